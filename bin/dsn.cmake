@@ -28,6 +28,10 @@ message(STATUS "ENABLE_GCOV = ${ENABLE_GCOV}")
 option(ENABLE_GPERF "Enable gperftools (for tcmalloc)" ON)
 message(STATUS "ENABLE_GPERF = ${ENABLE_GPERF}")
 
+# Disable this option to compile the fail points out, which the unit tests depend on.
+option(ENABLE_FAIL_POINT "Enable fail points (for fault injection in tests)" ON)
+message(STATUS "ENABLE_FAIL_POINT = ${ENABLE_FAIL_POINT}")
+
 # ================================================================== #
 
 
@@ -185,6 +189,10 @@ function(dsn_setup_compiler_flags)
     # We want access to the PRI* print format macros.
     add_definitions(-D__STDC_FORMAT_MACROS)
 
+    if(NOT ENABLE_FAIL_POINT)
+        add_definitions(-DDSN_DISABLE_FAIL_POINT)
+    endif()
+
     set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -std=c++1y" CACHE STRING "" FORCE)
 
     #  -Wall: Enable all warnings.
@@ -293,7 +301,7 @@ function(dsn_setup_thirdparty_libs)
         message(FATAL_ERROR "thrift library not found in ${DSN_THIRDPARTY_ROOT}/lib")
     endif()
     find_package(fmt REQUIRED)
-    set(DEFAULT_THIRDPARTY_LIBS ${THRIFT_LIB} fmt::fmt CACHE STRING "default thirdparty libs" FORCE)
+    set(THIRDPARTY_LIBS ${THRIFT_LIB} fmt::fmt)
 
     # rocksdb
     file(GLOB ROCKSDB_DEPENDS_MODULE_PATH ${DSN_PROJECT_DIR}/thirdparty/src/*/cmake/modules)
@@ -306,6 +314,19 @@ function(dsn_setup_thirdparty_libs)
     find_package(lz4)
     find_package(RocksDB REQUIRED)
 
+    # optional codecs of rpc response compression
+    if(LZ4_FOUND)
+        add_definitions(-DDSN_HAS_LZ4)
+        include_directories(${LZ4_INCLUDE_DIR})
+        list(APPEND THIRDPARTY_LIBS ${LZ4_LIBRARIES})
+    endif()
+    if(ZSTD_FOUND)
+        add_definitions(-DDSN_HAS_ZSTD)
+        include_directories(${ZSTD_INCLUDE_DIRS})
+        list(APPEND THIRDPARTY_LIBS ${ZSTD_LIBRARIES})
+    endif()
+    set(DEFAULT_THIRDPARTY_LIBS ${THIRDPARTY_LIBS} CACHE STRING "default thirdparty libs" FORCE)
+
     link_directories(${DSN_THIRDPARTY_ROOT}/lib)
     link_directories(${DSN_THIRDPARTY_ROOT}/lib64)
 endfunction(dsn_setup_thirdparty_libs)
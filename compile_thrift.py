@@ -270,5 +270,12 @@ if __name__ == "__main__":
     add_hook("dsn.layer2", "src", replace_hook, ["dsn.layer2_types.h", {
              r"dsn\.layer2_TYPES_H": 'dsn_layer2_TYPES_H'}])
 
+    # the keys read into a map are moved rather than copied into it
+    move_map_key = {r"\[(_key\d+)\]": r"[std::move(\1)]"}
+    add_hook("dsn.layer2", "src", replace_hook,
+             ["dsn.layer2_types.cpp", move_map_key])
+    add_hook("replication", "src/dist/replication", replace_hook,
+             ["replication_types.cpp", move_map_key])
+
     for i in thrift_description:
         compile_thrift_file(i)
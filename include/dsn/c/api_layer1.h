@@ -141,7 +141,9 @@ dsn_threadpool_code_register.
   ; task queue aspects names, usually for tooling purpose
   queue_aspects =
 
-  ; task queue provider name
+  ; task queue provider name, e.g., dsn::tools::simple_task_queue,
+  ; dsn::tools::hpc_concurrent_task_queue, or dsn::tools::work_stealing_task_queue
+  ; (per-worker queues with stealing, for non-partitioned pools only)
   queue_factory_name = dsn::tools::hpc_concurrent_task_queue
 
   ; throttling: throttling threshold above which rpc requests will be dropped
@@ -267,6 +269,10 @@ __inline uint64_t dsn_now_us() { return dsn_now_ns() / 1000; }
 __inline uint64_t dsn_now_ms() { return dsn_now_ns() / 1000000; }
 __inline uint64_t dsn_now_s() { return dsn_now_ns() / 1000000000; }
 
+/*! the current time in milliseconds cached every [core] coarse_clock_interval_ms, which is much
+    cheaper than dsn_now_ms() for the callers tolerating the staleness */
+extern DSN_API uint64_t dsn_now_coarse_ms();
+
 /*@}*/
 
 /*@}*/
@@ -39,6 +39,7 @@
 #include <dsn/utility/error_code.h>
 #include <dsn/tool-api/threadpool_code.h>
 #include <dsn/tool-api/task_code.h>
+#include <dsn/utility/inline_function.h>
 
 /*!
 @addtogroup task-common
@@ -48,7 +49,9 @@
 namespace dsn {
 class message_ex;
 
-typedef std::function<void()> task_handler;
+// The callbacks of tasks are stored in inline_function rather than std::function, so that the
+// lambdas capturing a few variables are not allocated on heap on every enqueue.
+typedef inline_function<void()> task_handler;
 
 /// A callback to handle rpc requests.
 ///
@@ -62,19 +65,20 @@ typedef std::function<void(dsn::message_ex *)> rpc_request_handler;
 ///  - error_code
 ///  - message_ex: the sent rpc request
 ///  - message_ex: the received rpc response
-typedef std::function<void(dsn::error_code, dsn::message_ex *, dsn::message_ex *)>
+typedef inline_function<void(dsn::error_code, dsn::message_ex *, dsn::message_ex *)>
     rpc_response_handler;
 
 /// Parameters:
 ///  - error_code
 ///  - size_t: the read or written size of bytes from file.
-typedef std::function<void(dsn::error_code, size_t)> aio_handler;
+typedef inline_function<void(dsn::error_code, size_t)> aio_handler;
 
 class task;
 class raw_task;
 class rpc_request_task;
 class rpc_response_task;
 class aio_task;
+class task_queue_router;
 }
 /*!
 apps updates the value at dsn_task_queue_virtual_length_ptr(..) to control
@@ -84,4 +88,13 @@ enable customized throttling, see spec of thread pool for more information
 extern DSN_API volatile int *dsn_task_queue_virtual_length_ptr(dsn::task_code code,
                                                                int hash DEFAULT(0));
 
+/*!
+installs the router of a partitioned thread pool, which maps the task hashes to the queues,
+see task_queue_router. it must be installed before any task whose queue is changed by it is
+enqueued, and kept alive for the lifetime of the process. returns false if the pool is not
+partitioned or already has a router.
+*/
+extern DSN_API bool dsn_threadpool_set_queue_router(dsn::threadpool_code pool,
+                                                    dsn::task_queue_router *router);
+
 /*@}*/
@@ -0,0 +1,275 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine) || __cplusplus < 202002L
+#error "dsn/cpp/coroutine.h requires C++20 coroutines"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+#include <dsn/tool-api/async_calls.h>
+
+namespace dsn {
+namespace coro {
+
+// Coroutines on top of the task engine, as an alternative to chaining callbacks.
+//
+// A coroutine returns async_task and is started by spawn(), which binds it to a task code, a
+// thread hash and a tracker. The coroutine always runs in tasks of that code and hash, so it
+// keeps the thread affinity of the callbacks it replaces, e.g. of a replica:
+//
+//   async_task replica::check_remote(rpc_address target)
+//   {
+//       auto result = co_await coro::call<check_response>(target, RPC_CHECK, check_request());
+//       if (result.first != ERR_OK) {
+//           co_await coro::sleep_for(std::chrono::seconds(1));
+//           ...
+//       }
+//   }
+//
+//   coro::spawn(LPC_REPLICATION_COMMON, &_tracker, check_remote(target), get_gpid().thread_hash());
+//
+// Each co_await resumes the coroutine with one task tracked by the tracker, which is what a
+// callback would have cost, without any std::function. When the tracker cancels the task, the
+// coroutine is destroyed instead of being resumed, which destroys its local variables.
+//
+// The arguments of a coroutine are copied into its frame, but the captures of a lambda are
+// not, so spawn functions or member functions rather than lambdas with captures.
+class async_task
+{
+public:
+    struct promise_type
+    {
+        task_code code{TASK_CODE_INVALID};
+        int hash{0};
+        task_tracker *tracker{nullptr};
+
+        async_task get_return_object() noexcept
+        {
+            return async_task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        // started by spawn()
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        // the frame is freed as soon as the coroutine returns
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    async_task(async_task &&other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+    async_task(const async_task &) = delete;
+    async_task &operator=(const async_task &) = delete;
+
+    // a coroutine never spawned is destroyed with this object
+    ~async_task()
+    {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+private:
+    explicit async_task(handle_type h) : _handle(h) {}
+
+    friend void spawn(task_code code, task_tracker *tracker, async_task &&coroutine, int hash);
+
+    handle_type _handle;
+};
+
+// the task resuming a coroutine
+class coroutine_task : public task
+{
+public:
+    coroutine_task(async_task::handle_type h)
+        : task(h.promise().code, h.promise().hash), _handle(h)
+    {
+    }
+
+    ~coroutine_task() override { clear_non_trivial_on_task_end(); }
+
+    void exec() override { std::exchange(_handle, nullptr).resume(); }
+
+protected:
+    // destroys the coroutine if the task is cancelled rather than executed
+    void clear_non_trivial_on_task_end() override
+    {
+        if (_handle) {
+            std::exchange(_handle, nullptr).destroy();
+        }
+    }
+
+private:
+    async_task::handle_type _handle;
+};
+
+// resumes the coroutine in a task of its code and hash after `delay_ms`
+inline void resume_later(async_task::handle_type h, int delay_ms = 0)
+{
+    task_ptr t(new coroutine_task(h));
+    t->set_tracker(h.promise().tracker);
+    if (t->spec().has_hook(TASK_HOOK_CREATE)) {
+        t->spec().on_task_create.execute(task::get_current_task(), t);
+    }
+    t->set_delay(delay_ms);
+    t->enqueue();
+}
+
+// runs the coroutine in the tasks of `code` and `hash`, tracked by `tracker`
+inline void spawn(task_code code, task_tracker *tracker, async_task &&coroutine, int hash = 0)
+{
+    auto h = std::exchange(coroutine._handle, nullptr);
+    h.promise().code = code;
+    h.promise().hash = hash;
+    h.promise().tracker = tracker;
+    resume_later(h);
+}
+
+// co_await sleep_for(delay)
+class sleep_awaiter
+{
+public:
+    explicit sleep_awaiter(std::chrono::milliseconds delay) : _delay(delay) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(async_task::handle_type h)
+    {
+        resume_later(h, std::max(static_cast<int>(_delay.count()), 0));
+    }
+    void await_resume() const noexcept {}
+
+private:
+    std::chrono::milliseconds _delay;
+};
+
+inline sleep_awaiter sleep_for(std::chrono::milliseconds delay) { return sleep_awaiter(delay); }
+
+// co_await yield(), to let other tasks of the same thread run
+inline sleep_awaiter yield() { return sleep_awaiter(std::chrono::milliseconds(0)); }
+
+// co_await call(server, request) sends the request and returns the rpc_response_task, whose
+// error() and get_response() are the result of the call
+class rpc_call_awaiter
+{
+public:
+    rpc_call_awaiter(rpc_address server, message_ex *request) : _server(server), _request(request)
+    {
+    }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(async_task::handle_type h)
+    {
+        // the reply is handled by the ack pool, and the coroutine is resumed in its own task
+        _task = rpc::create_rpc_response_task(
+            _request, nullptr, [h](error_code, message_ex *, message_ex *) { resume_later(h); });
+        // the coroutine may be resumed at once, so this must be the last access to the awaiter
+        dsn_rpc_call(_server, _task.get());
+    }
+    rpc_response_task_ptr await_resume() noexcept { return std::move(_task); }
+
+private:
+    rpc_address _server;
+    message_ex *_request;
+    rpc_response_task_ptr _task;
+};
+
+inline rpc_call_awaiter call(rpc_address server, message_ex *request)
+{
+    return rpc_call_awaiter(server, request);
+}
+
+// co_await call<TResponse>(server, code, req, ...) returns std::pair<error_code, TResponse>,
+// like rpc::call_wait()
+template <typename TResponse>
+class typed_rpc_call_awaiter : public rpc_call_awaiter
+{
+public:
+    using rpc_call_awaiter::rpc_call_awaiter;
+
+    std::pair<error_code, TResponse> await_resume()
+    {
+        rpc_response_task_ptr t = rpc_call_awaiter::await_resume();
+        std::pair<error_code, TResponse> result;
+        result.first = t->error();
+        if (result.first == ERR_OK) {
+            unmarshall(t->get_response(), result.second);
+        }
+        return result;
+    }
+};
+
+template <typename TResponse, typename TRequest>
+typed_rpc_call_awaiter<TResponse>
+call(rpc_address server,
+     task_code code,
+     TRequest &&req,
+     std::chrono::milliseconds timeout = std::chrono::milliseconds(0),
+     int thread_hash = 0,
+     uint64_t partition_hash = 0)
+{
+    dsn::message_ex *msg = dsn::message_ex::create_request(
+        code, static_cast<int>(timeout.count()), thread_hash, partition_hash);
+    marshall(msg, std::forward<TRequest>(req));
+    return typed_rpc_call_awaiter<TResponse>(server, msg);
+}
+
+// co_await read(...) / write(...) returns std::pair<error_code, size_t>, the error and the
+// transferred bytes of the io
+class aio_awaiter
+{
+public:
+    aio_awaiter(disk_file *file, char *buffer, int count, uint64_t offset, bool is_write)
+        : _file(file), _buffer(buffer), _count(count), _offset(offset), _is_write(is_write)
+    {
+    }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(async_task::handle_type h)
+    {
+        auto cb = [this, h](error_code err, size_t size) {
+            _err = err;
+            _size = size;
+            resume_later(h);
+        };
+        // the completion is handled by the pool of the coroutine, not tracked so that it always
+        // happens, and then the coroutine is resumed by a tracked task
+        if (_is_write) {
+            file::write(_file, _buffer, _count, _offset, h.promise().code, nullptr, cb,
+                        h.promise().hash);
+        } else {
+            file::read(_file, _buffer, _count, _offset, h.promise().code, nullptr, cb,
+                       h.promise().hash);
+        }
+    }
+    std::pair<error_code, size_t> await_resume() const noexcept { return {_err, _size}; }
+
+private:
+    disk_file *_file;
+    char *_buffer;
+    int _count;
+    uint64_t _offset;
+    bool _is_write;
+
+    error_code _err;
+    size_t _size{0};
+};
+
+inline aio_awaiter read(disk_file *file, char *buffer, int count, uint64_t offset)
+{
+    return aio_awaiter(file, buffer, count, offset, false);
+}
+
+inline aio_awaiter write(disk_file *file, const char *buffer, int count, uint64_t offset)
+{
+    return aio_awaiter(file, const_cast<char *>(buffer), count, offset, true);
+}
+
+} // namespace coro
+} // namespace dsn
@@ -25,6 +25,11 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <ostream>
 #include <vector>
 #include <map>
 #include <unordered_map>
@@ -34,7 +39,6 @@
 #include <type_traits>
 #include <cctype>
 
-#include <rapidjson/ostreamwrapper.h>
 #include <rapidjson/prettywriter.h>
 #include <rapidjson/writer.h>
 #include <rapidjson/document.h>
@@ -42,6 +46,7 @@
 #include <boost/lexical_cast.hpp>
 
 #include <dsn/utility/autoref_ptr.h>
+#include <dsn/utility/ports.h>
 #include <dsn/utility/utils.h>
 #include <dsn/tool-api/auto_codes.h>
 #include <dsn/dist/replication/replication_types.h>
@@ -200,8 +205,8 @@
 #define DEFINE_JSON_SERIALIZATION(...)                                                             \
     void encode_json_state(std::ostream &os)                                                       \
     {                                                                                              \
-        rapidjson::OStreamWrapper wrapper(os);                                                     \
-        dsn::json::JsonWriter w(wrapper);                                                          \
+        dsn::json::json_output_stream stream(os);                                                  \
+        dsn::json::JsonWriter w(stream);                                                           \
         encode_json_state(w);                                                                      \
     }                                                                                              \
     void encode_json_state(dsn::json::JsonWriter &out) const                                       \
@@ -226,9 +231,99 @@
 namespace dsn {
 namespace json {
 
+// json_output_stream is the output stream of JsonWriter, which writes into a buffer of its own.
+//
+// rapidjson::OStreamWrapper calls std::ostream::put() for each char, which is rather slow. Instead
+// the writer reserves the space for each value, e.g. 6 bytes for each char of a string to be
+// escaped, then writes the chars by plain stores which the compiler can unroll and vectorize.
+//
+// If constructed with an std::ostream, the buffer is written into it when the writer flushes,
+// i.e. at the end of the root value, or when the buffer is full. Otherwise the output is kept
+// in the buffer, and get_buffer() returns it as a blob without copying.
+class json_output_stream
+{
+public:
+    typedef char Ch;
+
+    json_output_stream() : _os(nullptr) {}
+    explicit json_output_stream(std::ostream &os) : _os(&os) {}
+    ~json_output_stream() { Flush(); }
+
+    json_output_stream(const json_output_stream &) = delete;
+    json_output_stream &operator=(const json_output_stream &) = delete;
+
+    void Put(char c)
+    {
+        Reserve(1);
+        *_cur++ = c;
+    }
+    void PutUnsafe(char c) { *_cur++ = c; }
+
+    void Reserve(size_t count)
+    {
+        if (dsn_unlikely(static_cast<size_t>(_end - _cur) < count)) {
+            grow(count);
+        }
+    }
+
+    void Flush()
+    {
+        if (_os != nullptr && _cur != _begin) {
+            _os->write(_begin, _cur - _begin);
+            _cur = _begin;
+        }
+    }
+
+    // the output, only for the stream without std::ostream
+    blob get_buffer() const
+    {
+        assert(_os == nullptr);
+        return blob(_buffer, 0, static_cast<unsigned int>(_cur - _begin));
+    }
+
+private:
+    static const size_t INITIAL_BUFFER_BYTES = 4096;
+
+    void grow(size_t count)
+    {
+        Flush();
+        size_t size = _cur - _begin;
+        if (static_cast<size_t>(_end - _cur) >= count) {
+            return;
+        }
+        size_t capacity = std::max(size + count, static_cast<size_t>(_end - _begin) * 2);
+        if (capacity < INITIAL_BUFFER_BYTES) {
+            capacity = INITIAL_BUFFER_BYTES;
+        }
+        std::shared_ptr<char> buffer = utils::make_shared_array<char>(capacity);
+        if (size > 0) {
+            memcpy(buffer.get(), _begin, size);
+        }
+        _buffer = std::move(buffer);
+        _begin = _buffer.get();
+        _cur = _begin + size;
+        _end = _begin + capacity;
+    }
+
+    std::ostream *_os;
+    std::shared_ptr<char> _buffer;
+    char *_begin{nullptr};
+    char *_cur{nullptr};
+    char *_end{nullptr};
+};
+
+// found by argument dependent lookup from rapidjson::Writer, in place of the generic ones which
+// check the space for each char
+inline void PutReserve(json_output_stream &stream, size_t count) { stream.Reserve(count); }
+inline void PutUnsafe(json_output_stream &stream, char c) { stream.PutUnsafe(c); }
+
+// the documents not smaller than this are copied and parsed in situ, so that the strings in the
+// document refer to the copy rather than being copied one by one
+static const size_t JSON_INSITU_PARSE_MIN_BYTES = 4096;
+
 typedef rapidjson::GenericValue<rapidjson::UTF8<>> JsonObject;
-typedef rapidjson::Writer<rapidjson::OStreamWrapper> JsonWriter;
-typedef rapidjson::PrettyWriter<rapidjson::OStreamWrapper> PrettyJsonWriter;
+typedef rapidjson::Writer<json_output_stream> JsonWriter;
+typedef rapidjson::PrettyWriter<json_output_stream> PrettyJsonWriter;
 
 template <typename>
 class json_forwarder;
@@ -245,7 +340,7 @@ inline void json_encode(JsonWriter &out, const char *str) { out.String(str, strl
 inline bool json_decode(const JsonObject &in, std::string &str)
 {
     dverify(in.IsString());
-    str = in.GetString();
+    str.assign(in.GetString(), in.GetStringLength());
     return true;
 }
 
@@ -578,15 +673,16 @@ public:
     }
     static void encode(std::ostream &os, const T &t)
     {
-        rapidjson::OStreamWrapper wrapper(os);
-        JsonWriter writer(wrapper);
+        json_output_stream stream(os);
+        JsonWriter writer(stream);
         encode(writer, t);
     }
     static dsn::blob encode(const T &t)
     {
-        std::ostringstream os;
-        encode(os, t);
-        return blob::create_from_bytes(os.str());
+        json_output_stream stream;
+        JsonWriter writer(stream);
+        encode(writer, t);
+        return stream.get_buffer();
     }
 
     static bool decode(const JsonObject &in, T &t)
@@ -596,6 +692,14 @@ public:
     static bool decode(const dsn::blob &bb, T &t)
     {
         rapidjson::Document doc;
+        if (bb.length() >= JSON_INSITU_PARSE_MIN_BYTES) {
+            // the copy must outlive the document
+            std::unique_ptr<char[]> buffer(new char[bb.length() + 1]);
+            memcpy(buffer.get(), bb.data(), bb.length());
+            buffer[bb.length()] = '\0';
+            dverify(!doc.ParseInsitu(buffer.get()).HasParseError());
+            return decode(doc, t);
+        }
         dverify(!doc.Parse(bb.data(), bb.length()).HasParseError());
         return decode(doc, t);
     }
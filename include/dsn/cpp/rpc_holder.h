@@ -129,6 +129,25 @@ public:
         return _i->dsn_request;
     }
 
+    // Replies the request with `body`, a response already serialized in the format of the
+    // request (e.g. a cached one), rather than serializing response() on auto reply.
+    void reply_serialized(const blob &body)
+    {
+        dassert(_i, "rpc_holder is uninitialized");
+        if (dsn_unlikely(_mail_box != nullptr)) {
+            binary_reader reader(body);
+            unmarshall(reader,
+                       _i->thrift_response,
+                       (dsn_msg_serialize_format)dsn_request()->header->context.u.serialize_format);
+            return;
+        }
+
+        _i->auto_reply = false;
+        message_ex *dsn_response = dsn_request()->create_response();
+        dsn_response->write_append(body);
+        dsn_rpc_reply(dsn_response);
+    }
+
     // the remote address where reveice request from and send response to.
     rpc_address remote_address() const { return dsn_request()->header->from_address; }
 
@@ -100,6 +100,16 @@ public:
         commit_buffer();
     }
 
+    // the buffer of `val` is attached to the message without copying
+    virtual void write_shared(const blob &val) override
+    {
+        if (val.length() > 0 && val.buffer_ptr() != nullptr) {
+            flush();
+            _msg->write_append(val);
+        }
+        binary_writer::write_shared(val);
+    }
+
 private:
     virtual void create_new_buffer(size_t size, /*out*/ blob &bb) override
     {
@@ -149,9 +149,14 @@ inline std::ostream &operator<<(std::ostream &out, const partition_configuration
 
 typedef struct _configuration_query_by_index_request__isset
 {
-    _configuration_query_by_index_request__isset() : app_name(false), partition_indices(false) {}
+    _configuration_query_by_index_request__isset()
+        : app_name(false), partition_indices(false), known_version(false), wait_ms(false)
+    {
+    }
     bool app_name : 1;
     bool partition_indices : 1;
+    bool known_version : 1;
+    bool wait_ms : 1;
 } _configuration_query_by_index_request__isset;
 
 class configuration_query_by_index_request
@@ -161,11 +166,13 @@ public:
     configuration_query_by_index_request(configuration_query_by_index_request &&);
     configuration_query_by_index_request &operator=(const configuration_query_by_index_request &);
     configuration_query_by_index_request &operator=(configuration_query_by_index_request &&);
-    configuration_query_by_index_request() : app_name() {}
+    configuration_query_by_index_request() : app_name(), known_version(0), wait_ms(0) {}
 
     virtual ~configuration_query_by_index_request() throw();
     std::string app_name;
     std::vector<int32_t> partition_indices;
+    int64_t known_version;
+    int32_t wait_ms;
 
     _configuration_query_by_index_request__isset __isset;
 
@@ -173,12 +180,24 @@ public:
 
     void __set_partition_indices(const std::vector<int32_t> &val);
 
+    void __set_known_version(const int64_t val);
+
+    void __set_wait_ms(const int32_t val);
+
     bool operator==(const configuration_query_by_index_request &rhs) const
     {
         if (!(app_name == rhs.app_name))
             return false;
         if (!(partition_indices == rhs.partition_indices))
             return false;
+        if (__isset.known_version != rhs.__isset.known_version)
+            return false;
+        else if (__isset.known_version && !(known_version == rhs.known_version))
+            return false;
+        if (__isset.wait_ms != rhs.__isset.wait_ms)
+            return false;
+        else if (__isset.wait_ms && !(wait_ms == rhs.wait_ms))
+            return false;
         return true;
     }
     bool operator!=(const configuration_query_by_index_request &rhs) const
@@ -205,7 +224,12 @@ inline std::ostream &operator<<(std::ostream &out, const configuration_query_by_
 typedef struct _configuration_query_by_index_response__isset
 {
     _configuration_query_by_index_response__isset()
-        : err(false), app_id(false), partition_count(false), is_stateful(false), partitions(false)
+        : err(false),
+          app_id(false),
+          partition_count(false),
+          is_stateful(false),
+          partitions(false),
+          version(false)
     {
     }
     bool err : 1;
@@ -213,6 +237,7 @@ typedef struct _configuration_query_by_index_response__isset
     bool partition_count : 1;
     bool is_stateful : 1;
     bool partitions : 1;
+    bool version : 1;
 } _configuration_query_by_index_response__isset;
 
 class configuration_query_by_index_response
@@ -222,7 +247,10 @@ public:
     configuration_query_by_index_response(configuration_query_by_index_response &&);
     configuration_query_by_index_response &operator=(const configuration_query_by_index_response &);
     configuration_query_by_index_response &operator=(configuration_query_by_index_response &&);
-    configuration_query_by_index_response() : app_id(0), partition_count(0), is_stateful(0) {}
+    configuration_query_by_index_response()
+        : app_id(0), partition_count(0), is_stateful(0), version(0)
+    {
+    }
 
     virtual ~configuration_query_by_index_response() throw();
     ::dsn::error_code err;
@@ -230,6 +258,7 @@ public:
     int32_t partition_count;
     bool is_stateful;
     std::vector<partition_configuration> partitions;
+    int64_t version;
 
     _configuration_query_by_index_response__isset __isset;
 
@@ -243,6 +272,8 @@ public:
 
     void __set_partitions(const std::vector<partition_configuration> &val);
 
+    void __set_version(const int64_t val);
+
     bool operator==(const configuration_query_by_index_response &rhs) const
     {
         if (!(err == rhs.err))
@@ -255,6 +286,10 @@ public:
             return false;
         if (!(partitions == rhs.partitions))
             return false;
+        if (__isset.version != rhs.__isset.version)
+            return false;
+        else if (__isset.version && !(version == rhs.version))
+            return false;
         return true;
     }
     bool operator!=(const configuration_query_by_index_response &rhs) const
@@ -71,6 +71,8 @@ public:
         return (uint32_t)l;
     }
 
+    binary_reader &reader() { return _reader; }
+
 private:
     binary_reader &_reader;
 };
@@ -91,6 +93,8 @@ public:
         _writer.write((const char *)buf, static_cast<int>(len));
     }
 
+    binary_writer &writer() { return _writer; }
+
 private:
     binary_writer &_writer;
 };
@@ -454,6 +458,30 @@ inline uint32_t blob::read(apache::thrift::protocol::TProtocol *iprot)
     // for optimization, it is dangerous if the oprot is not a binary proto
     apache::thrift::protocol::TBinaryProtocol *binary_proto =
         static_cast<apache::thrift::protocol::TBinaryProtocol *>(iprot);
+
+    // blobs read from a message (e.g. client write payloads and learn responses) reference the
+    // buffer of the message without copying, which is the same as readString() in binary
+    // protocol
+    auto trans = dynamic_cast<binary_reader_transport *>(iprot->getTransport().get());
+    if (trans != nullptr && dynamic_cast<apache::thrift::protocol::TBinaryProtocol *>(iprot)) {
+        int32_t size = 0;
+        uint32_t xfer = binary_proto->readI32(size);
+        if (size < 0) {
+            throw apache::thrift::protocol::TProtocolException(
+                apache::thrift::protocol::TProtocolException::NEGATIVE_SIZE);
+        }
+        if (size > trans->reader().get_remaining_size()) {
+            throw TTransportException(TTransportException::END_OF_FILE,
+                                      "no more data to read after end-of-buffer");
+        }
+        if (size == 0) {
+            *this = blob();
+            return xfer;
+        }
+        trans->reader().read(*this, size);
+        return xfer + static_cast<uint32_t>(size);
+    }
+
     blob_string str(*this);
     return binary_proto->readString<blob_string>(str);
 }
@@ -462,6 +490,19 @@ inline uint32_t blob::write(apache::thrift::protocol::TProtocol *oprot) const
 {
     apache::thrift::protocol::TBinaryProtocol *binary_proto =
         static_cast<apache::thrift::protocol::TBinaryProtocol *>(oprot);
+
+    // large blobs (e.g. file blocks of nfs and learning) are attached to the writer without
+    // copying, which is the same as writeString() in binary protocol
+    const unsigned int shared_write_min_bytes = 16 * 1024;
+    if (length() >= shared_write_min_bytes && buffer_ptr() != nullptr &&
+        dynamic_cast<apache::thrift::protocol::TBinaryProtocol *>(oprot) != nullptr) {
+        auto trans = dynamic_cast<binary_writer_transport *>(oprot->getTransport().get());
+        if (trans != nullptr) {
+            uint32_t xfer = binary_proto->writeI32(length());
+            trans->writer().write_shared(*this);
+            return xfer + static_cast<uint32_t>(length());
+        }
+    }
     return binary_proto->writeString<blob_string>(blob_string(const_cast<blob &>(*this)));
 }
 
@@ -15,10 +15,13 @@ typedef dsn::ref_ptr<block_file> block_file_ptr;
 /**
  * @brief The ls_request struct, use to list all the files and directories under the dir_name
  * dir_name: a valid absolute path string, which "/" as splitter.We don't support relative path
+ * page_size: the max count of the entries in a page of {@link block_filesystem::list_dir_in_pages},
+ *            the implementation may return smaller pages
  */
 struct ls_request
 {
     std::string dir_name;
+    uint32_t page_size = 1000;
 };
 
 /**
@@ -51,6 +54,8 @@ struct ls_response
 typedef std::function<void(const ls_response &)> ls_callback;
 typedef future_task<ls_response> ls_future;
 typedef dsn::ref_ptr<ls_future> ls_future_ptr;
+// called with each page of the entries listed by list_dir_in_pages, return false to stop listing
+typedef std::function<bool(const std::vector<ls_entry> &)> ls_page_handler;
 
 /**
  * @brief The create_file_request struct, used to create a block_file_ptr
@@ -275,11 +280,14 @@ struct download_request
  *    ERR_FILE_OPERATION_FAILED: open output_local_name for write failed.
  *    if try to download a non-exist file and with an invalid output_local_name,
  *    it's up to implementation to return which error.
+ *  file_md5: the md5 of the downloaded content which is computed while downloading, empty if
+ *    the implementation doesn't support it.
  */
 struct download_response
 {
     dsn::error_code err;
     uint64_t downloaded_size;
+    std::string file_md5;
 };
 typedef std::function<void(const download_response &)> download_callback;
 typedef future_task<download_response> download_future;
@@ -318,6 +326,41 @@ public:
                                    const ls_callback &callback,
                                    dsn::task_tracker *tracker = nullptr) = 0;
 
+    /**
+     * @brief list_dir_in_pages
+     *    list the entries under req.dir_name page by page without holding all of them, which
+     *    is preferred for the directories with a huge count of entries. The pages are passed to
+     *    `handler` in order as soon as they are listed, maybe in a thread of the implementation,
+     *    and the listing is stopped if `handler` returns false. `callback` is called after all
+     *    the pages are handled, with the same errors as list_dir and always empty entries.
+     *
+     *    The default implementation lists the whole directory by list_dir as one page.
+     * @param req, ref {@link #ls_request}
+     * @param handler, called with each page
+     * @param code, a task_code, describe how the callback executed
+     * @param callback, called when the listing is finished
+     * @param tracker
+     * @return a task which represent the async operation
+     */
+    virtual dsn::task_ptr list_dir_in_pages(const ls_request &req,
+                                            const ls_page_handler &handler,
+                                            dsn::task_code code,
+                                            const ls_callback &callback,
+                                            dsn::task_tracker *tracker = nullptr)
+    {
+        return list_dir(req,
+                        code,
+                        [handler, callback](const ls_response &resp) {
+                            ls_response result;
+                            result.err = resp.err;
+                            if (resp.err == ERR_OK && !resp.entries->empty()) {
+                                handler(*resp.entries);
+                            }
+                            callback(result);
+                        },
+                        tracker);
+    }
+
     /**
      * @brief create_file
      * @param req, ref {@link #create_file_request}
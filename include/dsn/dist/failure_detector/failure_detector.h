@@ -65,6 +65,8 @@
 #include <dsn/dist/failure_detector/fd.server.h>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/tool-api/zlocks.h>
+#include <dsn/utility/synchronize.h>
+#include <atomic>
 
 namespace dsn {
 namespace fd {
@@ -113,6 +115,7 @@ public:
 
     uint32_t get_lease_ms() const { return _lease_milliseconds; }
     uint32_t get_grace_ms() const { return _grace_milliseconds; }
+    uint32_t get_beacon_timeout_ms() const { return _beacon_timeout_milliseconds; }
 
     void register_master(::dsn::rpc_address target);
 
@@ -122,6 +125,11 @@ public:
 
     virtual bool is_master_connected(::dsn::rpc_address node) const;
 
+    // the time (in ms) before which `node` still regards this worker as alive, which is derived
+    // from the send time of the last acked beacon in the same way as check_all_records() does,
+    // return 0 if `node` is not a connected master
+    uint64_t get_master_lease_expire_ms(::dsn::rpc_address node) const;
+
     // ATTENTION: be very careful to set is_connected to false as
     // workers are always considered *connected* initially which is ok even when workers think
     // master is disconnected
@@ -160,6 +168,9 @@ protected:
 private:
     void check_all_records();
 
+    // refreshes the record of `node` if it's a connected worker, without _lock
+    bool refresh_alive_worker(::dsn::rpc_address node, uint64_t now);
+
 private:
     class master_record
     {
@@ -181,20 +192,20 @@ private:
         }
     };
 
+    // the beacons of an alive worker only refresh last_beacon_recv_time under the read lock of
+    // _workers_lock, while the other updates are made under both _lock and the write lock
     class worker_record
     {
     public:
         ::dsn::rpc_address node;
-        uint64_t last_beacon_recv_time;
-        bool is_alive;
+        std::atomic<uint64_t> last_beacon_recv_time;
+        std::atomic<bool> is_alive;
 
         // workers are always considered *connected* initially which is ok even when workers think
         // master is disconnected
         worker_record(::dsn::rpc_address node, uint64_t last_beacon_recv_time)
+            : node(node), last_beacon_recv_time(last_beacon_recv_time), is_alive(true)
         {
-            this->node = node;
-            this->last_beacon_recv_time = last_beacon_recv_time;
-            is_alive = true;
         }
     };
 
@@ -207,6 +218,8 @@ private:
 
     master_map _masters;
     worker_map _workers;
+    // protects the structure of _workers, see worker_record
+    mutable utils::rw_lock_nr _workers_lock;
 
     uint32_t _check_interval_milliseconds;
     uint32_t _beacon_interval_milliseconds;
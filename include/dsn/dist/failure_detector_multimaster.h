@@ -46,9 +46,12 @@ namespace dist {
 class slave_failure_detector_with_multimaster : public dsn::fd::failure_detector
 {
 public:
+    // `master_switched_callback` is called once the leader of the meta servers is switched,
+    // with the lock of the failure detector held
     slave_failure_detector_with_multimaster(std::vector<::dsn::rpc_address> &meta_servers,
                                             std::function<void()> &&master_disconnected_callback,
-                                            std::function<void()> &&master_connected_callback);
+                                            std::function<void()> &&master_connected_callback,
+                                            std::function<void()> &&master_switched_callback = {});
     ~slave_failure_detector_with_multimaster(void);
 
     virtual void end_ping(::dsn::error_code err, const fd::beacon_ack &ack, void *context);
@@ -73,9 +76,26 @@ public:
     void set_leader_for_test(dsn::rpc_address meta);
 
 private:
+    // Probes all the meta servers except `leader` concurrently, rather than trying them one
+    // after another, and switches to the first one which claims to be the leader or hints at it.
+    void probe_meta_servers(::dsn::rpc_address leader);
+    void end_probe(::dsn::error_code err,
+                   ::dsn::rpc_address target,
+                   const fd::beacon_ack &ack,
+                   uint64_t round);
+
+    // switches the leader to `to`, and starts beaconing it immediately
+    void switch_leader(::dsn::rpc_address from, ::dsn::rpc_address to);
+
     dsn::rpc_address _meta_servers;
     std::function<void()> _master_disconnected_callback;
     std::function<void()> _master_connected_callback;
+    std::function<void()> _master_switched_callback;
+
+    // protected by failure_detector::_lock
+    uint64_t _probe_round{0};
+    bool _probing{false};
+    int _pending_probes{0};
 };
 
 //------------------ inline implementation --------------------------------
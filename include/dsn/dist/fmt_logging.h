@@ -26,17 +26,190 @@
 
 #pragma once
 
+#include <dsn/tool-api/logging_provider.h>
 #include <fmt/ostream.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace dsn {
+class error_code;
+class gpid;
+class rpc_address;
+class task_code;
+
+namespace fmt_logging {
+
+// Whether an argument of type T is copied into a deferred_log_message, to be formatted when the
+// logger writes out the message. The copy mustn't refer to the memory of the caller, which may
+// be gone by then, so e.g. fmt::join() or the pointers to other than chars are formatted eagerly.
+template <typename T>
+struct is_deferrable
+    : std::integral_constant<bool, std::is_arithmetic<T>::value || std::is_enum<T>::value>
+{
+};
+template <>
+struct is_deferrable<std::string> : std::true_type
+{
+};
+// copied into std::string
+template <>
+struct is_deferrable<const char *> : std::true_type
+{
+};
+template <>
+struct is_deferrable<char *> : std::true_type
+{
+};
+template <>
+struct is_deferrable<error_code> : std::true_type
+{
+};
+template <>
+struct is_deferrable<gpid> : std::true_type
+{
+};
+template <>
+struct is_deferrable<rpc_address> : std::true_type
+{
+};
+template <>
+struct is_deferrable<task_code> : std::true_type
+{
+};
+
+template <typename... Args>
+struct all_deferrable : std::true_type
+{
+};
+template <typename T, typename... Args>
+struct all_deferrable<T, Args...>
+    : std::integral_constant<bool,
+                             is_deferrable<typename std::decay<T>::type>::value &&
+                                 all_deferrable<Args...>::value>
+{
+};
+
+// how an argument is stored in a deferred_log_message
+template <typename T>
+struct captured
+{
+    typedef T type;
+    template <typename U>
+    static U &&capture(U &&arg)
+    {
+        return std::forward<U>(arg);
+    }
+};
+template <>
+struct captured<const char *>
+{
+    typedef std::string type;
+    static std::string capture(const char *arg) { return arg != nullptr ? arg : "(null)"; }
+};
+template <>
+struct captured<char *> : captured<const char *>
+{
+};
+
+template <typename... Args>
+class message : public deferred_log_message
+{
+public:
+    template <typename... CallArgs>
+    explicit message(const char *fmt, CallArgs &&... args)
+        : _fmt(fmt), _args(captured<Args>::capture(std::forward<CallArgs>(args))...)
+    {
+    }
+
+    void format_to(std::string &out) const override
+    {
+        format_to(out, std::index_sequence_for<Args...>());
+    }
+
+private:
+    template <size_t... I>
+    void format_to(std::string &out, std::index_sequence<I...>) const
+    {
+        try {
+            out.append(fmt::format(_fmt, std::get<I>(_args)...));
+        } catch (const std::exception &e) {
+            // thrown on the thread formatting it, which may not be the logging thread
+            out.append(_fmt).append(" <bad log message: ").append(e.what()).append(">");
+        }
+    }
+
+    const char *_fmt; // a string literal
+    std::tuple<typename captured<Args>::type...> _args;
+};
+
+// the format string is a string literal, and all the arguments are deferrable
+template <size_t N, typename... Args>
+void log(std::true_type,
+         const char *file,
+         const char *function,
+         const int line,
+         dsn_log_level_t log_level,
+         const char (&fmt)[N],
+         Args &&... args)
+{
+    logging_provider::instance()->dsn_log_deferred(
+        file,
+        function,
+        line,
+        log_level,
+        std::unique_ptr<deferred_log_message>(
+            new message<typename std::decay<Args>::type...>(fmt, std::forward<Args>(args)...)));
+}
+
+template <typename Fmt, typename... Args>
+void log(std::false_type,
+         const char *file,
+         const char *function,
+         const int line,
+         dsn_log_level_t log_level,
+         Fmt &&fmt,
+         Args &&... args)
+{
+    dsn_log(file, function, line, log_level, fmt::format(fmt, std::forward<Args>(args)...).c_str());
+}
+
+template <typename Fmt, typename... Args>
+void log(const char *file,
+         const char *function,
+         const int line,
+         dsn_log_level_t log_level,
+         Fmt &&fmt,
+         Args &&... args)
+{
+    // a literal is an lvalue of const char[N], unlike a char array on the stack
+    typedef typename std::remove_reference<Fmt>::type fmt_type;
+    typedef std::integral_constant<bool,
+                                   std::is_lvalue_reference<Fmt>::value &&
+                                       std::is_array<fmt_type>::value &&
+                                       std::is_same<typename std::remove_extent<fmt_type>::type,
+                                                    const char>::value &&
+                                       all_deferrable<Args...>::value>
+        deferrable;
+    fmt_logging::log(
+        deferrable(), file, function, line, log_level, fmt, std::forward<Args>(args)...);
+}
+
+} // namespace fmt_logging
+} // namespace dsn
 
 // The macros below no longer use the default snprintf method for log message formatting,
 // instead we use fmt::format.
-// TODO(wutao1): prevent construction of std::string for each log.
+//
+// The arguments are only evaluated if the level is enabled. If the format string is a literal
+// and the arguments are of the deferrable types above, they are captured into a
+// deferred_log_message instead, so that the logger may format it off the logging thread, e.g.
+// async_logger formats it on its background thread.
 
 #define dlog_f(level, ...)                                                                         \
     do {                                                                                           \
         if (level >= dsn_log_start_level)                                                          \
-            dsn_log(                                                                               \
-                __FILENAME__, __FUNCTION__, __LINE__, level, fmt::format(__VA_ARGS__).c_str());    \
+            dsn::fmt_logging::log(__FILENAME__, __FUNCTION__, __LINE__, level, __VA_ARGS__);       \
     } while (false)
 #define dinfo_f(...) dlog_f(LOG_LEVEL_INFORMATION, __VA_ARGS__)
 #define ddebug_f(...) dlog_f(LOG_LEVEL_DEBUG, __VA_ARGS__)
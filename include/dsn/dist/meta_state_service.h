@@ -46,8 +46,11 @@
 #include <dsn/service_api_cpp.h>
 #include <dsn/utility/error_code.h>
 #include <dsn/tool-api/future_types.h>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <functional>
+#include <utility>
 
 namespace dsn {
 namespace dist {
@@ -60,6 +63,12 @@ typedef std::function<void(error_code ec, const std::vector<std::string> &ret_st
 typedef future_task<error_code, std::vector<std::string>> err_stringv_future;
 typedef dsn::ref_ptr<err_stringv_future> err_stringv_future_ptr;
 
+typedef std::vector<std::pair<std::string, blob>> children_data;
+typedef std::function<void(error_code ec, const children_data &ret_children)>
+    err_children_data_callback;
+typedef future_task<error_code, children_data> err_children_data_future;
+typedef dsn::ref_ptr<err_children_data_future> err_children_data_future_ptr;
+
 class meta_state_service
 {
 public:
@@ -183,6 +192,77 @@ public:
                                   task_code cb_code,
                                   const err_stringv_callback &cb_get_children,
                                   dsn::task_tracker *tracker = nullptr) = 0;
+
+    /*
+     * get all childrens of a node with their data
+     * node: dir name with full path
+     * cb_code: the task code specifies where to execute the callback
+     * cb_get_children_data: if success, ret_children store the names (not full path) and
+     *                       the data of the children, in the order of get_children.
+     *                       children removed after listed are not returned
+     *
+     * the data of the children are read concurrently by default
+     */
+    virtual task_ptr get_children_data(const std::string &node,
+                                       task_code cb_code,
+                                       const err_children_data_callback &cb_get_children_data,
+                                       dsn::task_tracker *tracker = nullptr)
+    {
+        err_children_data_future_ptr tsk(
+            new err_children_data_future(cb_code, cb_get_children_data, 0));
+        tsk->set_tracker(tracker);
+        get_children(
+            node,
+            cb_code,
+            [this, node, cb_code, tsk](error_code ec, const std::vector<std::string> &children) {
+                if (ec != ERR_OK || children.empty()) {
+                    tsk->enqueue_with(ec, children_data());
+                    return;
+                }
+
+                struct context
+                {
+                    children_data children;
+                    std::vector<char> exists;
+                    std::atomic_int remaining;
+                    std::atomic_int error;
+                };
+                std::shared_ptr<context> ctx = std::make_shared<context>();
+                ctx->children.resize(children.size());
+                ctx->exists.resize(children.size(), false);
+                ctx->remaining.store(static_cast<int>(children.size()));
+                ctx->error.store(ERR_OK);
+                for (size_t i = 0; i < children.size(); ++i) {
+                    ctx->children[i].first = children[i];
+                    get_data(node + "/" + children[i],
+                             cb_code,
+                             [ctx, tsk, i](error_code ec, const blob &value) {
+                                 if (ec == ERR_OK) {
+                                     ctx->children[i].second = value;
+                                     ctx->exists[i] = true;
+                                 } else if (ec != ERR_OBJECT_NOT_FOUND) {
+                                     ctx->error.store(ec);
+                                 }
+                                 if (--ctx->remaining != 0) {
+                                     return;
+                                 }
+
+                                 error_code err(ctx->error.load());
+                                 children_data result;
+                                 if (err == ERR_OK) {
+                                     result.reserve(ctx->children.size());
+                                     for (size_t j = 0; j < ctx->children.size(); ++j) {
+                                         if (ctx->exists[j]) {
+                                             result.push_back(std::move(ctx->children[j]));
+                                         }
+                                     }
+                                 }
+                                 tsk->enqueue_with(err, std::move(result));
+                             });
+                }
+            });
+        return tsk;
+    }
 };
 }
 }
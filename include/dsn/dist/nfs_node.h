@@ -35,6 +35,17 @@
 
 namespace dsn {
 
+// the priority of a copy on the nfs server which serves it, the copies of higher priority get
+// larger shares of the bandwidth of the server, see [nfs] nfs_server_priority_weights
+enum nfs_copy_priority
+{
+    NFS_COPY_PRIORITY_BACKUP = 0,
+    NFS_COPY_PRIORITY_BALANCE,
+    NFS_COPY_PRIORITY_SPLIT,
+    NFS_COPY_PRIORITY_RECOVERY,
+    NFS_COPY_PRIORITY_COUNT
+};
+
 struct remote_copy_request
 {
     dsn::rpc_address source;
@@ -43,6 +54,7 @@ struct remote_copy_request
     std::string dest_dir;
     bool overwrite;
     bool high_priority;
+    nfs_copy_priority priority;
 };
 
 class nfs_node
@@ -50,6 +62,16 @@ class nfs_node
 public:
     static std::unique_ptr<nfs_node> create();
 
+    // the suffix of the file next to a copied file, which saves the blocks written by a failed
+    // copy of it, see [nfs] nfs_resumable_copy_enabled
+    static const char *COPY_PROGRESS_SUFFIX;
+
+    // prepare `dest_dir` to copy `files` into: if [nfs] nfs_resumable_copy_enabled, the files
+    // not in `files` are removed, and `files` are kept along with their copy progress, so that
+    // the copy resumes from the last failed one, otherwise the whole `dest_dir` is removed
+    static void prepare_copy_dir(const std::string &dest_dir,
+                                 const std::vector<std::string> &files);
+
 public:
     aio_task_ptr copy_remote_directory(rpc_address remote,
                                        const std::string &source_dir,
@@ -59,7 +81,8 @@ public:
                                        task_code callback_code,
                                        task_tracker *tracker,
                                        aio_handler &&callback,
-                                       int hash = 0);
+                                       int hash = 0,
+                                       nfs_copy_priority priority = NFS_COPY_PRIORITY_BALANCE);
     aio_task_ptr copy_remote_files(rpc_address remote,
                                    const std::string &source_dir,
                                    const std::vector<std::string> &files, // empty for all
@@ -69,7 +92,8 @@ public:
                                    task_code callback_code,
                                    task_tracker *tracker,
                                    aio_handler &&callback,
-                                   int hash = 0);
+                                   int hash = 0,
+                                   nfs_copy_priority priority = NFS_COPY_PRIORITY_BALANCE);
 
     nfs_node() {}
     virtual ~nfs_node() {}
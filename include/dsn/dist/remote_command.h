@@ -18,7 +18,16 @@ task_ptr async_call_remote(rpc_address remote,
                            std::function<void(error_code, const std::string &)> callback,
                            std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
 
-/// Registers the server-side RPC handler of remote commands.
+/// Calls a batch of remote commands to the remote server in one request. The commands are
+/// executed concurrently on THREAD_POOL_REMOTE_COMMAND of the server, and the response is a json
+/// array of {"cmd", "ok", "output"} in the order of `commands`.
+task_ptr async_call_remote_batch(
+    rpc_address remote,
+    const std::vector<std::pair<std::string, std::vector<std::string>>> &commands,
+    std::function<void(error_code, const std::string &)> callback,
+    std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+/// Registers the server-side RPC handlers of remote commands.
 bool register_remote_command_rpc();
 
 } // namespace cmd
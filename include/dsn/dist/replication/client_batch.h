@@ -0,0 +1,118 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <vector>
+
+#include <dsn/cpp/rpc_stream.h>
+#include <dsn/utility/error_code.h>
+#include <dsn/utility/shared_array.h>
+
+namespace dsn {
+namespace replication {
+
+// The body of RPC_CLIENT_BATCH is the count of the client requests followed by each of them as a
+// whole message, i.e. the header and the body, which are sent by a partition_resolver to the
+// replica server serving all of them. The body of its response is the count of the results
+// followed by each of them, i.e. the error and the reply message, which is empty if there is
+// none, e.g. the request timed out on the replica server.
+
+struct client_batch_result
+{
+    error_code err;
+    message_ptr reply;
+};
+
+namespace client_batch_detail {
+
+inline void write_message(rpc_write_stream &writer, message_ex *msg)
+{
+    if (msg == nullptr) {
+        writer.write_pod(0);
+        return;
+    }
+    writer.write_pod(static_cast<int>(sizeof(message_header) + msg->body_size()));
+    // the header is in the first buffer of a message for sending, and ahead of the buffers of a
+    // received one
+    if (reinterpret_cast<const char *>(msg->header) != msg->buffers[0].data()) {
+        writer.write(reinterpret_cast<const char *>(msg->header),
+                     static_cast<int>(sizeof(message_header)));
+    }
+    for (const blob &bb : msg->buffers) {
+        writer.write(bb.data(), static_cast<int>(bb.length()));
+    }
+}
+
+// returns a received message, or nullptr if it's empty
+inline message_ex *read_message(rpc_read_stream &reader)
+{
+    int length = 0;
+    reader.read_pod(length);
+    if (length == 0) {
+        return nullptr;
+    }
+    dassert(length >= static_cast<int>(sizeof(message_header)),
+            "invalid message length %d in client batch",
+            length);
+    // copied into an aligned block of its own, as the messages parsed from the network are
+    std::shared_ptr<char> buffer(utils::make_shared_array<char>(length));
+    reader.read(buffer.get(), length);
+    message_ex *msg = message_ex::create_receive_message(blob(buffer, length));
+    msg->hdr_format = NET_HDR_DSN;
+    return msg;
+}
+
+} // namespace client_batch_detail
+
+inline void write_client_batch(message_ex *msg, const std::vector<message_ex *> &requests)
+{
+    rpc_write_stream writer(msg);
+    writer.write_pod(static_cast<int>(requests.size()));
+    for (message_ex *request : requests) {
+        client_batch_detail::write_message(writer, request);
+    }
+}
+
+// the requests are received messages with no reference
+inline void read_client_batch(message_ex *msg, /*out*/ std::vector<message_ex *> &requests)
+{
+    rpc_read_stream reader(msg);
+    int count = 0;
+    reader.read_pod(count);
+    dassert(count >= 0, "invalid request count %d in client batch", count);
+    requests.resize(count);
+    for (message_ex *&request : requests) {
+        request = client_batch_detail::read_message(reader);
+        dassert(request != nullptr, "empty request in client batch");
+    }
+}
+
+inline void write_client_batch(message_ex *msg, const std::vector<client_batch_result> &results)
+{
+    rpc_write_stream writer(msg);
+    writer.write_pod(static_cast<int>(results.size()));
+    for (const client_batch_result &result : results) {
+        writer.write(std::string(result.err.to_string()));
+        client_batch_detail::write_message(writer, result.reply.get());
+    }
+}
+
+inline void read_client_batch(message_ex *msg, /*out*/ std::vector<client_batch_result> &results)
+{
+    rpc_read_stream reader(msg);
+    int count = 0;
+    reader.read_pod(count);
+    dassert(count >= 0, "invalid result count %d in client batch", count);
+    results.resize(count);
+    for (client_batch_result &result : results) {
+        std::string err;
+        reader.read(err);
+        result.err = error_code::try_get(err, ERR_UNKNOWN);
+        result.reply = client_batch_detail::read_message(reader);
+    }
+}
+
+} // namespace replication
+} // namespace dsn
@@ -64,6 +64,58 @@ protected:
     pipeline::environment _env;
 };
 
+/// \brief Packs a batch of mutation tuples into one payload for the wire, so that
+/// a mutation_duplicator sends a single request per batch.
+///
+/// The payload is compressed by zstd if the library is available. Besides, the
+/// mutations of the same app are sampled to train a zstd dictionary shared by all
+/// the encoders of that app, which improves the ratio of small writes a lot.
+/// A payload carries the dictionary inline the first time it is used, after that
+/// only the id of the dictionary is carried.
+///
+/// The encoder is not thread-safe, each mutation_duplicator should own one.
+/// \see dsn::replication::mutation_batch_decoder
+class mutation_batch_encoder
+{
+public:
+    explicit mutation_batch_encoder(string_view app_name);
+
+    ~mutation_batch_encoder();
+
+    blob encode(const mutation_tuple_set &mutations);
+
+    /// Carry the dictionary inline again in the next payload. Call it when the
+    /// remote failed to decode a payload with ERR_OBJECT_NOT_FOUND, which means
+    /// the remote has lost the dictionary (e.g. restarted), and re-encode the batch.
+    void reship_dictionary() { _shipped_dict_id = 0; }
+
+private:
+    struct context;
+    std::unique_ptr<context> _ctx;
+    uint32_t _shipped_dict_id{0};
+};
+
+/// \brief Unpacks the payloads made by mutation_batch_encoder on the remote.
+/// It keeps the dictionaries received, so one decoder should be used for the
+/// payloads of a duplication. Not thread-safe.
+class mutation_batch_decoder
+{
+public:
+    mutation_batch_decoder();
+
+    ~mutation_batch_decoder();
+
+    /// The data of the returned mutations refers to the decoded buffer rather than
+    /// the payload.
+    /// \returns ERR_OBJECT_NOT_FOUND if the dictionary of the payload is unknown.
+    /// \returns ERR_INVALID_DATA if the payload is corrupted.
+    error_s decode(const blob &payload, /*out*/ std::vector<mutation_tuple> &mutations);
+
+private:
+    struct context;
+    std::unique_ptr<context> _ctx;
+};
+
 inline std::unique_ptr<mutation_duplicator>
 new_mutation_duplicator(replica_base *r, string_view remote_cluster_address, string_view app)
 {
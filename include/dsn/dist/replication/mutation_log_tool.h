@@ -38,19 +38,54 @@
 #include <string>
 #include <iostream>
 #include <functional>
+#include <limits>
 #include <dsn/tool-api/rpc_message.h>
 
 namespace dsn {
 namespace replication {
 
+// the mutations to be scanned by mutation_log_tool::scan()
+struct mutation_log_filter
+{
+    // -1 for all the apps or partitions
+    int32_t app_id = -1;
+    int32_t partition_index = -1;
+    // [start, end) of the mutation timestamp, in microseconds
+    int64_t start_timestamp_us = 0;
+    int64_t end_timestamp_us = std::numeric_limits<int64_t>::max();
+    // [start, end) of the decree
+    int64_t start_decree = 0;
+    int64_t end_decree = std::numeric_limits<int64_t>::max();
+
+    bool match_partition(int32_t app, int32_t partition) const
+    {
+        return (app_id == -1 || app_id == app) &&
+               (partition_index == -1 || partition_index == partition);
+    }
+};
+
 class mutation_log_tool
 {
 public:
-    bool
-    dump(const std::string &log_dir,
-         std::ostream &output,
-         std::function<void(
-             int64_t decree, int64_t timestamp, dsn::message_ex **requests, int count)> callback);
+    typedef std::function<void(
+        int64_t decree, int64_t timestamp, dsn::message_ex **requests, int count)>
+        dump_callback;
+
+    bool dump(const std::string &log_dir, std::ostream &output, dump_callback callback);
+
+    // Scans the log files under `log_dir` concurrently in `thread_count` threads, and outputs
+    // the mutations matching `filter` like dump(), in log order.
+    //
+    // If `index_dir` isn't empty, the index of each log file is saved in it, which records the
+    // timestamp range and the decree range of each partition in each log block. Then the later
+    // scans only read and decode the matching blocks. The index is built again once the log file
+    // is changed.
+    bool scan(const std::string &log_dir,
+              const std::string &index_dir,
+              const mutation_log_filter &filter,
+              uint32_t thread_count,
+              std::ostream &output,
+              dump_callback callback);
 };
 }
 }
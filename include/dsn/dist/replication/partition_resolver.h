@@ -26,12 +26,18 @@
 
 #pragma once
 
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include <dsn/utility/autoref_ptr.h>
 #include <dsn/utility/error_code.h>
 #include <dsn/tool-api/gpid.h>
 #include <dsn/tool-api/rpc_address.h>
 #include <dsn/tool-api/rpc_message.h>
 #include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/zlocks.h>
+#include <dsn/cpp/serialization_helper/dsn.layer2_types.h>
 
 namespace dsn {
 namespace replication {
@@ -62,11 +68,46 @@ public:
         return response_task;
     }
 
+    // call the requests of (partition_hash, request) as call_op() does, the callback is copied
+    // for each of them, and the tasks are returned in the order of the requests. the requests
+    // resolved to the same replica server are sent in one RPC_CLIENT_BATCH if
+    // [replication] client_batch_enabled, see call_tasks().
+    template <typename TReq, typename TCallback>
+    std::vector<dsn::rpc_response_task_ptr>
+    call_ops(dsn::task_code code,
+             const std::vector<std::pair<uint64_t, TReq>> &requests,
+             dsn::task_tracker *tracker,
+             const TCallback &callback,
+             std::chrono::milliseconds timeout)
+    {
+        std::vector<dsn::rpc_response_task_ptr> tasks;
+        tasks.reserve(requests.size());
+        for (const auto &request : requests) {
+            dsn::message_ex *msg = dsn::message_ex::create_request(
+                code, static_cast<int>(timeout.count()), 0, request.first);
+            marshall(msg, request.second);
+            tasks.push_back(rpc::create_rpc_response_task(msg, tracker, TCallback(callback)));
+        }
+        call_tasks(tasks);
+        return tasks;
+    }
+
+    // call the tasks as call_task() does, but the requests resolved to the same replica server
+    // are sent in one RPC_CLIENT_BATCH, which is demultiplexed to the replicas by the replica
+    // server, if [replication] client_batch_enabled. the follower reads are sent alone, and the
+    // requests failed in a batch are retried alone.
+    void call_tasks(const std::vector<dsn::rpc_response_task_ptr> &tasks);
+
     // choosing a proper replica server from meta server or local route cache
     // and send the read/write request.
     // if got reply or error, call the callback.
     // parameters like request data, timeout, callback handler are all wrapped
     // into "task", you may want to refer to dsn::rpc_response_task for details.
+    // if the request is marked as follower read (`context.u.is_follower_read` of the header),
+    // it may be sent to a secondary, and is retried on the primary if failed. such reads may
+    // also be hedged on another replica after the p95 latency of the chosen one, and time out
+    // early by the latency of the chosen one, see [replication] client_hedged_read_enabled
+    // and client_adaptive_read_timeout_enabled.
     void call_task(const dsn::rpc_response_task_ptr &task);
 
     std::string get_app_name() const { return _app_name; }
@@ -100,12 +141,14 @@ protected:
      * \param partition_hash the partition hash
      * \param callback       callback invoked on completion or timeout
      * \param timeout_ms     timeout to execute the callback
+     * \param follower_read  whether a secondary can be resolved as well as the primary
      *
      * \return see \ref resolve_result for details
      */
     virtual void resolve(uint64_t partition_hash,
                          std::function<void(resolve_result &&)> &&callback,
-                         int timeout_ms) = 0;
+                         int timeout_ms,
+                         bool follower_read) = 0;
 
     /*!
      failure handler when access failed for certain partition
@@ -117,6 +160,29 @@ protected:
      */
     virtual void on_access_failure(int partition_index, error_code err) = 0;
 
+    /*!
+     handler of the configuration piggybacked by a replica server on access failure
+
+     \param config the configuration of the partition known by the replica server, e.g. the
+                   primary known by a secondary rejecting a write
+
+     this is to retry on the new primary without querying the meta server
+     */
+    virtual void on_config_hint(const partition_configuration &config) {}
+
+    /*!
+     resolve a replica of the partition other than `excluded` to send a hedged read to
+
+     \param partition_index zero-based index of the partition.
+     \param excluded        the replica which the read has been sent to
+
+     \return an invalid address if there is no other replica to read
+     */
+    virtual rpc_address resolve_hedge(int partition_index, rpc_address excluded)
+    {
+        return rpc_address();
+    }
+
     /**
      * get zero-based partition index
      *
@@ -131,6 +197,38 @@ protected:
     std::string _cluster_name;
     std::string _app_name;
     rpc_address _meta_server;
+
+private:
+    // retry the request of `task` on failure until its timeout
+    void add_retry_handler(const rpc_response_task_ptr &task);
+    // set the partition of the request by `result`, or complete the task by the error
+    bool on_resolved(const rpc_response_task_ptr &task, const resolve_result &result);
+    void send_task(const rpc_response_task_ptr &task, rpc_address addr);
+
+    struct batch_call;
+    void on_batch_resolved(const ref_ptr<batch_call> &bc,
+                           const rpc_response_task_ptr &task,
+                           rpc_address addr);
+    void send_batch(rpc_address addr, std::vector<rpc_response_task_ptr> &&tasks);
+
+    struct hedged_call;
+    void call_hedged(const rpc_response_task_ptr &task, rpc_address addr);
+    void send_attempt(const ref_ptr<hedged_call> &hc, message_ex *request, rpc_address addr);
+    void send_hedge(const ref_ptr<hedged_call> &hc);
+
+    // the latency of a replica server observed by the follower reads, estimated by the smoothed
+    // mean and mean deviation as the round-trip time of TCP
+    struct replica_latency
+    {
+        int64_t srtt_us;
+        int64_t rttvar_us;
+        uint32_t samples;
+    };
+    void record_latency(rpc_address addr, uint64_t latency_us);
+    bool get_latency(rpc_address addr, /*out*/ replica_latency &latency) const;
+
+    mutable zlock _latencies_lock;
+    std::unordered_map<rpc_address, replica_latency> _latencies;
 };
 
 typedef ref_ptr<partition_resolver> partition_resolver_ptr;
@@ -126,6 +126,9 @@ public:
 
     ::dsn::error_code apply_checkpoint(chkpt_apply_mode mode, const learn_state &state);
     ::dsn::error_code apply_mutation(const mutation *mu);
+    // Applies consecutive committed mutations, with their writes merged into one
+    // on_batched_write_requests() call if supported by the storage engine.
+    ::dsn::error_code apply_mutations(const std::vector<const mutation *> &mutations);
 
     // methods need to implement on storage engine side
     virtual ::dsn::error_code start(int argc, char **argv) = 0;
@@ -219,6 +222,13 @@ public:
                                           dsn::message_ex **requests,
                                           int request_length);
 
+    //
+    // Whether the writes of several consecutive mutations could be applied in one
+    // on_batched_write_requests() call, with the decree and timestamp of the last mutation.
+    // It's used to speed up replaying the learned mutations.
+    //
+    virtual bool support_batched_mutations() const { return false; }
+
     // query compact state.
     virtual std::string query_compact_state() const = 0;
 
@@ -36,7 +36,10 @@
 
 #include <dsn/dist/replication.h>
 
+#include <algorithm>
 #include <cctype>
+#include <functional>
+#include <mutex>
 #include <string>
 #include <map>
 #include <vector>
@@ -99,6 +102,17 @@ public:
                              int32_t &partition_count,
                              std::vector<partition_configuration> &partitions);
 
+    typedef std::function<void(const std::string &app_name,
+                               error_code err,
+                               const configuration_query_by_index_response &resp)>
+        app_partitions_callback;
+    // query the partitions of the apps concurrently over the connection to the meta server, at
+    // most `max_concurrency` queries are in flight. `callback` is called for each app as its
+    // response arrives, one at a time, where `err` is the error of either the rpc or the response.
+    void list_apps_partitions(const std::vector<std::string> &app_names,
+                              const app_partitions_callback &callback,
+                              int max_concurrency = DEFAULT_MAX_CONCURRENCY);
+
     dsn::replication::configuration_meta_control_response
     control_meta_function_level(meta_function_level::type level);
 
@@ -178,6 +192,18 @@ public:
         const std::string &app_name,
         /*out*/ std::map<dsn::rpc_address, error_with<query_disk_info_response>> &resps);
 
+    // query the nodes concurrently, at most `max_concurrency` queries are in flight, and
+    // `callback` is called for each node as its response arrives, one at a time
+    void query_disk_info(
+        const std::vector<dsn::rpc_address> &targets,
+        const std::string &app_name,
+        const std::function<void(dsn::rpc_address, error_with<query_disk_info_response> &&)>
+            &callback,
+        int max_concurrency = DEFAULT_MAX_CONCURRENCY);
+
+    // the default limit of the rpcs in flight when fanning out to the apps or the nodes
+    static const int DEFAULT_MAX_CONCURRENCY = 64;
+
 private:
     bool static valid_app_char(int c);
 
@@ -231,6 +257,50 @@ private:
         return error_with<TResponse>(std::move(rpc.response()));
     }
 
+    /// Send requests to multiple servers concurrently, keeping at most `max_concurrency` of them
+    /// in flight, and waits until all of them finish. A failed rpc is retried at most
+    /// `max_retry` times, then `on_result(i, err)` is called with the result of `rpcs[i]`, one at a
+    /// time, so it doesn't need any locking.
+    template <typename TRpcHolder>
+    void call_rpcs_windowed(std::vector<std::pair<dsn::rpc_address, TRpcHolder>> &rpcs,
+                            const std::function<void(size_t, error_code)> &on_result,
+                            int max_concurrency,
+                            int max_retry,
+                            int reply_thread_hash = 0)
+    {
+        dsn::task_tracker tracker;
+        std::mutex lock;
+        size_t next = std::min(rpcs.size(), static_cast<size_t>(std::max(max_concurrency, 1)));
+
+        // each finished rpc issues the next one, until all are issued
+        std::function<void(size_t, int)> call_one = [&](size_t i, int retry) {
+            rpcs[i].second.call(rpcs[i].first,
+                                &tracker,
+                                [&, i, retry](error_code err) {
+                                    if (err != ERR_OK && retry < max_retry) {
+                                        call_one(i, retry + 1);
+                                        return;
+                                    }
+                                    size_t n = rpcs.size();
+                                    {
+                                        std::lock_guard<std::mutex> l(lock);
+                                        on_result(i, err);
+                                        if (next < rpcs.size()) {
+                                            n = next++;
+                                        }
+                                    }
+                                    if (n < rpcs.size()) {
+                                        call_one(n, 0);
+                                    }
+                                },
+                                reply_thread_hash);
+        };
+        for (size_t i = 0; i < next; i++) {
+            call_one(i, 0);
+        }
+        tracker.wait_outstanding_tasks();
+    }
+
     /// Send request to multi replica server synchronously.
     template <typename TRpcHolder, typename TResponse = typename TRpcHolder::response_type>
     void call_rpcs_async(std::map<dsn::rpc_address, TRpcHolder> &rpcs,
@@ -238,31 +308,21 @@ private:
                          int reply_thread_hash = 0,
                          bool enable_retry = true)
     {
-        dsn::task_tracker tracker;
-        error_code err = ERR_UNKNOWN;
-        for (auto &rpc : rpcs) {
-            rpc.second.call(
-                rpc.first, &tracker, [&err, &resps, &rpcs, &rpc](error_code code) mutable {
-                    err = code;
-                    if (err == dsn::ERR_OK) {
-                        resps.emplace(rpc.first, std::move(rpc.second.response()));
-                        rpcs.erase(rpc.first);
-                    } else {
-                        resps.emplace(
-                            rpc.first,
-                            std::move(error_s::make(err, "unable to send rpc to server")));
-                    }
-                });
-        }
-        tracker.wait_outstanding_tasks();
-
-        if (enable_retry && rpcs.size() > 0) {
-            std::map<dsn::rpc_address, dsn::error_with<TResponse>> retry_resps;
-            call_rpcs_async(rpcs, retry_resps, reply_thread_hash, false);
-            for (auto &resp : retry_resps) {
-                resps.emplace(resp.first, std::move(resp.second));
-            }
-        }
+        std::vector<std::pair<dsn::rpc_address, TRpcHolder>> rpc_list(rpcs.begin(), rpcs.end());
+        call_rpcs_windowed(rpc_list,
+                           [&](size_t i, error_code err) {
+                               if (err == dsn::ERR_OK) {
+                                   resps.emplace(rpc_list[i].first,
+                                                 std::move(rpc_list[i].second.response()));
+                                   rpcs.erase(rpc_list[i].first);
+                               } else {
+                                   resps.emplace(rpc_list[i].first,
+                                                 error_s::make(err, "unable to send rpc to server"));
+                               }
+                           },
+                           DEFAULT_MAX_CONCURRENCY,
+                           enable_retry ? 1 : 0,
+                           reply_thread_hash);
     }
 
 private:
@@ -270,6 +330,9 @@ private:
     dsn::task_tracker _tracker;
 
     typedef rpc_holder<query_disk_info_request, query_disk_info_response> query_disk_info_rpc;
+    typedef rpc_holder<configuration_query_by_index_request,
+                       configuration_query_by_index_response>
+        query_config_rpc;
 };
 } // namespace replication
 } // namespace dsn
@@ -239,6 +239,8 @@ class prepare_ack;
 
 class learn_state;
 
+class file_meta;
+
 class learn_request;
 
 class learn_response;
@@ -357,8 +359,6 @@ class configuration_query_restore_request;
 
 class configuration_query_restore_response;
 
-class file_meta;
-
 class configuration_update_app_env_request;
 
 class configuration_update_app_env_response;
@@ -1110,6 +1110,64 @@ inline std::ostream &operator<<(std::ostream &out, const learn_state &obj)
     return out;
 }
 
+typedef struct _file_meta__isset
+{
+    _file_meta__isset() : name(false), size(false), md5(false) {}
+    bool name : 1;
+    bool size : 1;
+    bool md5 : 1;
+} _file_meta__isset;
+
+class file_meta
+{
+public:
+    file_meta(const file_meta &);
+    file_meta(file_meta &&);
+    file_meta &operator=(const file_meta &);
+    file_meta &operator=(file_meta &&);
+    file_meta() : name(), size(0), md5() {}
+
+    virtual ~file_meta() throw();
+    std::string name;
+    int64_t size;
+    std::string md5;
+
+    _file_meta__isset __isset;
+
+    void __set_name(const std::string &val);
+
+    void __set_size(const int64_t val);
+
+    void __set_md5(const std::string &val);
+
+    bool operator==(const file_meta &rhs) const
+    {
+        if (!(name == rhs.name))
+            return false;
+        if (!(size == rhs.size))
+            return false;
+        if (!(md5 == rhs.md5))
+            return false;
+        return true;
+    }
+    bool operator!=(const file_meta &rhs) const { return !(*this == rhs); }
+
+    bool operator<(const file_meta &) const;
+
+    uint32_t read(::apache::thrift::protocol::TProtocol *iprot);
+    uint32_t write(::apache::thrift::protocol::TProtocol *oprot) const;
+
+    virtual void printTo(std::ostream &out) const;
+};
+
+void swap(file_meta &a, file_meta &b);
+
+inline std::ostream &operator<<(std::ostream &out, const file_meta &obj)
+{
+    obj.printTo(out);
+    return out;
+}
+
 typedef struct _learn_request__isset
 {
     _learn_request__isset()
@@ -1119,7 +1177,8 @@ typedef struct _learn_request__isset
           last_committed_decree_in_app(false),
           last_committed_decree_in_prepare_list(false),
           app_specific_learn_request(false),
-          max_gced_decree(false)
+          max_gced_decree(false),
+          local_files(false)
     {
     }
     bool pid : 1;
@@ -1129,6 +1188,7 @@ typedef struct _learn_request__isset
     bool last_committed_decree_in_prepare_list : 1;
     bool app_specific_learn_request : 1;
     bool max_gced_decree : 1;
+    bool local_files : 1;
 } _learn_request__isset;
 
 class learn_request
@@ -1154,6 +1214,7 @@ public:
     int64_t last_committed_decree_in_prepare_list;
     ::dsn::blob app_specific_learn_request;
     int64_t max_gced_decree;
+    std::vector<file_meta> local_files;
 
     _learn_request__isset __isset;
 
@@ -1171,6 +1232,8 @@ public:
 
     void __set_max_gced_decree(const int64_t val);
 
+    void __set_local_files(const std::vector<file_meta> &val);
+
     bool operator==(const learn_request &rhs) const
     {
         if (!(pid == rhs.pid))
@@ -1189,6 +1252,10 @@ public:
             return false;
         else if (__isset.max_gced_decree && !(max_gced_decree == rhs.max_gced_decree))
             return false;
+        if (__isset.local_files != rhs.__isset.local_files)
+            return false;
+        else if (__isset.local_files && !(local_files == rhs.local_files))
+            return false;
         return true;
     }
     bool operator!=(const learn_request &rhs) const { return !(*this == rhs); }
@@ -1219,7 +1286,9 @@ typedef struct _learn_response__isset
           type(true),
           state(false),
           address(false),
-          base_local_dir(false)
+          base_local_dir(false),
+          reused_files(false),
+          replica_count(false)
     {
     }
     bool err : 1;
@@ -1230,6 +1299,8 @@ typedef struct _learn_response__isset
     bool state : 1;
     bool address : 1;
     bool base_local_dir : 1;
+    bool reused_files : 1;
+    bool replica_count : 1;
 } _learn_response__isset;
 
 class learn_response
@@ -1243,7 +1314,8 @@ public:
         : last_committed_decree(0),
           prepare_start_decree(0),
           type((learn_type::type)0),
-          base_local_dir()
+          base_local_dir(),
+          replica_count(0)
     {
         type = (learn_type::type)0;
     }
@@ -1257,6 +1329,8 @@ public:
     learn_state state;
     ::dsn::rpc_address address;
     std::string base_local_dir;
+    std::vector<file_meta> reused_files;
+    int32_t replica_count;
 
     _learn_response__isset __isset;
 
@@ -1276,6 +1350,10 @@ public:
 
     void __set_base_local_dir(const std::string &val);
 
+    void __set_reused_files(const std::vector<file_meta> &val);
+
+    void __set_replica_count(const int32_t val);
+
     bool operator==(const learn_response &rhs) const
     {
         if (!(err == rhs.err))
@@ -1294,6 +1372,14 @@ public:
             return false;
         if (!(base_local_dir == rhs.base_local_dir))
             return false;
+        if (__isset.reused_files != rhs.__isset.reused_files)
+            return false;
+        else if (__isset.reused_files && !(reused_files == rhs.reused_files))
+            return false;
+        if (__isset.replica_count != rhs.__isset.replica_count)
+            return false;
+        else if (__isset.replica_count && !(replica_count == rhs.replica_count))
+            return false;
         return true;
     }
     bool operator!=(const learn_response &rhs) const { return !(*this == rhs); }
@@ -1789,12 +1875,21 @@ inline std::ostream &operator<<(std::ostream &out, const replica_server_info &ob
 
 typedef struct _configuration_query_by_node_request__isset
 {
-    _configuration_query_by_node_request__isset() : node(false), stored_replicas(false), info(false)
+    _configuration_query_by_node_request__isset()
+        : node(false),
+          stored_replicas(false),
+          info(false),
+          sync_version(false),
+          base_version(false),
+          removed_replicas(false)
     {
     }
     bool node : 1;
     bool stored_replicas : 1;
     bool info : 1;
+    bool sync_version : 1;
+    bool base_version : 1;
+    bool removed_replicas : 1;
 } _configuration_query_by_node_request__isset;
 
 class configuration_query_by_node_request
@@ -1804,12 +1899,15 @@ public:
     configuration_query_by_node_request(configuration_query_by_node_request &&);
     configuration_query_by_node_request &operator=(const configuration_query_by_node_request &);
     configuration_query_by_node_request &operator=(configuration_query_by_node_request &&);
-    configuration_query_by_node_request() {}
+    configuration_query_by_node_request() : sync_version(0), base_version(0) {}
 
     virtual ~configuration_query_by_node_request() throw();
     ::dsn::rpc_address node;
     std::vector<replica_info> stored_replicas;
     replica_server_info info;
+    int64_t sync_version;
+    int64_t base_version;
+    std::vector<::dsn::gpid> removed_replicas;
 
     _configuration_query_by_node_request__isset __isset;
 
@@ -1819,6 +1917,12 @@ public:
 
     void __set_info(const replica_server_info &val);
 
+    void __set_sync_version(const int64_t val);
+
+    void __set_base_version(const int64_t val);
+
+    void __set_removed_replicas(const std::vector<::dsn::gpid> &val);
+
     bool operator==(const configuration_query_by_node_request &rhs) const
     {
         if (!(node == rhs.node))
@@ -1831,6 +1935,18 @@ public:
             return false;
         else if (__isset.info && !(info == rhs.info))
             return false;
+        if (__isset.sync_version != rhs.__isset.sync_version)
+            return false;
+        else if (__isset.sync_version && !(sync_version == rhs.sync_version))
+            return false;
+        if (__isset.base_version != rhs.__isset.base_version)
+            return false;
+        else if (__isset.base_version && !(base_version == rhs.base_version))
+            return false;
+        if (__isset.removed_replicas != rhs.__isset.removed_replicas)
+            return false;
+        else if (__isset.removed_replicas && !(removed_replicas == rhs.removed_replicas))
+            return false;
         return true;
     }
     bool operator!=(const configuration_query_by_node_request &rhs) const
@@ -1857,12 +1973,13 @@ inline std::ostream &operator<<(std::ostream &out, const configuration_query_by_
 typedef struct _configuration_query_by_node_response__isset
 {
     _configuration_query_by_node_response__isset()
-        : err(false), partitions(false), gc_replicas(false)
+        : err(false), partitions(false), gc_replicas(false), acked_sync_version(false)
     {
     }
     bool err : 1;
     bool partitions : 1;
     bool gc_replicas : 1;
+    bool acked_sync_version : 1;
 } _configuration_query_by_node_response__isset;
 
 class configuration_query_by_node_response
@@ -1872,12 +1989,13 @@ public:
     configuration_query_by_node_response(configuration_query_by_node_response &&);
     configuration_query_by_node_response &operator=(const configuration_query_by_node_response &);
     configuration_query_by_node_response &operator=(configuration_query_by_node_response &&);
-    configuration_query_by_node_response() {}
+    configuration_query_by_node_response() : acked_sync_version(0) {}
 
     virtual ~configuration_query_by_node_response() throw();
     ::dsn::error_code err;
     std::vector<configuration_update_request> partitions;
     std::vector<replica_info> gc_replicas;
+    int64_t acked_sync_version;
 
     _configuration_query_by_node_response__isset __isset;
 
@@ -1887,6 +2005,8 @@ public:
 
     void __set_gc_replicas(const std::vector<replica_info> &val);
 
+    void __set_acked_sync_version(const int64_t val);
+
     bool operator==(const configuration_query_by_node_response &rhs) const
     {
         if (!(err == rhs.err))
@@ -1897,6 +2017,10 @@ public:
             return false;
         else if (__isset.gc_replicas && !(gc_replicas == rhs.gc_replicas))
             return false;
+        if (__isset.acked_sync_version != rhs.__isset.acked_sync_version)
+            return false;
+        else if (__isset.acked_sync_version && !(acked_sync_version == rhs.acked_sync_version))
+            return false;
         return true;
     }
     bool operator!=(const configuration_query_by_node_response &rhs) const
@@ -4903,64 +5027,6 @@ inline std::ostream &operator<<(std::ostream &out, const configuration_query_res
     return out;
 }
 
-typedef struct _file_meta__isset
-{
-    _file_meta__isset() : name(false), size(false), md5(false) {}
-    bool name : 1;
-    bool size : 1;
-    bool md5 : 1;
-} _file_meta__isset;
-
-class file_meta
-{
-public:
-    file_meta(const file_meta &);
-    file_meta(file_meta &&);
-    file_meta &operator=(const file_meta &);
-    file_meta &operator=(file_meta &&);
-    file_meta() : name(), size(0), md5() {}
-
-    virtual ~file_meta() throw();
-    std::string name;
-    int64_t size;
-    std::string md5;
-
-    _file_meta__isset __isset;
-
-    void __set_name(const std::string &val);
-
-    void __set_size(const int64_t val);
-
-    void __set_md5(const std::string &val);
-
-    bool operator==(const file_meta &rhs) const
-    {
-        if (!(name == rhs.name))
-            return false;
-        if (!(size == rhs.size))
-            return false;
-        if (!(md5 == rhs.md5))
-            return false;
-        return true;
-    }
-    bool operator!=(const file_meta &rhs) const { return !(*this == rhs); }
-
-    bool operator<(const file_meta &) const;
-
-    uint32_t read(::apache::thrift::protocol::TProtocol *iprot);
-    uint32_t write(::apache::thrift::protocol::TProtocol *oprot) const;
-
-    virtual void printTo(std::ostream &out) const;
-};
-
-void swap(file_meta &a, file_meta &b);
-
-inline std::ostream &operator<<(std::ostream &out, const file_meta &obj)
-{
-    obj.printTo(out);
-    return out;
-}
-
 typedef struct _configuration_update_app_env_request__isset
 {
     _configuration_update_app_env_request__isset()
@@ -0,0 +1,85 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace dsn {
+
+// histogram_snapshot is a copy of the bucket counts of a log_linear_histogram.
+// Snapshots of the same bucket layout can be merged (e.g. from different counters) or
+// subtracted (e.g. the increment of a histogram during a time window), and are then
+// queried for any quantile.
+class histogram_snapshot
+{
+public:
+    histogram_snapshot() : _count(0), _sum(0) {}
+
+    void clear();
+    void merge(const histogram_snapshot &other);
+    // `base` must be an earlier snapshot of the same histogram
+    void subtract(const histogram_snapshot &base);
+
+    // the value at `quantile` in [0.0, 1.0], with a relative error of no more than 1/32,
+    // return 0 if nothing is recorded
+    int64_t quantile(double quantile) const;
+
+    uint64_t count() const { return _count; }
+    int64_t sum() const { return _sum; }
+    double mean() const { return _count == 0 ? 0.0 : static_cast<double>(_sum) / _count; }
+
+private:
+    friend class log_linear_histogram;
+
+    // empty if nothing is recorded, to keep idle snapshots small
+    std::vector<uint64_t> _buckets;
+    uint64_t _count;
+    int64_t _sum;
+};
+
+// log_linear_histogram records non-negative int64 values into buckets whose width grows
+// like power of two, with 32 linear sub-buckets in each power of two (similar to HDR
+// histogram with about 1.5 significant digits). Values larger than 2^48 are clamped.
+//
+// record() is lock-free and wait-free: the buckets are sharded by thread id, and a shard
+// is allocated on the first value recorded to it.
+class log_linear_histogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 5;
+    static const int MAX_VALUE_BITS = 48;
+    static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const int BUCKET_COUNT = (MAX_VALUE_BITS + 1 - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT;
+    static const int SHARD_COUNT = 8;
+
+    log_linear_histogram();
+    ~log_linear_histogram();
+
+    log_linear_histogram(const log_linear_histogram &) = delete;
+    log_linear_histogram &operator=(const log_linear_histogram &) = delete;
+
+    void record(int64_t value);
+
+    void take_snapshot(/*out*/ histogram_snapshot &snapshot) const;
+
+    static int bucket_index(int64_t value);
+    // a representative value of all the values falling into bucket `index`
+    static int64_t bucket_value(int index);
+
+private:
+    struct shard
+    {
+        std::atomic<uint64_t> buckets[BUCKET_COUNT];
+        std::atomic<int64_t> sum;
+    };
+
+    shard *get_shard();
+
+    std::atomic<shard *> _shards[SHARD_COUNT];
+};
+
+} // namespace dsn
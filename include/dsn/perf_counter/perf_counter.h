@@ -29,6 +29,7 @@
 #include <dsn/utility/enum_helper.h>
 #include <dsn/utility/autoref_ptr.h>
 #include <dsn/utility/dlib.h>
+#include <dsn/perf_counter/histogram.h>
 #include <memory>
 #include <sstream>
 #include <vector>
@@ -38,6 +39,7 @@ typedef enum dsn_perf_counter_type_t {
     COUNTER_TYPE_VOLATILE_NUMBER, // special kind of NUMBER which will be reset on get
     COUNTER_TYPE_RATE,
     COUNTER_TYPE_NUMBER_PERCENTILES,
+    COUNTER_TYPE_HISTOGRAM, // percentiles computed from a histogram of all the samples
     COUNTER_TYPE_COUNT,
     COUNTER_TYPE_INVALID
 } dsn_perf_counter_type_t;
@@ -84,6 +86,12 @@ public:
     virtual int64_t get_integer_value() = 0;
     virtual double get_percentile(dsn_perf_counter_percentile_type_t type) = 0;
 
+    // return the value at `quantile` in [0.0, 1.0], only valid for COUNTER_TYPE_HISTOGRAM
+    virtual double get_quantile(double quantile) { return 0.0; }
+
+    // return false if the counter is not COUNTER_TYPE_HISTOGRAM
+    virtual bool get_histogram_snapshot(/*out*/ histogram_snapshot &snapshot) { return false; }
+
     typedef std::vector<std::pair<int64_t *, int>> samples_t;
 
     // return actual sample count, must <= required_sample_count
@@ -29,6 +29,7 @@
 #include <dsn/utility/singleton.h>
 #include <dsn/utility/synchronize.h>
 #include <dsn/perf_counter/perf_counter.h>
+#include <atomic>
 #include <map>
 #include <sstream>
 #include <queue>
@@ -74,6 +75,13 @@ public:
 
     perf_counter_ptr get_counter(const std::string &full_name);
 
+    ///
+    /// register a counter implemented by the caller, e.g. one computing its value from other
+    /// sources when it's read, or return the registered one with the same name, please call
+    /// remove_counter as well
+    ///
+    perf_counter_ptr add_counter(const perf_counter_ptr &counter);
+
     struct counter_snapshot
     {
         double value{0.0};
@@ -82,7 +90,8 @@ public:
 
     private:
         friend class perf_counters;
-        bool updated_recently{false};
+        // the snapshot version since which the value is unchanged
+        uint64_t changed_version{0};
     };
 
     ///
@@ -100,7 +109,9 @@ public:
     /// then you can iterate all counters or query some specific counters.
     /// if another take_snapshot is called, the old one will be overwrite.
     ///
-    /// the snapshot will be protected by a read-write lock internally.
+    /// the snapshot will be protected by a read-write lock internally. take_snapshot refreshes
+    /// the values of the counters in place and only rebuilds the shards whose counters were
+    /// added or removed since the last snapshot, so the lock is held shortly.
     ///
     /// when you read the snapshot, you should provide a callback called "snapshot_visitor".
     /// this callback will be called once for each requested counter.
@@ -112,6 +123,20 @@ public:
     void take_snapshot();
     void iterate_snapshot(const snapshot_iterator &v) const;
 
+    // call `v` once with all the counters in the snapshot, the pointers are valid until `v`
+    // returns, during which the snapshot can't be updated
+    typedef std::function<void(const std::vector<const counter_snapshot *> &)> snapshot_visitor;
+    void visit_snapshot(const snapshot_visitor &v) const;
+
+    // the version is increased each time take_snapshot is called
+    uint64_t snapshot_version() const { return _snapshot_version.load(); }
+
+    // call `v` with the counters whose values changed, or which were created, in the snapshots
+    // after `since_version`, so that a pusher only sends the changed counters; pass the
+    // snapshot_version() of the last push, or 0 to visit all the counters. Removed counters are
+    // not reported.
+    void iterate_changed_snapshot(uint64_t since_version, const snapshot_iterator &v) const;
+
     // if found is not nullptr, then whether a counter was found will be stored in it
     // that is to say:
     //    if (found != nullptr && (*found)[i]==true) {
@@ -141,11 +166,8 @@ private:
                               dsn_perf_counter_type_t type,
                               const char *dsptr);
 
-    void get_all_counters(std::vector<perf_counter_ptr> *all) const;
-
-    mutable utils::rw_lock_nr _lock;
     // keep counter as a refptr to make the counter can be safely accessed
-    // by get_all_counters and remove_counter concurrently
+    // by take_snapshot and remove_counter concurrently
     //
     // keep an user reference for each counter coz the counter may be shared by different modules
     // called get_xxx_counter
@@ -154,13 +176,45 @@ private:
         perf_counter_ptr counter;
         int user_reference;
     };
-    std::unordered_map<std::string, counter_object> _counters;
 
+    // the counters are sharded by the hash of the full name, so that creating or removing a
+    // counter, e.g. on opening a replica, only contends with the counters of the same shard
+    static const int SHARD_COUNT = 16;
+    struct counter_shard
+    {
+        mutable utils::rw_lock_nr lock;
+        std::unordered_map<std::string, counter_object> counters;
+        // increased each time a counter is added into or removed from the shard
+        uint64_t generation{0};
+    };
+
+    // the snapshot entries of a counter shard with their names interned, which are rebuilt only
+    // if the generation of the counter shard changes
+    struct snapshot_shard
+    {
+        uint64_t generation{0};
+        bool built{false};
+        std::vector<counter_snapshot> entries;
+        std::unordered_map<std::string, size_t> index;
+
+        // the source of each entry, only accessed by take_snapshot
+        std::vector<std::pair<perf_counter_ptr, dsn_perf_counter_percentile_type_t>> sources;
+    };
+
+    static int shard_of(const std::string &full_name);
+    static void read_values(const snapshot_shard &ss, /*out*/ std::vector<double> &values);
+    const counter_snapshot *find_snapshot(const std::string &name) const;
+
+    counter_shard _shards[SHARD_COUNT];
+
+    // serialize take_snapshot, under which the sources of the snapshot shards are accessed
+    utils::ex_lock_nr _take_snapshot_lock;
     mutable utils::rw_lock_nr _snapshot_lock;
-    std::unordered_map<std::string, counter_snapshot> _snapshots;
+    snapshot_shard _snapshots[SHARD_COUNT];
 
     // timestamp in seconds when take snapshot of current counters
     int64_t _timestamp;
+    std::atomic<uint64_t> _snapshot_version{0};
 };
 
 } // namespace dsn
@@ -36,6 +36,9 @@
 
 #pragma once
 
+#include <atomic>
+
+#include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/tool-api/task_queue.h>
 #include <dsn/utility/utils.h>
 
@@ -54,12 +57,53 @@ public:
 
     virtual bool is_task_accepted(task *task) = 0;
 
+    // called by the worker for each task dequeued from the bound queue, with the time the task
+    // has waited in the queue. Only the tasks of TASK_TYPE_RPC_REQUEST can be rejected, which
+    // are replied with ERR_BUSY instead of executed.
+    virtual bool is_dequeued_task_accepted(task *task, uint64_t sojourn_ns, uint64_t now_ns)
+    {
+        return true;
+    }
+
     task_queue *bound_queue() const { return _queue; }
 
 private:
     task_queue *_queue;
 };
 
+///
+/// codel_admission_controller sheds the client requests by the queue delay rather than the
+/// queue length, in the way of CoDel (controlled delay):
+///   - the queue is considered overloaded if no task dequeued in the last `interval_ms` has
+///     waited less than `target_ms`;
+///   - when overloaded, the storage rpc requests (registered by register_storage_task_code)
+///     which have waited longer than `target_ms` are rejected, otherwise only those which have
+///     waited longer than `interval_ms` are rejected.
+/// The other tasks, such as the internal replication rpcs, are never rejected.
+///
+/// arguments: [target_ms = 5] [interval_ms = 100]
+///
+class codel_admission_controller : public admission_controller
+{
+public:
+    codel_admission_controller(task_queue *q, std::vector<std::string> &sargs);
+
+    bool is_task_accepted(task *task) override { return true; }
+    bool is_dequeued_task_accepted(task *task, uint64_t sojourn_ns, uint64_t now_ns) override;
+
+    bool is_overloaded(uint64_t now_ns) const
+    {
+        return now_ns > _last_below_target_ns.load(std::memory_order_relaxed) + _interval_ns;
+    }
+
+private:
+    uint64_t _target_ns;
+    uint64_t _interval_ns;
+    // the last time a task was dequeued with a sojourn time below the target
+    std::atomic<uint64_t> _last_below_target_ns;
+    perf_counter_wrapper _shed_count;
+};
+
 // ----------------- inline implementation -----------------
 template <typename T>
 admission_controller *admission_controller::create(task_queue *q, const char *args)
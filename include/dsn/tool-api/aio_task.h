@@ -55,12 +55,18 @@ public:
     std::vector<dsn_file_buffer_t> *write_buffer_vec; // only used if support_write_vec is true
     uint32_t buffer_size;
     uint64_t file_offset;
+    bool sync_after_write; // if the written data should be persisted before the write completes
 
     // filled by frameworks
     aio_type type;
     disk_engine *engine;
     void *file_object; // TODO(wutao1): make it disk_file*, and distinguish it from `file`
 
+    // the stages of the write in nanoseconds, filled by frameworks for tracing
+    uint64_t issue_time_ns;    // issued to the disk_engine
+    uint64_t submit_time_ns;   // submitted to the aio provider, after queueing in the disk_engine
+    uint64_t complete_time_ns; // completed by the aio provider
+
     aio_context()
         : file(nullptr),
           buffer(nullptr),
@@ -68,9 +74,13 @@ public:
           write_buffer_vec(nullptr),
           buffer_size(0),
           file_offset(0),
+          sync_after_write(false),
           type(AIO_Invalid),
           engine(nullptr),
-          file_object(nullptr)
+          file_object(nullptr),
+          issue_time_ns(0),
+          submit_time_ns(0),
+          complete_time_ns(0)
     {
     }
 };
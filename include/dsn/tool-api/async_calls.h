@@ -61,7 +61,9 @@ create_task(task_code code, task_tracker *tracker, task_handler &&callback, int
 {
     task_ptr t(new raw_task(code, std::move(callback), hash, nullptr));
     t->set_tracker(tracker);
-    t->spec().on_task_create.execute(task::get_current_task(), t);
+    if (t->spec().has_hook(TASK_HOOK_CREATE)) {
+        t->spec().on_task_create.execute(task::get_current_task(), t);
+    }
     return t;
 }
 
@@ -73,7 +75,9 @@ inline task_ptr create_timer_task(task_code code,
 {
     task_ptr t(new timer_task(code, std::move(callback), interval.count(), hash, nullptr));
     t->set_tracker(tracker);
-    t->spec().on_task_create.execute(task::get_current_task(), t);
+    if (t->spec().has_hook(TASK_HOOK_CREATE)) {
+        t->spec().on_task_create.execute(task::get_current_task(), t);
+    }
     return t;
 }
 
@@ -113,7 +117,9 @@ inline rpc_response_task_ptr create_rpc_response_task(dsn::message_ex *req,
     rpc_response_task_ptr t(
         new rpc_response_task((message_ex *)req, std::move(callback), reply_thread_hash, nullptr));
     t->set_tracker(tracker);
-    t->spec().on_task_create.execute(task::get_current_task(), t);
+    if (t->spec().has_hook(TASK_HOOK_CREATE)) {
+        t->spec().on_task_create.execute(task::get_current_task(), t);
+    }
     return t;
 }
 
@@ -51,12 +51,18 @@ extern error_code close(disk_file *file);
 /// flush the buffer of the given file
 extern error_code flush(disk_file *file);
 
+/// the native file descriptor of the given file, e.g. to hint the kernel with posix_fadvise,
+/// -1 if the file is null
+extern int native_fd(disk_file *file);
+
 inline aio_task_ptr
 create_aio_task(task_code code, task_tracker *tracker, aio_handler &&callback, int hash = 0)
 {
     aio_task_ptr t(new aio_task(code, std::move(callback), hash));
     t->set_tracker((task_tracker *)tracker);
-    t->spec().on_task_create.execute(task::get_current_task(), t);
+    if (t->spec().has_hook(TASK_HOOK_CREATE)) {
+        t->spec().on_task_create.execute(task::get_current_task(), t);
+    }
     return t;
 }
 
@@ -78,6 +84,8 @@ extern aio_task_ptr write(disk_file *file,
                           aio_handler &&callback,
                           int hash = 0);
 
+/// \param sync_after_write whether to persist the data before the write completes,
+///                         which may be cheaper than flush() after the write
 extern aio_task_ptr write_vector(disk_file *file,
                                  const dsn_file_buffer_t *buffers,
                                  int buffer_count,
@@ -85,9 +93,24 @@ extern aio_task_ptr write_vector(disk_file *file,
                                  task_code callback_code,
                                  task_tracker *tracker,
                                  aio_handler &&callback,
-                                 int hash = 0);
+                                 int hash = 0,
+                                 bool sync_after_write = false);
 
 extern aio_context_ptr prepare_aio_context(aio_task *tsk);
 
+/// count the latencies of the aios on the files opened under `dir` for the disk `tag`, and
+/// serve them by an aio context of their own if [core] aio_per_disk_enabled, see
+/// disk_engine::register_disk()
+extern void register_disk(const std::string &tag, const std::string &dir);
+
+/// the latencies of the aios are counted in buckets, where bucket i holds those in
+/// [2^i, 2^(i+1)) microseconds, and bucket 0 also holds those under 1 microsecond
+const int AIO_LATENCY_BUCKET_COUNT = 32;
+
+/// the counts of the aios completed on the disk `tag` in each latency bucket since the disk is
+/// registered, return false if the disk isn't registered
+extern bool get_disk_aio_latency_counts(const std::string &tag,
+                                        /*out*/ std::vector<uint64_t> &counts);
+
 } // namespace file
 } // namespace dsn
@@ -71,6 +71,9 @@ public:
 
     int thread_hash() const { return _value.u.app_id * 7919 + _value.u.partition_index; }
 
+    // the app id of a thread_hash(), as long as the partition index is less than 7919
+    static int32_t app_id_of_thread_hash(int hash) { return hash / 7919; }
+
     friend std::ostream &operator<<(std::ostream &os, gpid id)
     {
         return os << std::string(id.to_string());
@@ -36,6 +36,7 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <dsn/c/api_utilities.h>
 #include <dsn/c/api_layer1.h>
 #include <dsn/utility/synchronize.h>
@@ -70,10 +71,12 @@ public:
                                 : _members[rand::next_u32(0, (uint32_t)_members.size() - 1)];
     }
     rpc_address next(rpc_address current) const;
+    // lock-free, as it's read on each rpc to the group
     rpc_address leader() const
     {
-        alr_t l(_lock);
-        return _leader_index >= 0 ? _members[_leader_index] : rpc_address::s_invalid_address;
+        rpc_address addr;
+        addr.value() = _leader.load(std::memory_order_acquire);
+        return addr;
     }
     void leader_forward();
     rpc_address possible_leader();
@@ -86,9 +89,18 @@ private:
     typedef ::dsn::utils::auto_read_lock alr_t;
     typedef ::dsn::utils::auto_write_lock alw_t;
 
+    // must be called with the write lock held whenever _leader_index or _members changes
+    void update_leader()
+    {
+        _leader.store(_leader_index >= 0 ? _members[_leader_index].value() : 0,
+                      std::memory_order_release);
+    }
+
     mutable ::dsn::utils::rw_lock_nr _lock;
     members_t _members;
     int _leader_index;
+    // the value of _members[_leader_index], or 0 (the invalid address) if there is no leader
+    std::atomic<uint64_t> _leader{0};
     bool _update_leader_automatically;
     std::string _name;
 };
@@ -108,6 +120,7 @@ inline rpc_group_address::rpc_group_address(const rpc_group_address &other)
     _leader_index = other._leader_index;
     _update_leader_automatically = other._update_leader_automatically;
     _members = other._members;
+    update_leader();
 }
 
 inline rpc_group_address &rpc_group_address::operator=(const rpc_group_address &other)
@@ -116,6 +129,7 @@ inline rpc_group_address &rpc_group_address::operator=(const rpc_group_address &
     _leader_index = other._leader_index;
     _update_leader_automatically = other._update_leader_automatically;
     _members = other._members;
+    update_leader();
     return *this;
 }
 
@@ -138,6 +152,7 @@ inline void rpc_group_address::leader_forward()
     if (_members.empty())
         return;
     _leader_index = (_leader_index + 1) % _members.size();
+    update_leader();
 }
 
 inline void rpc_group_address::set_leader(rpc_address addr)
@@ -150,6 +165,7 @@ inline void rpc_group_address::set_leader(rpc_address addr)
         for (int i = 0; i < (int)_members.size(); i++) {
             if (_members[i] == addr) {
                 _leader_index = i;
+                update_leader();
                 return;
             }
         }
@@ -157,15 +173,23 @@ inline void rpc_group_address::set_leader(rpc_address addr)
         _members.push_back(addr);
         _leader_index = (int)(_members.size() - 1);
     }
+    update_leader();
 }
 
 inline rpc_address rpc_group_address::possible_leader()
 {
-    alr_t l(_lock);
+    rpc_address addr = leader();
+    if (!addr.is_invalid()) {
+        return addr;
+    }
+
+    alw_t l(_lock);
     if (_members.empty())
         return rpc_address::s_invalid_address;
-    if (_leader_index == -1)
+    if (_leader_index == -1) {
         _leader_index = rand::next_u32(0, (uint32_t)_members.size() - 1);
+        update_leader();
+    }
     return _members[_leader_index];
 }
 
@@ -175,10 +199,14 @@ inline bool rpc_group_address::remove(rpc_address addr)
     auto it = std::find(_members.begin(), _members.end(), addr);
     bool r = (it != _members.end());
     if (r) {
-        if (-1 != _leader_index && addr == _members[_leader_index])
+        int index = (int)(it - _members.begin());
+        if (index == _leader_index)
             _leader_index = -1;
+        else if (index < _leader_index)
+            _leader_index--;
 
         _members.erase(it);
+        update_leader();
     }
     return r;
 }
@@ -9,6 +9,14 @@
 #include <dsn/cpp/serverlet.h>
 #include <dsn/utility/errors.h>
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
 namespace dsn {
 
 enum http_method
@@ -28,11 +36,14 @@ struct http_request
     blob body;
     blob full_url;
     http_method method;
+    // the value of If-None-Match, empty if the request hasn't it
+    std::string if_none_match;
 };
 
 enum class http_status_code
 {
     ok,                    // 200
+    not_modified,          // 304
     temporary_redirect,    // 307
     bad_request,           // 400
     not_found,             // 404
@@ -44,13 +55,106 @@ extern std::string http_status_code_to_string(http_status_code code);
 struct http_response
 {
     std::string body;
+    // if not empty, the response is sent with "Transfer-Encoding: chunked", `body` (if not
+    // empty) being the first chunk and these the following ones. they are attached to the
+    // response message without copying, see http_body_stream.
+    std::vector<blob> body_chunks;
     http_status_code status_code{http_status_code::ok};
     std::string content_type = "text/plain";
     std::string location;
+    // sent as ETag if not empty
+    std::string etag;
+
+    // `body` followed by `body_chunks`
+    std::string full_body() const;
 
     message_ptr to_message(message_ex *req) const;
 };
 
+// http_body_stream is an std::ostream writing into `resp.body_chunks` in chunks of at most
+// `chunk_bytes`, so that a large response is neither built into one std::string nor copied
+// into the response message:
+//
+//   http_body_stream out(resp);
+//   tp.output(out, dsn::utils::table_printer::output_format::kJsonCompact);
+//
+// the last chunk is written when the stream is destroyed, flushing (e.g. by std::endl) doesn't
+// cut a chunk.
+class http_body_stream : public std::ostream
+{
+public:
+    explicit http_body_stream(http_response &resp, size_t chunk_bytes = 64 * 1024);
+    ~http_body_stream() override;
+
+private:
+    class chunk_buf : public std::streambuf
+    {
+    public:
+        chunk_buf(std::vector<blob> &chunks, size_t chunk_bytes);
+
+        // move the written data into a chunk
+        void write_chunk();
+
+    protected:
+        int_type overflow(int_type c) override;
+
+    private:
+        std::vector<blob> &_chunks;
+        size_t _chunk_bytes;
+        std::shared_ptr<char> _buffer;
+    };
+
+    chunk_buf _buf;
+};
+
+// http_response_cache caches the responses of a handler which are built from a state with a
+// version, e.g. the apps of the meta server, so that the monitoring systems polling the server
+// don't rebuild the same response for each request under the lock of the state. a response is
+// cached for each set of the query args, and it's rebuilt by the first request after the version
+// changes, while the others of the same query are still replied with the previous one. the
+// responses are sent with an ETag of their bodies, so a request with the same If-None-Match is
+// replied 304 Not Modified without the body.
+//
+// only the responses of 200 OK are cached.
+class http_response_cache
+{
+public:
+    typedef std::function<void(const http_request &req, http_response &resp)> http_callback;
+    // returns the version of the state, or a negative value if the responses can't be cached
+    // right now, e.g. they should be redirected to another server
+    typedef std::function<int64_t()> version_getter;
+
+    http_response_cache(version_getter version, http_callback cb)
+        : _version(std::move(version)), _cb(std::move(cb))
+    {
+    }
+
+    void call(const http_request &req, http_response &resp);
+
+private:
+    struct entry
+    {
+        int64_t version{-1};
+        std::string content_type;
+        blob body;
+        // empty if no response is built yet
+        std::string etag;
+        bool building{false};
+    };
+
+    static void reply(const http_request &req, const entry &e, http_response &resp);
+
+    // the queries beyond are never cached, as the query args come from the clients
+    static const size_t MAX_CACHED_QUERIES = 1024;
+
+    const version_getter _version;
+    const http_callback _cb;
+
+    std::mutex _lock;
+    // the query args in order -> the cached response
+    std::map<std::string, entry> _entries;
+};
+
 class http_service
 {
 public:
@@ -65,6 +169,20 @@ public:
         _cb_map.emplace(std::move(path), std::make_pair(std::move(cb), std::move(help)));
     }
 
+    // `cb` is called through an http_response_cache by `version`
+    void register_cached_handler(std::string path,
+                                 http_response_cache::version_getter version,
+                                 http_callback cb,
+                                 std::string help)
+    {
+        auto cache = std::make_shared<http_response_cache>(std::move(version), std::move(cb));
+        register_handler(std::move(path),
+                         [cache](const http_request &req, http_response &resp) {
+                             cache->call(req, resp);
+                         },
+                         std::move(help));
+    }
+
     void call(const http_request &req, http_response &resp)
     {
         auto it = _cb_map.find(req.service_method.second);
@@ -36,13 +36,28 @@
 #pragma once
 
 #include <dsn/service_api_c.h>
+#include <functional>
+#include <memory>
 #include <stdarg.h>
+#include <string>
 
 namespace dsn {
 /*!
 @addtogroup tool-api-providers
 @{
 */
+
+// a log message of which the arguments are captured by the logging thread, and formatted
+// only when the logger writes it out, see dlog_f in <dsn/dist/fmt_logging.h>
+class deferred_log_message
+{
+public:
+    virtual ~deferred_log_message() = default;
+
+    // append the formatted message to `out`, never throws
+    virtual void format_to(std::string &out) const = 0;
+};
+
 class logging_provider
 {
 public:
@@ -78,6 +93,13 @@ public:
                          dsn_log_level_t log_level,
                          const char *str) = 0;
 
+    // the default implementation formats `msg` on the calling thread
+    virtual void dsn_log_deferred(const char *file,
+                                  const char *function,
+                                  const int line,
+                                  dsn_log_level_t log_level,
+                                  std::unique_ptr<deferred_log_message> msg);
+
     virtual void flush() = 0;
 
 private:
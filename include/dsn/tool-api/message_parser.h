@@ -44,18 +44,29 @@ class message_reader
 {
 public:
     explicit message_reader(int buffer_block_size)
-        : _buffer_occupied(0), _buffer_block_size(buffer_block_size)
+        : _buffer_occupied(0),
+          _buffer_block_size(buffer_block_size),
+          _next_block_size(buffer_block_size),
+          _max_read_length(0)
     {
     }
 
-    // called before read to extend read buffer
+    // called before read to extend read buffer.
+    // the parsers know the length of the message once its header is read, then `read_next` is the
+    // rest of the message, so a message larger than a block is read into one buffer of its size.
     DSN_API char *read_buffer_ptr(unsigned int read_next);
 
     // get remaining buffer capacity
     unsigned int read_buffer_capacity() const { return _buffer.length() - _buffer_occupied; }
 
     // called after read to mark data occupied
-    void mark_read(unsigned int read_length) { _buffer_occupied += read_length; }
+    void mark_read(unsigned int read_length)
+    {
+        if (read_length > _max_read_length) {
+            _max_read_length = read_length;
+        }
+        _buffer_occupied += read_length;
+    }
 
     // discard read data
     void truncate_read() { _buffer_occupied = 0; }
@@ -73,7 +84,17 @@ public:
     // TODO(wutao1): make them private members
     blob _buffer;
     unsigned int _buffer_occupied;
+    // the max size of the blocks for the messages smaller than it
     const unsigned int _buffer_block_size;
+
+private:
+    void adapt_block_size();
+
+    // the blocks are shrunk for the sessions of small reads, so that the small messages don't
+    // hold large blocks, and grown back to _buffer_block_size for the sessions of large reads
+    unsigned int _next_block_size;
+    // of the reads into the current block
+    unsigned int _max_read_length;
 };
 
 class message_parser;
@@ -108,6 +129,10 @@ public:
     // may be invoked for mutiple times if the message is reused for resending.
     virtual void prepare_on_send(message_ex *msg) {}
 
+    // whether the messages sent by this parser carry checksums, which is decided per connection.
+    // a receiver only verifies the checksums carried, so the ends need no more negotiation.
+    virtual void set_checksum_enabled(bool enabled) {}
+
     struct send_buf
     {
         void *buf;
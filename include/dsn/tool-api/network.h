@@ -123,6 +123,7 @@ public:
 
     rpc_engine *engine() const { return _engine; }
     int max_buffer_block_count_per_send() const { return _max_buffer_block_count_per_send; }
+    size_t max_bytes_per_send() const { return _max_bytes_per_send; }
     network_header_format client_hdr_format() const { return _client_hdr_format; }
     network_header_format unknown_msg_hdr_format() const { return _unknown_msg_header_format; }
     int message_buffer_block_size() const { return _message_buffer_block_size; }
@@ -135,6 +136,7 @@ protected:
     network_header_format _unknown_msg_header_format; // default is NET_HDR_INVALID
     int _message_buffer_block_size;
     int _max_buffer_block_count_per_send;
+    size_t _max_bytes_per_send;
     int _send_queue_threshold;
 
 private:
@@ -175,8 +177,20 @@ public:
     virtual rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) = 0;
 
 protected:
-    typedef std::unordered_map<::dsn::rpc_address, rpc_session_ptr> client_sessions;
-    client_sessions _clients; // to_address => rpc_session
+    // the sessions to a server, which are created on demand.
+    //
+    // the requests are spread on the first _cfg_client_sessions_per_server sessions by their
+    // partitions, so that the requests of a partition are always sent in order through the same
+    // session. if _cfg_large_message_bytes > 0, the requests whose bodies are no smaller than
+    // it, e.g. learn and bulk load, are sent through one more dedicated session, so that they
+    // don't block the latency-sensitive ones.
+    typedef std::vector<rpc_session_ptr> client_session_pool;
+
+    // index of the session in the pool through which `request` is sent
+    DSN_API int select_client_session(const message_ex *request) const;
+
+    typedef std::unordered_map<::dsn::rpc_address, client_session_pool> client_sessions;
+    client_sessions _clients; // to_address => rpc_session pool
     utils::rw_lock_nr _clients_lock;
 
     typedef std::unordered_map<::dsn::rpc_address, rpc_session_ptr> server_sessions;
@@ -186,6 +200,8 @@ protected:
     utils::rw_lock_nr _servers_lock;
 
     uint32_t _cfg_conn_threshold_per_ip;
+    uint32_t _cfg_client_sessions_per_server;
+    uint32_t _cfg_large_message_bytes;
 };
 
 /*!
@@ -247,6 +263,8 @@ public:
     // should always be called in lock
     bool unlink_message_for_send();
     virtual void send(uint64_t signature) = 0;
+    // the priority of the send queue of `msg`
+    static dsn_task_priority_t get_send_priority(message_ex *msg);
     void on_send_completed(uint64_t signature = 0);
 
 protected:
@@ -263,11 +281,17 @@ protected:
     volatile session_state _connect_state;
 
     // messages are sent in batch, firstly all messages are linked together
-    // in a doubly-linked list "_messages".
-    // if no messages are on-the-flying, a batch of messages are fetch from the "_messages"
-    // and put them to _sending_msgs; meanwhile, buffers of these messages are put
-    // in _sending_buffers
-    dlink _messages;
+    // in the doubly-linked lists "_messages", one per priority.
+    // if no messages are on-the-flying, a batch of messages are fetch from the "_messages",
+    // higher priority first, and put them to _sending_msgs; meanwhile, buffers of these
+    // messages are put in _sending_buffers, which are sent in one vectored write. A batch
+    // is bounded by max_buffer_block_count_per_send and max_bytes_per_send.
+    //
+    // the priority of a message is the priority of its rpc code, except that the messages
+    // of at least [network] send_queue_bulk_message_bytes are always of the lowest priority,
+    // so that the small messages like beacons and prepare acks are never queued behind the
+    // large ones like learn responses, but only wait for the write on the flying.
+    dlink _messages[TASK_PRIORITY_COUNT];
     int _message_count; // count of _messages
 
     bool _is_sending_next;
@@ -291,11 +315,16 @@ protected:
     void clear_send_queue(bool resend_msgs);
     bool on_disconnected(bool is_write);
 
+    // whether the messages sent on this session carry checksums, which are skipped on the
+    // loopback connections unless [network] rpc_checksum_on_loopback is set
+    bool is_checksum_required();
+
 protected:
     // constant info
     connection_oriented_network &_net;
     dsn::rpc_address _remote_addr;
     int _max_buffer_block_count_per_send;
+    size_t _max_bytes_per_send;
     message_reader _reader;
     message_parser_ptr _parser;
 
@@ -130,6 +130,7 @@ public:
     }
 
     uint64_t &value() { return _addr.value; }
+    uint64_t value() const { return _addr.value; }
 
     dsn_host_type_t type() const { return (dsn_host_type_t)_addr.v4.type; }
 
@@ -215,8 +216,12 @@ struct hash<::dsn::rpc_address>
     size_t operator()(const ::dsn::rpc_address &ep) const
     {
         switch (ep.type()) {
-        case HOST_TYPE_IPV4:
-            return std::hash<uint32_t>()(ep.ip()) ^ std::hash<uint16_t>()(ep.port());
+        case HOST_TYPE_IPV4: {
+            // mix all the bits of the 64-bit value, as the ips of a cluster often differ only in
+            // the low bits, which collide with the ports if they are simply xor-ed
+            uint64_t h = ep.value() * 0x9E3779B97F4A7C15ULL;
+            return static_cast<size_t>(h ^ (h >> 32));
+        }
         case HOST_TYPE_GROUP:
             return std::hash<void *>()(ep.group_address());
         default:
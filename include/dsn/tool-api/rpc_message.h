@@ -46,6 +46,7 @@
 #include <dsn/tool-api/auto_codes.h>
 #include <dsn/tool-api/rpc_address.h>
 #include <dsn/tool-api/global_config.h>
+#include <dsn/tool-api/trace_span.h>
 
 namespace dsn {
 class rpc_session;
@@ -67,11 +68,14 @@ typedef union msg_context
     {
         uint64_t is_request : 1;           ///< whether the RPC message is a request or response
         uint64_t is_forwarded : 1;         ///< whether the msg is forwarded or not
-        uint64_t unused : 4;               ///< not used yet
+        uint64_t is_follower_read : 1;     ///< whether a secondary may serve the read request
+        uint64_t unused : 3;               ///< not used yet
         uint64_t serialize_format : 4;     ///< dsn_msg_serialize_format
         uint64_t is_forward_supported : 1; ///< whether support forwarding a message to real leader
         uint64_t is_backup_request : 1;    ///< whether the RPC is a backup request
-        uint64_t reserved : 52;
+        uint64_t compress_type : 2;        ///< dsn_msg_compress_type accepted for the response
+        uint64_t is_compressed : 1;        ///< whether the body is compressed with compress_type
+        uint64_t reserved : 49;
     } u;
     uint64_t context; ///< msg_context is of sizeof(uint64_t)
 } msg_context_t;
@@ -125,7 +129,7 @@ typedef struct message_header
 
 class message_ex : public ref_counter,
                    public extensible_object<message_ex, 4>,
-                   public transient_object
+                   public pooled_object
 {
 public:
     message_header *header;
@@ -148,6 +152,9 @@ public:
     // by message queuing
     dlink dl;
 
+    // by tracing, the span of a sampled request, which is shared by its response
+    trace_span_ptr span;
+
 public:
     // message_ex(blob bb, bool parse_hdr = true); // read
     DSN_API ~message_ex();
@@ -158,6 +165,10 @@ public:
     DSN_API error_code error();
     DSN_API task_code rpc_code();
     static uint64_t new_id() { return ++_id; }
+    // count and approximate body bytes of the messages alive in this process, the buffers
+    // shared by several messages are counted by each of them
+    static int64_t alive_count() { return s_alive_count.load(std::memory_order_relaxed); }
+    static int64_t alive_bytes() { return s_alive_bytes.load(std::memory_order_relaxed); }
     static unsigned int get_body_length(char *hdr) { return ((message_header *)hdr)->body_length; }
 
     //
@@ -203,6 +214,8 @@ public:
     //
     DSN_API void write_next(void **ptr, size_t *size, size_t min_size);
     DSN_API void write_commit(size_t size);
+    // append `data` to the body without copying, all the pending writes must be committed
+    DSN_API void write_append(const blob &data);
     DSN_API bool read_next(void **ptr, size_t *size);
     bool read_next(blob &data);
     DSN_API void read_commit(size_t size);
@@ -216,14 +229,27 @@ public:
     DSN_API void restore_read();
 
     bool is_backup_request() const { return header->context.u.is_backup_request; }
+    bool is_follower_read() const { return header->context.u.is_follower_read; }
+
+    // the body crc of a large received message is verified by the task handling it rather than
+    // the network thread, return false if the body is corrupted
+    void defer_body_crc_check() { _body_crc_deferred = true; }
+    DSN_API bool verify_body_crc();
 
 private:
     DSN_API message_ex();
     DSN_API void prepare_buffer_header();
     DSN_API void release_buffer_header();
+    void account_bytes(int64_t bytes)
+    {
+        _accounted_bytes += bytes;
+        s_alive_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
 
 private:
     static std::atomic<uint64_t> _id;
+    static std::atomic<int64_t> s_alive_count;
+    static std::atomic<int64_t> s_alive_bytes;
 
 private:
     // by msg read & write
@@ -231,6 +257,8 @@ private:
     int _rw_offset;     // current buffer offset
     bool _rw_committed; // mark if it is in middle state of reading/writing
     bool _is_read;      // is for read(recv) or write(send)
+    int64_t _accounted_bytes{0};
+    bool _body_crc_deferred{false};
 
 public:
     static uint32_t s_local_hash; // used by fast_rpc_name
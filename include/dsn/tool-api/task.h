@@ -68,6 +68,8 @@ struct __tls_dsn__
 {
     uint32_t magic;
     task *current_task;
+    // the code of current_task, which can be read in signal handlers, e.g, by the cpu profiler
+    int current_task_code;
 
     task_worker *worker;
     int worker_index;
@@ -178,7 +180,7 @@ extern __thread struct __tls_dsn__ tls_dsn;
 /// functions for different purposes on these hook points, you may want to refer to
 /// "tracer", "profiler" and "fault_injector" for details.
 ///
-class task : public ref_counter, public extensible_object<task, 4>, public transient_object
+class task : public ref_counter, public extensible_object<task, 4>, public pooled_object
 {
 public:
     task(task_code code, int hash = 0, service_node *node = nullptr);
@@ -235,6 +237,9 @@ public:
     service_node *node() const { return _node; }
     task_tracker *tracker() const { return _context_tracker.tracker(); }
     bool is_empty() const { return _is_null; }
+    // the partition which the cpu time of this task is charged to, see task_cpu_accounting
+    gpid accounting_gpid() const { return _accounting_gpid; }
+    void set_accounting_gpid(gpid pid) { _accounting_gpid = pid; }
 
     // static helper utilities
     static task *get_current_task();
@@ -311,6 +316,10 @@ private:
     int _hash;
     int _delay_milliseconds;
     bool _wait_for_cancel;
+    // the enqueue time of the task sampled by task_latency_sampler, 0 if not sampled
+    uint64_t _sampled_enqueue_ts_ns{0};
+    // inherited from the task creating this one
+    gpid _accounting_gpid;
     task_spec *_spec;
     service_node *_node;
     trackable_task _context_tracker; // when tracker is gone, the task is cancelled automatically
@@ -318,6 +327,8 @@ private:
 public:
     // used by task queue only
     task *next;
+    // the time when the task is enqueued into a queue which has an admission controller
+    uint64_t queue_enqueue_ts_ns{0};
 };
 typedef dsn::ref_ptr<dsn::task> task_ptr;
 
@@ -425,10 +436,32 @@ public:
 
     message_ex *get_request() const { return _request; }
 
+    // add a point to the span of the request if it is sampled
+    void trace(const char *event)
+    {
+        if (_request->span != nullptr) {
+            _request->span->add_point(event);
+        }
+    }
+
     void enqueue() override;
 
+    // reply the request with `err` instead of executing the handler, which must be called
+    // before the task is executed
+    void reject(error_code err);
+
     void exec() override
     {
+        if (_rejected) {
+            return;
+        }
+        if (dsn_unlikely(!_request->verify_body_crc())) {
+            // the client gets a timeout and retries, as if the request is lost
+            derror("rpc_request_task(%s) from(%s) is dropped as its body is corrupted",
+                   spec().name.c_str(),
+                   _request->header->from_address.to_string());
+            return;
+        }
         if (0 == _enqueue_ts_ns ||
             dsn_now_ns() - _enqueue_ts_ns <
                 static_cast<uint64_t>(_request->header->client.timeout_ms) * 1000000ULL) {
@@ -450,6 +483,7 @@ protected:
     message_ex *_request;
     rpc_request_handler _handler;
     uint64_t _enqueue_ts_ns;
+    bool _rejected{false};
 };
 typedef dsn::ref_ptr<rpc_request_task> rpc_request_task_ptr;
 
@@ -474,6 +508,12 @@ public:
 
     void exec() override
     {
+        if (dsn_unlikely(_response != nullptr && !_response->verify_body_crc())) {
+            derror("the response of rpc(%s) from(%s) is corrupted",
+                   spec().name.c_str(),
+                   _response->header->from_address.to_string());
+            set_error_code(ERR_INVALID_DATA);
+        }
         if (dsn_likely(nullptr != _cb)) {
             _cb(_error, _request, _response);
         }
@@ -0,0 +1,82 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dsn/tool-api/gpid.h>
+#include <dsn/utility/singleton.h>
+
+namespace dsn {
+
+///
+/// task_cpu_accounting attributes the cpu time of the executed tasks, measured by
+/// CLOCK_THREAD_CPUTIME_ID around task::exec(), to their task codes and their partitions if
+/// [core] task_cpu_accounting is enabled.
+///
+/// The partition of a task is the gpid in the header of the request for a rpc request task, and
+/// is inherited from the task creating it otherwise, so that the prepares, the aio callbacks and
+/// the timers started in the handlers of a replica are charged to the replica too. The tasks
+/// without any partition are charged to gpid(0, 0).
+///
+/// The usages are accumulated since the start of the process into the stats of the executing
+/// thread, which are merged on read by the remote command "task-cpu" and the http service
+/// "ip:port/taskCpu".
+///
+class task_cpu_accounting : public utils::singleton<task_cpu_accounting>
+{
+public:
+    task_cpu_accounting();
+
+    static bool enabled();
+
+    // the cpu time consumed by the current thread
+    static uint64_t thread_cpu_ns();
+
+    // record a task executed by the current thread
+    void record(int code, gpid pid, uint64_t cpu_ns);
+
+    struct cpu_usage
+    {
+        uint64_t cpu_ns{0};
+        uint64_t count{0};
+    };
+    // the merged usages of the task codes which have been executed, indexed by task code
+    std::map<int, cpu_usage> get_code_usages() const;
+    std::map<gpid, cpu_usage> get_partition_usages() const;
+    // the usages of the partitions summed up by app id
+    std::map<int32_t, cpu_usage> get_app_usages() const;
+
+    // the usages of all the apps, and of the `top` partitions and task codes consuming the most
+    // cpu time, in the tabular format or in json
+    std::string get_usage_report(int top, bool json) const;
+
+private:
+    struct thread_stats
+    {
+        explicit thread_stats(int count);
+
+        const int code_count;
+        // written by the owner thread only
+        std::unique_ptr<std::atomic<uint64_t>[]> code_cpu_ns;
+        std::unique_ptr<std::atomic<uint64_t>[]> code_counts;
+
+        std::mutex lock; // protect partitions, which is contended only by the readers
+        std::unordered_map<gpid, cpu_usage> partitions;
+    };
+
+    thread_stats *local_stats();
+
+    mutable std::mutex _lock; // protect _threads
+    std::vector<std::unique_ptr<thread_stats>> _threads;
+};
+
+} // namespace dsn
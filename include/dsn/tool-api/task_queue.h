@@ -38,6 +38,7 @@
 #include <dsn/tool-api/task.h>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/utility/dlib.h>
+#include <vector>
 
 namespace dsn {
 
@@ -68,6 +69,9 @@ public:
     DSN_API virtual ~task_queue();
 
     virtual void enqueue(task *task) = 0;
+    // enqueue the tasks at once, which is called for the tasks enqueued in an
+    // enqueue_batch_scope. the queues override it to signal the workers once for all the tasks.
+    DSN_API virtual void enqueue_batch(const std::vector<task *> &tasks);
     // dequeue may return more than 1 tasks, but there is a configured
     // best batch size for each worker so that load among workers
     // are balanced,
@@ -83,7 +87,23 @@ public:
     int increase_count(int count = 1)
     {
         _queue_length_counter->add(count);
-        return _queue_length.fetch_add(count, std::memory_order_relaxed) + count;
+        int length = _queue_length.fetch_add(count, std::memory_order_relaxed) + count;
+        if (length > _queue_length_peak.load(std::memory_order_relaxed)) {
+            // lost updates between racing enqueuers are tolerable for a gauge
+            _queue_length_peak.store(length, std::memory_order_relaxed);
+        }
+        return length;
+    }
+    // the max queue length since the last call, which is reported by "system.queue"
+    int peak_count_and_reset()
+    {
+        return _queue_length_peak.exchange(count(), std::memory_order_relaxed);
+    }
+    // the time when the last task was enqueued into the empty queue, which is only recorded
+    // if spin_wait_max_us of the pool is enabled
+    uint64_t wakeup_enqueue_ts_ns() const
+    {
+        return _wakeup_enqueue_ts_ns.load(std::memory_order_relaxed);
     }
     const std::string &get_name() { return _name; }
     task_worker_pool *pool() const { return _pool; }
@@ -95,7 +115,13 @@ public:
 
 private:
     friend class task_worker_pool;
+    friend class enqueue_batch_scope;
     void enqueue_internal(task *task);
+    // the tasks rejected by throttling are removed from `tasks`
+    void enqueue_internal_batch(std::vector<task *> &tasks);
+    // returns true if the task is rejected
+    bool throttle(task *task);
+    void on_enqueue(int count);
 
 private:
     task_worker_pool *_pool;
@@ -103,9 +129,28 @@ private:
     int _index;
     admission_controller *_controller;
     std::atomic<int> _queue_length;
+    std::atomic<int> _queue_length_peak;
     dsn::perf_counter_wrapper _queue_length_counter;
     threadpool_spec *_spec;
     volatile int _virtual_queue_length;
+    std::atomic<uint64_t> _wakeup_enqueue_ts_ns;
+};
+
+/*!
+  task queue router maps the hash of a task to the index of its queue in a partitioned pool, in
+  place of `hash % queue_count`. it must map a hash to the same queue all the time, as the tasks
+  of a hash are assumed to be run by one thread. route() is called by any thread enqueuing tasks,
+  so it should be lock-free.
+ */
+class task_queue_router
+{
+public:
+    virtual ~task_queue_router() = default;
+
+    // called once with the queue count of the pool before the router is installed
+    virtual void init(unsigned int queue_count) = 0;
+
+    virtual unsigned int route(int hash) const = 0;
 };
 /*@}*/
 } // end namespace
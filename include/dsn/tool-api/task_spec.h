@@ -120,6 +120,20 @@ ENUM_REG(DSF_PROTOC_BINARY)
 ENUM_REG(DSF_PROTOC_JSON)
 ENUM_END(dsn_msg_serialize_format)
 
+// the values are carried in msg_context::compress_type, so there must be no more than 3 codecs
+typedef enum dsn_msg_compress_type {
+    MCT_NONE = 0,
+    MCT_LZ4 = 1,
+    MCT_ZSTD = 2,
+    MCT_INVALID = 3
+} dsn_msg_compress_type;
+
+ENUM_BEGIN(dsn_msg_compress_type, MCT_INVALID)
+ENUM_REG(MCT_NONE)
+ENUM_REG(MCT_LZ4)
+ENUM_REG(MCT_ZSTD)
+ENUM_END(dsn_msg_compress_type)
+
 // define network header format for RPC
 DEFINE_CUSTOMIZED_ID_TYPE(network_header_format)
 DEFINE_CUSTOMIZED_ID(network_header_format, NET_HDR_INVALID)
@@ -141,6 +155,27 @@ typedef void (*task_rejection_handler)(task *, admission_controller *);
 
 std::set<dsn::task_code> &get_storage_rpc_req_codes();
 
+// the bits of task_spec::hooks, one for each join point of the task_spec
+enum task_hook
+{
+    TASK_HOOK_CREATE = 1u << 0,
+    TASK_HOOK_ENQUEUE = 1u << 1,
+    TASK_HOOK_BEGIN = 1u << 2,
+    TASK_HOOK_END = 1u << 3,
+    TASK_HOOK_CANCELLED = 1u << 4,
+    TASK_HOOK_WAIT_PRE = 1u << 5,
+    TASK_HOOK_WAIT_NOTIFIED = 1u << 6,
+    TASK_HOOK_WAIT_POST = 1u << 7,
+    TASK_HOOK_CANCEL_POST = 1u << 8,
+    TASK_HOOK_AIO_CALL = 1u << 9,
+    TASK_HOOK_AIO_ENQUEUE = 1u << 10,
+    TASK_HOOK_RPC_CALL = 1u << 11,
+    TASK_HOOK_RPC_REQUEST_ENQUEUE = 1u << 12,
+    TASK_HOOK_RPC_REPLY = 1u << 13,
+    TASK_HOOK_RPC_RESPONSE_ENQUEUE = 1u << 14,
+    TASK_HOOK_RPC_CREATE_RESPONSE = 1u << 15,
+};
+
 class task_spec : public extensible_object<task_spec, 4>
 {
 public:
@@ -179,13 +214,16 @@ public:
 
     // allow task executed in other thread pools or tasks
     // for TASK_TYPE_COMPUTE - allow-inline allows a task being executed in its caller site
-    // for other tasks - allow-inline allows a task being execution in io-thread
+    // for other tasks - allow-inline allows a task being execution in io-thread, e.g. the
+    // callback of an aio task runs on the aio completion thread without a hop to its pool,
+    // which suits the short callbacks that never block nor wait for other tasks
     bool allow_inline;
     bool randomize_timer_delay_if_zero; // to avoid many timers executing at the same time
     network_header_format rpc_call_header_format;
     dsn_msg_serialize_format rpc_msg_payload_serialize_default_format;
     rpc_channel rpc_call_channel;
     bool rpc_message_crc_required;
+    dsn_msg_compress_type rpc_response_compress_type;
 
     int32_t rpc_timeout_milliseconds;
     int32_t rpc_request_resend_timeout_milliseconds;  // 0 for no auto-resend
@@ -195,6 +233,11 @@ public:
 
     task_rejection_handler rejection_handler;
 
+    // the task_hook bits of the join points which have any advice, the hot paths test it once
+    // for several join points and skip evaluating the arguments of them, it's always 0 if no
+    // toollet is installed
+    uint32_t hooks;
+
     // COMPUTE
     /*!
      @addtogroup tool-api-hooks
@@ -240,6 +283,8 @@ public:
 public:
     DSN_API static bool init();
     DSN_API void init_profiling(bool profile);
+
+    bool has_hook(uint32_t mask) const { return (hooks & mask) != 0; }
 };
 
 CONFIG_BEGIN(task_spec)
@@ -294,6 +339,13 @@ CONFIG_FLD(bool,
            rpc_message_crc_required,
            false,
            "whether to calculate the crc checksum when send request/response")
+CONFIG_FLD_ENUM(dsn_msg_compress_type,
+                rpc_response_compress_type,
+                MCT_NONE,
+                MCT_INVALID,
+                false,
+                "which codec the response body of this kind of rpc calls is compressed with, "
+                "the remote side falls back to MCT_NONE if it does not support the codec")
 CONFIG_FLD(int32_t,
            uint64,
            rpc_timeout_milliseconds,
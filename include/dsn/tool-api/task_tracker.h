@@ -153,6 +153,12 @@ private:
 class task_tracker
 {
 public:
+    // The tasks are put in `task_bucket_count` buckets, each with its own lock. A task is put in
+    // the bucket of the thread creating it, so the trackers shared by many threads, like the
+    // ones of the replicas, may use SHARDED_BUCKET_COUNT buckets to avoid the contention of
+    // the lock, at the cost of a cache line per bucket.
+    static const int SHARDED_BUCKET_COUNT = 8;
+
     explicit task_tracker(int task_bucket_count = 1);
     virtual ~task_tracker();
 
@@ -168,9 +174,20 @@ public:
 
 private:
     friend class trackable_task;
+
+    struct bucket_base
+    {
+        ::dsn::utils::ex_lock_nr_spin lock;
+        dlink tasks;
+    };
+    // padded to a cache line to avoid false sharing between the buckets
+    struct bucket : bucket_base
+    {
+        char padding[64 - sizeof(bucket_base)];
+    };
+
     const int _task_bucket_count;
-    ::dsn::utils::ex_lock_nr_spin *_outstanding_tasks_lock;
-    dlink *_outstanding_tasks;
+    bucket *_buckets;
 };
 
 // ------- inlined implementation ----------
@@ -185,9 +202,9 @@ inline void trackable_task::set_tracker(task_tracker *owner, task *tsk)
         _dl_bucket_id =
             static_cast<int>(::dsn::utils::get_current_tid() % _owner->_task_bucket_count);
         {
-            utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(
-                _owner->_outstanding_tasks_lock[_dl_bucket_id]);
-            _dl.insert_after(&_owner->_outstanding_tasks[_dl_bucket_id]);
+            auto &b = _owner->_buckets[_dl_bucket_id];
+            utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(b.lock);
+            _dl.insert_after(&b.tasks);
         }
     }
 }
@@ -219,8 +236,7 @@ inline trackable_task::owner_delete_state trackable_task::owner_delete_prepare()
 inline void trackable_task::owner_delete_commit()
 {
     {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(
-            _owner->_outstanding_tasks_lock[_dl_bucket_id]);
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_owner->_buckets[_dl_bucket_id].lock);
         _dl.remove();
     }
 
@@ -94,6 +94,12 @@ private:
     utils::notify_event _started;
     int _processed_task_count;
 
+    // moving average of how long the worker is idle before a task arrives
+    uint64_t _avg_idle_ns;
+    perf_counter_wrapper _spin_hit_count;
+    perf_counter_wrapper _park_count;
+    perf_counter_wrapper _wakeup_latency_ns;
+
 public:
     DSN_API static void set_name(const char *name);
     DSN_API static void set_priority(worker_priority_t pri);
@@ -102,6 +108,12 @@ public:
 private:
     void run_internal();
 
+    // spin-then-park, see spin_wait_max_us of threadpool_spec
+    uint64_t spin_budget_ns() const;
+    // return false if no task arrives in the spin budget
+    bool spin_wait(task_queue *q, uint64_t idle_start_ns);
+    void on_idle_end(task_queue *q, uint64_t idle_start_ns, bool parked);
+
 public:
     /*!
     @addtogroup tool-api-hooks
@@ -71,6 +71,10 @@ struct threadpool_spec
     bool enable_virtual_queue_throttling;
     std::string admission_controller_factory_name;
     std::string admission_controller_arguments;
+    int spin_wait_max_us;
+    bool adaptive_spin_wait;
+    bool numa_aware;
+    bool lazy_start;
 
     threadpool_spec(const dsn::threadpool_code &code) : name(code.to_string()), pool_code(code) {}
     threadpool_spec(const threadpool_spec &source) = default;
@@ -127,5 +131,29 @@ CONFIG_FLD_STRING(admission_controller_factory_name,
 CONFIG_FLD_STRING(admission_controller_arguments,
                   "",
                   "arguments for the cusotmized admission controller")
+CONFIG_FLD(int,
+           uint64,
+           spin_wait_max_us,
+           0,
+           "how long an idle worker spins for new tasks before it parks on the queue, 0 to park "
+           "at once")
+CONFIG_FLD(bool,
+           bool,
+           adaptive_spin_wait,
+           true,
+           "whether an idle worker spins only when tasks recently arrived within "
+           "spin_wait_max_us after it became idle")
+CONFIG_FLD(bool,
+           bool,
+           numa_aware,
+           false,
+           "whether the workers are split evenly across the numa nodes, each bound to the cpus "
+           "of its node, which overrides worker_affinity_mask")
+CONFIG_FLD(bool,
+           bool,
+           lazy_start,
+           false,
+           "whether the workers are started on the first task of the pool rather than at the "
+           "startup, for the rarely used pools")
 CONFIG_END
 }
@@ -0,0 +1,127 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dsn/tool-api/task_code.h>
+#include <dsn/utility/autoref_ptr.h>
+#include <dsn/utility/singleton.h>
+#include <dsn/utility/synchronize.h>
+
+namespace dsn {
+
+class message_ex;
+
+struct trace_point
+{
+    // a static string which names the point, such as "rpc_receive"
+    const char *event;
+    uint64_t ts_ns;
+};
+
+///
+/// trace_span records the time points of a sampled rpc request, along the path of
+///
+///   rpc_receive -> task_enqueue -> task_dequeue -> [init_prepare -> log_append ->
+///   prepare_ack ... -> commit] -> reply
+///
+/// A request is sampled on receiving with the probability of 1 / [tracing] trace_sample_rate,
+/// and its span is referenced by the request message and the response message. The span is
+/// completed when released by all of them, and is submitted to trace_exporter then.
+///
+/// Points can be added concurrently. The points after the first MAX_POINT_COUNT ones are
+/// dropped.
+///
+class trace_span : public ref_counter
+{
+public:
+    static const int MAX_POINT_COUNT = 24;
+
+    // return nullptr if the request is not sampled, or a span with the point "rpc_receive"
+    static trace_span *sample(message_ex *request);
+
+    trace_span(uint64_t trace_id, task_code code);
+    ~trace_span() override;
+
+    void add_point(const char *event);
+
+    uint64_t trace_id() const { return _trace_id; }
+    task_code code() const { return _code; }
+
+private:
+    const uint64_t _trace_id;
+    const task_code _code;
+    std::atomic<int> _point_count{0};
+    trace_point _points[MAX_POINT_COUNT];
+};
+typedef ref_ptr<trace_span> trace_span_ptr;
+
+struct completed_span
+{
+    uint64_t trace_id;
+    task_code code;
+    std::vector<trace_point> points;
+
+    // trace_id=<trace_id>, code=<code>, <event>=+<us since the first point>us, ...
+    std::string to_string() const;
+};
+
+// trace_sink exports the completed spans, which is created with the name of
+// [tracing] trace_sink by factory_store<trace_sink>
+class trace_sink
+{
+public:
+    template <typename T>
+    static trace_sink *create()
+    {
+        return new T();
+    }
+    typedef trace_sink *(*factory)();
+
+    virtual ~trace_sink() = default;
+
+    // never called concurrently
+    virtual void export_spans(const std::vector<completed_span> &spans) = 0;
+};
+
+// the sink named "log", which logs a span in a line
+class log_trace_sink : public trace_sink
+{
+public:
+    void export_spans(const std::vector<completed_span> &spans) override;
+};
+
+// trace_exporter collects the completed spans, and exports them to the sink in batch, once
+// [tracing] trace_export_batch_size spans are collected or the oldest one has been waiting for
+// [tracing] trace_export_interval_ms
+class trace_exporter : public utils::singleton<trace_exporter>
+{
+public:
+    trace_exporter();
+
+    void submit(completed_span &&span);
+
+    // export all the collected spans now
+    void flush();
+
+    // replace the sink created by name, mainly for test
+    void set_sink(std::unique_ptr<trace_sink> sink);
+
+private:
+    void export_spans(std::vector<completed_span> &&spans);
+
+    utils::ex_lock_nr _lock; // protect _spans and _first_submit_ms
+    std::vector<completed_span> _spans;
+    uint64_t _first_submit_ms{0};
+
+    utils::ex_lock_nr _sink_lock; // serialize the exports
+    std::unique_ptr<trace_sink> _sink;
+};
+
+} // namespace dsn
@@ -41,11 +41,18 @@
 ///
 
 namespace dsn {
+///
+/// the time waited for a lock when it's held by others is sampled by the lock site if the lock
+/// is named by `site` and [core] enable_lock_profiling is true, the stats of which are printed by
+/// the remote command "locks.contention".
+///
+struct lock_contention_stat;
+
 class ilock;
 class zlock
 {
 public:
-    zlock(bool recursive = false);
+    zlock(bool recursive = false, const char *site = nullptr);
     ~zlock();
 
     void lock();
@@ -55,13 +62,14 @@ public:
 private:
     DISALLOW_COPY_AND_ASSIGN(zlock);
     ilock *_h;
+    lock_contention_stat *_stat;
 };
 
 class rwlock_nr_provider;
 class zrwlock_nr
 {
 public:
-    zrwlock_nr();
+    explicit zrwlock_nr(const char *site = nullptr);
     ~zrwlock_nr();
 
     void lock_read();
@@ -75,6 +83,7 @@ public:
 private:
     DISALLOW_COPY_AND_ASSIGN(zrwlock_nr);
     rwlock_nr_provider *_h;
+    lock_contention_stat *_stat;
 };
 
 class semaphore_provider;
@@ -98,6 +98,19 @@ tracer::on_task_wait_pre = true
 [task.RPC_PING]
 is_trace = false
 
+[tracer]
+; trace 1 of every N task flows, which are sampled by their trace_id (or task id
+; for the local tasks), 0 to trace none, mutable through flags.set
+tracer_sample_ratio = 1
+
+; record the events into an in-memory ring buffer rather than the log, which is
+; dumped by the remote command "tracer.dump [count]" or saved in a binary file by
+; "tracer.save <file>", mutable through flags.set
+tracer_output_to_ring = false
+
+; the count of events kept in the ring buffer, rounded up to a power of 2
+tracer_ring_buffer_events = 65536
+
 </PRE>
 */
 namespace dsn {
@@ -0,0 +1,42 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <dsn/utility/binary_writer.h>
+
+namespace dsn {
+
+/// arena_binary_writer is a binary_writer whose buffers are allocated from the transient memory
+/// of the current thread (see transient_memory.h), rather than by a malloc for each buffer.
+///
+/// the chunks allocated one after another are adjacent in the same transient memory block, so
+/// binary_writer merges them into one blob, and get_buffer() usually returns the only buffer
+/// without copying. the buffers appended by write_shared() are kept as they are, so get_buffers()
+/// is a scatter-gather view of the data, which is also not copied.
+///
+/// `header_size` bytes are reserved at the beginning of the first buffer, which can be filled
+/// through header() after the body is written, e.g. with the body length or crc.
+class arena_binary_writer : public binary_writer
+{
+public:
+    explicit arena_binary_writer(int header_size = 0, int chunk_size = 0);
+
+    template <typename T>
+    T *header()
+    {
+        assert(sizeof(T) <= static_cast<size_t>(_header_size));
+        return reinterpret_cast<T *>(const_cast<char *>(get_first_buffer().data()));
+    }
+
+    int header_size() const { return _header_size; }
+
+protected:
+    void create_new_buffer(size_t size, /*out*/ blob &bb) override;
+
+private:
+    int _header_size;
+};
+
+} // namespace dsn
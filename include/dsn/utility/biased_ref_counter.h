@@ -0,0 +1,99 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+
+namespace dsn {
+
+struct biased_ref_owner;
+extern __thread biased_ref_owner *tls_biased_ref_owner;
+
+///
+/// biased_ref_counter is a replacement of ref_counter for the objects which are mostly
+/// referenced by the thread creating them, e.g. the mutations of a replica, most references of
+/// which are taken and dropped by the worker thread of the replica. The references on the owner
+/// thread are counted without atomic read-modify-write operations, and only those on the other
+/// threads are counted atomically (see "Biased Reference Counting", PACT'18).
+///
+/// The owner merges its count into the atomic one when it drops all its references. The other
+/// threads may drop the references taken by the owner, in which case the owner is asked to
+/// merge by queuing the object to it, which is done in merge_queued().
+///
+/// Only the objects created on the threads which have called enable_biasing() are biased,
+/// as these threads must call merge_queued() regularly. Task workers do so after each batch of
+/// tasks. The objects created on the other threads are counted atomically like ref_counter.
+///
+class biased_ref_counter
+{
+public:
+    biased_ref_counter();
+    virtual ~biased_ref_counter() = default;
+
+    void add_ref()
+    {
+        if (is_biased()) {
+            _biased_count.store(_biased_count.load(std::memory_order_relaxed) + 1,
+                                std::memory_order_relaxed);
+        } else {
+            // relaxed is enough for the same reason as ref_counter::add_ref
+            _shared.fetch_add(kOneRef, std::memory_order_relaxed);
+        }
+    }
+
+    void release_ref()
+    {
+        if (is_biased()) {
+            long count = _biased_count.load(std::memory_order_relaxed) - 1;
+            _biased_count.store(count, std::memory_order_relaxed);
+            if (count == 0) {
+                merge(false);
+            }
+        } else {
+            release_shared_ref();
+        }
+    }
+
+    // may be stale if the object is referenced by several threads
+    long get_count() const
+    {
+        return _biased_count.load(std::memory_order_relaxed) +
+               count_of(_shared.load(std::memory_order_relaxed));
+    }
+
+    // bias the objects created on this thread to it, which must call merge_queued() regularly
+    static void enable_biasing();
+
+    // merge the objects queued to this thread by the other threads
+    static void merge_queued();
+
+private:
+    // the atomic count is kept in the higher bits of `_shared`, with the flags in the lower bits
+    static const long kMerged = 1;
+    static const long kQueued = 2;
+    static const long kOneRef = 4;
+
+    static long count_of(long shared) { return shared >> 2; }
+
+    // `_merged` is only read on the owner thread
+    bool is_biased() const { return _owner == tls_biased_ref_owner && !_merged; }
+
+    // merge the biased count into the atomic one on the owner thread, and delete the object if
+    // no reference is left. `dequeued` is true if the object is merged on request.
+    void merge(bool dequeued);
+    void release_shared_ref();
+
+    biased_ref_owner *const _owner;
+    // only written by the owner thread
+    bool _merged;
+    std::atomic<long> _biased_count{0};
+    std::atomic<long> _shared;
+
+public:
+    biased_ref_counter(const biased_ref_counter &) = delete;
+    biased_ref_counter &operator=(const biased_ref_counter &) = delete;
+};
+
+} // namespace dsn
@@ -37,6 +37,11 @@ public:
     void write(const blob &val);
     void write_empty(int sz);
 
+    // append the content of `val` (without its length) as a separate buffer which shares the
+    // memory of `val`, so `val` must not be modified afterwards. It is copied instead if it
+    // does not own its memory.
+    virtual void write_shared(const blob &val);
+
     bool next(void **data, int *size);
     bool backup(int count);
 
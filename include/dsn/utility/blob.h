@@ -29,6 +29,8 @@
 #include <memory>
 #include <thrift/protocol/TProtocol.h>
 
+#include <dsn/utility/shared_array.h>
+
 namespace dsn {
 
 /// dsn::blob is a special thrift type that's not generated by thrift compiler,
@@ -64,16 +66,18 @@ public:
     /// NOTE: this operation is not efficient since it involves a memory copy.
     static blob create_from_bytes(const char *s, size_t len)
     {
-        std::shared_ptr<char> s_arr(new char[len], std::default_delete<char[]>());
+        std::shared_ptr<char> s_arr = utils::make_shared_array<char>(len);
         memcpy(s_arr.get(), s, len);
         return blob(std::move(s_arr), 0, static_cast<unsigned int>(len));
     }
 
     /// Create shared buffer without copying data.
+    /// The string is moved into the block of the reference count, so only one allocation is
+    /// made.
     static blob create_from_bytes(std::string &&bytes)
     {
-        auto s = new std::string(std::move(bytes));
-        std::shared_ptr<char> buf(const_cast<char *>(s->data()), [s](char *) { delete s; });
+        auto s = std::make_shared<std::string>(std::move(bytes));
+        std::shared_ptr<char> buf(s, const_cast<char *>(s->data()));
         return blob(std::move(buf), 0, static_cast<unsigned int>(s->length()));
     }
 
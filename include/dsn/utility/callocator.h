@@ -53,4 +53,8 @@ public:
 /// are derived from transient_objects,
 /// so that their memory can be mamanged by trans_memory_allocator
 typedef callocator_object<tls_trans_malloc, tls_trans_free> transient_object;
+
+/// pooled_object uses tls_pool_malloc/tls_pool_free as custom memory allocate,
+/// which caches the freed memory of the same size class in thread local free lists
+typedef callocator_object<tls_pool_malloc, tls_pool_free> pooled_object;
 }
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 
 namespace dsn {
@@ -18,6 +19,15 @@ public:
     // Gets current time in nanoseconds.
     virtual uint64_t now_ns() const;
 
+    // Gets the current time in milliseconds cached by a background thread every
+    // [core] coarse_clock_interval_ms, for the callers which tolerate the staleness. It's
+    // now_ns() / 1000000 if the cache is not started or the clock is mocked.
+    static uint64_t coarse_now_ms();
+
+    // Installs the tsc clock if [core] tsc_clock_enabled, and starts the coarse clock, unless
+    // the clock is mocked, e.g. by the simulator (not thread-safety)
+    static void start_fast_clocks();
+
     // Gets singleton instance. eager singleton, which is thread safe
     static const clock *instance();
 
@@ -26,6 +36,7 @@ public:
 
 private:
     static std::unique_ptr<clock> _clock;
+    static std::atomic<bool> _mocked;
 };
 
 } // namespace utils
@@ -27,6 +27,17 @@ uint32_t crc32_concat(uint32_t xy_init,
                       uint32_t y_final,
                       size_t y_size);
 
+//
+// Given
+//      x_final = crc32_calc(x_ptr, x_size, x_init);
+// and
+//      y_final = crc32_calc(y_ptr, y_size, 0);
+// compute CRC of concatenation of A and B
+//      x##y_crc = crc32_calc(x##y, x_size + y_size, x_init);
+// without touching A and B, and without knowing x_size
+//
+uint32_t crc32_combine(uint32_t x_final, uint32_t y_final, size_t y_size);
+
 uint64_t crc64_calc(const void *ptr, size_t size, uint64_t init_crc);
 
 //
@@ -45,5 +56,16 @@ uint64_t crc64_concat(uint32_t xy_init,
                       uint64_t y_init,
                       uint64_t y_final,
                       size_t y_size);
+
+//
+// Given
+//      x_final = crc64_calc(x_ptr, x_size, x_init);
+// and
+//      y_final = crc64_calc(y_ptr, y_size, 0);
+// compute CRC of concatenation of A and B
+//      x##y_crc = crc64_calc(x##y, x_size + y_size, x_init);
+// without touching A and B, and without knowing x_size
+//
+uint64_t crc64_combine(uint64_t x_final, uint64_t y_final, size_t y_size);
 }
 }
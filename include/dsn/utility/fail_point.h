@@ -20,24 +20,54 @@
 /// A fail point implementation in C++.
 /// This lib is ported from https://github.com/pingcap/fail-rs.
 
+#include <atomic>
+
+#include <dsn/utility/ports.h>
 #include <dsn/utility/string_view.h>
 
 /// The only entry to define a fail point.
 /// When a fail point is defined, it's referenced via the name.
+///
+/// A disabled fail point costs a relaxed load of a global flag, which is only set when some fail
+/// points are configured after setup(). The fail point is looked up once by name on its first
+/// evaluation, and cached in a static handle afterward.
+///
+/// Build with -DDSN_DISABLE_FAIL_POINT (cmake -DENABLE_FAIL_POINT=OFF) to compile the fail
+/// points out entirely. The lambda is still compiled so that the variables only used by it
+/// don't break the build.
+#ifdef DSN_DISABLE_FAIL_POINT
+#define FAIL_POINT_INJECT_F(name, lambda)                                                          \
+    do {                                                                                           \
+        if (false) {                                                                               \
+            auto __Func = lambda;                                                                  \
+            (void)__Func;                                                                          \
+        }                                                                                          \
+    } while (0)
+#else
 #define FAIL_POINT_INJECT_F(name, lambda)                                                          \
     do {                                                                                           \
-        if (dsn_likely(!::dsn::fail::_S_FAIL_POINT_ENABLED))                                       \
+        if (dsn_likely(!::dsn::fail::_S_FAIL_POINT_ENABLED.load(std::memory_order_relaxed)))       \
             break;                                                                                 \
-        auto __Func = lambda;                                                                      \
-        auto __Res = ::dsn::fail::eval(name);                                                      \
+        static ::dsn::fail::fail_point *__Point = ::dsn::fail::get(name);                          \
+        auto __Res = ::dsn::fail::eval(__Point);                                                   \
         if (__Res != nullptr) {                                                                    \
+            auto __Func = lambda;                                                                  \
             return __Func(*__Res);                                                                 \
         }                                                                                          \
     } while (0)
+#endif
 
 namespace dsn {
 namespace fail {
 
+struct fail_point;
+
+/// Get the fail point of the name, which is created if not exists. The returned pointer is
+/// valid until the process exits.
+extern fail_point *get(dsn::string_view name);
+
+extern const std::string *eval(fail_point *p);
+
 extern const std::string *eval(dsn::string_view name);
 
 /// Set new actions to a fail point at runtime.
@@ -52,7 +82,8 @@ extern void setup();
 /// Tear down the fail point system.
 extern void teardown();
 
-extern bool _S_FAIL_POINT_ENABLED;
+/// Whether any fail point is configured after setup().
+extern std::atomic<bool> _S_FAIL_POINT_ENABLED;
 
 } // namespace fail
 } // namespace dsn
@@ -31,6 +31,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <dsn/utility/error_code.h>
 
 #ifndef _XOPEN_SOURCE
@@ -98,6 +99,10 @@ bool create_directory(const std::string &path);
 
 bool create_file(const std::string &path);
 
+// allocates the blocks of the file up to `size` bytes, so the later writes within them don't
+// have to allocate blocks or grow the file
+bool preallocate_file(const std::string &path, int64_t size);
+
 bool get_current_directory(std::string &path);
 
 bool last_write_time(const std::string &path, time_t &tm);
@@ -121,6 +126,9 @@ bool get_disk_space_info(const std::string &path, disk_space_info &info);
 
 bool link_file(const std::string &src, const std::string &target);
 
+// Copies src to target, the target must not exist.
+bool copy_file(const std::string &src, const std::string &target);
+
 error_code md5sum(const std::string &file_path, /*out*/ std::string &result);
 
 // return value:
@@ -136,6 +144,19 @@ bool verify_file(const std::string &fname,
                  const std::string &expected_md5,
                  const int64_t &expected_fsize);
 
+struct file_to_verify
+{
+    std::string fname;
+    std::string md5;
+    int64_t size;
+};
+
+// verify the files by up to `max_threads` threads concurrently, `results` is whether each of
+// them is verified; return true if all of them are verified
+bool verify_files(const std::vector<file_to_verify> &files,
+                  int max_threads,
+                  /*out*/ std::vector<bool> &results);
+
 } // namespace filesystem
 } // namespace utils
 } // namespace dsn
@@ -8,10 +8,22 @@
 #include <cstdint>
 #include <functional>
 
+#include <dsn/utility/errors.h>
+
 // Example:
 //    DSN_DEFINE_string("core", filename, "my_file.txt", "The file to read");
 //    DSN_DEFINE_validator(filename, [](const char *fname){ return is_file(fname); });
 //    auto fptr = file::open(FLAGS_filename, O_RDONLY | O_BINARY, 0);
+//
+// The flags are plain variables registered at static initialization, and loaded from the config
+// once by flags_initialize(), so reading them costs nothing on hot paths, unlike
+// dsn_config_get_value_*() which looks up the config under a lock.
+//
+// A flag tagged FT_MUTABLE can be updated at runtime by the remote command "flags.set", and is
+// stored atomically so that readers see either the old or the new value:
+//    DSN_DEFINE_uint32("replication", max_concurrent_copy, 8, "...");
+//    DSN_TAG_VARIABLE(max_concurrent_copy, FT_MUTABLE);
+// Such flags should be read once per use, e.g. into a local variable, rather than cached.
 
 #define DSN_DECLARE_VARIABLE(type, name) extern type FLAGS_##name
 
@@ -46,11 +58,15 @@
 // `validator` must be a std::function<bool(FLAG_TYPE)> and receives the flag value as argument,
 // returns true if validation passed.
 // The program corrupts if the validation failed.
+// The validator is also checked when the flag is updated at runtime, and the update is
+// rejected if it fails.
 #define DSN_DEFINE_validator(name, validator)                                                      \
     static auto FLAGS_VALIDATOR_FN_##name = validator;                                             \
-    static const dsn::flag_validator FLAGS_VALIDATOR_##name(#name, []() {                          \
-        dassert(FLAGS_VALIDATOR_FN_##name(FLAGS_##name), "validation failed: %s", #name);          \
-    })
+    static const dsn::flag_validator FLAGS_VALIDATOR_##name(                                       \
+        #name, []() -> bool { return FLAGS_VALIDATOR_FN_##name(FLAGS_##name); })
+
+#define DSN_TAG_VARIABLE(name, tag)                                                                \
+    static const dsn::flag_tagger FLAGS_TAGGER_##name##_##tag(#name, dsn::flag_tag::tag)
 
 namespace dsn {
 
@@ -71,10 +87,30 @@ public:
 class flag_validator
 {
 public:
-    flag_validator(const char *name, std::function<void()>);
+    flag_validator(const char *name, std::function<bool()>);
+};
+
+enum class flag_tag
+{
+    FT_MUTABLE = 0, // can be updated at runtime
 };
 
-// Loads all the flags from configuration.
+// An utility class that tags a flag upon initialization.
+class flag_tagger
+{
+public:
+    flag_tagger(const char *name, flag_tag tag);
+};
+
+// Loads all the flags from configuration, and registers the remote commands "flags.list",
+// "flags.get" and "flags.set".
 extern void flags_initialize();
 
+// Updates the flag to `value` at runtime. It fails if the flag doesn't exist, isn't tagged
+// FT_MUTABLE, or `value` is invalid.
+extern error_s update_flag(const std::string &name, const std::string &value);
+
+// Gets the current value of the flag as a string.
+extern error_with<std::string> get_flag_str(const std::string &name);
+
 } // namespace dsn
@@ -0,0 +1,264 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dsn {
+
+// inline_function is a replacement of std::function with a larger inline buffer.
+//
+// std::function of libstdc++ only stores the callables of at most 16 bytes inline, so a lambda
+// capturing more than two pointers is allocated on heap. The task callbacks usually capture a
+// few more, e.g. `this`, a mutation_ptr and a decree, so inline_function stores the callables
+// of at most `InlineSize` bytes inline, and only allocates for the larger ones.
+//
+// Like std::function, it's copyable and requires the callables to be copyable, it's empty if
+// constructed from nullptr, a null function pointer or an empty std::function, and throws
+// std::bad_function_call if called when empty.
+template <typename Signature, size_t InlineSize = 64>
+class inline_function;
+
+template <typename R, typename... Args, size_t InlineSize>
+class inline_function<R(Args...), InlineSize>
+{
+    template <typename...>
+    struct make_void
+    {
+        typedef void type;
+    };
+
+    template <typename F, typename = void>
+    struct is_callable : std::false_type
+    {
+    };
+    template <typename F>
+    struct is_callable<
+        F,
+        typename make_void<decltype(std::declval<F &>()(std::declval<Args>()...))>::type>
+        : std::integral_constant<
+              bool,
+              std::is_void<R>::value ||
+                  std::is_convertible<decltype(std::declval<F &>()(std::declval<Args>()...)),
+                                      R>::value>
+    {
+    };
+
+    template <typename F>
+    using enable_if_callable =
+        typename std::enable_if<!std::is_same<typename std::decay<F>::type,
+                                              inline_function>::value &&
+                                is_callable<typename std::decay<F>::type>::value>::type;
+
+    typedef typename std::aligned_storage<InlineSize, alignof(std::max_align_t)>::type storage_t;
+
+    template <typename F>
+    struct fits_inline
+        : std::integral_constant<bool,
+                                 sizeof(F) <= InlineSize &&
+                                     alignof(std::max_align_t) % alignof(F) == 0 &&
+                                     std::is_nothrow_move_constructible<F>::value>
+    {
+    };
+
+    struct ops_t
+    {
+        R (*invoke)(void *storage, Args... args);
+        void (*copy)(const void *src, void *dst);
+        // move constructs `dst` from `src`, and destroys `src`
+        void (*move)(void *src, void *dst);
+        void (*destroy)(void *storage);
+    };
+
+    template <typename F, bool Inline = fits_inline<F>::value>
+    struct manager
+    {
+        static F *get(void *s) { return static_cast<F *>(s); }
+        template <typename G>
+        static void create(void *s, G &&g)
+        {
+            ::new (s) F(std::forward<G>(g));
+        }
+        static R invoke(void *s, Args... args) { return (*get(s))(std::forward<Args>(args)...); }
+        static void copy(const void *src, void *dst)
+        {
+            ::new (dst) F(*static_cast<const F *>(src));
+        }
+        static void move(void *src, void *dst)
+        {
+            ::new (dst) F(std::move(*get(src)));
+            get(src)->~F();
+        }
+        static void destroy(void *s) { get(s)->~F(); }
+    };
+
+    template <typename F>
+    struct manager<F, false>
+    {
+        static F *&get(void *s) { return *static_cast<F **>(s); }
+        template <typename G>
+        static void create(void *s, G &&g)
+        {
+            get(s) = new F(std::forward<G>(g));
+        }
+        static R invoke(void *s, Args... args) { return (*get(s))(std::forward<Args>(args)...); }
+        static void copy(const void *src, void *dst)
+        {
+            get(dst) = new F(**static_cast<F *const *>(src));
+        }
+        static void move(void *src, void *dst) { get(dst) = get(src); }
+        static void destroy(void *s) { delete get(s); }
+    };
+
+    template <typename F>
+    static const ops_t *get_ops()
+    {
+        typedef manager<F> m;
+        static const ops_t ops = {&m::invoke, &m::copy, &m::move, &m::destroy};
+        return &ops;
+    }
+
+    template <typename F>
+    static bool is_null(const F &)
+    {
+        return false;
+    }
+    template <typename T>
+    static bool is_null(T *f)
+    {
+        return f == nullptr;
+    }
+    template <typename Sig>
+    static bool is_null(const std::function<Sig> &f)
+    {
+        return !f;
+    }
+    template <typename Sig, size_t N>
+    static bool is_null(const inline_function<Sig, N> &f)
+    {
+        return !f;
+    }
+
+public:
+    inline_function() noexcept : _ops(nullptr) {}
+    inline_function(std::nullptr_t) noexcept : _ops(nullptr) {}
+
+    inline_function(const inline_function &other) : _ops(other._ops)
+    {
+        if (_ops != nullptr) {
+            _ops->copy(&other._storage, &_storage);
+        }
+    }
+
+    inline_function(inline_function &&other) noexcept : _ops(other._ops)
+    {
+        if (_ops != nullptr) {
+            _ops->move(&other._storage, &_storage);
+            other._ops = nullptr;
+        }
+    }
+
+    template <typename F, typename = enable_if_callable<F>>
+    inline_function(F &&f) : _ops(nullptr)
+    {
+        typedef typename std::decay<F>::type func_t;
+        const func_t &decayed = f;
+        if (!is_null(decayed)) {
+            manager<func_t>::create(&_storage, std::forward<F>(f));
+            _ops = get_ops<func_t>();
+        }
+    }
+
+    ~inline_function() { reset(); }
+
+    inline_function &operator=(const inline_function &other)
+    {
+        if (this != &other) {
+            *this = inline_function(other);
+        }
+        return *this;
+    }
+
+    inline_function &operator=(inline_function &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            if (other._ops != nullptr) {
+                other._ops->move(&other._storage, &_storage);
+                _ops = other._ops;
+                other._ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    inline_function &operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    template <typename F, typename = enable_if_callable<F>>
+    inline_function &operator=(F &&f)
+    {
+        return *this = inline_function(std::forward<F>(f));
+    }
+
+    void swap(inline_function &other) noexcept
+    {
+        inline_function tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    explicit operator bool() const noexcept { return _ops != nullptr; }
+
+    R operator()(Args... args) const
+    {
+        if (_ops == nullptr) {
+            throw std::bad_function_call();
+        }
+        return _ops->invoke(&_storage, std::forward<Args>(args)...);
+    }
+
+private:
+    void reset() noexcept
+    {
+        if (_ops != nullptr) {
+            _ops->destroy(&_storage);
+            _ops = nullptr;
+        }
+    }
+
+    const ops_t *_ops;
+    mutable storage_t _storage;
+};
+
+template <typename Sig, size_t N>
+bool operator==(const inline_function<Sig, N> &f, std::nullptr_t) noexcept
+{
+    return !f;
+}
+template <typename Sig, size_t N>
+bool operator==(std::nullptr_t, const inline_function<Sig, N> &f) noexcept
+{
+    return !f;
+}
+template <typename Sig, size_t N>
+bool operator!=(const inline_function<Sig, N> &f, std::nullptr_t) noexcept
+{
+    return static_cast<bool>(f);
+}
+template <typename Sig, size_t N>
+bool operator!=(std::nullptr_t, const inline_function<Sig, N> &f) noexcept
+{
+    return static_cast<bool>(f);
+}
+
+} // namespace dsn
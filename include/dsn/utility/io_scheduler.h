@@ -0,0 +1,108 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dsn/utility/TokenBucket.h>
+#include <dsn/utility/singleton.h>
+#include <dsn/utility/synchronize.h>
+
+namespace dsn {
+
+// the background activities scheduled by io_scheduler
+enum class io_class
+{
+    LEARN = 0,
+    BACKUP,
+    BULK_LOAD,
+    DUPLICATION,
+    COPY,
+    COUNT
+};
+
+const char *io_class_to_string(io_class cls);
+
+///
+/// io_scheduler shares the background i/o bandwidth of the node between the i/o classes and
+/// the disks, which is disabled unless [io_scheduler] enable_io_scheduler is true:
+///
+///   - the node-wide cap, starting at [io_scheduler] io_max_rate_mb, is shared by the classes
+///     active in the last adjust interval in proportion to their weights
+///     ([io_scheduler] io_<class>_weight), so an idle class leaves its share to the others;
+///   - each registered disk is additionally limited to [io_scheduler] io_disk_rate_mb;
+///   - every [io_scheduler] io_adjust_interval_ms, the cap is halved (to no less than
+///     [io_scheduler] io_min_rate_mb) if the observed foreground write latency is above
+///     [io_scheduler] io_foreground_latency_target_ms, otherwise increased by 1/10 of
+///     io_max_rate_mb.
+///
+/// The existing per-component limits (nfs max_copy_rate_megabytes, fds_*_limit_rate, ...)
+/// are still applied, the scheduler only adds a node-wide limit on top of them.
+///
+class io_scheduler : public utils::singleton<io_scheduler>
+{
+public:
+    io_scheduler();
+
+    // block until `bytes` of i/o of `cls` on the disk containing `local_path` is allowed,
+    // `local_path` can be empty if the disk is unknown
+    void consume(io_class cls, const std::string &local_path, uint64_t bytes);
+
+    // reserve `bytes` of i/o without blocking, return the milliseconds that the caller should
+    // wait before issuing the i/o
+    uint64_t reserve(io_class cls, const std::string &local_path, uint64_t bytes);
+
+    // register a disk whose root directory is `dir`
+    void register_disk(const std::string &tag, const std::string &dir);
+
+    // record the latency of a foreground write
+    void observe_foreground_latency(uint64_t latency_ns);
+
+    // the current node-wide cap in bytes per second
+    double cap() const { return _cap.load(std::memory_order_relaxed); }
+    // the current rate of `cls` in bytes per second
+    double rate(io_class cls) const;
+
+    std::string get_info() const;
+
+private:
+    friend class io_scheduler_test;
+
+    struct class_state
+    {
+        folly::DynamicTokenBucket bucket;
+        std::atomic<double> rate{0};
+        std::atomic<uint64_t> last_active_ms{0};
+    };
+
+    struct disk_state
+    {
+        std::string tag;
+        std::string dir;
+        folly::DynamicTokenBucket bucket;
+    };
+
+    // return the seconds to wait
+    double reserve_seconds(io_class cls, const std::string &local_path, uint64_t bytes);
+    disk_state *find_disk(const std::string &local_path);
+    void try_adjust(uint64_t now_ms);
+    void adjust(uint64_t now_ms);
+
+    class_state _classes[static_cast<int>(io_class::COUNT)];
+    std::atomic<double> _cap;
+    std::atomic<uint64_t> _next_adjust_ms{0};
+
+    // the moving average of the foreground write latency, and the time of the last sample
+    std::atomic<uint64_t> _foreground_latency_ns{0};
+    std::atomic<uint64_t> _last_foreground_sample_ms{0};
+
+    mutable utils::rw_lock_nr _disks_lock; // protect _disks
+    std::vector<std::unique_ptr<disk_state>> _disks;
+};
+
+} // namespace dsn
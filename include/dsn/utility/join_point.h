@@ -42,7 +42,9 @@ namespace dsn {
 class join_point_base
 {
 public:
-    join_point_base(const char *name);
+    // `hook_mask` is optional, in which `hook_bit` is set whenever the join point has any advice,
+    // so that the owner is able to test all its join points at once
+    join_point_base(const char *name, uint32_t *hook_mask = nullptr, uint32_t hook_bit = 0);
 
     bool put_front(void *fn, const char *name, bool is_native = false);
     bool put_back(void *fn, const char *name, bool is_native = false);
@@ -52,6 +54,7 @@ public:
     bool put_replace(const char *base, void *fn, const char *name);
 
     const char *name() const { return _name.c_str(); }
+    bool empty() const { return _hdr.next == &_hdr; }
 
 protected:
     struct advice_entry
@@ -69,6 +72,10 @@ protected:
 private:
     advice_entry *new_entry(void *fn, const char *name, bool is_native);
     advice_entry *get_by_name(const char *name);
+    void update_hook_mask();
+
+    uint32_t *_hook_mask;
+    uint32_t _hook_bit;
 };
 
 struct join_point_unused_type
@@ -89,7 +96,10 @@ public:
     typedef void (*advice_prototype)(T1, T2, T3);
 
 public:
-    join_point(const char *name) : join_point_base(name) {}
+    join_point(const char *name, uint32_t *hook_mask = nullptr, uint32_t hook_bit = 0)
+        : join_point_base(name, hook_mask, hook_bit)
+    {
+    }
     bool put_native(point_prototype point)
     {
         return join_point_base::put_front((void *)point, "native", true);
@@ -139,7 +149,10 @@ public:
     typedef void (*advice_prototype)(T1, T2, T3);
 
 public:
-    join_point(const char *name) : join_point_base(name) {}
+    join_point(const char *name, uint32_t *hook_mask = nullptr, uint32_t hook_bit = 0)
+        : join_point_base(name, hook_mask, hook_bit)
+    {
+    }
     bool put_native(point_prototype point)
     {
         return join_point_base::put_front((void *)point, "native", true);
@@ -187,7 +200,10 @@ public:
     typedef void (*advice_prototype)(T1, T2);
 
 public:
-    join_point(const char *name) : join_point_base(name) {}
+    join_point(const char *name, uint32_t *hook_mask = nullptr, uint32_t hook_bit = 0)
+        : join_point_base(name, hook_mask, hook_bit)
+    {
+    }
     bool put_native(point_prototype point)
     {
         return join_point_base::put_front((void *)point, "native", true);
@@ -237,7 +253,10 @@ public:
     typedef void (*advice_prototype)(T1, T2);
 
 public:
-    join_point(const char *name) : join_point_base(name) {}
+    join_point(const char *name, uint32_t *hook_mask = nullptr, uint32_t hook_bit = 0)
+        : join_point_base(name, hook_mask, hook_bit)
+    {
+    }
     bool put_native(point_prototype point)
     {
         return join_point_base::put_front((void *)point, "native", true);
@@ -286,7 +305,10 @@ public:
     typedef void (*advice_prototype)(T1);
 
 public:
-    join_point(const char *name) : join_point_base(name) {}
+    join_point(const char *name, uint32_t *hook_mask = nullptr, uint32_t hook_bit = 0)
+        : join_point_base(name, hook_mask, hook_bit)
+    {
+    }
     bool put_native(point_prototype point)
     {
         return join_point_base::put_front((void *)point, "native", true);
@@ -336,7 +358,10 @@ public:
     typedef void (*advice_prototype)(T1);
 
 public:
-    join_point(const char *name) : join_point_base(name) {}
+    join_point(const char *name, uint32_t *hook_mask = nullptr, uint32_t hook_bit = 0)
+        : join_point_base(name, hook_mask, hook_bit)
+    {
+    }
     bool put_native(point_prototype point)
     {
         return join_point_base::put_front((void *)point, "native", true);
@@ -385,7 +410,10 @@ public:
     typedef void (*advice_prototype)();
 
 public:
-    join_point(const char *name) : join_point_base(name) {}
+    join_point(const char *name, uint32_t *hook_mask = nullptr, uint32_t hook_bit = 0)
+        : join_point_base(name, hook_mask, hook_bit)
+    {
+    }
     bool put_native(point_prototype point)
     {
         return join_point_base::put_front((void *)point, "native", true);
@@ -436,7 +464,10 @@ public:
     typedef void (*advice_prototype)();
 
 public:
-    join_point(const char *name) : join_point_base(name) {}
+    join_point(const char *name, uint32_t *hook_mask = nullptr, uint32_t hook_bit = 0)
+        : join_point_base(name, hook_mask, hook_bit)
+    {
+    }
     bool put_native(point_prototype point)
     {
         return join_point_base::put_front((void *)point, "native", true);
@@ -0,0 +1,45 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace dsn {
+namespace utils {
+
+///
+/// The numa topology of the host, which is read from sysfs:
+///
+///   /sys/devices/system/node/node<k>/cpulist
+///   /sys/class/net/<interface>/device/numa_node
+///
+/// A host without numa support is regarded as one numa node with all the cpus.
+///
+
+/// return the count of numa nodes, at least 1
+int numa_node_count();
+
+/// get the cpus of a numa node, return false if the node is not found
+bool numa_node_cpus(int node, /*out*/ std::vector<int> &cpus);
+
+/// return the numa node which the network interface is attached to, or -1 if unknown
+int numa_node_of_net_interface(const char *network_interface);
+
+/// bind the current thread to the cpus of a numa node, return false if failed
+bool bind_thread_to_numa_node(int node);
+
+/// parse a cpu list like "0-3,8,10-11", return false if it is malformed
+bool parse_cpu_list(const std::string &cpu_list, /*out*/ std::vector<int> &cpus);
+
+/// the numa node of the worker `index` when `worker_count` workers are split evenly and
+/// contiguously across `node_count` nodes
+inline int numa_node_of_worker(int index, int worker_count, int node_count)
+{
+    return worker_count <= 0 ? 0 : index * node_count / worker_count;
+}
+
+} // namespace utils
+} // namespace dsn
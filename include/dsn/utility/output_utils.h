@@ -156,8 +156,8 @@ private:
     template <typename Writer>
     void output_in_json(std::ostream &out) const
     {
-        rapidjson::OStreamWrapper wrapper(out);
-        Writer writer(wrapper);
+        dsn::json::json_output_stream stream(out);
+        Writer writer(stream);
         writer.StartObject();
         json_encode(writer, *this);
         writer.EndObject();
@@ -220,8 +220,8 @@ private:
     template <typename Writer>
     void output_in_json(std::ostream &out) const
     {
-        rapidjson::OStreamWrapper wrapper(out);
-        Writer writer(wrapper);
+        dsn::json::json_output_stream stream(out);
+        Writer writer(stream);
         writer.StartObject();
         for (const auto &tp : _tps) {
             json_encode(writer, tp);
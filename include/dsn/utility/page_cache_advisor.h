@@ -0,0 +1,56 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace dsn {
+namespace utils {
+
+///
+/// page_cache_advisor hints the kernel with posix_fadvise(2) about a file read once from the
+/// beginning to the end by the background i/o, such as serving a learner or replaying a log:
+///
+///   - readahead: the next `readahead_bytes` after the reading are asked to be read ahead;
+///   - drop-behind: the pages are dropped from the page cache once the reading goes past them,
+///     but only those which weren't cached before the reading, so that the large reads don't
+///     evict the hot pages of the others (e.g. the storage engine, whose files may be hard
+///     linked by the checkpoints being read), and the pages cached by others aren't dropped.
+///
+/// It's thread-safe. The file must be kept open until the advisor is destroyed, on which the
+/// pages read are all dropped if drop-behind is enabled.
+///
+class page_cache_advisor
+{
+public:
+    page_cache_advisor(int fd, uint64_t readahead_bytes, bool drop_behind);
+    ~page_cache_advisor();
+
+    // called before [offset, offset + length) is read
+    void on_read(uint64_t offset, uint64_t length);
+
+    // the ranges of [offset, offset + length) which aren't in the page cache, in pages
+    static std::vector<std::pair<uint64_t, uint64_t>>
+    uncached_ranges(int fd, uint64_t offset, uint64_t length);
+
+private:
+    void drop_before(uint64_t offset);
+
+    const int _fd;
+    const uint64_t _readahead_bytes;
+    const bool _drop_behind;
+
+    std::mutex _lock;
+    // the file has been advised up to this offset
+    uint64_t _advised_offset;
+    // the ranges to be dropped once read, in the order of the offset
+    std::vector<std::pair<uint64_t, uint64_t>> _to_drop;
+};
+
+} // namespace utils
+} // namespace dsn
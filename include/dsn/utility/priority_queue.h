@@ -36,6 +36,7 @@
 #pragma once
 
 #include <queue>
+#include <vector>
 #include <cassert>
 #include <dsn/utility/synchronize.h>
 
@@ -63,6 +64,20 @@ public:
         }
     }
 
+    // enqueue the objects under one lock, `get_priority` returns the priority of an object
+    template <typename TGetPriority>
+    long enqueue_batch(const std::vector<T> &objs, TGetPriority get_priority)
+    {
+        auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+        for (const T &obj : objs) {
+            uint32_t priority = get_priority(obj);
+            assert(priority >= 0 && priority < priority_count); // "wrong priority");
+            _items[priority].push(obj);
+        }
+        _count += static_cast<long>(objs.size());
+        return _count;
+    }
+
     virtual T dequeue()
     {
         auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
@@ -130,6 +145,15 @@ public:
         return r;
     }
 
+    // the waiters are signaled once for all the objects
+    template <typename TGetPriority>
+    long enqueue_batch(const std::vector<T> &objs, TGetPriority get_priority)
+    {
+        auto r = priority_queue<T, priority_count, TQueue>::enqueue_batch(objs, get_priority);
+        _sema.signal(static_cast<int>(objs.size()));
+        return r;
+    }
+
     T dequeue_with_timeout(/*out*/ long &ct, int milliseconds)
     {
         if (!_sema.wait(milliseconds)) {
@@ -24,6 +24,14 @@ int pipe_execute(const char *command, std::ostream &output);
 ///
 void process_mem_usage(double &vm_usage, double &resident_set);
 
+///
+/// the memory limit in bytes of the cgroup this process is in, read from cgroup v2
+/// (memory.max) or v1 (memory/memory.limit_in_bytes).
+///
+/// On failure or if the memory is unlimited, returns -1
+///
+int64_t cgroup_memory_limit();
+
 ///
 /// get the thread id.
 /// for best performance, we cache the tid value
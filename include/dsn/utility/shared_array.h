@@ -0,0 +1,93 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace dsn {
+namespace utils {
+
+namespace shared_array_internal {
+
+// allocates the control block of a std::shared_ptr along with `extra` bytes behind it, the
+// address of which is returned by `tail`
+template <typename T>
+class tail_allocator
+{
+public:
+    typedef T value_type;
+
+    tail_allocator(size_t extra, size_t align, char **tail)
+        : _extra(extra), _align(align), _tail(tail)
+    {
+    }
+
+    template <typename U>
+    tail_allocator(const tail_allocator<U> &other)
+        : _extra(other._extra), _align(other._align), _tail(other._tail)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        size_t head = (n * sizeof(T) + _align - 1) / _align * _align;
+        char *p = static_cast<char *>(::operator new(head + _extra));
+        *_tail = p + head;
+        return reinterpret_cast<T *>(p);
+    }
+
+    void deallocate(T *p, size_t) { ::operator delete(p); }
+
+    // any of them can deallocate the blocks allocated by the others
+    template <typename U>
+    bool operator==(const tail_allocator<U> &) const
+    {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const tail_allocator<U> &other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    template <typename U>
+    friend class tail_allocator;
+
+    size_t _extra;
+    size_t _align;
+    char **_tail;
+};
+
+template <typename T>
+std::shared_ptr<T> make_shared_array(size_t size, std::true_type /*trivial*/)
+{
+    // the array and the reference count are allocated in a single block, rather than in one
+    // block each, the array is left uninitialized like `new T[size]`
+    char *tail = nullptr;
+    std::shared_ptr<char> holder = std::allocate_shared<char>(
+        tail_allocator<char>(sizeof(T) * size, alignof(T), &tail));
+    return std::shared_ptr<T>(holder, reinterpret_cast<T *>(tail));
+}
+
+template <typename T>
+std::shared_ptr<T> make_shared_array(size_t size, std::false_type /*trivial*/)
+{
+    return std::shared_ptr<T>(new T[size], std::default_delete<T[]>());
+}
+
+} // namespace shared_array_internal
+
+template <typename T>
+std::shared_ptr<T> make_shared_array(size_t size)
+{
+    return shared_array_internal::make_shared_array<T>(size, std::is_trivial<T>());
+}
+
+} // namespace utils
+} // namespace dsn
@@ -84,9 +84,50 @@ void tls_trans_mem_commit(size_t use_size);
 // allocate a blob, the size is "sz"
 blob tls_trans_mem_alloc_blob(size_t sz);
 
+// the memory piece [ptr, ptr + sz) acquired by "tls_trans_mem_next" as a blob, which shares
+// the current block. if "bb" ends right before "ptr" in the current block, "bb" is extended to
+// cover the piece and true is returned, so that the pieces acquired one after another are kept
+// in one contiguous blob. otherwise "bb" is assigned with the piece and false is returned.
+bool tls_trans_mem_extend_blob(blob &bb, const void *ptr, size_t sz);
+
 // allocate memory
 void *tls_trans_malloc(size_t sz);
 
 // free memory, ptr shouldn't be null
 void tls_trans_free(void *ptr);
+
+/// tls pool is a thread local, size-classed cache of the small objects which are frequently
+/// allocated and freed, such as message_ex, message_header and tasks.
+///
+/// each memory piece is allocated by "malloc" with a small header recording its size class,
+/// when freed it is pushed into the free list of its size class in the tls cache of the
+/// freeing thread (unless the cache is full), so that the next allocation of the same size class
+/// on this thread needn't call "malloc". pieces larger than the largest size class are always
+/// allocated and freed by "malloc"/"free".
+///
+/// the pool can be disabled (e.g. for ASAN runs) by tls_pool_init, then all the pieces are
+/// allocated and freed by "malloc"/"free" directly.
+
+// should call this at the beginning of the process, "max_cached_bytes_per_thread" limits
+// the bytes cached in each thread
+void tls_pool_init(bool enabled, size_t max_cached_bytes_per_thread);
+
+bool tls_pool_enabled();
+
+// allocate memory from the tls pool
+void *tls_pool_malloc(size_t sz);
+
+// free memory allocated by tls_pool_malloc, ptr shouldn't be null
+void tls_pool_free(void *ptr);
+
+struct tls_pool_stats
+{
+    uint64_t hit_count;    // allocations served by the cache
+    uint64_t miss_count;   // allocations served by malloc
+    uint64_t cached_count; // pieces in the caches of all threads
+    uint64_t cached_bytes; // bytes in the caches of all threads
+};
+
+// stats of all the threads, including the exited threads for hit/miss count
+tls_pool_stats tls_pool_get_stats();
 }
@@ -39,6 +39,7 @@
 #include <memory>
 
 #include <dsn/tool-api/rpc_address.h>
+#include <dsn/utility/shared_array.h>
 #include <dsn/utility/string_view.h>
 
 #define TIME_MS_MAX 0xffffffff
@@ -46,12 +47,6 @@
 namespace dsn {
 namespace utils {
 
-template <typename T>
-std::shared_ptr<T> make_shared_array(size_t size)
-{
-    return std::shared_ptr<T>(new T[size], std::default_delete<T[]>());
-}
-
 // get host name from ip series
 // if can't get a hostname from ip(maybe no hostname or other errors), return false, and
 // hostname_result will be invalid value
@@ -37,6 +37,7 @@
 
 #include <dsn/utility/synchronize.h>
 #include <dsn/utility/link.h>
+#include <atomic>
 #include <cassert>
 
 namespace dsn {
@@ -106,4 +107,97 @@ private:
 protected:
     slist<T> _hdr;
 };
+
+//
+// A lock-free work queue running one workload at a time, to which the works are added by many
+// threads. The added works are pushed onto a lock-free stack, and the thread adding the first
+// work when the queue is idle owns the queue, who unlinks the next workload, and keeps owning it
+// until the workloads are all completed. Only the owner touches `_hdr`, so that the works can be
+// merged by unlink_next_workload() at dequeue time without any lock.
+//
+template <typename T>
+class mpsc_work_queue
+{
+public:
+    mpsc_work_queue() : _pushed(nullptr), _work_count(0), _running_count(0) {}
+
+    ~mpsc_work_queue()
+    {
+        assert(_work_count.load() == 0);
+        //"work queue is deleted when there are still running ops or pending work items in queue"
+    }
+
+    // return not-null for what's to be run next
+    T *add_work(T *dl, void *ctx)
+    {
+        T *head = _pushed.load(std::memory_order_relaxed);
+        do {
+            dl->next = head;
+        } while (!_pushed.compare_exchange_weak(
+            head, dl, std::memory_order_release, std::memory_order_relaxed));
+
+        // the work is counted after it's pushed, so it's visible to the owner
+        if (_work_count.fetch_add(1, std::memory_order_acq_rel) != 0) {
+            return nullptr;
+        }
+        return next_workload(ctx);
+    }
+
+    // called when the current workload is completed, which returns the next workload if any,
+    // otherwise the ownership is released
+    T *on_work_completed(T *running, void *ctx)
+    {
+        int completed = _running_count;
+        if (_work_count.fetch_sub(completed, std::memory_order_acq_rel) == completed) {
+            return nullptr;
+        }
+        return next_workload(ctx);
+    }
+
+protected:
+    // only called by the owner
+    virtual T *unlink_next_workload(void *ctx) { return _hdr.pop_one(); }
+
+    slist<T> _hdr;
+
+private:
+    T *next_workload(void *ctx)
+    {
+        // move the pushed works to `_hdr` in the order they are added
+        T *pushed = _pushed.exchange(nullptr, std::memory_order_acquire);
+        T *reversed = nullptr;
+        while (pushed != nullptr) {
+            T *next = static_cast<T *>(pushed->next);
+            pushed->next = reversed;
+            reversed = pushed;
+            pushed = next;
+        }
+        if (reversed != nullptr) {
+            T *tail = reversed;
+            while (tail->next != nullptr) {
+                tail = static_cast<T *>(tail->next);
+            }
+            if (_hdr._last != nullptr) {
+                _hdr._last->next = reversed;
+            } else {
+                _hdr._first = reversed;
+            }
+            _hdr._last = tail;
+        }
+
+        T *workload = unlink_next_workload(ctx);
+        assert(workload != nullptr);
+        _running_count = 0;
+        for (T *t = workload; t != nullptr; t = static_cast<T *>(t->next)) {
+            ++_running_count;
+        }
+        return workload;
+    }
+
+    std::atomic<T *> _pushed;
+    // the works added and not completed yet
+    std::atomic<int> _work_count;
+    // the works in the running workload, only accessed by the owner
+    int _running_count;
+};
 }
\ No newline at end of file
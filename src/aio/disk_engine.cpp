@@ -24,12 +24,19 @@
  * THE SOFTWARE.
  */
 
+#include <dsn/c/api_layer1.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/tool-api/aio_task.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include "disk_engine.h"
 #include "sim_aio_provider.h"
+#include "io_uring_aio_provider.h"
 #include "core/core/service_engine.h"
 
+#include <algorithm>
+#include <limits.h>
+
 using namespace dsn::utils;
 
 namespace dsn {
@@ -37,9 +44,23 @@ using namespace aio;
 
 DEFINE_TASK_CODE_AIO(LPC_AIO_BATCH_WRITE, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
 
+DSN_DEFINE_uint32("core",
+                  aio_max_write_batch_bytes,
+                  1024 * 1024,
+                  "the max size of the contiguous writes to a file merged into one write");
+DSN_TAG_VARIABLE(aio_max_write_batch_bytes, FT_MUTABLE);
+DSN_DEFINE_bool("core",
+                aio_per_disk_enabled,
+                false,
+                "whether the files on each data dir are served by an aio provider of their own, "
+                "with its own aio context, queue depth and completion thread, so that a slow or "
+                "failing disk doesn't delay the aios on the others; it takes effect on the files "
+                "opened after the replica server starts");
+
 const char *native_aio_provider = "dsn::tools::native_aio_provider";
 DSN_REGISTER_COMPONENT_PROVIDER(native_linux_aio_provider, native_aio_provider);
 DSN_REGISTER_COMPONENT_PROVIDER(sim_aio_provider, "dsn::tools::sim_aio_provider");
+DSN_REGISTER_COMPONENT_PROVIDER(io_uring_aio_provider, "dsn::tools::io_uring_aio_provider");
 
 //----------------- disk_file ------------------------
 aio_task *disk_write_queue::unlink_next_workload(void *plength)
@@ -56,7 +77,8 @@ aio_task *disk_write_queue::unlink_next_workload(void *plength)
             next_offset = io->file_offset + sz;
         } else {
             // batch condition
-            if (next_offset == io->file_offset && sz + io->buffer_size <= _max_batch_bytes) {
+            if (next_offset == io->file_offset &&
+                sz + io->buffer_size <= FLAGS_aio_max_write_batch_bytes) {
                 sz += io->buffer_size;
                 next_offset += io->buffer_size;
             }
@@ -83,7 +105,16 @@ aio_task *disk_write_queue::unlink_next_workload(void *plength)
     return first;
 }
 
-disk_file::disk_file(dsn_handle_t handle) : _handle(handle) {}
+aio_disk::aio_disk()
+{
+    for (auto &c : aio_latency_counts) {
+        c.store(0, std::memory_order_relaxed);
+    }
+}
+
+disk_file::disk_file(dsn_handle_t handle, aio_disk *disk) : _handle(handle), _disk(disk) {}
+
+aio_provider &disk_file::provider() const { return disk_engine::provider(_disk); }
 
 aio_task *disk_file::read(aio_task *tsk)
 {
@@ -144,7 +175,12 @@ aio_task *disk_file::on_write_completed(aio_task *wk, void *ctx, error_code err,
 disk_engine::disk_engine()
 {
     _node = service_engine::instance().get_all_nodes().begin()->second.get();
+    _default_disk.tag = "default";
+    _default_disk.provider.reset(create_provider());
+}
 
+aio_provider *disk_engine::create_provider()
+{
     aio_provider *provider = utils::factory_store<aio_provider>::create(
         FLAGS_aio_factory_name, dsn::PROVIDER_TYPE_MAIN, this);
     // use native_aio_provider in default
@@ -154,7 +190,85 @@ disk_engine::disk_engine()
         provider = utils::factory_store<aio_provider>::create(
             native_aio_provider, dsn::PROVIDER_TYPE_MAIN, this);
     }
-    _provider.reset(provider);
+    return provider;
+}
+
+void disk_engine::register_disk(const std::string &tag, const std::string &dir)
+{
+    utils::auto_write_lock l(_disks_lock);
+    for (const auto &d : _disks) {
+        if (d->dir == dir) {
+            return;
+        }
+    }
+
+    std::unique_ptr<aio_disk> d(new aio_disk());
+    d->tag = tag;
+    d->dir = dir;
+    if (FLAGS_aio_per_disk_enabled) {
+        d->provider.reset(create_provider());
+    }
+    d->aio_latency_ns.init_app_counter(
+        "eon.disk_engine",
+        fmt::format("aio_latency_ns.{}", tag).c_str(),
+        COUNTER_TYPE_NUMBER_PERCENTILES,
+        fmt::format("latency of the aios on disk {}, from submitted to completed", tag).c_str());
+    d->aio_count.init_app_counter("eon.disk_engine",
+                                  fmt::format("aio_count.{}", tag).c_str(),
+                                  COUNTER_TYPE_RATE,
+                                  fmt::format("aio count on disk {} per second", tag).c_str());
+    d->aio_fail_count.init_app_counter(
+        "eon.disk_engine",
+        fmt::format("aio_fail_count.{}", tag).c_str(),
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        fmt::format("failed aio count on disk {} in the recent period", tag).c_str());
+    ddebug_f("the files under {} are served by the aio provider of {}",
+             dir,
+             FLAGS_aio_per_disk_enabled ? "disk " + tag : std::string("default"));
+    _disks.emplace_back(std::move(d));
+}
+
+bool disk_engine::get_aio_latency_counts(const std::string &tag,
+                                         /*out*/ std::vector<uint64_t> &counts)
+{
+    utils::auto_read_lock l(_disks_lock);
+    for (const auto &d : _disks) {
+        if (d->tag == tag) {
+            counts.resize(file::AIO_LATENCY_BUCKET_COUNT);
+            for (int i = 0; i < file::AIO_LATENCY_BUCKET_COUNT; ++i) {
+                counts[i] = d->aio_latency_counts[i].load(std::memory_order_relaxed);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+aio_disk *disk_engine::find_disk(const char *path)
+{
+    {
+        utils::auto_read_lock l(_disks_lock);
+        if (_disks.empty()) {
+            return &_default_disk;
+        }
+    }
+
+    std::string abs_path;
+    if (!utils::filesystem::get_absolute_path(path, abs_path)) {
+        return &_default_disk;
+    }
+
+    // the disk with the longest matched dir
+    aio_disk *found = &_default_disk;
+    utils::auto_read_lock l(_disks_lock);
+    for (const auto &d : _disks) {
+        if (abs_path.compare(0, d->dir.size(), d->dir) == 0 &&
+            (abs_path.size() == d->dir.size() || abs_path[d->dir.size()] == '/') &&
+            d->dir.size() > found->dir.size()) {
+            found = d.get();
+        }
+    }
+    return found;
 }
 
 class batch_write_io_task : public aio_task
@@ -170,6 +284,11 @@ public:
         auto df = (disk_file *)_tasks->get_aio_context()->file_object;
         uint32_t sz;
 
+        for (auto t = _tasks; t != nullptr; t = (aio_task *)t->next) {
+            t->get_aio_context()->submit_time_ns = get_aio_context()->submit_time_ns;
+            t->get_aio_context()->complete_time_ns = get_aio_context()->complete_time_ns;
+        }
+
         auto wk = df->on_write_completed(_tasks, (void *)&sz, error(), get_transferred_size());
         if (wk) {
             wk->get_aio_context()->engine->process_write(wk, sz);
@@ -193,6 +312,7 @@ void disk_engine::write(aio_task *aio)
     dio->file_object = df;
     dio->engine = this;
     dio->type = AIO_Write;
+    dio->issue_time_ns = dsn_now_ns();
 
     uint32_t sz;
     auto wk = df->write(aio, &sz);
@@ -208,14 +328,16 @@ void disk_engine::process_write(aio_task *aio, uint32_t sz)
     // no batching
     if (dio->buffer_size == sz) {
         if (dio->buffer == nullptr) {
-            if (dio->support_write_vec) {
+            // writev accepts at most IOV_MAX buffers
+            if (dio->support_write_vec && aio->_unmerged_write_buffers.size() <= IOV_MAX) {
                 dio->write_buffer_vec = &aio->_unmerged_write_buffers;
             } else {
                 aio->collapse();
             }
         }
         dassert(dio->buffer || dio->write_buffer_vec, "");
-        _provider->submit_aio_task(aio);
+        dio->submit_time_ns = dsn_now_ns();
+        static_cast<disk_file *>(dio->file_object)->provider().submit_aio_task(aio);
     }
 
     // batching
@@ -233,6 +355,7 @@ void disk_engine::process_write(aio_task *aio, uint32_t sz)
         auto cur_task = aio;
         do {
             auto cur_dio = cur_task->get_aio_context();
+            new_dio->sync_after_write |= cur_dio->sync_after_write;
             if (cur_dio->buffer) {
                 dsn_file_buffer_t buf;
                 buf.buffer = cur_dio->buffer;
@@ -253,6 +376,24 @@ void disk_engine::process_write(aio_task *aio, uint32_t sz)
 
 void disk_engine::complete_io(aio_task *aio, error_code err, uint32_t bytes, int delay_milliseconds)
 {
+    aio_context *dio = aio->get_aio_context();
+    dio->complete_time_ns = dsn_now_ns();
+    aio_disk *disk = static_cast<disk_file *>(dio->file_object)->disk();
+    if (disk->aio_count.get() != nullptr) {
+        disk->aio_count->increment();
+        if (dio->submit_time_ns > 0 && dio->complete_time_ns > dio->submit_time_ns) {
+            uint64_t latency_ns = dio->complete_time_ns - dio->submit_time_ns;
+            disk->aio_latency_ns->set(latency_ns);
+            uint64_t latency_us = latency_ns / 1000;
+            int bucket = latency_us == 0 ? 0 : 63 - __builtin_clzll(latency_us);
+            disk->aio_latency_counts[std::min(bucket, file::AIO_LATENCY_BUCKET_COUNT - 1)]
+                .fetch_add(1, std::memory_order_relaxed);
+        }
+        if (err != ERR_OK) {
+            disk->aio_fail_count->increment();
+        }
+    }
+
     if (err != ERR_OK) {
         dinfo("disk operation failure with code %s, err = %s, aio_task_id = %016" PRIx64,
               aio->spec().name.c_str(),
@@ -272,7 +413,8 @@ void disk_engine::complete_io(aio_task *aio, error_code err, uint32_t bytes, int
         if (aio->get_aio_context()->type == AIO_Read) {
             auto wk = df->on_read_completed(aio, err, (size_t)bytes);
             if (wk) {
-                _provider->submit_aio_task(wk);
+                wk->get_aio_context()->submit_time_ns = dsn_now_ns();
+                df->provider().submit_aio_task(wk);
             }
         }
 
@@ -28,30 +28,44 @@
 
 #include "aio_provider.h"
 
+#include <atomic>
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/tool-api/file_io.h>
 #include <dsn/utility/synchronize.h>
 #include <dsn/utility/work_queue.h>
 
 namespace dsn {
 
-class disk_write_queue : public work_queue<aio_task>
+// the contiguous writes are merged into one when dequeued, up to
+// [core] aio_max_write_batch_bytes
+class disk_write_queue : public mpsc_work_queue<aio_task>
 {
-public:
-    disk_write_queue() : work_queue(2)
-    {
-        _max_batch_bytes = 1024 * 1024; // 1 MB
-    }
-
 private:
     virtual aio_task *unlink_next_workload(void *plength) override;
+};
 
-private:
-    uint32_t _max_batch_bytes;
+// a disk registered by disk_engine::register_disk(), or the default one
+struct aio_disk
+{
+    aio_disk();
+
+    std::string tag;
+    std::string dir; // empty for the default one, which serves the files on no registered disk
+    // null if the files on the disk are served by the provider of the default one
+    std::unique_ptr<aio_provider> provider;
+
+    // not initialized for the default one
+    perf_counter_wrapper aio_latency_ns;
+    perf_counter_wrapper aio_count;
+    perf_counter_wrapper aio_fail_count;
+    // see file::get_disk_aio_latency_counts()
+    std::atomic<uint64_t> aio_latency_counts[file::AIO_LATENCY_BUCKET_COUNT];
 };
 
 class disk_file
 {
 public:
-    disk_file(dsn_handle_t handle);
+    disk_file(dsn_handle_t handle, aio_disk *disk);
     aio_task *read(aio_task *tsk);
     aio_task *write(aio_task *tsk, void *ctx);
 
@@ -60,9 +74,12 @@ public:
 
     // TODO(wutao1): make it uint64_t
     dsn_handle_t native_handle() const { return _handle; }
+    aio_disk *disk() const { return _disk; }
+    aio_provider &provider() const;
 
 private:
     dsn_handle_t _handle;
+    aio_disk *_disk; // where this file is opened
     disk_write_queue _write_queue;
     work_queue<aio_task> _read_queue;
 };
@@ -73,17 +90,38 @@ public:
     void write(aio_task *aio);
 
     service_node *node() const { return _node; }
-    static aio_provider &provider() { return *instance()._provider.get(); }
+    // the provider of the files on no registered disk
+    static aio_provider &provider() { return *instance()._default_disk.provider; }
+    // the provider serving the files on `disk`
+    static aio_provider &provider(const aio_disk *disk)
+    {
+        return disk->provider != nullptr ? *disk->provider : provider();
+    }
+
+    // the latencies of the aios on the files under `dir` are counted for the disk. if
+    // [core] aio_per_disk_enabled is true, the files are also served by an aio provider of their
+    // own, with its own aio context, queue depth and completion thread, so that a slow or
+    // failing disk doesn't delay the aios on the others.
+    void register_disk(const std::string &tag, const std::string &dir);
+
+    // see file::get_disk_aio_latency_counts()
+    bool get_aio_latency_counts(const std::string &tag, /*out*/ std::vector<uint64_t> &counts);
+
+    // the disk of the file at `path`, with the longest matched dir
+    aio_disk *find_disk(const char *path);
 
 private:
     // the object of disk_engine must be created by `singleton::instance`
     disk_engine();
     ~disk_engine() = default;
 
+    aio_provider *create_provider();
     void process_write(aio_task *wk, uint32_t sz);
     void complete_io(aio_task *aio, error_code err, uint32_t bytes, int delay_milliseconds = 0);
 
-    std::unique_ptr<aio_provider> _provider;
+    aio_disk _default_disk;
+    utils::rw_lock_nr _disks_lock; // protect _disks
+    std::vector<std::unique_ptr<aio_disk>> _disks;
     service_node *_node;
 
     friend class aio_provider;
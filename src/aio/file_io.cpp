@@ -33,9 +33,10 @@ namespace file {
 
 /*extern*/ disk_file *open(const char *file_name, int flag, int pmode)
 {
-    dsn_handle_t nh = disk_engine::provider().open(file_name, flag, pmode);
+    aio_disk *disk = disk_engine::instance().find_disk(file_name);
+    dsn_handle_t nh = disk_engine::provider(disk).open(file_name, flag, pmode);
     if (nh != DSN_INVALID_FILE_HANDLE) {
-        return new disk_file(nh);
+        return new disk_file(nh, disk);
     } else {
         return nullptr;
     }
@@ -44,7 +45,7 @@ namespace file {
 /*extern*/ error_code close(disk_file *file)
 {
     if (nullptr != file) {
-        auto ret = disk_engine::provider().close(file->native_handle());
+        auto ret = file->provider().close(file->native_handle());
         delete file;
         return ret;
     } else {
@@ -55,12 +56,17 @@ namespace file {
 /*extern*/ error_code flush(disk_file *file)
 {
     if (nullptr != file) {
-        return disk_engine::provider().flush(file->native_handle());
+        return file->provider().flush(file->native_handle());
     } else {
         return ERR_INVALID_HANDLE;
     }
 }
 
+/*extern*/ int native_fd(disk_file *file)
+{
+    return nullptr != file ? static_cast<int>((uintptr_t)file->native_handle()) : -1;
+}
+
 /*extern*/ aio_task_ptr read(disk_file *file,
                              char *buffer,
                              int count,
@@ -85,7 +91,8 @@ namespace file {
     }
     auto wk = file->read(cb);
     if (wk) {
-        disk_engine::provider().submit_aio_task(wk);
+        wk->get_aio_context()->submit_time_ns = dsn_now_ns();
+        file->provider().submit_aio_task(wk);
     }
     return cb;
 }
@@ -117,12 +124,14 @@ namespace file {
                                      task_code callback_code,
                                      task_tracker *tracker,
                                      aio_handler &&callback,
-                                     int hash /*= 0*/)
+                                     int hash /*= 0*/,
+                                     bool sync_after_write /*= false*/)
 {
     auto cb = create_aio_task(callback_code, tracker, std::move(callback), hash);
     cb->get_aio_context()->file = file;
     cb->get_aio_context()->file_offset = offset;
     cb->get_aio_context()->type = AIO_Write;
+    cb->get_aio_context()->sync_after_write = sync_after_write;
     for (int i = 0; i < buffer_count; i++) {
         if (buffers[i].size > 0) {
             cb->_unmerged_write_buffers.push_back(buffers[i]);
@@ -136,7 +145,19 @@ namespace file {
 
 /*extern*/ aio_context_ptr prepare_aio_context(aio_task *tsk)
 {
+    // the providers of all the disks are of the same type
     return disk_engine::provider().prepare_aio_context(tsk);
 }
+
+/*extern*/ void register_disk(const std::string &tag, const std::string &dir)
+{
+    disk_engine::instance().register_disk(tag, dir);
+}
+
+/*extern*/ bool get_disk_aio_latency_counts(const std::string &tag,
+                                            /*out*/ std::vector<uint64_t> &counts)
+{
+    return disk_engine::instance().get_aio_latency_counts(tag, counts);
+}
 } // namespace file
 } // namespace dsn
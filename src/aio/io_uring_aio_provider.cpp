@@ -0,0 +1,489 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "io_uring_aio_provider.h"
+#include "core/task/task_engine.h"
+
+#include <dsn/utility/flags.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace dsn {
+
+DSN_DEFINE_uint32("core",
+                  io_uring_queue_depth,
+                  256,
+                  "entry count of the io_uring submission queue of io_uring_aio_provider");
+DSN_DEFINE_uint32("core",
+                  io_uring_registered_files,
+                  1024,
+                  "max count of files registered to io_uring, 0 means not to register files");
+
+namespace {
+
+// the ctx of a write linked with fdatasync is tagged on the lowest bit in the user_data
+// of the write sqe, the ctx pointers are always aligned
+const uint64_t LINKED_WRITE_TAG = 1;
+
+int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+inline unsigned load_acquire(const unsigned *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+
+inline void store_release(unsigned *p, unsigned v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+} // anonymous namespace
+
+io_uring_aio_provider::io_uring_aio_provider(disk_engine *disk)
+    : aio_provider(disk), _sq_local_tail(0), _submitting(false), _inflight_cqes(0)
+{
+    setup_ring(std::max(FLAGS_io_uring_queue_depth, 2u));
+    register_files(FLAGS_io_uring_registered_files);
+
+    _is_running = true;
+    _worker = std::thread([this]() {
+        task::set_tls_dsn_context(node(), nullptr);
+        get_event();
+    });
+}
+
+io_uring_aio_provider::~io_uring_aio_provider()
+{
+    if (!_is_running) {
+        return;
+    }
+    _is_running = false;
+
+    // wake up the completion thread by a nop
+    _lock.lock();
+    _pending_ios.push_back(nullptr);
+    submit_pending_ios();
+    _lock.unlock();
+    _worker.join();
+
+    munmap(_sqes, _sqes_size);
+    if (_cq_ring != _sq_ring) {
+        munmap(_cq_ring, _cq_ring_size);
+    }
+    munmap(_sq_ring, _sq_ring_size);
+    ::close(_ring_fd);
+}
+
+void io_uring_aio_provider::setup_ring(uint32_t entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    _ring_fd = sys_io_uring_setup(entries, &p);
+    dassert(_ring_fd >= 0,
+            "io_uring_setup error, err = %s, io_uring requires linux kernel 5.5+",
+            strerror(errno));
+
+    _sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    _cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+    }
+
+    _sq_ring = mmap(nullptr,
+                    _sq_ring_size,
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE,
+                    _ring_fd,
+                    IORING_OFF_SQ_RING);
+    dassert(_sq_ring != MAP_FAILED, "mmap sq ring failed, err = %s", strerror(errno));
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        _cq_ring = _sq_ring;
+    } else {
+        _cq_ring = mmap(nullptr,
+                        _cq_ring_size,
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE,
+                        _ring_fd,
+                        IORING_OFF_CQ_RING);
+        dassert(_cq_ring != MAP_FAILED, "mmap cq ring failed, err = %s", strerror(errno));
+    }
+
+    _sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    _sqes = (struct io_uring_sqe *)mmap(nullptr,
+                                        _sqes_size,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE,
+                                        _ring_fd,
+                                        IORING_OFF_SQES);
+    dassert(_sqes != MAP_FAILED, "mmap sqes failed, err = %s", strerror(errno));
+
+    char *sq = (char *)_sq_ring;
+    _sq_head = (unsigned *)(sq + p.sq_off.head);
+    _sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    _sq_array = (unsigned *)(sq + p.sq_off.array);
+    _sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+    _sq_entries = p.sq_entries;
+    _sq_local_tail = *_sq_tail;
+
+    char *cq = (char *)_cq_ring;
+    _cq_head = (unsigned *)(cq + p.cq_off.head);
+    _cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    _cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    _cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+    _cq_entries = p.cq_entries;
+
+    ddebug("io_uring is setup, sq_entries = %u, cq_entries = %u", _sq_entries, _cq_entries);
+}
+
+void io_uring_aio_provider::register_files(uint32_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    // register a sparse file set, the slots are updated on open/close
+    std::vector<int> files(count, -1);
+    if (sys_io_uring_register(_ring_fd, IORING_REGISTER_FILES, files.data(), count) != 0) {
+        dwarn("register files to io_uring failed, err = %s, files won't be registered",
+              strerror(errno));
+        return;
+    }
+
+    _registered_files = std::move(files);
+    for (int i = (int)count - 1; i >= 0; --i) {
+        _free_file_slots.push_back(i);
+    }
+}
+
+void io_uring_aio_provider::update_registered_file(int slot, int fd)
+{
+    struct io_uring_files_update up;
+    memset(&up, 0, sizeof(up));
+    up.offset = (uint32_t)slot;
+    up.fds = (uint64_t)(uintptr_t)&fd;
+    int ret = sys_io_uring_register(_ring_fd, IORING_REGISTER_FILES_UPDATE, &up, 1);
+    dassert(ret == 1,
+            "update registered file of io_uring failed, slot = %d, fd = %d, err = %s",
+            slot,
+            fd,
+            strerror(errno));
+}
+
+dsn_handle_t io_uring_aio_provider::open(const char *file_name, int flag, int pmode)
+{
+    int fd = ::open(file_name, flag, pmode);
+    if (fd < 0) {
+        derror("create file failed, err = %s", strerror(errno));
+        return DSN_INVALID_FILE_HANDLE;
+    }
+
+    int slot = -1;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        if (!_free_file_slots.empty()) {
+            slot = _free_file_slots.back();
+            _free_file_slots.pop_back();
+        }
+    }
+    if (slot >= 0) {
+        update_registered_file(slot, fd);
+
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        _registered_files[slot] = fd;
+        _file_slots[fd] = slot;
+    }
+    return (dsn_handle_t)(uintptr_t)fd;
+}
+
+error_code io_uring_aio_provider::close(dsn_handle_t fh)
+{
+    if (fh == DSN_INVALID_FILE_HANDLE) {
+        return ERR_OK;
+    }
+
+    int fd = (int)(uintptr_t)(fh);
+    int slot = -1;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        auto it = _file_slots.find(fd);
+        if (it != _file_slots.end()) {
+            slot = it->second;
+            _file_slots.erase(it);
+            _registered_files[slot] = -1;
+        }
+    }
+    if (slot >= 0) {
+        update_registered_file(slot, -1);
+
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        _free_file_slots.push_back(slot);
+    }
+
+    if (::close(fd) == 0) {
+        return ERR_OK;
+    } else {
+        derror("close file failed, err = %s", strerror(errno));
+        return ERR_FILE_OPERATION_FAILED;
+    }
+}
+
+error_code io_uring_aio_provider::flush(dsn_handle_t fh)
+{
+    if (fh == DSN_INVALID_FILE_HANDLE || ::fsync((int)(uintptr_t)(fh)) == 0) {
+        return ERR_OK;
+    } else {
+        derror("flush file failed, err = %s", strerror(errno));
+        return ERR_FILE_OPERATION_FAILED;
+    }
+}
+
+aio_context *io_uring_aio_provider::prepare_aio_context(aio_task *tsk)
+{
+    return new io_uring_aio_context(tsk);
+}
+
+void io_uring_aio_provider::submit_aio_task(aio_task *aio_tsk)
+{
+    auto ctx = (io_uring_aio_context *)aio_tsk->get_aio_context();
+    if (ctx->type != AIO_Read && ctx->type != AIO_Write) {
+        derror("unknown aio type %u", static_cast<int>(ctx->type));
+        complete_io(aio_tsk, ERR_FILE_OPERATION_FAILED, 0);
+        return;
+    }
+
+    ctx->iov.clear();
+    if (ctx->buffer || ctx->type == AIO_Read) {
+        ctx->iov.push_back({ctx->buffer, ctx->buffer_size});
+    } else {
+        for (const dsn_file_buffer_t &buf : *ctx->write_buffer_vec) {
+            ctx->iov.push_back({buf.buffer, (size_t)buf.size});
+        }
+    }
+    ctx->pending_cqes = cqe_count(ctx);
+
+    _lock.lock();
+    _pending_ios.push_back(ctx);
+    submit_pending_ios();
+    _lock.unlock();
+}
+
+void io_uring_aio_provider::submit_pending_ios()
+{
+    // only one thread submits at the same time, the IOs pushed by other threads meanwhile
+    // are submitted together in the next round
+    if (_submitting) {
+        return;
+    }
+    _submitting = true;
+
+    while (true) {
+        while (!_pending_ios.empty()) {
+            io_uring_aio_context *ctx = _pending_ios.front();
+            unsigned count = cqe_count(ctx);
+            // bound the in-flight IOs to avoid the overflow of completion queue
+            if (_inflight_cqes + count > _cq_entries ||
+                _sq_local_tail + count - load_acquire(_sq_head) > _sq_entries) {
+                break;
+            }
+            _pending_ios.pop_front();
+            _inflight_cqes += count;
+
+            if (ctx == nullptr) {
+                prepare_nop_sqe();
+            } else {
+                prepare_sqes(ctx);
+            }
+        }
+        store_release(_sq_tail, _sq_local_tail);
+
+        unsigned to_submit = _sq_local_tail - load_acquire(_sq_head);
+        if (to_submit == 0) {
+            break;
+        }
+
+        _lock.unlock();
+        int ret = sys_io_uring_enter(_ring_fd, to_submit, 0, 0);
+        if (ret < 0) {
+            dassert(errno == EINTR || errno == EAGAIN || errno == EBUSY,
+                    "io_uring_enter error, err = %s",
+                    strerror(errno));
+            std::this_thread::yield();
+        }
+        _lock.lock();
+    }
+
+    _submitting = false;
+}
+
+struct io_uring_sqe *io_uring_aio_provider::next_sqe()
+{
+    // the tail is published in submit_pending_ios after all the sqes are prepared
+    unsigned idx = (_sq_local_tail++) & _sq_mask;
+    _sq_array[idx] = idx;
+
+    struct io_uring_sqe *sqe = &_sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void io_uring_aio_provider::prepare_nop_sqe()
+{
+    struct io_uring_sqe *sqe = next_sqe();
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = 0;
+}
+
+void io_uring_aio_provider::prepare_sqes(io_uring_aio_context *ctx)
+{
+    int fd = static_cast<int>((ssize_t)ctx->file);
+    uint8_t flags = 0;
+    auto it = _file_slots.find(fd);
+    if (it != _file_slots.end()) {
+        fd = it->second;
+        flags |= IOSQE_FIXED_FILE;
+    }
+
+    struct io_uring_sqe *sqe = next_sqe();
+    sqe->opcode = (ctx->type == AIO_Read) ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->flags = flags;
+    sqe->fd = fd;
+    sqe->off = ctx->file_offset;
+    sqe->addr = (uint64_t)(uintptr_t)ctx->iov.data();
+    sqe->len = (uint32_t)ctx->iov.size();
+    sqe->user_data = (uint64_t)(uintptr_t)ctx;
+
+    if (cqe_count(ctx) == 2) {
+        // the fsync starts only after the write succeeds, and is cancelled if the write fails
+        sqe->flags |= IOSQE_IO_LINK;
+        sqe->user_data |= LINKED_WRITE_TAG;
+
+        sqe = next_sqe();
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->flags = flags;
+        sqe->fd = fd;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe->user_data = (uint64_t)(uintptr_t)ctx;
+    }
+}
+
+void io_uring_aio_provider::get_event()
+{
+    task::set_tls_dsn_context(node(), nullptr);
+
+    const char *name = ::dsn::tools::get_service_node_name(node());
+    char buffer[128];
+    sprintf(buffer, "%s.aio", name);
+    task_worker::set_name(buffer);
+
+    while (true) {
+        int ret = sys_io_uring_enter(_ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0 && errno != EINTR) {
+            dwarn("io_uring_enter returns %d, err = %s", ret, strerror(errno));
+        }
+
+        // only this thread consumes the completion queue
+        unsigned head = *_cq_head;
+        unsigned tail = load_acquire(_cq_tail);
+        bool stopped = false;
+        {
+            // the callbacks of all the completions reaped at once are enqueued in a batch
+            enqueue_batch_scope batch;
+            for (unsigned i = head; i != tail; ++i) {
+                const struct io_uring_cqe &cqe = _cqes[i & _cq_mask];
+                if (cqe.user_data == 0) {
+                    // the nop to wake up this thread on destruction
+                    stopped = !_is_running.load(std::memory_order_relaxed);
+                    continue;
+                }
+
+                auto ctx = (io_uring_aio_context *)(uintptr_t)(cqe.user_data & ~LINKED_WRITE_TAG);
+                if (cqe_count(ctx) == 2 && !(cqe.user_data & LINKED_WRITE_TAG)) {
+                    ctx->sync_result = cqe.res;
+                } else {
+                    ctx->write_result = cqe.res;
+                }
+                if (--ctx->pending_cqes == 0) {
+                    complete_aio(ctx);
+                }
+            }
+        }
+        store_release(_cq_head, tail);
+
+        if (head != tail) {
+            _lock.lock();
+            _inflight_cqes -= tail - head;
+            if (!_pending_ios.empty()) {
+                submit_pending_ios();
+            }
+            _lock.unlock();
+        }
+
+        if (stopped) {
+            break;
+        }
+    }
+}
+
+void io_uring_aio_provider::complete_aio(io_uring_aio_context *ctx)
+{
+    if (ctx->write_result >= 0 && ctx->sync_result == -ECANCELED) {
+        // the linked fsync may be cancelled even if the write succeeds, e.g. the write is
+        // done partially and then retried inside the kernel, so sync it here instead
+        ctx->sync_result =
+            (::fdatasync(static_cast<int>((ssize_t)ctx->file)) == 0) ? 0 : -errno;
+    }
+
+    int err = 0;
+    if (ctx->write_result < 0) {
+        err = -ctx->write_result;
+    } else if (ctx->sync_result < 0) {
+        err = -ctx->sync_result;
+    }
+
+    error_code ec;
+    uint32_t bytes = 0;
+    if (err != 0) {
+        derror("aio error, err = %s", strerror(err));
+        ec = ERR_FILE_OPERATION_FAILED;
+    } else {
+        bytes = (uint32_t)ctx->write_result;
+        ec = bytes > 0 ? ERR_OK : ERR_HANDLE_EOF;
+    }
+    complete_io(ctx->tsk, ec, bytes);
+}
+
+} // namespace dsn
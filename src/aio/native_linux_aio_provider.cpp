@@ -25,6 +25,7 @@
  */
 
 #include "native_linux_aio_provider.h"
+#include "core/task/task_engine.h"
 
 #include <fcntl.h>
 #include <cstdlib>
@@ -34,7 +35,7 @@ namespace dsn {
 native_linux_aio_provider::native_linux_aio_provider(disk_engine *disk) : aio_provider(disk)
 {
     memset(&_ctx, 0, sizeof(_ctx));
-    auto ret = io_setup(128, &_ctx); // 128 concurrent events
+    auto ret = io_setup(MAX_EVENTS, &_ctx);
     dassert(ret == 0, "io_setup error, ret = %d", ret);
 
     _is_running = true;
@@ -95,7 +96,7 @@ void native_linux_aio_provider::submit_aio_task(aio_task *aio_tsk) { aio_interna
 
 void native_linux_aio_provider::get_event()
 {
-    struct io_event events[1];
+    struct io_event events[MAX_EVENTS];
     int ret;
 
     task::set_tls_dsn_context(node(), nullptr);
@@ -109,12 +110,15 @@ void native_linux_aio_provider::get_event()
         if (dsn_unlikely(!_is_running.load(std::memory_order_relaxed))) {
             break;
         }
-        ret = io_getevents(_ctx, 1, 1, events, NULL);
-        if (ret > 0) // should be 1
-        {
-            dassert(ret == 1, "io_getevents returns %d", ret);
-            struct iocb *io = events[0].obj;
-            complete_aio(io, static_cast<int>(events[0].res), static_cast<int>(events[0].res2));
+        ret = io_getevents(_ctx, 1, MAX_EVENTS, events, NULL);
+        if (ret > 0) {
+            // the callbacks of all the completions reaped at once are enqueued in a batch, so
+            // that each queue is signaled once for them rather than once per completion
+            enqueue_batch_scope batch;
+            for (int i = 0; i < ret; ++i) {
+                struct iocb *io = events[i].obj;
+                complete_aio(io, static_cast<int>(events[i].res), static_cast<int>(events[i].res2));
+            }
         } else {
             // on error it returns a negated error number (the negative of one of the values listed
             // in ERRORS
@@ -134,6 +138,12 @@ void native_linux_aio_provider::complete_aio(struct iocb *io, int bytes, int err
         ec = bytes > 0 ? ERR_OK : ERR_HANDLE_EOF;
     }
 
+    if (ec == ERR_OK && aio->type == AIO_Write && aio->sync_after_write &&
+        ::fdatasync(static_cast<int>((ssize_t)aio->file)) != 0) {
+        derror("sync file after write failed, err = %s", strerror(errno));
+        ec = ERR_FILE_OPERATION_FAILED;
+    }
+
     if (!aio->evt) {
         aio_task *aio_ptr(aio->tsk);
         aio->this_->complete_io(aio_ptr, ec, bytes);
@@ -65,10 +65,16 @@ public:
         explicit linux_disk_aio_context(aio_task *tsk_)
             : tsk(tsk_), this_(nullptr), evt(nullptr), err(ERR_UNKNOWN), bytes(0)
         {
+            // the buffers are submitted by pwritev without being collapsed into one
+            support_write_vec = true;
         }
     };
 
 protected:
+    // the max count of the concurrent aios, which is also the max count of the completions
+    // reaped at once
+    static const int MAX_EVENTS = 128;
+
     error_code aio_internal(aio_task *aio, bool async, /*out*/ uint32_t *pbytes = nullptr);
     void complete_aio(struct iocb *io, int bytes, int err);
     void get_event();
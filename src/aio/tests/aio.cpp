@@ -25,9 +25,19 @@
  */
 
 #include <dsn/tool-api/async_calls.h>
+#include <dsn/utility/defer.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/tool-api/global_config.h>
+
+#include "../disk_engine.h"
 
 #include <gtest/gtest.h>
+#include <atomic>
+#include <iostream>
+#include <list>
+#include <thread>
+#include <vector>
 
 using namespace ::dsn;
 
@@ -271,3 +281,285 @@ TEST(core, dsn_file)
     ASSERT_TRUE(utils::filesystem::file_size("copy_dest.txt", fout_size));
     ASSERT_EQ(fin_size, fout_size);
 }
+
+TEST(core, aio_write_vector_not_collapsed)
+{
+    auto fp = file::open("tmp_write_vector", O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    ASSERT_NE(nullptr, fp);
+
+    std::string parts[] = {"hello, ", "vectored ", "write"};
+    dsn_file_buffer_t buffers[3];
+    for (int i = 0; i < 3; i++) {
+        buffers[i].buffer = &parts[i][0];
+        buffers[i].size = parts[i].size();
+    }
+    auto t = file::write_vector(fp, buffers, 3, 0, LPC_AIO_TEST, nullptr, nullptr);
+    t->wait();
+    ASSERT_EQ(ERR_OK, t->error());
+    ASSERT_EQ(parts[0].size() + parts[1].size() + parts[2].size(), t->get_transferred_size());
+    // the buffers are written without being copied into one
+    ASSERT_EQ(0u, t->_merged_write_buffer_holder.length());
+
+    std::string content(t->get_transferred_size(), '\0');
+    t = file::read(fp, &content[0], (int)content.size(), 0, LPC_AIO_TEST, nullptr, nullptr);
+    t->wait();
+    ASSERT_EQ(ERR_OK, t->error());
+    ASSERT_EQ("hello, vectored write", content);
+
+    ASSERT_EQ(ERR_OK, file::close(fp));
+    utils::filesystem::remove_path("tmp_write_vector");
+}
+
+// the callbacks run on the aio completion thread, see config.ini
+DEFINE_TASK_CODE_AIO(LPC_AIO_TEST_INLINE, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+TEST(core, aio_batch_completions)
+{
+    if (dsn::tools::get_current_tool()->name() == "simulator") {
+        return;
+    }
+
+    const int block_size = 4096;
+    const int block_count = 64;
+    std::string data(block_size * block_count, '\0');
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i % 251);
+    }
+
+    auto fp = file::open("tmp_batch_completions", O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    ASSERT_NE(nullptr, fp);
+    auto t = file::write(fp, &data[0], (int)data.size(), 0, LPC_AIO_TEST, nullptr, nullptr);
+    t->wait();
+    ASSERT_EQ(ERR_OK, t->error());
+
+    // the completions of the reads in flight are reaped and dispatched in batches
+    std::vector<std::string> blocks(block_count, std::string(block_size, '\0'));
+    std::atomic<int> on_worker{0};
+    std::atomic<int> on_aio_thread{0};
+    std::thread::id test_thread = std::this_thread::get_id();
+    std::vector<aio_task_ptr> tasks;
+    for (int i = 0; i < block_count; i++) {
+        bool inlined = (i % 2 == 0);
+        tasks.push_back(file::read(
+            fp,
+            &blocks[i][0],
+            block_size,
+            (uint64_t)i * block_size,
+            inlined ? LPC_AIO_TEST_INLINE : LPC_AIO_TEST,
+            nullptr,
+            [&, inlined](dsn::error_code err, size_t sz) {
+                if (err != ERR_OK || sz != (size_t)block_size) {
+                    return;
+                }
+                if (!inlined && task::get_current_worker() != nullptr) {
+                    ++on_worker;
+                }
+                if (inlined && task::get_current_worker() == nullptr &&
+                    std::this_thread::get_id() != test_thread) {
+                    ++on_aio_thread;
+                }
+            }));
+    }
+    for (int i = 0; i < block_count; i++) {
+        tasks[i]->wait();
+        ASSERT_EQ(ERR_OK, tasks[i]->error());
+        ASSERT_EQ(data.substr(i * block_size, block_size), blocks[i]);
+    }
+    ASSERT_EQ(block_count / 2, on_worker.load());
+    ASSERT_EQ(block_count / 2, on_aio_thread.load());
+
+    ASSERT_EQ(ERR_OK, file::close(fp));
+    utils::filesystem::remove_path("tmp_batch_completions");
+}
+
+namespace dsn {
+DSN_DECLARE_bool(aio_per_disk_enabled);
+} // namespace dsn
+
+TEST(core, aio_per_disk)
+{
+    if (dsn::tools::get_current_tool()->name() == "simulator") {
+        return;
+    }
+
+    FLAGS_aio_per_disk_enabled = true;
+    auto cleanup = defer([]() {
+        FLAGS_aio_per_disk_enabled = false;
+        utils::filesystem::remove_path("tmp_aio_disk");
+        utils::filesystem::remove_path("tmp_aio_disk_other");
+    });
+    ASSERT_TRUE(utils::filesystem::create_directory("tmp_aio_disk"));
+    std::string dir;
+    ASSERT_TRUE(utils::filesystem::get_absolute_path("tmp_aio_disk", dir));
+    file::register_disk("tmp_disk", dir);
+
+    auto fp = file::open("tmp_aio_disk/file", O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    ASSERT_NE(nullptr, fp);
+    ASSERT_EQ("tmp_disk", fp->disk()->tag);
+    ASSERT_NE(&disk_engine::provider(), &fp->provider());
+
+    // the files out of the dir are still served by the default provider
+    auto other = file::open("tmp_aio_disk_other", O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    ASSERT_NE(nullptr, other);
+    ASSERT_EQ(&disk_engine::provider(), &other->provider());
+    ASSERT_EQ(ERR_OK, file::close(other));
+
+    std::string data(4096, 'x');
+    auto t = file::write(fp, &data[0], (int)data.size(), 0, LPC_AIO_TEST, nullptr, nullptr);
+    t->wait();
+    ASSERT_EQ(ERR_OK, t->error());
+    std::string content(data.size(), '\0');
+    t = file::read(fp, &content[0], (int)content.size(), 0, LPC_AIO_TEST, nullptr, nullptr);
+    t->wait();
+    ASSERT_EQ(ERR_OK, t->error());
+    ASSERT_EQ(data, content);
+    ASSERT_NE(nullptr, fp->disk()->aio_latency_ns.get());
+    ASSERT_EQ(ERR_OK, file::close(fp));
+}
+
+// Compares the aio providers by running the test with config.ini (libaio) and
+// config-io-uring.ini (io_uring), see run.sh.
+TEST(core, aio_benchmark)
+{
+    if (dsn::tools::get_current_tool()->name() == "simulator") {
+        return;
+    }
+
+    const int block_size = 4096;
+    const int block_count = 16384;
+    const int queue_depth = 64;
+    std::string block(block_size, 'x');
+
+    auto fp = file::open("tmp_benchmark", O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    ASSERT_NE(nullptr, fp);
+
+    // throughput of writes with `queue_depth` IOs in flight
+    uint64_t start = dsn_now_ns();
+    std::list<aio_task_ptr> tasks;
+    for (int i = 0; i < block_count; i++) {
+        if (tasks.size() >= (size_t)queue_depth) {
+            tasks.front()->wait();
+            ASSERT_EQ(ERR_OK, tasks.front()->error());
+            tasks.pop_front();
+        }
+        // use random offsets to avoid the batching in disk_engine
+        uint64_t offset = (uint64_t)((i * 7919) % block_count) * block_size;
+        tasks.push_back(file::write(
+            fp, block.data(), block_size, offset, LPC_AIO_TEST, nullptr, nullptr));
+    }
+    for (auto &t : tasks) {
+        t->wait();
+        ASSERT_EQ(ERR_OK, t->error());
+    }
+    uint64_t write_ns = dsn_now_ns() - start;
+
+    // throughput of reads with `queue_depth` IOs in flight
+    std::vector<std::string> buffers(queue_depth, block);
+    start = dsn_now_ns();
+    tasks.clear();
+    for (int i = 0; i < block_count; i++) {
+        if (tasks.size() >= (size_t)queue_depth) {
+            tasks.front()->wait();
+            ASSERT_EQ(ERR_OK, tasks.front()->error());
+            tasks.pop_front();
+        }
+        uint64_t offset = (uint64_t)((i * 7919) % block_count) * block_size;
+        tasks.push_back(file::read(fp,
+                                   &buffers[i % queue_depth][0],
+                                   block_size,
+                                   offset,
+                                   LPC_AIO_TEST,
+                                   nullptr,
+                                   nullptr));
+    }
+    for (auto &t : tasks) {
+        t->wait();
+        ASSERT_EQ(ERR_OK, t->error());
+    }
+    uint64_t read_ns = dsn_now_ns() - start;
+
+    // latency of the appending writes which are synced to disk, like the mutation log
+    const int sync_count = 256;
+    dsn_file_buffer_t buf;
+    buf.buffer = &block[0];
+    buf.size = block_size;
+    start = dsn_now_ns();
+    for (int i = 0; i < sync_count; i++) {
+        auto t = file::write_vector(fp,
+                                    &buf,
+                                    1,
+                                    (uint64_t)(block_count + i) * block_size,
+                                    LPC_AIO_TEST,
+                                    nullptr,
+                                    nullptr,
+                                    0,
+                                    true);
+        t->wait();
+        ASSERT_EQ(ERR_OK, t->error());
+        ASSERT_EQ((size_t)block_size, t->get_transferred_size());
+    }
+    uint64_t sync_ns = dsn_now_ns() - start;
+
+    ASSERT_EQ(ERR_OK, file::close(fp));
+    utils::filesystem::remove_path("tmp_benchmark");
+
+    std::cout << FLAGS_aio_factory_name << ": write " << block_count * 1e9 / write_ns
+              << " IOPS, read " << block_count * 1e9 / read_ns << " IOPS (" << block_size
+              << " bytes, queue depth " << queue_depth << "), synced write latency "
+              << sync_ns / sync_count / 1000 << " us" << std::endl;
+}
+
+// many threads appending to one file like the shared log, whose writes are merged by the
+// disk_write_queue of the file
+TEST(core, aio_concurrent_append_benchmark)
+{
+    if (dsn::tools::get_current_tool()->name() == "simulator") {
+        return;
+    }
+
+    const int thread_count = 16;
+    const int block_size = 512;
+    const int block_count_per_thread = 4096;
+    const int queue_depth = 16;
+    std::string block(block_size, 'x');
+
+    auto fp = file::open("tmp_append_benchmark", O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    ASSERT_NE(nullptr, fp);
+
+    std::atomic<uint64_t> next_offset{0};
+    uint64_t start = dsn_now_ns();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; i++) {
+        threads.emplace_back([&]() {
+            std::list<aio_task_ptr> tasks;
+            for (int j = 0; j < block_count_per_thread; j++) {
+                if (tasks.size() >= (size_t)queue_depth) {
+                    tasks.front()->wait();
+                    ASSERT_EQ(ERR_OK, tasks.front()->error());
+                    tasks.pop_front();
+                }
+                uint64_t offset = next_offset.fetch_add(block_size);
+                tasks.push_back(file::write(
+                    fp, block.data(), block_size, offset, LPC_AIO_TEST, nullptr, nullptr));
+            }
+            for (auto &t : tasks) {
+                t->wait();
+                ASSERT_EQ(ERR_OK, t->error());
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    uint64_t write_ns = dsn_now_ns() - start;
+
+    int64_t file_size;
+    ASSERT_EQ(ERR_OK, file::close(fp));
+    ASSERT_TRUE(utils::filesystem::file_size("tmp_append_benchmark", file_size));
+    ASSERT_EQ((int64_t)thread_count * block_count_per_thread * block_size, file_size);
+    utils::filesystem::remove_path("tmp_append_benchmark");
+
+    std::cout << FLAGS_aio_factory_name << ": " << thread_count << " threads append "
+              << thread_count * block_count_per_thread * 1e9 / write_ns << " writes/s ("
+              << block_size << " bytes)" << std::endl;
+}
@@ -8,6 +8,7 @@
 GTEST_API_ int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
-    dsn_run_config("config.ini", false);
+    // run with another config to test another aio provider, see run.sh
+    dsn_run_config(argc > 1 ? argv[1] : "config.ini", false);
     return RUN_ALL_TESTS();
 }
@@ -6,4 +6,8 @@ fi
 
 ./clear.sh
 output_xml="${REPORT_DIR}/dsn_aio_test.xml"
-GTEST_OUTPUT="xml:${output_xml}" ./dsn_aio_test
+GTEST_OUTPUT="xml:${output_xml}" ./dsn_aio_test || exit 1
+
+./clear.sh
+output_xml="${REPORT_DIR}/dsn_aio_test_io_uring.xml"
+GTEST_OUTPUT="xml:${output_xml}" ./dsn_aio_test config-io-uring.ini
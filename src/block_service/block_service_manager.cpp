@@ -90,12 +90,63 @@ error_code block_service_manager::download_file(const std::string &remote_dir,
                                                 const std::string &file_name,
                                                 block_filesystem *fs,
                                                 /*out*/ uint64_t &download_file_size)
+{
+    std::string download_file_md5;
+    return download_file(
+        remote_dir, local_dir, file_name, fs, download_file_size, download_file_md5);
+}
+
+// ThreadPool: THREAD_POOL_REPLICATION, THREAD_POOL_REPLICATION_LONG
+error_code block_service_manager::download_file(const std::string &remote_dir,
+                                                const std::string &local_dir,
+                                                const std::string &file_name,
+                                                block_filesystem *fs,
+                                                /*out*/ uint64_t &download_file_size,
+                                                /*out*/ std::string &download_file_md5)
 {
     error_code download_err = ERR_OK;
     task_tracker tracker;
+    async_download_file(remote_dir,
+                        local_dir,
+                        file_name,
+                        fs,
+                        nullptr,
+                        &tracker,
+                        [&download_err, &download_file_size, &download_file_md5](
+                            error_code err, uint64_t size, const std::string &md5) {
+                            download_err = err;
+                            if (err == ERR_OK) {
+                                download_file_size = size;
+                                download_file_md5 = md5;
+                            }
+                        });
+    tracker.wait_outstanding_tasks();
+    return download_err;
+}
 
-    auto download_file_callback_func = [this, &download_err, &download_file_size](
-        const download_response &resp, block_file_ptr bf, const std::string &local_file_name) {
+void block_service_manager::async_download_file(const std::string &remote_dir,
+                                                const std::string &local_dir,
+                                                const std::string &file_name,
+                                                block_filesystem *fs,
+                                                download_scheduler *scheduler,
+                                                task_tracker *tracker,
+                                                download_file_callback &&callback)
+{
+    if (scheduler != nullptr) {
+        scheduler->acquire();
+    }
+    auto cb = std::make_shared<download_file_callback>(std::move(callback));
+    auto release = [scheduler](uint64_t transferred_size) {
+        if (scheduler != nullptr) {
+            scheduler->release(transferred_size);
+        }
+    };
+
+    auto download_file_callback_func = [cb, release](const download_response &resp,
+                                                     block_file_ptr bf,
+                                                     const std::string &expected_md5,
+                                                     const std::string &local_file_name) {
+        release(resp.downloaded_size);
         if (resp.err != ERR_OK) {
             // during bulk load process, ERR_OBJECT_NOT_FOUND will be considered as a recoverable
             // error, however, if file damaged on remote file provider, bulk load should stop,
@@ -103,9 +154,9 @@ error_code block_service_manager::download_file(const std::string &remote_dir,
             if (resp.err == ERR_OBJECT_NOT_FOUND) {
                 derror_f("download file({}) failed, file on remote file provider is damaged",
                          local_file_name);
-                download_err = ERR_CORRUPTION;
+                (*cb)(ERR_CORRUPTION, 0, std::string());
             } else {
-                download_err = resp.err;
+                (*cb)(resp.err, 0, std::string());
             }
             return;
         }
@@ -116,50 +167,48 @@ error_code block_service_manager::download_file(const std::string &remote_dir,
                 bf->file_name(),
                 bf->get_size(),
                 resp.downloaded_size);
-            download_err = ERR_CORRUPTION;
+            (*cb)(ERR_CORRUPTION, 0, std::string());
             return;
         }
 
-        std::string current_md5;
-        error_code e = utils::filesystem::md5sum(local_file_name, current_md5);
-        if (e != ERR_OK) {
-            derror_f("calculate file({}) md5 failed", local_file_name);
-            download_err = e;
-            return;
+        // use the md5 computed while downloading if the block service supports it
+        std::string current_md5 = resp.file_md5;
+        if (current_md5.empty()) {
+            error_code e = utils::filesystem::md5sum(local_file_name, current_md5);
+            if (e != ERR_OK) {
+                derror_f("calculate file({}) md5 failed", local_file_name);
+                (*cb)(e, 0, std::string());
+                return;
+            }
         }
-        if (current_md5 != bf->get_md5sum()) {
+        if (current_md5 != expected_md5) {
             derror_f("local file({}) is different from remote file({}), download failed, md5: "
                      "local({}) VS remote({})",
                      local_file_name,
                      bf->file_name(),
                      current_md5,
-                     bf->get_md5sum());
-            download_err = ERR_CORRUPTION;
+                     expected_md5);
+            (*cb)(ERR_CORRUPTION, 0, std::string());
             return;
         }
-        ddebug_f("download file({}) succeed, file_size = {}",
-                 local_file_name.c_str(),
-                 resp.downloaded_size);
-        download_err = ERR_OK;
-        download_file_size = resp.downloaded_size;
+        ddebug_f("download file({}) succeed, file_size = {}", local_file_name, resp.downloaded_size);
+        (*cb)(ERR_OK, resp.downloaded_size, current_md5);
     };
 
-    auto create_file_cb = [this,
-                           &local_dir,
-                           &download_err,
-                           &download_file_size,
-                           &download_file_callback_func,
-                           &tracker](const create_file_response &resp, const std::string &fname) {
+    auto create_file_cb = [local_dir, cb, release, download_file_callback_func, tracker](
+        const create_file_response &resp, const std::string &fname) {
         if (resp.err != ERR_OK) {
             derror_f("create file({}) failed with error({})", fname, resp.err.to_string());
-            download_err = resp.err;
+            release(0);
+            (*cb)(resp.err, 0, std::string());
             return;
         }
 
         block_file *bf = resp.file_handle.get();
         if (bf->get_md5sum().empty()) {
             derror_f("file({}) doesn't exist on remote file provider", bf->file_name());
-            download_err = ERR_CORRUPTION;
+            release(0);
+            (*cb)(ERR_CORRUPTION, 0, std::string());
             return;
         }
 
@@ -182,36 +231,37 @@ error_code block_service_manager::download_file(const std::string &remote_dir,
                 }
                 if (!utils::filesystem::remove_path(local_file_name)) {
                     derror_f("failed to remove file({})", local_file_name);
-                    download_err = e;
+                    release(0);
+                    (*cb)(e, 0, std::string());
                     return;
                 }
             } else {
-                download_err = ERR_OK;
-                download_file_size = bf->get_size();
                 ddebug_f("local file({}) has been downloaded, file size = {}",
                          local_file_name,
-                         download_file_size);
+                         bf->get_size());
+                release(0);
+                (*cb)(ERR_OK, bf->get_size(), current_md5);
                 return;
             }
         }
 
-        // download or redownload file
+        // download or redownload file, the md5 of the remote file is copied as it may be
+        // updated by the download
         bf->download(download_request{local_file_name, 0, -1},
                      TASK_CODE_EXEC_INLINED,
                      std::bind(download_file_callback_func,
                                std::placeholders::_1,
                                resp.file_handle,
+                               bf->get_md5sum(),
                                local_file_name),
-                     &tracker);
+                     tracker);
     };
 
     const std::string remote_file_name = utils::filesystem::path_combine(remote_dir, file_name);
     fs->create_file(create_file_request{remote_file_name, false},
                     TASK_CODE_EXEC_INLINED,
                     std::bind(create_file_cb, std::placeholders::_1, file_name),
-                    &tracker);
-    tracker.wait_outstanding_tasks();
-    return download_err;
+                    tracker);
 }
 
 } // namespace block_service
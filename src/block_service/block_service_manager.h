@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include "download_scheduler.h"
+
 #include <dsn/dist/block_service.h>
 #include <dsn/utility/singleton_store.h>
 #include <dsn/tool-api/zlocks.h>
@@ -39,12 +41,43 @@ public:
                              block_filesystem *fs,
                              /*out*/ uint64_t &download_file_size);
 
+    // same as the above, also return the md5 of the local file, which is computed while
+    // downloading if the block service supports it, so that it needn't to be read again to verify
+    error_code download_file(const std::string &remote_dir,
+                             const std::string &local_dir,
+                             const std::string &file_name,
+                             block_filesystem *fs,
+                             /*out*/ uint64_t &download_file_size,
+                             /*out*/ std::string &download_file_md5);
+
+    // download_file_callback(err, download_file_size, file_md5)
+    typedef std::function<void(error_code, uint64_t, const std::string &)> download_file_callback;
+
+    // the asynchronous version of download_file, the md5 of the local file is also passed to
+    // the callback, which is computed while downloading if the block service supports it, so
+    // that the caller needn't to read the file again to verify it.
+    // if scheduler is not null, the caller is blocked until the scheduler allows one more
+    // download, and the download is released from the scheduler as soon as the transfer is
+    // finished, so that the next file can be downloaded while this one is being verified.
+    void async_download_file(const std::string &remote_dir,
+                             const std::string &local_dir,
+                             const std::string &file_name,
+                             block_filesystem *fs,
+                             download_scheduler *scheduler,
+                             task_tracker *tracker,
+                             download_file_callback &&callback);
+
+    // the scheduler of the downloads of restore on this node
+    download_scheduler &get_download_scheduler() { return _download_scheduler; }
+
 private:
     block_service_registry &_registry_holder;
 
     mutable zrwlock_nr _fs_lock;
     std::map<std::string, std::unique_ptr<block_filesystem>> _fs_map;
 
+    download_scheduler _download_scheduler;
+
     friend class block_service_manager_mock;
 };
 
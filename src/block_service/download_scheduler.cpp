@@ -0,0 +1,112 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "download_scheduler.h"
+
+#include <algorithm>
+
+#include <dsn/c/api_layer1.h>
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace dist {
+namespace block_service {
+
+DSN_DEFINE_uint32("replication",
+                  restore_download_min_concurrency,
+                  1,
+                  "the min count of the concurrent file downloads of restore on a node");
+DSN_DEFINE_uint32("replication",
+                  restore_download_max_concurrency,
+                  8,
+                  "the max count of the concurrent file downloads of restore on a node");
+DSN_DEFINE_uint32("replication",
+                  restore_download_adjust_interval_ms,
+                  5000,
+                  "the interval to adjust the concurrency of the file downloads of restore by "
+                  "the measured throughput");
+
+static uint32_t min_concurrency() { return std::max(FLAGS_restore_download_min_concurrency, 1u); }
+
+static uint32_t max_concurrency()
+{
+    return std::max(FLAGS_restore_download_max_concurrency, min_concurrency());
+}
+
+download_scheduler::download_scheduler(std::function<uint64_t()> now_ms)
+    : _now_ms(now_ms ? std::move(now_ms) : std::function<uint64_t()>(dsn_now_ms)),
+      _concurrency(min_concurrency())
+{
+    _interval_start_ms = _now_ms();
+}
+
+void download_scheduler::acquire()
+{
+    std::unique_lock<std::mutex> l(_lock);
+    _cond.wait(l, [this]() { return _running < _concurrency; });
+    ++_running;
+}
+
+void download_scheduler::release(uint64_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        dassert_f(_running > 0, "release a download which is not acquired");
+        --_running;
+        _interval_bytes += bytes;
+        adjust(_now_ms());
+    }
+    _cond.notify_all();
+}
+
+void download_scheduler::adjust(uint64_t now_ms)
+{
+    uint64_t elapsed_ms = now_ms - _interval_start_ms;
+    if (now_ms <= _interval_start_ms || elapsed_ms < FLAGS_restore_download_adjust_interval_ms) {
+        return;
+    }
+
+    double throughput = _interval_bytes * 1000.0 / elapsed_ms;
+    if (_last_throughput > 0 && throughput < _last_throughput * 0.95) {
+        // the last move made it worse
+        _direction = -_direction;
+    }
+
+    uint32_t old_concurrency = _concurrency;
+    if (_direction > 0 && _concurrency >= max_concurrency()) {
+        _direction = -1;
+    } else if (_direction < 0 && _concurrency <= min_concurrency()) {
+        _direction = 1;
+    }
+    int64_t next = static_cast<int64_t>(_concurrency) + _direction;
+    _concurrency = static_cast<uint32_t>(std::min<int64_t>(
+        std::max<int64_t>(next, min_concurrency()), max_concurrency()));
+    if (_concurrency != old_concurrency) {
+        ddebug_f("adjust the download concurrency from {} to {}, throughput = {} bytes/s",
+                 old_concurrency,
+                 _concurrency,
+                 static_cast<uint64_t>(throughput));
+    }
+
+    _last_throughput = throughput;
+    _interval_start_ms = now_ms;
+    _interval_bytes = 0;
+}
+
+uint32_t download_scheduler::concurrency() const
+{
+    std::lock_guard<std::mutex> l(_lock);
+    return _concurrency;
+}
+
+uint32_t download_scheduler::running() const
+{
+    std::lock_guard<std::mutex> l(_lock);
+    return _running;
+}
+
+} // namespace block_service
+} // namespace dist
+} // namespace dsn
@@ -0,0 +1,59 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace dsn {
+namespace dist {
+namespace block_service {
+
+///
+/// download_scheduler limits the count of the concurrent downloads of a service node, and
+/// adapts the limit to the throughput of the block service by hill climbing:
+/// every [replication] restore_download_adjust_interval_ms, the limit is moved by one in the
+/// current direction, and the direction is reversed once the throughput of the last interval
+/// drops more than 5% than the one before. The limit is always within
+/// [restore_download_min_concurrency, restore_download_max_concurrency].
+///
+class download_scheduler
+{
+public:
+    explicit download_scheduler(std::function<uint64_t()> now_ms = nullptr);
+
+    // block until the count of the running downloads is under the limit
+    void acquire();
+
+    // finish a download acquired by acquire(), which has transferred `bytes`
+    void release(uint64_t bytes);
+
+    uint32_t concurrency() const;
+    uint32_t running() const;
+
+private:
+    // adjust the limit if the current interval is over, called with _lock held
+    void adjust(uint64_t now_ms);
+
+    std::function<uint64_t()> _now_ms;
+
+    mutable std::mutex _lock;
+    std::condition_variable _cond;
+    uint32_t _concurrency;
+    uint32_t _running{0};
+
+    // +1 or -1
+    int _direction{1};
+    uint64_t _interval_start_ms;
+    uint64_t _interval_bytes{0};
+    // bytes per second of the last interval, 0 if not measured yet
+    double _last_throughput{0};
+};
+
+} // namespace block_service
+} // namespace dist
+} // namespace dsn
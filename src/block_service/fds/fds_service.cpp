@@ -14,11 +14,20 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <fstream>
+#include <thread>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <dsn/utility/defer.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/io_scheduler.h>
+#include <dsn/utility/page_cache_advisor.h>
 #include <dsn/utility/TokenBucket.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/flags.h>
@@ -41,6 +50,29 @@ DSN_DEFINE_uint32("replication", fds_write_limit_rate, 100, "rate limit of fds(M
 
 DSN_DEFINE_uint32("replication", fds_read_limit_rate, 100, "rate limit of fds(MB/s)");
 
+DSN_DEFINE_uint32("replication",
+                  fds_download_part_concurrency,
+                  1,
+                  "download the whole files larger than fds_download_part_size_kb in parts with "
+                  "this count of concurrent ranged requests, 1 to download sequentially");
+
+DSN_DEFINE_uint32("replication",
+                  fds_download_part_size_kb,
+                  16384,
+                  "the size of each part when downloading a file from fds in parts");
+
+DSN_DEFINE_uint32("replication",
+                  fds_remove_concurrency,
+                  8,
+                  "the count of the threads deleting the objects in batches when removing a "
+                  "directory from fds");
+
+DSN_DEFINE_bool("replication",
+                fds_upload_drop_behind,
+                true,
+                "whether to drop the pages of the file uploaded to fds from the page cache once "
+                "uploaded, except those which were cached before, e.g. by the storage engine");
+
 class utils
 {
 public:
@@ -183,85 +215,127 @@ error_code fds_service::initialize(const std::vector<std::string> &args)
         ERR_REFERENCE = ERR_FS_INTERNAL;                                                           \
     }
 
-dsn::task_ptr fds_service::list_dir(const ls_request &req,
-                                    dsn::task_code code,
-                                    const ls_callback &callback,
-                                    dsn::task_tracker *tracker = nullptr)
+error_code fds_service::list_entries(const ls_request &req, const ls_page_handler &handler)
 {
-    ls_future_ptr t(new ls_future(code, callback, 0));
-    t->set_tracker(tracker);
-
-    auto list_dir_in_background = [this, req, t]() {
-        ls_response resp;
-        std::string fds_path = utils::path_to_fds(req.dir_name, true);
-        try {
-            std::shared_ptr<galaxy::fds::FDSObjectListing> result =
-                _client->listObjects(_bucket_name, fds_path);
+    error_code err = ERR_OK;
+    std::string fds_path = utils::path_to_fds(req.dir_name, true);
+    const size_t page_size = std::max(req.page_size, 1U);
+    bool empty = true;
+    try {
+        std::shared_ptr<galaxy::fds::FDSObjectListing> result =
+            _client->listObjects(_bucket_name, fds_path);
+
+        std::vector<ls_entry> page;
+        bool stopped = false;
+        auto add_entry = [&](ls_entry &&entry) {
+            empty = false;
+            page.emplace_back(std::move(entry));
+            if (page.size() >= page_size) {
+                stopped = !handler(page);
+                page.clear();
+            }
+        };
+        while (!stopped) {
+            const std::vector<galaxy::fds::FDSObjectSummary> &objs = result->objectSummaries();
+            const std::vector<std::string> &common_prefix = result->commonPrefixes();
 
-            while (true) {
-                const std::vector<galaxy::fds::FDSObjectSummary> &objs = result->objectSummaries();
-                const std::vector<std::string> &common_prefix = result->commonPrefixes();
-                resp.err = dsn::ERR_OK;
+            // fds listing's objects are with full-path, we must extract the postfix to emulate
+            // the filesystem structure
+            for (auto it = objs.begin(); it != objs.end() && !stopped; ++it) {
+                dassert(fds_path.empty() || boost::starts_with(it->objectName(), fds_path),
+                        "invalid path(%s) in parent(%s)",
+                        it->objectName().c_str(),
+                        fds_path.c_str());
+                add_entry(
+                    {utils::path_from_fds(it->objectName().substr(fds_path.size()), false), false});
+            }
+            for (auto it = common_prefix.begin(); it != common_prefix.end() && !stopped; ++it) {
+                dassert(fds_path.empty() || boost::starts_with(*it, fds_path),
+                        "invalid path(%s) in parent(%s)",
+                        it->c_str(),
+                        fds_path.c_str());
+                add_entry({utils::path_from_fds(it->substr(fds_path.size()), true), true});
+            }
 
-                // fds listing's objects are with full-path, we must extract the postfix to emulate
-                // the filesystem structure
-                for (const galaxy::fds::FDSObjectSummary &obj : objs) {
-                    dassert(fds_path.empty() || boost::starts_with(obj.objectName(), fds_path),
-                            "invalid path(%s) in parent(%s)",
-                            obj.objectName().c_str(),
-                            fds_path.c_str());
-                    resp.entries->push_back(
-                        {utils::path_from_fds(obj.objectName().substr(fds_path.size()), false),
-                         false});
-                }
-                for (const std::string &s : common_prefix) {
-                    dassert(fds_path.empty() || boost::starts_with(s, fds_path),
-                            "invalid path(%s) in parent(%s)",
-                            s.c_str(),
-                            fds_path.c_str());
-                    resp.entries->push_back(
-                        {utils::path_from_fds(s.substr(fds_path.size()), true), true});
-                }
+            // list result may be paged
+            if (!stopped && result->truncated()) {
+                auto res_temp = _client->listNextBatchOfObjects(*result);
+                result.swap(res_temp);
+            } else {
+                break;
+            }
+        }
+        if (!stopped && !page.empty()) {
+            handler(page);
+        }
+    } catch (const galaxy::fds::GalaxyFDSClientException &ex) {
+        derror("fds listObjects failed: parameter(%s), code(%d), msg(%s)",
+               req.dir_name.c_str(),
+               ex.code(),
+               ex.what());
+        err = ERR_FS_INTERNAL;
+    }
+    FDS_EXCEPTION_HANDLE(err, "listObject", req.dir_name.c_str())
 
-                // list result may be paged
-                if (result->truncated()) {
-                    auto res_temp = _client->listNextBatchOfObjects(*result);
-                    result.swap(res_temp);
-                } else {
-                    break;
-                }
+    if (err == dsn::ERR_OK && empty) {
+        try {
+            if (_client->doesObjectExist(_bucket_name, utils::path_to_fds(req.dir_name, false))) {
+                derror("fds list_dir failed: path not dir, parameter(%s)", req.dir_name.c_str());
+                err = ERR_INVALID_PARAMETERS;
+            } else {
+                derror("fds list_dir failed: path not found, parameter(%s)",
+                       req.dir_name.c_str());
+                err = ERR_OBJECT_NOT_FOUND;
             }
         } catch (const galaxy::fds::GalaxyFDSClientException &ex) {
-            derror("fds listObjects failed: parameter(%s), code(%d), msg(%s)",
+            derror("fds doesObjectExist failed: parameter(%s), code(%d), msg(%s)",
                    req.dir_name.c_str(),
                    ex.code(),
                    ex.what());
-            resp.err = ERR_FS_INTERNAL;
+            err = ERR_FS_INTERNAL;
         }
-        FDS_EXCEPTION_HANDLE(resp.err, "listObject", req.dir_name.c_str())
+        FDS_EXCEPTION_HANDLE(err, "doesObjectExist", req.dir_name.c_str())
+    }
+    return err;
+}
 
-        if (resp.err == dsn::ERR_OK && resp.entries->empty()) {
-            try {
-                if (_client->doesObjectExist(_bucket_name,
-                                             utils::path_to_fds(req.dir_name, false))) {
-                    derror("fds list_dir failed: path not dir, parameter(%s)",
-                           req.dir_name.c_str());
-                    resp.err = ERR_INVALID_PARAMETERS;
-                } else {
-                    derror("fds list_dir failed: path not found, parameter(%s)",
-                           req.dir_name.c_str());
-                    resp.err = ERR_OBJECT_NOT_FOUND;
-                }
-            } catch (const galaxy::fds::GalaxyFDSClientException &ex) {
-                derror("fds doesObjectExist failed: parameter(%s), code(%d), msg(%s)",
-                       req.dir_name.c_str(),
-                       ex.code(),
-                       ex.what());
-                resp.err = ERR_FS_INTERNAL;
-            }
-            FDS_EXCEPTION_HANDLE(resp.err, "doesObjectExist", req.dir_name.c_str())
+dsn::task_ptr fds_service::list_dir(const ls_request &req,
+                                    dsn::task_code code,
+                                    const ls_callback &callback,
+                                    dsn::task_tracker *tracker = nullptr)
+{
+    ls_future_ptr t(new ls_future(code, callback, 0));
+    t->set_tracker(tracker);
+
+    auto list_dir_in_background = [this, req, t]() {
+        ls_response resp;
+        std::vector<ls_entry> &entries = *resp.entries;
+        resp.err = list_entries(req, [&entries](const std::vector<ls_entry> &page) {
+            entries.insert(entries.end(), page.begin(), page.end());
+            return true;
+        });
+        if (resp.err != ERR_OK) {
+            entries.clear();
         }
+        t->enqueue_with(resp);
+    };
 
+    dsn::tasking::enqueue(LPC_FDS_CALL, nullptr, list_dir_in_background);
+    return t;
+}
+
+dsn::task_ptr fds_service::list_dir_in_pages(const ls_request &req,
+                                             const ls_page_handler &handler,
+                                             dsn::task_code code,
+                                             const ls_callback &callback,
+                                             dsn::task_tracker *tracker = nullptr)
+{
+    ls_future_ptr t(new ls_future(code, callback, 0));
+    t->set_tracker(tracker);
+
+    auto list_dir_in_background = [this, req, handler, t]() {
+        ls_response resp;
+        resp.err = list_entries(req, handler);
         t->enqueue_with(resp);
     };
 
@@ -466,25 +540,7 @@ dsn::task_ptr fds_service::remove_path(const remove_path_request &req,
         FDS_EXCEPTION_HANDLE(resp.err, "remove_path", req.path.c_str());
 
         if (resp.err == ERR_OK && should_remove_path) {
-            fds_path = utils::path_to_fds(req.path, false);
-            try {
-                auto deleting = _client->deleteObjects(_bucket_name, fds_path, false);
-                if (deleting->countFailedObjects() <= 0) {
-                    resp.err = ERR_OK;
-                } else {
-                    derror("fds remove_path failed: countFailedObjects = %d, parameter(%s)",
-                           deleting->countFailedObjects(),
-                           req.path.c_str());
-                    resp.err = ERR_FS_INTERNAL;
-                }
-            } catch (const galaxy::fds::GalaxyFDSClientException &ex) {
-                derror("fds remove_path failed: parameter(%s), code(%d), msg(%s)",
-                       req.path.c_str(),
-                       ex.code(),
-                       ex.what());
-                resp.err = ERR_FS_INTERNAL;
-            }
-            FDS_EXCEPTION_HANDLE(resp.err, "remove_path", req.path.c_str());
+            resp.err = remove_objects(req.path);
         }
 
         callback->enqueue_with(resp);
@@ -495,6 +551,148 @@ dsn::task_ptr fds_service::remove_path(const remove_path_request &req,
     return callback;
 }
 
+error_code fds_service::remove_objects(const std::string &path)
+{
+    const std::string fds_dir = utils::path_to_fds(path, true);
+    const size_t concurrency = std::max(FLAGS_fds_remove_concurrency, 1U);
+
+    // the objects are listed page by page and deleted by the workers in batches of a page, at
+    // most `concurrency` batches are queued so that the listing doesn't run far ahead
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<std::vector<std::string>> batches;
+    bool listed = false;
+    error_code err = ERR_OK;
+
+    auto delete_batches = [&]() {
+        while (true) {
+            std::vector<std::string> batch;
+            {
+                std::unique_lock<std::mutex> l(lock);
+                cond.wait(l, [&]() { return !batches.empty() || listed || err != ERR_OK; });
+                if (err != ERR_OK || batches.empty()) {
+                    return;
+                }
+                batch = std::move(batches.front());
+                batches.pop_front();
+            }
+            cond.notify_all();
+
+            error_code ec = delete_objects(batch);
+            if (ec != ERR_OK) {
+                {
+                    std::lock_guard<std::mutex> l(lock);
+                    if (err == ERR_OK) {
+                        err = ec;
+                    }
+                }
+                cond.notify_all();
+                return;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < concurrency; ++i) {
+        workers.emplace_back(delete_batches);
+    }
+
+    error_code list_err = ERR_OK;
+    uint64_t object_count = 0;
+    try {
+        // without the delimiter, all the objects under fds_dir are listed
+        std::shared_ptr<galaxy::fds::FDSObjectListing> result =
+            _client->listObjects(_bucket_name, fds_dir, "");
+        while (true) {
+            std::vector<std::string> batch;
+            for (const galaxy::fds::FDSObjectSummary &obj : result->objectSummaries()) {
+                batch.push_back(obj.objectName());
+            }
+            if (!batch.empty()) {
+                object_count += batch.size();
+                std::unique_lock<std::mutex> l(lock);
+                cond.wait(l, [&]() { return batches.size() < concurrency || err != ERR_OK; });
+                if (err != ERR_OK) {
+                    break;
+                }
+                batches.emplace_back(std::move(batch));
+                l.unlock();
+                cond.notify_all();
+            }
+            if (!result->truncated()) {
+                break;
+            }
+            auto res_temp = _client->listNextBatchOfObjects(*result);
+            result.swap(res_temp);
+        }
+    } catch (const galaxy::fds::GalaxyFDSClientException &ex) {
+        derror("fds remove_path failed: parameter(%s), code(%d), msg(%s)",
+               path.c_str(),
+               ex.code(),
+               ex.what());
+        list_err = ERR_FS_INTERNAL;
+    }
+    FDS_EXCEPTION_HANDLE(list_err, "remove_path", path.c_str());
+
+    {
+        std::lock_guard<std::mutex> l(lock);
+        listed = true;
+        if (err == ERR_OK) {
+            err = list_err;
+        }
+    }
+    cond.notify_all();
+    for (auto &w : workers) {
+        w.join();
+    }
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    // the path may be a file rather than a directory
+    try {
+        _client->deleteObject(_bucket_name, utils::path_to_fds(path, false), false);
+    } catch (const galaxy::fds::GalaxyFDSClientException &ex) {
+        if (ex.code() != Poco::Net::HTTPResponse::HTTP_NOT_FOUND) {
+            derror("fds remove_path failed: parameter(%s), code(%d), msg(%s)",
+                   path.c_str(),
+                   ex.code(),
+                   ex.what());
+            err = ERR_FS_INTERNAL;
+        }
+    }
+    FDS_EXCEPTION_HANDLE(err, "remove_path", path.c_str());
+
+    ddebug_f("fds remove_path({}) removed {} objects under it with {} threads, error({})",
+             path,
+             object_count,
+             concurrency,
+             err);
+    return err;
+}
+
+error_code fds_service::delete_objects(const std::vector<std::string> &fds_paths)
+{
+    error_code err = ERR_OK;
+    try {
+        auto deleting = _client->deleteObjects(_bucket_name, fds_paths, false);
+        if (deleting->countFailedObjects() > 0) {
+            derror("fds deleteObjects failed: countFailedObjects = %d, first(%s)",
+                   deleting->countFailedObjects(),
+                   fds_paths.front().c_str());
+            err = ERR_FS_INTERNAL;
+        }
+    } catch (const galaxy::fds::GalaxyFDSClientException &ex) {
+        derror("fds deleteObjects failed: first(%s), code(%d), msg(%s)",
+               fds_paths.front().c_str(),
+               ex.code(),
+               ex.what());
+        err = ERR_FS_INTERNAL;
+    }
+    FDS_EXCEPTION_HANDLE(err, "deleteObjects", fds_paths.front().c_str());
+    return err;
+}
+
 fds_file_object::fds_file_object(fds_service *s,
                                  const std::string &name,
                                  const std::string &fds_path)
@@ -564,7 +762,8 @@ error_code fds_file_object::get_file_meta()
 error_code fds_file_object::get_content_in_batches(uint64_t start,
                                                    int64_t length,
                                                    /*out*/ std::ostream &os,
-                                                   /*out*/ uint64_t &transfered_bytes)
+                                                   /*out*/ uint64_t &transfered_bytes,
+                                                   const std::string &local_file)
 {
     // the max batch size is 1MB
     const uint64_t BATCH_MAX = 1 << 20;
@@ -588,6 +787,8 @@ error_code fds_file_object::get_content_in_batches(uint64_t start,
         uint64_t batch_len = std::min(BATCH_MAX, start + to_transfer_bytes - pos);
         // get tokens from token bucket
         _service->_read_token_bucket->consumeWithBorrowAndWait(batch_len);
+        // the downloads from fds are for bulk load and restore
+        io_scheduler::instance().consume(io_class::BULK_LOAD, local_file, batch_len);
 
         err = get_content(pos, batch_len, os, once_transfered_bytes);
         transfered_bytes += once_transfered_bytes;
@@ -600,6 +801,91 @@ error_code fds_file_object::get_content_in_batches(uint64_t start,
     return ERR_OK;
 }
 
+error_code fds_file_object::get_content_in_parts(const std::string &local_file,
+                                                 /*out*/ uint64_t &transfered_bytes)
+{
+    const uint64_t part_size = static_cast<uint64_t>(FLAGS_fds_download_part_size_kb) << 10;
+    const uint64_t part_count = (_size + part_size - 1) / part_size;
+    const uint64_t concurrency =
+        std::min(static_cast<uint64_t>(FLAGS_fds_download_part_concurrency), part_count);
+    const int max_attempts = 3;
+
+    std::atomic<uint64_t> next_part(0);
+    std::atomic<uint64_t> total_bytes(0);
+    std::mutex err_lock;
+    error_code err = ERR_OK;
+    auto set_error = [&err_lock, &err](error_code ec) {
+        std::lock_guard<std::mutex> l(err_lock);
+        if (err == ERR_OK) {
+            err = ec;
+        }
+    };
+    auto has_error = [&err_lock, &err]() {
+        std::lock_guard<std::mutex> l(err_lock);
+        return err != ERR_OK;
+    };
+
+    // each worker writes the parts at their offsets of the file through its own stream, and
+    // all the workers share the read token bucket of the service
+    auto download_parts = [&]() {
+        std::fstream os(local_file, std::ios::binary | std::ios::in | std::ios::out);
+        if (!os.is_open()) {
+            derror_f("fds download failed: fail to open localfile({}) when download({}) in parts",
+                     local_file,
+                     _fds_path);
+            set_error(ERR_FILE_OPERATION_FAILED);
+            return;
+        }
+
+        for (uint64_t part = next_part++; part < part_count && !has_error(); part = next_part++) {
+            uint64_t start = part * part_size;
+            uint64_t length = std::min(part_size, _size - start);
+            uint64_t part_bytes = 0;
+            error_code ec = ERR_OK;
+            for (int attempt = 1; attempt <= max_attempts; ++attempt) {
+                os.seekp(start);
+                ec = get_content_in_batches(start, length, os, part_bytes, local_file);
+                if (ec == ERR_OK && !os) {
+                    ec = ERR_FILE_OPERATION_FAILED;
+                    break;
+                }
+                if (ec == ERR_OBJECT_NOT_FOUND || (ec == ERR_OK && part_bytes == length)) {
+                    break;
+                }
+                // a part shorter than expected is caused by a broken response, try it again
+                dwarn_f("fds download part({}) of {} failed at attempt {}: error({}), "
+                        "got {} of {} bytes",
+                        part,
+                        _fds_path,
+                        attempt,
+                        ec,
+                        part_bytes,
+                        length);
+                if (ec == ERR_OK) {
+                    ec = ERR_FS_INTERNAL;
+                }
+            }
+            if (ec != ERR_OK) {
+                set_error(ec);
+                return;
+            }
+            total_bytes += part_bytes;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint64_t i = 1; i < concurrency; ++i) {
+        workers.emplace_back(download_parts);
+    }
+    download_parts();
+    for (auto &w : workers) {
+        w.join();
+    }
+
+    transfered_bytes = total_bytes.load();
+    return err;
+}
+
 error_code fds_file_object::get_content(uint64_t pos,
                                         uint64_t length,
                                         /*out*/ std::ostream &os,
@@ -765,8 +1051,22 @@ dsn::task_ptr fds_file_object::upload(const upload_request &req,
                    ptr);
             resp.err = dsn::ERR_FILE_OPERATION_FAILED;
         } else {
+            io_scheduler::instance().consume(io_class::BACKUP, local_file, file_sz);
+
+            // the checkpoint files are hard links of the sst files, whose pages in use by the
+            // storage engine are kept
+            int fd = FLAGS_fds_upload_drop_behind ? ::open(local_file.c_str(), O_RDONLY) : -1;
+            std::unique_ptr<dsn::utils::page_cache_advisor> advisor;
+            if (fd >= 0) {
+                advisor.reset(new dsn::utils::page_cache_advisor(fd, 0, true));
+                advisor->on_read(0, static_cast<uint64_t>(file_sz));
+            }
             resp.err = put_content(is, file_sz, resp.uploaded_size);
             is.close();
+            if (fd >= 0) {
+                advisor.reset();
+                ::close(fd);
+            }
         }
 
         t->enqueue_with(resp);
@@ -850,12 +1150,31 @@ dsn::task_ptr fds_file_object::download(const download_request &req,
     auto download_background = [this, req, handle, t]() {
         download_response resp;
         uint64_t transfered_size;
-        resp.err =
-            get_content_in_batches(req.remote_pos, req.remote_length, *handle, transfered_size);
         resp.downloaded_size = 0;
-        if (handle->tellp() != -1)
-            resp.downloaded_size = handle->tellp();
-        handle->close();
+
+        bool whole_file = req.remote_pos == 0 && req.remote_length == -1;
+        if (whole_file && FLAGS_fds_download_part_concurrency > 1 && !_has_meta_synced) {
+            resp.err = get_file_meta();
+        } else {
+            resp.err = ERR_OK;
+        }
+        if (resp.err == ERR_OK && whole_file && FLAGS_fds_download_part_concurrency > 1 &&
+            _size > (static_cast<uint64_t>(FLAGS_fds_download_part_size_kb) << 10)) {
+            handle->close();
+            resp.err = get_content_in_parts(req.output_local_name, transfered_size);
+            resp.downloaded_size = transfered_size;
+        } else {
+            if (resp.err == ERR_OK) {
+                resp.err = get_content_in_batches(req.remote_pos,
+                                                  req.remote_length,
+                                                  *handle,
+                                                  transfered_size,
+                                                  req.output_local_name);
+            }
+            if (handle->tellp() != -1)
+                resp.downloaded_size = handle->tellp();
+            handle->close();
+        }
         t->enqueue_with(resp);
         release_ref();
     };
@@ -39,6 +39,12 @@ public:
                                    const ls_callback &callback,
                                    dsn::task_tracker *tracker) override;
 
+    virtual dsn::task_ptr list_dir_in_pages(const ls_request &req,
+                                            const ls_page_handler &handler,
+                                            dsn::task_code code,
+                                            const ls_callback &callback,
+                                            dsn::task_tracker *tracker) override;
+
     virtual dsn::task_ptr create_file(const create_file_request &req,
                                       dsn::task_code code,
                                       const create_file_callback &cb,
@@ -60,8 +66,8 @@ public:
     //
     // Attention：
     //   -- remove the path directly on fds, will not enter trash
-    //   -- when req.path is a directory, this operation may consume much time if there are many
-    //      files under this directory
+    //   -- when req.path is a directory, the files under it are listed page by page and deleted
+    //      in batches by [replication] fds_remove_concurrency threads
     //
     virtual dsn::task_ptr remove_path(const remove_path_request &req,
                                       dsn::task_code code,
@@ -69,6 +75,12 @@ public:
                                       dsn::task_tracker *tracker) override;
 
 private:
+    // list the entries under req.dir_name synchronously, and pass them to `handler` in pages
+    error_code list_entries(const ls_request &req, const ls_page_handler &handler);
+    // remove the file of `path` and all the files under it synchronously
+    error_code remove_objects(const std::string &path);
+    error_code delete_objects(const std::vector<std::string> &fds_paths);
+
     std::shared_ptr<galaxy::fds::GalaxyFDSClient> _client;
     std::string _bucket_name;
     std::unique_ptr<folly::TokenBucket> _read_token_bucket;
@@ -112,10 +124,18 @@ public:
                                    dsn::task_tracker *tracker) override;
 
 private:
+    // `local_file` is the destination of the content if it is downloaded, which is used to
+    // schedule the disk i/o
     error_code get_content_in_batches(uint64_t start,
                                       int64_t length,
                                       /*out*/ std::ostream &os,
-                                      /*out*/ uint64_t &transfered_bytes);
+                                      /*out*/ uint64_t &transfered_bytes,
+                                      const std::string &local_file = std::string());
+    // download the whole file into `local_file` in parts of [replication]
+    // fds_download_part_size_kb, with [replication] fds_download_part_concurrency ranged
+    // requests in parallel, which requires the file meta to be synced
+    error_code get_content_in_parts(const std::string &local_file,
+                                    /*out*/ uint64_t &transfered_bytes);
     error_code get_content(uint64_t pos,
                            uint64_t length,
                            /*out*/ std::ostream &os,
@@ -1,24 +1,233 @@
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
 #include <memory>
+#include <unistd.h>
+
+#include <openssl/md5.h>
 
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/error_code.h>
 #include <dsn/utility/defer.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/utils.h>
 #include <dsn/utility/strings.h>
 #include <dsn/utility/safe_strerror_posix.h>
 
 #include <dsn/cpp/json_helper.h>
+#include <dsn/tool-api/file_io.h>
 #include <dsn/tool-api/task_tracker.h>
 #include "local_service.h"
 
-static const int max_length = 2048; // max data length read from file each time
-
 namespace dsn {
 namespace dist {
 namespace block_service {
 
+DSN_DEFINE_uint32("replication",
+                  local_service_io_chunk_kb,
+                  1024,
+                  "the size of each chunk read or written by aio when local_service copies a file");
+DSN_DEFINE_uint32("replication",
+                  local_service_io_depth,
+                  4,
+                  "the max count of chunks in flight when local_service copies a file");
+DSN_DEFINE_bool("replication",
+                local_service_direct_io,
+                false,
+                "whether local_service copies files with O_DIRECT, bypassing the page cache");
+
 DEFINE_THREAD_POOL_CODE(THREAD_POOL_LOCAL_SERVICE)
 DEFINE_TASK_CODE(LPC_LOCAL_SERVICE_CALL, TASK_PRIORITY_COMMON, THREAD_POOL_LOCAL_SERVICE)
+// the aio of local_service is issued without callback and waited in LPC_LOCAL_SERVICE_CALL,
+// so it must not be completed in THREAD_POOL_LOCAL_SERVICE
+DEFINE_TASK_CODE_AIO(LPC_LOCAL_SERVICE_AIO, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+// the alignment of the buffers, offsets and lengths of direct i/o
+static const uint64_t direct_io_alignment = 4096;
+
+static uint64_t align_up(uint64_t size)
+{
+    return (size + direct_io_alignment - 1) / direct_io_alignment * direct_io_alignment;
+}
+
+struct aligned_buffer_deleter
+{
+    void operator()(char *p) const { free(p); }
+};
+typedef std::unique_ptr<char, aligned_buffer_deleter> aligned_buffer;
+
+static std::string md5_to_string(MD5_CTX &ctx)
+{
+    unsigned char out[MD5_DIGEST_LENGTH];
+    MD5_Final(out, &ctx);
+
+    char str[MD5_DIGEST_LENGTH * 2 + 1];
+    str[MD5_DIGEST_LENGTH * 2] = 0;
+    for (int n = 0; n < MD5_DIGEST_LENGTH; n++)
+        sprintf(str + n + n, "%02x", out[n]);
+    return std::string(str);
+}
+
+// open the file with O_DIRECT if `direct` is true, and fall back to buffered i/o if the file
+// system doesn't support it, `direct` is reset to false then
+static disk_file *open_file(const std::string &path, int flag, int pmode, /*inout*/ bool &direct)
+{
+    if (direct) {
+        disk_file *f = file::open(path.c_str(), flag | O_DIRECT, pmode);
+        if (f != nullptr) {
+            return f;
+        }
+        dwarn("open file(%s) with O_DIRECT failed, err(%s), fall back to buffered i/o",
+              path.c_str(),
+              utils::safe_strerror(errno).c_str());
+        direct = false;
+    }
+    return file::open(path.c_str(), flag, pmode);
+}
+
+//
+// copy the file `from` to `to` by aio in chunks of [replication] local_service_io_chunk_kb,
+// with at most [replication] local_service_io_depth chunks in flight: the chunks are read
+// ahead while the previous ones are being written, and the md5 of the data is computed in
+// the order of the chunks, so the file needn't be read again after copied.
+//
+static error_code copy_file_by_aio(const std::string &from,
+                                   const std::string &to,
+                                   /*out*/ uint64_t &copied_size,
+                                   /*out*/ std::string &md5)
+{
+    int64_t size = 0;
+    if (!utils::filesystem::file_size(from, size)) {
+        derror("get size of file(%s) failed", from.c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    const uint64_t file_size = static_cast<uint64_t>(size);
+    const uint64_t chunk_size =
+        align_up(std::min(std::max(FLAGS_local_service_io_chunk_kb, 4u), 1024u * 1024) * 1024);
+    const uint64_t chunk_count = (file_size + chunk_size - 1) / chunk_size;
+    const uint32_t depth = std::max(FLAGS_local_service_io_depth, 2u);
+
+    bool in_direct = FLAGS_local_service_direct_io;
+    disk_file *in = open_file(from, O_RDONLY | O_BINARY, 0, in_direct);
+    if (in == nullptr) {
+        derror("open source file(%s) for read failed, err(%s)",
+               from.c_str(),
+               utils::safe_strerror(errno).c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    auto close_in = dsn::defer([in]() { file::close(in); });
+
+    bool out_direct = FLAGS_local_service_direct_io;
+    disk_file *out = open_file(to, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666, out_direct);
+    if (out == nullptr) {
+        derror("open target file(%s) for write failed, err(%s)",
+               to.c_str(),
+               utils::safe_strerror(errno).c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    struct slot
+    {
+        aligned_buffer buffer;
+        aio_task_ptr read_task;
+        aio_task_ptr write_task;
+    };
+    std::vector<slot> slots(depth);
+    for (slot &s : slots) {
+        void *p = nullptr;
+        int ret = posix_memalign(&p, direct_io_alignment, chunk_size);
+        dassert(ret == 0, "allocate aligned buffer of %" PRIu64 " bytes failed", chunk_size);
+        s.buffer.reset(static_cast<char *>(p));
+    }
+
+    error_code err = ERR_OK;
+    auto wait_write = [&err, &to](slot &s) {
+        if (s.write_task != nullptr) {
+            s.write_task->wait();
+            if (s.write_task->error() != ERR_OK && err == ERR_OK) {
+                derror("write file(%s) failed, err = %s",
+                       to.c_str(),
+                       s.write_task->error().to_string());
+                err = ERR_FILE_OPERATION_FAILED;
+            }
+            s.write_task = nullptr;
+        }
+    };
+    // the buffer of a slot is reused for reading only after its last chunk has been written
+    auto issue_read = [&](uint64_t index) {
+        slot &s = slots[index % depth];
+        wait_write(s);
+        if (err == ERR_OK) {
+            s.read_task = file::read(in,
+                                     s.buffer.get(),
+                                     static_cast<int>(chunk_size),
+                                     index * chunk_size,
+                                     LPC_LOCAL_SERVICE_AIO,
+                                     nullptr,
+                                     nullptr);
+        }
+    };
+
+    MD5_CTX ctx;
+    MD5_Init(&ctx);
+    uint64_t next_read = 0;
+    for (; next_read < std::min<uint64_t>(depth - 1, chunk_count); ++next_read) {
+        issue_read(next_read);
+    }
+    for (uint64_t i = 0; i < chunk_count && err == ERR_OK; ++i) {
+        slot &s = slots[i % depth];
+        s.read_task->wait();
+        uint64_t expected = std::min(chunk_size, file_size - i * chunk_size);
+        if (s.read_task->error() != ERR_OK || s.read_task->get_transferred_size() != expected) {
+            derror("read file(%s) at offset %" PRIu64 " failed, err = %s, read_size = %d",
+                   from.c_str(),
+                   i * chunk_size,
+                   s.read_task->error().to_string(),
+                   static_cast<int>(s.read_task->get_transferred_size()));
+            err = ERR_FILE_OPERATION_FAILED;
+            break;
+        }
+        s.read_task = nullptr;
+
+        MD5_Update(&ctx, s.buffer.get(), expected);
+        // the tail of the file is written in a whole aligned block with O_DIRECT,
+        // and truncated after all the chunks are written
+        s.write_task = file::write(out,
+                                   s.buffer.get(),
+                                   static_cast<int>(out_direct ? align_up(expected) : expected),
+                                   i * chunk_size,
+                                   LPC_LOCAL_SERVICE_AIO,
+                                   nullptr,
+                                   nullptr);
+
+        if (next_read < chunk_count) {
+            issue_read(next_read++);
+        }
+    }
+
+    // wait for all the aio in flight before the buffers are freed
+    for (slot &s : slots) {
+        if (s.read_task != nullptr) {
+            s.read_task->wait();
+        }
+        wait_write(s);
+    }
+    file::close(out);
+
+    if (err == ERR_OK && out_direct && file_size % direct_io_alignment != 0 &&
+        ::truncate(to.c_str(), static_cast<off_t>(file_size)) != 0) {
+        derror("truncate file(%s) to %" PRIu64 " failed, err(%s)",
+               to.c_str(),
+               file_size,
+               utils::safe_strerror(errno).c_str());
+        err = ERR_FILE_OPERATION_FAILED;
+    }
+    if (err == ERR_OK) {
+        copied_size = file_size;
+        md5 = md5_to_string(ctx);
+    }
+    return err;
+}
 
 struct file_metadata
 {
@@ -62,6 +271,67 @@ error_code local_service::initialize(const std::vector<std::string> &args)
     return ERR_OK;
 }
 
+error_code local_service::list_entries(const ls_request &req, const ls_page_handler &handler)
+{
+    std::string dir_path = ::dsn::utils::filesystem::path_combine(_root, req.dir_name);
+    if (::dsn::utils::filesystem::file_exists(dir_path)) {
+        ddebug("list_dir: invalid parameter(%s)", dir_path.c_str());
+        return ERR_INVALID_PARAMETERS;
+    }
+    if (!::dsn::utils::filesystem::directory_exists(dir_path)) {
+        ddebug("directory does not exist, dir = %s", dir_path.c_str());
+        return ERR_OBJECT_NOT_FOUND;
+    }
+
+    DIR *dir = ::opendir(dir_path.c_str());
+    if (dir == nullptr) {
+        derror("open directory %s failed, err = %s",
+               dir_path.c_str(),
+               utils::safe_strerror(errno).c_str());
+        return ERR_FS_INTERNAL;
+    }
+    auto cleanup = dsn::defer([dir]() { ::closedir(dir); });
+
+    const size_t page_size = std::max(req.page_size, 1U);
+    std::vector<ls_entry> page;
+    while (true) {
+        errno = 0;
+        struct dirent *ent = ::readdir(dir);
+        if (ent == nullptr) {
+            if (errno != 0) {
+                derror("read directory %s failed, err = %s",
+                       dir_path.c_str(),
+                       utils::safe_strerror(errno).c_str());
+                return ERR_FS_INTERNAL;
+            }
+            break;
+        }
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+
+        std::string path = ::dsn::utils::filesystem::path_combine(dir_path, ent->d_name);
+        bool is_directory = ent->d_type == DT_DIR ||
+                            (ent->d_type == DT_UNKNOWN &&
+                             ::dsn::utils::filesystem::directory_exists(path));
+        // a file is listed only if its metafile exists, the metafiles themselves are not
+        if (!is_directory && !::dsn::utils::filesystem::file_exists(get_metafile(path))) {
+            continue;
+        }
+        page.push_back({ent->d_name, is_directory});
+        if (page.size() >= page_size) {
+            if (!handler(page)) {
+                return ERR_OK;
+            }
+            page.clear();
+        }
+    }
+    if (!page.empty()) {
+        handler(page);
+    }
+    return ERR_OK;
+}
+
 dsn::task_ptr local_service::list_dir(const ls_request &req,
                                       dsn::task_code code,
                                       const ls_callback &callback,
@@ -72,54 +342,34 @@ dsn::task_ptr local_service::list_dir(const ls_request &req,
 
     // process
     auto list_dir_background = [this, req, tsk]() {
-        std::string dir_path = ::dsn::utils::filesystem::path_combine(_root, req.dir_name);
-        std::vector<std::string> children;
-
         ls_response resp;
-        resp.err = ERR_OK;
-
-        if (::dsn::utils::filesystem::file_exists(dir_path)) {
-            ddebug("list_dir: invalid parameter(%s)", dir_path.c_str());
-            resp.err = ERR_INVALID_PARAMETERS;
-        } else if (!::dsn::utils::filesystem::directory_exists(dir_path)) {
-            ddebug("directory does not exist, dir = %s", dir_path.c_str());
-            resp.err = ERR_OBJECT_NOT_FOUND;
-        } else {
-            if (!::dsn::utils::filesystem::get_subfiles(dir_path, children, false)) {
-                derror("get files under directory: %s fail", dir_path.c_str());
-                resp.err = ERR_FS_INTERNAL;
-                children.clear();
-            } else {
-                ls_entry tentry;
-                tentry.is_directory = false;
+        std::vector<ls_entry> &entries = *resp.entries;
+        resp.err = list_entries(req, [&entries](const std::vector<ls_entry> &page) {
+            entries.insert(entries.end(), page.begin(), page.end());
+            return true;
+        });
+        if (resp.err != ERR_OK) {
+            entries.clear();
+        }
+        tsk->enqueue_with(std::move(resp));
+    };
 
-                std::set<std::string> file_matcher;
-                for (const std::string &file : children) {
-                    file_matcher.insert(utils::filesystem::get_file_name(file));
-                }
-                for (const auto &file : file_matcher) {
-                    if (file_matcher.find(get_metafile(file)) != file_matcher.end()) {
-                        tentry.entry_name = file;
-                        resp.entries->emplace_back(tentry);
-                    }
-                }
-            }
+    tasking::enqueue(LPC_LOCAL_SERVICE_CALL, nullptr, std::move(list_dir_background));
+    return tsk;
+}
 
-            children.clear();
-            if (!::dsn::utils::filesystem::get_subdirectories(dir_path, children, false)) {
-                derror("get subpaths under directory: %s fail", dir_path.c_str());
-                resp.err = ERR_FS_INTERNAL;
-                children.clear();
-            } else {
-                ls_entry tentry;
-                tentry.is_directory = true;
+dsn::task_ptr local_service::list_dir_in_pages(const ls_request &req,
+                                               const ls_page_handler &handler,
+                                               dsn::task_code code,
+                                               const ls_callback &callback,
+                                               task_tracker *tracker)
+{
+    ls_future_ptr tsk(new ls_future(code, callback, 0));
+    tsk->set_tracker(tracker);
 
-                for (const auto &dir : children) {
-                    tentry.entry_name = ::dsn::utils::filesystem::get_file_name(dir);
-                    resp.entries->emplace_back(tentry);
-                }
-            }
-        }
+    auto list_dir_background = [this, req, handler, tsk]() {
+        ls_response resp;
+        resp.err = list_entries(req, handler);
         tsk->enqueue_with(std::move(resp));
     };
 
@@ -359,13 +609,32 @@ dsn::task_ptr local_file_object::write(const write_request &req,
         if (resp.err == ERR_OK) {
             dinfo("start write file, file = %s", file_name().c_str());
 
-            std::ofstream fout(file_name(), std::ifstream::out | std::ifstream::trunc);
-            if (!fout.is_open()) {
+            disk_file *f =
+                file::open(file_name().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+            if (f == nullptr) {
                 resp.err = ERR_FS_INTERNAL;
-            } else {
-                fout.write(req.buffer.data(), req.buffer.length());
+            } else if (req.buffer.length() > 0) {
+                auto t = file::write(f,
+                                     req.buffer.data(),
+                                     req.buffer.length(),
+                                     0,
+                                     LPC_LOCAL_SERVICE_AIO,
+                                     nullptr,
+                                     nullptr);
+                t->wait();
+                if (t->error() != ERR_OK || t->get_transferred_size() != req.buffer.length()) {
+                    derror("write file(%s) failed, err = %s",
+                           file_name().c_str(),
+                           t->error().to_string());
+                    resp.err = ERR_FS_INTERNAL;
+                }
+            }
+            if (f != nullptr) {
+                file::close(f);
+            }
+
+            if (resp.err == ERR_OK) {
                 resp.written_size = req.buffer.length();
-                fout.close();
 
                 // Currently we calc the meta data from source data, which save the io bandwidth
                 // a lot, but it is somewhat not correct.
@@ -413,17 +682,31 @@ dsn::task_ptr local_file_object::read(const read_request &req,
 
                 dinfo("read file(%s), size = %ld", file_name().c_str(), total_sz);
                 std::string buf;
-                buf.resize(total_sz + 1);
-                std::ifstream fin(file_name(), std::ifstream::in);
-                if (!fin.is_open()) {
+                disk_file *f = file::open(file_name().c_str(), O_RDONLY | O_BINARY, 0);
+                if (f == nullptr) {
                     resp.err = ERR_FS_INTERNAL;
                 } else {
-                    fin.seekg(static_cast<int64_t>(req.remote_pos), fin.beg);
-                    fin.read((char *)buf.c_str(), total_sz);
-                    buf[fin.gcount()] = '\0';
+                    if (total_sz > 0) {
+                        buf.resize(total_sz);
+                        auto t = file::read(f,
+                                            &buf[0],
+                                            static_cast<int>(total_sz),
+                                            req.remote_pos,
+                                            LPC_LOCAL_SERVICE_AIO,
+                                            nullptr,
+                                            nullptr);
+                        t->wait();
+                        if (t->error() != ERR_OK && t->error() != ERR_HANDLE_EOF) {
+                            derror("read file(%s) failed, err = %s",
+                                   file_name().c_str(),
+                                   t->error().to_string());
+                            resp.err = ERR_FS_INTERNAL;
+                        }
+                        buf.resize(t->get_transferred_size());
+                    }
+                    file::close(f);
                     resp.buffer = blob::create_from_bytes(std::move(buf));
                 }
-                fin.close();
             }
         }
 
@@ -445,55 +728,28 @@ dsn::task_ptr local_file_object::upload(const upload_request &req,
     tsk->set_tracker(tracker);
     auto upload_file_func = [this, req, tsk]() {
         upload_response resp;
-        resp.err = ERR_OK;
-        std::ifstream fin(req.input_local_name, std::ios_base::in);
-        if (!fin.is_open()) {
-            dwarn("open source file %s for read failed, err(%s)",
-                  req.input_local_name.c_str(),
-                  utils::safe_strerror(errno).c_str());
-            resp.err = ERR_FILE_OPERATION_FAILED;
-        }
-
+        dinfo("start to transfer from src_file(%s) to des_file(%s)",
+              req.input_local_name.c_str(),
+              file_name().c_str());
+        uint64_t total_sz = 0;
+        std::string md5;
+        // create the parent directories of the target file
         utils::filesystem::create_file(file_name());
-        std::ofstream fout(file_name(), std::ios_base::out | std::ios_base::trunc);
-        if (!fout.is_open()) {
-            dwarn("open target file %s for write failed, err(%s)",
-                  file_name().c_str(),
-                  utils::safe_strerror(errno).c_str());
-            resp.err = ERR_FS_INTERNAL;
-        }
-
+        resp.err = copy_file_by_aio(req.input_local_name, file_name(), total_sz, md5);
         if (resp.err == ERR_OK) {
-            dinfo("start to transfer from src_file(%s) to des_file(%s)",
-                  req.input_local_name.c_str(),
-                  file_name().c_str());
-            int64_t total_sz = 0;
-            char buf[max_length] = {'\0'};
-            while (!fin.eof()) {
-                fin.read(buf, max_length);
-                total_sz += fin.gcount();
-                fout.write(buf, fin.gcount());
-            }
-            dinfo("finish upload file, file = %s, total_size = %d", file_name().c_str(), total_sz);
-            fout.close();
-            fin.close();
-
-            resp.uploaded_size = static_cast<uint64_t>(total_sz);
+            dinfo("finish upload file, file = %s, total_size = %" PRIu64,
+                  file_name().c_str(),
+                  total_sz);
+            resp.uploaded_size = total_sz;
 
-            // calc the md5sum by source file for simplicity
             _size = total_sz;
-            error_code res = utils::filesystem::md5sum(req.input_local_name, _md5_value);
-            if (res == dsn::ERR_OK) {
-                _has_meta_synced = true;
-                store_metadata();
-            } else {
-                resp.err = ERR_FS_INTERNAL;
-            }
+            _md5_value = std::move(md5);
+            _has_meta_synced = true;
+            store_metadata();
         } else {
-            if (fin.is_open())
-                fin.close();
-            if (fout.is_open())
-                fout.close();
+            dwarn("upload file(%s) to %s failed",
+                  req.input_local_name.c_str(),
+                  file_name().c_str());
         }
 
         tsk->enqueue_with(resp);
@@ -532,48 +788,24 @@ dsn::task_ptr local_file_object::download(const download_request &req,
         }
 
         if (resp.err == ERR_OK) {
-            std::ifstream fin(file_name(), std::ifstream::in);
-            if (!fin.is_open()) {
-                derror("open block file(%s) failed, err(%s)",
-                       file_name().c_str(),
-                       utils::safe_strerror(errno).c_str());
-                resp.err = ERR_FS_INTERNAL;
-            }
-
-            std::ofstream fout(target_file, std::ios_base::out | std::ios_base::trunc);
-            if (!fout.is_open()) {
-                if (fin.is_open())
-                    fin.close();
-                derror("open target file(%s) failed, err(%s)",
-                       target_file.c_str(),
-                       utils::safe_strerror(errno).c_str());
-                resp.err = ERR_FILE_OPERATION_FAILED;
-            }
-
+            dinfo("start to transfer, src_file(%s), des_file(%s)",
+                  file_name().c_str(),
+                  target_file.c_str());
+            uint64_t total_sz = 0;
+            std::string md5;
+            resp.err = copy_file_by_aio(file_name(), target_file, total_sz, md5);
             if (resp.err == ERR_OK) {
-                dinfo("start to transfer, src_file(%s), des_file(%s)",
-                      file_name().c_str(),
-                      target_file.c_str());
-                int64_t total_sz = 0;
-                char buf[max_length] = {'\0'};
-                while (!fin.eof()) {
-                    fin.read(buf, max_length);
-                    total_sz += fin.gcount();
-                    fout.write(buf, fin.gcount());
-                }
-                dinfo("finish download file(%s), total_size = %d", target_file.c_str(), total_sz);
-                fout.close();
-                fin.close();
-                resp.downloaded_size = static_cast<uint64_t>(total_sz);
+                dinfo("finish download file(%s), total_size = %" PRIu64,
+                      target_file.c_str(),
+                      total_sz);
+                resp.downloaded_size = total_sz;
+                resp.file_md5 = md5;
 
                 _size = total_sz;
-                if ((resp.err = utils::filesystem::md5sum(target_file, _md5_value)) != ERR_OK) {
-                    dwarn("download %s failed when calculate the md5sum of %s",
-                          file_name().c_str(),
-                          target_file.c_str());
-                } else {
-                    _has_meta_synced = true;
-                }
+                _md5_value = std::move(md5);
+                _has_meta_synced = true;
+            } else {
+                dwarn("download %s to %s failed", file_name().c_str(), target_file.c_str());
             }
         }
 
@@ -19,6 +19,12 @@ public:
                                    const ls_callback &callback,
                                    dsn::task_tracker *tracker = nullptr) override;
 
+    virtual dsn::task_ptr list_dir_in_pages(const ls_request &req,
+                                            const ls_page_handler &handler,
+                                            dsn::task_code code,
+                                            const ls_callback &callback,
+                                            dsn::task_tracker *tracker = nullptr) override;
+
     virtual dsn::task_ptr create_file(const create_file_request &req,
                                       dsn::task_code code,
                                       const create_file_callback &cb,
@@ -44,6 +50,10 @@ public:
     static std::string get_metafile(const std::string &filepath);
 
 private:
+    // list the entries under req.dir_name synchronously by reading the directory
+    // incrementally, and pass them to `handler` in pages
+    error_code list_entries(const ls_request &req, const ls_page_handler &handler);
+
     std::string _root;
 };
 
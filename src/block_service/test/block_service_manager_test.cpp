@@ -85,6 +85,19 @@ TEST_F(block_service_manager_test, do_download_file_exist)
     ASSERT_EQ(test_download_file(), ERR_OK);
 }
 
+TEST_F(block_service_manager_test, do_download_file_exist_with_md5)
+{
+    create_local_file(FILE_NAME);
+    create_remote_file(FILE_NAME, _file_meta.size, _file_meta.md5);
+    uint64_t download_size = 0;
+    std::string download_md5;
+    ASSERT_EQ(ERR_OK,
+              _block_service_manager.download_file(
+                  PROVIDER, LOCAL_DIR, FILE_NAME, _fs.get(), download_size, download_md5));
+    ASSERT_EQ(static_cast<uint64_t>(_file_meta.size), download_size);
+    ASSERT_EQ(_file_meta.md5, download_md5);
+}
+
 TEST_F(block_service_manager_test, do_download_succeed)
 {
     create_local_file(FILE_NAME);
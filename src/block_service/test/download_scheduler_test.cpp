@@ -0,0 +1,85 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "block_service/download_scheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace dist {
+namespace block_service {
+
+TEST(download_scheduler_test, adjust_concurrency)
+{
+    uint64_t now = 0;
+    download_scheduler scheduler([&now]() { return now; });
+    ASSERT_EQ(1u, scheduler.concurrency());
+
+    // speed up while the throughput doesn't drop
+    scheduler.acquire();
+    now = 5000;
+    scheduler.release(5000);
+    ASSERT_EQ(2u, scheduler.concurrency());
+
+    scheduler.acquire();
+    scheduler.acquire();
+    ASSERT_EQ(2u, scheduler.running());
+    now = 10000;
+    scheduler.release(6000);
+    scheduler.release(0);
+    ASSERT_EQ(3u, scheduler.concurrency());
+    ASSERT_EQ(0u, scheduler.running());
+
+    // turn back once the throughput drops
+    now = 15000;
+    scheduler.acquire();
+    scheduler.release(1000);
+    ASSERT_EQ(2u, scheduler.concurrency());
+
+    now = 20000;
+    scheduler.acquire();
+    scheduler.release(1000);
+    ASSERT_EQ(1u, scheduler.concurrency());
+
+    // never be under the min concurrency
+    now = 25000;
+    scheduler.acquire();
+    scheduler.release(1000);
+    ASSERT_EQ(2u, scheduler.concurrency());
+
+    // not adjusted until the interval is over
+    now = 26000;
+    scheduler.acquire();
+    scheduler.release(100000);
+    ASSERT_EQ(2u, scheduler.concurrency());
+}
+
+TEST(download_scheduler_test, acquire_blocked)
+{
+    uint64_t now = 0;
+    download_scheduler scheduler([&now]() { return now; });
+    scheduler.acquire();
+
+    std::atomic<bool> acquired{false};
+    std::thread t([&scheduler, &acquired]() {
+        scheduler.acquire();
+        acquired.store(true);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(acquired.load());
+
+    scheduler.release(0);
+    t.join();
+    ASSERT_TRUE(acquired.load());
+    ASSERT_EQ(1u, scheduler.running());
+    scheduler.release(0);
+}
+
+} // namespace block_service
+} // namespace dist
+} // namespace dsn
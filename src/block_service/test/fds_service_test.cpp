@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/rand.h>
 #include <dsn/dist/block_service.h>
 #include <memory>
@@ -876,3 +877,78 @@ TEST_F(FDSClientTest, test_concurrent_upload_download)
         }
     }
 }
+
+namespace dsn {
+namespace dist {
+namespace block_service {
+DSN_DECLARE_uint32(fds_download_part_concurrency);
+DSN_DECLARE_uint32(fds_download_part_size_kb);
+} // namespace block_service
+} // namespace dist
+} // namespace dsn
+
+TEST_F(FDSClientTest, test_download_in_parts)
+{
+    std::shared_ptr<fds_service> s = std::make_shared<fds_service>();
+    std::vector<std::string> args = {server_address, access_key, access_secret, bucket_name};
+
+    if (server_address == example_server_address) {
+        // user don't specify the server-address, we just return true
+        return;
+    }
+
+    s->initialize(args);
+
+    create_file_response cf_resp;
+    upload_response u_resp;
+    download_response d_resp;
+    const std::string remote_file = "/fds_multipart/test_file";
+
+    s->create_file(create_file_request{remote_file, true},
+                   lpc_btest,
+                   [&cf_resp](const create_file_response &r) { cf_resp = r; },
+                   nullptr)
+        ->wait();
+    ASSERT_EQ(dsn::ERR_OK, cf_resp.err);
+    cf_resp.file_handle
+        ->upload(upload_request{f1.filename},
+                 lpc_btest,
+                 [&u_resp](const upload_response &r) { u_resp = r; },
+                 nullptr)
+        ->wait();
+    ASSERT_EQ(dsn::ERR_OK, u_resp.err);
+    ASSERT_EQ(f1.length, u_resp.uploaded_size);
+
+    // f1 is at least 32KB, which is split into parts of 4KB with an uneven last part
+    FLAGS_fds_download_part_concurrency = 4;
+    FLAGS_fds_download_part_size_kb = 4;
+    for (bool ignore_metadata : {true, false}) {
+        std::cout << "test download in parts, ignore metadata: " << ignore_metadata << std::endl;
+        s->create_file(create_file_request{remote_file, ignore_metadata},
+                       lpc_btest,
+                       [&cf_resp](const create_file_response &r) { cf_resp = r; },
+                       nullptr)
+            ->wait();
+        ASSERT_EQ(dsn::ERR_OK, cf_resp.err);
+
+        cf_resp.file_handle
+            ->download(download_request{local_file_for_download, 0, -1},
+                       lpc_btest,
+                       [&d_resp](const download_response &r) { d_resp = r; },
+                       nullptr)
+            ->wait();
+        ASSERT_EQ(dsn::ERR_OK, d_resp.err);
+        ASSERT_EQ(f1.length, d_resp.downloaded_size);
+        file_eq_compare(f1.filename, local_file_for_download);
+    }
+    FLAGS_fds_download_part_concurrency = 1;
+    FLAGS_fds_download_part_size_kb = 16384;
+
+    remove_path_response rem_resp;
+    s->remove_path(remove_path_request{"/fds_multipart", true},
+                   lpc_btest,
+                   [&rem_resp](const remove_path_response &r) { rem_resp = r; },
+                   nullptr)
+        ->wait();
+    ASSERT_EQ(dsn::ERR_OK, rem_resp.err);
+}
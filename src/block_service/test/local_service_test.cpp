@@ -0,0 +1,236 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <fstream>
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include <dsn/service_api_cpp.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/rand.h>
+
+#include "block_service/local/local_service.h"
+
+namespace dsn {
+namespace dist {
+namespace block_service {
+
+DSN_DECLARE_uint32(local_service_io_chunk_kb);
+DSN_DECLARE_uint32(local_service_io_depth);
+DSN_DECLARE_bool(local_service_direct_io);
+
+DEFINE_TASK_CODE(LPC_LOCAL_SERVICE_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+class local_service_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        _root = "./local_service_test";
+        utils::filesystem::remove_path(_root);
+        _service.initialize({_root});
+
+        // 3 full chunks and a tail, which is not aligned for direct i/o
+        _content.resize(3 * 4096 + 100);
+        for (char &c : _content) {
+            c = static_cast<char>(rand::next_u32(0, 255));
+        }
+        _src_file = "./local_service_test_src";
+        std::ofstream os(_src_file, std::ios::binary | std::ios::trunc);
+        os.write(_content.data(), _content.size());
+        os.close();
+        ASSERT_EQ(ERR_OK, utils::filesystem::md5sum(_src_file, _md5));
+
+        FLAGS_local_service_io_chunk_kb = 4;
+        FLAGS_local_service_io_depth = 2;
+    }
+
+    void TearDown() override
+    {
+        FLAGS_local_service_io_chunk_kb = 1024;
+        FLAGS_local_service_io_depth = 4;
+        FLAGS_local_service_direct_io = false;
+        utils::filesystem::remove_path(_root);
+        utils::filesystem::remove_path(_src_file);
+    }
+
+    block_file_ptr create_file(const std::string &name)
+    {
+        create_file_response resp;
+        _service
+            .create_file(create_file_request{name, false},
+                         LPC_LOCAL_SERVICE_TEST,
+                         [&resp](const create_file_response &r) { resp = r; })
+            ->wait();
+        EXPECT_EQ(ERR_OK, resp.err);
+        return resp.file_handle;
+    }
+
+    void test_upload_and_download(const std::string &name)
+    {
+        block_file_ptr file = create_file(name);
+        upload_response u_resp;
+        file->upload(upload_request{_src_file},
+                     LPC_LOCAL_SERVICE_TEST,
+                     [&u_resp](const upload_response &r) { u_resp = r; })
+            ->wait();
+        ASSERT_EQ(ERR_OK, u_resp.err);
+        ASSERT_EQ(_content.size(), u_resp.uploaded_size);
+        ASSERT_EQ(_content.size(), file->get_size());
+        ASSERT_EQ(_md5, file->get_md5sum());
+
+        // reload the metadata from disk
+        file = create_file(name);
+        ASSERT_EQ(_md5, file->get_md5sum());
+
+        std::string target = _root + "/" + name + ".downloaded";
+        download_response d_resp;
+        file->download(download_request{target, 0, -1},
+                       LPC_LOCAL_SERVICE_TEST,
+                       [&d_resp](const download_response &r) { d_resp = r; })
+            ->wait();
+        ASSERT_EQ(ERR_OK, d_resp.err);
+        ASSERT_EQ(_content.size(), d_resp.downloaded_size);
+        ASSERT_EQ(_md5, file->get_md5sum());
+
+        std::string md5;
+        ASSERT_EQ(ERR_OK, utils::filesystem::md5sum(target, md5));
+        ASSERT_EQ(_md5, md5);
+    }
+
+    error_code list_dir_in_pages(const std::string &dir_name,
+                                 uint32_t page_size,
+                                 size_t max_pages,
+                                 /*out*/ std::vector<std::vector<ls_entry>> &pages)
+    {
+        ls_response resp;
+        _service
+            .list_dir_in_pages(ls_request{dir_name, page_size},
+                               [&pages, max_pages](const std::vector<ls_entry> &page) {
+                                   pages.push_back(page);
+                                   return pages.size() < max_pages;
+                               },
+                               LPC_LOCAL_SERVICE_TEST,
+                               [&resp](const ls_response &r) { resp = r; })
+            ->wait();
+        EXPECT_TRUE(resp.entries->empty());
+        return resp.err;
+    }
+
+    local_service _service;
+    std::string _root;
+    std::string _src_file;
+    std::string _content;
+    std::string _md5;
+};
+
+TEST_F(local_service_test, upload_and_download)
+{
+    test_upload_and_download("file");
+
+    // fall back to buffered i/o if the file system doesn't support O_DIRECT
+    FLAGS_local_service_direct_io = true;
+    test_upload_and_download("direct_file");
+
+    // an empty file
+    _content.clear();
+    std::ofstream(_src_file, std::ios::binary | std::ios::trunc).close();
+    ASSERT_EQ(ERR_OK, utils::filesystem::md5sum(_src_file, _md5));
+    test_upload_and_download("empty_file");
+}
+
+TEST_F(local_service_test, upload_not_exist_file)
+{
+    block_file_ptr file = create_file("file");
+    upload_response resp;
+    file->upload(upload_request{_src_file + ".not_exist"},
+                 LPC_LOCAL_SERVICE_TEST,
+                 [&resp](const upload_response &r) { resp = r; })
+        ->wait();
+    ASSERT_NE(ERR_OK, resp.err);
+}
+
+TEST_F(local_service_test, read_and_write)
+{
+    block_file_ptr file = create_file("file");
+    write_response w_resp;
+    file->write(write_request{blob::create_from_bytes(std::string(_content))},
+                LPC_LOCAL_SERVICE_TEST,
+                [&w_resp](const write_response &r) { w_resp = r; })
+        ->wait();
+    ASSERT_EQ(ERR_OK, w_resp.err);
+    ASSERT_EQ(_content.size(), w_resp.written_size);
+    ASSERT_EQ(_md5, file->get_md5sum());
+
+    read_response r_resp;
+    file->read(read_request{100, 5000},
+               LPC_LOCAL_SERVICE_TEST,
+               [&r_resp](const read_response &r) { r_resp = r; })
+        ->wait();
+    ASSERT_EQ(ERR_OK, r_resp.err);
+    ASSERT_EQ(_content.substr(100, 5000), r_resp.buffer.to_string());
+
+    // read to the end of the file
+    file->read(read_request{4096, -1},
+               LPC_LOCAL_SERVICE_TEST,
+               [&r_resp](const read_response &r) { r_resp = r; })
+        ->wait();
+    ASSERT_EQ(ERR_OK, r_resp.err);
+    ASSERT_EQ(_content.substr(4096), r_resp.buffer.to_string());
+}
+
+TEST_F(local_service_test, list_dir_in_pages)
+{
+    std::string dir = _root + "/list_dir";
+    ASSERT_TRUE(utils::filesystem::create_directory(dir + "/sub"));
+    std::set<std::string> expected = {"sub"};
+    for (int i = 0; i < 5; ++i) {
+        std::string name = "file" + std::to_string(i);
+        std::ofstream(dir + "/" + name).close();
+        std::ofstream(dir + "/." + name + ".meta").close();
+        expected.insert(name);
+    }
+    // the file without metafile is not listed
+    std::ofstream(dir + "/no_meta").close();
+
+    std::vector<std::vector<ls_entry>> pages;
+    ASSERT_EQ(ERR_OK, list_dir_in_pages("list_dir", 2, 100, pages));
+    ASSERT_EQ(3, pages.size());
+    std::set<std::string> listed;
+    for (const auto &page : pages) {
+        ASSERT_EQ(2, page.size());
+        for (const ls_entry &entry : page) {
+            ASSERT_EQ(entry.entry_name == "sub", entry.is_directory);
+            listed.insert(entry.entry_name);
+        }
+    }
+    ASSERT_EQ(expected, listed);
+
+    // stopped by the handler
+    pages.clear();
+    ASSERT_EQ(ERR_OK, list_dir_in_pages("list_dir", 4, 1, pages));
+    ASSERT_EQ(1, pages.size());
+    ASSERT_EQ(4, pages[0].size());
+
+    // list_dir gets all the entries at once
+    ls_response resp;
+    _service
+        .list_dir(ls_request{"list_dir"},
+                  LPC_LOCAL_SERVICE_TEST,
+                  [&resp](const ls_response &r) { resp = r; })
+        ->wait();
+    ASSERT_EQ(ERR_OK, resp.err);
+    ASSERT_EQ(expected.size(), resp.entries->size());
+
+    pages.clear();
+    ASSERT_EQ(ERR_OBJECT_NOT_FOUND, list_dir_in_pages("not_exist", 2, 100, pages));
+    ASSERT_EQ(ERR_INVALID_PARAMETERS, list_dir_in_pages("list_dir/file0", 2, 100, pages));
+    ASSERT_TRUE(pages.empty());
+}
+
+} // namespace block_service
+} // namespace dist
+} // namespace dsn
@@ -24,15 +24,50 @@
  * THE SOFTWARE.
  */
 
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+
 #include <dsn/tool-api/zlocks.h>
 #include <dsn/tool-api/group_address.h>
+#include <dsn/utility/flags.h>
 #include <dsn/dist/replication/partition_resolver.h>
+#include <dsn/dist/replication/replication.codes.h>
+#include <dsn/dist/replication/client_batch.h>
 #include "partition_resolver_simple.h"
 #include "partition_resolver_manager.h"
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                client_hedged_read_enabled,
+                false,
+                "whether a follower read is also sent to another replica if the chosen one doesn't "
+                "reply within its p95 latency, the first successful reply is taken");
+DSN_DEFINE_uint32("replication",
+                  client_hedged_read_min_delay_ms,
+                  2,
+                  "min delay of the hedged read after the first attempt");
+DSN_DEFINE_bool("replication",
+                client_adaptive_read_timeout_enabled,
+                false,
+                "whether a follower read times out by the latency of the chosen replica rather "
+                "than the timeout of the request, then it's retried on the primary");
+DSN_DEFINE_uint32("replication",
+                  client_adaptive_read_timeout_min_ms,
+                  50,
+                  "min timeout of a follower read if client_adaptive_read_timeout_enabled");
+DSN_DEFINE_bool("replication",
+                client_batch_enabled,
+                false,
+                "whether the requests of partition_resolver::call_tasks() to the same replica "
+                "server are sent in one rpc, enable only after all the replica servers support "
+                "RPC_CLIENT_BATCH");
+
+// the latencies are trusted after so many samples
+static const uint32_t MIN_LATENCY_SAMPLES = 8;
+
 /*static*/
 partition_resolver_ptr partition_resolver::get_resolver(const char *cluster_name,
                                                         const std::vector<rpc_address> &meta_list,
@@ -42,7 +77,8 @@ partition_resolver_ptr partition_resolver::get_resolver(const char *cluster_name
 }
 
 DEFINE_TASK_CODE(LPC_RPC_DELAY_CALL, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
-void partition_resolver::call_task(const rpc_response_task_ptr &t)
+DEFINE_TASK_CODE(LPC_RPC_HEDGED_CALL, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+void partition_resolver::add_retry_handler(const rpc_response_task_ptr &t)
 {
     auto &hdr = *(t->get_request()->header);
     uint64_t deadline_ms = dsn_now_ms() + hdr.client.timeout_ms;
@@ -55,6 +91,13 @@ void partition_resolver::call_task(const rpc_response_task_ptr &t)
         if (req->header->gpid.value() != 0 && err != ERR_OK && err != ERR_HANDLER_NOT_FOUND &&
             err != ERR_APP_NOT_EXIST && err != ERR_OPERATION_DISABLED) {
             on_access_failure(req->header->gpid.get_partition_index(), err);
+            if (err == ERR_INVALID_STATE && resp != nullptr && resp->body_size() > 0) {
+                partition_configuration hint;
+                ::dsn::unmarshall(resp, hint);
+                if (hint.pid == req->header->gpid) {
+                    on_config_hint(hint);
+                }
+            }
             // still got time, retry
             uint64_t nms = dsn_now_ms();
             uint64_t gap = 8 << req->send_retry_count;
@@ -63,6 +106,8 @@ void partition_resolver::call_task(const rpc_response_task_ptr &t)
             if (nms + gap < deadline_ms) {
                 req->send_retry_count++;
                 req->header->client.timeout_ms = static_cast<int>(deadline_ms - nms - gap);
+                // the secondary may be too stale to serve, retry on the primary
+                req->header->context.u.is_follower_read = false;
 
                 rpc_response_task_ptr ctask =
                     dynamic_cast<rpc_response_task *>(task::get_current_task());
@@ -95,27 +140,291 @@ void partition_resolver::call_task(const rpc_response_task_ptr &t)
     };
     t->replace_callback(std::move(new_callback));
 
+bool partition_resolver::on_resolved(const rpc_response_task_ptr &t, const resolve_result &result)
+{
+    if (result.err != ERR_OK) {
+        t->enqueue(result.err, nullptr);
+        return false;
+    }
+
+    // update gpid when necessary
+    auto &hdr = *(t->get_request()->header);
+    if (hdr.gpid.value() != result.pid.value()) {
+        dassert(hdr.gpid.value() == 0, "inconsistent gpid");
+        hdr.gpid = result.pid;
+
+        // update thread hash if not assigned by applications
+        if (hdr.client.thread_hash == 0) {
+            hdr.client.thread_hash = result.pid.thread_hash();
+        }
+    }
+    return true;
+}
+
+void partition_resolver::send_task(const rpc_response_task_ptr &t, rpc_address addr)
+{
+    auto &hdr = *(t->get_request()->header);
+    bool hedged = FLAGS_client_hedged_read_enabled || FLAGS_client_adaptive_read_timeout_enabled;
+    if (hdr.context.u.is_follower_read && hedged) {
+        call_hedged(t, addr);
+    } else {
+        dsn_rpc_call(addr, t.get());
+    }
+}
+
+void partition_resolver::call_task(const rpc_response_task_ptr &t)
+{
+    add_retry_handler(t);
+
+    auto &hdr = *(t->get_request()->header);
     resolve(hdr.client.partition_hash,
-            [t](resolve_result &&result) mutable {
-                if (result.err != ERR_OK) {
-                    t->enqueue(result.err, nullptr);
-                    return;
+            [ this, t ](resolve_result && result) mutable {
+                if (on_resolved(t, result)) {
+                    send_task(t, result.address);
+                }
+            },
+            hdr.client.timeout_ms,
+            hdr.context.u.is_follower_read);
+}
+
+// the tasks of call_tasks() in resolving, which are grouped by the replica servers resolved and
+// sent when all of them are resolved.
+struct partition_resolver::batch_call : public ref_counter
+{
+    zlock lock;
+    int left{0};
+    std::map<rpc_address, std::vector<rpc_response_task_ptr>> groups;
+};
+
+void partition_resolver::call_tasks(const std::vector<rpc_response_task_ptr> &tasks)
+{
+    if (!FLAGS_client_batch_enabled || tasks.size() < 2) {
+        for (const rpc_response_task_ptr &t : tasks) {
+            call_task(t);
+        }
+        return;
+    }
+
+    ref_ptr<batch_call> bc(new batch_call());
+    bc->left = static_cast<int>(tasks.size());
+    for (const rpc_response_task_ptr &t : tasks) {
+        // the requests failed in a batch are retried alone by call_task()
+        add_retry_handler(t);
+
+        auto &hdr = *(t->get_request()->header);
+        resolve(hdr.client.partition_hash,
+                [ this, bc, t ](resolve_result && result) mutable {
+                    rpc_address addr;
+                    if (on_resolved(t, result)) {
+                        if (t->get_request()->header->context.u.is_follower_read) {
+                            // the follower reads may be hedged, which are sent alone
+                            send_task(t, result.address);
+                        } else {
+                            addr = result.address;
+                        }
+                    }
+                    on_batch_resolved(bc, t, addr);
+                },
+                hdr.client.timeout_ms,
+                hdr.context.u.is_follower_read);
+    }
+}
+
+void partition_resolver::on_batch_resolved(const ref_ptr<batch_call> &bc,
+                                           const rpc_response_task_ptr &t,
+                                           rpc_address addr)
+{
+    std::map<rpc_address, std::vector<rpc_response_task_ptr>> groups;
+    {
+        zauto_lock l(bc->lock);
+        if (!addr.is_invalid()) {
+            bc->groups[addr].push_back(t);
+        }
+        if (--bc->left > 0) {
+            return;
+        }
+        groups.swap(bc->groups);
+    }
+
+    for (auto &kv : groups) {
+        if (kv.second.size() == 1) {
+            dsn_rpc_call(kv.first, kv.second.front().get());
+        } else {
+            send_batch(kv.first, std::move(kv.second));
+        }
+    }
+}
+
+void partition_resolver::send_batch(rpc_address addr, std::vector<rpc_response_task_ptr> &&tasks)
+{
+    std::vector<message_ex *> requests;
+    requests.reserve(tasks.size());
+    int timeout_ms = 0;
+    for (const rpc_response_task_ptr &t : tasks) {
+        requests.push_back(t->get_request());
+        timeout_ms = std::max(timeout_ms, t->get_request()->header->client.timeout_ms);
+    }
+
+    message_ex *batch = message_ex::create_request(RPC_CLIENT_BATCH, timeout_ms);
+    write_client_batch(batch, requests);
+    rpc_response_task_ptr batch_task = rpc::create_rpc_response_task(
+        batch,
+        nullptr,
+        rpc_response_handler([addr, tasks = std::move(tasks)](
+            error_code err, message_ex *req, message_ex *resp) {
+            std::vector<client_batch_result> results;
+            if (err == ERR_OK) {
+                read_client_batch(resp, results);
+                if (results.size() != tasks.size()) {
+                    derror("the client batch to %s got %d results of %d requests",
+                           addr.to_string(),
+                           static_cast<int>(results.size()),
+                           static_cast<int>(tasks.size()));
+                    err = ERR_INVALID_DATA;
                 }
+            }
+            for (size_t i = 0; i < tasks.size(); ++i) {
+                if (err == ERR_OK) {
+                    tasks[i]->enqueue(results[i].err, results[i].reply.get());
+                } else {
+                    tasks[i]->enqueue(err, nullptr);
+                }
+            }
+        }));
+    dsn_rpc_call(addr, batch_task.get());
+}
+
+// the attempts of a follower read, i.e. the first one and the hedged one. the task of the caller
+// isn't sent itself, but completed by the first successful attempt, or the last failed one.
+struct partition_resolver::hedged_call : public ref_counter
+{
+    rpc_response_task_ptr task;
+    uint64_t deadline_ms;
+    rpc_address first_addr;
 
-                // update gpid when necessary
-                auto &hdr = *(t->get_request()->header);
-                if (hdr.gpid.value() != result.pid.value()) {
-                    dassert(hdr.gpid.value() == 0, "inconsistent gpid");
-                    hdr.gpid = result.pid;
+    zlock lock;
+    int outstanding{0};
+    bool completed{false};
+};
+
+void partition_resolver::call_hedged(const rpc_response_task_ptr &t, rpc_address addr)
+{
+    message_ex *request = t->get_request();
+    auto &hdr = *request->header;
 
-                    // update thread hash if not assigned by applications
-                    if (hdr.client.thread_hash == 0) {
-                        hdr.client.thread_hash = result.pid.thread_hash();
+    ref_ptr<hedged_call> hc(new hedged_call());
+    hc->task = t;
+    hc->deadline_ms = dsn_now_ms() + hdr.client.timeout_ms;
+    hc->first_addr = addr;
+
+    replica_latency latency;
+    bool known = get_latency(addr, latency);
+    if (known && FLAGS_client_adaptive_read_timeout_enabled) {
+        // the retransmission timeout of TCP
+        int64_t timeout_ms = (latency.srtt_us + 4 * latency.rttvar_us) / 1000;
+        timeout_ms = std::max<int64_t>(timeout_ms, FLAGS_client_adaptive_read_timeout_min_ms);
+        timeout_ms = std::min<int64_t>(timeout_ms, hdr.client.timeout_ms);
+        hdr.client.timeout_ms = static_cast<int>(timeout_ms);
+    }
+
+    // the caller task holds the request, and the retry reuses it
+    hc->outstanding = 1;
+    send_attempt(hc, request, addr);
+
+    if (known && FLAGS_client_hedged_read_enabled) {
+        // about p95 if the latencies are normally distributed
+        int64_t delay_ms = (latency.srtt_us + 2 * latency.rttvar_us) / 1000;
+        delay_ms = std::max<int64_t>(delay_ms, FLAGS_client_hedged_read_min_delay_ms);
+        if (dsn_now_ms() + delay_ms < hc->deadline_ms) {
+            partition_resolver_ptr r(this);
+            tasking::enqueue(LPC_RPC_HEDGED_CALL,
+                             nullptr,
+                             [r, hc]() { r->send_hedge(hc); },
+                             0,
+                             std::chrono::milliseconds(delay_ms));
+        }
+    }
+}
+
+void partition_resolver::send_attempt(const ref_ptr<hedged_call> &hc,
+                                      message_ex *request,
+                                      rpc_address addr)
+{
+    partition_resolver_ptr r(this);
+    uint64_t start_us = dsn_now_us();
+    rpc_response_task_ptr attempt = rpc::create_rpc_response_task(
+        request,
+        nullptr,
+        rpc_response_handler(
+            [r, hc, addr, start_us](error_code err, message_ex *req, message_ex *resp) {
+                // a timeout is a sample as well, so a stalled replica is soon avoided
+                if (err == ERR_OK || err == ERR_TIMEOUT) {
+                    r->record_latency(addr, dsn_now_us() - start_us);
+                }
+                {
+                    zauto_lock l(hc->lock);
+                    hc->outstanding--;
+                    if (hc->completed || (err != ERR_OK && hc->outstanding > 0)) {
+                        return;
                     }
+                    hc->completed = true;
                 }
-                dsn_rpc_call(result.address, t.get());
-            },
-            hdr.client.timeout_ms);
+                hc->task->enqueue(err, resp);
+            }));
+    dsn_rpc_call(addr, attempt.get());
+}
+
+void partition_resolver::send_hedge(const ref_ptr<hedged_call> &hc)
+{
+    message_ex *request = hc->task->get_request();
+    rpc_address addr =
+        resolve_hedge(request->header->gpid.get_partition_index(), hc->first_addr);
+    uint64_t now_ms = dsn_now_ms();
+    if (addr.is_invalid() || now_ms >= hc->deadline_ms) {
+        return;
+    }
+    {
+        // the caller task isn't completed nor retried until the hedge replies
+        zauto_lock l(hc->lock);
+        if (hc->completed) {
+            return;
+        }
+        hc->outstanding++;
+    }
+
+    // the request may be in sending, only its content is copied and it's sent as a new one
+    message_ex *hedge = request->copy(true, false);
+    hedge->header->id = message_ex::new_id();
+    hedge->header->client.timeout_ms = static_cast<int>(hc->deadline_ms - now_ms);
+    send_attempt(hc, hedge, addr);
+}
+
+void partition_resolver::record_latency(rpc_address addr, uint64_t latency_us)
+{
+    int64_t sample = static_cast<int64_t>(latency_us);
+    zauto_lock l(_latencies_lock);
+    auto it = _latencies.find(addr);
+    if (it == _latencies.end()) {
+        _latencies.emplace(addr, replica_latency{sample, sample / 2, 1});
+        return;
+    }
+
+    replica_latency &latency = it->second;
+    int64_t delta = sample - latency.srtt_us;
+    latency.srtt_us += delta / 8;
+    latency.rttvar_us += (std::abs(delta) - latency.rttvar_us) / 4;
+    latency.samples++;
+}
+
+bool partition_resolver::get_latency(rpc_address addr, /*out*/ replica_latency &latency) const
+{
+    zauto_lock l(_latencies_lock);
+    auto it = _latencies.find(addr);
+    if (it == _latencies.end() || it->second.samples < MIN_LATENCY_SAMPLES) {
+        return false;
+    }
+    latency = it->second;
+    return true;
 }
 } // namespace replication
 } // namespace dsn
@@ -25,6 +25,7 @@
  */
 
 #include <dsn/utility/utils.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/rand.h>
 #include <dsn/tool-api/async_calls.h>
 #include "partition_resolver_simple.h"
@@ -32,23 +33,32 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  client_route_subscription_wait_ms,
+                  0,
+                  "if not 0, the clients subscribe the changes of the routes from meta server, "
+                  "which holds each subscription for this time at most");
+
 partition_resolver_simple::partition_resolver_simple(rpc_address meta_server, const char *app_name)
     : partition_resolver(meta_server, app_name),
       _app_id(-1),
       _app_partition_count(-1),
-      _app_is_stateful(true)
+      _app_is_stateful(true),
+      _app_version(-1),
+      _subscribing(false)
 {
 }
 
 void partition_resolver_simple::resolve(uint64_t partition_hash,
                                         std::function<void(resolve_result &&)> &&callback,
-                                        int timeout_ms)
+                                        int timeout_ms,
+                                        bool follower_read)
 {
     int idx = -1;
     if (_app_partition_count != -1) {
         idx = get_partition_index(_app_partition_count, partition_hash);
         rpc_address target;
-        if (ERR_OK == get_address(idx, target)) {
+        if (ERR_OK == get_address(idx, follower_read, target)) {
             callback(resolve_result{ERR_OK, target, {_app_id, idx}});
             return;
         }
@@ -61,6 +71,7 @@ void partition_resolver_simple::resolve(uint64_t partition_hash,
     rc->timeout_timer = nullptr;
     rc->timeout_ms = timeout_ms;
     rc->timeout_ts_us = dsn_now_us() + timeout_ms * 1000;
+    rc->follower_read = follower_read;
     rc->completed = false;
 
     call(std::move(rc), false);
@@ -147,7 +158,7 @@ void partition_resolver_simple::call(request_context_ptr &&request, bool from_me
     if (-1 != pindex) {
         // fill target address if possible
         rpc_address addr;
-        auto err = get_address(pindex, addr);
+        auto err = get_address(pindex, request->follower_read, addr);
 
         // target address known
         if (err == ERR_OK) {
@@ -241,6 +252,14 @@ task_ptr partition_resolver_simple::query_config(int partition_index, int timeou
     if (partition_index != -1) {
         req.partition_indices.push_back(partition_index);
     }
+    {
+        // only the partitions changed since then are responded if the version is still known by
+        // the meta server
+        zauto_read_lock l(_config_lock);
+        if (_app_version != -1) {
+            req.__set_known_version(_app_version);
+        }
+    }
     marshall(msg, req);
 
     return rpc::call(
@@ -265,51 +284,7 @@ void partition_resolver_simple::query_config_reply(error_code err,
         if (resp.err == ERR_OK) {
             zauto_write_lock l(_config_lock);
 
-            if (_app_id != -1 && _app_id != resp.app_id) {
-                dassert(false,
-                        "app id is changed (mostly the app was removed and created with the same "
-                        "name), local Vs remote: %u vs %u ",
-                        _app_id,
-                        resp.app_id);
-            }
-            if (_app_partition_count != -1 && _app_partition_count != resp.partition_count) {
-                dassert(false,
-                        "partition count is changed (mostly the app was removed and created with "
-                        "the same name), local Vs remote: %u vs %u ",
-                        _app_partition_count,
-                        resp.partition_count);
-            }
-            _app_id = resp.app_id;
-            _app_partition_count = resp.partition_count;
-            _app_is_stateful = resp.is_stateful;
-
-            for (auto it = resp.partitions.begin(); it != resp.partitions.end(); ++it) {
-                auto &new_config = *it;
-
-                dinfo("%s.client: query config reply, gpid = %d.%d, ballot = %" PRId64
-                      ", primary = %s",
-                      _app_name.c_str(),
-                      new_config.pid.get_app_id(),
-                      new_config.pid.get_partition_index(),
-                      new_config.ballot,
-                      new_config.primary.to_string());
-
-                auto it2 = _config_cache.find(new_config.pid.get_partition_index());
-                if (it2 == _config_cache.end()) {
-                    std::unique_ptr<partition_info> pi(new partition_info);
-                    pi->timeout_count = 0;
-                    pi->config = new_config;
-                    _config_cache.emplace(new_config.pid.get_partition_index(), std::move(pi));
-                } else if (_app_is_stateful && it2->second->config.ballot < new_config.ballot) {
-                    it2->second->timeout_count = 0;
-                    it2->second->config = new_config;
-                } else if (!_app_is_stateful) {
-                    it2->second->timeout_count = 0;
-                    it2->second->config = new_config;
-                } else {
-                    // nothing to do
-                }
-            }
+            apply_query_response(resp);
         } else if (resp.err == ERR_OBJECT_NOT_FOUND) {
             derror("%s.client: query config reply, gpid = %d.%d, err = %s",
                    _app_name.c_str(),
@@ -385,13 +360,136 @@ void partition_resolver_simple::query_config_reply(error_code err,
     }
 }
 
+void partition_resolver_simple::apply_query_response(
+    const configuration_query_by_index_response &resp)
+{
+    if (_app_id != -1 && _app_id != resp.app_id) {
+        dassert(false,
+                "app id is changed (mostly the app was removed and created with the same "
+                "name), local Vs remote: %u vs %u ",
+                _app_id,
+                resp.app_id);
+    }
+    if (_app_partition_count != -1 && _app_partition_count != resp.partition_count) {
+        dassert(false,
+                "partition count is changed (mostly the app was removed and created with "
+                "the same name), local Vs remote: %u vs %u ",
+                _app_partition_count,
+                resp.partition_count);
+    }
+    _app_id = resp.app_id;
+    _app_partition_count = resp.partition_count;
+    _app_is_stateful = resp.is_stateful;
+    // the responses may arrive out of order
+    if (resp.__isset.version && resp.version > _app_version) {
+        _app_version = resp.version;
+    }
+
+    for (const partition_configuration &new_config : resp.partitions) {
+        dinfo("%s.client: query config reply, gpid = %d.%d, ballot = %" PRId64 ", primary = %s",
+              _app_name.c_str(),
+              new_config.pid.get_app_id(),
+              new_config.pid.get_partition_index(),
+              new_config.ballot,
+              new_config.primary.to_string());
+        update_config(new_config);
+    }
+
+    if (FLAGS_client_route_subscription_wait_ms > 0 && _app_version != -1 && !_subscribing) {
+        _subscribing = true;
+        tasking::enqueue(
+            LPC_REPLICATION_DELAY_QUERY_CONFIG, &_tracker, [this]() { subscribe_routes(); });
+    }
+}
+
+void partition_resolver_simple::update_config(const partition_configuration &new_config)
+{
+    auto it = _config_cache.find(new_config.pid.get_partition_index());
+    if (it == _config_cache.end()) {
+        std::unique_ptr<partition_info> pi(new partition_info);
+        pi->timeout_count = 0;
+        pi->config = new_config;
+        _config_cache.emplace(new_config.pid.get_partition_index(), std::move(pi));
+    } else if (_app_is_stateful && it->second->config.ballot < new_config.ballot) {
+        it->second->timeout_count = 0;
+        it->second->config = new_config;
+    } else if (!_app_is_stateful) {
+        it->second->timeout_count = 0;
+        it->second->config = new_config;
+    } else {
+        // nothing to do
+    }
+}
+
+void partition_resolver_simple::on_config_hint(const partition_configuration &config)
+{
+    zauto_write_lock l(_config_lock);
+    if (!_app_is_stateful || config.pid.get_app_id() != _app_id) {
+        return;
+    }
+
+    ddebug("%s.client: primary of partition %d.%d is %s told by replica, ballot = %" PRId64,
+           _app_name.c_str(),
+           config.pid.get_app_id(),
+           config.pid.get_partition_index(),
+           config.primary.to_string(),
+           config.ballot);
+    update_config(config);
+}
+
+void partition_resolver_simple::subscribe_routes()
+{
+    configuration_query_by_index_request req;
+    req.app_name = _app_name;
+    {
+        zauto_read_lock l(_config_lock);
+        req.__set_known_version(_app_version);
+    }
+    req.__set_wait_ms(FLAGS_client_route_subscription_wait_ms);
+
+    // the meta server replies in wait_ms, so the timeout is a little longer
+    auto msg = dsn::message_ex::create_request(RPC_CM_QUERY_PARTITION_CONFIG_BY_INDEX,
+                                               req.wait_ms + 10000);
+    marshall(msg, req);
+    rpc::call(
+        _meta_server,
+        msg,
+        &_tracker,
+        [this](error_code err, dsn::message_ex *request, dsn::message_ex *response) {
+            configuration_query_by_index_response resp;
+            if (err == ERR_OK) {
+                unmarshall(response, resp);
+                err = resp.err;
+            }
+
+            zauto_write_lock l(_config_lock);
+            if (err == ERR_OK) {
+                apply_query_response(resp);
+            }
+            // stop if the app is dropped, or the meta server doesn't support subscriptions and
+            // replies at once
+            if (err == ERR_OBJECT_NOT_FOUND || (err == ERR_OK && !resp.__isset.version)) {
+                dwarn("%s.client: stop subscribing the routes, err = %s",
+                      _app_name.c_str(),
+                      err.to_string());
+                _subscribing = false;
+                return;
+            }
+            tasking::enqueue(LPC_REPLICATION_DELAY_QUERY_CONFIG,
+                             &_tracker,
+                             [this]() { subscribe_routes(); },
+                             0,
+                             err == ERR_OK ? std::chrono::seconds(0) : std::chrono::seconds(1));
+        });
+}
+
 void partition_resolver_simple::handle_pending_requests(std::deque<request_context_ptr> &reqs,
                                                         error_code err)
 {
     for (auto &req : reqs) {
         if (err == ERR_OK) {
             rpc_address addr;
-            err = get_address(req->partition_index, addr);
+            err = get_address(req->partition_index, req->follower_read, addr);
             if (err == ERR_OK) {
                 end_request(std::move(req), err, addr);
             } else {
@@ -408,10 +506,16 @@ void partition_resolver_simple::handle_pending_requests(std::deque<request_conte
 }
 
 /*search in cache*/
-rpc_address partition_resolver_simple::get_address(const partition_configuration &config) const
+rpc_address partition_resolver_simple::get_address(const partition_configuration &config,
+                                                   bool follower_read) const
 {
     if (_app_is_stateful) {
-        return config.primary;
+        if (!follower_read || config.primary.is_invalid() || config.secondaries.empty()) {
+            return config.primary;
+        }
+        // spread the reads over all the replicas, including the primary
+        uint32_t index = rand::next_u32(0, config.secondaries.size());
+        return index == config.secondaries.size() ? config.primary : config.secondaries[index];
     } else {
         if (config.last_drops.size() == 0) {
             return rpc_address();
@@ -421,7 +525,9 @@ rpc_address partition_resolver_simple::get_address(const partition_configuration
     }
 }
 
-error_code partition_resolver_simple::get_address(int partition_index, /*out*/ rpc_address &addr)
+error_code partition_resolver_simple::get_address(int partition_index,
+                                                  bool follower_read,
+                                                  /*out*/ rpc_address &addr)
 {
     // partition_configuration config;
     {
@@ -429,7 +535,7 @@ error_code partition_resolver_simple::get_address(int partition_index, /*out*/ r
         auto it = _config_cache.find(partition_index);
         if (it != _config_cache.end()) {
             // config = it->second->config;
-            addr = get_address(it->second->config);
+            addr = get_address(it->second->config, follower_read);
             if (addr.is_invalid()) {
                 return ERR_IO_PENDING;
             } else {
@@ -441,6 +547,30 @@ error_code partition_resolver_simple::get_address(int partition_index, /*out*/ r
     }
 }
 
+rpc_address partition_resolver_simple::resolve_hedge(int partition_index, rpc_address excluded)
+{
+    zauto_read_lock l(_config_lock);
+    auto it = _config_cache.find(partition_index);
+    if (!_app_is_stateful || it == _config_cache.end()) {
+        return rpc_address();
+    }
+
+    const partition_configuration &config = it->second->config;
+    std::vector<rpc_address> candidates;
+    if (!config.primary.is_invalid() && config.primary != excluded) {
+        candidates.push_back(config.primary);
+    }
+    for (const rpc_address &addr : config.secondaries) {
+        if (addr != excluded) {
+            candidates.push_back(addr);
+        }
+    }
+    if (candidates.empty()) {
+        return rpc_address();
+    }
+    return candidates[rand::next_u32(0, candidates.size() - 1)];
+}
+
 int partition_resolver_simple::get_partition_index(int partition_count, uint64_t partition_hash)
 {
     return partition_hash % static_cast<uint64_t>(partition_count);
@@ -44,10 +44,15 @@ public:
 
     virtual void resolve(uint64_t partition_hash,
                          std::function<void(resolve_result &&)> &&callback,
-                         int timeout_ms) override;
+                         int timeout_ms,
+                         bool follower_read) override;
 
     virtual void on_access_failure(int partition_index, error_code err) override;
 
+    virtual void on_config_hint(const partition_configuration &config) override;
+
+    virtual rpc_address resolve_hedge(int partition_index, rpc_address excluded) override;
+
     virtual int get_partition_index(int partition_count, uint64_t partition_hash) override;
 
     int get_partition_count() const { return _app_partition_count; }
@@ -64,6 +69,11 @@ private:
     int _app_id;
     int _app_partition_count;
     bool _app_is_stateful;
+    // the version of the routes in _config_cache, -1 if unknown
+    int64_t _app_version;
+    // whether the changes of the routes are subscribed from meta server, see
+    // [replication] client_route_subscription_wait_ms
+    bool _subscribing;
 
     typedef std::function<void(resolve_result &&)> callback_t;
     struct request_context : ref_counter, transient_object
@@ -73,6 +83,7 @@ private:
         callback_t callback;
         int timeout_ms;         // init timeout
         uint64_t timeout_ts_us; // timeout at this timing point
+        bool follower_read;
 
         zlock lock;             // [
         task_ptr timeout_timer; // when partition config is unknown at the first place
@@ -98,8 +109,8 @@ private:
 
 private:
     // local routines
-    rpc_address get_address(const partition_configuration &config) const;
-    error_code get_address(int partition_index, /*out*/ rpc_address &addr);
+    rpc_address get_address(const partition_configuration &config, bool follower_read) const;
+    error_code get_address(int partition_index, bool follower_read, /*out*/ rpc_address &addr);
     void handle_pending_requests(std::deque<request_context_ptr> &reqs, error_code err);
     void clear_all_pending_requests();
 
@@ -119,6 +130,12 @@ private:
                             dsn::message_ex *request,
                             dsn::message_ex *response,
                             int partition_index);
+    // called with the write lock of _config_lock held
+    void apply_query_response(const configuration_query_by_index_response &resp);
+    void update_config(const partition_configuration &new_config);
+    // query the changes of the routes since _app_version, which is held by meta server until
+    // there are any, and subscribe again on reply
+    void subscribe_routes();
 };
 } // namespace replication
 } // namespace dsn
@@ -62,19 +62,26 @@ dsn::error_code replication_ddl_client::wait_app_ready(const std::string &app_na
                                                        int partition_count,
                                                        int max_replica_count)
 {
-    int sleep_sec = 2;
+    // the changes of the partitions are waited by the subscription of the routes, rather than
+    // polling all the partitions, if the meta server versions the routes
+    static const int WAIT_MS = 2000;
+    std::vector<partition_configuration> partitions(partition_count);
+    int64_t version = -1;
     while (true) {
-        std::this_thread::sleep_for(std::chrono::seconds(sleep_sec));
-
         std::shared_ptr<configuration_query_by_index_request> query_req(
             new configuration_query_by_index_request());
         query_req->app_name = app_name;
+        if (version != -1) {
+            query_req->__set_known_version(version);
+            query_req->__set_wait_ms(WAIT_MS);
+        }
 
         auto query_task = request_meta<configuration_query_by_index_request>(
-            RPC_CM_QUERY_PARTITION_CONFIG_BY_INDEX, query_req);
+            RPC_CM_QUERY_PARTITION_CONFIG_BY_INDEX, query_req, WAIT_MS * 3);
         query_task->wait();
         if (query_task->error() == ERR_INVALID_STATE) {
             std::cout << app_name << " not ready yet, still waiting..." << std::endl;
+            std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_MS));
             continue;
         }
 
@@ -94,9 +101,13 @@ dsn::error_code replication_ddl_client::wait_app_ready(const std::string &app_na
             return query_resp.err;
         }
         dassert(partition_count == query_resp.partition_count, "partition count not equal");
+        // the response contains only the changed partitions if known_version is still known
+        for (const partition_configuration &pc : query_resp.partitions) {
+            partitions[pc.pid.get_partition_index()] = pc;
+        }
         int ready_count = 0;
         for (int i = 0; i < partition_count; i++) {
-            const partition_configuration &pc = query_resp.partitions[i];
+            const partition_configuration &pc = partitions[i];
             if (!pc.primary.is_invalid() && (pc.secondaries.size() + 1 >= max_replica_count)) {
                 ready_count++;
             }
@@ -108,6 +119,13 @@ dsn::error_code replication_ddl_client::wait_app_ready(const std::string &app_na
         }
         std::cout << app_name << " not ready yet, still waiting... (" << ready_count << "/"
                   << partition_count << ")" << std::endl;
+
+        if (query_resp.__isset.version) {
+            version = query_resp.version;
+        } else {
+            // the meta server doesn't support the subscription
+            std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_MS));
+        }
     }
     return dsn::ERR_OK;
 }
@@ -366,18 +384,40 @@ dsn::error_code replication_ddl_client::list_apps(const dsn::app_status::type st
         tp_health.add_column("unhealthy");
         tp_health.add_column("write_unhealthy");
         tp_health.add_column("read_unhealthy");
+
+        std::vector<std::string> app_names;
+        for (const auto &info : apps) {
+            if (info.status == app_status::AS_AVAILABLE) {
+                app_names.push_back(info.app_name);
+            }
+        }
+        std::map<std::string, configuration_query_by_index_response> app_partitions;
+        r = dsn::ERR_OK;
+        list_apps_partitions(app_names,
+                             [&](const std::string &app_name,
+                                 error_code err,
+                                 const configuration_query_by_index_response &resp) {
+                                 if (err != dsn::ERR_OK) {
+                                     derror("list app(%s) failed, err = %s",
+                                            app_name.c_str(),
+                                            err.to_string());
+                                     r = err;
+                                 } else {
+                                     app_partitions.emplace(app_name, resp);
+                                 }
+                             });
+        if (r != dsn::ERR_OK) {
+            return r;
+        }
+
         for (auto &info : apps) {
             if (info.status != app_status::AS_AVAILABLE) {
                 continue;
             }
-            int32_t app_id;
-            int32_t partition_count;
-            std::vector<partition_configuration> partitions;
-            r = list_app(info.app_name, app_id, partition_count, partitions);
-            if (r != dsn::ERR_OK) {
-                derror("list app(%s) failed, err = %s", info.app_name.c_str(), r.to_string());
-                return r;
-            }
+            const configuration_query_by_index_response &resp = app_partitions[info.app_name];
+            int32_t app_id = resp.app_id;
+            int32_t partition_count = resp.partition_count;
+            const std::vector<partition_configuration> &partitions = resp.partitions;
             dassert(info.app_id == app_id, "invalid app_id, %d VS %d", info.app_id, app_id);
             dassert(info.partition_count == partition_count,
                     "invalid partition_count, %d VS %d",
@@ -516,15 +556,21 @@ dsn::error_code replication_ddl_client::list_nodes(const dsn::replication::node_
             return r;
         }
 
-        for (auto &app : apps) {
-            int32_t app_id;
-            int32_t partition_count;
-            std::vector<partition_configuration> partitions;
-            r = list_app(app.app_name, app_id, partition_count, partitions);
-            if (r != dsn::ERR_OK) {
-                return r;
+        std::vector<std::string> app_names;
+        for (const auto &app : apps) {
+            app_names.push_back(app.app_name);
+        }
+        // the replicas are counted as the responses arrive
+        r = dsn::ERR_OK;
+        list_apps_partitions(app_names,
+                             [&](const std::string &app_name,
+                                 error_code err,
+                                 const configuration_query_by_index_response &resp) {
+            if (err != dsn::ERR_OK) {
+                r = err;
+                return;
             }
-
+            const std::vector<partition_configuration> &partitions = resp.partitions;
             for (int i = 0; i < partitions.size(); i++) {
                 const dsn::partition_configuration &p = partitions[i];
                 if (!p.primary.is_invalid()) {
@@ -540,6 +586,9 @@ dsn::error_code replication_ddl_client::list_nodes(const dsn::replication::node_
                     }
                 }
             }
+        });
+        if (r != dsn::ERR_OK) {
+            return r;
         }
     }
 
@@ -835,6 +884,30 @@ dsn::error_code replication_ddl_client::list_app(const std::string &app_name,
     return dsn::ERR_OK;
 }
 
+void replication_ddl_client::list_apps_partitions(const std::vector<std::string> &app_names,
+                                                  const app_partitions_callback &callback,
+                                                  int max_concurrency)
+{
+    std::vector<std::pair<dsn::rpc_address, query_config_rpc>> rpcs;
+    for (const std::string &app_name : app_names) {
+        auto request = make_unique<configuration_query_by_index_request>();
+        request->app_name = app_name;
+        rpcs.emplace_back(_meta_server,
+                          query_config_rpc(std::move(request),
+                                           RPC_CM_QUERY_PARTITION_CONFIG_BY_INDEX));
+    }
+    call_rpcs_windowed(rpcs,
+                       [&rpcs, &callback](size_t i, error_code err) {
+                           const query_config_rpc &rpc = rpcs[i].second;
+                           if (err == ERR_OK) {
+                               err = rpc.response().err;
+                           }
+                           callback(rpc.request().app_name, err, rpc.response());
+                       },
+                       max_concurrency,
+                       2);
+}
+
 dsn::replication::configuration_meta_control_response
 replication_ddl_client::control_meta_function_level(meta_function_level::type level)
 {
@@ -1536,15 +1609,37 @@ void replication_ddl_client::query_disk_info(
     const std::string &app_name,
     /*out*/ std::map<dsn::rpc_address, error_with<query_disk_info_response>> &resps)
 {
-    std::map<dsn::rpc_address, query_disk_info_rpc> query_disk_info_rpcs;
+    query_disk_info(targets,
+                    app_name,
+                    [&resps](dsn::rpc_address target, error_with<query_disk_info_response> &&resp) {
+                        resps.emplace(target, std::move(resp));
+                    });
+}
+
+void replication_ddl_client::query_disk_info(
+    const std::vector<dsn::rpc_address> &targets,
+    const std::string &app_name,
+    const std::function<void(dsn::rpc_address, error_with<query_disk_info_response> &&)> &callback,
+    int max_concurrency)
+{
+    std::vector<std::pair<dsn::rpc_address, query_disk_info_rpc>> rpcs;
     for (const auto &target : targets) {
         auto request = make_unique<query_disk_info_request>();
         request->node = target;
         request->app_name = app_name;
-        query_disk_info_rpcs.emplace(target,
-                                     query_disk_info_rpc(std::move(request), RPC_QUERY_DISK_INFO));
-    }
-    call_rpcs_async(query_disk_info_rpcs, resps);
+        rpcs.emplace_back(target, query_disk_info_rpc(std::move(request), RPC_QUERY_DISK_INFO));
+    }
+    call_rpcs_windowed(rpcs,
+                       [&rpcs, &callback](size_t i, error_code err) {
+                           if (err == ERR_OK) {
+                               callback(rpcs[i].first, std::move(rpcs[i].second.response()));
+                           } else {
+                               callback(rpcs[i].first,
+                                        error_s::make(err, "unable to send rpc to server"));
+                           }
+                       },
+                       max_concurrency,
+                       1);
 }
 
 } // namespace replication
@@ -33,14 +33,71 @@
  */
 
 #include "fs_manager.h"
+#include <dsn/tool-api/file_io.h>
 #include <dsn/utility/utils.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/io_scheduler.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
 #include <thread>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <dsn/dist/fmt_logging.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_int32("replication",
+                 disk_io_util_high_ratio,
+                 90,
+                 "new replicas are not placed on the disks busier than this percent of the time, "
+                 "unless all the disks are");
+DSN_DEFINE_uint32("replication",
+                  disk_rebalance_load_gap_ratio,
+                  50,
+                  "a replica is moved between the disks if the write load of the heaviest disk "
+                  "exceeds the lightest one by this percent of the average");
+DSN_DEFINE_int64("replication",
+                 disk_rebalance_min_write_bytes_per_sec,
+                 4 * 1024 * 1024,
+                 "the disks are not rebalanced unless the heaviest one is written faster");
+DSN_DEFINE_int32("replication",
+                 disk_rebalance_min_available_ratio,
+                 20,
+                 "a replica is not moved to a disk with less available space than this percent");
+DSN_DEFINE_bool("replication",
+                disk_slow_detection_enabled,
+                false,
+                "whether to detect the fail-slow disks by the aio latency, which take no new "
+                "replicas and are reported to the meta server to move their replicas off");
+DSN_TAG_VARIABLE(disk_slow_detection_enabled, FT_MUTABLE);
+DSN_DEFINE_uint32("replication",
+                  disk_slow_aio_latency_ms,
+                  500,
+                  "a disk isn't considered slow unless the p99 latency of its aios exceeds this");
+DSN_DEFINE_uint32("replication",
+                  disk_slow_peer_latency_ratio,
+                  10,
+                  "a disk isn't considered slow unless the p99 latency of its aios exceeds this "
+                  "times the median of the other disks of the node");
+DSN_DEFINE_uint32("replication",
+                  disk_slow_min_aio_count,
+                  10,
+                  "a disk with fewer aios completed in an interval of the disk load update is not "
+                  "judged in the interval");
+DSN_DEFINE_uint32("replication",
+                  disk_slow_detect_rounds,
+                  3,
+                  "a disk is marked as fail-slow if it's considered slow in this count of the "
+                  "disk load updates in a row");
+DSN_DEFINE_uint32("replication",
+                  disk_slow_recover_rounds,
+                  30,
+                  "a fail-slow disk is recovered if it's considered normal in this count of the "
+                  "disk load updates in a row");
+
 unsigned dir_node::replicas_count() const
 {
     unsigned sum = 0;
@@ -93,6 +150,88 @@ void dir_node::update_disk_stat()
     }
 }
 
+void dir_node::update_io_stat(uint64_t now_ms)
+{
+    struct stat st;
+    if (::stat(full_dir.c_str(), &st) != 0) {
+        return;
+    }
+
+    std::ifstream diskstats("/proc/diskstats");
+    std::string line;
+    while (std::getline(diskstats, line)) {
+        // major minor name reads ... weighted_io_ms, see Documentation/iostats.txt of linux
+        std::istringstream in(line);
+        unsigned int dev_major = 0, dev_minor = 0;
+        std::string name;
+        uint64_t fields[11] = {0};
+        in >> dev_major >> dev_minor >> name;
+        for (int i = 0; i < 11 && (in >> fields[i]); i++) {
+        }
+        if (dev_major != major(st.st_dev) || dev_minor != minor(st.st_dev)) {
+            continue;
+        }
+
+        uint64_t io_ticks_ms = fields[9];
+        uint64_t weighted_io_ms = fields[10];
+        if (_last_io_stat_ms != 0 && now_ms > _last_io_stat_ms &&
+            io_ticks_ms >= _last_io_ticks_ms && weighted_io_ms >= _last_weighted_io_ms) {
+            uint64_t elapsed_ms = now_ms - _last_io_stat_ms;
+            io_util_ratio = static_cast<int>(
+                std::min<uint64_t>(100, (io_ticks_ms - _last_io_ticks_ms) * 100 / elapsed_ms));
+            io_queue_depth =
+                static_cast<double>(weighted_io_ms - _last_weighted_io_ms) / elapsed_ms;
+        }
+        _last_io_stat_ms = now_ms;
+        _last_io_ticks_ms = io_ticks_ms;
+        _last_weighted_io_ms = weighted_io_ms;
+        return;
+    }
+}
+
+void dir_node::update_aio_stat()
+{
+    std::vector<uint64_t> counts;
+    if (!file::get_disk_aio_latency_counts(tag, counts)) {
+        return;
+    }
+
+    std::vector<uint64_t> recent(counts.size(), 0);
+    aio_count = 0;
+    if (_last_aio_latency_counts.size() == counts.size()) {
+        for (size_t i = 0; i < counts.size(); ++i) {
+            recent[i] = counts[i] - _last_aio_latency_counts[i];
+            aio_count += recent[i];
+        }
+    }
+    aio_p99_latency_us = aio_latency_quantile(recent, 0.99);
+    _last_aio_latency_counts = std::move(counts);
+}
+
+/*static*/ uint64_t dir_node::aio_latency_quantile(const std::vector<uint64_t> &counts,
+                                                   double quantile)
+{
+    uint64_t total = 0;
+    for (uint64_t c : counts) {
+        total += c;
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    // the upper bound of the bucket where the quantile falls
+    uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(quantile * total)), 1);
+    uint64_t seen = 0;
+    size_t i = 0;
+    for (; i + 1 < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    return 2ULL << i;
+}
+
 fs_manager::fs_manager(bool for_test)
 {
     if (!for_test) {
@@ -116,6 +255,19 @@ fs_manager::fs_manager(bool for_test)
                                                       "disk.available.max.ratio",
                                                       COUNTER_TYPE_NUMBER,
                                                       "maximal disk available ratio in all disks");
+        _counter_max_io_util_ratio.init_app_counter("eon.replica_stub",
+                                                    "disk.io.util.max.ratio",
+                                                    COUNTER_TYPE_NUMBER,
+                                                    "maximal i/o utilization in all disks");
+        _counter_max_disk_write_bytes_per_sec.init_app_counter(
+            "eon.replica_stub",
+            "disk.write.bytes.max.rate",
+            COUNTER_TYPE_NUMBER,
+            "maximal bytes written by the replicas per second in all disks");
+        _counter_slow_disk_count.init_app_counter("eon.replica_stub",
+                                                  "disk.slow.count",
+                                                  COUNTER_TYPE_NUMBER,
+                                                  "count of the disks detected as fail-slow");
     }
 }
 
@@ -157,6 +309,9 @@ dsn::error_code fs_manager::initialize(const std::vector<std::string> &data_dirs
 
     if (!for_test) {
         update_disk_stat();
+        for (const auto &n : _dir_nodes) {
+            io_scheduler::instance().register_disk(n->tag, n->full_dir);
+        }
     }
     return dsn::ERR_OK;
 }
@@ -213,21 +368,34 @@ void fs_manager::allocate_dir(const gpid &pid, const std::string &type, /*out*/
     unsigned least_app_replicas_count = 0;
     unsigned least_total_replicas_count = 0;
 
+    // the busy or fail-slow disks are avoided unless all of them are
+    bool all_overloaded = std::all_of(_dir_nodes.begin(),
+                                      _dir_nodes.end(),
+                                      [this](const std::shared_ptr<dir_node> &n) {
+                                          return is_overloaded(*n);
+                                      });
+
     for (auto &n : _dir_nodes) {
         dassert(!n->has(pid),
                 "gpid(%d.%d) already in dir_node(%s)",
                 pid.get_app_id(),
                 pid.get_partition_index(),
                 n->tag.c_str());
+        if (!all_overloaded && is_overloaded(*n)) {
+            continue;
+        }
         unsigned app_replicas = n->replicas_count(pid.get_app_id());
         unsigned total_replicas = n->replicas_count();
 
+        // spread the replicas of an app over the disks, then prefer the lighter write load
         if (selected == nullptr || least_app_replicas_count > app_replicas) {
             least_app_replicas_count = app_replicas;
             least_total_replicas_count = total_replicas;
             selected = n.get();
         } else if (least_app_replicas_count == app_replicas &&
-                   least_total_replicas_count > total_replicas) {
+                   (n->write_bytes_per_sec < selected->write_bytes_per_sec ||
+                    (n->write_bytes_per_sec == selected->write_bytes_per_sec &&
+                     least_total_replicas_count > total_replicas))) {
             least_total_replicas_count = total_replicas;
             selected = n.get();
         }
@@ -268,6 +436,11 @@ void fs_manager::remove_replica(const gpid &pid)
     }
 }
 
+bool fs_manager::is_overloaded(const dir_node &n) const
+{
+    return n.slow || n.io_util_ratio >= FLAGS_disk_io_util_high_ratio;
+}
+
 bool fs_manager::for_each_dir_node(const std::function<bool(const dir_node &)> &func) const
 {
     zauto_read_lock l(_lock);
@@ -306,5 +479,196 @@ void fs_manager::update_disk_stat()
     _counter_min_available_ratio->set(_min_available_ratio);
     _counter_max_available_ratio->set(_max_available_ratio);
 }
+
+void fs_manager::update_disk_load(const std::map<gpid, int64_t> &replica_written_bytes)
+{
+    uint64_t now_ms = dsn_now_ms();
+    uint64_t elapsed_ms = now_ms - _last_load_update_ms;
+
+    zauto_write_lock l(_lock);
+    int max_io_util_ratio = 0;
+    int64_t max_write_bytes_per_sec = 0;
+    for (auto &n : _dir_nodes) {
+        n->update_io_stat(now_ms);
+        n->update_aio_stat();
+        n->write_bytes_per_sec = 0;
+        n->replica_write_bytes_per_sec.clear();
+        for (const auto &kv : n->holding_replicas) {
+            for (const gpid &pid : kv.second) {
+                auto cur = replica_written_bytes.find(pid);
+                auto last = _last_replica_written_bytes.find(pid);
+                if (_last_load_update_ms == 0 || cur == replica_written_bytes.end() ||
+                    last == _last_replica_written_bytes.end() || cur->second < last->second) {
+                    continue;
+                }
+                int64_t rate = (cur->second - last->second) * 1000 /
+                               static_cast<int64_t>(std::max<uint64_t>(elapsed_ms, 1));
+                n->replica_write_bytes_per_sec[pid] = rate;
+                n->write_bytes_per_sec += rate;
+            }
+        }
+        max_io_util_ratio = std::max(max_io_util_ratio, n->io_util_ratio);
+        max_write_bytes_per_sec = std::max(max_write_bytes_per_sec, n->write_bytes_per_sec);
+        dinfo_f("update disk load: dir = {}, io_util_ratio = {}%, io_queue_depth = {}, "
+                "write_bytes_per_sec = {}, aio_count = {}, aio_p99_latency_us = {}",
+                n->full_dir,
+                n->io_util_ratio,
+                n->io_queue_depth,
+                n->write_bytes_per_sec,
+                n->aio_count,
+                n->aio_p99_latency_us);
+    }
+    _last_load_update_ms = now_ms;
+    _last_replica_written_bytes = replica_written_bytes;
+    int slow_count = detect_slow_disks();
+
+    _counter_max_io_util_ratio->set(max_io_util_ratio);
+    _counter_max_disk_write_bytes_per_sec->set(max_write_bytes_per_sec);
+    _counter_slow_disk_count->set(slow_count);
+}
+
+int fs_manager::detect_slow_disks()
+{
+    int slow_count = 0;
+    for (auto &n : _dir_nodes) {
+        if (!FLAGS_disk_slow_detection_enabled) {
+            n->slow = false;
+            n->_slow_rounds = 0;
+            n->_normal_rounds = 0;
+            continue;
+        }
+        if (n->aio_count < FLAGS_disk_slow_min_aio_count) {
+            slow_count += n->slow ? 1 : 0;
+            continue;
+        }
+
+        // a disk is compared with its peers, so that a node-wide stall isn't blamed on the disks
+        std::vector<uint64_t> peer_latencies;
+        for (const auto &peer : _dir_nodes) {
+            if (peer != n && peer->aio_count >= FLAGS_disk_slow_min_aio_count) {
+                peer_latencies.push_back(peer->aio_p99_latency_us);
+            }
+        }
+        bool slow_in_round = false;
+        if (!peer_latencies.empty()) {
+            auto median = peer_latencies.begin() + peer_latencies.size() / 2;
+            std::nth_element(peer_latencies.begin(), median, peer_latencies.end());
+            slow_in_round =
+                n->aio_p99_latency_us >= FLAGS_disk_slow_aio_latency_ms * 1000ULL &&
+                n->aio_p99_latency_us >= *median * FLAGS_disk_slow_peer_latency_ratio;
+        }
+
+        if (slow_in_round) {
+            n->_normal_rounds = 0;
+            if (++n->_slow_rounds >= static_cast<int>(FLAGS_disk_slow_detect_rounds) &&
+                !n->slow) {
+                n->slow = true;
+                derror_f("disk {} is detected as fail-slow, whose p99 aio latency is {}us in "
+                         "the last {} rounds",
+                         n->tag,
+                         n->aio_p99_latency_us,
+                         n->_slow_rounds);
+            }
+        } else {
+            n->_slow_rounds = 0;
+            if (++n->_normal_rounds >= static_cast<int>(FLAGS_disk_slow_recover_rounds) &&
+                n->slow) {
+                n->slow = false;
+                ddebug_f("disk {} is recovered from fail-slow, whose p99 aio latency is {}us",
+                         n->tag,
+                         n->aio_p99_latency_us);
+            }
+        }
+        slow_count += n->slow ? 1 : 0;
+    }
+    return slow_count;
+}
+
+std::vector<std::string> fs_manager::get_slow_disks() const
+{
+    std::vector<std::string> tags;
+    zauto_read_lock l(_lock);
+    for (const auto &n : _dir_nodes) {
+        if (n->slow) {
+            tags.push_back(n->tag);
+        }
+    }
+    return tags;
+}
+
+bool fs_manager::plan_disk_migration(/*out*/ gpid &pid,
+                                     /*out*/ std::string &from_tag,
+                                     /*out*/ std::string &to_tag) const
+{
+    zauto_read_lock l(_lock);
+    if (_dir_nodes.size() < 2) {
+        return false;
+    }
+
+    const dir_node *heaviest = nullptr;
+    const dir_node *lightest = nullptr;
+    int64_t total = 0;
+    for (const auto &n : _dir_nodes) {
+        total += n->write_bytes_per_sec;
+        if (heaviest == nullptr || n->write_bytes_per_sec > heaviest->write_bytes_per_sec) {
+            heaviest = n.get();
+        }
+        if (!n->slow && n->disk_available_ratio >= FLAGS_disk_rebalance_min_available_ratio &&
+            (lightest == nullptr || n->write_bytes_per_sec < lightest->write_bytes_per_sec)) {
+            lightest = n.get();
+        }
+    }
+    if (lightest == nullptr || heaviest == lightest ||
+        heaviest->write_bytes_per_sec < FLAGS_disk_rebalance_min_write_bytes_per_sec) {
+        return false;
+    }
+    int64_t gap = heaviest->write_bytes_per_sec - lightest->write_bytes_per_sec;
+    int64_t average = total / static_cast<int64_t>(_dir_nodes.size());
+    if (gap * 100 <= average * FLAGS_disk_rebalance_load_gap_ratio) {
+        return false;
+    }
+
+    // the most written secondary which doesn't make the lightest disk heavier than the heaviest
+    // one, so the gap is narrowed the most. primaries aren't moved as they serve the writes.
+    int64_t best_rate = 0;
+    for (const auto &kv : heaviest->holding_secondary_replicas) {
+        for (const gpid &id : kv.second) {
+            auto it = heaviest->replica_write_bytes_per_sec.find(id);
+            if (it == heaviest->replica_write_bytes_per_sec.end()) {
+                continue;
+            }
+            if (it->second > best_rate && it->second < gap) {
+                best_rate = it->second;
+                pid = id;
+            }
+        }
+    }
+    if (best_rate == 0) {
+        return false;
+    }
+
+    from_tag = heaviest->tag;
+    to_tag = lightest->tag;
+    ddebug_f("plan to move replica {} from disk {}({} bytes/s) to disk {}({} bytes/s), whose "
+             "write rate is {} bytes/s",
+             pid,
+             from_tag,
+             heaviest->write_bytes_per_sec,
+             to_tag,
+             lightest->write_bytes_per_sec,
+             best_rate);
+    return true;
+}
+
+std::string fs_manager::get_dir_by_tag(const std::string &tag) const
+{
+    for (const auto &n : _dir_nodes) {
+        if (n->tag == tag) {
+            return n->full_dir;
+        }
+    }
+    return std::string();
+}
+
 } // namespace replication
 } // namespace dsn
@@ -55,6 +55,23 @@ public:
     std::map<app_id, std::set<gpid>> holding_primary_replicas;
     std::map<app_id, std::set<gpid>> holding_secondary_replicas;
 
+    // the i/o load of the disk, updated by fs_manager::update_disk_load():
+    //  - io_util_ratio: percent of the time that the device is busy, as %util of iostat
+    //  - io_queue_depth: average count of the requests in flight, as avgqu-sz of iostat
+    //  - write_bytes_per_sec: written by the replicas on the disk, estimated by the growth of
+    //    their private logs
+    // io_util_ratio and io_queue_depth are 0 if the device isn't found in /proc/diskstats.
+    int io_util_ratio;
+    double io_queue_depth;
+    int64_t write_bytes_per_sec;
+    std::map<gpid, int64_t> replica_write_bytes_per_sec;
+
+    // the aios completed on the disk since the last update_disk_load() and their p99 latency,
+    // and whether the disk is detected as fail-slow by fs_manager::detect_slow_disks()
+    uint64_t aio_count;
+    uint64_t aio_p99_latency_us;
+    bool slow;
+
 public:
     dir_node(const std::string &tag_,
              const std::string &dir_,
@@ -65,7 +82,13 @@ public:
           full_dir(dir_),
           disk_capacity_mb(disk_capacity_mb_),
           disk_available_mb(disk_available_mb_),
-          disk_available_ratio(disk_available_ratio_)
+          disk_available_ratio(disk_available_ratio_),
+          io_util_ratio(0),
+          io_queue_depth(0),
+          write_bytes_per_sec(0),
+          aio_count(0),
+          aio_p99_latency_us(0),
+          slow(false)
     {
     }
     unsigned replicas_count(app_id id) const;
@@ -73,6 +96,26 @@ public:
     bool has(const dsn::gpid &pid) const;
     unsigned remove(const dsn::gpid &pid);
     void update_disk_stat();
+    void update_io_stat(uint64_t now_ms);
+    void update_aio_stat();
+
+    // the latency in microseconds at `quantile` of the aios counted in `counts`, see
+    // file::get_disk_aio_latency_counts(), return 0 if there is none
+    static uint64_t aio_latency_quantile(const std::vector<uint64_t> &counts, double quantile);
+
+private:
+    friend class fs_manager;
+
+    // the last sample of /proc/diskstats
+    uint64_t _last_io_stat_ms = 0;
+    uint64_t _last_io_ticks_ms = 0;
+    uint64_t _last_weighted_io_ms = 0;
+
+    // the last sample of the aio latency counts
+    std::vector<uint64_t> _last_aio_latency_counts;
+    // the count of the consecutive rounds in which the disk is found slow or normal
+    int _slow_rounds = 0;
+    int _normal_rounds = 0;
 };
 
 class fs_manager
@@ -96,6 +139,21 @@ public:
     bool for_each_dir_node(const std::function<bool(const dir_node &)> &func) const;
     void update_disk_stat();
 
+    // update the i/o load of the disks, where `replica_written_bytes` is the total bytes
+    // written by each replica so far, whose growth since the last update is the write rate
+    void update_disk_load(const std::map<gpid, int64_t> &replica_written_bytes);
+
+    // plan to move a secondary replica from the disk with the heaviest write load to the one
+    // with the lightest, if the load of them differs by more than
+    // [replication] disk_rebalance_load_gap_ratio. returns false if there is no such move.
+    bool plan_disk_migration(/*out*/ gpid &pid,
+                             /*out*/ std::string &from_tag,
+                             /*out*/ std::string &to_tag) const;
+    // the root directory of the disk of `tag`, or empty if there isn't
+    std::string get_dir_by_tag(const std::string &tag) const;
+    // the tags of the disks detected as fail-slow
+    std::vector<std::string> get_slow_disks() const;
+
 private:
     void reset_disk_stat()
     {
@@ -107,6 +165,16 @@ private:
     }
 
     dir_node *get_dir_node(const std::string &subdir);
+    bool is_overloaded(const dir_node &n) const;
+
+    // a disk is slow in a round of update_disk_load() if the p99 latency of its aios exceeds
+    // both [replication] disk_slow_aio_latency_ms and [replication] disk_slow_peer_latency_ratio
+    // times the median of the other disks, and it's marked as fail-slow after
+    // [replication] disk_slow_detect_rounds such rounds in a row, until it's normal for
+    // [replication] disk_slow_recover_rounds rounds in a row. The disks with too few aios in
+    // a round are not judged. return the count of the fail-slow disks, caller should hold the
+    // write lock.
+    int detect_slow_disks();
 
     // when visit the tag/storage of the _dir_nodes map, there's no need to protect by the lock.
     // but when visit the holding_replicas, you must take care.
@@ -120,11 +188,18 @@ private:
 
     std::vector<std::shared_ptr<dir_node>> _dir_nodes;
 
+    // for update_disk_load()
+    uint64_t _last_load_update_ms = 0;
+    std::map<gpid, int64_t> _last_replica_written_bytes;
+
     perf_counter_wrapper _counter_total_capacity_mb;
     perf_counter_wrapper _counter_total_available_mb;
     perf_counter_wrapper _counter_total_available_ratio;
     perf_counter_wrapper _counter_min_available_ratio;
     perf_counter_wrapper _counter_max_available_ratio;
+    perf_counter_wrapper _counter_max_io_util_ratio;
+    perf_counter_wrapper _counter_max_disk_write_bytes_per_sec;
+    perf_counter_wrapper _counter_slow_disk_count;
 
     friend class replica_stub;
     friend class mock_replica_stub;
@@ -28,6 +28,7 @@
 
 #include <fstream>
 
+#include <dsn/cpp/rpc_stream.h>
 #include <dsn/dist/replication/replica_envs.h>
 #include <dsn/utility/flags.h>
 #include <dsn/utility/filesystem.h>
@@ -39,6 +40,28 @@ DSN_DEFINE_int32("replication",
                  max_concurrent_bulk_load_downloading_count,
                  5,
                  "concurrent bulk load downloading replica count");
+DSN_DEFINE_int32("replication",
+                 max_concurrent_checkpoint_count_per_disk,
+                 2,
+                 "max count of the replicas doing background checkpoint concurrently on each "
+                 "disk, 0 means no limit");
+DSN_DEFINE_bool("replication",
+                cold_backup_incremental,
+                false,
+                "whether cold backup uploads only the checkpoint files changed since the previous "
+                "backups of the same policy, and references the unchanged ones uploaded by them");
+DSN_DEFINE_uint32("replication",
+                  cold_backup_max_incremental_chain,
+                  7,
+                  "a checkpoint file is uploaded again by the incremental cold backup if the backup "
+                  "which has uploaded it is this many backups ago, so meta server keeps this many "
+                  "backups more than backup_history_count_to_keep for the references");
+DSN_DEFINE_uint32("replication",
+                  cold_backup_small_file_kb,
+                  1024,
+                  "the checkpoint files smaller than it are uploaded by cold backup up to 8 at a "
+                  "time in one of the max_concurrent_uploading_file_count slots, after the "
+                  "larger files which are uploaded first; 0 means all files take a slot each");
 
 /*extern*/ const char *partition_status_to_string(partition_status::type status)
 {
@@ -49,6 +72,76 @@ DSN_DEFINE_int32("replication",
     return it->second;
 }
 
+/*extern*/ void write_config_proposal_batch(
+    dsn::message_ex *msg, const std::vector<configuration_update_request> &proposals)
+{
+    rpc_write_stream writer(msg);
+    writer.write_pod(static_cast<int>(proposals.size()));
+    for (const configuration_update_request &proposal : proposals) {
+        marshall(writer, proposal, DSF_THRIFT_BINARY);
+    }
+}
+
+/*extern*/ void read_config_proposal_batch(
+    dsn::message_ex *msg, /*out*/ std::vector<configuration_update_request> &proposals)
+{
+    rpc_read_stream reader(msg);
+    int count = 0;
+    reader.read_pod(count);
+    dassert(count >= 0, "invalid proposal count %d in batch", count);
+    proposals.resize(count);
+    for (configuration_update_request &proposal : proposals) {
+        unmarshall(reader, proposal, DSF_THRIFT_BINARY);
+    }
+}
+
+template <typename T>
+static void write_thrift_batch(dsn::message_ex *msg, const std::vector<T> &items)
+{
+    rpc_write_stream writer(msg);
+    writer.write_pod(static_cast<int>(items.size()));
+    for (const T &item : items) {
+        marshall(writer, item, DSF_THRIFT_BINARY);
+    }
+}
+
+template <typename T>
+static void read_thrift_batch(dsn::message_ex *msg, /*out*/ std::vector<T> &items)
+{
+    rpc_read_stream reader(msg);
+    int count = 0;
+    reader.read_pod(count);
+    dassert(count >= 0, "invalid item count %d in batch", count);
+    items.resize(count);
+    for (T &item : items) {
+        unmarshall(reader, item, DSF_THRIFT_BINARY);
+    }
+}
+
+/*extern*/ void write_group_check_batch(dsn::message_ex *msg,
+                                        const std::vector<group_check_request> &requests)
+{
+    write_thrift_batch(msg, requests);
+}
+
+/*extern*/ void read_group_check_batch(dsn::message_ex *msg,
+                                       /*out*/ std::vector<group_check_request> &requests)
+{
+    read_thrift_batch(msg, requests);
+}
+
+/*extern*/ void write_group_check_batch(dsn::message_ex *msg,
+                                        const std::vector<group_check_response> &responses)
+{
+    write_thrift_batch(msg, responses);
+}
+
+/*extern*/ void read_group_check_batch(dsn::message_ex *msg,
+                                       /*out*/ std::vector<group_check_response> &responses)
+{
+    read_thrift_batch(msg, responses);
+}
+
 replication_options::replication_options()
 {
     deny_client_on_start = false;
@@ -118,6 +211,8 @@ replication_options::replication_options()
     max_concurrent_uploading_file_count = 10;
 
     cold_backup_checkpoint_reserve_minutes = 10;
+
+    max_concurrent_checkpoint_count_per_disk = 2;
 }
 
 replication_options::~replication_options() {}
@@ -528,6 +623,7 @@ void replication_options::initialize()
                                                           "bulk load root on remote file provider");
 
     max_concurrent_bulk_load_downloading_count = FLAGS_max_concurrent_bulk_load_downloading_count;
+    max_concurrent_checkpoint_count_per_disk = FLAGS_max_concurrent_checkpoint_count_per_disk;
 
     replica_helper::load_meta_servers(meta_servers);
 
@@ -601,6 +697,7 @@ const std::string cold_backup_constant::APP_BACKUP_STATUS("app_backup_status");
 const std::string cold_backup_constant::CURRENT_CHECKPOINT("current_checkpoint");
 const std::string cold_backup_constant::BACKUP_METADATA("backup_metadata");
 const std::string cold_backup_constant::BACKUP_INFO("backup_info");
+const std::string cold_backup_constant::INCREMENTAL_MANIFEST("incremental_manifest");
 const int32_t cold_backup_constant::PROGRESS_FINISHED = 1000;
 
 const std::string backup_restore_constant::FORCE_RESTORE("restore.force_restore");
@@ -644,6 +741,8 @@ const std::string replica_envs::ROCKSDB_CHECKPOINT_RESERVE_TIME_SECONDS(
 const std::string replica_envs::ROCKSDB_ITERATION_THRESHOLD_TIME_MS(
     "replica.rocksdb_iteration_threshold_time_ms");
 const std::string replica_envs::BUSINESS_INFO("business.info");
+const std::string replica_envs::POOL_GROUP("replica.pool_group");
+const std::string replica_envs::WRITE_FAIR_QUEUING("replica.write_fair_queuing");
 
 const std::string bulk_load_constant::BULK_LOAD_INFO("bulk_load_info");
 const int32_t bulk_load_constant::BULK_LOAD_REQUEST_INTERVAL = 10;
@@ -772,6 +871,19 @@ std::string get_remote_chkpt_meta_file(const std::string &root,
     return ss.str();
 }
 
+
+std::string get_incremental_manifest_file(const std::string &root,
+                                          const std::string &policy_name,
+                                          const std::string &app_name,
+                                          gpid pid)
+{
+    std::stringstream ss;
+    ss << get_policy_path(root, policy_name) << "/incremental/" << app_name << "_"
+       << pid.get_app_id() << "/" << pid.get_partition_index() << "/"
+       << cold_backup_constant::INCREMENTAL_MANIFEST;
+    return ss.str();
+}
+
 } // namespace cold_backup
 } // namespace replication
 } // namespace dsn
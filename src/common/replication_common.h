@@ -120,6 +120,7 @@ public:
 
     std::string bulk_load_provider_root;
     int32_t max_concurrent_bulk_load_downloading_count;
+    int32_t max_concurrent_checkpoint_count_per_disk;
 
 public:
     replication_options();
@@ -134,6 +135,24 @@ typedef rpc_holder<register_child_request, register_child_response> register_chi
 
 extern const char *partition_status_to_string(partition_status::type status);
 
+// the body of RPC_CONFIG_PROPOSAL_BATCH is the count of proposals followed by each of them,
+// which are sent by meta server to the same replica server
+extern void write_config_proposal_batch(dsn::message_ex *msg,
+                                        const std::vector<configuration_update_request> &proposals);
+extern void read_config_proposal_batch(dsn::message_ex *msg,
+                                       /*out*/ std::vector<configuration_update_request> &proposals);
+
+// the bodies of RPC_GROUP_CHECK_BATCH and its response are the count of group checks followed by
+// each of them, which are sent by the primaries on a replica server to the same node
+extern void write_group_check_batch(dsn::message_ex *msg,
+                                    const std::vector<group_check_request> &requests);
+extern void read_group_check_batch(dsn::message_ex *msg,
+                                   /*out*/ std::vector<group_check_request> &requests);
+extern void write_group_check_batch(dsn::message_ex *msg,
+                                    const std::vector<group_check_response> &responses);
+extern void read_group_check_batch(dsn::message_ex *msg,
+                                   /*out*/ std::vector<group_check_response> &responses);
+
 class cold_backup_constant
 {
 public:
@@ -142,6 +161,7 @@ public:
     static const std::string CURRENT_CHECKPOINT;
     static const std::string BACKUP_METADATA;
     static const std::string BACKUP_INFO;
+    static const std::string INCREMENTAL_MANIFEST;
     static const int32_t PROGRESS_FINISHED;
 };
 
@@ -321,6 +341,19 @@ std::string get_remote_chkpt_meta_file(const std::string &root,
                                        const std::string &app_name,
                                        gpid pid,
                                        int64_t backup_id);
+
+// compose the absolute path(AP) of the incremental backup manifest of a replica on block service,
+// which is shared by all the backups of the policy
+// input:
+//  -- root:       the prefix of the AP
+//  -- pid:          gpid of replcia
+// return:
+//      the AP of the incremental backup manifest:
+//      <root>/<policy_name>/incremental/<appname_appid>/<partition_index>/incremental_manifest
+std::string get_incremental_manifest_file(const std::string &root,
+                                          const std::string &policy_name,
+                                          const std::string &app_name,
+                                          gpid pid);
 } // namespace cold_backup
 } // namespace replication
 } // namespace dsn
@@ -1811,6 +1811,143 @@ void learn_state::printTo(std::ostream &out) const
     out << ")";
 }
 
+file_meta::~file_meta() throw() {}
+
+void file_meta::__set_name(const std::string &val) { this->name = val; }
+
+void file_meta::__set_size(const int64_t val) { this->size = val; }
+
+void file_meta::__set_md5(const std::string &val) { this->md5 = val; }
+
+uint32_t file_meta::read(::apache::thrift::protocol::TProtocol *iprot)
+{
+
+    apache::thrift::protocol::TInputRecursionTracker tracker(*iprot);
+    uint32_t xfer = 0;
+    std::string fname;
+    ::apache::thrift::protocol::TType ftype;
+    int16_t fid;
+
+    xfer += iprot->readStructBegin(fname);
+
+    using ::apache::thrift::protocol::TProtocolException;
+
+    while (true) {
+        xfer += iprot->readFieldBegin(fname, ftype, fid);
+        if (ftype == ::apache::thrift::protocol::T_STOP) {
+            break;
+        }
+        switch (fid) {
+        case 1:
+            if (ftype == ::apache::thrift::protocol::T_STRING) {
+                xfer += iprot->readString(this->name);
+                this->__isset.name = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
+        case 2:
+            if (ftype == ::apache::thrift::protocol::T_I64) {
+                xfer += iprot->readI64(this->size);
+                this->__isset.size = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
+        case 3:
+            if (ftype == ::apache::thrift::protocol::T_STRING) {
+                xfer += iprot->readString(this->md5);
+                this->__isset.md5 = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
+        default:
+            xfer += iprot->skip(ftype);
+            break;
+        }
+        xfer += iprot->readFieldEnd();
+    }
+
+    xfer += iprot->readStructEnd();
+
+    return xfer;
+}
+
+uint32_t file_meta::write(::apache::thrift::protocol::TProtocol *oprot) const
+{
+    uint32_t xfer = 0;
+    apache::thrift::protocol::TOutputRecursionTracker tracker(*oprot);
+    xfer += oprot->writeStructBegin("file_meta");
+
+    xfer += oprot->writeFieldBegin("name", ::apache::thrift::protocol::T_STRING, 1);
+    xfer += oprot->writeString(this->name);
+    xfer += oprot->writeFieldEnd();
+
+    xfer += oprot->writeFieldBegin("size", ::apache::thrift::protocol::T_I64, 2);
+    xfer += oprot->writeI64(this->size);
+    xfer += oprot->writeFieldEnd();
+
+    xfer += oprot->writeFieldBegin("md5", ::apache::thrift::protocol::T_STRING, 3);
+    xfer += oprot->writeString(this->md5);
+    xfer += oprot->writeFieldEnd();
+
+    xfer += oprot->writeFieldStop();
+    xfer += oprot->writeStructEnd();
+    return xfer;
+}
+
+void swap(file_meta &a, file_meta &b)
+{
+    using ::std::swap;
+    swap(a.name, b.name);
+    swap(a.size, b.size);
+    swap(a.md5, b.md5);
+    swap(a.__isset, b.__isset);
+}
+
+file_meta::file_meta(const file_meta &other473)
+{
+    name = other473.name;
+    size = other473.size;
+    md5 = other473.md5;
+    __isset = other473.__isset;
+}
+file_meta::file_meta(file_meta &&other474)
+{
+    name = std::move(other474.name);
+    size = std::move(other474.size);
+    md5 = std::move(other474.md5);
+    __isset = std::move(other474.__isset);
+}
+file_meta &file_meta::operator=(const file_meta &other475)
+{
+    name = other475.name;
+    size = other475.size;
+    md5 = other475.md5;
+    __isset = other475.__isset;
+    return *this;
+}
+file_meta &file_meta::operator=(file_meta &&other476)
+{
+    name = std::move(other476.name);
+    size = std::move(other476.size);
+    md5 = std::move(other476.md5);
+    __isset = std::move(other476.__isset);
+    return *this;
+}
+void file_meta::printTo(std::ostream &out) const
+{
+    using ::apache::thrift::to_string;
+    out << "file_meta(";
+    out << "name=" << to_string(name);
+    out << ", "
+        << "size=" << to_string(size);
+    out << ", "
+        << "md5=" << to_string(md5);
+    out << ")";
+}
+
 learn_request::~learn_request() throw() {}
 
 void learn_request::__set_pid(const ::dsn::gpid &val) { this->pid = val; }
@@ -1840,6 +1977,12 @@ void learn_request::__set_max_gced_decree(const int64_t val)
     __isset.max_gced_decree = true;
 }
 
+void learn_request::__set_local_files(const std::vector<file_meta> &val)
+{
+    this->local_files = val;
+    __isset.local_files = true;
+}
+
 uint32_t learn_request::read(::apache::thrift::protocol::TProtocol *iprot)
 {
 
@@ -1915,6 +2058,25 @@ uint32_t learn_request::read(::apache::thrift::protocol::TProtocol *iprot)
                 xfer += iprot->skip(ftype);
             }
             break;
+        case 8:
+            if (ftype == ::apache::thrift::protocol::T_LIST) {
+                {
+                    this->local_files.clear();
+                    uint32_t _size712;
+                    ::apache::thrift::protocol::TType _etype715;
+                    xfer += iprot->readListBegin(_etype715, _size712);
+                    this->local_files.resize(_size712);
+                    uint32_t _i716;
+                    for (_i716 = 0; _i716 < _size712; ++_i716) {
+                        xfer += this->local_files[_i716].read(iprot);
+                    }
+                    xfer += iprot->readListEnd();
+                }
+                this->__isset.local_files = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
         default:
             xfer += iprot->skip(ftype);
             break;
@@ -1965,6 +2127,20 @@ uint32_t learn_request::write(::apache::thrift::protocol::TProtocol *oprot) cons
         xfer += oprot->writeI64(this->max_gced_decree);
         xfer += oprot->writeFieldEnd();
     }
+    if (this->__isset.local_files) {
+        xfer += oprot->writeFieldBegin("local_files", ::apache::thrift::protocol::T_LIST, 8);
+        {
+            xfer += oprot->writeListBegin(::apache::thrift::protocol::T_STRUCT,
+                                          static_cast<uint32_t>(this->local_files.size()));
+            std::vector<file_meta>::const_iterator _iter717;
+            for (_iter717 = this->local_files.begin(); _iter717 != this->local_files.end();
+                 ++_iter717) {
+                xfer += (*_iter717).write(oprot);
+            }
+            xfer += oprot->writeListEnd();
+        }
+        xfer += oprot->writeFieldEnd();
+    }
     xfer += oprot->writeFieldStop();
     xfer += oprot->writeStructEnd();
     return xfer;
@@ -1980,6 +2156,7 @@ void swap(learn_request &a, learn_request &b)
     swap(a.last_committed_decree_in_prepare_list, b.last_committed_decree_in_prepare_list);
     swap(a.app_specific_learn_request, b.app_specific_learn_request);
     swap(a.max_gced_decree, b.max_gced_decree);
+    swap(a.local_files, b.local_files);
     swap(a.__isset, b.__isset);
 }
 
@@ -1992,6 +2169,7 @@ learn_request::learn_request(const learn_request &other54)
     last_committed_decree_in_prepare_list = other54.last_committed_decree_in_prepare_list;
     app_specific_learn_request = other54.app_specific_learn_request;
     max_gced_decree = other54.max_gced_decree;
+    local_files = other54.local_files;
     __isset = other54.__isset;
 }
 learn_request::learn_request(learn_request &&other55)
@@ -2004,6 +2182,7 @@ learn_request::learn_request(learn_request &&other55)
         std::move(other55.last_committed_decree_in_prepare_list);
     app_specific_learn_request = std::move(other55.app_specific_learn_request);
     max_gced_decree = std::move(other55.max_gced_decree);
+    local_files = std::move(other55.local_files);
     __isset = std::move(other55.__isset);
 }
 learn_request &learn_request::operator=(const learn_request &other56)
@@ -2015,6 +2194,7 @@ learn_request &learn_request::operator=(const learn_request &other56)
     last_committed_decree_in_prepare_list = other56.last_committed_decree_in_prepare_list;
     app_specific_learn_request = other56.app_specific_learn_request;
     max_gced_decree = other56.max_gced_decree;
+    local_files = other56.local_files;
     __isset = other56.__isset;
     return *this;
 }
@@ -2028,6 +2208,7 @@ learn_request &learn_request::operator=(learn_request &&other57)
         std::move(other57.last_committed_decree_in_prepare_list);
     app_specific_learn_request = std::move(other57.app_specific_learn_request);
     max_gced_decree = std::move(other57.max_gced_decree);
+    local_files = std::move(other57.local_files);
     __isset = std::move(other57.__isset);
     return *this;
 }
@@ -2050,6 +2231,9 @@ void learn_request::printTo(std::ostream &out) const
     out << ", "
         << "max_gced_decree=";
     (__isset.max_gced_decree ? (out << to_string(max_gced_decree)) : (out << "<null>"));
+    out << ", "
+        << "local_files=";
+    (__isset.local_files ? (out << to_string(local_files)) : (out << "<null>"));
     out << ")";
 }
 
@@ -2077,6 +2261,18 @@ void learn_response::__set_address(const ::dsn::rpc_address &val) { this->addres
 
 void learn_response::__set_base_local_dir(const std::string &val) { this->base_local_dir = val; }
 
+void learn_response::__set_reused_files(const std::vector<file_meta> &val)
+{
+    this->reused_files = val;
+    __isset.reused_files = true;
+}
+
+void learn_response::__set_replica_count(const int32_t val)
+{
+    this->replica_count = val;
+    __isset.replica_count = true;
+}
+
 uint32_t learn_response::read(::apache::thrift::protocol::TProtocol *iprot)
 {
 
@@ -2162,6 +2358,33 @@ uint32_t learn_response::read(::apache::thrift::protocol::TProtocol *iprot)
                 xfer += iprot->skip(ftype);
             }
             break;
+        case 9:
+            if (ftype == ::apache::thrift::protocol::T_LIST) {
+                {
+                    this->reused_files.clear();
+                    uint32_t _size718;
+                    ::apache::thrift::protocol::TType _etype721;
+                    xfer += iprot->readListBegin(_etype721, _size718);
+                    this->reused_files.resize(_size718);
+                    uint32_t _i722;
+                    for (_i722 = 0; _i722 < _size718; ++_i722) {
+                        xfer += this->reused_files[_i722].read(iprot);
+                    }
+                    xfer += iprot->readListEnd();
+                }
+                this->__isset.reused_files = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
+        case 10:
+            if (ftype == ::apache::thrift::protocol::T_I32) {
+                xfer += iprot->readI32(this->replica_count);
+                this->__isset.replica_count = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
         default:
             xfer += iprot->skip(ftype);
             break;
@@ -2212,6 +2435,25 @@ uint32_t learn_response::write(::apache::thrift::protocol::TProtocol *oprot) con
     xfer += oprot->writeString(this->base_local_dir);
     xfer += oprot->writeFieldEnd();
 
+    if (this->__isset.reused_files) {
+        xfer += oprot->writeFieldBegin("reused_files", ::apache::thrift::protocol::T_LIST, 9);
+        {
+            xfer += oprot->writeListBegin(::apache::thrift::protocol::T_STRUCT,
+                                          static_cast<uint32_t>(this->reused_files.size()));
+            std::vector<file_meta>::const_iterator _iter723;
+            for (_iter723 = this->reused_files.begin(); _iter723 != this->reused_files.end();
+                 ++_iter723) {
+                xfer += (*_iter723).write(oprot);
+            }
+            xfer += oprot->writeListEnd();
+        }
+        xfer += oprot->writeFieldEnd();
+    }
+    if (this->__isset.replica_count) {
+        xfer += oprot->writeFieldBegin("replica_count", ::apache::thrift::protocol::T_I32, 10);
+        xfer += oprot->writeI32(this->replica_count);
+        xfer += oprot->writeFieldEnd();
+    }
     xfer += oprot->writeFieldStop();
     xfer += oprot->writeStructEnd();
     return xfer;
@@ -2228,6 +2470,8 @@ void swap(learn_response &a, learn_response &b)
     swap(a.state, b.state);
     swap(a.address, b.address);
     swap(a.base_local_dir, b.base_local_dir);
+    swap(a.reused_files, b.reused_files);
+    swap(a.replica_count, b.replica_count);
     swap(a.__isset, b.__isset);
 }
 
@@ -2241,6 +2485,8 @@ learn_response::learn_response(const learn_response &other59)
     state = other59.state;
     address = other59.address;
     base_local_dir = other59.base_local_dir;
+    reused_files = other59.reused_files;
+    replica_count = other59.replica_count;
     __isset = other59.__isset;
 }
 learn_response::learn_response(learn_response &&other60)
@@ -2253,6 +2499,8 @@ learn_response::learn_response(learn_response &&other60)
     state = std::move(other60.state);
     address = std::move(other60.address);
     base_local_dir = std::move(other60.base_local_dir);
+    reused_files = std::move(other60.reused_files);
+    replica_count = std::move(other60.replica_count);
     __isset = std::move(other60.__isset);
 }
 learn_response &learn_response::operator=(const learn_response &other61)
@@ -2265,6 +2513,8 @@ learn_response &learn_response::operator=(const learn_response &other61)
     state = other61.state;
     address = other61.address;
     base_local_dir = other61.base_local_dir;
+    reused_files = other61.reused_files;
+    replica_count = other61.replica_count;
     __isset = other61.__isset;
     return *this;
 }
@@ -2278,6 +2528,8 @@ learn_response &learn_response::operator=(learn_response &&other62)
     state = std::move(other62.state);
     address = std::move(other62.address);
     base_local_dir = std::move(other62.base_local_dir);
+    reused_files = std::move(other62.reused_files);
+    replica_count = std::move(other62.replica_count);
     __isset = std::move(other62.__isset);
     return *this;
 }
@@ -2300,6 +2552,12 @@ void learn_response::printTo(std::ostream &out) const
         << "address=" << to_string(address);
     out << ", "
         << "base_local_dir=" << to_string(base_local_dir);
+    out << ", "
+        << "reused_files=";
+    (__isset.reused_files ? (out << to_string(reused_files)) : (out << "<null>"));
+    out << ", "
+        << "replica_count=";
+    (__isset.replica_count ? (out << to_string(replica_count)) : (out << "<null>"));
     out << ")";
 }
 
@@ -3369,7 +3627,7 @@ uint32_t replica_server_info::read(::apache::thrift::protocol::TProtocol *iprot)
                     for (_i94 = 0; _i94 < _size90; ++_i94) {
                         std::string _key95;
                         xfer += iprot->readString(_key95);
-                        std::string &_val96 = this->geo_tags[_key95];
+                        std::string &_val96 = this->geo_tags[std::move(_key95)];
                         xfer += iprot->readString(_val96);
                     }
                     xfer += iprot->readMapEnd();
@@ -3492,6 +3750,25 @@ void configuration_query_by_node_request::__set_info(const replica_server_info &
     __isset.info = true;
 }
 
+void configuration_query_by_node_request::__set_sync_version(const int64_t val)
+{
+    this->sync_version = val;
+    __isset.sync_version = true;
+}
+
+void configuration_query_by_node_request::__set_base_version(const int64_t val)
+{
+    this->base_version = val;
+    __isset.base_version = true;
+}
+
+void configuration_query_by_node_request::__set_removed_replicas(
+    const std::vector<::dsn::gpid> &val)
+{
+    this->removed_replicas = val;
+    __isset.removed_replicas = true;
+}
+
 uint32_t configuration_query_by_node_request::read(::apache::thrift::protocol::TProtocol *iprot)
 {
 
@@ -3546,6 +3823,41 @@ uint32_t configuration_query_by_node_request::read(::apache::thrift::protocol::T
                 xfer += iprot->skip(ftype);
             }
             break;
+        case 4:
+            if (ftype == ::apache::thrift::protocol::T_I64) {
+                xfer += iprot->readI64(this->sync_version);
+                this->__isset.sync_version = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
+        case 5:
+            if (ftype == ::apache::thrift::protocol::T_I64) {
+                xfer += iprot->readI64(this->base_version);
+                this->__isset.base_version = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
+        case 6:
+            if (ftype == ::apache::thrift::protocol::T_LIST) {
+                {
+                    this->removed_replicas.clear();
+                    uint32_t _size706;
+                    ::apache::thrift::protocol::TType _etype709;
+                    xfer += iprot->readListBegin(_etype709, _size706);
+                    this->removed_replicas.resize(_size706);
+                    uint32_t _i710;
+                    for (_i710 = 0; _i710 < _size706; ++_i710) {
+                        xfer += this->removed_replicas[_i710].read(iprot);
+                    }
+                    xfer += iprot->readListEnd();
+                }
+                this->__isset.removed_replicas = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
         default:
             xfer += iprot->skip(ftype);
             break;
@@ -3588,6 +3900,31 @@ configuration_query_by_node_request::write(::apache::thrift::protocol::TProtocol
         xfer += this->info.write(oprot);
         xfer += oprot->writeFieldEnd();
     }
+    if (this->__isset.sync_version) {
+        xfer += oprot->writeFieldBegin("sync_version", ::apache::thrift::protocol::T_I64, 4);
+        xfer += oprot->writeI64(this->sync_version);
+        xfer += oprot->writeFieldEnd();
+    }
+    if (this->__isset.base_version) {
+        xfer += oprot->writeFieldBegin("base_version", ::apache::thrift::protocol::T_I64, 5);
+        xfer += oprot->writeI64(this->base_version);
+        xfer += oprot->writeFieldEnd();
+    }
+    if (this->__isset.removed_replicas) {
+        xfer += oprot->writeFieldBegin("removed_replicas", ::apache::thrift::protocol::T_LIST, 6);
+        {
+            xfer += oprot->writeListBegin(::apache::thrift::protocol::T_STRUCT,
+                                          static_cast<uint32_t>(this->removed_replicas.size()));
+            std::vector<::dsn::gpid>::const_iterator _iter711;
+            for (_iter711 = this->removed_replicas.begin();
+                 _iter711 != this->removed_replicas.end();
+                 ++_iter711) {
+                xfer += (*_iter711).write(oprot);
+            }
+            xfer += oprot->writeListEnd();
+        }
+        xfer += oprot->writeFieldEnd();
+    }
     xfer += oprot->writeFieldStop();
     xfer += oprot->writeStructEnd();
     return xfer;
@@ -3599,6 +3936,9 @@ void swap(configuration_query_by_node_request &a, configuration_query_by_node_re
     swap(a.node, b.node);
     swap(a.stored_replicas, b.stored_replicas);
     swap(a.info, b.info);
+    swap(a.sync_version, b.sync_version);
+    swap(a.base_version, b.base_version);
+    swap(a.removed_replicas, b.removed_replicas);
     swap(a.__isset, b.__isset);
 }
 
@@ -3608,6 +3948,9 @@ configuration_query_by_node_request::configuration_query_by_node_request(
     node = other108.node;
     stored_replicas = other108.stored_replicas;
     info = other108.info;
+    sync_version = other108.sync_version;
+    base_version = other108.base_version;
+    removed_replicas = other108.removed_replicas;
     __isset = other108.__isset;
 }
 configuration_query_by_node_request::configuration_query_by_node_request(
@@ -3616,6 +3959,9 @@ configuration_query_by_node_request::configuration_query_by_node_request(
     node = std::move(other109.node);
     stored_replicas = std::move(other109.stored_replicas);
     info = std::move(other109.info);
+    sync_version = std::move(other109.sync_version);
+    base_version = std::move(other109.base_version);
+    removed_replicas = std::move(other109.removed_replicas);
     __isset = std::move(other109.__isset);
 }
 configuration_query_by_node_request &configuration_query_by_node_request::
@@ -3624,6 +3970,9 @@ operator=(const configuration_query_by_node_request &other110)
     node = other110.node;
     stored_replicas = other110.stored_replicas;
     info = other110.info;
+    sync_version = other110.sync_version;
+    base_version = other110.base_version;
+    removed_replicas = other110.removed_replicas;
     __isset = other110.__isset;
     return *this;
 }
@@ -3633,6 +3982,9 @@ operator=(configuration_query_by_node_request &&other111)
     node = std::move(other111.node);
     stored_replicas = std::move(other111.stored_replicas);
     info = std::move(other111.info);
+    sync_version = std::move(other111.sync_version);
+    base_version = std::move(other111.base_version);
+    removed_replicas = std::move(other111.removed_replicas);
     __isset = std::move(other111.__isset);
     return *this;
 }
@@ -3647,6 +3999,15 @@ void configuration_query_by_node_request::printTo(std::ostream &out) const
     out << ", "
         << "info=";
     (__isset.info ? (out << to_string(info)) : (out << "<null>"));
+    out << ", "
+        << "sync_version=";
+    (__isset.sync_version ? (out << to_string(sync_version)) : (out << "<null>"));
+    out << ", "
+        << "base_version=";
+    (__isset.base_version ? (out << to_string(base_version)) : (out << "<null>"));
+    out << ", "
+        << "removed_replicas=";
+    (__isset.removed_replicas ? (out << to_string(removed_replicas)) : (out << "<null>"));
     out << ")";
 }
 
@@ -3669,6 +4030,12 @@ void configuration_query_by_node_response::__set_gc_replicas(const std::vector<r
     __isset.gc_replicas = true;
 }
 
+void configuration_query_by_node_response::__set_acked_sync_version(const int64_t val)
+{
+    this->acked_sync_version = val;
+    __isset.acked_sync_version = true;
+}
+
 uint32_t configuration_query_by_node_response::read(::apache::thrift::protocol::TProtocol *iprot)
 {
 
@@ -3734,6 +4101,14 @@ uint32_t configuration_query_by_node_response::read(::apache::thrift::protocol::
                 xfer += iprot->skip(ftype);
             }
             break;
+        case 4:
+            if (ftype == ::apache::thrift::protocol::T_I64) {
+                xfer += iprot->readI64(this->acked_sync_version);
+                this->__isset.acked_sync_version = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
         default:
             xfer += iprot->skip(ftype);
             break;
@@ -3783,6 +4158,11 @@ configuration_query_by_node_response::write(::apache::thrift::protocol::TProtoco
         }
         xfer += oprot->writeFieldEnd();
     }
+    if (this->__isset.acked_sync_version) {
+        xfer += oprot->writeFieldBegin("acked_sync_version", ::apache::thrift::protocol::T_I64, 4);
+        xfer += oprot->writeI64(this->acked_sync_version);
+        xfer += oprot->writeFieldEnd();
+    }
     xfer += oprot->writeFieldStop();
     xfer += oprot->writeStructEnd();
     return xfer;
@@ -3794,6 +4174,7 @@ void swap(configuration_query_by_node_response &a, configuration_query_by_node_r
     swap(a.err, b.err);
     swap(a.partitions, b.partitions);
     swap(a.gc_replicas, b.gc_replicas);
+    swap(a.acked_sync_version, b.acked_sync_version);
     swap(a.__isset, b.__isset);
 }
 
@@ -3803,6 +4184,7 @@ configuration_query_by_node_response::configuration_query_by_node_response(
     err = other124.err;
     partitions = other124.partitions;
     gc_replicas = other124.gc_replicas;
+    acked_sync_version = other124.acked_sync_version;
     __isset = other124.__isset;
 }
 configuration_query_by_node_response::configuration_query_by_node_response(
@@ -3811,6 +4193,7 @@ configuration_query_by_node_response::configuration_query_by_node_response(
     err = std::move(other125.err);
     partitions = std::move(other125.partitions);
     gc_replicas = std::move(other125.gc_replicas);
+    acked_sync_version = std::move(other125.acked_sync_version);
     __isset = std::move(other125.__isset);
 }
 configuration_query_by_node_response &configuration_query_by_node_response::
@@ -3819,6 +4202,7 @@ operator=(const configuration_query_by_node_response &other126)
     err = other126.err;
     partitions = other126.partitions;
     gc_replicas = other126.gc_replicas;
+    acked_sync_version = other126.acked_sync_version;
     __isset = other126.__isset;
     return *this;
 }
@@ -3828,6 +4212,7 @@ operator=(configuration_query_by_node_response &&other127)
     err = std::move(other127.err);
     partitions = std::move(other127.partitions);
     gc_replicas = std::move(other127.gc_replicas);
+    acked_sync_version = std::move(other127.acked_sync_version);
     __isset = std::move(other127.__isset);
     return *this;
 }
@@ -3841,6 +4226,9 @@ void configuration_query_by_node_response::printTo(std::ostream &out) const
     out << ", "
         << "gc_replicas=";
     (__isset.gc_replicas ? (out << to_string(gc_replicas)) : (out << "<null>"));
+    out << ", "
+        << "acked_sync_version=";
+    (__isset.acked_sync_version ? (out << to_string(acked_sync_version)) : (out << "<null>"));
     out << ")";
 }
 
@@ -3932,7 +4320,7 @@ uint32_t create_app_options::read(::apache::thrift::protocol::TProtocol *iprot)
                     for (_i132 = 0; _i132 < _size128; ++_i132) {
                         std::string _key133;
                         xfer += iprot->readString(_key133);
-                        std::string &_val134 = this->envs[_key133];
+                        std::string &_val134 = this->envs[std::move(_key133)];
                         xfer += iprot->readString(_val134);
                     }
                     xfer += iprot->readMapEnd();
@@ -7163,7 +7551,7 @@ uint32_t disk_info::read(::apache::thrift::protocol::TProtocol *iprot)
                     for (_i279 = 0; _i279 < _size275; ++_i279) {
                         int32_t _key280;
                         xfer += iprot->readI32(_key280);
-                        int32_t &_val281 = this->holding_primary_replica_counts[_key280];
+                        int32_t &_val281 = this->holding_primary_replica_counts[std::move(_key280)];
                         xfer += iprot->readI32(_val281);
                     }
                     xfer += iprot->readMapEnd();
@@ -7185,7 +7573,8 @@ uint32_t disk_info::read(::apache::thrift::protocol::TProtocol *iprot)
                     for (_i286 = 0; _i286 < _size282; ++_i286) {
                         int32_t _key287;
                         xfer += iprot->readI32(_key287);
-                        int32_t &_val288 = this->holding_secondary_replica_counts[_key287];
+                        int32_t &_val288 =
+                            this->holding_secondary_replica_counts[std::move(_key287)];
                         xfer += iprot->readI32(_val288);
                     }
                     xfer += iprot->readMapEnd();
@@ -11250,143 +11639,6 @@ void configuration_query_restore_response::printTo(std::ostream &out) const
     out << ")";
 }
 
-file_meta::~file_meta() throw() {}
-
-void file_meta::__set_name(const std::string &val) { this->name = val; }
-
-void file_meta::__set_size(const int64_t val) { this->size = val; }
-
-void file_meta::__set_md5(const std::string &val) { this->md5 = val; }
-
-uint32_t file_meta::read(::apache::thrift::protocol::TProtocol *iprot)
-{
-
-    apache::thrift::protocol::TInputRecursionTracker tracker(*iprot);
-    uint32_t xfer = 0;
-    std::string fname;
-    ::apache::thrift::protocol::TType ftype;
-    int16_t fid;
-
-    xfer += iprot->readStructBegin(fname);
-
-    using ::apache::thrift::protocol::TProtocolException;
-
-    while (true) {
-        xfer += iprot->readFieldBegin(fname, ftype, fid);
-        if (ftype == ::apache::thrift::protocol::T_STOP) {
-            break;
-        }
-        switch (fid) {
-        case 1:
-            if (ftype == ::apache::thrift::protocol::T_STRING) {
-                xfer += iprot->readString(this->name);
-                this->__isset.name = true;
-            } else {
-                xfer += iprot->skip(ftype);
-            }
-            break;
-        case 2:
-            if (ftype == ::apache::thrift::protocol::T_I64) {
-                xfer += iprot->readI64(this->size);
-                this->__isset.size = true;
-            } else {
-                xfer += iprot->skip(ftype);
-            }
-            break;
-        case 3:
-            if (ftype == ::apache::thrift::protocol::T_STRING) {
-                xfer += iprot->readString(this->md5);
-                this->__isset.md5 = true;
-            } else {
-                xfer += iprot->skip(ftype);
-            }
-            break;
-        default:
-            xfer += iprot->skip(ftype);
-            break;
-        }
-        xfer += iprot->readFieldEnd();
-    }
-
-    xfer += iprot->readStructEnd();
-
-    return xfer;
-}
-
-uint32_t file_meta::write(::apache::thrift::protocol::TProtocol *oprot) const
-{
-    uint32_t xfer = 0;
-    apache::thrift::protocol::TOutputRecursionTracker tracker(*oprot);
-    xfer += oprot->writeStructBegin("file_meta");
-
-    xfer += oprot->writeFieldBegin("name", ::apache::thrift::protocol::T_STRING, 1);
-    xfer += oprot->writeString(this->name);
-    xfer += oprot->writeFieldEnd();
-
-    xfer += oprot->writeFieldBegin("size", ::apache::thrift::protocol::T_I64, 2);
-    xfer += oprot->writeI64(this->size);
-    xfer += oprot->writeFieldEnd();
-
-    xfer += oprot->writeFieldBegin("md5", ::apache::thrift::protocol::T_STRING, 3);
-    xfer += oprot->writeString(this->md5);
-    xfer += oprot->writeFieldEnd();
-
-    xfer += oprot->writeFieldStop();
-    xfer += oprot->writeStructEnd();
-    return xfer;
-}
-
-void swap(file_meta &a, file_meta &b)
-{
-    using ::std::swap;
-    swap(a.name, b.name);
-    swap(a.size, b.size);
-    swap(a.md5, b.md5);
-    swap(a.__isset, b.__isset);
-}
-
-file_meta::file_meta(const file_meta &other473)
-{
-    name = other473.name;
-    size = other473.size;
-    md5 = other473.md5;
-    __isset = other473.__isset;
-}
-file_meta::file_meta(file_meta &&other474)
-{
-    name = std::move(other474.name);
-    size = std::move(other474.size);
-    md5 = std::move(other474.md5);
-    __isset = std::move(other474.__isset);
-}
-file_meta &file_meta::operator=(const file_meta &other475)
-{
-    name = other475.name;
-    size = other475.size;
-    md5 = other475.md5;
-    __isset = other475.__isset;
-    return *this;
-}
-file_meta &file_meta::operator=(file_meta &&other476)
-{
-    name = std::move(other476.name);
-    size = std::move(other476.size);
-    md5 = std::move(other476.md5);
-    __isset = std::move(other476.__isset);
-    return *this;
-}
-void file_meta::printTo(std::ostream &out) const
-{
-    using ::apache::thrift::to_string;
-    out << "file_meta(";
-    out << "name=" << to_string(name);
-    out << ", "
-        << "size=" << to_string(size);
-    out << ", "
-        << "md5=" << to_string(md5);
-    out << ")";
-}
-
 configuration_update_app_env_request::~configuration_update_app_env_request() throw() {}
 
 void configuration_update_app_env_request::__set_app_name(const std::string &val)
@@ -12449,7 +12701,7 @@ uint32_t duplication_entry::read(::apache::thrift::protocol::TProtocol *iprot)
                     for (_i521 = 0; _i521 < _size517; ++_i521) {
                         int32_t _key522;
                         xfer += iprot->readI32(_key522);
-                        int64_t &_val523 = this->progress[_key522];
+                        int64_t &_val523 = this->progress[std::move(_key522)];
                         xfer += iprot->readI64(_val523);
                     }
                     xfer += iprot->readMapEnd();
@@ -13031,7 +13283,7 @@ uint32_t duplication_sync_request::read(::apache::thrift::protocol::TProtocol *i
                         ::dsn::gpid _key553;
                         xfer += _key553.read(iprot);
                         std::vector<duplication_confirm_entry> &_val554 =
-                            this->confirm_list[_key553];
+                            this->confirm_list[std::move(_key553)];
                         {
                             _val554.clear();
                             uint32_t _size555;
@@ -13197,7 +13449,8 @@ uint32_t duplication_sync_response::read(::apache::thrift::protocol::TProtocol *
                     for (_i570 = 0; _i570 < _size566; ++_i570) {
                         int32_t _key571;
                         xfer += iprot->readI32(_key571);
-                        std::map<int32_t, duplication_entry> &_val572 = this->dup_map[_key571];
+                        std::map<int32_t, duplication_entry> &_val572 =
+                            this->dup_map[std::move(_key571)];
                         {
                             _val572.clear();
                             uint32_t _size573;
@@ -13208,7 +13461,7 @@ uint32_t duplication_sync_response::read(::apache::thrift::protocol::TProtocol *
                             for (_i577 = 0; _i577 < _size573; ++_i577) {
                                 int32_t _key578;
                                 xfer += iprot->readI32(_key578);
-                                duplication_entry &_val579 = _val572[_key578];
+                                duplication_entry &_val579 = _val572[std::move(_key578)];
                                 xfer += _val579.read(iprot);
                             }
                             xfer += iprot->readMapEnd();
@@ -15773,7 +16026,8 @@ uint32_t bulk_load_response::read(::apache::thrift::protocol::TProtocol *iprot)
                     for (_i671 = 0; _i671 < _size667; ++_i671) {
                         ::dsn::rpc_address _key672;
                         xfer += _key672.read(iprot);
-                        partition_bulk_load_state &_val673 = this->group_bulk_load_state[_key672];
+                        partition_bulk_load_state &_val673 =
+                            this->group_bulk_load_state[std::move(_key672)];
                         xfer += _val673.read(iprot);
                     }
                     xfer += iprot->readMapEnd();
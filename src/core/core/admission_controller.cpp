@@ -34,9 +34,63 @@
  */
 
 #include <dsn/tool-api/admission_controller.h>
+#include <dsn/tool-api/task.h>
+#include <dsn/utility/string_conv.h>
+#include <dsn/utility/time_utils.h>
+
+#include "core/task/task_engine.h"
 
 namespace dsn {
 
+codel_admission_controller::codel_admission_controller(task_queue *q,
+                                                       std::vector<std::string> &sargs)
+    : admission_controller(q, sargs),
+      _target_ns(5 * 1000000ULL),
+      _interval_ns(100 * 1000000ULL),
+      _last_below_target_ns(utils::get_current_physical_time_ns())
+{
+    uint64_t target_ms = 5, interval_ms = 100;
+    if (sargs.size() > 0) {
+        dassert(buf2uint64(sargs[0], target_ms) && target_ms > 0,
+                "invalid target_ms '%s' for codel_admission_controller",
+                sargs[0].c_str());
+    }
+    if (sargs.size() > 1) {
+        dassert(buf2uint64(sargs[1], interval_ms) && interval_ms >= target_ms,
+                "invalid interval_ms '%s' for codel_admission_controller",
+                sargs[1].c_str());
+    }
+    _target_ns = target_ms * 1000000ULL;
+    _interval_ns = interval_ms * 1000000ULL;
+
+    _shed_count.init_global_counter(q->pool()->node()->full_name(),
+                                    "engine",
+                                    (q->get_name() + ".codel.shed.count").c_str(),
+                                    COUNTER_TYPE_VOLATILE_NUMBER,
+                                    "the count of requests rejected by the codel admission "
+                                    "controller for the queue delay");
+}
+
+bool codel_admission_controller::is_dequeued_task_accepted(task *task,
+                                                           uint64_t sojourn_ns,
+                                                           uint64_t now_ns)
+{
+    if (sojourn_ns < _target_ns) {
+        _last_below_target_ns.store(now_ns, std::memory_order_relaxed);
+        return true;
+    }
+
+    const task_spec &spec = task->spec();
+    if (spec.type != TASK_TYPE_RPC_REQUEST || !spec.rpc_request_for_storage) {
+        return true;
+    }
+    if (sojourn_ns <= (is_overloaded(now_ns) ? _target_ns : _interval_ns)) {
+        return true;
+    }
+    _shed_count->increment();
+    return false;
+}
+
 //
 ////-------------------------- BoundedQueueAdmissionController
 ///--------------------------------------------------
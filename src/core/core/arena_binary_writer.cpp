@@ -0,0 +1,23 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/arena_binary_writer.h>
+#include <dsn/utility/transient_memory.h>
+
+namespace dsn {
+
+arena_binary_writer::arena_binary_writer(int header_size, int chunk_size)
+    : binary_writer(chunk_size), _header_size(header_size)
+{
+    if (_header_size > 0) {
+        write_empty(_header_size);
+    }
+}
+
+void arena_binary_writer::create_new_buffer(size_t size, /*out*/ blob &bb)
+{
+    bb = tls_trans_mem_alloc_blob(size);
+}
+
+} // namespace dsn
@@ -0,0 +1,121 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/biased_ref_counter.h>
+
+#include <mutex>
+#include <vector>
+
+namespace dsn {
+
+// the objects queued to an owner thread to be merged, which is never freed as the objects
+// biased to the thread may outlive it
+struct biased_ref_owner
+{
+    std::mutex lock;
+    std::vector<biased_ref_counter *> queued;
+    std::atomic<bool> has_queued{false};
+    // the objects queued after the owner exits are merged by the threads queuing them
+    bool exited{false};
+};
+
+__thread biased_ref_owner *tls_biased_ref_owner = nullptr;
+
+namespace {
+struct biased_ref_owner_exit_guard
+{
+    ~biased_ref_owner_exit_guard()
+    {
+        {
+            std::lock_guard<std::mutex> l(tls_biased_ref_owner->lock);
+            tls_biased_ref_owner->exited = true;
+        }
+        biased_ref_counter::merge_queued();
+    }
+};
+} // anonymous namespace
+
+biased_ref_counter::biased_ref_counter()
+    : _owner(tls_biased_ref_owner),
+      _merged(_owner == nullptr),
+      _shared(_merged ? kMerged : 0)
+{
+}
+
+/*static*/ void biased_ref_counter::enable_biasing()
+{
+    if (tls_biased_ref_owner != nullptr) {
+        return;
+    }
+    tls_biased_ref_owner = new biased_ref_owner();
+    static thread_local biased_ref_owner_exit_guard guard;
+    (void)guard;
+}
+
+/*static*/ void biased_ref_counter::merge_queued()
+{
+    biased_ref_owner *owner = tls_biased_ref_owner;
+    if (owner == nullptr || !owner->has_queued.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    std::vector<biased_ref_counter *> queued;
+    {
+        std::lock_guard<std::mutex> l(owner->lock);
+        queued.swap(owner->queued);
+        owner->has_queued.store(false, std::memory_order_relaxed);
+    }
+    for (biased_ref_counter *obj : queued) {
+        obj->merge(true);
+    }
+}
+
+void biased_ref_counter::merge(bool dequeued)
+{
+    long delta = dequeued ? -kQueued : 0;
+    if (!_merged) {
+        delta += _biased_count.load(std::memory_order_relaxed) * kOneRef + kMerged;
+        _biased_count.store(0, std::memory_order_relaxed);
+        _merged = true;
+    }
+
+    // like ref_counter::release_ref, the accesses through the dropped references on the other
+    // threads must happen before the deletion
+    long shared = _shared.fetch_add(delta, std::memory_order_acq_rel) + delta;
+    if (count_of(shared) == 0 && (shared & kQueued) == 0) {
+        delete this;
+    }
+}
+
+void biased_ref_counter::release_shared_ref()
+{
+    long shared = _shared.load(std::memory_order_relaxed);
+    long next;
+    do {
+        next = shared - kOneRef;
+        // the references taken on the owner thread may be dropped on the others, after which
+        // the owner may never drop all its references to merge. So it's asked to merge once
+        // the atomic count is not positive before it merges.
+        if ((shared & (kMerged | kQueued)) == 0 && count_of(next) <= 0) {
+            next |= kQueued;
+        }
+    } while (!_shared.compare_exchange_weak(
+        shared, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    if ((next & kQueued) != 0 && (shared & kQueued) == 0) {
+        std::unique_lock<std::mutex> l(_owner->lock);
+        if (!_owner->exited) {
+            _owner->queued.push_back(this);
+            _owner->has_queued.store(true, std::memory_order_release);
+            return;
+        }
+        l.unlock();
+        // the exited owner won't take or drop any reference, so it's merged here
+        merge(true);
+    } else if ((next & kMerged) != 0 && (next & kQueued) == 0 && count_of(next) == 0) {
+        delete this;
+    }
+}
+
+} // namespace dsn
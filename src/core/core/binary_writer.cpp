@@ -37,6 +37,21 @@ void binary_writer::create_buffer(size_t size)
 
     blob bb;
     create_new_buffer(size, bb);
+
+    // the new buffer follows the last one in the same memory, e.g. both are allocated from
+    // the transient memory, so they are merged to keep the data contiguous
+    if (!_buffers.empty()) {
+        blob &last = *_buffers.rbegin();
+        if (last._holder != nullptr && last._holder == bb._holder &&
+            last._data + last._length == bb._data) {
+            _current_buffer = (char *)last.data();
+            _current_offset = static_cast<int>(last._length);
+            last._length += bb._length;
+            _current_buffer_length = static_cast<int>(last._length);
+            return;
+        }
+    }
+
     _buffers.push_back(bb);
 
     _current_buffer = (char *)bb.data();
@@ -148,6 +163,28 @@ void binary_writer::write(const char *buffer, int sz)
     }
 }
 
+void binary_writer::write_shared(const blob &val)
+{
+    if (val.length() == 0) {
+        return;
+    }
+    if (val.buffer_ptr() == nullptr) {
+        write(val.data(), val.length());
+        return;
+    }
+
+    if (_current_offset > 0) {
+        commit();
+    } else if (_current_buffer_length > 0) {
+        // the current buffer is not used yet
+        *_buffers.rbegin() = _buffers.rbegin()->range(0, 0);
+        _current_buffer_length = 0;
+    }
+    _buffers.push_back(val);
+    _current_buffer = nullptr;
+    _total_size += val.length();
+}
+
 bool binary_writer::next(void **data, int *size)
 {
     int rem_size = _current_buffer_length - _current_offset;
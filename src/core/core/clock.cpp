@@ -5,20 +5,116 @@
 #include <dsn/utility/clock.h>
 #include <dsn/utility/time_utils.h>
 #include <dsn/utility/dlib.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/smart_pointers.h>
+#include <dsn/c/api_utilities.h>
+
+#include <thread>
+
+#include "tsc_clock.h"
 
 DSN_API uint64_t dsn_now_ns() { return dsn::utils::clock::instance()->now_ns(); }
 
+DSN_API uint64_t dsn_now_coarse_ms() { return dsn::utils::clock::coarse_now_ms(); }
+
 namespace dsn {
 namespace utils {
 
+DSN_DEFINE_bool("core",
+                tsc_clock_enabled,
+                false,
+                "read the time from the tsc of cpu rather than clock_gettime, if the tsc is "
+                "invariant; not used by the simulator");
+DSN_DEFINE_uint32("core",
+                  coarse_clock_interval_ms,
+                  1,
+                  "interval to update the cached time returned by dsn_now_coarse_ms(), 0 means "
+                  "no cache");
+DSN_DEFINE_uint32("core",
+                  tsc_clock_calibrate_interval_ms,
+                  1000,
+                  "interval to calibrate the tsc clock against the system clock");
+
+namespace {
+
+bool s_tsc_used = false;
+std::atomic<uint64_t> s_coarse_ms{0};
+
+uint64_t fast_now_ns()
+{
+    return s_tsc_used ? tsc_clock::read_ns() : get_current_physical_time_ns();
+}
+
+void run_clock_ticker()
+{
+    uint64_t interval_ms = FLAGS_coarse_clock_interval_ms;
+    if (interval_ms == 0 || (s_tsc_used && interval_ms > FLAGS_tsc_clock_calibrate_interval_ms)) {
+        interval_ms = FLAGS_tsc_clock_calibrate_interval_ms;
+    }
+    uint64_t last_calibrate_ms = fast_now_ns() / 1000000;
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        uint64_t now_ms = fast_now_ns() / 1000000;
+        if (s_tsc_used && now_ms >= last_calibrate_ms + FLAGS_tsc_clock_calibrate_interval_ms) {
+            tsc_clock::calibrate();
+            last_calibrate_ms = now_ms;
+        }
+        if (FLAGS_coarse_clock_interval_ms > 0) {
+            s_coarse_ms.store(now_ms, std::memory_order_relaxed);
+        }
+    }
+}
+
+} // anonymous namespace
+
 std::unique_ptr<clock> clock::_clock = make_unique<clock>();
+std::atomic<bool> clock::_mocked{false};
 
 const clock *clock::instance() { return _clock.get(); }
 
 uint64_t clock::now_ns() const { return get_current_physical_time_ns(); }
 
-void clock::mock(clock *mock_clock) { _clock.reset(mock_clock); }
+/*static*/ uint64_t clock::coarse_now_ms()
+{
+    uint64_t ms = s_coarse_ms.load(std::memory_order_relaxed);
+    if (ms == 0 || _mocked.load(std::memory_order_relaxed)) {
+        return instance()->now_ns() / 1000000;
+    }
+    return ms;
+}
+
+/*static*/ void clock::start_fast_clocks()
+{
+    static bool started = false;
+    if (started || _mocked.load()) {
+        return;
+    }
+    started = true;
+
+    if (FLAGS_tsc_clock_enabled) {
+        if (tsc_clock::available()) {
+            tsc_clock::calibrate();
+            s_tsc_used = true;
+            _clock.reset(new tsc_clock());
+            ddebug("the tsc clock is used");
+        } else {
+            dwarn("the tsc of this machine is not invariant, use the system clock instead");
+        }
+    }
+    if (FLAGS_coarse_clock_interval_ms == 0 && !s_tsc_used) {
+        return;
+    }
+    if (FLAGS_coarse_clock_interval_ms > 0) {
+        s_coarse_ms.store(fast_now_ns() / 1000000);
+    }
+    std::thread(run_clock_ticker).detach();
+}
+
+void clock::mock(clock *mock_clock)
+{
+    _mocked.store(true);
+    _clock.reset(mock_clock);
+}
 
 } // namespace utils
 } // namespace dsn
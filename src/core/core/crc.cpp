@@ -1,6 +1,18 @@
 #include <cstdio>
+#include <cstring>
 #include <dsn/utility/crc.h>
 
+#include "crc_impl.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
 namespace dsn {
 namespace utils {
 
@@ -418,9 +430,350 @@ uint64_t crc64::_crc_table[sizeof(crc64::_crc_table) / sizeof(crc64::_crc_table[
 
 namespace dsn {
 namespace utils {
+namespace crc_impl {
+
+//
+// Returns (x ** n) mod POLY, where n is in bits rather than bytes
+//
+template <typename crc_t>
+static typename crc_t::uint x_pow_n_bits(uint64_t n)
+{
+    typename crc_t::uint r = crc_t::MSB;       // r = 1
+    typename crc_t::uint x = crc_t::MSB >> 1; // x = x ** 1
+    for (; n != 0; n >>= 1) {
+        if (n & 1)
+            r = crc_t::MulPoly(r, x);
+        x = crc_t::MulPoly(x, x);
+    }
+    return r;
+}
+
+//
+// Table-based implementations, which work on all platforms.
+//
+static uint32_t crc32_table(const void *ptr, size_t size, uint32_t init_crc)
+{
+    return crc32::compute(ptr, size, init_crc);
+}
+
+static uint64_t crc64_table(const void *ptr, size_t size, uint64_t init_crc)
+{
+    return crc64::compute(ptr, size, init_crc);
+}
+
+//
+// Both crc32 and crc64 are computed in 3 independent lanes for large buffers, so that the
+// latency of the crc instructions can be hidden. The lanes are combined by
+//      crc(ABC) = crc(A) * x**(2L) + crc(B) * x**L + crc(C)
+// where L is the lane length in bits.
+//
+static const size_t LONG_LANE_BYTES = 1024;
+static const size_t SHORT_LANE_BYTES = 128;
+
+//
+// Multiplication by a constant mod POLY, which is linear, so it's done byte by byte with
+// tables when carry-less multiplication is not available.
+//
+struct crc32_shift
+{
+    uint32_t k;
+    uint32_t table[4][256];
+
+    void init(uint32_t constant)
+    {
+        k = constant;
+        for (int i = 0; i < 4; ++i) {
+            for (uint32_t b = 0; b < 256; ++b) {
+                table[i][b] = crc32::MulPoly(b << (8 * i), constant);
+            }
+        }
+    }
+
+    uint32_t multiply(uint32_t a) const
+    {
+        return table[0][a & 0xff] ^ table[1][(a >> 8) & 0xff] ^ table[2][(a >> 16) & 0xff] ^
+               table[3][a >> 24];
+    }
+};
+
+static crc32_shift crc32_long_lane_shift;  // x**(8*LONG_LANE_BYTES) mod POLY
+static crc32_shift crc32_short_lane_shift; // x**(8*SHORT_LANE_BYTES) mod POLY
+
+static void init_crc32_lane_shift()
+{
+    crc32_long_lane_shift.init(crc32::ComputeX_N(LONG_LANE_BYTES));
+    crc32_short_lane_shift.init(crc32::ComputeX_N(SHORT_LANE_BYTES));
+}
+
+#if defined(__x86_64__)
+
+//
+// SSE4.2 provides the crc32 instruction for the crc32c polynomial, which is just the one used
+// by crc32_calc.
+//
+__attribute__((target("sse4.2"))) static uint32_t
+crc32_sse42_bytes(const uint8_t *p, size_t size, uint32_t crc)
+{
+    for (; size > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0; --size, ++p)
+        crc = _mm_crc32_u8(crc, *p);
+
+    uint64_t crc64 = crc;
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        crc64 = _mm_crc32_u64(crc64, v);
+    }
+    crc = static_cast<uint32_t>(crc64);
+
+    for (; size > 0; --size, ++p)
+        crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+
+// (a * b) mod POLY with carry-less multiplication, and reduced by the crc32 instruction
+__attribute__((target("sse4.2,pclmul"))) static uint32_t crc32_pclmul_multiply(uint32_t a,
+                                                                               uint32_t b)
+{
+    __m128i r = _mm_clmulepi64_si128(_mm_cvtsi32_si128(a), _mm_cvtsi32_si128(b), 0x00);
+    uint64_t v = static_cast<uint64_t>(_mm_cvtsi128_si64(r)) << 1;
+    return _mm_crc32_u32(0, static_cast<uint32_t>(v)) ^ static_cast<uint32_t>(v >> 32);
+}
+
+template <size_t lane_bytes, bool use_pclmul>
+__attribute__((target("sse4.2,pclmul"))) static uint32_t
+crc32_sse42_lanes(const uint8_t *&p, size_t &size, uint32_t crc, const crc32_shift &lane_shift)
+{
+    while (size >= 3 * lane_bytes) {
+        uint64_t c0 = crc, c1 = 0, c2 = 0;
+        for (size_t i = 0; i < lane_bytes; i += 8) {
+            uint64_t v0, v1, v2;
+            memcpy(&v0, p + i, sizeof(v0));
+            memcpy(&v1, p + lane_bytes + i, sizeof(v1));
+            memcpy(&v2, p + 2 * lane_bytes + i, sizeof(v2));
+            c0 = _mm_crc32_u64(c0, v0);
+            c1 = _mm_crc32_u64(c1, v1);
+            c2 = _mm_crc32_u64(c2, v2);
+        }
+
+        uint32_t a = static_cast<uint32_t>(c0);
+        if (use_pclmul) {
+            a = crc32_pclmul_multiply(a, lane_shift.k) ^ static_cast<uint32_t>(c1);
+            crc = crc32_pclmul_multiply(a, lane_shift.k) ^ static_cast<uint32_t>(c2);
+        } else {
+            a = lane_shift.multiply(a) ^ static_cast<uint32_t>(c1);
+            crc = lane_shift.multiply(a) ^ static_cast<uint32_t>(c2);
+        }
+
+        p += 3 * lane_bytes;
+        size -= 3 * lane_bytes;
+    }
+    return crc;
+}
+
+template <bool use_pclmul>
+__attribute__((target("sse4.2,pclmul"))) static uint32_t
+crc32_sse42(const void *ptr, size_t size, uint32_t init_crc)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(ptr);
+    uint32_t crc = ~init_crc;
+
+    if (size >= 3 * SHORT_LANE_BYTES) {
+        crc = crc32_sse42_lanes<LONG_LANE_BYTES, use_pclmul>(p, size, crc, crc32_long_lane_shift);
+        crc = crc32_sse42_lanes<SHORT_LANE_BYTES, use_pclmul>(
+            p, size, crc, crc32_short_lane_shift);
+    }
+
+    return ~crc32_sse42_bytes(p, size, crc);
+}
+
+//
+// crc64 is computed by folding the input with carry-less multiplication. The 128 bits
+// folding state V (bit i is the coefficient of x**(127-i)) is kept so that
+//      V * x**64 mod POLY == the crc of the data consumed so far
+// and V is folded forward by D bits by
+//      V * x**D = H * x**(D+64) + L * x**D
+// where H and L are the lower and higher 64 bits of V. As the product of pclmulqdq is one
+// bit shorter, the fold constants are x**(D+63) mod POLY and x**(D-1) mod POLY.
+//
+struct crc64_fold_constants
+{
+    uint64_t h; // x**(D+63) mod POLY
+    uint64_t l; // x**(D-1) mod POLY
+};
+
+static crc64_fold_constants crc64_fold_by_16;
+static crc64_fold_constants crc64_fold_by_32;
+static crc64_fold_constants crc64_fold_by_48;
+static crc64_fold_constants crc64_fold_by_64;
+
+static crc64_fold_constants make_crc64_fold_constants(uint64_t distance_bytes)
+{
+    crc64_fold_constants c;
+    c.h = x_pow_n_bits<crc64>(distance_bytes * 8 + 63);
+    c.l = x_pow_n_bits<crc64>(distance_bytes * 8 - 1);
+    return c;
+}
+
+static void init_crc64_fold_constants()
+{
+    crc64_fold_by_16 = make_crc64_fold_constants(16);
+    crc64_fold_by_32 = make_crc64_fold_constants(32);
+    crc64_fold_by_48 = make_crc64_fold_constants(48);
+    crc64_fold_by_64 = make_crc64_fold_constants(64);
+}
+
+__attribute__((target("sse4.2,pclmul"))) static inline __m128i
+crc64_fold(__m128i v, const crc64_fold_constants &c)
+{
+    __m128i k = _mm_set_epi64x(static_cast<long long>(c.l), static_cast<long long>(c.h));
+    return _mm_xor_si128(_mm_clmulepi64_si128(v, k, 0x00), _mm_clmulepi64_si128(v, k, 0x11));
+}
+
+__attribute__((target("sse4.2,pclmul"))) static uint64_t
+crc64_pclmul(const void *ptr, size_t size, uint64_t init_crc)
+{
+    if (size < 64) {
+        return crc64::compute(ptr, size, init_crc);
+    }
+
+    const uint8_t *p = static_cast<const uint8_t *>(ptr);
+    const __m128i *in = reinterpret_cast<const __m128i *>(p);
+
+    // the initial crc is xor-ed into the first 8 bytes, just like the table-based approach
+    __m128i v0 = _mm_xor_si128(_mm_loadu_si128(in),
+                               _mm_cvtsi64_si128(static_cast<long long>(~init_crc)));
+    __m128i v1 = _mm_loadu_si128(in + 1);
+    __m128i v2 = _mm_loadu_si128(in + 2);
+    __m128i v3 = _mm_loadu_si128(in + 3);
+    in += 4;
+    size -= 64;
+
+    for (; size >= 64; size -= 64, in += 4) {
+        v0 = _mm_xor_si128(crc64_fold(v0, crc64_fold_by_64), _mm_loadu_si128(in));
+        v1 = _mm_xor_si128(crc64_fold(v1, crc64_fold_by_64), _mm_loadu_si128(in + 1));
+        v2 = _mm_xor_si128(crc64_fold(v2, crc64_fold_by_64), _mm_loadu_si128(in + 2));
+        v3 = _mm_xor_si128(crc64_fold(v3, crc64_fold_by_64), _mm_loadu_si128(in + 3));
+    }
+
+    __m128i v = _mm_xor_si128(_mm_xor_si128(crc64_fold(v0, crc64_fold_by_48),
+                                            crc64_fold(v1, crc64_fold_by_32)),
+                              _mm_xor_si128(crc64_fold(v2, crc64_fold_by_16), v3));
+    for (; size >= 16; size -= 16, ++in) {
+        v = _mm_xor_si128(crc64_fold(v, crc64_fold_by_16), _mm_loadu_si128(in));
+    }
+
+    // reduce V to 64 bits by the table, then go on with the tail bytes
+    uint8_t folded[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(folded), v);
+    uint64_t crc = crc64::compute(folded, sizeof(folded), ~0ULL);
+    return crc64::compute(in, size, crc);
+}
+
+#elif defined(__aarch64__)
+
+//
+// ARMv8 provides crc32c instructions as an optional extension.
+//
+__attribute__((target("+crc"))) static uint32_t
+crc32_armv8_bytes(const uint8_t *p, size_t size, uint32_t crc)
+{
+    for (; size > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0; --size, ++p)
+        crc = __crc32cb(crc, *p);
+
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        crc = __crc32cd(crc, v);
+    }
+
+    for (; size > 0; --size, ++p)
+        crc = __crc32cb(crc, *p);
+    return crc;
+}
+
+template <size_t lane_bytes>
+__attribute__((target("+crc"))) static uint32_t
+crc32_armv8_lanes(const uint8_t *&p, size_t &size, uint32_t crc, const crc32_shift &lane_shift)
+{
+    while (size >= 3 * lane_bytes) {
+        uint32_t c0 = crc, c1 = 0, c2 = 0;
+        for (size_t i = 0; i < lane_bytes; i += 8) {
+            uint64_t v0, v1, v2;
+            memcpy(&v0, p + i, sizeof(v0));
+            memcpy(&v1, p + lane_bytes + i, sizeof(v1));
+            memcpy(&v2, p + 2 * lane_bytes + i, sizeof(v2));
+            c0 = __crc32cd(c0, v0);
+            c1 = __crc32cd(c1, v1);
+            c2 = __crc32cd(c2, v2);
+        }
+
+        uint32_t a = lane_shift.multiply(c0) ^ c1;
+        crc = lane_shift.multiply(a) ^ c2;
+
+        p += 3 * lane_bytes;
+        size -= 3 * lane_bytes;
+    }
+    return crc;
+}
+
+__attribute__((target("+crc"))) static uint32_t
+crc32_armv8(const void *ptr, size_t size, uint32_t init_crc)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(ptr);
+    uint32_t crc = ~init_crc;
+
+    if (size >= 3 * SHORT_LANE_BYTES) {
+        crc = crc32_armv8_lanes<LONG_LANE_BYTES>(p, size, crc, crc32_long_lane_shift);
+        crc = crc32_armv8_lanes<SHORT_LANE_BYTES>(p, size, crc, crc32_short_lane_shift);
+    }
+
+    return ~crc32_armv8_bytes(p, size, crc);
+}
+
+#endif
+
+static std::vector<implementation> detect_implementations()
+{
+    init_crc32_lane_shift();
+
+    std::vector<implementation> impls;
+    impls.push_back({"table", crc32_table, crc64_table});
+
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        impls.push_back({"sse4.2", crc32_sse42<false>, crc64_table});
+        if (__builtin_cpu_supports("pclmul")) {
+            init_crc64_fold_constants();
+            impls.push_back({"sse4.2+pclmul", crc32_sse42<true>, crc64_pclmul});
+        }
+    }
+#elif defined(__aarch64__)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        impls.push_back({"armv8-crc", crc32_armv8, crc64_table});
+    }
+#endif
+
+    return impls;
+}
+
+const std::vector<implementation> &supported_implementations()
+{
+    static const std::vector<implementation> impls = detect_implementations();
+    return impls;
+}
+
+const implementation &current_implementation()
+{
+    static const implementation &impl = supported_implementations().back();
+    return impl;
+}
+
+} // namespace crc_impl
+
 uint32_t crc32_calc(const void *ptr, size_t size, uint32_t init_crc)
 {
-    return dsn::utils::crc32::compute(ptr, size, init_crc);
+    return crc_impl::current_implementation().crc32(ptr, size, init_crc);
 }
 
 uint32_t crc32_concat(uint32_t xy_init,
@@ -435,9 +788,14 @@ uint32_t crc32_concat(uint32_t xy_init,
         0, x_init, x_final, (uint64_t)x_size, y_init, y_final, (uint64_t)y_size);
 }
 
+uint32_t crc32_combine(uint32_t x_final, uint32_t y_final, size_t y_size)
+{
+    return dsn::utils::crc32::MulPoly(x_final, dsn::utils::crc32::ComputeX_N(y_size)) ^ y_final;
+}
+
 uint64_t crc64_calc(const void *ptr, size_t size, uint64_t init_crc)
 {
-    return dsn::utils::crc64::compute(ptr, size, init_crc);
+    return crc_impl::current_implementation().crc64(ptr, size, init_crc);
 }
 
 uint64_t crc64_concat(uint32_t xy_init,
@@ -451,5 +809,10 @@ uint64_t crc64_concat(uint32_t xy_init,
     return ::dsn::utils::crc64::concatenate(
         0, x_init, x_final, (uint64_t)x_size, y_init, y_final, (uint64_t)y_size);
 }
+
+uint64_t crc64_combine(uint64_t x_final, uint64_t y_final, size_t y_size)
+{
+    return dsn::utils::crc64::MulPoly(x_final, dsn::utils::crc64::ComputeX_N(y_size)) ^ y_final;
+}
 }
 }
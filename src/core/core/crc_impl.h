@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include <dsn/utility/crc.h>
+
+namespace dsn {
+namespace utils {
+namespace crc_impl {
+
+typedef uint32_t (*crc32_func)(const void *ptr, size_t size, uint32_t init_crc);
+typedef uint64_t (*crc64_func)(const void *ptr, size_t size, uint64_t init_crc);
+
+struct implementation
+{
+    const char *name;
+    crc32_func crc32;
+    crc64_func crc64;
+};
+
+// All the crc implementations supported by the current cpu, ordered from the slowest
+// to the fastest. The table-based one is always available as the first one.
+const std::vector<implementation> &supported_implementations();
+
+// The implementation used by crc32_calc and crc64_calc, which is the fastest one
+// in supported_implementations().
+const implementation &current_implementation();
+
+} // namespace crc_impl
+} // namespace utils
+} // namespace dsn
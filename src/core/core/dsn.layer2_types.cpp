@@ -340,6 +340,18 @@ void configuration_query_by_index_request::__set_partition_indices(const std::ve
     this->partition_indices = val;
 }
 
+void configuration_query_by_index_request::__set_known_version(const int64_t val)
+{
+    this->known_version = val;
+    __isset.known_version = true;
+}
+
+void configuration_query_by_index_request::__set_wait_ms(const int32_t val)
+{
+    this->wait_ms = val;
+    __isset.wait_ms = true;
+}
+
 uint32_t configuration_query_by_index_request::read(::apache::thrift::protocol::TProtocol *iprot)
 {
 
@@ -386,6 +398,22 @@ uint32_t configuration_query_by_index_request::read(::apache::thrift::protocol::
                 xfer += iprot->skip(ftype);
             }
             break;
+        case 3:
+            if (ftype == ::apache::thrift::protocol::T_I64) {
+                xfer += iprot->readI64(this->known_version);
+                this->__isset.known_version = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
+        case 4:
+            if (ftype == ::apache::thrift::protocol::T_I32) {
+                xfer += iprot->readI32(this->wait_ms);
+                this->__isset.wait_ms = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
         default:
             xfer += iprot->skip(ftype);
             break;
@@ -422,6 +450,17 @@ configuration_query_by_index_request::write(::apache::thrift::protocol::TProtoco
     }
     xfer += oprot->writeFieldEnd();
 
+    if (this->__isset.known_version) {
+        xfer += oprot->writeFieldBegin("known_version", ::apache::thrift::protocol::T_I64, 3);
+        xfer += oprot->writeI64(this->known_version);
+        xfer += oprot->writeFieldEnd();
+    }
+    if (this->__isset.wait_ms) {
+        xfer += oprot->writeFieldBegin("wait_ms", ::apache::thrift::protocol::T_I32, 4);
+        xfer += oprot->writeI32(this->wait_ms);
+        xfer += oprot->writeFieldEnd();
+    }
+
     xfer += oprot->writeFieldStop();
     xfer += oprot->writeStructEnd();
     return xfer;
@@ -432,6 +471,8 @@ void swap(configuration_query_by_index_request &a, configuration_query_by_index_
     using ::std::swap;
     swap(a.app_name, b.app_name);
     swap(a.partition_indices, b.partition_indices);
+    swap(a.known_version, b.known_version);
+    swap(a.wait_ms, b.wait_ms);
     swap(a.__isset, b.__isset);
 }
 
@@ -440,6 +481,8 @@ configuration_query_by_index_request::configuration_query_by_index_request(
 {
     app_name = other22.app_name;
     partition_indices = other22.partition_indices;
+    known_version = other22.known_version;
+    wait_ms = other22.wait_ms;
     __isset = other22.__isset;
 }
 configuration_query_by_index_request::configuration_query_by_index_request(
@@ -447,6 +490,8 @@ configuration_query_by_index_request::configuration_query_by_index_request(
 {
     app_name = std::move(other23.app_name);
     partition_indices = std::move(other23.partition_indices);
+    known_version = std::move(other23.known_version);
+    wait_ms = std::move(other23.wait_ms);
     __isset = std::move(other23.__isset);
 }
 configuration_query_by_index_request &configuration_query_by_index_request::
@@ -454,6 +499,8 @@ operator=(const configuration_query_by_index_request &other24)
 {
     app_name = other24.app_name;
     partition_indices = other24.partition_indices;
+    known_version = other24.known_version;
+    wait_ms = other24.wait_ms;
     __isset = other24.__isset;
     return *this;
 }
@@ -462,6 +509,8 @@ operator=(configuration_query_by_index_request &&other25)
 {
     app_name = std::move(other25.app_name);
     partition_indices = std::move(other25.partition_indices);
+    known_version = std::move(other25.known_version);
+    wait_ms = std::move(other25.wait_ms);
     __isset = std::move(other25.__isset);
     return *this;
 }
@@ -472,6 +521,12 @@ void configuration_query_by_index_request::printTo(std::ostream &out) const
     out << "app_name=" << to_string(app_name);
     out << ", "
         << "partition_indices=" << to_string(partition_indices);
+    out << ", "
+        << "known_version=";
+    (__isset.known_version ? (out << to_string(known_version)) : (out << "<null>"));
+    out << ", "
+        << "wait_ms=";
+    (__isset.wait_ms ? (out << to_string(wait_ms)) : (out << "<null>"));
     out << ")";
 }
 
@@ -500,6 +555,12 @@ void configuration_query_by_index_response::__set_partitions(
     this->partitions = val;
 }
 
+void configuration_query_by_index_response::__set_version(const int64_t val)
+{
+    this->version = val;
+    __isset.version = true;
+}
+
 uint32_t configuration_query_by_index_response::read(::apache::thrift::protocol::TProtocol *iprot)
 {
 
@@ -570,6 +631,14 @@ uint32_t configuration_query_by_index_response::read(::apache::thrift::protocol:
                 xfer += iprot->skip(ftype);
             }
             break;
+        case 6:
+            if (ftype == ::apache::thrift::protocol::T_I64) {
+                xfer += iprot->readI64(this->version);
+                this->__isset.version = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
         default:
             xfer += iprot->skip(ftype);
             break;
@@ -617,6 +686,12 @@ configuration_query_by_index_response::write(::apache::thrift::protocol::TProtoc
     }
     xfer += oprot->writeFieldEnd();
 
+    if (this->__isset.version) {
+        xfer += oprot->writeFieldBegin("version", ::apache::thrift::protocol::T_I64, 6);
+        xfer += oprot->writeI64(this->version);
+        xfer += oprot->writeFieldEnd();
+    }
+
     xfer += oprot->writeFieldStop();
     xfer += oprot->writeStructEnd();
     return xfer;
@@ -630,6 +705,7 @@ void swap(configuration_query_by_index_response &a, configuration_query_by_index
     swap(a.partition_count, b.partition_count);
     swap(a.is_stateful, b.is_stateful);
     swap(a.partitions, b.partitions);
+    swap(a.version, b.version);
     swap(a.__isset, b.__isset);
 }
 
@@ -641,6 +717,7 @@ configuration_query_by_index_response::configuration_query_by_index_response(
     partition_count = other32.partition_count;
     is_stateful = other32.is_stateful;
     partitions = other32.partitions;
+    version = other32.version;
     __isset = other32.__isset;
 }
 configuration_query_by_index_response::configuration_query_by_index_response(
@@ -651,6 +728,7 @@ configuration_query_by_index_response::configuration_query_by_index_response(
     partition_count = std::move(other33.partition_count);
     is_stateful = std::move(other33.is_stateful);
     partitions = std::move(other33.partitions);
+    version = std::move(other33.version);
     __isset = std::move(other33.__isset);
 }
 configuration_query_by_index_response &configuration_query_by_index_response::
@@ -661,6 +739,7 @@ operator=(const configuration_query_by_index_response &other34)
     partition_count = other34.partition_count;
     is_stateful = other34.is_stateful;
     partitions = other34.partitions;
+    version = other34.version;
     __isset = other34.__isset;
     return *this;
 }
@@ -672,6 +751,7 @@ operator=(configuration_query_by_index_response &&other35)
     partition_count = std::move(other35.partition_count);
     is_stateful = std::move(other35.is_stateful);
     partitions = std::move(other35.partitions);
+    version = std::move(other35.version);
     __isset = std::move(other35.__isset);
     return *this;
 }
@@ -688,6 +768,9 @@ void configuration_query_by_index_response::printTo(std::ostream &out) const
         << "is_stateful=" << to_string(is_stateful);
     out << ", "
         << "partitions=" << to_string(partitions);
+    out << ", "
+        << "version=";
+    (__isset.version ? (out << to_string(version)) : (out << "<null>"));
     out << ")";
 }
 
@@ -802,7 +885,7 @@ uint32_t app_info::read(::apache::thrift::protocol::TProtocol *iprot)
                     for (_i41 = 0; _i41 < _size37; ++_i41) {
                         std::string _key42;
                         xfer += iprot->readString(_key42);
-                        std::string &_val43 = this->envs[_key42];
+                        std::string &_val43 = this->envs[std::move(_key42)];
                         xfer += iprot->readString(_val43);
                     }
                     xfer += iprot->readMapEnd();
@@ -27,6 +27,24 @@ namespace dsn {
 namespace fail {
 
 static fail_point_registry REGISTRY;
+static std::atomic<bool> SETUP{false};
+
+/*extern*/ std::atomic<bool> _S_FAIL_POINT_ENABLED{false};
+
+static void update_enabled()
+{
+    _S_FAIL_POINT_ENABLED.store(SETUP.load() && REGISTRY.any_active());
+}
+
+/*extern*/ fail_point *get(string_view name) { return &REGISTRY.create_if_not_exists(name); }
+
+/*extern*/ const std::string *eval(fail_point *p)
+{
+    if (!p->active()) {
+        return nullptr;
+    }
+    return p->eval();
+}
 
 /*extern*/ const std::string *eval(string_view name)
 {
@@ -34,7 +52,7 @@ static fail_point_registry REGISTRY;
     if (!p) {
         return nullptr;
     }
-    return p->eval();
+    return eval(p);
 }
 
 inline const char *task_type_to_string(fail_point::task_type t)
@@ -62,16 +80,20 @@ inline const char *task_type_to_string(fail_point::task_type t)
            p.get_arg().data(),
            p.get_frequency(),
            p.get_max_count());
+    update_enabled();
 }
 
-/*static*/ bool _S_FAIL_POINT_ENABLED = false;
-
-/*extern*/ void setup() { _S_FAIL_POINT_ENABLED = true; }
+/*extern*/ void setup()
+{
+    SETUP.store(true);
+    update_enabled();
+}
 
 /*extern*/ void teardown()
 {
+    SETUP.store(false);
     REGISTRY.clear();
-    _S_FAIL_POINT_ENABLED = false;
+    update_enabled();
 }
 
 void fail_point::set_action(string_view action)
@@ -79,6 +101,7 @@ void fail_point::set_action(string_view action)
     if (!parse_from_string(action)) {
         dfatal("unrecognized command: %s", action.data());
     }
+    _active = true;
 }
 
 bool fail_point::parse_from_string(string_view action)
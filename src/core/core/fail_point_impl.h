@@ -40,6 +40,18 @@ struct fail_point
 
     const std::string *eval();
 
+    // whether an action is set, the fail points evaluated but never configured are inactive
+    bool active() const { return _active; }
+
+    void reset()
+    {
+        _task = Off;
+        _arg.clear();
+        _freq = 100;
+        _max_cnt = -1;
+        _active = false;
+    }
+
     explicit fail_point(string_view name) : _name(name) {}
 
     /// for test only
@@ -73,8 +85,11 @@ private:
     std::string _arg;
     int _freq{100};
     int _max_cnt{-1}; // TODO(wutao1): not thread-safe
+    bool _active{false};
 };
 
+// The fail points are never removed once created, so the pointers cached by the
+// FAIL_POINT_INJECT_F sites stay valid. The nodes of unordered_map aren't moved on rehash.
 struct fail_point_registry
 {
     fail_point &create_if_not_exists(string_view name)
@@ -85,6 +100,17 @@ struct fail_point_registry
         return it->second;
     }
 
+    bool any_active() const
+    {
+        std::lock_guard<std::mutex> guard(_mu);
+        for (const auto &kv : _registry) {
+            if (kv.second.active()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     fail_point *try_get(string_view name)
     {
         std::lock_guard<std::mutex> guard(_mu);
@@ -99,7 +125,9 @@ struct fail_point_registry
     void clear()
     {
         std::lock_guard<std::mutex> guard(_mu);
-        _registry.clear();
+        for (auto &kv : _registry) {
+            kv.second.reset();
+        }
     }
 
 private:
@@ -33,7 +33,11 @@
  *     xxxx-xx-xx, author, fix bug about xxx
  */
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <memory>
+#include <thread>
 
 #include <dsn/c/api_utilities.h>
 #include <dsn/dist/fmt_logging.h>
@@ -43,7 +47,9 @@
 
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <boost/filesystem.hpp>
 #include <openssl/md5.h>
 
@@ -532,6 +538,23 @@ bool create_file(const std::string &path)
     return true;
 }
 
+bool preallocate_file(const std::string &path, int64_t size)
+{
+    int fd = ::open(path.c_str(), O_WRONLY);
+    if (fd < 0) {
+        dwarn("preallocate_file %s failed, err = %s", path.c_str(), safe_strerror(errno).c_str());
+        return false;
+    }
+
+    // posix_fallocate returns the error rather than setting errno
+    int err = ::posix_fallocate(fd, 0, size);
+    if (err != 0) {
+        dwarn_f("preallocate_file {} to {} bytes failed, err = {}", path, size, safe_strerror(err));
+    }
+    ::close(fd);
+    return err == 0;
+}
+
 bool get_absolute_path(const std::string &path1, std::string &path2)
 {
     bool succ;
@@ -701,6 +724,17 @@ bool link_file(const std::string &src, const std::string &target)
     return (err == 0);
 }
 
+bool copy_file(const std::string &src, const std::string &target)
+{
+    if (src.empty() || target.empty())
+        return false;
+    if (!file_exists(src) || file_exists(target))
+        return false;
+    boost::system::error_code ec;
+    boost::filesystem::copy_file(src, target, ec);
+    return !ec;
+}
+
 error_code md5sum(const std::string &file_path, /*out*/ std::string &result)
 {
     result.clear();
@@ -710,38 +744,38 @@ error_code md5sum(const std::string &file_path, /*out*/ std::string &result)
         return ERR_OBJECT_NOT_FOUND;
     }
 
-    FILE *fp = fopen(file_path.c_str(), "rb");
-    if (fp == nullptr) {
+    int fd = ::open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
         derror("md5sum error: open file %s failed", file_path.c_str());
         return ERR_FILE_OPERATION_FAILED;
     }
+    // the file is read once from the beginning to the end
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
-    char buf[4096];
+    // the larger buffer saves the syscalls on large files such as the checkpoint files
+    static const size_t MD5_BUFFER_SIZE = 1 << 20;
+    std::unique_ptr<char[]> buf(new char[MD5_BUFFER_SIZE]);
     unsigned char out[MD5_DIGEST_LENGTH];
     MD5_CTX c;
     MD5_Init(&c);
     while (true) {
-        size_t ret_code = fread(buf, sizeof(char), 4096, fp);
-        if (ret_code == 4096) {
-            MD5_Update(&c, buf, 4096);
-        } else {
-            if (feof(fp)) {
-                if (ret_code > 0)
-                    MD5_Update(&c, buf, ret_code);
-                break;
-            } else {
-                int err = ferror(fp);
-                derror("md5sum error: read file %s failed: errno = %d (%s)",
-                       file_path.c_str(),
-                       err,
-                       safe_strerror(err).c_str());
-                fclose(fp);
-                MD5_Final(out, &c);
-                return ERR_FILE_OPERATION_FAILED;
-            }
+        ssize_t ret_code = ::read(fd, buf.get(), MD5_BUFFER_SIZE);
+        if (ret_code > 0) {
+            MD5_Update(&c, buf.get(), ret_code);
+        } else if (ret_code == 0) {
+            break;
+        } else if (errno != EINTR) {
+            int err = errno;
+            derror("md5sum error: read file %s failed: errno = %d (%s)",
+                   file_path.c_str(),
+                   err,
+                   safe_strerror(err).c_str());
+            ::close(fd);
+            MD5_Final(out, &c);
+            return ERR_FILE_OPERATION_FAILED;
         }
     }
-    fclose(fp);
+    ::close(fd);
     MD5_Final(out, &c);
 
     char str[MD5_DIGEST_LENGTH * 2 + 1];
@@ -809,16 +843,22 @@ bool verify_file(const std::string &fname,
         derror_f("verify file({}) failed, becaused failed to get file size", fname);
         return false;
     }
+    // the size is checked first to save the md5 of the damaged file
+    if (f_size != expected_fsize) {
+        derror_f("verify file({}) failed, because file damaged, size: {} VS {}",
+                 fname,
+                 f_size,
+                 expected_fsize);
+        return false;
+    }
     std::string md5;
     if (md5sum(fname, md5) != ERR_OK) {
         derror_f("verify file({}) failed, becaused failed to get file md5", fname);
         return false;
     }
-    if (f_size != expected_fsize || md5 != expected_md5) {
-        derror_f("verify file({}) failed, because file damaged, size: {} VS {}, md5: {} VS {}",
+    if (md5 != expected_md5) {
+        derror_f("verify file({}) failed, because file damaged, md5: {} VS {}",
                  fname,
-                 f_size,
-                 expected_fsize,
                  md5,
                  expected_md5);
         return false;
@@ -826,6 +866,33 @@ bool verify_file(const std::string &fname,
     return true;
 }
 
+bool verify_files(const std::vector<file_to_verify> &files,
+                  int max_threads,
+                  /*out*/ std::vector<bool> &results)
+{
+    // std::vector<bool> can't be written by multiple threads
+    std::vector<char> verified(files.size(), 0);
+    std::atomic<size_t> next(0);
+    auto verify = [&files, &verified, &next]() {
+        for (size_t i = next++; i < files.size(); i = next++) {
+            verified[i] = verify_file(files[i].fname, files[i].md5, files[i].size) ? 1 : 0;
+        }
+    };
+
+    int thread_count = std::min(std::max(max_threads, 1), static_cast<int>(files.size()));
+    std::vector<std::thread> threads;
+    for (int i = 1; i < thread_count; ++i) {
+        threads.emplace_back(verify);
+    }
+    verify();
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    results.assign(verified.begin(), verified.end());
+    return std::all_of(results.begin(), results.end(), [](bool ok) { return ok; });
+}
+
 } // namespace filesystem
 } // namespace utils
 } // namespace dsn
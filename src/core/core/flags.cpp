@@ -5,10 +5,16 @@
 #include <dsn/utility/flags.h>
 #include <dsn/utility/config_api.h>
 #include <dsn/utility/singleton.h>
+#include <dsn/utility/string_conv.h>
 #include <dsn/c/api_utilities.h>
+#include <dsn/tool-api/command_manager.h>
 #include <boost/optional/optional.hpp>
+#include <fmt/format.h>
 
 #include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
 
 namespace dsn {
 
@@ -24,7 +30,7 @@ enum value_type
     FV_MAX_INDEX = 6,
 };
 
-using validator_fn = std::function<void()>;
+using validator_fn = std::function<bool()>;
 
 class flag_data
 {
@@ -33,7 +39,7 @@ public:
     case type_enum:                                                                                \
         value<type>() = dsn_config_get_value_##suffix(_section, _name, value<type>(), _desc);      \
         if (_validator) {                                                                          \
-            _validator();                                                                          \
+            dassert(_validator(), "validation failed: %s", _name);                                 \
         }                                                                                          \
         break
 
@@ -55,9 +61,81 @@ public:
     {
     }
 
+#define FLAG_DATA_UPDATE_CASE(type, type_enum, suffix)                                             \
+    case type_enum: {                                                                              \
+        type tmp;                                                                                  \
+        if (!buf2##suffix(val, tmp)) {                                                             \
+            return error_s::make(ERR_INVALID_PARAMETERS, fmt::format("{} is invalid", val));       \
+        }                                                                                          \
+        type old = load_value<type>();                                                             \
+        store_value(tmp);                                                                          \
+        if (_validator && !_validator()) {                                                         \
+            store_value(old);                                                                      \
+            return error_s::make(ERR_INVALID_PARAMETERS, "value validation failed");               \
+        }                                                                                          \
+    } break
+
+    error_s update(const std::string &val)
+    {
+        if (!has_tag(flag_tag::FT_MUTABLE)) {
+            return error_s::make(ERR_OPERATION_DISABLED, fmt::format("{} is not mutable", _name));
+        }
+        switch (_type) {
+            FLAG_DATA_UPDATE_CASE(int32_t, FV_INT32, int32);
+            FLAG_DATA_UPDATE_CASE(int64_t, FV_INT64, int64);
+            FLAG_DATA_UPDATE_CASE(uint32_t, FV_UINT32, uint32);
+            FLAG_DATA_UPDATE_CASE(uint64_t, FV_UINT64, uint64);
+            FLAG_DATA_UPDATE_CASE(bool, FV_BOOL, bool);
+            FLAG_DATA_UPDATE_CASE(double, FV_DOUBLE, double);
+        case FV_STRING:
+            return error_s::make(ERR_OPERATION_DISABLED, "string flags are not mutable");
+        }
+        return error_s::ok();
+    }
+
+    std::string to_string() const
+    {
+        std::ostringstream out;
+        switch (_type) {
+        case FV_INT32:
+            out << load_value<int32_t>();
+            break;
+        case FV_INT64:
+            out << load_value<int64_t>();
+            break;
+        case FV_UINT32:
+            out << load_value<uint32_t>();
+            break;
+        case FV_UINT64:
+            out << load_value<uint64_t>();
+            break;
+        case FV_BOOL:
+            out << (load_value<bool>() ? "true" : "false");
+            break;
+        case FV_DOUBLE:
+            out << load_value<double>();
+            break;
+        case FV_STRING:
+            out << load_value<const char *>();
+            break;
+        }
+        return out.str();
+    }
+
     void set_validator(validator_fn &validator) { _validator = std::move(validator); }
     const validator_fn &validator() const { return _validator; }
 
+    void add_tag(flag_tag tag)
+    {
+        dassert(tag != flag_tag::FT_MUTABLE || _type != FV_STRING,
+                "string flag \"%s\" can't be mutable",
+                _name);
+        _tags.insert(tag);
+    }
+    bool has_tag(flag_tag tag) const { return _tags.find(tag) != _tags.end(); }
+
+    const char *section() const { return _section; }
+
 private:
     template <typename T>
     T &value()
@@ -65,6 +143,21 @@ private:
         return *reinterpret_cast<T *>(_val);
     }
 
+    // the values are updated at runtime while being read by other threads without lock
+    template <typename T>
+    T load_value() const
+    {
+        T v;
+        __atomic_load(reinterpret_cast<T *>(_val), &v, __ATOMIC_RELAXED);
+        return v;
+    }
+
+    template <typename T>
+    void store_value(T v)
+    {
+        __atomic_store(reinterpret_cast<T *>(_val), &v, __ATOMIC_RELAXED);
+    }
+
 private:
     const value_type _type;
     void *const _val;
@@ -72,6 +165,7 @@ private:
     const char *_name;
     const char *_desc;
     validator_fn _validator;
+    std::set<flag_tag> _tags;
 };
 
 class flag_registry : public utils::singleton<flag_registry>
@@ -89,6 +183,13 @@ public:
         }
     }
 
+    void add_tag(const char *name, flag_tag tag)
+    {
+        auto it = _flags.find(name);
+        dassert(it != _flags.end(), "flag \"%s\" does not exist", name);
+        it->second.add_tag(tag);
+    }
+
     void load_from_config()
     {
         for (auto &kv : _flags) {
@@ -97,12 +198,78 @@ public:
         }
     }
 
+    // the flags are only added on static initialization, so they are looked up without lock
+    error_s update_flag(const std::string &name, const std::string &val)
+    {
+        auto it = _flags.find(name);
+        if (it == _flags.end()) {
+            return error_s::make(ERR_OBJECT_NOT_FOUND, fmt::format("{} is not found", name));
+        }
+        std::lock_guard<std::mutex> l(_update_lock);
+        return it->second.update(val);
+    }
+
+    error_with<std::string> get_flag_str(const std::string &name) const
+    {
+        auto it = _flags.find(name);
+        if (it == _flags.end()) {
+            return error_s::make(ERR_OBJECT_NOT_FOUND, fmt::format("{} is not found", name));
+        }
+        return it->second.to_string();
+    }
+
+    std::string list_flags() const
+    {
+        std::ostringstream out;
+        for (const auto &kv : _flags) {
+            out << "[" << kv.second.section() << "] " << kv.first << " = "
+                << kv.second.to_string()
+                << (kv.second.has_tag(flag_tag::FT_MUTABLE) ? " (mutable)" : "") << std::endl;
+        }
+        return out.str();
+    }
+
+    void register_commands()
+    {
+        static std::once_flag flag;
+        std::call_once(flag, [this]() {
+            command_manager::instance().register_command(
+                {"flags.list"},
+                "flags.list",
+                "flags.list - list all the flags and their values",
+                [this](const std::vector<std::string> &args) { return list_flags(); });
+            command_manager::instance().register_command(
+                {"flags.get"},
+                "flags.get <name>",
+                "flags.get - get the value of a flag",
+                [this](const std::vector<std::string> &args) {
+                    if (args.size() != 1) {
+                        return std::string(ERR_INVALID_PARAMETERS.to_string());
+                    }
+                    auto res = get_flag_str(args[0]);
+                    return res.is_ok() ? res.get_value() : res.get_error().description();
+                });
+            command_manager::instance().register_command(
+                {"flags.set"},
+                "flags.set <name> <value>",
+                "flags.set - update the value of a mutable flag",
+                [this](const std::vector<std::string> &args) {
+                    if (args.size() != 2) {
+                        return std::string(ERR_INVALID_PARAMETERS.to_string());
+                    }
+                    error_s err = update_flag(args[0], args[1]);
+                    return err.is_ok() ? std::string("OK") : err.description();
+                });
+        });
+    }
+
 private:
     friend class utils::singleton<flag_registry>;
     flag_registry() = default;
 
 private:
     std::map<std::string, flag_data> _flags;
+    std::mutex _update_lock;
 };
 
 #define FLAG_REG_CONSTRUCTOR(type, type_enum)                                                      \
@@ -125,6 +292,25 @@ flag_validator::flag_validator(const char *name, validator_fn validator)
     flag_registry::instance().add_validator(name, validator);
 }
 
-/*extern*/ void flags_initialize() { flag_registry::instance().load_from_config(); }
+flag_tagger::flag_tagger(const char *name, flag_tag tag)
+{
+    flag_registry::instance().add_tag(name, tag);
+}
+
+/*extern*/ void flags_initialize()
+{
+    flag_registry::instance().load_from_config();
+    flag_registry::instance().register_commands();
+}
+
+/*extern*/ error_s update_flag(const std::string &name, const std::string &value)
+{
+    return flag_registry::instance().update_flag(name, value);
+}
+
+/*extern*/ error_with<std::string> get_flag_str(const std::string &name)
+{
+    return flag_registry::instance().get_flag_str(name);
+}
 
 } // namespace dsn
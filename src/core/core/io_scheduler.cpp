@@ -0,0 +1,249 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/io_scheduler.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/time_utils.h>
+#include <fmt/format.h>
+
+namespace dsn {
+
+DSN_DEFINE_bool("io_scheduler",
+                enable_io_scheduler,
+                false,
+                "whether to share the background i/o bandwidth of the node by io_scheduler");
+DSN_DEFINE_uint32("io_scheduler",
+                  io_max_rate_mb,
+                  500,
+                  "the max node-wide rate of the background i/o (MB/s)");
+DSN_DEFINE_uint32("io_scheduler",
+                  io_min_rate_mb,
+                  50,
+                  "the node-wide rate of the background i/o never backs off below this (MB/s)");
+DSN_DEFINE_uint32("io_scheduler",
+                  io_disk_rate_mb,
+                  250,
+                  "the max rate of the background i/o on each disk (MB/s)");
+DSN_DEFINE_uint32("io_scheduler",
+                  io_adjust_interval_ms,
+                  1000,
+                  "the interval to adjust the node-wide rate and the rates of the classes");
+DSN_DEFINE_uint32("io_scheduler",
+                  io_foreground_latency_target_ms,
+                  20,
+                  "back off the node-wide rate if the foreground write latency exceeds this");
+DSN_DEFINE_uint32("io_scheduler", io_learn_weight, 4, "the weight of learning");
+DSN_DEFINE_uint32("io_scheduler", io_backup_weight, 1, "the weight of cold backup");
+DSN_DEFINE_uint32("io_scheduler", io_bulk_load_weight, 2, "the weight of bulk load");
+DSN_DEFINE_uint32("io_scheduler", io_duplication_weight, 3, "the weight of duplication");
+DSN_DEFINE_uint32("io_scheduler", io_copy_weight, 1, "the weight of other file copies");
+
+const char *io_class_to_string(io_class cls)
+{
+    switch (cls) {
+    case io_class::LEARN:
+        return "learn";
+    case io_class::BACKUP:
+        return "backup";
+    case io_class::BULK_LOAD:
+        return "bulk_load";
+    case io_class::DUPLICATION:
+        return "duplication";
+    case io_class::COPY:
+        return "copy";
+    default:
+        return "unknown";
+    }
+}
+
+static uint32_t class_weight(io_class cls)
+{
+    switch (cls) {
+    case io_class::LEARN:
+        return FLAGS_io_learn_weight;
+    case io_class::BACKUP:
+        return FLAGS_io_backup_weight;
+    case io_class::BULK_LOAD:
+        return FLAGS_io_bulk_load_weight;
+    case io_class::DUPLICATION:
+        return FLAGS_io_duplication_weight;
+    default:
+        return FLAGS_io_copy_weight;
+    }
+}
+
+static uint64_t now_ms() { return utils::get_current_physical_time_ns() / 1000000; }
+
+io_scheduler::io_scheduler() : _cap(static_cast<double>(FLAGS_io_max_rate_mb) * (1 << 20))
+{
+    adjust(now_ms());
+}
+
+void io_scheduler::consume(io_class cls, const std::string &local_path, uint64_t bytes)
+{
+    double nap_seconds = reserve_seconds(cls, local_path, bytes);
+    if (nap_seconds > 0) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(static_cast<int64_t>(nap_seconds * 1000000)));
+    }
+}
+
+uint64_t io_scheduler::reserve(io_class cls, const std::string &local_path, uint64_t bytes)
+{
+    return static_cast<uint64_t>(std::ceil(reserve_seconds(cls, local_path, bytes) * 1000));
+}
+
+double io_scheduler::reserve_seconds(io_class cls, const std::string &local_path, uint64_t bytes)
+{
+    if (!FLAGS_enable_io_scheduler || bytes == 0) {
+        return 0;
+    }
+
+    uint64_t now = now_ms();
+    try_adjust(now);
+
+    // the burst is 1 second of the rate, and the requests larger than it are allowed by
+    // borrowing the tokens of the future
+    class_state &c = _classes[static_cast<int>(cls)];
+    c.last_active_ms.store(now, std::memory_order_relaxed);
+    double rate = c.rate.load(std::memory_order_relaxed);
+    double nap = c.bucket.consumeWithBorrowNonBlocking(bytes, rate, rate).get_value_or(0);
+
+    disk_state *disk = find_disk(local_path);
+    if (disk != nullptr) {
+        double disk_rate = static_cast<double>(FLAGS_io_disk_rate_mb) * (1 << 20);
+        nap = std::max(nap,
+                       disk->bucket.consumeWithBorrowNonBlocking(bytes, disk_rate, disk_rate)
+                           .get_value_or(0));
+    }
+    return nap;
+}
+
+void io_scheduler::register_disk(const std::string &tag, const std::string &dir)
+{
+    utils::auto_write_lock l(_disks_lock);
+    for (const auto &d : _disks) {
+        if (d->dir == dir) {
+            return;
+        }
+    }
+    std::unique_ptr<disk_state> d(new disk_state());
+    d->tag = tag;
+    d->dir = dir;
+    _disks.emplace_back(std::move(d));
+}
+
+io_scheduler::disk_state *io_scheduler::find_disk(const std::string &local_path)
+{
+    if (local_path.empty()) {
+        return nullptr;
+    }
+
+    // the disk with the longest matched root directory
+    disk_state *found = nullptr;
+    utils::auto_read_lock l(_disks_lock);
+    for (const auto &d : _disks) {
+        if (local_path.compare(0, d->dir.size(), d->dir) == 0 &&
+            (local_path.size() == d->dir.size() || local_path[d->dir.size()] == '/') &&
+            (found == nullptr || d->dir.size() > found->dir.size())) {
+            found = d.get();
+        }
+    }
+    return found;
+}
+
+void io_scheduler::observe_foreground_latency(uint64_t latency_ns)
+{
+    if (!FLAGS_enable_io_scheduler) {
+        return;
+    }
+    // the moving average with a weight of 1/8 for the latest sample, lost updates between
+    // racing writers are tolerable
+    int64_t avg = static_cast<int64_t>(_foreground_latency_ns.load(std::memory_order_relaxed));
+    avg += (static_cast<int64_t>(latency_ns) - avg) / 8;
+    _foreground_latency_ns.store(static_cast<uint64_t>(avg), std::memory_order_relaxed);
+    _last_foreground_sample_ms.store(now_ms(), std::memory_order_relaxed);
+}
+
+double io_scheduler::rate(io_class cls) const
+{
+    return _classes[static_cast<int>(cls)].rate.load(std::memory_order_relaxed);
+}
+
+void io_scheduler::try_adjust(uint64_t now)
+{
+    uint64_t next = _next_adjust_ms.load(std::memory_order_relaxed);
+    if (now < next ||
+        !_next_adjust_ms.compare_exchange_strong(next, now + FLAGS_io_adjust_interval_ms)) {
+        return;
+    }
+    adjust(now);
+}
+
+void io_scheduler::adjust(uint64_t now)
+{
+    const double mb = 1 << 20;
+    double max_rate = std::max(FLAGS_io_max_rate_mb, 1u) * mb;
+    double min_rate = std::min(std::max(FLAGS_io_min_rate_mb, 1u) * mb, max_rate);
+
+    // AIMD on the foreground write latency, which is considered normal if there is no foreground
+    // write in the last interval
+    double cap = std::min(_cap.load(std::memory_order_relaxed), max_rate);
+    bool has_recent_foreground =
+        now <= _last_foreground_sample_ms.load(std::memory_order_relaxed) +
+                   2 * static_cast<uint64_t>(FLAGS_io_adjust_interval_ms);
+    if (has_recent_foreground &&
+        _foreground_latency_ns.load(std::memory_order_relaxed) >
+            FLAGS_io_foreground_latency_target_ms * 1000000ULL) {
+        cap = std::max(cap / 2, min_rate);
+    } else {
+        cap = std::min(cap + max_rate / 10, max_rate);
+    }
+    _cap.store(cap, std::memory_order_relaxed);
+
+    bool active[static_cast<int>(io_class::COUNT)];
+    uint64_t active_weight = 0;
+    for (int i = 0; i < static_cast<int>(io_class::COUNT); ++i) {
+        active[i] = _classes[i].last_active_ms.load(std::memory_order_relaxed) +
+                        FLAGS_io_adjust_interval_ms >=
+                    now;
+        if (active[i]) {
+            active_weight += std::max(class_weight(static_cast<io_class>(i)), 1u);
+        }
+    }
+    for (int i = 0; i < static_cast<int>(io_class::COUNT); ++i) {
+        // an inactive class is given the share as if it were active, so it is not starved
+        // before the next adjustment
+        uint64_t weight = std::max(class_weight(static_cast<io_class>(i)), 1u);
+        uint64_t total = active[i] ? active_weight : active_weight + weight;
+        _classes[i].rate.store(cap * weight / total, std::memory_order_relaxed);
+    }
+}
+
+std::string io_scheduler::get_info() const
+{
+    std::string info = fmt::format("enabled: {}, cap: {:.1f}MB/s, foreground latency: {}us\n",
+                                   FLAGS_enable_io_scheduler,
+                                   cap() / (1 << 20),
+                                   _foreground_latency_ns.load() / 1000);
+    for (int i = 0; i < static_cast<int>(io_class::COUNT); ++i) {
+        info += fmt::format("  {}: {:.1f}MB/s\n",
+                            io_class_to_string(static_cast<io_class>(i)),
+                            _classes[i].rate.load() / (1 << 20));
+    }
+    utils::auto_read_lock l(_disks_lock);
+    for (const auto &d : _disks) {
+        info += fmt::format("  disk {}: {}\n", d->tag, d->dir);
+    }
+    return info;
+}
+
+} // namespace dsn
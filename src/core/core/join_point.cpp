@@ -38,7 +38,8 @@
 
 namespace dsn {
 
-join_point_base::join_point_base(const char *name)
+join_point_base::join_point_base(const char *name, uint32_t *hook_mask, uint32_t hook_bit)
+    : _hook_mask(hook_mask), _hook_bit(hook_bit)
 {
     _name = std::string(name);
     _hdr.next = _hdr.prev = &_hdr;
@@ -55,6 +56,7 @@ bool join_point_base::put_front(void *fn, const char *name, bool is_native)
     e1->prev = e;
     e->prev = &_hdr;
 
+    update_hook_mask();
     return true;
 }
 
@@ -68,6 +70,7 @@ bool join_point_base::put_back(void *fn, const char *name, bool is_native)
     _hdr.prev = e;
     e->prev = e1;
 
+    update_hook_mask();
     return true;
 }
 
@@ -87,6 +90,7 @@ bool join_point_base::put_before(const char *base, void *fn, const char *name, b
     e0->prev = e;
     e->prev = e1;
 
+    update_hook_mask();
     return true;
 }
 
@@ -106,6 +110,7 @@ bool join_point_base::put_after(const char *base, void *fn, const char *name, bo
     e0->next = e;
     e->next = e1;
 
+    update_hook_mask();
     return true;
 }
 
@@ -133,6 +138,7 @@ bool join_point_base::remove(const char *name)
     e0->next->prev = e0->prev;
     e0->prev->next = e0->next;
 
+    update_hook_mask();
     return true;
 }
 
@@ -160,4 +166,16 @@ join_point_base::advice_entry *join_point_base::get_by_name(const char *name)
     return nullptr;
 }
 
+void join_point_base::update_hook_mask()
+{
+    if (_hook_mask == nullptr) {
+        return;
+    }
+    if (empty()) {
+        *_hook_mask &= ~_hook_bit;
+    } else {
+        *_hook_mask |= _hook_bit;
+    }
+}
+
 } // end namespace dsn
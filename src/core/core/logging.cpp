@@ -161,6 +161,17 @@ namespace dsn {
 std::unique_ptr<logging_provider> logging_provider::_logger =
     std::unique_ptr<logging_provider>(nullptr);
 
+void logging_provider::dsn_log_deferred(const char *file,
+                                        const char *function,
+                                        const int line,
+                                        dsn_log_level_t log_level,
+                                        std::unique_ptr<deferred_log_message> msg)
+{
+    std::string str;
+    msg->format_to(str);
+    dsn_log(file, function, line, log_level, str.c_str());
+}
+
 logging_provider *logging_provider::instance()
 {
     static std::unique_ptr<logging_provider> default_logger =
@@ -0,0 +1,128 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/numa.h>
+
+namespace dsn {
+namespace utils {
+
+static const char *numa_sysfs_root = "/sys/devices/system/node";
+
+static bool read_first_line(const std::string &path, /*out*/ std::string &line)
+{
+    std::ifstream in(path);
+    return in && std::getline(in, line);
+}
+
+int numa_node_count()
+{
+    static int count = []() {
+        int n = 0;
+        while (filesystem::directory_exists(std::string(numa_sysfs_root) + "/node" +
+                                            std::to_string(n))) {
+            ++n;
+        }
+        return n > 0 ? n : 1;
+    }();
+    return count;
+}
+
+bool numa_node_cpus(int node, /*out*/ std::vector<int> &cpus)
+{
+    std::string line;
+    std::string path = std::string(numa_sysfs_root) + "/node" + std::to_string(node) + "/cpulist";
+    if (!read_first_line(path, line)) {
+        return false;
+    }
+    return parse_cpu_list(line, cpus);
+}
+
+int numa_node_of_net_interface(const char *network_interface)
+{
+    std::string line;
+    std::string path = std::string("/sys/class/net/") + network_interface + "/device/numa_node";
+    if (!read_first_line(path, line)) {
+        return -1;
+    }
+    // it's -1 if the device is not attached to any node
+    int node = atoi(line.c_str());
+    return node >= 0 && node < numa_node_count() ? node : -1;
+}
+
+bool bind_thread_to_numa_node(int node)
+{
+    std::vector<int> cpus;
+    if (!numa_node_cpus(node, cpus) || cpus.empty()) {
+        dwarn("get cpus of numa node %d failed", node);
+        return false;
+    }
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int cpu : cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpuset);
+        }
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (err != 0) {
+        dwarn("bind thread to numa node %d failed, err = %d", node, err);
+        return false;
+    }
+    return true;
+}
+
+bool parse_cpu_list(const std::string &cpu_list, /*out*/ std::vector<int> &cpus)
+{
+    cpus.clear();
+    size_t pos = 0;
+    while (pos < cpu_list.size()) {
+        size_t end = cpu_list.find(',', pos);
+        if (end == std::string::npos) {
+            end = cpu_list.size();
+        }
+        std::string range = cpu_list.substr(pos, end - pos);
+        pos = end + 1;
+
+        // trim the trailing spaces and line breaks
+        while (!range.empty() && isspace(range.back())) {
+            range.pop_back();
+        }
+        if (range.empty()) {
+            continue;
+        }
+
+        char *next = nullptr;
+        long first = strtol(range.c_str(), &next, 10);
+        long last = first;
+        if (next == range.c_str() || first < 0) {
+            return false;
+        }
+        if (*next == '-') {
+            const char *second = next + 1;
+            last = strtol(second, &next, 10);
+            if (next == second || last < first) {
+                return false;
+            }
+        }
+        if (*next != '\0') {
+            return false;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    return !cpus.empty();
+}
+
+} // namespace utils
+} // namespace dsn
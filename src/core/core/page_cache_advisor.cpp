@@ -0,0 +1,102 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/page_cache_advisor.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace dsn {
+namespace utils {
+
+static uint64_t page_size()
+{
+    static const uint64_t size = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+page_cache_advisor::page_cache_advisor(int fd, uint64_t readahead_bytes, bool drop_behind)
+    : _fd(fd), _readahead_bytes(readahead_bytes), _drop_behind(drop_behind), _advised_offset(0)
+{
+    // double the readahead window of the kernel
+    ::posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+page_cache_advisor::~page_cache_advisor() { drop_before(UINT64_MAX); }
+
+void page_cache_advisor::on_read(uint64_t offset, uint64_t length)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    if (_advised_offset < offset) {
+        // jump forward, the skipped pages aren't read
+        _advised_offset = offset;
+    }
+
+    uint64_t end = offset + std::max(length, _readahead_bytes);
+    if (end > _advised_offset) {
+        // the residency is checked before the readahead, which caches the pages
+        if (_drop_behind) {
+            auto ranges = uncached_ranges(_fd, _advised_offset, end - _advised_offset);
+            _to_drop.insert(_to_drop.end(), ranges.begin(), ranges.end());
+        }
+        if (_readahead_bytes > 0) {
+            ::posix_fadvise(_fd, _advised_offset, end - _advised_offset, POSIX_FADV_WILLNEED);
+        }
+        _advised_offset = end;
+    }
+
+    drop_before(offset);
+}
+
+void page_cache_advisor::drop_before(uint64_t offset)
+{
+    auto it = _to_drop.begin();
+    for (; it != _to_drop.end() && it->first + it->second <= offset; ++it) {
+        ::posix_fadvise(_fd, it->first, it->second, POSIX_FADV_DONTNEED);
+    }
+    _to_drop.erase(_to_drop.begin(), it);
+}
+
+/*static*/ std::vector<std::pair<uint64_t, uint64_t>>
+page_cache_advisor::uncached_ranges(int fd, uint64_t offset, uint64_t length)
+{
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    uint64_t begin = offset / page_size() * page_size();
+    uint64_t pages = (offset + length - begin + page_size() - 1) / page_size();
+    if (pages == 0) {
+        return ranges;
+    }
+
+    // mapping the file doesn't fault the pages in, whose residency is then told by mincore
+    void *addr = ::mmap(nullptr, pages * page_size(), PROT_READ, MAP_SHARED, fd, begin);
+    if (addr == MAP_FAILED) {
+        // all the pages are regarded as cached, so that none is dropped
+        return ranges;
+    }
+    std::vector<unsigned char> resident(pages);
+    int ret = ::mincore(addr, pages * page_size(), resident.data());
+    ::munmap(addr, pages * page_size());
+    if (ret != 0) {
+        return ranges;
+    }
+
+    for (uint64_t i = 0; i < pages; ++i) {
+        if ((resident[i] & 1) != 0) {
+            continue;
+        }
+        uint64_t start = begin + i * page_size();
+        if (!ranges.empty() && ranges.back().first + ranges.back().second == start) {
+            ranges.back().second += page_size();
+        } else {
+            ranges.emplace_back(start, page_size());
+        }
+    }
+    return ranges;
+}
+
+} // namespace utils
+} // namespace dsn
@@ -9,6 +9,7 @@
 #include <dsn/utility/utils.h>
 #include <dsn/utility/preloadable.h>
 #include <dsn/utility/process_utils.h>
+#include <dsn/utility/string_conv.h>
 #include <dsn/utility/time_utils.h>
 
 namespace dsn {
@@ -70,6 +71,29 @@ void process_mem_usage(double &vm_usage, double &resident_set)
     resident_set = rss * page_size_kb;
 }
 
+int64_t cgroup_memory_limit()
+{
+    // the limit of cgroup v1 is a huge number rather than "max" if unlimited
+    static const int64_t kUnlimitedThreshold = INT64_C(1) << 60;
+    for (const char *path :
+         {"/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory/memory.limit_in_bytes"}) {
+        std::ifstream limit_stream(path, std::ios_base::in);
+        std::string value;
+        if (!(limit_stream >> value)) {
+            continue;
+        }
+        if (value == "max") {
+            return -1;
+        }
+        int64_t limit = 0;
+        if (!buf2int64(value, limit) || limit <= 0 || limit >= kUnlimitedThreshold) {
+            return -1;
+        }
+        return limit;
+    }
+    return -1;
+}
+
 class record_process_start_time : public preloadable<record_process_start_time>
 {
 public:
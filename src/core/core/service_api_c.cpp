@@ -27,12 +27,15 @@
 #include <dsn/service_api_c.h>
 #include <dsn/tool_api.h>
 #include <dsn/cpp/serialization.h>
+#include <dsn/utility/clock.h>
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/process_utils.h>
 #include <dsn/utility/flags.h>
 #include <dsn/tool-api/command_manager.h>
+#include <chrono>
 #include <fstream>
 #include <dsn/utility/time_utils.h>
+#include <dsn/utility/transient_memory.h>
 
 #ifdef DSN_ENABLE_GPERF
 #include <gperftools/malloc_extension.h>
@@ -67,6 +70,12 @@ DSN_API volatile int *dsn_task_queue_virtual_length_ptr(dsn::task_code code, int
                                                                                            hash);
 }
 
+DSN_API bool dsn_threadpool_set_queue_router(dsn::threadpool_code pool,
+                                             dsn::task_queue_router *router)
+{
+    return dsn::task::get_current_node()->computation()->get_pool(pool)->set_queue_router(router);
+}
+
 DSN_API bool dsn_task_is_running_inside(dsn::task *t)
 {
     return ::dsn::task::get_current_task() == t;
@@ -281,6 +290,9 @@ extern void dsn_log_init(const std::string &logging_factory_name,
                          const std::string &dir_log,
                          std::function<std::string()> dsn_log_prefixed_message_func);
 extern void dsn_core_init();
+namespace dsn {
+extern void register_lock_profiling_commands();
+} // namespace dsn
 
 inline void dsn_global_init()
 {
@@ -334,11 +346,52 @@ static std::string dsn_log_prefixed_message_func()
     return res;
 }
 
+namespace {
+
+// the wall time of the phases of the startup, which is reported once the apps are created
+class startup_timer
+{
+public:
+    startup_timer() : _start(std::chrono::steady_clock::now()), _last(_start) {}
+
+    // ends the current phase, which is named `name`
+    void end_phase(const char *name)
+    {
+        auto now = std::chrono::steady_clock::now();
+        _phases.emplace_back(name, to_ms(now - _last));
+        _last = now;
+    }
+
+    std::string to_string() const
+    {
+        std::ostringstream oss;
+        for (const auto &phase : _phases) {
+            oss << phase.first << " = " << phase.second << " ms, ";
+        }
+        oss << "total = " << to_ms(_last - _start) << " ms";
+        return oss.str();
+    }
+
+private:
+    static int64_t to_ms(std::chrono::steady_clock::duration d)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+    }
+
+    const std::chrono::steady_clock::time_point _start;
+    std::chrono::steady_clock::time_point _last;
+    std::vector<std::pair<const char *, int64_t>> _phases;
+};
+
+} // anonymous namespace
+
 bool run(const char *config_file,
          const char *config_arguments,
          bool sleep_after_init,
          std::string &app_list)
 {
+    startup_timer timer;
+
     dsn_global_init();
     dsn_core_init();
     ::dsn::task::set_tls_dsn_context(nullptr, nullptr);
@@ -402,12 +455,17 @@ bool run(const char *config_file,
     // setup log dir
     spec.dir_log = ::dsn::utils::filesystem::path_combine(cdir, "log");
     dsn::utils::filesystem::create_directory(spec.dir_log);
+    timer.end_phase("load config");
 
     // init tools
     dsn_all.tool.reset(::dsn::utils::factory_store<::dsn::tools::tool_app>::create(
         spec.tool.c_str(), ::dsn::PROVIDER_TYPE_MAIN, spec.tool.c_str()));
     dsn_all.tool->install(spec);
 
+    // after the tool, which may mock the clock
+    ::dsn::utils::clock::start_fast_clocks();
+    timer.end_phase("install tool");
+
     // init app specs
     if (!spec.init_app_specs()) {
         printf("error in config file %s, exit ...\n", config_file);
@@ -422,6 +480,19 @@ bool run(const char *config_file,
         "thread local transient memory buffer size (KB), default is 1024");
     ::dsn::tls_trans_mem_init(tls_trans_memory_KB * 1024);
 
+    bool tls_pool_enabled = dsn_config_get_value_bool(
+        "core",
+        "tls_pool_enabled",
+        ::dsn::tls_pool_enabled(),
+        "whether to cache the freed small objects (e.g. messages and tasks) in thread local "
+        "pools, default is true unless built with ASAN");
+    size_t tls_pool_max_KB_per_thread = (size_t)dsn_config_get_value_uint64(
+        "core",
+        "tls_pool_max_KB_per_thread",
+        1024, // 1 MB
+        "max memory (KB) cached in the thread local pool of each thread, default is 1024");
+    ::dsn::tls_pool_init(tls_pool_enabled, tls_pool_max_KB_per_thread * 1024);
+
 #ifdef DSN_ENABLE_GPERF
     double_t tcmalloc_release_rate =
         (double_t)dsn_config_get_value_double("core",
@@ -434,6 +505,8 @@ bool run(const char *config_file,
 
     // init logging
     dsn_log_init(spec.logging_factory_name, spec.dir_log, dsn_log_prefixed_message_func);
+    dsn::register_lock_profiling_commands();
+    timer.end_phase("init memory and logging");
 
     // prepare minimum necessary
     ::dsn::service_engine::instance().init_before_toollets(spec);
@@ -458,6 +531,7 @@ bool run(const char *config_file,
 
     // init runtime
     ::dsn::service_engine::instance().init_after_toollets();
+    timer.end_phase("init toollets and providers");
 
     dsn_all.engine_ready = true;
 
@@ -466,6 +540,7 @@ bool run(const char *config_file,
     ::dsn::utils::split_args(app_list.c_str(), applistkvs, ';');
 
     // init apps
+    std::vector<::dsn::service_app_spec *> app_specs;
     for (auto &sp : spec.app_specs) {
         if (!sp.run)
             continue;
@@ -490,9 +565,11 @@ bool run(const char *config_file,
         }
 
         if (create_it) {
-            ::dsn::service_engine::instance().start_node(sp);
+            app_specs.push_back(&sp);
         }
     }
+    ::dsn::service_engine::instance().start_nodes(app_specs);
+    timer.end_phase("start nodes");
 
     if (::dsn::service_engine::instance().get_all_nodes().size() == 0) {
         printf("no app are created, usually because \n"
@@ -520,8 +597,32 @@ bool run(const char *config_file,
                                                           return oss.str();
                                                       });
 
+    dsn::command_manager::instance().register_command(
+        {"tls-pool-stats"},
+        "tls-pool-stats - show the occupancy and hit/miss count of the thread local pools",
+        "tls-pool-stats",
+        [](const std::vector<std::string> &args) {
+            dsn::tls_pool_stats stats = dsn::tls_pool_get_stats();
+            std::ostringstream oss;
+            oss << "enabled: " << (dsn::tls_pool_enabled() ? "true" : "false") << std::endl
+                << "hit_count: " << stats.hit_count << std::endl
+                << "miss_count: " << stats.miss_count << std::endl
+                << "cached_count: " << stats.cached_count << std::endl
+                << "cached_bytes: " << stats.cached_bytes << std::endl;
+            return oss.str();
+        });
+
     // invoke customized init after apps are created
     dsn::tools::sys_init_after_app_created.execute();
+    timer.end_phase("init after apps created");
+
+    std::string startup_phases = timer.to_string();
+    ddebug("process(%ld) startup phases: %s", getpid(), startup_phases.c_str());
+    dsn::command_manager::instance().register_command(
+        {"startup-phases"},
+        "startup-phases - show the wall time of the phases of the process startup",
+        "startup-phases",
+        [startup_phases](const std::vector<std::string> &args) { return startup_phases; });
 
     // start the tool
     dsn_all.tool->run();
@@ -26,19 +26,31 @@
 
 #include "service_engine.h"
 #include "core/task/task_engine.h"
+#include "core/task/task_latency_sampler.h"
 #include "core/rpc/rpc_engine.h"
 
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/smart_pointers.h>
+#include <dsn/utility/string_conv.h>
 #include <dsn/tool-api/env_provider.h>
 #include <dsn/tool-api/command_manager.h>
+#include <dsn/tool-api/task_cpu_accounting.h>
 #include <dsn/tool_api.h>
 #include <dsn/tool/node_scoper.h>
+#include <set>
+#include <thread>
 
 using namespace dsn::utils;
 
 namespace dsn {
 
+DSN_DEFINE_bool("core",
+                start_nodes_in_parallel,
+                true,
+                "whether the service nodes of the process are started in parallel, except in the "
+                "simulator");
+
 service_node::service_node(service_app_spec &app_spec) { _app_spec = app_spec; }
 
 bool service_node::rpc_register_handler(task_code code,
@@ -102,6 +114,7 @@ void service_node::init_service_app()
 error_code service_node::start()
 {
     error_code err = ERR_OK;
+    uint64_t start_ms = dsn_now_ms();
 
     // init data dir
     if (!dsn::utils::filesystem::path_exists(spec().data_dir))
@@ -111,15 +124,18 @@ error_code service_node::start()
     _computation = make_unique<task_engine>(this);
     _computation->create(_app_spec.pools);
     dassert(!_computation->is_started(), "task engine must not be started at this point");
+    uint64_t pools_created_ms = dsn_now_ms();
 
     // init rpc
     err = init_rpc_engine();
     if (err != ERR_OK)
         return err;
+    uint64_t rpc_started_ms = dsn_now_ms();
 
     // start task engine
     _computation->start();
     dassert(_computation->is_started(), "task engine must be started at this point");
+    uint64_t pools_started_ms = dsn_now_ms();
 
     // create service_app
     {
@@ -130,6 +146,16 @@ error_code service_node::start()
     // start rpc serving
     _rpc->start_serving();
 
+    uint64_t end_ms = dsn_now_ms();
+    ddebug("[%s] node started in %" PRIu64 " ms: create pools = %" PRIu64
+           " ms, start rpc engine = %" PRIu64 " ms, start pools = %" PRIu64
+           " ms, create app = %" PRIu64 " ms",
+           full_name(),
+           end_ms - start_ms,
+           pools_created_ms - start_ms,
+           rpc_started_ms - pools_created_ms,
+           pools_started_ms - rpc_started_ms,
+           end_ms - pools_started_ms);
     return err;
 }
 
@@ -182,6 +208,26 @@ service_engine::service_engine()
         "system.queue - get queue internal information",
         "system.queue",
         &service_engine::get_queue_info);
+    ::dsn::command_manager::instance().register_command(
+        {"task-latency"},
+        "task-latency - get the sampled queue and execution latency of each task code, "
+        "which requires [core] task_latency_sample_rate > 0",
+        "task-latency [task_code_prefix]...",
+        [](const std::vector<std::string> &args) {
+            return task_latency_sampler::instance().get_latency_report(args);
+        });
+    ::dsn::command_manager::instance().register_command(
+        {"task-cpu"},
+        "task-cpu - get the cpu time consumed by each app, and by the top partitions and task "
+        "codes, which requires [core] task_cpu_accounting = true",
+        "task-cpu [top=20]",
+        [](const std::vector<std::string> &args) {
+            int32_t top = 20;
+            if (!args.empty() && (!buf2int32(args[0], top) || top < 0)) {
+                return std::string("invalid arguments for task-cpu: top must be a number");
+            }
+            return task_cpu_accounting::instance().get_usage_report(top, false);
+        });
 }
 
 service_engine::~service_engine() = default;
@@ -210,34 +256,64 @@ void service_engine::init_after_toollets()
     tls_dsn.env = _env;
 }
 
-void service_engine::start_node(service_app_spec &app_spec)
+void service_engine::start_node(service_app_spec &app_spec) { start_nodes({&app_spec}); }
+
+void service_engine::start_nodes(const std::vector<service_app_spec *> &app_specs)
 {
-    auto it = _nodes_by_app_id.find(app_spec.id);
-    if (it == _nodes_by_app_id.end()) {
-        for (auto p : app_spec.ports) {
+    std::vector<std::shared_ptr<service_node>> nodes;
+    std::map<int, const char *> new_ports;
+    for (service_app_spec *app_spec : app_specs) {
+        if (_nodes_by_app_id.find(app_spec->id) != _nodes_by_app_id.end()) {
+            continue;
+        }
+
+        for (auto p : app_spec->ports) {
             // union to existing node if any port is shared
-            if (_nodes_by_app_port.find(p) != _nodes_by_app_port.end()) {
-                service_node *n = _nodes_by_app_port[p];
-
-                dassert(false,
-                        "network port %d usage confliction for %s vs %s, "
-                        "please reconfig",
-                        p,
-                        n->full_name(),
-                        app_spec.full_name.c_str());
-            }
+            auto it = _nodes_by_app_port.find(p);
+            const char *name = it != _nodes_by_app_port.end() ? it->second->full_name() : nullptr;
+            auto it2 = new_ports.find(p);
+            name = it2 != new_ports.end() ? it2->second : name;
+            dassert(name == nullptr,
+                    "network port %d usage confliction for %s vs %s, "
+                    "please reconfig",
+                    p,
+                    name,
+                    app_spec->full_name.c_str());
+            new_ports[p] = app_spec->full_name.c_str();
         }
+        nodes.push_back(std::make_shared<service_node>(*app_spec));
+    }
 
-        auto node = std::make_shared<service_node>(app_spec);
+    auto start = [](service_node *node) {
         error_code err = node->start();
         dassert(err == ERR_OK, "service node start failed, err = %s", err.to_string());
+    };
+
+    // the nodes are independent of each other, while the simulator should run them one by one
+    // to be deterministic
+    if (FLAGS_start_nodes_in_parallel && nodes.size() > 1 && _spec.tool != "simulator") {
+        std::vector<std::thread> threads;
+        for (auto &node : nodes) {
+            threads.emplace_back([this, &start, node]() {
+                task::set_tls_dsn_context(nullptr, nullptr);
+                tls_dsn.env = _env;
+                start(node.get());
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+    } else {
+        for (auto &node : nodes) {
+            start(node.get());
+        }
+    }
 
+    for (auto &node : nodes) {
         _nodes_by_app_id[node->id()] = node;
         for (auto p1 : node->spec().ports) {
             _nodes_by_app_port[p1] = node.get();
         }
-
-        return;
     }
 }
 
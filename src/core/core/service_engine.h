@@ -122,6 +122,8 @@ public:
     void init_after_toollets();
 
     void start_node(service_app_spec &app_spec);
+    // starts the nodes not started yet, in parallel if [core] start_nodes_in_parallel
+    void start_nodes(const std::vector<service_app_spec *> &app_specs);
     const service_nodes_by_app_id &get_all_nodes() const { return _nodes_by_app_id; }
 
 private:
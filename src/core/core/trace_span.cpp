@@ -0,0 +1,139 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <algorithm>
+
+#include <dsn/c/api_layer1.h>
+#include <dsn/c/api_utilities.h>
+#include <dsn/tool-api/rpc_message.h>
+#include <dsn/tool-api/trace_span.h>
+#include <dsn/utility/factory_store.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/rand.h>
+#include <fmt/format.h>
+
+namespace dsn {
+
+DSN_DEFINE_uint32("tracing",
+                  trace_sample_rate,
+                  0,
+                  "sample one in every trace_sample_rate received requests, 0 to disable tracing");
+DSN_DEFINE_string("tracing", trace_sink, "log", "the factory name of the sink of completed spans");
+DSN_DEFINE_uint32("tracing",
+                  trace_export_batch_size,
+                  64,
+                  "export the completed spans once the count of them reaches this");
+DSN_DEFINE_uint32("tracing",
+                  trace_export_interval_ms,
+                  1000,
+                  "export the completed spans once the oldest one has waited for this");
+
+const int trace_span::MAX_POINT_COUNT;
+
+/*static*/ trace_span *trace_span::sample(message_ex *request)
+{
+    uint32_t rate = FLAGS_trace_sample_rate;
+    if (dsn_likely(rate == 0) || rand::next_u32(rate) != 0) {
+        return nullptr;
+    }
+    auto span = new trace_span(request->header->trace_id, request->rpc_code());
+    span->add_point("rpc_receive");
+    return span;
+}
+
+trace_span::trace_span(uint64_t trace_id, task_code code) : _trace_id(trace_id), _code(code) {}
+
+trace_span::~trace_span()
+{
+    completed_span span;
+    span.trace_id = _trace_id;
+    span.code = _code;
+    int count = std::min(_point_count.load(std::memory_order_acquire), MAX_POINT_COUNT);
+    span.points.assign(_points, _points + count);
+    trace_exporter::instance().submit(std::move(span));
+}
+
+void trace_span::add_point(const char *event)
+{
+    int index = _point_count.fetch_add(1, std::memory_order_acq_rel);
+    if (index < MAX_POINT_COUNT) {
+        _points[index].event = event;
+        _points[index].ts_ns = dsn_now_ns();
+    }
+}
+
+std::string completed_span::to_string() const
+{
+    std::string str = fmt::format("trace_id={:016x}, code={}", trace_id, code.to_string());
+    uint64_t start_ns = points.empty() ? 0 : points.front().ts_ns;
+    for (const trace_point &p : points) {
+        str += fmt::format(", {}=+{}us", p.event, (p.ts_ns - start_ns) / 1000);
+    }
+    return str;
+}
+
+void log_trace_sink::export_spans(const std::vector<completed_span> &spans)
+{
+    for (const completed_span &span : spans) {
+        ddebug("[trace] %s", span.to_string().c_str());
+    }
+}
+
+trace_exporter::trace_exporter()
+{
+    utils::factory_store<trace_sink>::register_factory(
+        "log", trace_sink::create<log_trace_sink>, PROVIDER_TYPE_MAIN);
+}
+
+void trace_exporter::submit(completed_span &&span)
+{
+    std::vector<completed_span> spans;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        uint64_t now_ms = dsn_now_ms();
+        if (_spans.empty()) {
+            _first_submit_ms = now_ms;
+        }
+        _spans.emplace_back(std::move(span));
+        if (_spans.size() < FLAGS_trace_export_batch_size &&
+            now_ms < _first_submit_ms + FLAGS_trace_export_interval_ms) {
+            return;
+        }
+        spans.swap(_spans);
+    }
+    export_spans(std::move(spans));
+}
+
+void trace_exporter::flush()
+{
+    std::vector<completed_span> spans;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        spans.swap(_spans);
+    }
+    if (!spans.empty()) {
+        export_spans(std::move(spans));
+    }
+}
+
+void trace_exporter::set_sink(std::unique_ptr<trace_sink> sink)
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_sink_lock);
+    _sink = std::move(sink);
+}
+
+void trace_exporter::export_spans(std::vector<completed_span> &&spans)
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_sink_lock);
+    if (_sink == nullptr) {
+        _sink.reset(utils::factory_store<trace_sink>::create(FLAGS_trace_sink, PROVIDER_TYPE_MAIN));
+        if (_sink == nullptr) {
+            derror("invalid [tracing] trace_sink %s, use the log sink instead", FLAGS_trace_sink);
+            _sink.reset(new log_trace_sink());
+        }
+    }
+    _sink->export_spans(spans);
+}
+
+} // namespace dsn
@@ -33,8 +33,13 @@
  *     xxxx-xx-xx, author, fix bug about xxx
  */
 
+#include <atomic>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <mutex>
+#include <unordered_set>
 #include <dsn/utility/utils.h>
 #include <dsn/utility/transient_memory.h>
 
@@ -113,6 +118,20 @@ blob tls_trans_mem_alloc_blob(size_t sz)
     return buffer;
 }
 
+bool tls_trans_mem_extend_blob(blob &bb, const void *ptr, size_t sz)
+{
+    const char *block = tls_trans_memory.block->get();
+    if (bb.buffer_ptr() == block && bb.data() + bb.length() == ptr) {
+        bb.assign(*tls_trans_memory.block,
+                  (int)(bb.data() - block),
+                  (unsigned int)(bb.length() + sz));
+        return true;
+    }
+
+    bb.assign(*tls_trans_memory.block, (int)((const char *)ptr - block), (unsigned int)sz);
+    return false;
+}
+
 void *tls_trans_malloc(size_t sz)
 {
     sz += sizeof(std::shared_ptr<char>) + sizeof(uint32_t);
@@ -140,4 +159,233 @@ void tls_trans_free(void *ptr)
     ptr = (void *)((char *)ptr - sizeof(std::shared_ptr<char>));
     ((std::shared_ptr<char> *)(ptr))->~shared_ptr<char>();
 }
+
+///
+/// tls pool
+///
+namespace {
+
+// size classes are 64, 128, ..., 4096 bytes
+const int TLS_POOL_CLASS_COUNT = 7;
+const size_t TLS_POOL_MIN_CLASS_BYTES = 64;
+const uint32_t TLS_POOL_LARGE_CLASS = TLS_POOL_CLASS_COUNT;
+const uint32_t TLS_POOL_MAGIC = 0xdeadbeef;
+
+// the header is 16 bytes to keep the alignment of the returned memory
+struct tls_pool_header
+{
+    uint32_t magic;
+    uint32_t size_class;
+    uint64_t reserved;
+};
+static_assert(sizeof(tls_pool_header) == 16, "");
+
+struct tls_pool_free_piece
+{
+    tls_pool_free_piece *next;
+};
+
+struct tls_pool_cache
+{
+    tls_pool_free_piece *free_lists[TLS_POOL_CLASS_COUNT];
+    uint32_t counts[TLS_POOL_CLASS_COUNT];
+
+    // only written by the owner thread, but may be read by the others
+    std::atomic<uint64_t> hit_count;
+    std::atomic<uint64_t> miss_count;
+    std::atomic<uint64_t> cached_count;
+    std::atomic<uint64_t> cached_bytes;
+};
+
+bool tls_pool_is_enabled =
+#if defined(__SANITIZE_ADDRESS__)
+    false;
+#else
+    true;
+#endif
+// max cached count of each size class per thread
+uint32_t tls_pool_max_counts[TLS_POOL_CLASS_COUNT];
+
+std::mutex tls_pool_caches_lock;
+std::unordered_set<tls_pool_cache *> tls_pool_caches;
+// hit/miss count of the exited threads
+std::atomic<uint64_t> tls_pool_retired_hit_count(0);
+std::atomic<uint64_t> tls_pool_retired_miss_count(0);
+
+inline size_t tls_pool_class_bytes(uint32_t size_class)
+{
+    return TLS_POOL_MIN_CLASS_BYTES << size_class;
+}
+
+inline uint32_t tls_pool_size_class(size_t sz)
+{
+    uint32_t size_class = 0;
+    while (size_class < TLS_POOL_CLASS_COUNT && tls_pool_class_bytes(size_class) < sz) {
+        size_class++;
+    }
+    return size_class;
+}
+
+inline void tls_pool_inc(std::atomic<uint64_t> &v, int64_t delta)
+{
+    // single writer, so needn't an atomic read-modify-write
+    v.store(v.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+void set_tls_pool_max_cached_bytes(size_t max_cached_bytes_per_thread)
+{
+    for (int i = 0; i < TLS_POOL_CLASS_COUNT; i++) {
+        tls_pool_max_counts[i] = static_cast<uint32_t>(max_cached_bytes_per_thread /
+                                                       TLS_POOL_CLASS_COUNT /
+                                                       tls_pool_class_bytes(i));
+    }
+}
+
+struct tls_pool_max_counts_initializer
+{
+    tls_pool_max_counts_initializer() { set_tls_pool_max_cached_bytes(1024 * 1024); }
+} tls_pool_max_counts_initializer_instance;
+
+// the pointer is trivially destructible, so it's still accessible after tls_pool_holder
+// is destructed on thread exit, then the memory is freed directly
+thread_local tls_pool_cache *tls_pool = nullptr;
+
+struct tls_pool_holder
+{
+    tls_pool_cache cache;
+
+    tls_pool_holder()
+    {
+        memset(cache.free_lists, 0, sizeof(cache.free_lists));
+        memset(cache.counts, 0, sizeof(cache.counts));
+        cache.hit_count = 0;
+        cache.miss_count = 0;
+        cache.cached_count = 0;
+        cache.cached_bytes = 0;
+
+        std::lock_guard<std::mutex> l(tls_pool_caches_lock);
+        tls_pool_caches.insert(&cache);
+    }
+
+    ~tls_pool_holder()
+    {
+        tls_pool = nullptr;
+        {
+            std::lock_guard<std::mutex> l(tls_pool_caches_lock);
+            tls_pool_caches.erase(&cache);
+            tls_pool_retired_hit_count += cache.hit_count.load(std::memory_order_relaxed);
+            tls_pool_retired_miss_count += cache.miss_count.load(std::memory_order_relaxed);
+        }
+
+        for (int i = 0; i < TLS_POOL_CLASS_COUNT; i++) {
+            while (cache.free_lists[i] != nullptr) {
+                tls_pool_free_piece *piece = cache.free_lists[i];
+                cache.free_lists[i] = piece->next;
+                ::free(piece);
+            }
+        }
+    }
+};
+
+tls_pool_cache *get_tls_pool()
+{
+    if (dsn_unlikely(tls_pool == nullptr)) {
+        static thread_local bool destructed = false;
+        if (destructed) {
+            return nullptr;
+        }
+        static thread_local struct holder_guard
+        {
+            tls_pool_holder holder;
+            ~holder_guard() { destructed = true; }
+        } guard;
+        tls_pool = &guard.holder.cache;
+    }
+    return tls_pool;
+}
+
+} // anonymous namespace
+
+void tls_pool_init(bool enabled, size_t max_cached_bytes_per_thread)
+{
+    tls_pool_is_enabled = enabled;
+    set_tls_pool_max_cached_bytes(max_cached_bytes_per_thread);
+}
+
+bool tls_pool_enabled() { return tls_pool_is_enabled; }
+
+void *tls_pool_malloc(size_t sz)
+{
+    uint32_t size_class = tls_pool_size_class(sz);
+    tls_pool_cache *cache = nullptr;
+    if (size_class != TLS_POOL_LARGE_CLASS && tls_pool_is_enabled) {
+        cache = get_tls_pool();
+    }
+
+    void *ptr;
+    if (cache != nullptr && cache->free_lists[size_class] != nullptr) {
+        tls_pool_free_piece *piece = cache->free_lists[size_class];
+        cache->free_lists[size_class] = piece->next;
+        cache->counts[size_class]--;
+        tls_pool_inc(cache->hit_count, 1);
+        tls_pool_inc(cache->cached_count, -1);
+        tls_pool_inc(cache->cached_bytes, -(int64_t)tls_pool_class_bytes(size_class));
+        ptr = piece;
+    } else {
+        size_t alloc_bytes = (size_class == TLS_POOL_LARGE_CLASS)
+                                 ? sz
+                                 : tls_pool_class_bytes(size_class);
+        ptr = ::malloc(sizeof(tls_pool_header) + alloc_bytes);
+        if (cache != nullptr) {
+            tls_pool_inc(cache->miss_count, 1);
+        }
+    }
+
+    tls_pool_header *hdr = static_cast<tls_pool_header *>(ptr);
+    hdr->magic = TLS_POOL_MAGIC;
+    hdr->size_class = size_class;
+    return hdr + 1;
+}
+
+void tls_pool_free(void *ptr)
+{
+    tls_pool_header *hdr = static_cast<tls_pool_header *>(ptr) - 1;
+    // invalid tls pool memory
+    assert(hdr->magic == TLS_POOL_MAGIC);
+    hdr->magic = 0;
+
+    uint32_t size_class = hdr->size_class;
+    tls_pool_cache *cache = nullptr;
+    if (size_class != TLS_POOL_LARGE_CLASS && tls_pool_is_enabled) {
+        cache = get_tls_pool();
+    }
+
+    if (cache != nullptr && cache->counts[size_class] < tls_pool_max_counts[size_class]) {
+        tls_pool_free_piece *piece = reinterpret_cast<tls_pool_free_piece *>(hdr);
+        piece->next = cache->free_lists[size_class];
+        cache->free_lists[size_class] = piece;
+        cache->counts[size_class]++;
+        tls_pool_inc(cache->cached_count, 1);
+        tls_pool_inc(cache->cached_bytes, tls_pool_class_bytes(size_class));
+    } else {
+        ::free(hdr);
+    }
+}
+
+tls_pool_stats tls_pool_get_stats()
+{
+    tls_pool_stats stats;
+    std::lock_guard<std::mutex> l(tls_pool_caches_lock);
+    stats.hit_count = tls_pool_retired_hit_count.load();
+    stats.miss_count = tls_pool_retired_miss_count.load();
+    stats.cached_count = 0;
+    stats.cached_bytes = 0;
+    for (tls_pool_cache *cache : tls_pool_caches) {
+        stats.hit_count += cache->hit_count.load(std::memory_order_relaxed);
+        stats.miss_count += cache->miss_count.load(std::memory_order_relaxed);
+        stats.cached_count += cache->cached_count.load(std::memory_order_relaxed);
+        stats.cached_bytes += cache->cached_bytes.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
 }
@@ -0,0 +1,101 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "tsc_clock.h"
+
+#include <dsn/utility/time_utils.h>
+
+#include <fstream>
+#include <thread>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace dsn {
+namespace utils {
+
+namespace {
+
+#if defined(__x86_64__)
+inline uint64_t read_tsc() { return __rdtsc(); }
+#else
+inline uint64_t read_tsc() { return 0; }
+#endif
+
+// the base of the conversion, written by calibrate() under a sequence lock, so that the readers
+// never wait
+std::atomic<uint32_t> s_seq{0};
+std::atomic<uint64_t> s_base_tsc{0};
+std::atomic<uint64_t> s_base_ns{0};
+std::atomic<double> s_ns_per_tick{0};
+
+// the first calibration point, from which the rate is measured over a longer and longer baseline
+uint64_t s_anchor_tsc = 0;
+uint64_t s_anchor_ns = 0;
+std::atomic_flag s_calibrating = ATOMIC_FLAG_INIT;
+
+} // anonymous namespace
+
+/*static*/ bool tsc_clock::available()
+{
+#if defined(__x86_64__) && defined(__linux__)
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 5, "flags") == 0) {
+            return line.find(" constant_tsc") != std::string::npos &&
+                   line.find(" nonstop_tsc") != std::string::npos;
+        }
+    }
+#endif
+    return false;
+}
+
+/*static*/ void tsc_clock::calibrate()
+{
+    if (s_calibrating.test_and_set()) {
+        return;
+    }
+
+    uint64_t tsc = read_tsc();
+    uint64_t ns = get_current_physical_time_ns();
+    if (s_anchor_tsc == 0) {
+        s_anchor_tsc = tsc;
+        s_anchor_ns = ns;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        tsc = read_tsc();
+        ns = get_current_physical_time_ns();
+    }
+    double ns_per_tick = static_cast<double>(ns - s_anchor_ns) / (tsc - s_anchor_tsc);
+
+    s_seq.fetch_add(1, std::memory_order_acq_rel);
+    s_base_tsc.store(tsc, std::memory_order_relaxed);
+    s_base_ns.store(ns, std::memory_order_relaxed);
+    s_ns_per_tick.store(ns_per_tick, std::memory_order_relaxed);
+    s_seq.fetch_add(1, std::memory_order_release);
+
+    s_calibrating.clear();
+}
+
+/*static*/ uint64_t tsc_clock::read_ns()
+{
+    uint64_t base_tsc, base_ns;
+    double ns_per_tick;
+    uint32_t seq;
+    do {
+        seq = s_seq.load(std::memory_order_acquire);
+        base_tsc = s_base_tsc.load(std::memory_order_relaxed);
+        base_ns = s_base_ns.load(std::memory_order_relaxed);
+        ns_per_tick = s_ns_per_tick.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) != 0 || seq != s_seq.load(std::memory_order_relaxed));
+
+    // the tsc of another core may be slightly behind the base
+    auto elapsed_ticks = static_cast<int64_t>(read_tsc() - base_tsc);
+    return base_ns + static_cast<int64_t>(elapsed_ticks * ns_per_tick);
+}
+
+} // namespace utils
+} // namespace dsn
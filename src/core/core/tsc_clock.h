@@ -0,0 +1,34 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <dsn/utility/clock.h>
+
+namespace dsn {
+namespace utils {
+
+// tsc_clock reads the time stamp counter of cpu instead of calling clock_gettime, and converts it
+// to the wall time by the rate calibrated against the system clock. The calibration is redone by
+// calibrate() periodically, so that the time follows the adjustments of the system clock.
+//
+// It's only available on x86_64 with the invariant tsc, which is synchronized among the cores and
+// ticks at a constant rate regardless of the frequency scaling and the sleep states.
+class tsc_clock : public clock
+{
+public:
+    // whether the tsc of this machine is reliable to be a clock
+    static bool available();
+
+    // (re)calibrates the rate and the base of the tsc, thread-safe
+    static void calibrate();
+
+    // the time in nanoseconds by the tsc, calibrate() must have been called once
+    static uint64_t read_ns();
+
+    uint64_t now_ns() const override { return read_ns(); }
+};
+
+} // namespace utils
+} // namespace dsn
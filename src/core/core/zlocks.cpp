@@ -34,12 +34,209 @@
  */
 
 #include <dsn/utility/factory_store.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/singleton.h>
+#include <dsn/utility/time_utils.h>
+#include <dsn/tool-api/command_manager.h>
 #include <dsn/tool-api/zlocks.h>
 #include "core/core/zlock_provider.h"
 #include "core/core/service_engine.h"
 
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
 namespace dsn {
 
+DSN_DEFINE_bool("core",
+                enable_lock_profiling,
+                false,
+                "whether to sample the time waited for the named locks when they are held by "
+                "others, which is printed by the remote command locks.contention");
+DSN_TAG_VARIABLE(enable_lock_profiling, FT_MUTABLE);
+
+struct lock_contention_stat
+{
+    enum wait_mode
+    {
+        EXCLUSIVE,
+        SHARED,
+        WAIT_MODE_COUNT
+    };
+
+    // bucket i counts the waits shorter than 2^i us, but not shorter than 2^(i-1) us
+    static const int kBucketCount = 24;
+
+    struct wait_stat
+    {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> max_ns{0};
+        std::atomic<uint64_t> buckets[kBucketCount]{};
+    };
+
+    explicit lock_contention_stat(std::string s) : site(std::move(s)) {}
+
+    void add_wait(wait_mode mode, uint64_t ns)
+    {
+        wait_stat &w = waits[mode];
+        w.count.fetch_add(1, std::memory_order_relaxed);
+        w.total_ns.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t max_ns = w.max_ns.load(std::memory_order_relaxed);
+        while (ns > max_ns &&
+               !w.max_ns.compare_exchange_weak(max_ns, ns, std::memory_order_relaxed)) {
+        }
+
+        int bucket = 0;
+        for (uint64_t us = ns / 1000; us > 0 && bucket < kBucketCount - 1; us >>= 1) {
+            ++bucket;
+        }
+        w.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const std::string site;
+    wait_stat waits[WAIT_MODE_COUNT];
+};
+
+namespace {
+
+// the stats of the locks sharing a site are aggregated, e.g. the private logs of all replicas
+class lock_profiler : public utils::singleton<lock_profiler>
+{
+public:
+    lock_contention_stat *get_stat(const char *site)
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        std::unique_ptr<lock_contention_stat> &stat = _stats[site];
+        if (stat == nullptr) {
+            stat.reset(new lock_contention_stat(site));
+        }
+        return stat.get();
+    }
+
+    // sorted by the total wait time, the worst first
+    std::string dump() const
+    {
+        typedef std::pair<const lock_contention_stat *, int> entry;
+        std::vector<entry> entries;
+        {
+            std::lock_guard<std::mutex> l(_lock);
+            for (const auto &kv : _stats) {
+                for (int mode = 0; mode < lock_contention_stat::WAIT_MODE_COUNT; ++mode) {
+                    if (kv.second->waits[mode].count.load(std::memory_order_relaxed) > 0) {
+                        entries.emplace_back(kv.second.get(), mode);
+                    }
+                }
+            }
+        }
+        auto total_ns = [](const entry &e) {
+            return e.first->waits[e.second].total_ns.load(std::memory_order_relaxed);
+        };
+        std::sort(entries.begin(), entries.end(), [&total_ns](const entry &l, const entry &r) {
+            return total_ns(l) > total_ns(r);
+        });
+
+        std::ostringstream out;
+        if (!FLAGS_enable_lock_profiling) {
+            out << "lock profiling is disabled by [core] enable_lock_profiling" << std::endl;
+        }
+        for (const entry &e : entries) {
+            const lock_contention_stat::wait_stat &w = e.first->waits[e.second];
+            uint64_t count = w.count.load(std::memory_order_relaxed);
+            out << e.first->site
+                << (e.second == lock_contention_stat::SHARED ? " (shared)" : " (exclusive)")
+                << ": waits = " << count << ", total_ms = " << total_ns(e) / 1000000
+                << ", avg_us = " << total_ns(e) / count / 1000
+                << ", p50_us <= " << percentile_us(w, count, 0.5)
+                << ", p99_us <= " << percentile_us(w, count, 0.99)
+                << ", max_us = " << w.max_ns.load(std::memory_order_relaxed) / 1000 << std::endl;
+        }
+        return out.str();
+    }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        for (auto &kv : _stats) {
+            for (lock_contention_stat::wait_stat &w : kv.second->waits) {
+                w.count.store(0, std::memory_order_relaxed);
+                w.total_ns.store(0, std::memory_order_relaxed);
+                w.max_ns.store(0, std::memory_order_relaxed);
+                for (std::atomic<uint64_t> &b : w.buckets) {
+                    b.store(0, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+private:
+    friend class utils::singleton<lock_profiler>;
+    lock_profiler() = default;
+
+    // the upper bound of the bucket where the percentile lies
+    static uint64_t
+    percentile_us(const lock_contention_stat::wait_stat &w, uint64_t count, double percentile)
+    {
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(count * percentile));
+        uint64_t seen = 0;
+        for (int i = 0; i < lock_contention_stat::kBucketCount; ++i) {
+            seen += w.buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return 1ULL << i;
+            }
+        }
+        return 1ULL << (lock_contention_stat::kBucketCount - 1);
+    }
+
+    mutable std::mutex _lock;
+    std::map<std::string, std::unique_ptr<lock_contention_stat>> _stats;
+};
+
+lock_contention_stat *get_contention_stat(const char *site)
+{
+    return site == nullptr ? nullptr : lock_profiler::instance().get_stat(site);
+}
+
+// the waits are only timed when the lock is held by others, so that the uncontended locking
+// costs no more than a try_lock
+template <typename TryLock, typename Lock>
+inline void profiled_lock(lock_contention_stat *stat,
+                          lock_contention_stat::wait_mode mode,
+                          TryLock &&try_lock,
+                          Lock &&lock)
+{
+    if (stat == nullptr || !FLAGS_enable_lock_profiling) {
+        lock();
+    } else if (!try_lock()) {
+        uint64_t start = utils::get_current_physical_time_ns();
+        lock();
+        stat->add_wait(mode, utils::get_current_physical_time_ns() - start);
+    }
+}
+
+} // anonymous namespace
+
+void register_lock_profiling_commands()
+{
+    command_manager::instance().register_command(
+        {"locks.contention"},
+        "locks.contention [reset] - print or reset the time waited for the named locks",
+        "locks.contention [reset]",
+        [](const std::vector<std::string> &args) {
+            if (args.empty()) {
+                return lock_profiler::instance().dump();
+            }
+            if (args.size() == 1 && args[0] == "reset") {
+                lock_profiler::instance().reset();
+                return std::string("OK");
+            }
+            return std::string(ERR_INVALID_PARAMETERS.to_string());
+        });
+}
+
 namespace lock_checker {
 __thread int zlock_exclusive_count;
 __thread int zlock_shared_count;
@@ -65,7 +262,7 @@ void check_dangling_lock()
 }
 } // namespace lock_checker
 
-zlock::zlock(bool recursive)
+zlock::zlock(bool recursive, const char *site) : _stat(get_contention_stat(site))
 {
     if (recursive) {
         lock_provider *last = utils::factory_store<lock_provider>::create(
@@ -86,7 +283,10 @@ zlock::~zlock() { delete _h; }
 
 void zlock::lock()
 {
-    _h->lock();
+    profiled_lock(_stat,
+                  lock_contention_stat::EXCLUSIVE,
+                  [this]() { return _h->try_lock(); },
+                  [this]() { _h->lock(); });
     ++lock_checker::zlock_exclusive_count;
 }
 
@@ -105,7 +305,7 @@ void zlock::unlock()
     _h->unlock();
 }
 
-zrwlock_nr::zrwlock_nr()
+zrwlock_nr::zrwlock_nr(const char *site) : _stat(get_contention_stat(site))
 {
     rwlock_nr_provider *last = utils::factory_store<rwlock_nr_provider>::create(
         service_engine::instance().spec().rwlock_nr_factory_name.c_str(),
@@ -118,7 +318,10 @@ zrwlock_nr::~zrwlock_nr() { delete _h; }
 
 void zrwlock_nr::lock_read()
 {
-    _h->lock_read();
+    profiled_lock(_stat,
+                  lock_contention_stat::SHARED,
+                  [this]() { return _h->try_lock_read(); },
+                  [this]() { _h->lock_read(); });
     ++lock_checker::zlock_shared_count;
 }
 
@@ -138,7 +341,10 @@ bool zrwlock_nr::try_lock_read()
 
 void zrwlock_nr::lock_write()
 {
-    _h->lock_write();
+    profiled_lock(_stat,
+                  lock_contention_stat::EXCLUSIVE,
+                  [this]() { return _h->try_lock_write(); },
+                  [this]() { _h->lock_write(); });
     ++lock_checker::zlock_exclusive_count;
 }
 
@@ -24,67 +24,156 @@
  * THE SOFTWARE.
  */
 
+#include <dsn/utility/numa.h>
 #include <dsn/utility/rand.h>
+#include <dsn/utility/smart_pointers.h>
 #include <memory>
+#include <string>
 
 #include "asio_net_provider.h"
 #include "asio_rpc_session.h"
+#include "core/task/work_stealing_task_queue.h"
 
 namespace dsn {
 namespace tools {
 
 asio_network_provider::asio_network_provider(rpc_engine *srv, network *inner_provider)
-    : connection_oriented_network(srv, inner_provider)
+    : connection_oriented_network(srv, inner_provider),
+      _busy_poll_us(0),
+      _socket_busy_poll_us(0),
+      _multi_reactor(false),
+      _accepting(false)
 {
-    _acceptor = nullptr;
+    _send_message_count_per_write.init_global_counter(get_service_node_name(node()),
+                                                      "network",
+                                                      "send.message.count.per.write",
+                                                      COUNTER_TYPE_NUMBER_PERCENTILES,
+                                                      "message count coalesced in each write");
+    _send_bytes_per_write.init_global_counter(get_service_node_name(node()),
+                                              "network",
+                                              "send.bytes.per.write",
+                                              COUNTER_TYPE_NUMBER_PERCENTILES,
+                                              "bytes sent in each write");
 }
 
 asio_network_provider::~asio_network_provider()
 {
-    if (_acceptor) {
-        _acceptor->close();
+    for (auto &r : _reactors) {
+        if (r->acceptor) {
+            r->acceptor->close();
+        }
+        r->io_service.stop();
     }
-    _io_service.stop();
-    for (auto &w : _workers) {
-        w->join();
+    for (auto &r : _reactors) {
+        for (auto &w : r->workers) {
+            w->join();
+        }
     }
 }
 
-error_code asio_network_provider::start(rpc_channel channel, int port, bool client_only)
+void asio_network_provider::create_reactors()
 {
-    if (_acceptor != nullptr)
-        return ERR_SERVICE_ALREADY_RUNNING;
-
     int io_service_worker_count =
         (int)dsn_config_get_value_uint64("network",
                                          "io_service_worker_count",
                                          1,
                                          "thread number for io service (timer and boost network)");
+    int io_reactor_count = (int)dsn_config_get_value_uint64(
+        "network",
+        "io_reactor_count",
+        0,
+        "if not 0, the number of the reactors of asio_network_provider, each of which is run by "
+        "one thread and listens on the port with SO_REUSEPORT, and io_service_worker_count is "
+        "ignored");
+
+    _multi_reactor = (io_reactor_count > 0);
+    int reactor_count = _multi_reactor ? io_reactor_count : 1;
+    int threads_per_reactor = _multi_reactor ? 1 : io_service_worker_count;
+
+    // bind the io threads to the numa node of the nic, so that the received messages are
+    // allocated on the local memory of the nic
+    int numa_node = -1;
+    if (dsn_config_get_value_bool("network",
+                                  "numa_aware_io_service",
+                                  false,
+                                  "whether to bind the io service threads to the numa node "
+                                  "which primary_interface is attached to")) {
+        const char *interface = dsn_config_get_value_string(
+            "network", "primary_interface", "", "network interface name");
+        if (strlen(interface) > 0) {
+            numa_node = utils::numa_node_of_net_interface(interface);
+        }
+        if (numa_node < 0) {
+            dwarn("numa node of network interface \"%s\" is unknown, io service threads are "
+                  "not bound",
+                  interface);
+        }
+    }
+
+    const char *name = ::dsn::tools::get_service_node_name(node());
+    for (int i = 0; i < reactor_count; i++) {
+        _reactors.emplace_back(make_unique<reactor>());
+        reactor &r = *_reactors.back();
+        r.index = i;
+
+        std::string prefix = "reactor." + std::to_string(i) + ".";
+        r.session_count_counter.init_global_counter(name,
+                                                    "network",
+                                                    (prefix + "session.count").c_str(),
+                                                    COUNTER_TYPE_NUMBER,
+                                                    "session count of the reactor");
+        r.accept_count_counter.init_global_counter(name,
+                                                   "network",
+                                                   (prefix + "accept.count").c_str(),
+                                                   COUNTER_TYPE_RATE,
+                                                   "connections accepted by the reactor");
+        r.recv_bytes_counter.init_global_counter(name,
+                                                 "network",
+                                                 (prefix + "recv.bytes").c_str(),
+                                                 COUNTER_TYPE_RATE,
+                                                 "bytes received by the reactor");
+
+        for (int j = 0; j < threads_per_reactor; j++) {
+            // the thread names are kept as before in the default mode
+            int thread_index = _multi_reactor ? i : j;
+            r.workers.push_back(std::make_shared<std::thread>([this,
+                                                               &r,
+                                                               thread_index,
+                                                               numa_node]() {
+                task::set_tls_dsn_context(node(), nullptr);
+
+                const char *name = ::dsn::tools::get_service_node_name(node());
+                char buffer[128];
+                sprintf(buffer, "%s.asio.%d", name, thread_index);
+                task_worker::set_name(buffer);
+                if (numa_node >= 0) {
+                    utils::bind_thread_to_numa_node(numa_node);
+                }
+                if (_multi_reactor) {
+                    // the requests of the sessions of a reactor are handled by the same worker
+                    // of the non-partitioned pools, unless stolen by the others
+                    work_stealing_task_queue::set_thread_affinity(r.index);
+                }
+
+                run_io_service(r);
+            }));
+        }
+    }
+}
+
+error_code asio_network_provider::start(rpc_channel channel, int port, bool client_only)
+{
+    if (_accepting)
+        return ERR_SERVICE_ALREADY_RUNNING;
 
     // get connection threshold from config, default value 0 means no threshold
     _cfg_conn_threshold_per_ip = (uint32_t)dsn_config_get_value_uint64(
         "network", "conn_threshold_per_ip", 0, "max connection count to each server per ip");
 
-    for (int i = 0; i < io_service_worker_count; i++) {
-        _workers.push_back(std::make_shared<std::thread>([this, i]() {
-            task::set_tls_dsn_context(node(), nullptr);
-
-            const char *name = ::dsn::tools::get_service_node_name(node());
-            char buffer[128];
-            sprintf(buffer, "%s.asio.%d", name, i);
-            task_worker::set_name(buffer);
-
-            boost::asio::io_service::work work(_io_service);
-            boost::system::error_code ec;
-            _io_service.run(ec);
-            if (ec) {
-                dassert(false, "boost::asio::io_service run failed: err(%s)", ec.message().data());
-            }
-        }));
+    if (_reactors.empty()) {
+        create_reactors();
     }
 
-    _acceptor = nullptr;
-
     dassert(channel == RPC_CHANNEL_TCP || channel == RPC_CHANNEL_UDP,
             "invalid given channel %s",
             channel.to_string());
@@ -92,51 +181,148 @@ error_code asio_network_provider::start(rpc_channel channel, int port, bool clie
     _address.assign_ipv4(get_local_ipv4(), port);
 
     if (!client_only) {
-        auto v4_addr = boost::asio::ip::address_v4::any(); //(ntohl(_address.ip));
-        ::boost::asio::ip::tcp::endpoint endpoint(v4_addr, _address.port());
-        boost::system::error_code ec;
-        _acceptor.reset(new boost::asio::ip::tcp::acceptor(_io_service));
-        _acceptor->open(endpoint.protocol(), ec);
-        if (ec) {
-            derror("asio tcp acceptor open failed, error = %s", ec.message().c_str());
-            _acceptor.reset();
-            return ERR_NETWORK_INIT_FAILED;
+        bool reuse_port = _multi_reactor;
+#ifndef SO_REUSEPORT
+        if (reuse_port) {
+            dwarn("SO_REUSEPORT is not supported on this platform, only the first reactor accepts "
+                  "connections");
+            reuse_port = false;
         }
-        _acceptor->set_option(boost::asio::socket_base::reuse_address(true));
-        _acceptor->bind(endpoint, ec);
-        if (ec) {
-            derror("asio tcp acceptor bind failed, error = %s", ec.message().c_str());
-            _acceptor.reset();
-            return ERR_NETWORK_INIT_FAILED;
+#endif
+        for (auto &r : _reactors) {
+            error_code err = start_acceptor(*r, reuse_port);
+            if (err != ERR_OK) {
+                for (auto &started : _reactors) {
+                    if (started->acceptor) {
+                        started->acceptor->close();
+                        started->acceptor.reset();
+                    }
+                }
+                return err;
+            }
+            if (!reuse_port) {
+                break;
+            }
         }
-        int backlog = boost::asio::socket_base::max_connections;
-        _acceptor->listen(backlog, ec);
+        _accepting = true;
+        for (auto &r : _reactors) {
+            if (r->acceptor) {
+                do_accept(*r);
+            }
+        }
+    }
+
+    return ERR_OK;
+}
+
+error_code asio_network_provider::start_acceptor(reactor &r, bool reuse_port)
+{
+    auto v4_addr = boost::asio::ip::address_v4::any(); //(ntohl(_address.ip));
+    ::boost::asio::ip::tcp::endpoint endpoint(v4_addr, _address.port());
+    boost::system::error_code ec;
+    r.acceptor.reset(new boost::asio::ip::tcp::acceptor(r.io_service));
+    r.acceptor->open(endpoint.protocol(), ec);
+    if (ec) {
+        derror("asio tcp acceptor open failed, error = %s", ec.message().c_str());
+        r.acceptor.reset();
+        return ERR_NETWORK_INIT_FAILED;
+    }
+    r.acceptor->set_option(boost::asio::socket_base::reuse_address(true));
+#ifdef SO_REUSEPORT
+    if (reuse_port) {
+        r.acceptor->set_option(
+            boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true), ec);
         if (ec) {
-            derror("asio tcp acceptor listen failed, port = %u, error = %s",
-                   _address.port(),
-                   ec.message().c_str());
-            _acceptor.reset();
+            derror("asio tcp acceptor set SO_REUSEPORT failed, error = %s", ec.message().c_str());
+            r.acceptor.reset();
             return ERR_NETWORK_INIT_FAILED;
         }
-        do_accept();
     }
-
+#endif
+    r.acceptor->bind(endpoint, ec);
+    if (ec) {
+        derror("asio tcp acceptor bind failed, error = %s", ec.message().c_str());
+        r.acceptor.reset();
+        return ERR_NETWORK_INIT_FAILED;
+    }
+    int backlog = boost::asio::socket_base::max_connections;
+    r.acceptor->listen(backlog, ec);
+    if (ec) {
+        derror("asio tcp acceptor listen failed, port = %u, error = %s",
+               _address.port(),
+               ec.message().c_str());
+        r.acceptor.reset();
+        return ERR_NETWORK_INIT_FAILED;
+    }
     return ERR_OK;
 }
 
+void asio_network_provider::run_io_service(reactor &r)
+{
+    boost::asio::io_service &ios = r.io_service;
+    boost::asio::io_service::work work(ios);
+    boost::system::error_code ec;
+    if (_busy_poll_us == 0) {
+        ios.run(ec);
+        dassert(!ec, "boost::asio::io_service run failed: err(%s)", ec.message().data());
+        return;
+    }
+
+    uint64_t last_active_ns = dsn_now_ns();
+    while (!ios.stopped()) {
+        if (ios.poll(ec) > 0) {
+            last_active_ns = dsn_now_ns();
+        } else if (dsn_now_ns() - last_active_ns >= _busy_poll_us * 1000) {
+            // idle for a while, block until the next event
+            ios.run_one(ec);
+            last_active_ns = dsn_now_ns();
+        }
+        dassert(!ec, "boost::asio::io_service run failed: err(%s)", ec.message().data());
+    }
+}
+
+asio_network_provider::reactor &asio_network_provider::select_reactor()
+{
+    reactor *selected = _reactors[0].get();
+    for (auto &r : _reactors) {
+        if (r->session_count.load(std::memory_order_relaxed) <
+            selected->session_count.load(std::memory_order_relaxed)) {
+            selected = r.get();
+        }
+    }
+    return *selected;
+}
+
+void asio_network_provider::on_session_closed(int reactor_index)
+{
+    reactor &r = *_reactors[reactor_index];
+    r.session_count.fetch_sub(1, std::memory_order_relaxed);
+    r.session_count_counter->decrement();
+}
+
+void asio_network_provider::on_session_read(int reactor_index, size_t bytes)
+{
+    _reactors[reactor_index]->recv_bytes_counter->add(bytes);
+}
+
 rpc_session_ptr asio_network_provider::create_client_session(::dsn::rpc_address server_addr)
 {
-    auto sock = std::make_shared<boost::asio::ip::tcp::socket>(_io_service);
+    reactor &r = select_reactor();
+    auto sock = std::make_shared<boost::asio::ip::tcp::socket>(r.io_service);
     message_parser_ptr parser(new_message_parser(_client_hdr_format));
-    return rpc_session_ptr(new asio_rpc_session(*this, server_addr, sock, parser, true));
+    rpc_session_ptr s(new asio_rpc_session(*this, server_addr, sock, parser, true, r.index));
+    r.session_count.fetch_add(1, std::memory_order_relaxed);
+    r.session_count_counter->increment();
+    return s;
 }
 
-void asio_network_provider::do_accept()
+void asio_network_provider::do_accept(reactor &r)
 {
-    auto socket = std::make_shared<boost::asio::ip::tcp::socket>(_io_service);
+    auto socket = std::make_shared<boost::asio::ip::tcp::socket>(r.io_service);
 
-    _acceptor->async_accept(*socket, [this, socket](boost::system::error_code ec) {
+    r.acceptor->async_accept(*socket, [this, &r, socket](boost::system::error_code ec) {
         if (!ec) {
+            r.accept_count_counter->increment();
             auto remote = socket->remote_endpoint(ec);
             if (ec) {
                 derror("failed to get the remote endpoint: %s", ec.message().data());
@@ -151,7 +337,8 @@ void asio_network_provider::do_accept()
                                          client_addr,
                                          (std::shared_ptr<boost::asio::ip::tcp::socket> &)socket,
                                          null_parser,
-                                         false);
+                                         false,
+                                         r.index);
 
                 // when server connection threshold is hit, close the session, otherwise accept it
                 if (check_if_conn_threshold_exceeded(s->remote_address())) {
@@ -161,18 +348,40 @@ void asio_network_provider::do_accept()
                           address().to_string());
                     s->close();
                 } else {
+                    r.session_count.fetch_add(1, std::memory_order_relaxed);
+                    r.session_count_counter->increment();
                     on_server_session_accepted(s);
 
                     // we should start read immediately after the rpc session is completely created.
                     s->start_read_next();
                 }
             }
+        } else if (ec == boost::asio::error::operation_aborted) {
+            // the acceptor is closed
+            return;
         }
 
-        do_accept();
+        do_accept(r);
     });
 }
 
+asio_polling_network_provider::asio_polling_network_provider(rpc_engine *srv,
+                                                             network *inner_provider)
+    : asio_network_provider(srv, inner_provider)
+{
+    _busy_poll_us = dsn_config_get_value_uint64(
+        "network",
+        "busy_poll_us",
+        50,
+        "period for which the io service workers of asio_polling_network_provider poll "
+        "before waiting for the next event");
+    _socket_busy_poll_us = (int)dsn_config_get_value_uint64(
+        "network",
+        "socket_busy_poll_us",
+        0,
+        "SO_BUSY_POLL of the sockets of asio_polling_network_provider, 0 means not to set it");
+}
+
 void asio_udp_provider::send_message(message_ex *request)
 {
     auto parser = get_message_parser(request->hdr_format);
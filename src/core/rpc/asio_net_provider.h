@@ -27,7 +27,10 @@
 #pragma once
 
 #include <dsn/tool_api.h>
+#include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <boost/asio.hpp>
+#include <atomic>
+#include <memory>
 
 namespace dsn {
 namespace tools {
@@ -43,17 +46,72 @@ public:
     virtual ::dsn::rpc_address address() override { return _address; }
     virtual rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) override;
 
-private:
-    void do_accept();
+protected:
+    // if not 0, the io service workers poll for this period before blocking
+    // to wait for the next event
+    uint64_t _busy_poll_us;
+    // if not 0, SO_BUSY_POLL of the sockets
+    int _socket_busy_poll_us;
+
+    // a reactor is an io service with its threads and sessions, and a listener on the server side.
+    //
+    // by default there is only one reactor run by [network] io_service_worker_count threads.
+    // in the multi-reactor mode, i.e. [network] io_reactor_count > 0, each reactor is run by one
+    // thread and has its own SO_REUSEPORT listener, so the connections are accepted and set up
+    // by all the reactors in parallel, and each session is always served by the same thread.
+    struct reactor
+    {
+        int index;
+        boost::asio::io_service io_service;
+        std::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor;
+        std::vector<std::shared_ptr<std::thread>> workers;
+        std::atomic<int> session_count{0};
+
+        perf_counter_wrapper session_count_counter;
+        perf_counter_wrapper accept_count_counter;
+        perf_counter_wrapper recv_bytes_counter;
+    };
+
+    void create_reactors();
+    error_code start_acceptor(reactor &r, bool reuse_port);
+    void do_accept(reactor &r);
+    void run_io_service(reactor &r);
+    // the reactor with the least sessions, for a new client session
+    reactor &select_reactor();
+
+    // called by the sessions of the reactor
+    void on_session_closed(int reactor_index);
+    void on_session_read(int reactor_index, size_t bytes);
 
 private:
     friend class asio_rpc_session;
+    friend class shm_network_provider;
+    friend class shm_rpc_session;
     friend class asio_network_provider_test;
 
-    std::shared_ptr<boost::asio::ip::tcp::acceptor> _acceptor;
-    boost::asio::io_service _io_service;
-    std::vector<std::shared_ptr<std::thread>> _workers;
+    std::vector<std::unique_ptr<reactor>> _reactors;
+    bool _multi_reactor;
+    bool _accepting;
     ::dsn::rpc_address _address;
+
+    // how many messages and bytes are coalesced into one write of the sessions
+    perf_counter_wrapper _send_message_count_per_write;
+    perf_counter_wrapper _send_bytes_per_write;
+};
+
+// asio_polling_network_provider busy polls the io service before waiting for the next event,
+// which trades cpu for the latency of the channels it's configured for, e.g.:
+//
+//   [network]
+//   network.client.RPC_CHANNEL_TCP = dsn::tools::asio_polling_network_provider, 65536
+//   busy_poll_us = 50
+//   socket_busy_poll_us = 50
+//
+// and use it as the factory of network.server.<port>.RPC_CHANNEL_TCP for the server side.
+class asio_polling_network_provider : public asio_network_provider
+{
+public:
+    asio_polling_network_provider(rpc_engine *srv, network *inner_provider);
 };
 
 class asio_udp_provider : public network
@@ -25,6 +25,7 @@
  */
 
 #include "asio_rpc_session.h"
+#include "core/task/task_engine.h"
 
 namespace dsn {
 namespace tools {
@@ -73,6 +74,21 @@ void asio_rpc_session::set_options()
         if (ec)
             dwarn("asio socket set option failed, error = %s", ec.message().c_str());
         dinfo("boost asio set no_delay = true");
+
+        // poll the device queue for the data on a blocking receive, which may require
+        // CAP_NET_ADMIN to be larger than net.core.busy_read
+        int busy_poll_us = static_cast<asio_network_provider &>(_net)._socket_busy_poll_us;
+        if (busy_poll_us > 0) {
+#ifdef SO_BUSY_POLL
+            boost::asio::detail::socket_option::integer<SOL_SOCKET, SO_BUSY_POLL> option5(
+                busy_poll_us);
+            _socket->set_option(option5, ec);
+            if (ec)
+                dwarn("asio socket set SO_BUSY_POLL failed, error = %s", ec.message().c_str());
+#else
+            dwarn("SO_BUSY_POLL is not supported on this platform");
+#endif
+        }
     }
 }
 
@@ -100,6 +116,7 @@ void asio_rpc_session::do_read(int read_next)
                 }
                 on_failure();
             } else {
+                static_cast<asio_network_provider &>(_net).on_session_read(_reactor_index, length);
                 _reader.mark_read(length);
 
                 int read_next = -1;
@@ -109,6 +126,8 @@ void asio_rpc_session::do_read(int read_next)
                 }
 
                 if (_parser) {
+                    // the tasks of all the messages of this read are enqueued at once
+                    enqueue_batch_scope batch;
                     message_ex *msg = _parser->get_message_on_receive(&_reader, read_next);
 
                     while (msg != nullptr) {
@@ -133,13 +152,20 @@ void asio_rpc_session::send(uint64_t signature)
 {
     std::vector<boost::asio::const_buffer> asio_wbufs;
     int bcount = (int)_sending_buffers.size();
+    size_t bytes = 0;
 
-    // prepare buffers
+    // prepare buffers, all the messages in _sending_msgs are sent in one vectored write
+    // without copying
     asio_wbufs.resize(bcount);
     for (int i = 0; i < bcount; i++) {
         asio_wbufs[i] = boost::asio::const_buffer(_sending_buffers[i].buf, _sending_buffers[i].sz);
+        bytes += _sending_buffers[i].sz;
     }
 
+    auto &net = static_cast<asio_network_provider &>(_net);
+    net._send_message_count_per_write->set(_sending_msgs.size());
+    net._send_bytes_per_write->set(bytes);
+
     add_ref();
 
     utils::auto_read_lock socket_guard(_socket_lock);
@@ -161,8 +187,11 @@ asio_rpc_session::asio_rpc_session(asio_network_provider &net,
                                    ::dsn::rpc_address remote_addr,
                                    std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
                                    message_parser_ptr &parser,
-                                   bool is_client)
-    : rpc_session(net, remote_addr, parser, is_client), _socket(socket)
+                                   bool is_client,
+                                   int reactor_index)
+    : rpc_session(net, remote_addr, parser, is_client),
+      _socket(socket),
+      _reactor_index(reactor_index)
 {
     set_options();
 }
@@ -170,6 +199,7 @@ asio_rpc_session::asio_rpc_session(asio_network_provider &net,
 void asio_rpc_session::on_failure(bool is_write)
 {
     if (on_disconnected(is_write)) {
+        static_cast<asio_network_provider &>(_net).on_session_closed(_reactor_index);
         close();
     }
 }
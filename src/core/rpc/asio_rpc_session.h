@@ -44,7 +44,8 @@ public:
                      ::dsn::rpc_address remote_addr,
                      std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
                      message_parser_ptr &parser,
-                     bool is_client);
+                     bool is_client,
+                     int reactor_index);
 
     ~asio_rpc_session() override = default;
 
@@ -70,6 +71,8 @@ private:
     // reading/writing socket being modified or closed concurrently.
     std::shared_ptr<boost::asio::ip::tcp::socket> _socket;
     ::dsn::utils::rw_lock_nr _socket_lock;
+    // the reactor of asio_network_provider which the socket belongs to
+    const int _reactor_index;
 };
 
 } // namespace tools
@@ -34,10 +34,20 @@
  */
 
 #include "dsn_message_parser.h"
+#include "message_compression.h"
 #include <dsn/service_api_c.h>
 #include <dsn/utility/crc.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
+
+DSN_DEFINE_uint32("network",
+                  rpc_body_crc_deferred_bytes,
+                  1048576,
+                  "the body crc of the uncompressed messages of at least these bytes is verified "
+                  "by the task handling the message rather than the network thread, 0 to verify "
+                  "all of them on receive");
+
 void dsn_message_parser::reset() { _header_checked = false; }
 
 message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
@@ -66,7 +76,12 @@ message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
         if (buf_len >= msg_sz) {
             dsn::blob msg_bb = buf.range(0, msg_sz);
             message_ex *msg = message_ex::create_receive_message(msg_bb);
-            if (!is_right_body(msg)) {
+            bool defer_body_crc = FLAGS_rpc_body_crc_deferred_bytes > 0 &&
+                                  msg->header->body_length >= FLAGS_rpc_body_crc_deferred_bytes &&
+                                  !msg->header->context.u.is_compressed;
+            if (defer_body_crc) {
+                msg->defer_body_crc_check();
+            } else if (!is_right_body(msg)) {
                 message_header *header = (message_header *)buf_ptr;
                 derror("dsn message body check failed, id = %" PRIu64 ", trace_id = %016" PRIx64
                        ", rpc_name = %s, from_addr = %s",
@@ -81,10 +96,15 @@ message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
                 reader->_buffer = buf.range(msg_sz);
                 reader->_buffer_occupied -= msg_sz;
                 _header_checked = false;
+                msg->hdr_format = NET_HDR_DSN;
+                msg = message_compression::decompress(msg);
+                if (msg == nullptr) {
+                    read_next = -1;
+                    return nullptr;
+                }
                 read_next = (reader->_buffer_occupied >= sizeof(message_header)
                                  ? 0
                                  : sizeof(message_header) - reader->_buffer_occupied);
-                msg->hdr_format = NET_HDR_DSN;
                 return msg;
             }
         } else { // buf_len < msg_sz
@@ -111,14 +131,19 @@ void dsn_message_parser::prepare_on_send(message_ex *msg)
     dassert(len == (size_t)header->body_length + sizeof(message_header), "data length is wrong");
 #endif
 
-    if (task_spec::get(msg->local_rpc_code)->rpc_message_crc_required) {
+    if (header->context.u.is_request) {
+        message_compression::prepare_request(msg);
+    } else {
+        message_compression::compress_response(msg);
+    }
+
+    if (_checksum_enabled && task_spec::get(msg->local_rpc_code)->rpc_message_crc_required) {
         // compute data crc if necessary (only once for the first time)
         if (header->body_crc32 == CRC_INVALID) {
             int i_max = (int)buffers.size() - 1;
             uint32_t crc32 = 0;
             size_t len = 0;
             for (int i = 0; i <= i_max; i++) {
-                uint32_t lcrc;
                 const void *ptr;
                 size_t sz;
 
@@ -130,9 +155,8 @@ void dsn_message_parser::prepare_on_send(message_ex *msg)
                     sz = (size_t)buffers[i].length();
                 }
 
-                lcrc = dsn::utils::crc32_calc(ptr, sz, crc32);
-                crc32 = dsn::utils::crc32_concat(0, 0, crc32, len, crc32, lcrc, sz);
-
+                // the crc of the previous buffers is continued rather than concatenated
+                crc32 = dsn::utils::crc32_calc(ptr, sz, crc32);
                 len += sz;
             }
 
@@ -143,6 +167,9 @@ void dsn_message_parser::prepare_on_send(message_ex *msg)
         // always compute header crc
         header->hdr_crc32 = CRC_INVALID;
         header->hdr_crc32 = dsn::utils::crc32_calc(header, sizeof(message_header), 0);
+    } else {
+        // the message may be checksummed when sent by another session
+        header->hdr_crc32 = CRC_INVALID;
     }
 }
 
@@ -190,9 +217,7 @@ int dsn_message_parser::get_buffers_on_send(message_ex *msg, /*out*/ send_buf *b
             const void *ptr = (const void *)buffers[i].data();
             size_t sz = (size_t)buffers[i].length();
 
-            uint32_t lcrc = dsn::utils::crc32_calc(ptr, sz, crc32);
-            crc32 = dsn::utils::crc32_concat(0, 0, crc32, len, crc32, lcrc, sz);
-
+            crc32 = dsn::utils::crc32_calc(ptr, sz, crc32);
             len += sz;
         }
 
@@ -55,12 +55,15 @@ public:
 
     virtual int get_buffers_on_send(message_ex *msg, /*out*/ send_buf *buffers) override;
 
-private:
-    static bool is_right_header(char *hdr);
+    virtual void set_checksum_enabled(bool enabled) override { _checksum_enabled = enabled; }
 
     static bool is_right_body(message_ex *msg);
 
+private:
+    static bool is_right_header(char *hdr);
+
 private:
     bool _header_checked;
+    bool _checksum_enabled{true};
 };
 }
@@ -0,0 +1,240 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "message_compression.h"
+
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/utility/crc.h>
+#include <dsn/utility/endians.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/utils.h>
+
+#ifdef DSN_HAS_LZ4
+#include <lz4.h>
+#endif
+#ifdef DSN_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace dsn {
+
+DSN_DEFINE_uint32("network",
+                  response_compress_min_bytes,
+                  4096,
+                  "response body smaller than this is sent uncompressed");
+DSN_DEFINE_double("network",
+                  response_compress_max_ratio,
+                  0.9,
+                  "response body is sent uncompressed if compressed_size / raw_size is larger "
+                  "than this, which skips the data that has been compressed, like sst files");
+DSN_DEFINE_validator(response_compress_max_ratio,
+                     [](double ratio) -> bool { return ratio > 0 && ratio <= 1; });
+DSN_DEFINE_int32("network", response_compress_zstd_level, 1, "compression level of zstd");
+
+namespace {
+
+// the uncompressed body length ahead of the compressed body
+const size_t raw_length_bytes = sizeof(uint32_t);
+
+struct compression_counters
+{
+    perf_counter_wrapper input_bytes;
+    perf_counter_wrapper output_bytes;
+    perf_counter_wrapper skipped_bytes;
+
+    compression_counters()
+    {
+        input_bytes.init_global_counter("server",
+                                        "network",
+                                        "response.compress.input.bytes",
+                                        COUNTER_TYPE_RATE,
+                                        "uncompressed bytes of the compressed responses");
+        output_bytes.init_global_counter("server",
+                                         "network",
+                                         "response.compress.output.bytes",
+                                         COUNTER_TYPE_RATE,
+                                         "compressed bytes of the compressed responses");
+        skipped_bytes.init_global_counter("server",
+                                          "network",
+                                          "response.compress.skipped.bytes",
+                                          COUNTER_TYPE_RATE,
+                                          "bytes sent uncompressed for the poor ratio");
+    }
+};
+
+compression_counters &counters()
+{
+    static compression_counters c;
+    return c;
+}
+
+} // anonymous namespace
+
+/*static*/ bool message_compression::is_supported(dsn_msg_compress_type type)
+{
+    switch (type) {
+#ifdef DSN_HAS_LZ4
+    case MCT_LZ4:
+        return true;
+#endif
+#ifdef DSN_HAS_ZSTD
+    case MCT_ZSTD:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+/*static*/ bool message_compression::compress(dsn_msg_compress_type type,
+                                              const char *data,
+                                              size_t size,
+                                              /*out*/ std::string &output)
+{
+    switch (type) {
+#ifdef DSN_HAS_LZ4
+    case MCT_LZ4: {
+        output.resize(LZ4_compressBound(static_cast<int>(size)));
+        int r = LZ4_compress_default(
+            data, &output[0], static_cast<int>(size), static_cast<int>(output.size()));
+        if (r <= 0) {
+            return false;
+        }
+        output.resize(r);
+        return true;
+    }
+#endif
+#ifdef DSN_HAS_ZSTD
+    case MCT_ZSTD: {
+        output.resize(ZSTD_compressBound(size));
+        size_t r = ZSTD_compress(
+            &output[0], output.size(), data, size, FLAGS_response_compress_zstd_level);
+        if (ZSTD_isError(r)) {
+            return false;
+        }
+        output.resize(r);
+        return true;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+/*static*/ bool message_compression::decompress(dsn_msg_compress_type type,
+                                                const char *data,
+                                                size_t size,
+                                                size_t raw_size,
+                                                /*out*/ char *output)
+{
+    switch (type) {
+#ifdef DSN_HAS_LZ4
+    case MCT_LZ4:
+        return LZ4_decompress_safe(
+                   data, output, static_cast<int>(size), static_cast<int>(raw_size)) ==
+               static_cast<int>(raw_size);
+#endif
+#ifdef DSN_HAS_ZSTD
+    case MCT_ZSTD: {
+        size_t r = ZSTD_decompress(output, raw_size, data, size);
+        return !ZSTD_isError(r) && r == raw_size;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+/*static*/ void message_compression::prepare_request(message_ex *msg)
+{
+    auto type = task_spec::get(msg->local_rpc_code)->rpc_response_compress_type;
+    msg->header->context.u.compress_type = is_supported(type) ? type : MCT_NONE;
+    msg->header->context.u.is_compressed = 0;
+}
+
+/*static*/ void message_compression::compress_response(message_ex *msg)
+{
+    auto &header = msg->header;
+    auto type = static_cast<dsn_msg_compress_type>(header->context.u.compress_type);
+    if (header->context.u.is_compressed || !is_supported(type) ||
+        header->body_length < FLAGS_response_compress_min_bytes) {
+        return;
+    }
+
+    // gather the body, which starts just after the header in buffers[0]
+    std::string body;
+    body.reserve(header->body_length);
+    for (size_t i = 0; i < msg->buffers.size(); ++i) {
+        const blob &bb = msg->buffers[i];
+        size_t offset = (i == 0 ? sizeof(message_header) : 0);
+        body.append(bb.data() + offset, bb.length() - offset);
+    }
+    dassert(body.size() == header->body_length, "data length is wrong");
+
+    std::string compressed;
+    if (!compress(type, body.data(), body.size(), compressed) ||
+        compressed.size() + raw_length_bytes >
+            body.size() * FLAGS_response_compress_max_ratio) {
+        counters().skipped_bytes->add(body.size());
+        return;
+    }
+    counters().input_bytes->add(body.size());
+    counters().output_bytes->add(compressed.size() + raw_length_bytes);
+
+    std::string output(raw_length_bytes, '\0');
+    data_output(&output[0], raw_length_bytes).write_u32(static_cast<uint32_t>(body.size()));
+    output.append(compressed);
+
+    msg->buffers[0] = msg->buffers[0].range(0, sizeof(message_header));
+    msg->buffers.resize(1);
+    msg->buffers.emplace_back(blob::create_from_bytes(std::move(output)));
+    header->body_length = msg->buffers[1].length();
+    header->context.u.is_compressed = 1;
+}
+
+/*static*/ message_ex *message_compression::decompress(message_ex *msg)
+{
+    if (!msg->header->context.u.is_compressed) {
+        return msg;
+    }
+
+    auto type = static_cast<dsn_msg_compress_type>(msg->header->context.u.compress_type);
+    const blob &bb = msg->buffers[0];
+    if (!is_supported(type) || bb.length() < raw_length_bytes) {
+        derror("unsupported or corrupted compressed body, compress_type = %s, rpc_name = %s",
+               enum_to_string(type),
+               msg->header->rpc_name);
+        delete msg;
+        return nullptr;
+    }
+
+    uint32_t raw_size = data_input(string_view(bb.data(), raw_length_bytes)).read_u32();
+    std::shared_ptr<char> buffer(utils::make_shared_array<char>(sizeof(message_header) + raw_size));
+    if (!decompress(type,
+                    bb.data() + raw_length_bytes,
+                    bb.length() - raw_length_bytes,
+                    raw_size,
+                    buffer.get() + sizeof(message_header))) {
+        derror("decompress body failed, compress_type = %s, rpc_name = %s",
+               enum_to_string(type),
+               msg->header->rpc_name);
+        delete msg;
+        return nullptr;
+    }
+
+    auto *header = reinterpret_cast<message_header *>(buffer.get());
+    memcpy(header, msg->header, sizeof(message_header));
+    header->body_length = raw_size;
+    header->context.u.is_compressed = 0;
+    // the crc has been checked against the compressed body
+    header->hdr_crc32 = header->body_crc32 = CRC_INVALID;
+
+    message_ex *raw_msg = message_ex::create_receive_message(
+        blob(std::move(buffer), static_cast<int>(sizeof(message_header) + raw_size)));
+    raw_msg->hdr_format = msg->hdr_format;
+    delete msg;
+    return raw_msg;
+}
+
+} // namespace dsn
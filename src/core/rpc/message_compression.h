@@ -0,0 +1,53 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <dsn/tool-api/rpc_message.h>
+#include <dsn/tool-api/task_spec.h>
+
+namespace dsn {
+
+// Response body compression of the dsn message protocol.
+//
+// A request advertises the codec configured by `rpc_response_compress_type` of its rpc code
+// in msg_context::compress_type, which is copied into the response by create_response(). The
+// remote side compresses the response body with that codec if it supports it too, the body
+// is large enough, and the compressed size is small enough for the work to be worthwhile
+// (e.g. for already-compressed sst files it's not). The compressed body is prefixed with the
+// uncompressed length in 4 bytes, and msg_context::is_compressed is set.
+//
+// Remotes of older versions leave the bits untouched and never compress, so both sides can
+// be upgraded in any order.
+class message_compression
+{
+public:
+    // whether `type` is compiled in
+    static bool is_supported(dsn_msg_compress_type type);
+
+    // on sending a request: advertise the codec configured for its rpc code
+    static void prepare_request(message_ex *msg);
+
+    // on sending a response: compress the body in place if accepted and worthwhile
+    static void compress_response(message_ex *msg);
+
+    // on receiving: decompress the body of `msg` if it is compressed, the header and body
+    // of the returned message are contiguous as create_receive_message() requires.
+    // `msg` is returned if it's not compressed, or else it is released and a new message is
+    // returned. Return nullptr if the body is corrupted.
+    static message_ex *decompress(message_ex *msg);
+
+    // raw codec functions, exposed for test
+    static bool compress(dsn_msg_compress_type type,
+                         const char *data,
+                         size_t size,
+                         /*out*/ std::string &output);
+    static bool decompress(dsn_msg_compress_type type,
+                           const char *data,
+                           size_t size,
+                           size_t raw_size,
+                           /*out*/ char *output);
+};
+
+} // namespace dsn
@@ -34,7 +34,9 @@
  */
 
 #include "message_parser_manager.h"
+#include "read_buffer_pool.h"
 #include <dsn/service_api_c.h>
+#include <algorithm>
 
 namespace dsn {
 
@@ -141,13 +143,12 @@ char *message_reader::read_buffer_ptr(unsigned int read_next)
             rb = _buffer.range(0, _buffer_occupied);
 
         // switch to next
-        unsigned int sz =
-            (read_next + _buffer_occupied > _buffer_block_size ? read_next + _buffer_occupied
-                                                               : _buffer_block_size);
+        adapt_block_size();
+        unsigned int sz = std::max(read_next + _buffer_occupied, _next_block_size);
         // TODO(wutao1): make it a buffer queue like what sofa-pbrpc does
         //               (https://github.com/baidu/sofa-pbrpc/blob/master/src/sofa/pbrpc/buffer.h)
         //               to reduce memory copy.
-        _buffer.assign(dsn::utils::make_shared_array<char>(sz), 0, sz);
+        _buffer = read_buffer_alloc(sz);
         _buffer_occupied = 0;
 
         // copy
@@ -155,6 +156,7 @@ char *message_reader::read_buffer_ptr(unsigned int read_next)
             // every read buffer_block_size data may cause one copy
             memcpy((void *)_buffer.data(), (const void *)rb.data(), rb.length());
             _buffer_occupied = rb.length();
+            read_buffer_on_copy(rb.length());
         }
 
         dassert(read_next + _buffer_occupied <= _buffer.length(),
@@ -168,6 +170,19 @@ char *message_reader::read_buffer_ptr(unsigned int read_next)
     return (char *)(_buffer.data() + _buffer_occupied);
 }
 
+void message_reader::adapt_block_size()
+{
+    // the smallest size class of the pool
+    const unsigned int min_block_size =
+        std::min(_buffer_block_size, static_cast<unsigned int>(read_buffer_alloc_size(1)));
+    if (_max_read_length * 2 > _next_block_size) {
+        _next_block_size = std::min(_next_block_size * 2, _buffer_block_size);
+    } else if (_buffer.length() > 0 && _max_read_length * 4 < _next_block_size) {
+        _next_block_size = std::max(_next_block_size / 2, min_block_size);
+    }
+    _max_read_length = 0;
+}
+
 //-------------------- msg parser manager --------------------
 void message_parser_manager::register_factory(network_header_format fmt,
                                               const std::vector<const char *> &signatures,
@@ -26,10 +26,24 @@
 
 #include <dsn/tool-api/network.h>
 #include <dsn/utility/factory_store.h>
+#include <dsn/utility/flags.h>
+#include <algorithm>
 #include "message_parser_manager.h"
 #include "core/rpc/rpc_engine.h"
 
 namespace dsn {
+
+DSN_DEFINE_uint32("network",
+                  send_queue_bulk_message_bytes,
+                  65536,
+                  "the messages of at least these bytes are sent after all the smaller ones "
+                  "queued in a session, 0 to send them by the priorities of their rpc codes");
+DSN_DEFINE_bool("network",
+                rpc_checksum_on_loopback,
+                false,
+                "whether the messages on the loopback connections carry checksums, for the rpc "
+                "codes of which rpc_message_crc_required is set");
+
 /*static*/ join_point<void, rpc_session *>
     rpc_session::on_rpc_session_connected("rpc.session.connected");
 /*static*/ join_point<void, rpc_session *>
@@ -128,11 +142,16 @@ void rpc_session::clear_send_queue(bool resend_msgs)
     }
 
     while (true) {
-        dlink *msg;
+        dlink *msg = nullptr;
         {
             utils::auto_lock<utils::ex_lock_nr> l(_lock);
-            msg = _messages.next();
-            if (msg == &_messages)
+            for (auto &q : _messages) {
+                if (q.next() != &q) {
+                    msg = q.next();
+                    break;
+                }
+            }
+            if (msg == nullptr)
                 break;
 
             msg->remove();
@@ -159,8 +178,8 @@ void rpc_session::clear_send_queue(bool resend_msgs)
 
 inline bool rpc_session::unlink_message_for_send()
 {
-    auto n = _messages.next();
     int bcount = 0;
+    size_t bytes = 0;
 
     dbg_dassert(0 == _sending_buffers.size(),
                 "sending_buffers should be empty, but size = %d",
@@ -169,23 +188,33 @@ inline bool rpc_session::unlink_message_for_send()
                 "sending_msgs should be empty, but size = %d",
                 (int)_sending_msgs.size());
 
-    while (n != &_messages) {
-        auto lmsg = CONTAINING_RECORD(n, message_ex, dl);
-        auto lcount = _parser->get_buffer_count_on_send(lmsg);
-        if (bcount > 0 && bcount + lcount > _max_buffer_block_count_per_send) {
-            break;
-        }
+    bool full = false;
+    for (int pri = TASK_PRIORITY_COUNT - 1; pri >= 0 && !full; --pri) {
+        auto &q = _messages[pri];
+        auto n = q.next();
+        while (n != &q) {
+            auto lmsg = CONTAINING_RECORD(n, message_ex, dl);
+            auto lcount = _parser->get_buffer_count_on_send(lmsg);
+            if (bcount > 0 && (bcount + lcount > _max_buffer_block_count_per_send ||
+                               bytes >= _max_bytes_per_send)) {
+                full = true;
+                break;
+            }
 
-        _sending_buffers.resize(bcount + lcount);
-        auto rcount = _parser->get_buffers_on_send(lmsg, &_sending_buffers[bcount]);
-        dassert(lcount >= rcount, "%d VS %d", lcount, rcount);
-        if (lcount != rcount)
-            _sending_buffers.resize(bcount + rcount);
-        bcount += rcount;
-        _sending_msgs.push_back(lmsg);
+            _sending_buffers.resize(bcount + lcount);
+            auto rcount = _parser->get_buffers_on_send(lmsg, &_sending_buffers[bcount]);
+            dassert(lcount >= rcount, "%d VS %d", lcount, rcount);
+            if (lcount != rcount)
+                _sending_buffers.resize(bcount + rcount);
+            for (int i = bcount; i < bcount + rcount; i++) {
+                bytes += _sending_buffers[i].sz;
+            }
+            bcount += rcount;
+            _sending_msgs.push_back(lmsg);
 
-        n = n->next();
-        lmsg->dl.remove();
+            n = n->next();
+            lmsg->dl.remove();
+        }
     }
 
     // added in send_message
@@ -193,6 +222,19 @@ inline bool rpc_session::unlink_message_for_send()
     return _sending_msgs.size() > 0;
 }
 
+/*static*/ dsn_task_priority_t rpc_session::get_send_priority(message_ex *msg)
+{
+    if (FLAGS_send_queue_bulk_message_bytes > 0 &&
+        msg->header->body_length >= FLAGS_send_queue_bulk_message_bytes) {
+        return TASK_PRIORITY_LOW;
+    }
+    task_spec *spec = task_spec::get(msg->rpc_code());
+    if (spec == nullptr || spec->priority == TASK_PRIORITY_INVALID) {
+        return TASK_PRIORITY_COMMON;
+    }
+    return spec->priority;
+}
+
 DEFINE_TASK_CODE(LPC_DELAY_RPC_REQUEST_RATE, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
 
 void rpc_session::start_read_next(int read_next)
@@ -234,6 +276,7 @@ int rpc_session::prepare_parser()
         }
     }
     _parser = _net.new_message_parser(hdr_format);
+    _parser->set_checksum_enabled(is_checksum_required());
     dinfo("message parser created, remote_client = %s, header_format = %s",
           _remote_addr.to_string(),
           hdr_format.to_string());
@@ -253,7 +296,7 @@ void rpc_session::send_message(message_ex *msg)
     uint64_t sig;
     {
         utils::auto_lock<utils::ex_lock_nr> l(_lock);
-        msg->dl.insert_before(&_messages);
+        msg->dl.insert_before(&_messages[get_send_priority(msg)]);
         ++_message_count;
 
         if (SS_CONNECTED == _connect_state && !_is_sending_next) {
@@ -337,6 +380,7 @@ rpc_session::rpc_session(connection_oriented_network &net,
       _net(net),
       _remote_addr(remote_addr),
       _max_buffer_block_count_per_send(net.max_buffer_block_count_per_send()),
+      _max_bytes_per_send(net.max_bytes_per_send()),
       _reader(net.message_buffer_block_size()),
       _parser(parser),
 
@@ -344,11 +388,24 @@ rpc_session::rpc_session(connection_oriented_network &net,
       _matcher(_net.engine()->matcher()),
       _delay_server_receive_ms(0)
 {
+    if (_parser != nullptr) {
+        _parser->set_checksum_enabled(is_checksum_required());
+    }
     if (!is_client) {
         on_rpc_session_connected.execute(this);
     }
 }
 
+bool rpc_session::is_checksum_required()
+{
+    if (FLAGS_rpc_checksum_on_loopback) {
+        return true;
+    }
+    // the data never leaves the host on a loopback connection
+    uint32_t ip = _remote_addr.ip();
+    return (ip >> 24) != 127 && ip != _net.address().ip();
+}
+
 bool rpc_session::on_disconnected(bool is_write)
 {
     bool ret;
@@ -419,7 +476,16 @@ network::network(rpc_engine *srv, network *inner_provider)
     : _engine(srv), _client_hdr_format(NET_HDR_DSN), _unknown_msg_header_format(NET_HDR_INVALID)
 {
     _message_buffer_block_size = 1024 * 64;
-    _max_buffer_block_count_per_send = 64; // TODO: windows, how about the other platforms?
+    _max_buffer_block_count_per_send = (int)dsn_config_get_value_uint64(
+        "network",
+        "max_buffer_block_count_per_send",
+        64,
+        "max count of buffers of the messages coalesced into one write of a session");
+    _max_bytes_per_send = (size_t)dsn_config_get_value_uint64(
+        "network",
+        "max_bytes_per_send",
+        1024 * 1024,
+        "max bytes of the messages coalesced into one write of a session");
     _send_queue_threshold =
         (int)dsn_config_get_value_uint64("network",
                                          "send_queue_threshold",
@@ -498,10 +564,69 @@ uint32_t network::get_local_ipv4()
     return ip;
 }
 
+DSN_DEFINE_uint32("network",
+                  client_sessions_per_server,
+                  1,
+                  "count of the sessions from a client to each server, through which the "
+                  "requests are spread by their partitions");
+DSN_DEFINE_uint32("network",
+                  client_large_message_bytes,
+                  0,
+                  "if not 0, the requests whose bodies are no smaller than it are sent through "
+                  "a dedicated session to each server, apart from the latency-sensitive ones");
+
 connection_oriented_network::connection_oriented_network(rpc_engine *srv, network *inner_provider)
     : network(srv, inner_provider)
 {
     _cfg_conn_threshold_per_ip = 0;
+    _cfg_client_sessions_per_server = std::max(FLAGS_client_sessions_per_server, 1u);
+    _cfg_large_message_bytes = FLAGS_client_large_message_bytes;
+}
+
+int connection_oriented_network::select_client_session(const message_ex *request) const
+{
+    if (_cfg_large_message_bytes > 0 && request->header->body_length >= _cfg_large_message_bytes) {
+        return (int)_cfg_client_sessions_per_server;
+    }
+    if (_cfg_client_sessions_per_server == 1) {
+        return 0;
+    }
+
+    uint64_t hash;
+    if (request->header->gpid.value() != 0) {
+        hash = (uint32_t)request->header->gpid.thread_hash();
+    } else if (request->header->client.partition_hash != 0) {
+        hash = request->header->client.partition_hash;
+    } else {
+        hash = (uint32_t)request->header->client.thread_hash;
+    }
+    return (int)(hash % _cfg_client_sessions_per_server);
+}
+
+// whether `s` is in `pool`, and removes it if `remove`
+static bool find_client_session(std::vector<rpc_session_ptr> &pool,
+                                const rpc_session_ptr &s,
+                                bool remove)
+{
+    for (auto &session : pool) {
+        if (session.get() == s.get()) {
+            if (remove) {
+                session = nullptr;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool is_empty_pool(const std::vector<rpc_session_ptr> &pool)
+{
+    for (auto &session : pool) {
+        if (session != nullptr) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void connection_oriented_network::inject_drop_message(message_ex *msg, bool is_send)
@@ -516,7 +641,7 @@ void connection_oriented_network::inject_drop_message(message_ex *msg, bool is_s
         utils::auto_read_lock l(_clients_lock);
         auto it = _clients.find(msg->to_address);
         if (it != _clients.end()) {
-            s = it->second;
+            s = it->second[select_client_session(msg)];
         }
     }
 
@@ -529,13 +654,14 @@ void connection_oriented_network::send_message(message_ex *request)
 {
     rpc_session_ptr client = nullptr;
     auto &to = request->to_address;
+    int index = select_client_session(request);
 
     // TODO: thread-local client ptr cache
     {
         utils::auto_read_lock l(_clients_lock);
         auto it = _clients.find(to);
         if (it != _clients.end()) {
-            client = it->second;
+            client = it->second[index];
         }
     }
 
@@ -543,12 +669,16 @@ void connection_oriented_network::send_message(message_ex *request)
     bool new_client = false;
     if (nullptr == client.get()) {
         utils::auto_write_lock l(_clients_lock);
-        auto it = _clients.find(to);
-        if (it != _clients.end()) {
-            client = it->second;
+        auto &pool = _clients[to];
+        if (pool.empty()) {
+            // one more for the large messages
+            pool.resize(_cfg_client_sessions_per_server + (_cfg_large_message_bytes > 0 ? 1 : 0));
+        }
+        if (pool[index] != nullptr) {
+            client = pool[index];
         } else {
             client = create_client_session(to);
-            _clients.insert(client_sessions::value_type(to, client));
+            pool[index] = client;
             new_client = true;
         }
         scount = (int)_clients.size();
@@ -556,8 +686,9 @@ void connection_oriented_network::send_message(message_ex *request)
 
     // init connection if necessary
     if (new_client) {
-        ddebug("client session created, remote_server = %s, current_count = %d",
+        ddebug("client session created, remote_server = %s, index = %d, current_count = %d",
                client->remote_address().to_string(),
+               index,
                scount);
         client->connect();
     }
@@ -687,7 +818,7 @@ void connection_oriented_network::on_client_session_connected(rpc_session_ptr &s
     {
         utils::auto_read_lock l(_clients_lock);
         auto it = _clients.find(s->remote_address());
-        if (it != _clients.end() && it->second.get() == s.get()) {
+        if (it != _clients.end() && find_client_session(it->second, s, false)) {
             r = true;
         }
         scount = (int)_clients.size();
@@ -707,8 +838,10 @@ void connection_oriented_network::on_client_session_disconnected(rpc_session_ptr
     {
         utils::auto_write_lock l(_clients_lock);
         auto it = _clients.find(s->remote_address());
-        if (it != _clients.end() && it->second.get() == s.get()) {
-            _clients.erase(it);
+        if (it != _clients.end() && find_client_session(it->second, s, true)) {
+            if (is_empty_pool(it->second)) {
+                _clients.erase(it);
+            }
             r = true;
         }
         scount = (int)_clients.size();
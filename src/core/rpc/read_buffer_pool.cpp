@@ -0,0 +1,285 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "read_buffer_pool.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/utility/autoref_ptr.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/ports.h>
+#include <dsn/utility/utils.h>
+
+namespace dsn {
+
+DSN_DEFINE_uint64("network",
+                  read_buffer_pool_max_cached_bytes,
+                  8 * 1024 * 1024,
+                  "max bytes of the read buffers cached by each io thread, 0 to disable the cache");
+
+namespace {
+
+// size classes are 4KB, 8KB, ..., 1MB
+const int CLASS_COUNT = 9;
+const size_t MIN_CLASS_BYTES = 4096;
+const uint32_t LARGE_CLASS = CLASS_COUNT;
+
+inline size_t class_bytes(uint32_t size_class) { return MIN_CLASS_BYTES << size_class; }
+
+inline uint32_t get_size_class(size_t sz)
+{
+    uint32_t size_class = 0;
+    while (size_class < CLASS_COUNT && class_bytes(size_class) < sz) {
+        size_class++;
+    }
+    return size_class;
+}
+
+struct free_buffer
+{
+    free_buffer *next;
+};
+
+// the read buffers allocated by a thread, referenced by the thread and all the buffers in use
+struct buffer_cache : public ref_counter
+{
+    // only accessed by the owner thread
+    free_buffer *local_lists[CLASS_COUNT];
+    // pushed by the other threads, and taken all at once by the owner thread
+    std::atomic<free_buffer *> remote_lists[CLASS_COUNT];
+    std::atomic<uint64_t> cached_bytes;
+    // set when the owner thread exits, then the buffers are freed rather than cached
+    std::atomic<bool> retired;
+
+    buffer_cache() : cached_bytes(0), retired(false)
+    {
+        memset(local_lists, 0, sizeof(local_lists));
+        for (auto &list : remote_lists) {
+            list.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~buffer_cache()
+    {
+        for (int i = 0; i < CLASS_COUNT; i++) {
+            free_list(local_lists[i]);
+            free_list(remote_lists[i].load(std::memory_order_acquire));
+        }
+    }
+
+    static void free_list(free_buffer *b)
+    {
+        while (b != nullptr) {
+            free_buffer *next = b->next;
+            ::free(b);
+            b = next;
+        }
+    }
+
+    // called by the owner thread
+    char *take(uint32_t size_class)
+    {
+        free_buffer *b = local_lists[size_class];
+        if (b == nullptr) {
+            b = remote_lists[size_class].exchange(nullptr, std::memory_order_acquire);
+        }
+        if (b != nullptr) {
+            local_lists[size_class] = b->next;
+            cached_bytes.fetch_sub(class_bytes(size_class), std::memory_order_relaxed);
+        }
+        return reinterpret_cast<char *>(b);
+    }
+
+    // returns false if the cache is full
+    bool reserve(uint32_t size_class)
+    {
+        uint64_t bytes = class_bytes(size_class);
+        if (cached_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes >
+            FLAGS_read_buffer_pool_max_cached_bytes) {
+            cached_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // called by the owner thread
+    void put_local(char *buf, uint32_t size_class)
+    {
+        free_buffer *b = reinterpret_cast<free_buffer *>(buf);
+        b->next = local_lists[size_class];
+        local_lists[size_class] = b;
+    }
+
+    // called by the other threads
+    void put_remote(char *buf, uint32_t size_class)
+    {
+        free_buffer *b = reinterpret_cast<free_buffer *>(buf);
+        b->next = remote_lists[size_class].load(std::memory_order_relaxed);
+        while (!remote_lists[size_class].compare_exchange_weak(
+            b->next, b, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+// the pointer is trivially destructible, so it's still accessible after cache_holder
+// is destructed on thread exit, then the buffers are allocated without caching
+thread_local buffer_cache *tls_cache = nullptr;
+
+struct cache_holder
+{
+    buffer_cache *cache;
+
+    cache_holder() : cache(new buffer_cache()) { cache->add_ref(); }
+
+    ~cache_holder()
+    {
+        tls_cache = nullptr;
+        cache->retired.store(true, std::memory_order_release);
+        cache->release_ref();
+    }
+};
+
+buffer_cache *get_tls_cache()
+{
+    if (dsn_unlikely(tls_cache == nullptr)) {
+        static thread_local bool destructed = false;
+        if (destructed) {
+            return nullptr;
+        }
+        static thread_local struct holder_guard
+        {
+            cache_holder holder;
+            ~holder_guard() { destructed = true; }
+        } guard;
+        tls_cache = guard.holder.cache;
+    }
+    return tls_cache;
+}
+
+struct buffer_deleter
+{
+    buffer_cache *cache;
+    uint32_t size_class;
+
+    void operator()(char *buf) const
+    {
+        if (!cache->retired.load(std::memory_order_acquire) && cache->reserve(size_class)) {
+            // no cache is created for the threads which only release buffers
+            if (cache == tls_cache) {
+                cache->put_local(buf, size_class);
+            } else {
+                cache->put_remote(buf, size_class);
+            }
+        } else {
+            ::free(buf);
+        }
+        cache->release_ref();
+    }
+};
+
+struct read_buffer_counters
+{
+    std::atomic<uint64_t> hit_count{0};
+    std::atomic<uint64_t> miss_count{0};
+    std::atomic<uint64_t> large_count{0};
+    std::atomic<uint64_t> copy_bytes{0};
+
+    perf_counter_wrapper alloc_count_counter;
+    perf_counter_wrapper recycle_count_counter;
+    perf_counter_wrapper copy_bytes_counter;
+
+    read_buffer_counters()
+    {
+        alloc_count_counter.init_global_counter("server",
+                                                "network",
+                                                "read.buffer.alloc.count",
+                                                COUNTER_TYPE_RATE,
+                                                "read buffers allocated by malloc");
+        recycle_count_counter.init_global_counter("server",
+                                                  "network",
+                                                  "read.buffer.recycle.count",
+                                                  COUNTER_TYPE_RATE,
+                                                  "read buffers reused from the cache");
+        copy_bytes_counter.init_global_counter("server",
+                                               "network",
+                                               "read.buffer.copy.bytes",
+                                               COUNTER_TYPE_RATE,
+                                               "bytes copied when switching read buffers");
+    }
+};
+
+read_buffer_counters &counters()
+{
+    static read_buffer_counters c;
+    return c;
+}
+
+void on_alloc(bool hit, bool large)
+{
+    read_buffer_counters &c = counters();
+    if (hit) {
+        c.hit_count.fetch_add(1, std::memory_order_relaxed);
+        c.recycle_count_counter->increment();
+    } else {
+        c.miss_count.fetch_add(1, std::memory_order_relaxed);
+        c.alloc_count_counter->increment();
+        if (large) {
+            c.large_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+} // anonymous namespace
+
+blob read_buffer_alloc(size_t sz)
+{
+    uint32_t size_class = get_size_class(sz);
+    buffer_cache *cache = nullptr;
+    if (size_class != LARGE_CLASS && FLAGS_read_buffer_pool_max_cached_bytes > 0) {
+        cache = get_tls_cache();
+    }
+
+    if (cache == nullptr) {
+        on_alloc(false, size_class == LARGE_CLASS);
+        return blob(utils::make_shared_array<char>(sz), static_cast<unsigned int>(sz));
+    }
+
+    char *buf = cache->take(size_class);
+    on_alloc(buf != nullptr, false);
+    if (buf == nullptr) {
+        buf = static_cast<char *>(::malloc(class_bytes(size_class)));
+    }
+    cache->add_ref(); // released by buffer_deleter
+    return blob(std::shared_ptr<char>(buf, buffer_deleter{cache, size_class}),
+                static_cast<unsigned int>(sz));
+}
+
+size_t read_buffer_alloc_size(size_t sz)
+{
+    uint32_t size_class = get_size_class(sz);
+    return size_class == LARGE_CLASS ? sz : class_bytes(size_class);
+}
+
+read_buffer_stats read_buffer_get_stats()
+{
+    read_buffer_counters &c = counters();
+    read_buffer_stats stats;
+    stats.hit_count = c.hit_count.load(std::memory_order_relaxed);
+    stats.miss_count = c.miss_count.load(std::memory_order_relaxed);
+    stats.large_count = c.large_count.load(std::memory_order_relaxed);
+    stats.copy_bytes = c.copy_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void read_buffer_on_copy(size_t bytes)
+{
+    read_buffer_counters &c = counters();
+    c.copy_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    c.copy_bytes_counter->add(bytes);
+}
+
+} // namespace dsn
@@ -0,0 +1,40 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <dsn/utility/blob.h>
+
+namespace dsn {
+
+/// read buffer pool recycles the read buffers of message_reader.
+///
+/// the buffers are rounded up to the size classes of 4KB, 8KB, ..., 1MB, and cached by the
+/// thread allocating them, which is the io thread of the session. a read buffer is referenced by
+/// the messages received into it, so it's usually released by the worker threads after the
+/// messages are handled, then it's pushed back to the cache of its allocating thread, rather
+/// than the releasing thread. buffers larger than the largest size class are never cached.
+///
+/// the bytes cached by each thread is limited by [network] read_buffer_pool_max_cached_bytes.
+
+// allocate a buffer of `sz` bytes, the returned blob is exactly `sz` bytes
+blob read_buffer_alloc(size_t sz);
+
+// the bytes actually allocated for a buffer of `sz` bytes
+size_t read_buffer_alloc_size(size_t sz);
+
+struct read_buffer_stats
+{
+    uint64_t hit_count;   // allocations served by the cache
+    uint64_t miss_count;  // allocations served by malloc, including the large ones
+    uint64_t large_count; // allocations larger than the largest size class
+    uint64_t copy_bytes;  // bytes copied by message_reader when switching buffers
+};
+
+read_buffer_stats read_buffer_get_stats();
+
+// called by message_reader
+void read_buffer_on_copy(size_t bytes);
+
+} // namespace dsn
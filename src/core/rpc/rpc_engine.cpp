@@ -37,11 +37,19 @@
 #include <dsn/tool-api/task_queue.h>
 #include <dsn/tool-api/async_calls.h>
 #include <dsn/cpp/serialization.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/rand.h>
 #include <set>
 
 namespace dsn {
 
+DSN_DEFINE_bool("network",
+                rpc_loopback_in_process,
+                true,
+                "whether the rpcs to the node itself are passed in process rather than through "
+                "the network, i.e. with no socket io, parsing or checksum");
+DSN_TAG_VARIABLE(rpc_loopback_in_process, FT_MUTABLE);
+
 DEFINE_TASK_CODE(LPC_RPC_TIMEOUT, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
 
 class rpc_timeout_task : public task
@@ -64,35 +72,73 @@ private:
     uint64_t _id;
 };
 
+const uint64_t rpc_client_matcher::SLOT_BUSY;
+
 rpc_client_matcher::~rpc_client_matcher()
 {
-    for (int i = 0; i < MATCHER_BUCKET_NR; i++) {
-        dassert(_requests[i].size() == 0,
+    for (int i = 0; i < MATCHER_SLOT_NR; i++) {
+        dassert(_slots[i].key.load() == 0,
                 "all rpc entries must be removed before the matcher ends");
     }
+    dassert(_overflow_requests.size() == 0,
+            "all rpc entries must be removed before the matcher ends");
+}
+
+template <typename TFunc>
+bool rpc_client_matcher::update_entry(uint64_t key, TFunc &&f)
+{
+    match_slot &slot = _slots[key & (MATCHER_SLOT_NR - 1)];
+    uint64_t expected = key;
+    while (!slot.key.compare_exchange_weak(
+        expected, key | SLOT_BUSY, std::memory_order_acquire, std::memory_order_relaxed)) {
+        if (expected != key && expected != (key | SLOT_BUSY)) {
+            expected = 0;
+            break;
+        }
+        // the entry is accessed by others, which only lasts for a few instructions
+        expected = key;
+    }
+
+    if (expected == key) {
+        if (f(slot.entry)) {
+            slot.key.store(key, std::memory_order_release);
+        } else {
+            slot.entry = match_entry();
+            slot.key.store(0, std::memory_order_release);
+        }
+        return true;
+    }
+
+    if (_overflow_count.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+    utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_overflow_lock);
+    auto it = _overflow_requests.find(key);
+    if (it == _overflow_requests.end()) {
+        return false;
+    }
+    if (!f(it->second)) {
+        _overflow_requests.erase(it);
+        _overflow_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return true;
 }
 
 bool rpc_client_matcher::on_recv_reply(network *net, uint64_t key, message_ex *reply, int delay_ms)
 {
     rpc_response_task_ptr call;
     task_ptr timeout_task;
-    int bucket_index = key % MATCHER_BUCKET_NR;
 
-    {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto it = _requests[bucket_index].find(key);
-        if (it != _requests[bucket_index].end()) {
-            call = std::move(it->second.resp_task);
-            timeout_task = std::move(it->second.timeout_task);
-            _requests[bucket_index].erase(it);
-        } else {
-            if (reply) {
-                dassert(reply->get_count() == 0,
-                        "reply should not be referenced by anybody so far");
-                delete reply;
-            }
+    if (!update_entry(key, [&call, &timeout_task](match_entry &e) {
+            call = std::move(e.resp_task);
+            timeout_task = std::move(e.timeout_task);
             return false;
+        })) {
+        if (reply) {
+            dassert(reply->get_count() == 0, "reply should not be referenced by anybody so far");
+            delete reply;
         }
+        return false;
     }
 
     dbg_dassert(call != nullptr, "rpc response task cannot be empty");
@@ -187,8 +233,10 @@ bool rpc_client_matcher::on_recv_reply(network *net, uint64_t key, message_ex *r
                    reply->header->rpc_name,
                    reply->header->trace_id);
 
-            // call network failure model
-            net->inject_drop_message(reply, false);
+            // call network failure model, there is no network for the loopback rpcs
+            if (net != nullptr) {
+                net->inject_drop_message(reply, false);
+            }
         }
     }
 
@@ -198,29 +246,26 @@ bool rpc_client_matcher::on_recv_reply(network *net, uint64_t key, message_ex *r
 void rpc_client_matcher::on_rpc_timeout(uint64_t key)
 {
     rpc_response_task_ptr call;
-    int bucket_index = key % MATCHER_BUCKET_NR;
+    task_ptr timeout_task;
     uint64_t timeout_ts_ms;
     bool resend = false;
 
-    {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto it = _requests[bucket_index].find(key);
-        if (it != _requests[bucket_index].end()) {
-            timeout_ts_ms = it->second.timeout_ts_ms;
-            call = it->second.resp_task;
+    if (!update_entry(key, [&](match_entry &e) {
+            timeout_ts_ms = e.timeout_ts_ms;
+            call = e.resp_task;
             if (timeout_ts_ms == 0) {
-                _requests[bucket_index].erase(it);
+                // released outside of the slot
+                timeout_task = std::move(e.timeout_task);
+                return false;
             }
 
             // resend is enabled
-            else {
-                // do it in next check so we can do expensive things
-                // outside of the lock
-                resend = true;
-            }
-        } else {
-            return;
-        }
+            // do it in next check so we can do expensive things
+            // outside of the slot
+            resend = true;
+            return true;
+        })) {
+        return;
     }
 
     dbg_dassert(call != nullptr, "rpc response task is missing for rpc request %" PRIu64, key);
@@ -244,26 +289,21 @@ void rpc_client_matcher::on_rpc_timeout(uint64_t key)
         new_timeout_task = new rpc_timeout_task(this, key, call->node());
     }
 
-    {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto it = _requests[bucket_index].find(key);
-        if (it != _requests[bucket_index].end()) {
+    if (!update_entry(key, [&](match_entry &e) {
             // timeout
             if (!resend) {
-                _requests[bucket_index].erase(it);
+                timeout_task = std::move(e.timeout_task);
+                return false;
             }
 
             // resend
-            else {
-                // reset timeout task
-                it->second.timeout_task = new_timeout_task;
-            }
-        }
-
+            // reset timeout task
+            timeout_task = std::move(e.timeout_task);
+            e.timeout_task = new_timeout_task;
+            return true;
+        })) {
         // response is received
-        else {
-            resend = false;
-        }
+        resend = false;
     }
 
     if (resend) {
@@ -284,7 +324,6 @@ void rpc_client_matcher::on_rpc_timeout(uint64_t key)
 void rpc_client_matcher::on_call(message_ex *request, const rpc_response_task_ptr &call)
 {
     message_header &hdr = *request->header;
-    int bucket_index = hdr.id % MATCHER_BUCKET_NR;
     auto sp = task_spec::get(request->local_rpc_code);
     int timeout_ms = hdr.client.timeout_ms;
     uint64_t timeout_ts_ms = 0;
@@ -299,11 +338,20 @@ void rpc_client_matcher::on_call(message_ex *request, const rpc_response_task_pt
     dbg_dassert(call != nullptr, "rpc response task cannot be empty");
     task *timeout_task(new rpc_timeout_task(this, hdr.id, call->node()));
 
-    {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
+    dassert(hdr.id != 0 && (hdr.id & SLOT_BUSY) == 0, "invalid request id %" PRIu64, hdr.id);
+    match_slot &slot = _slots[hdr.id & (MATCHER_SLOT_NR - 1)];
+    uint64_t expected = 0;
+    if (slot.key.compare_exchange_strong(
+            expected, hdr.id | SLOT_BUSY, std::memory_order_acquire, std::memory_order_relaxed)) {
+        slot.entry = match_entry{call, timeout_task, timeout_ts_ms};
+        slot.key.store(hdr.id, std::memory_order_release);
+    } else {
+        dassert((expected & ~SLOT_BUSY) != hdr.id, "the message is already on the fly!!!");
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_overflow_lock);
         auto pr =
-            _requests[bucket_index].emplace(hdr.id, match_entry{call, timeout_task, timeout_ts_ms});
+            _overflow_requests.emplace(hdr.id, match_entry{call, timeout_task, timeout_ts_ms});
         dassert(pr.second, "the message is already on the fly!!!");
+        _overflow_count.fetch_add(1, std::memory_order_release);
     }
 
     timeout_task->set_delay(timeout_ms);
@@ -397,13 +445,26 @@ rpc_request_task *rpc_server_dispatcher::on_request(message_ex *msg, service_nod
 
     if (handler) {
         auto r = new rpc_request_task(msg, std::move(handler), node);
-        r->spec().on_task_create.execute(task::get_current_task(), r);
+        if (r->spec().has_hook(TASK_HOOK_CREATE)) {
+            r->spec().on_task_create.execute(task::get_current_task(), r);
+        }
         return r;
     } else
         return nullptr;
 }
 
 //----------------------------------------------------------------------------------------------
+// returns the message received for `msg` when it is passed in process, the content of which is
+// the same as the one parsed from the network
+static message_ex *loopback_message(message_ex *msg)
+{
+    // copied into a contiguous block, as the received messages are expected to be, e.g. by
+    // forwarding, and `msg` is still kept by the sender, e.g. for resending
+    message_ex *recv_msg = msg->copy(true, true);
+    msg->copy_to(*recv_msg); // extensible object state move
+    return recv_msg;
+}
+
 rpc_engine::rpc_engine(service_node *node) : _node(node), _rpc_matcher(this)
 {
     dassert(_node != nullptr, "");
@@ -549,6 +610,7 @@ void rpc_engine::on_recv_request(network *net, message_ex *msg, int delay_ms)
     auto code = msg->rpc_code();
 
     if (code != ::dsn::TASK_CODE_INVALID) {
+        msg->span = trace_span::sample(msg);
         rpc_request_task *tsk = nullptr;
 
         // handle replication
@@ -576,7 +638,9 @@ void rpc_engine::on_recv_request(network *net, message_ex *msg, int delay_ms)
                        msg->header->trace_id);
 
                 // call network failure model when network is present
-                net->inject_drop_message(msg, false);
+                if (net != nullptr) {
+                    net->inject_drop_message(msg, false);
+                }
 
                 // because (1) initially, the ref count is zero
                 //         (2) upper apps may call add_ref already
@@ -691,7 +755,8 @@ void rpc_engine::call_ip(rpc_address addr,
     }
 
     // join point and possible fault injection
-    if (!sp->on_rpc_call.execute(task::get_current_task(), request, call, true)) {
+    if (sp->has_hook(TASK_HOOK_RPC_CALL) &&
+        !sp->on_rpc_call.execute(task::get_current_task(), request, call, true)) {
         ddebug("rpc request %s is dropped (fault inject), trace_id = %016" PRIx64,
                request->header->rpc_name,
                request->header->trace_id);
@@ -715,6 +780,20 @@ void rpc_engine::call_ip(rpc_address addr,
         _rpc_matcher.on_call(request, call);
     }
 
+    // the rpcs to the node itself, of which the reply is passed back in process by reply(),
+    // the ones handled inline are excluded as they would run on the caller thread
+    if (FLAGS_rpc_loopback_in_process && addr == _local_primary_address &&
+        request->hdr_format == NET_HDR_DSN && !sp->allow_inline &&
+        (call == nullptr || !call->spec().allow_inline)) {
+        message_ex *recv_msg = loopback_message(request);
+        on_recv_request(nullptr, recv_msg, 0);
+
+        // as ref_count for request may be zero
+        request->add_ref();
+        request->release_ref();
+        return;
+    }
+
     net->send_message(request);
 }
 
@@ -732,6 +811,10 @@ void rpc_engine::reply(message_ex *response, error_code err)
         return;
     }
 
+    if (response->span != nullptr) {
+        response->span->add_point("reply");
+    }
+
     strncpy(response->header->server.error_name,
             err.to_string(),
             sizeof(response->header->server.error_name) - 1);
@@ -745,7 +828,7 @@ void rpc_engine::reply(message_ex *response, error_code err)
                   : task_spec::get(response->local_rpc_code);
 
     bool no_fail = true;
-    if (sp) {
+    if (sp && sp->has_hook(TASK_HOOK_RPC_REPLY)) {
         // current task may be nullptr when this method is directly invoked from rpc_engine.
         task *cur_task = task::get_current_task();
         if (cur_task) {
@@ -753,6 +836,20 @@ void rpc_engine::reply(message_ex *response, error_code err)
         }
     }
 
+    // the request is passed in process by call_ip(), so is the reply
+    if (s == nullptr && response->to_address == _local_primary_address) {
+        if (no_fail) {
+            message_ex *recv_msg = loopback_message(response);
+            _rpc_matcher.on_recv_reply(nullptr, recv_msg->header->id, recv_msg, 0);
+        }
+
+        // because (1) initially, the ref count is zero
+        //         (2) upper apps may call add_ref already
+        response->add_ref();
+        response->release_ref();
+        return;
+    }
+
     // connection oriented network, we have bound session
     if (s != nullptr) {
         // not forwarded, we can use the original rpc session
@@ -26,6 +26,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
 #include <dsn/utility/synchronize.h>
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/network.h>
@@ -50,11 +54,20 @@ class rpc_engine;
 // (due to
 // less std::shared_ptr<rpc_client_matcher> operations in rpc_timeout_task
 //
-#define MATCHER_BUCKET_NR 13
+// The outstanding calls are kept in a pre-allocated slot array indexed by the low bits of the
+// request id. As request ids are allocated sequentially, a slot is usually free again long before
+// its index comes round, so registering and matching a call only take an atomic operation on the
+// slot rather than a lock and a heap allocation. The calls whose slots are still taken fall back
+// to a locked overflow map.
+//
+#define MATCHER_SLOT_NR (1 << 16)
 class rpc_client_matcher : public ref_counter
 {
 public:
-    rpc_client_matcher(rpc_engine *engine) : _engine(engine) {}
+    rpc_client_matcher(rpc_engine *engine)
+        : _engine(engine), _slots(new match_slot[MATCHER_SLOT_NR])
+    {
+    }
 
     ~rpc_client_matcher();
 
@@ -79,16 +92,36 @@ private:
     void on_rpc_timeout(uint64_t key);
 
 private:
-    rpc_engine *_engine;
     struct match_entry
     {
         rpc_response_task_ptr resp_task;
         task_ptr timeout_task;
         uint64_t timeout_ts_ms; // > 0 for auto-resent msgs
     };
+
+    struct match_slot
+    {
+        // 0 if free, the request id if taken, or the request id with SLOT_BUSY set
+        // while the entry is being accessed exclusively
+        std::atomic<uint64_t> key{0};
+        match_entry entry;
+    };
+    static const uint64_t SLOT_BUSY = 1ULL << 63;
+
+    // calls `f` on the entry of `key` exclusively, and removes the entry if `f` returns false,
+    // returns false if there is no entry of `key`
+    template <typename TFunc>
+    bool update_entry(uint64_t key, TFunc &&f);
+
+private:
+    rpc_engine *_engine;
+
+    std::unique_ptr<match_slot[]> _slots;
+
     typedef std::unordered_map<uint64_t, match_entry> rpc_requests;
-    rpc_requests _requests[MATCHER_BUCKET_NR];
-    ::dsn::utils::ex_lock_nr_spin _requests_lock[MATCHER_BUCKET_NR];
+    rpc_requests _overflow_requests;
+    std::atomic<int> _overflow_count{0};
+    ::dsn::utils::ex_lock_nr_spin _overflow_lock;
 };
 
 class rpc_server_dispatcher
@@ -42,12 +42,15 @@
 #include <cctype>
 
 #include "core/task/task_engine.h"
+#include "dsn_message_parser.h"
 
 using namespace dsn::utils;
 
 namespace dsn {
 
 std::atomic<uint64_t> message_ex::_id(0);
+std::atomic<int64_t> message_ex::s_alive_count(0);
+std::atomic<int64_t> message_ex::s_alive_bytes(0);
 uint32_t message_ex::s_local_hash = 0;
 
 message_ex::message_ex()
@@ -60,6 +63,7 @@ message_ex::message_ex()
       _rw_committed(true),
       _is_read(false)
 {
+    s_alive_count.fetch_add(1, std::memory_order_relaxed);
 }
 
 message_ex::~message_ex()
@@ -86,6 +90,8 @@ message_ex::~message_ex()
     if (!_is_read) {
         dassert(_rw_committed, "message write is not committed");
     }
+    s_alive_count.fetch_sub(1, std::memory_order_relaxed);
+    s_alive_bytes.fetch_sub(_accounted_bytes, std::memory_order_relaxed);
 }
 
 error_code message_ex::error()
@@ -128,6 +134,7 @@ message_ex *message_ex::create_receive_message(const blob &data)
     // the message_header is hidden ahead of the buffer
     auto data2 = data.range((int)sizeof(message_header));
     msg->buffers.push_back(data2);
+    msg->account_bytes(data2.length());
 
     // dbg_dassert(msg->header->body_length > 0, "message %s is empty!", msg->header->rpc_name);
     return msg;
@@ -158,8 +165,8 @@ message_ex *message_ex::create_receive_message_with_standalone_header(const blob
 {
     message_ex *msg = new message_ex();
     std::shared_ptr<char> header_holder(
-        static_cast<char *>(dsn::tls_trans_malloc(sizeof(message_header))),
-        [](char *c) { dsn::tls_trans_free(c); });
+        static_cast<char *>(dsn::tls_pool_malloc(sizeof(message_header))),
+        [](char *c) { dsn::tls_pool_free(c); });
     msg->header = reinterpret_cast<message_header *>(header_holder.get());
     memset(static_cast<void *>(msg->header), 0, sizeof(message_header));
 
@@ -167,6 +174,7 @@ message_ex *message_ex::create_receive_message_with_standalone_header(const blob
     msg->buffers.push_back(data);
 
     msg->header->body_length = data.length();
+    msg->account_bytes(data.length());
     msg->_is_read = true;
     // we skip the message header
     msg->_rw_index = 1;
@@ -178,8 +186,8 @@ message_ex *message_ex::copy_message_no_reply(const message_ex &old_msg)
 {
     message_ex *msg = new message_ex();
     std::shared_ptr<char> header_holder(
-        static_cast<char *>(dsn::tls_trans_malloc(sizeof(message_header))),
-        [](char *c) { dsn::tls_trans_free(c); });
+        static_cast<char *>(dsn::tls_pool_malloc(sizeof(message_header))),
+        [](char *c) { dsn::tls_pool_free(c); });
     msg->header = reinterpret_cast<message_header *>(header_holder.get());
     memset(msg->header, 0, sizeof(message_header));
     msg->buffers.emplace_back(blob(std::move(header_holder), sizeof(message_header)));
@@ -192,6 +200,7 @@ message_ex *message_ex::copy_message_no_reply(const message_ex &old_msg)
     }
 
     msg->header->body_length = msg->buffers[1].length();
+    msg->account_bytes(msg->header->body_length);
     msg->_is_read = true;
     msg->_rw_index = 1;
     msg->local_rpc_code = old_msg.local_rpc_code;
@@ -268,6 +277,7 @@ message_ex *message_ex::copy(bool clone_content, bool copy_for_receive)
         else
             msg->buffers.push_back(data);
     }
+    msg->account_bytes(body_size());
     return msg;
 }
 
@@ -355,6 +365,7 @@ message_ex *message_ex::create_response()
     msg->to_address = header->from_address;
     msg->io_session = io_session;
     msg->hdr_format = hdr_format;
+    msg->span = span;
 
     if (local_rpc_code != TASK_CODE_INVALID) {
         task_spec *request_sp = task_spec::get(local_rpc_code);
@@ -419,24 +430,15 @@ void message_ex::write_next(void **ptr, size_t *size, size_t min_size)
     ::dsn::tls_trans_mem_next(ptr, size, min_size);
     this->_rw_committed = false;
 
-    // optimization
-    if (this->_rw_index >= 0) {
-        auto &lbb = *this->buffers.rbegin();
-
-        // if the current allocation is within the same buffer with the previous one
-        if (*ptr == lbb.data() + lbb.length() &&
-            ::dsn::tls_trans_memory.block->get() == lbb.buffer_ptr()) {
-            lbb.assign(*::dsn::tls_trans_memory.block,
-                       (int)((char *)(*ptr) - ::dsn::tls_trans_memory.block->get() - lbb.length()),
-                       (int)(lbb.length() + *size));
-
-            return;
-        }
+    // the pieces of the same transient memory block are kept in one buffer, which is usually
+    // the buffer of the header, see prepare_buffer_header
+    if (this->_rw_index >= 0 &&
+        ::dsn::tls_trans_mem_extend_blob(*this->buffers.rbegin(), *ptr, *size)) {
+        return;
     }
 
-    ::dsn::blob buffer((*::dsn::tls_trans_memory.block),
-                       (int)((char *)(*ptr) - ::dsn::tls_trans_memory.block->get()),
-                       (int)(*size));
+    ::dsn::blob buffer;
+    ::dsn::tls_trans_mem_extend_blob(buffer, *ptr, *size);
     this->_rw_index++;
     this->_rw_offset = 0;
     this->buffers.push_back(buffer);
@@ -458,6 +460,25 @@ void message_ex::write_commit(size_t size)
     *this->buffers.rbegin() = this->buffers.rbegin()->range(0, (int)this->_rw_offset);
     this->_rw_committed = true;
     this->header->body_length += (int)size;
+    account_bytes(size);
+}
+
+void message_ex::write_append(const blob &data)
+{
+    dassert(!this->_is_read && this->_rw_committed,
+            "there are pending msg write not committed"
+            ", please invoke dsn_msg_write_next and dsn_msg_write_commit in pairs");
+
+    // the next write_next() never merges into this buffer, as it is not from the
+    // tls_trans_memory
+    this->_rw_index++;
+    this->_rw_offset = data.length();
+    this->buffers.push_back(data);
+    this->header->body_length += data.length();
+    account_bytes(data.length());
+
+    dassert(this->_rw_index + 1 == (int)this->buffers.size(),
+            "message write buffer count is not right");
 }
 
 bool message_ex::read_next(void **ptr, size_t *size)
@@ -527,6 +548,15 @@ void message_ex::restore_read()
     _rw_offset = 0;
 }
 
+bool message_ex::verify_body_crc()
+{
+    if (!_body_crc_deferred) {
+        return true;
+    }
+    _body_crc_deferred = false;
+    return dsn_message_parser::is_right_body(this);
+}
+
 void *message_ex::rw_ptr(size_t offset_begin)
 {
     // printf("%p %s\n", this, __FUNCTION__);
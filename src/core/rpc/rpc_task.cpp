@@ -40,6 +40,10 @@ rpc_request_task::rpc_request_task(message_ex *request, rpc_request_handler &&h,
         "%s is not a RPC_REQUEST task, please use DEFINE_TASK_CODE_RPC to define the task code",
         spec().name.c_str());
     _request->add_ref(); // released in dctor
+
+    if (_request->header->gpid.get_app_id() > 0) {
+        set_accounting_gpid(_request->header->gpid);
+    }
 }
 
 rpc_request_task::~rpc_request_task()
@@ -55,6 +59,13 @@ void rpc_request_task::enqueue()
     task::enqueue(node()->computation()->get_pool(spec().pool_code));
 }
 
+void rpc_request_task::reject(error_code err)
+{
+    _rejected = true;
+    auto resp = _request->create_response();
+    task::get_current_rpc()->reply(resp, err);
+}
+
 rpc_response_task::rpc_response_task(message_ex *request,
                                      const rpc_response_handler &cb,
                                      int hash,
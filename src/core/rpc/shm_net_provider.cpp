@@ -0,0 +1,338 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "shm_net_provider.h"
+#include "shm_rpc_session.h"
+#include "core/rpc/rpc_engine.h"
+
+#include <dsn/utility/flags.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_uint32("network",
+                  shm_ring_capacity_kb,
+                  4096,
+                  "the capacity of the ring in each direction of a session of "
+                  "shm_network_provider, in KB, which should be a power of 2");
+DSN_DEFINE_validator(shm_ring_capacity_kb, [](uint32_t kb) -> bool {
+    return kb >= 4 && kb <= 1024 * 1024 && (kb & (kb - 1)) == 0;
+});
+
+namespace {
+
+// sent by the client on the unix domain socket, along with the fds of the shared memory, the
+// eventfd of the server and the eventfd of the client
+struct shm_hello
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t ring_capacity;
+};
+
+const uint32_t SHM_HELLO_MAGIC = 0x4d485352; // "RSHM"
+const uint32_t SHM_HELLO_VERSION = 1;
+const int SHM_HELLO_FD_COUNT = 3;
+
+// the remote address of the server sessions, an ip of loopback which the tcp clients don't use,
+// so that the server sessions are never mixed up with those of tcp
+const uint32_t SHM_CLIENT_IP = 0x7ffffffe; // 127.255.255.254
+
+bool send_hello(int sock, const shm_hello &hello, const int (&fds)[SHM_HELLO_FD_COUNT])
+{
+    struct iovec iov;
+    iov.iov_base = const_cast<shm_hello *>(&hello);
+    iov.iov_len = sizeof(hello);
+
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    return ::sendmsg(sock, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(hello));
+}
+
+bool recv_hello(int sock, shm_hello &hello, int (&fds)[SHM_HELLO_FD_COUNT])
+{
+    struct iovec iov;
+    iov.iov_base = &hello;
+    iov.iov_len = sizeof(hello);
+
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = ::recvmsg(sock, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    struct cmsghdr *cmsg = n > 0 ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+        return false;
+    }
+    int count = static_cast<int>((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+    int received[SHM_HELLO_FD_COUNT];
+    memcpy(received, CMSG_DATA(cmsg), std::min(count, SHM_HELLO_FD_COUNT) * sizeof(int));
+    if (count != SHM_HELLO_FD_COUNT || n != static_cast<ssize_t>(sizeof(hello)) ||
+        (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0) {
+        for (int i = 0; i < std::min(count, SHM_HELLO_FD_COUNT); ++i) {
+            ::close(received[i]);
+        }
+        return false;
+    }
+    memcpy(fds, received, sizeof(fds));
+    return true;
+}
+
+void close_fds(const int (&fds)[SHM_HELLO_FD_COUNT])
+{
+    for (int fd : fds) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+} // anonymous namespace
+
+shm_network_provider::shm_network_provider(rpc_engine *srv, network *inner_provider)
+    : asio_network_provider(srv, inner_provider), _next_client_port(MAX_CLIENT_PORT + 1)
+{
+}
+
+shm_network_provider::~shm_network_provider()
+{
+    if (_shm_acceptor) {
+        boost::system::error_code ec;
+        _shm_acceptor->close(ec);
+    }
+}
+
+/*static*/ std::string shm_network_provider::socket_name(int port)
+{
+    // in the abstract namespace, which is removed with the socket
+    return std::string(1, '\0') + "rdsn.shm." + std::to_string(port);
+}
+
+error_code shm_network_provider::start(rpc_channel channel, int port, bool client_only)
+{
+    error_code err = asio_network_provider::start(channel, port, client_only);
+    if (err != ERR_OK || client_only || _shm_acceptor) {
+        return err;
+    }
+
+    boost::asio::local::stream_protocol::endpoint endpoint(socket_name(port));
+    boost::system::error_code ec;
+    _shm_acceptor.reset(
+        new boost::asio::local::stream_protocol::acceptor(_reactors[0]->io_service));
+    _shm_acceptor->open(endpoint.protocol(), ec);
+    if (!ec) {
+        _shm_acceptor->bind(endpoint, ec);
+    }
+    if (!ec) {
+        _shm_acceptor->listen(boost::asio::socket_base::max_connections, ec);
+    }
+    if (ec) {
+        // the local clients still reach the server by tcp
+        derror("shm acceptor on port %d failed, error = %s", port, ec.message().c_str());
+        _shm_acceptor.reset();
+        return ERR_OK;
+    }
+
+    do_accept_shm();
+    return ERR_OK;
+}
+
+void shm_network_provider::do_accept_shm()
+{
+    auto socket =
+        std::make_shared<boost::asio::local::stream_protocol::socket>(_reactors[0]->io_service);
+    _shm_acceptor->async_accept(*socket, [this, socket](boost::system::error_code ec) {
+        if (!ec) {
+            on_shm_accepted(socket);
+        } else if (ec == boost::asio::error::operation_aborted) {
+            // the acceptor is closed
+            return;
+        }
+
+        do_accept_shm();
+    });
+}
+
+void shm_network_provider::on_shm_accepted(
+    std::shared_ptr<boost::asio::local::stream_protocol::socket> socket)
+{
+    // wait for the hello sent right after the connecting
+    auto on_readable = [this, socket](boost::system::error_code ec, std::size_t) {
+        if (ec) {
+            dwarn("shm handover failed, error = %s", ec.message().c_str());
+        } else {
+            on_shm_hello(socket);
+        }
+    };
+    socket->async_read_some(boost::asio::null_buffers(), on_readable);
+}
+
+void shm_network_provider::on_shm_hello(
+    std::shared_ptr<boost::asio::local::stream_protocol::socket> socket)
+{
+    shm_hello hello;
+    int fds[SHM_HELLO_FD_COUNT] = {-1, -1, -1};
+    struct stat st;
+    if (!recv_hello(socket->native_handle(), hello, fds) || hello.magic != SHM_HELLO_MAGIC ||
+        hello.version != SHM_HELLO_VERSION || hello.ring_capacity < 4096 ||
+        (hello.ring_capacity & (hello.ring_capacity - 1)) != 0 || ::fstat(fds[0], &st) != 0 ||
+        static_cast<uint64_t>(st.st_size) != shm_rpc_session::shm_size(hello.ring_capacity)) {
+        derror("shm handover failed, invalid hello");
+        close_fds(fds);
+        return;
+    }
+
+    // the shared memory, the eventfd of the server, and the one of the client
+    reactor &r = select_reactor();
+    message_parser_ptr null_parser;
+    shm_rpc_session *session = new shm_rpc_session(*this,
+                                                   next_client_address(),
+                                                   socket,
+                                                   fds[0],
+                                                   hello.ring_capacity,
+                                                   false,
+                                                   fds[1],
+                                                   fds[2],
+                                                   null_parser,
+                                                   false,
+                                                   r.index);
+    rpc_session_ptr s(session);
+    if (!session->is_mapped()) {
+        s->close();
+        return;
+    }
+
+    r.session_count.fetch_add(1, std::memory_order_relaxed);
+    r.session_count_counter->increment();
+    on_server_session_accepted(s);
+
+    // we should start read immediately after the rpc session is completely created.
+    s->start_read_next();
+    session->watch_socket();
+}
+
+::dsn::rpc_address shm_network_provider::next_client_address()
+{
+    utils::auto_read_lock l(_servers_lock);
+    for (int i = 0; i <= UINT16_MAX; ++i) {
+        uint32_t port = _next_client_port.fetch_add(1) % (UINT16_MAX + 1);
+        if (port <= MAX_CLIENT_PORT) {
+            continue;
+        }
+        ::dsn::rpc_address addr(SHM_CLIENT_IP, static_cast<uint16_t>(port));
+        if (_servers.find(addr) == _servers.end()) {
+            return addr;
+        }
+    }
+    // all the ports are taken, which is almost impossible
+    return ::dsn::rpc_address(SHM_CLIENT_IP, MAX_CLIENT_PORT + 1);
+}
+
+rpc_session_ptr shm_network_provider::create_client_session(::dsn::rpc_address server_addr)
+{
+    // only the servers on the same host
+    uint32_t ip = server_addr.ip();
+    if ((ip >> 24) == 127 || ip == address().ip()) {
+        rpc_session_ptr s = create_shm_client_session(server_addr);
+        if (s != nullptr) {
+            return s;
+        }
+    }
+    return asio_network_provider::create_client_session(server_addr);
+}
+
+rpc_session_ptr shm_network_provider::create_shm_client_session(::dsn::rpc_address server_addr)
+{
+    reactor &r = select_reactor();
+    auto socket = std::make_shared<boost::asio::local::stream_protocol::socket>(r.io_service);
+    boost::system::error_code ec;
+    // connecting to a local socket doesn't block
+    socket->connect(boost::asio::local::stream_protocol::endpoint(
+                        socket_name(server_addr.port())),
+                    ec);
+    if (ec) {
+        dinfo("shm server %s is not present, use tcp instead, error = %s",
+              server_addr.to_string(),
+              ec.message().c_str());
+        return nullptr;
+    }
+
+    shm_hello hello;
+    hello.magic = SHM_HELLO_MAGIC;
+    hello.version = SHM_HELLO_VERSION;
+    hello.ring_capacity = static_cast<uint64_t>(FLAGS_shm_ring_capacity_kb) * 1024;
+
+    // the shared memory, the eventfd of the server, and the one of the client
+    int fds[SHM_HELLO_FD_COUNT] = {
+        static_cast<int>(::syscall(SYS_memfd_create, "rdsn.shm", 1U /*MFD_CLOEXEC*/)),
+        ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC),
+        ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)};
+    if (fds[0] < 0 || fds[1] < 0 || fds[2] < 0 ||
+        ::ftruncate(fds[0], shm_rpc_session::shm_size(hello.ring_capacity)) != 0) {
+        derror("create shm for %s failed, use tcp instead, err = %s",
+               server_addr.to_string(),
+               strerror(errno));
+        close_fds(fds);
+        return nullptr;
+    }
+
+    // the memfd and the eventfd of the client are taken by the session, and all the fds are
+    // duplicated to the server by the hello
+    int memfd = ::dup(fds[0]);
+    message_parser_ptr parser(new_message_parser(_client_hdr_format));
+    shm_rpc_session *session = new shm_rpc_session(*this,
+                                                   server_addr,
+                                                   socket,
+                                                   memfd,
+                                                   hello.ring_capacity,
+                                                   true,
+                                                   fds[2],
+                                                   fds[1],
+                                                   parser,
+                                                   true,
+                                                   r.index);
+    rpc_session_ptr s(session);
+    bool sent = session->is_mapped() && send_hello(socket->native_handle(), hello, fds);
+    // the eventfds are closed by the session
+    ::close(fds[0]);
+    if (!sent) {
+        derror("shm handover to %s failed, use tcp instead, err = %s",
+               server_addr.to_string(),
+               strerror(errno));
+        s->close();
+        return nullptr;
+    }
+
+    r.session_count.fetch_add(1, std::memory_order_relaxed);
+    r.session_count_counter->increment();
+    return s;
+}
+
+} // namespace tools
+} // namespace dsn
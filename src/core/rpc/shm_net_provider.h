@@ -0,0 +1,53 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "asio_net_provider.h"
+
+namespace dsn {
+namespace tools {
+
+// shm_network_provider passes the messages to the peers on the same host through the shared
+// memory rather than the loopback tcp connections, e.g. between a proxy and the replica server
+// on its host:
+//
+//   network.client.RPC_CHANNEL_TCP = dsn::tools::shm_network_provider, 65536
+//   network.server.0.RPC_CHANNEL_TCP = dsn::tools::shm_network_provider, 65536
+//
+// Besides the tcp port, a server listens on the unix domain socket "@rdsn.shm.<port>" in the
+// abstract namespace, on which a client of the same host hands over the shared memory and the
+// eventfds of a new shm_rpc_session. The sessions to the remote servers, or to the local ones
+// not listening on the unix domain socket, are created on tcp as asio_network_provider does.
+class shm_network_provider : public asio_network_provider
+{
+public:
+    shm_network_provider(rpc_engine *srv, network *inner_provider);
+
+    ~shm_network_provider() override;
+
+    error_code start(rpc_channel channel, int port, bool client_only) override;
+    rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) override;
+
+    // the name of the unix domain socket of the server on `port`
+    static std::string socket_name(int port);
+
+private:
+    friend class shm_rpc_session;
+
+    // returns nullptr if the server doesn't listen on the unix domain socket
+    rpc_session_ptr create_shm_client_session(::dsn::rpc_address server_addr);
+    void do_accept_shm();
+    void on_shm_accepted(std::shared_ptr<boost::asio::local::stream_protocol::socket> socket);
+    void on_shm_hello(std::shared_ptr<boost::asio::local::stream_protocol::socket> socket);
+    // the remote address of a new server session, unique among the server sessions
+    ::dsn::rpc_address next_client_address();
+
+private:
+    std::shared_ptr<boost::asio::local::stream_protocol::acceptor> _shm_acceptor;
+    std::atomic<uint32_t> _next_client_port;
+};
+
+} // namespace tools
+} // namespace dsn
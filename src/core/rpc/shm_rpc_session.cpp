@@ -0,0 +1,352 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "shm_rpc_session.h"
+#include "shm_net_provider.h"
+#include "core/task/task_engine.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace dsn {
+namespace tools {
+
+// copies at most `size` bytes into the ring, returns the bytes copied
+static size_t ring_write(shm_ring *r, const char *buf, size_t size)
+{
+    uint64_t write_pos = r->write_pos.load(std::memory_order_relaxed);
+    uint64_t space = r->capacity - (write_pos - r->read_pos.load(std::memory_order_acquire));
+    size_t n = static_cast<size_t>(std::min<uint64_t>(size, space));
+    size_t offset = static_cast<size_t>(write_pos & (r->capacity - 1));
+    size_t first = std::min<size_t>(n, r->capacity - offset);
+    memcpy(r->data() + offset, buf, first);
+    memcpy(r->data(), buf + first, n - first);
+    r->write_pos.store(write_pos + n, std::memory_order_release);
+    return n;
+}
+
+// copies at most `size` bytes out of the ring, returns the bytes copied
+static size_t ring_read(shm_ring *r, char *buf, size_t size)
+{
+    uint64_t read_pos = r->read_pos.load(std::memory_order_relaxed);
+    uint64_t data = r->write_pos.load(std::memory_order_acquire) - read_pos;
+    size_t n = static_cast<size_t>(std::min<uint64_t>(size, data));
+    size_t offset = static_cast<size_t>(read_pos & (r->capacity - 1));
+    size_t first = std::min<size_t>(n, r->capacity - offset);
+    memcpy(buf, r->data() + offset, first);
+    memcpy(buf + first, r->data(), n - first);
+    r->read_pos.store(read_pos + n, std::memory_order_release);
+    return n;
+}
+
+// signals `efd` if the other side waits on `waiting`, after the ring is written or read
+static void ring_notify(std::atomic<uint32_t> &waiting, int efd)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed) != 0 && waiting.exchange(0) != 0) {
+        uint64_t one = 1;
+        if (::write(efd, &one, sizeof(one)) != sizeof(one)) {
+            dwarn("signal eventfd %d failed, err = %s", efd, strerror(errno));
+        }
+    }
+}
+
+// sets `waiting` before the side waits, and returns whether it should still wait, i.e. the ring
+// is still not readable (for the consumer) or writable (for the producer) after that
+static bool ring_prepare_wait(shm_ring *r, std::atomic<uint32_t> &waiting, bool is_producer)
+{
+    waiting.store(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t used = r->write_pos.load(std::memory_order_acquire) -
+                    r->read_pos.load(std::memory_order_acquire);
+    bool should_wait = is_producer ? used == r->capacity : used == 0;
+    if (!should_wait) {
+        waiting.store(0, std::memory_order_relaxed);
+    }
+    return should_wait;
+}
+
+shm_rpc_session::shm_rpc_session(shm_network_provider &net,
+                                 ::dsn::rpc_address remote_addr,
+                                 std::shared_ptr<socket_type> &socket,
+                                 int memfd,
+                                 uint64_t ring_capacity,
+                                 bool init,
+                                 int local_efd,
+                                 int remote_efd,
+                                 message_parser_ptr &parser,
+                                 bool is_client,
+                                 int reactor_index)
+    : rpc_session(net, remote_addr, parser, is_client),
+      _socket(socket),
+      _io_service(static_cast<asio_network_provider &>(net)._reactors[reactor_index]->io_service),
+      _strand(_io_service),
+      _local_efd(_io_service, local_efd),
+      _remote_efd(remote_efd),
+      _closed(false),
+      _shm(nullptr),
+      _shm_size(shm_size(ring_capacity)),
+      _send_ring(nullptr),
+      _recv_ring(nullptr),
+      _read_next(0),
+      _read_waiting(false),
+      _write_signature(0),
+      _write_buffer_index(0),
+      _write_offset(0),
+      _write_waiting(false),
+      _event_waiting(false),
+      _event_value(0),
+      _socket_byte(0),
+      _reactor_index(reactor_index)
+{
+    void *shm = ::mmap(nullptr, _shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    ::close(memfd);
+    if (shm == MAP_FAILED) {
+        derror("mmap the shared memory of %" PRIu64 " bytes failed, err = %s",
+               static_cast<uint64_t>(_shm_size),
+               strerror(errno));
+        return;
+    }
+    _shm = shm;
+
+    // the ring from the client to the server goes first
+    auto *rings = static_cast<char *>(_shm);
+    auto *c2s = reinterpret_cast<shm_ring *>(rings);
+    auto *s2c = reinterpret_cast<shm_ring *>(rings + sizeof(shm_ring) + ring_capacity);
+    if (init) {
+        for (shm_ring *r : {c2s, s2c}) {
+            new (r) shm_ring();
+            r->write_pos.store(0);
+            r->read_pos.store(0);
+            r->consumer_waiting.store(0);
+            r->producer_waiting.store(0);
+            r->capacity = ring_capacity;
+        }
+    }
+    _send_ring = is_client ? c2s : s2c;
+    _recv_ring = is_client ? s2c : c2s;
+}
+
+shm_rpc_session::~shm_rpc_session()
+{
+    if (_shm != nullptr) {
+        ::munmap(_shm, _shm_size);
+    }
+    ::close(_remote_efd);
+}
+
+void shm_rpc_session::do_read(int read_next)
+{
+    add_ref();
+    _strand.post([this, read_next]() {
+        _read_next = read_next;
+        read_ring();
+        release_ref();
+    });
+}
+
+void shm_rpc_session::read_ring()
+{
+    while (!_closed.load(std::memory_order_relaxed)) {
+        void *ptr = _reader.read_buffer_ptr(_read_next);
+        int remaining = _reader.read_buffer_capacity();
+        size_t length = ring_read(_recv_ring, static_cast<char *>(ptr), remaining);
+        if (length == 0) {
+            if (ring_prepare_wait(_recv_ring, _recv_ring->consumer_waiting, false)) {
+                _read_waiting = true;
+                wait_event();
+                return;
+            }
+            continue;
+        }
+        ring_notify(_recv_ring->producer_waiting, _remote_efd);
+
+        static_cast<asio_network_provider &>(_net).on_session_read(_reactor_index, length);
+        _reader.mark_read(length);
+
+        int read_next = -1;
+
+        if (!_parser) {
+            read_next = prepare_parser();
+        }
+
+        if (_parser) {
+            // the tasks of all the messages of this read are enqueued at once
+            enqueue_batch_scope batch;
+            message_ex *msg = _parser->get_message_on_receive(&_reader, read_next);
+
+            while (msg != nullptr) {
+                this->on_message_read(msg);
+                msg = _parser->get_message_on_receive(&_reader, read_next);
+            }
+        }
+
+        if (read_next == -1) {
+            derror("shm read from %s failed", _remote_addr.to_string());
+            on_failure();
+        } else {
+            start_read_next(read_next);
+        }
+        return;
+    }
+}
+
+void shm_rpc_session::send(uint64_t signature)
+{
+    _write_signature = signature;
+    _write_buffer_index = 0;
+    _write_offset = 0;
+    write_ring();
+}
+
+void shm_rpc_session::write_ring()
+{
+    while (_write_buffer_index < _sending_buffers.size()) {
+        if (_closed.load(std::memory_order_relaxed)) {
+            derror("shm write to %s failed: session closed", _remote_addr.to_string());
+            on_failure(true);
+            return;
+        }
+
+        const message_parser::send_buf &buf = _sending_buffers[_write_buffer_index];
+        size_t length = ring_write(
+            _send_ring, static_cast<const char *>(buf.buf) + _write_offset, buf.sz - _write_offset);
+        if (length > 0) {
+            ring_notify(_send_ring->consumer_waiting, _remote_efd);
+            _write_offset += length;
+            if (_write_offset == buf.sz) {
+                ++_write_buffer_index;
+                _write_offset = 0;
+            }
+            continue;
+        }
+
+        // the ring is full, wait for the peer to read, by which the writing is continued in
+        // the event handler, unless the ring is read right now
+        _write_waiting.store(true);
+        if (ring_prepare_wait(_send_ring, _send_ring->producer_waiting, true)) {
+            wait_event();
+            return;
+        }
+        if (!_write_waiting.exchange(false)) {
+            // taken over by the event handler
+            return;
+        }
+    }
+
+    // completed in the io service, as the next messages may be sent by on_send_completed(),
+    // which would call into here recursively
+    add_ref();
+    uint64_t signature = _write_signature;
+    _io_service.post([this, signature]() {
+        on_send_completed(signature);
+        release_ref();
+    });
+}
+
+void shm_rpc_session::wait_event()
+{
+    if (_event_waiting.exchange(true)) {
+        return;
+    }
+
+    utils::auto_read_lock fd_guard(_fd_lock);
+    if (!_local_efd.is_open()) {
+        _event_waiting.store(false);
+        return;
+    }
+
+    add_ref();
+    _local_efd.async_read_some(
+        boost::asio::buffer(&_event_value, sizeof(_event_value)),
+        _strand.wrap([this](boost::system::error_code ec, std::size_t length) {
+            _event_waiting.store(false);
+            if (ec) {
+                if (ec != boost::asio::error::operation_aborted) {
+                    derror("shm wait for %s failed: %s",
+                           _remote_addr.to_string(),
+                           ec.message().c_str());
+                }
+                on_failure();
+            } else {
+                if (_read_waiting) {
+                    _read_waiting = false;
+                    read_ring();
+                }
+                if (_write_waiting.exchange(false)) {
+                    write_ring();
+                }
+            }
+            release_ref();
+        }));
+}
+
+void shm_rpc_session::watch_socket()
+{
+    add_ref();
+
+    utils::auto_read_lock fd_guard(_fd_lock);
+    // nothing is sent on the socket after the handover, so any read ends the session
+    _socket->async_read_some(
+        boost::asio::buffer(&_socket_byte, sizeof(_socket_byte)),
+        [this](boost::system::error_code ec, std::size_t length) {
+            if (!ec) {
+                derror("shm socket of %s received unexpected data", _remote_addr.to_string());
+            } else if (ec == boost::asio::error::eof ||
+                       ec == boost::asio::error::operation_aborted) {
+                ddebug("shm socket of %s closed: %s",
+                       _remote_addr.to_string(),
+                       ec.message().c_str());
+            } else {
+                derror("shm socket of %s failed: %s",
+                       _remote_addr.to_string(),
+                       ec.message().c_str());
+            }
+            on_failure();
+            release_ref();
+        });
+}
+
+void shm_rpc_session::on_failure(bool is_write)
+{
+    if (on_disconnected(is_write)) {
+        static_cast<asio_network_provider &>(_net).on_session_closed(_reactor_index);
+        close();
+    }
+}
+
+void shm_rpc_session::close()
+{
+    _closed.store(true);
+
+    utils::auto_write_lock fd_guard(_fd_lock);
+
+    boost::system::error_code ec;
+    _socket->shutdown(boost::asio::socket_base::shutdown_type::shutdown_both, ec);
+    if (ec)
+        dwarn("shm socket shutdown failed, error = %s", ec.message().c_str());
+    _socket->close(ec);
+    if (ec)
+        dwarn("shm socket close failed, error = %s", ec.message().c_str());
+    _local_efd.close(ec);
+    if (ec)
+        dwarn("shm eventfd close failed, error = %s", ec.message().c_str());
+}
+
+void shm_rpc_session::connect()
+{
+    // the shared memory is handed over when the session is created, see
+    // shm_network_provider::create_shm_client_session()
+    if (set_connecting()) {
+        dinfo("client session %s connected by shm", _remote_addr.to_string());
+
+        set_connected();
+        on_send_completed();
+        start_read_next();
+        watch_socket();
+    }
+}
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,134 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <dsn/tool-api/network.h>
+#include <boost/asio.hpp>
+#include <atomic>
+#include <memory>
+
+namespace dsn {
+namespace tools {
+
+class shm_network_provider;
+
+// A single-producer single-consumer ring of bytes in the shared memory, followed by the
+// `capacity` bytes of its data. The positions only grow, of which the offsets in the data are
+// the remainders of `capacity`.
+//
+// A side going to wait sets its flag before checking the ring again, and the other side signals
+// the eventfd of the waiting side after it writes or reads if the flag is set, so that no wakeup
+// is lost.
+struct shm_ring
+{
+    alignas(64) std::atomic<uint64_t> write_pos;
+    alignas(64) std::atomic<uint64_t> read_pos;
+    alignas(64) std::atomic<uint32_t> consumer_waiting;
+    std::atomic<uint32_t> producer_waiting;
+    uint64_t capacity; // a power of 2
+
+    char *data() { return reinterpret_cast<char *>(this + 1); }
+};
+
+// A session through the rings in the shared memory between two processes on the same host,
+// one ring in each direction. Each side waits on its own eventfd, which the other side signals
+// when there is data to read or space to write, and the unix domain socket on which the shared
+// memory and the eventfds are handed over is kept only to detect the closing of the peer.
+//
+// The messages are sent in the same format as on tcp, so they are parsed by the same parsers.
+// The sending side copies the messages into the ring on the sending thread, and the receiving
+// side reads them by the io service of its reactor.
+// Thread-safe
+class shm_rpc_session : public rpc_session
+{
+public:
+    typedef boost::asio::local::stream_protocol::socket socket_type;
+
+    // the shared memory of `memfd` is mapped, and the 2 rings in it are initialized if `init` is
+    // set. the fds are taken by the session, and is_mapped() should be checked before use.
+    shm_rpc_session(shm_network_provider &net,
+                    ::dsn::rpc_address remote_addr,
+                    std::shared_ptr<socket_type> &socket,
+                    int memfd,
+                    uint64_t ring_capacity,
+                    bool init,
+                    int local_efd,
+                    int remote_efd,
+                    message_parser_ptr &parser,
+                    bool is_client,
+                    int reactor_index);
+
+    ~shm_rpc_session() override;
+
+    void send(uint64_t signature) override;
+
+    void close() override;
+
+    void connect() override;
+
+    bool is_mapped() const { return _shm != nullptr; }
+
+    static size_t shm_size(uint64_t ring_capacity)
+    {
+        return 2 * (sizeof(shm_ring) + ring_capacity);
+    }
+
+    // starts to detect the closing of the peer, for the server sessions
+    void watch_socket();
+
+private:
+    void do_read(int read_next) override;
+    void on_failure(bool is_write = false);
+    void on_message_read(message_ex *msg)
+    {
+        if (!on_recv_message(msg, 0)) {
+            on_failure(false);
+        }
+    }
+
+    // reads the ring until it is empty or a read is started next, run in _strand
+    void read_ring();
+    // writes the sending messages into the ring until all of them are written or the ring is
+    // full, run by only one thread at a time
+    void write_ring();
+    // waits for the eventfd to be signaled, if not waiting yet
+    void wait_event();
+
+private:
+    std::shared_ptr<socket_type> _socket;
+    boost::asio::io_service &_io_service;
+    boost::asio::io_service::strand _strand;
+    // the eventfd signaled by the peer, and the one to signal the peer
+    boost::asio::posix::stream_descriptor _local_efd;
+    int _remote_efd;
+    // guards the socket and the eventfds from being closed while being used
+    ::dsn::utils::rw_lock_nr _fd_lock;
+    std::atomic<bool> _closed;
+
+    void *_shm;
+    size_t _shm_size;
+    shm_ring *_send_ring;
+    shm_ring *_recv_ring;
+
+    // of the reading, only accessed in _strand
+    int _read_next;
+    bool _read_waiting;
+
+    // of the sending messages being written
+    uint64_t _write_signature;
+    size_t _write_buffer_index;
+    size_t _write_offset;
+    std::atomic<bool> _write_waiting;
+
+    std::atomic<bool> _event_waiting;
+    uint64_t _event_value;
+    char _socket_byte;
+
+    // the reactor of asio_network_provider which the session belongs to
+    const int _reactor_index;
+};
+
+} // namespace tools
+} // namespace dsn
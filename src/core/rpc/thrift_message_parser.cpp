@@ -33,6 +33,7 @@
 #include <dsn/utility/ports.h>
 #include <dsn/utility/crc.h>
 #include <dsn/utility/endians.h>
+#include <dsn/utility/utils.h>
 #include <dsn/tool-api/rpc_message.h>
 
 namespace dsn {
@@ -83,36 +84,96 @@ static int32_t gpid_to_thread_hash(gpid id)
     return id.get_app_id() * magic_number + id.get_partition_index();
 }
 
-// Reads the requests's name, seqid, and TMessageType from the binary data,
-// and constructs a `message_ex` object.
-static message_ex *create_message_from_request_blob(const blob &body_data)
+// the version of the thrift binary protocol in the strict message begin
+static constexpr uint32_t THRIFT_VERSION_1 = 0x80010000;
+static constexpr uint32_t THRIFT_VERSION_MASK = 0xffff0000;
+
+static bool read_be32(string_view &data, /*out*/ uint32_t &val)
 {
-    dsn::message_ex *msg = message_ex::create_receive_message_with_standalone_header(body_data);
-    dsn::message_header *dsn_hdr = msg->header;
+    if (data.size() < sizeof(uint32_t)) {
+        return false;
+    }
+    memcpy(&val, data.data(), sizeof(uint32_t));
+    val = be32toh(val);
+    data.remove_prefix(sizeof(uint32_t));
+    return true;
+}
 
-    dsn::rpc_read_stream stream(msg);
-    ::dsn::binary_reader_transport binary_transport(stream);
-    boost::shared_ptr<::dsn::binary_reader_transport> trans_ptr(
-        &binary_transport, [](::dsn::binary_reader_transport *) {});
-    ::apache::thrift::protocol::TBinaryProtocol iprot(trans_ptr);
+// Reads the message begin of thrift binary protocol, in both the strict and the old formats,
+// directly from `data` rather than through a TBinaryProtocol and its transport, and returns
+// the bytes read, or 0 if `data` is not a valid message begin.
+static size_t read_message_begin(string_view data,
+                                 /*out*/ string_view &name,
+                                 /*out*/ int32_t &mtype,
+                                 /*out*/ int32_t &seqid)
+{
+    size_t total = data.size();
+    uint32_t sz = 0;
+    if (!read_be32(data, sz)) {
+        return 0;
+    }
 
-    std::string fname;
-    ::apache::thrift::protocol::TMessageType mtype;
-    int32_t seqid;
-    iprot.readMessageBegin(fname, mtype, seqid);
-    dsn_hdr->id = seqid;
-    strncpy(dsn_hdr->rpc_name, fname.c_str(), sizeof(dsn_hdr->rpc_name) - 1);
-    dsn_hdr->rpc_name[sizeof(dsn_hdr->rpc_name) - 1] = '\0';
+    uint32_t name_length = sz;
+    // the strict format begins with a negative version
+    bool strict = (sz & 0x80000000) != 0;
+    if (strict) {
+        if ((sz & THRIFT_VERSION_MASK) != THRIFT_VERSION_1 || !read_be32(data, name_length)) {
+            return 0;
+        }
+        mtype = static_cast<int32_t>(sz & 0x000000ff);
+    }
+    if (name_length > data.size()) {
+        return 0;
+    }
+    name = data.substr(0, name_length);
+    data.remove_prefix(name_length);
+    if (!strict) {
+        if (data.empty()) {
+            return 0;
+        }
+        mtype = static_cast<int8_t>(data[0]);
+        data.remove_prefix(1);
+    }
+
+    uint32_t id = 0;
+    if (!read_be32(data, id)) {
+        return 0;
+    }
+    seqid = static_cast<int32_t>(id);
+    return total - data.size();
+}
 
-    if (mtype == ::apache::thrift::protocol::T_CALL ||
-        mtype == ::apache::thrift::protocol::T_ONEWAY) {
-        dsn_hdr->context.u.is_request = 1;
+// Reads the requests's name, seqid, and TMessageType from the binary data,
+// and constructs a `message_ex` object, which references `body_data` without copying.
+static message_ex *create_message_from_request_blob(const blob &body_data)
+{
+    string_view fname;
+    int32_t mtype = 0;
+    int32_t seqid = 0;
+    size_t begin_length =
+        read_message_begin(string_view(body_data.data(), body_data.length()), fname, mtype, seqid);
+    if (begin_length == 0) {
+        derror("invalid thrift message begin");
+        return nullptr;
     }
-    if (dsn_hdr->context.u.is_request != 1) {
+    if (mtype != ::apache::thrift::protocol::T_CALL &&
+        mtype != ::apache::thrift::protocol::T_ONEWAY) {
         derror("invalid message type: %d", mtype);
-        delete msg;
         return nullptr;
     }
+
+    dsn::message_ex *msg = message_ex::create_receive_message_with_standalone_header(body_data);
+    dsn::message_header *dsn_hdr = msg->header;
+    dsn_hdr->id = seqid;
+    size_t name_length = std::min(fname.size(), sizeof(dsn_hdr->rpc_name) - 1);
+    memcpy(dsn_hdr->rpc_name, fname.data(), name_length);
+    dsn_hdr->rpc_name[name_length] = '\0';
+    dsn_hdr->context.u.is_request = 1;
+
+    // the message begin is consumed, as what the thrift protocol does
+    blob bb;
+    msg->read_next(bb);
+    msg->read_commit(begin_length);
     dsn_hdr->context.u.serialize_format = DSF_THRIFT_BINARY; // always serialize in thrift binary
 
     // common fields
@@ -196,7 +257,8 @@ message_ex *thrift_message_parser::parse_request_body_v0(message_reader *reader,
         return nullptr;
     }
 
-    message_ex *msg = create_message_from_request_blob(buf);
+    // the body is a slice of the read buffer
+    message_ex *msg = create_message_from_request_blob(buf.range(0, _meta_v0->body_length));
     if (msg == nullptr) {
         read_next = -1;
         reset();
@@ -243,7 +305,9 @@ message_ex *thrift_message_parser::parse_request_body_v1(message_reader *reader,
         read_next = _v1_specific_vars->_body_length - buf.size();
         return nullptr;
     }
-    message_ex *msg = create_message_from_request_blob(buf);
+    // the body is a slice of the read buffer
+    message_ex *msg =
+        create_message_from_request_blob(buf.range(0, _v1_specific_vars->_body_length));
     if (msg == nullptr) {
         read_next = -1;
         reset();
@@ -310,33 +374,30 @@ void thrift_message_parser::prepare_on_send(message_ex *msg)
     dassert(header->server.error_name[0], "error name should be set");
     dassert(!buffers.empty(), "buffers can not be empty");
 
-    // write thrift response header and thrift message begin
-    binary_writer header_writer;
-    binary_writer_transport header_trans(header_writer);
-    boost::shared_ptr<binary_writer_transport> header_trans_ptr(&header_trans,
-                                                                [](binary_writer_transport *) {});
-    ::apache::thrift::protocol::TBinaryProtocol header_proto(header_trans_ptr);
-    // first total length, but we don't know the length, so firstly we put a placeholder
-    header_proto.writeI32(0);
-    // then the error_message
-    header_proto.writeString(string_view(header->server.error_name));
-    // then the thrift message begin
-    header_proto.writeMessageBegin(
-        header->rpc_name, ::apache::thrift::protocol::T_REPLY, header->id);
-
-    // write thrift message end
-    binary_writer end_writer;
-    binary_writer_transport end_trans(header_writer);
-    boost::shared_ptr<binary_writer_transport> end_trans_ptr(&end_trans,
-                                                             [](binary_writer_transport *) {});
-    ::apache::thrift::protocol::TBinaryProtocol end_proto(end_trans_ptr);
-    end_proto.writeMessageEnd();
-
-    // now let's set the total length
-    blob header_bb = header_writer.get_buffer();
-    blob end_bb = end_writer.get_buffer();
-    int32_t *total_length = reinterpret_cast<int32_t *>((void *)header_bb.data());
-    *total_length = htobe32(header_bb.length() + header->body_length + end_bb.length());
+    // write thrift response header and thrift message begin in the binary protocol directly:
+    //   <total_len(i32)> <error_name(i32 + bytes)>
+    //   <version | T_REPLY(i32)> <rpc_name(i32 + bytes)> <seqid(i32)>
+    // the thrift message end writes nothing in the binary protocol.
+    size_t error_length = strnlen(header->server.error_name, sizeof(header->server.error_name));
+    size_t name_length = strnlen(header->rpc_name, sizeof(header->rpc_name));
+    size_t header_length = 5 * sizeof(uint32_t) + error_length + name_length;
+    std::shared_ptr<char> header_holder(utils::make_shared_array<char>(header_length));
+    char *p = header_holder.get();
+    auto write_be32 = [&p](uint32_t val) {
+        val = htobe32(val);
+        memcpy(p, &val, sizeof(val));
+        p += sizeof(val);
+    };
+    write_be32(header_length + header->body_length);
+    write_be32(error_length);
+    memcpy(p, header->server.error_name, error_length);
+    p += error_length;
+    write_be32(THRIFT_VERSION_1 | ::apache::thrift::protocol::T_REPLY);
+    write_be32(name_length);
+    memcpy(p, header->rpc_name, name_length);
+    p += name_length;
+    write_be32(static_cast<uint32_t>(header->id));
+    blob header_bb(std::move(header_holder), header_length);
 
     unsigned int dsn_size = sizeof(message_header) + header->body_length;
     int dsn_buf_count = 0;
@@ -348,10 +409,9 @@ void thrift_message_parser::prepare_on_send(message_ex *msg)
     }
     dassert(dsn_size == 0, "dsn_size = %u", dsn_size);
 
-    // put header_bb and end_bb at the end
+    // put header_bb at the end, which is sent ahead of the body in a separate send_buf
     buffers.resize(dsn_buf_count);
     buffers.emplace_back(std::move(header_bb));
-    buffers.emplace_back(std::move(end_bb));
 }
 
 int thrift_message_parser::get_buffers_on_send(message_ex *msg, /*out*/ send_buf *buffers)
@@ -381,21 +441,13 @@ int thrift_message_parser::get_buffers_on_send(message_ex *msg, /*out*/ send_buf
         ++i;
     }
     dassert(dsn_size == 0, "dsn_size = %u", dsn_size);
-    dassert(dsn_buf_count + 2 == msg_buffers.size(), "must have 2 more blob at the end");
+    dassert(dsn_buf_count + 1 == msg_buffers.size(), "must have 1 more blob at the end");
 
     // set header
     blob &header_bb = msg_buffers[dsn_buf_count];
     buffers[0].buf = (void *)header_bb.data();
     buffers[0].sz = header_bb.length();
 
-    // set end if need
-    blob &end_bb = msg_buffers[dsn_buf_count + 1];
-    if (end_bb.length() > 0) {
-        buffers[i].buf = (void *)end_bb.data();
-        buffers[i].sz = end_bb.length();
-        ++i;
-    }
-
     return i;
 }
 
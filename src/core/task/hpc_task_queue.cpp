@@ -52,6 +52,14 @@ void hpc_concurrent_task_queue::enqueue(task *task)
     _sema.signal(1);
 }
 
+void hpc_concurrent_task_queue::enqueue_batch(const std::vector<task *> &tasks)
+{
+    for (task *t : tasks) {
+        _queues[t->spec().priority].q.enqueue(t);
+    }
+    _sema.signal(static_cast<int>(tasks.size()));
+}
+
 task *hpc_concurrent_task_queue::dequeue(int &batch_size)
 {
     batch_size = _sema.waitMany(batch_size);
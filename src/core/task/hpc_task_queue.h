@@ -55,6 +55,8 @@ public:
 
     void enqueue(task *task) override;
 
+    void enqueue_batch(const std::vector<task *> &tasks) override;
+
     task *dequeue(/*inout*/ int &batch_size) override;
 };
 }
@@ -86,6 +86,12 @@ simple_task_queue::simple_task_queue(task_worker_pool *pool, int index, task_que
 
 void simple_task_queue::enqueue(task *task) { _samples.enqueue(task, task->spec().priority); }
 
+void simple_task_queue::enqueue_batch(const std::vector<task *> &tasks)
+{
+    _samples.enqueue_batch(tasks,
+                           [](task *t) { return static_cast<uint32_t>(t->spec().priority); });
+}
+
 // always return 1 or 0 task so far
 task *simple_task_queue::dequeue(/*inout*/ int &batch_size)
 {
@@ -40,6 +40,7 @@ public:
     ~simple_task_queue() override = default;
 
     virtual void enqueue(task *task) override;
+    void enqueue_batch(const std::vector<task *> &tasks) override;
     virtual task *dequeue(/*inout*/ int &batch_size) override;
 
 private:
@@ -42,8 +42,10 @@
 #include <dsn/utility/rand.h>
 #include <dsn/tool/node_scoper.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/tool-api/task_cpu_accounting.h>
 
 #include "task_engine.h"
+#include "task_latency_sampler.h"
 #include "core/core/service_engine.h"
 #include "core/rpc/rpc_engine.h"
 
@@ -134,6 +136,10 @@ task::task(dsn::task_code code, int hash, service_node *node)
     }
 
     _task_id = tls_dsn.node_pool_thread_ids + (++tls_dsn.last_lower32_task_id);
+
+    if (tls_dsn.current_task != nullptr) {
+        _accounting_gpid = tls_dsn.current_task->_accounting_gpid;
+    }
 }
 
 task::~task()
@@ -169,12 +175,36 @@ void task::exec_internal()
         dassert(tls_dsn.magic == 0xdeadbeef, "thread is not inited with task::set_tls_dsn_context");
 
         task *parent_task = tls_dsn.current_task;
+        int parent_task_code = tls_dsn.current_task_code;
         tls_dsn.current_task = this;
+        tls_dsn.current_task_code = _spec->code;
 
         _spec->on_task_begin.execute(this);
 
+        uint64_t sampled_start_ts_ns = 0;
+        if (dsn_unlikely(_sampled_enqueue_ts_ns != 0)) {
+            sampled_start_ts_ns = dsn_now_ns();
+        }
+
+        uint64_t cpu_start_ns = 0;
+        if (dsn_unlikely(task_cpu_accounting::enabled())) {
+            cpu_start_ns = task_cpu_accounting::thread_cpu_ns();
+        }
+
         exec();
 
+        if (dsn_unlikely(cpu_start_ns != 0)) {
+            task_cpu_accounting::instance().record(
+                _spec->code, _accounting_gpid, task_cpu_accounting::thread_cpu_ns() - cpu_start_ns);
+        }
+
+        if (dsn_unlikely(sampled_start_ts_ns != 0)) {
+            task_latency_sampler::instance().record(_spec->code,
+                                                    sampled_start_ts_ns - _sampled_enqueue_ts_ns,
+                                                    dsn_now_ns() - sampled_start_ts_ns);
+            _sampled_enqueue_ts_ns = 0;
+        }
+
         // after exec(), one shot tasks are still in "running".
         // other tasks may call "set_retry" to reset tasks to "ready",
         // like timers and rpc_response_tasks
@@ -211,6 +241,7 @@ void task::exec_internal()
         }
 
         tls_dsn.current_task = parent_task;
+        tls_dsn.current_task_code = parent_task_code;
     }
 
     if (notify_if_necessary) {
@@ -279,7 +310,9 @@ bool task::wait(int timeout_milliseconds)
     auto cs = state();
 
     if (cs >= TASK_STATE_FINISHED) {
-        spec().on_task_wait_post.execute(get_current_task(), this, true);
+        if (spec().has_hook(TASK_HOOK_WAIT_POST)) {
+            spec().on_task_wait_post.execute(get_current_task(), this, true);
+        }
         return true;
     }
 
@@ -295,7 +328,9 @@ bool task::wait(int timeout_milliseconds)
         }
     }
 
-    spec().on_task_wait_pre.execute(get_current_task(), this, (uint32_t)timeout_milliseconds);
+    if (spec().has_hook(TASK_HOOK_WAIT_PRE)) {
+        spec().on_task_wait_pre.execute(get_current_task(), this, (uint32_t)timeout_milliseconds);
+    }
 
     bool ret = (state() >= TASK_STATE_FINISHED);
     if (!ret) {
@@ -303,7 +338,9 @@ bool task::wait(int timeout_milliseconds)
         ret = (nevt->wait_for(timeout_milliseconds));
     }
 
-    spec().on_task_wait_post.execute(get_current_task(), this, ret);
+    if (spec().has_hook(TASK_HOOK_WAIT_POST)) {
+        spec().on_task_wait_post.execute(get_current_task(), this, ret);
+    }
     return ret;
 }
 
@@ -399,7 +436,11 @@ void task::enqueue(task_worker_pool *pool)
             _spec->name.c_str());
 
     if (spec().type == TASK_TYPE_COMPUTE) {
-        spec().on_task_enqueue.execute(get_current_task(), this);
+        if (spec().has_hook(TASK_HOOK_ENQUEUE)) {
+            spec().on_task_enqueue.execute(get_current_task(), this);
+        }
+    } else if (spec().type == TASK_TYPE_RPC_REQUEST) {
+        static_cast<rpc_request_task *>(this)->trace("task_enqueue");
     }
 
     // for delayed tasks, refering to timer service
@@ -408,6 +449,10 @@ void task::enqueue(task_worker_pool *pool)
         return;
     }
 
+    if (dsn_unlikely(task_latency_sampler::should_sample())) {
+        _sampled_enqueue_ts_ns = dsn_now_ns();
+    }
+
     // fast execution
     if (_is_null) {
         dassert(_node == task::get_current_node(), "");
@@ -0,0 +1,200 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/tool-api/task_cpu_accounting.h>
+
+#include <time.h>
+#include <algorithm>
+#include <sstream>
+
+#include <dsn/tool-api/task_code.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/output_utils.h>
+#include <dsn/utility/ports.h>
+
+namespace dsn {
+
+DSN_DEFINE_bool("core",
+                task_cpu_accounting,
+                false,
+                "whether to attribute the cpu time of the executed tasks to their task codes and "
+                "partitions, which costs two clock_gettime() calls for each task");
+
+namespace {
+
+// the `top` entries of `usages` in the descending order of the cpu time
+template <typename Key>
+std::vector<std::pair<Key, task_cpu_accounting::cpu_usage>>
+top_usages(const std::map<Key, task_cpu_accounting::cpu_usage> &usages, int top)
+{
+    std::vector<std::pair<Key, task_cpu_accounting::cpu_usage>> sorted(usages.begin(),
+                                                                       usages.end());
+    auto by_cpu = [](const std::pair<Key, task_cpu_accounting::cpu_usage> &l,
+                     const std::pair<Key, task_cpu_accounting::cpu_usage> &r) {
+        return l.second.cpu_ns > r.second.cpu_ns;
+    };
+    if (top >= 0 && static_cast<size_t>(top) < sorted.size()) {
+        std::partial_sort(sorted.begin(), sorted.begin() + top, sorted.end(), by_cpu);
+        sorted.resize(top);
+    } else {
+        std::sort(sorted.begin(), sorted.end(), by_cpu);
+    }
+    return sorted;
+}
+
+void add_usage_columns(utils::table_printer &tp)
+{
+    for (const char *col : {"cpu_ms", "count", "avg_cpu_us"}) {
+        tp.add_column(col, utils::table_printer::alignment::kRight);
+    }
+}
+
+void append_usage(utils::table_printer &tp, const task_cpu_accounting::cpu_usage &usage)
+{
+    tp.append_data(usage.cpu_ns / 1000000);
+    tp.append_data(usage.count);
+    tp.append_data(usage.count == 0 ? 0 : usage.cpu_ns / usage.count / 1000);
+}
+
+} // anonymous namespace
+
+task_cpu_accounting::thread_stats::thread_stats(int count)
+    : code_count(count),
+      code_cpu_ns(new std::atomic<uint64_t>[count]),
+      code_counts(new std::atomic<uint64_t>[count])
+{
+    for (int i = 0; i < code_count; ++i) {
+        code_cpu_ns[i].store(0, std::memory_order_relaxed);
+        code_counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+task_cpu_accounting::task_cpu_accounting() = default;
+
+/*static*/ bool task_cpu_accounting::enabled() { return FLAGS_task_cpu_accounting; }
+
+/*static*/ uint64_t task_cpu_accounting::thread_cpu_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+task_cpu_accounting::thread_stats *task_cpu_accounting::local_stats()
+{
+    // the stats are owned by the accounting rather than the thread, so that the usages of the
+    // exited threads are still reported
+    static thread_local thread_stats *stats = nullptr;
+    if (dsn_unlikely(stats == nullptr)) {
+        std::unique_ptr<thread_stats> s(new thread_stats(task_code::max() + 1));
+        stats = s.get();
+        std::lock_guard<std::mutex> l(_lock);
+        _threads.emplace_back(std::move(s));
+    }
+    return stats;
+}
+
+void task_cpu_accounting::record(int code, gpid pid, uint64_t cpu_ns)
+{
+    thread_stats *stats = local_stats();
+    if (code >= 0 && code < stats->code_count) {
+        // only the owner thread writes, so no read-modify-write is needed
+        auto &ns = stats->code_cpu_ns[code];
+        ns.store(ns.load(std::memory_order_relaxed) + cpu_ns, std::memory_order_relaxed);
+        auto &count = stats->code_counts[code];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> l(stats->lock);
+    cpu_usage &usage = stats->partitions[pid];
+    usage.cpu_ns += cpu_ns;
+    ++usage.count;
+}
+
+std::map<int, task_cpu_accounting::cpu_usage> task_cpu_accounting::get_code_usages() const
+{
+    std::map<int, cpu_usage> usages;
+    std::lock_guard<std::mutex> l(_lock);
+    for (const auto &stats : _threads) {
+        for (int code = 0; code < stats->code_count; ++code) {
+            uint64_t count = stats->code_counts[code].load(std::memory_order_relaxed);
+            if (count == 0) {
+                continue;
+            }
+            cpu_usage &usage = usages[code];
+            usage.cpu_ns += stats->code_cpu_ns[code].load(std::memory_order_relaxed);
+            usage.count += count;
+        }
+    }
+    return usages;
+}
+
+std::map<gpid, task_cpu_accounting::cpu_usage> task_cpu_accounting::get_partition_usages() const
+{
+    std::map<gpid, cpu_usage> usages;
+    std::lock_guard<std::mutex> l(_lock);
+    for (const auto &stats : _threads) {
+        std::lock_guard<std::mutex> sl(stats->lock);
+        for (const auto &kv : stats->partitions) {
+            cpu_usage &usage = usages[kv.first];
+            usage.cpu_ns += kv.second.cpu_ns;
+            usage.count += kv.second.count;
+        }
+    }
+    return usages;
+}
+
+std::map<int32_t, task_cpu_accounting::cpu_usage> task_cpu_accounting::get_app_usages() const
+{
+    std::map<int32_t, cpu_usage> usages;
+    for (const auto &kv : get_partition_usages()) {
+        cpu_usage &usage = usages[kv.first.get_app_id()];
+        usage.cpu_ns += kv.second.cpu_ns;
+        usage.count += kv.second.count;
+    }
+    return usages;
+}
+
+std::string task_cpu_accounting::get_usage_report(int top, bool json) const
+{
+    utils::multi_table_printer mtp;
+
+    utils::table_printer apps("app_cpu");
+    apps.add_title("app_id");
+    add_usage_columns(apps);
+    for (const auto &kv : top_usages(get_app_usages(), -1)) {
+        apps.add_row(kv.first);
+        append_usage(apps, kv.second);
+    }
+    mtp.add(std::move(apps));
+
+    std::map<gpid, cpu_usage> partition_usages = get_partition_usages();
+    // the tasks without partition are reported by app 0
+    partition_usages.erase(gpid());
+    utils::table_printer partitions("partition_cpu");
+    partitions.add_title("gpid");
+    add_usage_columns(partitions);
+    for (const auto &kv : top_usages(partition_usages, top)) {
+        partitions.add_row(kv.first.to_string());
+        append_usage(partitions, kv.second);
+    }
+    mtp.add(std::move(partitions));
+
+    utils::table_printer codes("task_code_cpu");
+    codes.add_title("task_code");
+    add_usage_columns(codes);
+    for (const auto &kv : top_usages(get_code_usages(), top)) {
+        codes.add_row(task_code(kv.first).to_string());
+        append_usage(codes, kv.second);
+    }
+    mtp.add(std::move(codes));
+
+    std::ostringstream out;
+    mtp.output(out,
+               json ? utils::table_printer::output_format::kJsonCompact
+                    : utils::table_printer::output_format::kTabular);
+    return out.str();
+}
+
+} // namespace dsn
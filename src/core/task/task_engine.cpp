@@ -95,33 +95,62 @@ void task_worker_pool::start()
     if (_is_running)
         return;
 
-    for (auto &tsvc : _per_queue_timer_svcs)
-        tsvc->start();
-    for (auto &wk : _workers)
-        wk->start();
+    // a lazy_start pool starts its workers on its first task
+    if (!_spec.lazy_start)
+        start_workers();
 
     ddebug("[%s] thread pool [%s] started, pool_code = %s, worker_count = %d, worker_share_core = "
-           "%s, partitioned = %s, ...",
+           "%s, partitioned = %s, lazy_start = %s, ...",
            _node->full_name(),
            _spec.name.c_str(),
            _spec.pool_code.to_string(),
            _spec.worker_count,
            _spec.worker_share_core ? "true" : "false",
-           _spec.partitioned ? "true" : "false");
+           _spec.partitioned ? "true" : "false",
+           _spec.lazy_start ? "true" : "false");
 
     _is_running = true;
 }
 
+void task_worker_pool::start_workers()
+{
+    std::call_once(_start_workers_once, [this]() {
+        for (auto &tsvc : _per_queue_timer_svcs)
+            tsvc->start();
+        for (auto &wk : _workers)
+            wk->start();
+        _workers_started.store(true, std::memory_order_release);
+
+        if (_spec.lazy_start) {
+            ddebug("[%s] workers of thread pool [%s] started on the first task",
+                   _node->full_name(),
+                   _spec.name.c_str());
+        }
+    });
+}
+
 void task_worker_pool::add_timer(task *t)
 {
     dassert(t->delay_milliseconds() > 0,
             "task delayed should be dispatched to timer service first");
 
-    unsigned int idx = (_spec.partitioned
-                            ? static_cast<unsigned int>(t->hash()) %
-                                  static_cast<unsigned int>(_per_queue_timer_svcs.size())
-                            : 0);
-    _per_queue_timer_svcs[idx]->add_timer(t);
+    if (!_workers_started.load(std::memory_order_acquire))
+        start_workers();
+    _per_queue_timer_svcs[queue_index(t->hash())]->add_timer(t);
+}
+
+bool task_worker_pool::set_queue_router(task_queue_router *router)
+{
+    if (!_spec.partitioned || _router.load() != nullptr) {
+        derror("[%s] can not set the queue router of thread pool [%s], partitioned = %s",
+               _node->full_name(),
+               _spec.name.c_str(),
+               _spec.partitioned ? "true" : "false");
+        return false;
+    }
+    router->init(static_cast<unsigned int>(_queues.size()));
+    _router.store(router, std::memory_order_release);
+    return true;
 }
 
 void task_worker_pool::enqueue(task *t)
@@ -135,13 +164,69 @@ void task_worker_pool::enqueue(task *t)
             "worker pool %s must be started before enqueue task %s",
             spec().name.c_str(),
             t->spec().name.c_str());
-    unsigned int idx =
-        (_spec.partitioned
-             ? static_cast<unsigned int>(t->hash()) % static_cast<unsigned int>(_queues.size())
-             : 0);
+    if (!_workers_started.load(std::memory_order_acquire))
+        start_workers();
+    unsigned int idx = queue_index(t->hash());
+    if (enqueue_batch_scope::defer(_queues[idx], t)) {
+        return;
+    }
     return _queues[idx]->enqueue_internal(t);
 }
 
+namespace {
+
+struct enqueue_batch
+{
+    int depth = 0;
+    // the deferred tasks grouped by queue, there're usually only a few queues in a batch
+    std::vector<std::pair<task_queue *, std::vector<task *>>> queues;
+    // the number of the used entries of `queues`, the others are kept to reuse their vectors
+    size_t queue_count = 0;
+};
+
+thread_local enqueue_batch tls_enqueue_batch;
+
+} // anonymous namespace
+
+enqueue_batch_scope::enqueue_batch_scope() { ++tls_enqueue_batch.depth; }
+
+enqueue_batch_scope::~enqueue_batch_scope()
+{
+    enqueue_batch &batch = tls_enqueue_batch;
+    if (--batch.depth > 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < batch.queue_count; ++i) {
+        auto &entry = batch.queues[i];
+        entry.first->enqueue_internal_batch(entry.second);
+        entry.second.clear();
+    }
+    batch.queue_count = 0;
+}
+
+/*static*/ bool enqueue_batch_scope::defer(task_queue *q, task *t)
+{
+    enqueue_batch &batch = tls_enqueue_batch;
+    if (batch.depth == 0) {
+        return false;
+    }
+
+    size_t i = 0;
+    while (i < batch.queue_count && batch.queues[i].first != q) {
+        ++i;
+    }
+    if (i == batch.queue_count) {
+        if (i == batch.queues.size()) {
+            batch.queues.emplace_back();
+        }
+        batch.queues[i].first = q;
+        ++batch.queue_count;
+    }
+    batch.queues[i].second.push_back(t);
+    return true;
+}
+
 bool task_worker_pool::shared_same_worker_with_current_task(task *tsk) const
 {
     task *current = task::get_current_task();
@@ -151,9 +236,7 @@ bool task_worker_pool::shared_same_worker_with_current_task(task *tsk) const
         else if (_workers.size() == 1)
             return true;
         else if (_spec.partitioned) {
-            unsigned int sz = static_cast<unsigned int>(_workers.size());
-            return static_cast<unsigned int>(current->hash()) % sz ==
-                   static_cast<unsigned int>(tsk->hash()) % sz;
+            return queue_index(current->hash()) == queue_index(tsk->hash());
         } else {
             return false;
         }
@@ -194,7 +277,8 @@ void task_worker_pool::get_queue_info(/*out*/ std::stringstream &ss)
                 first_flag = 1;
             else
                 ss << ",";
-            ss << "\t\t{\"name\":\"" << q->get_name() << "\",\n\t\t\"num\":" << q->count() << "}\n";
+            ss << "\t\t{\"name\":\"" << q->get_name() << "\",\n\t\t\"num\":" << q->count()
+               << ",\n\t\t\"peak\":" << q->peak_count_and_reset() << "}\n";
         }
     }
     ss << "]\n";
@@ -237,8 +321,7 @@ void task_engine::start()
 volatile int *task_engine::get_task_queue_virtual_length_ptr(dsn::task_code code, int hash)
 {
     auto pl = get_pool(task_spec::get(code)->pool_code);
-    auto idx = (pl->spec().partitioned ? hash % pl->spec().worker_count : 0);
-    return pl->queues()[idx]->get_virtual_length_ptr();
+    return pl->queues()[pl->queue_index(hash)]->get_virtual_length_ptr();
 }
 
 void task_engine::get_runtime_info(const std::string &indent,
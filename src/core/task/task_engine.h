@@ -40,6 +40,7 @@
 #include <dsn/tool-api/admission_controller.h>
 #include <dsn/tool-api/task_worker.h>
 #include <dsn/tool-api/timer_service.h>
+#include <mutex>
 
 namespace dsn {
 
@@ -67,6 +68,19 @@ public:
     // cached timer service access
     void add_timer(task *task);
 
+    // the index of the queue for the tasks of `hash`, see task_queue_router
+    unsigned int queue_index(int hash) const
+    {
+        if (!_spec.partitioned) {
+            return 0;
+        }
+        const task_queue_router *router = _router.load(std::memory_order_acquire);
+        return router == nullptr
+                   ? static_cast<unsigned int>(hash) % static_cast<unsigned int>(_queues.size())
+                   : router->route(hash);
+    }
+    bool set_queue_router(task_queue_router *router);
+
     // inquery
     const threadpool_spec &spec() const { return _spec; }
     bool shared_same_worker_with_current_task(task *task) const;
@@ -79,8 +93,13 @@ public:
     std::vector<task_queue *> &queues() { return _queues; }
     std::vector<task_worker *> &workers() { return _workers; }
     std::vector<admission_controller *> &controllers() { return _controllers; }
+    bool workers_started() const { return _workers_started.load(std::memory_order_acquire); }
 
 private:
+    // starts the workers and the timer services once, either in start(), or on the first task
+    // if the pool is lazy_start
+    void start_workers();
+
     threadpool_spec _spec;
     task_engine *_owner;
     service_node *_node;
@@ -90,8 +109,34 @@ private:
     std::vector<admission_controller *> _controllers;
 
     std::vector<timer_service *> _per_queue_timer_svcs;
+    std::atomic<const task_queue_router *> _router{nullptr};
 
     bool _is_running;
+    std::once_flag _start_workers_once;
+    std::atomic<bool> _workers_started{false};
+};
+
+//
+// enqueue_batch_scope defers the tasks enqueued into the pools by the current thread until the
+// outermost scope exits, then enqueues them into their task queues at once, so that the workers
+// of a queue are signaled once for all the tasks rather than once per task. e.g. the io threads
+// dispatch all the rpc messages parsed from one read in a scope.
+//
+// the tasks in a scope are not visible to the workers until the scope exits, so never wait for
+// them in a scope.
+//
+class enqueue_batch_scope
+{
+public:
+    enqueue_batch_scope();
+    ~enqueue_batch_scope();
+
+    // returns false if not in a scope
+    static bool defer(task_queue *q, task *t);
+
+private:
+    enqueue_batch_scope(const enqueue_batch_scope &) = delete;
+    enqueue_batch_scope &operator=(const enqueue_batch_scope &) = delete;
 };
 
 class task_engine
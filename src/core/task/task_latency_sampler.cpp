@@ -0,0 +1,230 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "task_latency_sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include <dsn/tool-api/task_code.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/output_utils.h>
+#include <dsn/utility/ports.h>
+
+namespace dsn {
+
+DSN_DEFINE_uint32("core",
+                  task_latency_sample_rate,
+                  0,
+                  "sample one in every task_latency_sample_rate tasks enqueued by each thread to "
+                  "record the queue time and the execution time, 0 to disable the sampling");
+
+const int latency_histogram::SUB_BUCKET_BITS;
+const int latency_histogram::SUB_BUCKET_COUNT;
+const int latency_histogram::MAX_VALUE_BITS;
+const int latency_histogram::BUCKET_COUNT;
+
+latency_histogram::latency_histogram()
+{
+    for (auto &b : _buckets) {
+        b.store(0, std::memory_order_relaxed);
+    }
+}
+
+void latency_histogram::record(uint64_t value)
+{
+    auto &b = _buckets[bucket_index(value)];
+    // only the owner thread writes, so no read-modify-write is needed
+    b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void latency_histogram::merge_into(/*inout*/ std::vector<uint64_t> &counts) const
+{
+    counts.resize(BUCKET_COUNT, 0);
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i] += _buckets[i].load(std::memory_order_relaxed);
+    }
+}
+
+/*static*/ int latency_histogram::bucket_index(uint64_t value)
+{
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<int>(value);
+    }
+    int msb = 63 - __builtin_clzll(value);
+    if (msb >= MAX_VALUE_BITS) {
+        return BUCKET_COUNT - 1;
+    }
+    int group = msb - SUB_BUCKET_BITS + 1;
+    int sub = static_cast<int>(value >> (msb - SUB_BUCKET_BITS)) - SUB_BUCKET_COUNT;
+    return group * SUB_BUCKET_COUNT + sub;
+}
+
+/*static*/ uint64_t latency_histogram::bucket_value(int index)
+{
+    int group = index / SUB_BUCKET_COUNT;
+    uint64_t sub = index % SUB_BUCKET_COUNT;
+    if (group == 0) {
+        return sub;
+    }
+    uint64_t lower = (SUB_BUCKET_COUNT + sub) << (group - 1);
+    return lower + ((1ULL << (group - 1)) >> 1);
+}
+
+/*static*/ uint64_t latency_histogram::quantile(const std::vector<uint64_t> &counts,
+                                                double quantile)
+{
+    uint64_t total = 0;
+    for (uint64_t c : counts) {
+        total += c;
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(quantile * total)), 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return bucket_value(static_cast<int>(i));
+        }
+    }
+    return bucket_value(static_cast<int>(counts.size()) - 1);
+}
+
+task_latency_sampler::thread_stats::thread_stats(int count)
+    : code_count(count), codes(new std::atomic<code_stats *>[count])
+{
+    for (int i = 0; i < code_count; ++i) {
+        codes[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+task_latency_sampler::thread_stats::~thread_stats()
+{
+    for (int i = 0; i < code_count; ++i) {
+        delete codes[i].load(std::memory_order_relaxed);
+    }
+}
+
+task_latency_sampler::task_latency_sampler() = default;
+
+/*static*/ bool task_latency_sampler::should_sample()
+{
+    uint32_t rate = FLAGS_task_latency_sample_rate;
+    if (dsn_likely(rate == 0)) {
+        return false;
+    }
+    static thread_local uint32_t enqueued = 0;
+    if (++enqueued < rate) {
+        return false;
+    }
+    enqueued = 0;
+    return true;
+}
+
+task_latency_sampler::thread_stats *task_latency_sampler::local_stats()
+{
+    // the stats are owned by the sampler rather than the thread, so that the samples of the
+    // exited threads are still reported
+    static thread_local thread_stats *stats = nullptr;
+    if (dsn_unlikely(stats == nullptr)) {
+        std::unique_ptr<thread_stats> s(new thread_stats(task_code::max() + 1));
+        stats = s.get();
+        std::lock_guard<std::mutex> l(_lock);
+        _threads.emplace_back(std::move(s));
+    }
+    return stats;
+}
+
+void task_latency_sampler::record(int code, uint64_t queue_ns, uint64_t exec_ns)
+{
+    thread_stats *stats = local_stats();
+    if (code < 0 || code >= stats->code_count) {
+        // the task code is registered after the stats are created
+        return;
+    }
+
+    code_stats *cs = stats->codes[code].load(std::memory_order_relaxed);
+    if (dsn_unlikely(cs == nullptr)) {
+        cs = new code_stats();
+        stats->codes[code].store(cs, std::memory_order_release);
+    }
+    cs->queue_us.record(queue_ns / 1000);
+    cs->exec_us.record(exec_ns / 1000);
+}
+
+std::vector<task_latency_sampler::task_latency> task_latency_sampler::get_latencies() const
+{
+    std::vector<task_latency> latencies;
+    std::lock_guard<std::mutex> l(_lock);
+    for (int code = 0; code <= task_code::max(); ++code) {
+        task_latency tl;
+        tl.code = code;
+        for (const auto &stats : _threads) {
+            if (code >= stats->code_count) {
+                continue;
+            }
+            code_stats *cs = stats->codes[code].load(std::memory_order_acquire);
+            if (cs != nullptr) {
+                cs->queue_us.merge_into(tl.queue_us);
+                cs->exec_us.merge_into(tl.exec_us);
+            }
+        }
+
+        tl.count = 0;
+        for (uint64_t c : tl.exec_us) {
+            tl.count += c;
+        }
+        if (tl.count > 0) {
+            latencies.emplace_back(std::move(tl));
+        }
+    }
+    return latencies;
+}
+
+std::string task_latency_sampler::get_latency_report(const std::vector<std::string> &args) const
+{
+    utils::table_printer tp("task_latency");
+    tp.add_title("task_code");
+    for (const char *col : {"samples",
+                            "queue_p50_us",
+                            "queue_p99_us",
+                            "queue_p999_us",
+                            "exec_p50_us",
+                            "exec_p99_us",
+                            "exec_p999_us"}) {
+        tp.add_column(col, utils::table_printer::alignment::kRight);
+    }
+
+    for (const task_latency &tl : get_latencies()) {
+        std::string name = task_code(tl.code).to_string();
+        bool matched = args.empty();
+        for (const std::string &prefix : args) {
+            if (name.compare(0, prefix.size(), prefix) == 0) {
+                matched = true;
+                break;
+            }
+        }
+        if (!matched) {
+            continue;
+        }
+
+        tp.add_row(name);
+        tp.append_data(tl.count);
+        for (const auto *counts : {&tl.queue_us, &tl.exec_us}) {
+            tp.append_data(latency_histogram::quantile(*counts, 0.5));
+            tp.append_data(latency_histogram::quantile(*counts, 0.99));
+            tp.append_data(latency_histogram::quantile(*counts, 0.999));
+        }
+    }
+
+    std::ostringstream out;
+    tp.output(out);
+    return out.str();
+}
+
+} // namespace dsn
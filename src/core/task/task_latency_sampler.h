@@ -0,0 +1,102 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <dsn/utility/singleton.h>
+
+namespace dsn {
+
+// latency_histogram is written by a single thread and can be read by any thread. The values
+// are bucketed log-linearly with SUB_BUCKET_COUNT sub-buckets for each power of 2, which keeps
+// the relative error under 1 / SUB_BUCKET_COUNT with a small memory footprint.
+class latency_histogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 3;
+    static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const int MAX_VALUE_BITS = 40;
+    static const int BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    latency_histogram();
+
+    // must be called by the owner thread only
+    void record(uint64_t value);
+
+    // add the bucket counts of this histogram into `counts`, which is of BUCKET_COUNT
+    void merge_into(/*inout*/ std::vector<uint64_t> &counts) const;
+
+    static int bucket_index(uint64_t value);
+    // a representative value of all the values falling into bucket `index`
+    static uint64_t bucket_value(int index);
+    // the value at `quantile` of the merged `counts`, return 0 if nothing is recorded
+    static uint64_t quantile(const std::vector<uint64_t> &counts, double quantile);
+
+private:
+    std::atomic<uint64_t> _buckets[BUCKET_COUNT];
+};
+
+///
+/// task_latency_sampler samples one in every [core] task_latency_sample_rate tasks enqueued by
+/// each thread, and records the queue time and the execution time of the sampled tasks into the
+/// histograms of the executing thread for each task code. The histograms of all threads are
+/// merged on read, by the remote command "task-latency".
+///
+/// Unlike the profiler toollet, no join point is attached to the tasks, the cost of the tasks
+/// not sampled is a thread local counter increment.
+///
+class task_latency_sampler : public utils::singleton<task_latency_sampler>
+{
+public:
+    task_latency_sampler();
+
+    // whether the task being enqueued by the current thread should be sampled
+    static bool should_sample();
+
+    // record a sampled task executed by the current thread
+    void record(int code, uint64_t queue_ns, uint64_t exec_ns);
+
+    struct task_latency
+    {
+        int code;
+        std::vector<uint64_t> queue_us; // the merged bucket counts
+        std::vector<uint64_t> exec_us;
+        uint64_t count;
+    };
+    // the merged latencies of the task codes which have samples
+    std::vector<task_latency> get_latencies() const;
+
+    // task-latency [task_code_prefix]...
+    std::string get_latency_report(const std::vector<std::string> &args) const;
+
+private:
+    struct code_stats
+    {
+        latency_histogram queue_us;
+        latency_histogram exec_us;
+    };
+
+    struct thread_stats
+    {
+        explicit thread_stats(int count);
+        ~thread_stats();
+
+        const int code_count;
+        // allocated by the owner thread on the first sample of each code
+        std::unique_ptr<std::atomic<code_stats *>[]> codes;
+    };
+
+    thread_stats *local_stats();
+
+    mutable std::mutex _lock; // protect _threads
+    std::vector<std::unique_ptr<thread_stats>> _threads;
+};
+
+} // namespace dsn
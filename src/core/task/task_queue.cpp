@@ -27,12 +27,18 @@
 #include <dsn/tool-api/task_queue.h>
 #include "task_engine.h"
 #include <dsn/tool-api/network.h>
+#include <dsn/utility/time_utils.h>
+#include <algorithm>
 #include "core/rpc/rpc_engine.h"
 
 namespace dsn {
 
 task_queue::task_queue(task_worker_pool *pool, int index, task_queue *inner_provider)
-    : _pool(pool), _controller(nullptr), _queue_length(0)
+    : _pool(pool),
+      _controller(nullptr),
+      _queue_length(0),
+      _queue_length_peak(0),
+      _wakeup_enqueue_ts_ns(0)
 {
     char num[30];
     sprintf(num, "%u", index);
@@ -50,7 +56,14 @@ task_queue::task_queue(task_worker_pool *pool, int index, task_queue *inner_prov
 
 task_queue::~task_queue() = default;
 
-void task_queue::enqueue_internal(task *task)
+void task_queue::enqueue_batch(const std::vector<task *> &tasks)
+{
+    for (task *t : tasks) {
+        enqueue(t);
+    }
+}
+
+bool task_queue::throttle(task *task)
 {
     auto &sp = task->spec();
     auto throttle_mode = sp.rpc_request_throttling_mode;
@@ -89,12 +102,43 @@ void task_queue::enqueue_internal(task *task)
                       rtask->get_request()->header->trace_id);
 
                 task->release_ref(); // added in task::enqueue(pool)
-                return;
+                return true;
             }
         }
     }
 
-    tls_dsn.last_worker_queue_size = increase_count();
+    if (_controller != nullptr) {
+        task->queue_enqueue_ts_ns = utils::get_current_physical_time_ns();
+    }
+    return false;
+}
+
+void task_queue::on_enqueue(int count)
+{
+    tls_dsn.last_worker_queue_size = increase_count(count);
+    if (tls_dsn.last_worker_queue_size == count && _spec->spin_wait_max_us > 0) {
+        _wakeup_enqueue_ts_ns.store(utils::get_current_physical_time_ns(),
+                                    std::memory_order_relaxed);
+    }
+}
+
+void task_queue::enqueue_internal(task *task)
+{
+    if (throttle(task)) {
+        return;
+    }
+    on_enqueue(1);
     enqueue(task);
 }
+
+void task_queue::enqueue_internal_batch(std::vector<task *> &tasks)
+{
+    tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [this](task *t) { return throttle(t); }),
+                tasks.end());
+    if (tasks.empty()) {
+        return;
+    }
+    on_enqueue(static_cast<int>(tasks.size()));
+    enqueue_batch(tasks);
+}
 }
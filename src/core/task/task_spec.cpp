@@ -146,25 +146,55 @@ task_spec::task_spec(int code,
       rpc_call_header_format(NET_HDR_DSN),
       rpc_call_channel(RPC_CHANNEL_TCP),
       rpc_message_crc_required(false),
-      on_task_create((std::string(name) + std::string(".create")).c_str()),
-      on_task_enqueue((std::string(name) + std::string(".enqueue")).c_str()),
-      on_task_begin((std::string(name) + std::string(".begin")).c_str()),
-      on_task_end((std::string(name) + std::string(".end")).c_str()),
-      on_task_cancelled((std::string(name) + std::string(".cancelled")).c_str()),
-
-      on_task_wait_pre((std::string(name) + std::string(".wait.pre")).c_str()),
-      on_task_wait_notified((std::string(name) + std::string(".wait.notified")).c_str()),
-      on_task_wait_post((std::string(name) + std::string(".wait.post")).c_str()),
-      on_task_cancel_post((std::string(name) + std::string(".cancel.post")).c_str()),
-
-      on_aio_call((std::string(name) + std::string(".aio.call")).c_str()),
-      on_aio_enqueue((std::string(name) + std::string(".aio.enqueue")).c_str()),
-
-      on_rpc_call((std::string(name) + std::string(".rpc.call")).c_str()),
-      on_rpc_request_enqueue((std::string(name) + std::string(".rpc.request.enqueue")).c_str()),
-      on_rpc_reply((std::string(name) + std::string(".rpc.reply")).c_str()),
-      on_rpc_response_enqueue((std::string(name) + std::string(".rpc.response.enqueue")).c_str()),
-      on_rpc_create_response((std::string(name) + std::string("rpc.create.response")).c_str())
+      rpc_response_compress_type(MCT_NONE),
+      hooks(0),
+      on_task_create((std::string(name) + std::string(".create")).c_str(),
+                     &hooks,
+                     TASK_HOOK_CREATE),
+      on_task_enqueue((std::string(name) + std::string(".enqueue")).c_str(),
+                      &hooks,
+                      TASK_HOOK_ENQUEUE),
+      on_task_begin((std::string(name) + std::string(".begin")).c_str(), &hooks, TASK_HOOK_BEGIN),
+      on_task_end((std::string(name) + std::string(".end")).c_str(), &hooks, TASK_HOOK_END),
+      on_task_cancelled((std::string(name) + std::string(".cancelled")).c_str(),
+                        &hooks,
+                        TASK_HOOK_CANCELLED),
+
+      on_task_wait_pre((std::string(name) + std::string(".wait.pre")).c_str(),
+                       &hooks,
+                       TASK_HOOK_WAIT_PRE),
+      on_task_wait_notified((std::string(name) + std::string(".wait.notified")).c_str(),
+                            &hooks,
+                            TASK_HOOK_WAIT_NOTIFIED),
+      on_task_wait_post((std::string(name) + std::string(".wait.post")).c_str(),
+                        &hooks,
+                        TASK_HOOK_WAIT_POST),
+      on_task_cancel_post((std::string(name) + std::string(".cancel.post")).c_str(),
+                          &hooks,
+                          TASK_HOOK_CANCEL_POST),
+
+      on_aio_call((std::string(name) + std::string(".aio.call")).c_str(),
+                  &hooks,
+                  TASK_HOOK_AIO_CALL),
+      on_aio_enqueue((std::string(name) + std::string(".aio.enqueue")).c_str(),
+                     &hooks,
+                     TASK_HOOK_AIO_ENQUEUE),
+
+      on_rpc_call((std::string(name) + std::string(".rpc.call")).c_str(),
+                  &hooks,
+                  TASK_HOOK_RPC_CALL),
+      on_rpc_request_enqueue((std::string(name) + std::string(".rpc.request.enqueue")).c_str(),
+                             &hooks,
+                             TASK_HOOK_RPC_REQUEST_ENQUEUE),
+      on_rpc_reply((std::string(name) + std::string(".rpc.reply")).c_str(),
+                   &hooks,
+                   TASK_HOOK_RPC_REPLY),
+      on_rpc_response_enqueue((std::string(name) + std::string(".rpc.response.enqueue")).c_str(),
+                              &hooks,
+                              TASK_HOOK_RPC_RESPONSE_ENQUEUE),
+      on_rpc_create_response((std::string(name) + std::string("rpc.create.response")).c_str(),
+                             &hooks,
+                             TASK_HOOK_RPC_CREATE_RESPONSE)
 {
     dassert(strlen(name) < DSN_MAX_TASK_CODE_NAME_LENGTH,
             "task code name '%s' is too long: length must be smaller than "
@@ -25,8 +25,11 @@
  */
 
 #include <sstream>
+#include <dsn/utility/biased_ref_counter.h>
+#include <dsn/utility/numa.h>
 #include <dsn/utility/process_utils.h>
 #include <dsn/utility/smart_pointers.h>
+#include <dsn/utility/time_utils.h>
 
 #include "task_engine.h"
 
@@ -52,6 +55,27 @@ task_worker::task_worker(task_worker_pool *pool,
 
     _thread = nullptr;
     _processed_task_count = 0;
+    _avg_idle_ns = 0;
+
+    if (pool->spec().spin_wait_max_us > 0) {
+        std::string prefix = pool->spec().name + '.' + std::to_string(index);
+        _spin_hit_count.init_global_counter(pool->node()->full_name(),
+                                            "engine",
+                                            (prefix + ".spin.hit.count").c_str(),
+                                            COUNTER_TYPE_RATE,
+                                            "the rate of tasks got by the idle worker spinning");
+        _park_count.init_global_counter(pool->node()->full_name(),
+                                        "engine",
+                                        (prefix + ".park.count").c_str(),
+                                        COUNTER_TYPE_RATE,
+                                        "the rate of the idle worker parking on the queue");
+        _wakeup_latency_ns.init_global_counter(
+            pool->node()->full_name(),
+            "engine",
+            (prefix + ".wakeup.latency(ns)").c_str(),
+            COUNTER_TYPE_NUMBER_PERCENTILES,
+            "the latency from enqueuing a task to the parked worker waking up for it");
+    }
 }
 
 task_worker::~task_worker()
@@ -161,7 +185,14 @@ void task_worker::run_internal()
     set_name(name().c_str());
     set_priority(pool_spec().worker_priority);
 
-    if (true == pool_spec().worker_share_core) {
+    int numa_nodes = utils::numa_node_count();
+    if (pool_spec().numa_aware && numa_nodes > 1) {
+        // the contiguous workers are on the same node, so are the partitions hashed to them
+        int node = utils::numa_node_of_worker(_index, pool_spec().worker_count, numa_nodes);
+        if (!utils::bind_thread_to_numa_node(node)) {
+            derror("bind %s to numa node %d failed", name().c_str(), node);
+        }
+    } else if (true == pool_spec().worker_share_core) {
         if (pool_spec().worker_affinity_mask > 0) {
             set_affinity(pool_spec().worker_affinity_mask);
         }
@@ -191,16 +222,88 @@ void task_worker::run_internal()
     loop();
 }
 
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+uint64_t task_worker::spin_budget_ns() const
+{
+    uint64_t max_ns = static_cast<uint64_t>(pool_spec().spin_wait_max_us) * 1000;
+    if (!pool_spec().adaptive_spin_wait) {
+        return max_ns;
+    }
+    // spinning is worthless if tasks recently arrived much later than the budget, so the
+    // worker parks at once, and it spins again once the load rises
+    return _avg_idle_ns <= max_ns ? max_ns : 0;
+}
+
+bool task_worker::spin_wait(task_queue *q, uint64_t idle_start_ns)
+{
+    uint64_t budget_ns = spin_budget_ns();
+    while (_is_running) {
+        if (q->count() > 0) {
+            return true;
+        }
+        if (utils::get_current_physical_time_ns() - idle_start_ns >= budget_ns) {
+            return false;
+        }
+        cpu_relax();
+    }
+    return true;
+}
+
+void task_worker::on_idle_end(task_queue *q, uint64_t idle_start_ns, bool parked)
+{
+    uint64_t now = utils::get_current_physical_time_ns();
+    int64_t idle_ns = static_cast<int64_t>(now - idle_start_ns);
+    // the moving average of the idle time, with a weight of 1/8 for the latest one
+    _avg_idle_ns = static_cast<uint64_t>(static_cast<int64_t>(_avg_idle_ns) +
+                                         (idle_ns - static_cast<int64_t>(_avg_idle_ns)) / 8);
+
+    if (!parked) {
+        _spin_hit_count->increment();
+        return;
+    }
+    _park_count->increment();
+    uint64_t enqueue_ts_ns = q->wakeup_enqueue_ts_ns();
+    if (enqueue_ts_ns > idle_start_ns && enqueue_ts_ns < now) {
+        _wakeup_latency_ns->set(now - enqueue_ts_ns);
+    }
+}
+
 void task_worker::loop()
 {
     task_queue *q = queue();
     int best_batch_size = pool_spec().dequeue_batch_size;
+    bool spin_enabled = pool_spec().spin_wait_max_us > 0;
+    admission_controller *controller = q->controller();
+    // the objects created by the tasks are biased to this thread, see biased_ref_counter
+    biased_ref_counter::enable_biasing();
 
     while (_is_running) {
+        // spin for a while before parking on the queue, to save the wake-up latency of the
+        // tasks arriving soon
+        bool idle = spin_enabled && q->count() == 0;
+        uint64_t idle_start_ns = 0;
+        bool parked = false;
+        if (idle) {
+            idle_start_ns = utils::get_current_physical_time_ns();
+            parked = !spin_wait(q, idle_start_ns);
+        }
+
         int batch_size = best_batch_size;
         task *task = q->dequeue(batch_size), *next;
+        if (idle) {
+            on_idle_end(q, idle_start_ns, parked);
+        }
 
         q->decrease_count(batch_size);
+        uint64_t dequeue_ts_ns = controller != nullptr ? utils::get_current_physical_time_ns() : 0;
 
 #ifndef NDEBUG
         int count = 0;
@@ -208,6 +311,18 @@ void task_worker::loop()
         while (task != nullptr) {
             next = task->next;
             task->next = nullptr;
+            if (task->spec().type == TASK_TYPE_RPC_REQUEST) {
+                static_cast<rpc_request_task *>(task)->trace("task_dequeue");
+            }
+            if (controller != nullptr) {
+                uint64_t sojourn_ns = dequeue_ts_ns > task->queue_enqueue_ts_ns
+                                          ? dequeue_ts_ns - task->queue_enqueue_ts_ns
+                                          : 0;
+                if (!controller->is_dequeued_task_accepted(task, sojourn_ns, dequeue_ts_ns) &&
+                    task->spec().type == TASK_TYPE_RPC_REQUEST) {
+                    static_cast<rpc_request_task *>(task)->reject(ERR_BUSY);
+                }
+            }
             task->exec_internal();
             task = next;
 #ifndef NDEBUG
@@ -223,6 +338,7 @@ void task_worker::loop()
 #endif
 
         _processed_task_count += batch_size;
+        biased_ref_counter::merge_queued();
     }
 }
 
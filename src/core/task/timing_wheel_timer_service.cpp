@@ -0,0 +1,208 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "timing_wheel_timer_service.h"
+
+#include <dsn/tool-api/task.h>
+#include <dsn/tool-api/task_worker.h>
+#include <dsn/utility/flags.h>
+
+#include <algorithm>
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_uint32("core",
+                  timer_wheel_tick_ms,
+                  1,
+                  "the tick of timing_wheel_timer_service in milliseconds, a delayed task is "
+                  "fired at most one tick later than its delay");
+DSN_DEFINE_validator(timer_wheel_tick_ms, [](uint32_t value) -> bool { return value > 0; });
+
+const int timing_wheel_timer_service::LEVEL_COUNT;
+const int timing_wheel_timer_service::LEVEL0_BITS;
+const int timing_wheel_timer_service::LEVEL_BITS;
+const uint64_t timing_wheel_timer_service::MAX_SPAN_TICKS;
+
+timing_wheel_timer_service::timing_wheel_timer_service(service_node *node,
+                                                       timer_service *inner_provider)
+    : timer_service(node, inner_provider),
+      _start_time(std::chrono::steady_clock::now()),
+      _tick_ms(FLAGS_timer_wheel_tick_ms),
+      _now_tick(0),
+      _wakeup_tick(UINT64_MAX),
+      _timer_count(0),
+      _stopped(false)
+{
+}
+
+timing_wheel_timer_service::~timing_wheel_timer_service()
+{
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        _stopped = true;
+    }
+    _cond.notify_one();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+}
+
+void timing_wheel_timer_service::start()
+{
+    _worker = std::thread([this]() {
+        task::set_tls_dsn_context(node(), nullptr);
+
+        char buffer[128];
+        sprintf(buffer, "%s.timer", get_service_node_name(node()));
+
+        task_worker::set_name(buffer);
+        task_worker::set_priority(worker_priority_t::THREAD_xPRIORITY_ABOVE_NORMAL);
+
+        run();
+    });
+}
+
+uint64_t timing_wheel_timer_service::current_tick() const
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - _start_time)
+                       .count();
+    return static_cast<uint64_t>(elapsed) / _tick_ms;
+}
+
+void timing_wheel_timer_service::add_timer(task *task)
+{
+    // round up, so that a task is never fired earlier than its delay
+    uint64_t delay_ticks = (static_cast<uint64_t>(task->delay_milliseconds()) + _tick_ms - 1) /
+                           _tick_ms;
+    task->set_delay(0);
+
+    // the tick in progress is only partially elapsed, so wait for one more tick
+    uint64_t now_tick = current_tick();
+    timer_entry e{task, now_tick + delay_ticks + 1};
+
+    bool notify;
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        if (_timer_count == 0) {
+            // the wheel is not advanced while idle, catch up with the clock directly
+            _now_tick = std::max(_now_tick, now_tick);
+        }
+        insert(e);
+        ++_timer_count;
+        notify = e.expire_tick < _wakeup_tick;
+        if (notify) {
+            _wakeup_tick = e.expire_tick;
+        }
+    }
+    if (notify) {
+        _cond.notify_one();
+    }
+}
+
+void timing_wheel_timer_service::insert(timer_entry e)
+{
+    uint64_t span = e.expire_tick > _now_tick ? e.expire_tick - _now_tick : 0;
+    if (span < (1ULL << LEVEL0_BITS)) {
+        // expired entries are put to the slot of the next tick
+        uint64_t tick = std::max(e.expire_tick, _now_tick + 1);
+        _slots[0][tick & ((1 << LEVEL0_BITS) - 1)].push_back(e);
+        return;
+    }
+
+    // the parked entries are cascaded again when the last level comes round
+    uint64_t tick = span < MAX_SPAN_TICKS ? e.expire_tick : _now_tick + MAX_SPAN_TICKS - 1;
+    for (int level = 1; level < LEVEL_COUNT; ++level) {
+        int shift = LEVEL0_BITS + LEVEL_BITS * level;
+        if (span < (1ULL << shift) || level == LEVEL_COUNT - 1) {
+            int index = (tick >> (shift - LEVEL_BITS)) & ((1 << LEVEL_BITS) - 1);
+            _slots[level][index].push_back(e);
+            return;
+        }
+    }
+}
+
+uint64_t timing_wheel_timer_service::next_event_tick() const
+{
+    const uint64_t level0_mask = (1 << LEVEL0_BITS) - 1;
+    uint64_t round_end = (_now_tick | level0_mask) + 1;
+    for (uint64_t tick = _now_tick + 1; tick < round_end; ++tick) {
+        if (!_slots[0][tick & level0_mask].empty()) {
+            return tick;
+        }
+    }
+    return round_end;
+}
+
+void timing_wheel_timer_service::cascade(int level, int index)
+{
+    std::vector<timer_entry> entries;
+    entries.swap(_slots[level][index]);
+    for (timer_entry &e : entries) {
+        insert(e);
+    }
+}
+
+void timing_wheel_timer_service::advance_to(uint64_t tick, std::vector<timer_entry> &expired)
+{
+    const uint64_t level0_mask = (1 << LEVEL0_BITS) - 1;
+    const uint64_t level_mask = (1 << LEVEL_BITS) - 1;
+    while (_now_tick < tick) {
+        if (_timer_count == 0) {
+            _now_tick = tick;
+            return;
+        }
+
+        // skip the ticks with nothing to do
+        _now_tick = std::min(next_event_tick(), tick);
+
+        // cascade from the upper levels first when a round of level 0 begins
+        if ((_now_tick & level0_mask) == 0) {
+            for (int level = LEVEL_COUNT - 1; level > 0; --level) {
+                int shift = LEVEL0_BITS + LEVEL_BITS * (level - 1);
+                if ((_now_tick & ((1ULL << shift) - 1)) == 0) {
+                    cascade(level, (_now_tick >> shift) & level_mask);
+                }
+            }
+        }
+
+        auto &slot = _slots[0][_now_tick & level0_mask];
+        _timer_count -= slot.size();
+        expired.insert(expired.end(), slot.begin(), slot.end());
+        slot.clear();
+    }
+}
+
+void timing_wheel_timer_service::run()
+{
+    std::vector<timer_entry> expired;
+    std::unique_lock<std::mutex> l(_lock);
+    while (!_stopped) {
+        advance_to(current_tick(), expired);
+        if (!expired.empty()) {
+            l.unlock();
+            for (timer_entry &e : expired) {
+                e.t->enqueue();
+
+                // to consume the added ref count by task::enqueue for add_timer
+                e.t->release_ref();
+            }
+            expired.clear();
+            l.lock();
+            continue;
+        }
+
+        if (_timer_count == 0) {
+            _wakeup_tick = UINT64_MAX;
+            _cond.wait(l);
+        } else {
+            _wakeup_tick = next_event_tick();
+            _cond.wait_until(l, _start_time + std::chrono::milliseconds(_wakeup_tick * _tick_ms));
+        }
+    }
+}
+
+} // namespace tools
+} // namespace dsn
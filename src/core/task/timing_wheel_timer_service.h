@@ -0,0 +1,90 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <dsn/tool-api/timer_service.h>
+
+namespace dsn {
+class task;
+
+namespace tools {
+
+// timing_wheel_timer_service keeps the delayed tasks in a hierarchical timing wheel, driven
+// by one thread:
+//  - level 0 has 256 slots of one tick each, and every upper level has 64 slots each
+//    covering a whole round of the level below, so 4 levels cover 2^26 ticks (about
+//    18 hours with 1ms ticks); longer delays are parked in the last level and cascaded
+//    again when due
+//  - add_timer() is O(1): the task is appended to the slot of its expiration tick
+//  - cancelling is O(1) as well, as a cancelled task stays in its slot and is dropped by
+//    task::exec_internal when it expires, the same as with simple_timer_service
+//
+// Compared with one boost::asio::deadline_timer per task, there is no heap allocation or
+// reordering of a timer queue per task, which matters when there are lots of outstanding
+// rpc timeouts. The price is that a task is delayed by at most one more tick.
+class timing_wheel_timer_service : public timer_service
+{
+public:
+    timing_wheel_timer_service(service_node *node, timer_service *inner_provider);
+
+    ~timing_wheel_timer_service() override;
+
+    // after milliseconds, the provider should call task->enqueue()
+    void add_timer(task *task) override;
+
+    void start() override;
+
+private:
+    struct timer_entry
+    {
+        task *t;
+        uint64_t expire_tick;
+    };
+
+    static const int LEVEL_COUNT = 4;
+    static const int LEVEL0_BITS = 8;
+    static const int LEVEL_BITS = 6;
+    static const uint64_t MAX_SPAN_TICKS = 1ULL << (LEVEL0_BITS + LEVEL_BITS * (LEVEL_COUNT - 1));
+
+    uint64_t current_tick() const;
+
+    // put the entry to the slot of its expiration tick, relative to _now_tick
+    void insert(timer_entry e);
+
+    // the first tick after _now_tick which has tasks to expire or slots to cascade,
+    // must be called when there is any timer
+    uint64_t next_event_tick() const;
+
+    // advance the wheel to `tick`, and move the expired tasks to `expired`
+    void advance_to(uint64_t tick, std::vector<timer_entry> &expired);
+
+    void cascade(int level, int index);
+
+    void run();
+
+    const std::chrono::steady_clock::time_point _start_time;
+    const uint32_t _tick_ms;
+
+    std::mutex _lock;
+    std::condition_variable _cond;
+    std::vector<timer_entry> _slots[LEVEL_COUNT][1 << LEVEL0_BITS];
+    // all ticks up to and including _now_tick have been processed
+    uint64_t _now_tick;
+    // the tick at which the worker is going to wake up, UINT64_MAX if it waits for new timers
+    uint64_t _wakeup_tick;
+    uint64_t _timer_count;
+    bool _stopped;
+
+    std::thread _worker;
+};
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,161 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "work_stealing_task_queue.h"
+#include "task_engine.h"
+
+#include <dsn/utility/smart_pointers.h>
+
+namespace dsn {
+namespace tools {
+
+static thread_local int tls_affinity = -1;
+
+/*static*/ void work_stealing_task_queue::set_thread_affinity(int affinity)
+{
+    tls_affinity = affinity;
+}
+
+work_stealing_task_queue::work_stealing_task_queue(task_worker_pool *pool,
+                                                   int index,
+                                                   task_queue *inner_provider)
+    : task_queue(pool, index, inner_provider), _next_deque(0)
+{
+    dassert(!pool->spec().partitioned,
+            "work_stealing_task_queue can only be used by non-partitioned pool, pool = %s",
+            pool->spec().name.c_str());
+
+    int worker_count = std::max(pool->spec().worker_count, 1);
+    for (int i = 0; i < worker_count; ++i) {
+        _deques.emplace_back(make_unique<worker_deque>());
+    }
+}
+
+int work_stealing_task_queue::current_deque_index() const
+{
+    if (tls_dsn.magic != 0xdeadbeef || tls_dsn.worker == nullptr ||
+        tls_dsn.worker->pool() != pool()) {
+        return -1;
+    }
+    return tls_dsn.worker->index() % static_cast<int>(_deques.size());
+}
+
+int work_stealing_task_queue::enqueue_deque_index()
+{
+    int idx = current_deque_index();
+    if (idx < 0 && tls_affinity >= 0) {
+        idx = tls_affinity % static_cast<int>(_deques.size());
+    } else if (idx < 0) {
+        idx = static_cast<int>(_next_deque.fetch_add(1, std::memory_order_relaxed) %
+                               static_cast<uint32_t>(_deques.size()));
+    }
+    return idx;
+}
+
+void work_stealing_task_queue::enqueue(task *task)
+{
+    worker_deque &dq = *_deques[enqueue_deque_index()];
+    {
+        utils::auto_lock<utils::ex_lock_nr_spin> l(dq.lock);
+        dq.q[task->spec().priority].push_back(task);
+        dq.count.fetch_add(1, std::memory_order_relaxed);
+    }
+    _sema.signal(1);
+}
+
+void work_stealing_task_queue::enqueue_batch(const std::vector<task *> &tasks)
+{
+    worker_deque &dq = *_deques[enqueue_deque_index()];
+    {
+        utils::auto_lock<utils::ex_lock_nr_spin> l(dq.lock);
+        for (task *t : tasks) {
+            dq.q[t->spec().priority].push_back(t);
+        }
+        dq.count.fetch_add(static_cast<int>(tasks.size()), std::memory_order_relaxed);
+    }
+    _sema.signal(static_cast<int>(tasks.size()));
+}
+
+/*static*/ int
+work_stealing_task_queue::pop_tasks(worker_deque &dq, int max_count, task *&head, task *&last)
+{
+    if (dq.count.load(std::memory_order_relaxed) == 0) {
+        return 0;
+    }
+
+    int popped = 0;
+    utils::auto_lock<utils::ex_lock_nr_spin> l(dq.lock);
+    for (int pri = TASK_PRIORITY_COUNT - 1; pri >= 0 && popped < max_count; --pri) {
+        auto &q = dq.q[pri];
+        while (!q.empty() && popped < max_count) {
+            task *t = q.front();
+            q.pop_front();
+            t->next = nullptr;
+            if (last) {
+                last->next = t;
+            } else {
+                head = t;
+            }
+            last = t;
+            ++popped;
+        }
+    }
+    dq.count.fetch_sub(popped, std::memory_order_relaxed);
+    return popped;
+}
+
+task *work_stealing_task_queue::dequeue(/*inout*/ int &batch_size)
+{
+    batch_size = static_cast<int>(_sema.waitMany(batch_size));
+    if (batch_size == 0) {
+        return nullptr;
+    }
+
+    int self = current_deque_index();
+    if (self < 0) {
+        self = 0;
+    }
+
+    task *head = nullptr, *last = nullptr;
+    int deque_count = static_cast<int>(_deques.size());
+
+    // the semaphore guarantees that there are at least batch_size tasks in all the deques,
+    // which may be stolen by other workers concurrently, so retry until all are collected
+    int remaining = batch_size - pop_tasks(*_deques[self], batch_size, head, last);
+    while (remaining > 0) {
+        for (int i = 1; i <= deque_count && remaining > 0; ++i) {
+            worker_deque &victim = *_deques[(self + i) % deque_count];
+            // take at most half of the victim's tasks to leave some for its owner
+            int steal = std::min(remaining,
+                                 std::max(1, victim.count.load(std::memory_order_relaxed) / 2));
+            remaining -= pop_tasks(victim, steal, head, last);
+        }
+    }
+    return head;
+}
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,91 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <concurrentqueue/lightweightsemaphore.h>
+
+#include <dsn/tool-api/task_queue.h>
+#include <dsn/utility/synchronize.h>
+
+namespace dsn {
+namespace tools {
+
+// work_stealing_task_queue is a task queue shared by all the workers of a
+// non-partitioned pool, which internally keeps one deque per worker:
+//  - tasks enqueued from a worker of the same pool go to that worker's own deque,
+//    tasks enqueued from other threads are spread round-robin on the deques, unless
+//    the thread is bound to a deque by set_thread_affinity()
+//  - a worker dequeues from its own deque first, and steals from its siblings
+//    when its own deque is drained
+//
+// Like other task queues, higher priority tasks are always dequeued first within
+// a deque, and dequeue(batch_size) blocks until at least one task is available.
+class work_stealing_task_queue : public task_queue
+{
+public:
+    work_stealing_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider);
+
+    void enqueue(task *task) override;
+
+    // all the tasks go to the same deque
+    void enqueue_batch(const std::vector<task *> &tasks) override;
+
+    task *dequeue(/*inout*/ int &batch_size) override;
+
+    // bind current thread, which is not a worker, to the deque `affinity % worker_count` of
+    // every work stealing queue, e.g. the io threads of the reactors, so that the tasks of the
+    // sessions of a reactor are handled by the same worker unless stolen; -1 to unbind
+    static void set_thread_affinity(int affinity);
+
+private:
+    struct worker_deque
+    {
+        utils::ex_lock_nr_spin lock;
+        std::deque<task *> q[TASK_PRIORITY_COUNT];
+        std::atomic<int> count{0};
+    };
+
+    // index of the deque bound to current thread, or -1 if current thread
+    // is not a worker of this pool
+    int current_deque_index() const;
+
+    // the deque to enqueue into from current thread
+    int enqueue_deque_index();
+
+    // pop at most `max_count` tasks from `dq`, higher priority first,
+    // and append them to the linked list [head, last]
+    static int pop_tasks(worker_deque &dq, int max_count, task *&head, task *&last);
+
+    moodycamel::LightweightSemaphore _sema;
+    std::vector<std::unique_ptr<worker_deque>> _deques;
+    std::atomic<uint32_t> _next_deque;
+};
+
+} // namespace tools
+} // namespace dsn
@@ -36,6 +36,7 @@
 #include <dsn/tool-api/rpc_address.h>
 #include <dsn/tool-api/group_address.h>
 #include <gtest/gtest.h>
+#include <set>
 
 using namespace ::dsn;
 
@@ -221,3 +222,38 @@ TEST(core, rpc_group_address)
     ASSERT_EQ(0u, g->members().size());
     ASSERT_EQ(invalid_addr, g->leader());
 }
+
+TEST(core, rpc_group_address_remove_before_leader)
+{
+    rpc_address addr1("127.0.0.1", 8080);
+    rpc_address addr2("127.0.0.1", 8081);
+    rpc_address addr3("127.0.0.1", 8082);
+
+    rpc_address t;
+    t.assign_group("test_group_remove");
+    rpc_group_address *g = t.group_address();
+    g->add_list({addr1, addr2, addr3});
+    g->set_leader(addr3);
+    ASSERT_EQ(addr3, g->leader());
+
+    // the leader is kept when a member before it is removed
+    ASSERT_TRUE(g->remove(addr1));
+    ASSERT_EQ(addr3, g->leader());
+    ASSERT_EQ(addr3, g->possible_leader());
+
+    g->leader_forward();
+    ASSERT_EQ(addr2, g->leader());
+}
+
+TEST(core, rpc_address_hash)
+{
+    // the ips of a cluster differ in the low bits, which used to collide with the ports
+    std::hash<rpc_address> hasher;
+    std::set<size_t> hashes;
+    for (uint32_t ip = 0; ip < 16; ip++) {
+        for (uint16_t port = 34800; port < 34816; port++) {
+            hashes.insert(hasher(rpc_address((10 << 24) + ip, port)));
+        }
+    }
+    ASSERT_EQ(16 * 16, hashes.size());
+}
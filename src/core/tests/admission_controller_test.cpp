@@ -0,0 +1,61 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/service_api_cpp.h>
+#include <dsn/tool-api/admission_controller.h>
+#include <dsn/tool-api/rpc_message.h>
+#include <dsn/utility/time_utils.h>
+#include <gtest/gtest.h>
+
+#include "core/task/task_engine.h"
+
+namespace dsn {
+
+DEFINE_STORAGE_RPC_CODE(RPC_TEST_CODEL_CLIENT_READ,
+                        TASK_PRIORITY_COMMON,
+                        THREAD_POOL_DEFAULT,
+                        false,
+                        NOT_ALLOW_BATCH,
+                        IS_IDEMPOTENT)
+DEFINE_TASK_CODE_RPC(RPC_TEST_CODEL_INTERNAL, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+static const uint64_t ms = 1000000;
+
+TEST(admission_controller_test, codel)
+{
+    service_node *node = task::get_current_node2();
+    ASSERT_NE(nullptr, node);
+    task_queue *q = node->computation()->get_pool(THREAD_POOL_DEFAULT)->queues()[0];
+
+    std::vector<std::string> args = {"10", "200"};
+    codel_admission_controller controller(q, args);
+
+    message_ex *client_request = message_ex::create_request(RPC_TEST_CODEL_CLIENT_READ);
+    rpc_request_task_ptr client_task(new rpc_request_task(client_request, nullptr, node));
+    message_ex *internal_request = message_ex::create_request(RPC_TEST_CODEL_INTERNAL);
+    rpc_request_task_ptr internal_task(new rpc_request_task(internal_request, nullptr, node));
+    task *client = client_task.get();
+    task *internal = internal_task.get();
+
+    uint64_t now = utils::get_current_physical_time_ns();
+    ASSERT_TRUE(controller.is_dequeued_task_accepted(client, 1 * ms, now));
+    ASSERT_FALSE(controller.is_overloaded(now + 100 * ms));
+
+    // not overloaded yet, only the requests waiting longer than the interval are rejected
+    ASSERT_TRUE(controller.is_dequeued_task_accepted(client, 50 * ms, now + 100 * ms));
+    ASSERT_FALSE(controller.is_dequeued_task_accepted(client, 250 * ms, now + 100 * ms));
+    ASSERT_TRUE(controller.is_dequeued_task_accepted(internal, 250 * ms, now + 100 * ms));
+
+    // above the target for an interval
+    ASSERT_TRUE(controller.is_overloaded(now + 201 * ms));
+    ASSERT_FALSE(controller.is_dequeued_task_accepted(client, 50 * ms, now + 201 * ms));
+    ASSERT_TRUE(controller.is_dequeued_task_accepted(internal, 50 * ms, now + 201 * ms));
+
+    // back to normal once a task is dequeued below the target
+    ASSERT_TRUE(controller.is_dequeued_task_accepted(internal, 5 * ms, now + 202 * ms));
+    ASSERT_FALSE(controller.is_overloaded(now + 203 * ms));
+    ASSERT_TRUE(controller.is_dequeued_task_accepted(client, 50 * ms, now + 203 * ms));
+}
+
+} // namespace dsn
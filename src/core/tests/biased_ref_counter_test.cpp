@@ -0,0 +1,121 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/autoref_ptr.h>
+#include <dsn/utility/biased_ref_counter.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+
+namespace dsn {
+
+class biased_object : public biased_ref_counter
+{
+public:
+    explicit biased_object(std::atomic<int> &destroyed) : _destroyed(destroyed) {}
+    ~biased_object() override { ++_destroyed; }
+
+private:
+    std::atomic<int> &_destroyed;
+};
+
+typedef ref_ptr<biased_object> biased_object_ptr;
+
+// run `cb` on a thread owning the biased objects
+template <typename Callback>
+void run_on_owner(Callback &&cb)
+{
+    std::thread owner([&cb]() {
+        biased_ref_counter::enable_biasing();
+        cb();
+    });
+    owner.join();
+}
+
+TEST(biased_ref_counter_test, referenced_by_owner)
+{
+    std::atomic<int> destroyed{0};
+    run_on_owner([&destroyed]() {
+        biased_object_ptr obj(new biased_object(destroyed));
+        {
+            biased_object_ptr copy = obj;
+            ASSERT_EQ(2, obj->get_count());
+        }
+        ASSERT_EQ(1, obj->get_count());
+        obj = nullptr;
+        ASSERT_EQ(1, destroyed);
+    });
+}
+
+TEST(biased_ref_counter_test, dropped_by_others)
+{
+    std::atomic<int> destroyed{0};
+    run_on_owner([&destroyed]() {
+        // the reference taken by the owner is dropped by another thread
+        biased_object_ptr obj(new biased_object(destroyed));
+        biased_object *raw = obj.get();
+        raw->add_ref();
+        std::thread([raw]() { raw->release_ref(); }).join();
+        ASSERT_EQ(1, obj->get_count());
+
+        biased_ref_counter::merge_queued();
+        ASSERT_EQ(1, obj->get_count());
+        ASSERT_EQ(0, destroyed);
+        obj = nullptr;
+        ASSERT_EQ(1, destroyed);
+
+        // all the references are taken and dropped by another thread
+        raw = new biased_object(destroyed);
+        std::thread([raw]() { biased_object_ptr ptr(raw); }).join();
+        ASSERT_EQ(1, destroyed);
+        biased_ref_counter::merge_queued();
+        ASSERT_EQ(2, destroyed);
+    });
+}
+
+TEST(biased_ref_counter_test, referenced_by_others)
+{
+    std::atomic<int> destroyed{0};
+    biased_object_ptr shared;
+    run_on_owner([&destroyed, &shared]() {
+        biased_object_ptr obj(new biased_object(destroyed));
+        std::thread([&obj, &shared]() { shared = obj; }).join();
+        ASSERT_EQ(2, obj->get_count());
+        obj = nullptr;
+    });
+
+    // the owner has merged its count when it dropped its references
+    ASSERT_EQ(0, destroyed);
+    ASSERT_EQ(1, shared->get_count());
+    shared = nullptr;
+    ASSERT_EQ(1, destroyed);
+}
+
+TEST(biased_ref_counter_test, owner_exited)
+{
+    std::atomic<int> destroyed{0};
+    biased_object *raw = nullptr;
+    run_on_owner([&destroyed, &raw]() {
+        raw = new biased_object(destroyed);
+        raw->add_ref();
+    });
+
+    // dropped after the owner exits
+    ASSERT_EQ(0, destroyed);
+    raw->release_ref();
+    ASSERT_EQ(1, destroyed);
+}
+
+TEST(biased_ref_counter_test, not_biased)
+{
+    // the objects created on the threads not owning objects are counted atomically
+    std::atomic<int> destroyed{0};
+    biased_object_ptr obj(new biased_object(destroyed));
+    std::thread([obj]() { ASSERT_EQ(2, obj->get_count()); }).join();
+    ASSERT_EQ(1, obj->get_count());
+    obj = nullptr;
+    ASSERT_EQ(1, destroyed);
+}
+
+} // namespace dsn
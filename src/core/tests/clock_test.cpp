@@ -0,0 +1,50 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include <dsn/c/api_layer1.h>
+#include <dsn/utility/clock.h>
+#include <dsn/utility/time_utils.h>
+
+#include "core/core/tsc_clock.h"
+
+namespace dsn {
+namespace utils {
+
+TEST(clock_test, tsc_clock)
+{
+    if (!tsc_clock::available()) {
+        return;
+    }
+
+    tsc_clock::calibrate();
+    tsc_clock clk;
+    uint64_t last_ns = 0;
+    for (int i = 0; i < 100; ++i) {
+        uint64_t before_ns = get_current_physical_time_ns();
+        uint64_t ns = clk.now_ns();
+        uint64_t after_ns = get_current_physical_time_ns();
+        // within 1ms of the system clock
+        ASSERT_LE(before_ns, ns + 1000000);
+        ASSERT_LE(ns, after_ns + 1000000);
+        ASSERT_LE(last_ns, ns);
+        last_ns = ns;
+        if (i % 10 == 0) {
+            tsc_clock::calibrate();
+        }
+    }
+}
+
+TEST(clock_test, coarse_now_ms)
+{
+    uint64_t before_ms = dsn_now_ms();
+    uint64_t coarse_ms = dsn_now_coarse_ms();
+    uint64_t after_ms = dsn_now_ms();
+    ASSERT_LE(coarse_ms, after_ms);
+    ASSERT_LE(before_ms, coarse_ms + 1000);
+}
+
+} // namespace utils
+} // namespace dsn
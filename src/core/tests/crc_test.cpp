@@ -0,0 +1,106 @@
+// Copyright (c) 2017, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "core/core/crc_impl.h"
+
+#include <dsn/utility/crc.h>
+#include <dsn/utility/rand.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+
+namespace dsn {
+namespace utils {
+
+class crc_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        _buffer.resize(BUFFER_SIZE);
+        for (auto &c : _buffer) {
+            c = static_cast<char>(rand::next_u32(0, 255));
+        }
+    }
+
+    static constexpr size_t BUFFER_SIZE = 4 << 20;
+    std::string _buffer;
+};
+
+TEST_F(crc_test, implementations_agree)
+{
+    const auto &impls = crc_impl::supported_implementations();
+    ASSERT_FALSE(impls.empty());
+    ASSERT_STREQ("table", impls[0].name);
+
+    for (int i = 0; i < 2000; ++i) {
+        size_t offset = rand::next_u32(0, 63);
+        size_t size = rand::next_u32(0, i < 1000 ? 512 : 65536);
+        uint32_t init32 = (i % 2 == 0) ? 0 : rand::next_u32();
+        uint64_t init64 = (i % 2 == 0) ? 0 : rand::next_u64();
+        const char *ptr = _buffer.data() + offset;
+
+        uint32_t expect32 = impls[0].crc32(ptr, size, init32);
+        uint64_t expect64 = impls[0].crc64(ptr, size, init64);
+        for (const auto &impl : impls) {
+            ASSERT_EQ(expect32, impl.crc32(ptr, size, init32)) << impl.name << ", size = " << size;
+            ASSERT_EQ(expect64, impl.crc64(ptr, size, init64)) << impl.name << ", size = " << size;
+        }
+        ASSERT_EQ(expect32, crc32_calc(ptr, size, init32));
+        ASSERT_EQ(expect64, crc64_calc(ptr, size, init64));
+    }
+}
+
+TEST_F(crc_test, combine)
+{
+    for (int i = 0; i < 100; ++i) {
+        size_t x_size = rand::next_u32(0, 10000);
+        size_t y_size = rand::next_u32(0, 10000);
+        uint32_t init32 = rand::next_u32();
+        uint64_t init64 = rand::next_u64();
+        const char *x = _buffer.data();
+        const char *y = x + x_size;
+
+        uint32_t x32 = crc32_calc(x, x_size, init32);
+        uint32_t y32 = crc32_calc(y, y_size, 0);
+        ASSERT_EQ(crc32_calc(x, x_size + y_size, init32), crc32_combine(x32, y32, y_size));
+
+        uint64_t x64 = crc64_calc(x, x_size, init64);
+        uint64_t y64 = crc64_calc(y, y_size, 0);
+        ASSERT_EQ(crc64_calc(x, x_size + y_size, init64), crc64_combine(x64, y64, y_size));
+    }
+}
+
+TEST_F(crc_test, benchmark)
+{
+    const int rounds = 20;
+    for (const auto &impl : crc_impl::supported_implementations()) {
+        for (size_t size : {(size_t)64, (size_t)4096, (size_t)(4 << 20)}) {
+            size_t count = rounds * (BUFFER_SIZE / size);
+
+            uint32_t crc32 = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < count; ++i) {
+                crc32 = impl.crc32(_buffer.data() + (i * size) % BUFFER_SIZE, size, crc32);
+            }
+            std::chrono::duration<double> crc32_elapsed = std::chrono::steady_clock::now() - start;
+
+            uint64_t crc64 = 0;
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < count; ++i) {
+                crc64 = impl.crc64(_buffer.data() + (i * size) % BUFFER_SIZE, size, crc64);
+            }
+            std::chrono::duration<double> crc64_elapsed = std::chrono::steady_clock::now() - start;
+
+            double bytes = static_cast<double>(count * size);
+            std::cout << impl.name << ": size = " << size
+                      << ", crc32 = " << bytes / crc32_elapsed.count() / 1e9 << " GB/s"
+                      << ", crc64 = " << bytes / crc64_elapsed.count() / 1e9 << " GB/s"
+                      << " (" << crc32 << ", " << crc64 << ")" << std::endl;
+        }
+    }
+}
+
+} // namespace utils
+} // namespace dsn
@@ -17,7 +17,9 @@
 
 #include "core/core/fail_point_impl.h"
 
+#include <dsn/utility/time_utils.h>
 #include <gtest/gtest.h>
+#include <iostream>
 
 namespace dsn {
 namespace fail {
@@ -151,5 +153,51 @@ TEST(fail_point, return_void)
     teardown();
 }
 
+int bench_func(int i)
+{
+    FAIL_POINT_INJECT_F("bench", [](string_view str) -> int { return -1; });
+    return i;
+}
+
+// the overhead of a fail point on hot paths, e.g. replication_app_base::apply_mutation()
+TEST(fail_point, benchmark)
+{
+    const int count = 10000000;
+    auto bench = [count](const char *title) {
+        uint64_t start_ns = utils::get_current_physical_time_ns();
+        int64_t sum = 0;
+        for (int i = 0; i < count; i++) {
+            sum += bench_func(i);
+        }
+        uint64_t elapsed_ns = utils::get_current_physical_time_ns() - start_ns;
+        std::cout << title << ": " << elapsed_ns / (double)count << " ns per check" << std::endl;
+        return sum;
+    };
+
+    int64_t expected = (int64_t)count * (count - 1) / 2;
+    ASSERT_EQ(expected, bench("disabled"));
+
+    // the fail points are set up, but none of them is configured
+    setup();
+    ASSERT_EQ(expected, bench("setup without any configured"));
+
+    // another fail point is configured, this one is looked up by its cached handle
+    cfg("bench_other", "return()");
+    ASSERT_EQ(expected, bench("another configured"));
+
+    uint64_t start_ns = utils::get_current_physical_time_ns();
+    for (int i = 0; i < count; i++) {
+        ASSERT_EQ(nullptr, eval("bench"));
+    }
+    std::cout << "lookup by name: "
+              << (utils::get_current_physical_time_ns() - start_ns) / (double)count
+              << " ns per check" << std::endl;
+
+    cfg("bench", "return()");
+    ASSERT_EQ(-1, bench_func(0));
+    teardown();
+    ASSERT_EQ(0, bench_func(0));
+}
+
 } // namespace fail
 } // namespace dsn
@@ -25,6 +25,60 @@ TEST(verify_file, verify_file_test)
     remove_path(fname);
 }
 
+TEST(verify_file, verify_files_test)
+{
+    std::vector<file_to_verify> files;
+    for (int i = 0; i < 8; ++i) {
+        std::string fname = "test_verify_files_" + std::to_string(i);
+        create_file(fname);
+        file_to_verify f;
+        f.fname = fname;
+        md5sum(fname, f.md5);
+        file_size(fname, f.size);
+        files.push_back(f);
+    }
+    files[3].md5 = "wrong_md5";
+    files[5].size = 10086;
+    files.push_back({"file_not_exists", "wrong_md5", 10086});
+
+    for (int threads : {1, 4, 16}) {
+        std::vector<bool> results;
+        ASSERT_FALSE(verify_files(files, threads, results));
+        ASSERT_EQ(results.size(), files.size());
+        for (size_t i = 0; i < files.size(); ++i) {
+            ASSERT_EQ(results[i], i != 3 && i != 5 && i != 8) << i;
+        }
+    }
+
+    files.resize(3);
+    std::vector<bool> results;
+    ASSERT_TRUE(verify_files(files, 2, results));
+    ASSERT_TRUE(verify_files({}, 2, results));
+    ASSERT_TRUE(results.empty());
+
+    for (int i = 0; i < 8; ++i) {
+        remove_path("test_verify_files_" + std::to_string(i));
+    }
+}
+
+TEST(copy_file, copy_file_test)
+{
+    const std::string &fname = "test_copy_src";
+    const std::string &target = "test_copy_target";
+    create_file(fname);
+    std::string expected_md5;
+    md5sum(fname, expected_md5);
+
+    ASSERT_TRUE(copy_file(fname, target));
+    ASSERT_TRUE(verify_file(target, expected_md5, 0));
+    // the target must not exist
+    ASSERT_FALSE(copy_file(fname, target));
+    ASSERT_FALSE(copy_file("file_not_exists", "test_copy_target2"));
+
+    remove_path(fname);
+    remove_path(target);
+}
+
 } // namespace filesystem
 } // namespace utils
 } // namespace dsn
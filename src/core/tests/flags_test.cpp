@@ -0,0 +1,43 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/flags.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+
+DSN_DEFINE_int32("flags_test", test_mutable_int32, 5, "");
+DSN_DEFINE_validator(test_mutable_int32, [](int32_t value) -> bool { return value >= 0; });
+DSN_TAG_VARIABLE(test_mutable_int32, FT_MUTABLE);
+
+DSN_DEFINE_bool("flags_test", test_mutable_bool, false, "");
+DSN_TAG_VARIABLE(test_mutable_bool, FT_MUTABLE);
+
+DSN_DEFINE_uint64("flags_test", test_immutable_uint64, 10, "");
+
+TEST(flags_test, update_flag)
+{
+    ASSERT_TRUE(update_flag("test_mutable_int32", "10").is_ok());
+    ASSERT_EQ(10, FLAGS_test_mutable_int32);
+    ASSERT_EQ("10", get_flag_str("test_mutable_int32").get_value());
+
+    // rejected by the validator, and the value is kept
+    ASSERT_EQ(ERR_INVALID_PARAMETERS, update_flag("test_mutable_int32", "-1").code());
+    ASSERT_EQ(10, FLAGS_test_mutable_int32);
+
+    // not a number
+    ASSERT_EQ(ERR_INVALID_PARAMETERS, update_flag("test_mutable_int32", "abc").code());
+    ASSERT_EQ(10, FLAGS_test_mutable_int32);
+
+    ASSERT_TRUE(update_flag("test_mutable_bool", "true").is_ok());
+    ASSERT_TRUE(FLAGS_test_mutable_bool);
+
+    ASSERT_EQ(ERR_OPERATION_DISABLED, update_flag("test_immutable_uint64", "20").code());
+    ASSERT_EQ(10, FLAGS_test_immutable_uint64);
+
+    ASSERT_EQ(ERR_OBJECT_NOT_FOUND, update_flag("test_not_existed", "1").code());
+    ASSERT_FALSE(get_flag_str("test_not_existed").is_ok());
+}
+
+} // namespace dsn
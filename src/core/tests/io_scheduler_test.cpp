@@ -0,0 +1,103 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/flags.h>
+#include <dsn/utility/io_scheduler.h>
+#include <dsn/utility/time_utils.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+
+DSN_DECLARE_bool(enable_io_scheduler);
+DSN_DECLARE_uint32(io_max_rate_mb);
+DSN_DECLARE_uint32(io_min_rate_mb);
+DSN_DECLARE_uint32(io_foreground_latency_target_ms);
+
+class io_scheduler_test : public testing::Test
+{
+public:
+    void SetUp() override { FLAGS_enable_io_scheduler = true; }
+    void TearDown() override { FLAGS_enable_io_scheduler = false; }
+
+    static uint64_t now_ms() { return utils::get_current_physical_time_ns() / 1000000; }
+
+    void mark_active(io_class cls, uint64_t now)
+    {
+        _s._classes[static_cast<int>(cls)].last_active_ms.store(now);
+    }
+
+    std::string find_disk(const std::string &path)
+    {
+        auto d = _s.find_disk(path);
+        return d == nullptr ? "" : d->tag;
+    }
+
+    io_scheduler _s;
+};
+
+TEST_F(io_scheduler_test, disabled)
+{
+    FLAGS_enable_io_scheduler = false;
+    ASSERT_EQ(0u, _s.reserve(io_class::LEARN, "", 1ULL << 40));
+}
+
+TEST_F(io_scheduler_test, weighted_share)
+{
+    const double cap = static_cast<double>(FLAGS_io_max_rate_mb) * (1 << 20);
+    ASSERT_DOUBLE_EQ(cap, _s.cap());
+
+    uint64_t now = now_ms();
+    mark_active(io_class::LEARN, now);
+    mark_active(io_class::BACKUP, now);
+    _s.adjust(now);
+
+    // learn:backup = 4:1, and the inactive ones are shared as if they were active
+    ASSERT_DOUBLE_EQ(cap * 4 / 5, _s.rate(io_class::LEARN));
+    ASSERT_DOUBLE_EQ(cap * 1 / 5, _s.rate(io_class::BACKUP));
+    ASSERT_DOUBLE_EQ(cap * 2 / 7, _s.rate(io_class::BULK_LOAD));
+    ASSERT_DOUBLE_EQ(cap * 3 / 8, _s.rate(io_class::DUPLICATION));
+
+    // the bucket is full at the beginning, and borrowing is allowed beyond it
+    ASSERT_EQ(0u, _s.reserve(io_class::BACKUP, "", 1 << 20));
+    ASSERT_GT(_s.reserve(io_class::BACKUP, "", static_cast<uint64_t>(cap)), 500u);
+}
+
+TEST_F(io_scheduler_test, back_off)
+{
+    const double mb = 1 << 20;
+    uint64_t now = now_ms();
+    for (int i = 0; i < 100; ++i) {
+        _s.observe_foreground_latency((FLAGS_io_foreground_latency_target_ms + 10) * 1000000ULL);
+    }
+
+    _s.adjust(now);
+    ASSERT_DOUBLE_EQ(FLAGS_io_max_rate_mb * mb / 2, _s.cap());
+    for (int i = 0; i < 10; ++i) {
+        _s.adjust(now);
+    }
+    ASSERT_DOUBLE_EQ(FLAGS_io_min_rate_mb * mb, _s.cap());
+
+    // recover additively once the latency is back to normal
+    for (int i = 0; i < 100; ++i) {
+        _s.observe_foreground_latency(1000000);
+    }
+    _s.adjust(now);
+    ASSERT_DOUBLE_EQ(FLAGS_io_min_rate_mb * mb + FLAGS_io_max_rate_mb * mb / 10, _s.cap());
+}
+
+TEST_F(io_scheduler_test, find_disk)
+{
+    _s.register_disk("ssd1", "/home/work/ssd1");
+    _s.register_disk("ssd1_sub", "/home/work/ssd1/sub");
+    _s.register_disk("ssd10", "/home/work/ssd10");
+
+    ASSERT_EQ("ssd1", find_disk("/home/work/ssd1/replica/1.1.pegasus"));
+    ASSERT_EQ("ssd1_sub", find_disk("/home/work/ssd1/sub/file"));
+    ASSERT_EQ("ssd10", find_disk("/home/work/ssd10/file"));
+    ASSERT_EQ("ssd1", find_disk("/home/work/ssd1"));
+    ASSERT_EQ("", find_disk("/home/work/ssd2/file"));
+    ASSERT_EQ("", find_disk(""));
+}
+
+} // namespace dsn
@@ -158,3 +158,32 @@ TEST(core, join_point)
         ASSERT_EQ(check_vec, jp_vec);
     }
 }
+
+static int s_hook_calls = 0;
+static void count_hook_calls(int) { ++s_hook_calls; }
+
+TEST(core, join_point_hook_mask)
+{
+    uint32_t mask = 0x1;
+    join_point<void, int> jp1("jp1", &mask, 0x2);
+    join_point<void, int> jp2("jp2", &mask, 0x4);
+    ASSERT_TRUE(jp1.empty());
+    ASSERT_EQ(0x1u, mask);
+
+    jp1.put_back(count_hook_calls, "a");
+    jp1.put_back(count_hook_calls, "b");
+    jp2.put_front(count_hook_calls, "c");
+    ASSERT_FALSE(jp1.empty());
+    ASSERT_EQ(0x7u, mask);
+
+    jp1.execute(0);
+    ASSERT_EQ(2, s_hook_calls);
+
+    jp1.remove("a");
+    ASSERT_EQ(0x7u, mask);
+    jp1.remove("b");
+    ASSERT_TRUE(jp1.empty());
+    ASSERT_EQ(0x5u, mask);
+    jp2.remove("c");
+    ASSERT_EQ(0x1u, mask);
+}
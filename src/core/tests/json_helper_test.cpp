@@ -24,6 +24,10 @@
  * THE SOFTWARE.
  */
 
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
 #include <gtest/gtest.h>
 #include <dsn/cpp/json_helper.h>
 
@@ -494,4 +498,90 @@ TEST(json_helper, upgrade_downgrade)
     ASSERT_EQ(n2.c, o.c);
 }
 
+namespace {
+
+partition_configuration make_partition_configuration(int pidx)
+{
+    partition_configuration pc;
+    pc.pid = gpid(2, pidx);
+    pc.ballot = 5;
+    pc.max_replica_count = 3;
+    pc.primary = rpc_address("127.0.0.1", 34801);
+    pc.secondaries = {rpc_address("127.0.0.1", 34802), rpc_address("127.0.0.1", 34803)};
+    pc.last_drops = {rpc_address("127.0.0.1", 34804)};
+    pc.last_committed_decree = 100000 + pidx;
+    pc.partition_flags = 0;
+    return pc;
+}
+
+app_info make_app_info(int env_count)
+{
+    app_info info;
+    info.status = app_status::AS_AVAILABLE;
+    info.app_type = "pegasus";
+    info.app_name = "temp";
+    info.app_id = 2;
+    info.partition_count = 8;
+    for (int i = 0; i < env_count; i++) {
+        info.envs["env.key." + std::to_string(i)] = "env \"value\" " + std::to_string(i);
+    }
+    info.is_stateful = true;
+    info.max_replica_count = 3;
+    info.init_partition_count = 8;
+    return info;
+}
+
+} // anonymous namespace
+
+TEST(json_helper, large_document_encode_decode)
+{
+    // large enough to be parsed in situ
+    app_info info = make_app_info(1000);
+    blob bb = dsn::json::json_forwarder<app_info>::encode(info);
+    ASSERT_LE(dsn::json::JSON_INSITU_PARSE_MIN_BYTES, bb.length());
+
+    app_info decoded;
+    ASSERT_TRUE(dsn::json::json_forwarder<app_info>::decode(bb, decoded));
+    ASSERT_EQ(info, decoded);
+
+    // the same output is written into an std::ostream
+    std::ostringstream os;
+    dsn::json::json_forwarder<app_info>::encode(os, info);
+    ASSERT_EQ(bb.to_string(), os.str());
+}
+
+TEST(json_helper, encode_decode_benchmark)
+{
+    const int count = 100000;
+    std::vector<partition_configuration> pcs;
+    for (int i = 0; i < 8; i++) {
+        pcs.push_back(make_partition_configuration(i));
+    }
+    app_info info = make_app_info(10);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        const partition_configuration &pc = pcs[i % pcs.size()];
+        blob bb = dsn::json::json_forwarder<partition_configuration>::encode(pc);
+        partition_configuration decoded;
+        ASSERT_TRUE(dsn::json::json_forwarder<partition_configuration>::decode(bb, decoded));
+    }
+    auto pc_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        blob bb = dsn::json::json_forwarder<app_info>::encode(info);
+        app_info decoded;
+        ASSERT_TRUE(dsn::json::json_forwarder<app_info>::decode(bb, decoded));
+    }
+    auto info_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+    std::cout << "json round trip: partition_configuration " << pc_ns / count
+              << " ns, app_info " << info_ns / count << " ns" << std::endl;
+}
+
 } // namespace dsn
@@ -68,3 +68,26 @@ TEST(tools_common, std_lock_provider)
     delete rwlock;
     delete sema;
 }
+
+TEST(tools_common, adaptive_lock_providers)
+{
+    adaptive_lock_nr_provider *nr_lock = new adaptive_lock_nr_provider(nullptr);
+    nr_lock->lock();
+    EXPECT_FALSE(nr_lock->try_lock());
+    nr_lock->unlock();
+    EXPECT_TRUE(nr_lock->try_lock());
+    nr_lock->unlock();
+
+    reader_biased_rwlock_nr_provider *rwlock = new reader_biased_rwlock_nr_provider(nullptr);
+    rwlock->lock_read();
+    EXPECT_TRUE(rwlock->try_lock_read());
+    EXPECT_FALSE(rwlock->try_lock_write());
+    rwlock->unlock_read();
+    rwlock->unlock_read();
+    rwlock->lock_write();
+    EXPECT_FALSE(rwlock->try_lock_read());
+    rwlock->unlock_write();
+
+    delete nr_lock;
+    delete rwlock;
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/tool-api/command_manager.h>
+#include <dsn/tool-api/zlocks.h>
+#include <dsn/utility/defer.h>
+#include <dsn/utility/flags.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+namespace dsn {
+
+DSN_DECLARE_bool(enable_lock_profiling);
+
+static std::string contention()
+{
+    std::string output;
+    command_manager::instance().run_command("locks.contention", {}, output);
+    return output;
+}
+
+// a lock is held by `hold` on another thread for a while, during which it's locked by `lock`
+static void contend(const std::function<void()> &lock,
+                    const std::function<void()> &unlock,
+                    const std::function<void()> &hold)
+{
+    std::atomic<bool> held{false};
+    std::thread holder([&]() {
+        hold();
+        held = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        unlock();
+    });
+    while (!held) {
+    }
+    lock();
+    holder.join();
+}
+
+TEST(lock_profiling_test, contended_locks)
+{
+    FLAGS_enable_lock_profiling = true;
+    auto cleanup = defer([]() {
+        FLAGS_enable_lock_profiling = false;
+        std::string output;
+        command_manager::instance().run_command("locks.contention", {"reset"}, output);
+    });
+
+    zlock l(false, "lock_profiling_test::l");
+    {
+        // the uncontended locking isn't sampled
+        zauto_lock a(l);
+    }
+    ASSERT_EQ(std::string::npos, contention().find("lock_profiling_test::l"));
+
+    contend([&l]() { l.lock(); }, [&l]() { l.unlock(); }, [&l]() { l.lock(); });
+    l.unlock();
+    std::string output = contention();
+    ASSERT_NE(std::string::npos, output.find("lock_profiling_test::l (exclusive): waits = 1"))
+        << output;
+
+    zrwlock_nr rw("lock_profiling_test::rw");
+    contend([&rw]() { rw.lock_read(); },
+            [&rw]() { rw.unlock_write(); },
+            [&rw]() { rw.lock_write(); });
+    rw.unlock_read();
+    output = contention();
+    ASSERT_NE(std::string::npos, output.find("lock_profiling_test::rw (shared): waits = 1"))
+        << output;
+    ASSERT_EQ(std::string::npos, output.find("lock_profiling_test::rw (exclusive)")) << output;
+
+    command_manager::instance().run_command("locks.contention", {"reset"}, output);
+    ASSERT_EQ("OK", output);
+    ASSERT_EQ(std::string::npos, contention().find("lock_profiling_test::"));
+}
+
+} // namespace dsn
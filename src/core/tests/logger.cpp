@@ -35,7 +35,17 @@
 
 #include "core/tools/common/simple_logger.h"
 #include <gtest/gtest.h>
+#include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <fstream>
+
+namespace dsn {
+namespace tools {
+DSN_DECLARE_string(block_start_level);
+DSN_DECLARE_uint32(buffer_size_kb_per_thread);
+} // namespace tools
+} // namespace dsn
 
 using namespace dsn;
 using namespace dsn::tools;
@@ -130,3 +140,141 @@ TEST(tools_common, simple_logger)
     clear_files(index);
     finish_test_dir();
 }
+
+// count of lines containing "test_print" in all the log files
+static int count_test_print_lines(const std::vector<int> &log_index)
+{
+    int lines = 0;
+    for (auto i : log_index) {
+        std::ifstream in("log." + std::to_string(i) + ".txt");
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.find("test_print") != std::string::npos) {
+                lines++;
+            }
+        }
+    }
+    return lines;
+}
+
+static void log_from_threads(logging_provider *logger, int thread_count, int count_per_thread)
+{
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([logger, count_per_thread]() {
+            for (int j = 0; j < count_per_thread; ++j) {
+                log_print(logger, "%s %d", "test_print", j);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+TEST(tools_common, async_logger)
+{
+    const char *old_block_start_level = FLAGS_block_start_level;
+    uint32_t old_buffer_size_kb = FLAGS_buffer_size_kb_per_thread;
+    std::vector<int> index;
+    prepare_test_dir();
+
+    // nothing is lost if all levels block on full buffers
+    FLAGS_block_start_level = "LOG_LEVEL_INFORMATION";
+    async_logger *logger = new async_logger("./");
+    log_from_threads(logger, 8, 50000);
+    logger->flush();
+    ASSERT_EQ(0u, logger->dropped_count());
+    get_log_file_index(index);
+    ASSERT_EQ(8 * 50000, count_test_print_lines(index));
+    // rotated as simple_logger
+    ASSERT_GT(index.size(), 1u);
+    delete logger;
+    clear_files(index);
+
+    // messages are dropped and counted on full buffers
+    FLAGS_block_start_level = "LOG_LEVEL_WARNING";
+    FLAGS_buffer_size_kb_per_thread = 4;
+    logger = new async_logger("./");
+    log_from_threads(logger, 8, 50000);
+    uint64_t dropped = logger->dropped_count();
+    // all the buffered messages are written on destruction
+    delete logger;
+    index.clear();
+    get_log_file_index(index);
+    ASSERT_EQ(8u * 50000, count_test_print_lines(index) + dropped);
+    clear_files(index);
+
+    FLAGS_block_start_level = old_block_start_level;
+    FLAGS_buffer_size_kb_per_thread = old_buffer_size_kb;
+    finish_test_dir();
+}
+
+TEST(tools_common, async_logger_deferred)
+{
+    const char *old_block_start_level = FLAGS_block_start_level;
+    uint32_t old_buffer_size_kb = FLAGS_buffer_size_kb_per_thread;
+    std::vector<int> index;
+    prepare_test_dir();
+
+    // more messages than the deferred queues hold are formatted on the logging threads
+    FLAGS_block_start_level = "LOG_LEVEL_INFORMATION";
+    FLAGS_buffer_size_kb_per_thread = 4;
+    async_logger *logger = new async_logger("./");
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([logger, i]() {
+            for (int j = 0; j < 20000; ++j) {
+                logger->dsn_log_deferred(
+                    __FILE__,
+                    __FUNCTION__,
+                    __LINE__,
+                    LOG_LEVEL_INFORMATION,
+                    std::unique_ptr<deferred_log_message>(
+                        new fmt_logging::message<const char *, int>("{} {}", "test_print", j)));
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    // formatted by fmt rather than printf
+    logger->dsn_log_deferred(__FILE__,
+                             __FUNCTION__,
+                             __LINE__,
+                             LOG_LEVEL_INFORMATION,
+                             std::unique_ptr<deferred_log_message>(
+                                 new fmt_logging::message<std::string>("{} {{}}", "test_print")));
+    // a bad format string is logged as is, along with the error
+    logger->dsn_log_deferred(
+        __FILE__,
+        __FUNCTION__,
+        __LINE__,
+        LOG_LEVEL_INFORMATION,
+        std::unique_ptr<deferred_log_message>(new fmt_logging::message<>("test_print {}")));
+    logger->flush();
+    ASSERT_EQ(0u, logger->dropped_count());
+    delete logger;
+
+    get_log_file_index(index);
+    ASSERT_EQ(8 * 20000 + 2, count_test_print_lines(index));
+    int bad_lines = 0, escaped_lines = 0;
+    for (auto i : index) {
+        std::ifstream in("log." + std::to_string(i) + ".txt");
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.find("<bad log message") != std::string::npos) {
+                bad_lines++;
+            } else if (line.find("test_print {}") != std::string::npos) {
+                escaped_lines++;
+            }
+        }
+    }
+    ASSERT_EQ(1, escaped_lines);
+    ASSERT_EQ(1, bad_lines);
+    clear_files(index);
+
+    FLAGS_block_start_level = old_block_start_level;
+    FLAGS_buffer_size_kb_per_thread = old_buffer_size_kb;
+    finish_test_dir();
+}
@@ -2,10 +2,14 @@
 // This source code is licensed under the Apache License Version 2.0, which
 // can be found in the LICENSE file in the root directory of this source tree.
 
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include <dsn/tool-api/message_parser.h>
 
+#include "core/rpc/read_buffer_pool.h"
+
 namespace dsn {
 
 class message_reader_test : public testing::Test
@@ -86,6 +90,60 @@ public:
         ASSERT_EQ(reader._buffer.length(), 4500);
         ASSERT_EQ(reader._buffer_occupied, 500);
     }
+
+    void test_adaptive_block_size()
+    {
+        message_reader reader(65536);
+
+        // the blocks shrink to the smallest size class for the small messages
+        for (int i = 0; i < 10000; ++i) {
+            reader.read_buffer_ptr(100);
+            reader.mark_read(100);
+            reader.consume_buffer(100);
+        }
+        ASSERT_LE(reader._buffer.length(), 4096);
+
+        // and grow back to the block size for the large reads
+        for (int i = 0; i < 10; ++i) {
+            reader.read_buffer_ptr(1);
+            reader.mark_read(reader.read_buffer_capacity());
+            reader.consume_buffer(reader._buffer_occupied);
+        }
+        reader.read_buffer_ptr(1);
+        ASSERT_EQ(reader._buffer.length(), 65536);
+
+        // a message larger than the block size is read into a buffer of its size
+        reader.mark_read(100);
+        reader.read_buffer_ptr(200000);
+        ASSERT_EQ(reader._buffer.length(), 200100);
+        ASSERT_EQ(reader._buffer_occupied, 100);
+    }
+
+    void test_read_buffer_recycle()
+    {
+        read_buffer_stats before = read_buffer_get_stats();
+
+        // a buffer released by its allocating thread
+        blob b1 = read_buffer_alloc(5000);
+        ASSERT_EQ(b1.length(), 5000);
+        const char *p1 = b1.data();
+        b1 = blob();
+        blob b2 = read_buffer_alloc(8192);
+        ASSERT_EQ(b2.data(), p1);
+
+        // a buffer released by another thread goes back to the allocating thread
+        std::thread([b = std::move(b2)]() mutable { b = blob(); }).join();
+        blob b3 = read_buffer_alloc(6000);
+        ASSERT_EQ(b3.data(), p1);
+
+        // a buffer larger than the largest size class is never cached
+        blob large = read_buffer_alloc(2 * 1024 * 1024);
+        ASSERT_EQ(large.length(), 2 * 1024 * 1024);
+
+        read_buffer_stats after = read_buffer_get_stats();
+        ASSERT_GE(after.hit_count - before.hit_count, 2);
+        ASSERT_GE(after.large_count - before.large_count, 1);
+    }
 };
 
 TEST_F(message_reader_test, init) { test_init(); }
@@ -96,4 +154,8 @@ TEST_F(message_reader_test, read_data) { test_read_data(); }
 
 TEST_F(message_reader_test, consume_buffer) { test_consume_buffer(); }
 
+TEST_F(message_reader_test, adaptive_block_size) { test_adaptive_block_size(); }
+
+TEST_F(message_reader_test, read_buffer_recycle) { test_read_buffer_recycle(); }
+
 } // namespace dsn
@@ -0,0 +1,315 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+// The microbenchmarks of the hot paths of the runtime, as the baselines of the performance
+// work. They are skipped by the simulator, whose time is virtual, e.g. to run them only:
+//
+//   ./dsn.core.tests config-test.ini --gtest_filter=microbenchmark.*
+//
+// Each case prints a line of "MICROBENCHMARK <json>", and records its ns/op as a property in the
+// xml report of gtest. The results are also written into [microbenchmark] result_file if set,
+// which can be used as the [microbenchmark] baseline_file of the later runs, and then a case
+// fails if its ns/op is more than [microbenchmark] regression_threshold_percent above the
+// baseline.
+
+#include <dsn/cpp/serialization.h>
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/utility/binary_writer.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/synchronize.h>
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include "core/core/service_engine.h"
+#include "test_utils.h"
+
+namespace dsn {
+
+DSN_DEFINE_uint32("microbenchmark",
+                  min_time_ms,
+                  50,
+                  "the min time of each round of a microbenchmark, the best of 3 rounds is taken");
+DSN_DEFINE_string("microbenchmark",
+                  result_file,
+                  "",
+                  "the file to append the results to, in lines of \"<name> <ns/op>\"");
+DSN_DEFINE_string("microbenchmark",
+                  baseline_file,
+                  "",
+                  "the results of a former run in the format of result_file, empty means the "
+                  "results are not checked");
+DSN_DEFINE_uint32("microbenchmark",
+                  regression_threshold_percent,
+                  20,
+                  "a microbenchmark fails if it is slower than its baseline by this percentage");
+
+DEFINE_TASK_CODE(LPC_MICROBENCHMARK, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE_AIO(LPC_MICROBENCHMARK_AIO, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+class microbenchmark : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        if (service_engine::instance().spec().tool == "simulator") {
+            _skipped = true;
+        }
+    }
+
+    // `op(n)` runs the benchmarked operation n times
+    void run(const std::string &name, const std::function<void(int)> &op)
+    {
+        const uint64_t min_time_ns = FLAGS_min_time_ms * 1000000ULL;
+
+        // find the iterations lasting for min_time_ms
+        int n = 1;
+        uint64_t elapsed_ns = time(op, n);
+        while (elapsed_ns < min_time_ns && n < (1 << 30)) {
+            double scale = elapsed_ns == 0 ? 100 : 1.2 * min_time_ns / elapsed_ns;
+            n = static_cast<int>(std::min(n * std::min(std::max(scale, 2.0), 100.0), 1e9));
+            elapsed_ns = time(op, n);
+        }
+
+        double ns_per_op = static_cast<double>(elapsed_ns) / n;
+        for (int round = 1; round < 3; ++round) {
+            ns_per_op = std::min(ns_per_op, static_cast<double>(time(op, n)) / n);
+        }
+        report(name, n, ns_per_op);
+    }
+
+protected:
+    static uint64_t time(const std::function<void(int)> &op, int n)
+    {
+        uint64_t start_ns = dsn_now_ns();
+        op(n);
+        return dsn_now_ns() - start_ns;
+    }
+
+    static void report(const std::string &name, int iterations, double ns_per_op)
+    {
+        std::cout << fmt::format("MICROBENCHMARK {{\"name\": \"{}\", \"iterations\": {}, "
+                                 "\"ns_per_op\": {:.1f}, \"ops_per_sec\": {:.0f}}}",
+                                 name,
+                                 iterations,
+                                 ns_per_op,
+                                 1e9 / std::max(ns_per_op, 1e-3))
+                  << std::endl;
+        RecordProperty(name, static_cast<int>(ns_per_op + 0.5));
+
+        if (strlen(FLAGS_result_file) > 0) {
+            std::ofstream out(FLAGS_result_file, std::ios::app);
+            out << name << " " << fmt::format("{:.1f}", ns_per_op) << std::endl;
+        }
+
+        const auto &baselines = load_baselines();
+        auto it = baselines.find(name);
+        if (it != baselines.end()) {
+            double limit = it->second * (100 + FLAGS_regression_threshold_percent) / 100;
+            EXPECT_LE(ns_per_op, limit) << name << " regressed from its baseline of "
+                                        << it->second << " ns/op";
+        }
+    }
+
+    static const std::map<std::string, double> &load_baselines()
+    {
+        static std::map<std::string, double> baselines = []() {
+            std::map<std::string, double> results;
+            if (strlen(FLAGS_baseline_file) > 0) {
+                std::ifstream in(FLAGS_baseline_file);
+                std::string name;
+                double ns_per_op;
+                while (in >> name >> ns_per_op) {
+                    results[name] = ns_per_op;
+                }
+            }
+            return results;
+        }();
+        return baselines;
+    }
+
+    bool _skipped = false;
+};
+
+// enqueue `n` tasks by `enqueue`, and wait until all of them are done
+static void run_tasks(int n, const std::function<void(const task_handler &)> &enqueue)
+{
+    std::atomic<int> remaining(n);
+    utils::notify_event finished;
+    task_handler done = [&remaining, &finished]() {
+        if (remaining.fetch_sub(1) == 1) {
+            finished.notify();
+        }
+    };
+    for (int i = 0; i < n; ++i) {
+        enqueue(done);
+    }
+    finished.wait();
+}
+
+TEST_F(microbenchmark, task_enqueue)
+{
+    if (_skipped) {
+        return;
+    }
+    run("task_enqueue", [](int n) {
+        run_tasks(n, [](const task_handler &done) {
+            tasking::enqueue(LPC_MICROBENCHMARK, nullptr, task_handler(done));
+        });
+    });
+}
+
+TEST_F(microbenchmark, task_enqueue_delayed)
+{
+    if (_skipped) {
+        return;
+    }
+    // through the timer service
+    run("task_enqueue_delayed", [](int n) {
+        run_tasks(n, [](const task_handler &done) {
+            tasking::enqueue(LPC_MICROBENCHMARK,
+                             nullptr,
+                             task_handler(done),
+                             0,
+                             std::chrono::milliseconds(1));
+        });
+    });
+}
+
+TEST_F(microbenchmark, task_tracker)
+{
+    if (_skipped) {
+        return;
+    }
+    task_tracker tracker;
+    run("task_tracker_create_release", [&tracker](int n) {
+        for (int i = 0; i < n; ++i) {
+            tasking::create_task(LPC_MICROBENCHMARK, &tracker, []() {});
+        }
+    });
+}
+
+TEST_F(microbenchmark, rpc_call_loopback)
+{
+    if (_skipped) {
+        return;
+    }
+    rpc_address server("localhost", 20101);
+    run("rpc_call_loopback", [server](int n) {
+        for (int i = 0; i < n; ++i) {
+            auto result = rpc::call_wait<std::string>(
+                server, RPC_TEST_HASH, std::string("echo ping"), std::chrono::milliseconds(0), 1);
+            ASSERT_EQ(ERR_OK, result.first);
+        }
+    });
+}
+
+TEST_F(microbenchmark, aio)
+{
+    if (_skipped) {
+        return;
+    }
+    const int block_size = 4096;
+    const int block_count = 1024;
+    std::string block(block_size, 'x');
+    auto fp = file::open("microbenchmark_aio", O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    ASSERT_NE(nullptr, fp);
+
+    // one aio in flight at a time
+    int index = 0;
+    run("aio_write_4k", [&](int n) {
+        for (int i = 0; i < n; ++i, ++index) {
+            uint64_t offset = (uint64_t)(index % block_count) * block_size;
+            file::write(fp, &block[0], block_size, offset, LPC_MICROBENCHMARK_AIO, nullptr, nullptr)
+                ->wait();
+        }
+    });
+    run("aio_read_4k", [&](int n) {
+        for (int i = 0; i < n; ++i, ++index) {
+            uint64_t offset = (uint64_t)(index % block_count) * block_size;
+            file::read(fp, &block[0], block_size, offset, LPC_MICROBENCHMARK_AIO, nullptr, nullptr)
+                ->wait();
+        }
+    });
+
+    ASSERT_EQ(ERR_OK, file::close(fp));
+    utils::filesystem::remove_path("microbenchmark_aio");
+}
+
+TEST_F(microbenchmark, perf_counter)
+{
+    if (_skipped) {
+        return;
+    }
+    struct
+    {
+        const char *name;
+        dsn_perf_counter_type_t type;
+    } cases[] = {
+        {"perf_counter_number_increment", COUNTER_TYPE_NUMBER},
+        {"perf_counter_volatile_number_increment", COUNTER_TYPE_VOLATILE_NUMBER},
+        {"perf_counter_rate_increment", COUNTER_TYPE_RATE},
+        {"perf_counter_percentile_set", COUNTER_TYPE_NUMBER_PERCENTILES},
+    };
+    for (const auto &c : cases) {
+        perf_counter_wrapper counter;
+        counter.init_global_counter("microbenchmark", "microbenchmark", c.name, c.type, c.name);
+        if (c.type == COUNTER_TYPE_NUMBER_PERCENTILES) {
+            run(c.name, [&counter](int n) {
+                for (int i = 0; i < n; ++i) {
+                    counter->set(i);
+                }
+            });
+        } else {
+            run(c.name, [&counter](int n) {
+                for (int i = 0; i < n; ++i) {
+                    counter->increment();
+                }
+            });
+        }
+    }
+}
+
+TEST_F(microbenchmark, marshall)
+{
+    if (_skipped) {
+        return;
+    }
+    const std::string value(100, 'v');
+    const blob payload = blob::create_from_bytes(std::string(1000, 'p'));
+
+    run("binary_writer_marshall", [&](int n) {
+        for (int i = 0; i < n; ++i) {
+            binary_writer writer;
+            writer.write((int64_t)i);
+            writer.write(value);
+            writer.write(payload);
+            blob bb = writer.get_buffer();
+            ASSERT_LT(0, bb.length());
+        }
+    });
+
+    run("blob_copy", [&](int n) {
+        for (int i = 0; i < n; ++i) {
+            blob copy = payload;
+            ASSERT_EQ(payload.length(), copy.length());
+        }
+    });
+
+    run("rpc_message_marshall", [&](int n) {
+        for (int i = 0; i < n; ++i) {
+            message_ex *msg = message_ex::create_request(RPC_TEST_HASH);
+            ::dsn::marshall(msg, value);
+            msg->add_ref();
+            msg->release_ref();
+        }
+    });
+}
+
+} // namespace dsn
@@ -33,7 +33,10 @@
  *     xxxx-xx-xx, author, fix bug about xxx
  */
 
+#include <algorithm>
+#include <iostream>
 #include <memory>
+#include <numeric>
 #include <thread>
 
 #include <gtest/gtest.h>
@@ -42,8 +45,12 @@
 
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/task_spec.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/synchronize.h>
 
 #include "core/rpc/asio_net_provider.h"
+#include "core/rpc/shm_net_provider.h"
+#include "core/rpc/shm_rpc_session.h"
 #include "core/rpc/network.sim.h"
 #include "core/core/service_engine.h"
 #include "core/rpc/rpc_engine.h"
@@ -52,6 +59,12 @@
 using namespace dsn;
 using namespace dsn::tools;
 
+namespace dsn {
+namespace tools {
+DSN_DECLARE_uint32(shm_ring_capacity_kb);
+} // namespace tools
+} // namespace dsn
+
 class asio_network_provider_test : public asio_network_provider
 {
 public:
@@ -67,6 +80,20 @@ public:
             "change _cfg_conn_threshold_per_ip %u -> %u for test", _cfg_conn_threshold_per_ip, n);
         _cfg_conn_threshold_per_ip = n;
     }
+
+    void change_test_cfg_client_session_pool(uint32_t sessions_per_server,
+                                             uint32_t large_message_bytes)
+    {
+        _cfg_client_sessions_per_server = sessions_per_server;
+        _cfg_large_message_bytes = large_message_bytes;
+    }
+
+    std::vector<rpc_session_ptr> get_client_session_pool(rpc_address server)
+    {
+        utils::auto_read_lock l(_clients_lock);
+        auto it = _clients.find(server);
+        return it != _clients.end() ? it->second : std::vector<rpc_session_ptr>();
+    }
 };
 
 static int TEST_PORT = 20401;
@@ -303,3 +330,244 @@ TEST(tools_common, asio_network_provider_connection_threshold)
 
     TEST_PORT++;
 }
+
+// sends a request of `body_bytes` bytes for partition `pidx` through `net`, and waits for the reply
+void rpc_network_send(connection_oriented_network *net,
+                      rpc_address server,
+                      int pidx,
+                      size_t body_bytes)
+{
+    message_ex *msg = message_ex::create_request(RPC_TEST_NETPROVIDER, 0, 0);
+    msg->header->gpid = gpid(1, pidx);
+    msg->to_address = server;
+    ::dsn::marshall(msg, std::string(body_bytes, 'a'));
+
+    utils::notify_event replied;
+    rpc_response_task *t = new rpc_response_task(
+        msg,
+        [&replied](error_code ec, message_ex *, message_ex *) {
+            EXPECT_EQ(ERR_OK, ec);
+            replied.notify();
+        },
+        0);
+    net->engine()->matcher()->on_call(msg, t);
+    net->send_message(msg);
+    replied.wait();
+}
+
+TEST(tools_common, asio_network_provider_client_session_pool)
+{
+    if (dsn::service_engine::instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    ASSERT_TRUE(dsn_rpc_register_handler(
+        RPC_TEST_NETPROVIDER, "rpc.test.netprovider", rpc_server_response));
+
+    std::unique_ptr<asio_network_provider_test> asio_network(
+        new asio_network_provider_test(task::get_current_rpc(), nullptr));
+    ASSERT_EQ(ERR_OK, asio_network->start(RPC_CHANNEL_TCP, TEST_PORT, false));
+    // 2 sessions for the small requests, and one more for the requests of at least 4KB
+    asio_network->change_test_cfg_client_session_pool(2, 4096);
+
+    rpc_address server("localhost", TEST_PORT);
+    rpc_network_send(asio_network.get(), server, 0, 16);
+    auto pool = asio_network->get_client_session_pool(server);
+    ASSERT_EQ(3u, pool.size());
+    ASSERT_TRUE((pool[0] == nullptr) != (pool[1] == nullptr));
+    ASSERT_EQ(nullptr, pool[2]);
+
+    // the requests of the same partition go through the same session
+    rpc_network_send(asio_network.get(), server, 0, 16);
+    ASSERT_EQ(pool, asio_network->get_client_session_pool(server));
+
+    // partition 1 goes through the other one, and the large request through the third one
+    rpc_network_send(asio_network.get(), server, 1, 16);
+    rpc_network_send(asio_network.get(), server, 1, 8192);
+    pool = asio_network->get_client_session_pool(server);
+    ASSERT_NE(nullptr, pool[0]);
+    ASSERT_NE(nullptr, pool[1]);
+    ASSERT_NE(nullptr, pool[2]);
+    ASSERT_NE(pool[0], pool[1]);
+
+    // the pool is kept until all its sessions are disconnected
+    pool[2]->close();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    pool = asio_network->get_client_session_pool(server);
+    ASSERT_EQ(nullptr, pool[2]);
+    ASSERT_NE(nullptr, pool[0]);
+
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_NETPROVIDER));
+
+    TEST_PORT++;
+}
+
+TEST(tools_common, shm_net_provider)
+{
+    if (dsn::service_engine::instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    ASSERT_TRUE(dsn_rpc_register_handler(
+        RPC_TEST_NETPROVIDER, "rpc.test.netprovider", rpc_server_response));
+
+    // the smallest rings, so that the messages wrap around and the sides wait for each other
+    uint32_t old_capacity_kb = FLAGS_shm_ring_capacity_kb;
+    FLAGS_shm_ring_capacity_kb = 4;
+
+    std::unique_ptr<shm_network_provider> shm_network(
+        new shm_network_provider(task::get_current_rpc(), nullptr));
+    ASSERT_EQ(ERR_OK, shm_network->start(RPC_CHANNEL_TCP, TEST_PORT, false));
+
+    rpc_session_ptr client_session =
+        shm_network->create_client_session(rpc_address("localhost", TEST_PORT));
+    ASSERT_NE(nullptr, dynamic_cast<shm_rpc_session *>(client_session.get()));
+    client_session->connect();
+    rpc_client_session_send(client_session);
+    client_session->close();
+
+    // through the session pool of the provider, with the messages larger than the rings
+    rpc_address server("localhost", TEST_PORT);
+    for (size_t body_bytes : {16, 4096, 100000}) {
+        rpc_network_send(shm_network.get(), server, 0, body_bytes);
+    }
+
+    // a local server not listening on the unix domain socket is reached by tcp
+    std::unique_ptr<asio_network_provider> asio_network(
+        new asio_network_provider(task::get_current_rpc(), nullptr));
+    ASSERT_EQ(ERR_OK, asio_network->start(RPC_CHANNEL_TCP, TEST_PORT + 1, false));
+    client_session = shm_network->create_client_session(rpc_address("localhost", TEST_PORT + 1));
+    ASSERT_EQ(nullptr, dynamic_cast<shm_rpc_session *>(client_session.get()));
+    client_session->connect();
+    rpc_client_session_send(client_session);
+    client_session->close();
+
+    FLAGS_shm_ring_capacity_kb = old_capacity_kb;
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_NETPROVIDER));
+
+    TEST_PORT += 2;
+}
+
+DEFINE_TASK_CODE_RPC(RPC_TEST_SEND_QUEUE_HIGH, TASK_PRIORITY_HIGH, THREAD_POOL_TEST_SERVER)
+
+// a client session which never connects, so that the messages stay in its send queues
+class send_queue_test_session : public rpc_session
+{
+public:
+    send_queue_test_session(connection_oriented_network &net, message_parser_ptr &parser)
+        : rpc_session(net, rpc_address("localhost", TEST_PORT), parser, true)
+    {
+    }
+
+    void connect() override {}
+    void close() override {}
+    void do_read(int) override {}
+    void send(uint64_t) override {}
+
+    std::vector<message_ex *> unlink_all()
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        _connect_state = SS_CONNECTED;
+        unlink_message_for_send();
+        return _sending_msgs;
+    }
+};
+
+TEST(tools_common, rpc_session_send_queue_priority)
+{
+    std::unique_ptr<asio_network_provider_test> asio_network(
+        new asio_network_provider_test(task::get_current_rpc(), nullptr));
+    message_parser_ptr parser(asio_network->new_message_parser(NET_HDR_DSN));
+    rpc_session_ptr s(new send_queue_test_session(*asio_network, parser));
+
+    message_ex *bulk = message_ex::create_request(RPC_TEST_NETPROVIDER);
+    ::dsn::marshall(bulk, std::string(1 << 20, 'a'));
+    message_ex *common = message_ex::create_request(RPC_TEST_NETPROVIDER);
+    ::dsn::marshall(common, std::string("common"));
+    message_ex *high = message_ex::create_request(RPC_TEST_SEND_QUEUE_HIGH);
+    ::dsn::marshall(high, std::string("high"));
+
+    s->send_message(bulk);
+    s->send_message(common);
+    s->send_message(high);
+
+    // the small messages are sent before the bulk one, higher priority first
+    auto sending = static_cast<send_queue_test_session *>(s.get())->unlink_all();
+    ASSERT_EQ(3u, sending.size());
+    ASSERT_EQ(high, sending[0]);
+    ASSERT_EQ(common, sending[1]);
+    ASSERT_EQ(bulk, sending[2]);
+}
+
+// the average and the 99th percentile latency in microseconds of `count` sequential
+// round trips through `client_session`
+void ping_pong(rpc_session_ptr client_session,
+               int count,
+               /*out*/ uint64_t &avg_us,
+               /*out*/ uint64_t &p99_us)
+{
+    std::vector<uint64_t> latencies;
+    latencies.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        message_ex *msg = message_ex::create_request(RPC_TEST_NETPROVIDER, 0, 0);
+        ::dsn::marshall(msg, std::string("ping"));
+
+        utils::notify_event replied;
+        rpc_response_task *t = new rpc_response_task(
+            msg,
+            [&replied](error_code ec, message_ex *, message_ex *) {
+                EXPECT_EQ(ERR_OK, ec);
+                replied.notify();
+            },
+            0);
+        uint64_t start_ns = dsn_now_ns();
+        client_session->net().engine()->matcher()->on_call(msg, t);
+        client_session->send_message(msg);
+        replied.wait();
+        latencies.push_back((dsn_now_ns() - start_ns) / 1000);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    avg_us = std::accumulate(latencies.begin(), latencies.end(), uint64_t(0)) / count;
+    p99_us = latencies[count * 99 / 100];
+}
+
+TEST(tools_common, asio_polling_net_provider_ping_pong)
+{
+    if (dsn::service_engine::instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    ASSERT_TRUE(dsn_rpc_register_handler(
+        RPC_TEST_NETPROVIDER, "rpc.test.netprovider", rpc_server_response));
+
+    const int count = 2000;
+    std::unique_ptr<asio_network_provider> providers[] = {
+        std::unique_ptr<asio_network_provider>(
+            new asio_network_provider(task::get_current_rpc(), nullptr)),
+        std::unique_ptr<asio_network_provider>(
+            new asio_polling_network_provider(task::get_current_rpc(), nullptr)),
+        std::unique_ptr<asio_network_provider>(
+            new shm_network_provider(task::get_current_rpc(), nullptr))};
+    const char *names[] = {
+        "asio_network_provider", "asio_polling_network_provider", "shm_network_provider"};
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(ERR_OK, providers[i]->start(RPC_CHANNEL_TCP, TEST_PORT, false));
+        rpc_session_ptr client_session =
+            providers[i]->create_client_session(rpc_address("localhost", TEST_PORT));
+        client_session->connect();
+        // warm up
+        rpc_client_session_send(client_session);
+
+        uint64_t avg_us = 0;
+        uint64_t p99_us = 0;
+        ping_pong(client_session, count, avg_us, p99_us);
+        std::cout << names[i] << ": " << count << " round trips, avg = " << avg_us
+                  << "us, p99 = " << p99_us << "us" << std::endl;
+
+        client_session->close();
+        TEST_PORT++;
+    }
+
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_NETPROVIDER));
+}
@@ -0,0 +1,40 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/numa.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace utils {
+
+TEST(core, parse_cpu_list)
+{
+    std::vector<int> cpus;
+    ASSERT_TRUE(parse_cpu_list("0-3,8,10-11\n", cpus));
+    ASSERT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}), cpus);
+    ASSERT_TRUE(parse_cpu_list("5", cpus));
+    ASSERT_EQ(std::vector<int>({5}), cpus);
+
+    ASSERT_FALSE(parse_cpu_list("", cpus));
+    ASSERT_FALSE(parse_cpu_list("3-1", cpus));
+    ASSERT_FALSE(parse_cpu_list("1-", cpus));
+    ASSERT_FALSE(parse_cpu_list("a,1", cpus));
+}
+
+TEST(core, numa_node_of_worker)
+{
+    // the workers are split evenly and contiguously
+    std::vector<int> nodes;
+    for (int i = 0; i < 6; ++i) {
+        nodes.push_back(numa_node_of_worker(i, 6, 2));
+    }
+    ASSERT_EQ(std::vector<int>({0, 0, 0, 1, 1, 1}), nodes);
+    ASSERT_EQ(0, numa_node_of_worker(0, 1, 2));
+
+    ASSERT_LE(1, numa_node_count());
+    ASSERT_EQ(-1, numa_node_of_net_interface("not-exist-interface"));
+}
+
+} // namespace utils
+} // namespace dsn
@@ -0,0 +1,62 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/page_cache_advisor.h>
+#include <dsn/utility/filesystem.h>
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace dsn {
+namespace utils {
+
+TEST(page_cache_advisor_test, drop_behind_keeps_cached_pages)
+{
+    const std::string fname = "page_cache_advisor_test_file";
+    const uint64_t page = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+    const uint64_t size = 16 * page;
+
+    int fd = ::open(fname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    ASSERT_GE(fd, 0);
+    std::string data(size, 'x');
+    ASSERT_EQ(static_cast<ssize_t>(size), ::pwrite(fd, data.data(), size, 0));
+    ASSERT_EQ(0, ::fsync(fd));
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+    auto ranges = page_cache_advisor::uncached_ranges(fd, 0, size);
+    if (ranges.size() != 1 || ranges[0].second != size) {
+        // the pages can't be dropped on this file system, e.g. tmpfs
+        ::close(fd);
+        filesystem::remove_path(fname);
+        return;
+    }
+
+    // the first 4 pages are cached by others
+    ASSERT_EQ(static_cast<ssize_t>(4 * page), ::pread(fd, &data[0], 4 * page, 0));
+    ranges = page_cache_advisor::uncached_ranges(fd, 0, size);
+    ASSERT_EQ(1, ranges.size());
+    ASSERT_EQ(4 * page, ranges[0].first);
+    ASSERT_EQ(12 * page, ranges[0].second);
+
+    {
+        page_cache_advisor advisor(fd, 4 * page, true);
+        for (uint64_t offset = 0; offset < size; offset += 2 * page) {
+            advisor.on_read(offset, 2 * page);
+            ASSERT_EQ(static_cast<ssize_t>(2 * page), ::pread(fd, &data[0], 2 * page, offset));
+        }
+    }
+
+    // only the pages cached by the reading are dropped
+    ranges = page_cache_advisor::uncached_ranges(fd, 0, size);
+    ASSERT_EQ(1, ranges.size());
+    ASSERT_EQ(4 * page, ranges[0].first);
+    ASSERT_EQ(12 * page, ranges[0].second);
+
+    ::close(fd);
+    filesystem::remove_path(fname);
+}
+
+} // namespace utils
+} // namespace dsn
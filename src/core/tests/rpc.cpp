@@ -36,6 +36,8 @@
 #include <dsn/utility/priority_queue.h>
 #include <dsn/tool-api/group_address.h>
 #include <dsn/tool-api/async_calls.h>
+#include <dsn/utility/defer.h>
+#include <dsn/utility/flags.h>
 
 #include "test_utils.h"
 
@@ -245,3 +247,39 @@ TEST(core, send_to_invalid_address)
 
     send_message(group, std::string("echo hehehe"), 1, action_on_succeed, action_on_failure);
 }
+
+namespace dsn {
+DSN_DECLARE_bool(rpc_loopback_in_process);
+} // namespace dsn
+
+DEFINE_TASK_CODE_RPC(RPC_TEST_LOOPBACK, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+static void on_rpc_test_loopback(dsn::message_ex *request)
+{
+    std::string str;
+    ::dsn::unmarshall(request, str);
+    // the requests passed in process have no session
+    str += request->io_session == nullptr ? " by loopback" : " by network";
+    dsn::message_ex *response = request->create_response();
+    ::dsn::marshall(response, str);
+    dsn_rpc_reply(response);
+}
+
+TEST(core, rpc_loopback)
+{
+    ASSERT_TRUE(
+        dsn_rpc_register_handler(RPC_TEST_LOOPBACK, "rpc.test.loopback", on_rpc_test_loopback));
+    bool old_loopback = FLAGS_rpc_loopback_in_process;
+    auto cleanup = dsn::defer([old_loopback]() {
+        FLAGS_rpc_loopback_in_process = old_loopback;
+        dsn_rpc_unregiser_handler(RPC_TEST_LOOPBACK);
+    });
+
+    for (bool loopback : {true, false}) {
+        FLAGS_rpc_loopback_in_process = loopback;
+        auto result = ::dsn::rpc::call_wait<std::string>(
+            dsn_primary_address(), RPC_TEST_LOOPBACK, std::string("hello"));
+        ASSERT_EQ(ERR_OK, result.first);
+        ASSERT_EQ(loopback ? "hello by loopback" : "hello by network", result.second);
+    }
+}
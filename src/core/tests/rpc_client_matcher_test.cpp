@@ -0,0 +1,96 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <dsn/tool-api/async_calls.h>
+#include <gtest/gtest.h>
+
+#include "core/rpc/rpc_engine.h"
+#include "test_utils.h"
+
+namespace dsn {
+
+namespace {
+
+// a call whose reply is never delivered to any callback
+rpc_response_task_ptr create_call(uint64_t id = 0)
+{
+    message_ex *request = message_ex::create_request(RPC_TEST_HASH, 10000);
+    if (id != 0) {
+        request->header->id = id;
+    }
+    return rpc::create_rpc_response_task(request, nullptr, rpc_response_handler());
+}
+
+} // anonymous namespace
+
+TEST(core, rpc_client_matcher)
+{
+    rpc_client_matcher matcher(task::get_current_rpc());
+
+    // the second call takes the same slot as the first one, and falls back to the overflow map
+    uint64_t id = message_ex::new_id();
+    rpc_response_task_ptr call1 = create_call(id);
+    rpc_response_task_ptr call2 = create_call(id + MATCHER_SLOT_NR);
+    matcher.on_call(call1->get_request(), call1);
+    matcher.on_call(call2->get_request(), call2);
+
+    ASSERT_FALSE(matcher.on_recv_reply(nullptr, id + 1, nullptr, 0));
+    ASSERT_TRUE(matcher.on_recv_reply(nullptr, id + MATCHER_SLOT_NR, nullptr, 0));
+    ASSERT_FALSE(matcher.on_recv_reply(nullptr, id + MATCHER_SLOT_NR, nullptr, 0));
+    ASSERT_TRUE(matcher.on_recv_reply(nullptr, id, nullptr, 0));
+    ASSERT_FALSE(matcher.on_recv_reply(nullptr, id, nullptr, 0));
+
+    call1->wait();
+    call2->wait();
+    ASSERT_EQ(ERR_NETWORK_FAILURE, call1->error());
+    ASSERT_EQ(ERR_NETWORK_FAILURE, call2->error());
+}
+
+TEST(core, rpc_client_matcher_benchmark)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    const int call_count = 100000;
+    service_node *node = task::get_current_node2();
+    rpc_client_matcher matcher(task::get_current_rpc());
+
+    for (int thread_count : {1, 2, 4, 8}) {
+        int calls_per_thread = call_count / thread_count;
+
+        // the calls are prepared beforehand, so that only the matcher is measured
+        std::vector<std::vector<rpc_response_task_ptr>> calls(thread_count);
+        for (auto &thread_calls : calls) {
+            for (int i = 0; i < calls_per_thread; ++i) {
+                thread_calls.push_back(create_call());
+            }
+        }
+
+        uint64_t start_ns = dsn_now_ns();
+        std::vector<std::thread> threads;
+        for (auto &thread_calls : calls) {
+            threads.emplace_back([&matcher, &thread_calls, node]() {
+                task::set_tls_dsn_context(node, nullptr);
+                for (auto &call : thread_calls) {
+                    matcher.on_call(call->get_request(), call);
+                    matcher.on_recv_reply(nullptr, call->get_request()->header->id, nullptr, 0);
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        uint64_t elapsed_ns = dsn_now_ns() - start_ns;
+
+        std::cout << "rpc_client_matcher: " << thread_count << " threads, "
+                  << calls_per_thread * thread_count * 1000000000.0 / elapsed_ns
+                  << " on_call/on_recv_reply pairs/s" << std::endl;
+    }
+}
+
+} // namespace dsn
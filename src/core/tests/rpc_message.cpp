@@ -36,6 +36,7 @@
 #include <dsn/utility/crc.h>
 #include <dsn/utility/transient_memory.h>
 #include <dsn/tool-api/rpc_message.h>
+#include <dsn/cpp/serialization.h>
 #include <core/core/message_utils.cpp>
 #include <gtest/gtest.h>
 
@@ -195,3 +196,127 @@ TEST(rpc_message, restore_read)
         msg->restore_read();
     }
 }
+
+TEST(rpc_message, write_shared_blob)
+{
+    using namespace dsn;
+    const int large_size = 64 * 1024;
+    std::shared_ptr<char> buf(utils::make_shared_array<char>(large_size));
+    for (int i = 0; i < large_size; i++) {
+        buf.get()[i] = static_cast<char>(i % 127);
+    }
+    blob large(buf, large_size);
+    blob small(buf, 0, 100);
+
+    for (const blob &bb : {large, small}) {
+        message_ptr request = message_ex::create_request(RPC_CODE_FOR_TEST, 100, 1);
+        marshall(request.get(), bb, DSF_THRIFT_BINARY);
+
+        bool shared = false;
+        for (const blob &b : request->buffers) {
+            shared = shared || (b.data() == bb.data());
+        }
+        // only large blobs are attached without copying
+        ASSERT_EQ(bb.length() == large_size, shared);
+
+        message_ptr receive = request->copy(true, true);
+        blob result;
+        rpc_read_stream reader(receive.get());
+        unmarshall(reader, result, DSF_THRIFT_BINARY);
+        ASSERT_EQ(bb.to_string(), result.to_string());
+    }
+}
+
+TEST(rpc_message, alive_accounting)
+{
+    using namespace dsn;
+    int64_t old_count = message_ex::alive_count();
+    int64_t old_bytes = message_ex::alive_bytes();
+    {
+        message_ptr request = message_ex::create_request(RPC_CODE_FOR_TEST, 100, 1);
+        marshall(request.get(), std::string(1000, 'a'), DSF_THRIFT_BINARY);
+        ASSERT_EQ(old_count + 1, message_ex::alive_count());
+        ASSERT_EQ(old_bytes + request->body_size(), message_ex::alive_bytes());
+
+        message_ptr receive = request->copy(true, true);
+        ASSERT_EQ(old_count + 2, message_ex::alive_count());
+        ASSERT_EQ(old_bytes + 2 * request->body_size(), message_ex::alive_bytes());
+    }
+    ASSERT_EQ(old_count, message_ex::alive_count());
+    ASSERT_EQ(old_bytes, message_ex::alive_bytes());
+}
+
+TEST(rpc_message, deferred_body_crc)
+{
+    using namespace dsn;
+    message_ptr request = message_ex::create_request(RPC_CODE_FOR_TEST, 100, 1);
+    marshall(request.get(), std::string(1000, 'a'), DSF_THRIFT_BINARY);
+
+    message_ptr receive = request->copy(true, true);
+    uint32_t crc = 0;
+    for (const blob &bb : receive->buffers) {
+        crc = utils::crc32_calc(bb.data(), bb.length(), crc);
+    }
+    receive->header->body_crc32 = crc;
+
+    // the body is not checked again unless deferred
+    ASSERT_TRUE(receive->verify_body_crc());
+    receive->defer_body_crc_check();
+    ASSERT_TRUE(receive->verify_body_crc());
+
+    const_cast<char *>(receive->buffers.back().data())[0] ^= 1;
+    receive->defer_body_crc_check();
+    ASSERT_FALSE(receive->verify_body_crc());
+    ASSERT_TRUE(receive->verify_body_crc());
+}
+
+TEST(rpc_message, read_shared_blob)
+{
+    using namespace dsn;
+    for (int size : {0, 100, 64 * 1024}) {
+        blob bb = blob::create_from_bytes(std::string(size, 'x'));
+        message_ptr request = message_ex::create_request(RPC_CODE_FOR_TEST, 100, 1);
+        marshall(request.get(), bb, DSF_THRIFT_BINARY);
+
+        message_ptr receive = request->copy(true, true);
+        blob result;
+        rpc_read_stream reader(receive.get());
+        unmarshall(reader, result, DSF_THRIFT_BINARY);
+        ASSERT_EQ(bb.to_string(), result.to_string());
+
+        // the blob references the buffer of the message without copying
+        if (size > 0) {
+            const blob &body = receive->buffers.back();
+            ASSERT_GE(result.data(), body.data());
+            ASSERT_LE(result.data() + result.length(), body.data() + body.length());
+        }
+    }
+}
+
+TEST(rpc_message, binary_writer_write_shared)
+{
+    using namespace dsn;
+    std::string data(1000, 'x');
+    blob shared = blob::create_from_bytes(std::string(data));
+
+    binary_writer writer;
+    writer.write(std::string("head"));
+    writer.write_shared(shared);
+    writer.write_shared(blob(data.data(), 0, 10)); // not owning, copied
+    writer.write(std::string("tail"));
+
+    std::vector<blob> buffers;
+    writer.get_buffers(buffers);
+    ASSERT_EQ(3u, buffers.size());
+    ASSERT_EQ(shared.data(), buffers[1].data());
+
+    binary_reader reader(writer.get_buffer());
+    std::string head, tail;
+    reader.read(head);
+    std::string content(1010, '\0');
+    reader.read(&content[0], 1010);
+    reader.read(tail);
+    ASSERT_EQ("head", head);
+    ASSERT_EQ(data + data.substr(0, 10), content);
+    ASSERT_EQ("tail", tail);
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <thread>
+
+#include <dsn/service_api_cpp.h>
+#include <dsn/tool-api/task_cpu_accounting.h>
+#include <dsn/utility/flags.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+
+DSN_DECLARE_bool(task_cpu_accounting);
+
+DEFINE_TASK_CODE(LPC_TEST_CPU_RECORD, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE(LPC_TEST_CPU_PARENT, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE(LPC_TEST_CPU_CHILD, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+TEST(task_cpu_accounting_test, record_from_threads)
+{
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([i]() {
+            for (int j = 0; j < 100; ++j) {
+                task_cpu_accounting::instance().record(
+                    LPC_TEST_CPU_RECORD, gpid(10001, i % 2), 1000000 * (i % 2 + 1));
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    auto codes = task_cpu_accounting::instance().get_code_usages();
+    ASSERT_EQ(400u, codes[LPC_TEST_CPU_RECORD].count);
+    ASSERT_EQ(600000000u, codes[LPC_TEST_CPU_RECORD].cpu_ns);
+
+    auto partitions = task_cpu_accounting::instance().get_partition_usages();
+    ASSERT_EQ(200u, partitions[gpid(10001, 0)].count);
+    ASSERT_EQ(200000000u, partitions[gpid(10001, 0)].cpu_ns);
+    ASSERT_EQ(400000000u, partitions[gpid(10001, 1)].cpu_ns);
+
+    auto apps = task_cpu_accounting::instance().get_app_usages();
+    ASSERT_EQ(400u, apps[10001].count);
+    ASSERT_EQ(600000000u, apps[10001].cpu_ns);
+
+    std::string report = task_cpu_accounting::instance().get_usage_report(1, false);
+    ASSERT_NE(std::string::npos, report.find("10001"));
+    ASSERT_EQ(std::string::npos, report.find("10001.0"));
+    ASSERT_NE(std::string::npos, report.find("10001.1"));
+}
+
+TEST(task_cpu_accounting_test, inherit_gpid)
+{
+    FLAGS_task_cpu_accounting = true;
+    task_ptr child;
+    task_ptr parent = tasking::create_task(LPC_TEST_CPU_PARENT, nullptr, [&child]() {
+        child = tasking::enqueue(LPC_TEST_CPU_CHILD, nullptr, []() {});
+    });
+    parent->set_accounting_gpid(gpid(10002, 3));
+    parent->enqueue();
+    parent->wait();
+    child->wait();
+    ASSERT_EQ(gpid(10002, 3), child->accounting_gpid());
+    // the task without partition
+    tasking::enqueue(LPC_TEST_CPU_CHILD, nullptr, []() {})->wait();
+    FLAGS_task_cpu_accounting = false;
+    tasking::enqueue(LPC_TEST_CPU_PARENT, nullptr, []() {})->wait();
+
+    auto partitions = task_cpu_accounting::instance().get_partition_usages();
+    ASSERT_EQ(2u, partitions[gpid(10002, 3)].count);
+    ASSERT_LE(1u, partitions[gpid()].count);
+    auto codes = task_cpu_accounting::instance().get_code_usages();
+    ASSERT_EQ(1u, codes[LPC_TEST_CPU_PARENT].count);
+    ASSERT_EQ(2u, codes[LPC_TEST_CPU_CHILD].count);
+}
+
+} // namespace dsn
@@ -36,8 +36,11 @@
 #include "core/task/task_engine.h"
 #include "test_utils.h"
 #include <dsn/tool_api.h>
+#include <dsn/tool-api/async_calls.h>
 #include <gtest/gtest.h>
+#include <atomic>
 #include <sstream>
+#include <thread>
 
 using namespace ::dsn;
 
@@ -204,3 +207,54 @@ dynamic_cast<admission_controller_for_test*>(controllers1[0]);
     ASSERT_EQ(nullptr, controllers2[1]);
 }
 */
+
+DEFINE_TASK_CODE(LPC_ENQUEUE_BATCH_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+TEST(core, enqueue_batch_scope)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    std::atomic<int> count(0);
+    std::vector<task_ptr> tasks;
+    {
+        enqueue_batch_scope outer;
+        {
+            enqueue_batch_scope inner;
+            for (int i = 0; i < 10; ++i) {
+                tasks.push_back(
+                    tasking::enqueue(LPC_ENQUEUE_BATCH_TEST, nullptr, [&count]() { ++count; }, i));
+            }
+        }
+
+        // the tasks are enqueued when the outermost scope exits
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ASSERT_EQ(0, count.load());
+    }
+
+    for (auto &t : tasks) {
+        t->wait();
+    }
+    ASSERT_EQ(10, count.load());
+}
+
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_LAZY)
+DEFINE_TASK_CODE(LPC_LAZY_START_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_LAZY)
+
+TEST(core, task_engine_lazy_start)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    task_worker_pool *pool =
+        task::get_current_node2()->computation()->get_pool(THREAD_POOL_FOR_TEST_LAZY);
+    ASSERT_NE(nullptr, pool);
+    ASSERT_TRUE(pool->spec().lazy_start);
+    ASSERT_FALSE(pool->workers_started());
+
+    // the workers are started by the first task
+    std::atomic<int> count(0);
+    tasking::enqueue(LPC_LAZY_START_TEST, nullptr, [&count]() { ++count; })->wait();
+    ASSERT_TRUE(pool->workers_started());
+    ASSERT_EQ(1, count.load());
+}
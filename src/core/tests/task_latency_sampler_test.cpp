@@ -0,0 +1,112 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <thread>
+
+#include <dsn/service_api_cpp.h>
+#include <dsn/utility/flags.h>
+#include <gtest/gtest.h>
+
+#include "core/task/task_latency_sampler.h"
+
+namespace dsn {
+
+DSN_DECLARE_uint32(task_latency_sample_rate);
+
+DEFINE_TASK_CODE(LPC_TEST_LATENCY_RECORD, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE(LPC_TEST_LATENCY_SAMPLED, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+TEST(task_latency_sampler_test, histogram_bucket)
+{
+    for (uint64_t v = 0; v < 8; ++v) {
+        ASSERT_EQ(static_cast<int>(v), latency_histogram::bucket_index(v));
+        ASSERT_EQ(v, latency_histogram::bucket_value(static_cast<int>(v)));
+    }
+
+    int last_index = 0;
+    for (uint64_t v = 8; v < (1ULL << 20); v += v / 7) {
+        int index = latency_histogram::bucket_index(v);
+        ASSERT_GE(index, last_index);
+        ASSERT_LT(index, latency_histogram::BUCKET_COUNT);
+        last_index = index;
+
+        // the relative error is less than 1/8
+        uint64_t value = latency_histogram::bucket_value(index);
+        ASSERT_LE(value > v ? value - v : v - value, v / 8);
+    }
+
+    ASSERT_EQ(latency_histogram::BUCKET_COUNT - 1, latency_histogram::bucket_index(1ULL << 40));
+    ASSERT_EQ(latency_histogram::BUCKET_COUNT - 1, latency_histogram::bucket_index(UINT64_MAX));
+}
+
+TEST(task_latency_sampler_test, histogram_quantile)
+{
+    std::vector<uint64_t> counts;
+    ASSERT_EQ(0u, latency_histogram::quantile(counts, 0.99));
+
+    latency_histogram h;
+    for (int i = 0; i < 990; ++i) {
+        h.record(5);
+    }
+    for (int i = 0; i < 10; ++i) {
+        h.record(1000);
+    }
+    h.merge_into(counts);
+    ASSERT_EQ(latency_histogram::BUCKET_COUNT, static_cast<int>(counts.size()));
+    ASSERT_EQ(5u, latency_histogram::quantile(counts, 0.5));
+    ASSERT_EQ(5u, latency_histogram::quantile(counts, 0.99));
+    ASSERT_EQ(latency_histogram::bucket_value(latency_histogram::bucket_index(1000)),
+              latency_histogram::quantile(counts, 0.999));
+}
+
+TEST(task_latency_sampler_test, record_from_threads)
+{
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([]() {
+            for (int j = 0; j < 100; ++j) {
+                task_latency_sampler::instance().record(LPC_TEST_LATENCY_RECORD, 2000, 7000);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    bool found = false;
+    for (const auto &tl : task_latency_sampler::instance().get_latencies()) {
+        if (tl.code == LPC_TEST_LATENCY_RECORD) {
+            found = true;
+            ASSERT_EQ(400u, tl.count);
+            ASSERT_EQ(2u, latency_histogram::quantile(tl.queue_us, 0.5));
+            ASSERT_EQ(7u, latency_histogram::quantile(tl.exec_us, 0.999));
+        }
+    }
+    ASSERT_TRUE(found);
+
+    std::string report = task_latency_sampler::instance().get_latency_report({"LPC_TEST_LATENCY"});
+    ASSERT_NE(std::string::npos, report.find("LPC_TEST_LATENCY_RECORD"));
+    report = task_latency_sampler::instance().get_latency_report({"RPC_"});
+    ASSERT_EQ(std::string::npos, report.find("LPC_TEST_LATENCY_RECORD"));
+}
+
+TEST(task_latency_sampler_test, sample_tasks)
+{
+    FLAGS_task_latency_sample_rate = 1;
+    for (int i = 0; i < 10; ++i) {
+        tasking::enqueue(LPC_TEST_LATENCY_SAMPLED, nullptr, []() {})->wait();
+    }
+    FLAGS_task_latency_sample_rate = 0;
+    tasking::enqueue(LPC_TEST_LATENCY_SAMPLED, nullptr, []() {})->wait();
+
+    uint64_t count = 0;
+    for (const auto &tl : task_latency_sampler::instance().get_latencies()) {
+        if (tl.code == LPC_TEST_LATENCY_SAMPLED) {
+            count = tl.count;
+        }
+    }
+    ASSERT_EQ(10u, count);
+}
+
+} // namespace dsn
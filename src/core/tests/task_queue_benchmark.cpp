@@ -0,0 +1,154 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "core/task/task_engine.h"
+#include "test_utils.h"
+#include <dsn/tool_api.h>
+#include <dsn/utility/synchronize.h>
+#include <dsn/utility/time_utils.h>
+#include <gtest/gtest.h>
+
+using namespace ::dsn;
+
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_BENCH_SIMPLE_QUEUE)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_BENCH_HPC_QUEUE)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_BENCH_WORK_STEALING_QUEUE)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_BENCH_SPIN_WAIT)
+DEFINE_TASK_CODE(LPC_BENCH_SIMPLE_QUEUE, TASK_PRIORITY_COMMON, THREAD_POOL_BENCH_SIMPLE_QUEUE)
+DEFINE_TASK_CODE(LPC_BENCH_HPC_QUEUE, TASK_PRIORITY_COMMON, THREAD_POOL_BENCH_HPC_QUEUE)
+DEFINE_TASK_CODE(LPC_BENCH_WORK_STEALING_QUEUE,
+                 TASK_PRIORITY_COMMON,
+                 THREAD_POOL_BENCH_WORK_STEALING_QUEUE)
+DEFINE_TASK_CODE(LPC_BENCH_SPIN_WAIT, TASK_PRIORITY_COMMON, THREAD_POOL_BENCH_SPIN_WAIT)
+
+namespace {
+
+// burn cpu for about `loops` iterations, which can not be optimized out by compiler
+uint64_t spin(int loops)
+{
+    volatile uint64_t x = 0;
+    for (int i = 0; i < loops; ++i) {
+        x = x + i;
+    }
+    return x;
+}
+
+// Skewed load: all the tasks are spawned by one task running in the pool, and
+// every 8th task is 32 times heavier than the others. Returns the elapsed time
+// in microseconds from spawning to the finish of the last task.
+uint64_t run_skewed_load(task_code code, int task_count)
+{
+    std::atomic<int> remaining(task_count);
+    utils::notify_event finished;
+
+    uint64_t start = dsn_now_us();
+    tasking::enqueue(code, nullptr, [&remaining, &finished, code, task_count]() {
+        for (int i = 0; i < task_count; ++i) {
+            int loops = (i % 8 == 0) ? 32000 : 1000;
+            tasking::enqueue(code, nullptr, [&remaining, &finished, loops]() {
+                spin(loops);
+                if (remaining.fetch_sub(1) == 1) {
+                    finished.notify();
+                }
+            });
+        }
+    });
+    finished.wait();
+    return dsn_now_us() - start;
+}
+
+// Ping-pong load: the tasks are enqueued one by one from the current thread, each after the
+// last one is done. Returns the average latency in nanoseconds from enqueuing a task to its
+// execution.
+uint64_t run_ping_pong_load(task_code code, int task_count)
+{
+    uint64_t total_ns = 0;
+    for (int i = 0; i < task_count; ++i) {
+        uint64_t latency_ns = 0;
+        uint64_t start = utils::get_current_physical_time_ns();
+        tasking::enqueue(code, nullptr, [&latency_ns, start]() {
+            latency_ns = utils::get_current_physical_time_ns() - start;
+        })->wait();
+        total_ns += latency_ns;
+    }
+    return total_ns / task_count;
+}
+
+} // anonymous namespace
+
+TEST(core, task_queue_benchmark)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    const int task_count = 100000;
+    struct
+    {
+        const char *name;
+        task_code code;
+    } cases[] = {
+        {"simple_task_queue", LPC_BENCH_SIMPLE_QUEUE},
+        {"hpc_concurrent_task_queue", LPC_BENCH_HPC_QUEUE},
+        {"work_stealing_task_queue", LPC_BENCH_WORK_STEALING_QUEUE},
+    };
+
+    for (auto &c : cases) {
+        task_worker_pool *pool =
+            task::get_current_node2()->computation()->get_pool(task_spec::get(c.code)->pool_code);
+        ASSERT_NE(nullptr, pool);
+
+        uint64_t elapsed_us = run_skewed_load(c.code, task_count);
+        std::cout << c.name << ": " << task_count << " tasks on " << pool->spec().worker_count
+                  << " workers in " << elapsed_us / 1000 << " ms, "
+                  << task_count * 1000000.0 / std::max(elapsed_us, (uint64_t)1) << " tasks/s"
+                  << std::endl;
+    }
+}
+
+TEST(core, task_worker_spin_wait_benchmark)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    const int task_count = 10000;
+    struct
+    {
+        const char *name;
+        task_code code;
+    } cases[] = {
+        {"park", LPC_BENCH_HPC_QUEUE}, {"spin_then_park", LPC_BENCH_SPIN_WAIT},
+    };
+
+    for (auto &c : cases) {
+        task_worker_pool *pool =
+            task::get_current_node2()->computation()->get_pool(task_spec::get(c.code)->pool_code);
+        ASSERT_NE(nullptr, pool);
+
+        uint64_t latency_ns = run_ping_pong_load(c.code, task_count);
+        std::cout << c.name << ": average latency of " << task_count << " ping-pong tasks is "
+                  << latency_ns << " ns" << std::endl;
+    }
+}
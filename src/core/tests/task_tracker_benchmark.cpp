@@ -0,0 +1,54 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/task_tracker.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+
+DEFINE_TASK_CODE(LPC_TASK_TRACKER_BENCH, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+TEST(core, task_tracker_benchmark)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    // every thread creates and releases tasks tracked by a shared tracker, like the tasks of a
+    // replica created by the replication thread and released by the io threads
+    const int task_count = 400000;
+    service_node *node = task::get_current_node2();
+    for (int bucket_count : {1, task_tracker::SHARDED_BUCKET_COUNT}) {
+        for (int thread_count : {1, 4, 8}) {
+            task_tracker tracker(bucket_count);
+            int tasks_per_thread = task_count / thread_count;
+
+            uint64_t start_ns = dsn_now_ns();
+            std::vector<std::thread> threads;
+            for (int i = 0; i < thread_count; ++i) {
+                threads.emplace_back([&tracker, tasks_per_thread, node]() {
+                    task::set_tls_dsn_context(node, nullptr);
+                    for (int j = 0; j < tasks_per_thread; ++j) {
+                        tasking::create_task(LPC_TASK_TRACKER_BENCH, &tracker, []() {});
+                    }
+                });
+            }
+            for (auto &t : threads) {
+                t.join();
+            }
+            uint64_t elapsed_ns = dsn_now_ns() - start_ns;
+
+            std::cout << "task_tracker with " << bucket_count << " buckets: " << thread_count
+                      << " threads, "
+                      << tasks_per_thread * thread_count * 1000000000.0 / elapsed_ns
+                      << " tracked tasks/s" << std::endl;
+        }
+    }
+}
+
+} // namespace dsn
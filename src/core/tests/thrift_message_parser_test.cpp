@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 #include <dsn/utility/crc.h>
 #include <dsn/utility/endians.h>
+#include <dsn/cpp/rpc_stream.h>
 #include <dsn/cpp/serialization_helper/thrift_helper.h>
 #include <dsn/cpp/serialization_helper/dsn.layer2_types.h>
 
@@ -67,6 +68,8 @@ public:
             ASSERT_EQ(msg->hdr_format, NET_HDR_THRIFT);
 
             ASSERT_EQ(msg->header->body_length, body_length);
+            // the body is a slice of the read buffer
+            ASSERT_EQ(msg->buffers.back().length(), body_length);
             ASSERT_EQ(msg->header->gpid, gpid(1, 28));
             ASSERT_EQ(msg->header->hdr_type, THRIFT_HDR_SIG);
             ASSERT_EQ(msg->header->hdr_length, sizeof(message_header));
@@ -164,6 +167,8 @@ public:
             ASSERT_EQ(msg->hdr_format, NET_HDR_THRIFT);
 
             ASSERT_EQ(msg->header->body_length, body_length);
+            // the body is a slice of the read buffer
+            ASSERT_EQ(msg->buffers.back().length(), body_length);
             ASSERT_EQ(msg->header->gpid, gpid(1, 28));
             ASSERT_EQ(msg->header->hdr_type, THRIFT_HDR_SIG);
             ASSERT_EQ(msg->header->hdr_length, sizeof(message_header));
@@ -393,4 +398,52 @@ TEST_F(thrift_message_parser_test, get_message_on_receive_v1_data)
     reader.truncate_read();
 }
 
+TEST_F(thrift_message_parser_test, prepare_on_send)
+{
+    message_ptr request = message_ex::create_request(RPC_TEST_THRIFT_MESSAGE_PARSER, 1000, 64);
+    request->header->id = 999;
+    message_ptr response = request->create_response();
+    strcpy(response->header->server.error_name, "ERR_OK");
+    {
+        rpc_write_stream stream(response.get());
+        stream.write("response body", 13);
+    }
+
+    thrift_message_parser parser;
+    for (int i = 0; i < 2; ++i) {
+        // a resent message is prepared again
+        parser.prepare_on_send(response.get());
+        std::vector<message_parser::send_buf> buffers(
+            parser.get_buffer_count_on_send(response.get()));
+        int count = parser.get_buffers_on_send(response.get(), buffers.data());
+        ASSERT_LE(2, count);
+
+        std::string data;
+        for (int j = 0; j < count; ++j) {
+            data.append(static_cast<const char *>(buffers[j].buf), buffers[j].sz);
+        }
+
+        // the header written directly is readable by thrift
+        binary_reader reader(blob::create_from_bytes(std::string(data)));
+        binary_reader_transport trans(reader);
+        boost::shared_ptr<binary_reader_transport> transport(&trans,
+                                                             [](binary_reader_transport *) {});
+        ::apache::thrift::protocol::TBinaryProtocol proto(transport);
+        int32_t total_length = 0;
+        proto.readI32(total_length);
+        ASSERT_EQ(static_cast<int32_t>(data.size()), total_length);
+        std::string error_name;
+        proto.readString(error_name);
+        ASSERT_EQ("ERR_OK", error_name);
+        std::string name;
+        ::apache::thrift::protocol::TMessageType mtype;
+        int32_t seqid = 0;
+        proto.readMessageBegin(name, mtype, seqid);
+        ASSERT_EQ(response->header->rpc_name, name);
+        ASSERT_EQ(::apache::thrift::protocol::T_REPLY, mtype);
+        ASSERT_EQ(999, seqid);
+        ASSERT_EQ("response body", data.substr(data.size() - 13));
+    }
+}
+
 } // namespace dsn
@@ -0,0 +1,125 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <dsn/tool_api.h>
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/utility/synchronize.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+
+DEFINE_TASK_CODE(LPC_TIMER_SERVICE_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+namespace {
+
+std::unique_ptr<timer_service> create_timer_service(const char *name)
+{
+    std::unique_ptr<timer_service> svc(utils::factory_store<timer_service>::create(
+        name, PROVIDER_TYPE_MAIN, task::get_current_node2(), nullptr));
+    svc->start();
+    return svc;
+}
+
+// add the task to `svc` the way task::enqueue does for delayed tasks
+void add_timer(timer_service *svc, const task_ptr &t, int delay_ms)
+{
+    t->add_ref(); // released by the timer service
+    t->set_delay(delay_ms);
+    svc->add_timer(t.get());
+}
+
+} // anonymous namespace
+
+TEST(core, timing_wheel_timer_service)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    auto svc = create_timer_service("dsn::tools::timing_wheel_timer_service");
+
+    // the delays cover the first two levels of the wheel and the cascading between them
+    const int delays_ms[] = {1, 5, 100, 255, 256, 300, 1000};
+    const int count = sizeof(delays_ms) / sizeof(delays_ms[0]);
+    std::atomic<int> fired(0);
+    std::atomic<bool> early(false);
+    utils::notify_event all_fired;
+    std::vector<task_ptr> tasks;
+    for (int delay_ms : delays_ms) {
+        uint64_t start_ms = dsn_now_ms();
+        task_ptr t =
+            tasking::create_task(LPC_TIMER_SERVICE_TEST, nullptr, [&, start_ms, delay_ms]() {
+                if (dsn_now_ms() - start_ms < static_cast<uint64_t>(delay_ms)) {
+                    early = true;
+                }
+                if (++fired == count) {
+                    all_fired.notify();
+                }
+            });
+        add_timer(svc.get(), t, delay_ms);
+        tasks.push_back(t);
+    }
+
+    // a cancelled task is never executed
+    task_ptr cancelled =
+        tasking::create_task(LPC_TIMER_SERVICE_TEST, nullptr, [&fired]() { fired += 100; });
+    add_timer(svc.get(), cancelled, 10);
+    ASSERT_TRUE(cancelled->cancel(false));
+
+    all_fired.wait();
+    for (auto &t : tasks) {
+        t->wait();
+    }
+    ASSERT_FALSE(early);
+    ASSERT_EQ(count, fired.load());
+}
+
+TEST(core, timer_service_benchmark)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    // the timers are mostly cancelled before they expire, like rpc timeouts
+    const int timer_count = 100000;
+    for (const char *name :
+         {"dsn::tools::simple_timer_service", "dsn::tools::timing_wheel_timer_service"}) {
+        auto svc = create_timer_service(name);
+
+        std::vector<task_ptr> tasks;
+        tasks.reserve(timer_count);
+        for (int i = 0; i < timer_count; ++i) {
+            tasks.push_back(tasking::create_task(LPC_TIMER_SERVICE_TEST, nullptr, []() {}));
+        }
+
+        uint64_t start_ns = dsn_now_ns();
+        for (int i = 0; i < timer_count; ++i) {
+            add_timer(svc.get(), tasks[i], 1000 + i % 1000);
+        }
+        uint64_t add_ns = dsn_now_ns() - start_ns;
+
+        start_ns = dsn_now_ns();
+        for (auto &t : tasks) {
+            t->cancel(false);
+        }
+        uint64_t cancel_ns = dsn_now_ns() - start_ns;
+
+        // wait for all the timers to expire, so that the refs held by the service are released
+        for (auto &t : tasks) {
+            while (t->get_count() > 1) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+
+        std::cout << name << ": " << timer_count << " timers, average add time "
+                  << add_ns / timer_count << " ns, average cancel time " << cancel_ns / timer_count
+                  << " ns" << std::endl;
+    }
+}
+
+} // namespace dsn
@@ -0,0 +1,106 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/service_api_cpp.h>
+#include <dsn/tool-api/rpc_message.h>
+#include <dsn/tool-api/trace_span.h>
+#include <dsn/utility/flags.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+
+DSN_DECLARE_uint32(trace_sample_rate);
+DSN_DECLARE_uint32(trace_export_batch_size);
+
+DEFINE_TASK_CODE_RPC(RPC_TEST_TRACE_SPAN, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+struct recording_sink : public trace_sink
+{
+    void export_spans(const std::vector<completed_span> &spans) override
+    {
+        exported->insert(exported->end(), spans.begin(), spans.end());
+    }
+
+    std::vector<completed_span> *exported;
+};
+
+class trace_span_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        trace_exporter::instance().flush();
+        auto sink = new recording_sink();
+        sink->exported = &_exported;
+        trace_exporter::instance().set_sink(std::unique_ptr<trace_sink>(sink));
+    }
+
+    void TearDown() override
+    {
+        FLAGS_trace_sample_rate = 0;
+        trace_exporter::instance().set_sink(nullptr);
+    }
+
+    std::vector<completed_span> _exported;
+};
+
+TEST_F(trace_span_test, span_points)
+{
+    FLAGS_trace_export_batch_size = 2;
+
+    trace_span_ptr span = new trace_span(0x1234, RPC_TEST_TRACE_SPAN);
+    span->add_point("first");
+    span->add_point("second");
+    for (int i = 0; i < trace_span::MAX_POINT_COUNT; ++i) {
+        span->add_point("more");
+    }
+    span = nullptr;
+    // not exported until the batch is full
+    ASSERT_TRUE(_exported.empty());
+
+    span = new trace_span(0x5678, RPC_TEST_TRACE_SPAN);
+    span = nullptr;
+    ASSERT_EQ(2u, _exported.size());
+
+    const completed_span &first = _exported[0];
+    ASSERT_EQ(0x1234u, first.trace_id);
+    ASSERT_EQ(RPC_TEST_TRACE_SPAN, first.code);
+    ASSERT_EQ(trace_span::MAX_POINT_COUNT, static_cast<int>(first.points.size()));
+    ASSERT_STREQ("first", first.points[0].event);
+    ASSERT_STREQ("second", first.points[1].event);
+    ASSERT_LE(first.points[0].ts_ns, first.points[1].ts_ns);
+    ASSERT_EQ(0u, first.to_string().find("trace_id=0000000000001234, code=RPC_TEST_TRACE_SPAN, "
+                                          "first=+0us, second=+"));
+    ASSERT_TRUE(_exported[1].points.empty());
+
+    FLAGS_trace_export_batch_size = 64;
+}
+
+TEST_F(trace_span_test, sample_request)
+{
+    message_ex *request = message_ex::create_request(RPC_TEST_TRACE_SPAN);
+    request->add_ref();
+    ASSERT_EQ(nullptr, trace_span::sample(request));
+
+    FLAGS_trace_sample_rate = 1;
+    request->span = trace_span::sample(request);
+    ASSERT_NE(nullptr, request->span.get());
+    ASSERT_EQ(request->header->trace_id, request->span->trace_id());
+
+    // the span is shared by the response, and completed when both are released
+    message_ex *response = request->create_response();
+    response->add_ref();
+    ASSERT_EQ(request->span.get(), response->span.get());
+    request->release_ref();
+    response->span->add_point("reply");
+    response->release_ref();
+
+    trace_exporter::instance().flush();
+    ASSERT_EQ(1u, _exported.size());
+    ASSERT_EQ(2u, _exported[0].points.size());
+    ASSERT_STREQ("rpc_receive", _exported[0].points[0].event);
+    ASSERT_STREQ("reply", _exported[0].points[1].event);
+}
+
+} // namespace dsn
@@ -0,0 +1,60 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/service_api_cpp.h>
+#include <dsn/tool-api/command_manager.h>
+#include <dsn/utility/defer.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace tools {
+
+DSN_DECLARE_uint32(tracer_sample_ratio);
+DSN_DECLARE_bool(tracer_output_to_ring);
+
+DEFINE_TASK_CODE(LPC_TEST_TRACER_RING, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+// the tracer is installed by the toollets of config-test.ini
+TEST(tracer_test, ring_buffer)
+{
+    uint32_t old_ratio = FLAGS_tracer_sample_ratio;
+    bool old_output_to_ring = FLAGS_tracer_output_to_ring;
+    auto cleanup = defer([old_ratio, old_output_to_ring]() {
+        FLAGS_tracer_sample_ratio = old_ratio;
+        FLAGS_tracer_output_to_ring = old_output_to_ring;
+    });
+    FLAGS_tracer_sample_ratio = 1;
+    FLAGS_tracer_output_to_ring = true;
+
+    task_ptr t = tasking::enqueue(LPC_TEST_TRACER_RING, nullptr, []() {});
+    t->wait();
+
+    std::string output;
+    ASSERT_TRUE(command_manager::instance().run_command("tracer.dump", {"100000"}, output));
+    std::string begin = fmt::format("LPC_TEST_TRACER_RING EXEC BEGIN, task_id = {:016x}", t->id());
+    ASSERT_NE(std::string::npos, output.find(begin)) << output;
+
+    // none of the flows is sampled
+    FLAGS_tracer_sample_ratio = 0;
+    t = tasking::enqueue(LPC_TEST_TRACER_RING, nullptr, []() {});
+    t->wait();
+    ASSERT_TRUE(command_manager::instance().run_command("tracer.dump", {"100000"}, output));
+    begin = fmt::format("LPC_TEST_TRACER_RING EXEC BEGIN, task_id = {:016x}", t->id());
+    ASSERT_EQ(std::string::npos, output.find(begin));
+
+    const std::string path = "tracer_test.bin";
+    ASSERT_TRUE(command_manager::instance().run_command("tracer.save", {path}, output));
+    int64_t size = 0;
+    ASSERT_TRUE(utils::filesystem::file_size(path, size));
+    ASSERT_GT(size, 64);
+    utils::filesystem::remove_path(path);
+
+    ASSERT_TRUE(command_manager::instance().run_command("tracer.dump", {"abc"}, output));
+    ASSERT_NE(std::string::npos, output.find("invalid arguments"));
+}
+
+} // namespace tools
+} // namespace dsn
@@ -24,8 +24,10 @@
  * THE SOFTWARE.
  */
 
+#include <dsn/utility/arena_binary_writer.h>
 #include <dsn/utility/transient_memory.h>
 #include <gtest/gtest.h>
+#include <cstring>
 
 using namespace ::dsn;
 
@@ -101,3 +103,94 @@ TEST(core, transient_memory)
 
     tls_trans_mem_init(1024 * 1024); // restore
 }
+
+TEST(core, tls_pool)
+{
+    tls_pool_stats old_stats = tls_pool_get_stats();
+
+    // the freed piece is reused by the next allocation of the same size class
+    void *p1 = tls_pool_malloc(100);
+    memset(p1, 0, 100);
+    tls_pool_free(p1);
+    void *p2 = tls_pool_malloc(120);
+    if (tls_pool_enabled()) {
+        ASSERT_EQ(p1, p2);
+    }
+    tls_pool_free(p2);
+
+    // large pieces are not cached
+    void *p3 = tls_pool_malloc(1024 * 1024);
+    memset(p3, 0, 1024 * 1024);
+    tls_pool_free(p3);
+
+    // the memory is aligned
+    for (size_t sz : {(size_t)1, (size_t)64, (size_t)65, (size_t)4096, (size_t)4097}) {
+        void *p = tls_pool_malloc(sz);
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(p) % 16);
+        tls_pool_free(p);
+    }
+
+    // other threads may allocate concurrently
+    tls_pool_stats stats = tls_pool_get_stats();
+    if (tls_pool_enabled()) {
+        // the large pieces are not counted
+        ASSERT_LE(old_stats.hit_count + old_stats.miss_count + 6,
+                  stats.hit_count + stats.miss_count);
+        ASSERT_LT(old_stats.hit_count, stats.hit_count);
+        ASSERT_LT(0u, stats.cached_count);
+    }
+
+    // disabled pool, the pieces allocated before disabling can still be freed
+    bool enabled = tls_pool_enabled();
+    void *p4 = tls_pool_malloc(100);
+    tls_pool_init(false, 1024 * 1024);
+    void *p5 = tls_pool_malloc(100);
+    ASSERT_NE(p4, p5);
+    tls_pool_free(p4);
+    tls_pool_free(p5);
+    tls_pool_init(enabled, 1024 * 1024); // restore
+}
+
+TEST(core, arena_binary_writer)
+{
+    struct test_header
+    {
+        int32_t magic;
+        int32_t length;
+    };
+
+    // start with a new block, so that all the chunks below are in it
+    tls_trans_mem_alloc(4096);
+
+    arena_binary_writer writer(sizeof(test_header), 64);
+    ASSERT_EQ((int)sizeof(test_header), writer.total_size());
+    std::string data(200, 'a');
+    for (int i = 0; i < 10; i++) {
+        writer.write(data.data(), 20);
+    }
+    test_header *hdr = writer.header<test_header>();
+    hdr->magic = 0x12345678;
+    hdr->length = writer.total_size() - (int)sizeof(test_header);
+
+    // the chunks are merged into one buffer of the transient memory block
+    blob bb = writer.get_buffer();
+    ASSERT_EQ(1, writer.get_buffer_count());
+    ASSERT_EQ(tls_trans_memory.block->get(), bb.buffer_ptr());
+    ASSERT_EQ((unsigned int)(sizeof(test_header) + 200), bb.length());
+    ASSERT_EQ((const char *)hdr, bb.data());
+    ASSERT_EQ(0x12345678, hdr->magic);
+    ASSERT_EQ(200, hdr->length);
+    ASSERT_EQ(data, std::string(bb.data() + sizeof(test_header), 200));
+
+    // the shared buffers are not copied
+    blob shared = blob::create_from_bytes(std::string(100, 'b'));
+    writer.write_shared(shared);
+    writer.write(data.data(), 10);
+    std::vector<blob> buffers;
+    writer.get_buffers(buffers);
+    ASSERT_EQ(3u, buffers.size());
+    ASSERT_EQ(shared.data(), buffers[1].data());
+    ASSERT_EQ(10u, buffers[2].length());
+    ASSERT_EQ(tls_trans_memory.block->get(), buffers[2].buffer_ptr());
+    ASSERT_EQ(sizeof(test_header) + 310, (size_t)writer.total_size());
+}
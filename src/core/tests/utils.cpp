@@ -263,3 +263,39 @@ TEST(core, ref_ptr)
     z = foo_ptr();
     EXPECT_TRUE(count == 0);
 }
+
+TEST(core, make_shared_array)
+{
+    std::shared_ptr<char> chars = dsn::utils::make_shared_array<char>(100);
+    memset(chars.get(), 'a', 100);
+    ASSERT_EQ(1, chars.use_count());
+
+    std::shared_ptr<int64_t> ints = dsn::utils::make_shared_array<int64_t>(10);
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(ints.get()) % alignof(int64_t));
+    for (int i = 0; i < 10; ++i) {
+        ints.get()[i] = i;
+    }
+
+    std::shared_ptr<std::string> strs = dsn::utils::make_shared_array<std::string>(3);
+    strs.get()[2] = "not trivial";
+
+    ASSERT_NE(nullptr, dsn::utils::make_shared_array<char>(0));
+}
+
+TEST(core, blob_create_from_bytes)
+{
+    dsn::blob copied = dsn::blob::create_from_bytes("hello", 5);
+    ASSERT_EQ("hello", copied.to_string());
+
+    std::string str(1000, 'x');
+    const char *data = str.data();
+    dsn::blob moved = dsn::blob::create_from_bytes(std::move(str));
+    ASSERT_EQ(data, moved.data());
+    ASSERT_EQ(1000u, moved.length());
+
+    // the short strings are stored in the string object, which is moved into the blob
+    dsn::blob short_moved = dsn::blob::create_from_bytes(std::string("short"));
+    dsn::blob range = short_moved.range(1, 3);
+    short_moved = dsn::blob();
+    ASSERT_EQ("hor", range.to_string());
+}
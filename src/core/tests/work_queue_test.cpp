@@ -0,0 +1,59 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/work_queue.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace dsn {
+
+struct work_item
+{
+    work_item *next{nullptr};
+    int producer{0};
+    int seq{0};
+};
+
+TEST(work_queue_test, mpsc_work_queue)
+{
+    const int producer_count = 8;
+    const int work_count = 10000;
+    mpsc_work_queue<work_item> q;
+    std::vector<std::vector<work_item>> items(producer_count, std::vector<work_item>(work_count));
+
+    std::atomic<bool> running{false};
+    std::atomic<int> completed{0};
+    std::vector<int> last_seq(producer_count, -1);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producer_count; ++p) {
+        producers.emplace_back([&, p]() {
+            for (int i = 0; i < work_count; ++i) {
+                work_item *w = &items[p][i];
+                w->producer = p;
+                w->seq = i;
+                w = q.add_work(w, nullptr);
+                // run the workloads until the queue is released
+                while (w != nullptr) {
+                    ASSERT_FALSE(running.exchange(true));
+                    ASSERT_EQ(nullptr, w->next);
+                    // the works of a producer are run in the order they are added
+                    ASSERT_EQ(last_seq[w->producer] + 1, w->seq);
+                    last_seq[w->producer] = w->seq;
+                    completed++;
+                    running = false;
+                    w = q.on_work_completed(w, nullptr);
+                }
+            }
+        });
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    ASSERT_EQ(producer_count * work_count, completed.load());
+}
+
+} // namespace dsn
@@ -43,6 +43,10 @@ void register_std_lock_providers()
     lock_nr_provider::register_component<std_lock_nr_provider>("dsn::tools::std_lock_nr_provider");
     rwlock_nr_provider::register_component<std_rwlock_nr_provider>(
         "dsn::tools::std_rwlock_nr_provider");
+    lock_nr_provider::register_component<adaptive_lock_nr_provider>(
+        "dsn::tools::adaptive_lock_nr_provider");
+    rwlock_nr_provider::register_component<reader_biased_rwlock_nr_provider>(
+        "dsn::tools::reader_biased_rwlock_nr_provider");
     semaphore_provider::register_component<std_semaphore_provider>(
         "dsn::tools::std_semaphore_provider");
 }
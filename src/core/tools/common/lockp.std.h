@@ -38,6 +38,8 @@
 #include <dsn/utility/synchronize.h>
 #include "core/core/zlock_provider.h"
 
+#include <pthread.h>
+
 namespace dsn {
 namespace tools {
 
@@ -86,6 +88,56 @@ private:
     utils::rw_lock_nr _lock;
 };
 
+// spins for a while before sleeping on the futex if the lock is held by others, the spin count
+// adapts to how long the lock is held recently (glibc's PTHREAD_MUTEX_ADAPTIVE_NP)
+class adaptive_lock_nr_provider : public lock_nr_provider
+{
+public:
+    adaptive_lock_nr_provider(lock_nr_provider *inner_provider) : lock_nr_provider(inner_provider)
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+        pthread_mutex_init(&_lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+    virtual ~adaptive_lock_nr_provider() { pthread_mutex_destroy(&_lock); }
+    virtual void lock() { pthread_mutex_lock(&_lock); }
+    virtual bool try_lock() { return pthread_mutex_trylock(&_lock) == 0; }
+    virtual void unlock() { pthread_mutex_unlock(&_lock); }
+
+private:
+    pthread_mutex_t _lock;
+};
+
+// the readers aren't blocked by the waiting writers, but only by the one holding the lock, which
+// suits the locks mostly read such as the replica map. The writers may starve if the lock is
+// always held by some readers.
+class reader_biased_rwlock_nr_provider : public rwlock_nr_provider
+{
+public:
+    reader_biased_rwlock_nr_provider(rwlock_nr_provider *inner_provider)
+        : rwlock_nr_provider(inner_provider)
+    {
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+        pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_READER_NP);
+        pthread_rwlock_init(&_lock, &attr);
+        pthread_rwlockattr_destroy(&attr);
+    }
+    virtual ~reader_biased_rwlock_nr_provider() { pthread_rwlock_destroy(&_lock); }
+    virtual void lock_read() { pthread_rwlock_rdlock(&_lock); }
+    virtual void unlock_read() { pthread_rwlock_unlock(&_lock); }
+    virtual bool try_lock_read() { return pthread_rwlock_tryrdlock(&_lock) == 0; }
+
+    virtual void lock_write() { pthread_rwlock_wrlock(&_lock); }
+    virtual void unlock_write() { pthread_rwlock_unlock(&_lock); }
+    virtual bool try_lock_write() { return pthread_rwlock_trywrlock(&_lock) == 0; }
+
+private:
+    pthread_rwlock_t _lock;
+};
+
 class std_semaphore_provider : public semaphore_provider
 {
 public:
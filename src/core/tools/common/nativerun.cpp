@@ -48,7 +48,7 @@ void nativerun::install(service_spec &spec)
         spec.env_factory_name = ("dsn::env_provider");
 
     if (spec.timer_factory_name == "")
-        spec.timer_factory_name = ("dsn::tools::simple_timer_service");
+        spec.timer_factory_name = ("dsn::tools::timing_wheel_timer_service");
     {
         network_client_config cs;
         cs.factory_name = "dsn::tools::asio_network_provider";
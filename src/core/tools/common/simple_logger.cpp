@@ -25,7 +25,13 @@
  */
 
 #include "simple_logger.h"
+#include <algorithm>
+#include <deque>
 #include <sstream>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/flags.h>
 #include <dsn/utility/time_utils.h>
@@ -53,10 +59,36 @@ DSN_DEFINE_validator(stderr_start_level, [](const char *level) -> bool {
     return strcmp(level, "LOG_LEVEL_INVALID") != 0;
 });
 
+DSN_DEFINE_uint32("tools.async_logger",
+                  buffer_size_kb_per_thread,
+                  256,
+                  "size (KB) of the log buffer of each logging thread");
+
+DSN_DEFINE_uint32("tools.async_logger",
+                  flush_interval_ms,
+                  100,
+                  "interval (ms) the background thread writes the buffered logs to file");
+
+DSN_DEFINE_string("tools.async_logger",
+                  block_start_level,
+                  "LOG_LEVEL_WARNING",
+                  "when the log buffer is full, messages at or above this level wait until "
+                  "there is room, and messages of lower levels are dropped");
+DSN_DEFINE_validator(block_start_level, [](const char *level) -> bool {
+    return strcmp(level, "LOG_LEVEL_INVALID") != 0;
+});
+
+DSN_DEFINE_bool("tools.async_logger",
+                deferred_formatting,
+                true,
+                "format the messages of the fmt_logging macros below stderr_start_level on the "
+                "background thread rather than the logging thread");
+
+static const char s_level_char[] = "IDWEF";
+static const int MAX_LINES_PER_LOG_FILE = 200000;
+
 static void print_header(FILE *fp, dsn_log_level_t log_level)
 {
-    static char s_level_char[] = "IDWEF";
-
     uint64_t ts = dsn_now_ns();
     char str[24];
     dsn::utils::time_ms_to_string(ts / 1000000, str);
@@ -71,6 +103,101 @@ static void print_header(FILE *fp, dsn_log_level_t log_level)
             log_prefixed_message_func().c_str());
 }
 
+// print to the end of `out`
+static void append_vprintf(std::string &out, const char *fmt, va_list args)
+{
+    va_list args2;
+    va_copy(args2, args);
+
+    size_t old_size = out.size();
+    size_t room = std::max(out.capacity() - old_size, (size_t)256);
+    out.resize(old_size + room);
+    int n = vsnprintf(&out[old_size], room + 1, fmt, args);
+    if (n < 0) {
+        n = 0;
+    } else if ((size_t)n > room) {
+        out.resize(old_size + n);
+        vsnprintf(&out[old_size], n + 1, fmt, args2);
+    }
+    out.resize(old_size + n);
+    va_end(args2);
+}
+
+static void append_printf(std::string &out, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    append_vprintf(out, fmt, args);
+    va_end(args);
+}
+
+// same as print_header, but print to the end of `out`
+static void append_header(std::string &out, dsn_log_level_t log_level)
+{
+    uint64_t ts = dsn_now_ns();
+    char str[24];
+    dsn::utils::time_ms_to_string(ts / 1000000, str);
+
+    int tid = dsn::utils::get_current_tid();
+    append_printf(out,
+                  "%c%s (%" PRIu64 " %04x) %s",
+                  s_level_char[log_level],
+                  str,
+                  ts,
+                  tid,
+                  log_prefixed_message_func().c_str());
+}
+
+// find the range [start_index, index) of log files in `log_dir`, `index` is the one to create
+static void scan_log_files(const std::string &log_dir, int &start_index, int &index)
+{
+    // we assume all valid entries are positive
+    start_index = 0;
+    index = 1;
+
+    std::vector<std::string> sub_list;
+    if (!dsn::utils::filesystem::get_subfiles(log_dir, sub_list, false)) {
+        dassert(false, "Fail to get subfiles in %s.", log_dir.c_str());
+    }
+    for (auto &fpath : sub_list) {
+        auto &&name = dsn::utils::filesystem::get_file_name(fpath);
+        if (name.length() <= 8 || name.substr(0, 4) != "log.")
+            continue;
+
+        int idx;
+        if (1 != sscanf(name.c_str(), "log.%d.txt", &idx) || idx <= 0)
+            continue;
+
+        if (idx > index)
+            index = idx;
+
+        if (start_index == 0 || idx < start_index)
+            start_index = idx;
+    }
+
+    if (start_index == 0)
+        start_index = index;
+    else
+        ++index;
+}
+
+// remove the oldest log files to keep at most max_number_of_log_files_on_disk
+static void remove_garbage_log_files(const std::string &log_dir, int &start_index, int index)
+{
+    // TODO: move gc out of criticial path
+    while (index - start_index > FLAGS_max_number_of_log_files_on_disk) {
+        std::stringstream str2;
+        str2 << "log." << start_index++ << ".txt";
+        auto dp = utils::filesystem::path_combine(log_dir, str2.str());
+        if (utils::filesystem::file_exists(dp)) {
+            if (::remove(dp.c_str()) != 0) {
+                // if remove failed, just print log and ignore it.
+                printf("Failed to remove garbage log file %s\n", dp.c_str());
+            }
+        }
+    }
+}
+
 screen_logger::screen_logger(bool short_header) : logging_provider("./")
 {
     _short_header = short_header;
@@ -109,39 +236,12 @@ void screen_logger::flush() { ::fflush(stdout); }
 simple_logger::simple_logger(const char *log_dir) : logging_provider(log_dir)
 {
     _log_dir = std::string(log_dir);
-    // we assume all valid entries are positive
-    _start_index = 0;
-    _index = 1;
     _lines = 0;
     _log = nullptr;
     _stderr_start_level = enum_from_string(FLAGS_stderr_start_level, LOG_LEVEL_INVALID);
 
     // check existing log files
-    std::vector<std::string> sub_list;
-    if (!dsn::utils::filesystem::get_subfiles(_log_dir, sub_list, false)) {
-        dassert(false, "Fail to get subfiles in %s.", _log_dir.c_str());
-    }
-    for (auto &fpath : sub_list) {
-        auto &&name = dsn::utils::filesystem::get_file_name(fpath);
-        if (name.length() <= 8 || name.substr(0, 4) != "log.")
-            continue;
-
-        int index;
-        if (1 != sscanf(name.c_str(), "log.%d.txt", &index) || index <= 0)
-            continue;
-
-        if (index > _index)
-            _index = index;
-
-        if (_start_index == 0 || index < _start_index)
-            _start_index = index;
-    }
-    sub_list.clear();
-
-    if (_start_index == 0)
-        _start_index = _index;
-    else
-        ++_index;
+    scan_log_files(_log_dir, _start_index, _index);
 
     create_log_file();
 }
@@ -157,18 +257,7 @@ void simple_logger::create_log_file()
     str << _log_dir << "/log." << _index++ << ".txt";
     _log = ::fopen(str.str().c_str(), "w+");
 
-    // TODO: move gc out of criticial path
-    while (_index - _start_index > FLAGS_max_number_of_log_files_on_disk) {
-        std::stringstream str2;
-        str2 << "log." << _start_index++ << ".txt";
-        auto dp = utils::filesystem::path_combine(_log_dir, str2.str());
-        if (utils::filesystem::file_exists(dp)) {
-            if (::remove(dp.c_str()) != 0) {
-                // if remove failed, just print log and ignore it.
-                printf("Failed to remove garbage log file %s\n", dp.c_str());
-            }
-        }
-    }
+    remove_garbage_log_files(_log_dir, _start_index, _index);
 }
 
 simple_logger::~simple_logger(void)
@@ -217,7 +306,7 @@ void simple_logger::dsn_logv(const char *file,
         printf("\n");
     }
 
-    if (++_lines >= 200000) {
+    if (++_lines >= MAX_LINES_PER_LOG_FILE) {
         create_log_file();
     }
 }
@@ -247,10 +336,437 @@ void simple_logger::dsn_log(const char *file,
         printf("%s\n", str);
     }
 
-    if (++_lines >= 200000) {
+    if (++_lines >= MAX_LINES_PER_LOG_FILE) {
         create_log_file();
     }
 }
 
+// -----------   async_logger ---------------------------------
+
+namespace {
+
+std::atomic<uint64_t> s_next_async_logger_id(1);
+
+// the log buffer of current thread, which is orphaned when the thread exits
+struct tls_async_log_buffer
+{
+    uint64_t logger_id{0};
+    std::shared_ptr<async_logger::thread_buffer> buffer;
+    std::string scratch; // to format the messages
+
+    void release()
+    {
+        if (buffer != nullptr) {
+            buffer->orphaned.store(true, std::memory_order_release);
+            buffer.reset();
+        }
+        logger_id = 0;
+    }
+
+    ~tls_async_log_buffer() { release(); }
+};
+
+thread_local tls_async_log_buffer s_tls_log_buffer;
+
+// all the iovs are written unless there is an io error
+void writev_fully(int fd, struct iovec *iov, int count)
+{
+    while (count > 0) {
+        int batch = std::min(count, IOV_MAX);
+        ssize_t written = ::writev(fd, iov, batch);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            printf("Failed to write log file, err = %d\n", errno);
+            return;
+        }
+
+        // skip the written iovs, and adjust the partially written one
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+// the iovs of [from, to) of the buffer `b`
+void push_iovs(async_logger::thread_buffer *b,
+               uint64_t from,
+               uint64_t to,
+               std::vector<struct iovec> &iovs)
+{
+    if (from == to)
+        return;
+
+    size_t pos = from & (b->capacity - 1);
+    size_t len = to - from;
+    size_t first = std::min(len, b->capacity - pos);
+    iovs.push_back({b->data + pos, first});
+    if (len > first) {
+        iovs.push_back({b->data, len - first});
+    }
+}
+
+void format_deferred(const deferred_log_message *msg, std::string &out)
+{
+    msg->format_to(out);
+    out.push_back('\n');
+}
+
+} // anonymous namespace
+
+async_logger::thread_buffer::thread_buffer(size_t cap)
+    : capacity(cap),
+      head(0),
+      tail(0),
+      records(0),
+      orphaned(false),
+      deferred_capacity(std::max(cap / 64, (size_t)64)),
+      deferred_head(0),
+      deferred_tail(0)
+{
+    data = new char[capacity];
+    deferred = new deferred_entry[deferred_capacity];
+}
+
+async_logger::thread_buffer::~thread_buffer()
+{
+    for (uint64_t i = deferred_tail.load(); i != deferred_head.load(); ++i) {
+        delete deferred[i & (deferred_capacity - 1)].msg;
+    }
+    delete[] deferred;
+    delete[] data;
+}
+
+async_logger::async_logger(const char *log_dir)
+    : logging_provider(log_dir),
+      _id(s_next_async_logger_id.fetch_add(1)),
+      _log_dir(log_dir),
+      _log_fd(-1),
+      _lines(0),
+      _reported_dropped_count(0),
+      _dropped_count(0),
+      _stopped(false)
+{
+    _stderr_start_level = enum_from_string(FLAGS_stderr_start_level, LOG_LEVEL_INVALID);
+    _block_start_level = enum_from_string(FLAGS_block_start_level, LOG_LEVEL_INVALID);
+
+    // round up to power of 2 to locate by mask
+    _buffer_capacity = 4096;
+    while (_buffer_capacity < (size_t)FLAGS_buffer_size_kb_per_thread * 1024) {
+        _buffer_capacity <<= 1;
+    }
+
+    scan_log_files(_log_dir, _start_index, _index);
+    create_log_file();
+
+    _flusher = std::thread(&async_logger::flusher_loop, this);
+}
+
+async_logger::~async_logger(void)
+{
+    {
+        std::lock_guard<std::mutex> l(_flusher_lock);
+        _stopped = true;
+    }
+    _flusher_cond.notify_one();
+    _flusher.join();
+
+    utils::auto_lock<::dsn::utils::ex_lock> l(_write_lock);
+    write_buffers();
+    ::close(_log_fd);
+}
+
+void async_logger::create_log_file()
+{
+    if (_log_fd >= 0)
+        ::close(_log_fd);
+
+    _lines = 0;
+
+    std::stringstream str;
+    str << _log_dir << "/log." << _index++ << ".txt";
+    _log_fd = ::open(str.str().c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+
+    remove_garbage_log_files(_log_dir, _start_index, _index);
+}
+
+async_logger::thread_buffer *async_logger::get_thread_buffer()
+{
+    tls_async_log_buffer &tls = s_tls_log_buffer;
+    if (dsn_likely(tls.logger_id == _id)) {
+        return tls.buffer.get();
+    }
+
+    // current thread is logging with another logger before
+    tls.release();
+    tls.buffer = std::make_shared<thread_buffer>(_buffer_capacity);
+    tls.logger_id = _id;
+
+    std::lock_guard<std::mutex> l(_buffers_lock);
+    _buffers.push_back(tls.buffer);
+    return tls.buffer.get();
+}
+
+void async_logger::append(dsn_log_level_t log_level,
+                          const char *msg,
+                          size_t len,
+                          std::unique_ptr<deferred_log_message> deferred)
+{
+    thread_buffer *b = get_thread_buffer();
+
+    uint64_t dh = b->deferred_head.load(std::memory_order_relaxed);
+    std::string line;
+    if (deferred != nullptr &&
+        dh - b->deferred_tail.load(std::memory_order_acquire) == b->deferred_capacity) {
+        // too many deferred messages to be formatted, so format it here
+        line.assign(msg, len);
+        format_deferred(deferred.get(), line);
+        deferred.reset();
+        msg = line.data();
+        len = line.size();
+    }
+    len = std::min(len, b->capacity);
+
+    uint64_t h = b->head.load(std::memory_order_relaxed);
+    uint64_t t = b->tail.load(std::memory_order_acquire);
+    while (b->capacity - (h - t) < len) {
+        if (log_level < _block_start_level) {
+            _dropped_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        _flusher_cond.notify_one();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        t = b->tail.load(std::memory_order_acquire);
+    }
+
+    size_t pos = h & (b->capacity - 1);
+    size_t first = std::min(len, b->capacity - pos);
+    memcpy(b->data + pos, msg, first);
+    memcpy(b->data, msg + first, len - first);
+    if (deferred != nullptr) {
+        b->deferred[dh & (b->deferred_capacity - 1)] = {h + len, deferred.release()};
+        b->deferred_head.store(dh + 1, std::memory_order_release);
+    }
+    b->records.fetch_add(1, std::memory_order_relaxed);
+    b->head.store(h + len, std::memory_order_release);
+
+    // wake up the flusher once the buffer becomes half full
+    if (h - t < b->capacity / 2 && h + len - t >= b->capacity / 2) {
+        _flusher_cond.notify_one();
+    }
+}
+
+void async_logger::write_buffers()
+{
+    std::vector<std::shared_ptr<thread_buffer>> buffers;
+    {
+        std::lock_guard<std::mutex> l(_buffers_lock);
+        buffers = _buffers;
+    }
+
+    std::vector<struct iovec> iovs;
+    std::vector<uint64_t> heads(buffers.size());
+    std::vector<uint64_t> deferred_heads(buffers.size());
+    // the deferred messages, of which the strings are stable on push_back()
+    std::deque<std::string> formatted;
+    uint64_t records = 0;
+    for (size_t i = 0; i < buffers.size(); i++) {
+        thread_buffer *b = buffers[i].get();
+        uint64_t h = b->head.load(std::memory_order_acquire);
+        uint64_t t = b->tail.load(std::memory_order_relaxed);
+        uint64_t dh = b->deferred_head.load(std::memory_order_acquire);
+        uint64_t dt = b->deferred_tail.load(std::memory_order_relaxed);
+        heads[i] = h;
+        if (h == t) {
+            deferred_heads[i] = dt;
+            continue;
+        }
+
+        // each deferred message follows its header in the buffer
+        for (; dt != dh; ++dt) {
+            thread_buffer::deferred_entry &e = b->deferred[dt & (b->deferred_capacity - 1)];
+            if (e.pos > h)
+                break;
+            push_iovs(b, t, e.pos, iovs);
+            t = e.pos;
+
+            formatted.emplace_back();
+            format_deferred(e.msg, formatted.back());
+            delete e.msg;
+            e.msg = nullptr;
+            iovs.push_back({&formatted.back()[0], formatted.back().size()});
+        }
+        push_iovs(b, t, h, iovs);
+        deferred_heads[i] = dt;
+        records += b->records.exchange(0, std::memory_order_relaxed);
+    }
+
+    std::string dropped_msg;
+    uint64_t dropped = _dropped_count.load(std::memory_order_relaxed);
+    if (dropped != _reported_dropped_count) {
+        append_header(dropped_msg, LOG_LEVEL_WARNING);
+        append_printf(dropped_msg,
+                      "%" PRIu64 " log messages are dropped as the log buffers are full\n",
+                      dropped - _reported_dropped_count);
+        iovs.push_back({&dropped_msg[0], dropped_msg.size()});
+        _reported_dropped_count = dropped;
+        records++;
+    }
+
+    if (!iovs.empty()) {
+        writev_fully(_log_fd, iovs.data(), static_cast<int>(iovs.size()));
+    }
+
+    bool has_orphan = false;
+    for (size_t i = 0; i < buffers.size(); i++) {
+        thread_buffer *b = buffers[i].get();
+        // check orphaned before tail, as the producer never writes after being orphaned
+        if (b->orphaned.load(std::memory_order_acquire) &&
+            b->head.load(std::memory_order_acquire) == heads[i]) {
+            has_orphan = true;
+        }
+        b->deferred_tail.store(deferred_heads[i], std::memory_order_release);
+        b->tail.store(heads[i], std::memory_order_release);
+    }
+    if (has_orphan) {
+        std::lock_guard<std::mutex> l(_buffers_lock);
+        _buffers.erase(std::remove_if(_buffers.begin(),
+                                      _buffers.end(),
+                                      [](const std::shared_ptr<thread_buffer> &b) {
+                                          return b->orphaned.load(std::memory_order_acquire) &&
+                                                 b->head.load() == b->tail.load();
+                                      }),
+                       _buffers.end());
+    }
+
+    _lines += records;
+    if (_lines >= MAX_LINES_PER_LOG_FILE) {
+        create_log_file();
+    }
+}
+
+void async_logger::flusher_loop()
+{
+    std::unique_lock<std::mutex> l(_flusher_lock);
+    while (!_stopped) {
+        _flusher_cond.wait_for(l, std::chrono::milliseconds(FLAGS_flush_interval_ms));
+        l.unlock();
+        {
+            utils::auto_lock<::dsn::utils::ex_lock> wl(_write_lock);
+            write_buffers();
+        }
+        l.lock();
+    }
+}
+
+void async_logger::flush()
+{
+    {
+        utils::auto_lock<::dsn::utils::ex_lock> l(_write_lock);
+        write_buffers();
+    }
+    ::fflush(stdout);
+}
+
+void async_logger::dsn_logv(const char *file,
+                            const char *function,
+                            const int line,
+                            dsn_log_level_t log_level,
+                            const char *fmt,
+                            va_list args)
+{
+    va_list args2;
+    if (log_level >= _stderr_start_level) {
+        va_copy(args2, args);
+    }
+
+    std::string &msg = s_tls_log_buffer.scratch;
+    msg.clear();
+    append_header(msg, log_level);
+    if (!FLAGS_short_header) {
+        append_printf(msg, "%s:%d:%s(): ", file, line, function);
+    }
+    append_vprintf(msg, fmt, args);
+    msg.push_back('\n');
+    append(log_level, msg.data(), msg.size());
+
+    if (FLAGS_fast_flush || log_level >= LOG_LEVEL_ERROR) {
+        utils::auto_lock<::dsn::utils::ex_lock> l(_write_lock);
+        write_buffers();
+    }
+
+    if (log_level >= _stderr_start_level) {
+        print_header(stdout, log_level);
+        if (!FLAGS_short_header) {
+            printf("%s:%d:%s(): ", file, line, function);
+        }
+        vprintf(fmt, args2);
+        printf("\n");
+        va_end(args2);
+    }
+}
+
+void async_logger::dsn_log(const char *file,
+                           const char *function,
+                           const int line,
+                           dsn_log_level_t log_level,
+                           const char *str)
+{
+    std::string &msg = s_tls_log_buffer.scratch;
+    msg.clear();
+    append_header(msg, log_level);
+    if (!FLAGS_short_header) {
+        append_printf(msg, "%s:%d:%s(): ", file, line, function);
+    }
+    msg.append(str);
+    msg.push_back('\n');
+    append(log_level, msg.data(), msg.size());
+
+    if (FLAGS_fast_flush || log_level >= LOG_LEVEL_ERROR) {
+        utils::auto_lock<::dsn::utils::ex_lock> l(_write_lock);
+        write_buffers();
+    }
+
+    if (log_level >= _stderr_start_level) {
+        print_header(stdout, log_level);
+        if (!FLAGS_short_header) {
+            printf("%s:%d:%s(): ", file, line, function);
+        }
+        printf("%s\n", str);
+    }
+}
+
+void async_logger::dsn_log_deferred(const char *file,
+                                    const char *function,
+                                    const int line,
+                                    dsn_log_level_t log_level,
+                                    std::unique_ptr<deferred_log_message> msg)
+{
+    // the messages copied to stderr are formatted on the logging thread anyway
+    if (!FLAGS_deferred_formatting || log_level >= _stderr_start_level) {
+        logging_provider::dsn_log_deferred(file, function, line, log_level, std::move(msg));
+        return;
+    }
+
+    std::string &header = s_tls_log_buffer.scratch;
+    header.clear();
+    append_header(header, log_level);
+    if (!FLAGS_short_header) {
+        append_printf(header, "%s:%d:%s(): ", file, line, function);
+    }
+    append(log_level, header.data(), header.size(), std::move(msg));
+
+    if (FLAGS_fast_flush || log_level >= LOG_LEVEL_ERROR) {
+        utils::auto_lock<::dsn::utils::ex_lock> l(_write_lock);
+        write_buffers();
+    }
+}
+
 } // namespace tools
 } // namespace dsn
@@ -27,7 +27,12 @@
 #pragma once
 
 #include <dsn/tool_api.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 #include <cstdio>
 
 namespace dsn {
@@ -101,5 +106,115 @@ private:
     int _lines;
     dsn_log_level_t _stderr_start_level;
 };
+
+/*
+ * async_logger writes to the same log files as simple_logger (and shares its options in
+ * [tools.simple_logger]), but never does file io on the logging thread:
+ *  - every logging thread formats its messages into its own lock-free ring buffer
+ *  - a background thread drains all the buffers with large writev()s to the log file
+ *  - if a buffer is full, messages at or above [tools.async_logger] block_start_level
+ *    wait for the background thread, others are dropped and counted
+ *
+ * Messages at or above LOG_LEVEL_ERROR and flush() write out all the buffered messages
+ * synchronously, so nothing is lost before a crash.
+ *
+ * The messages of the fmt_logging macros (see dlog_f) are formatted by the background thread
+ * if [tools.async_logger] deferred_formatting is on: the logging thread only writes the header
+ * to its buffer, and queues the captured arguments to be formatted after the header.
+ */
+class async_logger : public logging_provider
+{
+public:
+    async_logger(const char *log_dir);
+    virtual ~async_logger(void);
+
+    virtual void dsn_logv(const char *file,
+                          const char *function,
+                          const int line,
+                          dsn_log_level_t log_level,
+                          const char *fmt,
+                          va_list args);
+
+    virtual void dsn_log(const char *file,
+                         const char *function,
+                         const int line,
+                         dsn_log_level_t log_level,
+                         const char *str);
+
+    virtual void dsn_log_deferred(const char *file,
+                                  const char *function,
+                                  const int line,
+                                  dsn_log_level_t log_level,
+                                  std::unique_ptr<deferred_log_message> msg);
+
+    virtual void flush();
+
+    // count of messages dropped because of full buffers
+    uint64_t dropped_count() const { return _dropped_count.load(); }
+
+public:
+    // single-producer (the logging thread)/single-consumer (holder of _write_lock) ring buffer
+    struct thread_buffer
+    {
+        explicit thread_buffer(size_t capacity);
+        ~thread_buffer();
+
+        char *data;
+        const size_t capacity; // power of 2
+        std::atomic<uint64_t> head; // written by producer
+        std::atomic<uint64_t> tail; // written by consumer
+        std::atomic<uint64_t> records;
+        std::atomic<bool> orphaned; // the producer thread has exited
+
+        // the deferred messages to be formatted at `pos` of the buffer, queued in the same way.
+        // an entry is pushed before its header, so the consumer sees it along with the header
+        struct deferred_entry
+        {
+            uint64_t pos;
+            deferred_log_message *msg;
+        };
+        deferred_entry *deferred;
+        const size_t deferred_capacity; // power of 2
+        std::atomic<uint64_t> deferred_head;
+        std::atomic<uint64_t> deferred_tail;
+    };
+
+private:
+    thread_buffer *get_thread_buffer();
+    // append a formatted message to the buffer of current thread, or the header of `deferred`
+    void append(dsn_log_level_t log_level,
+                const char *msg,
+                size_t len,
+                std::unique_ptr<deferred_log_message> deferred = nullptr);
+    // drain all the buffers to the log file, called with _write_lock held
+    void write_buffers();
+    void create_log_file();
+    void flusher_loop();
+
+private:
+    const uint64_t _id; // to distinguish buffers of different loggers in thread local storage
+    std::string _log_dir;
+    int _log_fd;
+    int _start_index;
+    int _index;
+    uint64_t _lines;
+    uint64_t _reported_dropped_count;
+    dsn_log_level_t _stderr_start_level;
+    dsn_log_level_t _block_start_level;
+    size_t _buffer_capacity;
+
+    // recursive to avoid dead lock when flush() is called in signal handler
+    ::dsn::utils::ex_lock _write_lock;
+
+    std::mutex _buffers_lock; // protect _buffers
+    std::vector<std::shared_ptr<thread_buffer>> _buffers;
+
+    std::atomic<uint64_t> _dropped_count;
+
+    std::mutex _flusher_lock;
+    std::condition_variable _flusher_cond;
+    bool _stopped;
+    std::thread _flusher;
+};
 }
 }
@@ -35,14 +35,307 @@
 
 #include <dsn/toollet/tracer.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/process_utils.h>
+#include <dsn/utility/string_conv.h>
+#include <dsn/utility/time_utils.h>
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/tool-api/aio_task.h>
 
+#include <fmt/format.h>
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+
 namespace dsn {
 namespace tools {
 
+DSN_DEFINE_uint32("tracer",
+                  tracer_sample_ratio,
+                  1,
+                  "1/N of the task flows are traced, chosen by the hash of the trace id of the rpc "
+                  "or the id of the task, 0 to trace none");
+DSN_TAG_VARIABLE(tracer_sample_ratio, FT_MUTABLE);
+
+DSN_DEFINE_bool("tracer",
+                tracer_output_to_ring,
+                false,
+                "whether to record the traced events into the in-memory ring buffer, which is "
+                "dumped by the remote commands tracer.dump and tracer.save, rather than log them");
+DSN_TAG_VARIABLE(tracer_output_to_ring, FT_MUTABLE);
+
+DSN_DEFINE_uint32("tracer",
+                  tracer_ring_buffer_events,
+                  65536,
+                  "the count of the latest events kept in the ring buffer of the tracer");
+
+enum trace_event_type : uint8_t
+{
+    TE_TASK_CREATE,
+    TE_TASK_ENQUEUE,
+    TE_TASK_BEGIN,
+    TE_TASK_END,
+    TE_TASK_CANCELLED,
+    TE_AIO_CALL,
+    TE_AIO_ENQUEUE,
+    TE_RPC_CALL,
+    TE_RPC_REQUEST_ENQUEUE,
+    TE_RPC_REPLY,
+    TE_RPC_RESPONSE_ENQUEUE,
+    TE_RPC_CREATE_RESPONSE,
+    TE_COUNT
+};
+
+static const char *trace_event_names[TE_COUNT] = {"CREATE",
+                                                  "ENQUEUE",
+                                                  "EXEC BEGIN",
+                                                  "EXEC END",
+                                                  "CANCELLED",
+                                                  "AIO.CALL",
+                                                  "AIO.ENQUEUE",
+                                                  "RPC.CALL",
+                                                  "RPC.REQUEST.ENQUEUE",
+                                                  "RPC.REPLY",
+                                                  "RPC.RESPONSE.ENQUEUE",
+                                                  "RPC.CREATE.RESPONSE"};
+
+// an event in the ring buffer, which is saved as is by tracer.save
+struct trace_event
+{
+    uint64_t ts_ns;
+    uint64_t task_id;  // 0 if not of a task, e.g. RPC.REPLY
+    uint64_t trace_id; // 0 if not of a rpc
+    uint64_t arg;      // the aio offset, or the callback task id of RPC.CALL
+    uint64_t from;     // rpc_address::value() of the rpc
+    uint64_t to;
+    int32_t code;  // task code, or rpc code
+    int32_t value; // queue size, delay ms, aio size, rpc timeout ms, or error code
+    int32_t tid;
+    uint8_t type; // trace_event_type
+    uint8_t padding[3];
+};
+static_assert(sizeof(trace_event) == 64, "trace_event is expected to be 64 bytes");
+
+// The events are written into the slots in turn without any lock. Each slot is guarded by a
+// sequence like a seqlock, so that the events being overwritten are skipped by the readers.
+class trace_ring
+{
+public:
+    explicit trace_ring(uint32_t capacity)
+    {
+        size_t size = 1;
+        while (size < std::max(capacity, 1U)) {
+            size <<= 1;
+        }
+        _slots.reset(new slot[size]);
+        _mask = size - 1;
+    }
+
+    static trace_ring &instance()
+    {
+        static trace_ring ring(FLAGS_tracer_ring_buffer_events);
+        return ring;
+    }
+
+    void record(const trace_event &e)
+    {
+        uint64_t index = _next.fetch_add(1, std::memory_order_relaxed);
+        slot &s = _slots[index & _mask];
+        s.seq.store(index * 2 + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s.event = e;
+        s.seq.store(index * 2 + 2, std::memory_order_release);
+    }
+
+    // the latest `max_count` events at most, in the order of being recorded
+    std::vector<trace_event> snapshot(size_t max_count) const
+    {
+        uint64_t end = _next.load(std::memory_order_acquire);
+        uint64_t count = std::min<uint64_t>({end, _mask + 1, max_count});
+        std::vector<trace_event> events;
+        events.reserve(count);
+        for (uint64_t index = end - count; index < end; ++index) {
+            const slot &s = _slots[index & _mask];
+            uint64_t seq = s.seq.load(std::memory_order_acquire);
+            trace_event e = s.event;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq == index * 2 + 2 && s.seq.load(std::memory_order_relaxed) == seq) {
+                events.push_back(e);
+            }
+        }
+        return events;
+    }
+
+private:
+    struct slot
+    {
+        std::atomic<uint64_t> seq{0};
+        trace_event event;
+    };
+    std::unique_ptr<slot[]> _slots;
+    size_t _mask;
+    std::atomic<uint64_t> _next{0};
+};
+
+// the events of a task flow are either all traced or none, which is identified by the trace id
+// of the rpc, or the id of the task
+static bool tracer_sampled(uint64_t flow_id)
+{
+    uint32_t ratio = FLAGS_tracer_sample_ratio;
+    if (ratio <= 1) {
+        return ratio == 1;
+    }
+    return ((flow_id * 0x9E3779B97F4A7C15ULL) >> 32) % ratio == 0;
+}
+
+static uint64_t tracer_trace_id(task *t)
+{
+    switch (t->spec().type) {
+    case dsn_task_type_t::TASK_TYPE_RPC_REQUEST:
+        return ((rpc_request_task *)t)->get_request()->header->trace_id;
+    case dsn_task_type_t::TASK_TYPE_RPC_RESPONSE:
+        return ((rpc_response_task *)t)->get_request()->header->trace_id;
+    default:
+        return 0;
+    }
+}
+
+static bool tracer_sampled(task *t)
+{
+    uint64_t trace_id = tracer_trace_id(t);
+    return tracer_sampled(trace_id != 0 ? trace_id : t->id());
+}
+
+static trace_event tracer_new_event(trace_event_type type, int code, uint64_t task_id)
+{
+    trace_event e;
+    memset(&e, 0, sizeof(e));
+    e.ts_ns = dsn_now_ns();
+    e.task_id = task_id;
+    e.code = code;
+    e.tid = utils::get_current_tid();
+    e.type = type;
+    return e;
+}
+
+static trace_event tracer_new_event(trace_event_type type, task *t)
+{
+    trace_event e = tracer_new_event(type, t->spec().code, t->id());
+    e.trace_id = tracer_trace_id(t);
+    return e;
+}
+
+static void tracer_record(const trace_event &e) { trace_ring::instance().record(e); }
+
+static std::string tracer_format_event(const trace_event &e)
+{
+    char time_buf[32];
+    utils::time_ms_to_string(e.ts_ns / 1000000, time_buf);
+    std::stringstream ss;
+    ss << time_buf << " " << e.tid << " " << dsn::task_code(e.code).to_string() << " "
+       << (e.type < TE_COUNT ? trace_event_names[e.type] : "UNKNOWN");
+    if (e.task_id != 0) {
+        ss << ", task_id = " << fmt::format("{:016x}", e.task_id);
+    }
+    if (e.trace_id != 0) {
+        ss << ", trace_id = " << fmt::format("{:016x}", e.trace_id);
+    }
+    if (e.from != 0 || e.to != 0) {
+        rpc_address from, to;
+        from.value() = e.from;
+        to.value() = e.to;
+        ss << ", " << from.to_string() << " => " << to.to_string();
+    }
+    switch (e.type) {
+    case TE_TASK_ENQUEUE:
+        ss << ", delay = " << e.value << " ms";
+        break;
+    case TE_TASK_END:
+        ss << ", err = " << error_code(e.value).to_string();
+        break;
+    case TE_AIO_CALL:
+        ss << ", offset = " << e.arg << ", size = " << e.value;
+        break;
+    case TE_AIO_ENQUEUE:
+    case TE_RPC_REQUEST_ENQUEUE:
+    case TE_RPC_RESPONSE_ENQUEUE:
+        ss << ", queue size = " << e.value;
+        break;
+    case TE_RPC_CALL:
+        ss << ", callback_task = " << fmt::format("{:016x}", e.arg) << ", timeout = " << e.value
+           << " ms";
+        break;
+    default:
+        break;
+    }
+    return ss.str();
+}
+
+// tracer.dump [count]
+static std::string tracer_dump(const std::vector<std::string> &args)
+{
+    uint32_t count = 100;
+    if (!args.empty() && !buf2uint32(args[0], count)) {
+        return "invalid arguments for tracer.dump: count must be a number";
+    }
+    std::stringstream ss;
+    for (const trace_event &e : trace_ring::instance().snapshot(count)) {
+        ss << tracer_format_event(e) << std::endl;
+    }
+    return ss.str();
+}
+
+// tracer.save <file>
+//
+// The file is:
+//   "DSNTRACE", uint32 version (1), uint32 sizeof(trace_event)
+//   uint32 code count, and for each code: uint32 name length, name
+//   uint64 event count, trace_event * count
+static std::string tracer_save(const std::vector<std::string> &args)
+{
+    if (args.size() != 1) {
+        return "invalid arguments for tracer.save: tracer.save <file>";
+    }
+    std::vector<trace_event> events = trace_ring::instance().snapshot(UINT64_MAX);
+
+    std::ofstream os(args[0], std::ios::binary | std::ios::trunc);
+    auto write = [&os](const void *data, size_t size) {
+        os.write(static_cast<const char *>(data), size);
+    };
+    uint32_t version = 1;
+    uint32_t event_size = sizeof(trace_event);
+    write("DSNTRACE", 8);
+    write(&version, sizeof(version));
+    write(&event_size, sizeof(event_size));
+    uint32_t code_count = static_cast<uint32_t>(dsn::task_code::max() + 1);
+    write(&code_count, sizeof(code_count));
+    for (uint32_t i = 0; i < code_count; ++i) {
+        const char *name = dsn::task_code(i).to_string();
+        uint32_t len = static_cast<uint32_t>(strlen(name));
+        write(&len, sizeof(len));
+        write(name, len);
+    }
+    uint64_t event_count = events.size();
+    write(&event_count, sizeof(event_count));
+    write(events.data(), events.size() * sizeof(trace_event));
+    os.close();
+    if (!os) {
+        return "failed to save the traced events to " + args[0];
+    }
+    return fmt::format("{} events are saved to {}", event_count, args[0]);
+}
+
 static void tracer_on_task_create(task *caller, task *callee)
 {
+    if (!tracer_sampled(callee)) {
+        return;
+    }
+    if (FLAGS_tracer_output_to_ring) {
+        tracer_record(tracer_new_event(TE_TASK_CREATE, callee));
+        return;
+    }
+
     dsn_task_type_t type = callee->spec().type;
     if (TASK_TYPE_RPC_REQUEST == type) {
         rpc_request_task *tsk = (rpc_request_task *)callee;
@@ -72,6 +365,16 @@ static void tracer_on_task_create(task *caller, task *callee)
 
 static void tracer_on_task_enqueue(task *caller, task *callee)
 {
+    if (!tracer_sampled(callee)) {
+        return;
+    }
+    if (FLAGS_tracer_output_to_ring) {
+        trace_event e = tracer_new_event(TE_TASK_ENQUEUE, callee);
+        e.value = callee->delay_milliseconds();
+        tracer_record(e);
+        return;
+    }
+
     ddebug("%s ENQUEUE, task_id = %016" PRIx64 ", delay = %d ms, queue size = %d",
            callee->spec().name.c_str(),
            callee->id(),
@@ -81,6 +384,24 @@ static void tracer_on_task_enqueue(task *caller, task *callee)
 
 static void tracer_on_task_begin(task *this_)
 {
+    if (!tracer_sampled(this_)) {
+        return;
+    }
+    if (FLAGS_tracer_output_to_ring) {
+        trace_event e = tracer_new_event(TE_TASK_BEGIN, this_);
+        if (this_->spec().type == dsn_task_type_t::TASK_TYPE_RPC_REQUEST) {
+            message_ex *req = ((rpc_request_task *)this_)->get_request();
+            e.from = req->header->from_address.value();
+            e.to = req->to_address.value();
+        } else if (this_->spec().type == dsn_task_type_t::TASK_TYPE_RPC_RESPONSE) {
+            message_ex *req = ((rpc_response_task *)this_)->get_request();
+            e.from = req->to_address.value();
+            e.to = req->header->from_address.value();
+        }
+        tracer_record(e);
+        return;
+    }
+
     switch (this_->spec().type) {
     case dsn_task_type_t::TASK_TYPE_COMPUTE:
     case dsn_task_type_t::TASK_TYPE_AIO:
@@ -111,6 +432,16 @@ static void tracer_on_task_begin(task *this_)
 
 static void tracer_on_task_end(task *this_)
 {
+    if (!tracer_sampled(this_)) {
+        return;
+    }
+    if (FLAGS_tracer_output_to_ring) {
+        trace_event e = tracer_new_event(TE_TASK_END, this_);
+        e.value = this_->error();
+        tracer_record(e);
+        return;
+    }
+
     ddebug("%s EXEC END, task_id = %016" PRIx64 ", err = %s",
            this_->spec().name.c_str(),
            this_->id(),
@@ -119,6 +450,14 @@ static void tracer_on_task_end(task *this_)
 
 static void tracer_on_task_cancelled(task *this_)
 {
+    if (!tracer_sampled(this_)) {
+        return;
+    }
+    if (FLAGS_tracer_output_to_ring) {
+        tracer_record(tracer_new_event(TE_TASK_CANCELLED, this_));
+        return;
+    }
+
     ddebug("%s CANCELLED, task_id = %016" PRIx64 "", this_->spec().name.c_str(), this_->id());
 }
 
@@ -131,6 +470,17 @@ static void tracer_on_task_cancel_post(task *caller, task *callee, bool succ) {}
 // return true means continue, otherwise early terminate with task::set_error_code
 static void tracer_on_aio_call(task *caller, aio_task *callee)
 {
+    if (!tracer_sampled(callee)) {
+        return;
+    }
+    if (FLAGS_tracer_output_to_ring) {
+        trace_event e = tracer_new_event(TE_AIO_CALL, callee);
+        e.arg = callee->get_aio_context()->file_offset;
+        e.value = static_cast<int32_t>(callee->get_aio_context()->buffer_size);
+        tracer_record(e);
+        return;
+    }
+
     ddebug("%s AIO.CALL, task_id = %016" PRIx64 ", offset = %" PRIu64 ", size = %d",
            callee->spec().name.c_str(),
            callee->id(),
@@ -140,6 +490,16 @@ static void tracer_on_aio_call(task *caller, aio_task *callee)
 
 static void tracer_on_aio_enqueue(aio_task *this_)
 {
+    if (!tracer_sampled(this_)) {
+        return;
+    }
+    if (FLAGS_tracer_output_to_ring) {
+        trace_event e = tracer_new_event(TE_AIO_ENQUEUE, this_);
+        e.value = tls_dsn.last_worker_queue_size;
+        tracer_record(e);
+        return;
+    }
+
     ddebug("%s AIO.ENQUEUE, task_id = %016" PRIx64 ", queue size = %d",
            this_->spec().name.c_str(),
            this_->id(),
@@ -150,6 +510,19 @@ static void tracer_on_aio_enqueue(aio_task *this_)
 static void tracer_on_rpc_call(task *caller, message_ex *req, rpc_response_task *callee)
 {
     message_header &hdr = *req->header;
+    if (!tracer_sampled(hdr.trace_id)) {
+        return;
+    }
+    if (FLAGS_tracer_output_to_ring) {
+        trace_event e = tracer_new_event(TE_RPC_CALL, req->local_rpc_code, 0);
+        e.trace_id = hdr.trace_id;
+        e.from = hdr.from_address.value();
+        e.to = req->to_address.value();
+        e.arg = callee ? callee->id() : 0;
+        e.value = hdr.client.timeout_ms;
+        tracer_record(e);
+        return;
+    }
     ddebug("%s RPC.CALL: %s => %s, trace_id = %016" PRIx64 ", callback_task = %016" PRIx64
            ", timeout = %d ms",
            hdr.rpc_name,
@@ -162,6 +535,18 @@ static void tracer_on_rpc_call(task *caller, message_ex *req, rpc_response_task
 
 static void tracer_on_rpc_request_enqueue(rpc_request_task *callee)
 {
+    if (!tracer_sampled(callee)) {
+        return;
+    }
+    if (FLAGS_tracer_output_to_ring) {
+        trace_event e = tracer_new_event(TE_RPC_REQUEST_ENQUEUE, callee);
+        e.from = callee->get_request()->header->from_address.value();
+        e.to = callee->get_request()->to_address.value();
+        e.value = tls_dsn.last_worker_queue_size;
+        tracer_record(e);
+        return;
+    }
+
     ddebug("%s RPC.REQUEST.ENQUEUE (0x%p), task_id = %016" PRIx64
            ", %s => %s, trace_id = %016" PRIx64 ", queue size = %d",
            callee->spec().name.c_str(),
@@ -177,6 +562,17 @@ static void tracer_on_rpc_request_enqueue(rpc_request_task *callee)
 static void tracer_on_rpc_reply(task *caller, message_ex *msg)
 {
     message_header &hdr = *msg->header;
+    if (!tracer_sampled(hdr.trace_id)) {
+        return;
+    }
+    if (FLAGS_tracer_output_to_ring) {
+        trace_event e = tracer_new_event(TE_RPC_REPLY, msg->local_rpc_code, 0);
+        e.trace_id = hdr.trace_id;
+        e.from = hdr.from_address.value();
+        e.to = msg->to_address.value();
+        tracer_record(e);
+        return;
+    }
 
     ddebug("%s RPC.REPLY: %s => %s, trace_id = %016" PRIx64 "",
            hdr.rpc_name,
@@ -187,6 +583,18 @@ static void tracer_on_rpc_reply(task *caller, message_ex *msg)
 
 static void tracer_on_rpc_response_enqueue(rpc_response_task *resp)
 {
+    if (!tracer_sampled(resp)) {
+        return;
+    }
+    if (FLAGS_tracer_output_to_ring) {
+        trace_event e = tracer_new_event(TE_RPC_RESPONSE_ENQUEUE, resp);
+        e.from = resp->get_request()->to_address.value();
+        e.to = resp->get_request()->header->from_address.value();
+        e.value = tls_dsn.last_worker_queue_size;
+        tracer_record(e);
+        return;
+    }
+
     ddebug("%s RPC.RESPONSE.ENQUEUE, task_id = %016" PRIx64 ", %s => %s, trace_id = %016" PRIx64
            ", queue size = %d",
            resp->spec().name.c_str(),
@@ -199,6 +607,16 @@ static void tracer_on_rpc_response_enqueue(rpc_response_task *resp)
 
 static void tracer_on_rpc_create_response(message_ex *req, message_ex *resp)
 {
+    if (!tracer_sampled(resp->header->trace_id)) {
+        return;
+    }
+    if (FLAGS_tracer_output_to_ring) {
+        trace_event e = tracer_new_event(TE_RPC_CREATE_RESPONSE, resp->local_rpc_code, 0);
+        e.trace_id = resp->header->trace_id;
+        tracer_record(e);
+        return;
+    }
+
     ddebug("%s RPC.CREATE.RESPONSE, trace_id = %016" PRIx64 "",
            resp->header->rpc_name,
            resp->header->trace_id);
@@ -401,6 +819,18 @@ void tracer::install(service_spec &spec)
         "tracer.find forward|f|backward|b rpc|r|task|t trace_id|task_id(e.g., "
         "a023003920302390) log_file_name(log.xx.txt)",
         tracer_log_flow);
+
+    command_manager::instance().register_command(
+        {"tracer.dump"},
+        "tracer.dump - dump the latest events in the ring buffer of the tracer",
+        "tracer.dump [count(default 100)]",
+        tracer_dump);
+
+    command_manager::instance().register_command(
+        {"tracer.save"},
+        "tracer.save - save the events in the ring buffer of the tracer to a binary file",
+        "tracer.save <file>",
+        tracer_save);
 }
 
 tracer::tracer(const char *name) : toollet(name) {}
@@ -37,6 +37,7 @@
 #include "scheduler.h"
 
 #include <dsn/utility/rand.h>
+#include <cstdlib>
 
 namespace dsn {
 namespace tools {
@@ -59,6 +60,12 @@ sim_env_provider::sim_env_provider(env_provider *inner_provider) : env_provider(
                                          "random_seed",
                                          0,
                                          "random seed for the simulator, 0 for random random seed");
+    // the seed can be overridden by the environment, so that a case can be run with many seeds,
+    // see src/dist/replication/test/simple_kv/run_seeds.sh
+    const char *seed_env = getenv("DSN_SIMULATOR_RANDOM_SEED");
+    if (seed_env != nullptr && seed_env[0] != '\0') {
+        _seed = atoi(seed_env);
+    }
     if (_seed == 0) {
         _seed = std::random_device{}();
     }
@@ -44,61 +44,95 @@
 namespace dsn {
 namespace tools {
 
-void event_wheel::add_event(uint64_t ts, task *t)
+event_wheel::event_wheel() : _buckets(BUCKET_COUNT), _count(0), _last_ts(0) {}
+
+std::vector<event_entry> *event_wheel::get_events(uint64_t ts)
 {
-    utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
+    // the events are mostly later than the others in the bucket, so search from the back
+    bucket &b = _buckets[bucket_index(ts)];
+    auto itr = b.end();
+    while (itr != b.begin() && std::prev(itr)->ts > ts) {
+        --itr;
+    }
+    if (itr != b.begin() && std::prev(itr)->ts == ts) {
+        return std::prev(itr)->events;
+    }
 
-    std::vector<event_entry> *evts;
-    auto itr = _events.find(ts);
-    if (itr != _events.end())
-        evts = itr->second;
-    else {
-        evts = new std::vector<event_entry>();
-        _events.insert(std::make_pair(ts, evts));
+    auto evts = new std::vector<event_entry>();
+    b.insert(itr, event_group{ts, evts});
+    _count++;
+    if (ts < _last_ts) {
+        _last_ts = ts;
     }
+    return evts;
+}
+
+void event_wheel::add_event(uint64_t ts, task *t)
+{
+    utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
 
     event_entry entry;
     entry.app_task = t;
-    evts->push_back(entry);
+    get_events(ts)->push_back(entry);
 }
 
 void event_wheel::add_system_event(uint64_t ts, std::function<void()> t)
 {
     utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
 
-    std::vector<event_entry> *evts;
-    auto itr = _events.find(ts);
-    if (itr != _events.end())
-        evts = itr->second;
-    else {
-        evts = new std::vector<event_entry>();
-        _events.insert(std::make_pair(ts, evts));
-    }
-
     event_entry entry;
     entry.system_task = std::move(t);
     entry.app_task = nullptr;
-    evts->push_back(entry);
+    get_events(ts)->push_back(std::move(entry));
 }
 
 std::vector<event_entry> *event_wheel::pop_next_events(/*out*/ uint64_t &ts)
 {
     utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
 
-    std::vector<event_entry> *evts = NULL;
-    auto itr = _events.begin();
-    if (itr != _events.end()) {
-        evts = itr->second;
-        ts = itr->first;
-        _events.erase(itr);
+    if (_count == 0) {
+        return nullptr;
+    }
+
+    // scan the buckets of the current year from _last_ts
+    bucket *next = nullptr;
+    uint64_t start = _last_ts / BUCKET_WIDTH_NS;
+    for (uint64_t i = 0; i < BUCKET_COUNT; i++) {
+        bucket &b = _buckets[bucket_index((start + i) * BUCKET_WIDTH_NS)];
+        if (!b.empty() && b.front().ts < (start + i + 1) * BUCKET_WIDTH_NS) {
+            next = &b;
+            break;
+        }
     }
+
+    // all the events are in the later years, which is rare, so find the earliest directly
+    if (next == nullptr) {
+        for (bucket &b : _buckets) {
+            if (!b.empty() && (next == nullptr || b.front().ts < next->front().ts)) {
+                next = &b;
+            }
+        }
+    }
+
+    std::vector<event_entry> *evts = next->front().events;
+    ts = next->front().ts;
+    next->pop_front();
+    _count--;
+    _last_ts = ts;
     return evts;
 }
 
 void event_wheel::clear()
 {
     utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
-    _events.clear();
+    for (bucket &b : _buckets) {
+        for (event_group &g : b) {
+            delete g.events;
+        }
+        b.clear();
+    }
+    _count = 0;
+    _last_ts = 0;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////
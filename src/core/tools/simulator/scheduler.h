@@ -38,6 +38,7 @@
 #include <dsn/tool_api.h>
 #include <dsn/tool/simulator.h>
 #include <dsn/utility/synchronize.h>
+#include <deque>
 
 namespace dsn {
 namespace tools {
@@ -48,9 +49,17 @@ struct event_entry
     std::function<void()> system_task;
 };
 
+// event_wheel is a calendar queue of the timed events, which are grouped by their timestamps.
+//
+// the timestamps are hashed into BUCKET_COUNT buckets of BUCKET_WIDTH_NS each, and the groups in
+// a bucket are sorted by timestamp. as the delays of the tasks are in milliseconds, and most of
+// them are less than a "year" of BUCKET_COUNT buckets, both adding and popping the events are
+// O(1) on average, rather than O(log n) of a sorted map. the groups with the same timestamp are
+// popped in the order they are created, so the schedule is still determined by the random seed.
 class event_wheel
 {
 public:
+    event_wheel();
     ~event_wheel() { clear(); }
 
     void add_event(uint64_t ts, task *t);
@@ -60,12 +69,31 @@ public:
     bool has_more_events() const
     {
         utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
-        return _events.size() > 0;
+        return _count > 0;
     }
 
 private:
-    typedef std::map<uint64_t, std::vector<event_entry> *> Events;
-    Events _events;
+    static const uint64_t BUCKET_WIDTH_NS = 1000000;
+    static const size_t BUCKET_COUNT = 1024; // must be a power of 2
+
+    struct event_group
+    {
+        uint64_t ts;
+        std::vector<event_entry> *events;
+    };
+    typedef std::deque<event_group> bucket;
+
+    static size_t bucket_index(uint64_t ts)
+    {
+        return static_cast<size_t>(ts / BUCKET_WIDTH_NS) & (BUCKET_COUNT - 1);
+    }
+
+    // the events at `ts`, which are created if not exist
+    std::vector<event_entry> *get_events(uint64_t ts);
+
+    std::vector<bucket> _buckets;
+    size_t _count;     // count of the event groups
+    uint64_t _last_ts; // no events are earlier than this
     mutable ::dsn::utils::ex_lock _lock;
 };
 
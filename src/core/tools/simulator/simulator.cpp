@@ -112,6 +112,9 @@ void simulator::install(service_spec &spec)
 
         if (tspec.queue_factory_name == "")
             tspec.queue_factory_name = ("dsn::tools::sim_task_queue");
+
+        // spinning on the physical clock makes no sense to the simulated workers
+        tspec.spin_wait_max_us = 0;
     }
 
     sys_exit.put_front(simulator::on_system_exit, "simulator");
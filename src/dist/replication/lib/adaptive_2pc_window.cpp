@@ -0,0 +1,98 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "adaptive_2pc_window.h"
+
+#include <dsn/utility/flags.h>
+#include <algorithm>
+#include <cmath>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                adaptive_2pc_window_enabled,
+                false,
+                "whether the count of the mutations a primary prepares concurrently is adapted "
+                "to the commit latency, rather than fixed at staleness_for_commit");
+DSN_DEFINE_uint32("replication",
+                  adaptive_2pc_window_min,
+                  1,
+                  "min count of the mutations a primary prepares concurrently if "
+                  "adaptive_2pc_window_enabled is set");
+DSN_DEFINE_uint32("replication",
+                  adaptive_2pc_latency_tolerance_percent,
+                  50,
+                  "the adaptive 2pc window shrinks once the commit latency is higher than the "
+                  "lowest one recently seen by more than this percentage");
+
+namespace {
+// count of the commits in an epoch of the lowest latency
+const int EPOCH_COMMITS = 1024;
+} // anonymous namespace
+
+adaptive_2pc_window::adaptive_2pc_window(int max_window)
+    : _max_window(std::max(max_window, 1)),
+      _window(_max_window),
+      // as if a window of commits has passed, so that it may shrink at once
+      _commits(_max_window),
+      _smoothed_latency_ns(0),
+      _epoch_commits(0),
+      _epoch_min_latency_ns(UINT64_MAX),
+      _last_epoch_min_latency_ns(UINT64_MAX)
+{
+}
+
+void adaptive_2pc_window::on_committed(uint64_t latency_ns, bool full)
+{
+    _smoothed_latency_ns = _smoothed_latency_ns == 0
+                               ? latency_ns
+                               : (_smoothed_latency_ns * 7 + latency_ns) / 8;
+    _epoch_min_latency_ns = std::min(_epoch_min_latency_ns, latency_ns);
+    if (++_epoch_commits == EPOCH_COMMITS) {
+        _last_epoch_min_latency_ns = _epoch_min_latency_ns;
+        _epoch_min_latency_ns = UINT64_MAX;
+        _epoch_commits = 0;
+    }
+    ++_commits;
+
+    uint64_t tolerated_ns =
+        min_latency_ns() * (100 + FLAGS_adaptive_2pc_latency_tolerance_percent) / 100;
+    if (_smoothed_latency_ns > tolerated_ns) {
+        // the effect of the last change shows after a window of commits
+        if (_commits >= window()) {
+            shrink(0.75);
+        }
+    } else if (full && _window < _max_window) {
+        int old_window = window();
+        _window = std::min(_window + 1.0 / old_window, static_cast<double>(_max_window));
+        if (window() != old_window) {
+            _commits = 0;
+        }
+    }
+}
+
+void adaptive_2pc_window::on_secondary_busy()
+{
+    // the prepares in flight may all be retried
+    if (_commits >= window()) {
+        shrink(0.5);
+    }
+}
+
+void adaptive_2pc_window::shrink(double ratio)
+{
+    int min_window = std::min(static_cast<int>(std::max(FLAGS_adaptive_2pc_window_min, 1u)),
+                              _max_window);
+    _window = std::max(std::floor(_window * ratio), static_cast<double>(min_window));
+    _commits = 0;
+}
+
+uint64_t adaptive_2pc_window::min_latency_ns() const
+{
+    return std::min(_epoch_min_latency_ns, _last_epoch_min_latency_ns);
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,63 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <stdint.h>
+
+namespace dsn {
+namespace replication {
+
+// adaptive_2pc_window decides how many mutations a primary prepares concurrently, between
+// [replication] adaptive_2pc_window_min and staleness_for_commit, if
+// [replication] adaptive_2pc_window_enabled is set.
+//
+// It compares the smoothed commit latency of the mutations, from being prepared to being acked
+// by all the secondaries, with the lowest one recently seen:
+//  - while the latency stays within adaptive_2pc_latency_tolerance_percent of the lowest one,
+//    the window grows by one for each window of commits, as long as it is full
+//  - once the latency rises over it, e.g. the secondaries lag, the window shrinks by 1/4, at
+//    most once for each window of commits
+//  - when a secondary asks to retry a prepare for being busy, the window is halved, also at
+//    most once for each window of commits
+// The writes over the window wait in the queue, and are coalesced into larger mutations.
+//
+// not thread safe
+class adaptive_2pc_window
+{
+public:
+    explicit adaptive_2pc_window(int max_window);
+
+    // the count of the mutations allowed to be prepared concurrently
+    int window() const { return static_cast<int>(_window); }
+
+    // a mutation is committed `latency_ns` after being prepared, `full` is whether any write
+    // has waited for the window since the last commit
+    void on_committed(uint64_t latency_ns, bool full);
+
+    // a secondary asks to retry a prepare for being busy
+    void on_secondary_busy();
+
+    // the smoothed commit latency
+    uint64_t latency_ns() const { return _smoothed_latency_ns; }
+
+private:
+    void shrink(double ratio);
+    uint64_t min_latency_ns() const;
+
+    const int _max_window;
+    double _window;
+    // the commits since the window is changed
+    int _commits;
+
+    uint64_t _smoothed_latency_ns;
+    // the lowest latency is that of this epoch and the last one, so that it follows the changes
+    // of the environment, e.g. the secondaries are moved to slower nodes
+    int _epoch_commits;
+    uint64_t _epoch_min_latency_ns;
+    uint64_t _last_epoch_min_latency_ns;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,192 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "app_counters.h"
+
+#include <algorithm>
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+#include <dsn/perf_counter/perf_counters.h>
+#include <dsn/tool-api/task.h>
+
+namespace dsn {
+namespace replication {
+
+// a read-only counter whose value is computed from the shards of an app when it's read
+class app_counters::aggregated_counter : public perf_counter
+{
+public:
+    aggregated_counter(const char *app,
+                       const char *name,
+                       app_counter_type type,
+                       const ref_ptr<app_state> &state)
+        : perf_counter(app, "eon.app", name, counter_type_of(type), name),
+          _type(type),
+          _state(state)
+    {
+    }
+
+    void increment() override { dassert(false, "app counter %s is read-only", full_name()); }
+    void decrement() override { dassert(false, "app counter %s is read-only", full_name()); }
+    void add(int64_t val) override { dassert(false, "app counter %s is read-only", full_name()); }
+    void set(int64_t val) override { dassert(false, "app counter %s is read-only", full_name()); }
+
+    double get_value() override { return static_cast<double>(get_integer_value()); }
+
+    int64_t get_integer_value() override
+    {
+        std::lock_guard<std::mutex> l(_state->lock);
+        int64_t total = _state->total(_type);
+        if (type() != COUNTER_TYPE_VOLATILE_NUMBER) {
+            return total;
+        }
+        int64_t delta = total - _state->reported[_type];
+        _state->reported[_type] = total;
+        return delta;
+    }
+
+    double get_percentile(dsn_perf_counter_percentile_type_t type) override
+    {
+        dassert(false, "app counter %s has no percentile", full_name());
+        return 0.0;
+    }
+
+private:
+    app_counter_type _type;
+    ref_ptr<app_state> _state;
+};
+
+int64_t app_counters::app_state::total(app_counter_type type) const
+{
+    int64_t total = retired[type];
+    for (const auto &s : shards) {
+        total += s.second->get(type);
+    }
+    return total;
+}
+
+/*static*/ const char *app_counters::name_of(app_counter_type type)
+{
+    switch (type) {
+    case APP_COUNTER_PRIVATE_LOG_SIZE_MB:
+        return "private.log.size(MB)";
+    case APP_COUNTER_WRITE_THROTTLING_DELAY_COUNT:
+        return "recent.write.throttling.delay.count";
+    case APP_COUNTER_WRITE_THROTTLING_REJECT_COUNT:
+        return "recent.write.throttling.reject.count";
+    case APP_COUNTER_WRITE_BACKPRESSURE_DELAY_COUNT:
+        return "recent.write.backpressure.delay.count";
+    default:
+        dassert(false, "invalid app counter type %d", type);
+        return nullptr;
+    }
+}
+
+/*static*/ dsn_perf_counter_type_t app_counters::counter_type_of(app_counter_type type)
+{
+    // the private log size is a gauge, whose detached replicas are not counted
+    return type == APP_COUNTER_PRIVATE_LOG_SIZE_MB ? COUNTER_TYPE_NUMBER
+                                                   : COUNTER_TYPE_VOLATILE_NUMBER;
+}
+
+app_counters::~app_counters()
+{
+    std::lock_guard<std::mutex> l(_lock);
+    for (auto &kv : _apps) {
+        remove_counters(kv.second);
+    }
+    _apps.clear();
+}
+
+void app_counters::attach(gpid pid, app_counter_shard *shard)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    app_entry &entry = _apps[pid.get_app_id()];
+    if (entry.state == nullptr) {
+        entry.state = new app_state();
+        for (int i = 0; i < APP_COUNTER_COUNT; ++i) {
+            auto type = static_cast<app_counter_type>(i);
+            std::string name = fmt::format("{}@{}", name_of(type), pid.get_app_id());
+            perf_counter_ptr c = perf_counters::instance().add_counter(new aggregated_counter(
+                task::get_current_node_name(), name.c_str(), type, entry.state));
+            entry.counter_names.emplace_back(c->full_name());
+        }
+    }
+
+    std::lock_guard<std::mutex> sl(entry.state->lock);
+    entry.state->shards.emplace_back(pid, shard);
+}
+
+void app_counters::detach(gpid pid, app_counter_shard *shard)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    auto it = _apps.find(pid.get_app_id());
+    if (it == _apps.end()) {
+        return;
+    }
+
+    app_state &state = *it->second.state;
+    {
+        std::lock_guard<std::mutex> sl(state.lock);
+        auto s = std::find(state.shards.begin(), state.shards.end(), std::make_pair(pid, shard));
+        if (s == state.shards.end()) {
+            return;
+        }
+        for (int i = 0; i < APP_COUNTER_COUNT; ++i) {
+            auto type = static_cast<app_counter_type>(i);
+            if (counter_type_of(type) == COUNTER_TYPE_VOLATILE_NUMBER) {
+                state.retired[type] += shard->get(type);
+            }
+        }
+        state.shards.erase(s);
+        if (!state.shards.empty()) {
+            return;
+        }
+    }
+
+    remove_counters(it->second);
+    _apps.erase(it);
+}
+
+void app_counters::remove_counters(app_entry &entry)
+{
+    for (const std::string &name : entry.counter_names) {
+        perf_counters::instance().remove_counter(name.c_str());
+    }
+    entry.counter_names.clear();
+}
+
+std::string app_counters::to_json(int32_t app_id) const
+{
+    nlohmann::json json = nlohmann::json::object();
+    std::lock_guard<std::mutex> l(_lock);
+    for (const auto &kv : _apps) {
+        if (app_id >= 0 && kv.first != app_id) {
+            continue;
+        }
+
+        const app_state &state = *kv.second.state;
+        std::lock_guard<std::mutex> sl(state.lock);
+        nlohmann::json app;
+        nlohmann::json replicas = nlohmann::json::object();
+        for (int i = 0; i < APP_COUNTER_COUNT; ++i) {
+            auto type = static_cast<app_counter_type>(i);
+            app[name_of(type)] = state.total(type);
+        }
+        for (const auto &s : state.shards) {
+            nlohmann::json replica;
+            for (int i = 0; i < APP_COUNTER_COUNT; ++i) {
+                auto type = static_cast<app_counter_type>(i);
+                replica[name_of(type)] = s.second->get(type);
+            }
+            replicas[s.first.to_string()] = std::move(replica);
+        }
+        json[std::to_string(kv.first)] = nlohmann::json{{"app", app}, {"replicas", replicas}};
+    }
+    return json.dump();
+}
+
+} // namespace replication
+} // namespace dsn
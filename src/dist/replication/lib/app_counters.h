@@ -0,0 +1,105 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <dsn/perf_counter/perf_counter.h>
+#include <dsn/tool-api/gpid.h>
+#include <dsn/utility/autoref_ptr.h>
+
+namespace dsn {
+namespace replication {
+
+// the metrics of the replicas which are aggregated by app
+enum app_counter_type
+{
+    APP_COUNTER_PRIVATE_LOG_SIZE_MB,
+    APP_COUNTER_WRITE_THROTTLING_DELAY_COUNT,
+    APP_COUNTER_WRITE_THROTTLING_REJECT_COUNT,
+    APP_COUNTER_WRITE_BACKPRESSURE_DELAY_COUNT,
+    APP_COUNTER_COUNT
+};
+
+// The app counter values of a replica, which are only written by the replica and merged into
+// its app when the counters of the app are read. The counts are cumulative, so that they can
+// be sampled on demand without disturbing the aggregation.
+class app_counter_shard
+{
+public:
+    void increment(app_counter_type type) { _values[type].fetch_add(1, std::memory_order_relaxed); }
+    void set(app_counter_type type, int64_t value)
+    {
+        _values[type].store(value, std::memory_order_relaxed);
+    }
+    int64_t get(app_counter_type type) const
+    {
+        return _values[type].load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int64_t> _values[APP_COUNTER_COUNT]{};
+};
+
+///
+/// app_counters registers the counters of each app on this node, named
+/// "eon.app*<metric>@<app_id>", which are computed from the shards of the replicas of the app
+/// each time they are read. With them the collectors scrape O(apps) rather than O(partitions)
+/// series, and the counters of the replicas are only needed for debugging, see
+/// [replication] replica_level_counters_enabled.
+///
+class app_counters
+{
+public:
+    ~app_counters();
+
+    // the counters of the app are registered when its first replica is attached, and removed
+    // when its last replica is detached
+    void attach(gpid pid, app_counter_shard *shard);
+    void detach(gpid pid, app_counter_shard *shard);
+
+    // the values of the app counters and of the replicas of the apps, in json; all the apps
+    // are included if app_id < 0
+    std::string to_json(int32_t app_id) const;
+
+    static const char *name_of(app_counter_type type);
+    static dsn_perf_counter_type_t counter_type_of(app_counter_type type);
+
+private:
+    class aggregated_counter;
+
+    // the replicas of an app, shared with its counters which may outlive it in the snapshots
+    struct app_state : public ref_counter
+    {
+        mutable std::mutex lock;
+        // a replica may be reopened before its old instance is released, so a pid may have
+        // more than one shard
+        std::vector<std::pair<gpid, app_counter_shard *>> shards;
+        // the counts of the detached replicas
+        int64_t retired[APP_COUNTER_COUNT]{};
+        // the counts last returned by the volatile counters
+        int64_t reported[APP_COUNTER_COUNT]{};
+
+        int64_t total(app_counter_type type) const;
+    };
+
+    struct app_entry
+    {
+        ref_ptr<app_state> state;
+        std::vector<std::string> counter_names;
+    };
+
+    void remove_counters(app_entry &entry);
+
+    mutable std::mutex _lock;
+    std::map<int32_t, app_entry> _apps;
+};
+
+} // namespace replication
+} // namespace dsn
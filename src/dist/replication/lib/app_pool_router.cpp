@@ -0,0 +1,132 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "app_pool_router.h"
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/tool-api/gpid.h>
+#include <dsn/utility/string_conv.h>
+#include <dsn/utility/strings.h>
+
+#include <algorithm>
+
+namespace dsn {
+namespace replication {
+
+const std::string app_pool_router::DEFAULT_GROUP("default");
+
+/*static*/ bool app_pool_router::parse_groups(const std::string &str,
+                                              /*out*/ std::map<std::string, uint32_t> &groups)
+{
+    groups.clear();
+    std::vector<std::string> items;
+    utils::split_args(str.c_str(), items, ',');
+    for (const std::string &item : items) {
+        std::vector<std::string> kv;
+        utils::split_args(item.c_str(), kv, ':');
+        uint32_t weight = 0;
+        if (kv.size() != 2 || kv[0].empty() || !buf2uint32(kv[1], weight) || weight == 0 ||
+            !groups.emplace(kv[0], weight).second) {
+            return false;
+        }
+    }
+    if (groups.empty()) {
+        return false;
+    }
+    groups.emplace(DEFAULT_GROUP, 1);
+    return true;
+}
+
+app_pool_router::app_pool_router(std::map<std::string, uint32_t> groups,
+                                 const std::map<int32_t, std::string> &app_groups)
+    : _weights(std::move(groups))
+{
+    std::map<std::string, uint32_t> indexes;
+    for (const auto &kv : _weights) {
+        indexes[kv.first] = static_cast<uint32_t>(_group_names.size());
+        _group_names.push_back(kv.first);
+    }
+    dassert(indexes.count(DEFAULT_GROUP) == 1, "the default group is missing");
+    _default_group = indexes[DEFAULT_GROUP];
+
+    for (const auto &kv : app_groups) {
+        auto it = indexes.find(kv.second);
+        if (kv.first < 0 || it == indexes.end()) {
+            dwarn_f("app({}) is put into the default group as the group \"{}\" is not found",
+                    kv.first,
+                    kv.second);
+            continue;
+        }
+        if (_app_groups.size() <= static_cast<size_t>(kv.first)) {
+            _app_groups.resize(kv.first + 1, _default_group);
+        }
+        _app_groups[kv.first] = it->second;
+    }
+}
+
+void app_pool_router::init(unsigned int queue_count)
+{
+    _ranges.assign(_group_names.size(), queue_range_t{0, queue_count});
+    if (queue_count < _group_names.size()) {
+        derror_f("the {} groups share all the {} queues as the queues are not enough",
+                 _group_names.size(),
+                 queue_count);
+        return;
+    }
+
+    // each group has one queue at least, and the others are divided by the weights, with the
+    // remainders given to the groups of the largest fractions
+    uint64_t total_weight = 0;
+    for (const std::string &name : _group_names) {
+        total_weight += _weights[name];
+    }
+    unsigned int spare = queue_count - static_cast<unsigned int>(_group_names.size());
+    unsigned int assigned = 0;
+    std::vector<std::pair<uint64_t, size_t>> fractions;
+    for (size_t i = 0; i < _group_names.size(); ++i) {
+        uint64_t share = static_cast<uint64_t>(spare) * _weights[_group_names[i]];
+        _ranges[i].count = 1 + static_cast<unsigned int>(share / total_weight);
+        assigned += _ranges[i].count;
+        fractions.emplace_back(share % total_weight, i);
+    }
+    std::sort(fractions.rbegin(), fractions.rend());
+    for (size_t i = 0; assigned < queue_count; ++i, ++assigned) {
+        _ranges[fractions[i].second].count++;
+    }
+
+    unsigned int begin = 0;
+    for (size_t i = 0; i < _ranges.size(); ++i) {
+        _ranges[i].begin = begin;
+        begin += _ranges[i].count;
+        ddebug_f("pool group \"{}\" has queues [{}, {}) of weight {}",
+                 _group_names[i],
+                 _ranges[i].begin,
+                 begin,
+                 _weights[_group_names[i]]);
+    }
+}
+
+unsigned int app_pool_router::route(int hash) const
+{
+    uint32_t group = _default_group;
+    if (hash >= 0) {
+        auto app_id = static_cast<size_t>(gpid::app_id_of_thread_hash(hash));
+        if (app_id < _app_groups.size()) {
+            group = _app_groups[app_id];
+        }
+    }
+    const queue_range_t &range = _ranges[group];
+    return range.begin + static_cast<unsigned int>(hash) % range.count;
+}
+
+std::pair<unsigned int, unsigned int> app_pool_router::queue_range(const std::string &group) const
+{
+    auto it = std::find(_group_names.begin(), _group_names.end(), group);
+    dassert(it != _group_names.end(), "group %s is not found", group.c_str());
+    const queue_range_t &range = _ranges[it - _group_names.begin()];
+    return std::make_pair(range.begin, range.begin + range.count);
+}
+
+} // namespace replication
+} // namespace dsn
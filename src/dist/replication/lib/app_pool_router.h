@@ -0,0 +1,63 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <dsn/tool-api/task_queue.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace dsn {
+namespace replication {
+
+// app_pool_router isolates the apps in THREAD_POOL_REPLICATION, so that the tasks of a heavy app
+// don't queue up before the ones of other apps on the same worker.
+//
+// The queues of the pool are divided into groups by their weights, the "default" group included.
+// An app is assigned to a group by the app env "replica.pool_group", and the apps without it
+// are in the default group. The partitions of an app are spread among the queues of its group
+// by their thread hashes.
+//
+// As a replica is bound to the thread which runs it first, the router is built only once when
+// the replica server starts, and then never changed. Both the assignment of a new app and the
+// change of the env take effect after the replica server restarts.
+class app_pool_router : public task_queue_router
+{
+public:
+    static const std::string DEFAULT_GROUP;
+
+    // parses the groups from "<name>:<weight>,...", returns false if it's invalid
+    static bool parse_groups(const std::string &str,
+                             /*out*/ std::map<std::string, uint32_t> &groups);
+
+    // `groups` is the weights of the groups, `app_groups` is the group names of the apps
+    app_pool_router(std::map<std::string, uint32_t> groups,
+                    const std::map<int32_t, std::string> &app_groups);
+
+    void init(unsigned int queue_count) override;
+
+    unsigned int route(int hash) const override;
+
+    // the [begin, end) of the queues of a group, for logging and testing
+    std::pair<unsigned int, unsigned int> queue_range(const std::string &group) const;
+
+private:
+    struct queue_range_t
+    {
+        unsigned int begin;
+        unsigned int count;
+    };
+
+    std::map<std::string, uint32_t> _weights;
+    // the index of the group of each app indexed by app id, the others are in the default group
+    std::vector<uint32_t> _app_groups;
+    std::vector<std::string> _group_names;
+    std::vector<queue_range_t> _ranges;
+    uint32_t _default_group;
+};
+
+} // namespace replication
+} // namespace dsn
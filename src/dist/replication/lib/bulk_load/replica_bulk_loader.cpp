@@ -405,12 +405,19 @@ error_code replica_bulk_loader::download_sst_files(const std::string &app_name,
         auto bulk_load_download_task = tasking::enqueue(
             LPC_BACKGROUND_BULK_LOAD, tracker(), [this, remote_dir, local_dir, f_meta, fs]() {
                 uint64_t f_size = 0;
+                std::string f_md5;
                 error_code ec = _stub->_block_service_manager.download_file(
-                    remote_dir, local_dir, f_meta.name, fs, f_size);
-                const std::string &file_name =
-                    utils::filesystem::path_combine(local_dir, f_meta.name);
+                    remote_dir, local_dir, f_meta.name, fs, f_size, f_md5);
+                // verify the file by the md5 computed while downloading, rather than reading it
+                // again
                 if (ec == ERR_OK &&
-                    !utils::filesystem::verify_file(file_name, f_meta.md5, f_meta.size)) {
+                    (f_size != static_cast<uint64_t>(f_meta.size) || f_md5 != f_meta.md5)) {
+                    derror_replica("file({}) is damaged, size: {} VS {}, md5: {} VS {}",
+                                   f_meta.name,
+                                   f_size,
+                                   f_meta.size,
+                                   f_md5,
+                                   f_meta.md5);
                     ec = ERR_CORRUPTION;
                 }
                 if (ec != ERR_OK) {
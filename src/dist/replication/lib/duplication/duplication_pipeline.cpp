@@ -4,6 +4,7 @@
 
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
 
 #include "dist/replication/lib/replica_stub.h"
 #include "duplication_pipeline.h"
@@ -12,6 +13,13 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  dup_max_inflight_batches,
+                  1,
+                  "the max count of the batches being shipped concurrently by the duplication of "
+                  "a partition, more than 1 requires the remote cluster to resolve the conflicts "
+                  "of the reordered writes, e.g. by timetag");
+
 //                     //
 // mutation_duplicator //
 //                     //
@@ -20,15 +28,24 @@ namespace replication {
     replica_base *, string_view /*remote cluster*/, string_view /*app*/)>
     mutation_duplicator::creator;
 
+DSN_DECLARE_bool(dup_load_from_memory);
+
 //               //
 // load_mutation //
 //               //
 
 void load_mutation::run()
 {
-    decree last_decree = _duplicator->progress().last_decree;
+    // load after the batches being shipped
+    decree last_decree =
+        std::max(_duplicator->progress().last_decree, _duplicator->_ship->last_inflight_decree());
     _start_decree = last_decree + 1;
-    if (_replica->private_log()->max_commit_on_disk() < _start_decree) {
+    decree max_loadable_decree = _replica->private_log()->max_commit_on_disk();
+    if (FLAGS_dup_load_from_memory) {
+        // the committed mutations not flushed yet can be loaded from memory
+        max_loadable_decree = std::max(max_loadable_decree, _replica->last_committed_decree());
+    }
+    if (max_loadable_decree < _start_decree) {
         // wait 100ms for next try if no mutation was added.
         repeat(100_ms);
         return;
@@ -64,6 +81,11 @@ void ship_mutation::run(decree &&last_decree, mutation_tuple_set &&in)
 {
     _last_decree = last_decree;
 
+    if (FLAGS_dup_max_inflight_batches > 1 || !_inflight_batches.empty()) {
+        ship_in_window(std::move(in));
+        return;
+    }
+
     if (in.empty()) {
         update_progress();
         step_down_next_stage();
@@ -73,6 +95,62 @@ void ship_mutation::run(decree &&last_decree, mutation_tuple_set &&in)
     ship(std::move(in));
 }
 
+void ship_mutation::ship_in_window(mutation_tuple_set &&in)
+{
+    if (in.empty()) {
+        // nothing to ship, it's confirmed right after the batches before it
+        _inflight_batches.push_back({_last_decree, true});
+        confirm_inflight_batches();
+        step_down_next_stage();
+        return;
+    }
+
+    mutation_duplicator *dup;
+    if (!_idle_duplicators.empty()) {
+        dup = _idle_duplicators.back();
+        _idle_duplicators.pop_back();
+    } else {
+        _extra_duplicators.emplace_back(new_mutation_duplicator(
+            _duplicator, _duplicator->remote_cluster_name(), _replica->get_app_info()->app_name));
+        dup = _extra_duplicators.back().get();
+        dup->set_task_environment(_duplicator);
+    }
+
+    // the elements of deque are never moved by push_back and pop_front
+    _inflight_batches.push_back({_last_decree, false});
+    inflight_batch *batch = &_inflight_batches.back();
+    dup->duplicate(std::move(in), [this, dup, batch](size_t total_shipped_size) mutable {
+        _counter_dup_shipped_bytes_rate->add(total_shipped_size);
+        batch->shipped = true;
+        _idle_duplicators.push_back(dup);
+        confirm_inflight_batches();
+        if (_window_full) {
+            _window_full = false;
+            step_down_next_stage();
+        }
+    });
+
+    // load the next batch while this one is being shipped
+    if (_inflight_batches.size() < FLAGS_dup_max_inflight_batches) {
+        step_down_next_stage();
+    } else {
+        _window_full = true;
+    }
+}
+
+void ship_mutation::confirm_inflight_batches()
+{
+    decree confirmed_decree = invalid_decree;
+    while (!_inflight_batches.empty() && _inflight_batches.front().shipped) {
+        confirmed_decree = _inflight_batches.front().last_decree;
+        _inflight_batches.pop_front();
+    }
+    if (confirmed_decree != invalid_decree) {
+        _last_decree = confirmed_decree;
+        update_progress();
+    }
+}
+
 void ship_mutation::update_progress()
 {
     dcheck_eq_replica(
@@ -93,6 +171,7 @@ ship_mutation::ship_mutation(replica_duplicator *duplicator)
     _mutation_duplicator = new_mutation_duplicator(
         duplicator, _duplicator->remote_cluster_name(), _replica->get_app_info()->app_name);
     _mutation_duplicator->set_task_environment(duplicator);
+    _idle_duplicators.push_back(_mutation_duplicator.get());
 
     _counter_dup_shipped_bytes_rate.init_app_counter("eon.replica_stub",
                                                      "dup.shipped_bytes_rate",
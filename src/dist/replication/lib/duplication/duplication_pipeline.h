@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <deque>
+
 #include <dsn/cpp/pipeline.h>
 #include <dsn/dist/replication/replica_base.h>
 #include <dsn/dist/replication/mutation_duplicator.h>
@@ -43,6 +45,13 @@ private:
 // ship_mutation is a pipeline stage receiving a set of mutations,
 // sending them to the remote cluster. After finished, the pipeline
 // will restart from load_mutation.
+//
+// If [replication] dup_max_inflight_batches > 1, the pipeline restarts from
+// load_mutation as soon as a batch is issued, as long as the count of the batches
+// being shipped is under the limit. Each in-flight batch is shipped by a dedicated
+// mutation_duplicator, which retries on its own until the batch is sent, so only
+// the failed batches are retried. The progress is confirmed in the order of the
+// decrees, i.e. a batch is confirmed only after all the batches before it.
 // ThreadPool: THREAD_POOL_REPLICATION
 class ship_mutation : public replica_base,
                       public pipeline::when<decree, mutation_tuple_set>,
@@ -57,9 +66,21 @@ public:
 
     void ship(mutation_tuple_set &&in);
 
+    // the max decree of the batches being shipped, or invalid_decree if there's none.
+    // the next batch should be loaded after it.
+    decree last_inflight_decree() const
+    {
+        return _inflight_batches.empty() ? invalid_decree : _inflight_batches.back().last_decree;
+    }
+
 private:
     void update_progress();
 
+    void ship_in_window(mutation_tuple_set &&in);
+
+    // confirm the progress of the shipped batches at the front of the window
+    void confirm_inflight_batches();
+
     friend struct ship_mutation_test;
     friend class replica_duplicator_test;
 
@@ -71,6 +92,19 @@ private:
 
     decree _last_decree{invalid_decree};
 
+    struct inflight_batch
+    {
+        decree last_decree;
+        bool shipped;
+    };
+    // in the order of decrees
+    std::deque<inflight_batch> _inflight_batches;
+    // the duplicators besides _mutation_duplicator, created on demand
+    std::vector<std::unique_ptr<mutation_duplicator>> _extra_duplicators;
+    std::vector<mutation_duplicator *> _idle_duplicators;
+    // whether the pipeline is held because the window is full
+    bool _window_full{false};
+
     perf_counter_wrapper _counter_dup_shipped_bytes_rate;
 };
 
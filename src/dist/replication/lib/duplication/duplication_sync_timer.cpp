@@ -11,6 +11,7 @@
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/utility/output_utils.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/string_conv.h>
 
 namespace dsn {
@@ -18,6 +19,27 @@ namespace replication {
 
 DEFINE_TASK_CODE(LPC_DUPLICATION_SYNC_TIMER, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
 
+DSN_DEFINE_uint32("replication",
+                  duplication_sync_min_interval_seconds,
+                  2,
+                  "the interval of duplication sync when the duplications on this server lag "
+                  "behind, see duplication_sync_lag_threshold");
+DSN_TAG_VARIABLE(duplication_sync_min_interval_seconds, FT_MUTABLE);
+
+DSN_DEFINE_uint32("replication",
+                  duplication_sync_max_interval_seconds,
+                  60,
+                  "the max interval of duplication sync, to which the interval grows when no "
+                  "confirm point advances and no duplication changes on this server");
+DSN_TAG_VARIABLE(duplication_sync_max_interval_seconds, FT_MUTABLE);
+
+DSN_DEFINE_uint64("replication",
+                  duplication_sync_lag_threshold,
+                  10000,
+                  "duplication sync runs in the min interval once the mutations pending to be "
+                  "duplicated on this server exceed this threshold");
+DSN_TAG_VARIABLE(duplication_sync_lag_threshold, FT_MUTABLE);
+
 void duplication_sync_timer::run()
 {
     // ensure duplication sync never be concurrent
@@ -31,6 +53,7 @@ void duplication_sync_timer::run()
         if (_stub->_state == replica_stub::NS_Disconnected) {
             ddebug_f("stop this round of duplication sync because this server is disconnected from "
                      "meta server");
+            schedule_next_round(true);
             return;
         }
     }
@@ -38,7 +61,8 @@ void duplication_sync_timer::run()
     auto req = make_unique<duplication_sync_request>();
     req->node = _stub->primary_address();
 
-    // collects confirm points from all primaries on this server
+    // collects confirm points from all primaries on this server, only the ones which advanced
+    // since they're confirmed by meta server are sent
     uint64_t pending_muts_cnt = 0;
     for (const replica_ptr &r : get_all_primaries()) {
         auto confirmed = r->get_duplication_manager()->get_duplication_confirms_to_update();
@@ -48,6 +72,8 @@ void duplication_sync_timer::run()
         pending_muts_cnt += r->get_duplication_manager()->get_pending_mutations_count();
     }
     _stub->_counter_dup_pending_mutations_count->set(pending_muts_cnt);
+    _confirms_sent = !req->confirm_list.empty();
+    _pending_mutations = pending_muts_cnt;
 
     duplication_sync_rpc rpc(std::move(req), RPC_CM_DUPLICATION_SYNC, 3_s);
     rpc_address meta_server_address(_stub->get_meta_server_address());
@@ -66,14 +92,47 @@ void duplication_sync_timer::on_duplication_sync_reply(error_code err,
     if (err == ERR_OK && resp.err != ERR_OK) {
         err = resp.err;
     }
+    bool active = true;
     if (err != ERR_OK) {
         derror_f("on_duplication_sync_reply: err({})", err.to_string());
     } else {
         update_duplication_map(resp.dup_map);
+        active = _confirms_sent || resp.dup_map != _last_dup_map;
+        _last_dup_map = resp.dup_map;
+    }
+
+    {
+        zauto_lock l(_lock);
+        _rpc_task = nullptr;
+    }
+    schedule_next_round(active);
+}
+
+void duplication_sync_timer::schedule_next_round(bool active)
+{
+    int max_interval =
+        std::max(static_cast<int>(FLAGS_duplication_sync_max_interval_seconds),
+                 DUPLICATION_SYNC_PERIOD_SECOND);
+    if (_pending_mutations > FLAGS_duplication_sync_lag_threshold) {
+        _interval_seconds =
+            std::max(1,
+                     std::min(static_cast<int>(FLAGS_duplication_sync_min_interval_seconds),
+                              DUPLICATION_SYNC_PERIOD_SECOND));
+    } else if (active) {
+        _interval_seconds = DUPLICATION_SYNC_PERIOD_SECOND;
+    } else {
+        _interval_seconds = std::min(_interval_seconds * 2, max_interval);
     }
 
     zauto_lock l(_lock);
-    _rpc_task = nullptr;
+    if (!_started) {
+        return;
+    }
+    _timer_task = tasking::enqueue(LPC_DUPLICATION_SYNC_TIMER,
+                                   &_stub->_tracker,
+                                   [this]() { run(); },
+                                   0,
+                                   _interval_seconds * 1_s);
 }
 
 void duplication_sync_timer::update_duplication_map(
@@ -127,30 +186,38 @@ void duplication_sync_timer::close()
 {
     ddebug("stop duplication sync");
 
+    task_ptr rpc_task;
+    task_ptr timer_task;
     {
         zauto_lock l(_lock);
-        if (_rpc_task) {
-            _rpc_task->cancel(true);
-            _rpc_task = nullptr;
-        }
+        _started = false;
+        rpc_task = std::move(_rpc_task);
+        timer_task = std::move(_timer_task);
     }
 
-    if (_timer_task) {
-        _timer_task->cancel(true);
-        _timer_task = nullptr;
+    // cancelled out of the lock, which the running callbacks may wait for
+    if (rpc_task) {
+        rpc_task->cancel(true);
+    }
+    if (timer_task) {
+        timer_task->cancel(true);
     }
 }
 
 void duplication_sync_timer::start()
 {
-    ddebug_f("run duplication sync periodically in {}s", DUPLICATION_SYNC_PERIOD_SECOND);
-
-    _timer_task = tasking::enqueue_timer(LPC_DUPLICATION_SYNC_TIMER,
-                                         &_stub->_tracker,
-                                         [this]() { run(); },
-                                         DUPLICATION_SYNC_PERIOD_SECOND * 1_s,
-                                         0,
-                                         DUPLICATION_SYNC_PERIOD_SECOND * 1_s);
+    ddebug_f("run duplication sync in {}s, which adapts to the duplications between {}s and {}s",
+             DUPLICATION_SYNC_PERIOD_SECOND,
+             FLAGS_duplication_sync_min_interval_seconds,
+             FLAGS_duplication_sync_max_interval_seconds);
+
+    zauto_lock l(_lock);
+    _started = true;
+    _timer_task = tasking::enqueue(LPC_DUPLICATION_SYNC_TIMER,
+                                   &_stub->_tracker,
+                                   [this]() { run(); },
+                                   0,
+                                   DUPLICATION_SYNC_PERIOD_SECOND * 1_s);
 }
 
 std::multimap<dupid_t, duplication_sync_timer::replica_dup_state>
@@ -53,6 +53,13 @@ private:
 
     void on_duplication_sync_reply(error_code err, const duplication_sync_response &resp);
 
+    // run the next round after the current interval, which is adapted to the duplications:
+    // - the min interval if the pending mutations on this server exceed the lag threshold,
+    //   so that the shipped mutations are confirmed sooner.
+    // - the normal interval if some confirm point advanced or the duplications changed.
+    // - otherwise the interval doubles, up to the max interval.
+    void schedule_next_round(bool active);
+
     std::vector<replica_ptr> get_all_primaries();
 
     std::vector<replica_ptr> get_all_replicas();
@@ -62,9 +69,17 @@ private:
 
     replica_stub *_stub{nullptr};
 
+    // the state of the current round, which decides the interval to the next one
+    bool _confirms_sent{false};
+    uint64_t _pending_mutations{0};
+    int _interval_seconds{DUPLICATION_SYNC_PERIOD_SECOND};
+    // the duplications responded by meta server last time
+    std::map<app_id, std::map<dupid_t, duplication_entry>> _last_dup_map;
+
+    bool _started{false};
     task_ptr _timer_task;
     task_ptr _rpc_task;
-    mutable zlock _lock; // protect _rpc_task
+    mutable zlock _lock; // protect _started, _timer_task and _rpc_task
 };
 
 } // namespace replication
@@ -3,6 +3,10 @@
 // can be found in the LICENSE file in the root directory of this source tree.
 
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/io_scheduler.h>
 
 #include "dist/replication/lib/replica_stub.h"
 #include "dist/replication/lib/replica.h"
@@ -13,6 +17,91 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                dup_load_from_memory,
+                true,
+                "load the mutations to duplicate from the prepare list if they are still kept in "
+                "memory, rather than from the private log");
+
+DSN_DEFINE_uint32("replication",
+                  dup_load_parallel_blocks,
+                  4,
+                  "the max number of private log blocks read in a round of duplication loading, "
+                  "which are decoded in parallel");
+DSN_TAG_VARIABLE(dup_load_parallel_blocks, FT_MUTABLE);
+DSN_DEFINE_validator(dup_load_parallel_blocks, [](uint32_t value) -> bool { return value > 0; });
+
+DEFINE_TASK_CODE(LPC_DUPLICATION_DECODE_LOG_BLOCK, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+namespace {
+
+struct log_block
+{
+    blob data;
+    int64_t data_offset = 0;
+
+    // set once decoded
+    std::vector<std::pair<int, mutation_ptr>> mutations; // log length, mutation
+    int64_t end_offset = 0;
+    error_s err = error_s::ok();
+};
+
+// Reads at most `max_blocks` blocks from `start_offset` of `log`, the error is returned
+// once no more block can be read.
+error_s read_log_blocks(log_file_ptr &log,
+                        size_t start_offset,
+                        uint32_t max_blocks,
+                        /*out*/ std::vector<log_block> &blocks)
+{
+    while (blocks.size() < max_blocks) {
+        if (!blocks.empty() && !blocks.back().data.buffer_ptr()) {
+            // the data may refer to the buffer of the log reader, which is reused by later reads
+            blob &data = blocks.back().data;
+            data = blob::create_from_bytes(data.data(), data.length());
+        }
+
+        log_block b;
+        int64_t end_offset = 0;
+        error_s err =
+            mutation_log::read_block(log, start_offset, b.data, b.data_offset, end_offset);
+        if (!err.is_ok()) {
+            return err;
+        }
+        start_offset = static_cast<size_t>(end_offset - log->start_offset());
+        blocks.push_back(std::move(b));
+    }
+    return error_s::ok();
+}
+
+void decode_log_block(log_block &b)
+{
+    mutation_log::replay_callback collect = [&b](int log_length, mutation_ptr &mu) {
+        b.mutations.emplace_back(log_length, std::move(mu));
+        return true;
+    };
+    b.err = mutation_log::decode_block(b.data, b.data_offset, collect, b.end_offset);
+}
+
+// The first block is decoded by the calling thread, while the others are decoded in the
+// shared pool concurrently.
+void decode_log_blocks(std::vector<log_block> &blocks)
+{
+    if (blocks.empty()) {
+        return;
+    }
+    task_tracker tracker;
+    for (size_t i = 1; i < blocks.size(); i++) {
+        tasking::enqueue(LPC_DUPLICATION_DECODE_LOG_BLOCK,
+                         &tracker,
+                         [&blocks, i]() { decode_log_block(blocks[i]); },
+                         static_cast<int>(i));
+    }
+    decode_log_block(blocks[0]);
+    tracker.wait_outstanding_tasks();
+}
+
+} // anonymous namespace
+
 /*static*/ constexpr int load_from_private_log::MAX_ALLOWED_BLOCK_REPEATS;
 /*static*/ constexpr int load_from_private_log::MAX_ALLOWED_FILE_REPEATS;
 
@@ -56,6 +145,18 @@ void load_from_private_log::run()
     dassert_replica(_start_decree != invalid_decree, "{}", _start_decree);
     _duplicator->verify_start_decree(_start_decree);
 
+    if (_io_delay_ms > 0) {
+        // the pipeline runs on the shared thread pool, so it is delayed rather than blocked
+        auto delay = std::chrono::milliseconds(_io_delay_ms);
+        _io_delay_ms = 0;
+        repeat(delay);
+        return;
+    }
+
+    if (FLAGS_dup_load_from_memory && load_from_memory()) {
+        return;
+    }
+
     if (_current == nullptr) {
         find_log_file_to_start();
         if (_current == nullptr) {
@@ -114,22 +215,38 @@ void load_from_private_log::find_log_file_to_start(std::map<int, log_file_ptr> l
         }
     }
     start_from_log_file(_current);
+    seek_to_start_decree();
 }
 
 void load_from_private_log::replay_log_block()
 {
-    error_s err =
-        mutation_log::replay_block(_current,
-                                   [this](int log_bytes_length, mutation_ptr &mu) -> bool {
-                                       auto es = _mutation_batch.add(std::move(mu));
-                                       dassert_replica(es.is_ok(), es.description());
-                                       _counter_dup_log_read_bytes_rate->add(log_bytes_length);
-                                       _counter_dup_log_read_mutations_rate->increment();
-                                       return true;
-                                   },
-                                   _start_offset,
-                                   _current_global_end_offset);
-    if (!err.is_ok()) {
+    // the blocks are read sequentially, as their crc is chained, but decoded in parallel
+    std::vector<log_block> blocks;
+    error_s err = read_log_blocks(_current, _start_offset, FLAGS_dup_load_parallel_blocks, blocks);
+    decode_log_blocks(blocks);
+
+    // the mutations are added in log order, until a block fails to be decoded
+    uint64_t read_bytes = 0;
+    size_t loaded_blocks = 0;
+    for (log_block &b : blocks) {
+        for (auto &m : b.mutations) {
+            auto es = _mutation_batch.add(std::move(m.second));
+            dassert_replica(es.is_ok(), es.description());
+            _counter_dup_log_read_bytes_rate->add(m.first);
+            _counter_dup_log_read_mutations_rate->increment();
+            read_bytes += m.first;
+        }
+        if (!b.err.is_ok()) {
+            err = b.err;
+            break;
+        }
+        _current_global_end_offset = b.end_offset;
+        loaded_blocks++;
+    }
+    _io_delay_ms =
+        io_scheduler::instance().reserve(io_class::DUPLICATION, _private_log->dir(), read_bytes);
+    // the error after the loaded blocks is met again in the next round
+    if (loaded_blocks == 0) {
         if (err.code() == ERR_HANDLE_EOF && switch_to_next_log_file()) {
             repeat();
             return;
@@ -186,8 +303,33 @@ void load_from_private_log::replay_log_block()
     step_down_next_stage(_mutation_batch.last_decree(), _mutation_batch.move_all_mutations());
 }
 
+bool load_from_private_log::load_from_memory()
+{
+    std::vector<mutation_ptr> mutations;
+    if (_replica->get_committed_mutations(_start_decree, mutations) == 0) {
+        // lagging behind, or nothing new
+        return false;
+    }
+
+    mutation_tuple_set loaded;
+    for (const mutation_ptr &mu : mutations) {
+        // the mutations are shared with the replica, the copy is consumed instead
+        mutation_ptr copy = mutation::copy_no_reply(mu);
+        add_mutation_if_valid(copy, loaded, _start_decree);
+    }
+    decree last_decree = mutations.back()->get_decree();
+    _counter_dup_memory_read_mutations_rate->add(mutations.size());
+
+    // the private log is read from wherever last_decree is in once it falls back
+    _current = nullptr;
+    _mutation_batch.reset(last_decree);
+    step_down_next_stage(last_decree, std::move(loaded));
+    return true;
+}
+
 load_from_private_log::load_from_private_log(replica *r, replica_duplicator *dup)
     : replica_base(r),
+      _replica(r),
       _private_log(r->private_log()),
       _duplicator(dup),
       _stub(r->get_replica_stub()),
@@ -202,6 +344,11 @@ load_from_private_log::load_from_private_log(replica *r, replica_duplicator *dup
         "dup.log_read_mutations_rate",
         COUNTER_TYPE_RATE,
         "reading rate of mutations from private log");
+    _counter_dup_memory_read_mutations_rate.init_app_counter(
+        "eon.replica_stub",
+        "dup.memory_read_mutations_rate",
+        COUNTER_TYPE_RATE,
+        "reading rate of mutations from the prepare list in memory");
     _counter_dup_load_file_failed_count.init_app_counter(
         "eon.replica_stub",
         "dup.load_file_failed_count",
@@ -230,5 +377,25 @@ void load_from_private_log::start_from_log_file(log_file_ptr f)
     _err_block_repeats_num = 0;
 }
 
+void load_from_private_log::seek_to_start_decree()
+{
+    // the file is reopened for reading, while the index is built in the one of the private log
+    auto file_map = _private_log->get_log_file_map();
+    auto it = file_map.find(_current->index());
+    int64_t offset = 0;
+    uint32_t crc32 = 0;
+    if (it == file_map.end() || !it->second->find_block_before(_start_decree, offset, crc32)) {
+        return;
+    }
+
+    ddebug_replica("start loading from offset {} of log file {} for decree {}",
+                   offset,
+                   _current->path(),
+                   _start_decree);
+    _current->reset_stream(static_cast<size_t>(offset), crc32);
+    _start_offset = static_cast<size_t>(offset);
+    _current_global_end_offset = _current->start_offset() + offset;
+}
+
 } // namespace replication
 } // namespace dsn
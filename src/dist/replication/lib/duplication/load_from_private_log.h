@@ -41,14 +41,25 @@ public:
     void find_log_file_to_start();
     void find_log_file_to_start(std::map<int, log_file_ptr> log_files);
 
+    // Reads at most `dup_load_parallel_blocks` blocks from the private log, which are decoded
+    // in parallel, and passes their mutations down in log order.
     void replay_log_block();
 
+    // Loads the committed mutations since _start_decree from the prepare list of the replica,
+    // which is possible only if the duplication isn't lagging behind.
+    // Returns false if it should fall back to replaying the private log.
+    bool load_from_memory();
+
     // Switches to the log file with index = current_log_index + 1.
     // Returns true if succeeds.
     bool switch_to_next_log_file();
 
     void start_from_log_file(log_file_ptr f);
 
+    // Starts reading `_current` near `_start_decree` rather than from the file start, through
+    // the sparse decree index of the file kept by the private log.
+    void seek_to_start_decree();
+
     bool will_fail_skip() const;
     bool will_fail_fast() const;
 
@@ -64,6 +75,7 @@ private:
     FRIEND_TEST(load_fail_mode_test, fail_slow);
     FRIEND_TEST(load_fail_mode_test, fail_skip_real_corrupted_file);
 
+    replica *_replica;
     mutation_log_ptr _private_log;
     replica_duplicator *_duplicator;
     replica_stub *_stub;
@@ -81,10 +93,14 @@ private:
 
     decree _start_decree{0};
 
+    // the delay required by io_scheduler for the bytes read in the last run
+    uint64_t _io_delay_ms{0};
+
     perf_counter_wrapper _counter_dup_load_file_failed_count;
     perf_counter_wrapper _counter_dup_load_skipped_bytes_count;
     perf_counter_wrapper _counter_dup_log_read_bytes_rate;
     perf_counter_wrapper _counter_dup_log_read_mutations_rate;
+    perf_counter_wrapper _counter_dup_memory_read_mutations_rate;
 
     std::chrono::milliseconds _repeat_delay{10_s};
 };
@@ -68,6 +68,12 @@ decree mutation_batch::last_decree() const { return _mutation_buffer->last_commi
 
 void mutation_batch::set_start_decree(decree d) { _start_decree = d; }
 
+void mutation_batch::reset(decree d)
+{
+    _mutation_buffer->reset(d);
+    _loaded_mutations.clear();
+}
+
 mutation_tuple_set mutation_batch::move_all_mutations()
 {
     // free the internal space
@@ -92,6 +98,46 @@ mutation_batch::mutation_batch(replica_duplicator *r) : replica_base(r)
     _mutation_buffer->reset(r->progress().confirmed_decree);
 }
 
+namespace {
+
+bool is_duplicatable_spec(task_code code)
+{
+    // ignore WRITE_EMPTY
+    if (code == RPC_REPLICATION_WRITE_EMPTY) {
+        return false;
+    }
+    // Ignore non-idempotent writes.
+    // Normally a duplicating replica will reply non-idempotent writes with
+    // ERR_OPERATION_DISABLED, but there could still be a mutation written
+    // before the duplication was added.
+    // To ignore means this write will be lost, which is acceptable under this rare case.
+    task_spec *spec = task_spec::get(code);
+    return spec != nullptr && spec->rpc_request_is_write_idempotent;
+}
+
+std::vector<bool> make_duplicatable_codes()
+{
+    std::vector<bool> codes(task_code::max() + 1);
+    for (int code = 0; code <= task_code::max(); code++) {
+        codes[code] = is_duplicatable_spec(task_code(code));
+    }
+    return codes;
+}
+
+} // anonymous namespace
+
+/*extern*/ bool is_duplicatable(task_code code)
+{
+    // the task codes are all registered on startup, so their specs are looked up once rather
+    // than for every update
+    static const std::vector<bool> codes = make_duplicatable_codes();
+    if (dsn_likely(static_cast<size_t>(code.code()) < codes.size())) {
+        return codes[code.code()];
+    }
+    // registered after the lookup
+    return is_duplicatable_spec(code);
+}
+
 /*extern*/ void
 add_mutation_if_valid(mutation_ptr &mu, mutation_tuple_set &mutations, decree start_decree)
 {
@@ -100,16 +146,7 @@ add_mutation_if_valid(mutation_ptr &mu, mutation_tuple_set &mutations, decree st
         return;
     }
     for (mutation_update &update : mu->data.updates) {
-        // ignore WRITE_EMPTY
-        if (update.code == RPC_REPLICATION_WRITE_EMPTY) {
-            continue;
-        }
-        // Ignore non-idempotent writes.
-        // Normally a duplicating replica will reply non-idempotent writes with
-        // ERR_OPERATION_DISABLED, but there could still be a mutation written
-        // before the duplication was added.
-        // To ignore means this write will be lost, which is acceptable under this rare case.
-        if (!task_spec::get(update.code)->rpc_request_is_write_idempotent) {
+        if (!is_duplicatable(update.code)) {
             continue;
         }
         blob bb;
@@ -54,6 +54,9 @@ public:
     // mutations with decree < d will be ignored.
     void set_start_decree(decree d);
 
+    // clear the buffered mutations, mutations with decree <= d will be ignored.
+    void reset(decree d);
+
     size_t size() const { return _loaded_mutations.size(); }
 
 private:
@@ -66,6 +69,10 @@ private:
 
 using mutation_batch_u_ptr = std::unique_ptr<mutation_batch>;
 
+/// Whether the updates of `code` are duplicated, which excludes WRITE_EMPTY and the
+/// non-idempotent writes.
+extern bool is_duplicatable(task_code code);
+
 /// Extract mutations into mutation_tuple_set if they are not WRITE_EMPTY.
 extern void add_mutation_if_valid(mutation_ptr &, mutation_tuple_set &, decree start_decree);
 
@@ -0,0 +1,420 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/dist/replication/mutation_duplicator.h>
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/endians.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/utils.h>
+
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#ifdef DSN_HAS_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                dup_compress_batch,
+                true,
+                "compress the batch of duplicated mutations by zstd if it's available");
+DSN_DEFINE_int32("replication",
+                 dup_compress_zstd_level,
+                 3,
+                 "compression level of zstd for the duplicated mutations");
+DSN_DEFINE_uint32("replication",
+                  dup_compress_dict_sample_bytes,
+                  1 << 20,
+                  "bytes of the mutations sampled per app to train the zstd dictionary, "
+                  "0 means no dictionary is used");
+DSN_DEFINE_uint32("replication",
+                  dup_compress_dict_size,
+                  64 << 10,
+                  "the max size of the zstd dictionary trained per app");
+
+namespace {
+
+// The payload is made up of:
+//   codec(u16) | dict id(u32) | inline dict length(u32) | raw body length(u32) |
+//   mutation count(u32) | inline dict | body
+// and each mutation in the raw body is:
+//   timestamp(u64) | task code name length(u16) | task code name |
+//   data length(u32) | data
+enum batch_codec : uint16_t
+{
+    BATCH_CODEC_NONE = 0,
+    BATCH_CODEC_ZSTD = 1,
+};
+
+template <typename T>
+void append_unsigned(std::string &out, T val)
+{
+    val = endian::hton(val);
+    out.append(reinterpret_cast<const char *>(&val), sizeof(val));
+}
+
+// Unlike data_input, it doesn't assert on the truncated data since
+// the payload comes from the remote.
+class payload_reader
+{
+public:
+    explicit payload_reader(string_view s) : _s(s) {}
+
+    template <typename T>
+    bool read(T &val)
+    {
+        if (_s.size() < sizeof(T)) {
+            return false;
+        }
+        memcpy(&val, _s.data(), sizeof(T));
+        val = endian::ntoh(val);
+        _s.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    bool read_bytes(size_t len, string_view &bytes)
+    {
+        if (_s.size() < len) {
+            return false;
+        }
+        bytes = _s.substr(0, len);
+        _s.remove_prefix(len);
+        return true;
+    }
+
+    string_view rest() const { return _s; }
+
+private:
+    string_view _s;
+};
+
+#ifdef DSN_HAS_ZSTD
+
+struct zstd_dictionary
+{
+    uint32_t id{0};
+    std::string bytes;
+    ZSTD_CDict *cdict{nullptr};
+
+    explicit zstd_dictionary(std::string &&dict) : bytes(std::move(dict))
+    {
+        id = ZDICT_getDictID(bytes.data(), bytes.size());
+        cdict = ZSTD_createCDict(bytes.data(), bytes.size(), FLAGS_dup_compress_zstd_level);
+    }
+
+    ~zstd_dictionary() { ZSTD_freeCDict(cdict); }
+};
+
+// Samples the mutations of an app and trains the dictionary
+// shared by all the encoders of the app.
+class app_dictionary
+{
+public:
+    explicit app_dictionary(std::string app_name) : _app_name(std::move(app_name)) {}
+
+    // Returns the trained dictionary, or nullptr if it's still sampling.
+    std::shared_ptr<const zstd_dictionary> sample(const mutation_tuple_set &mutations)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_dict != nullptr || _stopped) {
+            return _dict;
+        }
+        for (const mutation_tuple &mut : mutations) {
+            const blob &data = std::get<2>(mut);
+            _samples.append(data.data(), data.length());
+            _sample_sizes.push_back(data.length());
+            if (_samples.size() >= FLAGS_dup_compress_dict_sample_bytes) {
+                train();
+                break;
+            }
+        }
+        return _dict;
+    }
+
+private:
+    void train()
+    {
+        std::string dict(FLAGS_dup_compress_dict_size, '\0');
+        size_t r = ZDICT_trainFromBuffer(&dict[0],
+                                         dict.size(),
+                                         _samples.data(),
+                                         _sample_sizes.data(),
+                                         static_cast<unsigned>(_sample_sizes.size()));
+        if (ZDICT_isError(r)) {
+            // the mutations are compressed without dictionary from now on
+            dwarn_f("failed to train zstd dictionary for app({}) from {} mutations: {}",
+                    _app_name,
+                    _sample_sizes.size(),
+                    ZDICT_getErrorName(r));
+            _stopped = true;
+        } else {
+            dict.resize(r);
+            auto d = std::make_shared<zstd_dictionary>(std::move(dict));
+            if (d->id == 0 || d->cdict == nullptr) {
+                derror_f("invalid zstd dictionary trained for app({})", _app_name);
+                _stopped = true;
+            } else {
+                ddebug_f("zstd dictionary [id:{}, size:{}] is trained for app({})",
+                         d->id,
+                         d->bytes.size(),
+                         _app_name);
+                _dict = std::move(d);
+            }
+        }
+
+        // free the samples
+        std::string().swap(_samples);
+        std::vector<size_t>().swap(_sample_sizes);
+    }
+
+private:
+    const std::string _app_name;
+
+    std::mutex _lock;
+    std::string _samples;
+    std::vector<size_t> _sample_sizes;
+    std::shared_ptr<const zstd_dictionary> _dict;
+    bool _stopped{false};
+};
+
+std::shared_ptr<app_dictionary> get_app_dictionary(string_view app_name)
+{
+    static std::mutex lock;
+    static std::map<std::string, std::shared_ptr<app_dictionary>> dicts;
+
+    std::string name(app_name);
+    std::lock_guard<std::mutex> guard(lock);
+    auto &dict = dicts[name];
+    if (dict == nullptr) {
+        dict = std::make_shared<app_dictionary>(name);
+    }
+    return dict;
+}
+
+#endif // DSN_HAS_ZSTD
+
+} // anonymous namespace
+
+//                        //
+// mutation_batch_encoder //
+//                        //
+
+struct mutation_batch_encoder::context
+{
+#ifdef DSN_HAS_ZSTD
+    std::shared_ptr<app_dictionary> app_dict;
+    std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx{ZSTD_createCCtx(), ZSTD_freeCCtx};
+#endif
+};
+
+mutation_batch_encoder::mutation_batch_encoder(string_view app_name) : _ctx(new context)
+{
+#ifdef DSN_HAS_ZSTD
+    _ctx->app_dict = get_app_dictionary(app_name);
+#endif
+}
+
+mutation_batch_encoder::~mutation_batch_encoder() = default;
+
+blob mutation_batch_encoder::encode(const mutation_tuple_set &mutations)
+{
+    size_t raw_size = 0;
+    for (const mutation_tuple &mut : mutations) {
+        raw_size += sizeof(uint64_t) + sizeof(uint16_t) + strlen(std::get<1>(mut).to_string()) +
+                    sizeof(uint32_t) + std::get<2>(mut).length();
+    }
+
+    // task code is encoded by name, since its value varies between processes
+    std::string raw;
+    raw.reserve(raw_size);
+    for (const mutation_tuple &mut : mutations) {
+        const char *name = std::get<1>(mut).to_string();
+        const blob &data = std::get<2>(mut);
+        append_unsigned(raw, std::get<0>(mut));
+        append_unsigned(raw, static_cast<uint16_t>(strlen(name)));
+        raw.append(name);
+        append_unsigned(raw, static_cast<uint32_t>(data.length()));
+        raw.append(data.data(), data.length());
+    }
+
+    uint16_t codec = BATCH_CODEC_NONE;
+    uint32_t dict_id = 0;
+    std::string inline_dict;
+    std::string compressed;
+#ifdef DSN_HAS_ZSTD
+    if (FLAGS_dup_compress_batch && _ctx->cctx != nullptr) {
+        std::shared_ptr<const zstd_dictionary> dict;
+        if (FLAGS_dup_compress_dict_sample_bytes > 0) {
+            dict = _ctx->app_dict->sample(mutations);
+        }
+
+        compressed.resize(ZSTD_compressBound(raw.size()));
+        size_t r = dict != nullptr ? ZSTD_compress_usingCDict(_ctx->cctx.get(),
+                                                              &compressed[0],
+                                                              compressed.size(),
+                                                              raw.data(),
+                                                              raw.size(),
+                                                              dict->cdict)
+                                   : ZSTD_compressCCtx(_ctx->cctx.get(),
+                                                       &compressed[0],
+                                                       compressed.size(),
+                                                       raw.data(),
+                                                       raw.size(),
+                                                       FLAGS_dup_compress_zstd_level);
+        if (ZSTD_isError(r)) {
+            derror_f("failed to compress {} mutations: {}", mutations.size(), ZSTD_getErrorName(r));
+        } else if (r < raw.size()) {
+            compressed.resize(r);
+            codec = BATCH_CODEC_ZSTD;
+            if (dict != nullptr) {
+                dict_id = dict->id;
+                if (_shipped_dict_id != dict_id) {
+                    inline_dict = dict->bytes;
+                    _shipped_dict_id = dict_id;
+                }
+            }
+        }
+    }
+#endif
+    const std::string &body = (codec == BATCH_CODEC_NONE ? raw : compressed);
+
+    std::string payload;
+    payload.reserve(sizeof(uint16_t) + sizeof(uint32_t) * 4 + inline_dict.size() + body.size());
+    append_unsigned(payload, codec);
+    append_unsigned(payload, dict_id);
+    append_unsigned(payload, static_cast<uint32_t>(inline_dict.size()));
+    append_unsigned(payload, static_cast<uint32_t>(raw.size()));
+    append_unsigned(payload, static_cast<uint32_t>(mutations.size()));
+    payload.append(inline_dict);
+    payload.append(body);
+    return blob::create_from_bytes(std::move(payload));
+}
+
+//                        //
+// mutation_batch_decoder //
+//                        //
+
+struct mutation_batch_decoder::context
+{
+#ifdef DSN_HAS_ZSTD
+    typedef std::unique_ptr<ZSTD_DDict, decltype(&ZSTD_freeDDict)> ddict_ptr;
+
+    std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx{ZSTD_createDCtx(), ZSTD_freeDCtx};
+    std::map<uint32_t, ddict_ptr> ddicts;
+#endif
+};
+
+mutation_batch_decoder::mutation_batch_decoder() : _ctx(new context) {}
+
+mutation_batch_decoder::~mutation_batch_decoder() = default;
+
+error_s mutation_batch_decoder::decode(const blob &payload,
+                                       /*out*/ std::vector<mutation_tuple> &mutations)
+{
+    payload_reader reader(string_view(payload.data(), payload.length()));
+    uint16_t codec = 0;
+    uint32_t dict_id = 0, dict_len = 0, raw_size = 0, count = 0;
+    string_view dict;
+    if (!reader.read(codec) || !reader.read(dict_id) || !reader.read(dict_len) ||
+        !reader.read(raw_size) || !reader.read(count) || !reader.read_bytes(dict_len, dict)) {
+        return FMT_ERR(
+            ERR_INVALID_DATA, "truncated header of mutation batch [size:{}]", payload.length());
+    }
+    string_view body = reader.rest();
+
+    blob raw;
+    switch (codec) {
+    case BATCH_CODEC_NONE:
+        if (body.size() != raw_size) {
+            return FMT_ERR(ERR_INVALID_DATA,
+                           "mismatched body size of mutation batch [expected:{}, actual:{}]",
+                           raw_size,
+                           body.size());
+        }
+        raw = payload.range(static_cast<int>(payload.length() - body.size()));
+        break;
+#ifdef DSN_HAS_ZSTD
+    case BATCH_CODEC_ZSTD: {
+        const ZSTD_DDict *ddict = nullptr;
+        if (dict_id != 0) {
+            auto it = _ctx->ddicts.find(dict_id);
+            if (it == _ctx->ddicts.end()) {
+                if (dict.empty()) {
+                    return FMT_ERR(ERR_OBJECT_NOT_FOUND,
+                                   "unknown dictionary of mutation batch [id:{}]",
+                                   dict_id);
+                }
+                context::ddict_ptr d(ZSTD_createDDict(dict.data(), dict.size()), ZSTD_freeDDict);
+                if (d == nullptr || ZSTD_getDictID_fromDDict(d.get()) != dict_id) {
+                    return FMT_ERR(
+                        ERR_INVALID_DATA, "invalid dictionary of mutation batch [id:{}]", dict_id);
+                }
+                it = _ctx->ddicts.emplace(dict_id, std::move(d)).first;
+            }
+            ddict = it->second.get();
+        }
+
+        if (ZSTD_getFrameContentSize(body.data(), body.size()) != raw_size) {
+            return FMT_ERR(ERR_INVALID_DATA, "corrupted zstd frame of mutation batch");
+        }
+        std::shared_ptr<char> buffer(utils::make_shared_array<char>(raw_size));
+        ZSTD_DCtx *dctx = _ctx->dctx.get();
+        size_t r = ddict != nullptr
+                       ? ZSTD_decompress_usingDDict(
+                             dctx, buffer.get(), raw_size, body.data(), body.size(), ddict)
+                       : ZSTD_decompressDCtx(
+                             dctx, buffer.get(), raw_size, body.data(), body.size());
+        if (ZSTD_isError(r) || r != raw_size) {
+            return FMT_ERR(ERR_INVALID_DATA,
+                           "failed to decompress mutation batch: {}",
+                           ZSTD_isError(r) ? ZSTD_getErrorName(r) : "mismatched size");
+        }
+        raw = blob(std::move(buffer), raw_size);
+        break;
+    }
+#endif
+    default:
+        return FMT_ERR(ERR_INVALID_DATA, "unsupported codec of mutation batch [codec:{}]", codec);
+    }
+
+    std::vector<mutation_tuple> result;
+    payload_reader body_reader(string_view(raw.data(), raw.length()));
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t timestamp = 0;
+        uint16_t name_len = 0;
+        uint32_t data_len = 0;
+        string_view name, data;
+        if (!body_reader.read(timestamp) || !body_reader.read(name_len) ||
+            !body_reader.read_bytes(name_len, name) || !body_reader.read(data_len) ||
+            !body_reader.read_bytes(data_len, data)) {
+            return FMT_ERR(
+                ERR_INVALID_DATA, "truncated mutation batch [count:{}, parsed:{}]", count, i);
+        }
+        task_code code = task_code::try_get(std::string(name), TASK_CODE_INVALID);
+        if (code == TASK_CODE_INVALID) {
+            return FMT_ERR(
+                ERR_INVALID_DATA, "unknown task code {} in mutation batch", std::string(name));
+        }
+        result.emplace_back(
+            timestamp, code, raw.range(static_cast<int>(data.data() - raw.data()), data_len));
+    }
+    if (!body_reader.rest().empty()) {
+        return FMT_ERR(ERR_INVALID_DATA,
+                       "{} trailing bytes in mutation batch",
+                       body_reader.rest().size());
+    }
+
+    mutations.insert(mutations.end(),
+                     std::make_move_iterator(result.begin()),
+                     std::make_move_iterator(result.end()));
+    return error_s::ok();
+}
+
+} // namespace replication
+} // namespace dsn
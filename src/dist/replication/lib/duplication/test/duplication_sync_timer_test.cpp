@@ -7,10 +7,14 @@
 
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/tool-api/rpc_message.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(duplication_sync_min_interval_seconds);
+DSN_DECLARE_uint64(duplication_sync_lag_threshold);
+
 class duplication_sync_timer_test : public duplication_test_base
 {
 public:
@@ -347,6 +351,52 @@ protected:
     std::unique_ptr<duplication_sync_timer> dup_sync;
 };
 
+TEST_F(duplication_sync_timer_test, adaptive_interval)
+{
+    // app 100 is not served by this server
+    duplication_entry ent;
+    ent.dupid = 1;
+    ent.status = duplication_status::DS_START;
+    duplication_sync_response resp;
+    resp.dup_map[100][ent.dupid] = ent;
+
+    // the duplications changed
+    dup_sync->on_duplication_sync_reply(ERR_OK, resp);
+    ASSERT_EQ(DUPLICATION_SYNC_PERIOD_SECOND, dup_sync->_interval_seconds);
+
+    // slows down when idle
+    for (int interval : {20, 40, 60, 60}) {
+        dup_sync->on_duplication_sync_reply(ERR_OK, resp);
+        ASSERT_EQ(interval, dup_sync->_interval_seconds);
+    }
+
+    // some confirm point advanced
+    dup_sync->_confirms_sent = true;
+    dup_sync->on_duplication_sync_reply(ERR_OK, resp);
+    ASSERT_EQ(DUPLICATION_SYNC_PERIOD_SECOND, dup_sync->_interval_seconds);
+    dup_sync->_confirms_sent = false;
+    dup_sync->on_duplication_sync_reply(ERR_OK, resp);
+    ASSERT_EQ(20, dup_sync->_interval_seconds);
+
+    // the duplications changed
+    resp.dup_map[100][ent.dupid].status = duplication_status::DS_PAUSE;
+    dup_sync->on_duplication_sync_reply(ERR_OK, resp);
+    ASSERT_EQ(DUPLICATION_SYNC_PERIOD_SECOND, dup_sync->_interval_seconds);
+
+    // speeds up when the duplications lag behind
+    dup_sync->_pending_mutations = FLAGS_duplication_sync_lag_threshold + 1;
+    dup_sync->on_duplication_sync_reply(ERR_OK, resp);
+    int min_interval = FLAGS_duplication_sync_min_interval_seconds;
+    ASSERT_EQ(min_interval, dup_sync->_interval_seconds);
+    dup_sync->_pending_mutations = 0;
+    dup_sync->on_duplication_sync_reply(ERR_OK, resp);
+    ASSERT_EQ(min_interval * 2, dup_sync->_interval_seconds);
+
+    // failed to sync
+    dup_sync->on_duplication_sync_reply(ERR_TIMEOUT, resp);
+    ASSERT_EQ(DUPLICATION_SYNC_PERIOD_SECOND, dup_sync->_interval_seconds);
+}
+
 TEST_F(duplication_sync_timer_test, duplication_sync) { test_duplication_sync(); }
 
 TEST_F(duplication_sync_timer_test, update_duplication_map) { test_update_duplication_map(); }
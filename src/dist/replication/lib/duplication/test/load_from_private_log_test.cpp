@@ -5,6 +5,7 @@
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/defer.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 
 #define BOOST_NO_CXX11_SCOPED_ENUMS
 #include <boost/filesystem/operations.hpp>
@@ -17,6 +18,9 @@
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(dup_load_parallel_blocks);
+DSN_DECLARE_uint32(log_decree_index_interval_kb);
+
 DEFINE_STORAGE_WRITE_RPC_CODE(RPC_RRDB_RRDB_PUT, ALLOW_BATCH, IS_IDEMPOTENT)
 
 class load_from_private_log_test : public duplication_test_base
@@ -301,6 +305,66 @@ TEST_F(load_from_private_log_test, start_duplication_100000_4MB)
     test_start_duplication(100000, 4);
 }
 
+TEST_F(load_from_private_log_test, start_duplication_with_parallel_blocks)
+{
+    // decoding one block per round, or more blocks than a round can read
+    uint32_t old_blocks = FLAGS_dup_load_parallel_blocks;
+    auto cleanup = defer([old_blocks]() { FLAGS_dup_load_parallel_blocks = old_blocks; });
+    for (uint32_t blocks : {1, 64}) {
+        FLAGS_dup_load_parallel_blocks = blocks;
+        utils::filesystem::remove_path(_log_dir);
+        test_start_duplication(10000, 1);
+    }
+}
+
+TEST_F(load_from_private_log_test, seek_to_start_decree)
+{
+    uint32_t old_interval = FLAGS_log_decree_index_interval_kb;
+    auto cleanup =
+        defer([old_interval]() { FLAGS_log_decree_index_interval_kb = old_interval; });
+    FLAGS_log_decree_index_interval_kb = 16;
+
+    const int num_entries = 2000;
+    {
+        mutation_log_ptr mlog = create_private_log(4, _replica->get_gpid());
+        for (int i = 1; i <= num_entries + 1; i++) {
+            mutation_ptr mu = create_test_mutation(i, std::string(1024, 'a'));
+            mlog->append(mu, LPC_AIO_IMMEDIATE_CALLBACK, nullptr, nullptr, 0);
+        }
+        mlog->tracker()->wait_outstanding_tasks();
+        mlog->close();
+    }
+
+    // the index is built as the private log is replayed on open
+    mutation_log_ptr mlog = create_private_log(4, _replica->get_gpid());
+    _replica->init_private_log(mlog);
+    {
+        load_from_private_log load(_replica.get(), duplicator.get());
+        load.set_start_decree(1500);
+        load.find_log_file_to_start();
+        ASSERT_TRUE(load._current);
+        ASSERT_GT(load._start_offset, 0);
+
+        // the mutations before the offset are all less than the start decree
+        std::vector<decree> decrees;
+        int64_t end_offset = 0;
+        ASSERT_TRUE(mutation_log::replay_block(load._current,
+                                               [&decrees](int, mutation_ptr &mu) {
+                                                   decrees.push_back(mu->get_decree());
+                                                   return true;
+                                               },
+                                               load._start_offset,
+                                               end_offset)
+                        .is_ok());
+        ASSERT_FALSE(decrees.empty());
+        ASSERT_LE(decrees.front(), 1500);
+    }
+
+    auto loaded = load_and_wait_all_entries_loaded(num_entries - 1500 + 1, num_entries, 1500);
+    ASSERT_EQ(num_entries - 1500 + 1, loaded.size());
+    ASSERT_EQ(1500, std::get<0>(*loaded.begin()));
+}
+
 // Ensure replica_duplicator can correctly handle real-world log file
 TEST_F(load_from_private_log_test, handle_real_private_log)
 {
@@ -339,6 +403,42 @@ TEST_F(load_from_private_log_test, restart_duplication) { test_restart_duplicati
 
 TEST_F(load_from_private_log_test, restart_duplication2) { test_restart_duplication2(); }
 
+TEST_F(load_from_private_log_test, load_from_memory)
+{
+    // decree 1~4 are committed in the prepare list, and no private log is written
+    prepare_list *plist = _replica->get_plist();
+    plist->set_committer([](mutation_ptr &) {});
+    _replica->set_last_committed_decree(0);
+    for (int i = 1; i <= 5; i++) {
+        mutation_ptr mu = create_test_mutation(i, "hello!");
+        ASSERT_EQ(ERR_OK, plist->prepare(mu, partition_status::PS_SECONDARY));
+    }
+    ASSERT_EQ(4, _replica->last_committed_decree());
+
+    load_from_private_log load(_replica.get(), duplicator.get());
+    load.set_start_decree(2);
+
+    decree last_decree = invalid_decree;
+    mutation_tuple_set loaded_mutations;
+    pipeline::do_when<decree, mutation_tuple_set> end_stage(
+        [&last_decree, &loaded_mutations](decree &&d, mutation_tuple_set &&mutations) {
+            last_decree = d;
+            loaded_mutations = std::move(mutations);
+        });
+    duplicator->from(load).link(end_stage);
+    duplicator->run_pipeline();
+    duplicator->wait_all();
+
+    ASSERT_EQ(4, last_decree);
+    ASSERT_EQ(3u, loaded_mutations.size());
+    ASSERT_EQ(2u, std::get<0>(*loaded_mutations.begin()));
+    ASSERT_FALSE(load._current);
+
+    // fall back to the private log once the mutations are not in memory any more
+    load.set_start_decree(100);
+    ASSERT_FALSE(load.load_from_memory());
+}
+
 TEST_F(load_from_private_log_test, ignore_useless)
 {
     utils::filesystem::remove_path(_log_dir);
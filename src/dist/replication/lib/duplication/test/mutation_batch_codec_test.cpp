@@ -0,0 +1,119 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "duplication_test_base.h"
+
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_bool(dup_compress_batch);
+DSN_DECLARE_uint32(dup_compress_dict_sample_bytes);
+DSN_DECLARE_uint32(dup_compress_dict_size);
+
+class mutation_batch_codec_test : public duplication_test_base
+{
+public:
+    mutation_tuple_set create_test_mutations(int count, int start_ts)
+    {
+        mutation_tuple_set mutations;
+        for (int i = 0; i < count; i++) {
+            std::string data = fmt::format("{{\"user\":\"user_{}\",\"score\":{}}}", i, i * 7);
+            mutations.emplace(start_ts + i,
+                              RPC_DUPLICATION_IDEMPOTENT_WRITE,
+                              blob::create_from_bytes(std::move(data)));
+        }
+        return mutations;
+    }
+
+    void assert_decoded(const mutation_tuple_set &expected,
+                        const std::vector<mutation_tuple> &actual)
+    {
+        ASSERT_EQ(expected.size(), actual.size());
+        auto it = expected.begin();
+        for (const mutation_tuple &mut : actual) {
+            ASSERT_EQ(std::get<0>(*it), std::get<0>(mut));
+            ASSERT_EQ(std::get<1>(*it), std::get<1>(mut));
+            ASSERT_EQ(std::get<2>(*it).to_string(), std::get<2>(mut).to_string());
+            ++it;
+        }
+    }
+};
+
+TEST_F(mutation_batch_codec_test, encode_and_decode)
+{
+    for (bool compress : {false, true}) {
+        FLAGS_dup_compress_batch = compress;
+
+        mutation_batch_encoder encoder("encode_and_decode");
+        mutation_batch_decoder decoder;
+        mutation_tuple_set mutations = create_test_mutations(100, 0);
+        blob payload = encoder.encode(mutations);
+
+        std::vector<mutation_tuple> decoded;
+        ASSERT_TRUE(decoder.decode(payload, decoded).is_ok());
+        assert_decoded(mutations, decoded);
+
+        decoded.clear();
+        ASSERT_TRUE(decoder.decode(encoder.encode(mutation_tuple_set()), decoded).is_ok());
+        ASSERT_TRUE(decoded.empty());
+    }
+    FLAGS_dup_compress_batch = true;
+}
+
+TEST_F(mutation_batch_codec_test, decode_corrupted_payload)
+{
+    mutation_batch_encoder encoder("decode_corrupted_payload");
+    mutation_batch_decoder decoder;
+    blob payload = encoder.encode(create_test_mutations(10, 0));
+
+    std::vector<mutation_tuple> decoded;
+    for (unsigned int len : {0u, 10u, payload.length() - 1}) {
+        error_s err = decoder.decode(payload.range(0, len), decoded);
+        ASSERT_EQ(err.code(), ERR_INVALID_DATA) << len;
+        ASSERT_TRUE(decoded.empty());
+    }
+}
+
+#ifdef DSN_HAS_ZSTD
+TEST_F(mutation_batch_codec_test, ship_dictionary)
+{
+    uint32_t old_sample_bytes = FLAGS_dup_compress_dict_sample_bytes;
+    uint32_t old_dict_size = FLAGS_dup_compress_dict_size;
+    FLAGS_dup_compress_dict_sample_bytes = 64 << 10;
+    FLAGS_dup_compress_dict_size = 4 << 10;
+
+    mutation_batch_encoder encoder("ship_dictionary");
+    mutation_batch_decoder decoder;
+    std::vector<mutation_tuple> decoded;
+
+    // the dictionary is trained after enough mutations are sampled,
+    // and carried inline by the first payload using it
+    int ts = 0;
+    for (; ts < 10000; ts += 1000) {
+        mutation_tuple_set mutations = create_test_mutations(1000, ts);
+        decoded.clear();
+        ASSERT_TRUE(decoder.decode(encoder.encode(mutations), decoded).is_ok());
+        assert_decoded(mutations, decoded);
+    }
+
+    // a decoder without the dictionary can't decode the payload
+    mutation_tuple_set mutations = create_test_mutations(1000, ts);
+    mutation_batch_decoder restarted_decoder;
+    decoded.clear();
+    ASSERT_EQ(restarted_decoder.decode(encoder.encode(mutations), decoded).code(),
+              ERR_OBJECT_NOT_FOUND);
+
+    encoder.reship_dictionary();
+    ASSERT_TRUE(restarted_decoder.decode(encoder.encode(mutations), decoded).is_ok());
+    assert_decoded(mutations, decoded);
+
+    FLAGS_dup_compress_dict_sample_bytes = old_sample_bytes;
+    FLAGS_dup_compress_dict_size = old_dict_size;
+}
+#endif
+
+} // namespace replication
+} // namespace dsn
@@ -71,5 +71,13 @@ TEST_F(mutation_batch_test, ignore_non_idempotent_write)
     ASSERT_EQ(result.size(), 0);
 }
 
+TEST_F(mutation_batch_test, is_duplicatable)
+{
+    ASSERT_TRUE(is_duplicatable(RPC_DUPLICATION_IDEMPOTENT_WRITE));
+    ASSERT_FALSE(is_duplicatable(RPC_DUPLICATION_NON_IDEMPOTENT_WRITE));
+    ASSERT_FALSE(is_duplicatable(RPC_REPLICATION_WRITE_EMPTY));
+    ASSERT_FALSE(is_duplicatable(TASK_CODE_INVALID));
+}
+
 } // namespace replication
 } // namespace dsn
@@ -6,9 +6,13 @@
 #include "dist/replication/lib/duplication/duplication_pipeline.h"
 #include "duplication_test_base.h"
 
+#include <dsn/utility/flags.h>
+
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(dup_max_inflight_batches);
+
 /*static*/ mock_mutation_duplicator::duplicate_function mock_mutation_duplicator::_func;
 
 struct mock_stage : pipeline::when<>
@@ -77,6 +81,56 @@ struct ship_mutation_test : public duplication_test_base
 
 TEST_F(ship_mutation_test, ship_mutation_tuple_set) { test_ship_mutation_tuple_set(); }
 
+TEST_F(ship_mutation_test, ship_in_window)
+{
+    FLAGS_dup_max_inflight_batches = 2;
+    ship_mutation shipper(duplicator.get());
+    mock_stage end;
+
+    pipeline::base base;
+    base.thread_pool(LPC_REPLICATION_LONG_LOW).task_tracker(_replica->tracker());
+    base.from(shipper).link(end);
+
+    std::vector<mutation_duplicator::callback> callbacks;
+    mock_mutation_duplicator::mock(
+        [&callbacks](mutation_tuple_set, mutation_duplicator::callback cb) {
+            callbacks.emplace_back(std::move(cb));
+        });
+    auto make_batch = [](decree d) {
+        mutation_tuple_set in;
+        in.emplace(std::make_tuple(static_cast<uint64_t>(d),
+                                   task_code(RPC_DUPLICATION_IDEMPOTENT_WRITE),
+                                   blob::create_from_bytes("hello")));
+        return in;
+    };
+    _replica->set_last_committed_decree(3);
+    decree init_decree = duplicator->progress().last_decree;
+
+    shipper.run(1, make_batch(1));
+    shipper.run(2, make_batch(2));
+    ASSERT_EQ(2u, callbacks.size());
+    ASSERT_EQ(2, shipper.last_inflight_decree());
+    ASSERT_TRUE(shipper._window_full);
+
+    // confirmed in order
+    callbacks[1](0);
+    ASSERT_EQ(init_decree, duplicator->progress().last_decree);
+    ASSERT_FALSE(shipper._window_full);
+    shipper.run(3, make_batch(3));
+    ASSERT_EQ(3u, callbacks.size());
+    // no more duplicators are created than the window size
+    ASSERT_EQ(1u, shipper._extra_duplicators.size());
+
+    callbacks[0](0);
+    ASSERT_EQ(2, duplicator->progress().last_decree);
+    callbacks[2](0);
+    ASSERT_EQ(3, duplicator->progress().last_decree);
+    ASSERT_EQ(invalid_decree, shipper.last_inflight_decree());
+
+    base.wait_all();
+    FLAGS_dup_max_inflight_batches = 1;
+}
+
 void retry(pipeline::base *base)
 {
     base->schedule([base]() { retry(base); }, 10_s);
@@ -0,0 +1,127 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "hotspot_detector.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <dsn/c/api_layer1.h>
+
+namespace dsn {
+namespace replication {
+
+hotspot_detector::hotspot_detector(uint32_t key_sample_interval)
+    : _key_sample_interval(key_sample_interval), _last_collect_ms(dsn_now_ms())
+{
+}
+
+/*static*/ uint32_t hotspot_detector::sketch_index(uint64_t partition_hash, int row)
+{
+    // each row takes a different hash of the key
+    uint64_t h = (partition_hash ^ (0x9e3779b97f4a7c15ULL * (row + 1))) * 0xff51afd7ed558ccdULL;
+    return static_cast<uint32_t>(row << kSketchWidthBits) +
+           static_cast<uint32_t>(h >> (64 - kSketchWidthBits));
+}
+
+void hotspot_detector::record(uint64_t partition_hash, uint32_t bytes, bool is_write)
+{
+    uint64_t count = (is_write ? _writes : _reads).fetch_add(1, std::memory_order_relaxed) + 1;
+    _bytes.fetch_add(bytes, std::memory_order_relaxed);
+    if (is_write) {
+        _write_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    if (_key_sample_interval == 0 || count % _key_sample_interval != 0) {
+        return;
+    }
+
+    zauto_lock l(_lock);
+    if (_sketch == nullptr) {
+        _sketch.reset(new uint32_t[kSketchDepth << kSketchWidthBits]());
+    }
+    _sampled = true;
+
+    uint32_t estimate = std::numeric_limits<uint32_t>::max();
+    for (int row = 0; row < kSketchDepth; ++row) {
+        estimate = std::min(estimate, ++_sketch[sketch_index(partition_hash, row)]);
+    }
+
+    auto it = _candidates.find(partition_hash);
+    if (it != _candidates.end()) {
+        it->second = estimate;
+        return;
+    }
+    if (_candidates.size() < static_cast<size_t>(kMaxCandidates)) {
+        _candidates.emplace(partition_hash, estimate);
+        return;
+    }
+    auto coldest = std::min_element(
+        _candidates.begin(),
+        _candidates.end(),
+        [](const std::pair<const uint64_t, uint32_t> &lhs,
+           const std::pair<const uint64_t, uint32_t> &rhs) { return lhs.second < rhs.second; });
+    if (coldest->second < estimate) {
+        _candidates.erase(coldest);
+        _candidates.emplace(partition_hash, estimate);
+    }
+}
+
+partition_hotspot hotspot_detector::collect(gpid pid, int top_keys)
+{
+    partition_hotspot result;
+    result.pid = pid;
+
+    zauto_lock l(_lock);
+    uint64_t now_ms = dsn_now_ms();
+    uint64_t interval_ms = std::max<uint64_t>(now_ms - _last_collect_ms, 1);
+    _last_collect_ms = now_ms;
+
+    result.read_qps = _reads.exchange(0, std::memory_order_relaxed) * 1000 / interval_ms;
+    result.write_qps = _writes.exchange(0, std::memory_order_relaxed) * 1000 / interval_ms;
+    result.bytes_per_sec = _bytes.exchange(0, std::memory_order_relaxed) * 1000 / interval_ms;
+    result.write_bytes_per_sec =
+        _write_bytes.exchange(0, std::memory_order_relaxed) * 1000 / interval_ms;
+
+    if (!_sampled) {
+        return result;
+    }
+    std::vector<std::pair<uint64_t, uint32_t>> keys(_candidates.begin(), _candidates.end());
+    std::sort(keys.begin(),
+              keys.end(),
+              [](const std::pair<uint64_t, uint32_t> &lhs,
+                 const std::pair<uint64_t, uint32_t> &rhs) { return lhs.second > rhs.second; });
+    for (int i = 0; i < top_keys && i < static_cast<int>(keys.size()); ++i) {
+        result.hot_key_hashes.push_back(static_cast<int64_t>(keys[i].first));
+        // each sample stands for `_key_sample_interval` requests
+        result.hot_key_qps.push_back(static_cast<int64_t>(keys[i].second) * _key_sample_interval *
+                                     1000 / interval_ms);
+    }
+
+    memset(_sketch.get(), 0, sizeof(uint32_t) * (kSketchDepth << kSketchWidthBits));
+    _candidates.clear();
+    _sampled = false;
+    return result;
+}
+
+std::vector<partition_hotspot>
+pick_hot_partitions(std::vector<partition_hotspot> &&loads, int top_n, int64_t min_qps)
+{
+    auto is_cold = [min_qps](const partition_hotspot &load) {
+        return load.read_qps + load.write_qps < min_qps;
+    };
+    loads.erase(std::remove_if(loads.begin(), loads.end(), is_cold), loads.end());
+    std::sort(loads.begin(),
+              loads.end(),
+              [](const partition_hotspot &lhs, const partition_hotspot &rhs) {
+                  return lhs.read_qps + lhs.write_qps > rhs.read_qps + rhs.write_qps;
+              });
+    if (top_n >= 0 && static_cast<int>(loads.size()) > top_n) {
+        loads.resize(top_n);
+    }
+    return std::move(loads);
+}
+
+} // namespace replication
+} // namespace dsn
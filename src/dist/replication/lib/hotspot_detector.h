@@ -0,0 +1,63 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <dsn/dist/replication/replication_types.h>
+#include <dsn/tool-api/zlocks.h>
+
+namespace dsn {
+namespace replication {
+
+///
+/// hotspot_detector counts the requests served by a replica, and samples the partition hashes
+/// of their keys into a count-min sketch, so that the hottest keys are known without a counter
+/// for each key. The counts are written by the replica, and collected by replica_stub on each
+/// config sync, which reports the hottest partitions of the node to meta server.
+///
+class hotspot_detector
+{
+public:
+    // one of every `key_sample_interval` requests is sampled, 0 means no key is sampled
+    explicit hotspot_detector(uint32_t key_sample_interval);
+
+    void record(uint64_t partition_hash, uint32_t bytes, bool is_write);
+
+    // the load since the last collect, with at most `top_keys` hottest keys, after which the
+    // counts are reset
+    partition_hotspot collect(gpid pid, int top_keys);
+
+private:
+    static const int kSketchDepth = 4;
+    static const int kSketchWidthBits = 9;
+    static const int kMaxCandidates = 32;
+
+    static uint32_t sketch_index(uint64_t partition_hash, int row);
+
+    const uint32_t _key_sample_interval;
+    std::atomic<uint64_t> _reads{0};
+    std::atomic<uint64_t> _writes{0};
+    std::atomic<uint64_t> _bytes{0};
+    std::atomic<uint64_t> _write_bytes{0};
+
+    zlock _lock;
+    uint64_t _last_collect_ms;
+    // allocated on the first sample, as most of the replicas are never hot
+    std::unique_ptr<uint32_t[]> _sketch;
+    bool _sampled{false};
+    // partition hash -> estimated count of the keys with the highest estimates
+    std::unordered_map<uint64_t, uint32_t> _candidates;
+};
+
+// the loads of at most `top_n` partitions with the highest qps, which is at least `min_qps`
+std::vector<partition_hotspot>
+pick_hot_partitions(std::vector<partition_hotspot> &&loads, int top_n, int64_t min_qps);
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,159 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "learn_scheduler.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace dsn {
+namespace replication {
+
+bool learn_scheduler::acquire(gpid pid, const std::string &disk_tag, int replica_count)
+{
+    zauto_lock l(_lock);
+    if (_running.find(pid) != _running.end()) {
+        return true;
+    }
+
+    // the queued learners are blocked by the limits, and the new one only takes the slot if
+    // it's not blocked, so the queued learners aren't passed by it. a learner requesting again
+    // keeps its place in the queue unless its partition has changed
+    auto queued = _queued.find(replica_count);
+    if (queued == _queued.end() ||
+        std::none_of(queued->second.begin(),
+                     queued->second.end(),
+                     [pid, &disk_tag](const learn_request &req) {
+                         return req.pid == pid && req.disk_tag == disk_tag;
+                     })) {
+        remove_queued_unlocked(pid);
+        _queued[replica_count].push_back(learn_request{pid, disk_tag, replica_count});
+    }
+    std::vector<gpid> started;
+    start_queued_unlocked(started);
+    return _running.find(pid) != _running.end();
+}
+
+std::vector<gpid> learn_scheduler::release(gpid pid)
+{
+    std::vector<gpid> started;
+    zauto_lock l(_lock);
+    auto it = _running.find(pid);
+    if (it == _running.end()) {
+        remove_queued_unlocked(pid);
+        return started;
+    }
+    const std::string &disk_tag = it->second.disk_tag;
+    if (!disk_tag.empty() && --_disk_counts[disk_tag] == 0) {
+        _disk_counts.erase(disk_tag);
+    }
+    _running.erase(it);
+    start_queued_unlocked(started);
+    return started;
+}
+
+bool learn_scheduler::is_running(gpid pid) const
+{
+    zauto_lock l(_lock);
+    return _running.find(pid) != _running.end();
+}
+
+bool learn_scheduler::is_queued(gpid pid) const
+{
+    zauto_lock l(_lock);
+    for (const auto &kv : _queued) {
+        for (const learn_request &req : kv.second) {
+            if (req.pid == pid) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int learn_scheduler::running_count() const
+{
+    zauto_lock l(_lock);
+    return _running.size();
+}
+
+int learn_scheduler::queued_count() const
+{
+    zauto_lock l(_lock);
+    int count = 0;
+    for (const auto &kv : _queued) {
+        count += kv.second.size();
+    }
+    return count;
+}
+
+std::string learn_scheduler::to_string() const
+{
+    zauto_lock l(_lock);
+    std::stringstream ss;
+    ss << "running(" << _running.size() << "):";
+    for (const auto &kv : _running) {
+        ss << " " << kv.first.to_string() << "@" << kv.second.disk_tag << "/"
+           << kv.second.replica_count;
+    }
+    ss << "\nqueued:";
+    for (const auto &kv : _queued) {
+        for (const learn_request &req : kv.second) {
+            ss << " " << req.pid.to_string() << "@" << req.disk_tag << "/" << req.replica_count;
+        }
+    }
+    return ss.str();
+}
+
+bool learn_scheduler::can_start_unlocked(const learn_request &req) const
+{
+    if (req.disk_tag.empty() || _max_per_disk == 0) {
+        return true;
+    }
+    auto it = _disk_counts.find(req.disk_tag);
+    return it == _disk_counts.end() || it->second < static_cast<int>(_max_per_disk);
+}
+
+void learn_scheduler::start_queued_unlocked(/*out*/ std::vector<gpid> &started)
+{
+    // the learners on a busy disk are skipped rather than blocking those on the other disks
+    for (auto kv = _queued.begin(); kv != _queued.end();) {
+        std::deque<learn_request> &queue = kv->second;
+        for (auto it = queue.begin(); it != queue.end();) {
+            if (_max_concurrent > 0 && _running.size() >= _max_concurrent) {
+                return;
+            }
+            if (!can_start_unlocked(*it)) {
+                ++it;
+                continue;
+            }
+            if (!it->disk_tag.empty()) {
+                ++_disk_counts[it->disk_tag];
+            }
+            started.push_back(it->pid);
+            _running.emplace(it->pid, std::move(*it));
+            it = queue.erase(it);
+        }
+        kv = queue.empty() ? _queued.erase(kv) : std::next(kv);
+    }
+}
+
+bool learn_scheduler::remove_queued_unlocked(gpid pid)
+{
+    for (auto kv = _queued.begin(); kv != _queued.end(); ++kv) {
+        for (auto it = kv->second.begin(); it != kv->second.end(); ++it) {
+            if (it->pid == pid) {
+                kv->second.erase(it);
+                if (kv->second.empty()) {
+                    _queued.erase(kv);
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+} // namespace replication
+} // namespace dsn
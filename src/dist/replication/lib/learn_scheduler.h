@@ -0,0 +1,76 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <dsn/tool-api/gpid.h>
+#include <dsn/tool-api/zlocks.h>
+
+namespace dsn {
+namespace replication {
+
+///
+/// learn_scheduler bounds the learners copying app checkpoints on a replica server, in total
+/// and on each disk. After a node failure, hundreds of partitions start learning at once, so
+/// the queued learners are granted by the count of the replicas their partitions still have:
+/// a partition with only one replica left is rebuilt before those with two, and the replicas
+/// added by the load balance, whose partitions are healthy, learn last.
+///
+class learn_scheduler
+{
+public:
+    // 0 means no limit
+    learn_scheduler(uint32_t max_concurrent, uint32_t max_per_disk)
+        : _max_concurrent(max_concurrent), _max_per_disk(max_per_disk)
+    {
+    }
+
+    // requests a slot for the learner `pid` to copy the app checkpoint on the disk of `disk_tag`,
+    // where `replica_count` is the count of the primary and secondaries of its partition.
+    // returns true if the slot is taken, otherwise the learner is queued, or its queued request
+    // is updated, and returned by release() once the slot is taken for it.
+    bool acquire(gpid pid, const std::string &disk_tag, int replica_count);
+
+    // returns the slot taken by `pid` or removes its queued request, returns the queued learners
+    // whose slots are taken now
+    std::vector<gpid> release(gpid pid);
+
+    bool is_running(gpid pid) const;
+    bool is_queued(gpid pid) const;
+    int running_count() const;
+    int queued_count() const;
+
+    // the running and queued learners, in the order to be granted for the queued ones
+    std::string to_string() const;
+
+private:
+    struct learn_request
+    {
+        gpid pid;
+        std::string disk_tag;
+        int replica_count;
+    };
+
+    // caller should hold _lock
+    bool can_start_unlocked(const learn_request &req) const;
+    void start_queued_unlocked(/*out*/ std::vector<gpid> &started);
+    bool remove_queued_unlocked(gpid pid);
+
+    const uint32_t _max_concurrent;
+    const uint32_t _max_per_disk;
+
+    mutable zlock _lock;
+    // replica count -> the learners queued in order
+    std::map<int, std::deque<learn_request>> _queued;
+    std::map<gpid, learn_request> _running;
+    std::map<std::string, int> _disk_counts;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -4,25 +4,62 @@
 
 #include "log_block.h"
 
+#include <dsn/utility/arena_binary_writer.h>
+#include <dsn/utility/crc.h>
+#include <dsn/utility/flags.h>
+
+#include <algorithm>
+
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  log_inline_mutation_max_bytes,
+                  4096,
+                  "the mutations whose data are not larger than this are serialized into the "
+                  "log buffer with their data copied, so that the consecutive ones are written "
+                  "as one contiguous buffer; the data of the larger ones are referred without "
+                  "copying");
+
+std::atomic<int64_t> log_appender::s_alive_bytes(0);
+
 log_block::log_block(int64_t start_offset) : _start_offset(start_offset) { init(); }
 
 log_block::log_block() { init(); }
 
 void log_block::init()
 {
-    log_block_header hdr;
+    // the header is filled when the block is written, see log_file::commit_log_blocks
+    arena_binary_writer temp_writer(sizeof(log_block_header));
+    new (temp_writer.header<log_block_header>()) log_block_header();
+    blob hdr = temp_writer.get_buffer();
+    _size += hdr.length();
+    _data.push_back(std::move(hdr));
+}
 
-    binary_writer temp_writer;
-    temp_writer.write_pod(hdr);
-    add(temp_writer.get_buffer());
+void log_block::add(const blob &bb)
+{
+    _size += bb.length();
+    _body_crc = dsn::utils::crc32_calc(bb.data(), bb.length(), _body_crc);
+
+    // the log_block_header is always kept as the first blob
+    if (_data.size() > 1) {
+        blob &last = _data.back();
+        if (last.buffer_ptr() != nullptr && last.buffer_ptr() == bb.buffer_ptr() &&
+            last.data() + last.length() == bb.data()) {
+            last = blob(last.buffer(),
+                        static_cast<int>(last.data() - last.buffer_ptr()),
+                        last.length() + bb.length());
+            return;
+        }
+    }
+    _data.push_back(bb);
 }
 
 void log_appender::append_mutation(const mutation_ptr &mu, const aio_task_ptr &cb)
 {
     _mutations.push_back(mu);
+    _max_decree = std::max(_max_decree, mu->get_decree());
     if (cb) {
         _callbacks.push_back(cb);
     }
@@ -35,7 +72,21 @@ void log_appender::append_mutation(const mutation_ptr &mu, const aio_task_ptr &c
         blk = &_blocks.back();
     }
     mu->data.header.log_offset = blk->start_offset() + blk->size();
-    mu->write_to([blk](const blob &bb) { blk->add(bb); });
+
+    size_t data_bytes = 0;
+    for (const mutation_update &update : mu->data.updates) {
+        data_bytes += update.data.length();
+    }
+    if (data_bytes <= FLAGS_log_inline_mutation_max_bytes) {
+        // the header and the data are serialized into the transient memory of this thread,
+        // right after the previous mutation, so they are merged into the same blob
+        arena_binary_writer writer;
+        mu->write_copied_to(writer);
+        blk->add(writer.get_buffer());
+    } else {
+        mu->write_to([blk](const blob &bb) { blk->add(bb); });
+    }
+    account_bytes();
 }
 
 } // namespace replication
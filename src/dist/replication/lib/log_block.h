@@ -27,6 +27,9 @@ class log_block
     std::vector<blob> _data; // the first blob is log_block_header
     size_t _size{0};         // total data size of all blobs
     int64_t _start_offset{0};
+    // crc of the block data (not including log_block_header) from the seed 0, which is computed
+    // incrementally as the data is added
+    uint32_t _body_crc{0};
 
 public:
     log_block();
@@ -51,12 +54,12 @@ public:
         return _data.front();
     }
 
-    // add a blob into the block
-    void add(const blob &bb)
-    {
-        _size += bb.length();
-        _data.push_back(bb);
-    }
+    // add a blob into the block, which is merged into the last blob if it follows the last one
+    // in the same buffer, e.g. both are serialized into the transient memory by one thread
+    void add(const blob &bb);
+
+    // see _body_crc, log_file::commit_log_blocks chains it after the crc of the previous block
+    uint32_t body_crc() const { return _body_crc; }
 
     // return total data size in the block
     size_t size() const { return _size; }
@@ -75,14 +78,27 @@ private:
 class log_appender
 {
 public:
-    explicit log_appender(int64_t start_offset) { _blocks.emplace_back(start_offset); }
+    explicit log_appender(int64_t start_offset) : _create_time_ns(dsn_now_ns())
+    {
+        _blocks.emplace_back(start_offset);
+        account_bytes();
+    }
 
-    log_appender(int64_t start_offset, log_block &block)
+    log_appender(int64_t start_offset, log_block &block) : _create_time_ns(dsn_now_ns())
     {
         block._start_offset = start_offset;
         _blocks.emplace_back(std::move(block));
+        account_bytes();
     }
 
+    log_appender(const log_appender &) = delete;
+    log_appender &operator=(const log_appender &) = delete;
+
+    ~log_appender() { s_alive_bytes.fetch_sub(_accounted_bytes, std::memory_order_relaxed); }
+
+    // bytes of the log buffers alive in this process, pending or being written
+    static int64_t alive_bytes() { return s_alive_bytes.load(std::memory_order_relaxed); }
+
     void append_mutation(const mutation_ptr &mu, const aio_task_ptr &cb);
 
     size_t size() const { return _full_blocks_size + _blocks.crbegin()->size(); }
@@ -90,6 +106,11 @@ public:
 
     std::vector<mutation_ptr> mutations() const { return _mutations; }
 
+    size_t mutation_count() const { return _mutations.size(); }
+
+    // max decree of the mutations appended
+    decree max_decree() const { return _max_decree; }
+
     // The callback registered for each write.
     const std::vector<aio_task_ptr> &callbacks() const { return _callbacks; }
 
@@ -98,9 +119,23 @@ public:
 
     std::vector<log_block> &all_blocks() { return _blocks; }
 
+    // when the first write is appended, used to trace the wait in the pending buffer
+    uint64_t create_time_ns() const { return _create_time_ns; }
+
 protected:
     static constexpr size_t DEFAULT_MAX_BLOCK_BYTES = 1 * 1024 * 1024; // 1MB
 
+    // account the bytes appended since the last call
+    void account_bytes()
+    {
+        int64_t bytes = static_cast<int64_t>(size()) - _accounted_bytes;
+        _accounted_bytes += bytes;
+        s_alive_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    static std::atomic<int64_t> s_alive_bytes;
+    int64_t _accounted_bytes{0};
+
     // |---------------------- _blocks ----------------------|
     // | full block 0 | full block 1 | .... | unfilled block |
 
@@ -111,6 +146,8 @@ protected:
     size_t _full_blocks_blob_cnt{0};
     std::vector<aio_task_ptr> _callbacks;
     std::vector<mutation_ptr> _mutations;
+    decree _max_decree{0};
+    uint64_t _create_time_ns;
 };
 
 } // namespace replication
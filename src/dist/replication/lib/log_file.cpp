@@ -26,14 +26,42 @@
 
 #include "log_file.h"
 #include "log_file_stream.h"
+#include "log_write_tracer.h"
 
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/crc.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
+
+#include <algorithm>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                mmap_log_file_read,
+                false,
+                "whether to read log files through memory mapping on replay and duplication "
+                "loading, the read log blocks reference the mapped pages instead of copies");
+DSN_DEFINE_uint32("replication",
+                  log_replay_readahead_kb,
+                  4096,
+                  "the size of the log file read ahead on replay and duplication loading (KB), "
+                  "0 means no readahead except by the kernel, not used if mmap_log_file_read");
+DSN_DEFINE_bool("replication",
+                log_replay_drop_behind,
+                true,
+                "whether to drop the pages of the log file from the page cache once replayed, "
+                "except those which were cached before, not used if mmap_log_file_read");
+
+DSN_DEFINE_uint32("replication",
+                  log_decree_index_interval_kb,
+                  1024,
+                  "the interval in bytes of the blocks recorded in the sparse decree index of "
+                  "a log file, with which the loading of duplication starts near the decree, "
+                  "0 to disable the index");
+DSN_TAG_VARIABLE(log_decree_index_interval_kb, FT_MUTABLE);
+
 log_file::~log_file() { close(); }
 /*static */ log_file_ptr log_file::open_read(const char *path, /*out*/ error_code &err)
 {
@@ -90,6 +118,11 @@ log_file::~log_file() { close(); }
     lf->reset_stream();
     blob hdr_blob;
     err = lf->read_next_log_block(hdr_blob);
+    if (err == ERR_INVALID_DATA && hdr_blob.length() == sizeof(log_block_header) &&
+        reinterpret_cast<const log_block_header *>(hdr_blob.data())->magic == 0) {
+        // a preallocated file whose header isn't written yet
+        err = ERR_HANDLE_EOF;
+    }
     if (err == ERR_INVALID_DATA || err == ERR_INCOMPLETE_DATA || err == ERR_HANDLE_EOF ||
         err == ERR_FILE_OPERATION_FAILED) {
         std::string removed = std::string(path) + ".removed";
@@ -111,13 +144,15 @@ log_file::~log_file() { close(); }
     if (!lf->is_right_header()) {
         std::string removed = std::string(path) + ".removed";
         derror("invalid log file header of file %s. Rename the file to %s", path, removed.c_str());
+        // a recycled file whose header isn't written yet, which still has the stale header
+        bool recycled = lf->header().magic == 0xdeadbeef && lf->is_preallocated();
         delete lf;
         lf = nullptr;
 
         // rename file on failure
         dsn::utils::filesystem::rename_path(path, removed);
 
-        err = ERR_INVALID_DATA;
+        err = recycled ? ERR_HANDLE_EOF : ERR_INVALID_DATA;
         return nullptr;
     }
 
@@ -125,7 +160,11 @@ log_file::~log_file() { close(); }
     return lf;
 }
 
-/*static*/ log_file_ptr log_file::create_write(const char *dir, int index, int64_t start_offset)
+/*static*/ log_file_ptr log_file::create_write(const char *dir,
+                                               int index,
+                                               int64_t start_offset,
+                                               int64_t preallocate_size,
+                                               const std::string &recycled_path)
 {
     char path[512];
     sprintf(path, "%s/log.%d.%" PRId64, dir, index, start_offset);
@@ -135,13 +174,28 @@ log_file::~log_file() { close(); }
         return nullptr;
     }
 
+    bool recycled = false;
+    if (preallocate_size > 0 && !recycled_path.empty()) {
+        recycled = dsn::utils::filesystem::rename_path(recycled_path, path);
+        if (!recycled) {
+            dwarn("recycle log file %s as %s failed", recycled_path.c_str(), path);
+        }
+    }
+
     disk_file *hfile = file::open(path, O_RDWR | O_CREAT | O_BINARY, 0666);
     if (!hfile) {
         dwarn("create log %s failed", path);
         return nullptr;
     }
 
-    return new log_file(path, hfile, index, start_offset, false);
+    auto lf = new log_file(path, hfile, index, start_offset, false);
+    if (preallocate_size > 0) {
+        // the recycled file is still treated as preallocated if it can't be grown, since its
+        // tail is the stale data
+        lf->_preallocated =
+            dsn::utils::filesystem::preallocate_file(path, preallocate_size) || recycled;
+    }
+    return lf;
 }
 
 log_file::log_file(
@@ -154,6 +208,8 @@ log_file::log_file(
     _path = path;
     _index = index;
     _crc32 = 0;
+    _preallocated = false;
+    _read_offset = 0;
     _last_write_time = 0;
     memset(&_header, 0, sizeof(_header));
 
@@ -173,6 +229,7 @@ void log_file::close()
     //_stream implicitly refer to _handle so it needs to be cleaned up first.
     // TODO: We need better abstraction to avoid those manual stuffs..
     _stream.reset(nullptr);
+    _mmap_stream.reset(nullptr);
     if (_handle) {
         error_code err = file::close(_handle);
         dassert(err == ERR_OK, "file::close failed, err = %s", err.to_string());
@@ -195,7 +252,21 @@ void log_file::flush() const
 error_code log_file::read_next_log_block(/*out*/ ::dsn::blob &bb)
 {
     dassert(_is_read, "log file must be of read mode");
-    auto err = _stream->read_next(sizeof(log_block_header), bb);
+    error_code err = read_log_block(bb);
+    if (err == ERR_OK) {
+        _read_offset += sizeof(log_block_header) + bb.length();
+    } else if (is_preallocated() &&
+               (err == ERR_INVALID_DATA || err == ERR_INCOMPLETE_DATA || err == ERR_HANDLE_EOF)) {
+        // the rest of the file is zeros, or the stale data if it's recycled
+        _end_offset.store(_start_offset + static_cast<int64_t>(_read_offset));
+        err = ERR_HANDLE_EOF;
+    }
+    return err;
+}
+
+error_code log_file::read_log_block(/*out*/ ::dsn::blob &bb)
+{
+    auto err = read_next(sizeof(log_block_header), bb);
     if (err != ERR_OK || bb.length() != sizeof(log_block_header)) {
         if (err == ERR_OK || err == ERR_HANDLE_EOF) {
             // if read_count is 0, then we meet the end of file
@@ -216,7 +287,7 @@ error_code log_file::read_next_log_block(/*out*/ ::dsn::blob &bb)
         return ERR_INVALID_DATA;
     }
 
-    err = _stream->read_next(hdr.length, bb);
+    err = read_next(hdr.length, bb);
     if (err != ERR_OK || hdr.length != bb.length()) {
         derror("read data block body failed, size = %d vs %d, err = %s",
                bb.length(),
@@ -256,7 +327,8 @@ aio_task_ptr log_file::commit_log_blocks(log_appender &pending,
                                          dsn::task_code evt,
                                          dsn::task_tracker *tracker,
                                          aio_handler &&callback,
-                                         int hash)
+                                         int hash,
+                                         bool sync_after_write)
 {
     dassert(!_is_read, "log file must be of write mode");
     dcheck_gt(pending.size(), 0);
@@ -268,6 +340,7 @@ aio_task_ptr log_file::commit_log_blocks(log_appender &pending,
 
     auto size = (long long)pending.size();
     size_t vec_size = pending.blob_count();
+    index_block(pending.start_offset() - start_offset(), _crc32, pending.max_decree());
     std::vector<dsn_file_buffer_t> buffer_vector(vec_size);
     int buffer_idx = 0;
     for (log_block &block : pending.all_blocks()) {
@@ -277,20 +350,15 @@ aio_task_ptr log_file::commit_log_blocks(log_appender &pending,
         dassert(hdr->magic == 0xdeadbeef, "");
         hdr->local_offset = local_offset;
         hdr->length = static_cast<int32_t>(block.size() - sizeof(log_block_header));
-        hdr->body_crc = _crc32;
+        // the crc of the block body is computed as it's appended, and chained here after the
+        // crc of the previous block without reading the data again
+        hdr->body_crc = dsn::utils::crc32_combine(
+            _crc32, block.body_crc(), static_cast<size_t>(hdr->length));
 
-        for (int i = 0; i < block.data().size(); i++) {
-            auto &blk = block.data()[i];
+        for (const blob &blk : block.data()) {
             buffer_vector[buffer_idx].buffer =
                 reinterpret_cast<void *>(const_cast<char *>(blk.data()));
             buffer_vector[buffer_idx].size = blk.length();
-
-            // skip block header
-            if (i > 0) {
-                hdr->body_crc = dsn::utils::crc32_calc(static_cast<const void *>(blk.data()),
-                                                       static_cast<size_t>(blk.length()),
-                                                       hdr->body_crc);
-            }
             buffer_idx++;
         }
         _crc32 = hdr->body_crc;
@@ -298,6 +366,24 @@ aio_task_ptr log_file::commit_log_blocks(log_appender &pending,
 
     aio_task_ptr tsk;
     int64_t local_offset = pending.start_offset() - start_offset();
+    const char *log_type = log_write_tracer::log_type_of(evt);
+    if (log_type != nullptr) {
+        log_write_trace trace;
+        trace.log_type = log_type;
+        trace.file = _path;
+        trace.offset = local_offset;
+        trace.size = static_cast<size_t>(size);
+        trace.mutation_count = pending.mutation_count();
+        uint64_t issue_time_ns = dsn_now_ns();
+        trace.pending_us = (issue_time_ns - pending.create_time_ns()) / 1000;
+        callback = [ trace = std::move(trace), issue_time_ns, cb = std::move(callback) ](
+            error_code err, size_t sz) mutable {
+            trace_write(std::move(trace), issue_time_ns);
+            if (cb) {
+                cb(err, sz);
+            }
+        };
+    }
     if (callback) {
         tsk = file::write_vector(_handle,
                                  buffer_vector.data(),
@@ -306,7 +392,8 @@ aio_task_ptr log_file::commit_log_blocks(log_appender &pending,
                                  evt,
                                  tracker,
                                  std::forward<aio_handler>(callback),
-                                 hash);
+                                 hash,
+                                 sync_after_write);
     } else {
         tsk = file::write_vector(_handle,
                                  buffer_vector.data(),
@@ -315,23 +402,108 @@ aio_task_ptr log_file::commit_log_blocks(log_appender &pending,
                                  evt,
                                  tracker,
                                  nullptr,
-                                 hash);
+                                 hash,
+                                 sync_after_write);
     }
 
     _end_offset.fetch_add(size);
     return tsk;
 }
 
+/*static*/ void log_file::trace_write(log_write_trace &&trace, uint64_t issue_time_ns)
+{
+    // the callback is executed by the aio task, whose context has the times of the stages
+    task *t = task::get_current_task();
+    uint64_t now_ns = dsn_now_ns();
+    if (t != nullptr && t->spec().type == TASK_TYPE_AIO) {
+        const aio_context *ctx = static_cast<aio_task *>(t)->get_aio_context();
+        if (ctx->submit_time_ns >= issue_time_ns && ctx->complete_time_ns >= ctx->submit_time_ns &&
+            now_ns >= ctx->complete_time_ns) {
+            trace.queue_us = (ctx->submit_time_ns - issue_time_ns) / 1000;
+            trace.io_us = (ctx->complete_time_ns - ctx->submit_time_ns) / 1000;
+            trace.dispatch_us = (now_ns - ctx->complete_time_ns) / 1000;
+        }
+    }
+    if (trace.io_us == 0 && trace.queue_us == 0 && trace.dispatch_us == 0) {
+        // the stages in the disk engine are unknown, e.g. in the simulator
+        trace.io_us = (now_ns - issue_time_ns) / 1000;
+    }
+    trace.timestamp_ms = now_ns / 1000000;
+    log_write_tracer::instance().trace(std::move(trace));
+}
+
 void log_file::reset_stream(size_t offset /*default = 0*/)
 {
-    if (_stream == nullptr) {
-        _stream.reset(new file_streamer(_handle, offset));
+    if (FLAGS_mmap_log_file_read) {
+        if (_mmap_stream == nullptr) {
+            _mmap_stream.reset(new mmap_streamer(_path));
+        }
+        _mmap_stream->reset(offset);
     } else {
-        _stream->reset(offset);
+        _mmap_stream.reset(nullptr);
+        if (_stream == nullptr) {
+            _stream.reset(new file_streamer(_handle,
+                                            offset,
+                                            FLAGS_log_replay_readahead_kb * 1024ULL,
+                                            FLAGS_log_replay_drop_behind));
+        } else {
+            _stream->reset(offset);
+        }
     }
     if (offset == 0) {
         _crc32 = 0;
     }
+    _read_offset = offset;
+}
+
+void log_file::reset_stream(size_t offset, uint32_t crc32)
+{
+    reset_stream(offset);
+    _crc32 = crc32;
+}
+
+void log_file::index_block(int64_t local_offset, uint32_t crc32, decree block_max_decree)
+{
+    zauto_lock l(_index_lock);
+    if (local_offset <= _last_block_offset) {
+        // already indexed, e.g. the file written is replayed again
+        return;
+    }
+    _last_block_offset = local_offset;
+
+    uint64_t interval = FLAGS_log_decree_index_interval_kb * 1024ULL;
+    if (interval > 0 && local_offset >= _last_position_offset + static_cast<int64_t>(interval)) {
+        _block_index.push_back({local_offset, crc32, _indexed_max_decree});
+        _last_position_offset = local_offset;
+    }
+    _indexed_max_decree = std::max(_indexed_max_decree, block_max_decree);
+}
+
+bool log_file::find_block_before(decree d,
+                                 /*out*/ int64_t &local_offset,
+                                 /*out*/ uint32_t &crc32) const
+{
+    zauto_lock l(_index_lock);
+    // the first block whose previous mutations may have `d`
+    auto it = std::lower_bound(
+        _block_index.begin(), _block_index.end(), d, [](const block_position &p, decree target) {
+            return p.max_decree_before < target;
+        });
+    if (it == _block_index.begin()) {
+        return false;
+    }
+    --it;
+    local_offset = it->local_offset;
+    crc32 = it->crc32;
+    return true;
+}
+
+error_code log_file::read_next(size_t size, /*out*/ blob &result)
+{
+    if (_mmap_stream != nullptr) {
+        return _mmap_stream->read_next(size, result);
+    }
+    return _stream->read_next(size, result);
 }
 
 decree log_file::previous_log_max_decree(const dsn::gpid &pid)
@@ -386,7 +558,7 @@ int log_file::write_file_header(binary_writer &writer, const replica_log_info_ma
     _previous_log_max_decrees = init_max_decrees;
 
     _header.magic = 0xdeadbeef;
-    _header.version = 0x1;
+    _header.version = _preallocated ? 0x2 : 0x1;
     _header.start_global_offset = start_offset();
 
     writer.write_pod(_header);
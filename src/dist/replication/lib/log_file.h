@@ -33,11 +33,13 @@
 namespace dsn {
 namespace replication {
 
+struct log_write_trace;
+
 // each log file has a log_file_header stored at the beginning of the first block's data content
 struct log_file_header
 {
     int32_t magic;   // 0xdeadbeef
-    int32_t version; // current 0x1
+    int32_t version; // 0x1, or 0x2 if the file is preallocated
     int64_t
         start_global_offset; // start offset in the global space, equals to the file name's postfix
 };
@@ -95,10 +97,16 @@ public:
 
     // open the log file for write
     // the file path is '{dir}/log.{index}.{start_offset}'
+    // if 'preallocate_size' is positive, the file is preallocated to it, and made by renaming
+    // 'recycled_path' if not empty, which is a gc'ed log file whose data is stale
     // returns:
     //   - non-null if open succeed
     //   - null if open failed
-    static log_file_ptr create_write(const char *dir, int index, int64_t start_offset);
+    static log_file_ptr create_write(const char *dir,
+                                     int index,
+                                     int64_t start_offset,
+                                     int64_t preallocate_size = 0,
+                                     const std::string &recycled_path = std::string());
 
     // close the log file
     void close();
@@ -113,6 +121,8 @@ public:
     // sync read the next log entry from the file
     // the entry data is start from the 'local_offset' of the file
     // the result is passed out by 'bb', not including the log_block_header
+    // the data of a preallocated file ends at the first invalid block, where ERR_HANDLE_EOF is
+    // returned and the end offset is set
     // return error codes:
     //  - ERR_OK
     //  - ERR_HANDLE_EOF
@@ -132,6 +142,7 @@ public:
     // 'callback_host' is used to get tracer
     // 'callback' is to indicate the callback handler
     // 'hash' helps to choose which thread in the thread pool to execute the callback
+    // 'sync_after_write' is to persist the blocks before the callback is executed
     // returns:
     //   - non-null if io task is in pending
     //   - null if error
@@ -145,17 +156,28 @@ public:
                                         dsn::task_code evt,
                                         dsn::task_tracker *tracker,
                                         aio_handler &&callback,
-                                        int hash);
+                                        int hash,
+                                        bool sync_after_write = false);
 
     //
     // others
     //
 
-    // Reset file_streamer to point to `offset`.
-    // offset=0 means the start of this log file.
+    // Reset file_streamer (or mmap_streamer if `mmap_log_file_read` is enabled) to point to
+    // `offset`. offset=0 means the start of this log file.
     void reset_stream(size_t offset = 0);
+    // Reset the stream to read the block at `offset` directly, whose crc is chained to `crc32`
+    // of the blocks before it.
+    void reset_stream(size_t offset, uint32_t crc32);
+    // the chained crc of the blocks read from the stream
+    uint32_t crc32() const { return _crc32; }
     // end offset in the global space: end_offset = start_offset + file_size
     int64_t end_offset() const { return _end_offset.load(); }
+    // a preallocated file is larger than its data, whose end is known after it's read through,
+    // or as the start of the next file
+    void set_end_offset(int64_t end_offset) { _end_offset.store(end_offset); }
+    // if the file is preallocated, whose tail may be zeros or stale data
+    bool is_preallocated() const { return _preallocated || _header.version == 0x2; }
     // start offset in the global space
     int64_t start_offset() const { return _start_offset; }
     // file index
@@ -184,6 +206,24 @@ public:
 
     const disk_file *file_handle() const { return _handle; }
 
+    //
+    // sparse decree index
+    //
+    // The position of a block is recorded every `log_decree_index_interval_kb` bytes as the file
+    // is written or replayed, with which the reading starts near a decree rather than from the
+    // file start. It's only meaningful for the private log, whose mutations are of a single
+    // partition.
+    //
+
+    // `block_max_decree` is the max decree of the mutations in the block(s) at `local_offset`,
+    // whose crc is chained to `crc32`, the blocks must be indexed in order
+    void index_block(int64_t local_offset, uint32_t crc32, decree block_max_decree);
+    // find the last indexed block before which the decrees of all the mutations are less than
+    // `d`, returns false if there's no such block, where the reading starts from the file start
+    bool find_block_before(decree d,
+                           /*out*/ int64_t &local_offset,
+                           /*out*/ uint32_t &crc32) const;
+
 private:
     // make private, user should create log_file through open_read() or open_write()
     log_file(const char *path, disk_file *handle, int index, int64_t start_offset, bool is_read);
@@ -191,12 +231,23 @@ private:
 private:
     friend class mock_log_file;
 
+    // read the next `size` bytes from the stream
+    error_code read_next(size_t size, /*out*/ blob &result);
+    // complete the stages of the write in the disk engine, and record it
+    static void trace_write(log_write_trace &&trace, uint64_t issue_time_ns);
+    error_code read_log_block(/*out*/ ::dsn::blob &bb);
+
     uint32_t _crc32;
+    bool _preallocated; // if preallocated for write
+    size_t _read_offset; // local offset of the stream
     int64_t _start_offset; // start offset in the global space
     std::atomic<int64_t>
         _end_offset; // end offset in the global space: end_offset = start_offset + file_size
     class file_streamer;
     std::unique_ptr<file_streamer> _stream;
+    // blobs read from it reference the mapped pages of the file
+    class mmap_streamer;
+    std::unique_ptr<mmap_streamer> _mmap_stream;
     disk_file *_handle;        // file handle
     const bool _is_read;       // if opened for read or write
     std::string _path;         // file path
@@ -206,6 +257,18 @@ private:
 
     mutable zlock _write_lock;
 
+    struct block_position
+    {
+        int64_t local_offset;
+        uint32_t crc32;
+        decree max_decree_before; // max decree of the mutations before the block
+    };
+    mutable zlock _index_lock;
+    std::vector<block_position> _block_index; // in the order of the offset and the decree
+    int64_t _last_block_offset{-1};           // the offset of the last block passed to it
+    int64_t _last_position_offset{0};         // the offset of the last block recorded
+    decree _indexed_max_decree{0};            // max decree of the mutations passed to it
+
     // this data is used for garbage collection, and is part of file header.
     // for read, the value is read from file header.
     // for write, the value is set by write_file_header().
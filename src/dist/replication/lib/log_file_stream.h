@@ -28,6 +28,13 @@
 
 #pragma once
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <dsn/utility/page_cache_advisor.h>
+
 #include "log_file.h"
 
 namespace dsn {
@@ -37,11 +44,16 @@ namespace replication {
 class log_file::file_streamer
 {
 public:
-    explicit file_streamer(disk_file *fd, size_t file_offset)
-        : _file_dispatched_bytes(file_offset), _file_handle(fd)
+    // the pages read ahead by `readahead_bytes` are dropped once read if `drop_behind`
+    file_streamer(disk_file *fd, size_t file_offset, uint64_t readahead_bytes, bool drop_behind)
+        : _file_dispatched_bytes(file_offset),
+          _file_handle(fd),
+          _readahead_bytes(readahead_bytes),
+          _drop_behind(drop_behind)
     {
         _current_buffer = _buffers + 0;
         _next_buffer = _buffers + 1;
+        reset_advisor();
         fill_buffers();
     }
     ~file_streamer()
@@ -62,6 +74,7 @@ public:
             _current_buffer->_begin = _current_buffer->_end = _next_buffer->_begin =
                 _next_buffer->_end = 0;
             _file_dispatched_bytes = file_offset;
+            reset_advisor();
         }
         fill_buffers();
     }
@@ -122,12 +135,25 @@ public:
     }
 
 private:
+    // the advisor assumes the reading goes forward, so it's created again once jumped
+    void reset_advisor()
+    {
+        _advisor.reset();
+        if (_readahead_bytes > 0 || _drop_behind) {
+            _advisor.reset(new utils::page_cache_advisor(
+                file::native_fd(_file_handle), _readahead_bytes, _drop_behind));
+        }
+    }
+
     void fill_buffers()
     {
         while (!_current_buffer->_have_ongoing_task && _current_buffer->empty()) {
             _current_buffer->_begin = _current_buffer->_end = 0;
             _current_buffer->_file_offset_of_buffer = _file_dispatched_bytes;
             _current_buffer->_have_ongoing_task = true;
+            if (_advisor != nullptr) {
+                _advisor->on_read(_file_dispatched_bytes, block_size_bytes);
+            }
             _current_buffer->_task = file::read(_file_handle,
                                                 _current_buffer->_buffer.get(),
                                                 block_size_bytes,
@@ -190,6 +216,108 @@ private:
     // number of bytes we have issued read operations
     size_t _file_dispatched_bytes;
     disk_file *_file_handle;
+
+    const uint64_t _readahead_bytes;
+    const bool _drop_behind;
+    std::unique_ptr<utils::page_cache_advisor> _advisor;
+};
+
+// log_file::mmap_streamer
+//
+// The file is mapped as a whole, and the results reference the mapped pages, which are unmapped
+// once the streamer and all the results are released. The file may be appended after mapped,
+// such as the private log being written while loaded by duplication, so it's mapped again once
+// the reading goes beyond the mapped length.
+class log_file::mmap_streamer
+{
+public:
+    explicit mmap_streamer(const std::string &path) : _path(path) {}
+
+    void reset(size_t file_offset) { _offset = file_offset; }
+
+    // possible error_code:
+    //  ERR_OK                      result would always size as expected
+    //  ERR_HANDLE_EOF              if there are not enough data in file. result would still be
+    //                              filled with possible data
+    //  ERR_FILE_OPERATION_FAILED   filesystem failure
+    error_code read_next(size_t size, /*out*/ blob &result)
+    {
+        if (_offset + size > _length && !remap()) {
+            result = blob();
+            return ERR_FILE_OPERATION_FAILED;
+        }
+
+        size_t len = _offset < _length ? std::min(size, _length - _offset) : 0;
+        result = len == 0 ? blob() : blob(_data,
+                                          static_cast<int>(_offset),
+                                          static_cast<unsigned int>(len));
+        _offset += len;
+        readahead();
+        return len == size ? ERR_OK : ERR_HANDLE_EOF;
+    }
+
+private:
+    // map the file again if it has grown, return false on failure
+    bool remap()
+    {
+        int fd = ::open(_path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            derror("open log file %s for mmap failed, errno = %d", _path.c_str(), errno);
+            return false;
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            derror("stat log file %s failed, errno = %d", _path.c_str(), errno);
+            ::close(fd);
+            return false;
+        }
+        size_t length = static_cast<size_t>(st.st_size);
+        if (length <= _length) {
+            ::close(fd);
+            return true;
+        }
+
+        void *addr = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            derror("mmap log file %s failed, size = %zu, errno = %d", _path.c_str(), length, errno);
+            return false;
+        }
+        ::madvise(addr, length, MADV_SEQUENTIAL);
+
+        // the previous mapping is kept until the results referencing it are released
+        _data = std::shared_ptr<char>(static_cast<char *>(addr),
+                                      [length](char *p) { ::munmap(p, length); });
+        _length = length;
+        _advised_offset = 0;
+        return true;
+    }
+
+    // hint the kernel to read the next window ahead of the reading
+    void readahead()
+    {
+        if (_advised_offset >= std::min(_length, _offset + readahead_bytes / 2)) {
+            return;
+        }
+
+        static const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        size_t begin = std::max(_advised_offset, _offset) / page_size * page_size;
+        size_t end = std::min(_length, _offset + readahead_bytes);
+        if (end > begin) {
+            ::madvise(_data.get() + begin, end - begin, MADV_WILLNEED);
+        }
+        _advised_offset = end;
+    }
+
+    static constexpr size_t readahead_bytes = 4 * 1024 * 1024; // 4MB
+
+    const std::string _path;
+    std::shared_ptr<char> _data;
+    size_t _length{0};
+    size_t _offset{0};
+    // the readahead has been hinted up to this offset
+    size_t _advised_offset{0};
 };
 
 } // namespace replication
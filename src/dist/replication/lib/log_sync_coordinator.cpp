@@ -0,0 +1,52 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "log_sync_coordinator.h"
+
+#include <dsn/dist/replication/replication.codes.h>
+#include <dsn/tool-api/async_calls.h>
+
+#include <set>
+
+namespace dsn {
+namespace replication {
+
+void log_sync_coordinator::sync(const log_file_ptr &lf, std::function<void()> callback)
+{
+    zauto_lock l(_lock);
+    _pending.emplace_back(lf, std::move(callback));
+    if (!_is_syncing) {
+        _is_syncing = true;
+        tasking::enqueue(LPC_SYNC_REPLICATION_LOG, &_tracker, [this]() { sync_round(); });
+    }
+}
+
+void log_sync_coordinator::sync_round()
+{
+    std::vector<std::pair<log_file_ptr, std::function<void()>>> round;
+    {
+        zauto_lock l(_lock);
+        round.swap(_pending);
+    }
+
+    std::set<log_file *> synced;
+    for (auto &p : round) {
+        if (synced.insert(p.first.get()).second) {
+            p.first->flush();
+        }
+    }
+    for (auto &p : round) {
+        p.second();
+    }
+
+    zauto_lock l(_lock);
+    if (_pending.empty()) {
+        _is_syncing = false;
+    } else {
+        tasking::enqueue(LPC_SYNC_REPLICATION_LOG, &_tracker, [this]() { sync_round(); });
+    }
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,45 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "log_file.h"
+
+#include <dsn/tool-api/task_tracker.h>
+
+namespace dsn {
+namespace replication {
+
+// Batches the fsync of the private log files on one disk, used when the shared log is disabled
+// and the private logs are responsible for the durability of mutations.
+//
+// Only one round of fsync runs at a time. The files written during a round are synced in the
+// next round, each of them once no matter how many writes it got, so the fsync count of the
+// disk is bounded by the file count rather than the write count.
+class log_sync_coordinator
+{
+public:
+    explicit log_sync_coordinator(const std::string &disk_tag) : _disk_tag(disk_tag) {}
+    ~log_sync_coordinator() { _tracker.cancel_outstanding_tasks(); }
+
+    // Syncs `lf` to disk, then calls `callback` in THREAD_POOL_REPLICATION_LONG.
+    // Thread safe.
+    void sync(const log_file_ptr &lf, std::function<void()> callback);
+
+    const std::string &disk_tag() const { return _disk_tag; }
+
+private:
+    void sync_round();
+
+    const std::string _disk_tag;
+
+    zlock _lock;
+    std::vector<std::pair<log_file_ptr, std::function<void()>>> _pending;
+    bool _is_syncing{false};
+
+    dsn::task_tracker _tracker;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,145 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "log_write_tracer.h"
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/dist/replication/replication.codes.h>
+#include <dsn/utility/flags.h>
+#include <nlohmann/json.hpp>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_uint32("replication",
+                  log_slow_write_threshold_ms,
+                  100,
+                  "the shared and private log writes slower than it from the pending buffer to "
+                  "the callback are logged with their stages; 0 means disabled");
+DSN_DEFINE_uint32("replication",
+                  log_slow_write_keep_count,
+                  64,
+                  "count of the recent slow log writes kept for ip:port/replica/log_writes");
+
+namespace {
+
+void init_stage_counter(perf_counter_wrapper &counter,
+                        const char *log_type,
+                        const char *stage,
+                        const char *desc)
+{
+    std::string name = fmt::format("{}.log.write.{}(us)", log_type, stage);
+    counter.init_app_counter("eon.replica", name.c_str(), COUNTER_TYPE_HISTOGRAM, desc);
+}
+
+} // anonymous namespace
+
+log_write_tracer::log_write_tracer()
+{
+    for (auto &kv : {std::make_pair("shared", &_shared), std::make_pair("private", &_private)}) {
+        init_stage_counter(kv.second->pending,
+                           kv.first,
+                           "pending",
+                           "time of the log writes waiting in the pending buffer");
+        init_stage_counter(kv.second->queue,
+                           kv.first,
+                           "queue",
+                           "time of the log writes queueing in the disk engine");
+        init_stage_counter(
+            kv.second->io, kv.first, "io", "time of the log writes done by the aio provider");
+        init_stage_counter(kv.second->dispatch,
+                           kv.first,
+                           "dispatch",
+                           "time from the log writes completed to their callbacks executed");
+    }
+}
+
+/*static*/ const char *log_write_tracer::log_type_of(task_code code)
+{
+    if (code == LPC_WRITE_REPLICATION_LOG_SHARED) {
+        return "shared";
+    }
+    if (code == LPC_WRITE_REPLICATION_LOG_PRIVATE) {
+        return "private";
+    }
+    return nullptr;
+}
+
+void log_write_tracer::trace(log_write_trace &&trace)
+{
+    stage_counters &counters = trace.log_type == "shared" ? _shared : _private;
+    counters.pending->set(trace.pending_us);
+    counters.queue->set(trace.queue_us);
+    counters.io->set(trace.io_us);
+    counters.dispatch->set(trace.dispatch_us);
+
+    if (FLAGS_log_slow_write_threshold_ms == 0 ||
+        trace.total_us() < FLAGS_log_slow_write_threshold_ms * 1000ULL) {
+        return;
+    }
+
+    dwarn_f("slow {} log write to {} at offset {}: {} bytes of {} mutations, took {} us, "
+            "pending {} us, queue {} us, io {} us, dispatch {} us",
+            trace.log_type,
+            trace.file,
+            trace.offset,
+            trace.size,
+            trace.mutation_count,
+            trace.total_us(),
+            trace.pending_us,
+            trace.queue_us,
+            trace.io_us,
+            trace.dispatch_us);
+
+    std::lock_guard<std::mutex> l(_lock);
+    _slow_writes.emplace_back(std::move(trace));
+    while (_slow_writes.size() > FLAGS_log_slow_write_keep_count) {
+        _slow_writes.pop_front();
+    }
+}
+
+std::vector<log_write_trace> log_write_tracer::recent_slow_writes() const
+{
+    std::lock_guard<std::mutex> l(_lock);
+    return std::vector<log_write_trace>(_slow_writes.begin(), _slow_writes.end());
+}
+
+std::string log_write_tracer::to_json() const
+{
+    nlohmann::json json;
+    for (auto &kv : {std::make_pair("shared", &_shared), std::make_pair("private", &_private)}) {
+        for (auto &stage : {std::make_pair("pending", &kv.second->pending),
+                            std::make_pair("queue", &kv.second->queue),
+                            std::make_pair("io", &kv.second->io),
+                            std::make_pair("dispatch", &kv.second->dispatch)}) {
+            perf_counter *counter = stage.second->get();
+            json[kv.first][stage.first] = nlohmann::json{
+                {"p50", counter->get_quantile(0.5)},
+                {"p99", counter->get_quantile(0.99)},
+                {"p999", counter->get_quantile(0.999)},
+            };
+        }
+    }
+
+    json["slow_writes"] = nlohmann::json::array();
+    for (const log_write_trace &t : recent_slow_writes()) {
+        json["slow_writes"].push_back(nlohmann::json{
+            {"log", t.log_type},
+            {"file", t.file},
+            {"offset", t.offset},
+            {"size", t.size},
+            {"mutation_count", t.mutation_count},
+            {"timestamp_ms", t.timestamp_ms},
+            {"total_us", t.total_us()},
+            {"pending_us", t.pending_us},
+            {"queue_us", t.queue_us},
+            {"io_us", t.io_us},
+            {"dispatch_us", t.dispatch_us},
+        });
+    }
+    return json.dump();
+}
+
+} // namespace replication
+} // namespace dsn
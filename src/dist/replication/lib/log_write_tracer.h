@@ -0,0 +1,74 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/tool-api/task_code.h>
+#include <dsn/utility/singleton.h>
+
+namespace dsn {
+namespace replication {
+
+// The stages of a log write, in microseconds.
+struct log_write_trace
+{
+    std::string log_type; // "shared" or "private"
+    std::string file;
+    int64_t offset{0}; // the local offset in the file
+    size_t size{0};
+    size_t mutation_count{0};
+    uint64_t timestamp_ms{0};
+
+    uint64_t pending_us{0};  // from the first mutation appended to the pending buffer to issued
+    uint64_t queue_us{0};    // from issued to submitted to the aio provider by the disk_engine
+    uint64_t io_us{0};       // from submitted to completed by the aio provider
+    uint64_t dispatch_us{0}; // from completed to the callback executed
+
+    uint64_t total_us() const { return pending_us + queue_us + io_us + dispatch_us; }
+};
+
+///
+/// log_write_tracer records the stages of the writes of the shared and private logs into the
+/// histogram counters of each log type, and keeps the recent writes slower than
+/// [replication] log_slow_write_threshold_ms, which are also logged. They are exposed by
+/// ip:port/replica/log_writes.
+///
+class log_write_tracer : public utils::singleton<log_write_tracer>
+{
+public:
+    log_write_tracer();
+
+    // the log type traced for the writes of `code`, or nullptr if they are not traced
+    static const char *log_type_of(task_code code);
+
+    void trace(log_write_trace &&trace);
+
+    std::vector<log_write_trace> recent_slow_writes() const;
+
+    // the quantiles of the stages of each log type, and the recent slow writes
+    std::string to_json() const;
+
+private:
+    struct stage_counters
+    {
+        perf_counter_wrapper pending;
+        perf_counter_wrapper queue;
+        perf_counter_wrapper io;
+        perf_counter_wrapper dispatch;
+    };
+    stage_counters _shared;
+    stage_counters _private;
+
+    mutable std::mutex _lock;
+    std::deque<log_write_trace> _slow_writes;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -37,10 +37,76 @@
 #include "mutation_log.h"
 #include "replica.h"
 
+#include <dsn/utility/arena_binary_writer.h>
+#include <dsn/utility/flags.h>
+
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  write_batch_window_ms,
+                  0,
+                  "how long the primary holds the client writes of a partition to coalesce them "
+                  "into one mutation even if it's not busy with the in-flight mutations, 0 means "
+                  "writes are coalesced only when the in-flight mutations reach the limit");
+DSN_DEFINE_uint32("replication",
+                  write_batch_max_bytes,
+                  64 * 1024,
+                  "a held mutation is prepared at once when the approximate size of its writes "
+                  "reaches this size, which is at most 1MB");
+DSN_DEFINE_uint32("replication",
+                  mutation_shared_write_min_bytes,
+                  4096,
+                  "the writes not smaller than this are attached to the prepare messages and the "
+                  "log blocks by sharing the buffers of the client requests, rather than copied");
+
+DSN_DECLARE_bool(adaptive_2pc_window_enabled);
+
+DSN_DEFINE_uint32("replication",
+                  prepare_window_max_kb,
+                  0,
+                  "max approximate size of the mutations being prepared and not yet committed by "
+                  "the primary, besides the count limit staleness_for_commit, the client writes "
+                  "beyond it are coalesced in the queue; 0 means only the count is limited");
+
 std::atomic<uint64_t> mutation::s_tid(0);
+std::atomic<int64_t> mutation::s_alive_count(0);
+std::atomic<int64_t> mutation::s_alive_bytes(0);
+
+prepare_batch_ack::prepare_batch_ack(dsn::message_ex *request, std::vector<decree> &&decrees)
+    : _request(request),
+      _decrees(std::move(decrees)),
+      _results(_decrees.size(), ERR_IO_PENDING),
+      _left_count(static_cast<int>(_decrees.size()))
+{
+    _request->add_ref(); // released on dctor
+}
+
+prepare_batch_ack::~prepare_batch_ack() { _request->release_ref(); }
+
+bool prepare_batch_ack::ack(int index, error_code err)
+{
+    dassert(index >= 0 && index < size(), "invalid index %d, batch size = %d", index, size());
+    if (_results[index] != ERR_IO_PENDING) {
+        return false;
+    }
+    _results[index] = err;
+    return --_left_count == 0;
+}
+
+void prepare_batch_ack::get_result(/*out*/ decree &acked_decree, /*out*/ error_code &err) const
+{
+    dassert(_left_count == 0, "there are still %d mutations not acked", _left_count);
+    acked_decree = invalid_decree;
+    err = ERR_OK;
+    for (int i = 0; i < size(); ++i) {
+        if (_results[i] != ERR_OK) {
+            err = _results[i];
+            return;
+        }
+        acked_decree = _decrees[i];
+    }
+}
 
 mutation::mutation()
 {
@@ -49,8 +115,11 @@ mutation::mutation()
     _not_logged = 1;
     _prepare_ts_ms = 0;
     strcpy(_name, "0.0.0.0");
-    _appro_data_bytes = sizeof(mutation_header);
+    _appro_data_bytes = 0;
+    add_appro_data_bytes(sizeof(mutation_header));
+    s_alive_count.fetch_add(1, std::memory_order_relaxed);
     _create_ts_ns = dsn_now_ns();
+    _start_ts_ns = 0;
     _tid = ++s_tid;
 }
 
@@ -59,7 +128,7 @@ mutation_ptr mutation::copy_no_reply(const mutation_ptr &old_mu)
     mutation_ptr mu(new mutation());
     mu->_private0 = old_mu->_private0;
     strcpy(mu->_name, old_mu->_name);
-    mu->_appro_data_bytes = old_mu->_appro_data_bytes;
+    mu->add_appro_data_bytes(old_mu->_appro_data_bytes - mu->_appro_data_bytes);
     mu->data = old_mu->data;
     mu->_is_sync_to_child = old_mu->is_sync_to_child();
     // create a new message without client information, it will not rely
@@ -76,6 +145,9 @@ mutation_ptr mutation::copy_no_reply(const mutation_ptr &old_mu)
 
 mutation::~mutation()
 {
+    s_alive_count.fetch_sub(1, std::memory_order_relaxed);
+    s_alive_bytes.fetch_sub(_appro_data_bytes, std::memory_order_relaxed);
+
     for (auto &r : client_requests) {
         if (r != nullptr) {
             r->release_ref();
@@ -105,7 +177,7 @@ void mutation::copy_from(mutation_ptr &old)
 {
     data.updates = old->data.updates;
     client_requests = old->client_requests;
-    _appro_data_bytes = old->_appro_data_bytes;
+    add_appro_data_bytes(old->_appro_data_bytes - _appro_data_bytes);
     _create_ts_ns = old->_create_ts_ns;
 
     for (auto &r : client_requests) {
@@ -137,7 +209,7 @@ void mutation::add_client_request(task_code code, dsn::message_ex *request)
 {
     data.updates.push_back(mutation_update());
     mutation_update &update = data.updates.back();
-    _appro_data_bytes += 32; // approximate code size
+    add_appro_data_bytes(32); // approximate code size
 
     if (request != nullptr) {
         update.code = code;
@@ -145,18 +217,20 @@ void mutation::add_client_request(task_code code, dsn::message_ex *request)
             (dsn_msg_serialize_format)request->header->context.u.serialize_format;
         update.__set_start_time_ns(dsn_now_ns());
         request->add_ref(); // released on dctor
+        if (request->span != nullptr) {
+            _traced = true;
+        }
 
-        void *ptr;
-        size_t size;
-        bool r = request->read_next(&ptr, &size);
+        // the data shares the buffer of the request, so that it can be attached to the prepare
+        // messages and the log blocks without copying
+        bool r = request->read_next(update.data);
         dassert(r, "payload is not present");
         request->read_commit(0); // so we can re-read the request buffer in replicated app
-        update.data.assign((char *)ptr, 0, (int)size);
 
-        _appro_data_bytes += sizeof(int) + (int)size; // data size
+        add_appro_data_bytes(sizeof(int) + (int)update.data.length()); // data size
     } else {
         update.code = RPC_REPLICATION_WRITE_EMPTY;
-        _appro_data_bytes += sizeof(int); // empty data size
+        add_appro_data_bytes(sizeof(int)); // empty data size
     }
 
     client_requests.push_back(request);
@@ -164,9 +238,8 @@ void mutation::add_client_request(task_code code, dsn::message_ex *request)
     dassert(client_requests.size() == data.updates.size(), "size must be equal");
 }
 
-void mutation::write_to(const std::function<void(const blob &)> &inserter) const
+void mutation::write_meta_to(binary_writer &writer) const
 {
-    binary_writer writer(1024);
     write_mutation_header(writer, data.header);
     writer.write_pod(static_cast<int>(data.updates.size()));
     for (const mutation_update &update : data.updates) {
@@ -182,6 +255,14 @@ void mutation::write_to(const std::function<void(const blob &)> &inserter) const
 
         writer.write_pod(static_cast<int>(update.data.length()));
     }
+}
+
+void mutation::write_to(const std::function<void(const blob &)> &inserter) const
+{
+    // the header is allocated from the transient memory, like the buffers of the messages,
+    // rather than by a malloc for each mutation
+    arena_binary_writer writer;
+    write_meta_to(writer);
     inserter(writer.get_buffer());
     for (const mutation_update &update : data.updates) {
         inserter(update.data);
@@ -190,22 +271,21 @@ void mutation::write_to(const std::function<void(const blob &)> &inserter) const
 
 void mutation::write_to(binary_writer &writer, dsn::message_ex * /*to*/) const
 {
-    write_mutation_header(writer, data.header);
-    writer.write_pod(static_cast<int>(data.updates.size()));
+    write_meta_to(writer);
     for (const mutation_update &update : data.updates) {
-        // write task_code as string to make it cross-process compatible.
-        // avoid memory copy, equal to writer.write(std::string)
-        const char *cstr = update.code.to_string();
-        int len = static_cast<int>(strlen(cstr));
-        writer.write_pod(len);
-        if (len > 0)
-            writer.write(cstr, len);
-
-        writer.write_pod(static_cast<int>(update.serialization_type));
-
-        writer.write_pod(static_cast<int>(update.data.length()));
+        // the large data are attached to the writer without copying, e.g. to the buffers of the
+        // prepare messages, so each of them is shared by all the secondaries
+        if (update.data.length() >= FLAGS_mutation_shared_write_min_bytes) {
+            writer.write_shared(update.data);
+        } else {
+            writer.write(update.data.data(), update.data.length());
+        }
     }
-    // TODO(qinzuoyan): directly append buffer to message to avoid memory copy
+}
+
+void mutation::write_copied_to(binary_writer &writer) const
+{
+    write_meta_to(writer);
     for (const mutation_update &update : data.updates) {
         writer.write(update.data.data(), update.data.length());
     }
@@ -328,9 +408,13 @@ void mutation::wait_log_task() const
 mutation_queue::mutation_queue(gpid gpid,
                                int max_concurrent_op /*= 2*/,
                                bool batch_write_disabled /*= false*/)
-    : _max_concurrent_op(max_concurrent_op), _batch_write_disabled(batch_write_disabled)
+    : _max_concurrent_op(max_concurrent_op),
+      _batch_write_disabled(batch_write_disabled),
+      _adaptive_window(max_concurrent_op),
+      _window_full(false)
 {
     _current_op_count = 0;
+    _current_running_bytes = 0;
     _pending_mutation = nullptr;
     dassert(gpid.get_app_id() != 0, "invalid gpid");
     _pcount = dsn_task_queue_virtual_length_ptr(RPC_PREPARE, gpid.thread_hash());
@@ -359,12 +443,20 @@ mutation_ptr mutation_queue::add_work(task_code code, dsn::message_ex *request,
 
     _pending_mutation->add_client_request(code, request);
 
+    // hold the mutation in the batch window, unless it's large enough
+    bool hold =
+        FLAGS_write_batch_window_ms > 0 && !_batch_write_disabled &&
+        spec->rpc_request_is_write_allow_batch &&
+        _pending_mutation->appro_data_bytes() < static_cast<int>(FLAGS_write_batch_max_bytes);
+
     // short-cut
-    if (_current_op_count < _max_concurrent_op && _hdr.is_empty()) {
+    if (_hdr.is_empty() && !hold && can_start(_pending_mutation->appro_data_bytes())) {
         auto ret = _pending_mutation;
         _pending_mutation = nullptr;
-        _current_op_count++;
-        return ret;
+        return start(std::move(ret));
+    }
+    if (_current_op_count >= max_concurrent_ops()) {
+        _window_full = true;
     }
 
     // check if need to switch work queue
@@ -377,45 +469,93 @@ mutation_ptr mutation_queue::add_work(task_code code, dsn::message_ex *request,
     }
 
     // get next work item
-    if (_current_op_count >= _max_concurrent_op)
-        return nullptr;
-    else if (_hdr.is_empty()) {
+    if (_hdr.is_empty()) {
         dassert(_pending_mutation != nullptr, "pending mutation cannot be null");
+        if (hold || !can_start(_pending_mutation->appro_data_bytes())) {
+            return nullptr;
+        }
 
         auto ret = _pending_mutation;
         _pending_mutation = nullptr;
-        _current_op_count++;
-        return ret;
+        return start(std::move(ret));
+    } else if (can_start(_hdr._first->appro_data_bytes())) {
+        return start(unlink_next_workload());
     } else {
-        _current_op_count++;
-        return unlink_next_workload();
+        return nullptr;
     }
 }
 
-mutation_ptr mutation_queue::check_possible_work(int current_running_count)
+mutation_ptr mutation_queue::flush_pending()
 {
-    _current_op_count = current_running_count;
-
-    if (_current_op_count >= _max_concurrent_op)
+    if (_pending_mutation == nullptr || !_hdr.is_empty() ||
+        !can_start(_pending_mutation->appro_data_bytes())) {
+        // the held mutation will be got by check_possible_work when a running one is done
         return nullptr;
+    }
+
+    auto ret = _pending_mutation;
+    _pending_mutation = nullptr;
+    return start(std::move(ret));
+}
+
+mutation_ptr mutation_queue::check_possible_work(int current_running_count,
+                                                 int64_t current_running_bytes)
+{
+    _current_op_count = current_running_count;
+    _current_running_bytes = current_running_bytes;
 
     // no further workload
     if (_hdr.is_empty()) {
-        if (_pending_mutation != nullptr) {
+        if (_pending_mutation != nullptr && can_start(_pending_mutation->appro_data_bytes())) {
             auto ret = _pending_mutation;
             _pending_mutation = nullptr;
-            _current_op_count++;
-            return ret;
+            return start(std::move(ret));
         } else {
             return nullptr;
         }
     }
 
     // run further workload
-    else {
-        _current_op_count++;
-        return unlink_next_workload();
+    else if (can_start(_hdr._first->appro_data_bytes())) {
+        return start(unlink_next_workload());
+    } else {
+        return nullptr;
+    }
+}
+
+bool mutation_queue::can_start(int bytes) const
+{
+    if (_current_op_count >= max_concurrent_ops()) {
+        return false;
+    }
+    return FLAGS_prepare_window_max_kb == 0 || _current_op_count == 0 ||
+           _current_running_bytes + bytes <= FLAGS_prepare_window_max_kb * 1024LL;
+}
+
+double mutation_queue::window_usage() const
+{
+    double usage = static_cast<double>(_current_op_count) / max_concurrent_ops();
+    if (FLAGS_prepare_window_max_kb > 0) {
+        usage = std::max(usage,
+                         static_cast<double>(_current_running_bytes) /
+                             (FLAGS_prepare_window_max_kb * 1024.0));
+    }
+    return std::min(usage, 1.0);
+}
+
+int mutation_queue::max_concurrent_ops() const
+{
+    return FLAGS_adaptive_2pc_window_enabled ? _adaptive_window.window() : _max_concurrent_op;
+}
+
+void mutation_queue::on_committed(mutation *mu)
+{
+    if (mu->start_ts_ns() == 0) {
+        return;
     }
+    _adaptive_window.on_committed(dsn_now_ns() - mu->start_ts_ns(), _window_full);
+    _window_full = false;
+    mu->set_start_ts_ns(0);
 }
 
 void mutation_queue::clear()
@@ -36,8 +36,10 @@
 #pragma once
 
 #include "common/replication_common.h"
+#include "adaptive_2pc_window.h"
 #include <list>
 #include <atomic>
+#include <dsn/utility/biased_ref_counter.h>
 #include <dsn/utility/link.h>
 
 #ifndef __linux__
@@ -50,10 +52,41 @@ namespace replication {
 class mutation;
 typedef dsn::ref_ptr<mutation> mutation_ptr;
 
+// prepare_batch_ack collects the acks of the mutations carried by one RPC_PREPARE_BATCH
+// message on secondary, to reply the message only once after all of them are acked.
+// The reply is cumulative: it carries the highest decree up to which all the mutations are
+// acked with ERR_OK, along with the error of the first mutation that is not.
+class prepare_batch_ack : public ref_counter
+{
+public:
+    prepare_batch_ack(dsn::message_ex *request, std::vector<decree> &&decrees);
+    ~prepare_batch_ack();
+
+    // ack the mutation at `index` of the batch, the latter acks of the same mutation are
+    // ignored; returns true if all the mutations are acked after this one
+    bool ack(int index, error_code err);
+
+    // valid after all the mutations are acked, `acked_decree` is invalid_decree if the first
+    // mutation is not acked with ERR_OK
+    void get_result(/*out*/ decree &acked_decree, /*out*/ error_code &err) const;
+
+    dsn::message_ex *request() const { return _request; }
+    int size() const { return static_cast<int>(_decrees.size()); }
+
+private:
+    dsn::message_ex *_request;
+    std::vector<decree> _decrees;
+    std::vector<error_code> _results; // ERR_IO_PENDING if not acked yet
+    int _left_count;
+};
+typedef dsn::ref_ptr<prepare_batch_ack> prepare_batch_ack_ptr;
+
 // mutation is the 2pc unit of PacificA, which wraps one or more client requests and add
 // header informations related to PacificA algorithm for them.
 // both header and client request content are put into "data" member.
-class mutation : public ref_counter
+// most references of a mutation are taken and dropped by the worker thread of its replica,
+// which are counted without atomic operations by biased_ref_counter.
+class mutation : public biased_ref_counter
 {
 public:
     mutation();
@@ -76,6 +109,15 @@ public:
             request->add_ref(); // released on dctor
         }
     }
+    // the batched prepare messages carrying this mutation, along with the index in each batch
+    const std::vector<std::pair<prepare_batch_ack_ptr, int>> &prepare_batches() const
+    {
+        return _prepare_batches;
+    }
+    void add_prepare_batch(const prepare_batch_ack_ptr &batch, int index)
+    {
+        _prepare_batches.emplace_back(batch, index);
+    }
     unsigned int left_secondary_ack_count() const { return _left_secondary_ack_count; }
     unsigned int left_potential_secondary_ack_count() const
     {
@@ -88,6 +130,10 @@ public:
         return dsn_now_ms() + gap_ms >= _prepare_ts_ms + timeout_ms;
     }
     uint64_t create_ts_ns() const { return _create_ts_ns; }
+    // when the write queue starts it to be prepared, 0 if it isn't from the write queue or its
+    // commit latency has been sampled
+    uint64_t start_ts_ns() const { return _start_ts_ns; }
+    void set_start_ts_ns(uint64_t ts) { _start_ts_ns = ts; }
     ballot get_ballot() const { return data.header.ballot; }
     decree get_decree() const { return data.header.decree; }
 
@@ -119,6 +165,9 @@ public:
     // >= 1 MB
     bool is_full() const { return _appro_data_bytes >= 1024 * 1024; }
     int appro_data_bytes() const { return _appro_data_bytes; }
+    // count and approximate bytes of the mutations alive in this process
+    static int64_t alive_count() { return s_alive_count.load(std::memory_order_relaxed); }
+    static int64_t alive_bytes() { return s_alive_bytes.load(std::memory_order_relaxed); }
 
     // read & write mutation data
     //
@@ -126,8 +175,13 @@ public:
     // because:
     //   - the private log may be transfered to other node with different program
     //   - the private/shared log may be replayed by different program when server restart
+    //
+    // the header and the metas of the updates are serialized once for each call, while the data of
+    // the updates are shared with the client requests unless they are small or copied explicitly
     void write_to(const std::function<void(const blob &)> &inserter) const;
     void write_to(binary_writer &writer, dsn::message_ex *to) const;
+    // the data of the updates are always copied into `writer`
+    void write_copied_to(binary_writer &writer) const;
     static mutation_ptr read_from(binary_reader &reader, dsn::message_ex *from);
 
     static void write_mutation_header(binary_writer &writer, const mutation_header &header);
@@ -145,7 +199,28 @@ public:
     void set_is_sync_to_child(bool sync_to_child) { _is_sync_to_child = sync_to_child; }
     bool is_sync_to_child() { return _is_sync_to_child; }
 
+    // add a point to the spans of the sampled client requests
+    void trace(const char *event)
+    {
+        if (dsn_unlikely(_traced)) {
+            for (dsn::message_ex *request : client_requests) {
+                if (request != nullptr && request->span != nullptr) {
+                    request->span->add_point(event);
+                }
+            }
+        }
+    }
+
 private:
+    // the header, the count of the updates, and the code, type and length of each update
+    void write_meta_to(binary_writer &writer) const;
+
+    void add_appro_data_bytes(int bytes)
+    {
+        _appro_data_bytes += bytes;
+        s_alive_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
     union
     {
         struct
@@ -161,12 +236,17 @@ private:
     ::dsn::task_ptr _log_task;
     node_tasks _prepare_or_commit_tasks;
     std::vector<dsn::message_ex *> _prepare_requests; // may combine duplicate requests
+    std::vector<std::pair<prepare_batch_ack_ptr, int>> _prepare_batches;
     char _name[60];                                   // app_id.partition_index.ballot.decree
     int _appro_data_bytes;
     uint64_t _create_ts_ns; // for profiling
+    uint64_t _start_ts_ns;
     uint64_t _tid;          // trace id, unique in process
     static std::atomic<uint64_t> s_tid;
+    static std::atomic<int64_t> s_alive_count;
+    static std::atomic<int64_t> s_alive_bytes;
     bool _is_sync_to_child; // for partition split
+    bool _traced{false};    // whether any of the client requests is sampled
 };
 
 class replica;
@@ -194,15 +274,48 @@ public:
                 _current_op_count);
     }
 
+    // return the mutation to be prepared, or nullptr if the request is queued or held in the
+    // batch window (see `write_batch_window_ms`)
     mutation_ptr add_work(task_code code, dsn::message_ex *request, replica *r);
 
+    // whether there is a mutation held in the batch window or waiting for running ones
+    bool has_pending() const { return _pending_mutation != nullptr; }
+
+    // whether a request added now would be prepared at once or coalesced into the pending
+    // mutation, rather than queued behind the mutations waiting for the running ones
+    bool can_accept() const
+    {
+        if (!_hdr.is_empty()) {
+            return false;
+        }
+        return _pending_mutation != nullptr ? !_pending_mutation->is_full() : can_start(0);
+    }
+
+    // called when the batch window ends, return the held mutation if it can be prepared now
+    mutation_ptr flush_pending();
+
     void clear();
     // called when you want to clear the mutation_queue and want to get the remaining messages
     void clear(std::vector<mutation_ptr> &queued_mutations);
 
     // called when the curren operation is completed or replica configuration is change,
     // which triggers further round of operations as returned
-    mutation_ptr check_possible_work(int current_running_count);
+    // `current_running_bytes` is the approximate size of the running operations, which are
+    // also limited by `prepare_window_max_kb`
+    mutation_ptr check_possible_work(int current_running_count, int64_t current_running_bytes = 0);
+
+    // how full the window of the running operations is, by count or by bytes, the larger one
+    double window_usage() const;
+
+    // the max count of the running operations, which is adapted to the commit latency if
+    // [replication] adaptive_2pc_window_enabled is set, see adaptive_2pc_window
+    int max_concurrent_ops() const;
+
+    // called when `mu` is acked by all the secondaries, to sample the commit latency
+    void on_committed(mutation *mu);
+
+    // called when a secondary asks to retry a prepare for being busy
+    void on_secondary_busy() { _adaptive_window.on_secondary_busy(); }
 
 private:
     mutation_ptr unlink_next_workload()
@@ -217,11 +330,27 @@ private:
 
     void reset_max_concurrent_ops(int max_c) { _max_concurrent_op = max_c; }
 
+    // whether an operation of `bytes` can start to run, one operation always can if none is
+    // running, however large it is
+    bool can_start(int bytes) const;
+    mutation_ptr start(mutation_ptr mu)
+    {
+        _current_op_count++;
+        _current_running_bytes += mu->appro_data_bytes();
+        mu->set_start_ts_ns(dsn_now_ns());
+        return mu;
+    }
+
 private:
     int _current_op_count;
     int _max_concurrent_op;
+    int64_t _current_running_bytes;
     bool _batch_write_disabled;
 
+    adaptive_2pc_window _adaptive_window;
+    // whether any write has waited for the count limit since the last commit
+    bool _window_full;
+
     volatile int *_pcount;
     mutation_ptr _pending_mutation;
     slist<mutation> _hdr;
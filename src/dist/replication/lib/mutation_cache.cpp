@@ -27,18 +27,25 @@
 #include "mutation_cache.h"
 #include "mutation.h"
 
+#include <thread>
+
 namespace dsn {
 namespace replication {
 
 mutation_cache::mutation_cache(decree init_decree, int max_count)
+    : _slots(new std::atomic<mutation *>[max_count]), _active_readers(0), _epoch(1)
 {
     _max_count = max_count;
     _array.resize(max_count, nullptr);
+    for (int i = 0; i < max_count; i++) {
+        _slots[i].store(nullptr, std::memory_order_relaxed);
+    }
 
     reset(init_decree, false);
 }
 
 mutation_cache::mutation_cache(const mutation_cache &cache)
+    : _slots(new std::atomic<mutation *>[cache._max_count]), _active_readers(0), _epoch(1)
 {
     _array.clear();
     _array.reserve(cache._array.size());
@@ -52,9 +59,23 @@ mutation_cache::mutation_cache(const mutation_cache &cache)
     _end_idx = cache._end_idx;
     _start_decree = cache._start_decree;
     _end_decree.store(cache._end_decree.load());
+
+    _slot_base_decree.store(cache._slot_base_decree.load());
+    for (int i = 0; i < _max_count; i++) {
+        _slots[i].store(_array[i].get(), std::memory_order_relaxed);
+    }
+    _appro_data_bytes.store(cache._appro_data_bytes.load());
 }
 
-mutation_cache::~mutation_cache() { _array.clear(); }
+mutation_cache::~mutation_cache()
+{
+    // no reader should be active any more
+    dassert(_active_readers.load() == 0,
+            "%d lock-free readers are still active",
+            _active_readers.load());
+    _retired.clear();
+    _array.clear();
+}
 
 error_code mutation_cache::put(mutation_ptr &mu)
 {
@@ -84,7 +105,7 @@ error_code mutation_cache::put(mutation_ptr &mu)
                 mu->data.header.ballot);
     }
 
-    _array[idx] = mu;
+    set_slot(idx, mu);
 
     // update tracking data
     _interval += delta;
@@ -106,7 +127,7 @@ mutation_ptr mutation_cache::pop_min()
 {
     if (_interval > 0) {
         mutation_ptr mu = _array[_start_idx];
-        _array[_start_idx] = nullptr;
+        set_slot(_start_idx, nullptr);
 
         _interval--;
         _start_idx = (_start_idx + 1) % _max_count;
@@ -134,8 +155,12 @@ void mutation_cache::reset(decree init_decree, bool clear_mutations)
 
     if (clear_mutations) {
         for (int i = 0; i < _max_count; i++)
-            _array[i] = nullptr;
+            set_slot(i, nullptr);
+        try_reclaim();
     }
+
+    // slots left by the old decree range are ignored by readers as their decrees mismatch
+    _slot_base_decree.store(init_decree);
 }
 
 mutation_ptr mutation_cache::get_mutation_by_decree(decree decree)
@@ -145,5 +170,98 @@ mutation_ptr mutation_cache::get_mutation_by_decree(decree decree)
     else
         return _array[(_start_idx + (decree - _start_decree) + _max_count) % _max_count];
 }
+
+void mutation_cache::set_slot(int idx, const mutation_ptr &mu)
+{
+    mutation_ptr &old = _array[idx];
+    if (old.get() == mu.get()) {
+        return;
+    }
+
+    _slots[idx].store(mu.get());
+    int64_t bytes = mu == nullptr ? 0 : mu->appro_data_bytes();
+    if (old != nullptr) {
+        bytes -= old->appro_data_bytes();
+        retire(old.get());
+    }
+    _appro_data_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    old = mu;
+}
+
+void mutation_cache::retire(mutation *mu)
+{
+    // `mu` is already unlinked from _slots, so a reader entering after this check can not
+    // see it, and the caller is free to release it at once if there is no reader now
+    if (_active_readers.load() == 0) {
+        return;
+    }
+
+    _retired.emplace_back(_epoch.load(), mu);
+    if (_retired.size() >= RECLAIM_THRESHOLD) {
+        try_reclaim();
+    }
+}
+
+void mutation_cache::try_reclaim()
+{
+    if (_retired.empty()) {
+        return;
+    }
+    if (_active_readers.load() == 0) {
+        _retired.clear();
+        return;
+    }
+
+    // readers entering from now on announce an epoch larger than any retired one, so
+    // the mutations retired before the minimal epoch of active readers are unreachable
+    uint64_t safe_epoch = _epoch.fetch_add(1) + 1;
+    for (const reader_record &r : _readers) {
+        uint64_t e = r.epoch.load();
+        if (e != 0 && e < safe_epoch) {
+            safe_epoch = e;
+        }
+    }
+    while (!_retired.empty() && _retired.front().first < safe_epoch) {
+        _retired.pop_front();
+    }
+}
+
+int mutation_cache::get_mutations_lock_free(decree start,
+                                            decree end,
+                                            /*out*/ std::vector<mutation_ptr> &mutations) const
+{
+    _active_readers.fetch_add(1);
+
+    // occupy a free reader record with the current epoch
+    reader_record *record = nullptr;
+    while (record == nullptr) {
+        uint64_t epoch = _epoch.load();
+        for (reader_record &r : _readers) {
+            uint64_t expected = 0;
+            if (r.epoch.compare_exchange_strong(expected, epoch)) {
+                record = &r;
+                break;
+            }
+        }
+        if (record == nullptr) {
+            std::this_thread::yield();
+        }
+    }
+
+    int count = 0;
+    decree base = _slot_base_decree.load();
+    for (decree d = start; d <= end; d++) {
+        mutation *mu = _slots[slot_index(d, base)].load();
+        if (mu == nullptr || mu->get_decree() != d) {
+            break;
+        }
+        mutations.emplace_back(mu);
+        count++;
+    }
+
+    record->epoch.store(0);
+    _active_readers.fetch_sub(1);
+    return count;
+}
 }
 } // namespace end
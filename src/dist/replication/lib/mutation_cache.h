@@ -29,6 +29,8 @@
 #include "common/replication_common.h"
 #include "mutation.h"
 #include <vector>
+#include <deque>
+#include <memory>
 #include <atomic>
 
 namespace dsn {
@@ -37,6 +39,12 @@ namespace replication {
 // mutation_cache is an in-memory array that stores a limited number
 // (SEE replication_options::max_mutation_count_in_prepare_list) of mutation log entries.
 //
+// All the methods except get_mutations_lock_free() must be called by a single writer
+// (the replica thread). get_mutations_lock_free() may be called by any number of readers
+// concurrently with the writer: every slot is mirrored by an atomic raw pointer, and a
+// mutation unlinked by the writer is retired instead of released until no reader which
+// may still see it is active (epoch based reclamation).
+//
 // Inherited by: prepare_list
 class mutation_cache
 {
@@ -51,12 +59,45 @@ public:
     mutation_ptr get_mutation_by_decree(decree decree);
     void reset(decree init_decree, bool clear_mutations);
 
+    // Append the mutations with continuous decrees in [start, end] to `mutations`, stop at
+    // the first decree which is not in the cache any more. Returns the count appended.
+    // Thread-safe, lock-free, and never blocks the writer.
+    int get_mutations_lock_free(decree start,
+                                decree end,
+                                /*out*/ std::vector<mutation_ptr> &mutations) const;
+
     decree min_decree() const { return _start_decree; }
     decree max_decree() const { return _end_decree; }
     int count() const { return _interval; }
     int capacity() const { return _max_count; }
+    // approximate bytes of the mutations in the cache, can be called from any thread
+    int64_t appro_data_bytes() const { return _appro_data_bytes.load(std::memory_order_relaxed); }
+
+    // count of mutations that are unlinked but not yet released, only for test
+    size_t retired_count() const { return _retired.size(); }
+
+private:
+    // replace the mutation in slot `idx`, the old one is retired
+    void set_slot(int idx, const mutation_ptr &mu);
+    void retire(mutation *mu);
+    void try_reclaim();
+
+    int slot_index(decree d, decree base) const
+    {
+        return static_cast<int>(((d - base) % _max_count + _max_count) % _max_count);
+    }
 
 private:
+    static const int MAX_LOCK_FREE_READERS = 8;
+    static const size_t RECLAIM_THRESHOLD = 32;
+
+    struct reader_record
+    {
+        // epoch announced by the reader occupying this record, 0 if the record is free
+        std::atomic<uint64_t> epoch{0};
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
     std::vector<mutation_ptr> _array;
     int _max_count;
 
@@ -66,6 +107,17 @@ private:
     int _end_idx;
     decree _start_decree;
     std::atomic<decree> _end_decree;
+
+    // _slots[slot_index(d, _slot_base_decree)] mirrors _array for readers, slot_index() is stable between resets
+    std::unique_ptr<std::atomic<mutation *>[]> _slots;
+    std::atomic<int64_t> _appro_data_bytes{0};
+    std::atomic<decree> _slot_base_decree;
+
+    mutable std::atomic<int> _active_readers;
+    mutable std::atomic<uint64_t> _epoch;
+    mutable reader_record _readers[MAX_LOCK_FREE_READERS];
+    // <epoch when unlinked, mutation>, only accessed by the writer
+    std::deque<std::pair<uint64_t, mutation_ptr>> _retired;
 };
 }
 } // namespace
@@ -31,12 +31,79 @@
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/crc.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/tool-api/async_calls.h>
 
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  log_shared_max_inflight_writes,
+                  1,
+                  "max count of concurrent writes of shared log, 1 means only one write is allowed "
+                  "at the same time; if larger than 1, the pending mutations are group committed "
+                  "in an adaptive batch size while there are writes in flight");
+DSN_DEFINE_uint32("replication",
+                  log_shared_group_commit_min_batch_kb,
+                  4,
+                  "min batch size of shared log group commit when there are writes in flight");
+DSN_DEFINE_uint32("replication",
+                  log_shared_group_commit_max_batch_kb,
+                  1024,
+                  "max batch size of shared log group commit when there are writes in flight");
+DSN_DEFINE_uint32("replication",
+                  log_shared_replay_thread_count,
+                  4,
+                  "thread count to decode and dispatch mutations respectively when replaying "
+                  "shared log on startup, mutations of the same replica are always replayed in "
+                  "log order; 0 or 1 means replaying in the calling thread");
+DSN_DEFINE_uint32("replication",
+                  log_private_append_latency_target_us,
+                  0,
+                  "the target of private log append latency, the flush interval of private logs "
+                  "is adjusted by the arrival rate of mutations and the write latency to keep "
+                  "the latency under it; 0 means using log_private_batch_buffer_flush_interval_ms");
+DSN_DEFINE_bool("replication",
+                log_file_preallocate,
+                false,
+                "whether to preallocate the log files to max_log_file_mb and reuse the gc'ed ones, "
+                "so the writes don't allocate blocks or grow the files; the preallocated files "
+                "can't be read by the older versions");
+DSN_DEFINE_uint32("replication",
+                  log_file_recycle_count,
+                  4,
+                  "max count of the gc'ed log files kept for reuse by each log if "
+                  "log_file_preallocate is enabled");
+
+mutation_log_shared::mutation_log_shared(const std::string &dir,
+                                         int32_t max_log_file_mb,
+                                         bool force_flush,
+                                         perf_counter_wrapper *write_size_counter,
+                                         perf_counter_wrapper *batch_size_counter,
+                                         perf_counter_wrapper *batch_mutation_count_counter,
+                                         perf_counter_wrapper *batch_queueing_delay_counter)
+    : mutation_log(dir, max_log_file_mb, dsn::gpid(), nullptr),
+      _pending_write_start_time_ns(0),
+      _inflight_write_count(0),
+      _commit_lock(true),
+      _max_inflight_writes(std::max(FLAGS_log_shared_max_inflight_writes, 1u)),
+      _group_commit_batch_bytes(FLAGS_log_shared_group_commit_min_batch_kb * 1024),
+      _ewma_write_latency_us(0),
+      _ewma_incoming_bytes_per_us(0),
+      _last_issue_time_ns(0),
+      _force_flush(force_flush),
+      _write_size_counter(write_size_counter),
+      _batch_size_counter(batch_size_counter),
+      _batch_mutation_count_counter(batch_mutation_count_counter),
+      _batch_queueing_delay_counter(batch_queueing_delay_counter)
+{
+}
+
 ::dsn::task_ptr mutation_log_shared::append(mutation_ptr &mu,
                                             dsn::task_code callback_code,
                                             dsn::task_tracker *tracker,
@@ -55,6 +122,7 @@ namespace replication {
     // init pending buffer
     if (nullptr == _pending_write) {
         _pending_write = std::make_shared<log_appender>(mark_new_offset(0, true).second);
+        _pending_write_start_time_ns = dsn_now_ns();
     }
     _pending_write->append_mutation(mu, cb);
 
@@ -62,7 +130,7 @@ namespace replication {
     update_max_decree(mu->data.header.pid, d);
 
     // start to write if possible
-    if (!_is_writing.load(std::memory_order_acquire)) {
+    if (should_issue_write()) {
         write_pending_mutations(true);
         if (pending_size) {
             *pending_size = 0;
@@ -84,69 +152,113 @@ void mutation_log_shared::flush_internal(int max_count)
 {
     int count = 0;
     while (max_count <= 0 || count < max_count) {
-        if (_is_writing.load(std::memory_order_acquire)) {
+        if (_inflight_write_count.load(std::memory_order_acquire) > 0) {
             _tracker.wait_outstanding_tasks();
         } else {
             _slock.lock();
-            if (_is_writing.load(std::memory_order_acquire)) {
+            if (_inflight_write_count.load(std::memory_order_acquire) > 0) {
                 _slock.unlock();
                 continue;
             }
             if (!_pending_write) {
-                // !_is_writing && !_pending_write, means flush done
+                // no write in flight && !_pending_write, means flush done
                 _slock.unlock();
                 break;
             }
-            // !_is_writing && _pending_write, start next write
+            // no write in flight && _pending_write, start next write
             write_pending_mutations(true);
             count++;
         }
     }
 }
 
+bool mutation_log_shared::should_issue_write() const
+{
+    if (_inflight_writes.empty()) {
+        return true;
+    }
+    return _inflight_writes.size() < _max_inflight_writes &&
+           _pending_write->size() >= _group_commit_batch_bytes;
+}
+
+void mutation_log_shared::update_group_commit_batch_bytes()
+{
+    if (_max_inflight_writes <= 1) {
+        return;
+    }
+
+    // make the in-flight writes just cover the incoming bytes during one write, so that
+    // the disk keeps busy while the batches are as large as possible
+    double bytes = _ewma_write_latency_us * _ewma_incoming_bytes_per_us / _max_inflight_writes;
+    size_t min_bytes = FLAGS_log_shared_group_commit_min_batch_kb * 1024;
+    size_t max_bytes = std::max(FLAGS_log_shared_group_commit_max_batch_kb,
+                                FLAGS_log_shared_group_commit_min_batch_kb) *
+                       1024;
+    _group_commit_batch_bytes =
+        std::min(std::max(static_cast<size_t>(bytes), min_bytes), max_bytes);
+}
+
 void mutation_log_shared::write_pending_mutations(bool release_lock_required)
 {
     dassert(release_lock_required, "lock must be hold at this point");
-    dassert(!_is_writing.load(std::memory_order_relaxed), "");
+    dassert(_inflight_writes.size() < _max_inflight_writes,
+            "too many writes in flight: %d",
+            (int)_inflight_writes.size());
     dassert(_pending_write != nullptr, "");
     dassert(_pending_write->size() > 0, "pending write size = %d", (int)_pending_write->size());
     auto pr = mark_new_offset(_pending_write->size(), false);
     dcheck_eq(pr.second, _pending_write->start_offset());
 
-    _is_writing.store(true, std::memory_order_release);
+    uint64_t now_ns = dsn_now_ns();
+    size_t batch_size = _pending_write->size();
+    if (_batch_size_counter) {
+        (*_batch_size_counter)->set(batch_size);
+    }
+    if (_batch_mutation_count_counter) {
+        (*_batch_mutation_count_counter)->set(_pending_write->mutation_count());
+    }
+    if (_batch_queueing_delay_counter) {
+        (*_batch_queueing_delay_counter)->set((now_ns - _pending_write_start_time_ns) / 1000);
+    }
+    if (_last_issue_time_ns > 0 && now_ns > _last_issue_time_ns) {
+        double rate = static_cast<double>(batch_size) * 1000 / (now_ns - _last_issue_time_ns);
+        _ewma_incoming_bytes_per_us = _ewma_incoming_bytes_per_us * 0.8 + rate * 0.2;
+        update_group_commit_batch_bytes();
+    }
+    _last_issue_time_ns = now_ns;
 
     // move or reset pending variables
-    auto pending = std::move(_pending_write);
-
-    // seperate commit_log_block from within the lock
+    auto write = std::make_shared<inflight_write>();
+    write->pending = std::move(_pending_write);
+    write->issue_time_ns = now_ns;
+    _inflight_writes.push_back(write);
+    _inflight_write_count.fetch_add(1, std::memory_order_release);
+
+    // seperate commit_log_block from within the lock, but the blocks must be committed
+    // in the order of offsets, so hand over to _commit_lock before releasing _slock
+    _commit_lock.lock();
     _slock.unlock();
-    commit_pending_mutations(pr.first, pending);
+    commit_pending_mutations(pr.first, write);
+    _commit_lock.unlock();
 }
 
 void mutation_log_shared::commit_pending_mutations(log_file_ptr &lf,
-                                                   std::shared_ptr<log_appender> &pending)
+                                                   const inflight_write_ptr &write)
 {
     lf->commit_log_blocks( // forces a new line for params
-        *pending,
+        *write->pending,
         LPC_WRITE_REPLICATION_LOG_SHARED,
         &_tracker,
-        [this, lf, pending](error_code err, size_t sz) mutable {
-            dassert(_is_writing.load(std::memory_order_relaxed), "");
+        [this, lf, write](error_code err, size_t sz) mutable {
+            dassert(_inflight_write_count.load(std::memory_order_relaxed) > 0, "");
 
-            for (auto &block : pending->all_blocks()) {
+            for (auto &block : write->pending->all_blocks()) {
                 auto hdr = (log_block_header *)block.front().data();
                 dassert(hdr->magic == 0xdeadbeef, "header magic is changed: 0x%x", hdr->magic);
             }
 
             if (err == ERR_OK) {
-                dcheck_eq(sz, pending->size());
-
-                if (_force_flush) {
-                    // flush to ensure that shared log data synced to disk
-                    //
-                    // FIXME : the file could have been closed
-                    lf->flush();
-                }
+                dcheck_eq(sz, write->pending->size());
 
                 if (_write_size_counter) {
                     (*_write_size_counter)->add(sz);
@@ -155,29 +267,73 @@ void mutation_log_shared::commit_pending_mutations(log_file_ptr &lf,
                 derror("write shared log failed, err = %s", err.to_string());
             }
 
-            // here we use _is_writing instead of _issued_write.expired() to check writing done,
-            // because the following callbacks may run before "block" released, which may cause
-            // the next init_prepare() not starting the write.
-            _is_writing.store(false, std::memory_order_relaxed);
-
-            // notify the callbacks
-            // ATTENTION: callback may be called before this code block executed done.
-            for (auto &c : pending->callbacks()) {
-                c->enqueue(err, sz);
-            }
+            on_write_completed(write, err, sz);
+        },
+        0,
+        // ensure that shared log data synced to disk before the callbacks
+        _force_flush);
+}
 
-            // start to write next if possible
-            if (err == ERR_OK) {
-                _slock.lock();
+void mutation_log_shared::on_write_completed(const inflight_write_ptr &write,
+                                             error_code err,
+                                             size_t size)
+{
+    std::vector<inflight_write_ptr> completed;
 
-                if (!_is_writing.load(std::memory_order_acquire) && _pending_write) {
-                    write_pending_mutations(true);
-                } else {
-                    _slock.unlock();
+    // the writes may complete out of order, so the callbacks are only notified when
+    // all the previous writes complete
+    _callback_lock.lock();
+    {
+        zauto_lock l(_slock);
+        write->done = true;
+        write->err = err;
+        write->size = size;
+
+        double latency_us = static_cast<double>(dsn_now_ns() - write->issue_time_ns) / 1000;
+        _ewma_write_latency_us = _ewma_write_latency_us > 0
+                                     ? _ewma_write_latency_us * 0.8 + latency_us * 0.2
+                                     : latency_us;
+
+        while (!_inflight_writes.empty() && _inflight_writes.front()->done) {
+            inflight_write_ptr &w = _inflight_writes.front();
+            error_code e = (w->err != ERR_OK) ? w->err : w->previous_err;
+            if (e != ERR_OK) {
+                for (auto &next : _inflight_writes) {
+                    if (next->previous_err == ERR_OK) {
+                        next->previous_err = e;
+                    }
                 }
             }
-        },
-        0);
+            w->err = e;
+            completed.emplace_back(std::move(w));
+            _inflight_writes.pop_front();
+        }
+
+        // here we use _inflight_write_count instead of the life time of the log blocks to
+        // check writing done, because the following callbacks may run before "block" released,
+        // which may cause the next init_prepare() not starting the write.
+        _inflight_write_count.fetch_sub(completed.size(), std::memory_order_relaxed);
+    }
+
+    // notify the callbacks
+    // ATTENTION: callback may be called before this code block executed done.
+    for (auto &w : completed) {
+        for (auto &c : w->pending->callbacks()) {
+            c->enqueue(w->err, w->size);
+        }
+    }
+    _callback_lock.unlock();
+
+    // start to write next if possible
+    if (err == ERR_OK) {
+        _slock.lock();
+
+        if (_pending_write && should_issue_write()) {
+            write_pending_mutations(true);
+        } else {
+            _slock.unlock();
+        }
+    }
 }
 
 ////////////////////////////////////////////////////
@@ -193,9 +349,61 @@ mutation_log_private::mutation_log_private(const std::string &dir,
       replica_base(r),
       _batch_buffer_bytes(batch_buffer_bytes),
       _batch_buffer_max_count(batch_buffer_max_count),
-      _batch_buffer_flush_interval_ms(batch_buffer_flush_interval_ms)
+      _batch_buffer_flush_interval_ms(batch_buffer_flush_interval_ms),
+      _flush_interval_us(batch_buffer_flush_interval_ms * 1000),
+      _last_append_time_us(0),
+      _ewma_append_interval_us(0),
+      _ewma_write_latency_us(0),
+      _ewma_write_latency_dev_us(0)
 {
     mutation_log_private::init_states();
+
+    _counter_batch_mutation_count.init_app_counter("eon.replica",
+                                                   "private.log.batch.mutation.count",
+                                                   COUNTER_TYPE_NUMBER_PERCENTILES,
+                                                   "mutation count of each private log write");
+    _counter_flush_interval.init_app_counter("eon.replica",
+                                             "private.log.flush.interval(us)",
+                                             COUNTER_TYPE_NUMBER_PERCENTILES,
+                                             "effective flush interval of private logs");
+}
+
+/*static*/ uint64_t mutation_log_private::get_adaptive_flush_interval_us(
+    uint64_t target_us,
+    double append_interval_us,
+    double write_latency_us,
+    double write_latency_dev_us)
+{
+    // estimate the high percentile of write latency like the tcp retransmission timeout
+    double high_write_latency_us = write_latency_us + 4 * write_latency_dev_us;
+    if (high_write_latency_us >= target_us) {
+        return 0;
+    }
+    double budget_us = target_us - high_write_latency_us;
+    return append_interval_us < budget_us ? static_cast<uint64_t>(budget_us) : 0;
+}
+
+void mutation_log_private::update_flush_interval(uint64_t write_latency_us)
+{
+    if (FLAGS_log_private_append_latency_target_us == 0) {
+        _flush_interval_us = _batch_buffer_flush_interval_ms * 1000;
+        return;
+    }
+
+    double latency_us = static_cast<double>(write_latency_us);
+    if (_ewma_write_latency_us > 0) {
+        double dev_us = std::abs(latency_us - _ewma_write_latency_us);
+        _ewma_write_latency_dev_us = _ewma_write_latency_dev_us * 0.8 + dev_us * 0.2;
+        _ewma_write_latency_us = _ewma_write_latency_us * 0.8 + latency_us * 0.2;
+    } else {
+        _ewma_write_latency_us = latency_us;
+    }
+
+    _flush_interval_us = get_adaptive_flush_interval_us(FLAGS_log_private_append_latency_target_us,
+                                                        _ewma_append_interval_us,
+                                                        _ewma_write_latency_us,
+                                                        _ewma_write_latency_dev_us);
+    _counter_flush_interval->set(_flush_interval_us);
 }
 
 ::dsn::task_ptr mutation_log_private::append(mutation_ptr &mu,
@@ -205,16 +413,28 @@ mutation_log_private::mutation_log_private(const std::string &dir,
                                              int hash,
                                              int64_t *pending_size)
 {
-    dassert(nullptr == callback, "callback is not needed in private mutation log");
+    dassert(nullptr == callback || nullptr != _sync_coordinator,
+            "callback is only needed in private mutation log when shared log is disabled");
+    ::dsn::aio_task_ptr cb =
+        callback ? file::create_aio_task(
+                       callback_code, tracker, std::forward<aio_handler>(callback), hash)
+                 : nullptr;
 
     _plock.lock();
 
+    uint64_t now_us = dsn_now_us();
+    if (_last_append_time_us > 0 && now_us > _last_append_time_us) {
+        double interval_us = static_cast<double>(now_us - _last_append_time_us);
+        _ewma_append_interval_us = _ewma_append_interval_us * 0.8 + interval_us * 0.2;
+    }
+    _last_append_time_us = now_us;
+
     // init pending buffer
     if (nullptr == _pending_write) {
         _pending_write = make_unique<log_appender>(mark_new_offset(0, true).second);
-        _pending_write_start_time_ms = dsn_now_ms();
+        _pending_write_start_time_us = now_us;
     }
-    _pending_write->append_mutation(mu, nullptr);
+    _pending_write->append_mutation(mu, cb);
 
     // update meta
     _pending_write_max_commit =
@@ -223,7 +443,8 @@ mutation_log_private::mutation_log_private(const std::string &dir,
 
     // start to write if possible
     if (!_is_writing.load(std::memory_order_acquire) &&
-        (static_cast<uint32_t>(_pending_write->size()) >= _batch_buffer_bytes ||
+        (_sync_coordinator != nullptr ||
+         static_cast<uint32_t>(_pending_write->size()) >= _batch_buffer_bytes ||
          static_cast<uint32_t>(_pending_write->blob_count()) >= _batch_buffer_max_count ||
          flush_interval_expired())) {
         write_pending_mutations(true);
@@ -237,7 +458,7 @@ mutation_log_private::mutation_log_private(const std::string &dir,
         _plock.unlock();
     }
 
-    return nullptr;
+    return cb;
 }
 
 bool mutation_log_private::get_learn_state_in_memory(decree start_decree,
@@ -350,7 +571,8 @@ void mutation_log_private::init_states()
     _is_writing.store(false, std::memory_order_release);
     _issued_write.reset();
     _pending_write = nullptr;
-    _pending_write_start_time_ms = 0;
+    _pending_write_start_time_us = 0;
+    _issued_write_start_time_us = 0;
     _pending_write_max_commit = 0;
     _pending_write_max_decree = 0;
 }
@@ -371,7 +593,9 @@ void mutation_log_private::write_pending_mutations(bool release_lock_required)
     // move or reset pending variables
     std::shared_ptr<log_appender> pending = std::move(_pending_write);
     _issued_write = pending;
-    _pending_write_start_time_ms = 0;
+    _issued_write_start_time_us = dsn_now_us();
+    _counter_batch_mutation_count->set(pending->mutation_count());
+    _pending_write_start_time_us = 0;
     decree max_commit = _pending_write_max_commit;
     _pending_write_max_commit = 0;
     _pending_write_max_decree = 0;
@@ -400,6 +624,9 @@ void mutation_log_private::commit_pending_mutations(log_file_ptr &lf,
 
             if (err != ERR_OK) {
                 derror("write private log failed, err = %s", err.to_string());
+                for (auto &c : pending->callbacks()) {
+                    c->enqueue(err, sz);
+                }
                 _is_writing.store(false, std::memory_order_relaxed);
                 if (_io_error_callback) {
                     _io_error_callback(err);
@@ -408,30 +635,49 @@ void mutation_log_private::commit_pending_mutations(log_file_ptr &lf,
             }
             dcheck_eq(sz, pending->size());
 
+            if (_sync_coordinator != nullptr) {
+                _sync_coordinator->sync(lf, [this, pending, max_commit, sz]() {
+                    on_pending_mutations_durable(pending, max_commit, sz);
+                });
+                return;
+            }
+
             // flush to ensure that there is no gap between private log and in-memory buffer
             // so that we can get all mutations in learning process.
             //
             // FIXME : the file could have been closed
             lf->flush();
 
-            // update _private_max_commit_on_disk after written into log file done
-            update_max_commit_on_disk(max_commit);
+            on_pending_mutations_durable(pending, max_commit, sz);
+        },
+        0);
+}
+
+void mutation_log_private::on_pending_mutations_durable(
+    const std::shared_ptr<log_appender> &pending, decree max_commit, size_t size)
+{
+    // update _private_max_commit_on_disk after written into log file done
+    update_max_commit_on_disk(max_commit);
 
-            _is_writing.store(false, std::memory_order_relaxed);
+    _is_writing.store(false, std::memory_order_relaxed);
 
-            // start to write if possible
-            _plock.lock();
+    for (auto &c : pending->callbacks()) {
+        c->enqueue(ERR_OK, size);
+    }
 
-            if (!_is_writing.load(std::memory_order_acquire) && _pending_write &&
-                (static_cast<uint32_t>(_pending_write->size()) >= _batch_buffer_bytes ||
-                 static_cast<uint32_t>(_pending_write->blob_count()) >= _batch_buffer_max_count ||
-                 flush_interval_expired())) {
-                write_pending_mutations(true);
-            } else {
-                _plock.unlock();
-            }
-        },
-        0);
+    // start to write if possible
+    _plock.lock();
+    update_flush_interval(dsn_now_us() - _issued_write_start_time_us);
+
+    if (!_is_writing.load(std::memory_order_acquire) && _pending_write &&
+        (_sync_coordinator != nullptr ||
+         static_cast<uint32_t>(_pending_write->size()) >= _batch_buffer_bytes ||
+         static_cast<uint32_t>(_pending_write->blob_count()) >= _batch_buffer_max_count ||
+         flush_interval_expired())) {
+        write_pending_mutations(true);
+    } else {
+        _plock.unlock();
+    }
 }
 
 ///////////////////////////////////////////////////////////////
@@ -482,13 +728,8 @@ error_code mutation_log::open(replay_callback read_callback,
     return open(read_callback, write_error_callback, replay_condition);
 }
 
-error_code mutation_log::open(replay_callback read_callback,
-                              io_failure_callback write_error_callback,
-                              const std::map<gpid, decree> &replay_condition)
+error_code mutation_log::load_log_files()
 {
-    dassert(!_is_opened, "cannot open a opened mutation_log");
-    dassert(nullptr == _current_log_file, "the current log file must be null at this point");
-
     // create dir if necessary
     if (!dsn::utils::filesystem::path_exists(_dir)) {
         if (!dsn::utils::filesystem::create_directory(_dir)) {
@@ -499,7 +740,6 @@ error_code mutation_log::open(replay_callback read_callback,
 
     // load the existing logs
     _log_files.clear();
-    _io_error_callback = write_error_callback;
 
     std::vector<std::string> file_list;
     if (!dsn::utils::filesystem::get_subfiles(_dir, file_list, false)) {
@@ -507,10 +747,6 @@ error_code mutation_log::open(replay_callback read_callback,
         return ERR_FILE_OPERATION_FAILED;
     }
 
-    if (nullptr == read_callback) {
-        dassert(file_list.size() == 0, "log must be empty if callback is not present");
-    }
-
     std::sort(file_list.begin(), file_list.end());
 
     error_code err = ERR_OK;
@@ -549,7 +785,82 @@ error_code mutation_log::open(replay_callback read_callback,
         _log_files[log->index()] = log;
     }
 
-    file_list.clear();
+    // a preallocated file is larger than its data, which ends where the next file starts
+    for (auto it = _log_files.begin(); it != _log_files.end(); ++it) {
+        auto next = std::next(it);
+        if (it->second->is_preallocated() && next != _log_files.end() &&
+            next->first == it->first + 1) {
+            it->second->set_end_offset(next->second->start_offset());
+        }
+    }
+
+    return ERR_OK;
+}
+
+error_code mutation_log::open_without_replay(const mutation_log_tail &tail,
+                                             io_failure_callback write_error_callback)
+{
+    dassert(_is_private, "only private log can be opened without replay");
+    dassert(!_is_opened, "cannot open a opened mutation_log");
+    dassert(nullptr == _current_log_file, "the current log file must be null at this point");
+
+    _io_error_callback = write_error_callback;
+    error_code err = load_log_files();
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    // the files must not be changed since the tail is recorded, and the new mutations are
+    // appended to a new file, so the tail must be the end of the data of the last file
+    bool matched = false;
+    if (!_log_files.empty()) {
+        const log_file_ptr &last = _log_files.rbegin()->second;
+        matched = _log_files.rbegin()->first == tail.last_file_index &&
+                  tail.end_offset >= last->start_offset() &&
+                  (last->is_preallocated() ? tail.end_offset <= last->end_offset()
+                                           : tail.end_offset == last->end_offset());
+    }
+    if (!matched) {
+        dwarn("the tail of private log %s mismatches, last_file_index = %d, end_offset = %" PRId64,
+              _dir.c_str(),
+              tail.last_file_index,
+              tail.end_offset);
+        // keep the valid start offset set on open for the replay
+        for (auto &kv : _log_files) {
+            kv.second->close();
+        }
+        _log_files.clear();
+        return ERR_INCOMPLETE_DATA;
+    }
+    _log_files.rbegin()->second->set_end_offset(tail.end_offset);
+
+    {
+        zauto_lock l(_lock);
+        update_max_decree_no_lock(_private_gpid, tail.max_decree);
+        update_max_commit_on_disk_no_lock(tail.max_commit_on_disk);
+        _global_start_offset = _log_files.begin()->second->start_offset();
+        _global_end_offset = tail.end_offset;
+        _last_file_index = _log_files.rbegin()->first;
+        _is_opened = true;
+    }
+    return ERR_OK;
+}
+
+error_code mutation_log::open(replay_callback read_callback,
+                              io_failure_callback write_error_callback,
+                              const std::map<gpid, decree> &replay_condition)
+{
+    dassert(!_is_opened, "cannot open a opened mutation_log");
+    dassert(nullptr == _current_log_file, "the current log file must be null at this point");
+
+    _io_error_callback = write_error_callback;
+    error_code err = load_log_files();
+    if (err != ERR_OK) {
+        return err;
+    }
+    if (nullptr == read_callback) {
+        dassert(_log_files.empty(), "log must be empty if callback is not present");
+    }
 
     // filter useless log
     std::map<int, log_file_ptr>::iterator replay_begin = _log_files.begin();
@@ -629,11 +940,15 @@ error_code mutation_log::open(replay_callback read_callback,
     }
 
     // replay with the found files
+    // private logs are replayed in the calling thread, as the replicas are loaded concurrently
     std::map<int, log_file_ptr> replay_logs(replay_begin, replay_end);
+    uint32_t replay_thread_count = _is_private ? 1 : FLAGS_log_shared_replay_thread_count;
+    // mutations of different gpids may be replayed concurrently
+    std::mutex update_lock;
     int64_t end_offset = 0;
     err = replay(
         replay_logs,
-        [this, read_callback](int log_length, mutation_ptr &mu) {
+        [this, read_callback, &update_lock](int log_length, mutation_ptr &mu) {
             bool ret = true;
 
             if (read_callback) {
@@ -642,6 +957,7 @@ error_code mutation_log::open(replay_callback read_callback,
             }
 
             if (ret) {
+                std::lock_guard<std::mutex> l(update_lock);
                 this->update_max_decree_no_lock(mu->data.header.pid, mu->data.header.decree);
                 if (this->_is_private) {
                     this->update_max_commit_on_disk_no_lock(mu->data.header.last_committed_decree);
@@ -650,7 +966,8 @@ error_code mutation_log::open(replay_callback read_callback,
 
             return ret;
         },
-        end_offset);
+        end_offset,
+        replay_thread_count);
 
     if (ERR_OK == err) {
         _global_start_offset =
@@ -699,12 +1016,47 @@ void mutation_log::close()
     init_states();
 }
 
+void mutation_log::close(/*out*/ mutation_log_tail &tail)
+{
+    dassert(_is_private, "only the tail of private log is recorded");
+    {
+        zauto_lock l(_lock);
+        if (!_is_opened) {
+            tail = {0, 0, 0, 0};
+            return;
+        }
+    }
+
+    // all the reserved data is written after flush
+    flush();
+
+    {
+        zauto_lock l(_lock);
+        tail.last_file_index = _last_file_index;
+        tail.end_offset = _global_end_offset;
+        tail.max_decree = _private_log_info.max_decree;
+        tail.max_commit_on_disk = _private_max_commit_on_disk;
+    }
+    close();
+}
+
 error_code mutation_log::create_new_log_file()
 {
     // create file
     uint64_t start = dsn_now_ns();
-    log_file_ptr logf =
-        log_file::create_write(_dir.c_str(), _last_file_index + 1, _global_end_offset);
+    int64_t preallocate_size = 0;
+    std::string recycled_path;
+    if (FLAGS_log_file_preallocate) {
+        preallocate_size = _max_log_file_size_in_bytes;
+        std::vector<std::string> recycled_files;
+        if (dsn::utils::filesystem::get_subfiles(
+                utils::filesystem::path_combine(_dir, "recycle"), recycled_files, false) &&
+            !recycled_files.empty()) {
+            recycled_path = recycled_files.front();
+        }
+    }
+    log_file_ptr logf = log_file::create_write(
+        _dir.c_str(), _last_file_index + 1, _global_end_offset, preallocate_size, recycled_path);
     if (logf == nullptr) {
         derror("cannot create log file with index %d", _last_file_index + 1);
         return ERR_FILE_OPERATION_FAILED;
@@ -780,6 +1132,25 @@ error_code mutation_log::create_new_log_file()
     return ERR_OK;
 }
 
+bool mutation_log::remove_log_file(const std::string &fpath)
+{
+    if (FLAGS_log_file_preallocate && FLAGS_log_file_recycle_count > 0) {
+        std::string recycle_dir = utils::filesystem::path_combine(_dir, "recycle");
+        std::vector<std::string> recycled_files;
+        if (dsn::utils::filesystem::create_directory(recycle_dir) &&
+            dsn::utils::filesystem::get_subfiles(recycle_dir, recycled_files, false) &&
+            recycled_files.size() < FLAGS_log_file_recycle_count) {
+            std::string recycled_path = utils::filesystem::path_combine(
+                recycle_dir, utils::filesystem::get_file_name(fpath));
+            if (dsn::utils::filesystem::rename_path(fpath, recycled_path)) {
+                ddebug_f("log file {} is recycled as {}", fpath, recycled_path);
+                return true;
+            }
+        }
+    }
+    return dsn::utils::filesystem::remove_path(fpath);
+}
+
 std::pair<log_file_ptr, int64_t> mutation_log::mark_new_offset(size_t size,
                                                                bool create_new_log_if_needed)
 {
@@ -1301,7 +1672,7 @@ int mutation_log::garbage_collection(gpid gpid,
 
         // delete file
         auto &fpath = log->path();
-        if (!dsn::utils::filesystem::remove_path(fpath)) {
+        if (!remove_log_file(fpath)) {
             derror("gc_private @ %d.%d: fail to remove %s, stop current gc cycle ...",
                    _private_gpid.get_app_id(),
                    _private_gpid.get_partition_index(),
@@ -1331,15 +1702,14 @@ int mutation_log::garbage_collection(const replica_log_info_map &gc_condition,
 {
     dassert(!_is_private, "this method is only valid for shared log");
 
+    zauto_lock gc_l(_gc_lock);
     std::map<int, log_file_ptr> files;
-    replica_log_info_map max_decrees;
     int current_log_index = -1;
     int64_t total_log_size = 0;
 
     {
         zauto_lock l(_lock);
         files = _log_files;
-        max_decrees = _shared_log_info_map;
         if (_current_log_file != nullptr)
             current_log_index = _current_log_file->index();
         total_log_size = total_size_no_lock();
@@ -1366,146 +1736,126 @@ int mutation_log::garbage_collection(const replica_log_info_map &gc_condition,
     int reserved_smallest_log = files.begin()->first;
     int reserved_largest_log = current_log_index;
 
-    // find the largest file which can be deleted.
-    // after iterate, the 'mark_it' will point to the largest file which can be deleted.
-    std::map<int, log_file_ptr>::reverse_iterator mark_it;
-    std::set<gpid> kickout_replicas;
-    gpid stop_gc_replica;
-    int stop_gc_log_index = 0;
-    decree stop_gc_decree_gap = 0;
-    decree stop_gc_garbage_max_decree = 0;
-    decree stop_gc_log_max_decree = 0;
-    int file_count = 0;
-    for (mark_it = files.rbegin(); mark_it != files.rend(); ++mark_it) {
-        log_file_ptr log = mark_it->second;
-        dassert(mark_it->first == log->index(), "%d VS %d", mark_it->first, log->index());
-        file_count++;
-
-        bool delete_ok = true;
-
-        // skip current file
-        if (current_log_index == log->index()) {
-            delete_ok = false;
+    // the files which may be deleted are all except the newest one, the max decrees of the
+    // replicas in each of them are the previous max decrees of the next file
+    std::vector<log_file_ptr> candidates;
+    std::vector<const replica_log_info_map *> max_decrees;
+    for (auto it = files.begin(); std::next(it) != files.end(); ++it) {
+        dassert(it->first == it->second->index(), "%d VS %d", it->first, it->second->index());
+        candidates.push_back(it->second);
+        max_decrees.push_back(&std::next(it)->second->previous_log_max_decrees());
+    }
+    int oldest_index = candidates.front()->index();
+    int newest_index = candidates.back()->index();
+
+    // whether the k-th candidate and all the older ones can be deleted for the replica
+    auto deletable = [&](const gpid &pid, const replica_log_info &condition, size_t k) {
+        const log_file_ptr &log = candidates[k];
+        auto it = max_decrees[k]->find(pid);
+        if (it == max_decrees[k]->end()) {
+            // valid_start_offset may be reset to 0 if initialize_on_load() returns
+            // ERR_INCOMPLETE_DATA
+            dassert(condition.valid_start_offset == 0 ||
+                        condition.valid_start_offset >= log->end_offset(),
+                    "valid start offset must be 0 or greater than the end of this log file");
+            return true;
         }
-
-        if (delete_ok) {
-            std::set<gpid> prevent_gc_replicas_for_this_log;
-
-            for (auto &kv : gc_condition) {
-                if (kickout_replicas.find(kv.first) != kickout_replicas.end()) {
-                    // no need to consider this replica
-                    continue;
-                }
-
-                gpid gpid = kv.first;
-                decree garbage_max_decree = kv.second.max_decree;
-                int64_t valid_start_offset = kv.second.valid_start_offset;
-
-                bool delete_ok_for_this_replica = false;
-                bool kickout_this_replica = false;
-                auto it3 = max_decrees.find(gpid);
-
-                // log not found for this replica, ok to delete
-                if (it3 == max_decrees.end()) {
-                    // valid_start_offset may be reset to 0 if initialize_on_load() returns
-                    // ERR_INCOMPLETE_DATA
-                    dassert(
-                        valid_start_offset == 0 || valid_start_offset >= log->end_offset(),
-                        "valid start offset must be 0 or greater than the end of this log file");
-
-                    dinfo("gc @ %d.%d: max_decree for %s is missing vs %" PRId64
-                          " as garbage max decree,"
-                          " safe to delete this and all older logs for this replica",
-                          gpid.get_app_id(),
-                          gpid.get_partition_index(),
-                          log->path().c_str(),
-                          garbage_max_decree);
-                    delete_ok_for_this_replica = true;
-                    kickout_this_replica = true;
-                }
-
-                // log is invalid for this replica, ok to delete
-                else if (log->end_offset() <= valid_start_offset) {
-                    dinfo(
-                        "gc @ %d.%d: log is invalid for %s, as"
-                        " valid start offset vs log end offset = %" PRId64 " vs %" PRId64 ","
-                        " it is therefore safe to delete this and all older logs for this replica",
-                        gpid.get_app_id(),
-                        gpid.get_partition_index(),
-                        log->path().c_str(),
-                        valid_start_offset,
-                        log->end_offset());
-                    delete_ok_for_this_replica = true;
-                    kickout_this_replica = true;
-                }
-
-                // all decrees are no more than garbage max decree, ok to delete
-                else if (it3->second.max_decree <= garbage_max_decree) {
-                    dinfo(
-                        "gc @ %d.%d: max_decree for %s is %" PRId64 " vs %" PRId64
-                        " as garbage max decree,"
-                        " it is therefore safe to delete this and all older logs for this replica",
-                        gpid.get_app_id(),
-                        gpid.get_partition_index(),
-                        log->path().c_str(),
-                        it3->second.max_decree,
-                        garbage_max_decree);
-                    delete_ok_for_this_replica = true;
-                    kickout_this_replica = true;
-                }
-
-                else // it3->second.max_decree > garbage_max_decree
-                {
-                    // should not delete this file
-                    dinfo("gc @ %d.%d: max_decree for %s is %" PRId64 " vs %" PRId64
-                          " as garbage max decree,"
-                          " it is therefore not allowed to delete this and all older logs",
-                          gpid.get_app_id(),
-                          gpid.get_partition_index(),
-                          log->path().c_str(),
-                          it3->second.max_decree,
-                          garbage_max_decree);
-                    prevent_gc_replicas_for_this_log.insert(gpid);
-                    decree gap = it3->second.max_decree - garbage_max_decree;
-                    if (log->index() < stop_gc_log_index || gap > stop_gc_decree_gap) {
-                        // record the max gap replica for the smallest log
-                        stop_gc_replica = gpid;
-                        stop_gc_log_index = log->index();
-                        stop_gc_decree_gap = gap;
-                        stop_gc_garbage_max_decree = garbage_max_decree;
-                        stop_gc_log_max_decree = it3->second.max_decree;
-                    }
-                }
-
-                if (kickout_this_replica) {
-                    // files before this file is useless for this replica,
-                    // so from now on, this replica will not be considered anymore
-                    kickout_replicas.insert(gpid);
-                }
-
-                if (!delete_ok_for_this_replica) {
-                    // can not delete this file, mark it, and continue to check other replicas
-                    delete_ok = false;
-                }
+        return log->end_offset() <= condition.valid_start_offset ||
+               it->second.max_decree <= condition.max_decree;
+    };
+
+    // find the largest file which can be deleted for each replica by the index, which only
+    // checks the files newer than the ones checked by the last gc if the gc condition of the
+    // replica is not changed, or newer than the last deletable one if the condition grows
+    std::vector<std::pair<gpid, int>> deletable_indexes;
+    deletable_indexes.reserve(gc_condition.size());
+    int mark_index = newest_index;
+    for (const auto &kv : gc_condition) {
+        const replica_log_info &condition = kv.second;
+        int floor_index = oldest_index - 1;
+        int deletable_index = oldest_index - 1;
+        auto found = _gc_index.find(kv.first);
+        if (found != _gc_index.end()) {
+            const gc_index_entry &e = found->second;
+            if (e.garbage_max_decree == condition.max_decree &&
+                e.valid_start_offset == condition.valid_start_offset) {
+                floor_index = std::max(e.checked_index, e.deletable_index);
+                deletable_index = e.deletable_index;
+            } else if (e.garbage_max_decree <= condition.max_decree &&
+                       e.valid_start_offset <= condition.valid_start_offset) {
+                floor_index = e.deletable_index;
+                deletable_index = e.deletable_index;
             }
+        }
+        for (int k = static_cast<int>(candidates.size()) - 1;
+             k >= 0 && candidates[k]->index() > floor_index;
+             --k) {
+            if (deletable(kv.first, condition, k)) {
+                deletable_index = candidates[k]->index();
+                break;
+            }
+        }
 
-            // update prevent_gc_replicas
-            if (file_count > file_count_limit && !prevent_gc_replicas_for_this_log.empty()) {
-                prevent_gc_replicas.insert(prevent_gc_replicas_for_this_log.begin(),
-                                           prevent_gc_replicas_for_this_log.end());
+        _gc_index[kv.first] = {
+            condition.max_decree, condition.valid_start_offset, deletable_index, newest_index};
+        deletable_indexes.emplace_back(kv.first, deletable_index);
+        mark_index = std::min(mark_index, deletable_index);
+    }
+    if (_gc_index.size() > gc_condition.size()) {
+        for (auto it = _gc_index.begin(); it != _gc_index.end();) {
+            if (gc_condition.find(it->first) == gc_condition.end()) {
+                it = _gc_index.erase(it);
+            } else {
+                ++it;
             }
         }
+    }
 
-        if (delete_ok) {
-            // found the largest file which can be deleted
-            break;
+    // the replicas which prevent the files out of `file_count_limit' from being deleted
+    if (static_cast<int>(files.size()) > file_count_limit) {
+        auto limit_it = files.rbegin();
+        std::advance(limit_it, std::max(file_count_limit, 0));
+        int limit_index = std::min(limit_it->first, newest_index);
+        for (const auto &kv : deletable_indexes) {
+            if (kv.second < limit_index) {
+                prevent_gc_replicas.insert(kv.first);
+            }
         }
+    }
 
-        // update max_decrees for the next log file
-        max_decrees = log->previous_log_max_decrees();
+    // the replica with the max decree gap which stops the oldest reserved file from being
+    // deleted
+    gpid stop_gc_replica;
+    int stop_gc_log_index = 0;
+    decree stop_gc_decree_gap = 0;
+    decree stop_gc_garbage_max_decree = 0;
+    decree stop_gc_log_max_decree = 0;
+    if (mark_index < newest_index) {
+        size_t k = std::upper_bound(candidates.begin(),
+                                    candidates.end(),
+                                    mark_index,
+                                    [](int index, const log_file_ptr &log) {
+                                        return index < log->index();
+                                    }) -
+                   candidates.begin();
+        stop_gc_log_index = candidates[k]->index();
+        for (const auto &kv : deletable_indexes) {
+            if (kv.second >= stop_gc_log_index) {
+                continue;
+            }
+            auto it = max_decrees[k]->find(kv.first);
+            decree garbage_max_decree = gc_condition.find(kv.first)->second.max_decree;
+            decree gap = it->second.max_decree - garbage_max_decree;
+            if (gap > stop_gc_decree_gap) {
+                stop_gc_replica = kv.first;
+                stop_gc_decree_gap = gap;
+                stop_gc_garbage_max_decree = garbage_max_decree;
+                stop_gc_log_max_decree = it->second.max_decree;
+            }
+        }
     }
 
-    if (mark_it == files.rend()) {
+    if (mark_index < oldest_index) {
         // no file to delete
         if (stop_gc_decree_gap > 0) {
             ddebug("gc_shared: no file can be deleted, file_count_limit = %d, "
@@ -1542,7 +1892,7 @@ int mutation_log::garbage_collection(const replica_log_info_map &gc_condition,
 
     // ok, let's delete files in increasing order of file index
     // to avoid making a hole in the file list
-    int largest_log_to_delete = mark_it->second->index();
+    int largest_log_to_delete = mark_index;
     int to_delete_log_count = 0;
     int64_t to_delete_log_size = 0;
     int deleted_log_count = 0;
@@ -1561,7 +1911,7 @@ int mutation_log::garbage_collection(const replica_log_info_map &gc_condition,
 
         // delete file
         auto &fpath = log->path();
-        if (!dsn::utils::filesystem::remove_path(fpath)) {
+        if (!remove_log_file(fpath)) {
             derror("gc_shared: fail to remove %s, stop current gc cycle ...", fpath.c_str());
             break;
         }
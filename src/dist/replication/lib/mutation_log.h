@@ -30,16 +30,31 @@
 #include "mutation.h"
 #include "log_block.h"
 #include "log_file.h"
+#include "log_sync_coordinator.h"
 
 #include <atomic>
+#include <deque>
 #include <dsn/tool-api/zlocks.h>
 #include <dsn/utility/errors.h>
+#include <dsn/cpp/json_helper.h>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/dist/replication/replica_base.h>
 
 namespace dsn {
 namespace replication {
 
+//
+// the tail of a private log when it's closed, with which the log can be reopened without replay
+//
+struct mutation_log_tail
+{
+    int last_file_index;
+    int64_t end_offset;
+    decree max_decree;
+    decree max_commit_on_disk;
+    DEFINE_JSON_SERIALIZATION(last_file_index, end_offset, max_decree, max_commit_on_disk)
+};
+
 //
 // manage a sequence of continuous mutation log files
 // each log file name is: log.{index}.{global_start_offset}
@@ -112,16 +127,30 @@ public:
     error_code open(replay_callback read_callback,
                     io_failure_callback write_error_callback,
                     const std::map<gpid, decree> &replay_condition);
+    // open the private log without replay, whose files must end as `tail`, otherwise
+    // ERR_INCOMPLETE_DATA is returned and the log is left closed to be opened with replay.
+    // not thread safe, but only be called when init
+    error_code open_without_replay(const mutation_log_tail &tail,
+                                   io_failure_callback write_error_callback);
     // close the log
     // thread safe
     void close();
+    // close the private log, and return its tail after all the data is flushed
+    // thread safe
+    void close(/*out*/ mutation_log_tail &tail);
 
     //
     // replay
     //
+    //
+    // If `thread_count` > 1, the log blocks are read and verified sequentially by the calling
+    // thread, while the mutations are decoded and dispatched by `thread_count` threads
+    // respectively. The mutations of the same gpid are dispatched in log order by the same
+    // thread, so `callback` must be thread safe for different gpids.
     static error_code replay(std::vector<std::string> &log_files,
                              replay_callback callback,
-                             /*out*/ int64_t &end_offset);
+                             /*out*/ int64_t &end_offset,
+                             uint32_t thread_count = 1);
 
     // Reads a series of mutations from the log file (from `start_offset` of `log`),
     // and iterates over the mutations, executing the provided `callback` for each
@@ -149,6 +178,26 @@ public:
         return replay_block(log, callback, start_offset, end_offset);
     }
 
+    // replay_block() is split into read_block() and decode_block(), so that the blocks can be
+    // read sequentially, as their crc is chained, but decoded in parallel.
+    //
+    // Reads and verifies the block at `start_offset` of `log` without decoding it.
+    // `data` holds the mutations of the block, which start at `data_offset` in the global space,
+    // and `end_offset` is where the block ends.
+    // NOTE: `data` may refer to the buffer of the log reader, which is reused by later reads.
+    static error_s read_block(log_file_ptr &log,
+                              size_t start_offset,
+                              /*out*/ blob &data,
+                              /*out*/ int64_t &data_offset,
+                              /*out*/ int64_t &end_offset);
+
+    // Decodes the mutations in `data` read by read_block(), executing `callback` for each of
+    // them. `end_offset` is where the decoding stops.
+    static error_s decode_block(const blob &data,
+                                int64_t data_offset,
+                                replay_callback &callback,
+                                /*out*/ int64_t &end_offset);
+
     // Resets private-log with log files under `dir`.
     // The original plog will be removed after this call.
     // NOTE: private-log should be opened before this method called.
@@ -205,6 +254,9 @@ public:
                            int64_t reserve_max_time);
 
     // garbage collection for shared log, returns reserved file count.
+    // The newest file is never removed. The largest removable file of each replica is kept as
+    // an index, so only the new files, and the replicas whose gc conditions change, are checked
+    // by the next gc; the append lock is only held to copy the file list.
     // `prevent_gc_replicas' will store replicas which prevent log files out of `file_count_limit'
     // to be deleted.
     // remove log files if satisfy:
@@ -278,6 +330,10 @@ public:
     // get total size.
     int64_t total_size() const;
 
+    // get the global offset of the end of the log, i.e. the total bytes ever written.
+    // thread safe
+    int64_t end_offset() const { return get_global_offset(); }
+
     void hint_switch_file() { _switch_file_hint = true; }
     void demand_switch_file() { _switch_file_demand = true; }
 
@@ -304,13 +360,17 @@ private:
     //
     //  internal helpers
     //
+    // load the headers of the existing log files into _log_files
+    error_code load_log_files();
+
     static error_code replay(log_file_ptr log,
                              replay_callback callback,
                              /*out*/ int64_t &end_offset);
 
     static error_code replay(std::map<int, log_file_ptr> &log_files,
                              replay_callback callback,
-                             /*out*/ int64_t &end_offset);
+                             /*out*/ int64_t &end_offset,
+                             uint32_t thread_count = 1);
 
     // update max decree without lock
     void update_max_decree_no_lock(gpid gpid, decree d);
@@ -325,6 +385,10 @@ private:
     // - _lock.locked()
     error_code create_new_log_file();
 
+    // remove the gc'ed log file, or keep it in the recycle dir for the later log files if the
+    // log files are preallocated
+    bool remove_log_file(const std::string &fpath);
+
     // get total size ithout lock.
     int64_t total_size_no_lock() const;
 
@@ -340,7 +404,8 @@ protected:
     int64_t _min_log_file_size_in_bytes;
     bool _force_flush;
 
-    dsn::task_tracker _tracker;
+    // shared by the tasks of the replication, io and timer threads
+    dsn::task_tracker _tracker{dsn::task_tracker::SHARDED_BUCKET_COUNT};
 
 private:
     friend class mutation_log_test;
@@ -350,7 +415,7 @@ private:
     ///////////////////////////////////////////////
     //// memory states
     ///////////////////////////////////////////////
-    mutable zlock _lock;
+    mutable zlock _lock{false, "mutation_log::_lock"};
     bool _is_opened;
     bool _switch_file_hint;
     bool _switch_file_demand;
@@ -370,6 +435,18 @@ private:
     // replica log info for shared log
     replica_log_info_map _shared_log_info_map;
 
+    // the largest file index which can be deleted for each replica by the last gc of shared log,
+    // with the gc condition it's found by
+    struct gc_index_entry
+    {
+        decree garbage_max_decree;
+        int64_t valid_start_offset;
+        int deletable_index;
+        int checked_index; // the newest file index checked
+    };
+    zlock _gc_lock; // serializes the gc of shared log
+    std::unordered_map<gpid, gc_index_entry> _gc_index;
+
     // replica log info for private log
     replica_log_info _private_log_info;
     decree
@@ -385,13 +462,10 @@ public:
     mutation_log_shared(const std::string &dir,
                         int32_t max_log_file_mb,
                         bool force_flush,
-                        perf_counter_wrapper *write_size_counter = nullptr)
-        : mutation_log(dir, max_log_file_mb, dsn::gpid(), nullptr),
-          _is_writing(false),
-          _force_flush(force_flush),
-          _write_size_counter(write_size_counter)
-    {
-    }
+                        perf_counter_wrapper *write_size_counter = nullptr,
+                        perf_counter_wrapper *batch_size_counter = nullptr,
+                        perf_counter_wrapper *batch_mutation_count_counter = nullptr,
+                        perf_counter_wrapper *batch_queueing_delay_counter = nullptr);
 
     virtual ~mutation_log_shared() override
     {
@@ -410,28 +484,75 @@ public:
     virtual void flush_once() override;
 
 private:
+    // a batch of mutations which has been issued to the log file
+    struct inflight_write
+    {
+        std::shared_ptr<log_appender> pending;
+        uint64_t issue_time_ns{0};
+        bool done{false};
+        size_t size{0};
+        error_code err{ERR_OK};
+        // error of the previous writes, which also fails this write because
+        // there would be a hole in the log file
+        error_code previous_err{ERR_OK};
+    };
+    typedef std::shared_ptr<inflight_write> inflight_write_ptr;
+
     // async write pending mutations into log file
     // Preconditions:
     // - _pending_write != nullptr
-    // - _issued_write.expired() == true (because only one async write is allowed at the same time)
+    // - should_issue_write() == true
     // release_lock_required should always be true => this function must release the lock
     // appropriately for less lock contention
     void write_pending_mutations(bool release_lock_required);
 
-    void commit_pending_mutations(log_file_ptr &lf, std::shared_ptr<log_appender> &pending);
+    void commit_pending_mutations(log_file_ptr &lf, const inflight_write_ptr &write);
+
+    // notify the callbacks of all the completed writes in the order of issuing,
+    // and start the next write if possible
+    void on_write_completed(const inflight_write_ptr &write, error_code err, size_t size);
+
+    // whether to issue the pending write now, must be called under _slock:
+    // - always issue if there is no write in flight
+    // - in group commit mode, also issue if the in-flight writes are less than
+    //   `log_shared_max_inflight_writes` and the pending buffer is large enough
+    bool should_issue_write() const;
+
+    // adjust _group_commit_batch_bytes according to the observed write latency
+    // and incoming rate, must be called under _slock
+    void update_group_commit_batch_bytes();
 
     // flush at most count times
     // if count <= 0, means flush until all data is on disk
     void flush_internal(int max_count);
 
 private:
-    // bufferring - only one concurrent write is allowed
+    // bufferring - at most _max_inflight_writes concurrent writes are allowed
     mutable zlock _slock;
-    std::atomic_bool _is_writing;
     std::shared_ptr<log_appender> _pending_write;
+    uint64_t _pending_write_start_time_ns;
+    // writes in the order of issuing, protected by _slock
+    std::deque<inflight_write_ptr> _inflight_writes;
+    std::atomic<uint32_t> _inflight_write_count;
+
+    // the log blocks must be committed in the order of their offsets
+    zlock _commit_lock;
+    // the callbacks must be notified in the order of the log offsets, so that
+    // on_append_log_completed is called by decree order for each replica
+    zlock _callback_lock;
+
+    // group commit states, protected by _slock
+    uint32_t _max_inflight_writes;
+    size_t _group_commit_batch_bytes;
+    double _ewma_write_latency_us;
+    double _ewma_incoming_bytes_per_us;
+    uint64_t _last_issue_time_ns;
 
     bool _force_flush;
     perf_counter_wrapper *_write_size_counter;
+    perf_counter_wrapper *_batch_size_counter;
+    perf_counter_wrapper *_batch_mutation_count_counter;
+    perf_counter_wrapper *_batch_queueing_delay_counter;
 };
 
 class mutation_log_private : public mutation_log, private replica_base
@@ -475,6 +596,23 @@ public:
     virtual void flush() override;
     virtual void flush_once() override;
 
+    // Makes this log responsible for the durability of mutations, used when the shared log is
+    // disabled: writes are issued as soon as the previous one completes, synced to disk through
+    // `coordinator`, and then the callbacks of append() are notified.
+    // Must be called before any append.
+    void set_sync_coordinator(log_sync_coordinator *coordinator)
+    {
+        _sync_coordinator = coordinator;
+    }
+
+    // the flush interval to keep the append latency under `target_us`, which is the latency
+    // budget left by the estimated high percentile write latency, or 0 if the next mutation is
+    // not expected to arrive in the budget, so that waiting for it is useless
+    static uint64_t get_adaptive_flush_interval_us(uint64_t target_us,
+                                                   double append_interval_us,
+                                                   double write_latency_us,
+                                                   double write_latency_dev_us);
+
 private:
     // async write pending mutations into log file
     // Preconditions:
@@ -488,6 +626,11 @@ private:
                                   std::shared_ptr<log_appender> &pending,
                                   decree max_commit);
 
+    // called when the pending mutations are written and synced to disk
+    void on_pending_mutations_durable(const std::shared_ptr<log_appender> &pending,
+                                      decree max_commit,
+                                      size_t size);
+
     virtual void init_states() override;
 
     // flush at most count times
@@ -496,9 +639,12 @@ private:
 
     bool flush_interval_expired()
     {
-        return _pending_write_start_time_ms + _batch_buffer_flush_interval_ms <= dsn_now_ms();
+        return _pending_write_start_time_us + _flush_interval_us <= dsn_now_us();
     }
 
+    // update the flush interval with the latency of the last write, _plock should be held
+    void update_flush_interval(uint64_t write_latency_us);
+
 private:
     // bufferring - only one concurrent write is allowed
     typedef std::vector<mutation_ptr> mutations;
@@ -508,7 +654,8 @@ private:
     // `_issued_write.lock() == nullptr`, it means the emitted writes all finished.
     std::weak_ptr<log_appender> _issued_write;
     std::shared_ptr<log_appender> _pending_write;
-    uint64_t _pending_write_start_time_ms;
+    uint64_t _pending_write_start_time_us;
+    uint64_t _issued_write_start_time_us;
     decree _pending_write_max_commit;
     decree _pending_write_max_decree;
     mutable zlock _plock;
@@ -516,6 +663,19 @@ private:
     uint32_t _batch_buffer_bytes;
     uint32_t _batch_buffer_max_count;
     uint64_t _batch_buffer_flush_interval_ms;
+
+    // the effective flush interval, which is _batch_buffer_flush_interval_ms unless
+    // `log_private_append_latency_target_us` is set
+    uint64_t _flush_interval_us;
+    uint64_t _last_append_time_us;
+    double _ewma_append_interval_us;
+    double _ewma_write_latency_us;
+    double _ewma_write_latency_dev_us;
+
+    log_sync_coordinator *_sync_coordinator{nullptr};
+
+    perf_counter_wrapper _counter_batch_mutation_count;
+    perf_counter_wrapper _counter_flush_interval;
 };
 
 } // namespace replication
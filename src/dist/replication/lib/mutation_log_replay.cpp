@@ -7,10 +7,345 @@
 #include <dsn/utility/fail_point.h>
 #include <dsn/utility/errors.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/tool-api/task.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace dsn {
 namespace replication {
 
+namespace {
+
+// log_replay_pipeline decodes and dispatches the log blocks fed by the reader:
+//
+//   reader (the calling thread) --> decoders (decode mutations from a block)
+//          --> reader (route the decoded mutations in log order by gpid)
+//          --> dispatchers (execute the callback)
+//
+// The mutations of the same gpid are always dispatched by the same dispatcher in log
+// order, while the mutations of different gpids may be dispatched concurrently.
+class log_replay_pipeline
+{
+public:
+    log_replay_pipeline(mutation_log::replay_callback &callback, uint32_t thread_count)
+        : _callback(callback),
+          _max_pending_blocks(thread_count * 4),
+          _dispatchers(thread_count),
+          _closing(false),
+          _failed(false),
+          _decoded_end_offset(0),
+          _block_count(0),
+          _mutation_count(0),
+          _decode_ns(0),
+          _dispatch_ns(0)
+    {
+        // the callback may create tasks, which is only allowed in threads attached to a node
+        service_node *node = task::get_current_node();
+        for (uint32_t i = 0; i < thread_count; ++i) {
+            _decode_threads.emplace_back([this, node]() {
+                task::set_tls_dsn_context(node, nullptr);
+                run_decoder();
+            });
+            _dispatch_threads.emplace_back([this, node, i]() {
+                task::set_tls_dsn_context(node, nullptr);
+                run_dispatcher(_dispatchers[i]);
+            });
+        }
+    }
+
+    ~log_replay_pipeline() { stop(); }
+
+    // returns false if a previous block is failed to be decoded, which means the
+    // following blocks are useless
+    // the block is indexed in `log` once decoded, which is at `block_offset` of the file with
+    // its crc chained to `crc32`
+    bool submit(
+        blob data, int64_t start_offset, log_file_ptr log, int64_t block_offset, uint32_t crc32)
+    {
+        // the data may refer to the buffer of file_streamer, which is reused by later reads
+        if (!data.buffer_ptr()) {
+            data = blob::create_from_bytes(data.data(), data.length());
+        }
+
+        auto b = std::make_shared<block>();
+        b->data = std::move(data);
+        b->start_offset = start_offset;
+        b->log = std::move(log);
+        b->block_offset = block_offset;
+        b->crc32 = crc32;
+
+        std::unique_lock<std::mutex> l(_lock);
+        _pending_blocks.push_back(b);
+        _decode_queue.push_back(b);
+        _decode_cv.notify_one();
+
+        route_decoded_blocks(l, _max_pending_blocks);
+        return !_failed;
+    }
+
+    // waits for all the submitted blocks to be dispatched
+    // returns the first decoding error, and `end_offset` is where the decoding stops
+    error_s finish(/*out*/ int64_t &end_offset)
+    {
+        {
+            std::unique_lock<std::mutex> l(_lock);
+            route_decoded_blocks(l, 1);
+        }
+        stop();
+
+        end_offset = _decoded_end_offset;
+        return _error;
+    }
+
+    bool failed() const { return _failed; }
+
+    std::string timing_summary(uint64_t read_ns, uint64_t total_ns) const
+    {
+        return fmt::format("thread_count = {}, block_count = {}, mutation_count = {}, "
+                           "read_and_verify = {} ms, decode = {} ms, dispatch = {} ms, "
+                           "total = {} ms",
+                           _dispatchers.size(),
+                           _block_count,
+                           _mutation_count,
+                           read_ns / 1000000,
+                           _decode_ns.load() / 1000000,
+                           _dispatch_ns.load() / 1000000,
+                           total_ns / 1000000);
+    }
+
+private:
+    typedef std::vector<std::pair<int, mutation_ptr>> mutation_batch; // log length, mutation
+
+    struct block
+    {
+        blob data;
+        int64_t start_offset = 0;
+        log_file_ptr log;
+        int64_t block_offset = 0;
+        uint32_t crc32 = 0;
+
+        // set by decoder
+        bool decoded = false;
+        mutation_batch mutations;
+        int64_t end_offset = 0;
+        error_s err = error_s::ok();
+    };
+    typedef std::shared_ptr<block> block_ptr;
+
+    struct dispatcher
+    {
+        std::condition_variable cv;
+        std::deque<mutation_batch> queue;
+    };
+
+    static void decode(block &b)
+    {
+        mutation_log::replay_callback collect = [&b](int log_length, mutation_ptr &mu) {
+            b.mutations.emplace_back(log_length, std::move(mu));
+            return true;
+        };
+        b.err = mutation_log::decode_block(b.data, b.start_offset, collect, b.end_offset);
+    }
+
+    void run_decoder()
+    {
+        std::unique_lock<std::mutex> l(_lock);
+        while (true) {
+            _decode_cv.wait(l, [this]() { return _closing || !_decode_queue.empty(); });
+            if (_decode_queue.empty()) {
+                return;
+            }
+            block_ptr b = _decode_queue.front();
+            _decode_queue.pop_front();
+            l.unlock();
+
+            uint64_t start_ns = dsn_now_ns();
+            if (!_failed) {
+                decode(*b);
+            }
+            _decode_ns += dsn_now_ns() - start_ns;
+
+            l.lock();
+            b->decoded = true;
+            _decoded_cv.notify_one();
+        }
+    }
+
+    void run_dispatcher(dispatcher &d)
+    {
+        std::unique_lock<std::mutex> l(_lock);
+        while (true) {
+            d.cv.wait(l, [this, &d]() { return _closing || !d.queue.empty(); });
+            if (d.queue.empty()) {
+                return;
+            }
+            mutation_batch batch = std::move(d.queue.front());
+            d.queue.pop_front();
+            l.unlock();
+
+            uint64_t start_ns = dsn_now_ns();
+            for (auto &m : batch) {
+                _callback(m.first, m.second);
+            }
+            _dispatch_ns += dsn_now_ns() - start_ns;
+            batch.clear();
+
+            l.lock();
+        }
+    }
+
+    // routes the decoded blocks in order, and waits until less than `max_pending` blocks
+    // are not routed
+    void route_decoded_blocks(std::unique_lock<std::mutex> &l, size_t max_pending)
+    {
+        while (!_pending_blocks.empty()) {
+            block_ptr b = _pending_blocks.front();
+            if (!b->decoded) {
+                if (_pending_blocks.size() < max_pending) {
+                    return;
+                }
+                _decoded_cv.wait(l, [&b]() { return b->decoded; });
+            }
+            _pending_blocks.pop_front();
+
+            if (_failed) {
+                // drop the blocks after the failed one
+                continue;
+            }
+
+            decree max_decree = 0;
+            std::vector<mutation_batch> batches(_dispatchers.size());
+            for (auto &m : b->mutations) {
+                max_decree = std::max(max_decree, m.second->get_decree());
+                size_t index = std::hash<gpid>()(m.second->data.header.pid) % batches.size();
+                batches[index].push_back(std::move(m));
+            }
+            for (size_t i = 0; i < batches.size(); ++i) {
+                if (!batches[i].empty()) {
+                    _dispatchers[i].queue.push_back(std::move(batches[i]));
+                    _dispatchers[i].cv.notify_one();
+                }
+            }
+
+            if (b->err.is_ok()) {
+                b->log->index_block(b->block_offset, b->crc32, max_decree);
+            }
+
+            _block_count++;
+            _mutation_count += b->mutations.size();
+            _decoded_end_offset = b->end_offset;
+            if (!b->err.is_ok()) {
+                _error = b->err;
+                _failed = true;
+            }
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> l(_lock);
+            if (_closing) {
+                return;
+            }
+            _closing = true;
+            _decode_cv.notify_all();
+            for (auto &d : _dispatchers) {
+                d.cv.notify_all();
+            }
+        }
+        for (auto &t : _decode_threads) {
+            t.join();
+        }
+        for (auto &t : _dispatch_threads) {
+            t.join();
+        }
+    }
+
+private:
+    mutation_log::replay_callback &_callback;
+    const size_t _max_pending_blocks;
+
+    std::mutex _lock;
+    std::condition_variable _decode_cv;
+    std::condition_variable _decoded_cv;
+    std::deque<block_ptr> _decode_queue;
+    std::deque<block_ptr> _pending_blocks; // in log order, submitted but not routed
+    std::vector<dispatcher> _dispatchers;
+    bool _closing;
+
+    // written by the reader in route_decoded_blocks
+    std::atomic<bool> _failed;
+    error_s _error = error_s::ok();
+    int64_t _decoded_end_offset;
+    uint64_t _block_count;
+    uint64_t _mutation_count;
+
+    std::atomic<uint64_t> _decode_ns;
+    std::atomic<uint64_t> _dispatch_ns;
+
+    std::vector<std::thread> _decode_threads;
+    std::vector<std::thread> _dispatch_threads;
+};
+
+// reads and verifies the log blocks of `log` sequentially, and submits them to `pipeline`,
+// `end_offset` is where the reading stops, just like mutation_log::replay(log, ...)
+error_code replay_to_pipeline(log_file_ptr &log,
+                              log_replay_pipeline &pipeline,
+                              /*out*/ int64_t &end_offset,
+                              /*out*/ uint64_t &read_ns)
+{
+    end_offset = log->start_offset();
+    ddebug("start to replay mutation log %s in pipeline, offset = [%" PRId64 ", %" PRId64
+           "), size = %" PRId64,
+           log->path().c_str(),
+           log->start_offset(),
+           log->end_offset(),
+           log->end_offset() - log->start_offset());
+
+    log->reset_stream();
+    error_code err = ERR_OK;
+    while (true) {
+        blob bb;
+        int64_t block_offset = end_offset - log->start_offset();
+        uint32_t crc32 = log->crc32();
+        uint64_t start_ns = dsn_now_ns();
+        err = log->read_next_log_block(bb);
+        read_ns += dsn_now_ns() - start_ns;
+        if (err != ERR_OK) {
+            break;
+        }
+
+        int64_t offset = end_offset + sizeof(log_block_header);
+        if (end_offset == log->start_offset()) {
+            // The first block is log_file_header.
+            binary_reader reader(bb);
+            int header_size = log->read_file_header(reader);
+            if (!log->is_right_header()) {
+                derror("failed to read log file header of %s", log->path().c_str());
+                err = ERR_INVALID_DATA;
+                break;
+            }
+            offset += header_size;
+            bb = bb.range(header_size);
+        }
+
+        end_offset = offset + bb.length();
+        if (bb.length() > 0 &&
+            !pipeline.submit(std::move(bb), offset, log, block_offset, crc32)) {
+            break;
+        }
+    }
+
+    ddebug("finish to read mutation log (%s) [err: %s]", log->path().c_str(), err.to_string());
+    return err;
+}
+
+} // anonymous namespace
+
 /*static*/ error_code mutation_log::replay(log_file_ptr log,
                                            replay_callback callback,
                                            /*out*/ int64_t &end_offset)
@@ -27,11 +362,19 @@ namespace replication {
     error_s err;
     size_t start_offset = 0;
     while (true) {
-        err = replay_block(log, callback, start_offset, end_offset);
+        uint32_t crc32 = start_offset == 0 ? 0 : log->crc32();
+        decree max_decree = 0;
+        replay_callback indexed_callback = [&callback, &max_decree](int log_length,
+                                                                    mutation_ptr &mu) {
+            max_decree = std::max(max_decree, mu->get_decree());
+            return callback(log_length, mu);
+        };
+        err = replay_block(log, indexed_callback, start_offset, end_offset);
         if (!err.is_ok()) {
             // Stop immediately if failed
             break;
         }
+        log->index_block(static_cast<int64_t>(start_offset), crc32, max_decree);
 
         start_offset = static_cast<size_t>(end_offset - log->start_offset());
     }
@@ -46,14 +389,27 @@ namespace replication {
                                               replay_callback &callback,
                                               size_t start_offset,
                                               int64_t &end_offset)
+{
+    blob data;
+    int64_t data_offset = 0;
+    error_s err = read_block(log, start_offset, data, data_offset, end_offset);
+    if (!err.is_ok()) {
+        return err;
+    }
+    return decode_block(data, data_offset, callback, end_offset);
+}
+
+/*static*/ error_s mutation_log::read_block(log_file_ptr &log,
+                                            size_t start_offset,
+                                            blob &data,
+                                            int64_t &data_offset,
+                                            int64_t &end_offset)
 {
     FAIL_POINT_INJECT_F("mutation_log_replay_block", [](string_view) -> error_s {
         return error_s::make(ERR_INCOMPLETE_DATA, "mutation_log_replay_block");
     });
 
     blob bb;
-    std::unique_ptr<binary_reader> reader;
-
     log->reset_stream(start_offset); // start reading from given offset
     int64_t global_start_offset = start_offset + log->start_offset();
     end_offset = global_start_offset; // reset end_offset to the start.
@@ -64,21 +420,35 @@ namespace replication {
         return error_s::make(err, "failed to read log block");
     }
 
-    reader = dsn::make_unique<binary_reader>(bb);
-    end_offset += sizeof(log_block_header);
+    data_offset = global_start_offset + sizeof(log_block_header);
 
     // The first block is log_file_header.
     if (global_start_offset == log->start_offset()) {
-        end_offset += log->read_file_header(*reader);
+        binary_reader reader(bb);
+        int header_size = log->read_file_header(reader);
         if (!log->is_right_header()) {
             return error_s::make(ERR_INVALID_DATA, "failed to read log file header");
         }
         // continue to parsing the data block
+        data_offset += header_size;
+        bb = bb.range(header_size);
     }
 
-    while (!reader->is_eof()) {
-        auto old_size = reader->get_remaining_size();
-        mutation_ptr mu = mutation::read_from(*reader, nullptr);
+    data = std::move(bb);
+    end_offset = data_offset + data.length();
+    return error_s::ok();
+}
+
+/*static*/ error_s mutation_log::decode_block(const blob &data,
+                                              int64_t data_offset,
+                                              replay_callback &callback,
+                                              int64_t &end_offset)
+{
+    binary_reader reader(data);
+    end_offset = data_offset;
+    while (!reader.is_eof()) {
+        auto old_size = reader.get_remaining_size();
+        mutation_ptr mu = mutation::read_from(reader, nullptr);
         dassert(nullptr != mu, "");
         mu->set_logged();
 
@@ -89,7 +459,7 @@ namespace replication {
                            mu->data.header.log_offset);
         }
 
-        int log_length = old_size - reader->get_remaining_size();
+        int log_length = old_size - reader.get_remaining_size();
 
         callback(log_length, mu);
 
@@ -101,7 +471,8 @@ namespace replication {
 
 /*static*/ error_code mutation_log::replay(std::vector<std::string> &log_files,
                                            replay_callback callback,
-                                           /*out*/ int64_t &end_offset)
+                                           /*out*/ int64_t &end_offset,
+                                           uint32_t thread_count)
 {
     std::map<int, log_file_ptr> logs;
     for (auto &fpath : log_files) {
@@ -122,12 +493,13 @@ namespace replication {
         logs[log->index()] = log;
     }
 
-    return replay(logs, callback, end_offset);
+    return replay(logs, callback, end_offset, thread_count);
 }
 
 /*static*/ error_code mutation_log::replay(std::map<int, log_file_ptr> &logs,
                                            replay_callback callback,
-                                           /*out*/ int64_t &end_offset)
+                                           /*out*/ int64_t &end_offset,
+                                           uint32_t thread_count)
 {
     int64_t g_start_offset = 0;
     int64_t g_end_offset = 0;
@@ -147,6 +519,13 @@ namespace replication {
 
     end_offset = g_start_offset;
 
+    std::unique_ptr<log_replay_pipeline> pipeline;
+    uint64_t start_ns = dsn_now_ns();
+    uint64_t read_ns = 0;
+    if (thread_count > 1 && !logs.empty()) {
+        pipeline = dsn::make_unique<log_replay_pipeline>(callback, thread_count);
+    }
+
     for (auto &kv : logs) {
         log_file_ptr &log = kv.second;
 
@@ -158,7 +537,16 @@ namespace replication {
         }
 
         last = log;
-        err = mutation_log::replay(log, callback, end_offset);
+        if (pipeline) {
+            err = replay_to_pipeline(log, *pipeline, end_offset, read_ns);
+            if (pipeline->failed()) {
+                // the decoding error is returned by pipeline->finish()
+                log->close();
+                break;
+            }
+        } else {
+            err = mutation_log::replay(log, callback, end_offset);
+        }
 
         log->close();
 
@@ -174,7 +562,23 @@ namespace replication {
         }
     }
 
+    if (pipeline) {
+        int64_t decoded_end_offset = 0;
+        error_s decode_err = pipeline->finish(decoded_end_offset);
+        if (!decode_err.is_ok()) {
+            derror_f("failed to decode mutation log: {}", decode_err);
+            err = decode_err.code();
+            end_offset = decoded_end_offset;
+        }
+        ddebug_f("finish to replay mutation logs in pipeline: {}",
+                 pipeline->timing_summary(read_ns, dsn_now_ns() - start_ns));
+    }
+
     if (err == ERR_OK || err == ERR_HANDLE_EOF) {
+        // the end of a preallocated file is known after it's read through
+        if (!logs.empty() && logs.rbegin()->second->is_preallocated()) {
+            g_end_offset = logs.rbegin()->second->end_offset();
+        }
         // the log may still be written when used for learning
         dassert(g_end_offset <= end_offset,
                 "make sure the global end offset is correct: %" PRId64 " vs %" PRId64,
@@ -45,7 +45,7 @@ prepare_list::prepare_list(replica_base *r, const prepare_list &parent_plist)
     : mutation_cache(parent_plist), replica_base(r)
 {
     _committer = parent_plist._committer;
-    _last_committed_decree = parent_plist._last_committed_decree;
+    _last_committed_decree = parent_plist._last_committed_decree.load();
 }
 
 void prepare_list::reset(decree init_decree)
@@ -67,6 +67,18 @@ void prepare_list::truncate(decree init_decree)
     _last_committed_decree = init_decree;
 }
 
+int64_t prepare_list::appro_data_bytes_after(decree d)
+{
+    int64_t bytes = 0;
+    for (decree i = std::max(d + 1, min_decree()); i <= max_decree(); ++i) {
+        mutation_ptr mu = get_mutation_by_decree(i);
+        if (mu != nullptr) {
+            bytes += mu->appro_data_bytes();
+        }
+    }
+    return bytes;
+}
+
 error_code prepare_list::prepare(mutation_ptr &mu,
                                  partition_status::type status,
                                  bool pop_all_committed_mutations)
@@ -143,6 +155,15 @@ void prepare_list::commit(decree d, commit_type ct)
     if (d <= last_committed_decree())
         return;
 
+    std::vector<mutation_ptr> batch;
+    auto committer = [this, &batch](mutation_ptr &mu) {
+        if (_batch_committer) {
+            batch.push_back(mu);
+        } else {
+            _committer(mu);
+        }
+    };
+
     ballot last_bt = 0;
     switch (ct) {
     case COMMIT_TO_DECREE_HARD: {
@@ -155,10 +176,9 @@ void prepare_list::commit(decree d, commit_type ct)
 
             _last_committed_decree++;
             last_bt = mu->data.header.ballot;
-            _committer(mu);
+            committer(mu);
         }
-
-        return;
+        break;
     }
     case COMMIT_TO_DECREE_SOFT: {
         for (decree d0 = last_committed_decree() + 1; d0 <= d; d0++) {
@@ -166,12 +186,11 @@ void prepare_list::commit(decree d, commit_type ct)
             if (mu != nullptr && mu->is_ready_for_commit() && mu->data.header.ballot >= last_bt) {
                 _last_committed_decree++;
                 last_bt = mu->data.header.ballot;
-                _committer(mu);
+                committer(mu);
             } else
                 break;
         }
-
-        return;
+        break;
     }
     case COMMIT_ALL_READY: {
         if (d != last_committed_decree() + 1)
@@ -183,18 +202,21 @@ void prepare_list::commit(decree d, commit_type ct)
         while (mu != nullptr && mu->is_ready_for_commit() && mu->data.header.ballot >= last_bt) {
             _last_committed_decree++;
             last_bt = mu->data.header.ballot;
-            _committer(mu);
+            committer(mu);
             count++;
             mu = mutation_cache::get_mutation_by_decree(_last_committed_decree + 1);
         }
-
-        return;
+        break;
     }
     default:
         dassert(false, "invalid commit type %d", (int)ct);
     }
 
-    return;
+    if (batch.size() == 1) {
+        _committer(batch.front());
+    } else if (!batch.empty()) {
+        _batch_committer(batch);
+    }
 }
 } // namespace replication
 } // namespace dsn
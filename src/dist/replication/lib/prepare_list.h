@@ -50,6 +50,7 @@ class prepare_list : public mutation_cache, private replica_base
 {
 public:
     typedef std::function<void(mutation_ptr &)> mutation_committer;
+    typedef std::function<void(std::vector<mutation_ptr> &)> batch_mutation_committer;
 
 public:
     prepare_list(replica_base *r, decree init_decree, int max_count, mutation_committer committer);
@@ -59,6 +60,20 @@ public:
     void reset(decree init_decree);
     void truncate(decree init_decree);
     void set_committer(mutation_committer committer) { _committer = committer; }
+    // Optional. If set, the consecutive mutations which become committable in one commit()
+    // are committed together by it, rather than one by one by the mutation_committer.
+    // It's not copied to the prepare_list constructed from a parent.
+    void set_batch_committer(batch_mutation_committer committer)
+    {
+        _batch_committer = std::move(committer);
+    }
+
+    // Snapshot the committed mutations since decree `start` that are still kept in the list.
+    // Lock-free, can be called from any thread concurrently with the replica thread.
+    int get_committed_mutations(decree start, /*out*/ std::vector<mutation_ptr> &mutations) const
+    {
+        return get_mutations_lock_free(start, _last_committed_decree.load(), mutations);
+    }
 
     //
     // for two-phase commit
@@ -70,9 +85,13 @@ public:
                        bool pop_all_committed_mutations = false); // unordered prepare
     void commit(decree decree, commit_type ct);                   // ordered commit
 
+    // the approximate size of the mutations in (d, max_decree()]
+    int64_t appro_data_bytes_after(decree d);
+
 private:
-    decree _last_committed_decree;
+    std::atomic<decree> _last_committed_decree;
     mutation_committer _committer;
+    batch_mutation_committer _batch_committer;
 };
 
 } // namespace replication
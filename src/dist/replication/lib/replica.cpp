@@ -39,10 +39,26 @@
 #include <dsn/utility/string_conv.h>
 #include <dsn/utility/strings.h>
 #include <dsn/tool-api/rpc_message.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/io_scheduler.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                replica_level_counters_enabled,
+                true,
+                "whether to register the replica level counters which are also aggregated by app "
+                "as eon.app counters, whose values of each replica are available on demand at "
+                "ip:port/replica/app_counters");
+
+DSN_DEFINE_uint32("replication",
+                  hotspot_key_sample_interval,
+                  16,
+                  "one of every such client requests of a replica is sampled to find the hottest "
+                  "keys by their partition hashes, 0 means the keys are not sampled");
+
 replica::replica(
     replica_stub *stub, gpid gpid, const app_info &app, const char *dir, bool need_restore)
     : serverlet<replica>("replica"),
@@ -60,7 +76,8 @@ replica::replica(
       _restore_status(ERR_OK),
       _duplication_mgr(new replica_duplicator_manager(this)),
       _duplicating(app.duplicating),
-      _backup_mgr(new replica_backup_manager(this))
+      _backup_mgr(new replica_backup_manager(this)),
+      _hotspot_detector(FLAGS_hotspot_key_sample_interval)
 {
     dassert(_app_info.app_type != "", "");
     dassert(stub != nullptr, "");
@@ -72,17 +89,36 @@ replica::replica(
     _partition_version = app.partition_count - 1;
     _bulk_loader = make_unique<replica_bulk_loader>(this);
 
-    std::string counter_str = fmt::format("private.log.size(MB)@{}", gpid);
-    _counter_private_log_size.init_app_counter(
-        "eon.replica", counter_str.c_str(), COUNTER_TYPE_NUMBER, counter_str.c_str());
+    _stub->get_app_counters().attach(gpid, &_app_counter_shard);
 
-    counter_str = fmt::format("recent.write.throttling.delay.count@{}", gpid);
-    _counter_recent_write_throttling_delay_count.init_app_counter(
-        "eon.replica", counter_str.c_str(), COUNTER_TYPE_VOLATILE_NUMBER, counter_str.c_str());
+    std::string counter_str;
+    if (FLAGS_replica_level_counters_enabled) {
+        counter_str = fmt::format("private.log.size(MB)@{}", gpid);
+        _counter_private_log_size.init_app_counter(
+            "eon.replica", counter_str.c_str(), COUNTER_TYPE_NUMBER, counter_str.c_str());
 
-    counter_str = fmt::format("recent.write.throttling.reject.count@{}", gpid);
-    _counter_recent_write_throttling_reject_count.init_app_counter(
-        "eon.replica", counter_str.c_str(), COUNTER_TYPE_VOLATILE_NUMBER, counter_str.c_str());
+        counter_str = fmt::format("recent.write.throttling.delay.count@{}", gpid);
+        _counter_recent_write_throttling_delay_count.init_app_counter(
+            "eon.replica", counter_str.c_str(), COUNTER_TYPE_VOLATILE_NUMBER, counter_str.c_str());
+
+        counter_str = fmt::format("recent.write.backpressure.delay.count@{}", gpid);
+        _counter_recent_write_backpressure_delay_count.init_app_counter(
+            "eon.replica", counter_str.c_str(), COUNTER_TYPE_VOLATILE_NUMBER, counter_str.c_str());
+
+        counter_str = fmt::format("recent.write.throttling.reject.count@{}", gpid);
+        _counter_recent_write_throttling_reject_count.init_app_counter(
+            "eon.replica", counter_str.c_str(), COUNTER_TYPE_VOLATILE_NUMBER, counter_str.c_str());
+
+        counter_str = fmt::format("write.2pc.window@{}", gpid);
+        _counter_2pc_window.init_app_counter(
+            "eon.replica", counter_str.c_str(), COUNTER_TYPE_NUMBER, counter_str.c_str());
+
+        counter_str = fmt::format("write.queue.time(ns)@{}", gpid);
+        _counter_write_queue_time.init_app_counter("eon.replica",
+                                                   counter_str.c_str(),
+                                                   COUNTER_TYPE_NUMBER_PERCENTILES,
+                                                   counter_str.c_str());
+    }
 
     counter_str = fmt::format("dup.disabled_non_idempotent_write_count@{}", _app_info.app_name);
     _counter_dup_disabled_non_idempotent_write_count.init_app_counter(
@@ -95,6 +131,14 @@ replica::replica(
     _counter_backup_request_qps.init_app_counter(
         "eon.replica", counter_str.c_str(), COUNTER_TYPE_RATE, counter_str.c_str());
 
+    counter_str = fmt::format("restore.download.bytes.rate@{}", gpid);
+    _counter_restore_download_bytes.init_app_counter(
+        "eon.replica", counter_str.c_str(), COUNTER_TYPE_RATE, counter_str.c_str());
+
+    counter_str = fmt::format("restore.progress(permil)@{}", gpid);
+    _counter_restore_progress.init_app_counter(
+        "eon.replica", counter_str.c_str(), COUNTER_TYPE_NUMBER, counter_str.c_str());
+
     if (need_restore) {
         // add an extra env for restore
         _extra_envs.insert(
@@ -154,6 +198,30 @@ replica::~replica(void)
     dinfo("%s: replica destroyed", name());
 }
 
+DSN_DEFINE_uint32("replication",
+                  primary_read_lease_ms,
+                  0,
+                  "if not 0, the primary rejects non-backup reads with ERR_INVALID_STATE once the "
+                  "failure detector lease to the meta server expires, or some secondary has not "
+                  "acked any group check or prepare sent within this period, which should be "
+                  "larger than group_check_interval_ms");
+
+DSN_DEFINE_bool("replication",
+                follower_read_enabled,
+                false,
+                "whether secondaries serve the read requests marked as follower read, once they "
+                "are not staler than follower_read_max_lag_decrees/follower_read_max_lag_ms");
+DSN_DEFINE_uint32("replication",
+                  follower_read_max_lag_decrees,
+                  100,
+                  "max count of decrees by which a secondary serving follower reads may lag "
+                  "behind the last commit point piggybacked from the primary");
+DSN_DEFINE_uint32("replication",
+                  follower_read_max_lag_ms,
+                  5000,
+                  "max age of the last commit point piggybacked from the primary, by which a "
+                  "secondary serving follower reads knows how far it lags behind");
+
 void replica::on_client_read(dsn::message_ex *request)
 {
     if (status() == partition_status::PS_INACTIVE ||
@@ -162,7 +230,12 @@ void replica::on_client_read(dsn::message_ex *request)
         return;
     }
 
-    if (!request->is_backup_request()) {
+    if (request->is_follower_read() && status() == partition_status::PS_SECONDARY) {
+        if (!is_follower_read_allowed()) {
+            response_client_read(request, ERR_INVALID_STATE);
+            return;
+        }
+    } else if (!request->is_backup_request()) {
         // only backup request is allowed to read from a stale replica
 
         if (status() != partition_status::PS_PRIMARY) {
@@ -179,10 +252,21 @@ void replica::on_client_read(dsn::message_ex *request)
             response_client_read(request, ERR_INVALID_STATE);
             return;
         }
+
+        if (FLAGS_primary_read_lease_ms > 0) {
+            if (!is_read_lease_valid()) {
+                _stub->_counter_replicas_recent_read_lease_miss_count->increment();
+                response_client_read(request, ERR_INVALID_STATE);
+                return;
+            }
+            _stub->_counter_replicas_recent_read_lease_hit_count->increment();
+        }
     } else {
         _counter_backup_request_qps->increment();
     }
 
+    _hotspot_detector.record(request->header->client.partition_hash, request->body_size(), false);
+
     uint64_t start_time_ns = dsn_now_ns();
     dassert(_app != nullptr, "");
     _app->on_request(request);
@@ -194,14 +278,64 @@ void replica::on_client_read(dsn::message_ex *request)
     }
 }
 
+bool replica::is_read_lease_valid() const
+{
+    uint64_t now_ms = dsn_now_ms();
+    if (now_ms >= _stub->get_meta_lease_expire_ms()) {
+        return false;
+    }
+    uint64_t ack_time_ms = _primary_states.get_min_secondary_ack_time();
+    return ack_time_ms == UINT64_MAX || now_ms < ack_time_ms + FLAGS_primary_read_lease_ms;
+}
+
+bool replica::is_follower_read_allowed() const
+{
+    if (!FLAGS_follower_read_enabled ||
+        _secondary_states.primary_committed_decree == invalid_decree) {
+        return false;
+    }
+    if (dsn_now_coarse_ms() >
+        _secondary_states.primary_committed_decree_update_ms + FLAGS_follower_read_max_lag_ms) {
+        return false;
+    }
+    return last_committed_decree() + FLAGS_follower_read_max_lag_decrees >=
+           _secondary_states.primary_committed_decree;
+}
+
 void replica::response_client_read(dsn::message_ex *request, error_code error)
 {
-    _stub->response_client(get_gpid(), true, request, status(), error);
+    partition_configuration hint;
+    _stub->response_client(get_gpid(),
+                           true,
+                           request,
+                           status(),
+                           error,
+                           get_primary_hint(error, hint) ? &hint : nullptr);
 }
 
 void replica::response_client_write(dsn::message_ex *request, error_code error)
 {
-    _stub->response_client(get_gpid(), false, request, status(), error);
+    partition_configuration hint;
+    _stub->response_client(get_gpid(),
+                           false,
+                           request,
+                           status(),
+                           error,
+                           get_primary_hint(error, hint) ? &hint : nullptr);
+}
+
+bool replica::get_primary_hint(error_code error, /*out*/ partition_configuration &hint) const
+{
+    // only a replica which is not the primary tells the primary it knows
+    if (error != ERR_INVALID_STATE || status() == partition_status::PS_PRIMARY ||
+        _config.primary.is_invalid() || _config.primary == _stub->primary_address()) {
+        return false;
+    }
+    hint.pid = get_gpid();
+    hint.ballot = get_ballot();
+    hint.primary = _config.primary;
+    hint.max_replica_count = _app_info.max_replica_count;
+    return true;
 }
 
 void replica::check_state_completeness()
@@ -240,6 +374,7 @@ void replica::execute_mutation(mutation_ptr &mu)
         }
         break;
     case partition_status::PS_PRIMARY: {
+        mu->trace("commit");
         check_state_completeness();
         dassert(_app->last_committed_decree() + 1 == d,
                 "app commit: %" PRId64 ", mutation decree: %" PRId64 "",
@@ -303,13 +438,67 @@ void replica::execute_mutation(mutation_ptr &mu)
         handle_local_failure(err);
     }
 
+    on_mutation_executed(mu);
+}
+
+void replica::execute_mutations(std::vector<mutation_ptr> &mutations)
+{
+    // only the common cases are applied in batch, the others are executed one by one
+    bool batched = false;
+    switch (status()) {
+    case partition_status::PS_PRIMARY:
+        batched = true;
+        break;
+    case partition_status::PS_SECONDARY:
+        batched = !_secondary_states.checkpoint_is_running;
+        break;
+    default:
+        break;
+    }
+    if (!batched || _app->last_committed_decree() + 1 != mutations.front()->data.header.decree) {
+        for (mutation_ptr &mu : mutations) {
+            execute_mutation(mu);
+        }
+        return;
+    }
+
+    check_state_completeness();
+    std::vector<const mutation *> batch;
+    batch.reserve(mutations.size());
+    for (const mutation_ptr &mu : mutations) {
+        if (status() == partition_status::PS_PRIMARY) {
+            mu->trace("commit");
+        }
+        batch.push_back(mu.get());
+    }
+    error_code err = _app->apply_mutations(batch);
+
+    dinfo_replica("TwoPhaseCommit: mutations [{}, {}] committed in batch, err = {}",
+                  mutations.front()->name(),
+                  mutations.back()->name(),
+                  err.to_string());
+
+    if (err != ERR_OK) {
+        handle_local_failure(err);
+    }
+
+    for (mutation_ptr &mu : mutations) {
+        on_mutation_executed(mu);
+    }
+}
+
+void replica::on_mutation_executed(mutation_ptr &mu)
+{
+    decree d = mu->data.header.decree;
     if (status() == partition_status::PS_PRIMARY) {
         mutation_ptr next = _primary_states.write_queue.check_possible_work(
-            static_cast<int>(_prepare_list->max_decree() - d));
+            static_cast<int>(_prepare_list->max_decree() - d),
+            _prepare_list->appro_data_bytes_after(d));
 
         if (next) {
             init_prepare(next, false);
         }
+        dispatch_fair_writes();
     }
 
     // update table level latency perf-counters for primary partition
@@ -322,6 +511,11 @@ void replica::execute_mutation(mutation_ptr &mu)
                 _counters_table_level_latency[update.code]->set(now_ns - update.start_time_ns);
             }
         }
+        // the background i/o backs off if the foreground writes are slowed down
+        if (!mu->data.updates.empty()) {
+            io_scheduler::instance().observe_foreground_latency(
+                now_ns - mu->data.updates.front().start_time_ns);
+        }
     }
 }
 
@@ -339,6 +533,31 @@ decree replica::last_durable_decree() const { return _app->last_durable_decree()
 
 decree replica::last_flushed_decree() const { return _app->last_flushed_decree(); }
 
+int64_t replica::get_checkpoint_size_mb()
+{
+    decree durable_decree = last_durable_decree();
+    zauto_lock l(_checkpoint_size_lock);
+    if (durable_decree == _checkpoint_size_decree) {
+        return _checkpoint_size_mb;
+    }
+
+    std::vector<std::string> files;
+    if (!utils::filesystem::get_subfiles(_app->data_dir(), files, true)) {
+        dwarn_replica("get files of {} failed", _app->data_dir());
+        return _checkpoint_size_mb;
+    }
+    int64_t total_bytes = 0;
+    for (const std::string &file : files) {
+        int64_t bytes = 0;
+        if (utils::filesystem::file_size(file, bytes)) {
+            total_bytes += bytes;
+        }
+    }
+    _checkpoint_size_decree = durable_decree;
+    _checkpoint_size_mb = total_bytes >> 20;
+    return _checkpoint_size_mb;
+}
+
 decree replica::last_prepared_decree() const
 {
     ballot lastBallot = 0;
@@ -356,7 +575,7 @@ decree replica::last_prepared_decree() const
 
 bool replica::verbose_commit_log() const { return _stub->_verbose_commit_log; }
 
-void replica::close()
+void replica::close(decree checkpoint_min_log_tail)
 {
     dassert(status() == partition_status::PS_ERROR || status() == partition_status::PS_INACTIVE,
             "%s: invalid state %s when calling replica::close",
@@ -395,9 +614,26 @@ void replica::close()
         dassert(r, "potential secondary context is not cleared");
     }
 
+    if (checkpoint_min_log_tail > 0 && _app != nullptr &&
+        last_committed_decree() - last_durable_decree() > checkpoint_min_log_tail) {
+        error_code err = _app->sync_checkpoint();
+        ddebug("%s: checkpoint before closed, err = %s, last_durable_decree = %" PRId64,
+               name(),
+               err.to_string(),
+               last_durable_decree());
+    }
+
+    // the shutdown is clean if none of the mutations in the private log needs to be replayed
+    replica_clean_shutdown_info clean_info;
+    bool clean_shutdown = false;
     if (_private_log != nullptr) {
-        _private_log->close();
+        _private_log->close(clean_info.log_tail);
         _private_log = nullptr;
+        if (_app != nullptr && status() != partition_status::PS_ERROR) {
+            clean_info.last_durable_decree = last_durable_decree();
+            clean_shutdown = clean_info.log_tail.last_file_index > 0 &&
+                             clean_info.log_tail.max_decree <= clean_info.last_durable_decree;
+        }
     }
 
     if (_app != nullptr) {
@@ -405,10 +641,16 @@ void replica::close()
         error_code err = tmp_app->close(false);
         if (err != dsn::ERR_OK) {
             dwarn("%s: close app failed, err = %s", name(), err.to_string());
+            clean_shutdown = false;
         }
     }
 
+    if (clean_shutdown) {
+        store_clean_shutdown_info(clean_info);
+    }
+
     _counter_private_log_size.clear();
+    _stub->get_app_counters().detach(get_gpid(), &_app_counter_shard);
 
     // duplication_impl may have ongoing tasks.
     // release it before release replica.
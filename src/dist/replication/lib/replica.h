@@ -55,6 +55,8 @@
 #include "prepare_list.h"
 #include "replica_context.h"
 #include "throttling_controller.h"
+#include "app_counters.h"
+#include "hotspot_detector.h"
 
 namespace dsn {
 namespace replication {
@@ -69,6 +71,15 @@ namespace test {
 class test_checker;
 }
 
+// written into the replica dir when the replica is closed cleanly, with which the private log
+// needn't be replayed on the next open
+struct replica_clean_shutdown_info
+{
+    decree last_durable_decree;
+    mutation_log_tail log_tail;
+    DEFINE_JSON_SERIALIZATION(last_durable_decree, log_tail)
+};
+
 class replica : public serverlet<replica>, public ref_counter, public replica_base
 {
 public:
@@ -77,7 +88,10 @@ public:
     //
     //    routines for replica stub
     //
-    static replica *load(replica_stub *stub, const char *dir);
+    // the app info is read from the .app-info of `dir` unless `cached_info` is given, which
+    // is from the replica manifest of the disk
+    static replica *
+    load(replica_stub *stub, const char *dir, const app_info *cached_info = nullptr);
     // {parent_dir} is used in partition split for get_child_dir in replica_stub
     static replica *newr(replica_stub *stub,
                          gpid gpid,
@@ -95,8 +109,10 @@ public:
     void check_state_completeness();
     // error_code check_and_fix_private_log_completeness();
 
-    // close() will wait all traced tasks to finish
-    void close();
+    // close() will wait all traced tasks to finish. The app is checkpointed before closed if
+    // more than `checkpoint_min_log_tail` committed mutations are not durable yet, so that
+    // fewer logs are replayed on the next open; 0 means never.
+    void close(decree checkpoint_min_log_tail = 0);
 
     //
     //    requests from clients
@@ -112,6 +128,17 @@ public:
     /// \return true if request is throttled.
     /// \see replica::on_client_write
     bool throttle_request(throttling_controller &c, message_ex *request, int32_t req_units);
+    /// delay write requests in proportion to how full the prepare window or the memory budget
+    /// of this node is, and reject them beyond the memory budget
+    /// \return true if request is delayed or rejected.
+    bool throttle_by_backpressure(message_ex *request);
+    void delay_client_write(message_ex *request, int64_t delay_ms);
+    /// queue write requests in the fair order of the clients, see write_fair_queue
+    void enqueue_fair_write(message_ex *request);
+    /// move the queued write requests into write_queue as long as it takes them without waiting
+    void dispatch_fair_writes();
+    /// count a throttled write into the app counters and the replica level `counter` if any
+    void increment_throttling_counter(app_counter_type type, perf_counter_wrapper &counter);
     /// update throttling controllers
     /// \see replica::update_app_envs
     void update_throttle_envs(const std::map<std::string, std::string> &envs);
@@ -130,6 +157,7 @@ public:
     //    messages from peers (primary or secondary)
     //
     void on_prepare(dsn::message_ex *request);
+    void on_prepare_batch(dsn::message_ex *request);
     void on_learn(dsn::message_ex *msg, const learn_request &request);
     void on_learn_completion_notification(const group_check_response &report,
                                           /*out*/ learn_notify_response &response);
@@ -139,6 +167,7 @@ public:
     void on_add_learner(const group_check_request &request);
     void on_remove(const replica_configuration &request);
     void on_group_check(const group_check_request &request, /*out*/ group_check_response &response);
+    void on_commit_notify(const group_check_request &request);
     void on_copy_checkpoint(const replica_configuration &request, /*out*/ learn_response &response);
 
     //
@@ -160,9 +189,19 @@ public:
     const app_info *get_app_info() const { return &_app_info; }
     decree max_prepared_decree() const { return _prepare_list->max_decree(); }
     decree last_committed_decree() const { return _prepare_list->last_committed_decree(); }
+    // the committed mutations since decree `start` which are still kept in the prepare list,
+    // thread-safe
+    int get_committed_mutations(decree start, /*out*/ std::vector<mutation_ptr> &mutations) const
+    {
+        return _prepare_list->get_committed_mutations(start, mutations);
+    }
+    // approximate bytes of the mutations in the prepare list, thread-safe
+    int64_t get_prepare_list_bytes() const { return _prepare_list->appro_data_bytes(); }
     decree last_prepared_decree() const;
     decree last_durable_decree() const;
     decree last_flushed_decree() const;
+    // size of the data dir in MB, which is only re-calculated after a new checkpoint, thread-safe
+    int64_t get_checkpoint_size_mb();
     const std::string &dir() const { return _dir; }
     uint64_t create_time_milliseconds() const { return _create_time_ms; }
     const char *name() const { return replica_name(); }
@@ -207,7 +246,13 @@ private:
     void init_state();
     void response_client_read(dsn::message_ex *request, error_code error);
     void response_client_write(dsn::message_ex *request, error_code error);
+    // the primary known by this replica if it rejects a client request with `error`
+    bool get_primary_hint(error_code error, /*out*/ partition_configuration &hint) const;
     void execute_mutation(mutation_ptr &mu);
+    // Commits consecutive mutations, which are applied to the app in one batch if the app
+    // supports it, see replication_app_base::support_batched_mutations().
+    void execute_mutations(std::vector<mutation_ptr> &mutations);
+    void on_mutation_executed(mutation_ptr &mu);
     mutation_ptr new_mutation(decree decree);
 
     // initialization
@@ -216,6 +261,9 @@ private:
     error_code initialize_on_load();
     error_code init_app_and_prepare_list(bool create_new);
     decree get_replay_start_decree();
+    // the clean shutdown info is removed once loaded, so that it's never used twice
+    bool load_clean_shutdown_info(/*out*/ replica_clean_shutdown_info &info);
+    void store_clean_shutdown_info(const replica_clean_shutdown_info &info);
 
     /////////////////////////////////////////////////////////////////
     // 2pc
@@ -223,19 +271,50 @@ private:
     // See more about it in `replica_bulk_loader.cpp`
     void
     init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_committed_mutations = false);
+    // add the write request into write_queue, and prepare the mutation if it can start now
+    void add_client_write(message_ex *request);
+    // prepare the mutation held in the batch window of write_queue
+    void on_write_batch_window_end();
     void send_prepare_message(::dsn::rpc_address addr,
                               partition_status::type status,
                               const mutation_ptr &mu,
                               int timeout_milliseconds,
                               bool pop_all_committed_mutations = false,
                               int64_t learn_signature = invalid_signature);
+    // appends `mu` to the batch to secondary `addr`, and sends the batch if possible
+    void add_to_prepare_batch(::dsn::rpc_address addr, const mutation_ptr &mu);
+    void send_prepare_batch(::dsn::rpc_address addr, const prepare_batch_ptr &batch);
     void on_append_log_completed(mutation_ptr &mu, error_code err, size_t size);
+    // if the pipeline stays idle for `commit_broadcast_delay_ms` after a commit, the commit
+    // point that is not carried by any prepare yet is sent to the secondaries by
+    // broadcast_commit(), rather than waiting for the next prepare or group check
+    void schedule_commit_broadcast();
+    void broadcast_commit();
+    // the log that makes prepared mutations durable: the shared log, or the private log if
+    // the shared log is disabled
+    mutation_log *durable_log() const;
     void on_prepare_reply(std::pair<mutation_ptr, partition_status::type> pr,
                           error_code err,
                           dsn::message_ex *request,
                           dsn::message_ex *reply);
+    void on_prepare_batch_reply(const prepare_batch_ptr &batch,
+                                const std::vector<mutation_ptr> &mutations,
+                                error_code err,
+                                dsn::message_ex *request,
+                                dsn::message_ex *reply);
+    void handle_prepare_ack(mutation_ptr mu,
+                            partition_status::type target_status,
+                            ::dsn::rpc_address node,
+                            const prepare_ack &resp);
+    // returns false if the prepare should not go on, and a non-ERR_OK `ack_err` should be
+    // replied to the primary
+    bool check_prepare_config(const replica_configuration &rconfig,
+                              const mutation_ptr &mu,
+                              /*out*/ error_code &ack_err);
+    void do_prepare(mutation_ptr &mu);
     void do_possible_commit_on_primary(mutation_ptr &mu);
     void ack_prepare_message(error_code err, mutation_ptr &mu);
+    void reply_prepare_batch(const prepare_batch_ack &batch);
     void cleanup_preparing_mutations(bool wait);
 
     /////////////////////////////////////////////////////////////////
@@ -249,6 +328,9 @@ private:
                                         learn_response &&resp);
     void on_learn_remote_state_completed(error_code err);
     void handle_learning_error(error_code err, bool is_local_error);
+    // called by replica_stub once the slot of learning the app checkpoint is taken for this
+    // learner, which was queued as no slot was available
+    void on_learn_slot_granted();
     error_code handle_learning_succeeded_on_primary(::dsn::rpc_address node,
                                                     uint64_t learn_signature);
     void notify_learn_completion();
@@ -265,6 +347,35 @@ private:
     // This method is called on learner-side.
     decree get_max_gced_decree_for_learn() const;
 
+    // Collects the files under the local data dir for the learnee to match, with md5 unset.
+    // This method is called on learner-side.
+    std::vector<file_meta> collect_local_learn_files() const;
+
+    // Finds the checkpoint files in `resp.state.files` which have the same name and size as a
+    // file in `local_files`, and sets them with their md5 into `resp.reused_files`.
+    // Returns ERR_BUSY if md5 of some of them is still being computed in background.
+    // This method is called on primary-side.
+    error_code get_reused_learn_files(const std::vector<file_meta> &local_files,
+                                      learn_response &resp);
+
+    // Fills `resp` with the checkpoint of a secondary for the learner to copy from it, so that
+    // primary only serves the logs after the checkpoint. Returns false if the learner should
+    // learn the checkpoint of primary, or sets ERR_BUSY into `resp` while the checkpoint of the
+    // secondary is being queried.
+    // This method is called on primary-side.
+    bool get_checkpoint_from_secondary(const learn_request &request,
+                                       remote_learner_state &learner_state,
+                                       learn_response &resp);
+    void on_query_secondary_checkpoint_reply(error_code err,
+                                             ::dsn::rpc_address learner,
+                                             int64_t signature,
+                                             learn_response &&resp);
+
+    // Copies the files in `resp.reused_files` from the local data dir into the learn dir if
+    // their md5 matches, and copies the rest of `resp.state.files` from learnee.
+    // This method is called on learner-side, in THREAD_POOL_REPLICATION_LONG.
+    void copy_reused_and_remote_files(learn_request &&req, learn_response &&resp);
+
     /////////////////////////////////////////////////////////////////
     // failure handling
     void handle_local_failure(error_code error);
@@ -306,7 +417,17 @@ private:
     void broadcast_group_check();
     void on_group_check_reply(error_code err,
                               const std::shared_ptr<group_check_request> &req,
-                              const std::shared_ptr<group_check_response> &resp);
+                              const std::shared_ptr<group_check_response> &resp,
+                              uint64_t send_time_ms);
+
+    // whether this primary can still serve reads locally: the meta server has not removed it
+    // (failure detector lease) and all the secondaries have recently acked it (group check or
+    // prepare acks within primary_read_lease_ms)
+    bool is_read_lease_valid() const;
+
+    // whether this secondary is fresh enough to serve follower reads, i.e. it has recently got
+    // the commit point of the primary, and lags behind it no more than the configured decrees
+    bool is_follower_read_allowed() const;
 
     /////////////////////////////////////////////////////////////////
     // check timer for gc, checkpointing etc.
@@ -375,6 +496,10 @@ private:
 
     void parent_prepare_states(const std::string &dir);
 
+    // hard link the files of the latest checkpoint into child's dir, which is cheaper than
+    // copying a new checkpoint, the out-of-range keys are left for the storage engine to filter
+    error_code parent_link_checkpoint(const std::string &dir, /*out*/ learn_state &state);
+
     // child copy parent prepare list and call child_learn_states
     void child_copy_prepare_list(learn_state lstate,
                                  std::vector<mutation_ptr> mutation_list,
@@ -403,6 +528,9 @@ private:
     // child catch up parent states while executing async learn task
     void child_catch_up_states();
 
+    // child has caught up parent states, mark it and notify parent
+    void child_finish_catch_up();
+
     // child send notification to primary parent when it finish async learn
     void child_notify_catch_up();
 
@@ -544,15 +672,33 @@ private:
     // if replica in bulk load ingestion 2pc, will reject other write requests
     bool _is_bulk_load_ingestion{false};
 
+    // cache of get_checkpoint_size_mb(), which is calculated at _checkpoint_size_decree
+    zlock _checkpoint_size_lock;
+    decree _checkpoint_size_decree{-1};
+    int64_t _checkpoint_size_mb{0};
+
     // perf counters
+    // the counters aggregated by app, the replica level ones of which are only registered
+    // if [replication] replica_level_counters_enabled is set
+    app_counter_shard _app_counter_shard;
+    // the load of the requests served, reported to meta server if the partition is hot
+    hotspot_detector _hotspot_detector;
     perf_counter_wrapper _counter_private_log_size;
     perf_counter_wrapper _counter_recent_write_throttling_delay_count;
+    perf_counter_wrapper _counter_recent_write_backpressure_delay_count;
     perf_counter_wrapper _counter_recent_write_throttling_reject_count;
+    // the max count of the mutations prepared concurrently, see adaptive_2pc_window
+    perf_counter_wrapper _counter_2pc_window;
+    // how long the client writes wait in the write queue before being prepared
+    perf_counter_wrapper _counter_write_queue_time;
     std::vector<perf_counter *> _counters_table_level_latency;
     perf_counter_wrapper _counter_dup_disabled_non_idempotent_write_count;
     perf_counter_wrapper _counter_backup_request_qps;
+    perf_counter_wrapper _counter_restore_download_bytes;
+    perf_counter_wrapper _counter_restore_progress;
 
-    dsn::task_tracker _tracker;
+    // shared by the tasks of the replication, io and timer threads
+    dsn::task_tracker _tracker{dsn::task_tracker::SHARDED_BUCKET_COUNT};
     // the thread access checker
     dsn::thread_access_checker _checker;
 };
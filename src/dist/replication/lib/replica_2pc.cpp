@@ -30,10 +30,36 @@
 #include "replica_stub.h"
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  prepare_batch_max_count,
+                  1,
+                  "max count of mutations sent to a secondary in one RPC_PREPARE_BATCH message, "
+                  "which is acked once with the highest contiguously logged decree; 1 means "
+                  "sending one RPC_PREPARE message for each mutation. Do not enable it until all "
+                  "the replica servers support RPC_PREPARE_BATCH");
+DSN_DEFINE_uint32("replication",
+                  prepare_batch_max_inflight,
+                  2,
+                  "max count of RPC_PREPARE_BATCH messages in flight to a secondary, new "
+                  "mutations are accumulated into the next batch while the limit is reached, "
+                  "until prepare_batch_max_count mutations are accumulated");
+DSN_DEFINE_validator(prepare_batch_max_count, [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_validator(prepare_batch_max_inflight, [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_uint32("replication",
+                  commit_broadcast_delay_ms,
+                  0,
+                  "if no prepare is sent within the delay after the primary commits, the commit "
+                  "point is sent to the secondaries by a one-way RPC_COMMIT_NOTIFY, so that they "
+                  "apply the mutation without waiting for the next prepare or group check; 0 "
+                  "means disabled. Do not enable it until all the replica servers support "
+                  "RPC_COMMIT_NOTIFY");
+DSN_DECLARE_uint32(write_batch_window_ms);
+
 void replica::on_client_write(dsn::message_ex *request, bool ignore_throttling)
 {
     _checker.only_one_thread_access();
@@ -107,15 +133,54 @@ void replica::on_client_write(dsn::message_ex *request, bool ignore_throttling)
         if (throttle_request(_write_size_throttling_controller, request, request->body_size())) {
             return;
         }
+        if (throttle_by_backpressure(request)) {
+            return;
+        }
+    }
+
+    _hotspot_detector.record(request->header->client.partition_hash, request->body_size(), true);
+
+    if (_primary_states.fair_queue.enabled() || !_primary_states.fair_queue.empty()) {
+        enqueue_fair_write(request);
+        return;
     }
+    add_client_write(request);
+}
 
+void replica::add_client_write(message_ex *request)
+{
     dinfo("%s: got write request from %s", name(), request->header->from_address.to_string());
     auto mu = _primary_states.write_queue.add_work(request->rpc_code(), request, this);
     if (mu) {
         init_prepare(mu, false);
+    } else if (FLAGS_write_batch_window_ms > 0 && _primary_states.write_queue.has_pending() &&
+               _primary_states.write_batch_task == nullptr) {
+        // the clients are replied separately when the coalesced mutation is committed
+        _primary_states.write_batch_task =
+            tasking::enqueue(LPC_WRITE_BATCH_WINDOW,
+                             &_tracker,
+                             [this]() { on_write_batch_window_end(); },
+                             get_gpid().thread_hash(),
+                             std::chrono::milliseconds(FLAGS_write_batch_window_ms));
     }
 }
 
+void replica::on_write_batch_window_end()
+{
+    _checker.only_one_thread_access();
+
+    _primary_states.write_batch_task = nullptr;
+    if (partition_status::PS_PRIMARY != status()) {
+        return;
+    }
+
+    auto mu = _primary_states.write_queue.flush_pending();
+    if (mu) {
+        init_prepare(mu, false);
+    }
+    dispatch_fair_writes();
+}
+
 void replica::init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_committed_mutations)
 {
     dassert(partition_status::PS_PRIMARY == status(),
@@ -144,6 +209,7 @@ void replica::init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_c
          name(),
          mu->name(),
          mu->tid());
+    mu->trace("init_prepare");
 
     // check bounded staleness
     if (mu->data.header.decree > last_committed_decree() + _options->staleness_for_commit) {
@@ -189,17 +255,25 @@ void replica::init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_c
         goto ErrOut;
     }
 
+    if (!reconciliation && mu->start_ts_ns() != 0 && _counter_write_queue_time.get() != nullptr) {
+        _counter_write_queue_time->set(mu->start_ts_ns() - mu->create_ts_ns());
+    }
+
     // remote prepare
     mu->set_prepare_ts();
     mu->set_left_secondary_ack_count((unsigned int)_primary_states.membership.secondaries.size());
     for (auto it = _primary_states.membership.secondaries.begin();
          it != _primary_states.membership.secondaries.end();
          ++it) {
-        send_prepare_message(*it,
-                             partition_status::PS_SECONDARY,
-                             mu,
-                             _options->prepare_timeout_ms_for_secondaries,
-                             pop_all_committed_mutations);
+        if (FLAGS_prepare_batch_max_count > 1 && !pop_all_committed_mutations) {
+            add_to_prepare_batch(*it, mu);
+        } else {
+            send_prepare_message(*it,
+                                 partition_status::PS_SECONDARY,
+                                 mu,
+                                 _options->prepare_timeout_ms_for_secondaries,
+                                 pop_all_committed_mutations);
+        }
     }
 
     count = 0;
@@ -225,16 +299,16 @@ void replica::init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_c
                 mu->data.header.log_offset);
         dassert(mu->log_task() == nullptr, "");
         int64_t pending_size;
-        mu->log_task() = _stub->_log->append(mu,
-                                             LPC_WRITE_REPLICATION_LOG,
-                                             &_tracker,
-                                             std::bind(&replica::on_append_log_completed,
-                                                       this,
-                                                       mu,
-                                                       std::placeholders::_1,
-                                                       std::placeholders::_2),
-                                             get_gpid().thread_hash(),
-                                             &pending_size);
+        mu->log_task() = durable_log()->append(mu,
+                                               LPC_WRITE_REPLICATION_LOG,
+                                               &_tracker,
+                                               std::bind(&replica::on_append_log_completed,
+                                                         this,
+                                                         mu,
+                                                         std::placeholders::_1,
+                                                         std::placeholders::_2),
+                                               get_gpid().thread_hash(),
+                                               &pending_size);
         dassert(nullptr != mu->log_task(), "");
         if (_options->log_shared_pending_size_throttling_threshold_kb > 0 &&
             _options->log_shared_pending_size_throttling_delay_ms > 0 &&
@@ -253,6 +327,8 @@ void replica::init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_c
     }
 
     _primary_states.last_prepare_ts_ms = mu->prepare_ts_ms();
+    _primary_states.last_sent_committed_decree = std::max(
+        _primary_states.last_sent_committed_decree, mu->data.header.last_committed_decree);
     return;
 
 ErrOut:
@@ -298,6 +374,71 @@ void replica::send_prepare_message(::dsn::rpc_address addr,
           enum_to_string(rconfig.status));
 }
 
+void replica::add_to_prepare_batch(::dsn::rpc_address addr, const mutation_ptr &mu)
+{
+    prepare_batch_ptr &batch = _primary_states.prepare_batches[addr];
+    if (batch == nullptr) {
+        batch = std::make_shared<prepare_batch>();
+    }
+    batch->pending.push_back(mu);
+
+    // the pending mutations are sent when an in-flight batch is replied
+    if (batch->inflight_count < FLAGS_prepare_batch_max_inflight ||
+        batch->pending.size() >= FLAGS_prepare_batch_max_count) {
+        send_prepare_batch(addr, batch);
+    }
+}
+
+void replica::send_prepare_batch(::dsn::rpc_address addr, const prepare_batch_ptr &batch)
+{
+    std::vector<mutation_ptr> mutations;
+    for (auto &mu : batch->pending) {
+        // the mutation may have been committed or become stale since it is added
+        if (mu->data.header.ballot == get_ballot() && mu->get_decree() > last_committed_decree()) {
+            mutations.emplace_back(std::move(mu));
+        }
+    }
+    batch->pending.clear();
+    if (mutations.empty()) {
+        return;
+    }
+
+    dsn::message_ex *msg = dsn::message_ex::create_request(
+        RPC_PREPARE_BATCH, _options->prepare_timeout_ms_for_secondaries, get_gpid().thread_hash());
+    replica_configuration rconfig;
+    _primary_states.get_replica_config(partition_status::PS_SECONDARY, rconfig);
+
+    {
+        rpc_write_stream writer(msg);
+        marshall(writer, get_gpid(), DSF_THRIFT_BINARY);
+        marshall(writer, rconfig, DSF_THRIFT_BINARY);
+        writer.write_pod(static_cast<int>(mutations.size()));
+        for (auto &mu : mutations) {
+            mu->write_to(writer, msg);
+        }
+    }
+
+    batch->inflight_count++;
+    dsn::task_ptr rpc_task =
+        rpc::call(addr,
+                  msg,
+                  &_tracker,
+                  [=](error_code err, dsn::message_ex *request, dsn::message_ex *reply) {
+                      on_prepare_batch_reply(batch, mutations, err, request, reply);
+                  },
+                  get_gpid().thread_hash());
+    for (auto &mu : mutations) {
+        mu->remote_tasks()[addr] = rpc_task;
+    }
+
+    dinfo_replica("send_prepare_batch to {}, decree = [{}, {}], count = {}, inflight_count = {}",
+                  addr.to_string(),
+                  mutations.front()->get_decree(),
+                  mutations.back()->get_decree(),
+                  mutations.size(),
+                  batch->inflight_count);
+}
+
 void replica::do_possible_commit_on_primary(mutation_ptr &mu)
 {
     dassert(_config.ballot == mu->data.header.ballot,
@@ -309,8 +450,58 @@ void replica::do_possible_commit_on_primary(mutation_ptr &mu)
             enum_to_string(status()));
 
     if (mu->is_ready_for_commit()) {
+        _primary_states.write_queue.on_committed(mu.get());
+        if (_counter_2pc_window.get() != nullptr) {
+            _counter_2pc_window->set(_primary_states.write_queue.max_concurrent_ops());
+        }
         _prepare_list->commit(mu->data.header.decree, COMMIT_ALL_READY);
+        schedule_commit_broadcast();
+    }
+}
+
+void replica::schedule_commit_broadcast()
+{
+    if (FLAGS_commit_broadcast_delay_ms == 0 || _primary_states.commit_broadcast_task != nullptr ||
+        last_committed_decree() <= _primary_states.last_sent_committed_decree) {
+        return;
+    }
+
+    _primary_states.commit_broadcast_task =
+        tasking::enqueue(LPC_COMMIT_BROADCAST,
+                         &_tracker,
+                         [this]() { broadcast_commit(); },
+                         get_gpid().thread_hash(),
+                         std::chrono::milliseconds(FLAGS_commit_broadcast_delay_ms));
+}
+
+void replica::broadcast_commit()
+{
+    _checker.only_one_thread_access();
+
+    _primary_states.commit_broadcast_task = nullptr;
+    if (status() != partition_status::PS_PRIMARY) {
+        return;
+    }
+
+    // the commit point has been sent with the prepares since the commit
+    decree committed = last_committed_decree();
+    if (committed <= _primary_states.last_sent_committed_decree) {
+        return;
     }
+
+    for (const auto &addr : _primary_states.membership.secondaries) {
+        group_check_request request;
+        request.app = _app_info;
+        request.node = addr;
+        _primary_states.get_replica_config(partition_status::PS_SECONDARY, request.config);
+        request.last_committed_decree = committed;
+        rpc::call_one_way_typed(addr, RPC_COMMIT_NOTIFY, request, get_gpid().thread_hash());
+    }
+    _primary_states.last_sent_committed_decree = committed;
+
+    dinfo_replica("broadcast commit to {} secondaries, last_committed_decree = {}",
+                  _primary_states.membership.secondaries.size(),
+                  committed);
 }
 
 void replica::on_prepare(dsn::message_ex *request)
@@ -326,10 +517,79 @@ void replica::on_prepare(dsn::message_ex *request)
         mu = mutation::read_from(reader, request);
     }
 
-    decree decree = mu->data.header.decree;
-
     dinfo("%s: mutation %s on_prepare", name(), mu->name());
 
+    error_code ack_err;
+    if (!check_prepare_config(rconfig, mu, ack_err)) {
+        if (ack_err != ERR_OK) {
+            ack_prepare_message(ack_err, mu);
+        }
+        return;
+    }
+
+    do_prepare(mu);
+}
+
+void replica::on_prepare_batch(dsn::message_ex *request)
+{
+    _checker.only_one_thread_access();
+
+    replica_configuration rconfig;
+    std::vector<mutation_ptr> mutations;
+
+    {
+        rpc_read_stream reader(request);
+        unmarshall(reader, rconfig, DSF_THRIFT_BINARY);
+        int count = 0;
+        reader.read_pod(count);
+        dassert(count > 0, "invalid mutation count %d in batch", count);
+        mutations.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            // the batch is acked by prepare_batch_ack rather than each mutation
+            mutations.emplace_back(mutation::read_from(reader, nullptr));
+        }
+    }
+
+    std::vector<decree> decrees;
+    decrees.reserve(mutations.size());
+    for (auto &mu : mutations) {
+        dassert(mu->data.header.ballot == rconfig.ballot,
+                "invalid mutation ballot, %" PRId64 " VS %" PRId64 "",
+                mu->data.header.ballot,
+                rconfig.ballot);
+        decrees.push_back(mu->get_decree());
+    }
+    prepare_batch_ack_ptr batch(new prepare_batch_ack(request, std::move(decrees)));
+
+    dinfo_replica("on_prepare_batch, decree = [{}, {}], count = {}",
+                  mutations.front()->get_decree(),
+                  mutations.back()->get_decree(),
+                  mutations.size());
+
+    // all the mutations in the batch share the same configuration
+    error_code ack_err;
+    if (!check_prepare_config(rconfig, mutations.front(), ack_err)) {
+        if (ack_err != ERR_OK) {
+            for (int i = 0; i < batch->size(); ++i) {
+                batch->ack(i, ack_err);
+            }
+            reply_prepare_batch(*batch);
+        }
+        return;
+    }
+
+    for (int i = 0; i < batch->size(); ++i) {
+        mutations[i]->add_prepare_batch(batch, i);
+        do_prepare(mutations[i]);
+    }
+}
+
+bool replica::check_prepare_config(const replica_configuration &rconfig,
+                                   const mutation_ptr &mu,
+                                   /*out*/ error_code &ack_err)
+{
+    ack_err = ERR_OK;
+
     dassert(mu->data.header.pid == rconfig.pid,
             "(%d.%d) VS (%d.%d)",
             mu->data.header.pid.get_app_id(),
@@ -344,7 +604,7 @@ void replica::on_prepare(dsn::message_ex *request)
     if (mu->data.header.ballot < get_ballot()) {
         derror("%s: mutation %s on_prepare skipped due to old view", name(), mu->name());
         // no need response because the rpc should have been cancelled on primary in this case
-        return;
+        return false;
     }
 
     // update configuration when necessary
@@ -355,8 +615,8 @@ void replica::on_prepare(dsn::message_ex *request)
                    name(),
                    mu->name(),
                    enum_to_string(status()));
-            ack_prepare_message(ERR_INVALID_STATE, mu);
-            return;
+            ack_err = ERR_INVALID_STATE;
+            return false;
         }
     }
 
@@ -365,11 +625,10 @@ void replica::on_prepare(dsn::message_ex *request)
                name(),
                mu->name(),
                enum_to_string(status()));
-        ack_prepare_message((partition_status::PS_INACTIVE == status() && _inactive_is_transient)
-                                ? ERR_INACTIVE_STATE
-                                : ERR_INVALID_STATE,
-                            mu);
-        return;
+        ack_err = (partition_status::PS_INACTIVE == status() && _inactive_is_transient)
+                      ? ERR_INACTIVE_STATE
+                      : ERR_INVALID_STATE;
+        return false;
     } else if (partition_status::PS_POTENTIAL_SECONDARY == status()) {
         // new learning process
         if (rconfig.learner_signature != _potential_secondary_states.learning_version) {
@@ -381,8 +640,8 @@ void replica::on_prepare(dsn::message_ex *request)
                    _potential_secondary_states.learning_version,
                    rconfig.learner_signature);
             handle_learning_error(ERR_INVALID_STATE, false);
-            ack_prepare_message(ERR_INVALID_STATE, mu);
-            return;
+            ack_err = ERR_INVALID_STATE;
+            return false;
         }
 
         auto learning_status = _potential_secondary_states.learning_status;
@@ -400,8 +659,8 @@ void replica::on_prepare(dsn::message_ex *request)
                    enum_to_string(status()),
                    enum_to_string(learning_status),
                    ack_code.to_string());
-            ack_prepare_message(ack_code, mu);
-            return;
+            ack_err = ack_code;
+            return false;
         }
     }
 
@@ -409,6 +668,16 @@ void replica::on_prepare(dsn::message_ex *request)
             "invalid status, %s VS %s",
             enum_to_string(rconfig.status),
             enum_to_string(status()));
+    return true;
+}
+
+void replica::do_prepare(mutation_ptr &mu)
+{
+    if (partition_status::PS_SECONDARY == status()) {
+        _secondary_states.update_primary_committed_decree(mu->data.header.last_committed_decree);
+    }
+
+    decree decree = mu->data.header.decree;
     if (decree <= last_committed_decree()) {
         ack_prepare_message(ERR_OK, mu);
         return;
@@ -423,7 +692,12 @@ void replica::on_prepare(dsn::message_ex *request)
             ack_prepare_message(ERR_OK, mu);
         } else {
             // not logged, combine duplicate request to old mutation
-            mu2->add_prepare_request(request);
+            for (auto &request : mu->prepare_requests()) {
+                mu2->add_prepare_request(request);
+            }
+            for (auto &batch : mu->prepare_batches()) {
+                mu2->add_prepare_batch(batch.first, batch.second);
+            }
         }
         return;
     }
@@ -456,18 +730,23 @@ void replica::on_prepare(dsn::message_ex *request)
     }
 
     dassert(mu->log_task() == nullptr, "");
-    mu->log_task() = _stub->_log->append(mu,
-                                         LPC_WRITE_REPLICATION_LOG,
-                                         &_tracker,
-                                         std::bind(&replica::on_append_log_completed,
-                                                   this,
-                                                   mu,
-                                                   std::placeholders::_1,
-                                                   std::placeholders::_2),
-                                         get_gpid().thread_hash());
+    mu->log_task() = durable_log()->append(mu,
+                                           LPC_WRITE_REPLICATION_LOG,
+                                           &_tracker,
+                                           std::bind(&replica::on_append_log_completed,
+                                                     this,
+                                                     mu,
+                                                     std::placeholders::_1,
+                                                     std::placeholders::_2),
+                                           get_gpid().thread_hash());
     dassert(nullptr != mu->log_task(), "");
 }
 
+mutation_log *replica::durable_log() const
+{
+    return _stub->_log_shared_disabled ? _private_log.get() : _stub->_log.get();
+}
+
 void replica::on_append_log_completed(mutation_ptr &mu, error_code err, size_t size)
 {
     _checker.only_one_thread_access();
@@ -480,6 +759,7 @@ void replica::on_append_log_completed(mutation_ptr &mu, error_code err, size_t s
 
     if (err == ERR_OK) {
         mu->set_logged();
+        mu->trace("log_append");
     } else {
         derror("%s: append shared log failed for mutation %s, err = %s",
                name(),
@@ -513,6 +793,11 @@ void replica::on_append_log_completed(mutation_ptr &mu, error_code err, size_t s
         }
     }
 
+    if (_stub->_log_shared_disabled) {
+        // the mutation is already in the private log, whose failure only affects this replica
+        return;
+    }
+
     if (err != ERR_OK) {
         // mutation log failure, propagate to all replicas
         _stub->handle_log_failure(err);
@@ -531,23 +816,12 @@ void replica::on_prepare_reply(std::pair<mutation_ptr, partition_status::type> p
 {
     _checker.only_one_thread_access();
 
-    mutation_ptr mu = pr.first;
-    partition_status::type target_status = pr.second;
-
     // skip callback for old mutations
+    const mutation_ptr &mu = pr.first;
     if (partition_status::PS_PRIMARY != status() || mu->data.header.ballot < get_ballot() ||
         mu->get_decree() <= last_committed_decree())
         return;
 
-    dassert(mu->data.header.ballot == get_ballot(),
-            "%s: invalid mutation ballot, %" PRId64 " VS %" PRId64 "",
-            mu->name(),
-            mu->data.header.ballot,
-            get_ballot());
-
-    ::dsn::rpc_address node = request->to_address;
-    partition_status::type st = _primary_states.get_node_status(node);
-
     // handle reply
     prepare_ack resp;
 
@@ -558,6 +832,73 @@ void replica::on_prepare_reply(std::pair<mutation_ptr, partition_status::type> p
         ::dsn::unmarshall(reply, resp);
     }
 
+    handle_prepare_ack(mu, pr.second, request->to_address, resp);
+}
+
+void replica::on_prepare_batch_reply(const prepare_batch_ptr &batch,
+                                     const std::vector<mutation_ptr> &mutations,
+                                     error_code err,
+                                     dsn::message_ex *request,
+                                     dsn::message_ex *reply)
+{
+    _checker.only_one_thread_access();
+
+    ::dsn::rpc_address node = request->to_address;
+    prepare_ack resp;
+    if (err != ERR_OK) {
+        resp.err = err;
+        resp.decree = invalid_decree;
+    } else {
+        ::dsn::unmarshall(reply, resp);
+    }
+
+    // the ack is cumulative: the mutations up to resp.decree are logged, while the others
+    // fail with resp.err
+    for (const mutation_ptr &mu : mutations) {
+        prepare_ack mu_resp = resp;
+        if (mu->get_decree() <= resp.decree) {
+            mu_resp.err = ERR_OK;
+        } else {
+            dassert_replica(resp.err != ERR_OK,
+                            "mutation {} is not acked by {}, acked decree = {}",
+                            mu->name(),
+                            node.to_string(),
+                            resp.decree);
+        }
+        mu_resp.decree = mu->get_decree();
+
+        // skip callback for old mutations
+        if (partition_status::PS_PRIMARY != status() || mu->data.header.ballot < get_ballot() ||
+            mu->get_decree() <= last_committed_decree())
+            continue;
+        handle_prepare_ack(mu, partition_status::PS_SECONDARY, node, mu_resp);
+    }
+
+    dassert_replica(batch->inflight_count > 0, "no batch is in flight to {}", node.to_string());
+    batch->inflight_count--;
+
+    // send the mutations accumulated while the batch is in flight, unless the batch is
+    // dropped due to status change
+    auto it = _primary_states.prepare_batches.find(node);
+    if (partition_status::PS_PRIMARY == status() && it != _primary_states.prepare_batches.end() &&
+        it->second == batch && !batch->pending.empty()) {
+        send_prepare_batch(node, batch);
+    }
+}
+
+void replica::handle_prepare_ack(mutation_ptr mu,
+                                 partition_status::type target_status,
+                                 ::dsn::rpc_address node,
+                                 const prepare_ack &resp)
+{
+    dassert(mu->data.header.ballot == get_ballot(),
+            "%s: invalid mutation ballot, %" PRId64 " VS %" PRId64 "",
+            mu->name(),
+            mu->data.header.ballot,
+            get_ballot());
+
+    partition_status::type st = _primary_states.get_node_status(node);
+
     if (resp.err == ERR_OK) {
         dinfo("%s: mutation %s on_prepare_reply from %s, appro_data_bytes = %d, "
               "target_status = %s, err = %s",
@@ -579,6 +920,7 @@ void replica::on_prepare_reply(std::pair<mutation_ptr, partition_status::type> p
     }
 
     if (resp.err == ERR_OK) {
+        mu->trace("prepare_ack");
         dassert(resp.ballot == get_ballot(),
                 "invalid response ballot, %" PRId64 " VS %" PRId64 "",
                 resp.ballot,
@@ -594,6 +936,8 @@ void replica::on_prepare_reply(std::pair<mutation_ptr, partition_status::type> p
                     "invalid secondary node address, address = %s",
                     node.to_string());
             dassert(mu->left_secondary_ack_count() > 0, "%u", mu->left_secondary_ack_count());
+            // the prepare is sent no earlier than the mutation is initialized
+            _primary_states.update_secondary_ack_time(node, mu->prepare_ts_ms());
             if (0 == mu->decrease_left_secondary_ack_count()) {
                 do_possible_commit_on_primary(mu);
             }
@@ -618,6 +962,9 @@ void replica::on_prepare_reply(std::pair<mutation_ptr, partition_status::type> p
     else {
         // retry for INACTIVE or TRY_AGAIN if there is still time.
         if (resp.err == ERR_INACTIVE_STATE || resp.err == ERR_TRY_AGAIN) {
+            if (resp.err == ERR_TRY_AGAIN && target_status == partition_status::PS_SECONDARY) {
+                _primary_states.write_queue.on_secondary_busy();
+            }
             int prepare_timeout_ms = (target_status == partition_status::PS_SECONDARY
                                           ? _options->prepare_timeout_ms_for_secondaries
                                           : _options->prepare_timeout_ms_for_potential_secondaries);
@@ -700,10 +1047,16 @@ void replica::ack_prepare_message(error_code err, mutation_ptr &mu)
     resp.last_committed_decree_in_prepare_list = last_committed_decree();
 
     const std::vector<dsn::message_ex *> &prepare_requests = mu->prepare_requests();
-    dassert(!prepare_requests.empty(), "mutation = %s", mu->name());
+    const auto &prepare_batches = mu->prepare_batches();
+    dassert(!prepare_requests.empty() || !prepare_batches.empty(), "mutation = %s", mu->name());
     for (auto &request : prepare_requests) {
         reply(request, resp);
     }
+    for (auto &batch : prepare_batches) {
+        if (batch.first->ack(batch.second, err)) {
+            reply_prepare_batch(*batch.first);
+        }
+    }
 
     if (err == ERR_OK) {
         dinfo("%s: mutation %s ack_prepare_message, err = %s", name(), mu->name(), err.to_string());
@@ -712,6 +1065,25 @@ void replica::ack_prepare_message(error_code err, mutation_ptr &mu)
     }
 }
 
+void replica::reply_prepare_batch(const prepare_batch_ack &batch)
+{
+    prepare_ack resp;
+    resp.pid = get_gpid();
+    resp.ballot = get_ballot();
+    batch.get_result(resp.decree, resp.err);
+
+    // for partition_status::PS_POTENTIAL_SECONDARY ONLY
+    resp.last_committed_decree_in_app = _app->last_committed_decree();
+    resp.last_committed_decree_in_prepare_list = last_committed_decree();
+
+    reply(batch.request(), resp);
+
+    dinfo_replica("reply_prepare_batch, count = {}, acked_decree = {}, err = {}",
+                  batch.size(),
+                  resp.decree,
+                  resp.err.to_string());
+}
+
 void replica::cleanup_preparing_mutations(bool wait)
 {
     decree start = last_committed_decree() + 1;
@@ -42,10 +42,13 @@
 
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/dist/replication/replication_app_base.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(group_check_batch_window_ms);
+
 void replica::init_group_check()
 {
     _checker.only_one_thread_access();
@@ -56,12 +59,20 @@ void replica::init_group_check()
         return;
 
     dassert(nullptr == _primary_states.group_check_task, "");
+    // if the group checks are sent in batch, the timers of all the primaries on this node are
+    // aligned to fire at the same time, so that their group checks fall into the same batches
+    uint64_t delay_ms = 0;
+    if (FLAGS_group_check_batch_window_ms > 0) {
+        delay_ms = _options->group_check_interval_ms -
+                   dsn_now_ms() % _options->group_check_interval_ms;
+    }
     _primary_states.group_check_task =
         tasking::enqueue_timer(LPC_GROUP_CHECK,
                                &_tracker,
                                [this] { broadcast_group_check(); },
                                std::chrono::milliseconds(_options->group_check_interval_ms),
-                               get_gpid().thread_hash());
+                               get_gpid().thread_hash(),
+                               std::chrono::milliseconds(delay_ms));
 }
 
 void replica::broadcast_group_check()
@@ -95,6 +106,8 @@ void replica::broadcast_group_check()
         request->node = addr;
         _primary_states.get_replica_config(it->second, request->config);
         request->last_committed_decree = last_committed_decree();
+        _primary_states.last_sent_committed_decree =
+            std::max(_primary_states.last_sent_committed_decree, request->last_committed_decree);
         request->__set_confirmed_decree(_duplication_mgr->min_confirmed_decree());
 
         if (request->config.status == partition_status::PS_POTENTIAL_SECONDARY) {
@@ -109,17 +122,24 @@ void replica::broadcast_group_check()
                addr.to_string(),
                enum_to_string(it->second));
 
-        dsn::task_ptr callback_task =
-            rpc::call(addr,
-                      RPC_GROUP_CHECK,
-                      *request,
-                      &_tracker,
-                      [=](error_code err, group_check_response &&resp) {
-                          auto alloc = std::make_shared<group_check_response>(std::move(resp));
-                          on_group_check_reply(err, request, alloc);
-                      },
-                      std::chrono::milliseconds(0),
-                      get_gpid().thread_hash());
+        uint64_t send_time_ms = dsn_now_ms();
+        auto callback = [=](error_code err, group_check_response &&resp) {
+            auto alloc = std::make_shared<group_check_response>(std::move(resp));
+            on_group_check_reply(err, request, alloc, send_time_ms);
+        };
+        dsn::task_ptr callback_task;
+        if (FLAGS_group_check_batch_window_ms > 0) {
+            callback_task = _stub->send_group_check_in_batch(
+                addr, request, &_tracker, std::move(callback), get_gpid().thread_hash());
+        } else {
+            callback_task = rpc::call(addr,
+                                      RPC_GROUP_CHECK,
+                                      *request,
+                                      &_tracker,
+                                      std::move(callback),
+                                      std::chrono::milliseconds(0),
+                                      get_gpid().thread_hash());
+        }
 
         _primary_states.group_check_pending_replies[addr] = callback_task;
     }
@@ -167,6 +187,7 @@ void replica::on_group_check(const group_check_request &request,
     case partition_status::PS_INACTIVE:
         break;
     case partition_status::PS_SECONDARY:
+        _secondary_states.update_primary_committed_decree(request.last_committed_decree);
         if (request.last_committed_decree > last_committed_decree()) {
             _prepare_list->commit(request.last_committed_decree, COMMIT_TO_DECREE_HARD);
         }
@@ -194,9 +215,30 @@ void replica::on_group_check(const group_check_request &request,
     response.learner_signature = _potential_secondary_states.learning_version;
 }
 
+void replica::on_commit_notify(const group_check_request &request)
+{
+    _checker.only_one_thread_access();
+
+    // the commit point is only trusted from the primary of the current ballot, the other
+    // configuration changes are still left to the group checks
+    if (request.config.ballot != get_ballot() || status() != partition_status::PS_SECONDARY) {
+        dinfo_replica("ignore commit notify, ballot = {}, local ballot = {}, status = {}",
+                      request.config.ballot,
+                      get_ballot(),
+                      enum_to_string(status()));
+        return;
+    }
+
+    _secondary_states.update_primary_committed_decree(request.last_committed_decree);
+    if (request.last_committed_decree > last_committed_decree()) {
+        _prepare_list->commit(request.last_committed_decree, COMMIT_TO_DECREE_HARD);
+    }
+}
+
 void replica::on_group_check_reply(error_code err,
                                    const std::shared_ptr<group_check_request> &req,
-                                   const std::shared_ptr<group_check_response> &resp)
+                                   const std::shared_ptr<group_check_response> &resp,
+                                   uint64_t send_time_ms)
 {
     _checker.only_one_thread_access();
 
@@ -214,6 +256,9 @@ void replica::on_group_check_reply(error_code err,
         handle_remote_failure(req->config.status, req->node, err, "group check");
         _stub->_counter_replicas_recent_group_check_fail_count->increment();
     } else {
+        if (req->config.status == partition_status::PS_SECONDARY) {
+            _primary_states.update_secondary_ack_time(req->node, send_time_ms);
+        }
         if (resp->learner_status_ == learner_status::LearningSucceeded &&
             req->config.status == partition_status::PS_POTENTIAL_SECONDARY) {
             handle_learning_succeeded_on_primary(req->node, resp->learner_signature);
@@ -40,6 +40,7 @@
 #include "duplication/replica_duplicator_manager.h"
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/chrono_literals.h>
+#include <dsn/utility/rand.h>
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
 
@@ -115,9 +116,13 @@ void replica::on_checkpoint_timer()
                                  valid_start_offset,
                                  (int64_t)_options->log_private_reserve_max_size_mb * 1024 * 1024,
                                  (int64_t)_options->log_private_reserve_max_time_seconds);
-                             if (status() == partition_status::PS_PRIMARY)
-                                 _counter_private_log_size->set(_private_log->total_size() /
-                                                                1000000);
+                             if (status() == partition_status::PS_PRIMARY) {
+                                 int64_t size_mb = _private_log->total_size() / 1000000;
+                                 _app_counter_shard.set(APP_COUNTER_PRIVATE_LOG_SIZE_MB, size_mb);
+                                 if (_counter_private_log_size.get() != nullptr) {
+                                     _counter_private_log_size->set(size_mb);
+                                 }
+                             }
                          });
     }
 }
@@ -134,14 +139,29 @@ void replica::init_checkpoint(bool is_emergency)
         return;
     }
 
+    // limit the concurrent checkpoints on each disk, so that the replicas triggered together
+    // don't flush at the same time
+    std::shared_ptr<void> slot = _stub->acquire_checkpoint_slot(_dir);
+    if (slot == nullptr) {
+        ddebug_replica("delay checkpoint as the disk is busy, is_emergency = {}", is_emergency);
+        tasking::enqueue(LPC_PER_REPLICA_CHECKPOINT_TIMER,
+                         &_tracker,
+                         [this, is_emergency] { init_checkpoint(is_emergency); },
+                         get_gpid().thread_hash(),
+                         std::chrono::milliseconds(rand::next_u32(1000, 5000)));
+        return;
+    }
+
     // here we demand that async_checkpoint() is implemented.
     // we delay some time to run background_async_checkpoint() to pass unit test dsn.rep_tests.
     //
     // we may issue a new task to do backgroup_async_checkpoint
     // even if the old one hasn't finished yet
+    //
+    // the slot is returned when the task is done or cancelled
     tasking::enqueue(LPC_CHECKPOINT_REPLICA,
                      &_tracker,
-                     [this, is_emergency] { background_async_checkpoint(is_emergency); },
+                     [this, is_emergency, slot] { background_async_checkpoint(is_emergency); },
                      0,
                      10_ms);
 
@@ -182,8 +202,14 @@ void replica::on_copy_checkpoint(const replica_configuration &request,
         response.base_local_dir = _app->data_dir();
 
         // the state.files is returned whether with full_path or only-filename depends
-        // on the app impl, we'd better handle with it
+        // on the app impl, we'd better handle with it. the files under the data dir are kept
+        // relative to it, so that the ones in the sub dirs of the checkpoint could be copied
+        const std::string prefix = response.base_local_dir + "/";
         for (std::string &file_name : response.state.files) {
+            if (file_name.compare(0, prefix.length(), prefix) == 0) {
+                file_name = file_name.substr(prefix.length());
+                continue;
+            }
             std::size_t last_splitter = file_name.find_last_of("/\\");
             if (last_splitter != std::string::npos)
                 file_name = file_name.substr(last_splitter + 1);
@@ -242,7 +268,8 @@ void replica::on_copy_checkpoint_ack(error_code err,
         [this, resp, ldir](error_code err, size_t sz) {
             this->on_copy_checkpoint_file_completed(err, sz, resp, ldir);
         },
-        get_gpid().thread_hash());
+        get_gpid().thread_hash(),
+        NFS_COPY_PRIORITY_BACKUP);
 }
 
 void replica::on_copy_checkpoint_file_completed(error_code err,
@@ -263,7 +290,7 @@ void replica::on_copy_checkpoint_file_completed(error_code err,
         resp->state.to_decree_included > _app->last_durable_decree()) {
         // we must give the app the full path of the check point
         for (std::string &filename : resp->state.files) {
-            dassert(filename.find_last_of("/\\") == std::string::npos, "invalid file name");
+            dassert(!filename.empty() && filename[0] != '/', "invalid file name");
             filename = utils::filesystem::path_combine(chk_dir, filename);
         }
         _app->apply_checkpoint(replication_app_base::chkpt_apply_mode::copy, resp->state);
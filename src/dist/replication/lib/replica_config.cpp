@@ -980,10 +980,12 @@ bool replica::update_local_configuration(const replica_configuration &config,
     // start pending mutations if necessary
     if (status() == partition_status::PS_PRIMARY) {
         mutation_ptr next = _primary_states.write_queue.check_possible_work(
-            static_cast<int>(_prepare_list->max_decree() - last_committed_decree()));
+            static_cast<int>(_prepare_list->max_decree() - last_committed_decree()),
+            _prepare_list->appro_data_bytes_after(last_committed_decree()));
         if (next) {
             init_prepare(next, false);
         }
+        dispatch_fair_writes();
 
         if (_primary_states.membership.secondaries.size() + 1 <
             _options->mutation_2pc_min_replica_count) {
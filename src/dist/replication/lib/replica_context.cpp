@@ -33,7 +33,10 @@
  *     xxxx-xx-xx, author, fix bug about xxx
  */
 
+#include <algorithm>
+
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/utils.h>
 
 #include "replica_context.h"
@@ -46,12 +49,24 @@
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_bool(cold_backup_incremental);
+DSN_DECLARE_uint32(cold_backup_max_incremental_chain);
+DSN_DECLARE_uint32(cold_backup_small_file_kb);
+
+// the weight of a file in upload_weight(), a small file takes 1/8 of a slot
+static const int32_t UPLOAD_SLOT_WEIGHT = 8;
+
 void primary_context::cleanup(bool clean_pending_mutations)
 {
     do_cleanup_pending_mutations(clean_pending_mutations);
 
+    // clean up the batch window
+    CLEANUP_TASK_ALWAYS(write_batch_task)
+
     // clean up group check
     CLEANUP_TASK_ALWAYS(group_check_task)
+    CLEANUP_TASK_ALWAYS(commit_broadcast_task)
+    last_sent_committed_decree = invalid_decree;
 
     for (auto it = group_check_pending_replies.begin(); it != group_check_pending_replies.end();
          ++it) {
@@ -60,12 +75,17 @@ void primary_context::cleanup(bool clean_pending_mutations)
     }
 
     group_check_pending_replies.clear();
+    secondary_ack_time_ms.clear();
+
+    // the in-flight batches are cancelled along with the preparing mutations
+    prepare_batches.clear();
 
     // clean up reconfiguration
     CLEANUP_TASK_ALWAYS(reconfiguration_task)
 
     // clean up checkpoint
     CLEANUP_TASK_ALWAYS(checkpoint_task)
+    learn_file_md5s.clear();
 
     // clean up register child task
     CLEANUP_TASK_ALWAYS(register_child_task)
@@ -88,6 +108,7 @@ void primary_context::cleanup(bool clean_pending_mutations)
 bool primary_context::is_cleaned()
 {
     return nullptr == group_check_task && nullptr == reconfiguration_task &&
+           nullptr == write_batch_task &&
            nullptr == checkpoint_task && group_check_pending_replies.empty() &&
            nullptr == register_child_task && group_bulk_load_pending_replies.empty();
 }
@@ -96,6 +117,7 @@ void primary_context::do_cleanup_pending_mutations(bool clean_pending_mutations)
 {
     if (clean_pending_mutations) {
         write_queue.clear();
+        fair_queue.clear();
     }
 }
 
@@ -170,6 +192,25 @@ void primary_context::cleanup_bulk_load_states()
     ingestion_is_empty_prepare_sent = false;
 }
 
+void primary_context::update_secondary_ack_time(const rpc_address &node, uint64_t send_time_ms)
+{
+    uint64_t &ack_time_ms = secondary_ack_time_ms[node];
+    ack_time_ms = std::max(ack_time_ms, send_time_ms);
+}
+
+uint64_t primary_context::get_min_secondary_ack_time() const
+{
+    uint64_t min_ack_time_ms = UINT64_MAX;
+    for (const auto &node : membership.secondaries) {
+        auto it = secondary_ack_time_ms.find(node);
+        if (it == secondary_ack_time_ms.end()) {
+            return 0;
+        }
+        min_ack_time_ms = std::min(min_ack_time_ms, it->second);
+    }
+    return min_ack_time_ms;
+}
+
 bool secondary_context::cleanup(bool force)
 {
     CLEANUP_TASK(checkpoint_task, force)
@@ -183,11 +224,21 @@ bool secondary_context::cleanup(bool force)
     CLEANUP_TASK(catchup_with_private_log_task, force)
 
     checkpoint_is_running = false;
+    primary_committed_decree = invalid_decree;
+    primary_committed_decree_update_ms = 0;
     return true;
 }
 
 bool secondary_context::is_cleaned() { return checkpoint_is_running == false; }
 
+void secondary_context::update_primary_committed_decree(decree d)
+{
+    if (d >= primary_committed_decree) {
+        primary_committed_decree = d;
+        primary_committed_decree_update_ms = dsn_now_ms();
+    }
+}
+
 bool potential_secondary_context::cleanup(bool force)
 {
     task_ptr t = nullptr;
@@ -220,12 +271,13 @@ bool potential_secondary_context::cleanup(bool force)
     learning_copy_file_size = 0;
     learning_copy_buffer_size = 0;
     learning_round_is_running = false;
-    if (learn_app_concurrent_count_increased) {
-        --owner_replica->get_replica_stub()->_learn_app_concurrent_count;
-        learn_app_concurrent_count_increased = false;
-    }
+    // also cancels the request queued for the slot of learning app
+    owner_replica->get_replica_stub()->release_learn_slot(owner_replica->get_gpid());
+    learn_app_concurrent_count_increased = false;
     learning_start_prepare_decree = invalid_decree;
     first_learn_start_decree = invalid_decree;
+    local_files.clear();
+    local_files_collected = false;
     learning_status = learner_status::LearningInvalid;
     return true;
 }
@@ -237,6 +289,60 @@ bool potential_secondary_context::is_cleaned()
            nullptr == catchup_with_private_log_task && nullptr == completion_notify_task;
 }
 
+bool incremental_backup_manifest::find_reusable_file(const file_meta &f_meta,
+                                                     int64_t backup_id,
+                                                     /*out*/ incremental_backup_file &file) const
+{
+    auto it = files.find(f_meta.name);
+    if (it == files.end() || it->second.backup_id == backup_id ||
+        it->second.size != f_meta.size || it->second.md5 != f_meta.md5) {
+        return false;
+    }
+    // the file uploaded too many backups ago is not reused, whose backup may be removed by gc
+    if (std::find(backup_ids.begin(), backup_ids.end(), it->second.backup_id) ==
+        backup_ids.end()) {
+        return false;
+    }
+    file = it->second;
+    return true;
+}
+
+incremental_backup_manifest incremental_backup_manifest::next(int64_t backup_id,
+                                                              const std::string &remote_dir,
+                                                              const cold_backup_metadata &metadata,
+                                                              uint32_t max_chain) const
+{
+    incremental_backup_manifest manifest;
+    // the backup may be written again if it is retried
+    for (int64_t id : backup_ids) {
+        if (id < backup_id) {
+            manifest.backup_ids.push_back(id);
+        }
+    }
+    manifest.backup_ids.push_back(backup_id);
+    size_t max_count = std::max(max_chain, 1u);
+    if (manifest.backup_ids.size() > max_count) {
+        manifest.backup_ids.erase(manifest.backup_ids.begin(),
+                                  manifest.backup_ids.end() - max_count);
+    }
+
+    for (const file_meta &f_meta : metadata.files) {
+        incremental_backup_file &file = manifest.files[f_meta.name];
+        file.size = f_meta.size;
+        file.md5 = f_meta.md5;
+        auto reused = metadata.reused_files.find(f_meta.name);
+        auto prev = files.find(f_meta.name);
+        if (reused != metadata.reused_files.end() && prev != files.end()) {
+            file.backup_id = prev->second.backup_id;
+            file.remote_dir = reused->second;
+        } else {
+            file.backup_id = backup_id;
+            file.remote_dir = remote_dir;
+        }
+    }
+    return manifest;
+}
+
 const char *cold_backup_status_to_string(cold_backup_status status)
 {
     switch (status) {
@@ -778,6 +884,11 @@ void cold_backup_context::on_upload_chkpt_dir()
         return;
     }
 
+    if (FLAGS_cold_backup_incremental && !_have_load_incremental_manifest.load()) {
+        load_incremental_manifest();
+        return;
+    }
+
     prepare_upload();
 
     // prepare_upload maybe fail, so here check status
@@ -837,25 +948,42 @@ void cold_backup_context::prepare_upload()
         std::string &file = checkpoint_files[idx];
         file_meta f_meta;
         f_meta.name = file;
-        std::string file_full_path = ::dsn::utils::filesystem::path_combine(checkpoint_dir, file);
         int64_t file_size = checkpoint_file_sizes[idx];
-        std::string file_md5;
-        if (::dsn::utils::filesystem::md5sum(file_full_path, file_md5) != ERR_OK) {
-            derror("%s: get local file size or md5 fail, file = %s", name, file_full_path.c_str());
-            fail_upload("compute local file size or md5 failed");
-            return;
-        }
-        f_meta.md5 = file_md5;
+        // the md5 is computed right before the file is uploaded, see get_or_compute_md5
         f_meta.size = file_size;
         _metadata.files.emplace_back(f_meta);
         _file_status.insert(std::make_pair(file, FileUploadUncomplete));
-        _file_infos.insert(std::make_pair(file, std::make_pair(file_size, file_md5)));
+        _file_infos.insert(std::make_pair(file, std::make_pair(file_size, std::string())));
     }
     _upload_file_size.store(0);
 }
 
 void cold_backup_context::upload_file(const std::string &local_filename)
 {
+    std::string file_md5;
+    if (!get_or_compute_md5(local_filename, file_md5)) {
+        fail_upload("compute local file md5 failed");
+        return;
+    }
+
+    incremental_backup_file reusable;
+    bool reuse = false;
+    if (FLAGS_cold_backup_incremental) {
+        zauto_lock l(_lock);
+        // only try to reuse once, the file is uploaded if it fails
+        if (_reuse_tried_files.insert(local_filename).second) {
+            file_meta f_meta;
+            f_meta.name = local_filename;
+            f_meta.size = _file_infos.at(local_filename).first;
+            f_meta.md5 = file_md5;
+            reuse = _manifest.find_reusable_file(f_meta, request.backup_id, reusable);
+        }
+    }
+    if (reuse) {
+        reuse_file(local_filename, reusable);
+        return;
+    }
+
     std::string remote_chkpt_dir = cold_backup::get_remote_chkpt_dir(
         backup_root, request.policy.policy_name, request.app_name, request.pid, request.backup_id);
     dist::block_service::create_file_request req;
@@ -867,12 +995,16 @@ void cold_backup_context::upload_file(const std::string &local_filename)
     block_service->create_file(
         std::move(req),
         LPC_BACKGROUND_COLD_BACKUP,
-        [this, local_filename](const dist::block_service::create_file_response &resp) {
+        [this, local_filename, file_md5](const dist::block_service::create_file_response &resp) {
             if (resp.err == ERR_OK) {
                 const dist::block_service::block_file_ptr &file_handle = resp.file_handle;
                 dassert(file_handle != nullptr, "");
-                int64_t local_file_size = _file_infos.at(local_filename).first;
-                std::string md5 = _file_infos.at(local_filename).second;
+                int64_t local_file_size = 0;
+                {
+                    zauto_lock l(_lock);
+                    local_file_size = _file_infos.at(local_filename).first;
+                }
+                const std::string &md5 = file_md5;
                 std::string full_path_local_file =
                     ::dsn::utils::filesystem::path_combine(checkpoint_dir, local_filename);
                 if (md5 == file_handle->get_md5sum() &&
@@ -954,9 +1086,12 @@ void cold_backup_context::on_upload(const dist::block_service::block_file_ptr &f
             if (resp.err == ERR_OK) {
                 std::string local_filename =
                     ::dsn::utils::filesystem::get_file_name(full_path_local_file);
-                dassert(_file_infos.at(local_filename).first ==
-                            static_cast<int64_t>(resp.uploaded_size),
-                        "");
+                int64_t local_file_size = 0;
+                {
+                    zauto_lock l(_lock);
+                    local_file_size = _file_infos.at(local_filename).first;
+                }
+                dassert(local_file_size == static_cast<int64_t>(resp.uploaded_size), "");
                 ddebug("%s: upload checkpoint file complete, file = %s",
                        name,
                        full_path_local_file.c_str());
@@ -1009,6 +1144,13 @@ void cold_backup_context::write_backup_metadata()
         ddebug("%s: upload have already done, no need write metadata again", name);
         return;
     }
+    fill_metadata_md5();
+    // the manifest is written before the backup_metadata, so that the manifest is up to date once
+    // the backup is complete
+    if (FLAGS_cold_backup_incremental && !_have_write_incremental_manifest.load()) {
+        write_incremental_manifest();
+        return;
+    }
     std::string metadata = cold_backup::get_remote_chkpt_meta_file(
         backup_root, request.policy.policy_name, request.app_name, request.pid, request.backup_id);
     dist::block_service::create_file_request req;
@@ -1081,9 +1223,13 @@ void cold_backup_context::write_current_chkpt_file(const std::string &value)
     // before we write current checkpoint file, we can release the memory occupied by _metadata,
     // _file_status and _file_infos, because even if write current checkpoint file failed, the
     // backup_metadata is uploading succeed, so we will not re-upload
-    _metadata.files.clear();
-    _file_infos.clear();
-    _file_status.clear();
+    {
+        zauto_lock l(_lock);
+        _metadata.files.clear();
+        _file_infos.clear();
+        _file_status.clear();
+        _upload_order.clear();
+    }
 
     if (!is_ready_for_upload()) {
         ddebug("%s: backup status has changed to %s, stop write current checkpoint file",
@@ -1209,12 +1355,16 @@ void cold_backup_context::on_write(const dist::block_service::block_file_ptr &fi
         });
 }
 
-void cold_backup_context::on_upload_file_complete(const std::string &local_filename)
+void cold_backup_context::on_upload_file_complete(const std::string &local_filename, bool reused)
 {
-    const int64_t &f_size = _file_infos.at(local_filename).first;
+    int64_t f_size = 0;
+    {
+        zauto_lock l(_lock);
+        f_size = _file_infos.at(local_filename).first;
+    }
     _upload_file_size.fetch_add(f_size);
     file_upload_complete(local_filename);
-    if (_owner_replica != nullptr) {
+    if (_owner_replica != nullptr && !reused) {
         _owner_replica->get_replica_stub()
             ->_counter_cold_backup_recent_upload_file_succ_count->increment();
         _owner_replica->get_replica_stub()->_counter_cold_backup_recent_upload_file_size->add(
@@ -1253,24 +1403,233 @@ void cold_backup_context::on_upload_file_complete(const std::string &local_filen
     }
 }
 
+void cold_backup_context::load_incremental_manifest()
+{
+    std::string manifest_file = cold_backup::get_incremental_manifest_file(
+        backup_root, request.policy.policy_name, request.app_name, request.pid);
+    dist::block_service::create_file_request req;
+    req.file_name = manifest_file;
+    req.ignore_metadata = false;
+
+    add_ref();
+
+    block_service->create_file(
+        std::move(req),
+        LPC_BACKGROUND_COLD_BACKUP,
+        [this, manifest_file](const dist::block_service::create_file_response &resp) {
+            if (resp.err == ERR_OK && resp.file_handle->get_md5sum().empty() &&
+                resp.file_handle->get_size() <= 0) {
+                ddebug("%s: incremental manifest isn't exist, upload all the checkpoint files",
+                       name);
+                _have_load_incremental_manifest.store(true);
+                on_upload_chkpt_dir();
+            } else if (resp.err == ERR_OK) {
+                read_incremental_manifest(resp.file_handle);
+            } else {
+                // it's always safe to upload all the files
+                dwarn("%s: block service create file failed, upload all the checkpoint files, "
+                      "file = %s, err = %s",
+                      name,
+                      manifest_file.c_str(),
+                      resp.err.to_string());
+                _have_load_incremental_manifest.store(true);
+                on_upload_chkpt_dir();
+            }
+            release_ref();
+        });
+}
+
+void cold_backup_context::read_incremental_manifest(
+    const dist::block_service::block_file_ptr &file_handle)
+{
+    dist::block_service::read_request req;
+    req.remote_pos = 0;
+    req.remote_length = -1;
+
+    add_ref();
+
+    file_handle->read(
+        std::move(req),
+        LPC_BACKGROUND_COLD_BACKUP,
+        [this, file_handle](const dist::block_service::read_response &resp) {
+            incremental_backup_manifest manifest;
+            if (resp.err != ERR_OK ||
+                !json::json_forwarder<incremental_backup_manifest>::decode(resp.buffer,
+                                                                           manifest)) {
+                dwarn("%s: read incremental manifest failed, upload all the checkpoint files, "
+                      "file = %s, err = %s",
+                      name,
+                      file_handle->file_name().c_str(),
+                      resp.err.to_string());
+            } else {
+                ddebug("%s: read incremental manifest succeed, file count = %d, backup count = %d",
+                       name,
+                       static_cast<int>(manifest.files.size()),
+                       static_cast<int>(manifest.backup_ids.size()));
+                zauto_lock l(_lock);
+                _manifest = std::move(manifest);
+            }
+            _have_load_incremental_manifest.store(true);
+            on_upload_chkpt_dir();
+            release_ref();
+        });
+}
+
+void cold_backup_context::reuse_file(const std::string &local_filename,
+                                     const incremental_backup_file &file)
+{
+    dist::block_service::create_file_request req;
+    req.file_name = ::dsn::utils::filesystem::path_combine(file.remote_dir, local_filename);
+    req.ignore_metadata = false;
+
+    add_ref();
+
+    block_service->create_file(
+        std::move(req),
+        LPC_BACKGROUND_COLD_BACKUP,
+        [this, local_filename, file](const dist::block_service::create_file_response &resp) {
+            if (resp.err == ERR_OK && resp.file_handle->get_md5sum() == file.md5 &&
+                resp.file_handle->get_size() == static_cast<uint64_t>(file.size)) {
+                ddebug("%s: reuse checkpoint file uploaded by backup(%" PRId64
+                       "), file = %s, remote_dir = %s",
+                       name,
+                       file.backup_id,
+                       local_filename.c_str(),
+                       file.remote_dir.c_str());
+                {
+                    zauto_lock l(_lock);
+                    _metadata.reused_files[local_filename] = file.remote_dir;
+                }
+                on_upload_file_complete(local_filename, true);
+            } else {
+                dwarn("%s: checkpoint file uploaded by backup(%" PRId64
+                      ") can't be reused, upload it again, file = %s, err = %s",
+                      name,
+                      file.backup_id,
+                      local_filename.c_str(),
+                      resp.err.to_string());
+                upload_file(local_filename);
+            }
+            release_ref();
+        });
+}
+
+void cold_backup_context::write_incremental_manifest()
+{
+    std::string manifest_file = cold_backup::get_incremental_manifest_file(
+        backup_root, request.policy.policy_name, request.app_name, request.pid);
+    dist::block_service::create_file_request req;
+    req.file_name = manifest_file;
+    req.ignore_metadata = true;
+
+    add_ref();
+
+    block_service->create_file(
+        std::move(req),
+        LPC_BACKGROUND_COLD_BACKUP,
+        [this, manifest_file](const dist::block_service::create_file_response &resp) {
+            if (resp.err == ERR_OK) {
+                dassert(resp.file_handle != nullptr, "");
+                std::string remote_chkpt_dir =
+                    cold_backup::get_remote_chkpt_dir(backup_root,
+                                                      request.policy.policy_name,
+                                                      request.app_name,
+                                                      request.pid,
+                                                      request.backup_id);
+                blob buffer;
+                {
+                    zauto_lock l(_lock);
+                    buffer = json::json_forwarder<incremental_backup_manifest>::encode(
+                        _manifest.next(request.backup_id,
+                                       remote_chkpt_dir,
+                                       _metadata,
+                                       FLAGS_cold_backup_max_incremental_chain));
+                }
+                ddebug("%s: create incremental manifest succeed, start to write file, "
+                       "file = %s, reused file count = %d",
+                       name,
+                       manifest_file.c_str(),
+                       static_cast<int>(_metadata.reused_files.size()));
+                add_ref();
+                this->on_write(resp.file_handle, buffer, [this](bool succeed) {
+                    if (succeed) {
+                        _have_write_incremental_manifest.store(true);
+                        write_backup_metadata();
+                    }
+                    release_ref();
+                });
+            } else if (resp.err == ERR_TIMEOUT) {
+                derror("%s: block service create file timeout, retry after 10s, file = %s",
+                       name,
+                       manifest_file.c_str());
+                add_ref();
+
+                tasking::enqueue(
+                    LPC_BACKGROUND_COLD_BACKUP,
+                    nullptr,
+                    [this]() {
+                        if (!is_ready_for_upload()) {
+                            _have_write_backup_metadata.store(false);
+                            derror("%s: backup status has changed to %s, stop write incremental "
+                                   "manifest",
+                                   name,
+                                   cold_backup_status_to_string(status()));
+                        } else {
+                            write_incremental_manifest();
+                        }
+                        release_ref();
+                    },
+                    0,
+                    std::chrono::seconds(10));
+            } else {
+                derror("%s: block service create file failed, file = %s, err = %s",
+                       name,
+                       manifest_file.c_str(),
+                       resp.err.to_string());
+                _have_write_backup_metadata.store(false);
+                fail_upload("create file failed");
+            }
+            release_ref();
+        });
+}
+
 bool cold_backup_context::upload_complete_or_fetch_uncomplete_files(std::vector<std::string> &files)
 {
     bool upload_complete = false;
 
     zauto_lock l(_lock);
-    if (_file_remain_cnt > 0 && _cur_upload_file_cnt < _max_concurrent_uploading_file_cnt) {
-        for (const auto &_pair : _file_status) {
-            if (_pair.second == file_status::FileUploadUncomplete) {
-                files.emplace_back(_pair.first);
-                _file_remain_cnt -= 1;
-                _file_status[_pair.first] = file_status::FileUploading;
-                _cur_upload_file_cnt += 1;
-            }
-            if (_file_remain_cnt <= 0 ||
-                _cur_upload_file_cnt >= _max_concurrent_uploading_file_cnt) {
-                break;
-            }
+    if (_upload_order.size() != _file_status.size()) {
+        _upload_order.clear();
+        for (const auto &kv : _file_status) {
+            _upload_order.emplace_back(kv.first);
+        }
+        // the larger files take longer, so they start first to shorten the whole upload
+        std::stable_sort(_upload_order.begin(),
+                         _upload_order.end(),
+                         [this](const std::string &a, const std::string &b) {
+                             return _file_infos.at(a).first > _file_infos.at(b).first;
+                         });
+    }
+
+    const int32_t max_weight = _max_concurrent_uploading_file_cnt * UPLOAD_SLOT_WEIGHT;
+    for (const std::string &file : _upload_order) {
+        if (_file_remain_cnt <= 0 || _cur_upload_weight >= max_weight) {
+            break;
+        }
+        auto it = _file_status.find(file);
+        if (it->second != file_status::FileUploadUncomplete) {
+            continue;
+        }
+        // skip the large file which doesn't fit, for the small files which may
+        int32_t weight = upload_weight(file);
+        if (_cur_upload_weight + weight > max_weight) {
+            continue;
         }
+        files.emplace_back(file);
+        _file_remain_cnt -= 1;
+        it->second = file_status::FileUploading;
+        _cur_upload_file_cnt += 1;
+        _cur_upload_weight += weight;
     }
     if (_file_remain_cnt <= 0 && _cur_upload_file_cnt <= 0) {
         upload_complete = true;
@@ -1284,6 +1643,7 @@ void cold_backup_context::file_upload_uncomplete(const std::string &filename)
 
     dassert(_cur_upload_file_cnt >= 1, "cur_upload_file_cnt = %d", _cur_upload_file_cnt);
     _cur_upload_file_cnt -= 1;
+    _cur_upload_weight -= upload_weight(filename);
     _file_remain_cnt += 1;
     _file_status[filename] = file_status::FileUploadUncomplete;
 }
@@ -1294,9 +1654,48 @@ void cold_backup_context::file_upload_complete(const std::string &filename)
 
     dassert(_cur_upload_file_cnt >= 1, "cur_upload_file_cnt = %d", _cur_upload_file_cnt);
     _cur_upload_file_cnt -= 1;
+    _cur_upload_weight -= upload_weight(filename);
     _file_status[filename] = file_status::FileUploadComplete;
 }
 
+int cold_backup_context::upload_weight(const std::string &filename) const
+{
+    int64_t size = _file_infos.at(filename).first;
+    return size < FLAGS_cold_backup_small_file_kb * 1024LL ? 1 : UPLOAD_SLOT_WEIGHT;
+}
+
+bool cold_backup_context::get_or_compute_md5(const std::string &local_filename,
+                                             /*out*/ std::string &md5)
+{
+    {
+        zauto_lock l(_lock);
+        md5 = _file_infos.at(local_filename).second;
+    }
+    if (!md5.empty()) {
+        return true;
+    }
+
+    std::string full_path = ::dsn::utils::filesystem::path_combine(checkpoint_dir, local_filename);
+    if (::dsn::utils::filesystem::md5sum(full_path, md5) != ERR_OK) {
+        derror("%s: compute local file md5 failed, file = %s", name, full_path.c_str());
+        return false;
+    }
+    zauto_lock l(_lock);
+    _file_infos.at(local_filename).second = md5;
+    return true;
+}
+
+void cold_backup_context::fill_metadata_md5()
+{
+    zauto_lock l(_lock);
+    for (file_meta &f_meta : _metadata.files) {
+        auto it = _file_infos.find(f_meta.name);
+        if (it != _file_infos.end() && !it->second.second.empty()) {
+            f_meta.md5 = it->second.second;
+        }
+    }
+}
+
 bool partition_split_context::cleanup(bool force)
 {
     CLEANUP_TASK(async_learn_task, force)
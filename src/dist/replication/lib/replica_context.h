@@ -29,8 +29,10 @@
 #include <dsn/tool-api/zlocks.h>
 #include <dsn/dist/block_service.h>
 #include <dsn/cpp/json_helper.h>
+#include <set>
 
 #include "mutation.h"
+#include "write_fair_queue.h"
 
 class replication_service_test_app;
 
@@ -46,6 +48,18 @@ struct remote_learner_state
     ::dsn::task_ptr timeout_task;
     decree prepare_start_decree;
     std::string last_learn_log_file;
+
+    // the checkpoint of a secondary for the learner to copy instead of the one of primary,
+    // see replica::get_checkpoint_from_secondary()
+    enum class secondary_checkpoint_status
+    {
+        NONE,
+        QUERYING,
+        READY,
+        DONE // used or failed, the later checkpoints are learned from primary
+    };
+    secondary_checkpoint_status secondary_checkpoint_state{secondary_checkpoint_status::NONE};
+    std::shared_ptr<learn_response> secondary_checkpoint;
 };
 
 typedef std::unordered_map<::dsn::rpc_address, remote_learner_state> learner_map;
@@ -74,6 +88,14 @@ typedef std::unordered_map<::dsn::rpc_address, remote_learner_state> learner_map
         }                                                                                          \
     }
 
+// the mutations to be prepared on a secondary in batch, see replica::send_prepare_batch()
+struct prepare_batch
+{
+    std::vector<mutation_ptr> pending;
+    uint32_t inflight_count{0};
+};
+typedef std::shared_ptr<prepare_batch> prepare_batch_ptr;
+
 class primary_context
 {
 public:
@@ -102,6 +124,11 @@ public:
 
     void cleanup_bulk_load_states();
 
+    // `send_time_ms` is when the acked group check or prepare was sent to `node`
+    void update_secondary_ack_time(const rpc_address &node, uint64_t send_time_ms);
+    // the earliest of the last ack times of all the secondaries, UINT64_MAX if no secondary
+    uint64_t get_min_secondary_ack_time() const;
+
 public:
     // membership mgr, including learners
     partition_configuration membership;
@@ -111,6 +138,13 @@ public:
 
     // 2pc batching
     mutation_queue write_queue;
+    // the client writes waiting for write_queue in the fair order of the clients, only used
+    // when the app env "replica.write_fair_queuing" is set
+    write_fair_queue fair_queue;
+    // ends the batch window of the held mutation in write_queue, see `write_batch_window_ms`
+    dsn::task_ptr write_batch_task;
+    // batched prepare for each secondary
+    std::unordered_map<rpc_address, prepare_batch_ptr> prepare_batches;
 
     // group check
     dsn::task_ptr group_check_task; // the repeated group check task of LPC_GROUP_CHECK
@@ -119,6 +153,8 @@ public:
     // cancelled in cleanup() when status changed from PRIMARY to others
     node_tasks group_check_pending_replies; // group check response tasks of RPC_GROUP_CHECK for
                                             // each replica
+    // send time of the latest acked group check or prepare of each secondary, for read lease
+    std::unordered_map<rpc_address, uint64_t> secondary_ack_time_ms;
 
     // reconfiguration task of RPC_CM_UPDATE_PARTITION_CONFIGURATION
     dsn::task_ptr reconfiguration_task;
@@ -130,8 +166,18 @@ public:
     // copy checkpoint from secondaries ptr
     dsn::task_ptr checkpoint_task;
 
+    // md5 of the checkpoint files keyed by the path relative to the data dir, used to find the
+    // files that learners could take from their local ones, see replica::get_reused_learn_files()
+    std::map<std::string, file_meta> learn_file_md5s;
+    bool learn_file_md5_is_computing{false};
+
     uint64_t last_prepare_ts_ms;
 
+    // the highest commit point carried by the prepares or the commit broadcasts sent to the
+    // secondaries, see replica::schedule_commit_broadcast()
+    decree last_sent_committed_decree{invalid_decree};
+    dsn::task_ptr commit_broadcast_task;
+
     // Used for partition split
     // child addresses who has been caught up with its parent
     std::unordered_set<dsn::rpc_address> caught_up_children;
@@ -169,11 +215,18 @@ public:
     bool cleanup(bool force);
     bool is_cleaned();
 
+    void update_primary_committed_decree(decree d);
+
 public:
     bool checkpoint_is_running;
     ::dsn::task_ptr checkpoint_task;
     ::dsn::task_ptr checkpoint_completed_task;
     ::dsn::task_ptr catchup_with_private_log_task;
+
+    // the latest last_committed_decree of the primary piggybacked by prepare or group check,
+    // and when it is received, which bound the staleness of follower reads
+    decree primary_committed_decree{invalid_decree};
+    uint64_t primary_committed_decree_update_ms{0};
 };
 
 class potential_secondary_context
@@ -216,6 +269,11 @@ public:
     // It indicates the minimum decree under `learn/` dir.
     decree first_learn_start_decree{invalid_decree};
 
+    // The files under the local data dir (md5 not set), sent to learnee to find the files
+    // that could be taken locally rather than copied. Collected once per learning.
+    std::vector<file_meta> local_files;
+    bool local_files_collected{false};
+
     ::dsn::task_ptr delay_learning_task;
     ::dsn::task_ptr learning_task;
     ::dsn::task_ptr learn_remote_files_task;
@@ -271,7 +329,50 @@ struct cold_backup_metadata
     int64_t checkpoint_timestamp;
     std::vector<file_meta> files;
     int64_t checkpoint_total_size;
-    DEFINE_JSON_SERIALIZATION(checkpoint_decree, checkpoint_timestamp, files, checkpoint_total_size)
+    // file name -> the remote checkpoint dir which holds the file, for the files reused from the
+    // previous backups by incremental backup, the other files are under the checkpoint dir of
+    // this backup
+    std::map<std::string, std::string> reused_files;
+    DEFINE_JSON_SERIALIZATION(
+        checkpoint_decree, checkpoint_timestamp, files, checkpoint_total_size, reused_files)
+};
+
+struct incremental_backup_file
+{
+    int64_t size;
+    std::string md5;
+    // the backup which has uploaded the file, and the remote checkpoint dir of it
+    int64_t backup_id;
+    std::string remote_dir;
+    DEFINE_JSON_SERIALIZATION(size, md5, backup_id, remote_dir)
+};
+
+//
+// the manifest of the checkpoint files of a replica uploaded by the latest backups of a policy,
+// which is written before the backup_metadata of each backup, and loaded by the next backup to
+// reuse the unchanged files
+//
+struct incremental_backup_manifest
+{
+    // the latest backups of the replica, in ascending order, at most
+    // [replication] cold_backup_max_incremental_chain
+    std::vector<int64_t> backup_ids;
+    // file name -> file
+    std::map<std::string, incremental_backup_file> files;
+    DEFINE_JSON_SERIALIZATION(backup_ids, files)
+
+    // find the file uploaded by one of the backup_ids other than `backup_id`, with the same
+    // size and md5
+    bool find_reusable_file(const file_meta &f_meta,
+                            int64_t backup_id,
+                            /*out*/ incremental_backup_file &file) const;
+
+    // the manifest after the backup `backup_id`, whose files are under `remote_dir` except the
+    // reused ones in `metadata`
+    incremental_backup_manifest next(int64_t backup_id,
+                                     const std::string &remote_dir,
+                                     const cold_backup_metadata &metadata,
+                                     uint32_t max_chain) const;
 };
 
 //
@@ -312,7 +413,10 @@ public:
           _upload_status(UploadInvalid),
           _max_concurrent_uploading_file_cnt(max_upload_file_cnt),
           _cur_upload_file_cnt(0),
+          _cur_upload_weight(0),
           _file_remain_cnt(0),
+          _have_load_incremental_manifest(false),
+          _have_write_incremental_manifest(false),
           _owner_replica(r_),
           _start_time_ms(0)
     {
@@ -494,15 +598,33 @@ private:
     void upload_file(const std::string &local_filename);
     void on_upload(const dist::block_service::block_file_ptr &file_handle,
                    const std::string &full_path_local_file);
-    void on_upload_file_complete(const std::string &local_filename);
+    void on_upload_file_complete(const std::string &local_filename, bool reused = false);
+
+    // incremental backup
+    void load_incremental_manifest();
+    void read_incremental_manifest(const dist::block_service::block_file_ptr &file_handle);
+    // reuse the file uploaded by the previous backup if it still exists on remote, otherwise
+    // upload it
+    void reuse_file(const std::string &local_filename, const incremental_backup_file &file);
+    void write_incremental_manifest();
+
+    // the md5 of the checkpoint file, which is computed right before the file is uploaded, so
+    // that the upload reads it from the page cache rather than the disk again
+    bool get_or_compute_md5(const std::string &local_filename, /*out*/ std::string &md5);
+    // fill in the md5 of the files uploaded to _metadata
+    void fill_metadata_md5();
 
     // functions access the structure protected by _lock
     // return:
     //  -- true, uploading is complete
     //  -- false, uploading is not complete; and put uncomplete file into 'files'
+    // the larger files are fetched first, and the files smaller than
+    // [replication] cold_backup_small_file_kb share the slots of the concurrent uploading files
     bool upload_complete_or_fetch_uncomplete_files(std::vector<std::string> &files);
     void file_upload_uncomplete(const std::string &filename);
     void file_upload_complete(const std::string &filename);
+    // the share of a slot of the concurrent uploading files that the file takes, in 1/8 of a slot
+    int upload_weight(const std::string &filename) const;
 
 public:
     /// the following variables are public, and will only be set once, and will not be changed once
@@ -555,14 +677,27 @@ private:
     std::atomic_int _upload_status;
 
     int32_t _max_concurrent_uploading_file_cnt;
-    // filename -> <filesize, md5>
-    std::map<std::string, std::pair<int64_t, std::string>> _file_infos;
 
     zlock _lock; // lock the structure below
+    // filename -> <filesize, md5>, of which the md5 is empty until the file is to be uploaded
+    std::map<std::string, std::pair<int64_t, std::string>> _file_infos;
     std::map<std::string, file_status> _file_status;
+    // the files in _file_status from the largest to the smallest
+    std::vector<std::string> _upload_order;
     int32_t _cur_upload_file_cnt;
+    // the sum of the upload_weight() of the files uploading
+    int32_t _cur_upload_weight;
     int32_t _file_remain_cnt;
 
+    // the manifest of the previous backups, which is loaded before prepare_upload, and the files
+    // can be reused in it, which are protected by _lock
+    std::atomic_bool _have_load_incremental_manifest;
+    std::atomic_bool _have_write_incremental_manifest;
+    incremental_backup_manifest _manifest;
+    // the files which have been tried to be reused, each file is tried once, and is uploaded if
+    // it can't be reused
+    std::set<std::string> _reuse_tried_files;
+
     replica *_owner_replica;
     uint64_t _start_time_ms;
 };
@@ -0,0 +1,411 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "replica.h"
+#include "replica_stub.h"
+#include "mutation_log.h"
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/io_scheduler.h>
+
+#include <chrono>
+#include <set>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_uint32("replication",
+                  disk_load_update_interval_seconds,
+                  10,
+                  "interval to update the i/o load of the disks, 0 to disable");
+DSN_DEFINE_bool("replication",
+                disk_rebalance_enabled,
+                false,
+                "whether to move the secondary replicas from the disks with heavy write load to "
+                "the light ones of the node, one replica at a time");
+DSN_TAG_VARIABLE(disk_rebalance_enabled, FT_MUTABLE);
+DSN_DEFINE_uint32("replication",
+                  disk_rebalance_close_timeout_seconds,
+                  60,
+                  "the replica to move is given up if it isn't closed within this time");
+DSN_TAG_VARIABLE(disk_rebalance_close_timeout_seconds, FT_MUTABLE);
+
+namespace {
+
+// the resolution of the file modification times may be coarser than the clock
+const int64_t MTIME_SLACK_NS = 1000000000LL;
+
+int64_t wall_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+bool get_file_stat(const std::string &path, /*out*/ int64_t &size, /*out*/ int64_t &mtime_ns)
+{
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    size = st.st_size;
+    mtime_ns = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    return true;
+}
+
+// hard link `src` to `dst` if they are on the same file system, otherwise copy it, limited by
+// the io_scheduler
+bool link_or_copy_file(const std::string &src, const std::string &dst, int64_t size)
+{
+    if (::link(src.c_str(), dst.c_str()) == 0) {
+        return true;
+    }
+    io_scheduler::instance().consume(io_class::COPY, dst, static_cast<uint64_t>(size));
+    return utils::filesystem::copy_file(src, dst);
+}
+
+// copy the directory `src` to `dst` recursively while the replica is still serving. the files
+// changed or removed meanwhile are skipped, and fixed up by sync_dir() after it's closed.
+void precopy_dir(const std::string &src,
+                 const std::string &dst,
+                 const std::string &rel,
+                 /*out*/ std::map<std::string, int64_t> &copied_files)
+{
+    if (!utils::filesystem::create_directory(dst)) {
+        return;
+    }
+    std::vector<std::string> files;
+    if (utils::filesystem::get_subfiles(src, files, false)) {
+        for (const std::string &file : files) {
+            std::string name = utils::filesystem::get_file_name(file);
+            int64_t size = 0;
+            int64_t mtime_ns = 0;
+            int64_t start_ns = wall_now_ns();
+            if (get_file_stat(file, size, mtime_ns) &&
+                link_or_copy_file(file, utils::filesystem::path_combine(dst, name), size)) {
+                copied_files[rel + name] = start_ns;
+            }
+        }
+    }
+    std::vector<std::string> dirs;
+    if (utils::filesystem::get_subdirectories(src, dirs, false)) {
+        for (const std::string &dir : dirs) {
+            std::string name = utils::filesystem::get_file_name(dir);
+            precopy_dir(dir,
+                        utils::filesystem::path_combine(dst, name),
+                        rel + name + "/",
+                        copied_files);
+        }
+    }
+}
+
+// make `dst` the same as `src` after the replica is closed. the files copied online are kept
+// if they are not modified since copied, which are the most of the data, e.g. the sst files
+// of rocksdb and the finished private log files.
+bool sync_dir(const std::string &src,
+              const std::string &dst,
+              const std::string &rel,
+              const std::map<std::string, int64_t> &copied_files,
+              /*out*/ int64_t &copied_bytes)
+{
+    if (!utils::filesystem::directory_exists(dst) && !utils::filesystem::create_directory(dst)) {
+        derror_f("create directory {} failed", dst);
+        return false;
+    }
+
+    std::vector<std::string> files;
+    std::vector<std::string> dirs;
+    if (!utils::filesystem::get_subfiles(src, files, false) ||
+        !utils::filesystem::get_subdirectories(src, dirs, false)) {
+        derror_f("list directory {} failed", src);
+        return false;
+    }
+
+    // the stale ones must be removed, e.g. the private logs gc-ed meanwhile would be replayed
+    std::set<std::string> names;
+    for (const std::string &path : files) {
+        names.insert(utils::filesystem::get_file_name(path));
+    }
+    for (const std::string &path : dirs) {
+        names.insert(utils::filesystem::get_file_name(path));
+    }
+    std::vector<std::string> dst_entries;
+    utils::filesystem::get_subpaths(dst, dst_entries, false);
+    for (const std::string &path : dst_entries) {
+        if (names.find(utils::filesystem::get_file_name(path)) == names.end()) {
+            utils::filesystem::remove_path(path);
+        }
+    }
+
+    for (const std::string &file : files) {
+        std::string name = utils::filesystem::get_file_name(file);
+        std::string target = utils::filesystem::path_combine(dst, name);
+        int64_t size = 0;
+        int64_t mtime_ns = 0;
+        if (!get_file_stat(file, size, mtime_ns)) {
+            derror_f("stat file {} failed", file);
+            return false;
+        }
+        auto it = copied_files.find(rel + name);
+        int64_t copied_size = 0;
+        int64_t copied_mtime_ns = 0;
+        if (it != copied_files.end() && mtime_ns + MTIME_SLACK_NS < it->second &&
+            get_file_stat(target, copied_size, copied_mtime_ns) && copied_size == size) {
+            continue;
+        }
+        if (utils::filesystem::file_exists(target) && !utils::filesystem::remove_path(target)) {
+            derror_f("remove file {} failed", target);
+            return false;
+        }
+        if (!link_or_copy_file(file, target, size)) {
+            derror_f("copy file {} to {} failed", file, target);
+            return false;
+        }
+        copied_bytes += size;
+    }
+
+    for (const std::string &dir : dirs) {
+        std::string name = utils::filesystem::get_file_name(dir);
+        if (!sync_dir(dir,
+                      utils::filesystem::path_combine(dst, name),
+                      rel + name + "/",
+                      copied_files,
+                      copied_bytes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+void replica_stub::start_disk_balance()
+{
+    if (FLAGS_disk_load_update_interval_seconds == 0) {
+        return;
+    }
+    _disk_load_timer_task =
+        tasking::enqueue_timer(LPC_DISK_STAT,
+                               &_tracker,
+                               [this]() { on_disk_load(); },
+                               std::chrono::seconds(FLAGS_disk_load_update_interval_seconds),
+                               0,
+                               std::chrono::seconds(FLAGS_disk_load_update_interval_seconds));
+}
+
+void replica_stub::on_disk_load()
+{
+    // the bytes written into the private logs reflect the write load of the replicas
+    std::map<gpid, int64_t> written_bytes;
+    {
+        zauto_read_lock l(_replicas_lock);
+        for (const auto &kv : _replicas) {
+            mutation_log_ptr plog = kv.second->private_log();
+            if (plog != nullptr) {
+                written_bytes.emplace(kv.first, plog->end_offset());
+            }
+        }
+    }
+    _fs_manager.update_disk_load(written_bytes);
+    update_disk_holding_replicas();
+
+    if (!FLAGS_disk_rebalance_enabled) {
+        return;
+    }
+    {
+        zauto_read_lock l(_replicas_lock);
+        if (_disk_migration != nullptr) {
+            return;
+        }
+    }
+    gpid pid;
+    std::string from_tag;
+    std::string to_tag;
+    if (_fs_manager.plan_disk_migration(pid, from_tag, to_tag)) {
+        begin_disk_migration(pid, to_tag);
+    }
+}
+
+// a replica is moved to another disk of the node as following, which copies the files locally
+// rather than learning them from the primary over the network:
+//   1. the files of the replica are copied to the target disk after an emergency checkpoint,
+//      while it's still serving;
+//   2. the secondary replica is turned into PS_ERROR, so it's closed and removed from the
+//      partition, which is still served by the others;
+//   3. the files changed since copied are copied again, then the copy is switched with the
+//      original directory, which is left as garbage;
+//   4. the meta server adds the replica back as a learner to the node as usual, which is opened
+//      from the new directory and replays the tail of its private log, so it only learns the
+//      mutations since it's closed from the primary.
+// the replica isn't opened until it's moved, and only one replica is moved at a time.
+error_code replica_stub::begin_disk_migration(gpid pid, const std::string &to_tag)
+{
+    replica_ptr r = get_replica(pid);
+    if (r == nullptr) {
+        return ERR_OBJECT_NOT_FOUND;
+    }
+    if (r->status() != partition_status::PS_SECONDARY) {
+        return ERR_INVALID_STATE;
+    }
+    std::string to_root = _fs_manager.get_dir_by_tag(to_tag);
+    if (to_root.empty()) {
+        return ERR_OBJECT_NOT_FOUND;
+    }
+    std::string from_dir = r->dir();
+    if (utils::filesystem::path_combine(to_root, utils::filesystem::get_file_name(from_dir)) ==
+        from_dir) {
+        return ERR_INVALID_PARAMETERS;
+    }
+
+    auto m = std::make_shared<disk_migration>();
+    m->pid = pid;
+    m->app_type = r->get_app_info()->app_type;
+    m->from_dir = from_dir;
+    m->to_dir = utils::filesystem::path_combine(to_root, fmt::format("{}.{}", pid, m->app_type));
+    // named as garbage while copying, so it's removed by the disk gc if the copy is interrupted
+    m->tmp_dir = fmt::format("{}.{}.gar", m->to_dir, dsn_now_us());
+    {
+        zauto_write_lock l(_replicas_lock);
+        if (_disk_migration != nullptr) {
+            return ERR_BUSY;
+        }
+        _disk_migration = m;
+    }
+
+    ddebug_f("{}: start to move replica from {} to {}", r->name(), m->from_dir, m->to_dir);
+    tasking::enqueue(LPC_REPLICATION_COMMON,
+                     r->tracker(),
+                     [this, r, m]() {
+                         // flush the memtable, so more data is copied online
+                         trigger_checkpoint(r, true);
+                         tasking::enqueue(LPC_REPLICATION_LONG_COMMON,
+                                          &_tracker,
+                                          [this, m]() { copy_migrating_replica(m); });
+                     },
+                     pid.thread_hash());
+    return ERR_OK;
+}
+
+void replica_stub::copy_migrating_replica(std::shared_ptr<disk_migration> m)
+{
+    uint64_t start_ms = dsn_now_ms();
+    precopy_dir(m->from_dir, m->tmp_dir, "", m->copied_files);
+    ddebug_f("{}: copy {} files of replica online, time_used_ms = {}",
+             m->pid,
+             m->copied_files.size(),
+             dsn_now_ms() - start_ms);
+
+    replica_ptr r = get_replica(m->pid);
+    if (r == nullptr) {
+        utils::filesystem::remove_path(m->tmp_dir);
+        end_disk_migration(false);
+        return;
+    }
+    tasking::enqueue(LPC_REPLICATION_COMMON,
+                     r->tracker(),
+                     [this, m]() { close_migrating_replica(m); },
+                     m->pid.thread_hash());
+}
+
+void replica_stub::close_migrating_replica(std::shared_ptr<disk_migration> m)
+{
+    replica_ptr r = get_replica(m->pid);
+    if (r == nullptr || r->status() != partition_status::PS_SECONDARY) {
+        dwarn_f("{}: give up moving replica as it's not a secondary any more", m->pid);
+        utils::filesystem::remove_path(m->tmp_dir);
+        end_disk_migration(false);
+        return;
+    }
+    r->update_local_configuration_with_no_ballot_change(partition_status::PS_ERROR);
+    wait_disk_migration_closed(m, dsn_now_ms());
+}
+
+void replica_stub::wait_disk_migration_closed(std::shared_ptr<disk_migration> m,
+                                              uint64_t start_ms)
+{
+    bool closed = false;
+    {
+        zauto_read_lock l(_replicas_lock);
+        closed = _closed_replicas.find(m->pid) != _closed_replicas.end();
+    }
+    if (closed) {
+        tasking::enqueue(LPC_REPLICATION_LONG_COMMON, &_tracker, [this, m]() {
+            bool succeed = switch_migrating_replica(*m);
+            if (!succeed) {
+                utils::filesystem::remove_path(m->tmp_dir);
+            }
+            end_disk_migration(succeed);
+        });
+        return;
+    }
+
+    if (dsn_now_ms() - start_ms > FLAGS_disk_rebalance_close_timeout_seconds * 1000ULL) {
+        derror_f("{}: give up moving replica as it isn't closed in time", m->pid);
+        utils::filesystem::remove_path(m->tmp_dir);
+        end_disk_migration(false);
+        return;
+    }
+    tasking::enqueue(LPC_REPLICATION_LONG_COMMON,
+                     &_tracker,
+                     [this, m, start_ms]() { wait_disk_migration_closed(m, start_ms); },
+                     0,
+                     std::chrono::seconds(1));
+}
+
+bool replica_stub::switch_migrating_replica(const disk_migration &m)
+{
+    uint64_t start_ms = dsn_now_ms();
+    int64_t copied_bytes = 0;
+    if (!sync_dir(m.from_dir, m.tmp_dir, "", m.copied_files, copied_bytes)) {
+        return false;
+    }
+
+    std::string garbage_dir = fmt::format("{}.{}.gar", m.from_dir, dsn_now_us());
+    if (!utils::filesystem::rename_path(m.from_dir, garbage_dir)) {
+        derror_f("{}: rename {} to {} failed", m.pid, m.from_dir, garbage_dir);
+        return false;
+    }
+    if (!utils::filesystem::rename_path(m.tmp_dir, m.to_dir)) {
+        derror_f("{}: rename {} to {} failed", m.pid, m.tmp_dir, m.to_dir);
+        utils::filesystem::rename_path(garbage_dir, m.from_dir);
+        return false;
+    }
+
+    {
+        zauto_write_lock l(_replicas_lock);
+        _fs_manager.remove_replica(m.pid);
+        _fs_manager.add_replica(m.pid, m.to_dir);
+    }
+
+    // the app info in the manifest goes with the replica dir
+    app_info info;
+    replica_manifest *manifest = get_replica_manifest(m.from_dir);
+    if (manifest != nullptr && manifest->get(utils::filesystem::get_file_name(m.from_dir), info)) {
+        on_replica_dir_created(m.to_dir, info);
+    }
+    on_replica_dir_removed(m.from_dir);
+
+    ddebug_f("{}: move replica from {} to {} succeed, {} bytes copied after closed, "
+             "time_used_ms = {}",
+             m.pid,
+             m.from_dir,
+             m.to_dir,
+             copied_bytes,
+             dsn_now_ms() - start_ms);
+    return true;
+}
+
+void replica_stub::end_disk_migration(bool succeed)
+{
+    zauto_write_lock l(_replicas_lock);
+    ddebug_f("{}: finish to move replica, succeed = {}", _disk_migration->pid, succeed);
+    _disk_migration = nullptr;
+}
+
+} // namespace replication
+} // namespace dsn
@@ -4,12 +4,21 @@
 
 #include <nlohmann/json.hpp>
 #include <fmt/format.h>
+#include <dsn/utility/flags.h>
 #include "replica_http_service.h"
 #include "duplication/duplication_sync_timer.h"
+#include "log_write_tracer.h"
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  http_duplication_cache_window_ms,
+                  1000,
+                  "the window in which the responses of /replica/duplication are reused, as the "
+                  "monitoring systems poll it, 0 means disabled");
+DSN_TAG_VARIABLE(http_duplication_cache_window_ms, FT_MUTABLE);
+
 void replica_http_service::query_duplication_handler(const http_request &req, http_response &resp)
 {
     if (!_stub->_duplication_sync_timer) {
@@ -55,5 +64,40 @@ void replica_http_service::query_duplication_handler(const http_request &req, ht
     resp.body = json.dump();
 }
 
+int64_t replica_http_service::duplication_version() const
+{
+    uint32_t window_ms = FLAGS_http_duplication_cache_window_ms;
+    if (window_ms == 0) {
+        return -1;
+    }
+    return static_cast<int64_t>(dsn_now_ms() / window_ms);
+}
+
+void replica_http_service::query_log_writes_handler(const http_request &req, http_response &resp)
+{
+    resp.status_code = http_status_code::ok;
+    resp.body = log_write_tracer::instance().to_json();
+}
+
+void replica_http_service::query_memory_handler(const http_request &req, http_response &resp)
+{
+    resp.status_code = http_status_code::ok;
+    resp.body = _stub->get_memory_usage_json();
+}
+
+void replica_http_service::query_app_counters_handler(const http_request &req,
+                                                      http_response &resp)
+{
+    int32_t appid = -1;
+    auto it = req.query_args.find("appid");
+    if (it != req.query_args.end() && (!buf2int32(it->second, appid) || appid < 0)) {
+        resp.status_code = http_status_code::bad_request;
+        resp.body = fmt::format("invalid appid={}", it->second);
+        return;
+    }
+    resp.status_code = http_status_code::ok;
+    resp.body = _stub->get_app_counters().to_json(appid);
+}
+
 } // namespace replication
 } // namespace dsn
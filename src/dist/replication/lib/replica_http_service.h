@@ -14,19 +14,51 @@ class replica_http_service : public http_service
 public:
     explicit replica_http_service(replica_stub *stub) : _stub(stub)
     {
-        register_handler("duplication",
-                         std::bind(&replica_http_service::query_duplication_handler,
+        register_cached_handler("duplication",
+                                std::bind(&replica_http_service::duplication_version, this),
+                                std::bind(&replica_http_service::query_duplication_handler,
+                                          this,
+                                          std::placeholders::_1,
+                                          std::placeholders::_2),
+                                "ip:port/replica/duplication?appid=<appid>");
+        register_handler("log_writes",
+                         std::bind(&replica_http_service::query_log_writes_handler,
                                    this,
                                    std::placeholders::_1,
                                    std::placeholders::_2),
-                         "ip:port/replica/duplication?appid=<appid>");
+                         "ip:port/replica/log_writes");
+        register_handler("memory",
+                         std::bind(&replica_http_service::query_memory_handler,
+                                   this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2),
+                         "ip:port/replica/memory");
+        register_handler("app_counters",
+                         std::bind(&replica_http_service::query_app_counters_handler,
+                                   this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2),
+                         "ip:port/replica/app_counters[?appid=<appid>]");
     }
 
     std::string path() const override { return "replica"; }
 
     void query_duplication_handler(const http_request &req, http_response &resp);
 
+    // the stage latencies of the shared and private log writes, and the recent slow writes
+    void query_log_writes_handler(const http_request &req, http_response &resp);
+
+    // the memory pinned by the mutations, messages and log buffers, and the prepare lists
+    void query_memory_handler(const http_request &req, http_response &resp);
+
+    // the counters aggregated by app, and their values of each replica
+    void query_app_counters_handler(const http_request &req, http_response &resp);
+
 private:
+    // the progress of the duplications has no version, so the responses are cached within a
+    // window of [replication] http_duplication_cache_window_ms, which is the version
+    int64_t duplication_version() const;
+
     replica_stub *_stub;
 };
 
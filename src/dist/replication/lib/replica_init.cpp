@@ -31,8 +31,11 @@
 #include "backup/replica_backup_manager.h"
 #include <dsn/utility/factory_store.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/rand.h>
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
+#include <fstream>
 
 namespace dsn {
 namespace replication {
@@ -63,6 +66,7 @@ error_code replica::initialize_on_new()
         dsn::utils::filesystem::remove_path(_dir);
         return err;
     }
+    _stub->on_replica_dir_created(_dir, _app_info);
 
     return init_app_and_prepare_list(true);
 }
@@ -122,7 +126,7 @@ error_code replica::initialize_on_load()
     return init_app_and_prepare_list(false);
 }
 
-/*static*/ replica *replica::load(replica_stub *stub, const char *dir)
+/*static*/ replica *replica::load(replica_stub *stub, const char *dir, const app_info *cached_info)
 {
     char splitters[] = {'\\', '/', 0};
     std::string name = utils::get_last_component(std::string(dir), splitters);
@@ -145,12 +149,16 @@ error_code replica::initialize_on_load()
     }
 
     dsn::app_info info;
-    replica_app_info info2(&info);
     std::string path = utils::filesystem::path_combine(dir, ".app-info");
-    auto err = info2.load(path.c_str());
-    if (ERR_OK != err) {
-        derror("load app-info from %s failed, err = %s", path.c_str(), err.to_string());
-        return nullptr;
+    if (cached_info != nullptr) {
+        info = *cached_info;
+    } else {
+        replica_app_info info2(&info);
+        auto err = info2.load(path.c_str());
+        if (ERR_OK != err) {
+            derror("load app-info from %s failed, err = %s", path.c_str(), err.to_string());
+            return nullptr;
+        }
     }
 
     if (info.app_type != app_type) {
@@ -160,7 +168,7 @@ error_code replica::initialize_on_load()
 
     replica *rep = new replica(stub, pid, info, dir, false);
 
-    err = rep->initialize_on_load();
+    error_code err = rep->initialize_on_load();
     if (err == ERR_OK) {
         ddebug("%s: load replica succeed", rep->name());
         return rep;
@@ -187,6 +195,61 @@ error_code replica::initialize_on_load()
     }
 }
 
+DSN_DEFINE_bool("replication",
+                skip_replay_on_clean_shutdown,
+                true,
+                "whether to record the tail of the private log when a replica is closed cleanly, "
+                "so that the log isn't replayed on the next open if all of it is durable");
+
+static const char *kCleanShutdownInfoFile = ".clean-shutdown";
+
+bool replica::load_clean_shutdown_info(/*out*/ replica_clean_shutdown_info &info)
+{
+    std::string path = utils::filesystem::path_combine(_dir, kCleanShutdownInfoFile);
+    if (!utils::filesystem::file_exists(path)) {
+        return false;
+    }
+
+    std::string data;
+    bool loaded = utils::filesystem::read_file(path, data) == ERR_OK &&
+                  json::json_forwarder<replica_clean_shutdown_info>::decode(
+                      blob::create_from_bytes(std::move(data)), info);
+    // the log is to be appended, after which the info is stale
+    if (!utils::filesystem::remove_path(path)) {
+        derror_replica("remove clean shutdown info {} failed", path);
+        return false;
+    }
+    if (!loaded) {
+        dwarn_replica("load clean shutdown info {} failed", path);
+        return false;
+    }
+    return FLAGS_skip_replay_on_clean_shutdown;
+}
+
+void replica::store_clean_shutdown_info(const replica_clean_shutdown_info &info)
+{
+    if (!FLAGS_skip_replay_on_clean_shutdown) {
+        return;
+    }
+
+    std::string path = utils::filesystem::path_combine(_dir, kCleanShutdownInfoFile);
+    std::string tmp_path = path + ".tmp";
+    blob data = json::json_forwarder<replica_clean_shutdown_info>::encode(info);
+    std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+    os.write(data.data(), data.length());
+    os.close();
+    if (os.bad() || !utils::filesystem::rename_path(tmp_path, path)) {
+        derror_replica("store clean shutdown info {} failed", path);
+        utils::filesystem::remove_path(tmp_path);
+        return;
+    }
+    ddebug_replica("store clean shutdown info succeed, last_durable_decree = {}, "
+                   "max_decree_in_plog = {}, end_offset_in_plog = {}",
+                   info.last_durable_decree,
+                   info.log_tail.max_decree,
+                   info.log_tail.end_offset);
+}
+
 decree replica::get_replay_start_decree()
 {
     decree replay_start_decree = _app->last_committed_decree();
@@ -202,6 +265,10 @@ error_code replica::init_app_and_prepare_list(bool create_new)
 
     _app.reset(replication_app_base::new_storage_instance(_app_info.app_type, this));
     dassert(nullptr == _private_log, "private log must not be initialized yet");
+    if (_app->support_batched_mutations()) {
+        _prepare_list->set_batch_committer(
+            std::bind(&replica::execute_mutations, this, std::placeholders::_1));
+    }
 
     if (create_new) {
         err = _app->open_new_internal(this, _stub->_log->on_partition_reset(get_gpid(), 0), 0);
@@ -225,7 +292,7 @@ error_code replica::init_app_and_prepare_list(bool create_new)
             _config.ballot = _app->init_info().init_ballot;
             _prepare_list->reset(_app->last_committed_decree());
 
-            _private_log =
+            auto plog =
                 new mutation_log_private(log_dir,
                                          _options->log_private_file_size_mb,
                                          get_gpid(),
@@ -233,6 +300,10 @@ error_code replica::init_app_and_prepare_list(bool create_new)
                                          _options->log_private_batch_buffer_kb * 1024,
                                          _options->log_private_batch_buffer_count,
                                          _options->log_private_batch_buffer_flush_interval_ms);
+            if (_stub->_log_shared_disabled) {
+                plog->set_sync_coordinator(_stub->get_log_sync_coordinator(dir()));
+            }
+            _private_log = plog;
             ddebug("%s: plog_dir = %s", name(), log_dir.c_str());
 
             // sync valid_start_offset between app and logs
@@ -247,15 +318,35 @@ error_code replica::init_app_and_prepare_list(bool create_new)
                 replay_condition[_config.pid] = get_replay_start_decree();
 
                 uint64_t start_time = dsn_now_ms();
-                err = _private_log->open(
-                    [this](int log_length, mutation_ptr &mu) { return replay_mutation(mu, true); },
-                    [this](error_code err) {
-                        tasking::enqueue(LPC_REPLICATION_ERROR,
-                                         &_tracker,
-                                         [this, err]() { handle_local_failure(err); },
-                                         get_gpid().thread_hash());
-                    },
-                    replay_condition);
+                mutation_log::io_failure_callback on_io_failure = [this](error_code err) {
+                    tasking::enqueue(LPC_REPLICATION_ERROR,
+                                     &_tracker,
+                                     [this, err]() { handle_local_failure(err); },
+                                     get_gpid().thread_hash());
+                };
+
+                // the replay is skipped if all the mutations in the log are durable on a
+                // clean shutdown, as none of them would be replayed
+                replica_clean_shutdown_info clean_info;
+                err = ERR_INCOMPLETE_DATA;
+                if (load_clean_shutdown_info(clean_info) &&
+                    clean_info.last_durable_decree == _app->last_durable_decree() &&
+                    clean_info.log_tail.max_decree <= _app->last_durable_decree()) {
+                    err = _private_log->open_without_replay(clean_info.log_tail, on_io_failure);
+                    if (err == ERR_OK) {
+                        ddebug_replica("skip replaying private log on clean shutdown, "
+                                       "end_offset = {}",
+                                       clean_info.log_tail.end_offset);
+                    }
+                }
+                if (err != ERR_OK) {
+                    err = _private_log->open(
+                        [this](int log_length, mutation_ptr &mu) {
+                            return replay_mutation(mu, true);
+                        },
+                        on_io_failure,
+                        replay_condition);
+                }
 
                 uint64_t finish_time = dsn_now_ms();
 
@@ -324,7 +415,7 @@ error_code replica::init_app_and_prepare_list(bool create_new)
                 dassert(false, "Fail to create directory %s.", log_dir.c_str());
             }
 
-            _private_log =
+            auto plog =
                 new mutation_log_private(log_dir,
                                          _options->log_private_file_size_mb,
                                          get_gpid(),
@@ -332,6 +423,10 @@ error_code replica::init_app_and_prepare_list(bool create_new)
                                          _options->log_private_batch_buffer_kb * 1024,
                                          _options->log_private_batch_buffer_count,
                                          _options->log_private_batch_buffer_flush_interval_ms);
+            if (_stub->_log_shared_disabled) {
+                plog->set_sync_coordinator(_stub->get_log_sync_coordinator(dir()));
+            }
+            _private_log = plog;
             ddebug("%s: plog_dir = %s", name(), log_dir.c_str());
 
             err = _private_log->open(nullptr, [this](error_code err) {
@@ -344,12 +439,16 @@ error_code replica::init_app_and_prepare_list(bool create_new)
 
         if (err == ERR_OK) {
             if (_checkpoint_timer == nullptr && !_options->checkpoint_disabled) {
+                // the first checkpoint is delayed randomly within an interval, so that the
+                // replicas opened together don't checkpoint together
                 _checkpoint_timer = tasking::enqueue_timer(
                     LPC_PER_REPLICA_CHECKPOINT_TIMER,
                     &_tracker,
                     [this] { on_checkpoint_timer(); },
                     std::chrono::seconds(_options->checkpoint_interval_seconds),
-                    get_gpid().thread_hash());
+                    get_gpid().thread_hash(),
+                    std::chrono::milliseconds(
+                        rand::next_u32(0, _options->checkpoint_interval_seconds * 1000)));
             }
 
             _backup_mgr->start_collect_backup_info();
@@ -40,12 +40,49 @@
 #include "duplication/replica_duplicator_manager.h"
 
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                learn_app_reuse_local_files,
+                true,
+                "send the local files to learnee when learning, so that the checkpoint files "
+                "identical to the local ones are copied locally rather than from learnee");
+DSN_DEFINE_uint32("replication",
+                  learn_apply_batch_size,
+                  64,
+                  "the max count of the learned mutations applied to the app in one batch");
+DSN_DEFINE_uint32("replication",
+                  learn_verify_threads,
+                  4,
+                  "the max count of the threads to verify the local files reused by learning");
+DSN_DEFINE_bool("replication",
+                learn_app_from_secondary,
+                false,
+                "let the learner copy the checkpoint of a secondary rather than the one of "
+                "primary, so that primary only serves the logs after the checkpoint");
+
+// the count of the primary and secondaries of the partition, which the old primaries don't
+// tell, whose learners are taken as the ones for the load balance
+static int learn_replica_count(const learn_response &resp, int max_replica_count)
+{
+    return resp.__isset.replica_count ? resp.replica_count : max_replica_count;
+}
+
+// learning to restore a lost replica is served by the nfs server before the learning for the
+// load balance, which adds an extra replica to a healthy partition
+static nfs_copy_priority learn_copy_priority(const learn_response &resp, int max_replica_count)
+{
+    if (learn_replica_count(resp, max_replica_count) < max_replica_count) {
+        return NFS_COPY_PRIORITY_RECOVERY;
+    }
+    return NFS_COPY_PRIORITY_BALANCE;
+}
+
 void replica::init_learn(uint64_t signature)
 {
     _checker.only_one_thread_access();
@@ -177,17 +214,15 @@ void replica::init_learn(uint64_t signature)
         }
     }
 
-    if (_app->last_committed_decree() == 0 &&
-        _stub->_learn_app_concurrent_count.load() >= _options->learn_app_max_concurrent_count) {
+    // the learner is queued as it needs to learn app, which is started once the slot is taken
+    if (!_potential_secondary_states.learn_app_concurrent_count_increased &&
+        _stub->_learn_scheduler->is_queued(get_gpid())) {
         dwarn("%s: init_learn[%016" PRIx64 "]: learnee = %s, learn_duration = %" PRIu64
-              "ms, need to learn app because app_committed_decree = 0, but "
-              "learn_app_concurrent_count(%d) >= learn_app_max_concurrent_count(%d), skip",
+              "ms, still queued for the slot of learning app, skip",
               name(),
               _potential_secondary_states.learning_version,
               _config.primary.to_string(),
-              _potential_secondary_states.duration_ms(),
-              _stub->_learn_app_concurrent_count.load(),
-              _options->learn_app_max_concurrent_count);
+              _potential_secondary_states.duration_ms());
         return;
     }
 
@@ -202,6 +237,13 @@ void replica::init_learn(uint64_t signature)
     request.learner = _stub->_primary_address;
     request.signature = _potential_secondary_states.learning_version;
     _app->prepare_get_checkpoint(request.app_specific_learn_request);
+    if (FLAGS_learn_app_reuse_local_files && _app->last_committed_decree() > 0) {
+        if (!_potential_secondary_states.local_files_collected) {
+            _potential_secondary_states.local_files = collect_local_learn_files();
+            _potential_secondary_states.local_files_collected = true;
+        }
+        request.__set_local_files(_potential_secondary_states.local_files);
+    }
 
     ddebug("%s: init_learn[%016" PRIx64 "]: learnee = %s, learn_duration = %" PRIu64
            " ms, max_gced_decree = %" PRId64 ", local_committed_decree = %" PRId64 ", "
@@ -257,6 +299,28 @@ decree replica::get_max_gced_decree_for_learn() const // on learner
     return max_gced_decree_for_learn;
 }
 
+// ThreadPool: THREAD_POOL_REPLICATION
+std::vector<file_meta> replica::collect_local_learn_files() const // on learner
+{
+    std::vector<file_meta> local_files;
+    const std::string &data_dir = _app->data_dir();
+    std::vector<std::string> sub_files;
+    if (!utils::filesystem::get_subfiles(data_dir, sub_files, true)) {
+        dwarn_replica("get sub files of {} failed, learn without local files", data_dir);
+        return local_files;
+    }
+
+    for (const std::string &path : sub_files) {
+        file_meta meta;
+        if (!utils::filesystem::file_size(path, meta.size) || meta.size == 0) {
+            continue;
+        }
+        meta.name = path.substr(data_dir.length() + 1);
+        local_files.emplace_back(std::move(meta));
+    }
+    return local_files;
+}
+
 /*virtual*/ decree replica::max_gced_decree_no_lock() const
 {
     return _private_log->max_gced_decree_no_lock(get_gpid());
@@ -414,6 +478,7 @@ void replica::on_learn(dsn::message_ex *msg, const learn_request &request)
     const decree learn_start_decree = get_learn_start_decree(request);
     response.state.__set_learn_start_decree(learn_start_decree);
     bool delayed_replay_prepare_list = false;
+    bool checkpoint_from_secondary = false;
 
     ddebug("%s: on_learn[%016" PRIx64 "]: learner = %s, remote_committed_decree = %" PRId64 ", "
            "remote_app_committed_decree = %" PRId64 ", local_committed_decree = %" PRId64 ", "
@@ -433,6 +498,8 @@ void replica::on_learn(dsn::message_ex *msg, const learn_request &request)
            learn_start_decree);
 
     response.address = _stub->_primary_address;
+    response.__set_replica_count(
+        1 + static_cast<int>(_primary_states.membership.secondaries.size()));
     response.prepare_start_decree = invalid_decree;
     response.last_committed_decree = local_committed_decree;
     response.err = ERR_OK;
@@ -560,6 +627,8 @@ void replica::on_learn(dsn::message_ex *msg, const learn_request &request)
                    response.state.meta.length(),
                    static_cast<uint32_t>(response.state.files.size()),
                    response.state.to_decree_included);
+        } else if (get_checkpoint_from_secondary(request, learner_state, response)) {
+            checkpoint_from_secondary = true;
         } else {
             ::dsn::error_code err = _app->get_checkpoint(
                 learn_start_decree, request.app_specific_learn_request, response.state);
@@ -587,8 +656,16 @@ void replica::on_learn(dsn::message_ex *msg, const learn_request &request)
         }
     }
 
-    for (auto &file : response.state.files) {
-        file = file.substr(response.base_local_dir.length() + 1);
+    // the files of a secondary checkpoint are relative to base_local_dir already
+    if (!checkpoint_from_secondary) {
+        for (auto &file : response.state.files) {
+            file = file.substr(response.base_local_dir.length() + 1);
+        }
+    }
+
+    if (response.err == ERR_OK && response.type == learn_type::LT_APP &&
+        !request.local_files.empty()) {
+        response.err = get_reused_learn_files(request.local_files, response);
     }
 
     reply(msg, response);
@@ -599,6 +676,210 @@ void replica::on_learn(dsn::message_ex *msg, const learn_request &request)
     }
 }
 
+// ThreadPool: THREAD_POOL_REPLICATION
+error_code replica::get_reused_learn_files(const std::vector<file_meta> &local_files,
+                                           learn_response &resp) // on primary
+{
+    std::set<std::pair<std::string, int64_t>> local_keys;
+    for (const file_meta &f : local_files) {
+        local_keys.emplace(utils::filesystem::get_file_name(f.name), f.size);
+    }
+
+    // the files with the same name and size as a local file are reused if md5 also matches,
+    // md5 of them are computed in background and cached since a checkpoint is often learned
+    // by several learners
+    std::vector<file_meta> reused_files;
+    std::vector<file_meta> uncomputed_files;
+    auto &md5s = _primary_states.learn_file_md5s;
+    for (const std::string &name : resp.state.files) {
+        file_meta meta;
+        meta.name = name;
+        if (!utils::filesystem::file_size(
+                utils::filesystem::path_combine(resp.base_local_dir, name), meta.size) ||
+            local_keys.count({utils::filesystem::get_file_name(name), meta.size}) == 0) {
+            continue;
+        }
+        auto it = md5s.find(name);
+        if (it == md5s.end() || it->second.size != meta.size) {
+            uncomputed_files.emplace_back(std::move(meta));
+        } else if (!it->second.md5.empty()) {
+            reused_files.push_back(it->second);
+        }
+    }
+
+    if (!uncomputed_files.empty()) {
+        ddebug_replica("md5 of {} files to be reused by learner are being computed, retry later",
+                       uncomputed_files.size());
+        if (!_primary_states.learn_file_md5_is_computing) {
+            _primary_states.learn_file_md5_is_computing = true;
+            tasking::enqueue(
+                LPC_REPLICATION_LONG_COMMON,
+                &_tracker,
+                [
+                  this,
+                  dir = resp.base_local_dir,
+                  files = std::move(uncomputed_files),
+                  checkpoint_files = resp.state.files
+                ]() mutable {
+                    for (file_meta &f : files) {
+                        // a failed file is cached with empty md5 so that it won't be reused
+                        if (utils::filesystem::md5sum(utils::filesystem::path_combine(dir, f.name),
+                                                      f.md5) != ERR_OK) {
+                            f.md5.clear();
+                        }
+                    }
+                    tasking::enqueue(
+                        LPC_REPLICATION_COMMON,
+                        &_tracker,
+                        [
+                          this,
+                          files = std::move(files),
+                          checkpoint_files = std::move(checkpoint_files)
+                        ]() {
+                            _checker.only_one_thread_access();
+                            _primary_states.learn_file_md5_is_computing = false;
+                            if (status() != partition_status::PS_PRIMARY) {
+                                return;
+                            }
+                            // only keep the files of the latest learned checkpoint
+                            std::map<std::string, file_meta> md5s;
+                            for (const std::string &name : checkpoint_files) {
+                                auto it = _primary_states.learn_file_md5s.find(name);
+                                if (it != _primary_states.learn_file_md5s.end()) {
+                                    md5s.emplace(name, it->second);
+                                }
+                            }
+                            for (const file_meta &f : files) {
+                                md5s[f.name] = f;
+                            }
+                            _primary_states.learn_file_md5s = std::move(md5s);
+                        },
+                        get_gpid().thread_hash());
+                });
+        }
+        return ERR_BUSY;
+    }
+
+    ddebug_replica("{} of {} checkpoint files could be reused by learner",
+                   reused_files.size(),
+                   resp.state.files.size());
+    resp.__set_reused_files(std::move(reused_files));
+    return ERR_OK;
+}
+
+// ThreadPool: THREAD_POOL_REPLICATION
+bool replica::get_checkpoint_from_secondary(const learn_request &request,
+                                            remote_learner_state &learner_state,
+                                            learn_response &resp) // on primary
+{
+    typedef remote_learner_state::secondary_checkpoint_status checkpoint_status;
+
+    // the learner with local files to reuse learns from primary, who has the md5 of them
+    if (!FLAGS_learn_app_from_secondary || !request.local_files.empty()) {
+        return false;
+    }
+
+    switch (learner_state.secondary_checkpoint_state) {
+    case checkpoint_status::NONE: {
+        const auto &secondaries = _primary_states.membership.secondaries;
+        if (secondaries.empty()) {
+            learner_state.secondary_checkpoint_state = checkpoint_status::DONE;
+            return false;
+        }
+        // spread the learners over the secondaries
+        ::dsn::rpc_address source = secondaries[learner_state.signature % secondaries.size()];
+        replica_configuration config;
+        _primary_states.get_replica_config(partition_status::PS_SECONDARY, config);
+        rpc::call(source,
+                  RPC_REPLICA_COPY_LAST_CHECKPOINT,
+                  config,
+                  &_tracker,
+                  [ this, learner = request.learner, signature = request.signature ](
+                      error_code err, learn_response && ckpt) {
+                      on_query_secondary_checkpoint_reply(
+                          err, learner, signature, std::move(ckpt));
+                  },
+                  std::chrono::milliseconds(0),
+                  get_gpid().thread_hash());
+        learner_state.secondary_checkpoint_state = checkpoint_status::QUERYING;
+        ddebug_replica("on_learn[{:#018x}]: learner = {}, query checkpoint from secondary {}",
+                       request.signature,
+                       request.learner.to_string(),
+                       source.to_string());
+        resp.err = ERR_BUSY;
+        return true;
+    }
+    case checkpoint_status::QUERYING:
+        resp.err = ERR_BUSY;
+        return true;
+    case checkpoint_status::READY:
+        break;
+    default:
+        return false;
+    }
+
+    std::shared_ptr<learn_response> ckpt = std::move(learner_state.secondary_checkpoint);
+    learner_state.secondary_checkpoint_state = checkpoint_status::DONE;
+
+    // the logs after the checkpoint are learned from primary, which only keeps the logs after
+    // its own checkpoint
+    if (ckpt->state.to_decree_included < _app->last_durable_decree()) {
+        ddebug_replica("on_learn[{:#018x}]: learner = {}, checkpoint of secondary {} is older "
+                       "than the one of primary, {} vs {}, learn from primary",
+                       request.signature,
+                       request.learner.to_string(),
+                       ckpt->address.to_string(),
+                       ckpt->state.to_decree_included,
+                       _app->last_durable_decree());
+        return false;
+    }
+
+    resp.state = std::move(ckpt->state);
+    resp.address = ckpt->address;
+    resp.base_local_dir = ckpt->base_local_dir;
+    ddebug_replica("on_learn[{:#018x}]: learner = {}, learn checkpoint from secondary {}, "
+                   "learned_file_count = {}, learned_to_decree = {}",
+                   request.signature,
+                   request.learner.to_string(),
+                   resp.address.to_string(),
+                   resp.state.files.size(),
+                   resp.state.to_decree_included);
+    return true;
+}
+
+// ThreadPool: THREAD_POOL_REPLICATION
+void replica::on_query_secondary_checkpoint_reply(error_code err,
+                                                  ::dsn::rpc_address learner,
+                                                  int64_t signature,
+                                                  learn_response &&resp) // on primary
+{
+    _checker.only_one_thread_access();
+
+    typedef remote_learner_state::secondary_checkpoint_status checkpoint_status;
+    if (status() != partition_status::PS_PRIMARY) {
+        return;
+    }
+    auto it = _primary_states.learners.find(learner);
+    if (it == _primary_states.learners.end() || it->second.signature != signature ||
+        it->second.secondary_checkpoint_state != checkpoint_status::QUERYING) {
+        return;
+    }
+
+    if (err == ERR_OK) {
+        err = resp.err;
+    }
+    if (err != ERR_OK) {
+        dwarn_replica("query checkpoint from secondary for learner {} failed, learn from "
+                      "primary, error = {}",
+                      learner.to_string(),
+                      err.to_string());
+        it->second.secondary_checkpoint_state = checkpoint_status::DONE;
+        return;
+    }
+    it->second.secondary_checkpoint = std::make_shared<learn_response>(std::move(resp));
+    it->second.secondary_checkpoint_state = checkpoint_status::READY;
+}
+
 void replica::on_learn_reply(error_code err, learn_request &&req, learn_response &&resp)
 {
     _checker.only_one_thread_access();
@@ -639,10 +920,13 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
     _stub->_counter_replicas_learning_recent_copy_buffer_size->add(resp.state.meta.length());
 
     if (resp.err != ERR_OK) {
-        if (resp.err == ERR_INACTIVE_STATE || resp.err == ERR_INCONSISTENT_STATE) {
+        if (resp.err == ERR_INACTIVE_STATE || resp.err == ERR_INCONSISTENT_STATE ||
+            resp.err == ERR_BUSY) {
             dwarn("%s: on_learn_reply[%016" PRIx64
-                  "]: learnee = %s, learnee is updating ballot(inactive state) or "
-                  "reconciliation(inconsistent state), delay to start another round of learning",
+                  "]: learnee = %s, learnee is updating ballot(inactive state), "
+                  "reconciliation(inconsistent state), computing md5 of the files to be "
+                  "reused or querying the checkpoint of a secondary(busy), delay to start "
+                  "another round of learning",
                   name(),
                   req.signature,
                   resp.config.primary.to_string());
@@ -765,27 +1049,33 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
     }
 
     if (resp.type == learn_type::LT_APP) {
-        if (++_stub->_learn_app_concurrent_count > _options->learn_app_max_concurrent_count) {
-            --_stub->_learn_app_concurrent_count;
-            dwarn("%s: on_learn_reply[%016" PRIx64
-                  "]: learnee = %s, learn_app_concurrent_count(%d) >= "
-                  "learn_app_max_concurrent_count(%d), skip this round",
-                  name(),
-                  _potential_secondary_states.learning_version,
-                  _config.primary.to_string(),
-                  _stub->_learn_app_concurrent_count.load(),
-                  _options->learn_app_max_concurrent_count);
-            _potential_secondary_states.learning_round_is_running = false;
-            return;
-        } else {
+        if (!_potential_secondary_states.learn_app_concurrent_count_increased) {
+            int replica_count = learn_replica_count(resp, _app_info.max_replica_count);
+            if (!_stub->acquire_learn_slot(get_gpid(), _dir, replica_count)) {
+                dwarn("%s: on_learn_reply[%016" PRIx64
+                      "]: learnee = %s, no slot of learning app, queued with replica_count = %d, "
+                      "learn_app_running_count = %d, learn_app_queued_count = %d",
+                      name(),
+                      _potential_secondary_states.learning_version,
+                      _config.primary.to_string(),
+                      replica_count,
+                      _stub->_learn_scheduler->running_count(),
+                      _stub->_learn_scheduler->queued_count());
+                _potential_secondary_states.learning_round_is_running = false;
+                return;
+            }
             _potential_secondary_states.learn_app_concurrent_count_increased = true;
-            ddebug("%s: on_learn_reply[%016" PRIx64
-                   "]: learnee = %s, ++learn_app_concurrent_count = %d",
-                   name(),
-                   _potential_secondary_states.learning_version,
-                   _config.primary.to_string(),
-                   _stub->_learn_app_concurrent_count.load());
         }
+        ddebug("%s: on_learn_reply[%016" PRIx64
+               "]: learnee = %s, take the slot of learning app, learn_app_running_count = %d",
+               name(),
+               _potential_secondary_states.learning_version,
+               _config.primary.to_string(),
+               _stub->_learn_scheduler->running_count());
+    } else if (_potential_secondary_states.learn_app_concurrent_count_increased) {
+        // the slot taken in the queue isn't used as the app needn't be learned any more
+        _potential_secondary_states.learn_app_concurrent_count_increased = false;
+        _stub->release_learn_slot(get_gpid());
     }
 
     switch (resp.type) {
@@ -854,7 +1144,9 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
 
                 // write to shared log with no callback, the later 2pc ensures that logs
                 // are written to the disk
-                _stub->_log->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, &_tracker, nullptr);
+                if (!_stub->_log_shared_disabled) {
+                    _stub->_log->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, &_tracker, nullptr);
+                }
 
                 // because shared log are written without callback, need to manully
                 // set flag and write mutations to private log
@@ -933,7 +1225,8 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
 
     else if (resp.state.files.size() > 0) {
         auto learn_dir = _app->learn_dir();
-        utils::filesystem::remove_path(learn_dir);
+        // the files copied by the last failed learn may be resumed
+        nfs_node::prepare_copy_dir(learn_dir, resp.state.files);
         utils::filesystem::create_directory(learn_dir);
 
         if (!dsn::utils::filesystem::directory_exists(learn_dir)) {
@@ -961,18 +1254,30 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
             return;
         }
 
+        if (!resp.reused_files.empty()) {
+            _potential_secondary_states.learn_remote_files_task = tasking::create_task(
+                LPC_LEARN_REMOTE_DELTA_FILES,
+                &_tracker,
+                [ this, req_cap = std::move(req), resp_cap = std::move(resp) ]() mutable {
+                    copy_reused_and_remote_files(std::move(req_cap), std::move(resp_cap));
+                });
+            _potential_secondary_states.learn_remote_files_task->enqueue();
+            return;
+        }
+
         bool high_priority = (resp.type == learn_type::LT_APP ? false : true);
         ddebug("%s: on_learn_reply[%016" PRIx64 "]: learnee = %s, learn_duration = %" PRIu64
-               " ms, start to copy remote files, copy_file_count = %d, priority = %s",
+               " ms, start to copy remote files from %s, copy_file_count = %d, priority = %s",
                name(),
                req.signature,
                resp.config.primary.to_string(),
                _potential_secondary_states.duration_ms(),
+               resp.address.to_string(),
                static_cast<int>(resp.state.files.size()),
                high_priority ? "high" : "low");
 
         _potential_secondary_states.learn_remote_files_task = _stub->_nfs->copy_remote_files(
-            resp.config.primary,
+            resp.address,
             resp.base_local_dir,
             resp.state.files,
             learn_dir,
@@ -988,7 +1293,9 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
             ](error_code err, size_t sz) mutable {
                 on_copy_remote_state_completed(
                     err, sz, copy_start, std::move(req_cap), std::move(resp_copy));
-            });
+            },
+            0,
+            learn_copy_priority(resp, _app_info.max_replica_count));
     } else {
         _potential_secondary_states.learn_remote_files_task =
             tasking::create_task(LPC_LEARN_REMOTE_DELTA_FILES, &_tracker, [
@@ -1004,6 +1311,123 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
     }
 }
 
+// ThreadPool: THREAD_POOL_REPLICATION
+void replica::on_learn_slot_granted()
+{
+    _checker.only_one_thread_access();
+
+    // the slot may have been released by the cleanup of the learning meanwhile
+    if (status() != partition_status::PS_POTENTIAL_SECONDARY ||
+        !_stub->_learn_scheduler->is_running(get_gpid())) {
+        _stub->release_learn_slot(get_gpid());
+        return;
+    }
+
+    _potential_secondary_states.learn_app_concurrent_count_increased = true;
+    ddebug_replica("the slot of learning app is taken, learning_version = {:#018x}, start "
+                   "another round of learning",
+                   _potential_secondary_states.learning_version);
+    if (!_potential_secondary_states.learning_round_is_running) {
+        init_learn(_potential_secondary_states.learning_version);
+    }
+}
+
+// ThreadPool: THREAD_POOL_REPLICATION_LONG
+void replica::copy_reused_and_remote_files(learn_request &&req, learn_response &&resp)
+{
+    std::multimap<std::pair<std::string, int64_t>, std::string> local_files;
+    for (const file_meta &f : _potential_secondary_states.local_files) {
+        local_files.emplace(std::make_pair(utils::filesystem::get_file_name(f.name), f.size),
+                            f.name);
+    }
+
+    const std::string &data_dir = _app->data_dir();
+    const std::string &learn_dir = _app->learn_dir();
+    // copy the first candidate of each reused file, then verify the copies concurrently, as the
+    // local files may have been changed since collected
+    typedef decltype(local_files)::iterator candidate_iter;
+    std::vector<std::pair<candidate_iter, candidate_iter>> candidates;
+    std::vector<const file_meta *> copied_metas;
+    std::vector<utils::filesystem::file_to_verify> copied;
+    for (const file_meta &f : resp.reused_files) {
+        std::string target = utils::filesystem::path_combine(learn_dir, f.name);
+        utils::filesystem::create_directory(utils::filesystem::remove_file_name(target));
+        auto range = local_files.equal_range(
+            std::make_pair(utils::filesystem::get_file_name(f.name), f.size));
+        for (auto it = range.first; it != range.second; ++it) {
+            if (utils::filesystem::copy_file(utils::filesystem::path_combine(data_dir, it->second),
+                                             target)) {
+                candidates.emplace_back(std::next(it), range.second);
+                copied_metas.push_back(&f);
+                copied.push_back({target, f.md5, f.size});
+                break;
+            }
+            utils::filesystem::remove_path(target);
+        }
+    }
+    std::vector<bool> verified;
+    utils::filesystem::verify_files(copied, FLAGS_learn_verify_threads, verified);
+
+    std::set<std::string> reused;
+    int64_t reused_size = 0;
+    for (size_t i = 0; i < copied.size(); ++i) {
+        const utils::filesystem::file_to_verify &f = copied[i];
+        // the other candidates are tried one by one if the first one is changed
+        for (auto it = candidates[i].first; !verified[i] && it != candidates[i].second; ++it) {
+            utils::filesystem::remove_path(f.fname);
+            verified[i] =
+                utils::filesystem::copy_file(utils::filesystem::path_combine(data_dir, it->second),
+                                             f.fname) &&
+                utils::filesystem::verify_file(f.fname, f.md5, f.size);
+        }
+        if (verified[i]) {
+            reused.insert(copied_metas[i]->name);
+            reused_size += f.size;
+        } else {
+            utils::filesystem::remove_path(f.fname);
+        }
+    }
+
+    std::vector<std::string> remote_files;
+    for (const std::string &name : resp.state.files) {
+        if (reused.count(name) == 0) {
+            remote_files.push_back(name);
+        }
+    }
+
+    ddebug_replica("on_learn_reply[{:#018x}]: learnee = {}, learn_duration = {} ms, reused {} "
+                   "local files of {} bytes, start to copy remote files, copy_file_count = {}",
+                   req.signature,
+                   resp.config.primary.to_string(),
+                   _potential_secondary_states.duration_ms(),
+                   reused.size(),
+                   reused_size,
+                   remote_files.size());
+
+    uint64_t copy_start = _potential_secondary_states.duration_ms();
+    if (remote_files.empty()) {
+        on_copy_remote_state_completed(ERR_OK, 0, copy_start, std::move(req), std::move(resp));
+        return;
+    }
+
+    _potential_secondary_states.learn_remote_files_task = _stub->_nfs->copy_remote_files(
+        resp.address,
+        resp.base_local_dir,
+        remote_files,
+        learn_dir,
+        true,  // overwrite
+        false, // low priority as learning app
+        LPC_REPLICATION_COPY_REMOTE_FILES,
+        &_tracker,
+        [ this, copy_start, req_cap = std::move(req), resp_copy = resp ](error_code err,
+                                                                         size_t sz) mutable {
+            on_copy_remote_state_completed(
+                err, sz, copy_start, std::move(req_cap), std::move(resp_copy));
+        },
+        0,
+        learn_copy_priority(resp, _app_info.max_replica_count));
+}
+
 void replica::on_copy_remote_state_completed(error_code err,
                                              size_t size,
                                              uint64_t copy_start_time,
@@ -1037,14 +1461,14 @@ void replica::on_copy_remote_state_completed(error_code err,
            enum_to_string(_potential_secondary_states.learning_status));
 
     if (resp.type == learn_type::LT_APP) {
-        --_stub->_learn_app_concurrent_count;
         _potential_secondary_states.learn_app_concurrent_count_increased = false;
+        _stub->release_learn_slot(get_gpid());
         ddebug("%s: on_copy_remote_state_completed[%016" PRIx64
-               "]: learnee = %s, --learn_app_concurrent_count = %d",
+               "]: learnee = %s, release the slot of learning app, learn_app_running_count = %d",
                name(),
                _potential_secondary_states.learning_version,
                _config.primary.to_string(),
-               _stub->_learn_app_concurrent_count.load());
+               _stub->_learn_scheduler->running_count());
     }
 
     if (err == ERR_OK) {
@@ -1528,22 +1952,46 @@ error_code replica::apply_learned_state_from_private_log(learn_state &state)
     int64_t offset;
     error_code err;
 
+    // the committed mutations are applied to the app in batches
+    std::vector<mutation_ptr> apply_batch;
+    error_code apply_err = ERR_OK;
+    int64_t apply_count = 0;
+    uint64_t apply_start_ts = dsn_now_ns();
+    auto apply_batched_mutations = [this, &apply_batch, &apply_err, &apply_count]() {
+        if (apply_batch.empty()) {
+            return;
+        }
+        if (apply_err == ERR_OK) {
+            std::vector<const mutation *> mutations;
+            mutations.reserve(apply_batch.size());
+            for (const mutation_ptr &mu : apply_batch) {
+                mutations.push_back(mu.get());
+            }
+            apply_err = _app->apply_mutations(mutations);
+            apply_count += apply_batch.size();
+        }
+        apply_batch.clear();
+    };
+
     // temp prepare list for learning purpose
-    prepare_list plist(this,
-                       _app->last_committed_decree(),
-                       _options->max_mutation_count_in_prepare_list,
-                       [this, duplicating](mutation_ptr &mu) {
-                           if (mu->data.header.decree == _app->last_committed_decree() + 1) {
-                               // TODO: assign the returned error_code to err and check it
-                               _app->apply_mutation(mu);
-
-                               // appends logs-in-cache into plog to ensure them can be duplicated.
-                               if (duplicating) {
-                                   _private_log->append(
-                                       mu, LPC_WRITE_REPLICATION_LOG_COMMON, &_tracker, nullptr);
-                               }
-                           }
-                       });
+    prepare_list plist(
+        this,
+        _app->last_committed_decree(),
+        _options->max_mutation_count_in_prepare_list,
+        [this, duplicating, &apply_batch, &apply_batched_mutations](mutation_ptr &mu) {
+            if (mu->data.header.decree ==
+                _app->last_committed_decree() + 1 + static_cast<decree>(apply_batch.size())) {
+                apply_batch.push_back(mu);
+                if (apply_batch.size() >= FLAGS_learn_apply_batch_size) {
+                    apply_batched_mutations();
+                }
+
+                // appends logs-in-cache into plog to ensure them can be duplicated.
+                if (duplicating) {
+                    _private_log->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, &_tracker, nullptr);
+                }
+            }
+        });
 
     err = mutation_log::replay(state.files,
                                [&plist](int log_length, mutation_ptr &mu) {
@@ -1560,6 +2008,7 @@ error_code replica::apply_learned_state_from_private_log(learn_state &state)
                                    return true;
                                },
                                offset);
+    apply_batched_mutations();
 
     // update first_learn_start_decree, the position where the first round of LT_LOG starts from.
     // we use this value to determine whether to learn back from min_confirmed_decree
@@ -1624,6 +2073,7 @@ error_code replica::apply_learned_state_from_private_log(learn_state &state)
                    last_committed_decree());
             plist.commit(state.to_decree_included, COMMIT_TO_DECREE_SOFT);
         }
+        apply_batched_mutations();
 
         ddebug("%s: apply_learned_state_from_private_log[%016" PRIx64 "]: learnee = %s, "
                "learn_duration = %" PRIu64 " ms, apply in-buffer private logs done, "
@@ -1636,11 +2086,21 @@ error_code replica::apply_learned_state_from_private_log(learn_state &state)
                _app->last_committed_decree());
     }
 
+    uint64_t apply_duration_ns = std::max<uint64_t>(dsn_now_ns() - apply_start_ts, 1);
+    ddebug_replica("apply_learned_state_from_private_log[{:#018x}]: applied {} mutations in {} ms "
+                   "with batch size {}, apply_qps = {}, err = {}",
+                   _potential_secondary_states.learning_version,
+                   apply_count,
+                   apply_duration_ns / 1000000,
+                   FLAGS_learn_apply_batch_size,
+                   apply_count * 1000000000 / apply_duration_ns,
+                   apply_err.to_string());
+
     // awaits for unfinished mutation writes.
     if (duplicating) {
         _private_log->flush();
     }
-    return err;
+    return err != ERR_OK ? err : apply_err;
 }
 } // namespace replication
 } // namespace dsn
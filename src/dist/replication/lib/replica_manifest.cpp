@@ -0,0 +1,173 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "replica_manifest.h"
+
+#include <dsn/cpp/serialization.h>
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/binary_reader.h>
+#include <dsn/utility/binary_writer.h>
+#include <dsn/utility/crc.h>
+#include <dsn/utility/filesystem.h>
+
+#include <fstream>
+
+namespace dsn {
+namespace replication {
+
+const std::string replica_manifest::FILE_NAME(".replica-manifest");
+
+namespace {
+
+const int8_t RECORD_ADD = 1;
+const int8_t RECORD_REMOVE = 2;
+
+// a record is <payload length, crc of payload, payload>, where the payload is
+// <type, name of the replica dir, app info if added>
+const size_t RECORD_HEADER_SIZE = sizeof(uint32_t) * 2;
+
+blob encode_record(const std::string &name, const app_info *info)
+{
+    binary_writer payload;
+    payload.write(info != nullptr ? RECORD_ADD : RECORD_REMOVE);
+    payload.write(name);
+    if (info != nullptr) {
+        marshall(payload, *info, DSF_THRIFT_BINARY);
+    }
+    blob data = payload.get_buffer();
+
+    binary_writer record;
+    record.write(static_cast<uint32_t>(data.length()));
+    record.write(utils::crc32_calc(data.data(), data.length(), 0));
+    record.write(data.data(), data.length());
+    return record.get_buffer();
+}
+
+} // anonymous namespace
+
+replica_manifest::replica_manifest(const std::string &data_dir)
+    : _path(utils::filesystem::path_combine(data_dir, FILE_NAME))
+{
+}
+
+bool replica_manifest::load()
+{
+    zauto_lock l(_lock);
+    _entries.clear();
+
+    if (!utils::filesystem::file_exists(_path)) {
+        return false;
+    }
+    std::string data;
+    if (utils::filesystem::read_file(_path, data) != ERR_OK) {
+        derror_f("read replica manifest {} failed", _path);
+        return false;
+    }
+
+    size_t offset = 0;
+    size_t record_count = 0;
+    while (data.size() - offset >= RECORD_HEADER_SIZE) {
+        uint32_t length, crc;
+        memcpy(&length, data.data() + offset, sizeof(length));
+        memcpy(&crc, data.data() + offset + sizeof(length), sizeof(crc));
+        const char *payload = data.data() + offset + RECORD_HEADER_SIZE;
+        if (data.size() - offset - RECORD_HEADER_SIZE < length ||
+            utils::crc32_calc(payload, length, 0) != crc) {
+            // torn by a crash while appending, the records after which are lost
+            dwarn_f("replica manifest {} is corrupted at offset {}, the rest {} bytes are ignored",
+                    _path,
+                    offset,
+                    data.size() - offset);
+            break;
+        }
+
+        binary_reader reader(blob::create_from_bytes(payload, length));
+        int8_t type;
+        std::string name;
+        reader.read(type);
+        reader.read(name);
+        if (type == RECORD_ADD) {
+            unmarshall(reader, _entries[name], DSF_THRIFT_BINARY);
+        } else {
+            _entries.erase(name);
+        }
+        offset += RECORD_HEADER_SIZE + length;
+        ++record_count;
+    }
+
+    ddebug_f("load replica manifest {} succeed, record_count = {}, entry_count = {}",
+             _path,
+             record_count,
+             _entries.size());
+    return record_count > 0;
+}
+
+bool replica_manifest::get(const std::string &name, /*out*/ app_info &info) const
+{
+    zauto_lock l(_lock);
+    auto it = _entries.find(name);
+    if (it == _entries.end()) {
+        return false;
+    }
+    info = it->second;
+    return true;
+}
+
+void replica_manifest::add(const std::string &name, const app_info &info)
+{
+    zauto_lock l(_lock);
+    if (append(name, &info)) {
+        _entries[name] = info;
+    }
+}
+
+void replica_manifest::remove(const std::string &name)
+{
+    zauto_lock l(_lock);
+    if (_entries.find(name) != _entries.end() && append(name, nullptr)) {
+        _entries.erase(name);
+    }
+}
+
+void replica_manifest::reset(std::map<std::string, app_info> entries)
+{
+    zauto_lock l(_lock);
+    _entries = std::move(entries);
+
+    std::string tmp_path = _path + ".tmp";
+    std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+    for (const auto &kv : _entries) {
+        blob record = encode_record(kv.first, &kv.second);
+        os.write(record.data(), record.length());
+    }
+    os.close();
+    if (os.fail() || !utils::filesystem::rename_path(tmp_path, _path)) {
+        // the next startup falls back to the .app-info files of the replica dirs not recorded
+        derror_f("store replica manifest {} failed", _path);
+        utils::filesystem::remove_path(tmp_path);
+        utils::filesystem::remove_path(_path);
+    }
+}
+
+size_t replica_manifest::size() const
+{
+    zauto_lock l(_lock);
+    return _entries.size();
+}
+
+bool replica_manifest::append(const std::string &name, const app_info *info)
+{
+    blob record = encode_record(name, info);
+    std::ofstream os(_path, std::ios::binary | std::ios::app);
+    os.write(record.data(), record.length());
+    os.close();
+    if (os.fail()) {
+        derror_f("append to replica manifest {} failed, name = {}", _path, name);
+        return false;
+    }
+    return true;
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,63 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <dsn/cpp/serialization_helper/dsn.layer2_types.h>
+#include <dsn/tool-api/zlocks.h>
+
+#include <map>
+#include <string>
+
+namespace dsn {
+namespace replication {
+
+// replica_manifest is the list of the replica dirs under a data dir with their app infos, by
+// which the replica server starts without reading the .app-info of each replica dir.
+//
+// It is stored in the file ".replica-manifest" of the data dir, as a journal of the records of
+// the replica dirs added and removed, each with its crc. The journal is appended to when a
+// replica dir is created or removed, and compacted into the current entries on each startup.
+//
+// The manifest is only a cache of the .app-info files, so it may miss some changes, e.g. if the
+// process crashes before a record is appended. On startup, the entries not on the disk are
+// dropped, the dirs not in the manifest are loaded by their .app-info, and the entries used are
+// verified against the .app-info files in the background.
+// Thread-safe
+class replica_manifest
+{
+public:
+    static const std::string FILE_NAME;
+
+    explicit replica_manifest(const std::string &data_dir);
+
+    // reads the journal, of which the records after a corrupted one are ignored. returns false
+    // if the file doesn't exist or no record is read.
+    bool load();
+
+    // the app info of the replica dir named `name`, returns false if it isn't in the manifest
+    bool get(const std::string &name, /*out*/ app_info &info) const;
+
+    // appends a record of the replica dir named `name` created with `info`
+    void add(const std::string &name, const app_info &info);
+
+    // appends a record of the replica dir named `name` removed
+    void remove(const std::string &name);
+
+    // rewrites the journal with only `entries`, keyed by the names of the replica dirs
+    void reset(std::map<std::string, app_info> entries);
+
+    size_t size() const;
+
+private:
+    bool append(const std::string &name, const app_info *info);
+
+    const std::string _path;
+
+    mutable zlock _lock;
+    std::map<std::string, app_info> _entries;
+};
+
+} // namespace replication
+} // namespace dsn
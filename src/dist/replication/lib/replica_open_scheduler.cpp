@@ -0,0 +1,85 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "replica_open_scheduler.h"
+
+namespace dsn {
+namespace replication {
+
+std::vector<gpid>
+replica_open_scheduler::add(gpid pid, const std::string &disk_tag, bool is_primary)
+{
+    std::vector<gpid> started;
+    zauto_lock l(_lock);
+    (is_primary ? _primaries : _others).push_back(open_request{pid, disk_tag});
+    start_queued_unlocked(started);
+    return started;
+}
+
+std::vector<gpid> replica_open_scheduler::finish(gpid pid)
+{
+    std::vector<gpid> started;
+    zauto_lock l(_lock);
+    auto it = _running.find(pid);
+    if (it == _running.end()) {
+        return started;
+    }
+    if (!it->second.empty() && --_disk_counts[it->second] == 0) {
+        _disk_counts.erase(it->second);
+    }
+    _running.erase(it);
+    start_queued_unlocked(started);
+    return started;
+}
+
+int replica_open_scheduler::running_count() const
+{
+    zauto_lock l(_lock);
+    return _running.size();
+}
+
+int replica_open_scheduler::queued_count() const
+{
+    zauto_lock l(_lock);
+    return _primaries.size() + _others.size();
+}
+
+bool replica_open_scheduler::can_start_unlocked(const open_request &req) const
+{
+    if (req.disk_tag.empty() || _max_per_disk == 0) {
+        return true;
+    }
+    auto it = _disk_counts.find(req.disk_tag);
+    return it == _disk_counts.end() || it->second < static_cast<int>(_max_per_disk);
+}
+
+void replica_open_scheduler::start_queued_unlocked(/*out*/ std::vector<gpid> &started)
+{
+    start_from_unlocked(_primaries, started);
+    start_from_unlocked(_others, started);
+}
+
+void replica_open_scheduler::start_from_unlocked(std::deque<open_request> &queue,
+                                                 /*out*/ std::vector<gpid> &started)
+{
+    // the opens on a busy disk are skipped rather than blocking those on the other disks
+    for (auto it = queue.begin(); it != queue.end();) {
+        if (_max_concurrent > 0 && _running.size() >= _max_concurrent) {
+            return;
+        }
+        if (!can_start_unlocked(*it)) {
+            ++it;
+            continue;
+        }
+        if (!it->disk_tag.empty()) {
+            ++_disk_counts[it->disk_tag];
+        }
+        _running.emplace(it->pid, it->disk_tag);
+        started.push_back(it->pid);
+        it = queue.erase(it);
+    }
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,67 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <dsn/tool-api/gpid.h>
+#include <dsn/tool-api/zlocks.h>
+
+namespace dsn {
+namespace replication {
+
+///
+/// replica_open_scheduler bounds the replicas opened concurrently by replica_stub, in total and
+/// on each disk, so that a burst of opens after a failover doesn't overload a disk while the
+/// others are idle. The queued opens of primaries are started before those of the others, as
+/// the partitions are unavailable until their primaries are opened.
+///
+class replica_open_scheduler
+{
+public:
+    // 0 means no limit
+    replica_open_scheduler(uint32_t max_concurrent, uint32_t max_per_disk)
+        : _max_concurrent(max_concurrent), _max_per_disk(max_per_disk)
+    {
+    }
+
+    // queue the open of `pid` on the disk of `disk_tag`, where an empty disk tag is only limited
+    // by the total count, and return the opens to start now
+    std::vector<gpid> add(gpid pid, const std::string &disk_tag, bool is_primary);
+
+    // called when the open of `pid` started before is done, return the opens to start now
+    std::vector<gpid> finish(gpid pid);
+
+    int running_count() const;
+    int queued_count() const;
+
+private:
+    struct open_request
+    {
+        gpid pid;
+        std::string disk_tag;
+    };
+
+    // caller should hold _lock
+    bool can_start_unlocked(const open_request &req) const;
+    void start_queued_unlocked(/*out*/ std::vector<gpid> &started);
+    void start_from_unlocked(std::deque<open_request> &queue, /*out*/ std::vector<gpid> &started);
+
+    const uint32_t _max_concurrent;
+    const uint32_t _max_per_disk;
+
+    mutable zlock _lock;
+    std::deque<open_request> _primaries;
+    std::deque<open_request> _others;
+    // pid -> disk tag
+    std::map<gpid, std::string> _running;
+    std::map<std::string, int> _disk_counts;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -107,20 +107,44 @@ error_code replica::download_checkpoint(const configuration_restore_request &req
         return err;
     }
 
-    // download checkpoint files
+    // download checkpoint files, the count of the concurrent downloads is limited by the
+    // scheduler shared by all the replicas of this node
+    block_service_manager &bs_manager = _stub->_block_service_manager;
+    zlock err_lock;
     task_tracker tracker;
     for (const auto &f_meta : backup_metadata.files) {
-        tasking::enqueue(
-            TASK_CODE_EXEC_INLINED,
+        {
+            zauto_lock l(err_lock);
+            if (err != ERR_OK) {
+                // the whole checkpoint will be removed, so stop downloading the rest files
+                break;
+            }
+        }
+
+        // the files reused by incremental backup are under the checkpoint dirs of the previous
+        // backups
+        auto reused = backup_metadata.reused_files.find(f_meta.name);
+        const std::string &remote_dir =
+            reused == backup_metadata.reused_files.end() ? remote_chkpt_dir : reused->second;
+        bs_manager.async_download_file(
+            remote_dir,
+            local_chkpt_dir,
+            f_meta.name,
+            fs,
+            &bs_manager.get_download_scheduler(),
             &tracker,
-            [this, &err, remote_chkpt_dir, local_chkpt_dir, f_meta, fs]() {
-                uint64_t f_size = 0;
-                error_code download_err = _stub->_block_service_manager.download_file(
-                    remote_chkpt_dir, local_chkpt_dir, f_meta.name, fs, f_size);
-                const std::string file_name =
-                    utils::filesystem::path_combine(local_chkpt_dir, f_meta.name);
+            [this, &err, &err_lock, f_meta](
+                error_code download_err, uint64_t f_size, const std::string &f_md5) {
+                // the md5 is computed while downloading, so it's unnecessary to read the file
+                // again for verification
                 if (download_err == ERR_OK &&
-                    !utils::filesystem::verify_file(file_name, f_meta.md5, f_meta.size)) {
+                    (f_size != static_cast<uint64_t>(f_meta.size) || f_md5 != f_meta.md5)) {
+                    derror_replica("file({}) is damaged, size: {} VS {}, md5: {} VS {}",
+                                   f_meta.name,
+                                   f_size,
+                                   f_meta.size,
+                                   f_md5,
+                                   f_meta.md5);
                     download_err = ERR_CORRUPTION;
                 }
 
@@ -129,10 +153,11 @@ error_code replica::download_checkpoint(const configuration_restore_request &req
                         "failed to download file({}), error = {}", f_meta.name, download_err);
                     // ERR_CORRUPTION means we should rollback restore, so we can't change err if it
                     // is ERR_CORRUPTION now, otherwise it will be overridden by other errors
+                    zauto_lock l(err_lock);
                     if (err != ERR_CORRUPTION) {
                         err = download_err;
-                        return;
                     }
+                    return;
                 }
 
                 // update progress if download file succeed
@@ -368,6 +393,7 @@ dsn::error_code replica::skip_restore_partition(const std::string &restore_dir)
         utils::filesystem::create_directory(restore_dir)) {
         ddebug("%s: clear restore_dir(%s) succeed", name(), restore_dir.c_str());
         _restore_progress.store(cold_backup_constant::PROGRESS_FINISHED);
+        _counter_restore_progress->set(cold_backup_constant::PROGRESS_FINISHED);
         return ERR_OK;
     } else {
         derror("clear dir %s failed", restore_dir.c_str());
@@ -442,11 +468,13 @@ void replica::update_restore_progress(uint64_t f_size)
         return;
     }
 
-    _cur_download_size.fetch_add(f_size);
+    _counter_restore_download_bytes->add(f_size);
+    // the files are downloaded concurrently
+    auto cur_download_size = static_cast<double>(_cur_download_size.fetch_add(f_size) + f_size);
     auto total_size = static_cast<double>(_chkpt_total_size);
-    auto cur_download_size = static_cast<double>(_cur_download_size.load());
     auto cur_porgress = static_cast<int32_t>((cur_download_size / total_size) * 1000);
     _restore_progress.store(cur_porgress);
+    _counter_restore_progress->set(cur_porgress);
     ddebug_replica("total_size = {}, cur_downloaded_size = {}, progress = {}",
                    total_size,
                    cur_download_size,
@@ -7,6 +7,7 @@
 #include <dsn/utility/defer.h>
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 
 #include "replica.h"
 #include "replica_stub.h"
@@ -14,6 +15,16 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                split_link_checkpoint,
+                true,
+                "hard link the files of the parent's latest checkpoint into the child instead of "
+                "copying a new checkpoint, if the parent and child are on the same disk");
+DSN_DEFINE_int32("replication",
+                 split_max_concurrent_learn_count,
+                 8,
+                 "the max count of children learning parent states concurrently on a node");
+
 // ThreadPool: THREAD_POOL_REPLICATION
 void replica::on_add_child(const group_check_request &request) // on parent partition
 {
@@ -144,16 +155,32 @@ void replica::parent_prepare_states(const std::string &dir) // on parent partiti
 
     learn_state parent_states;
     int64_t checkpoint_decree;
+    dsn::error_code ec = ERR_OBJECT_NOT_FOUND;
+    // link the latest checkpoint, which saves copying all the files
+    if (FLAGS_split_link_checkpoint) {
+        ec = parent_link_checkpoint(dir, parent_states);
+        if (ec == ERR_OK) {
+            checkpoint_decree = parent_states.to_decree_included;
+        } else {
+            dwarn_replica("link checkpoint failed, fall back to copy it, error = {}", ec);
+        }
+    }
     // generate checkpoint
-    dsn::error_code ec = _app->copy_checkpoint_to_dir(dir.c_str(), &checkpoint_decree);
+    if (ec != ERR_OK) {
+        parent_states = learn_state();
+        ec = _app->copy_checkpoint_to_dir(dir.c_str(), &checkpoint_decree);
+    }
     if (ec == ERR_OK) {
         ddebug_replica("prepare checkpoint succeed: checkpoint dir = {}, checkpoint decree = {}",
                        dir,
                        checkpoint_decree);
         parent_states.to_decree_included = checkpoint_decree;
-        // learn_state.files[0] will be used to get learn dir in function 'storage_apply_checkpoint'
-        // so we add a fake file name here, this file won't appear on disk
-        parent_states.files.push_back(dsn::utils::filesystem::path_combine(dir, "file_name"));
+        if (parent_states.files.empty()) {
+            // learn_state.files[0] will be used to get learn dir in function
+            // 'storage_apply_checkpoint' so we add a fake file name here, this file won't appear
+            // on disk
+            parent_states.files.push_back(dsn::utils::filesystem::path_combine(dir, "file_name"));
+        }
     } else {
         derror_replica("prepare checkpoint failed, error = {}", ec.to_string());
         tasking::enqueue(LPC_PARTITION_SPLIT,
@@ -204,6 +231,62 @@ void replica::parent_prepare_states(const std::string &dir) // on parent partiti
     }
 }
 
+// ThreadPool: THREAD_POOL_REPLICATION
+error_code replica::parent_link_checkpoint(const std::string &dir,
+                                           /*out*/ learn_state &state) // on parent partition
+{
+    // hard link doesn't work across disks
+    std::string parent_tag, child_tag;
+    if (_stub->_fs_manager.get_disk_tag(_dir, parent_tag) != ERR_OK ||
+        _stub->_fs_manager.get_disk_tag(dir, child_tag) != ERR_OK || parent_tag != child_tag) {
+        ddebug_replica("parent dir({}) and child dir({}) are not on the same disk", _dir, dir);
+        return ERR_INVALID_PARAMETERS;
+    }
+
+    learn_state checkpoint;
+    error_code ec = _app->get_checkpoint(0, blob(), checkpoint);
+    if (ec != ERR_OK) {
+        return ec;
+    }
+    if (checkpoint.to_decree_included <= 0 || checkpoint.files.empty()) {
+        return ERR_OBJECT_NOT_FOUND;
+    }
+
+    // the files of the checkpoint are under data dir, keep their relative paths in child's dir
+    const std::string &data_dir = _app->data_dir();
+    utils::filesystem::remove_path(dir);
+    std::vector<std::string> linked_files;
+    for (const std::string &file : checkpoint.files) {
+        if (file.compare(0, data_dir.size() + 1, data_dir + "/") != 0) {
+            derror_replica("checkpoint file({}) is not under data dir({})", file, data_dir);
+            ec = ERR_INVALID_DATA;
+            break;
+        }
+        std::string target = utils::filesystem::path_combine(dir, file.substr(data_dir.size() + 1));
+        if (!utils::filesystem::create_directory(utils::filesystem::remove_file_name(target)) ||
+            !utils::filesystem::link_file(file, target)) {
+            derror_replica("link checkpoint file({}) to {} failed", file, target);
+            ec = ERR_FILE_OPERATION_FAILED;
+            break;
+        }
+        linked_files.emplace_back(std::move(target));
+    }
+    if (ec != ERR_OK) {
+        utils::filesystem::remove_path(dir);
+        return ec;
+    }
+
+    ddebug_replica("link checkpoint succeed: {} files linked into {}, checkpoint decree = {}",
+                   linked_files.size(),
+                   dir,
+                   checkpoint.to_decree_included);
+    state.from_decree_excluded = checkpoint.from_decree_excluded;
+    state.to_decree_included = checkpoint.to_decree_included;
+    state.meta = checkpoint.meta;
+    state.files = std::move(linked_files);
+    return ERR_OK;
+}
+
 // ThreadPool: THREAD_POOL_REPLICATION
 void replica::child_copy_prepare_list(learn_state lstate,
                                       std::vector<mutation_ptr> mutation_list,
@@ -242,11 +325,17 @@ void replica::child_copy_prepare_list(learn_state lstate,
     plist->set_committer(std::bind(&replica::execute_mutation, this, std::placeholders::_1));
     delete _prepare_list;
     _prepare_list = new prepare_list(this, *plist);
+    if (_app->support_batched_mutations()) {
+        _prepare_list->set_batch_committer(
+            std::bind(&replica::execute_mutations, this, std::placeholders::_1));
+    }
     for (decree d = last_committed_decree + 1; d <= _prepare_list->max_decree(); ++d) {
         mutation_ptr mu = _prepare_list->get_mutation_by_decree(d);
         dassert_replica(mu != nullptr, "can not find mutation, dercee={}", d);
         mu->data.header.pid = get_gpid();
-        _stub->_log->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, tracker(), nullptr);
+        if (!_stub->_log_shared_disabled) {
+            _stub->_log->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, tracker(), nullptr);
+        }
         _private_log->append(mu, LPC_WRITE_REPLICATION_LOG_COMMON, tracker(), nullptr);
         // set mutation has been logged in private log
         if (!mu->is_logged()) {
@@ -271,6 +360,27 @@ void replica::child_learn_states(learn_state lstate,
         return;
     }
 
+    if (++_stub->_split_learn_concurrent_count > FLAGS_split_max_concurrent_learn_count) {
+        --_stub->_split_learn_concurrent_count;
+        dwarn_replica("split_learn_concurrent_count({}) reaches "
+                      "split_max_concurrent_learn_count({}), retry later",
+                      _stub->_split_learn_concurrent_count.load(),
+                      FLAGS_split_max_concurrent_learn_count);
+        _split_states.async_learn_task = tasking::enqueue(LPC_PARTITION_SPLIT_ASYNC_LEARN,
+                                                          tracker(),
+                                                          std::bind(&replica::child_learn_states,
+                                                                    this,
+                                                                    lstate,
+                                                                    mutation_list,
+                                                                    plog_files,
+                                                                    total_file_size,
+                                                                    last_committed_decree),
+                                                          0,
+                                                          std::chrono::seconds(1));
+        return;
+    }
+    auto release = defer([this]() { --_stub->_split_learn_concurrent_count; });
+
     ddebug_replica("start to learn states asynchronously, prepare_list last_committed_decree={}, "
                    "checkpoint decree range=({},{}], private log files count={}, in-memory "
                    "mutation count={}",
@@ -433,15 +543,42 @@ void replica::child_catch_up_states() // on child partition
                           local_decree,
                           goal_decree,
                           _prepare_list->min_decree());
+            std::vector<mutation_ptr> mutations;
             for (decree d = local_decree + 1; d <= goal_decree; ++d) {
                 auto mu = _prepare_list->get_mutation_by_decree(d);
                 dassert(mu != nullptr, "");
-                error_code ec = _app->apply_mutation(mu);
-                if (ec != ERR_OK) {
-                    child_handle_split_error("child_catchup failed because apply mutation failed");
-                    return;
-                }
+                mutations.emplace_back(std::move(mu));
             }
+            // apply them in THREAD_POOL_REPLICATION_LONG, rather than blocking the replication
+            // thread which is shared with other replicas, including other splitting children
+            _split_states.async_learn_task = tasking::enqueue(
+                LPC_PARTITION_SPLIT_ASYNC_LEARN, tracker(), [this, mutations, goal_decree]() {
+                    for (const mutation_ptr &mu : mutations) {
+                        error_code ec = _app->apply_mutation(mu);
+                        if (ec != ERR_OK) {
+                            derror_replica("child_catchup failed because apply mutation failed, "
+                                           "decree={}, error={}",
+                                           mu->get_decree(),
+                                           ec);
+                            child_handle_async_learn_error();
+                            return;
+                        }
+                    }
+                    _split_states.async_learn_task =
+                        tasking::enqueue(LPC_PARTITION_SPLIT,
+                                         tracker(),
+                                         [this, goal_decree]() {
+                                             if (_prepare_list->last_committed_decree() >
+                                                 goal_decree) {
+                                                 // more mutations committed during applying
+                                                 child_catch_up_states();
+                                             } else {
+                                                 child_finish_catch_up();
+                                             }
+                                         },
+                                         get_gpid().thread_hash());
+                });
+            return;
         } else {
             // some missing mutations have already in private log
             // should call `catch_up_with_private_logs` to catch up all missing mutations
@@ -462,10 +599,22 @@ void replica::child_catch_up_states() // on child partition
         }
     }
 
+    child_finish_catch_up();
+}
+
+// ThreadPool: THREAD_POOL_REPLICATION
+void replica::child_finish_catch_up() // on child partition
+{
+    if (status() != partition_status::PS_PARTITION_SPLIT) {
+        dwarn_replica("wrong status, status is {}", enum_to_string(status()));
+        return;
+    }
+
     ddebug_replica("child catch up parent states, goal decree={}, local decree={}",
                    _prepare_list->last_committed_decree(),
                    _app->last_committed_decree());
     _split_states.is_caught_up = true;
+    _split_states.async_learn_task = nullptr;
 
     child_notify_catch_up();
 }
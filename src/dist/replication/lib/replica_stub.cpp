@@ -35,6 +35,7 @@
 
 #include "replica.h"
 #include "replica_stub.h"
+#include "app_pool_router.h"
 #include "mutation_log.h"
 #include "mutation.h"
 #include "bulk_load/replica_bulk_loader.h"
@@ -42,18 +43,28 @@
 #include "dist/replication/lib/backup/replica_backup_manager.h"
 
 #include <dsn/cpp/json_helper.h>
+#include <nlohmann/json.hpp>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/process_utils.h>
 #include <dsn/utility/rand.h>
 #include <dsn/utility/string_conv.h>
 #include <dsn/tool-api/command_manager.h>
+#include <dsn/tool-api/file_io.h>
 #include <dsn/dist/replication/replication_app_base.h>
+#include <dsn/dist/replication/replica_envs.h>
+#include <dsn/dist/replication/client_batch.h>
 #include <vector>
 #include <deque>
 #include <dsn/dist/fmt_logging.h>
 #ifdef DSN_ENABLE_GPERF
 #include <gperftools/malloc_extension.h>
+#include <fstream>
+
+#include "http/pprof_http_service.h"
 #endif
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/defer.h>
+#include <dsn/utility/flags.h>
 #include <dsn/dist/remote_command.h>
 
 namespace dsn {
@@ -61,6 +72,134 @@ namespace replication {
 
 bool replica_stub::s_not_exit_on_log_failure = false;
 
+DSN_DEFINE_uint32("replication",
+                  config_sync_full_interval_count,
+                  10,
+                  "send all the stored replicas to the meta server every this count of config "
+                  "syncs, and only the changed replicas in the others to save network, "
+                  "1 means always sending all of them");
+DSN_DEFINE_uint32("replication",
+                  hotspot_report_top_n,
+                  3,
+                  "report at most this count of the hottest partitions on each config sync, to be "
+                  "shown by meta server and weighed by its balancer, 0 means none is reported");
+DSN_DEFINE_uint32("replication",
+                  hotspot_report_top_keys,
+                  3,
+                  "report at most this count of the hottest keys of each hot partition");
+DSN_DEFINE_uint32("replication",
+                  hotspot_min_qps,
+                  100,
+                  "a partition is not reported as hot unless its qps is at least this value");
+DSN_DEFINE_bool("replication",
+                replica_load_report_enabled,
+                true,
+                "whether to report the qps and write bytes of each replica serving any request on "
+                "config sync, which are weighed by the load-weighted balancer of meta server");
+DSN_DEFINE_bool("replication",
+                replica_manifest_enabled,
+                true,
+                "whether to keep the app infos of the replica dirs of each data dir in a "
+                "manifest, so that the replicas are loaded without reading their .app-info files "
+                "one by one on startup");
+DSN_DEFINE_uint32("replication",
+                  max_concurrent_replica_opens,
+                  8,
+                  "max count of the replicas opened concurrently on the proposals of the meta "
+                  "server and the group checks of the primaries, in which the new primaries are "
+                  "opened first, 0 means no limit");
+DSN_DEFINE_uint32("replication",
+                  max_concurrent_replica_opens_per_disk,
+                  2,
+                  "max count of the existing replicas opened concurrently on each disk, "
+                  "0 means no limit");
+DSN_DEFINE_uint32("replication",
+                  learn_app_max_concurrent_count_per_disk,
+                  2,
+                  "max count of the learners copying app checkpoints concurrently on each disk, "
+                  "0 means no limit");
+DSN_DEFINE_uint32("replication",
+                  close_replica_concurrency_per_disk,
+                  2,
+                  "count of the replicas closed concurrently on each disk when the replica "
+                  "server stops");
+DSN_DEFINE_uint64("replication",
+                  close_replica_checkpoint_min_log_tail,
+                  0,
+                  "checkpoint a replica when the replica server stops if more than this count of "
+                  "committed mutations are not durable, 0 means never");
+DSN_DEFINE_bool("replication",
+                log_shared_disabled,
+                false,
+                "disable the shared log, then mutations are only written into the private logs, "
+                "whose fsyncs are batched across the private logs on the same disk");
+DSN_DEFINE_uint32("replication",
+                  group_check_batch_window_ms,
+                  0,
+                  "send the group checks from the primaries on this node to the same node within "
+                  "the window in one RPC_GROUP_CHECK_BATCH, 0 means disabled; it should be enabled "
+                  "only after all the replica servers support RPC_GROUP_CHECK_BATCH");
+DSN_DEFINE_string("replication",
+                  app_pool_groups,
+                  "",
+                  "isolate the apps in THREAD_POOL_REPLICATION by dividing its queues into groups "
+                  "by weights, in the format of \"<group>:<weight>,...\"; an app is assigned to "
+                  "a group by the app env replica.pool_group, and the others are in the group "
+                  "\"default\" which is of weight 1 if not specified; it takes effect on the "
+                  "replicas loaded when the replica server starts, empty means disabled");
+DSN_DEFINE_uint32("replication",
+                  mem_release_low_watermark_percent,
+                  70,
+                  "when the rss is below this percentage of the memory limit, tcmalloc keeps up "
+                  "to mem_release_max_reserved_mem_percentage of the allocated memory as free; "
+                  "above it, the kept free memory shrinks linearly to 0 at "
+                  "mem_release_high_watermark_percent");
+DSN_DEFINE_uint32("replication",
+                  mem_release_high_watermark_percent,
+                  90,
+                  "when the rss reaches this percentage of the memory limit, all the free memory "
+                  "of tcmalloc is released");
+DSN_DEFINE_uint64("replication",
+                  mem_release_memory_limit_mb,
+                  0,
+                  "the memory limit of this process for the memory release, 0 means the limit of "
+                  "its cgroup; the fixed mem_release_max_reserved_mem_percentage is used if there "
+                  "is no limit");
+DSN_DEFINE_uint64("replication",
+                  mem_release_max_mb_per_check,
+                  512,
+                  "max memory released to the system in one check of "
+                  "mem_release_check_interval_ms, to avoid locking the page heap of tcmalloc for "
+                  "long; 0 means no limit");
+DSN_DEFINE_uint32("replication",
+                  heap_profile_pressure_percent,
+                  0,
+                  "dump the sampled heap profile into heap_profile_dir when the rss reaches this "
+                  "percentage of the memory limit, 0 means disabled");
+DSN_DEFINE_uint32("replication",
+                  heap_profile_min_interval_seconds,
+                  3600,
+                  "min interval between two heap profiles dumped by heap_profile_pressure_percent");
+DSN_DEFINE_string("replication",
+                  heap_profile_dir,
+                  "heap_profile",
+                  "the dir to dump the heap profiles by heap_profile_pressure_percent");
+DSN_DEFINE_validator(mem_release_high_watermark_percent, [](uint32_t value) -> bool {
+    return value > 0 && value <= 100;
+});
+DSN_DEFINE_uint32("replication",
+                  memory_stat_interval_ms,
+                  10000,
+                  "interval to update the memory counters of the mutations, messages, log "
+                  "buffers and prepare lists on this node, 0 means disabled");
+DSN_DEFINE_uint64("replication",
+                  memory_budget_mb,
+                  0,
+                  "budget of the approximate memory pinned by the mutations, messages and log "
+                  "buffers on this node, the client writes are delayed in proportion to its usage "
+                  "as write_backpressure_* configured, and rejected with ERR_BUSY beyond it; 0 "
+                  "means no budget");
+
 replica_stub::replica_stub(replica_state_subscriber subscriber /*= nullptr*/,
                            bool is_long_subscriber /* = true*/)
     : serverlet("replica_stub"),
@@ -69,10 +208,12 @@ replica_stub::replica_stub(replica_state_subscriber subscriber /*= nullptr*/,
       _verbose_client_log_command(nullptr),
       _verbose_commit_log_command(nullptr),
       _trigger_chkpt_command(nullptr),
+      _migrate_disk_command(nullptr),
       _query_compact_command(nullptr),
       _query_app_envs_command(nullptr),
       _useless_dir_reserve_seconds_command(nullptr),
       _max_concurrent_bulk_load_downloading_count_command(nullptr),
+      _query_learn_scheduler_command(nullptr),
       _deny_client(false),
       _verbose_client_log(false),
       _verbose_commit_log(false),
@@ -81,7 +222,7 @@ replica_stub::replica_stub(replica_state_subscriber subscriber /*= nullptr*/,
       _release_tcmalloc_memory(false),
       _mem_release_max_reserved_mem_percentage(10),
       _max_concurrent_bulk_load_downloading_count(5),
-      _learn_app_concurrent_count(0),
+      _split_learn_concurrent_count(0),
       _fs_manager(false),
       _bulk_load_downloading_count(0)
 {
@@ -89,11 +230,20 @@ replica_stub::replica_stub(replica_state_subscriber subscriber /*= nullptr*/,
     _release_tcmalloc_memory_command = nullptr;
     _max_reserved_memory_percentage_command = nullptr;
 #endif
+    _open_scheduler = dsn::make_unique<replica_open_scheduler>(
+        FLAGS_max_concurrent_replica_opens, FLAGS_max_concurrent_replica_opens_per_disk);
+    _learn_scheduler = dsn::make_unique<learn_scheduler>(
+        std::max(0, _options.learn_app_max_concurrent_count),
+        FLAGS_learn_app_max_concurrent_count_per_disk);
     _replica_state_subscriber = subscriber;
     _is_long_subscriber = is_long_subscriber;
     _failure_detector = nullptr;
     _state = NS_Disconnected;
+    _config_sync_version = 0;
+    _acked_config_sync_version = 0;
+    _config_sync_rounds_since_full = 0;
     _log = nullptr;
+    _log_shared_disabled = false;
     _primary_address_str[0] = '\0';
     install_perf_counters();
 
@@ -109,6 +259,24 @@ replica_stub::~replica_stub(void) { close(); }
 
 void replica_stub::install_perf_counters()
 {
+    _counter_memory_mutation_bytes.init_app_counter("eon.replica_stub",
+                                                    "memory.mutation(bytes)",
+                                                    COUNTER_TYPE_NUMBER,
+                                                    "approximate bytes of the alive mutations");
+    _counter_memory_message_bytes.init_app_counter("eon.replica_stub",
+                                                   "memory.message(bytes)",
+                                                   COUNTER_TYPE_NUMBER,
+                                                   "approximate body bytes of the alive messages");
+    _counter_memory_log_buffer_bytes.init_app_counter(
+        "eon.replica_stub",
+        "memory.log_buffer(bytes)",
+        COUNTER_TYPE_NUMBER,
+        "bytes of the log buffers pending or being written");
+    _counter_memory_prepare_list_bytes.init_app_counter(
+        "eon.replica_stub",
+        "memory.prepare_list(bytes)",
+        COUNTER_TYPE_NUMBER,
+        "approximate bytes of the mutations in the prepare lists of all the replicas");
     _counter_replicas_count.init_app_counter(
         "eon.replica_stub", "replica(Count)", COUNTER_TYPE_NUMBER, "# in replica_stub._replicas");
     _counter_replicas_opening_count.init_app_counter("eon.replica_stub",
@@ -137,6 +305,16 @@ void replica_stub::install_perf_counters()
         "replicas.learning.max.copy.file.size",
         COUNTER_TYPE_NUMBER,
         "current learning max copy file size");
+    _counter_replicas_learning_app_running_count.init_app_counter(
+        "eon.replica_stub",
+        "replicas.learning.app.running.count",
+        COUNTER_TYPE_NUMBER,
+        "current count of the learners copying app checkpoints");
+    _counter_replicas_learning_app_queued_count.init_app_counter(
+        "eon.replica_stub",
+        "replicas.learning.app.queued.count",
+        COUNTER_TYPE_NUMBER,
+        "current count of the learners waiting to copy app checkpoints");
     _counter_replicas_learning_recent_start_count.init_app_counter(
         "eon.replica_stub",
         "replicas.learning.recent.start.count",
@@ -229,6 +407,16 @@ void replica_stub::install_perf_counters()
         "replicas.recent.group.check.fail.count",
         COUNTER_TYPE_VOLATILE_NUMBER,
         "group check fail count in the recent period");
+    _counter_replicas_recent_read_lease_hit_count.init_app_counter(
+        "eon.replica_stub",
+        "replicas.recent.read.lease.hit.count",
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        "count of reads served by primaries within the read lease in the recent period");
+    _counter_replicas_recent_read_lease_miss_count.init_app_counter(
+        "eon.replica_stub",
+        "replicas.recent.read.lease.miss.count",
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        "count of reads rejected by primaries as the read lease expired in the recent period");
 
     _counter_shared_log_size.init_app_counter(
         "eon.replica_stub", "shared.log.size(MB)", COUNTER_TYPE_NUMBER, "shared log size(MB)");
@@ -237,6 +425,29 @@ void replica_stub::install_perf_counters()
         "shared.log.recent.write.size",
         COUNTER_TYPE_VOLATILE_NUMBER,
         "shared log write size in the recent period");
+    _counter_shared_log_batch_size.init_app_counter("eon.replica_stub",
+                                                    "shared.log.batch.size",
+                                                    COUNTER_TYPE_NUMBER_PERCENTILES,
+                                                    "bytes of each shared log write batch");
+    _counter_shared_log_batch_mutation_count.init_app_counter(
+        "eon.replica_stub",
+        "shared.log.batch.mutation.count",
+        COUNTER_TYPE_NUMBER_PERCENTILES,
+        "mutation count of each shared log write batch");
+    _counter_shared_log_batch_queueing_delay.init_app_counter(
+        "eon.replica_stub",
+        "shared.log.batch.queueing.delay(us)",
+        COUNTER_TYPE_NUMBER_PERCENTILES,
+        "time(us) from the first mutation appended to the batch written");
+    _counter_replica_open_queueing_delay.init_app_counter(
+        "eon.replica_stub",
+        "replica.open.queueing.delay(ms)",
+        COUNTER_TYPE_NUMBER_PERCENTILES,
+        "time(ms) from a replica open requested to started");
+    _counter_replica_open_latency.init_app_counter("eon.replica_stub",
+                                                   "replica.open.latency(ms)",
+                                                   COUNTER_TYPE_NUMBER_PERCENTILES,
+                                                   "time(ms) to open a replica");
     _counter_recent_trigger_emergency_checkpoint_count.init_app_counter(
         "eon.replica_stub",
         "recent.trigger.emergency.checkpoint.count",
@@ -340,6 +551,15 @@ void replica_stub::install_perf_counters()
                                                            "tcmalloc.release.memory.size",
                                                            COUNTER_TYPE_NUMBER,
                                                            "current tcmalloc release memory size");
+    _counter_tcmalloc_release_duration_us.init_app_counter(
+        "eon.replica_stub",
+        "tcmalloc.release.duration(us)",
+        COUNTER_TYPE_NUMBER,
+        "time spent by the last tcmalloc memory release");
+    _counter_memory_pressure_percent.init_app_counter("eon.replica_stub",
+                                                      "memory.pressure(percent)",
+                                                      COUNTER_TYPE_NUMBER,
+                                                      "rss in percentage of the memory limit");
 #endif
 }
 
@@ -368,12 +588,16 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
     _deny_client = _options.deny_client_on_start;
     _verbose_client_log = _options.verbose_client_log_on_start;
     _verbose_commit_log = _options.verbose_commit_log_on_start;
+    _log_shared_disabled = FLAGS_log_shared_disabled;
     _gc_disk_error_replica_interval_seconds = _options.gc_disk_error_replica_interval_seconds;
     _gc_disk_garbage_replica_interval_seconds = _options.gc_disk_garbage_replica_interval_seconds;
     _release_tcmalloc_memory = _options.mem_release_enabled;
     _mem_release_max_reserved_mem_percentage = _options.mem_release_max_reserved_mem_percentage;
     _max_concurrent_bulk_load_downloading_count =
         _options.max_concurrent_bulk_load_downloading_count;
+    _learn_scheduler = dsn::make_unique<learn_scheduler>(
+        std::max(0, _options.learn_app_max_concurrent_count),
+        FLAGS_learn_app_max_concurrent_count_per_disk);
 
     // clear dirs if need
     if (clear) {
@@ -415,11 +639,19 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
         err = _fs_manager.initialize(_options.data_dirs, _options.data_dir_tags, false);
         dassert(err == dsn::ERR_OK, "initialize fs manager failed, err(%s)", err.to_string());
     }
+    // the aio latencies of the disks are counted for the fail-slow detection, see
+    // [core] aio_per_disk_enabled for the aio providers of the disks
+    for (const auto &dir_node : _fs_manager._dir_nodes) {
+        file::register_disk(dir_node->tag, dir_node->full_dir);
+    }
 
     _log = new mutation_log_shared(_options.slog_dir,
                                    _options.log_shared_file_size_mb,
                                    _options.log_shared_force_flush,
-                                   &_counter_shared_log_recent_write_size);
+                                   &_counter_shared_log_recent_write_size,
+                                   &_counter_shared_log_batch_size,
+                                   &_counter_shared_log_batch_mutation_count,
+                                   &_counter_shared_log_batch_queueing_delay);
     ddebug("slog_dir = %s", _options.slog_dir.c_str());
 
     // init rps
@@ -432,10 +664,18 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
             dassert(false, "Fail to get subdirectories in %s.", dir.c_str());
         }
         dir_list.insert(dir_list.end(), tmp_list.begin(), tmp_list.end());
+
+        if (FLAGS_replica_manifest_enabled) {
+            auto manifest = dsn::make_unique<replica_manifest>(dir);
+            manifest->load();
+            _replica_manifests[dir] = std::move(manifest);
+        }
     }
 
     replicas rps;
     utils::ex_lock rps_lock;
+    // the replica dirs loaded by the app infos in the manifests
+    std::vector<std::string> manifest_dirs;
     std::deque<task_ptr> load_tasks;
     uint64_t start_time = dsn_now_ms();
     for (auto &dir : dir_list) {
@@ -449,10 +689,14 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
         load_tasks.push_back(tasking::create_task(
             LPC_REPLICATION_INIT_LOAD,
             &_tracker,
-            [this, dir, &rps, &rps_lock] {
+            [this, dir, &rps, &rps_lock, &manifest_dirs] {
                 ddebug("process dir %s", dir.c_str());
 
-                auto r = replica::load(this, dir.c_str());
+                app_info cached_info;
+                replica_manifest *manifest = get_replica_manifest(dir);
+                bool cached = manifest != nullptr &&
+                              manifest->get(utils::filesystem::get_file_name(dir), cached_info);
+                auto r = replica::load(this, dir.c_str(), cached ? &cached_info : nullptr);
                 if (r != nullptr) {
                     ddebug("%s@%s: load replica '%s' success, <durable, commit> = <%" PRId64
                            ", %" PRId64 ">, last_prepared_decree = %" PRId64,
@@ -473,6 +717,9 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
                     }
 
                     rps[r->get_gpid()] = r;
+                    if (cached) {
+                        manifest_dirs.push_back(dir);
+                    }
                 }
             },
             load_tasks.size()));
@@ -485,10 +732,40 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
 
     dir_list.clear();
     load_tasks.clear();
-    ddebug("load replicas succeed, replica_count = %d, time_used = %" PRIu64 " ms",
+    ddebug("load replicas succeed, replica_count = %d, loaded_by_manifest_count = %d, "
+           "time_used = %" PRIu64 " ms",
            static_cast<int>(rps.size()),
+           static_cast<int>(manifest_dirs.size()),
            finish_time - start_time);
 
+    // compact the manifests into the loaded replicas, and verify the app infos used lazily
+    if (!_replica_manifests.empty()) {
+        std::map<std::string, std::map<std::string, app_info>> entries;
+        for (const auto &kv : _replica_manifests) {
+            entries[kv.first];
+        }
+        for (const auto &kv : rps) {
+            const std::string &dir = kv.second->dir();
+            auto it = entries.find(utils::filesystem::remove_file_name(dir));
+            if (it != entries.end()) {
+                app_info &info = it->second[utils::filesystem::get_file_name(dir)];
+                info = *kv.second->get_app_info();
+                info.envs.clear();
+            }
+        }
+        for (auto &kv : entries) {
+            _replica_manifests[kv.first]->reset(std::move(kv.second));
+        }
+
+        if (!manifest_dirs.empty()) {
+            tasking::enqueue(LPC_REPLICATION_LONG_LOW, &_tracker, [this, manifest_dirs]() {
+                verify_replica_manifests(manifest_dirs);
+            });
+        }
+    }
+
+    install_app_pool_router(rps);
+
     // init shared prepare log
     ddebug("start to replay shared log");
 
@@ -549,7 +826,10 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
         _log = new mutation_log_shared(_options.slog_dir,
                                        _options.log_shared_file_size_mb,
                                        _options.log_shared_force_flush,
-                                       &_counter_shared_log_recent_write_size);
+                                       &_counter_shared_log_recent_write_size,
+                                       &_counter_shared_log_batch_size,
+                                       &_counter_shared_log_batch_mutation_count,
+                                       &_counter_shared_log_batch_queueing_delay);
         auto lerr = _log->open(nullptr, [this](error_code err) { this->handle_log_failure(err); });
         dassert(lerr == ERR_OK, "restart log service must succeed");
     }
@@ -633,6 +913,14 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
             std::chrono::milliseconds(rand::next_u32(0, _options.gc_interval_ms)));
     }
 
+    if (FLAGS_memory_stat_interval_ms > 0) {
+        _memory_stat_timer_task =
+            tasking::enqueue_timer(LPC_MEMORY_STAT,
+                                   &_tracker,
+                                   [this]() { on_memory_stat(); },
+                                   std::chrono::milliseconds(FLAGS_memory_stat_interval_ms));
+    }
+
     // disk stat
     if (false == _options.disk_stat_disabled) {
         _disk_stat_timer_task = ::dsn::tasking::enqueue_timer(
@@ -642,10 +930,12 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
             std::chrono::seconds(_options.disk_stat_interval_seconds),
             0,
             std::chrono::seconds(_options.disk_stat_interval_seconds));
+        start_disk_balance();
     }
 
     // attach rps
     _replicas = std::move(rps);
+    update_replica_routes();
     _counter_replicas_count->add((uint64_t)_replicas.size());
     for (const auto &kv : _replicas) {
         _fs_manager.add_replica(kv.first, kv.second->dir());
@@ -676,6 +966,42 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
     }
 }
 
+void replica_stub::install_app_pool_router(const replicas &rps)
+{
+    if (strlen(FLAGS_app_pool_groups) == 0) {
+        return;
+    }
+
+    // kept for the lifetime of the process, as the pool may route with it at any time
+    static app_pool_router *router = nullptr;
+    if (router != nullptr) {
+        dwarn("the app pool router has been installed");
+        return;
+    }
+
+    std::map<std::string, uint32_t> groups;
+    if (!app_pool_router::parse_groups(FLAGS_app_pool_groups, groups)) {
+        derror("invalid app_pool_groups \"%s\", the apps are not isolated", FLAGS_app_pool_groups);
+        return;
+    }
+
+    std::map<int32_t, std::string> app_groups;
+    for (const auto &kv : rps) {
+        const std::map<std::string, std::string> &envs = kv.second->get_app_info()->envs;
+        auto it = envs.find(replica_envs::POOL_GROUP);
+        if (it != envs.end()) {
+            app_groups[kv.first.get_app_id()] = it->second;
+        }
+    }
+
+    router = new app_pool_router(std::move(groups), app_groups);
+    if (dsn_threadpool_set_queue_router(THREAD_POOL_REPLICATION, router)) {
+        ddebug("isolate %d apps in THREAD_POOL_REPLICATION by app_pool_groups \"%s\"",
+               static_cast<int>(app_groups.size()),
+               FLAGS_app_pool_groups);
+    }
+}
+
 void replica_stub::initialize_start()
 {
     // start timer for configuration sync
@@ -713,7 +1039,8 @@ void replica_stub::initialize_start()
         _failure_detector = new ::dsn::dist::slave_failure_detector_with_multimaster(
             _options.meta_servers,
             [this]() { this->on_meta_server_disconnected(); },
-            [this]() { this->on_meta_server_connected(); });
+            [this]() { this->on_meta_server_connected(); },
+            [this]() { this->on_meta_server_switched(); });
 
         auto err = _failure_detector->start(_options.fd_check_interval_seconds,
                                             _options.fd_beacon_interval_seconds,
@@ -757,12 +1084,41 @@ dsn::error_code replica_stub::on_kill_replica(gpid id)
 
 replica_ptr replica_stub::get_replica(gpid id)
 {
-    zauto_read_lock l(_replicas_lock);
-    auto it = _replicas.find(id);
-    if (it != _replicas.end())
-        return it->second;
-    else
+    std::shared_ptr<const replica_routes> routes = std::atomic_load(&_replica_routes);
+    if (routes == nullptr) {
+        return nullptr;
+    }
+    auto it = routes->find(id.get_app_id());
+    if (it == routes->end() || id.get_partition_index() < 0 ||
+        id.get_partition_index() >= (int)it->second.size()) {
         return nullptr;
+    }
+    return it->second[id.get_partition_index()];
+}
+
+void replica_stub::update_replica_routes()
+{
+    auto routes = std::make_shared<replica_routes>();
+    for (const auto &kv : _replicas) {
+        std::vector<replica_ptr> &parts = (*routes)[kv.first.get_app_id()];
+        if (kv.first.get_partition_index() >= (int)parts.size()) {
+            parts.resize(kv.first.get_partition_index() + 1);
+        }
+        parts[kv.first.get_partition_index()] = kv.second;
+    }
+    std::atomic_store(&_replica_routes, std::shared_ptr<const replica_routes>(std::move(routes)));
+}
+
+uint64_t replica_stub::get_meta_lease_expire_ms() const
+{
+    if (_options.fd_disabled) {
+        return UINT64_MAX;
+    }
+    if (_failure_detector == nullptr) {
+        return 0;
+    }
+    return _failure_detector->get_master_lease_expire_ms(
+        _failure_detector->current_server_contact());
 }
 
 replica_stub::replica_life_cycle replica_stub::get_replica_life_cycle(gpid id)
@@ -856,6 +1212,33 @@ void replica_stub::on_config_proposal(const configuration_update_request &propos
     }
 }
 
+void replica_stub::on_config_proposal_batch(dsn::message_ex *request)
+{
+    std::vector<configuration_update_request> proposals;
+    read_config_proposal_batch(request, proposals);
+
+    error_code err = ERR_OK;
+    if (!is_connected()) {
+        dwarn("%s: received %d config proposals: not connected, ignore",
+              _primary_address_str,
+              (int)proposals.size());
+        err = ERR_INVALID_STATE;
+    } else {
+        ddebug("%s: received %d config proposals", _primary_address_str, (int)proposals.size());
+        // each proposal is handled in the thread of its replica, as RPC_CONFIG_PROPOSAL is
+        for (configuration_update_request &proposal : proposals) {
+            int thread_hash = proposal.config.pid.thread_hash();
+            tasking::enqueue(LPC_CONFIG_PROPOSAL_DISPATCH,
+                             &_tracker,
+                             [ this, proposal = std::move(proposal) ]() {
+                                 on_config_proposal(proposal);
+                             },
+                             thread_hash);
+        }
+    }
+    reply(request, err);
+}
+
 void replica_stub::on_query_decree(query_replica_decree_rpc rpc)
 {
     const query_replica_decree_request &req = rpc.request();
@@ -1061,17 +1444,166 @@ void replica_stub::on_prepare(dsn::message_ex *request)
     }
 }
 
+void replica_stub::on_prepare_batch(dsn::message_ex *request)
+{
+    gpid id;
+    dsn::unmarshall(request, id);
+    replica_ptr rep = get_replica(id);
+    if (rep != nullptr) {
+        rep->on_prepare_batch(request);
+    } else {
+        prepare_ack resp;
+        resp.pid = id;
+        resp.err = ERR_OBJECT_NOT_FOUND;
+        resp.decree = invalid_decree;
+        reply(request, resp);
+    }
+}
+
 void replica_stub::on_group_check(group_check_rpc rpc)
 {
     const group_check_request &request = rpc.request();
-    group_check_response &response = rpc.response();
     if (!is_connected()) {
         dwarn("%s@%s: received group check: not connected, ignore",
               request.config.pid.to_string(),
               _primary_address_str);
         return;
     }
+    handle_group_check(request, rpc.response());
+}
+
+// the responses of an RPC_GROUP_CHECK_BATCH, which is replied once all of them are filled
+struct group_check_batch_reply
+{
+    group_check_batch_reply(dsn::message_ex *req, int count)
+        : request(req), responses(count), left_count(count)
+    {
+        request->add_ref(); // released on dctor
+    }
+    ~group_check_batch_reply() { request->release_ref(); }
+
+    void reply()
+    {
+        dsn::message_ex *response = request->create_response();
+        write_group_check_batch(response, responses);
+        dsn_rpc_reply(response);
+    }
+
+    dsn::message_ex *request;
+    std::vector<group_check_response> responses;
+    std::atomic<int> left_count;
+};
+
+void replica_stub::on_group_check_batch(dsn::message_ex *request)
+{
+    std::vector<group_check_request> requests;
+    read_group_check_batch(request, requests);
+    if (!is_connected()) {
+        dwarn("%s: received %d group checks: not connected, ignore",
+              _primary_address_str,
+              (int)requests.size());
+        return;
+    }
+
+    auto batch = std::make_shared<group_check_batch_reply>(request, (int)requests.size());
+    if (requests.empty()) {
+        batch->reply();
+        return;
+    }
+    // each group check is handled in the thread of its replica, as RPC_GROUP_CHECK is
+    for (int i = 0; i < (int)requests.size(); ++i) {
+        int thread_hash = requests[i].config.pid.thread_hash();
+        tasking::enqueue(LPC_GROUP_CHECK_DISPATCH,
+                         &_tracker,
+                         [ this, batch, i, req = std::move(requests[i]) ]() {
+                             handle_group_check(req, batch->responses[i]);
+                             if (--batch->left_count == 0) {
+                                 batch->reply();
+                             }
+                         },
+                         thread_hash);
+    }
+}
+
+// the results of an RPC_CLIENT_BATCH, which is replied once all of them are filled
+struct client_batch_reply
+{
+    client_batch_reply(dsn::message_ex *req, int count)
+        : request(req), results(count), left_count(count)
+    {
+        request->add_ref(); // released on dctor
+    }
+    ~client_batch_reply() { request->release_ref(); }
+
+    void reply()
+    {
+        dsn::message_ex *response = request->create_response();
+        write_client_batch(response, results);
+        dsn_rpc_reply(response);
+    }
+
+    dsn::message_ex *request;
+    std::vector<client_batch_result> results;
+    std::atomic<int> left_count;
+};
+
+void replica_stub::on_client_batch(dsn::message_ex *request)
+{
+    std::vector<dsn::message_ex *> requests;
+    read_client_batch(request, requests);
+    if (_deny_client) {
+        // ignore and do not reply
+        for (dsn::message_ex *sub : requests) {
+            sub->add_ref();
+            sub->release_ref();
+        }
+        return;
+    }
 
+    auto batch = std::make_shared<client_batch_reply>(request, (int)requests.size());
+    if (requests.empty()) {
+        batch->reply();
+        return;
+    }
+    // each request is called to this replica server as a new one, so it's dispatched to its
+    // replica and replied just as it's sent alone
+    for (int i = 0; i < (int)requests.size(); ++i) {
+        dsn::message_ex *sub = requests[i];
+        dsn::message_ex *call = sub->copy_and_prepare_send(false);
+        call->hdr_format = NET_HDR_DSN;
+        call->header->id = dsn::message_ex::new_id();
+        sub->add_ref();
+        sub->release_ref();
+
+        if (call->rpc_code() == TASK_CODE_INVALID) {
+            derror_f("{}: unknown rpc {} in client batch",
+                     _primary_address_str,
+                     call->header->rpc_name);
+            call->add_ref();
+            call->release_ref();
+            batch->results[i].err = ERR_HANDLER_NOT_FOUND;
+            if (--batch->left_count == 0) {
+                batch->reply();
+            }
+            continue;
+        }
+        rpc_response_task_ptr t = rpc::create_rpc_response_task(
+            call,
+            &_tracker,
+            [batch, i](dsn::error_code err, dsn::message_ex *req, dsn::message_ex *resp) {
+                batch->results[i].err = err;
+                batch->results[i].reply = resp;
+                if (--batch->left_count == 0) {
+                    batch->reply();
+                }
+            });
+        dsn_rpc_call(primary_address(), t.get());
+    }
+}
+
+void replica_stub::handle_group_check(const group_check_request &request,
+                                      /*out*/ group_check_response &response)
+{
     ddebug("%s@%s: received group check, primary = %s, ballot = %" PRId64
            ", status = %s, last_committed_decree = %" PRId64,
            request.config.pid.to_string(),
@@ -1098,6 +1630,93 @@ void replica_stub::on_group_check(group_check_rpc rpc)
     }
 }
 
+task_ptr replica_stub::send_group_check_in_batch(
+    rpc_address target,
+    const std::shared_ptr<group_check_request> &request,
+    task_tracker *tracker,
+    std::function<void(error_code, group_check_response &&)> &&callback,
+    int thread_hash)
+{
+    auto result = std::make_shared<std::pair<error_code, group_check_response>>();
+    task_ptr callback_task =
+        tasking::create_task(LPC_GROUP_CHECK_REPLY,
+                             tracker,
+                             [ result, cb = std::move(callback) ]() {
+                                 cb(result->first, std::move(result->second));
+                             },
+                             thread_hash);
+
+    bool first = false;
+    {
+        zauto_lock l(_group_check_batches_lock);
+        std::vector<pending_group_check> &batch = _group_check_batches[target];
+        batch.push_back({request, result, callback_task});
+        first = (batch.size() == 1);
+    }
+    if (first) {
+        tasking::enqueue(LPC_GROUP_CHECK,
+                         &_tracker,
+                         [this, target]() { flush_group_check_batch(target); },
+                         0,
+                         std::chrono::milliseconds(FLAGS_group_check_batch_window_ms));
+    }
+    return callback_task;
+}
+
+void replica_stub::flush_group_check_batch(rpc_address target)
+{
+    auto batch = std::make_shared<std::vector<pending_group_check>>();
+    {
+        zauto_lock l(_group_check_batches_lock);
+        auto iter = _group_check_batches.find(target);
+        if (iter == _group_check_batches.end()) {
+            return;
+        }
+        *batch = std::move(iter->second);
+        _group_check_batches.erase(iter);
+    }
+
+    std::vector<group_check_request> requests;
+    requests.reserve(batch->size());
+    for (const pending_group_check &check : *batch) {
+        requests.push_back(*check.request);
+    }
+    dinfo("%s: send %d group checks to %s in batch",
+          _primary_address_str,
+          (int)requests.size(),
+          target.to_string());
+
+    dsn::message_ex *msg = dsn::message_ex::create_request(RPC_GROUP_CHECK_BATCH);
+    write_group_check_batch(msg, requests);
+    rpc_response_task_ptr t = rpc::create_rpc_response_task(
+        msg,
+        &_tracker,
+        [batch, target](error_code err, dsn::message_ex *req, dsn::message_ex *resp) {
+            std::vector<group_check_response> responses;
+            if (err == ERR_OK) {
+                read_group_check_batch(resp, responses);
+                if (responses.size() != batch->size()) {
+                    derror("got %d group check responses from %s, but %d are sent",
+                           (int)responses.size(),
+                           target.to_string(),
+                           (int)batch->size());
+                    err = ERR_INVALID_DATA;
+                }
+            }
+            // dispatch the results to the threads of the replicas, the cancelled ones are
+            // skipped by the tasks themselves
+            for (size_t i = 0; i < batch->size(); ++i) {
+                pending_group_check &check = (*batch)[i];
+                check.result->first = err;
+                if (err == ERR_OK) {
+                    check.result->second = std::move(responses[i]);
+                }
+                check.callback_task->enqueue();
+            }
+        });
+    dsn_rpc_call(target, t.get());
+}
+
 void replica_stub::on_learn(dsn::message_ex *msg)
 {
     learn_request request;
@@ -1140,6 +1759,18 @@ void replica_stub::on_learn_completion_notification(learn_completion_notificatio
     }
 }
 
+void replica_stub::on_commit_notify(const group_check_request &request)
+{
+    if (!is_connected()) {
+        return;
+    }
+
+    replica_ptr rep = get_replica(request.config.pid);
+    if (rep != nullptr) {
+        rep->on_commit_notify(request);
+    }
+}
+
 void replica_stub::on_add_learner(const group_check_request &request)
 {
     if (!is_connected()) {
@@ -1186,6 +1817,7 @@ void replica_stub::get_replica_info(replica_info &info, replica_ptr r)
     info.last_committed_decree = r->last_committed_decree();
     info.last_prepared_decree = r->last_prepared_decree();
     info.last_durable_decree = r->last_durable_decree();
+    info.__set_checkpoint_size_mb(r->get_checkpoint_size_mb());
 
     dsn::error_code err = _fs_manager.get_disk_tag(r->dir(), info.disk_tag);
     if (dsn::ERR_OK != err) {
@@ -1233,14 +1865,16 @@ void replica_stub::query_configuration_by_node()
     configuration_query_by_node_request req;
     req.node = _primary_address;
 
-    // TODO: send stored replicas may cost network, we shouldn't config the frequency
-    get_local_replicas(req.stored_replicas);
-    req.__isset.stored_replicas = true;
+    fill_config_sync_request(req);
 
     ::dsn::marshall(msg, req);
 
-    ddebug("send query node partitions request to meta server, stored_replicas_count = %d",
-           (int)req.stored_replicas.size());
+    ddebug("send query node partitions request to meta server, stored_replicas_count = %d, "
+           "removed_replicas_count = %d, sync_version = %" PRId64 ", base_version = %" PRId64,
+           (int)req.stored_replicas.size(),
+           (int)req.removed_replicas.size(),
+           req.sync_version,
+           req.base_version);
 
     rpc_address target(_failure_detector->get_servers());
     _config_query_task =
@@ -1252,6 +1886,87 @@ void replica_stub::query_configuration_by_node()
                   });
 }
 
+void replica_stub::fill_config_sync_request(configuration_query_by_node_request &req)
+{
+    fill_replica_loads(req);
+    // the replicas on the fail-slow disks are moved off the node by meta server
+    std::vector<std::string> slow_disks = _fs_manager.get_slow_disks();
+    if (!slow_disks.empty()) {
+        req.__set_slow_disks(slow_disks);
+    }
+
+    std::vector<replica_info> local_replicas;
+    get_local_replicas(local_replicas);
+    _sending_stored_replicas.clear();
+    for (replica_info &info : local_replicas) {
+        gpid pid = info.pid;
+        _sending_stored_replicas.emplace(pid, std::move(info));
+    }
+
+    req.__set_sync_version(++_config_sync_version);
+    req.__isset.stored_replicas = true;
+    if (_acked_config_sync_version == 0 ||
+        ++_config_sync_rounds_since_full >= FLAGS_config_sync_full_interval_count) {
+        // the decrees of the replicas are refreshed by the full syncs
+        _config_sync_rounds_since_full = 0;
+        req.stored_replicas.reserve(_sending_stored_replicas.size());
+        for (const auto &kv : _sending_stored_replicas) {
+            req.stored_replicas.push_back(kv.second);
+        }
+        return;
+    }
+
+    req.__set_base_version(_acked_config_sync_version);
+    req.__isset.removed_replicas = true;
+    for (const auto &kv : _sending_stored_replicas) {
+        auto it = _acked_stored_replicas.find(kv.first);
+        if (it == _acked_stored_replicas.end() || it->second.status != kv.second.status ||
+            it->second.ballot != kv.second.ballot ||
+            it->second.checkpoint_size_mb != kv.second.checkpoint_size_mb) {
+            req.stored_replicas.push_back(kv.second);
+        }
+    }
+    for (const auto &kv : _acked_stored_replicas) {
+        if (_sending_stored_replicas.find(kv.first) == _sending_stored_replicas.end()) {
+            req.removed_replicas.push_back(kv.first);
+        }
+    }
+}
+
+void replica_stub::fill_replica_loads(configuration_query_by_node_request &req)
+{
+    if (FLAGS_hotspot_report_top_n == 0 && !FLAGS_replica_load_report_enabled) {
+        return;
+    }
+
+    std::vector<partition_hotspot> loads;
+    {
+        zauto_read_lock l(_replicas_lock);
+        loads.reserve(_replicas.size());
+        for (const auto &kv : _replicas) {
+            loads.push_back(
+                kv.second->_hotspot_detector.collect(kv.first, FLAGS_hotspot_report_top_keys));
+        }
+    }
+
+    if (FLAGS_replica_load_report_enabled) {
+        req.__isset.replica_loads = true;
+        for (const partition_hotspot &load : loads) {
+            if (load.read_qps + load.write_qps > 0) {
+                replica_load rl;
+                rl.pid = load.pid;
+                rl.qps = load.read_qps + load.write_qps;
+                rl.write_bytes_per_sec = load.write_bytes_per_sec;
+                req.replica_loads.push_back(std::move(rl));
+            }
+        }
+    }
+    if (FLAGS_hotspot_report_top_n > 0) {
+        req.__set_hot_partitions(pick_hot_partitions(
+            std::move(loads), FLAGS_hotspot_report_top_n, FLAGS_hotspot_min_qps));
+    }
+}
+
 void replica_stub::on_meta_server_connected()
 {
     ddebug("meta server connected");
@@ -1266,6 +1981,31 @@ void replica_stub::on_meta_server_connected()
     }
 }
 
+void replica_stub::on_meta_server_switched()
+{
+    ddebug("meta server switched");
+
+    zauto_lock l(_state_lock);
+    if (_state == NS_Disconnected) {
+        // the config sync is resumed once connected
+        return;
+    }
+
+    // the new leader may have no config sync acked before
+    _acked_config_sync_version = 0;
+    _acked_stored_replicas.clear();
+
+    // the query sent to the old leader may hang until timeout, so it's resent immediately
+    if (_config_query_task != nullptr) {
+        if (!_config_query_task->cancel(false)) {
+            // the reply is being handled, and the next query goes to the new leader
+            return;
+        }
+        _config_query_task = nullptr;
+    }
+    query_configuration_by_node();
+}
+
 // run in THREAD_POOL_META_SERVER
 void replica_stub::on_node_query_reply(error_code err,
                                        dsn::message_ex *request,
@@ -1311,6 +2051,16 @@ void replica_stub::on_node_query_reply(error_code err,
             return;
         }
 
+        if (resp.__isset.acked_sync_version && resp.acked_sync_version == _config_sync_version) {
+            _acked_config_sync_version = _config_sync_version;
+            _acked_stored_replicas = std::move(_sending_stored_replicas);
+        } else {
+            // the meta server doesn't know the replicas sent, send all of them next time
+            _acked_config_sync_version = 0;
+            _acked_stored_replicas.clear();
+        }
+        _sending_stored_replicas.clear();
+
         ddebug("process query node partitions response for resp.err = ERR_OK, "
                "partitions_count(%d), gc_replicas_count(%d)",
                (int)resp.partitions.size(),
@@ -1456,6 +2206,9 @@ void replica_stub::on_meta_server_disconnected()
         return;
 
     _state = NS_Disconnected;
+    // the meta server may fail over, so begin with a full config sync
+    _acked_config_sync_version = 0;
+    _acked_stored_replicas.clear();
 
     replicas rs;
     {
@@ -1492,7 +2245,8 @@ void replica_stub::response_client(gpid id,
                                    bool is_read,
                                    dsn::message_ex *request,
                                    partition_status::type status,
-                                   error_code error)
+                                   error_code error,
+                                   const partition_configuration *hint)
 {
     if (error == ERR_BUSY) {
         if (is_read)
@@ -1516,7 +2270,12 @@ void replica_stub::response_client(gpid id,
     }
 
     if (request != nullptr) {
-        dsn_rpc_reply(request->create_response(), error);
+        dsn::message_ex *response = request->create_response();
+        // only the clients of the dsn protocol know the hint
+        if (hint != nullptr && request->hdr_format == NET_HDR_DSN) {
+            ::dsn::marshall(response, *hint);
+        }
+        dsn_rpc_reply(response, error);
     }
 }
 
@@ -1541,6 +2300,9 @@ void replica_stub::on_gc_replica(replica_stub_ptr this_, gpid id)
         auto iter = _closed_replicas.find(id);
         if (iter == _closed_replicas.end())
             return;
+        if (is_disk_migrating(id)) {
+            return;
+        }
         closed_info = iter->second;
         _closed_replicas.erase(iter);
         _fs_manager.remove_replica(id);
@@ -1570,7 +2332,49 @@ void replica_stub::on_gc_replica(replica_stub_ptr this_, gpid id)
               replica_path.c_str(),
               rename_path);
         _counter_replicas_recent_replica_move_garbage_count->increment();
+        on_replica_dir_removed(replica_path);
+    }
+}
+
+void replica_stub::on_memory_stat()
+{
+    _counter_memory_mutation_bytes->set(mutation::alive_bytes());
+    _counter_memory_message_bytes->set(message_ex::alive_bytes());
+    _counter_memory_log_buffer_bytes->set(log_appender::alive_bytes());
+
+    int64_t prepare_list_bytes = 0;
+    zauto_read_lock l(_replicas_lock);
+    for (const auto &kv : _replicas) {
+        prepare_list_bytes += kv.second->get_prepare_list_bytes();
+    }
+    _counter_memory_prepare_list_bytes->set(prepare_list_bytes);
+}
+
+double replica_stub::memory_budget_usage() const
+{
+    if (FLAGS_memory_budget_mb == 0) {
+        return 0;
+    }
+    int64_t bytes =
+        mutation::alive_bytes() + message_ex::alive_bytes() + log_appender::alive_bytes();
+    return static_cast<double>(bytes) / (FLAGS_memory_budget_mb << 20);
+}
+
+std::string replica_stub::get_memory_usage_json() const
+{
+    nlohmann::json json;
+    json["mutation"] = {{"count", mutation::alive_count()}, {"bytes", mutation::alive_bytes()}};
+    json["message"] = {{"count", message_ex::alive_count()}, {"bytes", message_ex::alive_bytes()}};
+    json["log_buffer"] = {{"bytes", log_appender::alive_bytes()}};
+    json["budget_usage"] = memory_budget_usage();
+
+    json["replicas"] = nlohmann::json::object();
+    zauto_read_lock l(_replicas_lock);
+    for (const auto &kv : _replicas) {
+        json["replicas"][kv.first.to_string()] = {
+            {"prepare_list_bytes", kv.second->get_prepare_list_bytes()}};
     }
+    return json.dump();
 }
 
 void replica_stub::on_gc()
@@ -1603,6 +2407,33 @@ void replica_stub::on_gc()
 
     ddebug("start to garbage collection, replica_count = %d", (int)rs.size());
 
+    // the emergency checkpoints are spread evenly over half of the gc interval rather than
+    // triggered in a burst, and the replicas with larger private logs go first, as they hold
+    // more disk and take longer to replay
+    auto schedule_emergency_checkpoints = [this, &rs](std::vector<gpid> &ids) {
+        std::vector<std::pair<int64_t, gpid>> pressures;
+        for (auto &id : ids) {
+            const gc_info &info = rs[id];
+            pressures.emplace_back(info.plog ? info.plog->total_size() : 0, id);
+        }
+        std::sort(pressures.begin(),
+                  pressures.end(),
+                  [](const std::pair<int64_t, gpid> &l, const std::pair<int64_t, gpid> &r) {
+                      return l.first > r.first;
+                  });
+
+        uint64_t span_ms = _options.gc_interval_ms / 2;
+        for (size_t i = 0; i < pressures.size(); ++i) {
+            const gpid &id = pressures[i].second;
+            const replica_ptr &rep = rs[id].rep;
+            tasking::enqueue(LPC_PER_REPLICA_CHECKPOINT_TIMER,
+                             rep->tracker(),
+                             std::bind(&replica_stub::trigger_checkpoint, this, rep, true),
+                             id.thread_hash(),
+                             std::chrono::milliseconds(span_ms * i / pressures.size()));
+        }
+    };
+
     // gc shared prepare log
     //
     // Now that checkpoint is very important for gc, we must be able to trigger checkpoint when
@@ -1669,14 +2500,11 @@ void replica_stub::on_gc()
                    "checkpoint",
                    _options.log_shared_file_count_limit,
                    reserved_log_count);
+            std::vector<gpid> triggered;
             for (auto &kv : rs) {
-                tasking::enqueue(
-                    LPC_PER_REPLICA_CHECKPOINT_TIMER,
-                    kv.second.rep->tracker(),
-                    std::bind(&replica_stub::trigger_checkpoint, this, kv.second.rep, true),
-                    kv.first.thread_hash(),
-                    std::chrono::milliseconds(rand::next_u32(0, _options.gc_interval_ms / 2)));
+                triggered.push_back(kv.first);
             }
+            schedule_emergency_checkpoints(triggered);
         } else if (reserved_log_count > _options.log_shared_file_count_limit) {
             std::ostringstream oss;
             int c = 0;
@@ -1693,17 +2521,13 @@ void replica_stub::on_gc()
                    reserved_log_count,
                    (int)prevent_gc_replicas.size(),
                    oss.str().c_str());
+            std::vector<gpid> triggered;
             for (auto &id : prevent_gc_replicas) {
-                auto find = rs.find(id);
-                if (find != rs.end()) {
-                    tasking::enqueue(
-                        LPC_PER_REPLICA_CHECKPOINT_TIMER,
-                        find->second.rep->tracker(),
-                        std::bind(&replica_stub::trigger_checkpoint, this, find->second.rep, true),
-                        id.thread_hash(),
-                        std::chrono::milliseconds(rand::next_u32(0, _options.gc_interval_ms / 2)));
+                if (rs.find(id) != rs.end()) {
+                    triggered.push_back(id);
                 }
             }
+            schedule_emergency_checkpoints(triggered);
         }
 
         _counter_shared_log_size->set(_log->total_size() / (1024 * 1024));
@@ -1739,6 +2563,8 @@ void replica_stub::on_gc()
     _counter_replicas_learning_count->set(learning_count);
     _counter_replicas_learning_max_duration_time_ms->set(learning_max_duration_time_ms);
     _counter_replicas_learning_max_copy_file_size->set(learning_max_copy_file_size);
+    _counter_replicas_learning_app_running_count->set(_learn_scheduler->running_count());
+    _counter_replicas_learning_app_queued_count->set(_learn_scheduler->queued_count());
     _counter_cold_backup_running_count->set(cold_backup_running_count);
     _counter_cold_backup_max_duration_time_ms->set(cold_backup_max_duration_time_ms);
     _counter_cold_backup_max_upload_file_size->set(cold_backup_max_upload_file_size);
@@ -1774,6 +2600,14 @@ void replica_stub::on_disk_stat()
                 garbage_replica_dir_count++;
             }
 
+            {
+                // the replica being moved to another disk is copied here
+                zauto_read_lock l(_replicas_lock);
+                if (_disk_migration != nullptr && _disk_migration->tmp_dir == fpath) {
+                    continue;
+                }
+            }
+
             time_t mt;
             if (!dsn::utils::filesystem::last_write_time(fpath, mt)) {
                 dwarn("gc_disk: failed to get last write time of %s", fpath.c_str());
@@ -1836,6 +2670,14 @@ void replica_stub::on_disk_stat()
         return nullptr;
     }
 
+    if (is_disk_migrating(id)) {
+        _replicas_lock.unlock_write();
+        ddebug("open replica '%s.%s' failed coz replica is moving to another disk",
+               app.app_type.c_str(),
+               id.to_string());
+        return nullptr;
+    }
+
     auto it = _closing_replicas.find(id);
     if (it != _closing_replicas.end()) {
         task_ptr tsk = std::get<0>(it->second);
@@ -1846,6 +2688,7 @@ void replica_stub::on_disk_stat()
             _counter_replicas_closing_count->decrement();
 
             _replicas.emplace(id, rep);
+            update_replica_routes();
             _counter_replicas_count->increment();
 
             _closed_replicas.erase(id);
@@ -1870,24 +2713,58 @@ void replica_stub::on_disk_stat()
         return nullptr;
     }
 
-    task_ptr task =
-        tasking::enqueue(LPC_OPEN_REPLICA,
-                         &_tracker,
-                         std::bind(&replica_stub::open_replica, this, app, id, req, req2));
+    // the task is enqueued once the scheduler starts it
+    task_ptr task = tasking::create_task(
+        LPC_OPEN_REPLICA,
+        &_tracker,
+        std::bind(&replica_stub::open_replica, this, app, id, req, req2, dsn_now_ms()));
 
     _opening_replicas[id] = task;
     _counter_replicas_opening_count->increment();
     _closed_replicas.erase(id);
 
     _replicas_lock.unlock_write();
+
+    std::string disk_tag;
+    std::string dir = get_replica_dir(app.app_type.c_str(), id, false);
+    if (!dir.empty() && _fs_manager.get_disk_tag(dir, disk_tag) != ERR_OK) {
+        disk_tag.clear();
+    }
+    bool is_primary = req2 != nullptr && req2->type == config_type::CT_ASSIGN_PRIMARY;
+    start_opening_replicas(_open_scheduler->add(id, disk_tag, is_primary));
     return task;
 }
 
+void replica_stub::start_opening_replicas(const std::vector<gpid> &started)
+{
+    std::vector<task_ptr> tasks;
+    {
+        zauto_read_lock l(_replicas_lock);
+        for (const gpid &id : started) {
+            auto it = _opening_replicas.find(id);
+            if (it != _opening_replicas.end()) {
+                tasks.push_back(it->second);
+            }
+        }
+    }
+    for (task_ptr &task : tasks) {
+        task->enqueue();
+    }
+}
+
 void replica_stub::open_replica(const app_info &app,
                                 gpid id,
                                 std::shared_ptr<group_check_request> req,
-                                std::shared_ptr<configuration_update_request> req2)
-{
+                                std::shared_ptr<configuration_update_request> req2,
+                                uint64_t queued_ms)
+{
+    uint64_t start_ms = dsn_now_ms();
+    _counter_replica_open_queueing_delay->set(start_ms - queued_ms);
+    auto cleanup = dsn::defer([this, id, start_ms]() {
+        _counter_replica_open_latency->set(dsn_now_ms() - start_ms);
+        start_opening_replicas(_open_scheduler->finish(id));
+    });
+
     std::string dir = get_replica_dir(app.app_type.c_str(), id, false);
     replica_ptr rep = nullptr;
     if (!dir.empty()) {
@@ -1945,6 +2822,7 @@ void replica_stub::open_replica(const app_info &app,
         auto it = _replicas.find(id);
         dassert(it == _replicas.end(), "replica %s is already in _replicas", id.to_string());
         _replicas.insert(replicas::value_type(rep->get_gpid(), rep));
+        update_replica_routes();
         _counter_replicas_count->increment();
 
         _closed_replicas.erase(id);
@@ -1972,6 +2850,7 @@ void replica_stub::open_replica(const app_info &app,
     zauto_write_lock l(_replicas_lock);
 
     if (_replicas.erase(id) > 0) {
+        update_replica_routes();
         _counter_replicas_count->decrement();
 
         int delay_ms = 0;
@@ -2041,6 +2920,71 @@ void replica_stub::trigger_checkpoint(replica_ptr r, bool is_emergency)
     r->init_checkpoint(is_emergency);
 }
 
+log_sync_coordinator *replica_stub::get_log_sync_coordinator(const std::string &replica_dir)
+{
+    std::string disk_tag;
+    if (_fs_manager.get_disk_tag(replica_dir, disk_tag) != ERR_OK) {
+        dwarn_f("get disk tag of {} failed, sync its private log with the default coordinator",
+                replica_dir);
+    }
+
+    zauto_lock l(_log_sync_coordinators_lock);
+    std::unique_ptr<log_sync_coordinator> &coordinator = _log_sync_coordinators[disk_tag];
+    if (coordinator == nullptr) {
+        coordinator = dsn::make_unique<log_sync_coordinator>(disk_tag);
+    }
+    return coordinator.get();
+}
+
+std::shared_ptr<void> replica_stub::acquire_checkpoint_slot(const std::string &replica_dir)
+{
+    std::string disk_tag;
+    if (_fs_manager.get_disk_tag(replica_dir, disk_tag) != ERR_OK) {
+        dwarn_f("get disk tag of {} failed, limit its checkpoints with the default disk",
+                replica_dir);
+    }
+
+    {
+        zauto_lock l(_checkpoint_slots_lock);
+        int &count = _running_checkpoint_counts[disk_tag];
+        if (_options.max_concurrent_checkpoint_count_per_disk > 0 &&
+            count >= _options.max_concurrent_checkpoint_count_per_disk) {
+            return nullptr;
+        }
+        ++count;
+    }
+
+    // the deleter returns the slot rather than deleting the stub
+    return std::shared_ptr<void>(this, [this, disk_tag](void *) {
+        zauto_lock l(_checkpoint_slots_lock);
+        --_running_checkpoint_counts[disk_tag];
+    });
+}
+
+bool replica_stub::acquire_learn_slot(gpid pid, const std::string &replica_dir, int replica_count)
+{
+    std::string disk_tag;
+    if (_fs_manager.get_disk_tag(replica_dir, disk_tag) != ERR_OK) {
+        disk_tag.clear();
+    }
+    return _learn_scheduler->acquire(pid, disk_tag, replica_count);
+}
+
+void replica_stub::release_learn_slot(gpid pid)
+{
+    for (const gpid &id : _learn_scheduler->release(pid)) {
+        replica_ptr rep = get_replica(id);
+        if (rep == nullptr) {
+            release_learn_slot(id);
+            continue;
+        }
+        tasking::enqueue(LPC_DELAY_LEARN,
+                         rep->tracker(),
+                         [rep]() { rep->on_learn_slot_granted(); },
+                         id.thread_hash());
+    }
+}
+
 void replica_stub::handle_log_failure(error_code err)
 {
     derror("handle log failure: %s", err.to_string());
@@ -2052,7 +2996,11 @@ void replica_stub::handle_log_failure(error_code err)
 void replica_stub::open_service()
 {
     register_rpc_handler(RPC_CONFIG_PROPOSAL, "ProposeConfig", &replica_stub::on_config_proposal);
+    register_rpc_handler(RPC_CONFIG_PROPOSAL_BATCH,
+                         "ProposeConfigBatch",
+                         &replica_stub::on_config_proposal_batch);
     register_rpc_handler(RPC_PREPARE, "prepare", &replica_stub::on_prepare);
+    register_rpc_handler(RPC_PREPARE_BATCH, "prepare_batch", &replica_stub::on_prepare_batch);
     register_rpc_handler(RPC_LEARN, "Learn", &replica_stub::on_learn);
     register_rpc_handler_with_rpc_holder(RPC_LEARN_COMPLETION_NOTIFY,
                                          "LearnNotify",
@@ -2061,6 +3009,10 @@ void replica_stub::open_service()
     register_rpc_handler(RPC_REMOVE_REPLICA, "remove", &replica_stub::on_remove);
     register_rpc_handler_with_rpc_holder(
         RPC_GROUP_CHECK, "GroupCheck", &replica_stub::on_group_check);
+    register_rpc_handler(
+        RPC_GROUP_CHECK_BATCH, "GroupCheckBatch", &replica_stub::on_group_check_batch);
+    register_rpc_handler(RPC_CLIENT_BATCH, "ClientBatch", &replica_stub::on_client_batch);
+    register_rpc_handler(RPC_COMMIT_NOTIFY, "CommitNotify", &replica_stub::on_commit_notify);
     register_rpc_handler_with_rpc_holder(
         RPC_QUERY_PN_DECREE, "query_decree", &replica_stub::on_query_decree);
     register_rpc_handler_with_rpc_holder(
@@ -2157,6 +3109,18 @@ void replica_stub::register_ctrl_command()
                 });
             });
 
+        _migrate_disk_command = ::dsn::command_manager::instance().register_command(
+            {"replica.migrate-disk"},
+            "migrate-disk <app_id.partition_id> <target_disk_tag>",
+            "migrate-disk - move a secondary replica to another disk of this node",
+            [this](const std::vector<std::string> &args) {
+                gpid pid;
+                if (args.size() != 2 || !pid.parse_from(args[0].c_str())) {
+                    return std::string(ERR_INVALID_PARAMETERS.to_string());
+                }
+                return std::string(begin_disk_migration(pid, args[1]).to_string());
+            });
+
         _query_compact_command = ::dsn::command_manager::instance().register_command(
             {"replica.query-compact"},
             "query-compact [id1,id2,...] (where id is 'app_id' or 'app_id.partition_id')",
@@ -2273,6 +3237,13 @@ void replica_stub::register_ctrl_command()
                     }
                     return result;
                 });
+
+        _query_learn_scheduler_command = dsn::command_manager::instance().register_command(
+            {"replica.query-learn-scheduler"},
+            "query-learn-scheduler",
+            "query-learn-scheduler - query the learners copying app checkpoints and the queued "
+            "ones, as <gpid>@<disk tag>/<replica count of the partition>",
+            [this](const std::vector<std::string> &args) { return _learn_scheduler->to_string(); });
     });
 }
 
@@ -2396,6 +3367,7 @@ void replica_stub::close()
     dsn::command_manager::instance().deregister_command(_verbose_client_log_command);
     dsn::command_manager::instance().deregister_command(_verbose_commit_log_command);
     dsn::command_manager::instance().deregister_command(_trigger_chkpt_command);
+    dsn::command_manager::instance().deregister_command(_migrate_disk_command);
     dsn::command_manager::instance().deregister_command(_query_compact_command);
     dsn::command_manager::instance().deregister_command(_query_app_envs_command);
     dsn::command_manager::instance().deregister_command(_useless_dir_reserve_seconds_command);
@@ -2405,12 +3377,14 @@ void replica_stub::close()
 #endif
     dsn::command_manager::instance().deregister_command(
         _max_concurrent_bulk_load_downloading_count_command);
+    dsn::command_manager::instance().deregister_command(_query_learn_scheduler_command);
 
     _kill_partition_command = nullptr;
     _deny_client_command = nullptr;
     _verbose_client_log_command = nullptr;
     _verbose_commit_log_command = nullptr;
     _trigger_chkpt_command = nullptr;
+    _migrate_disk_command = nullptr;
     _query_compact_command = nullptr;
     _query_app_envs_command = nullptr;
     _useless_dir_reserve_seconds_command = nullptr;
@@ -2419,6 +3393,7 @@ void replica_stub::close()
     _max_reserved_memory_percentage_command = nullptr;
 #endif
     _max_concurrent_bulk_load_downloading_count_command = nullptr;
+    _query_learn_scheduler_command = nullptr;
 
     if (_config_sync_timer_task != nullptr) {
         _config_sync_timer_task->cancel(true);
@@ -2441,6 +3416,16 @@ void replica_stub::close()
         _disk_stat_timer_task = nullptr;
     }
 
+    if (_memory_stat_timer_task != nullptr) {
+        _memory_stat_timer_task->cancel(true);
+        _memory_stat_timer_task = nullptr;
+    }
+
+    if (_disk_load_timer_task != nullptr) {
+        _disk_load_timer_task->cancel(true);
+        _disk_load_timer_task = nullptr;
+    }
+
     if (_gc_timer_task != nullptr) {
         _gc_timer_task->cancel(true);
         _gc_timer_task = nullptr;
@@ -2480,12 +3465,23 @@ void replica_stub::close()
             _opening_replicas.erase(_opening_replicas.begin());
         }
 
-        while (!_replicas.empty()) {
-            _replicas.begin()->second->close();
-
+        // the private logs and the apps are closed in parallel, and the shared log is closed
+        // after all of them
+        std::map<std::string, std::vector<replica_ptr>> disk_replicas;
+        for (const auto &kv : _replicas) {
+            std::string disk_tag;
+            if (_fs_manager.get_disk_tag(kv.second->dir(), disk_tag) != ERR_OK) {
+                disk_tag.clear();
+            }
+            disk_replicas[disk_tag].push_back(kv.second);
             _counter_replicas_count->decrement();
-            _replicas.erase(_replicas.begin());
         }
+        _replicas.clear();
+        update_replica_routes();
+
+        _replicas_lock.unlock_write();
+        close_replicas(std::move(disk_replicas));
+        _replicas_lock.lock_write();
     }
 
     if (_failure_detector != nullptr) {
@@ -2500,6 +3496,40 @@ void replica_stub::close()
     }
 }
 
+void replica_stub::close_replicas(std::map<std::string, std::vector<replica_ptr>> &&disk_replicas)
+{
+    uint64_t start_time = dsn_now_ms();
+    size_t replica_count = 0;
+    std::vector<task_ptr> close_tasks;
+    for (auto &kv : disk_replicas) {
+        auto replicas = std::make_shared<std::vector<replica_ptr>>(std::move(kv.second));
+        auto next = std::make_shared<std::atomic<size_t>>(0);
+        replica_count += replicas->size();
+        size_t concurrency = std::max(FLAGS_close_replica_concurrency_per_disk, 1U);
+        for (size_t i = 0; i < concurrency && i < replicas->size(); ++i) {
+            close_tasks.push_back(tasking::create_task(
+                LPC_REPLICATION_CLOSE,
+                nullptr,
+                [replicas, next]() {
+                    for (size_t idx = (*next)++; idx < replicas->size(); idx = (*next)++) {
+                        (*replicas)[idx]->close(FLAGS_close_replica_checkpoint_min_log_tail);
+                        (*replicas)[idx] = nullptr;
+                    }
+                },
+                close_tasks.size()));
+            close_tasks.back()->enqueue();
+        }
+    }
+    for (auto &tsk : close_tasks) {
+        tsk->wait();
+    }
+    ddebug("close replicas succeed, replica_count = %d, disk_count = %d, time_used = %" PRIu64
+           " ms",
+           static_cast<int>(replica_count),
+           static_cast<int>(disk_replicas.size()),
+           dsn_now_ms() - start_time);
+}
+
 std::string replica_stub::get_replica_dir(const char *app_type, gpid id, bool create_new)
 {
     std::string gpid_str = fmt::format("{}.{}", id, app_type);
@@ -2522,6 +3552,66 @@ std::string replica_stub::get_replica_dir(const char *app_type, gpid id, bool cr
     return replica_dir;
 }
 
+replica_manifest *replica_stub::get_replica_manifest(const std::string &dir) const
+{
+    auto it = _replica_manifests.find(utils::filesystem::remove_file_name(dir));
+    return it == _replica_manifests.end() ? nullptr : it->second.get();
+}
+
+void replica_stub::on_replica_dir_created(const std::string &dir, const app_info &info)
+{
+    replica_manifest *manifest = get_replica_manifest(dir);
+    if (manifest != nullptr) {
+        // as stored in .app-info
+        app_info stored = info;
+        stored.envs.clear();
+        manifest->add(utils::filesystem::get_file_name(dir), stored);
+    }
+}
+
+void replica_stub::on_replica_dir_removed(const std::string &dir)
+{
+    replica_manifest *manifest = get_replica_manifest(dir);
+    if (manifest != nullptr) {
+        manifest->remove(utils::filesystem::get_file_name(dir));
+    }
+}
+
+void replica_stub::verify_replica_manifests(const std::vector<std::string> &dirs)
+{
+    int mismatch_count = 0;
+    for (const std::string &dir : dirs) {
+        replica_manifest *manifest = get_replica_manifest(dir);
+        std::string name = utils::filesystem::get_file_name(dir);
+        app_info cached_info;
+        if (manifest == nullptr || !manifest->get(name, cached_info) ||
+            !utils::filesystem::directory_exists(dir)) {
+            // removed since
+            continue;
+        }
+
+        app_info info;
+        replica_app_info info2(&info);
+        std::string path = utils::filesystem::path_combine(dir, ".app-info");
+        error_code err = info2.load(path.c_str());
+        if (err != ERR_OK) {
+            derror_f("verify replica manifest: load app-info from {} failed, err = {}", path, err);
+        } else if (!(info == cached_info)) {
+            // the replica is loaded by the stale app info, which is corrected by the meta server
+            // on config sync, while the manifest is corrected for the next startup
+            derror_f("verify replica manifest: the app info of {} in the manifest mismatches the "
+                     "one in {}",
+                     name,
+                     path);
+            ++mismatch_count;
+            manifest->add(name, info);
+        }
+    }
+    ddebug_f("verify replica manifests done, replica_count = {}, mismatch_count = {}",
+             dirs.size(),
+             mismatch_count);
+}
+
 std::string
 replica_stub::get_child_dir(const char *app_type, gpid child_pid, const std::string &parent_dir)
 {
@@ -2541,6 +3631,29 @@ replica_stub::get_child_dir(const char *app_type, gpid child_pid, const std::str
     return child_dir;
 }
 
+/*static*/ int64_t replica_stub::tcmalloc_bytes_to_release(int64_t allocated_bytes,
+                                                           int64_t reserved_bytes,
+                                                           int32_t max_reserved_percentage,
+                                                           double pressure)
+{
+    double low = FLAGS_mem_release_low_watermark_percent / 100.0;
+    double high = FLAGS_mem_release_high_watermark_percent / 100.0;
+    double reserved_ratio = max_reserved_percentage / 100.0;
+    if (pressure >= high) {
+        reserved_ratio = 0;
+    } else if (pressure > low) {
+        reserved_ratio *= (high - pressure) / (high - low);
+    }
+
+    int64_t max_reserved_bytes = static_cast<int64_t>(allocated_bytes * reserved_ratio);
+    int64_t release_bytes = std::max<int64_t>(reserved_bytes - max_reserved_bytes, 0);
+    if (FLAGS_mem_release_max_mb_per_check > 0) {
+        release_bytes =
+            std::min<int64_t>(release_bytes, FLAGS_mem_release_max_mb_per_check << 20);
+    }
+    return release_bytes;
+}
+
 #ifdef DSN_ENABLE_GPERF
 // Get tcmalloc numeric property (name is "prop") value.
 // Return -1 if get property failed (property we used will be greater than zero)
@@ -2570,21 +3683,71 @@ void replica_stub::gc_tcmalloc_memory()
         return;
     }
 
-    int64_t max_reserved_bytes =
-        total_allocated_bytes * _mem_release_max_reserved_mem_percentage / 100.0;
-    if (reserved_bytes > max_reserved_bytes) {
-        int64_t release_bytes = reserved_bytes - max_reserved_bytes;
+    double pressure = get_memory_pressure();
+    _counter_memory_pressure_percent->set(static_cast<int64_t>(pressure * 100));
+    dump_heap_profile_if_needed(pressure);
+
+    int64_t release_bytes = tcmalloc_bytes_to_release(
+        total_allocated_bytes, reserved_bytes, _mem_release_max_reserved_mem_percentage, pressure);
+    if (release_bytes > 0) {
         tcmalloc_released_bytes = release_bytes;
-        ddebug_f("Memory release started, almost {} bytes will be released", release_bytes);
+        ddebug_f("Memory release started, almost {} bytes will be released, memory pressure = {}",
+                 release_bytes,
+                 pressure);
+        uint64_t start_us = dsn_now_us();
         while (release_bytes > 0) {
             // tcmalloc releasing memory will lock page heap, release 1MB at a time to avoid locking
             // page heap for long time
             ::MallocExtension::instance()->ReleaseToSystem(1024 * 1024);
             release_bytes -= 1024 * 1024;
         }
+        _counter_tcmalloc_release_duration_us->set(dsn_now_us() - start_us);
     }
     _counter_tcmalloc_release_memory_size->set(tcmalloc_released_bytes);
 }
+
+double replica_stub::get_memory_pressure() const
+{
+    int64_t limit_bytes = FLAGS_mem_release_memory_limit_mb > 0
+                              ? static_cast<int64_t>(FLAGS_mem_release_memory_limit_mb << 20)
+                              : utils::cgroup_memory_limit();
+    if (limit_bytes <= 0) {
+        return 0;
+    }
+
+    double vm_usage_kb = 0;
+    double rss_kb = 0;
+    utils::process_mem_usage(vm_usage_kb, rss_kb);
+    return rss_kb * 1024 / limit_bytes;
+}
+
+void replica_stub::dump_heap_profile_if_needed(double pressure)
+{
+    if (FLAGS_heap_profile_pressure_percent == 0 ||
+        pressure * 100 < FLAGS_heap_profile_pressure_percent ||
+        dsn_now_ms() < _last_heap_profile_ms + FLAGS_heap_profile_min_interval_seconds * 1000) {
+        return;
+    }
+    _last_heap_profile_ms = dsn_now_ms();
+
+    std::string profile;
+    if (!pprof_http_service::get_heap_sample(profile)) {
+        dwarn_f("no heap sample to dump under memory pressure {}, is "
+                "TCMALLOC_SAMPLE_PARAMETER set?",
+                pressure);
+        return;
+    }
+    if (!utils::filesystem::create_directory(FLAGS_heap_profile_dir)) {
+        derror_f("create dir {} for heap profiles failed", FLAGS_heap_profile_dir);
+        return;
+    }
+    std::string path = utils::filesystem::path_combine(
+        FLAGS_heap_profile_dir, fmt::format("heap_sample.{}.{}", getpid(), _last_heap_profile_ms));
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    out << profile;
+    out.close();
+    dwarn_f("dumped the heap profile under memory pressure {} to {}", pressure, path);
+}
 #endif
 
 //
@@ -2624,6 +3787,7 @@ replica_ptr replica_stub::create_child_replica_if_not_found(gpid child_pid,
                             replica *rep = new replica(this, child_pid, *app, "./", false);
                             rep->_config.status = partition_status::PS_INACTIVE;
                             _replicas.insert(replicas::value_type(child_pid, rep));
+                            update_replica_routes();
                             ddebug_f("mock create_child_replica_if_not_found succeed");
                             return rep;
                         });
@@ -2644,6 +3808,7 @@ replica_ptr replica_stub::create_child_replica_if_not_found(gpid child_pid,
             if (rep != nullptr) {
                 auto pr = _replicas.insert(replicas::value_type(child_pid, rep));
                 dassert_f(pr.second, "child replica {} has been existed", rep->name());
+                update_replica_routes();
                 _counter_replicas_count->increment();
                 _closed_replicas.erase(child_pid);
             }
@@ -33,7 +33,10 @@
 //
 
 #include <functional>
+#include <map>
+#include <memory>
 #include <tuple>
+#include <vector>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/dist/failure_detector_multimaster.h>
 #include <dsn/dist/nfs_node.h>
@@ -42,6 +45,11 @@
 #include "common/fs_manager.h"
 #include "block_service/block_service_manager.h"
 #include "replica.h"
+#include "log_sync_coordinator.h"
+#include "learn_scheduler.h"
+#include "replica_open_scheduler.h"
+#include "replica_manifest.h"
+#include "app_counters.h"
 
 namespace dsn {
 namespace replication {
@@ -65,6 +73,9 @@ class test_checker;
 class cold_backup_context;
 
 typedef std::unordered_map<gpid, replica_ptr> replicas;
+// app_id => replicas indexed by the partition index, a read-only snapshot of _replicas for the
+// lock-free lookups on the client request path
+typedef std::unordered_map<int32_t, std::vector<replica_ptr>> replica_routes;
 typedef std::function<void(
     ::dsn::rpc_address /*from*/, const replica_configuration & /*new_config*/, bool /*is_closing*/)>
     replica_state_subscriber;
@@ -102,6 +113,7 @@ public:
     //    messages from meta server
     //
     void on_config_proposal(const configuration_update_request &proposal);
+    void on_config_proposal_batch(dsn::message_ex *request);
     void on_query_decree(query_replica_decree_rpc rpc);
     void on_query_replica_info(query_replica_info_rpc rpc);
     void on_query_disk_info(query_disk_info_rpc rpc);
@@ -118,11 +130,15 @@ public:
     //        - bulk_load
     //
     void on_prepare(dsn::message_ex *request);
+    void on_prepare_batch(dsn::message_ex *request);
     void on_learn(dsn::message_ex *msg);
     void on_learn_completion_notification(learn_completion_notification_rpc rpc);
     void on_add_learner(const group_check_request &request);
     void on_remove(const replica_configuration &request);
     void on_group_check(group_check_rpc rpc);
+    void on_group_check_batch(dsn::message_ex *request);
+    void on_client_batch(dsn::message_ex *request);
+    void on_commit_notify(const group_check_request &request);
     void on_copy_checkpoint(copy_checkpoint_rpc rpc);
     void on_group_bulk_load(group_bulk_load_rpc rpc);
 
@@ -137,8 +153,12 @@ public:
     //
     void on_meta_server_connected();
     void on_meta_server_disconnected();
+    // resends the config sync to the new leader of the meta servers immediately
+    void on_meta_server_switched();
     void on_gc();
     void on_disk_stat();
+    void on_memory_stat();
+    void on_disk_load();
 
     //
     //  routines published for test
@@ -152,14 +172,38 @@ public:
     //
     // common routines for inquiry
     //
+    // lock-free, by the snapshot of the replicas
     replica_ptr get_replica(gpid id);
+    // send the group check to `target` in one RPC_GROUP_CHECK_BATCH with the others sent to the
+    // same node within group_check_batch_window_ms; `callback` is called in the thread of
+    // `thread_hash` as the callback of rpc::call() is, and the returned task could be cancelled
+    task_ptr send_group_check_in_batch(
+        rpc_address target,
+        const std::shared_ptr<group_check_request> &request,
+        task_tracker *tracker,
+        std::function<void(error_code, group_check_response &&)> &&callback,
+        int thread_hash);
     replication_options &options() { return _options; }
     bool is_connected() const { return NS_Connected == _state; }
     virtual rpc_address get_meta_server_address() const { return _failure_detector->get_servers(); }
     rpc_address primary_address() const { return _primary_address; }
+    // the time (in ms) before which the meta server is guaranteed not to remove this replica
+    // server from any partition, UINT64_MAX if failure detection is disabled
+    uint64_t get_meta_lease_expire_ms() const;
+
+    // the approximate memory pinned by the mutations, messages and log buffers on this node,
+    // in ratio of [replication] memory_budget_mb, 0 if there is no budget
+    double memory_budget_usage() const;
+    // the memory accounting of this node and of each replica, for ip:port/replica/memory
+    std::string get_memory_usage_json() const;
 
     std::string get_replica_dir(const char *app_type, gpid id, bool create_new = true);
 
+    // keep the replica manifest of the data dir of `dir` in line with the replica dirs, see
+    // replica_manifest
+    void on_replica_dir_created(const std::string &dir, const app_info &info);
+    void on_replica_dir_removed(const std::string &dir);
+
     // during partition split, we should gurantee child replica and parent replica share the
     // same data dir
     std::string get_child_dir(const char *app_type, gpid child_pid, const std::string &parent_dir);
@@ -223,7 +267,23 @@ private:
     };
 
     void initialize_start();
+    // isolate the apps of the loaded replicas in THREAD_POOL_REPLICATION, see app_pool_router
+    void install_app_pool_router(const replicas &rps);
+    // the replica manifest of the data dir of `dir`, nullptr if the manifests are disabled
+    replica_manifest *get_replica_manifest(const std::string &dir) const;
+    // compares the app infos of the replicas loaded by the manifests with their .app-info files,
+    // `dirs` are the replica dirs
+    void verify_replica_manifests(const std::vector<std::string> &dirs);
     void query_configuration_by_node();
+    // fill the stored replicas of a config sync request, which are only the replicas changed
+    // since the last acked sync unless a full sync is required
+    // assert(_state_lock.locked())
+    void fill_config_sync_request(configuration_query_by_node_request &req);
+    // the loads and the hottest partitions since the last config sync
+    void fill_replica_loads(configuration_query_by_node_request &req);
+    void handle_group_check(const group_check_request &request,
+                            /*out*/ group_check_response &response);
+    void flush_group_check_batch(rpc_address target);
     void on_meta_server_disconnected_scatter(replica_stub_ptr this_, gpid id);
     void on_node_query_reply(error_code err, dsn::message_ex *request, dsn::message_ex *response);
     void on_node_query_reply_scatter(replica_stub_ptr this_,
@@ -237,12 +297,31 @@ private:
     void open_replica(const app_info &app,
                       gpid id,
                       std::shared_ptr<group_check_request> req,
-                      std::shared_ptr<configuration_update_request> req2);
+                      std::shared_ptr<configuration_update_request> req2,
+                      uint64_t queued_ms);
+    // enqueue the tasks of the opens started by _open_scheduler
+    void start_opening_replicas(const std::vector<gpid> &started);
     ::dsn::task_ptr begin_close_replica(replica_ptr r);
+    // close the replicas of each disk tag by concurrent tasks on shutdown
+    void close_replicas(std::map<std::string, std::vector<replica_ptr>> &&disk_replicas);
     void close_replica(replica_ptr r);
     void notify_replica_state_update(const replica_configuration &config, bool is_closing);
     void trigger_checkpoint(replica_ptr r, bool is_emergency);
+    // take a slot of the background checkpoints on the disk of `replica_dir`, which is returned
+    // when the result is destroyed; return nullptr if no slot is available
+    std::shared_ptr<void> acquire_checkpoint_slot(const std::string &replica_dir);
+    // take a slot of the learnings of app checkpoints for the learner `pid` on the disk of
+    // `replica_dir`, see learn_scheduler::acquire(); if no slot is available, the learner is
+    // queued and replica::on_learn_slot_granted() is called once the slot is taken for it
+    bool acquire_learn_slot(gpid pid, const std::string &replica_dir, int replica_count);
+    // return the slot taken by `pid` or cancel its queued request
+    void release_learn_slot(gpid pid);
     void handle_log_failure(error_code err);
+    // get the log sync coordinator of the disk where `replica_dir` is located,
+    // only used when `_log_shared_disabled` is true
+    log_sync_coordinator *get_log_sync_coordinator(const std::string &replica_dir);
+    // the counters of the apps, aggregated from the replicas on this node
+    app_counters &get_app_counters() { return _app_counters; }
 
     void install_perf_counters();
     dsn::error_code on_kill_replica(gpid id);
@@ -252,13 +331,40 @@ private:
     replica_life_cycle get_replica_life_cycle(gpid id);
     void on_gc_replica(replica_stub_ptr this_, gpid id);
 
+    // `hint` is the configuration of the partition known by this replica, which is piggybacked
+    // on the error response, so the client can retry on the primary without querying meta server
     void response_client(gpid id,
                          bool is_read,
                          dsn::message_ex *request,
                          partition_status::type status,
-                         error_code error);
+                         error_code error,
+                         const partition_configuration *hint = nullptr);
     void update_disk_holding_replicas();
 
+    // move the replicas between the disks of the node, see replica_disk_balance.cpp
+    struct disk_migration
+    {
+        gpid pid;
+        std::string app_type;
+        std::string from_dir;
+        std::string to_dir;
+        // the files are copied here before switched to to_dir
+        std::string tmp_dir;
+        // <relative path, wall time in nanoseconds> when the files are copied online
+        std::map<std::string, int64_t> copied_files;
+    };
+    void start_disk_balance();
+    error_code begin_disk_migration(gpid pid, const std::string &to_tag);
+    void copy_migrating_replica(std::shared_ptr<disk_migration> m);
+    void close_migrating_replica(std::shared_ptr<disk_migration> m);
+    void wait_disk_migration_closed(std::shared_ptr<disk_migration> m, uint64_t start_ms);
+    bool switch_migrating_replica(const disk_migration &m);
+    void end_disk_migration(bool succeed);
+    bool is_disk_migrating(gpid pid) const
+    {
+        return _disk_migration != nullptr && _disk_migration->pid == pid;
+    }
+
     void register_ctrl_command();
 
     int get_app_id_from_replicas(std::string app_name)
@@ -272,9 +378,24 @@ private:
         return 0;
     }
 
+    // The bytes of the free memory to release to the system in a check. The free memory beyond
+    // `max_reserved_percentage` of the allocated memory is released when `pressure`, the rss in
+    // ratio of the memory limit, is below [replication] mem_release_low_watermark_percent. The
+    // reserved memory shrinks linearly to 0 as the pressure rises to
+    // mem_release_high_watermark_percent. At most mem_release_max_mb_per_check is released.
+    static int64_t tcmalloc_bytes_to_release(int64_t allocated_bytes,
+                                             int64_t reserved_bytes,
+                                             int32_t max_reserved_percentage,
+                                             double pressure);
+
 #ifdef DSN_ENABLE_GPERF
     // Try to release tcmalloc memory back to operating system
     void gc_tcmalloc_memory();
+    // the rss in ratio of the memory limit, 0 if there is no limit
+    double get_memory_pressure() const;
+    // dump the sampled heap profile if the memory pressure reaches
+    // [replication] heap_profile_pressure_percent
+    void dump_heap_profile_if_needed(double pressure);
 #endif
 
 private:
@@ -301,13 +422,43 @@ private:
     typedef std::map<gpid, std::pair<app_info, replica_info>>
         closed_replicas; // <gpid, <app_info, replica_info> >
 
-    mutable zrwlock_nr _replicas_lock;
+    // rebuild the snapshot of _replicas, called with the write lock of _replicas_lock held
+    // whenever _replicas is changed
+    void update_replica_routes();
+
+    mutable zrwlock_nr _replicas_lock{"replica_stub::_replicas_lock"};
+    // declared before the replicas, which are detached from it on closing
+    app_counters _app_counters;
     replicas _replicas;
+    // read by std::atomic_load, replaced by std::atomic_store on update_replica_routes()
+    std::shared_ptr<const replica_routes> _replica_routes;
     opening_replicas _opening_replicas;
+    // the tasks in _opening_replicas are enqueued once they are started by the scheduler
+    std::unique_ptr<replica_open_scheduler> _open_scheduler;
     closing_replicas _closing_replicas;
     closed_replicas _closed_replicas;
 
+    // a group check waiting to be sent in batch
+    struct pending_group_check
+    {
+        std::shared_ptr<group_check_request> request;
+        // filled before callback_task is enqueued
+        std::shared_ptr<std::pair<error_code, group_check_response>> result;
+        task_ptr callback_task;
+    };
+    zlock _group_check_batches_lock;
+    std::map<rpc_address, std::vector<pending_group_check>> _group_check_batches;
+
     mutation_log_ptr _log;
+    // if the shared log is disabled, mutations are only written into the private logs,
+    // which are synced to disk through the coordinator of their disks
+    bool _log_shared_disabled;
+    zlock _log_sync_coordinators_lock;
+    std::map<std::string, std::unique_ptr<log_sync_coordinator>> _log_sync_coordinators;
+
+    // disk tag => count of the running background checkpoints
+    zlock _checkpoint_slots_lock;
+    std::map<std::string, int> _running_checkpoint_counts;
     ::dsn::rpc_address _primary_address;
     char _primary_address_str[64];
 
@@ -322,9 +473,21 @@ private:
 
     // temproal states
     ::dsn::task_ptr _config_query_task;
+    // states of delta config sync, protected by _state_lock
+    int64_t _config_sync_version;
+    // 0 if no sync is acked by the meta server, then all the stored replicas are sent
+    int64_t _acked_config_sync_version;
+    uint32_t _config_sync_rounds_since_full;
+    std::map<gpid, replica_info> _acked_stored_replicas;
+    std::map<gpid, replica_info> _sending_stored_replicas;
     ::dsn::task_ptr _config_sync_timer_task;
     ::dsn::task_ptr _gc_timer_task;
     ::dsn::task_ptr _disk_stat_timer_task;
+    ::dsn::task_ptr _memory_stat_timer_task;
+    ::dsn::task_ptr _disk_load_timer_task;
+    // the replica being moved to another disk, which isn't opened or gc-ed, protected by
+    // _replicas_lock
+    std::shared_ptr<disk_migration> _disk_migration;
     ::dsn::task_ptr _mem_release_timer_task;
 
     std::unique_ptr<duplication_sync_timer> _duplication_sync_timer;
@@ -335,6 +498,7 @@ private:
     dsn_handle_t _verbose_client_log_command;
     dsn_handle_t _verbose_commit_log_command;
     dsn_handle_t _trigger_chkpt_command;
+    dsn_handle_t _migrate_disk_command;
     dsn_handle_t _query_compact_command;
     dsn_handle_t _query_app_envs_command;
     dsn_handle_t _useless_dir_reserve_seconds_command;
@@ -343,6 +507,7 @@ private:
     dsn_handle_t _max_reserved_memory_percentage_command;
 #endif
     dsn_handle_t _max_concurrent_bulk_load_downloading_count_command;
+    dsn_handle_t _query_learn_scheduler_command;
 
     bool _deny_client;
     bool _verbose_client_log;
@@ -351,14 +516,22 @@ private:
     int32_t _gc_disk_garbage_replica_interval_seconds;
     bool _release_tcmalloc_memory;
     int32_t _mem_release_max_reserved_mem_percentage;
+    uint64_t _last_heap_profile_ms{0};
     int32_t _max_concurrent_bulk_load_downloading_count;
 
-    // we limit LT_APP max concurrent count, because nfs service implementation is
-    // too simple, it do not support priority.
-    std::atomic_int _learn_app_concurrent_count;
+    // we limit LT_APP max concurrent count in total and on each disk, and the partitions with
+    // less replicas learn first
+    std::unique_ptr<learn_scheduler> _learn_scheduler;
+
+    // we limit the count of children learning parent states concurrently, so that splitting
+    // a large app won't occupy all the THREAD_POOL_REPLICATION_LONG workers.
+    std::atomic_int _split_learn_concurrent_count;
 
     // handle all the data dirs
     fs_manager _fs_manager;
+    // the replica manifest of each data dir, empty if [replication] replica_manifest_enabled
+    // is false
+    std::map<std::string, std::unique_ptr<replica_manifest>> _replica_manifests;
 
     // handle all the block filesystems for current replica stub
     // (in other words, current service node)
@@ -375,6 +548,10 @@ private:
 
     // performance counters
     perf_counter_wrapper _counter_replicas_count;
+    perf_counter_wrapper _counter_memory_mutation_bytes;
+    perf_counter_wrapper _counter_memory_message_bytes;
+    perf_counter_wrapper _counter_memory_log_buffer_bytes;
+    perf_counter_wrapper _counter_memory_prepare_list_bytes;
     perf_counter_wrapper _counter_replicas_opening_count;
     perf_counter_wrapper _counter_replicas_closing_count;
     perf_counter_wrapper _counter_replicas_commit_qps;
@@ -382,6 +559,8 @@ private:
     perf_counter_wrapper _counter_replicas_learning_count;
     perf_counter_wrapper _counter_replicas_learning_max_duration_time_ms;
     perf_counter_wrapper _counter_replicas_learning_max_copy_file_size;
+    perf_counter_wrapper _counter_replicas_learning_app_running_count;
+    perf_counter_wrapper _counter_replicas_learning_app_queued_count;
     perf_counter_wrapper _counter_replicas_learning_recent_start_count;
     perf_counter_wrapper _counter_replicas_learning_recent_round_start_count;
     perf_counter_wrapper _counter_replicas_learning_recent_copy_file_count;
@@ -402,9 +581,16 @@ private:
     perf_counter_wrapper _counter_replicas_garbage_replica_dir_count;
 
     perf_counter_wrapper _counter_replicas_recent_group_check_fail_count;
+    perf_counter_wrapper _counter_replicas_recent_read_lease_hit_count;
+    perf_counter_wrapper _counter_replicas_recent_read_lease_miss_count;
 
     perf_counter_wrapper _counter_shared_log_size;
     perf_counter_wrapper _counter_shared_log_recent_write_size;
+    perf_counter_wrapper _counter_shared_log_batch_size;
+    perf_counter_wrapper _counter_shared_log_batch_mutation_count;
+    perf_counter_wrapper _counter_shared_log_batch_queueing_delay;
+    perf_counter_wrapper _counter_replica_open_queueing_delay;
+    perf_counter_wrapper _counter_replica_open_latency;
     perf_counter_wrapper _counter_recent_trigger_emergency_checkpoint_count;
 
     // <- Duplication Metrics ->
@@ -434,6 +620,8 @@ private:
 
 #ifdef DSN_ENABLE_GPERF
     perf_counter_wrapper _counter_tcmalloc_release_memory_size;
+    perf_counter_wrapper _counter_tcmalloc_release_duration_us;
+    perf_counter_wrapper _counter_memory_pressure_percent;
 #endif
     dsn::task_tracker _tracker;
 };
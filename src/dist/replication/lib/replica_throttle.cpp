@@ -10,10 +10,31 @@
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/dist/replication/replica_envs.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  write_backpressure_max_delay_ms,
+                  0,
+                  "the client writes are delayed up to it in proportion to how full the window of "
+                  "the mutations being prepared is, see write_backpressure_start_percent; 0 means "
+                  "disabled");
+DSN_DEFINE_uint32("replication",
+                  write_backpressure_start_percent,
+                  60,
+                  "the client writes start to be delayed when the window of the mutations being "
+                  "prepared is fuller than it, by count (staleness_for_commit) or by bytes "
+                  "(prepare_window_max_kb)");
+DSN_DEFINE_validator(write_backpressure_start_percent,
+                     [](uint32_t value) -> bool { return value <= 100; });
+DSN_DEFINE_uint32("replication",
+                  write_fair_queue_max_count,
+                  10000,
+                  "max count of the client writes queued by the fair queuing of a primary, see "
+                  "the app env replica.write_fair_queuing, the others are rejected");
+
 bool replica::throttle_request(throttling_controller &controller,
                                message_ex *request,
                                int32_t request_units)
@@ -26,12 +47,9 @@ bool replica::throttle_request(throttling_controller &controller,
     auto type = controller.control(request->header->client.timeout_ms, request_units, delay_ms);
     if (type != throttling_controller::PASS) {
         if (type == throttling_controller::DELAY) {
-            tasking::enqueue(LPC_WRITE_THROTTLING_DELAY,
-                             &_tracker,
-                             [ this, req = message_ptr(request) ]() { on_client_write(req, true); },
-                             get_gpid().thread_hash(),
-                             std::chrono::milliseconds(delay_ms));
-            _counter_recent_write_throttling_delay_count->increment();
+            delay_client_write(request, delay_ms);
+            increment_throttling_counter(APP_COUNTER_WRITE_THROTTLING_DELAY_COUNT,
+                                         _counter_recent_write_throttling_delay_count);
         } else { // type == throttling_controller::REJECT
             if (delay_ms > 0) {
                 tasking::enqueue(LPC_WRITE_THROTTLING_DELAY,
@@ -44,19 +62,119 @@ bool replica::throttle_request(throttling_controller &controller,
             } else {
                 response_client_write(request, ERR_BUSY);
             }
-            _counter_recent_write_throttling_reject_count->increment();
+            increment_throttling_counter(APP_COUNTER_WRITE_THROTTLING_REJECT_COUNT,
+                                         _counter_recent_write_throttling_reject_count);
         }
         return true;
     }
     return false;
 }
 
+bool replica::throttle_by_backpressure(message_ex *request)
+{
+    double memory_usage = _stub->memory_budget_usage();
+    if (memory_usage >= 1.0) {
+        response_client_write(request, ERR_BUSY);
+        increment_throttling_counter(APP_COUNTER_WRITE_THROTTLING_REJECT_COUNT,
+                                     _counter_recent_write_throttling_reject_count);
+        return true;
+    }
+    if (FLAGS_write_backpressure_max_delay_ms == 0) {
+        return false;
+    }
+
+    int64_t delay_ms = throttling_controller::backpressure_delay_ms(
+        std::max(_primary_states.write_queue.window_usage(), memory_usage),
+        FLAGS_write_backpressure_start_percent / 100.0,
+        FLAGS_write_backpressure_max_delay_ms);
+    if (delay_ms <= 0) {
+        return false;
+    }
+    if (request->header->client.timeout_ms > 0) {
+        delay_ms = std::min<int64_t>(delay_ms, request->header->client.timeout_ms / 2);
+    }
+
+    delay_client_write(request, delay_ms);
+    increment_throttling_counter(APP_COUNTER_WRITE_BACKPRESSURE_DELAY_COUNT,
+                                 _counter_recent_write_backpressure_delay_count);
+    return true;
+}
+
+void replica::delay_client_write(message_ex *request, int64_t delay_ms)
+{
+    tasking::enqueue(LPC_WRITE_THROTTLING_DELAY,
+                     &_tracker,
+                     [ this, req = message_ptr(request) ]() { on_client_write(req, true); },
+                     get_gpid().thread_hash(),
+                     std::chrono::milliseconds(delay_ms));
+}
+
+void replica::increment_throttling_counter(app_counter_type type, perf_counter_wrapper &counter)
+{
+    _app_counter_shard.increment(type);
+    if (counter.get() != nullptr) {
+        counter->increment();
+    }
+}
+
+void replica::enqueue_fair_write(message_ex *request)
+{
+    write_fair_queue &queue = _primary_states.fair_queue;
+    if (queue.size() >= FLAGS_write_fair_queue_max_count) {
+        response_client_write(request, ERR_BUSY);
+        increment_throttling_counter(APP_COUNTER_WRITE_THROTTLING_REJECT_COUNT,
+                                     _counter_recent_write_throttling_reject_count);
+        return;
+    }
+    queue.push(request);
+    dispatch_fair_writes();
+}
+
+void replica::dispatch_fair_writes()
+{
+    write_fair_queue &queue = _primary_states.fair_queue;
+    while (!queue.empty() && _primary_states.write_queue.can_accept()) {
+        uint64_t queued_ms = 0;
+        message_ptr request = queue.pop(queued_ms);
+        int timeout_ms = request->header->client.timeout_ms;
+        if (timeout_ms > 0 && queued_ms >= static_cast<uint64_t>(timeout_ms)) {
+            // the client has given up, so don't waste the capacity on it
+            response_client_write(request, ERR_TIMEOUT);
+            continue;
+        }
+        add_client_write(request);
+    }
+}
+
 void replica::update_throttle_envs(const std::map<std::string, std::string> &envs)
 {
     update_throttle_env_internal(
         envs, replica_envs::WRITE_QPS_THROTTLING, _write_qps_throttling_controller);
     update_throttle_env_internal(
         envs, replica_envs::WRITE_SIZE_THROTTLING, _write_size_throttling_controller);
+
+    bool changed = false;
+    std::string old_value;
+    std::string parse_error;
+    write_fair_queue &queue = _primary_states.fair_queue;
+    auto find = envs.find(replica_envs::WRITE_FAIR_QUEUING);
+    if (find != envs.end()) {
+        if (!queue.parse_from_env(find->second, parse_error, changed, old_value)) {
+            dwarn_replica("parse env failed, key = \"{}\", value = \"{}\", error = \"{}\"",
+                          replica_envs::WRITE_FAIR_QUEUING,
+                          find->second,
+                          parse_error);
+            queue.reset(changed, old_value);
+        }
+    } else {
+        queue.reset(changed, old_value);
+    }
+    if (changed) {
+        ddebug_replica("switch {} from \"{}\" to \"{}\"",
+                       replica_envs::WRITE_FAIR_QUEUING,
+                       old_value,
+                       queue.env_value());
+    }
 }
 
 void replica::update_throttle_env_internal(const std::map<std::string, std::string> &envs,
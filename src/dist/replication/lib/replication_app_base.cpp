@@ -571,6 +571,96 @@ int replication_app_base::on_batched_write_requests(int64_t decree,
     return ERR_OK;
 }
 
+::dsn::error_code
+replication_app_base::apply_mutations(const std::vector<const mutation *> &mutations)
+{
+    // ingestion requests are applied alone, see apply_mutation()
+    bool batched = support_batched_mutations() && mutations.size() > 1;
+    for (const mutation *mu : mutations) {
+        for (const mutation_update &update : mu->data.updates) {
+            if (update.code == dsn::apps::RPC_RRDB_RRDB_BULK_LOAD) {
+                batched = false;
+            }
+        }
+    }
+    if (!batched) {
+        for (const mutation *mu : mutations) {
+            error_code err = apply_mutation(mu);
+            if (err != ERR_OK) {
+                return err;
+            }
+        }
+        return ERR_OK;
+    }
+
+    FAIL_POINT_INJECT_F("replication_app_base_apply_mutation",
+                        [](dsn::string_view) { return ERR_OK; });
+
+    std::vector<dsn::message_ex *> batched_requests;
+    std::vector<dsn::message_ex *> faked_requests;
+    decree d = last_committed_decree();
+    for (const mutation *mu : mutations) {
+        dassert(mu->data.header.decree == ++d,
+                "invalid mutation decree, decree = %" PRId64 " VS %" PRId64 "",
+                mu->data.header.decree,
+                d);
+        dassert(mu->data.updates.size() == mu->client_requests.size(),
+                "invalid mutation size, %d VS %d",
+                (int)mu->data.updates.size(),
+                (int)mu->client_requests.size());
+        for (size_t i = 0; i < mu->data.updates.size(); i++) {
+            const mutation_update &update = mu->data.updates[i];
+            if (update.code == RPC_REPLICATION_WRITE_EMPTY) {
+                continue;
+            }
+            dsn::message_ex *req = mu->client_requests[i];
+            if (req == nullptr) {
+                req = dsn::message_ex::create_received_request(
+                    update.code,
+                    (dsn_msg_serialize_format)update.serialization_type,
+                    (void *)update.data.data(),
+                    update.data.length());
+                faked_requests.push_back(req);
+            }
+            batched_requests.push_back(req);
+        }
+    }
+
+    const mutation *last = mutations.back();
+    int perror = on_batched_write_requests(last->data.header.decree,
+                                           last->data.header.timestamp,
+                                           batched_requests.data(),
+                                           static_cast<int>(batched_requests.size()));
+
+    for (dsn::message_ex *req : faked_requests) {
+        req->release_ref();
+    }
+
+    if (perror != 0) {
+        derror("%s: mutations [%s, %s]: get internal error %d",
+               _replica->name(),
+               mutations.front()->name(),
+               last->name(),
+               perror);
+        return ERR_LOCAL_APP_FAILURE;
+    }
+
+    _last_committed_decree.store(last->data.header.decree);
+
+    if (_replica->verbose_commit_log()) {
+        ddebug("%s: mutations [%s, %s] committed in batch on %s, batched_count = %d",
+               _replica->name(),
+               mutations.front()->name(),
+               last->name(),
+               enum_to_string(_replica->status()),
+               static_cast<int>(batched_requests.size()));
+    }
+
+    _replica->update_commit_qps(static_cast<int>(batched_requests.size()));
+
+    return ERR_OK;
+}
+
 ::dsn::error_code replication_app_base::update_init_info(replica *r,
                                                          int64_t shared_log_offset,
                                                          int64_t private_log_offset,
@@ -30,6 +30,8 @@
 #include <dsn/utility/string_conv.h>
 #include <dsn/utility/strings.h>
 
+#include <cmath>
+
 namespace dsn {
 namespace replication {
 
@@ -40,8 +42,7 @@ throttling_controller::throttling_controller()
       _delay_ms(0),
       _reject_units(0),
       _reject_delay_ms(0),
-      _last_request_time(0),
-      _cur_units(0)
+      _burst_units(0)
 {
 }
 
@@ -66,11 +67,14 @@ bool throttling_controller::parse_from_env(const std::string &env_value,
     bool reject_parsed = false;
     int64_t reject_units = 0;
     int64_t reject_delay_ms = 0;
+    bool burst_parsed = false;
+    int64_t burst_units = 0;
     for (std::string &s : sargs) {
         std::vector<std::string> sargs1;
         utils::split_args(s.c_str(), sargs1, '*', true);
-        if (sargs1.size() != 3) {
-            parse_error = "invalid field count, should be 3";
+        bool is_burst = sargs1.size() == 2 && sargs1[1] == "burst";
+        if (sargs1.size() != 3 && !is_burst) {
+            parse_error = "invalid field count, should be 3, or 2 for burst";
             return false;
         }
 
@@ -92,6 +96,16 @@ bool throttling_controller::parse_from_env(const std::string &env_value,
         }
         units *= unit_multiplier;
 
+        if (is_burst) {
+            if (burst_parsed) {
+                parse_error = "duplicate burst config";
+                return false;
+            }
+            burst_parsed = true;
+            burst_units = units / partition_count + 1;
+            continue;
+        }
+
         int64_t ms = 0;
         if (!buf2int64(sargs1[2], ms) || ms < 0) {
             parse_error = "invalid delay ms, should be non-negative int";
@@ -127,6 +141,10 @@ bool throttling_controller::parse_from_env(const std::string &env_value,
     _delay_ms = delay_ms;
     _reject_units = reject_units;
     _reject_delay_ms = reject_delay_ms;
+    _burst_units = burst_units;
+    // start with full buckets
+    _delay_bucket.reset(0);
+    _reject_bucket.reset(0);
     return true;
 }
 
@@ -142,8 +160,7 @@ void throttling_controller::reset(bool &changed, std::string &old_env_value)
         _delay_ms = 0;
         _reject_units = 0;
         _reject_delay_ms = 0;
-        _last_request_time = 0;
-        _cur_units = 0;
+        _burst_units = 0;
     } else {
         changed = false;
     }
@@ -152,31 +169,58 @@ void throttling_controller::reset(bool &changed, std::string &old_env_value)
 throttling_controller::throttling_type throttling_controller::control(
     const int64_t client_timeout_ms, int32_t request_units, int64_t &delay_ms)
 {
-    int64_t now_s = dsn_now_s();
-    if (now_s != _last_request_time) {
-        _cur_units = 0;
-        _last_request_time = now_s;
-    }
-    _cur_units += request_units;
-    if (_reject_units > 0 && _cur_units > _reject_units) {
-        _cur_units -= request_units;
-        if (client_timeout_ms > 0) {
-            delay_ms = std::min(_reject_delay_ms, client_timeout_ms / 2);
-        } else {
-            delay_ms = _reject_delay_ms;
+    return control(client_timeout_ms, request_units, dsn_now_ns() / 1e9, delay_ms);
+}
+
+throttling_controller::throttling_type throttling_controller::control(
+    const int64_t client_timeout_ms, int32_t request_units, double now_s, int64_t &delay_ms)
+{
+    double units = std::max(request_units, 1);
+    if (_reject_units > 0) {
+        // a request larger than the burst is let go by a full bucket
+        double burst = std::max<double>(std::max(_burst_units, _reject_units), units);
+        if (!_reject_bucket.consume(units, _reject_units, burst, now_s)) {
+            if (client_timeout_ms > 0) {
+                delay_ms = std::min(_reject_delay_ms, client_timeout_ms / 2);
+            } else {
+                delay_ms = _reject_delay_ms;
+            }
+            return REJECT;
         }
-        return REJECT;
     }
-    if (_delay_units > 0 && _cur_units > _delay_units) {
-        if (client_timeout_ms > 0) {
-            delay_ms = std::min(_delay_ms, client_timeout_ms / 2);
-        } else {
-            delay_ms = _delay_ms;
+    if (_delay_units > 0) {
+        double burst = std::max<double>(_burst_units > 0 ? _burst_units : _delay_units, units);
+        // take the units in advance, and wait until they are refilled
+        double wait_s =
+            _delay_bucket.consumeWithBorrowNonBlocking(units, _delay_units, burst, now_s).get();
+        delay_ms = std::llround(wait_s * 1000);
+        if (delay_ms > 0) {
+            if (delay_ms > _delay_ms) {
+                // don't pile up the debt beyond the max delay, or the requests would be delayed
+                // long after the load drops
+                _delay_bucket.returnTokens(units, _delay_units);
+                delay_ms = _delay_ms;
+            }
+            if (client_timeout_ms > 0) {
+                delay_ms = std::min(delay_ms, client_timeout_ms / 2);
+            }
+            return DELAY;
         }
-        return DELAY;
     }
     return PASS;
 }
 
+/*static*/ int64_t
+throttling_controller::backpressure_delay_ms(double usage, double start_usage, int64_t max_delay_ms)
+{
+    if (usage <= start_usage) {
+        return 0;
+    }
+    if (usage >= 1.0 || start_usage >= 1.0) {
+        return max_delay_ms;
+    }
+    return static_cast<int64_t>(max_delay_ms * (usage - start_usage) / (1.0 - start_usage));
+}
+
 } // namespace replication
 } // namespace dsn
@@ -29,6 +29,8 @@
 #include <stdint.h>
 #include <string>
 
+#include <dsn/utility/TokenBucket.h>
+
 namespace dsn {
 
 namespace replication {
@@ -39,6 +41,13 @@ namespace replication {
 // For size-based throttling, request_units is the bytes size of the incoming
 // request.
 //
+// The units of each partition are limited by token buckets refilled at the configured units per
+// second, so that the requests are throttled smoothly rather than by a counter reset at each
+// second. The env is in the format of "<units>*delay*<ms>,<units>*reject*<ms>,<units>*burst",
+// in which the burst is the max units taken at once by the delay rate, one second of units by
+// default. A request over the delay rate is delayed until its units are refilled, up to <ms> of
+// delay, and a request over the reject rate is rejected.
+//
 // not thread safe
 class throttling_controller
 {
@@ -82,6 +91,16 @@ public:
     // 'delay_ms' is set when the return type is not PASS.
     throttling_type
     control(const int64_t client_timeout_ms, int32_t request_units, /*out*/ int64_t &delay_ms);
+    // the same as above with the current time in seconds, for testing
+    throttling_type control(const int64_t client_timeout_ms,
+                            int32_t request_units,
+                            double now_s,
+                            /*out*/ int64_t &delay_ms);
+
+    // The delay to feed back the pressure of a resource smoothly before its hard limit is hit.
+    // 'usage' is how full the resource is, in [0, 1] of the hard limit. The delay is 0 below
+    // 'start_usage', and grows linearly to 'max_delay_ms' at the hard limit.
+    static int64_t backpressure_delay_ms(double usage, double start_usage, int64_t max_delay_ms);
 
 private:
     friend class throttling_controller_test;
@@ -93,8 +112,9 @@ private:
     int64_t _delay_ms;        // should >= 0
     int64_t _reject_units;    // should >= 0
     int64_t _reject_delay_ms; // should >= 0
-    int64_t _last_request_time;
-    int64_t _cur_units;
+    int64_t _burst_units;     // 0 means one second of units
+    folly::DynamicTokenBucket _delay_bucket;
+    folly::DynamicTokenBucket _reject_bucket;
 };
 
 } // namespace replication
@@ -0,0 +1,139 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "write_fair_queue.h"
+
+#include <dsn/c/api_layer1.h>
+#include <dsn/utility/string_conv.h>
+#include <dsn/utility/strings.h>
+
+namespace dsn {
+namespace replication {
+
+// the idle flows are removed once there are more than this
+static const size_t MAX_IDLE_FLOWS = 1024;
+
+bool write_fair_queue::parse_from_env(const std::string &env_value,
+                                      std::string &parse_error,
+                                      bool &changed,
+                                      std::string &old_env_value)
+{
+    changed = false;
+    if (env_value == _env_value) {
+        return true;
+    }
+    std::vector<std::string> sargs;
+    utils::split_args(env_value.c_str(), sargs, ',', true);
+    if (sargs.empty()) {
+        parse_error = "empty env value";
+        return false;
+    }
+    std::unordered_map<uint32_t, uint32_t> weights;
+    uint32_t default_weight = 1;
+    for (const std::string &s : sargs) {
+        std::vector<std::string> sargs1;
+        utils::split_args(s.c_str(), sargs1, '*', true);
+        if (sargs1.size() != 2) {
+            parse_error = "invalid field count, should be 2";
+            return false;
+        }
+        uint32_t weight = 0;
+        if (!buf2uint32(sargs1[1], weight) || weight == 0) {
+            parse_error = "invalid weight, should be positive int";
+            return false;
+        }
+        if (sargs1[0] == "default") {
+            default_weight = weight;
+            continue;
+        }
+        uint32_t ip = rpc_address::ipv4_from_host(sargs1[0].c_str());
+        if (ip == 0) {
+            parse_error = "invalid client ip";
+            return false;
+        }
+        weights[ip] = weight;
+    }
+
+    changed = true;
+    old_env_value = _env_value;
+    _env_value = env_value;
+    _weights = std::move(weights);
+    _default_weight = default_weight;
+    return true;
+}
+
+void write_fair_queue::reset(bool &changed, std::string &old_env_value)
+{
+    changed = false;
+    if (enabled()) {
+        changed = true;
+        old_env_value = _env_value;
+        _env_value.clear();
+        _weights.clear();
+        _default_weight = 1;
+    }
+}
+
+uint32_t write_fair_queue::weight_of(uint32_t ip) const
+{
+    auto it = _weights.find(ip);
+    return it == _weights.end() ? _default_weight : it->second;
+}
+
+void write_fair_queue::push(message_ex *request)
+{
+    uint32_t ip = request->header->from_address.ip();
+    flow &f = _flows[ip];
+    double start = std::max(_virtual_time, f.finish);
+    size_t bytes = std::max<size_t>(request->body_size(), 1);
+    f.finish = start + static_cast<double>(bytes) / weight_of(ip);
+    if (f.requests.empty()) {
+        _heads.emplace(start, ip);
+    }
+    f.requests.push_back(entry{start, dsn_now_coarse_ms(), request});
+    _count++;
+}
+
+message_ptr write_fair_queue::pop(uint64_t &queued_ms)
+{
+    if (_heads.empty()) {
+        return nullptr;
+    }
+
+    uint32_t ip = _heads.begin()->second;
+    _heads.erase(_heads.begin());
+    flow &f = _flows[ip];
+    entry e = std::move(f.requests.front());
+    f.requests.pop_front();
+    _count--;
+    if (!f.requests.empty()) {
+        _heads.emplace(f.requests.front().start, ip);
+    }
+
+    _virtual_time = e.start;
+    queued_ms = dsn_now_coarse_ms() - e.enqueue_ms;
+
+    // the flows idle since before the virtual time have no credit to keep
+    if (_flows.size() > MAX_IDLE_FLOWS + _heads.size()) {
+        for (auto it = _flows.begin(); it != _flows.end();) {
+            if (it->second.requests.empty() && it->second.finish <= _virtual_time) {
+                it = _flows.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    return e.request;
+}
+
+void write_fair_queue::clear()
+{
+    _flows.clear();
+    _heads.clear();
+    _count = 0;
+    _virtual_time = 0;
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,84 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <dsn/tool-api/rpc_message.h>
+
+#include <deque>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+namespace dsn {
+namespace replication {
+
+// write_fair_queue shares the write capacity of a primary among its clients, keyed by the client
+// ip, by start-time fair queuing: each request gets a virtual start time which is the later one
+// of the current virtual time and the finish time of the last request of the same client, and
+// the client's finish time is pushed forward by its bytes divided by its weight. The requests
+// are popped in the order of their start times, so a client sending more than its share only
+// queues behind itself instead of the others.
+//
+// The weights are configured by the app env "replica.write_fair_queuing" in the format of
+// "<client ip>*<weight>,...", in which "default*<weight>" is the weight of the clients not
+// listed, 1 if not set.
+//
+// not thread safe
+class write_fair_queue
+{
+public:
+    // see throttling_controller::parse_from_env() for the parameters
+    bool parse_from_env(const std::string &env_value,
+                        /*out*/ std::string &parse_error,
+                        /*out*/ bool &changed,
+                        /*out*/ std::string &old_env_value);
+
+    // disables the fair queuing, the queued requests are kept to be popped
+    void reset(/*out*/ bool &changed, /*out*/ std::string &old_env_value);
+
+    bool enabled() const { return !_env_value.empty(); }
+    const std::string &env_value() const { return _env_value; }
+
+    void push(message_ex *request);
+
+    // pops the request of the earliest start time, `queued_ms` is how long it was queued
+    message_ptr pop(/*out*/ uint64_t &queued_ms);
+
+    bool empty() const { return _count == 0; }
+    size_t size() const { return _count; }
+
+    // drops all the queued requests, the clients will get timeout
+    void clear();
+
+private:
+    friend class write_fair_queue_test;
+
+    struct entry
+    {
+        double start;
+        uint64_t enqueue_ms;
+        message_ptr request;
+    };
+    struct flow
+    {
+        std::deque<entry> requests;
+        double finish{0};
+    };
+
+    uint32_t weight_of(uint32_t ip) const;
+
+    std::string _env_value;
+    std::unordered_map<uint32_t, uint32_t> _weights;
+    uint32_t _default_weight{1};
+
+    double _virtual_time{0};
+    std::unordered_map<uint32_t, flow> _flows;
+    // the start times of the head requests of the backlogged flows
+    std::set<std::pair<double, uint32_t>> _heads;
+    size_t _count{0};
+};
+
+} // namespace replication
+} // namespace dsn
@@ -155,6 +155,8 @@ void app_env_validator::register_all_validators()
          std::bind(&check_rocksdb_iteration, std::placeholders::_1, std::placeholders::_2)},
         // TODO(zhaoliwei): not implemented
         {replica_envs::BUSINESS_INFO, nullptr},
+        {replica_envs::POOL_GROUP, nullptr},
+        {replica_envs::WRITE_FAIR_QUEUING, nullptr},
         {replica_envs::DENY_CLIENT_WRITE, nullptr},
         {replica_envs::TABLE_LEVEL_DEFAULT_TTL, nullptr},
         {replica_envs::ROCKSDB_USAGE_SCENARIO, nullptr},
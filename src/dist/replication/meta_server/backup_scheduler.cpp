@@ -0,0 +1,100 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "backup_scheduler.h"
+
+#include <algorithm>
+
+namespace dsn {
+namespace replication {
+
+bool backup_scheduler::try_acquire(const std::string &policy_name,
+                                   gpid pid,
+                                   const rpc_address &node,
+                                   const std::string &disk_tag)
+{
+    zauto_lock l(_lock);
+    slot_key key(policy_name, pid);
+    if (_slots.find(key) != _slots.end()) {
+        return true;
+    }
+
+    int &node_count = _node_counts[node];
+    if (_max_per_node > 0 && node_count >= static_cast<int>(_max_per_node)) {
+        return false;
+    }
+    if (!disk_tag.empty()) {
+        int &disk_count = _disk_counts[std::make_pair(node, disk_tag)];
+        if (_max_per_disk > 0 && disk_count >= static_cast<int>(_max_per_disk)) {
+            return false;
+        }
+        ++disk_count;
+    }
+    ++node_count;
+    _slots.emplace(std::move(key), slot{node, disk_tag});
+    return true;
+}
+
+void backup_scheduler::release(const std::string &policy_name, gpid pid)
+{
+    zauto_lock l(_lock);
+    auto it = _slots.find(slot_key(policy_name, pid));
+    if (it != _slots.end()) {
+        release_slot_unlocked(it->second);
+        _slots.erase(it);
+    }
+}
+
+void backup_scheduler::release_all(const std::string &policy_name)
+{
+    zauto_lock l(_lock);
+    for (auto it = _slots.begin(); it != _slots.end();) {
+        if (it->first.first == policy_name) {
+            release_slot_unlocked(it->second);
+            it = _slots.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void backup_scheduler::release_slot_unlocked(const slot &s)
+{
+    if (--_node_counts[s.node] == 0) {
+        _node_counts.erase(s.node);
+    }
+    if (!s.disk_tag.empty()) {
+        auto key = std::make_pair(s.node, s.disk_tag);
+        if (--_disk_counts[key] == 0) {
+            _disk_counts.erase(key);
+        }
+    }
+}
+
+int backup_scheduler::running_count(const rpc_address &node) const
+{
+    zauto_lock l(_lock);
+    auto it = _node_counts.find(node);
+    return it == _node_counts.end() ? 0 : it->second;
+}
+
+int backup_scheduler::running_count(const rpc_address &node, const std::string &disk_tag) const
+{
+    zauto_lock l(_lock);
+    auto it = _disk_counts.find(std::make_pair(node, disk_tag));
+    return it == _disk_counts.end() ? 0 : it->second;
+}
+
+/*static*/ std::chrono::milliseconds backup_scheduler::poll_delay(
+    int polls, std::chrono::milliseconds period, std::chrono::milliseconds max_delay)
+{
+    std::chrono::milliseconds delay = period;
+    for (int i = 0; i < polls && delay < max_delay; ++i) {
+        delay *= 2;
+    }
+    return std::min(delay, std::max(period, max_delay));
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,71 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <string>
+
+#include <dsn/tool-api/gpid.h>
+#include <dsn/tool-api/rpc_address.h>
+#include <dsn/tool-api/zlocks.h>
+
+namespace dsn {
+namespace replication {
+
+///
+/// backup_scheduler limits the partitions under backup on each replica server, and on each
+/// disk of it, among all the backup policies. A policy acquires a slot for a partition before
+/// sending it the first backup request, and releases the slot once the partition finishes.
+///
+class backup_scheduler
+{
+public:
+    // 0 means no limit
+    backup_scheduler(uint32_t max_per_node, uint32_t max_per_disk)
+        : _max_per_node(max_per_node), _max_per_disk(max_per_disk)
+    {
+    }
+
+    // return true if the backup of `pid` by `policy_name` is allowed to run on the disk of
+    // `disk_tag` of `node`, where an empty disk tag is not limited; the slot is kept until
+    // release() even if the primary of the partition moves
+    bool try_acquire(const std::string &policy_name,
+                     gpid pid,
+                     const rpc_address &node,
+                     const std::string &disk_tag);
+    void release(const std::string &policy_name, gpid pid);
+    // release all the slots of `policy_name`, e.g. when its backup is restarted
+    void release_all(const std::string &policy_name);
+
+    int running_count(const rpc_address &node) const;
+    int running_count(const rpc_address &node, const std::string &disk_tag) const;
+
+    // the delay of the next poll of a partition under backup after `polls` polls, which
+    // doubles from `period` up to `max_delay`
+    static std::chrono::milliseconds
+    poll_delay(int polls, std::chrono::milliseconds period, std::chrono::milliseconds max_delay);
+
+private:
+    struct slot
+    {
+        rpc_address node;
+        std::string disk_tag;
+    };
+    typedef std::pair<std::string, gpid> slot_key;
+
+    void release_slot_unlocked(const slot &s);
+
+    const uint32_t _max_per_node;
+    const uint32_t _max_per_disk;
+
+    mutable zlock _lock;
+    std::map<slot_key, slot> _slots;
+    std::map<rpc_address, int> _node_counts;
+    std::map<std::pair<rpc_address, std::string>, int> _disk_counts;
+};
+
+} // namespace replication
+} // namespace dsn
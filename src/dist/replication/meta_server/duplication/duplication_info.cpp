@@ -134,31 +134,55 @@ bool duplication_info::alter_progress(int partition_index, decree d)
     if (!p.is_inited) {
         return false;
     }
-    if (p.is_altering) {
+    if (p.volatile_decree >= d) {
         return false;
     }
-    if (p.volatile_decree < d) {
-        p.volatile_decree = d;
+    p.volatile_decree = d;
+    return true;
+}
+
+bool duplication_info::begin_persist_progress(blob &value)
+{
+    zauto_write_lock l(_lock);
+
+    if (_is_progress_altering) {
+        return false;
+    }
+    // progress update is not supposed to be too frequent.
+    if (dsn_now_ms() <= _last_progress_update_ms + PROGRESS_UPDATE_PERIOD_MS) {
+        return false;
     }
-    if (p.volatile_decree != p.stored_decree) {
-        // progress update is not supposed to be too frequent.
-        if (dsn_now_ms() > p.last_progress_update_ms + PROGRESS_UPDATE_PERIOD_MS) {
-            p.is_altering = true;
-            p.last_progress_update_ms = dsn_now_ms();
-            return true;
+
+    bool changed = false;
+    _altering_progress.clear();
+    for (const auto &kv : _progress) {
+        if (!kv.second.is_inited) {
+            continue;
         }
+        _altering_progress[kv.first] = kv.second.volatile_decree;
+        changed = changed || kv.second.volatile_decree != kv.second.stored_decree;
     }
-    return false;
+    if (!changed) {
+        _altering_progress.clear();
+        return false;
+    }
+
+    _is_progress_altering = true;
+    _last_progress_update_ms = dsn_now_ms();
+    value = json::json_forwarder<std::map<int, decree>>::encode(_altering_progress);
+    return true;
 }
 
-void duplication_info::persist_progress(int partition_index)
+void duplication_info::persist_progress()
 {
     zauto_write_lock l(_lock);
 
-    auto &p = _progress[partition_index];
-    dassert_dup(p.is_altering, this, "partition_index: {}", partition_index);
-    p.is_altering = false;
-    p.stored_decree = p.volatile_decree;
+    dassert_dup(_is_progress_altering, this, "persist progress that is not altering");
+    for (const auto &kv : _altering_progress) {
+        _progress[kv.first].stored_decree = kv.second;
+    }
+    _altering_progress.clear();
+    _is_progress_altering = false;
 }
 
 void duplication_info::persist_status()
@@ -91,14 +91,22 @@ public:
     bool is_valid() const { return is_duplication_status_valid(_status); }
 
     ///
-    /// alter_progress -> persist_progress
+    /// alter_progress -> begin_persist_progress -> persist_progress
     ///
 
-    // Returns: false if `d` is not supposed to be persisted,
-    //          maybe because meta storage is busy or `d` is stale.
+    // Updates the in-memory confirmed decree of the partition.
+    // Returns: false if `d` is stale or the partition is not initialized.
     bool alter_progress(int partition_index, decree d);
 
-    void persist_progress(int partition_index);
+    // The progress of all partitions is persisted in one write, at most once
+    // per PROGRESS_UPDATE_PERIOD_MS.
+    // Returns: false if the progress is not supposed to be persisted now,
+    //          maybe because meta storage is busy, it's too frequent or nothing changed.
+    //          Otherwise `value` is the json of the progress to persist.
+    bool begin_persist_progress(/*out*/ blob &value);
+
+    // call this function after the progress has been persisted on meta storage.
+    void persist_progress();
 
     void init_progress(int partition_index, decree confirmed);
 
@@ -164,14 +172,18 @@ private:
     {
         int64_t volatile_decree{invalid_decree};
         int64_t stored_decree{invalid_decree};
-        bool is_altering{false};
-        uint64_t last_progress_update_ms{0};
         bool is_inited{false};
     };
 
     // partition_idx => progress
     std::map<int, partition_progress> _progress;
 
+    // Whether there's ongoing meta storage update of progress, whose
+    // values are in `_altering_progress`.
+    bool _is_progress_altering{false};
+    std::map<int, decree> _altering_progress;
+    uint64_t _last_progress_update_ms{0};
+
     uint64_t _last_progress_report_ms{0};
 
     duplication_status::type _status{duplication_status::DS_INIT};
@@ -271,6 +271,9 @@ void meta_duplication_service::duplication_sync(duplication_sync_rpc rpc)
     }
 
     /// update progress
+    // the progress of each dup is persisted in one write after all its partitions are updated,
+    // the response carries the in-memory progress that has been persisted
+    std::map<std::pair<int32_t, dupid_t>, duplication_info_s_ptr> updated_dups;
     for (const auto &kv : request.confirm_list) {
         gpid gpid = kv.first;
 
@@ -294,42 +297,37 @@ void meta_duplication_service::duplication_sync(duplication_sync_rpc rpc)
             if (!dup->is_valid()) {
                 continue;
             }
-            do_update_partition_confirmed(
-                dup, rpc, gpid.get_partition_index(), confirm.confirmed_decree);
+            if (dup->alter_progress(gpid.get_partition_index(), confirm.confirmed_decree)) {
+                updated_dups.emplace(std::make_pair(dup->app_id, dup->id), dup);
+            }
         }
     }
+    for (const auto &kv : updated_dups) {
+        do_update_progress(kv.second);
+    }
 }
 
-void meta_duplication_service::do_update_partition_confirmed(duplication_info_s_ptr &dup,
-                                                             duplication_sync_rpc &rpc,
-                                                             int32_t partition_idx,
-                                                             int64_t confirmed_decree)
+void meta_duplication_service::do_update_progress(const duplication_info_s_ptr &dup)
 {
-    if (dup->alter_progress(partition_idx, confirmed_decree)) {
-        std::string path = get_partition_path(dup, std::to_string(partition_idx));
-        blob value = blob::create_from_bytes(std::to_string(confirmed_decree));
-
-        _meta_svc->get_meta_storage()->get_data(std::string(path), [=](const blob &data) mutable {
-            if (data.length() == 0) {
-                _meta_svc->get_meta_storage()->create_node(
-                    std::string(path), std::move(value), [=]() mutable {
-                        dup->persist_progress(partition_idx);
-                        rpc.response().dup_map[dup->app_id][dup->id].progress[partition_idx] =
-                            confirmed_decree;
-                    });
-            } else {
-                _meta_svc->get_meta_storage()->set_data(
-                    std::string(path), std::move(value), [=]() mutable {
-                        dup->persist_progress(partition_idx);
-                        rpc.response().dup_map[dup->app_id][dup->id].progress[partition_idx] =
-                            confirmed_decree;
-                    });
-            }
-
-            // duplication_sync_rpc will finally be replied when confirmed points
-            // of all partitions are stored.
-        });
+    blob value;
+    if (!dup->begin_persist_progress(value)) {
+        return;
     }
+
+    std::string path = get_progress_path(dup);
+    _meta_svc->get_meta_storage()->get_data(std::string(path), [=](const blob &data) mutable {
+        auto on_persisted = [this, dup]() {
+            dup->persist_progress();
+            _counter_progress_persist_qps->increment();
+        };
+        if (data.length() == 0) {
+            _meta_svc->get_meta_storage()->create_node(
+                std::move(path), std::move(value), std::move(on_persisted));
+        } else {
+            _meta_svc->get_meta_storage()->set_data(
+                std::move(path), std::move(value), std::move(on_persisted));
+        }
+    });
 }
 
 std::shared_ptr<duplication_info>
@@ -404,6 +402,35 @@ void meta_duplication_service::recover_from_meta_state()
 // ThreadPool(WRITE): THREAD_POOL_META_STATE
 void meta_duplication_service::do_restore_duplication_progress(
     const duplication_info_s_ptr &dup, const std::shared_ptr<app_state> &app)
+{
+    // <app_path>/duplication/<dup_id>/progress
+    _meta_svc->get_meta_storage()->get_data(
+        get_progress_path(dup), [this, dup, app](const blob &value) {
+            if (value.size() == 0) {
+                // not found, restore from the nodes of partitions
+                do_restore_duplication_partition_progress(dup, app);
+                return;
+            }
+
+            std::map<int, decree> progress;
+            if (!json::json_forwarder<std::map<int, decree>>::decode(value, progress)) {
+                derror_dup(dup, "invalid progress {}", value.to_string());
+                do_restore_duplication_partition_progress(dup, app);
+                return;
+            }
+
+            for (int partition_idx = 0; partition_idx < app->partition_count; partition_idx++) {
+                auto it = progress.find(partition_idx);
+                dup->init_progress(partition_idx,
+                                   it == progress.end() ? invalid_decree : it->second);
+            }
+            ddebug_dup(dup, "initialize progress from metastore [{}]", value.to_string());
+        });
+}
+
+// ThreadPool(WRITE): THREAD_POOL_META_STATE
+void meta_duplication_service::do_restore_duplication_partition_progress(
+    const duplication_info_s_ptr &dup, const std::shared_ptr<app_state> &app)
 {
     for (int partition_idx = 0; partition_idx < app->partition_count; partition_idx++) {
         std::string str_pidx = std::to_string(partition_idx);
@@ -40,7 +40,13 @@ namespace replication {
 ///                                         "create_timestamp_ms": ...,
 ///                                      }
 ///
-///   <app_path>/duplication/<dup_id>/<partition_index> -> <confirmed_decree>
+///   <app_path>/duplication/<dup_id>/progress -> {
+///                                                  <partition_index>: <confirmed_decree>,
+///                                                  ...
+///                                               }
+///
+/// The confirmed decrees were stored in <app_path>/duplication/<dup_id>/<partition_index>
+/// before, which are only read when the progress node doesn't exist.
 ///
 /// Each app has an attribute called "duplicating" which indicates
 /// whether this app should prevent its unconfirmed WAL from being compacted.
@@ -52,6 +58,12 @@ public:
     {
         dassert(_state, "_state should not be null");
         dassert(_meta_svc, "_meta_svc should not be null");
+
+        _counter_progress_persist_qps.init_app_counter(
+            "eon.meta_duplication_service",
+            "dup.progress_persist_qps",
+            COUNTER_TYPE_RATE,
+            "the count of duplication progress writes to meta storage per second");
     }
 
     /// See replication.thrift for possible errors for each rpc.
@@ -81,13 +93,15 @@ private:
     void do_restore_duplication_progress(const duplication_info_s_ptr &dup,
                                          const std::shared_ptr<app_state> &app);
 
+    void do_restore_duplication_partition_progress(const duplication_info_s_ptr &dup,
+                                                   const std::shared_ptr<app_state> &app);
+
     void get_all_available_app(const node_state &ns,
                                std::map<int32_t, std::shared_ptr<app_state>> &app_map) const;
 
-    void do_update_partition_confirmed(duplication_info_s_ptr &dup,
-                                       duplication_sync_rpc &rpc,
-                                       int32_t partition_idx,
-                                       int64_t confirmed_decree);
+    // Persists the confirmed decrees of all partitions of `dup` in one write,
+    // if it's time to.
+    void do_update_progress(const duplication_info_s_ptr &dup);
 
     // Get zk path for duplication.
     std::string get_duplication_path(const app_state &app) const
@@ -103,6 +117,10 @@ private:
     {
         return dup->store_path + "/" + partition_idx;
     }
+    static std::string get_progress_path(const duplication_info_s_ptr &dup)
+    {
+        return dup->store_path + "/progress";
+    }
 
     // Create a new duplication from INIT state.
     // Thread-Safe
@@ -132,6 +150,8 @@ private:
     server_state *_state;
 
     meta_service *_meta_svc;
+
+    perf_counter_wrapper _counter_progress_persist_qps;
 };
 
 } // namespace replication
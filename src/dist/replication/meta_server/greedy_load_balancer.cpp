@@ -28,29 +28,74 @@
 #include <iostream>
 #include <queue>
 #include <dsn/tool-api/command_manager.h>
+#include <dsn/utility/crc.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/math.h>
 #include <dsn/dist/fmt_logging.h>
 #include "greedy_load_balancer.h"
 #include "meta_data.h"
+#include "meta_service.h"
+#include "server_state.h"
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_double("meta_server",
+                  balancer_load_tolerance_ratio,
+                  0.2,
+                  "in load-weighted mode, the primaries of an app are not moved for load unless "
+                  "the load of some node exceeds the average by this ratio");
+DSN_DEFINE_uint32("meta_server",
+                  balancer_load_max_moves_per_app,
+                  4,
+                  "in load-weighted mode, at most this count of primaries of an app are moved for "
+                  "load in a balance round, which bounds the cost of the migration");
+DSN_DEFINE_uint32("meta_server",
+                  balancer_max_copies_in_per_node,
+                  0,
+                  "at most this count of replicas are copied to a node in a balance round, 0 "
+                  "means no limit");
+DSN_TAG_VARIABLE(balancer_max_copies_in_per_node, FT_MUTABLE);
+DSN_DEFINE_uint32("meta_server",
+                  balancer_max_copies_out_per_node,
+                  0,
+                  "at most this count of replicas are copied from the primaries on a node in a "
+                  "balance round, 0 means no limit");
+DSN_TAG_VARIABLE(balancer_max_copies_out_per_node, FT_MUTABLE);
+DSN_DEFINE_uint64("meta_server",
+                  balancer_max_copy_mb_per_node,
+                  0,
+                  "at most this size of data in MB is copied to or from a node in a balance "
+                  "round, except that a single copy is always allowed, 0 means no limit");
+DSN_TAG_VARIABLE(balancer_max_copy_mb_per_node, FT_MUTABLE);
+DSN_DEFINE_uint32("meta_server",
+                  balancer_slow_disk_max_moves,
+                  16,
+                  "at most this count of replicas are moved off the fail-slow disks reported by "
+                  "the replica servers in a balance round, 0 to not move them");
+DSN_TAG_VARIABLE(balancer_slow_disk_max_moves, FT_MUTABLE);
+
 greedy_load_balancer::greedy_load_balancer(meta_service *_svc)
     : simple_load_balancer(_svc),
       _ctrl_balancer_in_turn(nullptr),
       _ctrl_only_primary_balancer(nullptr),
       _ctrl_only_move_primary(nullptr),
+      _ctrl_incremental_balancer(nullptr),
+      _ctrl_load_weighted_balancer(nullptr),
       _get_balance_operation_count(nullptr)
 {
     if (_svc != nullptr) {
         _balancer_in_turn = _svc->get_meta_options()._lb_opts.balancer_in_turn;
         _only_primary_balancer = _svc->get_meta_options()._lb_opts.only_primary_balancer;
         _only_move_primary = _svc->get_meta_options()._lb_opts.only_move_primary;
+        _incremental_balancer = _svc->get_meta_options()._lb_opts.incremental_balancer;
+        _load_weighted_balancer = _svc->get_meta_options()._lb_opts.load_weighted_balancer;
     } else {
         _balancer_in_turn = false;
         _only_primary_balancer = false;
         _only_move_primary = false;
+        _incremental_balancer = false;
+        _load_weighted_balancer = false;
     }
 
     ::memset(t_operation_counters, 0, sizeof(t_operation_counters));
@@ -75,6 +120,15 @@ greedy_load_balancer::greedy_load_balancer(meta_service *_svc)
         "recent_balance_copy_secondary_count",
         COUNTER_TYPE_VOLATILE_NUMBER,
         "copy secondary count by balancer in the recent period");
+    _app_balance_plan_time_us.init_app_counter("eon.greedy_balancer",
+                                               "app_balance_plan_time_us",
+                                               COUNTER_TYPE_NUMBER_PERCENTILES,
+                                               "time used to plan the balance of an app");
+    _recent_balance_skipped_app_count.init_app_counter(
+        "eon.greedy_balancer",
+        "recent_balance_skipped_app_count",
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        "apps skipped by incremental balancer in the recent period");
 }
 
 greedy_load_balancer::~greedy_load_balancer()
@@ -82,6 +136,8 @@ greedy_load_balancer::~greedy_load_balancer()
     UNREGISTER_VALID_HANDLER(_ctrl_balancer_in_turn);
     UNREGISTER_VALID_HANDLER(_ctrl_only_primary_balancer);
     UNREGISTER_VALID_HANDLER(_ctrl_only_move_primary);
+    UNREGISTER_VALID_HANDLER(_ctrl_incremental_balancer);
+    UNREGISTER_VALID_HANDLER(_ctrl_load_weighted_balancer);
     UNREGISTER_VALID_HANDLER(_get_balance_operation_count);
 }
 
@@ -115,9 +171,27 @@ void greedy_load_balancer::register_ctrl_commands()
             return remote_command_set_bool_flag(_only_move_primary, "lb.only_move_primary", args);
         });
 
+    _ctrl_incremental_balancer = dsn::command_manager::instance().register_command(
+        {"meta.lb.incremental_balancer"},
+        "lb.incremental_balancer <true|false>",
+        "control whether skip the apps which are balanced and not changed",
+        [this](const std::vector<std::string> &args) {
+            return remote_command_set_bool_flag(
+                _incremental_balancer, "lb.incremental_balancer", args);
+        });
+
+    _ctrl_load_weighted_balancer = dsn::command_manager::instance().register_command(
+        {"meta.lb.load_weighted_balancer"},
+        "lb.load_weighted_balancer <true|false>",
+        "control whether balance the loads of the primaries once they are balanced by count",
+        [this](const std::vector<std::string> &args) {
+            return remote_command_set_bool_flag(
+                _load_weighted_balancer, "lb.load_weighted_balancer", args);
+        });
+
     _get_balance_operation_count = dsn::command_manager::instance().register_command(
         {"meta.lb.get_balance_operation_count"},
-        "lb.get_balance_operation_count [total | move_pri | copy_pri | copy_sec | detail]",
+        "lb.get_balance_operation_count [total | move_pri | copy_pri | copy_sec | detail | plan]",
         "get balance operation count",
         [this](const std::vector<std::string> &args) { return get_balance_operation_count(args); });
 
@@ -135,6 +209,8 @@ void greedy_load_balancer::unregister_ctrl_commands()
     UNREGISTER_VALID_HANDLER(_ctrl_balancer_in_turn);
     UNREGISTER_VALID_HANDLER(_ctrl_only_primary_balancer);
     UNREGISTER_VALID_HANDLER(_ctrl_only_move_primary);
+    UNREGISTER_VALID_HANDLER(_ctrl_incremental_balancer);
+    UNREGISTER_VALID_HANDLER(_ctrl_load_weighted_balancer);
     UNREGISTER_VALID_HANDLER(_get_balance_operation_count);
     UNREGISTER_VALID_HANDLER(_ctrl_balancer_ignored_apps);
 
@@ -163,6 +239,15 @@ std::string greedy_load_balancer::get_balance_operation_count(const std::vector<
                              ",copy_pri=" + std::to_string(t_operation_counters[COPY_PRI_COUNT]) +
                              ",copy_sec=" + std::to_string(t_operation_counters[COPY_SEC_COUNT]) +
                              ",total=" + std::to_string(t_operation_counters[ALL_COUNT]));
+    else if (args[0] == "plan")
+        result = std::string(
+            "planned_apps=" + std::to_string(t_last_plan_stats.planned_apps) + ",skipped_apps=" +
+            std::to_string(t_last_plan_stats.skipped_apps) + ",plan_time_us=" +
+            std::to_string(t_last_plan_stats.plan_time_us) + ",slowest_app=" +
+            std::to_string(t_last_plan_stats.slowest_app) + ",slowest_app_plan_time_us=" +
+            std::to_string(t_last_plan_stats.slowest_app_plan_time_us) + ",throttled_apps=" +
+            std::to_string(t_last_plan_stats.throttled_apps) + ",copy_mb=" +
+            std::to_string(t_last_plan_stats.copy_mb));
     else
         result = std::string("ERR: invalid arguments");
 
@@ -247,13 +332,26 @@ greedy_load_balancer::generate_balancer_request(const partition_configuration &p
     default:
         dassert(false, "");
     }
-    ddebug("generate balancer: %d.%d %s from %s of disk_tag(%s) to %s",
+
+    int64_t cost_mb = 0;
+    if (type != balance_type::move_primary) {
+        cost_mb = get_copy_cost_mb(pc);
+        migration_budget &source = t_migration_budgets[pc.primary];
+        source.copies_out++;
+        source.mb_out += cost_mb;
+        migration_budget &target = t_migration_budgets[to];
+        target.copies_in++;
+        target.mb_in += cost_mb;
+        t_plan_stats.copy_mb += cost_mb;
+    }
+    ddebug("generate balancer: %d.%d %s from %s of disk_tag(%s) to %s, cost(%" PRId64 "MB)",
            pc.pid.get_app_id(),
            pc.pid.get_partition_index(),
            ans.c_str(),
            from.to_string(),
            get_disk_tag(from, pc.pid).c_str(),
-           to.to_string());
+           to.to_string(),
+           cost_mb);
     return std::make_shared<configuration_balancer_request>(std::move(result));
 }
 
@@ -269,6 +367,54 @@ const std::string &greedy_load_balancer::get_disk_tag(const rpc_address &node, c
     return iter->disk_tag;
 }
 
+int64_t greedy_load_balancer::get_copy_cost_mb(const partition_configuration &pc)
+{
+    config_context &cc = *get_config_context(*(t_global_view->apps), pc.pid);
+    auto iter = cc.find_from_serving(pc.primary);
+    return iter == cc.serving.end() ? 0 : iter->storage_mb;
+}
+
+bool greedy_load_balancer::within_migration_budget(const rpc_address &source,
+                                                   const rpc_address &target,
+                                                   int64_t cost_mb)
+{
+    if (!t_throttle_migrations) {
+        return true;
+    }
+
+    migration_budget out, in;
+    auto iter = t_migration_budgets.find(source);
+    if (iter != t_migration_budgets.end()) {
+        out = iter->second;
+    }
+    iter = t_migration_budgets.find(target);
+    if (iter != t_migration_budgets.end()) {
+        in = iter->second;
+    }
+
+    bool within = true;
+    if (FLAGS_balancer_max_copies_out_per_node > 0 &&
+        out.copies_out >= static_cast<int>(FLAGS_balancer_max_copies_out_per_node)) {
+        within = false;
+    }
+    if (FLAGS_balancer_max_copies_in_per_node > 0 &&
+        in.copies_in >= static_cast<int>(FLAGS_balancer_max_copies_in_per_node)) {
+        within = false;
+    }
+    // a replica larger than the budget is copied alone, or it would never be balanced
+    if (FLAGS_balancer_max_copy_mb_per_node > 0) {
+        int64_t max_mb = static_cast<int64_t>(FLAGS_balancer_max_copy_mb_per_node);
+        if ((out.copies_out > 0 && out.mb_out + cost_mb > max_mb) ||
+            (in.copies_in > 0 && in.mb_in + cost_mb > max_mb)) {
+            within = false;
+        }
+    }
+    if (!within) {
+        t_migration_throttled = true;
+    }
+    return within;
+}
+
 // assume all nodes are alive
 bool greedy_load_balancer::copy_primary_per_app(const std::shared_ptr<app_state> &app,
                                                 bool still_have_less_than_average,
@@ -342,25 +488,42 @@ bool greedy_load_balancer::copy_primary_per_app(const std::shared_ptr<app_state>
 
         // select a primary on id_max and copy it to id_min.
         // the selected primary should on a disk which have
-        // most amount of primaries for current app.
+        // most amount of primaries for current app, and the smaller one is cheaper to copy.
         gpid selected_pid = {-1, -1};
         int *selected_load = nullptr;
+        int64_t selected_cost_mb = 0;
+        bool throttled = false;
         for (const gpid &pid : *pri) {
             if (t_migration_result->find(pid) == t_migration_result->end()) {
                 const std::string &dtag = get_disk_tag(address_vec[id_max], pid);
-                if (selected_load == nullptr || load_on_max[dtag] > *selected_load) {
-                    dinfo("%s: select gpid(%d.%d) on disk(%s), load(%d)",
+                int64_t cost_mb = get_copy_cost_mb(app->partitions[pid.get_partition_index()]);
+                if (!within_migration_budget(address_vec[id_max], address_vec[id_min], cost_mb)) {
+                    throttled = true;
+                    continue;
+                }
+                if (selected_load == nullptr || load_on_max[dtag] > *selected_load ||
+                    (load_on_max[dtag] == *selected_load && cost_mb < selected_cost_mb)) {
+                    dinfo("%s: select gpid(%d.%d) on disk(%s), load(%d), cost(%" PRId64 "MB)",
                           app->get_logname(),
                           pid.get_app_id(),
                           pid.get_partition_index(),
                           dtag.c_str(),
-                          load_on_max[dtag]);
+                          load_on_max[dtag],
+                          cost_mb);
                     selected_pid = pid;
                     selected_load = &load_on_max[dtag];
+                    selected_cost_mb = cost_mb;
                 }
             }
         }
 
+        if (selected_load == nullptr && throttled) {
+            ddebug("%s: stop the copy as the migration budget of %s or %s is used up",
+                   app->get_logname(),
+                   address_vec[id_max].to_string(),
+                   address_vec[id_min].to_string());
+            break;
+        }
         dassert(selected_pid.get_app_id() != -1 && selected_load != nullptr,
                 "can't find primry to copy from(%s) to(%s)",
                 address_vec[id_max].to_string(),
@@ -449,6 +612,7 @@ bool greedy_load_balancer::copy_secondary_per_app(const std::shared_ptr<app_stat
                future_partitions[max_id]);
 
         int *selected_load = nullptr;
+        int64_t selected_cost_mb = 0;
         gpid selected_pid;
         for (const gpid &pid : *all_partitions_max_load) {
             if (max_ns.served_as(pid) == partition_status::PS_PRIMARY) {
@@ -474,15 +638,28 @@ bool greedy_load_balancer::copy_secondary_per_app(const std::shared_ptr<app_stat
                 continue;
             }
 
+            const partition_configuration &pc = app->partitions[pid.get_partition_index()];
+            int64_t cost_mb = get_copy_cost_mb(pc);
+            if (!within_migration_budget(pc.primary, min_ns.addr(), cost_mb)) {
+                dinfo("%s: skip gpid(%d.%d) coz the migration budget is used up",
+                      app->get_logname(),
+                      pid.get_app_id(),
+                      pid.get_partition_index());
+                continue;
+            }
+
             int &load = node_loads[max_id][get_disk_tag(max_ns.addr(), pid)];
-            if (selected_load == nullptr || *selected_load < load) {
-                dinfo("%s: select gpid(%d.%d) as target, tag(%s), load(%d)",
+            if (selected_load == nullptr || *selected_load < load ||
+                (*selected_load == load && cost_mb < selected_cost_mb)) {
+                dinfo("%s: select gpid(%d.%d) as target, tag(%s), load(%d), cost(%" PRId64 "MB)",
                       app->get_logname(),
                       pid.get_app_id(),
                       pid.get_partition_index(),
                       get_disk_tag(max_ns.addr(), pid).c_str(),
-                      load);
+                      load,
+                      cost_mb);
                 selected_load = &load;
+                selected_cost_mb = cost_mb;
                 selected_pid = pid;
             }
         }
@@ -643,14 +820,21 @@ bool greedy_load_balancer::move_primary_based_on_flow_per_app(const std::shared_
             std::list<dsn::gpid>::iterator selected = potential_moving.end();
             int selected_score = std::numeric_limits<int>::min();
 
+            int64_t selected_qps = -1;
+
             for (std::list<dsn::gpid>::iterator it = potential_moving.begin();
                  it != potential_moving.end();
                  ++it) {
                 const config_context &cc = app->helpers->contexts[it->get_partition_index()];
                 int score =
                     (*prev_load)[get_disk_tag(from, *it)] - (*current_load)[get_disk_tag(to, *it)];
-                if (score > selected_score) {
+                // the hotter partition is preferred on a tie, so that the hot primaries are
+                // spread over the nodes
+                auto hot = t_hot_partition_qps.find(*it);
+                int64_t qps = hot == t_hot_partition_qps.end() ? 0 : hot->second;
+                if (score > selected_score || (score == selected_score && qps > selected_qps)) {
                     selected_score = score;
+                    selected_qps = qps;
                     selected = it;
                 }
             }
@@ -739,6 +923,9 @@ bool greedy_load_balancer::primary_balancer_per_app(const std::shared_ptr<app_st
     }
     if (higher_count == 0 && lower_count == 0) {
         dinfo("the primaries are balanced for app(%s:%d)", app->app_name.c_str(), app->app_id);
+        if (_load_weighted_balancer) {
+            return primary_load_balancer_per_app(app, replicas_low, replicas_high);
+        }
         return true;
     }
 
@@ -797,6 +984,307 @@ bool greedy_load_balancer::primary_balancer_per_app(const std::shared_ptr<app_st
     return move_primary_based_on_flow_per_app(app, prev, flow);
 }
 
+bool greedy_load_balancer::primary_load_balancer_per_app(const std::shared_ptr<app_state> &app,
+                                                         int replicas_low,
+                                                         int replicas_high)
+{
+    auto find_load = [this](const rpc_address &node, const gpid &pid) -> const replica_load * {
+        auto node_iter = t_replica_loads.find(node);
+        if (node_iter == t_replica_loads.end()) {
+            return nullptr;
+        }
+        auto iter = node_iter->second.find(pid);
+        return iter == node_iter->second.end() ? nullptr : &iter->second;
+    };
+
+    int64_t total_qps = 0;
+    int64_t total_write_bytes = 0;
+    for (const auto &pc : app->partitions) {
+        const replica_load *load =
+            pc.primary.is_invalid() ? nullptr : find_load(pc.primary, pc.pid);
+        if (load != nullptr) {
+            total_qps += load->qps;
+            total_write_bytes += load->write_bytes_per_sec;
+        }
+    }
+    if (total_qps == 0 && total_write_bytes == 0) {
+        dinfo("%s: no load is reported for the primaries", app->get_logname());
+        return true;
+    }
+
+    // the load of a primary is its share of the qps of the app plus its share of the write
+    // bytes, both reported by the node serving it
+    std::vector<double> weights(app->partition_count, 0);
+    std::map<rpc_address, double> node_loads;
+    std::map<rpc_address, int> primary_counts;
+    std::map<rpc_address, std::vector<int>> node_primaries;
+    for (const auto &kv : *(t_global_view->nodes)) {
+        node_loads[kv.first] = 0;
+        primary_counts[kv.first] = kv.second.primary_count(app->app_id);
+    }
+    for (const auto &pc : app->partitions) {
+        if (pc.primary.is_invalid() || node_loads.find(pc.primary) == node_loads.end()) {
+            continue;
+        }
+        const replica_load *load = find_load(pc.primary, pc.pid);
+        double &weight = weights[pc.pid.get_partition_index()];
+        if (load != nullptr && total_qps > 0) {
+            weight += static_cast<double>(load->qps) / total_qps;
+        }
+        if (load != nullptr && total_write_bytes > 0) {
+            weight += static_cast<double>(load->write_bytes_per_sec) / total_write_bytes;
+        }
+        node_loads[pc.primary] += weight;
+        node_primaries[pc.primary].push_back(pc.pid.get_partition_index());
+    }
+
+    double average = 0;
+    for (const auto &kv : node_loads) {
+        average += kv.second;
+    }
+    average /= node_loads.size();
+
+    // each partition is moved at most once in a round
+    std::vector<bool> moved(app->partition_count, false);
+    uint32_t moves = 0;
+    while (moves < FLAGS_balancer_load_max_moves_per_app) {
+        auto heaviest = std::max_element(node_loads.begin(),
+                                         node_loads.end(),
+                                         [](const std::pair<const rpc_address, double> &lhs,
+                                            const std::pair<const rpc_address, double> &rhs) {
+                                             return lhs.second < rhs.second;
+                                         });
+        const rpc_address from = heaviest->first;
+        double from_load = heaviest->second;
+        if (from_load <= average * (1 + FLAGS_balancer_load_tolerance_ratio)) {
+            break;
+        }
+
+        // moving the load `d` from `from` to `to` reduces the sum of the squares of the node
+        // loads by 2 * d * (from_load - to_load - d), so the move with the largest reduction is
+        // taken. A single move must keep the primary counts balanced, while a swap with a
+        // primary of `to` whose secondary is `from` keeps them unchanged.
+        double best_gain = 1e-9;
+        int best_out = -1;
+        int best_in = -1;
+        rpc_address best_to;
+        for (int out : node_primaries[from]) {
+            if (moved[out]) {
+                continue;
+            }
+            const partition_configuration &pc = app->partitions[out];
+            for (const rpc_address &to : pc.secondaries) {
+                auto to_iter = node_loads.find(to);
+                if (to_iter == node_loads.end()) {
+                    continue;
+                }
+                double gap = from_load - to_iter->second;
+                if (primary_counts[from] - 1 >= replicas_low &&
+                    primary_counts[to] + 1 <= replicas_high) {
+                    double gain = weights[out] * (gap - weights[out]);
+                    if (gain > best_gain) {
+                        best_gain = gain;
+                        best_out = out;
+                        best_in = -1;
+                        best_to = to;
+                    }
+                }
+                for (int in : node_primaries[to]) {
+                    if (moved[in] || !is_secondary(app->partitions[in], from)) {
+                        continue;
+                    }
+                    double d = weights[out] - weights[in];
+                    double gain = d * (gap - d);
+                    if (gain > best_gain) {
+                        best_gain = gain;
+                        best_out = out;
+                        best_in = in;
+                        best_to = to;
+                    }
+                }
+            }
+        }
+        if (best_out == -1) {
+            break;
+        }
+
+        const partition_configuration &out_pc = app->partitions[best_out];
+        t_migration_result->emplace(
+            out_pc.pid,
+            generate_balancer_request(out_pc, balance_type::move_primary, from, best_to));
+        moved[best_out] = true;
+        node_loads[from] -= weights[best_out];
+        node_loads[best_to] += weights[best_out];
+        ++moves;
+        if (best_in != -1) {
+            const partition_configuration &in_pc = app->partitions[best_in];
+            t_migration_result->emplace(
+                in_pc.pid,
+                generate_balancer_request(in_pc, balance_type::move_primary, best_to, from));
+            moved[best_in] = true;
+            node_loads[best_to] -= weights[best_in];
+            node_loads[from] += weights[best_in];
+            ++moves;
+        } else {
+            --primary_counts[from];
+            ++primary_counts[best_to];
+        }
+        ddebug("%s: move primary %d.%d from %s to %s%s to balance the load, load of %s: %.3f, "
+               "average: %.3f",
+               app->get_logname(),
+               out_pc.pid.get_app_id(),
+               out_pc.pid.get_partition_index(),
+               from.to_string(),
+               best_to.to_string(),
+               best_in == -1 ? "" : " in exchange for another one",
+               from.to_string(),
+               from_load,
+               average);
+    }
+    return true;
+}
+
+void greedy_load_balancer::collect_load_reports()
+{
+    t_hot_partition_qps.clear();
+    t_replica_loads.clear();
+    t_slow_disks.clear();
+    if (_svc == nullptr || _svc->get_server_state() == nullptr) {
+        return;
+    }
+    for (const auto &kv : _svc->get_server_state()->get_slow_disks()) {
+        t_slow_disks[kv.first].insert(kv.second.begin(), kv.second.end());
+    }
+    for (const auto &kv : _svc->get_server_state()->get_hot_partitions()) {
+        for (const auto &hotspot : kv.second) {
+            t_hot_partition_qps[hotspot.pid] += hotspot.read_qps + hotspot.write_qps;
+        }
+    }
+    if (_load_weighted_balancer) {
+        for (const auto &kv : _svc->get_server_state()->get_replica_loads()) {
+            auto &loads = t_replica_loads[kv.first];
+            for (const auto &load : kv.second) {
+                loads.emplace(load.pid, load);
+            }
+        }
+    }
+}
+
+bool greedy_load_balancer::is_on_slow_disk(const rpc_address &node, const gpid &pid)
+{
+    auto iter = t_slow_disks.find(node);
+    return iter != t_slow_disks.end() && iter->second.count(get_disk_tag(node, pid)) != 0;
+}
+
+int greedy_load_balancer::evacuate_slow_disks()
+{
+    if (t_slow_disks.empty() || FLAGS_balancer_slow_disk_max_moves == 0) {
+        return 0;
+    }
+
+    const app_mapper &apps = *t_global_view->apps;
+    const node_mapper &nodes = *t_global_view->nodes;
+    std::vector<std::pair<rpc_address, gpid>> primaries;
+    std::vector<std::pair<rpc_address, gpid>> secondaries;
+    for (const auto &kv : t_slow_disks) {
+        auto node_iter = nodes.find(kv.first);
+        if (node_iter == nodes.end() || !node_iter->second.alive()) {
+            continue;
+        }
+        const node_state &ns = node_iter->second;
+        ns.for_each_partition([&](const gpid &pid) {
+            auto app_iter = apps.find(pid.get_app_id());
+            if (app_iter == apps.end() || app_iter->second->status != app_status::AS_AVAILABLE ||
+                !is_on_slow_disk(ns.addr(), pid)) {
+                return true;
+            }
+            if (ns.served_as(pid) == partition_status::PS_PRIMARY) {
+                primaries.emplace_back(ns.addr(), pid);
+            } else {
+                secondaries.emplace_back(ns.addr(), pid);
+            }
+            return true;
+        });
+    }
+
+    int moves = 0;
+    const int max_moves = static_cast<int>(FLAGS_balancer_slow_disk_max_moves);
+    // the primaries are switched to the secondaries not on the slow disks, which have the
+    // fewest primaries
+    for (const auto &p : primaries) {
+        if (moves >= max_moves) {
+            break;
+        }
+        const gpid &pid = p.second;
+        if (t_migration_result->find(pid) != t_migration_result->end()) {
+            continue;
+        }
+        const partition_configuration &pc =
+            apps.at(pid.get_app_id())->partitions[pid.get_partition_index()];
+        rpc_address to;
+        for (const rpc_address &secondary : pc.secondaries) {
+            if (!is_node_alive(nodes, secondary) || is_on_slow_disk(secondary, pid)) {
+                continue;
+            }
+            if (to.is_invalid() ||
+                nodes.at(secondary).primary_count() < nodes.at(to).primary_count()) {
+                to = secondary;
+            }
+        }
+        if (to.is_invalid()) {
+            dwarn_f("can't move primary {} off the slow disk of {}, as no healthy secondary",
+                    pid,
+                    p.first);
+            continue;
+        }
+        t_migration_result->emplace(
+            pid, generate_balancer_request(pc, balance_type::move_primary, p.first, to));
+        ++moves;
+    }
+    if (!primaries.empty()) {
+        return moves;
+    }
+
+    // the secondaries are copied to the nodes without the partition, which have the fewest
+    // replicas, preferring those without slow disks
+    for (const auto &s : secondaries) {
+        if (moves >= max_moves) {
+            break;
+        }
+        const gpid &pid = s.second;
+        if (t_migration_result->find(pid) != t_migration_result->end()) {
+            continue;
+        }
+        const partition_configuration &pc =
+            apps.at(pid.get_app_id())->partitions[pid.get_partition_index()];
+        if (pc.primary.is_invalid()) {
+            continue;
+        }
+        rpc_address to;
+        bool to_has_slow_disks = false;
+        for (const auto &kv : nodes) {
+            const node_state &ns = kv.second;
+            if (!ns.alive() || ns.served_as(pid) != partition_status::PS_INACTIVE) {
+                continue;
+            }
+            bool has_slow_disks = t_slow_disks.find(ns.addr()) != t_slow_disks.end();
+            if (to.is_invalid() || (to_has_slow_disks && !has_slow_disks) ||
+                (to_has_slow_disks == has_slow_disks &&
+                 ns.partition_count() < nodes.at(to).partition_count())) {
+                to = ns.addr();
+                to_has_slow_disks = has_slow_disks;
+            }
+        }
+        if (to.is_invalid() || !within_migration_budget(pc.primary, to, get_copy_cost_mb(pc))) {
+            continue;
+        }
+        t_migration_result->emplace(
+            pid, generate_balancer_request(pc, balance_type::copy_secondary, s.first, to));
+        ++moves;
+    }
+    return moves;
+}
+
 bool greedy_load_balancer::all_replica_infos_collected(const node_state &ns)
 {
     dsn::rpc_address n = ns.addr();
@@ -827,6 +1315,36 @@ void greedy_load_balancer::greedy_balancer(const bool balance_checker)
         }
     }
 
+    // the replicas on the fail-slow disks are moved off before the others are balanced, which
+    // would otherwise move the primaries back
+    int evacuations = evacuate_slow_disks();
+    if (evacuations > 0 && !balance_checker) {
+        ddebug_f("stop to do more balance as {} replicas are moved off the slow disks",
+                 evacuations);
+        return;
+    }
+
+    // forget the dropped apps, or all the apps if incremental mode is disabled
+    for (balanced_apps *balanced : {&_primary_balanced_apps, &_secondary_balanced_apps}) {
+        if (!_incremental_balancer) {
+            balanced->clear();
+            continue;
+        }
+        for (auto iter = balanced->begin(); iter != balanced->end();) {
+            auto app_iter = apps.find(iter->first);
+            if (app_iter == apps.end() || app_iter->second->status != app_status::AS_AVAILABLE) {
+                iter = balanced->erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+
+    uint64_t round_signature = _incremental_balancer ? get_round_signature() : 0;
+    std::unordered_map<app_id, uint64_t> app_signatures;
+    // apps which got primary balance actions in this round
+    std::set<app_id> primary_moved_apps;
+
     for (const auto &kv : apps) {
         const std::shared_ptr<app_state> &app = kv.second;
         if (is_ignored_app(kv.first)) {
@@ -836,7 +1354,19 @@ void greedy_load_balancer::greedy_balancer(const bool balance_checker)
         if (app->status != app_status::AS_AVAILABLE)
             continue;
 
-        bool enough_information = primary_balancer_per_app(app);
+        uint64_t signature =
+            _incremental_balancer ? get_app_signature(*app, round_signature) : 0;
+        app_signatures[app->app_id] = signature;
+
+        size_t actions_before = t_migration_result->size();
+        // the loads change without changing the signature of the app
+        bool enough_information =
+            plan_app(app, signature, !_load_weighted_balancer, _primary_balanced_apps, [&]() {
+                return primary_balancer_per_app(app);
+            });
+        if (t_migration_result->size() != actions_before) {
+            primary_moved_apps.insert(app->app_id);
+        }
         if (!enough_information) {
             // Even if we don't have enough info for current app,
             // the decisions made by previous apps are kept.
@@ -883,7 +1413,12 @@ void greedy_load_balancer::greedy_balancer(const bool balance_checker)
         if (app->status != app_status::AS_AVAILABLE)
             continue;
 
-        bool enough_information = copy_secondary_per_app(app);
+        // the actions made by primary balancer affect the plan of secondary balancer
+        bool enough_information = plan_app(app,
+                                           app_signatures[app->app_id],
+                                           primary_moved_apps.count(app->app_id) == 0,
+                                           _secondary_balanced_apps,
+                                           [&]() { return copy_secondary_per_app(app); });
         if (!enough_information) {
             // Even if we don't have enough info for current app,
             // the decisions made by previous apps are kept.
@@ -902,6 +1437,91 @@ void greedy_load_balancer::greedy_balancer(const bool balance_checker)
     }
 }
 
+uint64_t greedy_load_balancer::get_round_signature() const
+{
+    // the nodes are combined regardless of the order
+    uint64_t nodes_signature = 0;
+    for (const auto &kv : *(t_global_view->nodes)) {
+        nodes_signature += std::hash<rpc_address>()(kv.first);
+    }
+
+    uint64_t values[] = {static_cast<uint64_t>(t_alive_nodes),
+                         nodes_signature,
+                         static_cast<uint64_t>(_only_move_primary)};
+    return utils::crc64_calc(values, sizeof(values), 0);
+}
+
+uint64_t greedy_load_balancer::get_app_signature(const app_state &app,
+                                                 uint64_t round_signature) const
+{
+    uint64_t signature = round_signature;
+    auto add = [&signature](uint64_t value) {
+        signature = utils::crc64_calc(&value, sizeof(value), signature);
+    };
+
+    add(app.partition_count);
+    for (int i = 0; i < app.partition_count; ++i) {
+        const partition_configuration &pc = app.partitions[i];
+        add(std::hash<rpc_address>()(pc.primary));
+        add(pc.secondaries.size());
+        for (const rpc_address &secondary : pc.secondaries) {
+            add(std::hash<rpc_address>()(secondary));
+        }
+
+        // the disk tags decide which replicas to move
+        const config_context &cc = app.helpers->contexts[i];
+        add(cc.serving.size());
+        for (const serving_replica &replica : cc.serving) {
+            add(std::hash<rpc_address>()(replica.node));
+            add(std::hash<std::string>()(replica.disk_tag));
+        }
+    }
+    return signature;
+}
+
+bool greedy_load_balancer::plan_app(const std::shared_ptr<app_state> &app,
+                                    uint64_t signature,
+                                    bool cacheable,
+                                    /*in-out*/ balanced_apps &balanced,
+                                    const std::function<bool()> &planner)
+{
+    cacheable = cacheable && _incremental_balancer;
+    if (cacheable) {
+        auto iter = balanced.find(app->app_id);
+        if (iter != balanced.end() && iter->second == signature) {
+            dinfo("skip to plan app(%s) coz it is balanced and not changed", app->get_logname());
+            t_plan_stats.skipped_apps++;
+            return true;
+        }
+    }
+
+    size_t actions_before = t_migration_result->size();
+    uint64_t start_us = dsn_now_us();
+    t_migration_throttled = false;
+    bool enough_information = planner();
+    uint64_t plan_time_us = dsn_now_us() - start_us;
+
+    _app_balance_plan_time_us->set(plan_time_us);
+    t_plan_stats.planned_apps++;
+    t_plan_stats.plan_time_us += plan_time_us;
+    if (plan_time_us >= t_plan_stats.slowest_app_plan_time_us) {
+        t_plan_stats.slowest_app = app->app_id;
+        t_plan_stats.slowest_app_plan_time_us = plan_time_us;
+    }
+
+    if (t_migration_throttled) {
+        t_plan_stats.throttled_apps++;
+    }
+    // an app with deferred copies is not balanced yet
+    if (cacheable && enough_information && !t_migration_throttled &&
+        t_migration_result->size() == actions_before) {
+        balanced[app->app_id] = signature;
+    } else {
+        balanced.erase(app->app_id);
+    }
+    return enough_information;
+}
+
 bool greedy_load_balancer::balance(meta_view view, migration_list &list)
 {
     ddebug("balancer round");
@@ -912,8 +1532,14 @@ bool greedy_load_balancer::balance(meta_view view, migration_list &list)
     t_global_view = &view;
     t_migration_result = &list;
     t_migration_result->clear();
+    t_plan_stats = plan_stats();
+    t_throttle_migrations = true;
+    t_migration_budgets.clear();
+    collect_load_reports();
 
     greedy_balancer(false);
+    t_last_plan_stats = t_plan_stats;
+    _recent_balance_skipped_app_count->add(t_plan_stats.skipped_apps);
     return !t_migration_result->empty();
 }
 
@@ -927,6 +1553,9 @@ bool greedy_load_balancer::check(meta_view view, migration_list &list)
     t_global_view = &view;
     t_migration_result = &list;
     t_migration_result->clear();
+    t_plan_stats = plan_stats();
+    t_throttle_migrations = false;
+    t_migration_budgets.clear();
 
     greedy_balancer(true);
     return !t_migration_result->empty();
@@ -72,12 +72,55 @@ private:
         MAX_COUNT = 4
     };
 
+    // statistics of the per-app planning in one balance round
+    struct plan_stats
+    {
+        int planned_apps{0};
+        int skipped_apps{0};
+        uint64_t plan_time_us{0};
+        app_id slowest_app{0};
+        uint64_t slowest_app_plan_time_us{0};
+        // apps of which some copies are deferred as the migration budgets are used up
+        int throttled_apps{0};
+        // estimated data to copy by the planned migrations
+        int64_t copy_mb{0};
+    };
+
+    // the copies planned in a round from or to a node, and the estimated data of them
+    struct migration_budget
+    {
+        int copies_in{0};
+        int copies_out{0};
+        int64_t mb_in{0};
+        int64_t mb_out{0};
+    };
+
+    // app_id -> signature of the app when it's found balanced
+    typedef std::unordered_map<app_id, uint64_t> balanced_apps;
+
     // these variables are temporarily assigned by interface "balance"
     const meta_view *t_global_view;
     migration_list *t_migration_result;
     int t_total_partitions;
     int t_alive_nodes;
     int t_operation_counters[MAX_COUNT];
+    plan_stats t_plan_stats;
+    plan_stats t_last_plan_stats;
+    // pid -> qps of the hot partitions reported by the replica servers, with which the hotter
+    // primaries are moved first when the primaries are balanced
+    std::unordered_map<dsn::gpid, int64_t> t_hot_partition_qps;
+    // node -> pid -> load of the replicas reported by the replica servers, which is weighed in
+    // load-weighted mode
+    std::map<dsn::rpc_address, std::unordered_map<dsn::gpid, replica_load>> t_replica_loads;
+    // node -> tags of the fail-slow disks reported by the replica servers, whose replicas are
+    // moved off the nodes before the others are balanced
+    std::map<dsn::rpc_address, std::set<std::string>> t_slow_disks;
+    // the copies are bounded by the migration budgets of the nodes in a balance round, but
+    // not in a check round, which counts all the migrations to do
+    bool t_throttle_migrations;
+    std::unordered_map<dsn::rpc_address, migration_budget> t_migration_budgets;
+    // whether some copy of the app being planned is deferred for the budgets
+    bool t_migration_throttled;
 
     // this is used to assign an integer id for every node
     // and these are generated from the above data, which are tempory too
@@ -91,6 +134,13 @@ private:
     bool _balancer_in_turn;
     bool _only_primary_balancer;
     bool _only_move_primary;
+    bool _incremental_balancer;
+    bool _load_weighted_balancer;
+
+    // in incremental mode, the apps which are balanced and not changed since the last round
+    // are skipped. Primary and secondary balancers keep their own records.
+    balanced_apps _primary_balanced_apps;
+    balanced_apps _secondary_balanced_apps;
 
     // the app set which won't be re-balanced
     std::set<app_id> _balancer_ignored_apps;
@@ -100,6 +150,8 @@ private:
     dsn_handle_t _ctrl_balancer_in_turn;
     dsn_handle_t _ctrl_only_primary_balancer;
     dsn_handle_t _ctrl_only_move_primary;
+    dsn_handle_t _ctrl_incremental_balancer;
+    dsn_handle_t _ctrl_load_weighted_balancer;
     dsn_handle_t _get_balance_operation_count;
 
     // perf counters
@@ -107,6 +159,8 @@ private:
     perf_counter_wrapper _recent_balance_move_primary_count;
     perf_counter_wrapper _recent_balance_copy_primary_count;
     perf_counter_wrapper _recent_balance_copy_secondary_count;
+    perf_counter_wrapper _app_balance_plan_time_us;
+    perf_counter_wrapper _recent_balance_skipped_app_count;
 
 private:
     void number_nodes(const node_mapper &nodes);
@@ -130,14 +184,48 @@ private:
                               bool still_have_less_than_average,
                               int replicas_low);
     bool primary_balancer_per_app(const std::shared_ptr<app_state> &app);
+    // move the primaries of `app` which are balanced by count to reduce the variance of the
+    // loads of the nodes, within the count bounds and at most
+    // [meta_server] balancer_load_max_moves_per_app moves
+    bool primary_load_balancer_per_app(const std::shared_ptr<app_state> &app,
+                                       int replicas_low,
+                                       int replicas_high);
 
     bool copy_secondary_per_app(const std::shared_ptr<app_state> &app);
 
+    // move the replicas off the fail-slow disks in t_slow_disks, at most
+    // [meta_server] balancer_slow_disk_max_moves of them in a round: the primaries are moved to
+    // their secondaries first, and the secondaries are copied to other nodes once there is no
+    // primary left on the slow disks. return the count of the moves planned.
+    int evacuate_slow_disks();
+    bool is_on_slow_disk(const dsn::rpc_address &node, const dsn::gpid &pid);
+
     void greedy_balancer(bool balance_checker);
 
+    // signature of all the inputs of the per-app balancers except the app itself
+    uint64_t get_round_signature() const;
+    // signature of the partitions of `app` and where they are served, seeded by round signature
+    uint64_t get_app_signature(const app_state &app, uint64_t round_signature) const;
+
+    // run `planner` on `app` and record its planning time, unless the app is balanced and not
+    // changed since it's planned last time in incremental mode, return what `planner` returns
+    bool plan_app(const std::shared_ptr<app_state> &app,
+                  uint64_t signature,
+                  bool cacheable,
+                  /*in-out*/ balanced_apps &balanced,
+                  const std::function<bool()> &planner);
+
     bool all_replica_infos_collected(const node_state &ns);
+    void collect_load_reports();
     // using t_global_view to get disk_tag of node's pid
     const std::string &get_disk_tag(const dsn::rpc_address &node, const dsn::gpid &pid);
+    // the estimated data to copy when `pc` gets a new replica, which is learned from its primary
+    int64_t get_copy_cost_mb(const partition_configuration &pc);
+    // whether a copy of `cost_mb` from the primary on `source` to `target` is within the
+    // migration budgets of both nodes, and record the deferred copy if not
+    bool within_migration_budget(const dsn::rpc_address &source,
+                                 const dsn::rpc_address &target,
+                                 int64_t cost_mb);
 
     // return false if can't get the replica_info for some replicas on this node
     bool calc_disk_load(app_id id,
@@ -159,6 +247,8 @@ private:
     std::string clear_balancer_ignored_app_ids();
 
     bool is_ignored_app(app_id app_id);
+
+    friend class greedy_load_balancer_test;
 };
 } // namespace replication
 } // namespace dsn
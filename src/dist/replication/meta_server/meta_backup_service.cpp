@@ -1,4 +1,5 @@
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/time_utils.h>
 #include <dsn/utility/output_utils.h>
 #include <dsn/tool-api/http_server.h>
@@ -11,6 +12,25 @@
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_bool(cold_backup_incremental);
+DSN_DECLARE_uint32(cold_backup_max_incremental_chain);
+
+DSN_DEFINE_uint32("meta_server",
+                  backup_max_running_partitions_per_node,
+                  8,
+                  "max count of partitions under backup on each replica server among all the "
+                  "backup policies, 0 means no limit");
+DSN_DEFINE_uint32("meta_server",
+                  backup_max_running_partitions_per_disk,
+                  2,
+                  "max count of partitions under backup on each disk of a replica server among "
+                  "all the backup policies, 0 means no limit");
+DSN_DEFINE_uint32("meta_server",
+                  backup_poll_max_delay_ms,
+                  60000,
+                  "the delay between the polls of a partition under backup doubles from "
+                  "request_backup_period_ms up to this value");
+
 // TODO: backup_service and policy_context should need two locks, its own _lock and server_state's
 // _lock this maybe lead to deadlock, should refactor this
 
@@ -136,7 +156,71 @@ void policy_context::start_backup_app_partitions_unlocked(int32_t app_id)
             _backup_sig.c_str(),
             app_id);
     for (int32_t i = 0; i < iter->second; ++i) {
-        start_backup_partition_unlocked(gpid(app_id, i));
+        _progress.waiting_partitions.emplace_back(app_id, i);
+    }
+    schedule_waiting_partitions_unlocked();
+}
+
+void policy_context::schedule_waiting_partitions_unlocked()
+{
+    // the bigger partitions are started first, so the smaller ones fill in the free slots later
+    std::vector<gpid> waiting;
+    waiting.swap(_progress.waiting_partitions);
+    std::stable_sort(waiting.begin(), waiting.end(), [this](const gpid &a, const gpid &b) {
+        auto sa = _last_chkpt_size.find(a), sb = _last_chkpt_size.find(b);
+        return (sa == _last_chkpt_size.end() ? 0 : sa->second) >
+               (sb == _last_chkpt_size.end() ? 0 : sb->second);
+    });
+
+    std::vector<gpid> to_start;
+    {
+        zauto_read_lock l;
+        _backup_service->get_state()->lock_read(l);
+        for (const gpid &pid : waiting) {
+            const app_state *app = _backup_service->get_state()->get_app(pid.get_app_id()).get();
+            if (app == nullptr || app->status == app_status::AS_DROPPED) {
+                // skipped by start_backup_partition_unlocked
+                to_start.push_back(pid);
+                continue;
+            }
+            const rpc_address &primary = app->partitions[pid.get_partition_index()].primary;
+            if (primary.is_invalid()) {
+                _progress.waiting_partitions.push_back(pid);
+                continue;
+            }
+            const config_context &cc = app->helpers->contexts[pid.get_partition_index()];
+            auto serving = cc.find_from_serving(primary);
+            std::string disk_tag;
+            if (serving != cc.serving.end()) {
+                disk_tag = serving->disk_tag;
+            }
+            if (_backup_service->scheduler().try_acquire(
+                    _policy.policy_name, pid, primary, disk_tag)) {
+                to_start.push_back(pid);
+            } else {
+                _progress.waiting_partitions.push_back(pid);
+            }
+        }
+    }
+
+    for (const gpid &pid : to_start) {
+        start_backup_partition_unlocked(pid);
+    }
+
+    if (!_progress.waiting_partitions.empty() && !_progress.schedule_pending) {
+        dinfo("%s: %d partitions are waiting for backup slots",
+              _backup_sig.c_str(),
+              static_cast<int>(_progress.waiting_partitions.size()));
+        _progress.schedule_pending = true;
+        tasking::enqueue(LPC_DEFAULT_CALLBACK,
+                         &_tracker,
+                         [this]() {
+                             zauto_lock l(_lock);
+                             _progress.schedule_pending = false;
+                             schedule_waiting_partitions_unlocked();
+                         },
+                         0,
+                         _backup_service->backup_option().request_backup_period_ms);
     }
 }
 
@@ -399,6 +483,7 @@ bool policy_context::update_partition_progress_unlocked(gpid pid,
 void policy_context::record_partition_checkpoint_size_unlock(const gpid &pid, int64_t size)
 {
     _progress.app_chkpt_size[pid.get_app_id()][pid.get_partition_index()] = size;
+    _last_chkpt_size[pid] = size;
 }
 
 void policy_context::start_backup_partition_unlocked(gpid pid)
@@ -509,6 +594,11 @@ void policy_context::on_backup_reply(error_code err,
             record_partition_checkpoint_size_unlock(pid, response.checkpoint_total_size);
             // NOTICE: if a partition is finished, we don't try to resend the command again
             if (update_partition_progress_unlocked(pid, response.progress, primary)) {
+                // hand over the slot to the waiting partitions
+                _backup_service->scheduler().release(_policy.policy_name, pid);
+                if (!_progress.waiting_partitions.empty()) {
+                    schedule_waiting_partitions_unlocked();
+                }
                 return;
             }
         }
@@ -522,7 +612,16 @@ void policy_context::on_backup_reply(error_code err,
               response.err.to_string());
     }
 
-    // start another turn of backup no matter we encounter error or not finished
+    // start another turn of backup no matter we encounter error or not finished, the longer the
+    // backup of the partition runs the less frequently it's polled
+    std::chrono::milliseconds delay;
+    {
+        zauto_lock l(_lock);
+        delay = backup_scheduler::poll_delay(
+            _progress.poll_counts[pid]++,
+            _backup_service->backup_option().request_backup_period_ms,
+            std::chrono::milliseconds(FLAGS_backup_poll_max_delay_ms));
+    }
     tasking::enqueue(LPC_DEFAULT_CALLBACK,
                      &_tracker,
                      [this, pid]() {
@@ -530,11 +629,12 @@ void policy_context::on_backup_reply(error_code err,
                          start_backup_partition_unlocked(pid);
                      },
                      0,
-                     _backup_service->backup_option().request_backup_period_ms);
+                     delay);
 }
 
 void policy_context::initialize_backup_progress_unlocked()
 {
+    _backup_service->scheduler().release_all(_policy.policy_name);
     _progress.reset();
 
     zauto_read_lock l;
@@ -932,7 +1032,13 @@ void policy_context::gc_backup_info_unlocked(const backup_info &info_to_gc)
 
 void policy_context::issue_gc_backup_info_task_unlocked()
 {
-    if (_backup_history.size() > _policy.backup_history_count_to_keep) {
+    // the incremental backups may reference the files uploaded by the previous backups, at most
+    // cold_backup_max_incremental_chain, which must be kept for restoring
+    size_t count_to_keep = _policy.backup_history_count_to_keep;
+    if (FLAGS_cold_backup_incremental) {
+        count_to_keep += FLAGS_cold_backup_max_incremental_chain;
+    }
+    if (_backup_history.size() > count_to_keep) {
         backup_info &info = _backup_history.begin()->second;
         info.info_status = backup_info_status::type::DELETING;
         ddebug("%s: start to gc backup info with id(%" PRId64 ")",
@@ -1020,6 +1126,8 @@ backup_service::backup_service(meta_service *meta_svc,
     _opt.reconfiguration_retry_delay_ms = 15000_ms;
     _opt.request_backup_period_ms = 10000_ms;
     _opt.issue_backup_interval_ms = 300000_ms;
+    _scheduler = dsn::make_unique<backup_scheduler>(
+        FLAGS_backup_max_running_partitions_per_node, FLAGS_backup_max_running_partitions_per_disk);
 
     _in_initialize.store(true);
 }
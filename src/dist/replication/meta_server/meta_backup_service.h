@@ -10,6 +10,7 @@
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 
 #include "meta_data.h"
+#include "backup_scheduler.h"
 
 namespace dsn {
 namespace replication {
@@ -184,8 +185,14 @@ struct backup_progress
     std::map<app_id, std::map<int, int64_t>> app_chkpt_size;
     // if app is dropped when starting a new backup or under backuping, we just skip backup this app
     std::map<app_id, bool> is_app_skipped;
+    // the partitions waiting for the backup slots of their primaries, see backup_scheduler
+    std::vector<gpid> waiting_partitions;
+    // the count of polls of each partition under backup, by which the poll delay grows
+    std::map<gpid, int32_t> poll_counts;
+    // whether a task to schedule the waiting partitions is pending
+    bool schedule_pending;
 
-    backup_progress() : unfinished_apps(0) {}
+    backup_progress() : unfinished_apps(0), schedule_pending(false) {}
 
     void reset()
     {
@@ -195,6 +202,9 @@ struct backup_progress
         unfinished_partitions_per_app.clear();
         app_chkpt_size.clear();
         is_app_skipped.clear();
+        waiting_partitions.clear();
+        poll_counts.clear();
+        schedule_pending = false;
     }
 };
 
@@ -244,6 +254,9 @@ mock_private :
     mock_virtual void start_backup_app_meta_unlocked(int32_t app_id);
     mock_virtual void start_backup_app_partitions_unlocked(int32_t app_id);
     mock_virtual void start_backup_partition_unlocked(gpid pid);
+    // start the backups of the waiting partitions whose primaries have free backup slots, the
+    // bigger partitions of the last backup first, and retry the others later
+    void schedule_waiting_partitions_unlocked();
     // before finish backup one app, we write a flag file to represent whether the app's backup is
     // finished
     mock_virtual void write_backup_app_finish_flag_unlocked(int32_t app_id,
@@ -289,6 +302,8 @@ mock_private :
     // backup_id --> backup_info
     std::map<int64_t, backup_info> _backup_history;
     backup_progress _progress;
+    // the checkpoint sizes of the partitions in the last backups, by which they are scheduled
+    std::map<gpid, int64_t> _last_chkpt_size;
     std::string _backup_sig; // policy_name@backup_id, used when print backup related log
 
     perf_counter_wrapper _counter_policy_recent_backup_duration_ms;
@@ -317,6 +332,7 @@ public:
     meta_service *get_meta_service() const { return _meta_svc; }
     server_state *get_state() const { return _state; }
     backup_opt &backup_option() { return _opt; }
+    backup_scheduler &scheduler() { return *_scheduler; }
     void start();
 
     const std::string &backup_root() const { return _backup_root; }
@@ -370,6 +386,7 @@ private:
     std::string _backup_root;
 
     backup_opt _opt;
+    std::unique_ptr<backup_scheduler> _scheduler;
     std::atomic_bool _in_initialize;
     dsn::task_tracker _tracker;
 };
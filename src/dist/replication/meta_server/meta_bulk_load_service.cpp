@@ -2,14 +2,23 @@
 // This source code is licensed under the Apache License Version 2.0, which
 // can be found in the LICENSE file in the root directory of this source tree.
 
+#include <algorithm>
+
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 
 #include "meta_bulk_load_service.h"
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("meta_server",
+                  bulk_load_status_update_batch_interval_ms,
+                  100,
+                  "the partition bulk load status updates issued within this interval are "
+                  "written to remote storage together, 0 means to write them at the next turn");
+
 bulk_load_service::bulk_load_service(meta_service *meta_svc, const std::string &bulk_load_dir)
     : _meta_svc(meta_svc), _bulk_load_root(bulk_load_dir)
 {
@@ -395,6 +404,13 @@ void bulk_load_service::on_partition_bulk_load_reply(error_code err,
     switch (app_status) {
     case bulk_load_status::BLS_DOWNLOADING:
         handle_app_downloading(response, primary_addr);
+        // the app turns to ingesting once all the partitions are downloaded, which is driven by
+        // the requests of the partitions, so send request frequently after downloaded to avoid
+        // being idle at the barrier
+        if (response.__isset.total_download_progress &&
+            response.total_download_progress >= bulk_load_constant::PROGRESS_FINISHED) {
+            interval = bulk_load_constant::BULK_LOAD_REQUEST_SHORT_INTERVAL;
+        }
         break;
     case bulk_load_status::BLS_DOWNLOADED:
         update_partition_status_on_remote_storage(
@@ -431,16 +447,67 @@ void bulk_load_service::try_resend_bulk_load_request(const std::string &app_name
                                                      const int32_t interval)
 {
     FAIL_POINT_INJECT_F("meta_bulk_load_resend_request", [](dsn::string_view) {});
-    zauto_read_lock l(_lock);
-    if (is_app_bulk_loading_unlocked(pid.get_app_id())) {
+    {
+        zauto_read_lock l(_lock);
+        if (!is_app_bulk_loading_unlocked(pid.get_app_id())) {
+            return;
+        }
+    }
+
+    zauto_lock l(_batch_lock);
+    auto &round = _resend_rounds[interval];
+    round.emplace_back(app_name, pid);
+    if (round.size() == 1) {
         tasking::enqueue(LPC_META_STATE_NORMAL,
                          _meta_svc->tracker(),
-                         std::bind(&bulk_load_service::partition_bulk_load, this, app_name, pid),
+                         std::bind(&bulk_load_service::resend_bulk_load_requests, this, interval),
                          0,
                          std::chrono::seconds(interval));
     }
 }
 
+// ThreadPool: THREAD_POOL_META_STATE
+void bulk_load_service::resend_bulk_load_requests(int32_t interval)
+{
+    std::vector<std::pair<std::string, gpid>> partitions;
+    {
+        zauto_lock l(_batch_lock);
+        auto iter = _resend_rounds.find(interval);
+        if (iter == _resend_rounds.end()) {
+            return;
+        }
+        partitions = std::move(iter->second);
+        _resend_rounds.erase(iter);
+    }
+
+    std::vector<std::pair<rpc_address, size_t>> order;
+    order.reserve(partitions.size());
+    {
+        zauto_read_lock l(app_lock());
+        for (size_t i = 0; i < partitions.size(); ++i) {
+            const gpid &pid = partitions[i].second;
+            std::shared_ptr<app_state> app = _state->get_app(pid.get_app_id());
+            rpc_address primary;
+            if (app != nullptr && pid.get_partition_index() < app->partition_count) {
+                primary = app->partitions[pid.get_partition_index()].primary;
+            }
+            order.emplace_back(primary, i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end());
+
+    for (const auto &o : order) {
+        const auto &partition = partitions[o.second];
+        {
+            zauto_read_lock l(_lock);
+            if (!is_app_bulk_loading_unlocked(partition.second.get_app_id())) {
+                continue;
+            }
+        }
+        partition_bulk_load(partition.first, partition.second);
+    }
+}
+
 // ThreadPool: THREAD_POOL_META_STATE
 void bulk_load_service::handle_app_downloading(const bulk_load_response &response,
                                                const rpc_address &primary_addr)
@@ -789,15 +856,54 @@ void bulk_load_service::update_partition_status_on_remote_storage(const std::str
     pinfo.status = new_status;
     blob value = json::json_forwarder<partition_bulk_load_info>::encode(pinfo);
 
-    _meta_svc->get_meta_storage()->set_data(
-        get_partition_bulk_load_path(pid),
-        std::move(value),
-        std::bind(&bulk_load_service::update_partition_status_on_remote_storage_reply,
-                  this,
-                  app_name,
-                  pid,
-                  new_status,
-                  should_send_request));
+    zauto_lock bl(_batch_lock);
+    _pending_status_updates.push_back(
+        partition_status_update{app_name, pid, std::move(value), new_status, should_send_request});
+    if (_pending_status_updates.size() == 1) {
+        tasking::enqueue(
+            LPC_META_STATE_NORMAL,
+            _meta_svc->tracker(),
+            std::bind(&bulk_load_service::flush_partition_status_updates, this),
+            0,
+            std::chrono::milliseconds(FLAGS_bulk_load_status_update_batch_interval_ms));
+    }
+}
+
+// ThreadPool: THREAD_POOL_META_STATE
+void bulk_load_service::flush_partition_status_updates()
+{
+    std::vector<partition_status_update> updates;
+    {
+        zauto_lock l(_batch_lock);
+        updates.swap(_pending_status_updates);
+    }
+
+    {
+        // the bulk load dir of an app may have been removed since its updates were issued
+        zauto_read_lock l(_lock);
+        updates.erase(std::remove_if(updates.begin(),
+                                     updates.end(),
+                                     [this](const partition_status_update &u) {
+                                         return !is_app_bulk_loading_unlocked(u.pid.get_app_id());
+                                     }),
+                      updates.end());
+    }
+    if (updates.empty()) {
+        return;
+    }
+
+    ddebug_f("write {} partition bulk load status updates to remote storage", updates.size());
+    for (auto &u : updates) {
+        _meta_svc->get_meta_storage()->set_data(
+            get_partition_bulk_load_path(u.pid),
+            std::move(u.value),
+            std::bind(&bulk_load_service::update_partition_status_on_remote_storage_reply,
+                      this,
+                      u.app_name,
+                      u.pid,
+                      u.new_status,
+                      u.should_send_request));
+    }
 }
 
 // ThreadPool: THREAD_POOL_META_STATE
@@ -114,10 +114,16 @@ private:
                                       const bulk_load_response &response);
 
     // if app is still in bulk load, resend bulk_load_request to primary after interval seconds
+    // at most, the partitions to resend after the same interval join one round
     void try_resend_bulk_load_request(const std::string &app_name,
                                       const gpid &pid,
                                       const int32_t interval);
 
+    // resend bulk_load_request of the partitions of the round of `interval`, the requests to
+    // the same primary are sent back-to-back so that its replies arrive together and their
+    // status updates are coalesced
+    void resend_bulk_load_requests(int32_t interval);
+
     void handle_app_downloading(const bulk_load_response &response,
                                 const rpc_address &primary_addr);
 
@@ -177,6 +183,12 @@ private:
                                                    bulk_load_status::type new_status,
                                                    bool should_send_request = false);
 
+    // the status updates of the partitions issued within
+    // [meta_server] bulk_load_status_update_batch_interval_ms are written back-to-back, so that
+    // they are coalesced into multi-ops by the remote storage, while each update still has its
+    // own reply, so a failed update doesn't block the other partitions
+    void flush_partition_status_updates();
+
     void update_partition_status_on_remote_storage_reply(const std::string &app_name,
                                                          const gpid &pid,
                                                          bulk_load_status::type new_status,
@@ -336,6 +348,20 @@ private:
     std::unordered_map<gpid, bool> _partitions_cleaned_up;
     // Used for bulk load failed and app unavailable to avoid duplicated clean up
     std::unordered_map<app_id, bool> _apps_cleaning_up;
+
+    struct partition_status_update
+    {
+        std::string app_name;
+        gpid pid;
+        blob value;
+        bulk_load_status::type new_status;
+        bool should_send_request;
+    };
+    // protects the pending status updates and the resend rounds
+    zlock _batch_lock;
+    std::vector<partition_status_update> _pending_status_updates;
+    // interval -> partitions to resend bulk_load_request when the round is due
+    std::map<int32_t, std::vector<std::pair<std::string, gpid>>> _resend_rounds;
 };
 
 } // namespace replication
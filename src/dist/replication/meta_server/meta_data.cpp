@@ -343,12 +343,13 @@ bool config_context::remove_from_serving(const rpc_address &node)
 
 void config_context::collect_serving_replica(const rpc_address &node, const replica_info &info)
 {
+    int64_t storage_mb = info.__isset.checkpoint_size_mb ? info.checkpoint_size_mb : 0;
     auto iter = find_from_serving(node);
     if (iter != serving.end()) {
         iter->disk_tag = info.disk_tag;
-        iter->storage_mb = 0;
+        iter->storage_mb = storage_mb;
     } else {
-        serving.emplace_back(serving_replica{node, 0, info.disk_tag});
+        serving.emplace_back(serving_replica{node, storage_mb, info.disk_tag});
     }
 }
 
@@ -179,7 +179,7 @@ inline int dropped_cmp(const dropped_replica &d1, const dropped_replica &d2)
 struct serving_replica
 {
     dsn::rpc_address node;
-    // TODO: report the storage size of replica
+    // size of the checkpoint reported by the replica server, 0 if not reported
     int64_t storage_mb;
     std::string disk_tag;
 };
@@ -193,7 +193,8 @@ void meta_http_service::list_app_handler(const http_request &req, http_response
     std::vector<::dsn::app_info> &apps = response.infos;
 
     // output as json format
-    std::ostringstream out;
+    // the tables of all the apps may be large, so they are streamed into the response chunks
+    http_body_stream out(resp);
     dsn::utils::multi_table_printer mtp;
     int available_app_count = 0;
     dsn::utils::table_printer tp_general("general_info");
@@ -333,7 +334,6 @@ void meta_http_service::list_app_handler(const http_request &req, http_response
 
     mtp.output(out, dsn::utils::table_printer::output_format::kJsonCompact);
 
-    resp.body = out.str();
     resp.status_code = http_status_code::ok;
 }
 
@@ -399,7 +399,7 @@ void meta_http_service::list_node_handler(const http_request &req, http_response
     }
 
     // output as json format
-    std::ostringstream out;
+    http_body_stream out(resp);
     dsn::utils::multi_table_printer mtp;
     dsn::utils::table_printer tp_details("details");
     tp_details.add_title("address");
@@ -427,7 +427,6 @@ void meta_http_service::list_node_handler(const http_request &req, http_response
     mtp.add(std::move(tp_count));
     mtp.output(out, dsn::utils::table_printer::output_format::kJsonCompact);
 
-    resp.body = out.str();
     resp.status_code = http_status_code::ok;
 }
 
@@ -519,11 +518,90 @@ void meta_http_service::get_app_envs_handler(const http_request &req, http_respo
     resp.status_code = http_status_code::ok;
 }
 
+void meta_http_service::list_hotspot_handler(const http_request &req, http_response &resp)
+{
+    std::string app_name;
+    for (const auto &p : req.query_args) {
+        if (p.first == "app_name") {
+            app_name = p.second;
+        } else {
+            resp.status_code = http_status_code::bad_request;
+            return;
+        }
+    }
+    if (!redirect_if_not_primary(req, resp))
+        return;
+
+    configuration_list_apps_response response;
+    configuration_list_apps_request request;
+    request.status = dsn::app_status::AS_AVAILABLE;
+    _service->_state->list_apps(request, response);
+    if (response.err != dsn::ERR_OK) {
+        resp.body = response.err.to_string();
+        resp.status_code = http_status_code::internal_server_error;
+        return;
+    }
+    std::map<int32_t, std::string> app_names;
+    for (const auto &app : response.infos) {
+        if (app_name.empty() || app.app_name == app_name) {
+            app_names.emplace(app.app_id, app.app_name);
+        }
+    }
+
+    // the hottest partitions of all the nodes, in descending order of qps
+    std::vector<std::pair<rpc_address, partition_hotspot>> hotspots;
+    for (const auto &kv : _service->_state->get_hot_partitions()) {
+        for (const auto &hotspot : kv.second) {
+            if (app_names.find(hotspot.pid.get_app_id()) != app_names.end()) {
+                hotspots.emplace_back(kv.first, hotspot);
+            }
+        }
+    }
+    std::sort(hotspots.begin(),
+              hotspots.end(),
+              [](const std::pair<rpc_address, partition_hotspot> &lhs,
+                 const std::pair<rpc_address, partition_hotspot> &rhs) {
+                  return lhs.second.read_qps + lhs.second.write_qps >
+                         rhs.second.read_qps + rhs.second.write_qps;
+              });
+
+    dsn::utils::table_printer tp("hot_partitions");
+    tp.add_title("pid");
+    tp.add_column("app_name");
+    tp.add_column("node");
+    tp.add_column("read_qps");
+    tp.add_column("write_qps");
+    tp.add_column("bytes_per_sec");
+    // partition hash:qps of the hottest keys
+    tp.add_column("hot_keys");
+    for (const auto &kv : hotspots) {
+        const partition_hotspot &hotspot = kv.second;
+        std::ostringstream hot_keys;
+        for (size_t i = 0; i < hotspot.hot_key_hashes.size() && i < hotspot.hot_key_qps.size();
+             ++i) {
+            hot_keys << (i == 0 ? "" : ",") << static_cast<uint64_t>(hotspot.hot_key_hashes[i])
+                     << ":" << hotspot.hot_key_qps[i];
+        }
+        tp.add_row(hotspot.pid.to_string());
+        tp.append_data(app_names[hotspot.pid.get_app_id()]);
+        tp.append_data(kv.first.to_std_string());
+        tp.append_data(hotspot.read_qps);
+        tp.append_data(hotspot.write_qps);
+        tp.append_data(hotspot.bytes_per_sec);
+        tp.append_data(hot_keys.str());
+    }
+
+    std::ostringstream out;
+    tp.output(out, dsn::utils::table_printer::output_format::kJsonCompact);
+    resp.body = out.str();
+    resp.status_code = http_status_code::ok;
+}
+
 std::string set_to_string(const std::set<int32_t> &s)
 {
     std::stringstream out;
-    rapidjson::OStreamWrapper wrapper(out);
-    dsn::json::JsonWriter writer(wrapper);
+    dsn::json::json_output_stream stream(out);
+    dsn::json::JsonWriter writer(stream);
     dsn::json::json_encode(writer, s);
     return out.str();
 }
@@ -610,6 +688,27 @@ void meta_http_service::query_duplication_handler(const http_request &req, http_
     resp.body = duplication_query_response_to_string(rpc_resp);
 }
 
+int64_t meta_http_service::apps_version() const
+{
+#ifndef DSN_MOCK_TEST
+    rpc_address leader;
+    if (!_service->_failure_detector->get_leader(&leader)) {
+        return -1;
+    }
+#endif
+    return _service->_state->state_version();
+}
+
+int64_t meta_http_service::nodes_version() const
+{
+    int64_t version = apps_version();
+    if (version < 0) {
+        return -1;
+    }
+    // both are increasing, so is the sum
+    return version + _service->_node_state_version.load();
+}
+
 bool meta_http_service::redirect_if_not_primary(const http_request &req, http_response &resp)
 {
 #ifdef DSN_MOCK_TEST
@@ -17,42 +17,54 @@ class meta_http_service : public http_service
 public:
     explicit meta_http_service(meta_service *s) : _service(s)
     {
-        register_handler("app",
-                         std::bind(&meta_http_service::get_app_handler,
-                                   this,
-                                   std::placeholders::_1,
-                                   std::placeholders::_2),
-                         "ip:port/meta/app?app_name=temp");
+        // the views of the apps and the nodes are polled by the monitoring systems, so they're
+        // cached until the state changes
+        register_cached_handler("app",
+                                std::bind(&meta_http_service::apps_version, this),
+                                std::bind(&meta_http_service::get_app_handler,
+                                          this,
+                                          std::placeholders::_1,
+                                          std::placeholders::_2),
+                                "ip:port/meta/app?app_name=temp");
         register_handler("app/duplication",
                          std::bind(&meta_http_service::query_duplication_handler,
                                    this,
                                    std::placeholders::_1,
                                    std::placeholders::_2),
                          "ip:port/meta/app/duplication?name=<app_name>");
-        register_handler("apps",
-                         std::bind(&meta_http_service::list_app_handler,
-                                   this,
-                                   std::placeholders::_1,
-                                   std::placeholders::_2),
-                         "ip:port/meta/apps");
-        register_handler("nodes",
-                         std::bind(&meta_http_service::list_node_handler,
-                                   this,
-                                   std::placeholders::_1,
-                                   std::placeholders::_2),
-                         "ip:port/meta/nodes");
+        register_cached_handler("apps",
+                                std::bind(&meta_http_service::apps_version, this),
+                                std::bind(&meta_http_service::list_app_handler,
+                                          this,
+                                          std::placeholders::_1,
+                                          std::placeholders::_2),
+                                "ip:port/meta/apps");
+        register_cached_handler("nodes",
+                                std::bind(&meta_http_service::nodes_version, this),
+                                std::bind(&meta_http_service::list_node_handler,
+                                          this,
+                                          std::placeholders::_1,
+                                          std::placeholders::_2),
+                                "ip:port/meta/nodes");
         register_handler("cluster",
                          std::bind(&meta_http_service::get_cluster_info_handler,
                                    this,
                                    std::placeholders::_1,
                                    std::placeholders::_2),
                          "ip:port/meta/cluster");
-        register_handler("app_envs",
-                         std::bind(&meta_http_service::get_app_envs_handler,
+        register_cached_handler("app_envs",
+                                std::bind(&meta_http_service::apps_version, this),
+                                std::bind(&meta_http_service::get_app_envs_handler,
+                                          this,
+                                          std::placeholders::_1,
+                                          std::placeholders::_2),
+                                "ip:port/meta/app_envs?name=temp");
+        register_handler("hotspots",
+                         std::bind(&meta_http_service::list_hotspot_handler,
                                    this,
                                    std::placeholders::_1,
                                    std::placeholders::_2),
-                         "ip:port/meta/app_envs?name=temp");
+                         "ip:port/meta/hotspots[?app_name=temp]");
         register_handler("backup_policy",
                          std::bind(&meta_http_service::query_backup_policy_handler,
                                    this,
@@ -68,6 +80,7 @@ public:
     void list_node_handler(const http_request &req, http_response &resp);
     void get_cluster_info_handler(const http_request &req, http_response &resp);
     void get_app_envs_handler(const http_request &req, http_response &resp);
+    void list_hotspot_handler(const http_request &req, http_response &resp);
     void query_backup_policy_handler(const http_request &req, http_response &resp);
     void query_duplication_handler(const http_request &req, http_response &resp);
 
@@ -75,6 +88,12 @@ private:
     // set redirect location if current server is not primary
     bool redirect_if_not_primary(const http_request &req, http_response &resp);
 
+    // the versions of the cached views, which are -1 if current server is not primary, so the
+    // requests are redirected rather than replied from the cache
+    int64_t apps_version() const;
+    // the nodes with their replica counts
+    int64_t nodes_version() const;
+
     meta_service *_service;
 };
 
@@ -114,6 +114,24 @@ void meta_options::initialize()
         "add_secondary_max_count_for_one_node",
         10,
         "add secondary max count for one node when flow control enabled");
+    partition_chunk_size = (int32_t)dsn_config_get_value_uint64(
+        "meta_server",
+        "partition_chunk_size",
+        0,
+        "store the partitions of the newly created apps in chunks of this size on remote "
+        "storage for fast failover, 0 to store each partition in its own node");
+    config_proposal_batch_window_ms = dsn_config_get_value_uint64(
+        "meta_server",
+        "config_proposal_batch_window_ms",
+        0,
+        "send the proposals to the same node within this period in one batch, 0 to send each "
+        "proposal separately. Do not enable it until all the replica servers support "
+        "RPC_CONFIG_PROPOSAL_BATCH");
+    config_proposal_batch_max_count = (int32_t)dsn_config_get_value_uint64(
+        "meta_server",
+        "config_proposal_batch_max_count",
+        64,
+        "max count of proposals in one batch, a full batch is sent at once");
 
     /// failure detector options
     _fd_opts.distributed_lock_service_type =
@@ -139,6 +157,11 @@ void meta_options::initialize()
         5,
         "meta server will treat an rs unstable so as to reject it's beacons "
         "if its succssively restarting count exceeds this value");
+    _fd_opts.batch_beacons =
+        dsn_config_get_value_bool("meta_server",
+                                  "fd_batch_beacons",
+                                  true,
+                                  "whether to handle the beacons received meanwhile in one task");
 
     /// load balancer options
     _lb_opts.server_load_balancer_type =
@@ -160,6 +183,19 @@ void meta_options::initialize()
         "meta_server", "only_primary_balancer", false, "only try to make the primary balanced");
     _lb_opts.only_move_primary = dsn_config_get_value_bool(
         "meta_server", "only_move_primary", false, "only try to make the primary balanced by move");
+    _lb_opts.incremental_balancer =
+        dsn_config_get_value_bool("meta_server",
+                                  "incremental_balancer",
+                                  false,
+                                  "skip the apps which are balanced and not changed since the last "
+                                  "balance round");
+    _lb_opts.load_weighted_balancer =
+        dsn_config_get_value_bool("meta_server",
+                                  "load_weighted_balancer",
+                                  false,
+                                  "once the primaries of an app are balanced by count, move them "
+                                  "further to balance the qps and write bytes reported by the "
+                                  "replica servers");
 
     cold_backup_disabled = dsn_config_get_value_bool(
         "meta_server", "cold_backup_disabled", true, "whether to disable cold backup");
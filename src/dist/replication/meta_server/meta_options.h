@@ -48,6 +48,9 @@ public:
 
     uint64_t stable_rs_min_running_seconds;
     int32_t max_succssive_unstable_restart;
+
+    // handle the beacons received meanwhile in one task, see meta_server_failure_detector
+    bool batch_beacons = false;
 };
 
 class lb_suboptions
@@ -60,6 +63,8 @@ public:
     bool balancer_in_turn;
     bool only_primary_balancer;
     bool only_move_primary;
+    bool incremental_balancer;
+    bool load_weighted_balancer;
 };
 
 class meta_options
@@ -78,6 +83,15 @@ public:
     bool add_secondary_enable_flow_control;
     int32_t add_secondary_max_count_for_one_node;
 
+    // 0 for one node for each partition on remote storage, or else the partition count of
+    // each chunk node of the apps created from now on
+    int32_t partition_chunk_size;
+
+    // 0 for sending each proposal in its own RPC_CONFIG_PROPOSAL, or else the proposals to the
+    // same node within this period are sent in one RPC_CONFIG_PROPOSAL_BATCH
+    uint64_t config_proposal_batch_window_ms;
+    int32_t config_proposal_batch_max_count;
+
     fd_suboptions _fd_opts;
     lb_suboptions _lb_opts;
 
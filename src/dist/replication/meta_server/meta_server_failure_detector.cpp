@@ -35,6 +35,7 @@
 
 #include <dsn/utility/factory_store.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 #include <dsn/dist/fmt_logging.h>
 #include "meta_server_failure_detector.h"
 #include "server_state.h"
@@ -47,6 +48,13 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("meta_server",
+                  leader_lock_release_timeout_ms,
+                  3000,
+                  "the max time to wait for the leader lock to be released when the meta server "
+                  "stops, so that another meta server takes over without waiting for the "
+                  "session of this one to expire, 0 means the lock isn't released on stop");
+
 meta_server_failure_detector::meta_server_failure_detector(meta_service *svc)
     : _svc(svc),
       _lock_svc(nullptr),
@@ -67,6 +75,7 @@ meta_server_failure_detector::~meta_server_failure_detector()
         _lock_grant_task->cancel(true);
     if (_lock_expire_task)
         _lock_expire_task->cancel(true);
+    release_leader_lock();
     if (_lock_svc) {
         _lock_svc->finalize();
         delete _lock_svc;
@@ -178,6 +187,28 @@ void meta_server_failure_detector::acquire_leader_lock()
     }
 }
 
+void meta_server_failure_detector::release_leader_lock()
+{
+    if (_lock_svc == nullptr || FLAGS_leader_lock_release_timeout_ms == 0 ||
+        !_is_leader.exchange(false)) {
+        return;
+    }
+
+    // the candidates are watching the lock node, one of which is granted the lock as soon as
+    // the node is removed
+    error_code err = ERR_TIMEOUT;
+    task_ptr tsk = _lock_svc->unlock(_primary_lock_id,
+                                     dsn_primary_address().to_std_string(),
+                                     false,
+                                     LPC_META_SERVER_LEADER_LOCK_CALLBACK,
+                                     [&err](error_code ec) { err = ec; });
+    if (!tsk->wait(FLAGS_leader_lock_release_timeout_ms)) {
+        // the callback may run after `err` is gone
+        tsk->cancel(true);
+    }
+    ddebug_f("release the leader lock on stop, err = {}", err);
+}
+
 void meta_server_failure_detector::reset_stability_stat(const rpc_address &node)
 {
     zauto_lock l(_map_lock);
@@ -258,8 +289,45 @@ bool meta_server_failure_detector::update_stability_stat(const fd::beacon_msg &b
     }
 }
 
+DEFINE_TASK_CODE(LPC_META_SERVER_FD_BEACON_BATCH, TASK_PRIORITY_HIGH, fd::THREAD_POOL_FD)
 void meta_server_failure_detector::on_ping(const fd::beacon_msg &beacon,
                                            rpc_replier<fd::beacon_ack> &reply)
+{
+    if (!_fd_opts->batch_beacons) {
+        dsn::rpc_address leader;
+        bool is_leader = get_leader(&leader);
+        handle_beacon(beacon, is_leader, leader, reply);
+        return;
+    }
+
+    bool schedule;
+    {
+        zauto_lock l(_pending_lock);
+        schedule = _pending_beacons.empty();
+        _pending_beacons.emplace_back(beacon, std::move(reply));
+    }
+    if (schedule) {
+        tasking::enqueue(LPC_META_SERVER_FD_BEACON_BATCH, &_tracker, [this]() {
+            std::vector<pending_beacon> beacons;
+            {
+                zauto_lock l(_pending_lock);
+                beacons.swap(_pending_beacons);
+            }
+
+            dsn::rpc_address leader;
+            bool is_leader = get_leader(&leader);
+            for (auto &pr : beacons) {
+                handle_beacon(pr.first, is_leader, leader, pr.second);
+            }
+            dinfo("%d beacons are handled in batch", (int)beacons.size());
+        });
+    }
+}
+
+void meta_server_failure_detector::handle_beacon(const fd::beacon_msg &beacon,
+                                                 bool is_leader,
+                                                 rpc_address leader,
+                                                 rpc_replier<fd::beacon_ack> &reply)
 {
     fd::beacon_ack ack;
     ack.time = beacon.time;
@@ -271,8 +339,7 @@ void meta_server_failure_detector::on_ping(const fd::beacon_msg &beacon,
         return;
     }
 
-    dsn::rpc_address leader;
-    if (!get_leader(&leader)) {
+    if (!is_leader) {
         ack.is_master = false;
         ack.primary_node = leader;
     } else {
@@ -75,6 +75,10 @@ public:
     // return if acquire the leader lock, or-else blocked forever
     void acquire_leader_lock();
 
+    // called on stop, the lock is released if held, so that the other meta servers needn't
+    // wait for the session of this one to expire
+    void release_leader_lock();
+
     void reset_stability_stat(const dsn::rpc_address &node);
 
     // _fd_opts is initialized in constructor with a fd_suboption stored in meta_service.
@@ -109,9 +113,19 @@ public:
         }
         return failure_detector::is_worker_connected(node);
     }
+    // with fd_batch_beacons, the beacons are queued and handled in batch by one task, so that
+    // the leader is checked once for all of them, and thousands of replica servers don't
+    // occupy as many tasks of the fd pool in each beacon interval
     virtual void on_ping(const fd::beacon_msg &beacon, rpc_replier<fd::beacon_ack> &reply) override;
 
 private:
+    typedef std::pair<fd::beacon_msg, rpc_replier<fd::beacon_ack>> pending_beacon;
+
+    void handle_beacon(const fd::beacon_msg &beacon,
+                       bool is_leader,
+                       rpc_address leader,
+                       rpc_replier<fd::beacon_ack> &reply);
+
     // return value: return true if beacon.from_addr is stable; or-else, false
     bool update_stability_stat(const fd::beacon_msg &beacon);
     void leader_initialize(const std::string &lock_service_owner);
@@ -138,6 +152,10 @@ private:
     mutable zlock _map_lock;
     stability_map _stablity;
 
+    // the beacons waiting for the batch task, which is scheduled when it becomes non-empty
+    zlock _pending_lock;
+    std::vector<pending_beacon> _pending_beacons;
+
 public:
     /* these two functions are for test */
     meta_server_failure_detector(rpc_address leader_address, bool is_myself_leader);
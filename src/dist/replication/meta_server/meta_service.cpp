@@ -36,6 +36,7 @@
 #include <dsn/dist/replication/duplication_common.h>
 #include <dsn/dist/remote_command.h>
 #include <dsn/tool-api/command_manager.h>
+#include <dsn/utility/flags.h>
 #include <algorithm> // for std::remove_if
 #include <cctype>    // for ::isspace
 #include <dsn/dist/fmt_logging.h>
@@ -47,10 +48,22 @@
 #include "duplication/meta_duplication_service.h"
 #include "meta_split_service.h"
 #include "meta_bulk_load_service.h"
+#include "warm_standby.h"
 
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_bool(warm_standby_enabled);
+DSN_DECLARE_uint32(warm_standby_refresh_interval_ms);
+DSN_DECLARE_uint32(warm_standby_journal_max_entries);
+
+DSN_DEFINE_bool("meta_server",
+                config_sync_sharded_enabled,
+                true,
+                "whether the config syncs of the alive nodes are handled in the meta server pool "
+                "by the node address, and passed to the meta state pool only if they diverge "
+                "from the routing table");
+
 meta_service::meta_service()
     : serverlet("meta_service"), _failure_detector(nullptr), _started(false), _recovering(false)
 {
@@ -150,6 +163,11 @@ error_code meta_service::remote_storage_initialize()
         return err;
     }
     _storage.reset(storage);
+    if (FLAGS_warm_standby_enabled) {
+        auto journaled = std::make_shared<journaled_meta_state_service>(std::move(_storage));
+        _journaled_storage = journaled.get();
+        _storage = std::move(journaled);
+    }
     _meta_storage.reset(new mss::meta_storage(_storage.get(), &_tracker));
 
     std::vector<std::string> slices;
@@ -168,6 +186,18 @@ error_code meta_service::remote_storage_initialize()
     }
     _cluster_root = current.empty() ? "/" : current;
 
+    if (_journaled_storage != nullptr) {
+        _storage
+            ->create_node(meta_options::concat_path_unix_style(_cluster_root, "apps_journal"),
+                          LPC_META_CALLBACK,
+                          [&err](error_code ec) { err = ec; })
+            ->wait();
+        if (err != ERR_OK && err != ERR_NODE_ALREADY_EXIST) {
+            derror_f("create journal root failed, err = {}", err);
+            return err;
+        }
+    }
+
     ddebug("init meta_state_service succeed, cluster_root = %s", _cluster_root.c_str());
     return ERR_OK;
 }
@@ -184,6 +214,7 @@ void meta_service::set_node_state(const std::vector<rpc_address> &nodes, bool is
             _dead_set.insert(node);
         }
     }
+    ++_node_state_version;
 
     _recent_disconnect_count->add(is_alive ? 0 : nodes.size());
     _unalive_nodes_count->set(_dead_set.size());
@@ -253,6 +284,7 @@ void meta_service::start_service()
         if (_dead_set.find(kv.first) == _dead_set.end())
             _alive_set.insert(kv.first);
     }
+    ++_node_state_version;
 
     for (const dsn::rpc_address &node : _alive_set) {
         // sync alive set and the failure_detector
@@ -332,11 +364,43 @@ error_code meta_service::start()
     // so that the command line call can be handled
     dist::cmd::register_remote_command_rpc();
 
+    std::string apps_root = meta_options::concat_path_unix_style(_cluster_root, "apps");
+    if (_journaled_storage != nullptr) {
+        _warm_standby = make_unique<warm_standby>(
+            _storage.get(),
+            apps_root,
+            meta_options::concat_path_unix_style(_cluster_root, "apps_journal"));
+        _warm_standby->start(std::chrono::milliseconds(FLAGS_warm_standby_refresh_interval_ms));
+    }
+
     _failure_detector->acquire_leader_lock();
     dassert(_failure_detector->get_leader(nullptr), "must be primary at this point");
     ddebug("%s got the primary lock, start to recover server state from remote storage",
            dsn_primary_address().to_string());
 
+    // catch up the tail of the journal, and start journaling before any write as the leader
+    dist::meta_state_service *warm_snapshot = nullptr;
+    if (_warm_standby != nullptr) {
+        uint64_t start_ms = dsn_now_ms();
+        _warm_standby->stop();
+        err = _warm_standby->refresh();
+        if (err == ERR_OK) {
+            warm_snapshot = _warm_standby->snapshot();
+            ddebug_f("warm standby caught up the journal to entry {} in {} ms",
+                     _warm_standby->latest_seq(),
+                     dsn_now_ms() - start_ms);
+        } else {
+            dwarn_f("warm standby failed to catch up the journal, err = {}, recover server "
+                    "state from remote storage",
+                    err);
+        }
+        _journaled_storage->start_journal(
+            apps_root,
+            meta_options::concat_path_unix_style(_cluster_root, "apps_journal"),
+            _warm_standby->latest_seq() + 1,
+            FLAGS_warm_standby_journal_max_entries);
+    }
+
     // initialize the load balancer
     server_load_balancer *balancer = utils::factory_store<server_load_balancer>::create(
         _meta_opts._lb_opts.server_load_balancer_type.c_str(), PROVIDER_TYPE_MAIN, this);
@@ -359,8 +423,8 @@ error_code meta_service::start()
         this, meta_options::concat_path_unix_style(_cluster_root, "bulk_load"));
 
     // initialize the server_state
-    _state->initialize(this, meta_options::concat_path_unix_style(_cluster_root, "apps"));
-    while ((err = _state->initialize_data_structure()) != ERR_OK) {
+    _state->initialize(this, apps_root);
+    while ((err = _state->initialize_data_structure(warm_snapshot)) != ERR_OK) {
         if (err == ERR_OBJECT_NOT_FOUND && _meta_opts.recover_from_replica_server) {
             ddebug("can't find apps from remote storage, and "
                    "[meta_server].recover_from_replica_server = true, "
@@ -369,7 +433,9 @@ error_code meta_service::start()
         }
         derror("initialize server state from remote storage failed, err = %s, retry ...",
                err.to_string());
+        warm_snapshot = nullptr;
     }
+    _warm_standby.reset();
 
     initialize_duplication_service();
     recover_duplication_from_meta_state();
@@ -615,6 +681,20 @@ void meta_service::on_query_configuration_by_index(configuration_query_by_index_
         return;
     }
 
+    if (rpc.request().__isset.wait_ms && rpc.request().wait_ms > 0 &&
+        _state->subscribe_route(rpc)) {
+        return;
+    }
+
+    // the hot queries are served by the cached responses, without serializing them again
+    if (rpc.dsn_request()->header->context.u.serialize_format == DSF_THRIFT_BINARY) {
+        blob body;
+        if (_state->query_configuration_by_index_serialized(rpc.request(), body)) {
+            rpc.reply_serialized(body);
+            return;
+        }
+    }
+
     _state->query_configuration_by_index(rpc.request(), response);
     if (ERR_OK == response.err) {
         ddebug_f("client {} queried an available app {} with appid {}",
@@ -641,11 +721,22 @@ void meta_service::on_config_sync(configuration_query_by_node_rpc rpc)
         // AFTER the node dead is dispatch
         // AFTER the node dead event
         zauto_lock l(_failure_detector->_lock);
-        tasking::enqueue(LPC_META_STATE_HIGH,
-                         nullptr,
-                         std::bind(&server_state::on_config_sync, _state.get(), rpc),
-                         server_state::sStateHash);
+        if (!FLAGS_config_sync_sharded_enabled ||
+            _alive_set.find(rpc.request().node) == _alive_set.end()) {
+            tasking::enqueue(LPC_META_STATE_HIGH,
+                             nullptr,
+                             std::bind(&server_state::on_config_sync, _state.get(), rpc),
+                             server_state::sStateHash);
+            return;
+        }
     }
+
+    // the node is alive, so the node dead event will be handled AFTER this request, which is
+    // fine to be replied from the routing table
+    tasking::enqueue(LPC_META_CONFIG_SYNC,
+                     nullptr,
+                     std::bind(&server_state::on_config_sync_sharded, _state.get(), rpc),
+                     std::hash<rpc_address>()(rpc.request().node));
 }
 
 void meta_service::on_update_configuration(dsn::message_ex *req)
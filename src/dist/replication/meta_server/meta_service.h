@@ -56,6 +56,8 @@ class server_load_balancer;
 class meta_duplication_service;
 class meta_split_service;
 class bulk_load_service;
+class journaled_meta_state_service;
+class warm_standby;
 namespace test {
 class test_checker;
 }
@@ -240,6 +242,10 @@ private:
 
     std::shared_ptr<dist::meta_state_service> _storage;
     std::unique_ptr<mss::meta_storage> _meta_storage;
+    // not null if [meta_server] warm_standby_enabled, which wraps the remote storage in _storage
+    journaled_meta_state_service *_journaled_storage{nullptr};
+    // the copy of the apps kept before this becomes the leader
+    std::unique_ptr<warm_standby> _warm_standby;
 
     std::shared_ptr<server_load_balancer> _balancer;
     std::shared_ptr<backup_service> _backup_handler;
@@ -251,6 +257,7 @@ private:
     friend class meta_backup_test_base;
     friend class meta_http_service;
     friend class meta_service_test;
+    friend class partition_chunk_store_test;
     std::unique_ptr<meta_duplication_service> _dup_svc;
 
     std::unique_ptr<meta_split_service> _split_svc;
@@ -266,6 +273,8 @@ private:
     std::set<rpc_address> _alive_set;
     std::set<rpc_address> _dead_set;
     // ]
+    // increased whenever _alive_set or _dead_set changes
+    std::atomic<int64_t> _node_state_version{0};
     mutable zrwlock_nr _meta_lock;
 
     std::atomic_bool _started;
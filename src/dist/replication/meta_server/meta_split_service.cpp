@@ -25,6 +25,7 @@
  */
 
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
 
 #include "dist/replication/meta_server/meta_split_service.h"
 #include "dist/replication/meta_server/meta_state_service_utils.h"
@@ -32,10 +33,27 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_int32("meta_server",
+                 register_child_batch_size,
+                 256,
+                 "the max count of the child partitions registered in one transaction on remote "
+                 "storage, 0 to register them one by one");
+DSN_TAG_VARIABLE(register_child_batch_size, FT_MUTABLE);
+
 meta_split_service::meta_split_service(meta_service *meta_srv)
 {
     _meta_svc = meta_srv;
     _state = meta_srv->get_server_state();
+
+    _pending_child_count.init_app_counter("eon.meta_split_service",
+                                          "pending_child_count",
+                                          COUNTER_TYPE_NUMBER,
+                                          "count of the child partitions being registered");
+    _recent_registered_child_count.init_app_counter(
+        "eon.meta_split_service",
+        "recent_registered_child_count",
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        "count of the child partitions registered in the recent period");
 }
 
 void meta_split_service::app_partition_split(app_partition_split_rpc rpc)
@@ -115,6 +133,7 @@ void meta_split_service::do_app_partition_split(std::shared_ptr<app_state> app,
                 app->partitions[i].pid = gpid(app->app_id, i);
             }
         }
+        _state->publish_app_route(*app);
 
         auto &response = rpc.response();
         response.err = ERR_OK;
@@ -138,7 +157,7 @@ void meta_split_service::register_child_on_meta(register_child_rpc rpc)
     auto &response = rpc.response();
     response.err = ERR_IO_PENDING;
 
-    zauto_write_lock(app_lock());
+    zauto_write_lock l(app_lock());
     std::shared_ptr<app_state> app = _state->get_app(request.app.app_id);
     dassert_f(app != nullptr, "app is not existed, id({})", request.app.app_id);
     dassert_f(app->is_stateful, "app is stateless currently, id({})", request.app.app_id);
@@ -178,47 +197,139 @@ void meta_split_service::register_child_on_meta(register_child_rpc rpc)
     ddebug_f("parent({}) will register child({})", parent_gpid, child_gpid);
     parent_context.stage = config_status::pending_remote_sync;
     parent_context.msg = rpc.dsn_request();
-    parent_context.pending_sync_task = add_child_on_remote_storage(rpc, true);
+    _pending_child_count->increment();
+    if (FLAGS_register_child_batch_size <= 0 ||
+        _state->_chunk_store->get_chunk_size(app->app_id) > 0) {
+        // the partitions in the same chunk are batched by the chunk store
+        parent_context.pending_sync_task = add_child_on_remote_storage(rpc, true);
+        return;
+    }
+    _pending_children[app->app_id].rpcs.emplace_back(std::move(rpc));
+    register_children_on_remote_storage(app->app_id);
+}
+
+void meta_split_service::register_children_on_remote_storage(int32_t app_id)
+{
+    pending_children &pending = _pending_children[app_id];
+    if (pending.registering || pending.rpcs.empty()) {
+        return;
+    }
+
+    size_t count = std::min(pending.rpcs.size(),
+                            static_cast<size_t>(std::max(FLAGS_register_child_batch_size, 1)));
+    std::vector<register_child_rpc> children(
+        std::make_move_iterator(pending.rpcs.begin()),
+        std::make_move_iterator(pending.rpcs.begin() + count));
+    pending.rpcs.erase(pending.rpcs.begin(), pending.rpcs.begin() + count);
+    pending.registering = true;
+    submit_children_on_remote_storage(app_id, std::move(children));
+}
+
+void meta_split_service::submit_children_on_remote_storage(
+    int32_t app_id, std::vector<register_child_rpc> children)
+{
+    std::shared_ptr<app_state> app = _state->get_app(app_id);
+    dassert_f(app != nullptr, "app is not existed, id({})", app_id);
+
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    std::shared_ptr<dist::meta_state_service::transaction_entries> entries =
+        storage->new_transaction_entries(children.size());
+    for (const register_child_rpc &rpc : children) {
+        const partition_configuration &child_config = rpc.request().child_config;
+        blob value = dsn::json::json_forwarder<partition_configuration>::encode(child_config);
+        entries->create_node(_state->get_partition_path(child_config.pid), value);
+    }
+
+    std::vector<int> parent_indexes;
+    parent_indexes.reserve(children.size());
+    for (const register_child_rpc &rpc : children) {
+        parent_indexes.push_back(rpc.request().parent_config.pid.get_partition_index());
+    }
+    ddebug_f("app({}) register {} children on remote storage", app_id, children.size());
+
+    task_ptr t = storage->submit_transaction(
+        entries,
+        LPC_META_STATE_HIGH,
+        [ this, app_id, children = std::move(children) ](error_code ec) mutable {
+            on_register_children_on_remote_storage_reply(ec, app_id, std::move(children));
+        },
+        _meta_svc->tracker());
+    for (int pidx : parent_indexes) {
+        app->helpers->contexts[pidx].pending_sync_task = t;
+    }
+}
+
+void meta_split_service::on_register_children_on_remote_storage_reply(
+    error_code ec, int32_t app_id, std::vector<register_child_rpc> children)
+{
+    zauto_write_lock l(app_lock());
+
+    std::shared_ptr<app_state> app = _state->get_app(app_id);
+    dassert_f(app != nullptr, "app is not existed, id({})", app_id);
+    dassert_f(app->status == app_status::AS_AVAILABLE || app->status == app_status::AS_DROPPING,
+              "app is not available now, id({})",
+              app_id);
+
+    if (ec == ERR_TIMEOUT) {
+        dwarn_f("app({}) register {} children on remote storage timeout, retry later",
+                app_id,
+                children.size());
+        tasking::enqueue(LPC_META_STATE_HIGH,
+                         _meta_svc->tracker(),
+                         [ this, app_id, children = std::move(children) ]() mutable {
+                             zauto_write_lock l(app_lock());
+                             submit_children_on_remote_storage(app_id, std::move(children));
+                         },
+                         0,
+                         std::chrono::seconds(1));
+        return;
+    }
+
+    if (ec == ERR_OK) {
+        for (register_child_rpc &rpc : children) {
+            on_child_registered(*app, rpc);
+        }
+    } else {
+        // e.g. some of the children have been created by a transaction which timed out, so
+        // they're registered one by one, where the existing ones are overwritten
+        dwarn_f("app({}) register {} children on remote storage failed, err({}), register them "
+                "one by one",
+                app_id,
+                children.size(),
+                ec);
+        for (register_child_rpc &rpc : children) {
+            int pidx = rpc.request().parent_config.pid.get_partition_index();
+            app->helpers->contexts[pidx].pending_sync_task =
+                add_child_on_remote_storage(rpc, true);
+        }
+    }
+
+    _pending_children[app_id].registering = false;
+    register_children_on_remote_storage(app_id);
 }
 
 dsn::task_ptr meta_split_service::add_child_on_remote_storage(register_child_rpc rpc,
                                                               bool create_new)
 {
     const auto &request = rpc.request();
-    const std::string &partition_path = _state->get_partition_path(request.child_config.pid);
-    blob value = dsn::json::json_forwarder<partition_configuration>::encode(request.child_config);
-    if (create_new) {
-        return _meta_svc->get_remote_storage()->create_node(
-            partition_path,
-            LPC_META_STATE_HIGH,
-            std::bind(&meta_split_service::on_add_child_on_remote_storage_reply,
-                      this,
-                      std::placeholders::_1,
-                      rpc,
-                      create_new),
-            value);
-    } else {
-        return _meta_svc->get_remote_storage()->set_data(
-            partition_path,
-            value,
-            LPC_META_STATE_HIGH,
-            std::bind(&meta_split_service::on_add_child_on_remote_storage_reply,
-                      this,
-                      std::placeholders::_1,
-                      rpc,
-                      create_new),
-            _meta_svc->tracker());
-    }
+    return _state->write_partition_on_remote(
+        request.child_config,
+        create_new,
+        std::bind(&meta_split_service::on_add_child_on_remote_storage_reply,
+                  this,
+                  std::placeholders::_1,
+                  rpc,
+                  create_new),
+        create_new ? nullptr : _meta_svc->tracker());
 }
 
 void meta_split_service::on_add_child_on_remote_storage_reply(error_code ec,
                                                               register_child_rpc rpc,
                                                               bool create_new)
 {
-    zauto_write_lock(app_lock());
+    zauto_write_lock l(app_lock());
 
     const auto &request = rpc.request();
-    auto &response = rpc.response();
 
     std::shared_ptr<app_state> app = _state->get_app(request.app.app_id);
     dassert_f(app != nullptr, "app is not existed, id({})", request.app.app_id);
@@ -227,7 +338,6 @@ void meta_split_service::on_add_child_on_remote_storage_reply(error_code ec,
               request.app.app_id);
 
     dsn::gpid parent_gpid = request.parent_config.pid;
-    dsn::gpid child_gpid = request.child_config.pid;
     config_context &parent_context = app->helpers->contexts[parent_gpid.get_partition_index()];
 
     if (ec == ERR_TIMEOUT ||
@@ -247,29 +357,43 @@ void meta_split_service::on_add_child_on_remote_storage_reply(error_code ec,
     }
     dassert_f(ec == ERR_OK, "we can't handle this right now, err = {}", ec.to_string());
 
+    on_child_registered(*app, rpc);
+}
+
+void meta_split_service::on_child_registered(app_state &app, register_child_rpc &rpc)
+{
+    const auto &request = rpc.request();
+    auto &response = rpc.response();
+
+    dsn::gpid parent_gpid = request.parent_config.pid;
+    dsn::gpid child_gpid = request.child_config.pid;
+    config_context &parent_context = app.helpers->contexts[parent_gpid.get_partition_index()];
+
     ddebug_f("parent({}) resgiter child({}) on remote storage succeed", parent_gpid, child_gpid);
 
     // update local child partition configuration
     std::shared_ptr<configuration_update_request> update_child_request =
         std::make_shared<configuration_update_request>();
     update_child_request->config = request.child_config;
-    update_child_request->info = *app;
+    update_child_request->info = app;
     update_child_request->type = config_type::CT_REGISTER_CHILD;
     update_child_request->node = request.primary_address;
 
-    partition_configuration child_config = app->partitions[child_gpid.get_partition_index()];
+    partition_configuration child_config = app.partitions[child_gpid.get_partition_index()];
     child_config.secondaries = request.child_config.secondaries;
-    _state->update_configuration_locally(*app, update_child_request);
+    _state->update_configuration_locally(app, update_child_request);
 
     parent_context.pending_sync_task = nullptr;
     parent_context.stage = config_status::not_pending;
     if (parent_context.msg) {
         response.err = ERR_OK;
-        response.app = *app;
-        response.parent_config = app->partitions[parent_gpid.get_partition_index()];
-        response.child_config = app->partitions[child_gpid.get_partition_index()];
+        response.app = app;
+        response.parent_config = app.partitions[parent_gpid.get_partition_index()];
+        response.child_config = app.partitions[child_gpid.get_partition_index()];
         parent_context.msg = nullptr;
     }
+    _pending_child_count->decrement();
+    _recent_registered_child_count->increment();
 }
 
 } // namespace replication
@@ -23,6 +23,8 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+
 #include "dist/replication/meta_server/meta_service.h"
 #include "dist/replication/meta_server/server_state.h"
 
@@ -47,10 +49,39 @@ private:
     void
     on_add_child_on_remote_storage_reply(error_code ec, register_child_rpc rpc, bool create_new);
 
+    // meta -> remote storage to create the nodes of the pending children of an app in one
+    // transaction, the children registered while a transaction of the app is in flight are
+    // batched into the next one
+    // caller should hold app_lock()
+    void register_children_on_remote_storage(int32_t app_id);
+    // caller should hold app_lock()
+    void submit_children_on_remote_storage(int32_t app_id,
+                                           std::vector<register_child_rpc> children);
+    void on_register_children_on_remote_storage_reply(error_code ec,
+                                                      int32_t app_id,
+                                                      std::vector<register_child_rpc> children);
+
+    // update the child partition configuration after it's written on remote storage, and
+    // reply to the parent
+    // caller should hold app_lock()
+    void on_child_registered(app_state &app, register_child_rpc &rpc);
+
 private:
     meta_service *_meta_svc;
     server_state *_state;
 
+    struct pending_children
+    {
+        // whether a transaction of the app is in flight
+        bool registering{false};
+        std::vector<register_child_rpc> rpcs;
+    };
+    // app_id -> the children to be registered in the next transaction, protected by app_lock()
+    std::unordered_map<int32_t, pending_children> _pending_children;
+
+    perf_counter_wrapper _pending_child_count;
+    perf_counter_wrapper _recent_registered_child_count;
+
     zrwlock_nr &app_lock() const { return _state->_lock; }
 };
 } // namespace replication
@@ -38,12 +38,32 @@
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/async_calls.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
 #include <stack>
+#include <thread>
 #include <utility>
+#include <unistd.h>
 
 namespace dsn {
 namespace dist {
+
+DSN_DEFINE_uint64("meta_state_service_simple",
+                  checkpoint_log_size_kb,
+                  64 * 1024,
+                  "checkpoint the tree and remove the logs once the current log is larger than "
+                  "this size, 0 means never checkpointing");
+
+namespace {
+
+const size_t checkpoint_chunk_node_count = 4096;
+
+} // anonymous namespace
+
 // path: /, /n1/n2, /n1/n2/, /n2/n2/n3
 std::string meta_state_service_simple::normalize_path(const std::string &s)
 {
@@ -82,6 +102,16 @@ void meta_state_service_simple::write_log(blob &&log_blob,
                                           task_ptr task)
 {
     _log_lock.lock();
+    if (FLAGS_checkpoint_log_size_kb > 0 && !_checkpointing &&
+        _offset >= FLAGS_checkpoint_log_size_kb * 1024) {
+        error_code err = switch_log();
+        if (err != ERR_OK) {
+            dwarn("switch log failed, keep logging into log %" PRId64 ", err = %s",
+                  _log_index,
+                  err.to_string());
+        }
+    }
+    disk_file *log = _log;
     uint64_t log_offset = _offset;
     _offset += log_blob.length();
     auto continuation_task = std::unique_ptr<operation>(new operation(false, [=](bool log_succeed) {
@@ -92,7 +122,7 @@ void meta_state_service_simple::write_log(blob &&log_blob,
     _task_queue.emplace(move(continuation_task));
     _log_lock.unlock();
 
-    file::write(_log,
+    file::write(log,
                 log_blob.data(),
                 log_blob.length(),
                 log_offset,
@@ -103,17 +133,297 @@ void meta_state_service_simple::write_log(blob &&log_blob,
                             "we cannot handle logging failure now");
                     _log_lock.lock();
                     continuation_task_ptr->done = true;
-                    while (!_task_queue.empty()) {
-                        if (!_task_queue.front()->done) {
-                            break;
-                        }
-                        _task_queue.front()->cb(true);
-                        _task_queue.pop();
-                    }
+                    drain_task_queue();
                     _log_lock.unlock();
                 });
 }
 
+void meta_state_service_simple::drain_task_queue()
+{
+    while (!_task_queue.empty()) {
+        if (!_task_queue.front()->done) {
+            break;
+        }
+        _task_queue.front()->cb(true);
+        _task_queue.pop();
+    }
+}
+
+std::string meta_state_service_simple::get_log_path(int64_t log_index) const
+{
+    std::string log_path = utils::filesystem::path_combine(_work_dir, "meta_state_service.log");
+    return log_index == 0 ? log_path : log_path + "." + std::to_string(log_index);
+}
+
+std::string meta_state_service_simple::get_checkpoint_path() const
+{
+    return utils::filesystem::path_combine(_work_dir, "meta_state_service.checkpoint");
+}
+
+error_code meta_state_service_simple::switch_log()
+{
+    std::string log_path = get_log_path(_log_index + 1);
+    if (utils::filesystem::file_exists(log_path)) {
+        utils::filesystem::remove_path(log_path);
+    }
+    disk_file *log = file::open(log_path.c_str(), O_RDWR | O_CREAT | O_BINARY, 0666);
+    if (!log) {
+        derror("open file failed: %s", log_path.c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    disk_file *old_log = _log;
+    int64_t log_index = ++_log_index;
+    _log = log;
+    _offset = 0;
+    _checkpointing = true;
+    ddebug("switch to log %s for checkpointing", log_path.c_str());
+
+    // this is called after all the operations of the old logs are applied, and before any
+    // operation of the new log is applied
+    _task_queue.emplace(new operation(true, [this, old_log, log_index](bool) {
+        file::close(old_log);
+        std::shared_ptr<node_list> nodes = std::make_shared<node_list>();
+        {
+            zauto_lock _(_state_lock);
+            get_all_nodes(*nodes);
+        }
+        tasking::enqueue(LPC_META_STATE_SERVICE_SIMPLE_CHECKPOINT,
+                         &_tracker,
+                         [this, log_index, nodes]() { write_checkpoint(log_index, *nodes); });
+    }));
+    drain_task_queue();
+    return ERR_OK;
+}
+
+void meta_state_service_simple::get_all_nodes(/*out*/ node_list &nodes) const
+{
+    nodes.reserve(_quick_map.size());
+    std::stack<std::pair<std::string, const state_node *>> stack;
+    stack.emplace("", &_root);
+    while (!stack.empty()) {
+        std::pair<std::string, const state_node *> top = std::move(stack.top());
+        stack.pop();
+        for (const auto &kv : top.second->children) {
+            std::string path = top.first + "/" + kv.first;
+            nodes.emplace_back(path, kv.second->data);
+            stack.emplace(std::move(path), kv.second);
+        }
+    }
+}
+
+void meta_state_service_simple::write_checkpoint(int64_t log_index, const node_list &nodes)
+{
+    binary_writer writer;
+    checkpoint_header header;
+    header.log_index = log_index;
+    header.chunk_count = static_cast<uint32_t>(
+        (nodes.size() + checkpoint_chunk_node_count - 1) / checkpoint_chunk_node_count);
+    writer.write_pod(header);
+    for (size_t begin = 0; begin < nodes.size(); begin += checkpoint_chunk_node_count) {
+        size_t end = std::min(nodes.size(), begin + checkpoint_chunk_node_count);
+        binary_writer chunk_writer;
+        for (size_t i = begin; i < end; ++i) {
+            marshall(chunk_writer, nodes[i].first, DSF_THRIFT_BINARY);
+            marshall(chunk_writer, nodes[i].second, DSF_THRIFT_BINARY);
+        }
+        blob chunk = chunk_writer.get_buffer();
+        checkpoint_chunk_header chunk_header;
+        chunk_header.size = static_cast<uint32_t>(chunk.length());
+        chunk_header.node_count = static_cast<uint32_t>(end - begin);
+        writer.write_pod(chunk_header);
+        writer.write(chunk.data(), chunk.length());
+    }
+    blob buffer = writer.get_buffer();
+
+    std::string checkpoint_path = get_checkpoint_path();
+    std::string tmp_path = checkpoint_path + ".tmp";
+    bool succeed = false;
+    if (FILE *fd = fopen(tmp_path.c_str(), "wb")) {
+        succeed = fwrite(buffer.data(), buffer.length(), 1, fd) == 1 && fflush(fd) == 0 &&
+                  fsync(fileno(fd)) == 0;
+        succeed = fclose(fd) == 0 && succeed;
+    }
+    succeed = succeed && utils::filesystem::rename_path(tmp_path, checkpoint_path);
+    if (succeed) {
+        ddebug("write checkpoint %s succeed, node_count = %d, log_index = %" PRId64,
+               checkpoint_path.c_str(),
+               static_cast<int>(nodes.size()),
+               log_index);
+        remove_logs_before(log_index);
+    } else {
+        derror("write checkpoint %s failed, keep the logs", tmp_path.c_str());
+    }
+
+    zauto_lock l(_log_lock);
+    _checkpointing = false;
+}
+
+void meta_state_service_simple::remove_logs_before(int64_t log_index)
+{
+    for (int64_t i = log_index - 1; i >= 0; --i) {
+        std::string log_path = get_log_path(i);
+        if (!utils::filesystem::file_exists(log_path)) {
+            break;
+        }
+        if (!utils::filesystem::remove_path(log_path)) {
+            dwarn("remove log %s failed", log_path.c_str());
+        }
+    }
+}
+
+error_code meta_state_service_simple::load_checkpoint(/*out*/ int64_t &log_index)
+{
+    log_index = 0;
+    std::string checkpoint_path = get_checkpoint_path();
+    if (!utils::filesystem::file_exists(checkpoint_path)) {
+        return ERR_OK;
+    }
+
+    int64_t file_size = 0;
+    if (!utils::filesystem::file_size(checkpoint_path, file_size)) {
+        derror("get size of checkpoint %s failed", checkpoint_path.c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    std::shared_ptr<char> buffer(dsn::utils::make_shared_array<char>(file_size));
+    FILE *fd = fopen(checkpoint_path.c_str(), "rb");
+    if (fd == nullptr) {
+        derror("open checkpoint %s failed", checkpoint_path.c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    bool read_succeed = file_size == 0 || fread(buffer.get(), file_size, 1, fd) == 1;
+    fclose(fd);
+    if (!read_succeed) {
+        derror("read checkpoint %s failed", checkpoint_path.c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    // locate the chunks, and then decode them in parallel
+    binary_reader reader(blob(buffer, static_cast<int>(file_size)));
+    checkpoint_header header;
+    if (reader.read_pod(header) != sizeof(header) ||
+        header.magic != checkpoint_header::default_magic ||
+        header.version != checkpoint_header::default_version) {
+        derror("invalid header of checkpoint %s", checkpoint_path.c_str());
+        return ERR_CORRUPTION;
+    }
+    std::vector<std::pair<blob, uint32_t>> chunks(header.chunk_count);
+    for (auto &chunk : chunks) {
+        checkpoint_chunk_header chunk_header;
+        if (reader.read_pod(chunk_header) != sizeof(chunk_header) ||
+            reader.read(chunk.first, chunk_header.size) != static_cast<int>(chunk_header.size)) {
+            derror("checkpoint %s is truncated", checkpoint_path.c_str());
+            return ERR_CORRUPTION;
+        }
+        chunk.second = chunk_header.node_count;
+    }
+
+    std::vector<node_list> chunk_nodes(chunks.size());
+    std::atomic<size_t> next_chunk(0);
+    auto decode_chunks = [&chunks, &chunk_nodes, &next_chunk]() {
+        for (size_t i = next_chunk++; i < chunks.size(); i = next_chunk++) {
+            binary_reader chunk_reader(chunks[i].first);
+            chunk_nodes[i].resize(chunks[i].second);
+            for (auto &node : chunk_nodes[i]) {
+                unmarshall(chunk_reader, node.first, DSF_THRIFT_BINARY);
+                unmarshall(chunk_reader, node.second, DSF_THRIFT_BINARY);
+            }
+        }
+    };
+    size_t thread_count =
+        std::min<size_t>(chunks.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back(decode_chunks);
+    }
+    decode_chunks();
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    // the parent of a node is created before it
+    int node_count = 0;
+    for (const node_list &nodes : chunk_nodes) {
+        for (const auto &node : nodes) {
+            error_code err = create_node_internal(node.first, node.second);
+            if (err != ERR_OK) {
+                derror("load node %s from checkpoint %s failed, err = %s",
+                       node.first.c_str(),
+                       checkpoint_path.c_str(),
+                       err.to_string());
+                return ERR_CORRUPTION;
+            }
+            ++node_count;
+        }
+    }
+
+    log_index = header.log_index;
+    ddebug("load checkpoint %s succeed, node_count = %d, log_index = %" PRId64,
+           checkpoint_path.c_str(),
+           node_count,
+           log_index);
+    return ERR_OK;
+}
+
+bool meta_state_service_simple::replay_log(const std::string &log_path, /*out*/ uint64_t &offset)
+{
+    offset = 0;
+    FILE *fd = fopen(log_path.c_str(), "rb");
+    if (fd == nullptr) {
+        return true;
+    }
+    for (;;) {
+        log_header header;
+        if (fread(&header, sizeof(log_header), 1, fd) != 1) {
+            break;
+        }
+        if (header.magic != log_header::default_magic) {
+            break;
+        }
+        std::shared_ptr<char> buffer(dsn::utils::make_shared_array<char>(header.size));
+        if (fread(buffer.get(), header.size, 1, fd) != 1) {
+            break;
+        }
+        offset += sizeof(header) + header.size;
+        binary_reader reader(blob(buffer, (int)header.size));
+        int op_type;
+        reader.read(op_type);
+
+        switch (static_cast<operation_type>(op_type)) {
+        case operation_type::create_node: {
+            std::string node;
+            blob data;
+            create_node_log::parse(reader, node, data);
+            create_node_internal(node, data);
+            break;
+        }
+        case operation_type::delete_node: {
+            std::string node;
+            bool recursively_delete;
+            delete_node_log::parse(reader, node, recursively_delete);
+            delete_node_internal(node, recursively_delete);
+            break;
+        }
+        case operation_type::set_data: {
+            std::string node;
+            blob data;
+            set_data_log::parse(reader, node, data);
+            set_data_internal(node, data);
+            break;
+        }
+        default:
+            // The log is complete but its content is modified by cosmic ray. This is
+            // unacceptable
+            dassert(false, "meta state server log corrupted");
+        }
+    }
+    fclose(fd);
+
+    int64_t file_size = 0;
+    return utils::filesystem::file_size(log_path, file_size) &&
+           static_cast<uint64_t>(file_size) == offset;
+}
+
 error_code meta_state_service_simple::create_node_internal(const std::string &node,
                                                            const blob &value)
 {
@@ -235,59 +545,30 @@ error_code meta_state_service_simple::initialize(const std::vector<std::string>
     const char *work_dir =
         args.empty() ? service_app::current_service_app_info().data_dir.c_str() : args[0].c_str();
 
+    _work_dir = work_dir;
+    int64_t log_index = 0;
+    error_code err = load_checkpoint(log_index);
+    if (err != ERR_OK) {
+        return err;
+    }
+    remove_logs_before(log_index);
+
+    _log_index = log_index;
     _offset = 0;
-    std::string log_path = dsn::utils::filesystem::path_combine(work_dir, "meta_state_service.log");
-    if (utils::filesystem::file_exists(log_path)) {
-        if (FILE *fd = fopen(log_path.c_str(), "rb")) {
-            for (;;) {
-                log_header header;
-                if (fread(&header, sizeof(log_header), 1, fd) != 1) {
-                    break;
-                }
-                if (header.magic != log_header::default_magic) {
-                    break;
-                }
-                std::shared_ptr<char> buffer(dsn::utils::make_shared_array<char>(header.size));
-                if (fread(buffer.get(), header.size, 1, fd) != 1) {
-                    break;
-                }
-                _offset += sizeof(header) + header.size;
-                binary_reader reader(blob(buffer, (int)header.size));
-                int op_type;
-                reader.read(op_type);
-
-                switch (static_cast<operation_type>(op_type)) {
-                case operation_type::create_node: {
-                    std::string node;
-                    blob data;
-                    create_node_log::parse(reader, node, data);
-                    create_node_internal(node, data);
-                    break;
-                }
-                case operation_type::delete_node: {
-                    std::string node;
-                    bool recursively_delete;
-                    delete_node_log::parse(reader, node, recursively_delete);
-                    delete_node_internal(node, recursively_delete);
-                    break;
-                }
-                case operation_type::set_data: {
-                    std::string node;
-                    blob data;
-                    set_data_log::parse(reader, node, data);
-                    set_data_internal(node, data);
-                    break;
-                }
-                default:
-                    // The log is complete but its content is modified by cosmic ray. This is
-                    // unacceptable
-                    dassert(false, "meta state server log corrupted");
-                }
+    for (; utils::filesystem::file_exists(get_log_path(log_index)); ++log_index) {
+        _log_index = log_index;
+        if (!replay_log(get_log_path(log_index), _offset)) {
+            // the records after an incomplete one are never acked, drop them as a single
+            // log does
+            for (int64_t i = log_index + 1; utils::filesystem::file_exists(get_log_path(i)); ++i) {
+                dwarn("remove log %s after an incomplete one", get_log_path(i).c_str());
+                utils::filesystem::remove_path(get_log_path(i));
             }
-            fclose(fd);
+            break;
         }
     }
 
+    std::string log_path = get_log_path(_log_index);
     _log = file::open(log_path.c_str(), O_RDWR | O_CREAT | O_BINARY, 0666);
     if (!_log) {
         derror("open file failed: %s", log_path.c_str());
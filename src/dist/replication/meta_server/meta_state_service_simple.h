@@ -43,7 +43,21 @@ namespace dist {
 DEFINE_TASK_CODE_AIO(LPC_META_STATE_SERVICE_SIMPLE_INTERNAL,
                      TASK_PRIORITY_HIGH,
                      THREAD_POOL_DEFAULT);
-
+DEFINE_TASK_CODE(LPC_META_STATE_SERVICE_SIMPLE_CHECKPOINT,
+                 TASK_PRIORITY_COMMON,
+                 THREAD_POOL_DEFAULT);
+
+///
+/// meta_state_service_simple keeps the tree in memory, and persists it in the work path as:
+///
+///   meta_state_service.checkpoint  -> all the nodes, once the logs before log k are applied
+///   meta_state_service.log.<k>     -> the operations logged since the checkpoint
+///
+/// Once the current log is larger than [meta_state_service_simple] checkpoint_log_size_kb,
+/// the following operations are logged into a new log, and the tree is checkpointed in
+/// background after all the operations of the old logs are applied, then the old logs are
+/// removed. Log 0 is named meta_state_service.log, which is compatible with the old versions.
+///
 class meta_state_service_simple : public meta_state_service
 {
 public:
@@ -52,7 +66,9 @@ public:
           _quick_map({std::make_pair("/", &_root)}),
           _log_lock(true),
           _log(nullptr),
-          _offset(0)
+          _offset(0),
+          _log_index(0),
+          _checkpointing(false)
     {
     }
 
@@ -119,8 +135,31 @@ private:
         static const int default_magic = 0xdeadbeef;
         log_header() : magic(default_magic), size(0) {}
     };
+    struct checkpoint_header
+    {
+        int magic;
+        int version;
+        // the index of the first log not included
+        int64_t log_index;
+        uint32_t chunk_count;
+        static const int default_magic = 0xcafebabe;
+        static const int default_version = 1;
+        checkpoint_header()
+            : magic(default_magic), version(default_version), log_index(0), chunk_count(0)
+        {
+        }
+    };
+    // the nodes of a chunk can be decoded in parallel with the other chunks
+    struct checkpoint_chunk_header
+    {
+        uint32_t size;
+        uint32_t node_count;
+    };
 #pragma pack(pop)
 
+    // <path, data> of the nodes, in which the parent of a node is before it
+    typedef std::vector<std::pair<std::string, blob>> node_list;
+
     struct state_node
     {
         std::string name;
@@ -244,6 +283,21 @@ private:
 
     void
     write_log(blob &&log_blob, std::function<error_code(void)> internal_operation, task_ptr task);
+    // caller should hold _log_lock
+    void drain_task_queue();
+
+    std::string get_log_path(int64_t log_index) const;
+    std::string get_checkpoint_path() const;
+    // return false if the log ends with an incomplete record
+    bool replay_log(const std::string &log_path, /*out*/ uint64_t &offset);
+    error_code load_checkpoint(/*out*/ int64_t &log_index);
+    void remove_logs_before(int64_t log_index);
+
+    // caller should hold _log_lock
+    error_code switch_log();
+    // caller should hold _state_lock
+    void get_all_nodes(/*out*/ node_list &nodes) const;
+    void write_checkpoint(int64_t log_index, const node_list &nodes);
 
     error_code create_node_internal(const std::string &node, const blob &blob);
     error_code delete_node_internal(const std::string &node, bool recursive);
@@ -263,6 +317,9 @@ private:
     zlock _log_lock;
     disk_file *_log;
     uint64_t _offset;
+    int64_t _log_index;
+    bool _checkpointing;
+    std::string _work_dir;
 
     dsn::task_tracker _tracker;
 };
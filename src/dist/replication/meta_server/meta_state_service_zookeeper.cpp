@@ -33,6 +33,7 @@
  */
 #include <dsn/tool-api/async_calls.h>
 #include <dsn/dist/replication/replication.codes.h>
+#include <dsn/utility/flags.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
@@ -45,6 +46,39 @@
 namespace dsn {
 namespace dist {
 
+DSN_DEFINE_uint32("zookeeper",
+                  write_batch_max_count,
+                  1,
+                  "max count of concurrent create_node/set_data coalesced into one multi-op, "
+                  "1 means not to coalesce them. Coalesced writes are sent in the order issued, "
+                  "and are sent individually again if the multi-op fails");
+DSN_DEFINE_uint32("zookeeper",
+                  write_max_inflight_batches,
+                  16,
+                  "max count of in-flight writes or multi-ops when write_batch_max_count > 1, "
+                  "the writes issued while the window is full are coalesced");
+
+namespace {
+
+// keep a multi-op far below the default jute.maxbuffer (1MB) of zookeeper
+const size_t write_batch_max_bytes = 512 * 1024;
+
+// whether `paths` contains `path`, any ancestor or descendant of it
+bool is_related_path(const std::multiset<std::string> &paths, const std::string &path)
+{
+    for (size_t pos = path.size(); pos != std::string::npos && pos > 0;
+         pos = path.rfind('/', pos - 1)) {
+        if (paths.find(path.substr(0, pos)) != paths.end()) {
+            return true;
+        }
+    }
+    std::string prefix = path + "/";
+    auto it = paths.lower_bound(prefix);
+    return it != paths.end() && it->compare(0, prefix.size(), prefix) == 0;
+}
+
+} // anonymous namespace
+
 class zoo_transaction : public meta_state_service::transaction_entries
 {
 public:
@@ -143,7 +177,11 @@ error_code zoo_transaction::get_result(unsigned int entry_index)
     return from_zerror(_pkt->_results[entry_index].err);
 }
 
-meta_state_service_zookeeper::meta_state_service_zookeeper() : ref_counter() { _first_call = true; }
+meta_state_service_zookeeper::meta_state_service_zookeeper()
+    : ref_counter(), _inflight_write_batches(0)
+{
+    _first_call = true;
+}
 
 meta_state_service_zookeeper::~meta_state_service_zookeeper()
 {
@@ -204,9 +242,13 @@ task_ptr meta_state_service_zookeeper::create_node(const std::string &node,
                                                    const blob &value,
                                                    dsn::task_tracker *tracker)
 {
+    dinfo("call create, node(%s)", node.c_str());
+    if (FLAGS_write_batch_max_count > 1) {
+        return write_node(true, node, value, cb_code, cb_create, tracker);
+    }
+
     error_code_future_ptr tsk(new error_code_future(cb_code, cb_create, 0));
     tsk->set_tracker(tracker);
-    dinfo("call create, node(%s)", node.c_str());
     VISIT_INIT(tsk, zookeeper_session::ZOO_OPERATION::ZOO_CREATE, node);
     input->_value = value;
     input->_flags = 0;
@@ -316,6 +358,7 @@ task_ptr meta_state_service_zookeeper::get_data(const std::string &node,
     dinfo("call get, node(%s)", node.c_str());
     VISIT_INIT(tsk, zookeeper_session::ZOO_OPERATION::ZOO_GET, node);
     input->_is_set_watch = 0;
+    input->_use_cache = true;
     _session->visit(op);
     return tsk;
 }
@@ -326,9 +369,13 @@ task_ptr meta_state_service_zookeeper::set_data(const std::string &node,
                                                 const err_callback &cb_set_data,
                                                 dsn::task_tracker *tracker)
 {
+    dinfo("call set, node(%s)", node.c_str());
+    if (FLAGS_write_batch_max_count > 1) {
+        return write_node(false, node, value, cb_code, cb_set_data, tracker);
+    }
+
     error_code_future_ptr tsk(new error_code_future(cb_code, cb_set_data, 0));
     tsk->set_tracker(tracker);
-    dinfo("call set, node(%s)", node.c_str());
     VISIT_INIT(tsk, zookeeper_session::ZOO_OPERATION::ZOO_SET, node);
 
     input->_value = value;
@@ -364,6 +411,120 @@ task_ptr meta_state_service_zookeeper::get_children(const std::string &node,
     return tsk;
 }
 
+task_ptr meta_state_service_zookeeper::write_node(bool is_create,
+                                                  const std::string &node,
+                                                  const blob &value,
+                                                  task_code cb_code,
+                                                  const err_callback &cb,
+                                                  dsn::task_tracker *tracker)
+{
+    error_code_future_ptr tsk(new error_code_future(cb_code, cb, 0));
+    tsk->set_tracker(tracker);
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_writes_lock);
+        _pending_writes.push_back({is_create, node, value, tsk});
+    }
+    flush_writes();
+    return tsk;
+}
+
+void meta_state_service_zookeeper::flush_writes()
+{
+    std::vector<zoo_write_batch> batches;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_writes_lock);
+        while (_inflight_write_batches < FLAGS_write_max_inflight_batches &&
+               !_pending_writes.empty()) {
+            zoo_write_batch batch;
+            size_t batch_bytes = 0;
+            while (!_pending_writes.empty() && batch.size() < FLAGS_write_batch_max_count &&
+                   (batch.empty() ||
+                    batch_bytes + _pending_writes.front().value.length() <=
+                        write_batch_max_bytes) &&
+                   !is_related_path(_inflight_write_paths, _pending_writes.front().path)) {
+                batch_bytes += _pending_writes.front().value.length();
+                _inflight_write_paths.insert(_pending_writes.front().path);
+                batch.push_back(std::move(_pending_writes.front()));
+                _pending_writes.pop_front();
+            }
+            if (batch.empty()) {
+                break;
+            }
+            ++_inflight_write_batches;
+            batches.push_back(std::move(batch));
+        }
+    }
+
+    // the callback may be called synchronously if failed to send
+    for (zoo_write_batch &batch : batches) {
+        send_write_batch(std::move(batch));
+    }
+}
+
+void meta_state_service_zookeeper::send_write_batch(zoo_write_batch &&batch)
+{
+    zookeeper_session::zoo_opcontext *op = zookeeper_session::create_context();
+    zookeeper_session::zoo_input *input = &op->_input;
+    if (batch.size() == 1) {
+        const zoo_write &w = batch.front();
+        op->_optype = w.is_create ? zookeeper_session::ZOO_OPERATION::ZOO_CREATE
+                                  : zookeeper_session::ZOO_OPERATION::ZOO_SET;
+        input->_path = w.path;
+        input->_value = w.value;
+        input->_flags = 0;
+    } else {
+        std::shared_ptr<zoo_transaction> t(new zoo_transaction(batch.size()));
+        for (const zoo_write &w : batch) {
+            error_code err = w.is_create ? t->create_node(w.path, w.value)
+                                         : t->set_data(w.path, w.value);
+            dassert(err == ERR_OK, "add %s to multi-op failed: %s", w.path.c_str(), err.to_string());
+        }
+        op->_optype = zookeeper_session::ZOO_OPERATION::ZOO_TRANSACTION;
+        input->_pkt = t->packet();
+    }
+
+    ref_this self(this);
+    op->_callback_function = [ self, batch = std::move(batch) ](
+        zookeeper_session::zoo_opcontext * ctx)
+    {
+        self->on_write_batch_done(batch, ctx->_output.error);
+    };
+    _session->visit(op);
+}
+
+// this function runs in zookeeper do-completion thread
+void meta_state_service_zookeeper::on_write_batch_done(const zoo_write_batch &batch, int zoo_error)
+{
+    if (batch.size() > 1 && zoo_error != ZOK) {
+        // all the writes in a failed multi-op are rolled back, the paths are kept in-flight
+        // until they're sent individually, so that their callbacks get their own results
+        dinfo("multi-op of %d writes failed: %s, send them individually",
+              static_cast<int>(batch.size()),
+              zerror(zoo_error));
+        {
+            utils::auto_lock<utils::ex_lock_nr> l(_writes_lock);
+            _inflight_write_batches += static_cast<uint32_t>(batch.size() - 1);
+        }
+        for (const zoo_write &w : batch) {
+            send_write_batch({w});
+        }
+        return;
+    }
+
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_writes_lock);
+        --_inflight_write_batches;
+        for (const zoo_write &w : batch) {
+            _inflight_write_paths.erase(_inflight_write_paths.find(w.path));
+        }
+    }
+    error_code err = from_zerror(zoo_error);
+    for (const zoo_write &w : batch) {
+        w.callback->enqueue_with(err);
+    }
+    flush_writes();
+}
+
 /*static*/
 /* this function runs in zookeeper do-completion thread */
 void meta_state_service_zookeeper::on_zoo_session_evt(ref_this _this, int zoo_state)
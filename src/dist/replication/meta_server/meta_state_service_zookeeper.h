@@ -34,6 +34,8 @@
 
 #pragma once
 
+#include <deque>
+#include <set>
 #include <dsn/utility/synchronize.h>
 #include <dsn/utility/autoref_ptr.h>
 #include <dsn/tool-api/task_tracker.h>
@@ -105,6 +107,30 @@ public:
 private:
     typedef ref_ptr<meta_state_service_zookeeper> ref_this;
 
+    // a create_node or set_data which may be coalesced with others
+    struct zoo_write
+    {
+        bool is_create;
+        std::string path;
+        blob value;
+        error_code_future_ptr callback;
+    };
+    typedef std::vector<zoo_write> zoo_write_batch;
+
+    task_ptr write_node(bool is_create,
+                        const std::string &node,
+                        const blob &value,
+                        task_code cb_code,
+                        const err_callback &cb,
+                        dsn::task_tracker *tracker);
+    // send the pending writes in batches, while the in-flight batches are less than
+    // the window. A write related to any in-flight one (the same path, an ancestor or a
+    // descendant) is sent after it's done, so is no write queued after it.
+    void flush_writes();
+    // caller should count the batch in-flight
+    void send_write_batch(zoo_write_batch &&batch);
+    void on_write_batch_done(const zoo_write_batch &batch, int zoo_error);
+
     bool _first_call;
     int _zoo_state;
     zookeeper_session *_session;
@@ -112,6 +138,12 @@ private:
 
     dsn::task_tracker _tracker;
 
+    // write coalescing, protected by _writes_lock
+    utils::ex_lock_nr _writes_lock;
+    std::deque<zoo_write> _pending_writes;
+    std::multiset<std::string> _inflight_write_paths;
+    uint32_t _inflight_write_batches;
+
     static void on_zoo_session_evt(ref_this ptr, int zoo_state);
     static void visit_zookeeper_internal(ref_this ptr,
                                          task_ptr callback,
@@ -0,0 +1,244 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "partition_chunk_store.h"
+#include "meta_service.h"
+
+#include <dsn/cpp/serialization.h>
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/dist/replication/replication.codes.h>
+#include <dsn/utility/string_conv.h>
+
+namespace dsn {
+namespace replication {
+
+namespace {
+
+const char *chunk_name_prefix = "chunk.";
+const int32_t chunk_format_version = 1;
+
+} // anonymous namespace
+
+void partition_chunk_store::register_app(int32_t app_id,
+                                         const std::string &app_path,
+                                         int32_t chunk_size)
+{
+    dassert_f(chunk_size > 0, "invalid chunk size {} of app {}", chunk_size, app_id);
+
+    zauto_lock l(_lock);
+    auto it = _apps.find(app_id);
+    if (it != _apps.end()) {
+        dassert_f(it->second.chunk_size == chunk_size,
+                  "app {} is registered with chunk size {}, but {} now",
+                  app_id,
+                  it->second.chunk_size,
+                  chunk_size);
+        return;
+    }
+    app_chunks &app = _apps[app_id];
+    app.app_path = app_path;
+    app.chunk_size = chunk_size;
+}
+
+int32_t partition_chunk_store::get_chunk_size(int32_t app_id) const
+{
+    zauto_lock l(_lock);
+    auto it = _apps.find(app_id);
+    return it == _apps.end() ? 0 : it->second.chunk_size;
+}
+
+void partition_chunk_store::on_chunk_loaded(int32_t app_id,
+                                            int chunk_index,
+                                            const std::vector<partition_configuration> &partitions)
+{
+    zauto_lock l(_lock);
+    auto it = _apps.find(app_id);
+    dassert_f(it != _apps.end(), "app {} is not registered", app_id);
+
+    chunk_state &chunk = it->second.chunks[chunk_index];
+    chunk.exists = true;
+    for (const partition_configuration &pc : partitions) {
+        chunk.written[pc.pid.get_partition_index()] = pc;
+    }
+}
+
+task_ptr partition_chunk_store::write_partition(int32_t app_id,
+                                                const partition_configuration &pc,
+                                                task_code callback_code,
+                                                const err_callback &callback,
+                                                task_tracker *tracker)
+{
+    error_code_future_ptr t(new error_code_future(callback_code, callback, 0));
+    t->set_tracker(tracker);
+
+    zauto_lock l(_lock);
+    auto it = _apps.find(app_id);
+    dassert_f(it != _apps.end(), "app {} is not registered", app_id);
+
+    int pidx = pc.pid.get_partition_index();
+    int chunk_index = pidx / it->second.chunk_size;
+    // a later config of the same partition overrides the queued one
+    pending_partition &p = it->second.chunks[chunk_index].pending[pidx];
+    p.config = pc;
+    p.callbacks.push_back(t);
+
+    write_chunk(app_id, chunk_index);
+    return t;
+}
+
+void partition_chunk_store::write_chunk(int32_t app_id, int chunk_index)
+{
+    app_chunks &app = _apps[app_id];
+    chunk_state &chunk = app.chunks[chunk_index];
+    if (chunk.writing || chunk.pending.empty()) {
+        return;
+    }
+
+    std::map<int, partition_configuration> image = chunk.written;
+    for (const auto &kv : chunk.pending) {
+        image[kv.first] = kv.second.config;
+    }
+    std::vector<partition_configuration> partitions;
+    partitions.reserve(image.size());
+    for (const auto &kv : image) {
+        partitions.push_back(kv.second);
+    }
+    blob value = encode_chunk(app.chunk_size, partitions);
+
+    std::string path = app.app_path + "/" + get_chunk_name(chunk_index);
+    bool create_new = !chunk.exists;
+    chunk.writing = true;
+
+    // the callback is called only once, so it's safe to move the captured objects out
+    auto on_reply = [ this, app_id, chunk_index, create_new, image = std::move(image),
+                      written_partitions = std::move(chunk.pending) ](error_code ec) mutable
+    {
+        on_write_chunk_reply(
+            ec, app_id, chunk_index, create_new, std::move(image), std::move(written_partitions));
+    };
+    chunk.pending.clear();
+
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    if (create_new) {
+        storage->create_node(path, LPC_META_STATE_HIGH, on_reply, value, &_tracker);
+    } else {
+        storage->set_data(path, value, LPC_META_STATE_HIGH, on_reply, &_tracker);
+    }
+}
+
+void partition_chunk_store::on_write_chunk_reply(
+    error_code ec,
+    int32_t app_id,
+    int chunk_index,
+    bool create_new,
+    std::map<int, partition_configuration> &&image,
+    std::map<int, pending_partition> &&written_partitions)
+{
+    std::vector<error_code_future_ptr> callbacks;
+    {
+        zauto_lock l(_lock);
+        chunk_state &chunk = _apps[app_id].chunks[chunk_index];
+        chunk.writing = false;
+
+        if ((create_new && ec == ERR_NODE_ALREADY_EXIST) ||
+            (!create_new && ec == ERR_OBJECT_NOT_FOUND)) {
+            // the chunk has been created by the write timed out before, or not created yet,
+            // write the partitions again, unless they are overridden by later configs
+            dinfo_f("chunk {} of app {} exists = {}, rewrite it", chunk_index, app_id, create_new);
+            chunk.exists = create_new;
+            for (auto &kv : written_partitions) {
+                auto it = chunk.pending.find(kv.first);
+                if (it == chunk.pending.end()) {
+                    chunk.pending.emplace(kv.first, std::move(kv.second));
+                } else {
+                    it->second.callbacks.insert(it->second.callbacks.end(),
+                                                kv.second.callbacks.begin(),
+                                                kv.second.callbacks.end());
+                }
+            }
+            write_chunk(app_id, chunk_index);
+            return;
+        }
+
+        if (ec == ERR_OK) {
+            chunk.exists = true;
+            chunk.written = std::move(image);
+        } else {
+            dwarn_f(
+                "write chunk {} of app {} failed, err = {}", chunk_index, app_id, ec.to_string());
+        }
+        for (auto &kv : written_partitions) {
+            callbacks.insert(
+                callbacks.end(), kv.second.callbacks.begin(), kv.second.callbacks.end());
+        }
+        write_chunk(app_id, chunk_index);
+    }
+
+    for (auto &cb : callbacks) {
+        cb->enqueue_with(ec);
+    }
+}
+
+/*static*/ std::string partition_chunk_store::get_chunk_name(int chunk_index)
+{
+    return chunk_name_prefix + std::to_string(chunk_index);
+}
+
+/*static*/ bool partition_chunk_store::parse_chunk_name(const std::string &name,
+                                                        /*out*/ int &chunk_index)
+{
+    size_t prefix_len = strlen(chunk_name_prefix);
+    if (name.compare(0, prefix_len, chunk_name_prefix) != 0) {
+        return false;
+    }
+    return buf2int32(string_view(name.data() + prefix_len, name.size() - prefix_len),
+                     chunk_index) &&
+           chunk_index >= 0;
+}
+
+/*static*/ blob
+partition_chunk_store::encode_chunk(int32_t chunk_size,
+                                    const std::vector<partition_configuration> &partitions)
+{
+    binary_writer writer;
+    writer.write(chunk_format_version);
+    writer.write(chunk_size);
+    writer.write(static_cast<int32_t>(partitions.size()));
+    for (const partition_configuration &pc : partitions) {
+        marshall(writer, pc, DSF_THRIFT_BINARY);
+    }
+    return writer.get_buffer();
+}
+
+/*static*/ bool partition_chunk_store::decode_chunk(
+    const blob &value,
+    /*out*/ int32_t &chunk_size,
+    /*out*/ std::vector<partition_configuration> &partitions)
+{
+    binary_reader reader(value);
+    int32_t version = 0;
+    int32_t count = 0;
+    if (reader.get_remaining_size() < static_cast<int>(3 * sizeof(int32_t))) {
+        return false;
+    }
+    reader.read(version);
+    reader.read(chunk_size);
+    reader.read(count);
+    if (version != chunk_format_version || chunk_size <= 0 || count < 0 || count > chunk_size) {
+        derror_f("invalid chunk header, version = {}, chunk_size = {}, count = {}",
+                 version,
+                 chunk_size,
+                 count);
+        return false;
+    }
+
+    partitions.resize(count);
+    for (partition_configuration &pc : partitions) {
+        unmarshall(reader, pc, DSF_THRIFT_BINARY);
+    }
+    return reader.is_eof();
+}
+
+} // namespace replication
+} // namespace dsn
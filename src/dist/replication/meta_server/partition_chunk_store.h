@@ -0,0 +1,112 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <map>
+#include <unordered_map>
+
+#include <dsn/dist/meta_state_service.h>
+#include <dsn/dist/replication/replication_types.h>
+#include <dsn/tool-api/future_types.h>
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/tool-api/zlocks.h>
+
+namespace dsn {
+namespace replication {
+
+class meta_service;
+
+///
+/// partition_chunk_store persists the partition configurations of an app in chunks, instead of
+/// in one json node for each partition:
+///
+///   <cluster_root>/apps/<app_id>/chunk.<k> -> partitions [k * chunk_size, (k + 1) * chunk_size)
+///
+/// which makes the meta server load a large app with partition_count / chunk_size reads on
+/// failover. A chunk is thrift binary encoded, with the chunk_size it is written with.
+///
+/// Partitions written to the same chunk while a chunk write is in flight are batched into the
+/// next write of the chunk, so all of them are updated atomically by one set_data. The store
+/// keeps the last written image of each chunk, so that a chunk write never rolls back the
+/// partitions it does not update.
+///
+/// Apps not registered are in the layout of one node for each partition.
+///
+class partition_chunk_store
+{
+public:
+    explicit partition_chunk_store(meta_service *meta_svc) : _meta_svc(meta_svc) {}
+    ~partition_chunk_store() { _tracker.cancel_outstanding_tasks(); }
+
+    // chunk_size must be larger than 0
+    void register_app(int32_t app_id, const std::string &app_path, int32_t chunk_size);
+
+    // return 0 if the app is not registered
+    int32_t get_chunk_size(int32_t app_id) const;
+
+    // record the partitions of a chunk loaded from remote storage as written
+    void on_chunk_loaded(int32_t app_id,
+                         int chunk_index,
+                         const std::vector<partition_configuration> &partitions);
+
+    // write `pc` along with the other partitions of its chunk, `callback` is called with
+    // the result of the chunk write which contains `pc`
+    task_ptr write_partition(int32_t app_id,
+                             const partition_configuration &pc,
+                             task_code callback_code,
+                             const err_callback &callback,
+                             task_tracker *tracker = nullptr);
+
+    static std::string get_chunk_name(int chunk_index);
+    // return false if `name` is not a chunk node name
+    static bool parse_chunk_name(const std::string &name, /*out*/ int &chunk_index);
+
+    static blob encode_chunk(int32_t chunk_size,
+                             const std::vector<partition_configuration> &partitions);
+    static bool decode_chunk(const blob &value,
+                             /*out*/ int32_t &chunk_size,
+                             /*out*/ std::vector<partition_configuration> &partitions);
+
+private:
+    struct pending_partition
+    {
+        partition_configuration config;
+        std::vector<error_code_future_ptr> callbacks;
+    };
+
+    struct chunk_state
+    {
+        // whether the chunk node has been created on remote storage
+        bool exists{false};
+        bool writing{false};
+        std::map<int, partition_configuration> written;
+        std::map<int, pending_partition> pending;
+    };
+
+    struct app_chunks
+    {
+        std::string app_path;
+        int32_t chunk_size;
+        std::unordered_map<int, chunk_state> chunks;
+    };
+
+    // caller should hold _lock
+    void write_chunk(int32_t app_id, int chunk_index);
+    void on_write_chunk_reply(error_code ec,
+                              int32_t app_id,
+                              int chunk_index,
+                              bool create_new,
+                              std::map<int, partition_configuration> &&image,
+                              std::map<int, pending_partition> &&written_partitions);
+
+    meta_service *_meta_svc;
+    dsn::task_tracker _tracker;
+
+    mutable zlock _lock;
+    std::unordered_map<int32_t, app_chunks> _apps;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -35,12 +35,15 @@
  */
 
 #include <dsn/utility/factory_store.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/rand.h>
 #include <dsn/utility/string_conv.h>
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/tool-api/async_calls.h>
 #include <sstream>
 #include <cinttypes>
+#include <iterator>
 #include <string>
 #include <boost/lexical_cast.hpp>
 
@@ -57,13 +60,29 @@ namespace replication {
 static const char *lock_state = "lock";
 static const char *unlock_state = "unlock";
 
+DSN_DEFINE_int32("meta_server",
+                 max_route_subscription_wait_ms,
+                 60000,
+                 "max time a route subscription of the clients is held before it's replied");
+
+DSN_DEFINE_int32("meta_server",
+                 create_app_partition_batch_size,
+                 256,
+                 "the max count of the partition nodes of a new app created in one transaction "
+                 "on remote storage, 0 to create them one by one");
+
 server_state::server_state()
     : _meta_svc(nullptr),
       _add_secondary_enable_flow_control(false),
       _add_secondary_max_count_for_one_node(0),
       _cli_dump_handle(nullptr),
       _ctrl_add_secondary_enable_flow_control(nullptr),
-      _ctrl_add_secondary_max_count_for_one_node(nullptr)
+      _ctrl_add_secondary_max_count_for_one_node(nullptr),
+      _config_proposal_batch_window_ms(0),
+      _config_proposal_batch_max_count(0),
+      _first_route_version(static_cast<int64_t>(rand::next_u32() >> 1) << 32),
+      _last_route_version(_first_route_version),
+      _route_waiters_expiring(false)
 {
 }
 
@@ -153,10 +172,15 @@ void server_state::initialize(meta_service *meta_svc, const std::string &apps_ro
 {
     _meta_svc = meta_svc;
     _apps_root = apps_root;
+    _chunk_store.reset(new partition_chunk_store(meta_svc));
     _add_secondary_enable_flow_control =
         _meta_svc->get_meta_options().add_secondary_enable_flow_control;
     _add_secondary_max_count_for_one_node =
         _meta_svc->get_meta_options().add_secondary_max_count_for_one_node;
+    _config_proposal_batch_window_ms =
+        _meta_svc->get_meta_options().config_proposal_batch_window_ms;
+    _config_proposal_batch_max_count =
+        _meta_svc->get_meta_options().config_proposal_batch_max_count;
 
     _dead_partition_count.init_app_counter("eon.server_state",
                                            "dead_partition_count",
@@ -266,9 +290,40 @@ void server_state::transition_staging_state(std::shared_ptr<app_state> &app)
            app->get_logname(),
            enum_to_string(old_status),
            enum_to_string(app->status));
+    publish_app_route(*app);
+    if (old_status == app_status::AS_CREATING) {
+        assign_new_app_primaries(*app);
+    }
 #undef send_response
 }
 
+void server_state::assign_new_app_primaries(app_state &app)
+{
+    if (!app.is_stateful || _meta_svc->get_function_level() <= meta_function_level::fl_freezed) {
+        return;
+    }
+
+    // the balancer chooses the node with the least primaries for each partition in turn, so the
+    // primaries are spread over the nodes, and the proposals to a node are sent in batch
+    int proposal_count = 0;
+    for (int i = 0; i < app.partition_count; ++i) {
+        partition_configuration &pc = app.partitions[i];
+        if (!pc.primary.is_invalid() ||
+            app.helpers->contexts[i].stage == config_status::pending_remote_sync) {
+            continue;
+        }
+        configuration_proposal_action action;
+        _meta_svc->get_balancer()->cure({&_all_apps, &_nodes}, pc.pid, action);
+        if (action.type == config_type::CT_ASSIGN_PRIMARY) {
+            send_proposal(action, pc, app);
+            ++proposal_count;
+        }
+    }
+    ddebug("assign %d primaries of the new app(%s) without waiting for the balancer",
+           proposal_count,
+           app.get_logname());
+}
+
 void server_state::process_one_partition(std::shared_ptr<app_state> &app)
 {
     int ans = --app->helpers->partitions_in_progress;
@@ -285,6 +340,18 @@ void server_state::process_one_partition(std::shared_ptr<app_state> &app)
     }
 }
 
+// the dump file consists of the blocks of dump_file, whose crc is chained:
+//   - the format, "binary2"
+//   - the index, i.e. the app count, and the id, the partition count and the chunk size of
+//     each app
+//   - the chunks, each of which has the app_info and all the partitions of an app
+// so the chunks can be decoded in parallel on restore.
+//
+// the legacy format "binary" has a block for each app_info and partition, which are still
+// restored sequentially.
+static const char *dump_format = "binary2";
+static const char *legacy_dump_format = "binary";
+
 error_code server_state::dump_app_states(const char *local_path,
                                          const std::function<app_state *()> &iterator)
 {
@@ -294,18 +361,36 @@ error_code server_state::dump_app_states(const char *local_path,
         return ERR_FILE_OPERATION_FAILED;
     }
 
-    file->append_buffer("binary", 6);
+    std::vector<app_state *> apps;
+    std::vector<blob> chunks;
     app_state *app;
     while ((app = iterator()) != nullptr) {
         dassert(app->status == app_status::AS_AVAILABLE || app->status == app_status::AS_DROPPED,
                 "invalid app status");
         binary_writer writer;
         dsn::marshall(writer, *app, DSF_THRIFT_BINARY);
-        file->append_buffer(writer.get_buffer());
         for (const partition_configuration &pc : app->partitions) {
-            binary_writer writer;
             dsn::marshall(writer, pc, DSF_THRIFT_BINARY);
-            file->append_buffer(writer.get_buffer());
+        }
+        apps.push_back(app);
+        chunks.push_back(writer.get_buffer());
+    }
+
+    binary_writer index;
+    index.write_pod(static_cast<int32_t>(apps.size()));
+    for (size_t i = 0; i < apps.size(); ++i) {
+        index.write_pod(static_cast<int32_t>(apps[i]->app_id));
+        index.write_pod(static_cast<int32_t>(apps[i]->partition_count));
+        index.write_pod(static_cast<uint32_t>(chunks[i].length()));
+    }
+
+    if (file->append_buffer(dump_format, strlen(dump_format)) != 0 ||
+        file->append_buffer(index.get_buffer()) != 0) {
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    for (const blob &chunk : chunks) {
+        if (file->append_buffer(chunk) != 0) {
+            return ERR_FILE_OPERATION_FAILED;
         }
     }
     return ERR_OK;
@@ -372,9 +457,103 @@ error_code server_state::restore_from_local_storage(const char *local_path)
     dassert(file->read_next_buffer(data) == 1, "read format header fail");
     _all_apps.clear();
 
-    dassert(memcmp(data.data(), "binary", 6) == 0, "");
+    std::string format = data.to_string();
+    if (format == legacy_dump_format) {
+        restore_legacy_dump(*file);
+    } else {
+        dassert(format == dump_format, "unknown dump format %s", format.c_str());
+        restore_dump(*file);
+    }
+
+    for (auto &iter : _all_apps) {
+        if (iter.second->status == app_status::AS_AVAILABLE)
+            iter.second->status = app_status::AS_CREATING;
+        else {
+            dassert(iter.second->status == app_status::AS_DROPPED,
+                    "invalid app_status, status = %s",
+                    enum_to_string(iter.second->status));
+            iter.second->status = app_status::AS_DROPPING;
+        }
+    }
+    ec = sync_apps_to_remote_storage();
+    if (ec != ERR_OK) {
+        _all_apps.clear();
+        return ec;
+    }
+    return ERR_OK;
+}
+
+void server_state::restore_dump(dump_file &file)
+{
+    struct index_entry
+    {
+        int32_t app_id;
+        int32_t partition_count;
+        uint32_t chunk_size;
+    };
+
+    blob data;
+    dassert(file.read_next_buffer(data) == 1, "read index fail");
+    binary_reader index(data);
+    int32_t app_count = 0;
+    index.read_pod(app_count);
+    std::vector<index_entry> entries(app_count);
+    for (index_entry &e : entries) {
+        index.read_pod(e.app_id);
+        index.read_pod(e.partition_count);
+        index.read_pod(e.chunk_size);
+    }
+
+    // the chunks are read sequentially, as their crc is chained, but decoded in parallel
+    std::vector<std::shared_ptr<app_state>> apps(app_count);
+    dsn::task_tracker tracker;
+    for (int i = 0; i < app_count; ++i) {
+        blob chunk;
+        dassert(file.read_next_buffer(chunk) == 1, "read chunk of app %d fail", entries[i].app_id);
+        dassert(chunk.length() == entries[i].chunk_size,
+                "size of chunk of app %d mismatch, %u vs %u",
+                entries[i].app_id,
+                chunk.length(),
+                entries[i].chunk_size);
+        tasking::enqueue(LPC_META_CALLBACK,
+                         &tracker,
+                         [chunk, &entries, &apps, i]() {
+                             binary_reader reader(chunk);
+                             app_info info;
+                             unmarshall(reader, info, DSF_THRIFT_BINARY);
+                             dassert(info.app_id == entries[i].app_id &&
+                                         info.partition_count == entries[i].partition_count,
+                                     "app %d.%d mismatches the index %d.%d",
+                                     info.app_id,
+                                     info.partition_count,
+                                     entries[i].app_id,
+                                     entries[i].partition_count);
+                             std::shared_ptr<app_state> app = app_state::create(info);
+                             for (int pidx = 0; pidx < app->partition_count; ++pidx) {
+                                 unmarshall(reader, app->partitions[pidx], DSF_THRIFT_BINARY);
+                                 dassert(app->partitions[pidx].pid.get_partition_index() == pidx,
+                                         "uncorrect partition data, gpid(%d.%d), appname(%s)",
+                                         app->app_id,
+                                         pidx,
+                                         app->app_name.c_str());
+                             }
+                             apps[i] = std::move(app);
+                         },
+                         i);
+    }
+    dassert(file.read_next_buffer(data) == 0, "unexpected data after the chunks");
+    tracker.wait_outstanding_tasks();
+
+    for (std::shared_ptr<app_state> &app : apps) {
+        _all_apps.emplace(app->app_id, std::move(app));
+    }
+}
+
+void server_state::restore_legacy_dump(dump_file &file)
+{
+    blob data;
     while (true) {
-        int ans = file->read_next_buffer(data);
+        int ans = file.read_next_buffer(data);
         dassert(ans != -1, "read file failed");
         if (ans == 0) // file end
             break;
@@ -386,7 +565,7 @@ error_code server_state::restore_from_local_storage(const char *local_path)
         _all_apps.emplace(app->app_id, app);
 
         for (unsigned int i = 0; i != app->partition_count; ++i) {
-            ans = file->read_next_buffer(data);
+            ans = file.read_next_buffer(data);
             binary_reader reader(data);
             dassert(ans == 1, "unexpect read buffer, ret(%d)", ans);
             unmarshall(reader, app->partitions[i], DSF_THRIFT_BINARY);
@@ -397,23 +576,6 @@ error_code server_state::restore_from_local_storage(const char *local_path)
                     app->app_name.c_str());
         }
     }
-
-    for (auto &iter : _all_apps) {
-        if (iter.second->status == app_status::AS_AVAILABLE)
-            iter.second->status = app_status::AS_CREATING;
-        else {
-            dassert(iter.second->status == app_status::AS_DROPPED,
-                    "invalid app_status, status = %s",
-                    enum_to_string(iter.second->status));
-            iter.second->status = app_status::AS_DROPPING;
-        }
-    }
-    ec = sync_apps_to_remote_storage();
-    if (ec != ERR_OK) {
-        _all_apps.clear();
-        return ec;
-    }
-    return ERR_OK;
 }
 
 error_code server_state::initialize_default_apps()
@@ -529,6 +691,7 @@ error_code server_state::sync_apps_to_remote_storage()
     }
     for (auto &kv : _all_apps) {
         std::shared_ptr<app_state> &app = kv.second;
+        init_app_partition_layout(*app);
         for (unsigned int i = 0; i != app->partition_count; ++i) {
             task_ptr init_callback =
                 tasking::create_task(LPC_META_STATE_HIGH, &tracker, [] {}, sStateHash);
@@ -543,6 +706,7 @@ error_code server_state::sync_apps_to_remote_storage()
     t->wait();
     if (dsn::ERR_OK == err) {
         ddebug("set %s to unlock state in remote storage", _apps_root.c_str());
+        publish_routing_table();
         return err;
     } else {
         derror("set %s to unlock state in remote storage failed, reason(%s)",
@@ -552,59 +716,114 @@ error_code server_state::sync_apps_to_remote_storage()
     }
 }
 
-dsn::error_code server_state::sync_apps_from_remote_storage()
+dsn::error_code server_state::sync_apps_from_remote_storage(dist::meta_state_service *storage)
 {
     dsn::error_code err;
     dsn::task_tracker tracker;
 
-    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
-    auto sync_partition = [this, storage, &err, &tracker](
-        std::shared_ptr<app_state> &app, int partition_id, const std::string &partition_path) {
-        storage->get_data(
-            partition_path,
-            LPC_META_CALLBACK,
-            [this, app, partition_id, partition_path, &err](error_code ec,
-                                                            const blob &value) mutable {
-                if (ec == ERR_OK) {
-                    partition_configuration pc;
-                    dsn::json::json_forwarder<partition_configuration>::decode(value, pc);
+    if (storage == nullptr) {
+        storage = _meta_svc->get_remote_storage();
+    }
 
-                    dassert(pc.pid.get_app_id() == app->app_id &&
-                                pc.pid.get_partition_index() == partition_id,
-                            "invalid partition config");
-                    {
-                        zauto_write_lock l(_lock);
-                        app->partitions[partition_id] = pc;
-                        for (const dsn::rpc_address &addr : pc.last_drops) {
-                            app->helpers->contexts[partition_id].record_drop_history(addr);
-                        }
+    // caller should hold _lock
+    auto apply_partition = [this](std::shared_ptr<app_state> &app,
+                                  int partition_id,
+                                  const partition_configuration &pc) {
+        dassert(pc.pid.get_app_id() == app->app_id &&
+                    pc.pid.get_partition_index() == partition_id,
+                "invalid partition config");
+        app->partitions[partition_id] = pc;
+        for (const dsn::rpc_address &addr : pc.last_drops) {
+            app->helpers->contexts[partition_id].record_drop_history(addr);
+        }
 
-                        if (app->status == app_status::AS_CREATING &&
-                            (pc.partition_flags & pc_flags::dropped) != 0) {
-                            recall_partition(app, partition_id);
-                        } else if (app->status == app_status::AS_DROPPING &&
-                                   (pc.partition_flags & pc_flags::dropped) == 0) {
-                            drop_partition(app, partition_id);
-                        } else
-                            process_one_partition(app);
-                    }
-                } else if (ec == ERR_OBJECT_NOT_FOUND) {
-                    dwarn("partition node %s not exist on remote storage, may half create before",
-                          partition_path.c_str());
-                    init_app_partition_node(app, partition_id, nullptr);
-                } else {
-                    derror("get partition node failed, reason(%s)", ec.to_string());
-                    err = ec;
-                }
-            },
-            &tracker);
+        if (app->status == app_status::AS_CREATING &&
+            (pc.partition_flags & pc_flags::dropped) != 0) {
+            recall_partition(app, partition_id);
+        } else if (app->status == app_status::AS_DROPPING &&
+                   (pc.partition_flags & pc_flags::dropped) == 0) {
+            drop_partition(app, partition_id);
+        } else
+            process_one_partition(app);
+    };
+
+    // caller should hold _lock
+    auto sync_partitions = [this, &apply_partition](std::shared_ptr<app_state> &app,
+                                                    const std::string &app_path,
+                                                    const dist::children_data &children) {
+        std::vector<bool> loaded(app->partition_count, false);
+        for (const auto &child : children) {
+            int partition_id = -1;
+            if (!buf2int32(child.first, partition_id) || partition_id < 0 ||
+                partition_id >= app->partition_count) {
+                dwarn("ignore unknown node %s/%s", app_path.c_str(), child.first.c_str());
+                continue;
+            }
+            partition_configuration pc;
+            dsn::json::json_forwarder<partition_configuration>::decode(child.second, pc);
+            loaded[partition_id] = true;
+            apply_partition(app, partition_id, pc);
+        }
+        for (int i = 0; i < app->partition_count; ++i) {
+            if (!loaded[i]) {
+                dwarn("partition node %s/%d not exist on remote storage, may half create before",
+                      app_path.c_str(),
+                      i);
+                init_app_partition_node(app, i, nullptr);
+            }
+        }
+    };
+
+    // load all the chunks of an app, and then initialize the partitions not found in them,
+    // which may be half created
+    // caller should hold _lock
+    auto sync_chunks = [this, &apply_partition](std::shared_ptr<app_state> &app,
+                                                const std::string &app_path,
+                                                const dist::children_data &children) {
+        std::vector<bool> loaded(app->partition_count, false);
+        for (const auto &child : children) {
+            int chunk_index;
+            if (!partition_chunk_store::parse_chunk_name(child.first, chunk_index)) {
+                continue;
+            }
+
+            int32_t chunk_size = 0;
+            std::vector<partition_configuration> partitions;
+            dassert(partition_chunk_store::decode_chunk(child.second, chunk_size, partitions),
+                    "invalid partition chunk %s/%s",
+                    app_path.c_str(),
+                    child.first.c_str());
+            _chunk_store->register_app(app->app_id, get_app_path(*app), chunk_size);
+            _chunk_store->on_chunk_loaded(app->app_id, chunk_index, partitions);
+            for (const partition_configuration &pc : partitions) {
+                int partition_id = pc.pid.get_partition_index();
+                dassert(partition_id / chunk_size == chunk_index &&
+                            partition_id < app->partition_count,
+                        "invalid partition %d in chunk %s/%s",
+                        partition_id,
+                        app_path.c_str(),
+                        child.first.c_str());
+                loaded[partition_id] = true;
+                apply_partition(app, partition_id, pc);
+            }
+        }
+        for (int i = 0; i < app->partition_count; ++i) {
+            if (!loaded[i]) {
+                dwarn("partition %d.%d not exist in chunks on remote storage, "
+                      "may half create before",
+                      app->app_id,
+                      i);
+                init_app_partition_node(app, i, nullptr);
+            }
+        }
     };
 
     auto sync_app = [&](const std::string &app_path) {
         storage->get_data(
             app_path,
             LPC_META_CALLBACK,
-            [this, app_path, &err, &sync_partition](error_code ec, const blob &value) {
+            [this, storage, app_path, &err, &tracker, &sync_partitions, &sync_chunks](
+                error_code ec, const blob &value) {
                 if (ec == ERR_OK) {
                     app_info info;
                     dassert(dsn::json::json_forwarder<app_info>::decode(value, info),
@@ -626,11 +845,37 @@ dsn::error_code server_state::sync_apps_from_remote_storage()
                         }
                     }
 
-                    for (int i = 0; i < app->partition_count; i++) {
-                        std::string partition_path =
-                            app_path + "/" + boost::lexical_cast<std::string>(i);
-                        sync_partition(app, i, partition_path);
-                    }
+                    // the app is in the chunked layout if any chunk node exists
+                    storage->get_children_data(
+                        app_path,
+                        LPC_META_CALLBACK,
+                        [this, app, app_path, &err, &sync_partitions, &sync_chunks](
+                            error_code ec, const dist::children_data &children) mutable {
+                            if (ec != ERR_OK) {
+                                derror("get partitions of app %s failed, reason(%s)",
+                                       app_path.c_str(),
+                                       ec.to_string());
+                                err = ec;
+                                return;
+                            }
+
+                            bool is_chunked = false;
+                            for (const auto &child : children) {
+                                int chunk_index;
+                                if (partition_chunk_store::parse_chunk_name(child.first,
+                                                                            chunk_index)) {
+                                    is_chunked = true;
+                                    break;
+                                }
+                            }
+                            zauto_write_lock l(_lock);
+                            if (is_chunked) {
+                                sync_chunks(app, app_path, children);
+                            } else {
+                                sync_partitions(app, app_path, children);
+                            }
+                        },
+                        &tracker);
                 } else {
                     derror("get app info from meta state service failed, path = %s, err = %s",
                            app_path.c_str(),
@@ -681,6 +926,7 @@ dsn::error_code server_state::sync_apps_from_remote_storage()
         &tracker);
     tracker.wait_outstanding_tasks();
     if (err == ERR_OK) {
+        publish_routing_table();
         return _all_apps.empty() ? ERR_OBJECT_NOT_FOUND : ERR_OK;
     }
     return err;
@@ -714,9 +960,9 @@ void server_state::initialize_node_state()
     }
 }
 
-error_code server_state::initialize_data_structure()
+error_code server_state::initialize_data_structure(dist::meta_state_service *storage)
 {
-    error_code err = sync_apps_from_remote_storage();
+    error_code err = sync_apps_from_remote_storage(storage);
     if (err == ERR_OBJECT_NOT_FOUND) {
         if (_meta_svc->get_meta_options().recover_from_replica_server) {
             return ERR_OBJECT_NOT_FOUND;
@@ -752,15 +998,167 @@ void server_state::set_replica_migration_subscriber_for_test(
 // partition server => meta server
 // this is done in meta_state_thread_pool
 void server_state::on_config_sync(configuration_query_by_node_rpc rpc)
+{
+    update_load_reports(rpc.request());
+    do_config_sync(std::move(rpc), nullptr);
+}
+
+// this is done in meta_server_thread_pool
+void server_state::on_config_sync_sharded(configuration_query_by_node_rpc rpc)
+{
+    const configuration_query_by_node_request &request = rpc.request();
+    update_load_reports(request);
+    // only the delta config syncs without any changed replica are handled here, the others
+    // may change the replicas collected by the balancer
+    if (!is_config_sync_sharded(request.node) || !request.__isset.stored_replicas ||
+        !request.__isset.sync_version || !request.__isset.base_version ||
+        !request.stored_replicas.empty()) {
+        tasking::enqueue(LPC_META_STATE_HIGH,
+                         nullptr,
+                         std::bind(&server_state::do_config_sync, this, rpc, nullptr),
+                         sStateHash);
+        return;
+    }
+
+    auto replicas = std::make_shared<std::vector<replica_info>>();
+    if (!merge_stored_replicas(request, *replicas)) {
+        tasking::enqueue(LPC_META_STATE_HIGH,
+                         nullptr,
+                         std::bind(&server_state::do_config_sync, this, rpc, nullptr),
+                         sStateHash);
+        return;
+    }
+
+    configuration_query_by_node_response &response = rpc.response();
+    response.__isset.gc_replicas = false;
+    if (!fill_config_sync_from_routes(request.node, *replicas, response)) {
+        dinfo("the config sync from %s diverges from the routing table, pass it to the state "
+              "thread",
+              request.node.to_string());
+        response.partitions.clear();
+        tasking::enqueue(LPC_META_STATE_HIGH,
+                         nullptr,
+                         std::bind(&server_state::do_config_sync, this, rpc, replicas),
+                         sStateHash);
+        return;
+    }
+
+    response.err = ERR_OK;
+    response.__set_acked_sync_version(request.sync_version);
+    dinfo("send config sync response to %s from the routing table, partitions_count(%d)",
+          request.node.to_string(),
+          (int)response.partitions.size());
+}
+
+bool server_state::fill_config_sync_from_routes(
+    const rpc_address &node,
+    const std::vector<replica_info> &replicas,
+    /*out*/ configuration_query_by_node_response &response) const
+{
+    std::shared_ptr<const routing_table> table = std::atomic_load(&_routing_table);
+    if (table == nullptr) {
+        return false;
+    }
+
+    std::unordered_map<int32_t, const app_route *> routes;
+    for (const auto &kv : *table) {
+        const app_route &route = *kv.second;
+        routes.emplace(route.app_id, &route);
+        for (const auto &pc : route.partitions) {
+            if (is_member(*pc, node)) {
+                response.partitions.emplace_back();
+                configuration_update_request &partition = response.partitions.back();
+                partition.info = *route.info;
+                partition.config = *pc;
+                partition.host_node = node;
+            }
+        }
+    }
+
+    for (const replica_info &rep : replicas) {
+        auto iter = routes.find(rep.pid.get_app_id());
+        if (iter == routes.end() || iter->second->status != app_status::AS_AVAILABLE ||
+            rep.pid.get_partition_index() >= iter->second->partitions.size() ||
+            !is_member(*iter->second->partitions[rep.pid.get_partition_index()], node)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool server_state::is_config_sync_sharded(const rpc_address &node)
+{
+    zauto_lock l(_config_sync_sharded_nodes_lock);
+    return _config_sync_sharded_nodes.find(node) != _config_sync_sharded_nodes.end();
+}
+
+void server_state::set_config_sync_sharded(const rpc_address &node, bool sharded)
+{
+    zauto_lock l(_config_sync_sharded_nodes_lock);
+    if (sharded) {
+        _config_sync_sharded_nodes.insert(node);
+    } else {
+        _config_sync_sharded_nodes.erase(node);
+    }
+}
+
+void server_state::update_load_reports(const configuration_query_by_node_request &request)
+{
+    zauto_lock l(_load_reports_lock);
+    if (request.__isset.hot_partitions && !request.hot_partitions.empty()) {
+        _hot_partitions[request.node] = request.hot_partitions;
+    } else {
+        _hot_partitions.erase(request.node);
+    }
+    if (request.__isset.replica_loads && !request.replica_loads.empty()) {
+        _replica_loads[request.node] = request.replica_loads;
+    } else {
+        _replica_loads.erase(request.node);
+    }
+    if (request.__isset.slow_disks && !request.slow_disks.empty()) {
+        if (_slow_disks[request.node] != request.slow_disks) {
+            dwarn_f("node {} reports the fail-slow disks: {}",
+                    request.node,
+                    fmt::join(request.slow_disks, ","));
+        }
+        _slow_disks[request.node] = request.slow_disks;
+    } else {
+        _slow_disks.erase(request.node);
+    }
+}
+
+std::map<rpc_address, std::vector<partition_hotspot>> server_state::get_hot_partitions() const
+{
+    zauto_lock l(_load_reports_lock);
+    return _hot_partitions;
+}
+
+std::map<rpc_address, std::vector<replica_load>> server_state::get_replica_loads() const
+{
+    zauto_lock l(_load_reports_lock);
+    return _replica_loads;
+}
+
+std::map<rpc_address, std::vector<std::string>> server_state::get_slow_disks() const
+{
+    zauto_lock l(_load_reports_lock);
+    return _slow_disks;
+}
+
+void server_state::do_config_sync(configuration_query_by_node_rpc rpc,
+                                  std::shared_ptr<std::vector<replica_info>> merged_replicas)
 {
     configuration_query_by_node_response &response = rpc.response();
     const configuration_query_by_node_request &request = rpc.request();
 
     bool reject_this_request = false;
     response.__isset.gc_replicas = false;
-    ddebug("got config sync request from %s, stored_replicas_count(%d)",
+    ddebug("got config sync request from %s, stored_replicas_count(%d), sync_version(%" PRId64
+           "), base_version(%" PRId64 ")",
            request.node.to_string(),
-           (int)request.stored_replicas.size());
+           (int)request.stored_replicas.size(),
+           request.sync_version,
+           request.base_version);
 
     {
         zauto_read_lock l(_lock);
@@ -800,10 +1198,17 @@ void server_state::on_config_sync(configuration_query_by_node_rpc rpc)
         }
 
         // handle the stored replicas & the gc replicas
-        if (!reject_this_request && request.__isset.stored_replicas) {
+        std::vector<replica_info> replicas;
+        if (merged_replicas != nullptr) {
+            replicas = std::move(*merged_replicas);
+        }
+        if (!reject_this_request && request.__isset.stored_replicas &&
+            (merged_replicas != nullptr || merge_stored_replicas(request, replicas))) {
             if (ns != nullptr)
                 ns->set_replicas_collect_flag(true);
-            const std::vector<replica_info> &replicas = request.stored_replicas;
+            if (request.__isset.sync_version) {
+                response.__set_acked_sync_version(request.sync_version);
+            }
             meta_function_level::type level = _meta_svc->get_function_level();
             // if the node serve the replica on the meta server, then we ignore it
             // if the dropped servers on the meta servers are enough, we need to gc it
@@ -877,6 +1282,12 @@ void server_state::on_config_sync(configuration_query_by_node_rpc rpc)
                 response.__isset.gc_replicas = true;
             }
         }
+
+        // the next config sync of the node can be handled out of the state thread, until a
+        // configuration change of it is pending or it's dead
+        set_config_sync_sharded(request.node,
+                                !reject_this_request && ns != nullptr && ns->alive() &&
+                                    ns->has_collected());
     }
 
     if (reject_this_request) {
@@ -890,6 +1301,46 @@ void server_state::on_config_sync(configuration_query_by_node_rpc rpc)
            (int)response.gc_replicas.size());
 }
 
+bool server_state::merge_stored_replicas(const configuration_query_by_node_request &request,
+                                         /*out*/ std::vector<replica_info> &replicas)
+{
+    zauto_lock l(_node_stored_replicas_lock);
+    if (!request.__isset.sync_version) {
+        // the node doesn't support delta config sync
+        _node_stored_replicas.erase(request.node);
+        replicas = request.stored_replicas;
+        return true;
+    }
+
+    node_stored_replicas &stored = _node_stored_replicas[request.node];
+    if (!request.__isset.base_version) {
+        stored.replicas.clear();
+    } else if (stored.sync_version == 0 || stored.sync_version != request.base_version) {
+        dwarn("the base version(%" PRId64 ") of config sync from %s mismatches %" PRId64
+              ", require all the stored replicas",
+              request.base_version,
+              request.node.to_string(),
+              stored.sync_version);
+        _node_stored_replicas.erase(request.node);
+        return false;
+    } else {
+        for (const gpid &pid : request.removed_replicas) {
+            stored.replicas.erase(pid);
+        }
+    }
+
+    for (const replica_info &rep : request.stored_replicas) {
+        stored.replicas[rep.pid] = rep;
+    }
+    stored.sync_version = request.sync_version;
+
+    replicas.reserve(stored.replicas.size());
+    for (const auto &kv : stored.replicas) {
+        replicas.push_back(kv.second);
+    }
+    return true;
+}
+
 bool server_state::query_configuration_by_gpid(dsn::gpid id,
                                                /*out*/ partition_configuration &config)
 {
@@ -906,21 +1357,25 @@ void server_state::query_configuration_by_index(
     const configuration_query_by_index_request &request,
     /*out*/ configuration_query_by_index_response &response)
 {
-    zauto_read_lock l(_lock);
-    auto iter = _exist_apps.find(request.app_name.c_str());
-    if (iter == _exist_apps.end()) {
+    std::shared_ptr<const routing_table> table = std::atomic_load(&_routing_table);
+    if (table == nullptr) {
+        response.err = ERR_OBJECT_NOT_FOUND;
+        return;
+    }
+    auto iter = table->find(request.app_name);
+    if (iter == table->end()) {
         response.err = ERR_OBJECT_NOT_FOUND;
         return;
     }
 
-    std::shared_ptr<app_state> &app = iter->second;
-    if (app->status != app_status::AS_AVAILABLE) {
+    const app_route &app = *iter->second;
+    if (app.status != app_status::AS_AVAILABLE) {
         derror("invalid status(%s) in exist app(%s), app_id(%d)",
-               enum_to_string(app->status),
-               (app->app_name).c_str(),
-               app->app_id);
+               enum_to_string(app.status),
+               request.app_name.c_str(),
+               app.app_id);
 
-        switch (app->status) {
+        switch (app.status) {
         case app_status::AS_CREATING:
         case app_status::AS_RECALLING:
             response.err = ERR_BUSY_CREATING;
@@ -934,17 +1389,253 @@ void server_state::query_configuration_by_index(
         return;
     }
 
+    fill_route_response(app, request, response);
+}
+
+bool server_state::query_configuration_by_index_serialized(
+    const configuration_query_by_index_request &request, /*out*/ blob &body)
+{
+    std::shared_ptr<const routing_table> table = std::atomic_load(&_routing_table);
+    if (table == nullptr) {
+        return false;
+    }
+    auto iter = table->find(request.app_name);
+    if (iter == table->end() || iter->second->status != app_status::AS_AVAILABLE) {
+        return false;
+    }
+
+    const app_route &app = *iter->second;
+    int64_t key;
+    if (is_delta_query(app, request)) {
+        key = request.known_version;
+    } else if (request.partition_indices.empty()) {
+        key = -1;
+    } else {
+        return false;
+    }
+
+    app_route::response_cache &cache = *app.cache;
+    {
+        std::lock_guard<std::mutex> l(cache.lock);
+        auto it = cache.bodies.find(key);
+        if (it != cache.bodies.end()) {
+            body = it->second;
+            return true;
+        }
+    }
+
+    configuration_query_by_index_response response;
+    fill_route_response(app, request, response);
+    binary_writer writer;
+    marshall(writer, response, DSF_THRIFT_BINARY);
+    body = writer.get_buffer();
+
+    std::lock_guard<std::mutex> l(cache.lock);
+    // the clients usually know the same few versions, e.g. the last one before a failover,
+    // so the deltas since the oldest versions are evicted first
+    if (cache.bodies.size() >= MAX_CACHED_ROUTE_RESPONSES) {
+        auto victim = cache.bodies.begin();
+        if (victim->first == -1) {
+            ++victim;
+        }
+        cache.bodies.erase(victim);
+    }
+    cache.bodies.emplace(key, body);
+    return true;
+}
+
+void server_state::fill_route_response(
+    const app_route &route,
+    const configuration_query_by_index_request &request,
+    /*out*/ configuration_query_by_index_response &response) const
+{
     response.err = ERR_OK;
-    response.app_id = app->app_id;
-    response.partition_count = app->partition_count;
-    response.is_stateful = app->is_stateful;
+    response.app_id = route.app_id;
+    response.partition_count = route.partition_count;
+    response.is_stateful = route.is_stateful;
+
+    if (is_delta_query(route, request)) {
+        for (int i = 0; i < route.partitions.size(); ++i) {
+            if (route.partition_versions[i] > request.known_version) {
+                response.partitions.push_back(*route.partitions[i]);
+            }
+        }
+        response.__set_version(route.version);
+        return;
+    }
 
     for (const int32_t &index : request.partition_indices) {
-        if (index >= 0 && index < app->partitions.size())
-            response.partitions.push_back(app->partitions[index]);
+        if (index >= 0 && index < route.partitions.size())
+            response.partitions.push_back(*route.partitions[index]);
+    }
+    if (response.partitions.empty()) {
+        response.partitions.reserve(route.partitions.size());
+        for (const auto &pc : route.partitions) {
+            response.partitions.push_back(*pc);
+        }
+        response.__set_version(route.version);
+    }
+}
+
+server_state::app_route::app_route(const app_state &app, int64_t version)
+    : app_id(app.app_id),
+      status(app.status),
+      info(std::make_shared<const app_info>(app)),
+      partition_count(app.partition_count),
+      is_stateful(app.is_stateful),
+      version(version),
+      partition_versions(app.partitions.size(), version),
+      cache(std::make_shared<response_cache>())
+{
+    partitions.reserve(app.partitions.size());
+    for (const partition_configuration &pc : app.partitions) {
+        partitions.emplace_back(std::make_shared<const partition_configuration>(pc));
+    }
+}
+
+void server_state::publish_routing_table()
+{
+    auto table = std::make_shared<routing_table>();
+    int64_t version = ++_last_route_version;
+    for (const auto &kv : _exist_apps) {
+        table->emplace(kv.first, std::make_shared<const app_route>(*kv.second, version));
+    }
+    std::atomic_store(&_routing_table, std::shared_ptr<const routing_table>(std::move(table)));
+    notify_route_waiters(std::string());
+}
+
+void server_state::publish_app_route(const app_state &app)
+{
+    std::shared_ptr<const routing_table> old_table = std::atomic_load(&_routing_table);
+    auto table = old_table == nullptr ? std::make_shared<routing_table>()
+                                      : std::make_shared<routing_table>(*old_table);
+    auto iter = _exist_apps.find(app.app_name);
+    if (iter != _exist_apps.end() && iter->second.get() == &app) {
+        (*table)[app.app_name] = std::make_shared<const app_route>(app, ++_last_route_version);
+    } else {
+        // the app is dropped, and the name may be taken by another app
+        auto route = table->find(app.app_name);
+        if (route == table->end() || route->second->app_id != app.app_id) {
+            return;
+        }
+        table->erase(route);
+        ++_last_route_version;
+    }
+    std::atomic_store(&_routing_table, std::shared_ptr<const routing_table>(std::move(table)));
+    notify_route_waiters(app.app_name);
+}
+
+void server_state::publish_partition_route(const app_state &app, int pidx)
+{
+    std::shared_ptr<const routing_table> old_table = std::atomic_load(&_routing_table);
+    if (old_table != nullptr) {
+        auto iter = old_table->find(app.app_name);
+        if (iter != old_table->end() && iter->second->app_id == app.app_id &&
+            iter->second->status == app.status &&
+            iter->second->partition_count == app.partition_count) {
+            // only the configuration of the partition is copied
+            auto route = std::make_shared<app_route>(*iter->second);
+            route->partitions[pidx] =
+                std::make_shared<const partition_configuration>(app.partitions[pidx]);
+            route->version = ++_last_route_version;
+            route->partition_versions[pidx] = route->version;
+            route->cache = std::make_shared<app_route::response_cache>();
+            auto table = std::make_shared<routing_table>(*old_table);
+            (*table)[app.app_name] = std::move(route);
+            std::atomic_store(&_routing_table,
+                              std::shared_ptr<const routing_table>(std::move(table)));
+            notify_route_waiters(app.app_name);
+            return;
+        }
+    }
+    publish_app_route(app);
+}
+
+bool server_state::subscribe_route(configuration_query_by_index_rpc rpc)
+{
+    const configuration_query_by_index_request &request = rpc.request();
+    int wait_ms = std::min(request.wait_ms, FLAGS_max_route_subscription_wait_ms);
+    std::lock_guard<std::mutex> l(_route_waiters_lock);
+    // checked with the lock held, so the routes published after it notify the subscription
+    std::shared_ptr<const routing_table> table = std::atomic_load(&_routing_table);
+    if (table == nullptr) {
+        return false;
+    }
+    auto iter = table->find(request.app_name);
+    if (iter == table->end() || iter->second->status != app_status::AS_AVAILABLE ||
+        !request.__isset.known_version || iter->second->version != request.known_version) {
+        return false;
+    }
+
+    _route_waiters[request.app_name].push_back(route_waiter{rpc, dsn_now_ms() + wait_ms});
+    if (!_route_waiters_expiring) {
+        _route_waiters_expiring = true;
+        tasking::enqueue(LPC_META_CALLBACK,
+                         tracker(),
+                         std::bind(&server_state::expire_route_waiters, this),
+                         0,
+                         std::chrono::seconds(1));
+    }
+    return true;
+}
+
+void server_state::notify_route_waiters(const std::string &app_name)
+{
+    std::vector<route_waiter> waiters;
+    {
+        std::lock_guard<std::mutex> l(_route_waiters_lock);
+        for (auto iter = _route_waiters.begin(); iter != _route_waiters.end();) {
+            if (app_name.empty() || iter->first == app_name) {
+                std::move(iter->second.begin(), iter->second.end(), std::back_inserter(waiters));
+                iter = _route_waiters.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+    if (waiters.empty()) {
+        return;
+    }
+
+    // the publishers usually hold the write lock, so the waiters are replied asynchronously
+    tasking::enqueue(LPC_META_CALLBACK, tracker(), [ this, waiters = std::move(waiters) ]() {
+        for (const route_waiter &w : waiters) {
+            query_configuration_by_index(w.rpc.request(), w.rpc.response());
+        }
+    });
+}
+
+void server_state::expire_route_waiters()
+{
+    std::vector<route_waiter> expired;
+    {
+        std::lock_guard<std::mutex> l(_route_waiters_lock);
+        uint64_t now_ms = dsn_now_ms();
+        for (auto iter = _route_waiters.begin(); iter != _route_waiters.end();) {
+            std::vector<route_waiter> &waiters = iter->second;
+            auto it = std::partition(
+                waiters.begin(), waiters.end(), [now_ms](const route_waiter &w) {
+                    return w.deadline_ms > now_ms;
+                });
+            std::move(it, waiters.end(), std::back_inserter(expired));
+            waiters.erase(it, waiters.end());
+            iter = waiters.empty() ? _route_waiters.erase(iter) : std::next(iter);
+        }
+
+        _route_waiters_expiring = !_route_waiters.empty();
+        if (_route_waiters_expiring) {
+            tasking::enqueue(LPC_META_CALLBACK,
+                             tracker(),
+                             std::bind(&server_state::expire_route_waiters, this),
+                             0,
+                             std::chrono::seconds(1));
+        }
+    }
+
+    // nothing changed, so the responses only have the versions
+    for (const route_waiter &w : expired) {
+        query_configuration_by_index(w.rpc.request(), w.rpc.response());
     }
-    if (response.partitions.empty())
-        response.partitions = app->partitions;
 }
 
 void server_state::init_app_partition_node(std::shared_ptr<app_state> &app,
@@ -979,11 +1670,85 @@ void server_state::init_app_partition_node(std::shared_ptr<app_state> &app,
         }
     };
 
-    std::string app_partition_path = get_partition_path(*app, pidx);
-    dsn::blob value =
-        dsn::json::json_forwarder<partition_configuration>::encode(app->partitions[pidx]);
-    _meta_svc->get_remote_storage()->create_node(
-        app_partition_path, LPC_META_STATE_HIGH, on_create_app_partition, value);
+    write_partition_on_remote(app->partitions[pidx], true, on_create_app_partition);
+}
+
+void server_state::init_app_partition_nodes(std::shared_ptr<app_state> &app, int begin, int end)
+{
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    std::shared_ptr<dist::meta_state_service::transaction_entries> entries =
+        storage->new_transaction_entries(end - begin);
+    for (int i = begin; i < end; ++i) {
+        const partition_configuration &pc = app->partitions[i];
+        entries->create_node(get_partition_path(pc.pid),
+                             dsn::json::json_forwarder<partition_configuration>::encode(pc));
+    }
+
+    auto on_create_app_partitions = [this, app, begin, end](error_code ec) mutable {
+        dinfo("create partition nodes: app(%s), partitions[%d, %d), result: %s",
+              app->get_logname(),
+              begin,
+              end,
+              ec.to_string());
+        if (ERR_OK == ec) {
+            zauto_write_lock l(_lock);
+            for (int i = begin; i < end; ++i) {
+                process_one_partition(app);
+            }
+        } else if (ERR_TIMEOUT == ec) {
+            dwarn("create partition nodes failed, app(%s), partitions[%d, %d), retry later",
+                  app->get_logname(),
+                  begin,
+                  end);
+            tasking::enqueue(
+                LPC_META_STATE_HIGH,
+                tracker(),
+                std::bind(&server_state::init_app_partition_nodes, this, app, begin, end),
+                0,
+                std::chrono::milliseconds(1000));
+        } else {
+            // e.g. the nodes have been created by a transaction which timed out, so they're
+            // created one by one, where the existing ones are ignored
+            dwarn("create partition nodes failed, app(%s), partitions[%d, %d), err(%s), create "
+                  "them one by one",
+                  app->get_logname(),
+                  begin,
+                  end,
+                  ec.to_string());
+            for (int i = begin; i < end; ++i) {
+                init_app_partition_node(app, i, nullptr);
+            }
+        }
+    };
+
+    storage->submit_transaction(entries, LPC_META_STATE_HIGH, on_create_app_partitions);
+}
+
+void server_state::init_app_partition_layout(const app_state &app)
+{
+    int32_t chunk_size = _meta_svc->get_meta_options().partition_chunk_size;
+    if (chunk_size > 0) {
+        _chunk_store->register_app(app.app_id, get_app_path(app), chunk_size);
+    }
+}
+
+task_ptr server_state::write_partition_on_remote(const partition_configuration &pc,
+                                                 bool create_new,
+                                                 const err_callback &callback,
+                                                 dsn::task_tracker *tracker)
+{
+    if (_chunk_store->get_chunk_size(pc.pid.get_app_id()) > 0) {
+        return _chunk_store->write_partition(
+            pc.pid.get_app_id(), pc, LPC_META_STATE_HIGH, callback, tracker);
+    }
+
+    std::string partition_path = get_partition_path(pc.pid);
+    blob value = dsn::json::json_forwarder<partition_configuration>::encode(pc);
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    if (create_new) {
+        return storage->create_node(partition_path, LPC_META_STATE_HIGH, callback, value, tracker);
+    }
+    return storage->set_data(partition_path, value, LPC_META_STATE_HIGH, callback, tracker);
 }
 
 void server_state::do_app_create(std::shared_ptr<app_state> &app)
@@ -992,8 +1757,18 @@ void server_state::do_app_create(std::shared_ptr<app_state> &app)
         configuration_create_app_response resp;
         if (ERR_OK == ec || ERR_NODE_ALREADY_EXIST == ec) {
             dinfo("create app(%s) on storage service ok", app->get_logname());
-            for (unsigned int i = 0; i != app->partition_count; ++i) {
-                init_app_partition_node(app, i, nullptr);
+            if (FLAGS_create_app_partition_batch_size > 0 &&
+                _chunk_store->get_chunk_size(app->app_id) == 0) {
+                for (int begin = 0; begin < app->partition_count;
+                     begin += FLAGS_create_app_partition_batch_size) {
+                    int end = std::min(app->partition_count,
+                                       begin + FLAGS_create_app_partition_batch_size);
+                    init_app_partition_nodes(app, begin, end);
+                }
+            } else {
+                for (unsigned int i = 0; i != app->partition_count; ++i) {
+                    init_app_partition_node(app, i, nullptr);
+                }
             }
         } else if (ERR_TIMEOUT == ec) {
             dwarn("the storage service is not available currently, continue to create later");
@@ -1007,6 +1782,7 @@ void server_state::do_app_create(std::shared_ptr<app_state> &app)
         }
     };
 
+    init_app_partition_layout(*app);
     std::string app_dir = get_app_path(*app);
     blob value = app->to_json(app_status::AS_AVAILABLE);
     _meta_svc->get_remote_storage()->create_node(
@@ -1080,6 +1856,7 @@ void server_state::create_app(dsn::message_ex *msg)
 
             _all_apps.emplace(app->app_id, app);
             _exist_apps.emplace(request.app_name, app);
+            publish_app_route(*app);
         }
     }
 
@@ -1097,6 +1874,7 @@ void server_state::do_app_drop(std::shared_ptr<app_state> &app)
         if (ERR_OK == ec) {
             zauto_write_lock l(_lock);
             _exist_apps.erase(app->app_name);
+            publish_app_route(*app);
             for (int i = 0; i < app->partition_count; ++i) {
                 drop_partition(app, i);
             }
@@ -1137,6 +1915,7 @@ void server_state::drop_app(dsn::message_ex *msg)
             case app_status::AS_AVAILABLE:
                 do_dropping = true;
                 app->status = app_status::AS_DROPPING;
+                publish_app_route(*app);
                 app->drop_second = dsn_now_ms() / 1000;
                 if (request.options.__isset.reserve_seconds &&
                     request.options.reserve_seconds > 0) {
@@ -1231,6 +2010,7 @@ void server_state::recall_app(dsn::message_ex *msg)
                     target_app->helpers->pending_response = msg;
 
                     _exist_apps.emplace(target_app->app_name, target_app);
+                    publish_app_route(*target_app);
                 }
             }
         }
@@ -1267,10 +2047,82 @@ void server_state::send_proposal(rpc_address target, const configuration_update_
            proposal.config.ballot,
            target.to_string(),
            proposal.node.to_string());
-    dsn::message_ex *msg =
-        dsn::message_ex::create_request(RPC_CONFIG_PROPOSAL, 0, proposal.config.pid.thread_hash());
-    ::marshall(msg, proposal);
-    _meta_svc->send_message(target, msg);
+    if (_config_proposal_batch_window_ms == 0) {
+        dsn::message_ex *msg = dsn::message_ex::create_request(
+            RPC_CONFIG_PROPOSAL, 0, proposal.config.pid.thread_hash());
+        ::marshall(msg, proposal);
+        _meta_svc->send_message(target, msg);
+        return;
+    }
+
+    std::vector<configuration_update_request> full_batch;
+    {
+        zauto_lock l(_proposal_batches_lock);
+        std::vector<configuration_update_request> &batch = _proposal_batches[target];
+        batch.push_back(proposal);
+        if (static_cast<int32_t>(batch.size()) >= _config_proposal_batch_max_count) {
+            full_batch = std::move(batch);
+            _proposal_batches.erase(target);
+        } else if (batch.size() == 1) {
+            tasking::enqueue(LPC_META_STATE_HIGH,
+                             &_tracker,
+                             [this, target]() { flush_proposal_batch(target); },
+                             0,
+                             std::chrono::milliseconds(_config_proposal_batch_window_ms));
+        }
+    }
+    if (!full_batch.empty()) {
+        send_proposal_batch(target, full_batch);
+    }
+}
+
+void server_state::flush_proposal_batch(rpc_address target)
+{
+    std::vector<configuration_update_request> batch;
+    {
+        zauto_lock l(_proposal_batches_lock);
+        auto iter = _proposal_batches.find(target);
+        if (iter == _proposal_batches.end()) {
+            // the batch has been sent as it's full
+            return;
+        }
+        batch = std::move(iter->second);
+        _proposal_batches.erase(iter);
+    }
+    send_proposal_batch(target, batch);
+}
+
+void server_state::send_proposal_batch(rpc_address target,
+                                       const std::vector<configuration_update_request> &proposals)
+{
+    if (proposals.size() == 1) {
+        const configuration_update_request &proposal = proposals.front();
+        dsn::message_ex *msg = dsn::message_ex::create_request(
+            RPC_CONFIG_PROPOSAL, 0, proposal.config.pid.thread_hash());
+        ::marshall(msg, proposal);
+        _meta_svc->send_message(target, msg);
+        return;
+    }
+
+    ddebug("send %d proposals to %s in batch", (int)proposals.size(), target.to_string());
+    dsn::message_ex *msg = dsn::message_ex::create_request(RPC_CONFIG_PROPOSAL_BATCH);
+    write_config_proposal_batch(msg, proposals);
+    int count = proposals.size();
+    // the proposals lost are sent again by the following config syncs or balancer rounds,
+    // so the reply is only logged
+    dsn::rpc_response_task_ptr callback = rpc::create_rpc_response_task(
+        msg, &_tracker, [target, count](error_code err, error_code &&resp) {
+            if (err == ERR_OK) {
+                err = resp;
+            }
+            if (err != ERR_OK) {
+                dwarn("send %d proposals to %s in batch failed, err = %s",
+                      count,
+                      target.to_string(),
+                      err.to_string());
+            }
+        });
+    _meta_svc->send_request(msg, target, callback);
 }
 
 void server_state::send_proposal(const configuration_proposal_action &action,
@@ -1455,6 +2307,7 @@ void server_state::update_configuration_locally(
     // as we sync to remote storage according to it
     std::string old_config_str = boost::lexical_cast<std::string>(old_cfg);
     old_cfg = config_request->config;
+    publish_partition_route(app, gpid.get_partition_index());
     auto find_name = _config_type_VALUES_TO_NAMES.find(config_request->type);
     if (find_name != _config_type_VALUES_TO_NAMES.end()) {
         ddebug("meta update config ok: type(%s), old_config=%s, %s",
@@ -1505,14 +2358,9 @@ task_ptr server_state::update_configuration_on_remote(
             std::chrono::seconds(1));
     }
 
-    partition_configuration &pc = config_request->config;
-    std::string storage_path = get_partition_path(pc.pid);
-
-    blob json_config = dsn::json::json_forwarder<partition_configuration>::encode(pc);
-    return _meta_svc->get_remote_storage()->set_data(
-        storage_path,
-        json_config,
-        LPC_META_STATE_HIGH,
+    return write_partition_on_remote(
+        config_request->config,
+        false,
         std::bind(&server_state::on_update_configuration_on_remote_reply,
                   this,
                   std::placeholders::_1,
@@ -1601,10 +2449,7 @@ void server_state::recall_partition(std::shared_ptr<app_state> &app, int pidx)
     dassert((pc.partition_flags & pc_flags::dropped), "");
 
     pc.partition_flags = 0;
-    blob json_partition = dsn::json::json_forwarder<partition_configuration>::encode(pc);
-    std::string partition_path = get_partition_path(pc.pid);
-    _meta_svc->get_remote_storage()->set_data(
-        partition_path, json_partition, LPC_META_STATE_HIGH, on_recall_partition);
+    write_partition_on_remote(pc, false, on_recall_partition);
 }
 
 void server_state::drop_partition(std::shared_ptr<app_state> &app, int pidx)
@@ -1650,6 +2495,7 @@ void server_state::drop_partition(std::shared_ptr<app_state> &app, int pidx)
     cc.stage = config_status::pending_remote_sync;
     cc.pending_sync_request = req;
     cc.msg = nullptr;
+    set_config_sync_sharded(req->node, false);
 
     cc.pending_sync_task = update_configuration_on_remote(req);
 }
@@ -1691,6 +2537,7 @@ void server_state::downgrade_primary_to_inactive(std::shared_ptr<app_state> &app
     cc.stage = config_status::pending_remote_sync;
     cc.pending_sync_request = req;
     cc.msg = nullptr;
+    set_config_sync_sharded(req->node, false);
 
     cc.pending_sync_task = update_configuration_on_remote(req);
 }
@@ -1761,6 +2608,7 @@ void server_state::downgrade_stateless_nodes(std::shared_ptr<app_state> &app,
     cc.stage = config_status::pending_remote_sync;
     cc.pending_sync_request = req;
     cc.msg = nullptr;
+    set_config_sync_sharded(req->node, false);
 
     cc.pending_sync_task = update_configuration_on_remote(req);
 }
@@ -1834,6 +2682,7 @@ void server_state::on_update_configuration(
         cc.stage = config_status::pending_remote_sync;
         cc.pending_sync_request = cfg_request;
         cc.msg = msg;
+        set_config_sync_sharded(cfg_request->node, false);
         cc.pending_sync_task = update_configuration_on_remote(cfg_request);
     }
 }
@@ -1878,6 +2727,13 @@ void server_state::on_change_node_state(rpc_address node, bool is_alive)
             node_state &ns = iter->second;
             ns.set_alive(false);
             ns.set_replicas_collect_flag(false);
+            set_config_sync_sharded(node, false);
+            {
+                zauto_lock hl(_load_reports_lock);
+                _hot_partitions.erase(node);
+                _replica_loads.erase(node);
+                _slow_disks.erase(node);
+            }
             ns.for_each_partition([&, this](const dsn::gpid &pid) {
                 std::shared_ptr<app_state> app = get_app(pid.get_app_id());
                 dassert(app != nullptr && app->status != app_status::AS_DROPPED,
@@ -2644,6 +3500,8 @@ void server_state::set_app_envs(const app_env_rpc &env_rpc)
         for (int idx = 0; idx < keys.size(); idx++) {
             app->envs[keys[idx]] = values[idx];
         }
+        // the envs aren't routed, but they're in the views of the app
+        ++_last_route_version;
         std::string new_envs = dsn::utils::kv_map_to_string(app->envs, ',', '=');
         ddebug("app envs changed: old_envs = {%s}, new_envs = {%s}",
                old_envs.c_str(),
@@ -2717,6 +3575,7 @@ void server_state::del_app_envs(const app_env_rpc &env_rpc)
         for (const auto &key : keys) {
             app->envs.erase(key);
         }
+        ++_last_route_version;
         std::string new_envs = dsn::utils::kv_map_to_string(app->envs, ',', '=');
         ddebug("app envs changed: old_envs = {%s}, new_envs = {%s}",
                old_envs.c_str(),
@@ -2815,6 +3674,7 @@ void server_state::clear_app_envs(const app_env_rpc &env_rpc)
                     app->envs.erase(key);
                 }
             }
+            ++_last_route_version;
             std::string new_envs = dsn::utils::kv_map_to_string(app->envs, ',', '=');
             ddebug("app envs changed: old_envs = {%s}, new_envs = {%s}",
                    old_envs.c_str(),
@@ -35,7 +35,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <map>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <boost/lexical_cast.hpp>
 
 #include <dsn/dist/replication/replication_other_types.h>
@@ -45,9 +49,12 @@
 
 #include "common/replication_common.h"
 #include "dist/replication/meta_server/meta_data.h"
+#include "dist/replication/meta_server/partition_chunk_store.h"
 
 #include "meta_service.h"
 
+class dump_file;
+
 namespace dsn {
 namespace replication {
 
@@ -116,7 +123,9 @@ public:
     ~server_state();
 
     void initialize(meta_service *meta_svc, const std::string &apps_root);
-    error_code initialize_data_structure();
+    // the apps are read from `storage` if not null, e.g. the snapshot of the warm standby,
+    // otherwise from remote storage
+    error_code initialize_data_structure(dist::meta_state_service *storage = nullptr);
     void register_cli_commands();
 
     void lock_read(zauto_read_lock &other);
@@ -137,9 +146,22 @@ public:
         return iter->second;
     }
 
+    // served by the routing table, so it never waits for the writers of the apps
     void query_configuration_by_index(const configuration_query_by_index_request &request,
                                       /*out*/ configuration_query_by_index_response &response);
+    // the response of query_configuration_by_index in thrift binary, which is cached by the
+    // route of the app for the queries of all the partitions, and of the changes since a known
+    // version. returns false if the query isn't cached, e.g. it fails or queries by the indices
+    bool query_configuration_by_index_serialized(
+        const configuration_query_by_index_request &request, /*out*/ blob &body);
+    // hold a subscription, i.e. a query with wait_ms, until the route of the app changes since
+    // its known_version or wait_ms passes, then reply the changes. returns false if it should be
+    // replied right now, e.g. there are changes already or the known_version is unknown
+    bool subscribe_route(configuration_query_by_index_rpc rpc);
     bool query_configuration_by_gpid(const dsn::gpid id, /*out*/ partition_configuration &config);
+    // increased whenever the apps, their envs or their partitions change, which versions the
+    // views built from them, e.g. the responses of meta_http_service
+    int64_t state_version() const { return _last_route_version.load(); }
 
     // app options
     void create_app(dsn::message_ex *msg);
@@ -156,6 +178,15 @@ public:
 
     // update configuration
     void on_config_sync(configuration_query_by_node_rpc rpc);
+    // the config sync dispatched to the meta server pool by the node address, which is replied
+    // from the routing table if nothing diverges, or is passed to the state thread otherwise
+    void on_config_sync_sharded(configuration_query_by_node_rpc rpc);
+    // the hot partitions, the replica loads and the fail-slow disks reported by each alive node
+    // on its last config sync, thread safe
+    std::map<rpc_address, std::vector<partition_hotspot>> get_hot_partitions() const;
+    std::map<rpc_address, std::vector<replica_load>> get_replica_loads() const;
+    std::map<rpc_address, std::vector<std::string>> get_slow_disks() const;
+    void update_load_reports(const configuration_query_by_node_request &request);
     void on_update_configuration(std::shared_ptr<configuration_update_request> &request,
                                  dsn::message_ex *msg);
 
@@ -195,7 +226,10 @@ private:
 
     error_code dump_app_states(const char *local_path,
                                const std::function<app_state *()> &iterator);
-    error_code sync_apps_from_remote_storage();
+    // restore _all_apps from the blocks after the format block
+    void restore_dump(dump_file &file);
+    void restore_legacy_dump(dump_file &file);
+    error_code sync_apps_from_remote_storage(dist::meta_state_service *storage = nullptr);
     // sync local state to remote storage,
     // if return OK, all states are synced correctly, and all apps are in stable state
     // else indicate error that remote storage responses
@@ -229,6 +263,31 @@ private:
     void do_app_drop(std::shared_ptr<app_state> &app);
     void do_app_recall(std::shared_ptr<app_state> &app);
     void init_app_partition_node(std::shared_ptr<app_state> &app, int pidx, task_ptr callback);
+    // create the nodes of partitions [begin, end) of a new app in one transaction
+    void init_app_partition_nodes(std::shared_ptr<app_state> &app, int begin, int end);
+    // store the partitions of a newly created app in chunks if configured
+    void init_app_partition_layout(const app_state &app);
+    // write a partition in the layout of its app, create_new is ignored in the chunked layout
+    task_ptr write_partition_on_remote(const partition_configuration &pc,
+                                       bool create_new,
+                                       const err_callback &callback,
+                                       dsn::task_tracker *tracker = nullptr);
+    // get all the stored replicas of the node from a config sync request, by applying the
+    // changed replicas to those of the version it's based on. Return false if the version
+    // is unknown, which requires the node to send all the stored replicas.
+    bool merge_stored_replicas(const configuration_query_by_node_request &request,
+                               /*out*/ std::vector<replica_info> &replicas);
+    // handle the config sync in the state thread, with the stored replicas merged already if
+    // `merged_replicas` is not null
+    void do_config_sync(configuration_query_by_node_rpc rpc,
+                        std::shared_ptr<std::vector<replica_info>> merged_replicas);
+    // fill the partitions of the node from the routing table, return false if any of the
+    // stored replicas is not served by the node according to the table
+    bool fill_config_sync_from_routes(const rpc_address &node,
+                                      const std::vector<replica_info> &replicas,
+                                      /*out*/ configuration_query_by_node_response &response) const;
+    bool is_config_sync_sharded(const rpc_address &node);
+    void set_config_sync_sharded(const rpc_address &node, bool sharded);
     // do_update_app_info()
     //  -- ensure update app_info to remote storage succeed, if timeout, it will retry autoly
     void do_update_app_info(const std::string &app_path,
@@ -243,6 +302,27 @@ private:
     void
     update_configuration_locally(app_state &app,
                                  std::shared_ptr<configuration_update_request> &config_request);
+
+    // the routing table is published by the writers of the apps, i.e. the holders of the write
+    // lock of _lock (or the only thread on initializing), after they change the app set, the
+    // status or the partitions of an app. publish_routing_table() rebuilds the table from
+    // _exist_apps, and the others only rebuild the route of an app or a partition.
+    void publish_routing_table();
+    void publish_app_route(const app_state &app);
+    void publish_partition_route(const app_state &app, int pidx);
+    // reply the subscriptions of the app, or of all the apps if app_name is empty
+    void notify_route_waiters(const std::string &app_name);
+    void expire_route_waiters();
+    void fill_route_response(const app_route &route,
+                             const configuration_query_by_index_request &request,
+                             /*out*/ configuration_query_by_index_response &response) const;
+    // whether the partitions changed since request.known_version can be told by the route
+    bool is_delta_query(const app_route &route,
+                        const configuration_query_by_index_request &request) const
+    {
+        return request.__isset.known_version && request.known_version >= _first_route_version &&
+               request.known_version <= route.version;
+    }
     void request_check(const partition_configuration &old,
                        const configuration_update_request &request);
     void recall_partition(std::shared_ptr<app_state> &app, int pidx);
@@ -262,6 +342,10 @@ private:
     void send_proposal(const configuration_proposal_action &action,
                        const partition_configuration &pc,
                        const app_state &app);
+    // send the proposals to `target` queued in the batch window
+    void flush_proposal_batch(rpc_address target);
+    void send_proposal_batch(rpc_address target,
+                             const std::vector<configuration_update_request> &proposals);
 
     // util function
     int32_t next_app_id() const
@@ -290,6 +374,9 @@ private:
 
     void process_one_partition(std::shared_ptr<app_state> &app);
     void transition_staging_state(std::shared_ptr<app_state> &app);
+    // send the proposals of assigning the primaries of a new app at once, rather than in the
+    // next balancer round; caller should hold the write lock
+    void assign_new_app_primaries(app_state &app);
 
 private:
     friend class test::test_checker;
@@ -301,13 +388,18 @@ private:
     friend class meta_split_service;
     friend class bulk_load_service;
     friend class bulk_load_service_test;
+    friend class partition_chunk_store_test;
+    friend class config_proposal_batch_test;
+    friend class config_sync_delta_test;
+    friend class routing_table_test;
 
     dsn::task_tracker _tracker;
 
     meta_service *_meta_svc;
     std::string _apps_root;
+    std::unique_ptr<partition_chunk_store> _chunk_store;
 
-    mutable zrwlock_nr _lock;
+    mutable zrwlock_nr _lock{"server_state::_lock"};
     node_mapper _nodes;
 
     // available apps, dropping apps, creating apps: name -> app_state
@@ -315,6 +407,56 @@ private:
     //_exist_apps + dropped apps: app_id -> app_state
     app_mapper _all_apps;
 
+    // an immutable snapshot of an app in _exist_apps, for the routing queries. the
+    // configurations are shared by the consecutive routes of the app, so a change of a partition
+    // only copies the pointers of the others.
+    struct app_route
+    {
+        app_route(const app_state &app, int64_t version);
+
+        // serialized responses of the route: known_version -> body, and -1 for the full query.
+        // at most MAX_CACHED_ROUTE_RESPONSES are kept
+        struct response_cache
+        {
+            std::mutex lock;
+            std::map<int64_t, blob> bodies;
+        };
+
+        int32_t app_id;
+        app_status::type status;
+        std::shared_ptr<const app_info> info;
+        int32_t partition_count;
+        bool is_stateful;
+        std::vector<std::shared_ptr<const partition_configuration>> partitions;
+        // the version of the route, and the versions when the partitions changed last time
+        int64_t version;
+        std::vector<int64_t> partition_versions;
+        // never shared by the routes of different versions
+        std::shared_ptr<response_cache> cache;
+    };
+    // app name -> route, replaced as a whole by std::atomic_store, and the routes of the
+    // unchanged apps are shared by the consecutive tables
+    typedef std::map<std::string, std::shared_ptr<const app_route>> routing_table;
+    static const size_t MAX_CACHED_ROUTE_RESPONSES = 16;
+    std::shared_ptr<const routing_table> _routing_table;
+    // the versions of the routes are increased from a random _first_route_version, so a
+    // known_version from another meta server is very unlikely to be taken as a valid one
+    int64_t _first_route_version;
+    // also increased by the changes not routed, i.e. the dropped apps and the envs, see
+    // state_version()
+    std::atomic<int64_t> _last_route_version;
+
+    struct route_waiter
+    {
+        configuration_query_by_index_rpc rpc;
+        uint64_t deadline_ms;
+    };
+    // app name -> subscriptions, which are expired by a task scheduled every second when there
+    // is any subscription
+    std::mutex _route_waiters_lock;
+    std::map<std::string, std::vector<route_waiter>> _route_waiters;
+    bool _route_waiters_expiring;
+
     // for load balancer
     migration_list _temporary_list;
 
@@ -328,6 +470,32 @@ private:
     dsn_handle_t _ctrl_add_secondary_enable_flow_control;
     dsn_handle_t _ctrl_add_secondary_max_count_for_one_node;
 
+    uint64_t _config_proposal_batch_window_ms;
+    int32_t _config_proposal_batch_max_count;
+    // the proposals waiting to be sent in batch: target -> proposals
+    zlock _proposal_batches_lock;
+    std::unordered_map<rpc_address, std::vector<configuration_update_request>> _proposal_batches;
+
+    // the stored replicas of the nodes supporting delta config sync
+    struct node_stored_replicas
+    {
+        int64_t sync_version{0};
+        std::map<gpid, replica_info> replicas;
+    };
+    zlock _node_stored_replicas_lock;
+    std::unordered_map<rpc_address, node_stored_replicas> _node_stored_replicas;
+
+    // the nodes whose config sync can be handled out of the state thread, i.e. the last config
+    // sync of which was handled in the state thread with nothing pending on the node. A node is
+    // removed once it's dead or a configuration change of it is pending on remote storage.
+    zlock _config_sync_sharded_nodes_lock;
+    std::unordered_set<rpc_address> _config_sync_sharded_nodes;
+
+    mutable zlock _load_reports_lock;
+    std::map<rpc_address, std::vector<partition_hotspot>> _hot_partitions;
+    std::map<rpc_address, std::vector<replica_load>> _replica_loads;
+    std::map<rpc_address, std::vector<std::string>> _slow_disks;
+
     perf_counter_wrapper _dead_partition_count;
     perf_counter_wrapper _unreadable_partition_count;
     perf_counter_wrapper _unwritable_partition_count;
@@ -129,6 +129,7 @@ std::pair<dsn::error_code, std::shared_ptr<app_state>> server_state::restore_app
 
             _all_apps.emplace(app->app_id, app);
             _exist_apps.emplace(info.app_name, app);
+            publish_app_route(*app);
         }
     }
     // TODO: using one single env to replace
@@ -0,0 +1,673 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "warm_standby.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include <dsn/cpp/json_helper.h>
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/dist/replication/replication.codes.h>
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/string_conv.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("meta_server",
+                warm_standby_enabled,
+                false,
+                "whether the leader journals the changes of the apps, with which the followers "
+                "keep a copy of the apps and the new leader only catches up the journal on "
+                "takeover");
+DSN_DEFINE_uint32("meta_server",
+                  warm_standby_refresh_interval_ms,
+                  1000,
+                  "the interval of the followers to refresh their copy of the apps from the "
+                  "journal");
+DSN_DEFINE_uint32("meta_server",
+                  warm_standby_journal_max_entries,
+                  1000,
+                  "max count of the journal entries kept, a follower lagging behind them reloads "
+                  "all the apps");
+
+void journaled_meta_state_service::start_journal(const std::string &apps_root,
+                                                 const std::string &journal_root,
+                                                 uint64_t first_seq,
+                                                 uint32_t max_entries)
+{
+    zauto_lock l(_lock);
+    dassert(!_started, "journal of %s is already started", journal_root.c_str());
+    _apps_root = apps_root;
+    _journal_root = journal_root;
+    _next_seq = first_seq;
+    _max_entries = max_entries;
+    _started = true;
+    ddebug_f("start journaling the writes under {} to {} from entry {}",
+             apps_root,
+             journal_root,
+             first_seq);
+}
+
+bool journaled_meta_state_service::is_journaled(const std::string &path) const
+{
+    if (path == _apps_root) {
+        return true;
+    }
+    // <apps_root>/<app_id> or <apps_root>/<app_id>/<child>
+    if (path.size() <= _apps_root.size() + 1 || path.compare(0, _apps_root.size(), _apps_root) ||
+        path[_apps_root.size()] != '/') {
+        return false;
+    }
+    return std::count(path.begin() + _apps_root.size() + 1, path.end(), '/') <= 1;
+}
+
+void journaled_meta_state_service::append_write(const std::string &path, issue_func issue)
+{
+    {
+        zauto_lock l(_lock);
+        bool journaled = _started && is_journaled(path);
+        // the writes not journaled are still queued behind the ongoing ones to keep their order
+        if (journaled || _flushing || !_pending.empty()) {
+            _pending.push_back(pending_write{journaled ? path : std::string(), std::move(issue)});
+            issue = nullptr;
+        }
+    }
+
+    if (issue) {
+        issue([]() {});
+    } else {
+        try_flush();
+    }
+}
+
+void journaled_meta_state_service::try_flush()
+{
+    batch_ptr batch;
+    std::vector<std::string> paths;
+    uint64_t seq = 0;
+    {
+        zauto_lock l(_lock);
+        if (_flushing || _pending.empty()) {
+            return;
+        }
+        _flushing = true;
+        batch = std::make_shared<std::vector<pending_write>>(std::move(_pending));
+        _pending.clear();
+
+        std::set<std::string> unique_paths;
+        for (const pending_write &w : *batch) {
+            if (!w.path.empty()) {
+                unique_paths.insert(w.path);
+            }
+        }
+        paths.assign(unique_paths.begin(), unique_paths.end());
+        if (!paths.empty()) {
+            seq = _next_seq++;
+        }
+    }
+
+    if (paths.empty()) {
+        issue_batch(batch);
+    } else {
+        write_entry(seq, json::json_forwarder<std::vector<std::string>>::encode(paths), batch);
+    }
+}
+
+void journaled_meta_state_service::write_entry(uint64_t seq, blob value, batch_ptr batch)
+{
+    _inner->create_node(
+        entry_path(_journal_root, seq),
+        LPC_META_STATE_HIGH,
+        [this, seq, value, batch](error_code ec) {
+            if (ec == ERR_OK) {
+                issue_batch(batch);
+                if (_max_entries > 0 && seq >= _max_entries) {
+                    _inner->delete_node(entry_path(_journal_root, seq - _max_entries),
+                                        false,
+                                        LPC_META_STATE_HIGH,
+                                        [](error_code) {});
+                }
+                return;
+            }
+
+            if (ec == ERR_NODE_ALREADY_EXIST) {
+                // the entry is written by the former leader, whose entries are not all seen
+                uint64_t next_seq;
+                {
+                    zauto_lock l(_lock);
+                    next_seq = std::max(_next_seq, seq + 1);
+                    _next_seq = next_seq + 1;
+                }
+                dwarn_f("journal entry {} already exists, try {}", seq, next_seq);
+                write_entry(next_seq, value, batch);
+                return;
+            }
+
+            derror_f("create journal entry {} failed, err = {}, retry later", seq, ec);
+            tasking::enqueue(LPC_META_STATE_HIGH,
+                             nullptr,
+                             [this, seq, value, batch]() { write_entry(seq, value, batch); },
+                             0,
+                             std::chrono::seconds(1));
+        },
+        value);
+}
+
+void journaled_meta_state_service::issue_batch(const batch_ptr &batch)
+{
+    auto remaining = std::make_shared<std::atomic_int>(static_cast<int>(batch->size()));
+    for (const pending_write &w : *batch) {
+        w.issue([this, remaining]() {
+            if (--*remaining == 0) {
+                on_batch_done();
+            }
+        });
+    }
+}
+
+void journaled_meta_state_service::on_batch_done()
+{
+    {
+        zauto_lock l(_lock);
+        _flushing = false;
+    }
+    try_flush();
+}
+
+task_ptr journaled_meta_state_service::submit_transaction(
+    const std::shared_ptr<transaction_entries> &entries,
+    task_code cb_code,
+    const err_callback &cb_transaction,
+    dsn::task_tracker *tracker)
+{
+    error_code_future_ptr tsk(new error_code_future(cb_code, cb_transaction, 0));
+    tsk->set_tracker(tracker);
+    std::string path;
+    {
+        zauto_lock l(_lock);
+        path = _apps_root;
+    }
+    append_write(path, [this, entries, cb_code, tsk](const std::function<void()> &on_done) {
+        _inner->submit_transaction(entries, cb_code, [tsk, on_done](error_code ec) {
+            on_done();
+            tsk->enqueue_with(ec);
+        });
+    });
+    return tsk;
+}
+
+task_ptr journaled_meta_state_service::create_node(const std::string &node,
+                                                   task_code cb_code,
+                                                   const err_callback &cb_create,
+                                                   const blob &value,
+                                                   dsn::task_tracker *tracker)
+{
+    error_code_future_ptr tsk(new error_code_future(cb_code, cb_create, 0));
+    tsk->set_tracker(tracker);
+    append_write(node, [this, node, cb_code, value, tsk](const std::function<void()> &on_done) {
+        _inner->create_node(node,
+                            cb_code,
+                            [tsk, on_done](error_code ec) {
+                                on_done();
+                                tsk->enqueue_with(ec);
+                            },
+                            value);
+    });
+    return tsk;
+}
+
+task_ptr journaled_meta_state_service::delete_node(const std::string &node,
+                                                   bool recursively_delete,
+                                                   task_code cb_code,
+                                                   const err_callback &cb_delete,
+                                                   dsn::task_tracker *tracker)
+{
+    error_code_future_ptr tsk(new error_code_future(cb_code, cb_delete, 0));
+    tsk->set_tracker(tracker);
+    append_write(
+        node,
+        [this, node, recursively_delete, cb_code, tsk](const std::function<void()> &on_done) {
+            _inner->delete_node(node, recursively_delete, cb_code, [tsk, on_done](error_code ec) {
+                on_done();
+                tsk->enqueue_with(ec);
+            });
+        });
+    return tsk;
+}
+
+task_ptr journaled_meta_state_service::set_data(const std::string &node,
+                                                const blob &value,
+                                                task_code cb_code,
+                                                const err_callback &cb_set_data,
+                                                dsn::task_tracker *tracker)
+{
+    error_code_future_ptr tsk(new error_code_future(cb_code, cb_set_data, 0));
+    tsk->set_tracker(tracker);
+    append_write(node, [this, node, value, cb_code, tsk](const std::function<void()> &on_done) {
+        _inner->set_data(node, value, cb_code, [tsk, on_done](error_code ec) {
+            on_done();
+            tsk->enqueue_with(ec);
+        });
+    });
+    return tsk;
+}
+
+// Serves the reads of server_state from the copy of a warm standby.
+class warm_standby::snapshot_service : public dist::meta_state_service
+{
+public:
+    explicit snapshot_service(warm_standby *standby) : _standby(standby) {}
+
+    error_code initialize(const std::vector<std::string> &args) override { return ERR_OK; }
+    error_code finalize() override { return ERR_OK; }
+
+    std::shared_ptr<transaction_entries> new_transaction_entries(unsigned int capacity) override
+    {
+        dassert(false, "the snapshot of warm standby is read-only");
+        return nullptr;
+    }
+    task_ptr submit_transaction(const std::shared_ptr<transaction_entries> &entries,
+                                task_code cb_code,
+                                const err_callback &cb_transaction,
+                                dsn::task_tracker *tracker) override
+    {
+        dassert(false, "the snapshot of warm standby is read-only");
+        return nullptr;
+    }
+    task_ptr create_node(const std::string &node,
+                         task_code cb_code,
+                         const err_callback &cb_create,
+                         const blob &value,
+                         dsn::task_tracker *tracker) override
+    {
+        dassert(false, "the snapshot of warm standby is read-only");
+        return nullptr;
+    }
+    task_ptr delete_node(const std::string &node,
+                         bool recursively_delete,
+                         task_code cb_code,
+                         const err_callback &cb_delete,
+                         dsn::task_tracker *tracker) override
+    {
+        dassert(false, "the snapshot of warm standby is read-only");
+        return nullptr;
+    }
+    task_ptr set_data(const std::string &node,
+                      const blob &value,
+                      task_code cb_code,
+                      const err_callback &cb_set_data,
+                      dsn::task_tracker *tracker) override
+    {
+        dassert(false, "the snapshot of warm standby is read-only");
+        return nullptr;
+    }
+
+    task_ptr node_exist(const std::string &node,
+                        task_code cb_code,
+                        const err_callback &cb_exist,
+                        dsn::task_tracker *tracker) override
+    {
+        error_code err;
+        {
+            zauto_lock l(_standby->_lock);
+            err = _standby->_nodes.count(node) != 0 ? ERR_OK : ERR_PATH_NOT_FOUND;
+        }
+        return tasking::enqueue(cb_code, tracker, [=]() { cb_exist(err); });
+    }
+
+    task_ptr get_data(const std::string &node,
+                      task_code cb_code,
+                      const err_value_callback &cb_get_data,
+                      dsn::task_tracker *tracker) override
+    {
+        zauto_lock l(_standby->_lock);
+        auto it = _standby->_nodes.find(node);
+        if (it == _standby->_nodes.end()) {
+            return tasking::enqueue(
+                cb_code, tracker, [=]() { cb_get_data(ERR_OBJECT_NOT_FOUND, blob()); });
+        }
+        blob data = it->second.data;
+        return tasking::enqueue(cb_code, tracker, [=]() { cb_get_data(ERR_OK, data); });
+    }
+
+    task_ptr get_children(const std::string &node,
+                          task_code cb_code,
+                          const err_stringv_callback &cb_get_children,
+                          dsn::task_tracker *tracker) override
+    {
+        zauto_lock l(_standby->_lock);
+        auto it = _standby->_nodes.find(node);
+        if (it == _standby->_nodes.end()) {
+            return tasking::enqueue(cb_code, tracker, [=]() {
+                cb_get_children(ERR_OBJECT_NOT_FOUND, std::vector<std::string>());
+            });
+        }
+        std::vector<std::string> children(it->second.children.begin(),
+                                          it->second.children.end());
+        return tasking::enqueue(
+            cb_code, tracker, [=]() mutable { cb_get_children(ERR_OK, std::move(children)); });
+    }
+
+private:
+    warm_standby *_standby;
+};
+
+warm_standby::warm_standby(dist::meta_state_service *remote,
+                           std::string apps_root,
+                           std::string journal_root)
+    : _remote(remote),
+      _apps_root(std::move(apps_root)),
+      _journal_root(std::move(journal_root)),
+      _view(new snapshot_service(this))
+{
+}
+
+warm_standby::~warm_standby() { stop(); }
+
+void warm_standby::start(std::chrono::milliseconds interval)
+{
+    _timer = tasking::enqueue_timer(LPC_META_WARM_STANDBY,
+                                    nullptr,
+                                    [this]() {
+                                        error_code err = refresh();
+                                        if (err != ERR_OK) {
+                                            dwarn_f("refresh warm standby failed, err = {}", err);
+                                        }
+                                    },
+                                    interval);
+}
+
+void warm_standby::stop()
+{
+    if (_timer != nullptr) {
+        _timer->cancel(true);
+        _timer = nullptr;
+    }
+}
+
+uint64_t warm_standby::latest_seq() const
+{
+    zauto_lock l(_lock);
+    return _applied_seq;
+}
+
+error_code warm_standby::list_journal(std::vector<uint64_t> &seqs)
+{
+    error_code err;
+    std::vector<std::string> names;
+    _remote
+        ->get_children(_journal_root,
+                       LPC_META_CALLBACK,
+                       [&err, &names](error_code ec, const std::vector<std::string> &children) {
+                           err = ec;
+                           names = children;
+                       })
+        ->wait();
+    if (err == ERR_OBJECT_NOT_FOUND) {
+        return ERR_OK;
+    }
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    seqs.clear();
+    for (const std::string &name : names) {
+        uint64_t seq;
+        if (buf2uint64(name, seq)) {
+            seqs.push_back(seq);
+        }
+    }
+    std::sort(seqs.begin(), seqs.end());
+    return ERR_OK;
+}
+
+error_code warm_standby::read_entry(uint64_t seq, std::set<std::string> &paths)
+{
+    error_code err;
+    blob value;
+    _remote
+        ->get_data(journaled_meta_state_service::entry_path(_journal_root, seq),
+                   LPC_META_CALLBACK,
+                   [&err, &value](error_code ec, const blob &data) {
+                       err = ec;
+                       value = data;
+                   })
+        ->wait();
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    std::vector<std::string> entry;
+    if (!json::json_forwarder<std::vector<std::string>>::decode(value, entry)) {
+        derror_f("invalid journal entry {}: {}", seq, value.to_string());
+        return ERR_CORRUPTION;
+    }
+    paths.insert(entry.begin(), entry.end());
+    return ERR_OK;
+}
+
+error_code warm_standby::refresh()
+{
+    zauto_lock l(_lock);
+
+    std::vector<uint64_t> seqs;
+    error_code err = list_journal(seqs);
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    auto first_new = std::upper_bound(seqs.begin(), seqs.end(), _applied_seq);
+    // the entries since last refresh should be all kept
+    if (!_loaded || (first_new != seqs.end() &&
+                     static_cast<uint64_t>(seqs.end() - first_new) != seqs.back() - _applied_seq)) {
+        return reload(seqs);
+    }
+    if (first_new == seqs.end()) {
+        // the writes of the latest entry may be still ongoing
+        return reread(_unsettled);
+    }
+
+    // the entries before the latest one are settled, including the former latest one
+    std::set<std::string> paths = std::move(_unsettled);
+    std::set<std::string> unsettled;
+    for (auto it = first_new; it != seqs.end(); ++it) {
+        err = read_entry(*it, *it == seqs.back() ? unsettled : paths);
+        if (err == ERR_OBJECT_NOT_FOUND) {
+            // removed since listed, and the followers are lagging behind the journal
+            return reload(seqs);
+        }
+        if (err != ERR_OK) {
+            _unsettled.insert(paths.begin(), paths.end());
+            return err;
+        }
+    }
+    paths.insert(unsettled.begin(), unsettled.end());
+
+    if (paths.count(_apps_root) != 0) {
+        // the apps root is changed or a transaction is submitted
+        return reload(seqs);
+    }
+    err = reread(paths);
+    if (err != ERR_OK) {
+        _unsettled = std::move(paths);
+        return err;
+    }
+    _applied_seq = seqs.back();
+    _unsettled = std::move(unsettled);
+    return ERR_OK;
+}
+
+error_code warm_standby::reload(const std::vector<uint64_t> &seqs)
+{
+    _loaded = false;
+    _nodes.clear();
+    _unsettled.clear();
+
+    // all the entries but the latest one are settled before they are listed
+    uint64_t latest = seqs.empty() ? 0 : seqs.back();
+    if (!seqs.empty()) {
+        error_code err = read_entry(latest, _unsettled);
+        if (err != ERR_OK && err != ERR_OBJECT_NOT_FOUND) {
+            return err;
+        }
+    }
+
+    error_code err = ERR_OK;
+    blob root_data;
+    _remote
+        ->get_data(_apps_root,
+                   LPC_META_CALLBACK,
+                   [&err, &root_data](error_code ec, const blob &data) {
+                       err = ec;
+                       root_data = data;
+                   })
+        ->wait();
+    if (err == ERR_OBJECT_NOT_FOUND) {
+        _applied_seq = latest;
+        _loaded = true;
+        return ERR_OK;
+    }
+    if (err != ERR_OK) {
+        return err;
+    }
+    put_unlocked(_apps_root, root_data);
+
+    std::vector<std::string> apps;
+    _remote
+        ->get_children(_apps_root,
+                       LPC_META_CALLBACK,
+                       [&err, &apps](error_code ec, const std::vector<std::string> &children) {
+                           err = ec;
+                           apps = children;
+                       })
+        ->wait();
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    struct app_data
+    {
+        error_code err;
+        blob data;
+        dist::children_data children;
+    };
+    std::vector<app_data> loaded(apps.size());
+    dsn::task_tracker tracker;
+    for (size_t i = 0; i < apps.size(); ++i) {
+        std::string app_path = _apps_root + "/" + apps[i];
+        app_data *d = &loaded[i];
+        _remote->get_data(app_path,
+                          LPC_META_CALLBACK,
+                          [this, app_path, d, &tracker](error_code ec, const blob &data) {
+                              d->err = ec;
+                              d->data = data;
+                              if (ec != ERR_OK) {
+                                  return;
+                              }
+                              _remote->get_children_data(
+                                  app_path,
+                                  LPC_META_CALLBACK,
+                                  [d](error_code ec, const dist::children_data &children) {
+                                      d->err = ec;
+                                      d->children = children;
+                                  },
+                                  &tracker);
+                          },
+                          &tracker);
+    }
+    tracker.wait_outstanding_tasks();
+
+    for (size_t i = 0; i < apps.size(); ++i) {
+        if (loaded[i].err == ERR_OBJECT_NOT_FOUND) {
+            // removed since listed
+            continue;
+        }
+        if (loaded[i].err != ERR_OK) {
+            _nodes.clear();
+            return loaded[i].err;
+        }
+        std::string app_path = _apps_root + "/" + apps[i];
+        put_unlocked(app_path, loaded[i].data);
+        for (const auto &child : loaded[i].children) {
+            put_unlocked(app_path + "/" + child.first, child.second);
+        }
+    }
+
+    ddebug_f("warm standby loaded {} apps from remote storage, journal entry = {}",
+             apps.size(),
+             latest);
+    _applied_seq = latest;
+    _loaded = true;
+    return ERR_OK;
+}
+
+error_code warm_standby::reread(const std::set<std::string> &paths)
+{
+    struct path_data
+    {
+        error_code err;
+        blob data;
+    };
+    std::vector<std::string> path_list(paths.begin(), paths.end());
+    std::vector<path_data> results(path_list.size());
+    dsn::task_tracker tracker;
+    for (size_t i = 0; i < path_list.size(); ++i) {
+        path_data *d = &results[i];
+        _remote->get_data(path_list[i],
+                          LPC_META_CALLBACK,
+                          [d](error_code ec, const blob &data) {
+                              d->err = ec;
+                              d->data = data;
+                          },
+                          &tracker);
+    }
+    tracker.wait_outstanding_tasks();
+
+    for (size_t i = 0; i < path_list.size(); ++i) {
+        if (results[i].err != ERR_OK && results[i].err != ERR_OBJECT_NOT_FOUND) {
+            return results[i].err;
+        }
+    }
+    // parents are applied before their children
+    for (size_t i = 0; i < path_list.size(); ++i) {
+        if (results[i].err == ERR_OK) {
+            put_unlocked(path_list[i], results[i].data);
+        } else {
+            erase_unlocked(path_list[i]);
+        }
+    }
+    return ERR_OK;
+}
+
+void warm_standby::put_unlocked(const std::string &path, const blob &data)
+{
+    _nodes[path].data = data;
+    if (path != _apps_root) {
+        size_t pos = path.rfind('/');
+        _nodes[path.substr(0, pos)].children.insert(path.substr(pos + 1));
+    }
+}
+
+void warm_standby::erase_unlocked(const std::string &path)
+{
+    std::string prefix = path + "/";
+    auto it = _nodes.lower_bound(prefix);
+    while (it != _nodes.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+        it = _nodes.erase(it);
+    }
+    _nodes.erase(path);
+    if (path != _apps_root) {
+        size_t pos = path.rfind('/');
+        auto parent = _nodes.find(path.substr(0, pos));
+        if (parent != _nodes.end()) {
+            parent->second.children.erase(path.substr(pos + 1));
+        }
+    }
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,210 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <dsn/dist/meta_state_service.h>
+#include <dsn/tool-api/zlocks.h>
+
+namespace dsn {
+namespace replication {
+
+///
+/// With [meta_server] warm_standby_enabled, the leader records the paths it writes under
+/// <cluster_root>/apps, i.e. the apps root, the app nodes and their children, in a change
+/// journal before writing them:
+///
+///   <cluster_root>/apps_journal/<seq> -> json list of the paths written by batch <seq>
+///
+/// The writes of a batch are issued after its entry is created, and the next entry is created
+/// after the writes of the batch complete, so all the entries but the latest one are settled.
+///
+/// The followers keep a copy of the apps subtree up to date by re-reading the paths in the new
+/// entries, and the new leader catches up the tail of the journal on takeover rather than
+/// reading all the apps from remote storage again.
+///
+class journaled_meta_state_service : public dist::meta_state_service
+{
+public:
+    explicit journaled_meta_state_service(std::shared_ptr<dist::meta_state_service> inner)
+        : _inner(std::move(inner))
+    {
+    }
+
+    // the writes are passed through until this is called by the leader, after which the writes
+    // under `apps_root` are journaled from entry `first_seq`, and the entries older than the
+    // last `max_entries` ones are removed
+    void start_journal(const std::string &apps_root,
+                       const std::string &journal_root,
+                       uint64_t first_seq,
+                       uint32_t max_entries);
+
+    error_code initialize(const std::vector<std::string> &args) override
+    {
+        return _inner->initialize(args);
+    }
+    error_code finalize() override { return _inner->finalize(); }
+
+    std::shared_ptr<transaction_entries> new_transaction_entries(unsigned int capacity) override
+    {
+        return _inner->new_transaction_entries(capacity);
+    }
+    // the paths of a transaction are unknown, so it's journaled as a change of the apps root,
+    // on which the followers reload all the apps
+    task_ptr submit_transaction(const std::shared_ptr<transaction_entries> &entries,
+                                task_code cb_code,
+                                const err_callback &cb_transaction,
+                                dsn::task_tracker *tracker = nullptr) override;
+
+    task_ptr create_node(const std::string &node,
+                         task_code cb_code,
+                         const err_callback &cb_create,
+                         const blob &value = blob(),
+                         dsn::task_tracker *tracker = nullptr) override;
+    task_ptr delete_node(const std::string &node,
+                         bool recursively_delete,
+                         task_code cb_code,
+                         const err_callback &cb_delete,
+                         dsn::task_tracker *tracker = nullptr) override;
+    task_ptr set_data(const std::string &node,
+                      const blob &value,
+                      task_code cb_code,
+                      const err_callback &cb_set_data,
+                      dsn::task_tracker *tracker = nullptr) override;
+
+    // reads are not ordered after the queued writes
+    task_ptr node_exist(const std::string &node,
+                        task_code cb_code,
+                        const err_callback &cb_exist,
+                        dsn::task_tracker *tracker = nullptr) override
+    {
+        return _inner->node_exist(node, cb_code, cb_exist, tracker);
+    }
+    task_ptr get_data(const std::string &node,
+                      task_code cb_code,
+                      const err_value_callback &cb_get_data,
+                      dsn::task_tracker *tracker = nullptr) override
+    {
+        return _inner->get_data(node, cb_code, cb_get_data, tracker);
+    }
+    task_ptr get_children(const std::string &node,
+                          task_code cb_code,
+                          const err_stringv_callback &cb_get_children,
+                          dsn::task_tracker *tracker = nullptr) override
+    {
+        return _inner->get_children(node, cb_code, cb_get_children, tracker);
+    }
+    task_ptr get_children_data(const std::string &node,
+                               task_code cb_code,
+                               const err_children_data_callback &cb_get_children_data,
+                               dsn::task_tracker *tracker = nullptr) override
+    {
+        return _inner->get_children_data(node, cb_code, cb_get_children_data, tracker);
+    }
+
+    static std::string entry_path(const std::string &journal_root, uint64_t seq)
+    {
+        return journal_root + "/" + std::to_string(seq);
+    }
+
+private:
+    typedef std::function<void(const std::function<void()> &on_done)> issue_func;
+    struct pending_write
+    {
+        // empty if not journaled
+        std::string path;
+        issue_func issue;
+    };
+    typedef std::shared_ptr<std::vector<pending_write>> batch_ptr;
+
+    bool is_journaled(const std::string &path) const;
+
+    // queue the write if the journal is started, or call `issue` directly
+    void append_write(const std::string &path, issue_func issue);
+    void try_flush();
+    void write_entry(uint64_t seq, blob value, batch_ptr batch);
+    void issue_batch(const batch_ptr &batch);
+    void on_batch_done();
+
+    std::shared_ptr<dist::meta_state_service> _inner;
+
+    zlock _lock;
+    bool _started{false};
+    std::string _apps_root;
+    std::string _journal_root;
+    uint32_t _max_entries{0};
+    uint64_t _next_seq{0};
+    // whether there's a batch whose entry or writes are ongoing
+    bool _flushing{false};
+    std::vector<pending_write> _pending;
+};
+
+// The copy of the apps subtree kept by a follower, which is refreshed from the journal.
+class warm_standby
+{
+public:
+    warm_standby(dist::meta_state_service *remote,
+                 std::string apps_root,
+                 std::string journal_root);
+    ~warm_standby();
+
+    // refresh periodically until stop()
+    void start(std::chrono::milliseconds interval);
+    // stop refreshing, and wait for the ongoing refresh
+    void stop();
+
+    // load the apps subtree if not loaded yet or the journal is truncated since last refresh,
+    // otherwise re-read the paths in the new entries, blocking
+    error_code refresh();
+
+    uint64_t latest_seq() const;
+
+    // a read-only view of the copy for server_state::sync_apps_from_remote_storage, which is
+    // valid until this is destroyed and shouldn't be used concurrently with refresh()
+    dist::meta_state_service *snapshot() { return _view.get(); }
+
+private:
+    class snapshot_service;
+    friend class snapshot_service;
+    friend class warm_standby_test;
+
+    struct node
+    {
+        blob data;
+        std::set<std::string> children;
+    };
+
+    error_code list_journal(std::vector<uint64_t> &seqs);
+    error_code read_entry(uint64_t seq, std::set<std::string> &paths);
+    error_code reload(const std::vector<uint64_t> &seqs);
+    error_code reread(const std::set<std::string> &paths);
+
+    void put_unlocked(const std::string &path, const blob &data);
+    void erase_unlocked(const std::string &path);
+
+    dist::meta_state_service *_remote;
+    const std::string _apps_root;
+    const std::string _journal_root;
+
+    mutable zlock _lock;
+    bool _loaded{false};
+    uint64_t _applied_seq{0};
+    // the paths of the latest entry applied, whose writes may be ongoing
+    std::set<std::string> _unsettled;
+    // full path -> node
+    std::map<std::string, node> _nodes;
+
+    task_ptr _timer;
+    std::unique_ptr<snapshot_service> _view;
+};
+
+} // namespace replication
+} // namespace dsn
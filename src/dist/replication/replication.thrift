@@ -124,6 +124,14 @@ enum learner_status
     LearningFailed,
 }
 
+// Used for cold backup, bulk load and learn
+struct file_meta
+{
+    1:string    name;
+    2:i64       size;
+    3:string    md5;
+}
+
 struct learn_request
 {
     1:dsn.gpid pid;
@@ -137,6 +145,10 @@ struct learn_request
     // be duplicated (ie. max_gced_decree < confirmed_decree), if not,
     // learnee will copy the missing logs.
     7:optional i64        max_gced_decree;
+
+    // The checkpoint files the learner has locally, with the names relative to its data dir.
+    // Learnee won't copy the files of its checkpoint that the learner already has.
+    8:optional list<file_meta> local_files;
 }
 
 struct learn_response
@@ -149,6 +161,14 @@ struct learn_response
     6:learn_state           state; // learning data, including memory data and files
     7:dsn.rpc_address       address; // learnee's address
     8:string                base_local_dir; // base dir of files on learnee
+
+    // The files in state.files that learner should take from its local_files rather than
+    // copying from learnee. The local file is the one with the same size and md5.
+    9:optional list<file_meta> reused_files;
+
+    // The count of the primary and secondaries of the partition, by which the learner schedules
+    // the learning of the partitions with less replicas first.
+    10:optional i32         replica_count;
 }
 
 struct learn_notify_response
@@ -246,11 +266,44 @@ struct replica_server_info
     2:i64 total_capacity_mb;
 }
 
+// the load of a partition served by a replica server, reported if it's among the hottest
+struct partition_hotspot
+{
+    1:dsn.gpid pid;
+    2:i64 read_qps;
+    3:i64 write_qps;
+    4:i64 bytes_per_sec;
+    // the partition hashes of the hottest keys sampled, and their estimated qps respectively
+    5:list<i64> hot_key_hashes;
+    6:list<i64> hot_key_qps;
+    7:i64 write_bytes_per_sec;
+}
+
+// the load of a replica since the last config sync
+struct replica_load
+{
+    1:dsn.gpid pid;
+    2:i64 qps;
+    3:i64 write_bytes_per_sec;
+}
+
 struct configuration_query_by_node_request
 {
     1:dsn.rpc_address  node;
     2:optional list<replica_info> stored_replicas;
     3:optional replica_server_info info;
+    // the version of the stored replicas of this request, which is acked by meta server
+    4:optional i64 sync_version;
+    // if set, stored_replicas only contains the replicas changed since the version acked
+    // before, and removed_replicas are those removed since then
+    5:optional i64 base_version;
+    6:optional list<dsn.gpid> removed_replicas;
+    // the hottest partitions on the node since the last config sync
+    7:optional list<partition_hotspot> hot_partitions;
+    // the loads of the replicas which served any request since the last config sync
+    8:optional list<replica_load> replica_loads;
+    // the tags of the disks detected as fail-slow, whose replicas are to be moved off the node
+    9:optional list<string> slow_disks;
 }
 
 struct configuration_query_by_node_response
@@ -258,6 +311,9 @@ struct configuration_query_by_node_response
     1:dsn.error_code err;
     2:list<configuration_update_request> partitions;
     3:optional list<replica_info> gc_replicas;
+    // the sync_version of the request if its stored replicas are accepted, or else the
+    // replica server should send all the stored replicas next time
+    4:optional i64 acked_sync_version;
 }
 
 struct create_app_options
@@ -427,6 +483,9 @@ struct replica_info
     6:i64                    last_durable_decree;
     7:string                 app_type;
     8:string                 disk_tag;
+    // the size of the data of the replica, with which meta server estimates the cost of
+    // copying the replica to another node
+    9:optional i64           checkpoint_size_mb;
 }
 
 struct query_replica_info_request
@@ -628,14 +687,6 @@ struct configuration_query_restore_response
     3:list<i32>             restore_progress;
 }
 
-// Used for cold backup and bulk load
-struct file_meta
-{
-    1:string    name;
-    2:i64       size;
-    3:string    md5;
-}
-
 enum app_env_operation
 {
     APP_ENV_OP_INVALID,
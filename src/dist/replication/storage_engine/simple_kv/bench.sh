@@ -0,0 +1,15 @@
+#!/bin/bash
+#
+# Run the replication benchmark, the options are in [simple_kv.bench] of config.bench.ini.
+#
+# USAGE: ./bench.sh [config-file]
+
+if [ ! -f dsn.replication.simple_kv ]; then
+    echo "dsn.replication.simple_kv not exist"
+    exit 1
+fi
+
+config=${1:-config.bench.ini}
+
+./clear.sh
+./dsn.replication.simple_kv ${config}
@@ -0,0 +1,273 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <dsn/c/api_layer1.h>
+#include <dsn/tool-api/command_manager.h>
+#include <dsn/utility/rand.h>
+
+#include "simple_kv.client.h"
+
+namespace dsn {
+namespace replication {
+namespace application {
+
+// latency histogram of microseconds, whose buckets are the powers of 2 divided into 16 sub
+// buckets, so the percentiles are within 1/16 of the real values
+class latency_histogram
+{
+public:
+    latency_histogram()
+    {
+        for (auto &c : _counts) {
+            c.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void record(uint64_t us)
+    {
+        _counts[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        _sum_us.fetch_add(us, std::memory_order_relaxed);
+        uint64_t max_us = _max_us.load(std::memory_order_relaxed);
+        while (us > max_us && !_max_us.compare_exchange_weak(max_us, us)) {
+        }
+    }
+
+    uint64_t count() const { return _count.load(); }
+    uint64_t avg_us() const { return count() == 0 ? 0 : _sum_us.load() / count(); }
+    uint64_t max_us() const { return _max_us.load(); }
+
+    // the upper bound of the bucket of the `percentile` (e.g. 99.9)
+    uint64_t percentile_us(double percentile) const
+    {
+        uint64_t target = static_cast<uint64_t>(count() * percentile / 100);
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; ++i) {
+            seen += _counts[i].load(std::memory_order_relaxed);
+            if (seen > target) {
+                return std::min(bucket_upper_bound(i), max_us());
+            }
+        }
+        return max_us();
+    }
+
+private:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const int BUCKET_COUNT = 64 * SUB_BUCKET_COUNT;
+
+    static int bucket_index(uint64_t us)
+    {
+        if (us < SUB_BUCKET_COUNT) {
+            return static_cast<int>(us);
+        }
+        int msb = 63 - __builtin_clzll(us);
+        int sub = static_cast<int>(us >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+        return (msb - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + sub;
+    }
+
+    static uint64_t bucket_upper_bound(int index)
+    {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        int msb = index / SUB_BUCKET_COUNT + SUB_BUCKET_BITS - 1;
+        uint64_t sub = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+        return ((sub + 1) << (msb - SUB_BUCKET_BITS)) - 1;
+    }
+
+    std::atomic<uint64_t> _counts[BUCKET_COUNT];
+    std::atomic<uint64_t> _count{0};
+    std::atomic<uint64_t> _sum_us{0};
+    std::atomic<uint64_t> _max_us{0};
+};
+
+// simple_kv_bench_app is a client driving a read/write mix to a simple_kv app, as the baseline
+// of the replication performance. It keeps [simple_kv.bench] concurrency requests outstanding,
+// whose callbacks are spread over the threads of THREAD_POOL_DEFAULT, measures for
+// duration_seconds after warmup_seconds, then prints the QPS and latency percentiles of the
+// reads and writes, and the per-stage latencies of the task codes on the request path from the
+// profiler toollet, and exits the process. See config.bench.ini and bench.sh.
+class simple_kv_bench_app : public ::dsn::service_app
+{
+public:
+    simple_kv_bench_app(const service_app_info *info) : ::dsn::service_app(info) {}
+
+    ~simple_kv_bench_app() override { stop(); }
+
+    ::dsn::error_code start(const std::vector<std::string> &args) override
+    {
+        if (args.size() < 4)
+            return ::dsn::ERR_INVALID_PARAMETERS;
+
+        _concurrency = (int)dsn_config_get_value_uint64(
+            "simple_kv.bench", "concurrency", 64, "count of the outstanding requests");
+        _read_percent = (int)dsn_config_get_value_uint64(
+            "simple_kv.bench", "read_percent", 50, "percent of the reads in the requests");
+        _value_size = (int)dsn_config_get_value_uint64(
+            "simple_kv.bench", "value_size", 100, "bytes of the written values");
+        _key_space = dsn_config_get_value_uint64(
+            "simple_kv.bench", "key_space", 100000, "count of the distinct keys");
+        _warmup_seconds = (int)dsn_config_get_value_uint64(
+            "simple_kv.bench", "warmup_seconds", 5, "seconds before measuring");
+        _duration_seconds = (int)dsn_config_get_value_uint64(
+            "simple_kv.bench", "duration_seconds", 30, "seconds of measuring");
+        _value.assign(_value_size, 'v');
+
+        dsn::rpc_address meta;
+        meta.from_string_ipv4(args[2].c_str());
+        _client.reset(new simple_kv_client(args[1].c_str(), {meta}, args[3].c_str()));
+
+        ::dsn::tasking::enqueue(LPC_SIMPLE_KV_BENCH, &_tracker, [this] { run(); });
+        return ::dsn::ERR_OK;
+    }
+
+    ::dsn::error_code stop(bool cleanup = false) override
+    {
+        _stopped = true;
+        _tracker.cancel_outstanding_tasks();
+        _client.reset();
+        return ::dsn::ERR_OK;
+    }
+
+private:
+    void run()
+    {
+        // wait until the app is created and its partitions are ready
+        while (_client->read_sync("bench").first != ERR_OK) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+
+        uint64_t now_us = dsn_now_us();
+        _measure_start_us = now_us + _warmup_seconds * 1000000ULL;
+        _measure_end_us = _measure_start_us + _duration_seconds * 1000000ULL;
+        for (int i = 0; i < _concurrency; ++i) {
+            issue(i);
+        }
+
+        ::dsn::tasking::enqueue(LPC_SIMPLE_KV_BENCH,
+                                &_tracker,
+                                [this] { report(); },
+                                0,
+                                std::chrono::milliseconds((_measure_end_us - now_us) / 1000 +
+                                                          1000));
+    }
+
+    // issue a request, whose callback issues the next one on the same thread
+    void issue(int slot)
+    {
+        if (_stopped || dsn_now_us() >= _measure_end_us) {
+            return;
+        }
+
+        std::string key = "k" + std::to_string(rand::next_u64(0, _key_space - 1));
+        uint64_t partition_hash = std::hash<std::string>()(key);
+        uint64_t start_us = dsn_now_us();
+        if ((int)rand::next_u32(0, 99) < _read_percent) {
+            _client->read(key,
+                          [this, slot, start_us](error_code err, std::string &&) {
+                              on_complete(slot, start_us, err, _reads, _read_errors);
+                          },
+                          std::chrono::milliseconds(0),
+                          partition_hash,
+                          slot);
+        } else {
+            kv_pair pr;
+            pr.key = std::move(key);
+            pr.value = _value;
+            _client->write(pr,
+                           [this, slot, start_us](error_code err, int32_t) {
+                               on_complete(slot, start_us, err, _writes, _write_errors);
+                           },
+                           std::chrono::milliseconds(0),
+                           partition_hash,
+                           slot);
+        }
+    }
+
+    void on_complete(int slot,
+                     uint64_t start_us,
+                     error_code err,
+                     latency_histogram &hist,
+                     std::atomic<uint64_t> &errors)
+    {
+        uint64_t now_us = dsn_now_us();
+        if (now_us >= _measure_start_us && now_us < _measure_end_us) {
+            if (err == ERR_OK) {
+                hist.record(now_us - start_us);
+            } else {
+                errors.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        issue(slot);
+    }
+
+    void report()
+    {
+        std::ostringstream out;
+        out << "simple_kv bench: concurrency " << _concurrency << ", read " << _read_percent
+            << "%, value " << _value_size << " bytes, key space " << _key_space << ", "
+            << _duration_seconds << " seconds" << std::endl;
+        report_op(out, "read", _reads, _read_errors);
+        report_op(out, "write", _writes, _write_errors);
+
+        // latencies of the stages on the request path, e.g. queueing and execution on the
+        // primary, the prepare to the secondaries, and the writes of the private log
+        for (const char *code : {"RPC_SIMPLE_KV_SIMPLE_KV_READ",
+                                 "RPC_SIMPLE_KV_SIMPLE_KV_WRITE",
+                                 "RPC_PREPARE",
+                                 "LPC_WRITE_REPLICATION_LOG_SHARED"}) {
+            std::string output;
+            if (command_manager::instance().run_command(
+                    "profiler.query", {"counter_calc", code}, output)) {
+                out << "stages of " << code << ":" << std::endl << output << std::endl;
+            }
+        }
+        std::cout << out.str() << std::flush;
+        dsn_exit(0);
+    }
+
+    void report_op(std::ostringstream &out,
+                   const char *name,
+                   const latency_histogram &hist,
+                   const std::atomic<uint64_t> &errors)
+    {
+        out << std::setw(6) << name << ": " << hist.count() / std::max(_duration_seconds, 1)
+            << " qps, " << errors.load() << " errors, latency(us) avg " << hist.avg_us()
+            << ", p50 " << hist.percentile_us(50) << ", p90 " << hist.percentile_us(90)
+            << ", p99 " << hist.percentile_us(99) << ", p999 " << hist.percentile_us(99.9)
+            << ", max " << hist.max_us() << std::endl;
+    }
+
+    int _concurrency{0};
+    int _read_percent{0};
+    int _value_size{0};
+    uint64_t _key_space{0};
+    int _warmup_seconds{0};
+    int _duration_seconds{0};
+    std::string _value;
+
+    uint64_t _measure_start_us{0};
+    uint64_t _measure_end_us{0};
+    std::atomic<bool> _stopped{false};
+
+    latency_histogram _reads;
+    latency_histogram _writes;
+    std::atomic<uint64_t> _read_errors{0};
+    std::atomic<uint64_t> _write_errors{0};
+
+    std::unique_ptr<simple_kv_client> _client;
+    dsn::task_tracker _tracker;
+};
+} // namespace application
+} // namespace replication
+} // namespace dsn
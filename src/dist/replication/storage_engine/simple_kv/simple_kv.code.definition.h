@@ -46,6 +46,9 @@ DEFINE_STORAGE_WRITE_RPC_CODE(RPC_SIMPLE_KV_SIMPLE_KV_APPEND, ALLOW_BATCH, NOT_I
 
 // test timer task code
 DEFINE_TASK_CODE(LPC_SIMPLE_KV_TEST_TIMER, TASK_PRIORITY_COMMON, ::dsn::THREAD_POOL_DEFAULT)
+
+// benchmark task code
+DEFINE_TASK_CODE(LPC_SIMPLE_KV_BENCH, TASK_PRIORITY_COMMON, ::dsn::THREAD_POOL_DEFAULT)
 }
 }
 }
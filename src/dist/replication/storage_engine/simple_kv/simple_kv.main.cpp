@@ -35,6 +35,7 @@
 
 // apps
 #include "simple_kv.app.example.h"
+#include "simple_kv.bench.h"
 #include "simple_kv.server.impl.h"
 
 // framework specific tools
@@ -50,6 +51,8 @@ static void dsn_app_registration_simple_kv()
 
     dsn::service_app::register_factory<dsn::replication::application::simple_kv_client_app>(
         "client");
+    dsn::service_app::register_factory<dsn::replication::application::simple_kv_bench_app>(
+        "bench");
 }
 
 int main(int argc, char **argv)
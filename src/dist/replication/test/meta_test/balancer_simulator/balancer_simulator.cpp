@@ -1,7 +1,14 @@
 #include <algorithm>
+#include <cmath>
+#include <iostream>
 #include <gtest/gtest.h>
 
+#include <dsn/tool-api/command_manager.h>
+#include <dsn/utility/rand.h>
+#include <dsn/utility/strings.h>
+
 #include "dist/replication/meta_server/meta_data.h"
+#include "dist/replication/meta_server/meta_service.h"
 #include "dist/replication/meta_server/server_load_balancer.h"
 #include "dist/replication/meta_server/greedy_load_balancer.h"
 #include "dist/replication/test/meta_test/misc/misc.h"
@@ -23,152 +30,260 @@ using namespace dsn::replication;
 #endif
 #define ASSERT_FALSE(exp) dassert(!(exp), "")
 
-class simple_priority_queue
+// The balancer simulator is a benchmark of the load balancers on large virtual clusters.
+//
+// It generates a synthetic cluster by the options of [balancer_simulator] in the config file,
+// runs the balancer of each strategy from the same cluster until it converges, and reports the
+// planning time of the rounds, the migrations, and how balanced the cluster is at last:
+//
+//   ./sim_lb [config.ini]
+struct simulator_options
 {
-public:
-    simple_priority_queue(const std::vector<dsn::rpc_address> &nl,
-                          server_load_balancer::node_comparator &&compare)
-        : container(nl), cmp(std::move(compare))
-    {
-        std::make_heap(container.begin(), container.end(), cmp);
-    }
-    void push(const dsn::rpc_address &addr)
-    {
-        container.push_back(addr);
-        std::push_heap(container.begin(), container.end(), cmp);
-    }
-    dsn::rpc_address pop()
+    int node_count;
+    int app_count;
+    int min_partition_count;
+    int max_partition_count;
+    int disks_per_node;
+    // percent of the nodes which are newly added, i.e. without any replica
+    int new_node_percent;
+    // percent of the replicas which are on the first disk of their nodes
+    int disk_skew_percent;
+    int max_rounds;
+    uint32_t random_seed;
+    std::vector<std::string> strategies;
+
+    void load()
     {
-        std::pop_heap(container.begin(), container.end(), cmp);
-        dsn::rpc_address result = container.back();
-        container.pop_back();
-        return result;
+        node_count = (int)dsn_config_get_value_uint64(
+            "balancer_simulator", "node_count", 1000, "count of the nodes in the cluster");
+        app_count = (int)dsn_config_get_value_uint64(
+            "balancer_simulator", "app_count", 200, "count of the apps in the cluster");
+        min_partition_count = (int)dsn_config_get_value_uint64(
+            "balancer_simulator", "min_partition_count", 8, "min partition count of an app");
+        max_partition_count = (int)dsn_config_get_value_uint64(
+            "balancer_simulator", "max_partition_count", 256, "max partition count of an app");
+        disks_per_node = (int)dsn_config_get_value_uint64(
+            "balancer_simulator", "disks_per_node", 8, "count of the disks of each node");
+        new_node_percent =
+            (int)dsn_config_get_value_uint64("balancer_simulator",
+                                             "new_node_percent",
+                                             10,
+                                             "percent of the nodes without any replica");
+        disk_skew_percent =
+            (int)dsn_config_get_value_uint64("balancer_simulator",
+                                             "disk_skew_percent",
+                                             30,
+                                             "percent of the replicas on the first disk");
+        max_rounds = (int)dsn_config_get_value_uint64(
+            "balancer_simulator", "max_rounds", 100000, "max balance rounds of a strategy");
+        random_seed = (uint32_t)dsn_config_get_value_uint64(
+            "balancer_simulator", "random_seed", 1, "random seed to generate the cluster");
+        std::string s = dsn_config_get_value_string(
+            "balancer_simulator",
+            "strategies",
+            "greedy,greedy_incremental,greedy_in_turn,greedy_only_move_primary",
+            "strategies to compare, separated by comma");
+        dsn::utils::split_args(s.c_str(), strategies, ',');
     }
-    dsn::rpc_address top() const { return container.front(); }
-    bool empty() const { return container.empty(); }
-private:
-    std::vector<dsn::rpc_address> container;
-    server_load_balancer::node_comparator cmp;
 };
 
-void generate_balanced_apps(/*out*/ app_mapper &apps,
-                            node_mapper &nodes,
-                            const std::vector<dsn::rpc_address> &node_list)
+struct simulation_result
 {
-    nodes.clear();
-    for (const auto &node : node_list)
-        nodes[node].set_alive(true);
-
-    int partitions_per_node = random32(20, 100);
-    dsn::app_info info;
-    info.status = dsn::app_status::AS_AVAILABLE;
-    info.is_stateful = true;
-    info.app_id = 1;
-    info.app_name = "test";
-    info.app_type = "test";
-    info.partition_count = partitions_per_node * node_list.size();
-    info.max_replica_count = 3;
-
-    std::shared_ptr<app_state> the_app = app_state::create(info);
-
-    simple_priority_queue pq1(node_list, server_load_balancer::primary_comparator(nodes));
-    // generate balanced primary
-    for (dsn::partition_configuration &pc : the_app->partitions) {
-        dsn::rpc_address n = pq1.pop();
-        nodes[n].put_partition(pc.pid, true);
-        pc.primary = n;
-        pq1.push(n);
-    }
+    int rounds{0};
+    int migrations{0};
+    int actions{0};
+    uint64_t total_plan_us{0};
+    uint64_t max_plan_us{0};
+    bool converged{false};
+};
+
+void generate_cluster(const simulator_options &opts,
+                      /*out*/ app_mapper &apps,
+                      /*out*/ node_mapper &nodes,
+                      /*out*/ nodes_fs_manager &manager)
+{
+    srand(opts.random_seed);
+    dsn::rand::reseed_thread_local_rng(opts.random_seed);
 
-    // generate balanced secondary
-    simple_priority_queue pq2(node_list, server_load_balancer::partition_comparator(nodes));
-    std::vector<dsn::rpc_address> temp;
-
-    for (dsn::partition_configuration &pc : the_app->partitions) {
-        temp.clear();
-        while (pc.secondaries.size() + 1 < pc.max_replica_count) {
-            dsn::rpc_address n = pq2.pop();
-            if (!is_member(pc, n)) {
-                pc.secondaries.push_back(n);
-                nodes[n].put_partition(pc.pid, false);
+    std::vector<dsn::rpc_address> node_list = generate_node_list(opts.node_count);
+    int old_node_count = std::max(3, opts.node_count * (100 - opts.new_node_percent) / 100);
+    std::vector<dsn::rpc_address> old_nodes(node_list.begin(), node_list.begin() + old_node_count);
+
+    apps.clear();
+    char disk_tag[256];
+    for (int i = 1; i <= opts.app_count; ++i) {
+        dsn::app_info info;
+        info.status = dsn::app_status::AS_AVAILABLE;
+        info.app_id = i;
+        info.is_stateful = true;
+        info.app_name = "test_app" + std::to_string(i);
+        info.app_type = "test";
+        info.max_replica_count = 3;
+        info.partition_count = random32(opts.min_partition_count, opts.max_partition_count);
+        std::shared_ptr<app_state> app = app_state::create(info);
+        generate_app(app, old_nodes);
+
+        // the replicas are skewed to the first disk of the nodes
+        for (int pidx = 0; pidx < app->partition_count; ++pidx) {
+            config_context &cc = app->helpers->contexts[pidx];
+            const dsn::partition_configuration &pc = app->partitions[pidx];
+            std::vector<dsn::rpc_address> members = pc.secondaries;
+            members.push_back(pc.primary);
+            for (const dsn::rpc_address &addr : members) {
+                replica_info ri;
+                uint32_t disk = random32(0, 99) < opts.disk_skew_percent
+                                    ? 1
+                                    : random32(1, opts.disks_per_node);
+                snprintf(disk_tag, sizeof(disk_tag), "disk%u", disk);
+                ri.disk_tag = disk_tag;
+                cc.collect_serving_replica(addr, ri);
             }
-            temp.push_back(n);
         }
-        for (auto n : temp)
-            pq2.push(n);
+        apps.emplace(app->app_id, app);
     }
 
-    // check if balanced
-    int pri_min, part_min;
-    pri_min = part_min = the_app->partition_count + 1;
-    int pri_max, part_max;
-    pri_max = part_max = -1;
-
-    for (auto &kv : nodes) {
-        if (kv.second.primary_count() > pri_max)
-            pri_max = kv.second.primary_count();
-        if (kv.second.primary_count() < pri_min)
-            pri_min = kv.second.primary_count();
-        if (kv.second.partition_count() > part_max)
-            part_max = kv.second.partition_count();
-        if (kv.second.partition_count() < part_min)
-            part_min = kv.second.partition_count();
+    generate_node_mapper(nodes, apps, node_list);
+    generate_node_fs_manager(apps, nodes, manager, opts.disks_per_node);
+}
+
+double stddev(const std::vector<int> &values)
+{
+    if (values.empty()) {
+        return 0;
     }
+    double mean = 0;
+    for (int v : values) {
+        mean += v;
+    }
+    mean /= values.size();
+    double sum = 0;
+    for (int v : values) {
+        sum += (v - mean) * (v - mean);
+    }
+    return std::sqrt(sum / values.size());
+}
 
-    apps.emplace(the_app->app_id, the_app);
+void report_balance(const simulator_options &opts, const app_mapper &apps, const node_mapper &nodes)
+{
+    std::vector<int> primaries;
+    std::vector<int> partitions;
+    for (const auto &kv : nodes) {
+        primaries.push_back(kv.second.primary_count());
+        partitions.push_back(kv.second.partition_count());
+    }
 
-    ASSERT_TRUE(pri_max - pri_min <= 1);
-    ASSERT_TRUE(part_max - part_min <= 1);
+    // the disks without any replica count too
+    std::map<std::pair<dsn::rpc_address, std::string>, int> disk_replicas;
+    for (const auto &kv : apps) {
+        for (const config_context &cc : kv.second->helpers->contexts) {
+            for (const serving_replica &r : cc.serving) {
+                disk_replicas[std::make_pair(r.node, r.disk_tag)]++;
+            }
+        }
+    }
+    std::vector<int> disks(nodes.size() * opts.disks_per_node, 0);
+    size_t i = 0;
+    for (const auto &kv : disk_replicas) {
+        if (i < disks.size()) {
+            disks[i++] = kv.second;
+        }
+    }
+
+    std::cout << "  stddev of primaries per node: " << stddev(primaries)
+              << ", partitions per node: " << stddev(partitions)
+              << ", replicas per disk: " << stddev(disks) << std::endl;
 }
 
-void random_move_primary(app_mapper &apps, node_mapper &nodes, int primary_move_ratio)
+// set the options of the balancer by its remote commands, as the meta server does
+void set_strategy(const std::string &strategy)
 {
-    app_state &the_app = *(apps[0]);
-    int space_size = the_app.partition_count * 100;
-    for (dsn::partition_configuration &pc : the_app.partitions) {
-        int n = random32(1, space_size) / 100;
-        if (n < primary_move_ratio) {
-            int indice = random32(0, 1);
-            nodes[pc.primary].remove_partition(pc.pid, true);
-            std::swap(pc.primary, pc.secondaries[indice]);
-            nodes[pc.primary].put_partition(pc.pid, true);
-        }
+    std::map<std::string, bool> flags = {{"meta.lb.balancer_in_turn", false},
+                                         {"meta.lb.only_primary_balancer", false},
+                                         {"meta.lb.only_move_primary", false},
+                                         {"meta.lb.incremental_balancer", false}};
+    if (strategy == "greedy_incremental") {
+        flags["meta.lb.incremental_balancer"] = true;
+    } else if (strategy == "greedy_in_turn") {
+        flags["meta.lb.balancer_in_turn"] = true;
+    } else if (strategy == "greedy_only_primary") {
+        flags["meta.lb.only_primary_balancer"] = true;
+    } else if (strategy == "greedy_only_move_primary") {
+        flags["meta.lb.only_primary_balancer"] = true;
+        flags["meta.lb.only_move_primary"] = true;
+    } else {
+        dassert(strategy == "greedy", "unknown strategy %s", strategy.c_str());
+    }
+
+    std::string output;
+    for (const auto &kv : flags) {
+        ASSERT_TRUE(dsn::command_manager::instance().run_command(
+            kv.first, {kv.second ? "true" : "false"}, output));
     }
 }
 
-void greedy_balancer_perfect_move_primary()
+simulation_result run_strategy(const simulator_options &opts, const std::string &strategy)
 {
     app_mapper apps;
     node_mapper nodes;
-    std::vector<dsn::rpc_address> node_list;
+    nodes_fs_manager manager;
+    generate_cluster(opts, apps, nodes, manager);
 
-    generate_node_list(node_list, 20, 100);
-    generate_balanced_apps(apps, nodes, node_list);
+    meta_service svc;
+    greedy_load_balancer glb(&svc);
+    glb.register_ctrl_commands();
+    set_strategy(strategy);
 
-    random_move_primary(apps, nodes, 70);
-    // test the greedy balancer's move primary
-    greedy_load_balancer glb(nullptr);
-    migration_list ml;
+    std::cout << strategy << ":" << std::endl;
+    report_balance(opts, apps, nodes);
 
-    glb.check({&apps, &nodes}, ml);
-    dinfo("balance checker operation count = %d", ml.size());
-    int i = 0;
+    simulation_result result;
+    migration_list ml;
+    while (result.rounds < opts.max_rounds) {
+        uint64_t start_us = dsn_now_us();
+        bool has_migrations = glb.balance({&apps, &nodes}, ml);
+        uint64_t plan_us = dsn_now_us() - start_us;
+        result.total_plan_us += plan_us;
+        result.max_plan_us = std::max(result.max_plan_us, plan_us);
+        if (!has_migrations) {
+            result.converged = true;
+            break;
+        }
 
-    while (glb.balance({&apps, &nodes}, ml)) {
+        result.rounds++;
+        result.migrations += ml.size();
         for (const auto &kv : ml) {
-            const std::shared_ptr<configuration_balancer_request> &req = kv.second;
-            for (const configuration_proposal_action &act : req->action_list) {
-                ASSERT_TRUE(act.type != config_type::CT_ADD_SECONDARY_FOR_LB);
-            }
+            result.actions += kv.second->action_list.size();
         }
-        glb.check({&apps, &nodes}, ml);
-        dinfo("round %d: balance checker operation count = %d", ++i, ml.size());
+        migration_check_and_apply(apps, nodes, ml, &manager);
     }
+    glb.unregister_ctrl_commands();
+
+    std::cout << "  " << (result.converged ? "converged" : "not converged") << " in "
+              << result.rounds << " rounds, " << result.migrations << " migrations, "
+              << result.actions << " actions" << std::endl;
+    std::cout << "  plan time: total " << result.total_plan_us / 1000 << " ms, avg "
+              << result.total_plan_us / (result.rounds + 1) << " us, max " << result.max_plan_us
+              << " us per round" << std::endl;
+    report_balance(opts, apps, nodes);
+    return result;
 }
 
-int main(int, char **)
+int main(int argc, char **argv)
 {
-    dsn_run_config("config.ini", false);
-    greedy_balancer_perfect_move_primary();
+    dsn_run_config(argc > 1 ? argv[1] : "config.ini", false);
+
+    simulator_options opts;
+    opts.load();
+    std::cout << "cluster of " << opts.node_count << " nodes (" << opts.new_node_percent
+              << "% new), " << opts.app_count << " apps of [" << opts.min_partition_count << ", "
+              << opts.max_partition_count << "] partitions, " << opts.disks_per_node
+              << " disks per node (" << opts.disk_skew_percent << "% replicas on disk1)"
+              << std::endl;
+
+    bool all_converged = true;
+    for (const std::string &strategy : opts.strategies) {
+        all_converged = run_strategy(opts, strategy).converged && all_converged;
+    }
+    dsn_exit(all_converged ? 0 : 1);
     return 0;
 }
@@ -0,0 +1,62 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include "dist/replication/meta_server/backup_scheduler.h"
+
+namespace dsn {
+namespace replication {
+
+TEST(backup_scheduler_test, limits)
+{
+    backup_scheduler scheduler(3, 2);
+    rpc_address node1("127.0.0.1", 34801);
+    rpc_address node2("127.0.0.1", 34802);
+
+    ASSERT_TRUE(scheduler.try_acquire("p1", gpid(1, 0), node1, "disk1"));
+    ASSERT_TRUE(scheduler.try_acquire("p1", gpid(1, 1), node1, "disk1"));
+    // acquiring again is idempotent
+    ASSERT_TRUE(scheduler.try_acquire("p1", gpid(1, 1), node1, "disk1"));
+    ASSERT_EQ(2, scheduler.running_count(node1, "disk1"));
+
+    // limited by the disk
+    ASSERT_FALSE(scheduler.try_acquire("p1", gpid(1, 2), node1, "disk1"));
+    ASSERT_TRUE(scheduler.try_acquire("p2", gpid(1, 2), node1, "disk2"));
+    ASSERT_EQ(3, scheduler.running_count(node1));
+
+    // limited by the node, while the disks of unknown tags are only limited by the node
+    ASSERT_FALSE(scheduler.try_acquire("p1", gpid(1, 3), node1, ""));
+    ASSERT_TRUE(scheduler.try_acquire("p1", gpid(1, 3), node2, ""));
+    ASSERT_TRUE(scheduler.try_acquire("p1", gpid(1, 4), node2, ""));
+    ASSERT_TRUE(scheduler.try_acquire("p1", gpid(1, 5), node2, ""));
+    ASSERT_FALSE(scheduler.try_acquire("p1", gpid(1, 6), node2, ""));
+
+    scheduler.release("p1", gpid(1, 0));
+    ASSERT_EQ(1, scheduler.running_count(node1, "disk1"));
+    ASSERT_TRUE(scheduler.try_acquire("p1", gpid(1, 2), node1, "disk1"));
+
+    scheduler.release_all("p1");
+    ASSERT_EQ(1, scheduler.running_count(node1));
+    ASSERT_EQ(0, scheduler.running_count(node2));
+    ASSERT_EQ(0, scheduler.running_count(node1, "disk1"));
+    ASSERT_EQ(1, scheduler.running_count(node1, "disk2"));
+}
+
+TEST(backup_scheduler_test, poll_delay)
+{
+    using std::chrono::milliseconds;
+    milliseconds period(10);
+    milliseconds max_delay(100);
+    ASSERT_EQ(milliseconds(10), backup_scheduler::poll_delay(0, period, max_delay));
+    ASSERT_EQ(milliseconds(20), backup_scheduler::poll_delay(1, period, max_delay));
+    ASSERT_EQ(milliseconds(80), backup_scheduler::poll_delay(3, period, max_delay));
+    ASSERT_EQ(milliseconds(100), backup_scheduler::poll_delay(4, period, max_delay));
+    ASSERT_EQ(milliseconds(100), backup_scheduler::poll_delay(50, period, max_delay));
+    // the period is never shortened
+    ASSERT_EQ(milliseconds(10), backup_scheduler::poll_delay(5, period, milliseconds(1)));
+}
+
+} // namespace replication
+} // namespace dsn
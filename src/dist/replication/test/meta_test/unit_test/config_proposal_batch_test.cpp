@@ -0,0 +1,167 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include <dsn/dist/replication/replication.codes.h>
+
+#include "dist/replication/meta_server/server_state.h"
+#include "dist/replication/test/meta_test/misc/misc.h"
+#include "meta_service_test_app.h"
+
+namespace dsn {
+namespace replication {
+
+struct sent_proposals
+{
+    rpc_address target;
+    task_code code;
+    std::vector<configuration_update_request> proposals;
+};
+
+// records the proposals sent to replica servers
+class proposal_recorder : public fake_receiver_meta_service
+{
+public:
+    void send_message(const rpc_address &target, dsn::message_ex *request) override
+    {
+        dsn::message_ex *recv_request = create_corresponding_receive(request);
+        configuration_update_request proposal;
+        dsn::unmarshall(recv_request, proposal);
+        record(target, RPC_CONFIG_PROPOSAL, {proposal});
+
+        destroy_message(request);
+        destroy_message(recv_request);
+    }
+
+    // req is held by callback
+    void send_request(dsn::message_ex *req,
+                      const rpc_address &target,
+                      const rpc_response_task_ptr &callback) override
+    {
+        dsn::message_ex *recv_request = create_corresponding_receive(req);
+        std::vector<configuration_update_request> proposals;
+        read_config_proposal_batch(recv_request, proposals);
+        record(target, RPC_CONFIG_PROPOSAL_BATCH, proposals);
+
+        dsn::message_ex *response = recv_request->create_response();
+        dsn::marshall(response, error_code(ERR_OK));
+        callback->enqueue(ERR_OK, create_corresponding_receive(response));
+
+        destroy_message(recv_request);
+        destroy_message(response);
+    }
+
+    std::vector<sent_proposals> sent()
+    {
+        zauto_lock l(_lock);
+        return _sent;
+    }
+
+private:
+    void record(const rpc_address &target,
+                task_code code,
+                const std::vector<configuration_update_request> &proposals)
+    {
+        zauto_lock l(_lock);
+        _sent.push_back({target, code, proposals});
+    }
+
+    zlock _lock;
+    std::vector<sent_proposals> _sent;
+};
+
+class config_proposal_batch_test : public testing::Test
+{
+public:
+    void SetUp() override { _ss._meta_svc = &_ms; }
+
+    void set_batch_options(uint64_t window_ms, int32_t max_count)
+    {
+        _ss._config_proposal_batch_window_ms = window_ms;
+        _ss._config_proposal_batch_max_count = max_count;
+    }
+
+    void send_proposal(const rpc_address &target, int partition_index)
+    {
+        configuration_update_request proposal;
+        proposal.type = config_type::CT_ADD_SECONDARY;
+        proposal.node = target;
+        proposal.config.pid = gpid(1, partition_index);
+        _ss.send_proposal(target, proposal);
+    }
+
+    std::vector<sent_proposals> wait_sent(size_t count)
+    {
+        EXPECT_TRUE(spin_wait_condition([this, count]() { return _ms.sent().size() >= count; },
+                                        10));
+        return _ms.sent();
+    }
+
+    proposal_recorder _ms;
+    server_state _ss;
+    const rpc_address _node1{"127.0.0.1", 34801};
+    const rpc_address _node2{"127.0.0.1", 34802};
+};
+
+TEST_F(config_proposal_batch_test, no_batch)
+{
+    set_batch_options(0, 64);
+    send_proposal(_node1, 0);
+    send_proposal(_node1, 1);
+
+    std::vector<sent_proposals> sent = _ms.sent();
+    ASSERT_EQ(2, sent.size());
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_EQ(RPC_CONFIG_PROPOSAL, sent[i].code);
+        ASSERT_EQ(gpid(1, i), sent[i].proposals[0].config.pid);
+    }
+}
+
+TEST_F(config_proposal_batch_test, batch_in_window)
+{
+    set_batch_options(100, 64);
+    send_proposal(_node1, 0);
+    send_proposal(_node2, 1);
+    send_proposal(_node1, 2);
+    send_proposal(_node1, 3);
+    // nothing is sent until the window ends
+    ASSERT_TRUE(_ms.sent().empty());
+
+    std::vector<sent_proposals> sent = wait_sent(2);
+    ASSERT_EQ(2, sent.size());
+    std::sort(sent.begin(), sent.end(), [](const sent_proposals &a, const sent_proposals &b) {
+        return a.target < b.target;
+    });
+
+    // the proposals are kept in order
+    ASSERT_EQ(_node1, sent[0].target);
+    ASSERT_EQ(RPC_CONFIG_PROPOSAL_BATCH, sent[0].code);
+    ASSERT_EQ(3, sent[0].proposals.size());
+    ASSERT_EQ(gpid(1, 0), sent[0].proposals[0].config.pid);
+    ASSERT_EQ(gpid(1, 2), sent[0].proposals[1].config.pid);
+    ASSERT_EQ(gpid(1, 3), sent[0].proposals[2].config.pid);
+    ASSERT_EQ(config_type::CT_ADD_SECONDARY, sent[0].proposals[2].type);
+
+    // a single proposal is sent as it is
+    ASSERT_EQ(_node2, sent[1].target);
+    ASSERT_EQ(RPC_CONFIG_PROPOSAL, sent[1].code);
+    ASSERT_EQ(gpid(1, 1), sent[1].proposals[0].config.pid);
+}
+
+TEST_F(config_proposal_batch_test, full_batch)
+{
+    set_batch_options(100000, 2);
+    send_proposal(_node1, 0);
+    send_proposal(_node1, 1);
+
+    // a full batch is sent at once
+    std::vector<sent_proposals> sent = _ms.sent();
+    ASSERT_EQ(1, sent.size());
+    ASSERT_EQ(RPC_CONFIG_PROPOSAL_BATCH, sent[0].code);
+    ASSERT_EQ(2, sent[0].proposals.size());
+}
+
+} // namespace replication
+} // namespace dsn
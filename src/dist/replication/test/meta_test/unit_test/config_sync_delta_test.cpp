@@ -0,0 +1,85 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include "dist/replication/meta_server/server_state.h"
+
+namespace dsn {
+namespace replication {
+
+class config_sync_delta_test : public testing::Test
+{
+public:
+    static replica_info make_replica(int partition_index, ballot b)
+    {
+        replica_info info;
+        info.pid = gpid(1, partition_index);
+        info.ballot = b;
+        info.status = partition_status::PS_SECONDARY;
+        return info;
+    }
+
+    configuration_query_by_node_request make_request(int64_t sync_version,
+                                                     int64_t base_version,
+                                                     const std::vector<replica_info> &replicas,
+                                                     const std::vector<gpid> &removed = {})
+    {
+        configuration_query_by_node_request req;
+        req.node = _node;
+        req.__set_stored_replicas(replicas);
+        req.__set_sync_version(sync_version);
+        if (base_version != 0) {
+            req.__set_base_version(base_version);
+            req.__set_removed_replicas(removed);
+        }
+        return req;
+    }
+
+    // return the merged ballots ordered by partition index, or empty if failed to merge
+    std::vector<ballot> merge(const configuration_query_by_node_request &req)
+    {
+        std::vector<replica_info> replicas;
+        std::vector<ballot> ballots;
+        if (_ss.merge_stored_replicas(req, replicas)) {
+            for (const replica_info &info : replicas) {
+                EXPECT_EQ(static_cast<int>(ballots.size()), info.pid.get_partition_index());
+                ballots.push_back(info.ballot);
+            }
+        }
+        return ballots;
+    }
+
+    server_state _ss;
+    const rpc_address _node{"127.0.0.1", 34801};
+};
+
+TEST_F(config_sync_delta_test, merge_stored_replicas)
+{
+    // a full sync
+    ASSERT_EQ(std::vector<ballot>({1, 1}),
+              merge(make_request(1, 0, {make_replica(0, 1), make_replica(1, 1)})));
+
+    // a delta sync updates and adds replicas
+    ASSERT_EQ(std::vector<ballot>({2, 1, 1}),
+              merge(make_request(2, 1, {make_replica(0, 2), make_replica(2, 1)})));
+
+    // and removes replicas, nothing changed in the others
+    ASSERT_EQ(std::vector<ballot>({2}), merge(make_request(3, 2, {}, {gpid(1, 1), gpid(1, 2)})));
+
+    // a delta sync based on an unknown version is rejected, and then a full sync is required
+    ASSERT_TRUE(merge(make_request(5, 4, {make_replica(0, 3)})).empty());
+    ASSERT_TRUE(merge(make_request(6, 3, {make_replica(0, 3)})).empty());
+    ASSERT_EQ(std::vector<ballot>({3}), merge(make_request(7, 0, {make_replica(0, 3)})));
+
+    // a request without sync version is always of all the stored replicas
+    configuration_query_by_node_request req;
+    req.node = _node;
+    req.__set_stored_replicas({make_replica(0, 4), make_replica(1, 4)});
+    ASSERT_EQ(std::vector<ballot>({4, 4}), merge(req));
+    ASSERT_TRUE(merge(make_request(8, 7, {make_replica(0, 5)})).empty());
+}
+
+} // namespace replication
+} // namespace dsn
@@ -42,27 +42,44 @@ public:
         ASSERT_FALSE(dup.alter_progress(1, 5));
 
         dup.init_progress(1, invalid_decree);
+        dup.init_progress(2, invalid_decree);
         ASSERT_TRUE(dup.alter_progress(1, 5));
         ASSERT_EQ(dup._progress[1].volatile_decree, 5);
-        ASSERT_TRUE(dup._progress[1].is_altering);
 
-        // busy updating
-        ASSERT_FALSE(dup.alter_progress(1, 10));
+        // stale decree
+        ASSERT_FALSE(dup.alter_progress(1, 4));
         ASSERT_EQ(dup._progress[1].volatile_decree, 5);
-        ASSERT_TRUE(dup._progress[1].is_altering);
 
-        dup.persist_progress(1);
+        blob value;
+        ASSERT_TRUE(dup.begin_persist_progress(value));
+        ASSERT_TRUE(dup._is_progress_altering);
+        ASSERT_EQ(value.to_string(), R"({"1":5,"2":-1})");
+
+        // busy updating
+        ASSERT_TRUE(dup.alter_progress(2, 10));
+        ASSERT_FALSE(dup.begin_persist_progress(value));
+
+        dup.persist_progress();
         ASSERT_EQ(dup._progress[1].stored_decree, 5);
-        ASSERT_FALSE(dup._progress[1].is_altering);
+        ASSERT_EQ(dup._progress[2].stored_decree, invalid_decree);
+        ASSERT_FALSE(dup._is_progress_altering);
 
         // too frequent to update
-        ASSERT_FALSE(dup.alter_progress(1, 10));
-        ASSERT_FALSE(dup._progress[1].is_altering);
+        ASSERT_FALSE(dup.begin_persist_progress(value));
+        ASSERT_FALSE(dup._is_progress_altering);
 
-        dup._progress[1].last_progress_update_ms -=
-            duplication_info::PROGRESS_UPDATE_PERIOD_MS + 100;
+        // the progress of all partitions is persisted in one update
+        dup._last_progress_update_ms -= duplication_info::PROGRESS_UPDATE_PERIOD_MS + 100;
         ASSERT_TRUE(dup.alter_progress(1, 15));
-        ASSERT_TRUE(dup._progress[1].is_altering);
+        ASSERT_TRUE(dup.begin_persist_progress(value));
+        ASSERT_EQ(value.to_string(), R"({"1":15,"2":10})");
+        dup.persist_progress();
+        ASSERT_EQ(dup._progress[1].stored_decree, 15);
+        ASSERT_EQ(dup._progress[2].stored_decree, 10);
+
+        // nothing changed
+        dup._last_progress_update_ms -= duplication_info::PROGRESS_UPDATE_PERIOD_MS + 100;
+        ASSERT_FALSE(dup.begin_persist_progress(value));
     }
 
     static void test_init_and_start()
@@ -0,0 +1,237 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+
+#include "dist/replication/meta_server/greedy_load_balancer.h"
+#include "dist/replication/meta_server/meta_service.h"
+#include "dist/replication/test/meta_test/misc/misc.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_uint32(balancer_max_copies_in_per_node);
+DSN_DECLARE_uint32(balancer_max_copies_out_per_node);
+
+class greedy_load_balancer_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        std::vector<rpc_address> node_list;
+        generate_node_list(node_list, 10, 10);
+        generate_apps(_apps, node_list, 3, 4, std::pair<uint32_t, uint32_t>(32, 64), true);
+        generate_node_mapper(_nodes, _apps, node_list);
+        generate_node_fs_manager(_apps, _nodes, _manager, 4);
+    }
+
+    // the options of the meta_service are not initialized in the test
+    static void set_options(greedy_load_balancer &glb, bool incremental, bool load_weighted = false)
+    {
+        glb._balancer_in_turn = false;
+        glb._only_primary_balancer = false;
+        glb._only_move_primary = false;
+        glb._incremental_balancer = incremental;
+        glb._load_weighted_balancer = load_weighted;
+    }
+
+    // report the qps of each partition of `app` by the node serving its primary
+    void report_loads(meta_service &svc, const app_state &app, const std::vector<int64_t> &qps)
+    {
+        std::map<rpc_address, configuration_query_by_node_request> requests;
+        for (const auto &kv : _nodes) {
+            requests[kv.first].node = kv.first;
+        }
+        for (const auto &pc : app.partitions) {
+            replica_load load;
+            load.pid = pc.pid;
+            load.qps = qps[pc.pid.get_partition_index()];
+            load.write_bytes_per_sec = 0;
+            requests[pc.primary].__isset.replica_loads = true;
+            requests[pc.primary].replica_loads.push_back(load);
+        }
+        for (const auto &kv : requests) {
+            svc.get_server_state()->update_load_reports(kv.second);
+        }
+    }
+
+    int64_t max_node_qps(const app_state &app, const std::vector<int64_t> &qps)
+    {
+        std::map<rpc_address, int64_t> node_qps;
+        for (const auto &pc : app.partitions) {
+            node_qps[pc.primary] += qps[pc.pid.get_partition_index()];
+        }
+        int64_t result = 0;
+        for (const auto &kv : node_qps) {
+            result = std::max(result, kv.second);
+        }
+        return result;
+    }
+
+    // apply the balance actions until all apps are balanced
+    void balance_to_end(greedy_load_balancer &glb)
+    {
+        migration_list ml;
+        for (int i = 0; i < 10000 && glb.balance({&_apps, &_nodes}, ml); ++i) {
+            migration_check_and_apply(_apps, _nodes, ml, &_manager);
+        }
+        ASSERT_TRUE(ml.empty());
+    }
+
+    std::string get_plan_stats(greedy_load_balancer &glb)
+    {
+        return glb.get_balance_operation_count({"plan"});
+    }
+
+    const greedy_load_balancer::plan_stats &last_plan_stats(const greedy_load_balancer &glb)
+    {
+        return glb.t_last_plan_stats;
+    }
+
+    app_mapper _apps;
+    node_mapper _nodes;
+    nodes_fs_manager _manager;
+};
+
+TEST_F(greedy_load_balancer_test, incremental_balancer)
+{
+    meta_service svc;
+    greedy_load_balancer glb(&svc);
+    set_options(glb, true);
+    balance_to_end(glb);
+
+    // the balanced apps are skipped by both primary and secondary balancers
+    migration_list ml;
+    ASSERT_FALSE(glb.balance({&_apps, &_nodes}, ml));
+    ASSERT_EQ(0, last_plan_stats(glb).planned_apps);
+    ASSERT_EQ(6, last_plan_stats(glb).skipped_apps);
+    ASSERT_EQ("planned_apps=0,skipped_apps=6,plan_time_us=0,slowest_app=0,"
+              "slowest_app_plan_time_us=0,throttled_apps=0,copy_mb=0",
+              get_plan_stats(glb));
+
+    // which is the same as a full round
+    greedy_load_balancer full_glb(&svc);
+    set_options(full_glb, false);
+    ASSERT_FALSE(full_glb.balance({&_apps, &_nodes}, ml));
+    ASSERT_EQ(6, last_plan_stats(full_glb).planned_apps);
+
+    // only the changed app is planned again
+    partition_configuration &pc = _apps[1]->partitions[0];
+    rpc_address old_primary = pc.primary;
+    _nodes[old_primary].remove_partition(pc.pid, true);
+    _nodes[pc.secondaries[0]].put_partition(pc.pid, true);
+    pc.primary = pc.secondaries[0];
+    pc.secondaries[0] = old_primary;
+
+    glb.balance({&_apps, &_nodes}, ml);
+    ASSERT_LE(1, last_plan_stats(glb).planned_apps);
+    ASSERT_LE(2, last_plan_stats(glb).skipped_apps);
+    ASSERT_EQ(1, last_plan_stats(glb).slowest_app);
+    balance_to_end(glb);
+
+    // a new node makes all the apps planned again
+    rpc_address new_node("127.0.0.1", 20000);
+    _nodes[new_node].set_alive(true);
+    _nodes[new_node].set_addr(new_node);
+    ASSERT_TRUE(glb.balance({&_apps, &_nodes}, ml));
+    ASSERT_EQ(0, last_plan_stats(glb).skipped_apps);
+
+    // disabling the incremental mode makes all the apps planned
+    set_options(glb, false);
+    glb.balance({&_apps, &_nodes}, ml);
+    ASSERT_EQ(0, last_plan_stats(glb).skipped_apps);
+}
+
+TEST_F(greedy_load_balancer_test, load_weighted_balancer)
+{
+    meta_service svc;
+    greedy_load_balancer glb(&svc);
+    set_options(glb, false);
+    balance_to_end(glb);
+
+    // all the primaries on one node are hot
+    const app_state &app = *_apps.begin()->second;
+    rpc_address hot_node = app.partitions[0].primary;
+    std::vector<int64_t> qps(app.partition_count, 10);
+    for (const auto &pc : app.partitions) {
+        if (pc.primary == hot_node) {
+            qps[pc.pid.get_partition_index()] = 1000;
+        }
+    }
+    report_loads(svc, app, qps);
+
+    // the loads are ignored unless in load-weighted mode
+    migration_list ml;
+    ASSERT_FALSE(glb.balance({&_apps, &_nodes}, ml));
+
+    set_options(glb, false, true);
+    int64_t old_max_qps = max_node_qps(app, qps);
+    ASSERT_TRUE(glb.balance({&_apps, &_nodes}, ml));
+    for (int i = 0; i < 100 && !ml.empty(); ++i) {
+        // only the primaries of the hot app are moved, in a bounded count
+        ASSERT_GE(4, ml.size());
+        for (const auto &kv : ml) {
+            ASSERT_EQ(app.app_id, kv.first.get_app_id());
+            ASSERT_EQ(1, kv.second->action_list.size());
+            ASSERT_EQ(config_type::CT_UPGRADE_TO_PRIMARY, kv.second->action_list[0].type);
+        }
+        migration_check_and_apply(_apps, _nodes, ml, &_manager);
+        report_loads(svc, app, qps);
+        glb.balance({&_apps, &_nodes}, ml);
+    }
+    ASSERT_TRUE(ml.empty());
+    ASSERT_GT(old_max_qps, max_node_qps(app, qps));
+
+    // the primaries are still balanced by count
+    set_options(glb, false);
+    ASSERT_FALSE(glb.balance({&_apps, &_nodes}, ml));
+}
+
+TEST_F(greedy_load_balancer_test, throttled_migrations)
+{
+    meta_service svc;
+    greedy_load_balancer glb(&svc);
+    set_options(glb, false);
+    balance_to_end(glb);
+
+    // a new node makes the replicas copied to it
+    rpc_address new_node("127.0.0.1", 20000);
+    _nodes[new_node].set_alive(true);
+    _nodes[new_node].set_addr(new_node);
+
+    FLAGS_balancer_max_copies_in_per_node = 2;
+    FLAGS_balancer_max_copies_out_per_node = 1;
+    migration_list ml;
+    bool throttled = false;
+    for (int i = 0; i < 10000 && glb.balance({&_apps, &_nodes}, ml); ++i) {
+        std::map<rpc_address, int> copies_in, copies_out;
+        for (const auto &kv : ml) {
+            if (kv.second->balance_type == balancer_request_type::move_primary) {
+                continue;
+            }
+            const gpid &pid = kv.first;
+            ++copies_out[_apps[pid.get_app_id()]->partitions[pid.get_partition_index()].primary];
+            ++copies_in[kv.second->action_list[0].node];
+        }
+        for (const auto &kv : copies_in) {
+            ASSERT_GE(2, kv.second);
+        }
+        for (const auto &kv : copies_out) {
+            ASSERT_GE(1, kv.second);
+        }
+        throttled = throttled || last_plan_stats(glb).throttled_apps > 0;
+        migration_check_and_apply(_apps, _nodes, ml, &_manager);
+    }
+    FLAGS_balancer_max_copies_in_per_node = 0;
+    FLAGS_balancer_max_copies_out_per_node = 0;
+
+    // the deferred copies are done in the later rounds
+    ASSERT_TRUE(ml.empty());
+    ASSERT_TRUE(throttled);
+    ASSERT_LT(0u, _nodes[new_node].partition_count());
+}
+
+} // namespace replication
+} // namespace dsn
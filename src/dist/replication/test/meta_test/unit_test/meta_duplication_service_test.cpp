@@ -172,15 +172,10 @@ public:
 
             // update progress
             auto dup = app->duplications[resp.dupid];
-            duplication_sync_rpc rpc(make_unique<duplication_sync_request>(),
-                                     RPC_CM_DUPLICATION_SYNC);
-            dup_svc().do_update_partition_confirmed(dup, rpc, 1, 1000);
-            wait_all();
-
-            dup_svc().do_update_partition_confirmed(dup, rpc, 2, 2000);
-            wait_all();
-
-            dup_svc().do_update_partition_confirmed(dup, rpc, 4, 4000);
+            dup->alter_progress(1, 1000);
+            dup->alter_progress(2, 2000);
+            dup->alter_progress(4, 4000);
+            dup_svc().do_update_progress(dup);
             wait_all();
         }
 
@@ -535,6 +530,10 @@ TEST_F(meta_duplication_service_test, duplication_sync)
 
         duplication_sync_response resp = duplication_sync(node, confirm_list);
         ASSERT_EQ(resp.err, ERR_OK);
+
+        // the progress persisted by the last sync is responded
+        resp = duplication_sync(node, {});
+        ASSERT_EQ(resp.err, ERR_OK);
         ASSERT_EQ(resp.dup_map.size(), 1);
         ASSERT_EQ(resp.dup_map[app->app_id].size(), 1);
         ASSERT_EQ(resp.dup_map[app->app_id][dupid].dupid, dupid);
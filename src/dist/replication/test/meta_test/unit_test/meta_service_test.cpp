@@ -5,10 +5,13 @@
 #include "meta_test_base.h"
 
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_int32(create_app_partition_batch_size);
+
 class meta_service_test : public meta_test_base
 {
 public:
@@ -61,6 +64,30 @@ public:
         fail::teardown();
     }
 
+    void create_app_in_batches()
+    {
+        int32_t old_batch_size = FLAGS_create_app_partition_batch_size;
+        FLAGS_create_app_partition_batch_size = 16;
+        create_app("batch_created", 40);
+        FLAGS_create_app_partition_batch_size = old_batch_size;
+
+        std::shared_ptr<app_state> app = find_app("batch_created");
+        ASSERT_NE(nullptr, app);
+        ASSERT_EQ(app_status::AS_AVAILABLE, app->status);
+
+        // all the partition nodes are created on remote storage
+        std::vector<std::string> children;
+        _ms->get_remote_storage()
+            ->get_children(_ms->_cluster_root + "/apps/" + std::to_string(app->app_id),
+                           LPC_META_CALLBACK,
+                           [&children](error_code ec, const std::vector<std::string> &c) {
+                               ASSERT_EQ(ERR_OK, ec);
+                               children = c;
+                           })
+            ->wait();
+        ASSERT_EQ(40, children.size());
+    }
+
 private:
     app_env_rpc create_fake_rpc()
     {
@@ -77,5 +104,7 @@ TEST_F(meta_service_test, check_status_failure) { check_status_failure(); }
 
 TEST_F(meta_service_test, check_status_success) { check_status_success(); }
 
+TEST_F(meta_service_test, create_app_in_batches) { create_app_in_batches(); }
+
 } // namespace replication
 } // namespace dsn
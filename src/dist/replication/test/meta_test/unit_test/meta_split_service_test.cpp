@@ -56,10 +56,9 @@ public:
         return rpc.response();
     }
 
-    register_child_response
-    register_child(ballot req_parent_ballot, ballot child_ballot, bool wait_zk = false)
+    // mock the app whose partition count is doubled, where the children are not registered
+    std::shared_ptr<app_state> mock_app_partition_split()
     {
-        // mock local app info
         auto app = find_app(NAME);
         app->partition_count *= 2;
         app->partitions.resize(app->partition_count);
@@ -73,33 +72,47 @@ public:
                 app->partitions[i].ballot = PARENT_BALLOT;
             }
         }
-        app->partitions[CHILD_INDEX].ballot = child_ballot;
 
         // mock node state
         node_state node;
-        node.put_partition(dsn::gpid(app->app_id, PARENT_INDEX), true);
+        for (int i = 0; i < app->partition_count / 2; ++i) {
+            node.put_partition(dsn::gpid(app->app_id, i), true);
+        }
         mock_node_state(dsn::rpc_address("127.0.0.1", 10086), node);
+        return app;
+    }
 
-        // mock register_child_request
+    register_child_rpc
+    create_register_child_rpc(const app_state &app, ballot req_parent_ballot, int parent_index)
+    {
         partition_configuration parent_config;
         parent_config.ballot = req_parent_ballot;
         parent_config.last_committed_decree = 5;
         parent_config.max_replica_count = 3;
-        parent_config.pid = dsn::gpid(app->app_id, PARENT_INDEX);
+        parent_config.pid = dsn::gpid(app.app_id, parent_index);
 
         dsn::partition_configuration child_config;
         child_config.ballot = PARENT_BALLOT + 1;
         child_config.last_committed_decree = 5;
-        child_config.pid = dsn::gpid(app->app_id, CHILD_INDEX);
+        child_config.pid = dsn::gpid(app.app_id, parent_index + app.partition_count / 2);
 
         // register_child_request request;
         auto request = dsn::make_unique<register_child_request>();
-        request->app.app_id = app->app_id;
+        request->app.app_id = app.app_id;
         request->parent_config = parent_config;
         request->child_config = child_config;
         request->primary_address = dsn::rpc_address("127.0.0.1", 10086);
 
-        register_child_rpc rpc(std::move(request), RPC_CM_REGISTER_CHILD_REPLICA);
+        return register_child_rpc(std::move(request), RPC_CM_REGISTER_CHILD_REPLICA);
+    }
+
+    register_child_response
+    register_child(ballot req_parent_ballot, ballot child_ballot, bool wait_zk = false)
+    {
+        auto app = mock_app_partition_split();
+        app->partitions[CHILD_INDEX].ballot = child_ballot;
+
+        register_child_rpc rpc = create_register_child_rpc(*app, req_parent_ballot, PARENT_INDEX);
         split_svc().register_child_on_meta(rpc);
         wait_all();
         if (wait_zk) {
@@ -154,5 +167,23 @@ TEST_F(meta_split_service_test, register_child_succeed)
     ASSERT_EQ(resp.err, ERR_OK);
 }
 
+TEST_F(meta_split_service_test, register_children_in_batch)
+{
+    auto app = mock_app_partition_split();
+
+    // the children registered while the first transaction is in flight are batched
+    std::vector<register_child_rpc> rpcs;
+    for (uint32_t i = 0; i < PARTITION_COUNT; ++i) {
+        rpcs.emplace_back(create_register_child_rpc(*app, PARENT_BALLOT, i));
+        split_svc().register_child_on_meta(rpcs.back());
+    }
+    wait_all();
+
+    for (uint32_t i = 0; i < PARTITION_COUNT; ++i) {
+        ASSERT_EQ(ERR_OK, rpcs[i].response().err);
+        ASSERT_EQ(PARENT_BALLOT + 1, app->partitions[i + PARTITION_COUNT].ballot);
+    }
+}
+
 } // namespace replication
 } // namespace dsn
@@ -0,0 +1,153 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <algorithm>
+#include <gtest/gtest.h>
+
+#include "dist/replication/meta_server/partition_chunk_store.h"
+#include "meta_test_base.h"
+
+namespace dsn {
+namespace replication {
+
+class partition_chunk_store_test : public meta_test_base
+{
+public:
+    void set_chunk_size(int32_t chunk_size) { _ms->_meta_opts.partition_chunk_size = chunk_size; }
+
+    int32_t get_chunk_size(int32_t app_id) { return _ss->_chunk_store->get_chunk_size(app_id); }
+
+    std::vector<std::string> get_partition_nodes(const app_state &app)
+    {
+        std::vector<std::string> nodes;
+        _ms->get_remote_storage()
+            ->get_children(_ss->get_app_path(app),
+                           LPC_META_CALLBACK,
+                           [&nodes](error_code ec, const std::vector<std::string> &children) {
+                               ASSERT_EQ(ERR_OK, ec);
+                               nodes = children;
+                           })
+            ->wait();
+        std::sort(nodes.begin(), nodes.end());
+        return nodes;
+    }
+
+    error_code write_partition(const partition_configuration &pc)
+    {
+        error_code err;
+        _ss->write_partition_on_remote(pc, false, [&err](error_code ec) { err = ec; })->wait();
+        return err;
+    }
+
+    // load all the apps from remote storage by a new server_state
+    std::shared_ptr<server_state> reload()
+    {
+        auto ss = std::make_shared<server_state>();
+        ss->initialize(_ms.get(), _ss->_apps_root);
+        EXPECT_EQ(ERR_OK, ss->sync_apps_from_remote_storage());
+        EXPECT_TRUE(ss->spin_wait_staging(30));
+        return ss;
+    }
+};
+
+TEST_F(partition_chunk_store_test, chunk_format)
+{
+    int chunk_index = -1;
+    ASSERT_EQ("chunk.12", partition_chunk_store::get_chunk_name(12));
+    ASSERT_TRUE(partition_chunk_store::parse_chunk_name("chunk.12", chunk_index));
+    ASSERT_EQ(12, chunk_index);
+    ASSERT_FALSE(partition_chunk_store::parse_chunk_name("12", chunk_index));
+    ASSERT_FALSE(partition_chunk_store::parse_chunk_name("chunk.", chunk_index));
+    ASSERT_FALSE(partition_chunk_store::parse_chunk_name("chunk.-1", chunk_index));
+
+    std::vector<partition_configuration> partitions(3);
+    for (int i = 0; i < 3; ++i) {
+        partitions[i].pid = gpid(1, 4 + i);
+        partitions[i].ballot = 10 + i;
+        partitions[i].primary = rpc_address("127.0.0.1", 34801 + i);
+        partitions[i].secondaries = {rpc_address("127.0.0.1", 34810 + i)};
+        partitions[i].last_committed_decree = 100 + i;
+    }
+    blob value = partition_chunk_store::encode_chunk(4, partitions);
+
+    int32_t chunk_size = 0;
+    std::vector<partition_configuration> decoded;
+    ASSERT_TRUE(partition_chunk_store::decode_chunk(value, chunk_size, decoded));
+    ASSERT_EQ(4, chunk_size);
+    ASSERT_EQ(partitions, decoded);
+
+    ASSERT_FALSE(partition_chunk_store::decode_chunk(value.range(0, 8), chunk_size, decoded));
+}
+
+TEST_F(partition_chunk_store_test, legacy_layout)
+{
+    create_app("legacy_app", 4);
+    std::shared_ptr<app_state> app = find_app("legacy_app");
+    ASSERT_EQ(0, get_chunk_size(app->app_id));
+    ASSERT_EQ(std::vector<std::string>({"0", "1", "2", "3"}), get_partition_nodes(*app));
+
+    // the layout of existing apps is kept after the chunked layout is enabled
+    set_chunk_size(2);
+    create_app("chunked_app", 4);
+    std::shared_ptr<server_state> ss = reload();
+    ASSERT_EQ(0, ss->_chunk_store->get_chunk_size(app->app_id));
+    ASSERT_EQ(2, ss->_chunk_store->get_chunk_size(find_app("chunked_app")->app_id));
+    ASSERT_EQ(app->partitions, ss->get_app(app->app_id)->partitions);
+}
+
+TEST_F(partition_chunk_store_test, chunked_layout)
+{
+    set_chunk_size(4);
+    create_app("chunked_app", 10);
+    std::shared_ptr<app_state> app = find_app("chunked_app");
+    ASSERT_EQ(4, get_chunk_size(app->app_id));
+    ASSERT_EQ(std::vector<std::string>({"chunk.0", "chunk.1", "chunk.2"}),
+              get_partition_nodes(*app));
+
+    // partitions of the same chunk written concurrently are all persisted
+    std::vector<partition_configuration> partitions = app->partitions;
+    std::vector<task_ptr> tasks;
+    for (int i = 4; i < 8; ++i) {
+        partitions[i].ballot = 100 + i;
+        partitions[i].primary = rpc_address("127.0.0.1", 34801 + i);
+        tasks.push_back(_ss->write_partition_on_remote(
+            partitions[i], false, [](error_code ec) { ASSERT_EQ(ERR_OK, ec); }));
+    }
+    for (auto &t : tasks) {
+        t->wait();
+    }
+    // and a later write of a chunk doesn't roll back them
+    partitions[5].ballot = 200;
+    ASSERT_EQ(ERR_OK, write_partition(partitions[5]));
+
+    std::shared_ptr<server_state> ss = reload();
+    std::shared_ptr<app_state> reloaded = ss->get_app(app->app_id);
+    ASSERT_EQ(4, ss->_chunk_store->get_chunk_size(app->app_id));
+    ASSERT_EQ(partitions, reloaded->partitions);
+}
+
+TEST_F(partition_chunk_store_test, half_created)
+{
+    set_chunk_size(4);
+    create_app("chunked_app", 10);
+    std::shared_ptr<app_state> app = find_app("chunked_app");
+
+    // the last chunk is lost, like the meta server crashed while creating the app
+    error_code err;
+    _ms->get_remote_storage()
+        ->delete_node(_ss->get_app_path(*app) + "/" + partition_chunk_store::get_chunk_name(2),
+                      false,
+                      LPC_META_CALLBACK,
+                      [&err](error_code ec) { err = ec; })
+        ->wait();
+    ASSERT_EQ(ERR_OK, err);
+
+    std::shared_ptr<server_state> ss = reload();
+    ASSERT_EQ(10, ss->get_app(app->app_id)->partition_count);
+    ASSERT_EQ(std::vector<std::string>({"chunk.0", "chunk.1", "chunk.2"}),
+              get_partition_nodes(*app));
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,182 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include "dist/replication/meta_server/server_state.h"
+
+namespace dsn {
+namespace replication {
+
+class routing_table_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        app_info info;
+        info.app_id = 1;
+        info.app_name = "test";
+        info.app_type = "simple_kv";
+        info.is_stateful = true;
+        info.max_replica_count = 3;
+        info.partition_count = 4;
+        info.status = app_status::AS_AVAILABLE;
+        _app = app_state::create(info);
+        _ss._all_apps.emplace(_app->app_id, _app);
+        _ss._exist_apps.emplace(_app->app_name, _app);
+        _ss.publish_routing_table();
+    }
+
+    void update_partition(int pidx)
+    {
+        _app->partitions[pidx].ballot++;
+        _ss.publish_partition_route(*_app, pidx);
+    }
+
+    void publish_all() { _ss.publish_routing_table(); }
+
+    configuration_query_by_index_response query(int64_t known_version = -1)
+    {
+        configuration_query_by_index_request req;
+        req.app_name = _app->app_name;
+        if (known_version != -1) {
+            req.__set_known_version(known_version);
+        }
+        configuration_query_by_index_response resp;
+        _ss.query_configuration_by_index(req, resp);
+        return resp;
+    }
+
+    static std::vector<int> indices(const configuration_query_by_index_response &resp)
+    {
+        std::vector<int> result;
+        for (const partition_configuration &pc : resp.partitions) {
+            result.push_back(pc.pid.get_partition_index());
+        }
+        return result;
+    }
+
+    bool config_sync(const rpc_address &node,
+                     const std::vector<replica_info> &replicas,
+                     configuration_query_by_node_response &resp)
+    {
+        return _ss.fill_config_sync_from_routes(node, replicas, resp);
+    }
+
+    server_state _ss;
+    std::shared_ptr<app_state> _app;
+};
+
+TEST_F(routing_table_test, delta_query)
+{
+    configuration_query_by_index_response full = query();
+    ASSERT_EQ(ERR_OK, full.err);
+    ASSERT_TRUE(full.__isset.version);
+    ASSERT_EQ(4, full.partitions.size());
+
+    // nothing changed
+    configuration_query_by_index_response resp = query(full.version);
+    ASSERT_EQ(ERR_OK, resp.err);
+    ASSERT_EQ(full.version, resp.version);
+    ASSERT_TRUE(resp.partitions.empty());
+
+    update_partition(1);
+    update_partition(3);
+    resp = query(full.version);
+    ASSERT_EQ(std::vector<int>({1, 3}), indices(resp));
+    ASSERT_EQ(_app->partitions[1], resp.partitions[0]);
+    ASSERT_EQ(_app->partitions[3], resp.partitions[1]);
+    ASSERT_LT(full.version, resp.version);
+
+    int64_t version = resp.version;
+    update_partition(2);
+    ASSERT_EQ(std::vector<int>({2}), indices(query(version)));
+    ASSERT_EQ(std::vector<int>({1, 2, 3}), indices(query(full.version)));
+
+    // an unknown version, e.g. from another meta server, gets all the partitions
+    resp = query(_ss._last_route_version.load() + 1);
+    ASSERT_EQ(4, resp.partitions.size());
+    ASSERT_EQ(_ss._last_route_version.load(), resp.version);
+
+    // the routes of the app are rebuilt, e.g. when its status changes
+    _ss.publish_app_route(*_app);
+    ASSERT_EQ(4, query(version).partitions.size());
+}
+
+TEST_F(routing_table_test, serialized_response)
+{
+    configuration_query_by_index_response full = query();
+    update_partition(0);
+
+    configuration_query_by_index_request req;
+    req.app_name = _app->app_name;
+    for (int64_t known_version : {int64_t(-1), full.version}) {
+        if (known_version != -1) {
+            req.__set_known_version(known_version);
+        }
+        configuration_query_by_index_response resp;
+        _ss.query_configuration_by_index(req, resp);
+
+        // the cached response is the same as the serialized one
+        blob body, cached_body;
+        ASSERT_TRUE(_ss.query_configuration_by_index_serialized(req, body));
+        ASSERT_TRUE(_ss.query_configuration_by_index_serialized(req, cached_body));
+        ASSERT_EQ(body.data(), cached_body.data());
+
+        binary_reader reader(body);
+        configuration_query_by_index_response decoded;
+        unmarshall(reader, decoded, DSF_THRIFT_BINARY);
+        ASSERT_EQ(resp, decoded);
+    }
+
+    // the queries by index aren't cached
+    configuration_query_by_index_request indexed;
+    indexed.app_name = _app->app_name;
+    indexed.partition_indices = {1};
+    blob body;
+    ASSERT_FALSE(_ss.query_configuration_by_index_serialized(indexed, body));
+
+    // a new version of the app isn't served by the responses cached before
+    blob old_body;
+    req.__isset.known_version = false;
+    ASSERT_TRUE(_ss.query_configuration_by_index_serialized(req, old_body));
+    update_partition(2);
+    ASSERT_TRUE(_ss.query_configuration_by_index_serialized(req, body));
+    ASSERT_NE(old_body.data(), body.data());
+}
+
+TEST_F(routing_table_test, config_sync_from_routes)
+{
+    const rpc_address node("127.0.0.1", 34801);
+    const rpc_address other("127.0.0.1", 34802);
+    _app->partitions[0].primary = node;
+    _app->partitions[1].secondaries = {other, node};
+    _app->partitions[2].primary = other;
+    publish_all();
+
+    auto make_replica = [](int pidx) {
+        replica_info info;
+        info.pid = gpid(1, pidx);
+        return info;
+    };
+
+    configuration_query_by_node_response resp;
+    ASSERT_TRUE(config_sync(node, {make_replica(0), make_replica(1)}, resp));
+    ASSERT_EQ(2, resp.partitions.size());
+    ASSERT_EQ(_app->partitions[0], resp.partitions[0].config);
+    ASSERT_EQ(_app->partitions[1], resp.partitions[1].config);
+    ASSERT_EQ(_app->app_name, resp.partitions[0].info.app_name);
+    ASSERT_EQ(node, resp.partitions[1].host_node);
+
+    // a replica not served by the node per the routing table diverges
+    resp.partitions.clear();
+    ASSERT_FALSE(config_sync(node, {make_replica(2)}, resp));
+    resp.partitions.clear();
+    replica_info unknown;
+    unknown.pid = gpid(2, 0);
+    ASSERT_FALSE(config_sync(node, {unknown}, resp));
+}
+
+} // namespace replication
+} // namespace dsn
@@ -263,19 +263,23 @@ void meta_service_test_app::state_sync_test()
         ASSERT_EQ(dsn::ERR_OK, resp.err);
 
         app->status = dsn::app_status::AS_DROPPING;
+        ss2->publish_app_route(*app);
         ss2->query_configuration_by_index(req, resp);
         ASSERT_EQ(dsn::ERR_BUSY_DROPPING, resp.err);
 
         app->status = dsn::app_status::AS_RECALLING;
+        ss2->publish_app_route(*app);
         ss2->query_configuration_by_index(req, resp);
         ASSERT_EQ(dsn::ERR_BUSY_CREATING, resp.err);
 
         app->status = dsn::app_status::AS_CREATING;
+        ss2->publish_app_route(*app);
         ss2->query_configuration_by_index(req, resp);
         ASSERT_EQ(dsn::ERR_BUSY_CREATING, resp.err);
 
         // client unknown state
         app->status = dsn::app_status::AS_DROP_FAILED;
+        ss2->publish_app_route(*app);
         ss2->query_configuration_by_index(req, resp);
         ASSERT_EQ(dsn::ERR_UNKNOWN, resp.err);
     }
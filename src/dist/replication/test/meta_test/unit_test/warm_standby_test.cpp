@@ -0,0 +1,157 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include "dist/replication/meta_server/warm_standby.h"
+
+#include "meta_test_base.h"
+
+namespace dsn {
+namespace replication {
+
+class warm_standby_test : public meta_test_base
+{
+public:
+    void SetUp() override
+    {
+        meta_test_base::SetUp();
+        _apps_root = _ms->_cluster_root + "/apps";
+        _journal_root = _ms->_cluster_root + "/apps_journal";
+        _journaled = std::make_shared<journaled_meta_state_service>(_ms->_storage);
+        ASSERT_EQ(ERR_OK, create(_journal_root, ""));
+        _standby = make_unique<warm_standby>(_ms->get_remote_storage(), _apps_root, _journal_root);
+    }
+
+    void TearDown() override
+    {
+        _standby.reset();
+        _journaled.reset();
+        meta_test_base::TearDown();
+    }
+
+    error_code create(const std::string &path, const std::string &value)
+    {
+        error_code err;
+        _journaled
+            ->create_node(path,
+                          LPC_META_CALLBACK,
+                          [&err](error_code ec) { err = ec; },
+                          blob::create_from_bytes(std::string(value)))
+            ->wait();
+        return err;
+    }
+
+    error_code set(const std::string &path, const std::string &value)
+    {
+        error_code err;
+        _journaled
+            ->set_data(path,
+                       blob::create_from_bytes(std::string(value)),
+                       LPC_META_CALLBACK,
+                       [&err](error_code ec) { err = ec; })
+            ->wait();
+        return err;
+    }
+
+    error_code remove(const std::string &path)
+    {
+        error_code err;
+        _journaled
+            ->delete_node(path, true, LPC_META_CALLBACK, [&err](error_code ec) { err = ec; })
+            ->wait();
+        return err;
+    }
+
+    // the data of `path` in the copy of the standby, or "-" if not found
+    std::string snapshot_data(const std::string &path)
+    {
+        std::string result = "-";
+        _standby->snapshot()
+            ->get_data(path,
+                       LPC_META_CALLBACK,
+                       [&result](error_code ec, const blob &value) {
+                           if (ec == ERR_OK) {
+                               result = value.to_string();
+                           }
+                       })
+            ->wait();
+        return result;
+    }
+
+    std::vector<std::string> snapshot_children(const std::string &path)
+    {
+        std::vector<std::string> result;
+        _standby->snapshot()
+            ->get_children(path,
+                           LPC_META_CALLBACK,
+                           [&result](error_code ec, const std::vector<std::string> &children) {
+                               result = children;
+                           })
+            ->wait();
+        return result;
+    }
+
+    std::string _apps_root;
+    std::string _journal_root;
+    std::shared_ptr<journaled_meta_state_service> _journaled;
+    std::unique_ptr<warm_standby> _standby;
+};
+
+TEST_F(warm_standby_test, catch_up_journal)
+{
+    ASSERT_EQ(ERR_OK, _standby->refresh());
+    _journaled->start_journal(_apps_root, _journal_root, _standby->latest_seq() + 1, 100);
+
+    std::string app_path = _apps_root + "/100";
+    ASSERT_EQ(ERR_OK, create(app_path, "app"));
+    ASSERT_EQ(ERR_OK, create(app_path + "/0", "p0"));
+    ASSERT_EQ(ERR_OK, create(app_path + "/1", "p1"));
+    // not journaled
+    ASSERT_EQ(ERR_OK, create(app_path + "/1/x", "x"));
+
+    ASSERT_EQ(ERR_OK, _standby->refresh());
+    ASSERT_EQ("app", snapshot_data(app_path));
+    ASSERT_EQ("p0", snapshot_data(app_path + "/0"));
+    ASSERT_EQ("p1", snapshot_data(app_path + "/1"));
+    ASSERT_EQ("-", snapshot_data(app_path + "/1/x"));
+    ASSERT_EQ(std::vector<std::string>({"0", "1"}), snapshot_children(app_path));
+
+    uint64_t seq = _standby->latest_seq();
+    ASSERT_EQ(ERR_OK, set(app_path + "/1", "p1-1"));
+    ASSERT_EQ(ERR_OK, _standby->refresh());
+    ASSERT_EQ(seq + 1, _standby->latest_seq());
+    ASSERT_EQ("p1-1", snapshot_data(app_path + "/1"));
+
+    ASSERT_EQ(ERR_OK, remove(app_path));
+    ASSERT_EQ(ERR_OK, _standby->refresh());
+    ASSERT_EQ("-", snapshot_data(app_path));
+    ASSERT_EQ("-", snapshot_data(app_path + "/0"));
+    auto apps = snapshot_children(_apps_root);
+    ASSERT_EQ(apps.end(), std::find(apps.begin(), apps.end(), "100"));
+}
+
+TEST_F(warm_standby_test, reload_if_journal_truncated)
+{
+    ASSERT_EQ(ERR_OK, _standby->refresh());
+    _journaled->start_journal(_apps_root, _journal_root, _standby->latest_seq() + 1, 2);
+
+    std::string app_path = _apps_root + "/101";
+    ASSERT_EQ(ERR_OK, create(app_path, "app"));
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(ERR_OK, create(app_path + "/" + std::to_string(i), std::to_string(i)));
+    }
+
+    // the entries since last refresh are removed, so all the apps are reloaded
+    ASSERT_EQ(ERR_OK, _standby->refresh());
+    ASSERT_EQ("app", snapshot_data(app_path));
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(std::to_string(i), snapshot_data(app_path + "/" + std::to_string(i)));
+    }
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,75 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include "dist/replication/lib/adaptive_2pc_window.h"
+
+namespace dsn {
+namespace replication {
+
+TEST(adaptive_2pc_window_test, follow_latency)
+{
+    adaptive_2pc_window w(10);
+    ASSERT_EQ(10, w.window());
+
+    // flat latency keeps the window
+    for (int i = 0; i < 100; i++) {
+        w.on_committed(1000, true);
+    }
+    ASSERT_EQ(10, w.window());
+
+    // shrinks by 1/4 for each window of commits while the secondaries lag
+    w.on_committed(10000, true);
+    w.on_committed(10000, true);
+    ASSERT_EQ(7, w.window());
+    for (int i = 0; i < 5; i++) {
+        w.on_committed(10000, true);
+    }
+    ASSERT_EQ(7, w.window());
+    w.on_committed(10000, true);
+    ASSERT_EQ(5, w.window());
+    for (int i = 0; i < 100; i++) {
+        w.on_committed(10000, true);
+    }
+    ASSERT_EQ(1, w.window());
+
+    // doesn't grow unless the window is full
+    for (int i = 0; i < 100; i++) {
+        w.on_committed(1000, false);
+    }
+    ASSERT_EQ(1, w.window());
+
+    // grows by one for each window of commits while the latency is flat again
+    w.on_committed(1000, true);
+    ASSERT_EQ(2, w.window());
+    w.on_committed(1000, true);
+    ASSERT_EQ(2, w.window());
+    w.on_committed(1000, true);
+    ASSERT_EQ(3, w.window());
+    for (int i = 0; i < 100; i++) {
+        w.on_committed(1000, true);
+    }
+    ASSERT_EQ(10, w.window());
+}
+
+TEST(adaptive_2pc_window_test, secondary_busy)
+{
+    adaptive_2pc_window w(16);
+    w.on_secondary_busy();
+    ASSERT_EQ(8, w.window());
+    // the other prepares in flight are retried as well
+    w.on_secondary_busy();
+    w.on_secondary_busy();
+    ASSERT_EQ(8, w.window());
+
+    for (int i = 0; i < 8; i++) {
+        w.on_committed(1000, false);
+    }
+    w.on_secondary_busy();
+    ASSERT_EQ(4, w.window());
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,69 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+
+#include <dsn/perf_counter/perf_counters.h>
+#include <dsn/tool-api/task.h>
+
+#include "dist/replication/lib/app_counters.h"
+
+namespace dsn {
+namespace replication {
+
+static perf_counter_ptr get_app_counter(app_counter_type type, int32_t app_id)
+{
+    std::string full_name;
+    std::string name = fmt::format("{}@{}", app_counters::name_of(type), app_id);
+    perf_counter::build_full_name(
+        task::get_current_node_name(), "eon.app", name.c_str(), full_name);
+    return perf_counters::instance().get_counter(full_name);
+}
+
+TEST(app_counters_test, aggregate)
+{
+    app_counters counters;
+    app_counter_shard s1, s2, s3;
+    counters.attach(gpid(101, 0), &s1);
+    counters.attach(gpid(101, 1), &s2);
+    counters.attach(gpid(102, 0), &s3);
+
+    perf_counter_ptr delay = get_app_counter(APP_COUNTER_WRITE_THROTTLING_DELAY_COUNT, 101);
+    perf_counter_ptr log_size = get_app_counter(APP_COUNTER_PRIVATE_LOG_SIZE_MB, 101);
+    ASSERT_NE(nullptr, delay);
+    ASSERT_NE(nullptr, log_size);
+    ASSERT_EQ(COUNTER_TYPE_VOLATILE_NUMBER, delay->type());
+    ASSERT_EQ(COUNTER_TYPE_NUMBER, log_size->type());
+
+    s1.increment(APP_COUNTER_WRITE_THROTTLING_DELAY_COUNT);
+    s2.increment(APP_COUNTER_WRITE_THROTTLING_DELAY_COUNT);
+    s2.increment(APP_COUNTER_WRITE_THROTTLING_DELAY_COUNT);
+    s3.increment(APP_COUNTER_WRITE_THROTTLING_DELAY_COUNT);
+    s1.set(APP_COUNTER_PRIVATE_LOG_SIZE_MB, 10);
+    s2.set(APP_COUNTER_PRIVATE_LOG_SIZE_MB, 20);
+    ASSERT_EQ(3, delay->get_integer_value());
+    ASSERT_EQ(0, delay->get_integer_value());
+    ASSERT_EQ(30, log_size->get_integer_value());
+
+    // the counts of a detached replica are kept, while its gauges are not
+    s2.increment(APP_COUNTER_WRITE_THROTTLING_DELAY_COUNT);
+    counters.detach(gpid(101, 1), &s2);
+    ASSERT_EQ(1, delay->get_integer_value());
+    ASSERT_EQ(10, log_size->get_integer_value());
+
+    // the values of each replica are available on demand
+    std::string json = counters.to_json(101);
+    ASSERT_NE(std::string::npos, json.find("101.0"));
+    ASSERT_EQ(std::string::npos, json.find("101.1"));
+    ASSERT_EQ(std::string::npos, json.find("102.0"));
+
+    // the counters are removed with the last replica of the app
+    counters.detach(gpid(101, 0), &s1);
+    ASSERT_EQ(nullptr, get_app_counter(APP_COUNTER_WRITE_THROTTLING_DELAY_COUNT, 101));
+    ASSERT_NE(nullptr, get_app_counter(APP_COUNTER_WRITE_THROTTLING_DELAY_COUNT, 102));
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,69 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include <dsn/tool-api/gpid.h>
+
+#include "dist/replication/lib/app_pool_router.h"
+
+namespace dsn {
+namespace replication {
+
+TEST(app_pool_router_test, parse_groups)
+{
+    std::map<std::string, uint32_t> groups;
+    ASSERT_TRUE(app_pool_router::parse_groups("heavy:1,critical:2", groups));
+    std::map<std::string, uint32_t> expected = {{"heavy", 1}, {"critical", 2}, {"default", 1}};
+    ASSERT_EQ(expected, groups);
+
+    ASSERT_TRUE(app_pool_router::parse_groups("default:4,heavy:1", groups));
+    ASSERT_EQ(4, groups["default"]);
+
+    ASSERT_FALSE(app_pool_router::parse_groups("", groups));
+    ASSERT_FALSE(app_pool_router::parse_groups("heavy", groups));
+    ASSERT_FALSE(app_pool_router::parse_groups("heavy:0", groups));
+    ASSERT_FALSE(app_pool_router::parse_groups("heavy:1,heavy:2", groups));
+}
+
+TEST(app_pool_router_test, route)
+{
+    std::map<std::string, uint32_t> groups;
+    ASSERT_TRUE(app_pool_router::parse_groups("default:2,heavy:1,critical:1", groups));
+    app_pool_router router(groups, {{2, "heavy"}, {3, "critical"}, {4, "not_exist"}});
+    router.init(8);
+
+    // the queues are divided by the weights and sorted by the group names
+    ASSERT_EQ(std::make_pair(0u, 2u), router.queue_range("critical"));
+    ASSERT_EQ(std::make_pair(2u, 6u), router.queue_range("default"));
+    ASSERT_EQ(std::make_pair(6u, 8u), router.queue_range("heavy"));
+
+    for (int32_t pidx = 0; pidx < 16; ++pidx) {
+        unsigned int heavy = router.route(gpid(2, pidx).thread_hash());
+        ASSERT_TRUE(heavy >= 6 && heavy < 8);
+        unsigned int critical = router.route(gpid(3, pidx).thread_hash());
+        ASSERT_TRUE(critical < 2);
+        for (int32_t app_id : {1, 4, 100}) {
+            unsigned int others = router.route(gpid(app_id, pidx).thread_hash());
+            ASSERT_TRUE(others >= 2 && others < 6);
+        }
+        // a hash is always routed to the same queue
+        ASSERT_EQ(heavy, router.route(gpid(2, pidx).thread_hash()));
+    }
+    unsigned int q = router.route(-1);
+    ASSERT_TRUE(q >= 2 && q < 6);
+}
+
+TEST(app_pool_router_test, not_enough_queues)
+{
+    std::map<std::string, uint32_t> groups;
+    ASSERT_TRUE(app_pool_router::parse_groups("a:1,b:1,c:1", groups));
+    app_pool_router router(groups, {{1, "a"}});
+    router.init(2);
+    ASSERT_EQ(std::make_pair(0u, 2u), router.queue_range("a"));
+    ASSERT_EQ(std::make_pair(0u, 2u), router.queue_range("default"));
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,74 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include <dsn/cpp/serialization.h>
+#include <dsn/dist/replication/client_batch.h>
+#include <dsn/dist/replication/replication.codes.h>
+
+namespace dsn {
+namespace replication {
+
+TEST(client_batch_test, requests_round_trip)
+{
+    std::vector<message_ptr> holders;
+    std::vector<message_ex *> requests;
+    for (int i = 0; i < 3; ++i) {
+        message_ex *request = message_ex::create_request(RPC_DETECT_HOTKEY, 1000, 0, 100 + i);
+        marshall(request, std::string("value") + std::to_string(i));
+        holders.emplace_back(request);
+        requests.push_back(request);
+    }
+
+    message_ptr msg = message_ex::create_request(RPC_CLIENT_BATCH);
+    write_client_batch(msg.get(), requests);
+    message_ptr recv_msg = msg->copy(true, true);
+
+    std::vector<message_ex *> received;
+    read_client_batch(recv_msg.get(), received);
+    ASSERT_EQ(received.size(), requests.size());
+    for (int i = 0; i < (int)requests.size(); ++i) {
+        message_ptr request(received[i]);
+        ASSERT_STREQ(request->header->rpc_name, RPC_DETECT_HOTKEY.to_string());
+        ASSERT_EQ(request->header->client.partition_hash, static_cast<uint64_t>(100 + i));
+        ASSERT_EQ(request->header->client.timeout_ms, 1000);
+        ASSERT_EQ(request->header->id, requests[i]->header->id);
+
+        std::string value;
+        unmarshall(request.get(), value);
+        ASSERT_EQ(value, std::string("value") + std::to_string(i));
+    }
+}
+
+TEST(client_batch_test, results_round_trip)
+{
+    message_ptr request = message_ex::create_request(RPC_DETECT_HOTKEY);
+    message_ptr reply = request->create_response();
+    marshall(reply.get(), std::string("reply"));
+
+    std::vector<client_batch_result> results(2);
+    results[0].err = ERR_OK;
+    results[0].reply = reply;
+    results[1].err = ERR_TIMEOUT;
+
+    message_ptr msg = message_ex::create_request(RPC_CLIENT_BATCH);
+    write_client_batch(msg.get(), results);
+    message_ptr recv_msg = msg->copy(true, true);
+
+    std::vector<client_batch_result> received;
+    read_client_batch(recv_msg.get(), received);
+    ASSERT_EQ(received.size(), 2);
+    ASSERT_EQ(received[0].err, ERR_OK);
+    ASSERT_NE(received[0].reply.get(), nullptr);
+    ASSERT_EQ(received[0].reply->header->id, request->header->id);
+    std::string value;
+    unmarshall(received[0].reply.get(), value);
+    ASSERT_EQ(value, "reply");
+    ASSERT_EQ(received[1].err, ERR_TIMEOUT);
+    ASSERT_EQ(received[1].reply.get(), nullptr);
+}
+
+} // namespace replication
+} // namespace dsn
@@ -414,3 +414,119 @@ void replication_service_test_app::write_current_chkpt_file_test()
     ASSERT_TRUE(backup_metadata_file->get_count() == 1);
     ASSERT_TRUE(regular_file->get_count() == 1);
 }
+
+void replication_service_test_app::fetch_upload_files_test()
+{
+    cold_backup_context_ptr backup_context = new cold_backup_context(nullptr, request, 2);
+
+    // 3 large files and 10 small ones
+    std::map<std::string, int64_t> files = {
+        {"large1", 10 << 20}, {"large2", 20 << 20}, {"large3", 5 << 20}};
+    for (int i = 0; i < 10; i++) {
+        files.emplace("small" + std::to_string(i), 1024);
+    }
+    for (const auto &kv : files) {
+        backup_context->_file_status.emplace(
+            kv.first, cold_backup_context::file_status::FileUploadUncomplete);
+        backup_context->_file_infos.emplace(kv.first, std::make_pair(kv.second, std::string()));
+    }
+    backup_context->_file_remain_cnt = static_cast<int32_t>(files.size());
+
+    // the larger files first, each of which takes a slot
+    std::vector<std::string> fetched;
+    ASSERT_FALSE(backup_context->upload_complete_or_fetch_uncomplete_files(fetched));
+    ASSERT_EQ(std::vector<std::string>({"large2", "large1"}), fetched);
+    fetched.clear();
+    ASSERT_FALSE(backup_context->upload_complete_or_fetch_uncomplete_files(fetched));
+    ASSERT_TRUE(fetched.empty());
+
+    backup_context->file_upload_complete("large2");
+    ASSERT_FALSE(backup_context->upload_complete_or_fetch_uncomplete_files(fetched));
+    ASSERT_EQ(std::vector<std::string>({"large3"}), fetched);
+    fetched.clear();
+
+    // the small files share a slot
+    backup_context->file_upload_complete("large1");
+    ASSERT_FALSE(backup_context->upload_complete_or_fetch_uncomplete_files(fetched));
+    ASSERT_EQ(8u, fetched.size());
+    backup_context->file_upload_uncomplete(fetched[0]);
+    backup_context->file_upload_complete("large3");
+    fetched.clear();
+    ASSERT_FALSE(backup_context->upload_complete_or_fetch_uncomplete_files(fetched));
+    ASSERT_EQ(3u, fetched.size());
+
+    for (const auto &kv : files) {
+        if (kv.first.find("small") == 0) {
+            backup_context->file_upload_complete(kv.first);
+        }
+    }
+    fetched.clear();
+    ASSERT_TRUE(backup_context->upload_complete_or_fetch_uncomplete_files(fetched));
+    ASSERT_TRUE(fetched.empty());
+}
+
+TEST(cold_backup_context, incremental_backup_manifest)
+{
+    file_meta f1;
+    f1.name = "f1";
+    f1.size = 10;
+    f1.md5 = "md5_1";
+    file_meta f2;
+    f2.name = "f2";
+    f2.size = 20;
+    f2.md5 = "md5_2";
+
+    // the first backup uploads all the files
+    cold_backup_metadata metadata;
+    metadata.files = {f1, f2};
+    incremental_backup_manifest manifest;
+    manifest = manifest.next(1, "dir1", metadata, 2);
+    ASSERT_EQ(std::vector<int64_t>({1}), manifest.backup_ids);
+    ASSERT_EQ(2u, manifest.files.size());
+    ASSERT_EQ(1, manifest.files["f1"].backup_id);
+    ASSERT_EQ("dir1", manifest.files["f1"].remote_dir);
+
+    incremental_backup_file file;
+    ASSERT_TRUE(manifest.find_reusable_file(f1, 2, file));
+    ASSERT_EQ("dir1", file.remote_dir);
+    // uploaded by the same backup
+    ASSERT_FALSE(manifest.find_reusable_file(f1, 1, file));
+    // changed file
+    file_meta changed = f2;
+    changed.md5 = "md5_2_changed";
+    ASSERT_FALSE(manifest.find_reusable_file(changed, 2, file));
+
+    // the second backup reuses f1 and uploads the changed f2
+    metadata.files = {f1, changed};
+    metadata.reused_files = {{"f1", "dir1"}};
+    manifest = manifest.next(2, "dir2", metadata, 2);
+    ASSERT_EQ(std::vector<int64_t>({1, 2}), manifest.backup_ids);
+    ASSERT_EQ(1, manifest.files["f1"].backup_id);
+    ASSERT_EQ("dir1", manifest.files["f1"].remote_dir);
+    ASSERT_EQ(2, manifest.files["f2"].backup_id);
+    ASSERT_EQ("dir2", manifest.files["f2"].remote_dir);
+
+    // retry the second backup
+    ASSERT_EQ(std::vector<int64_t>({1, 2}), manifest.next(2, "dir2", metadata, 2).backup_ids);
+
+    // the third backup reuses both, then f1 is out of the chain
+    metadata.reused_files = {{"f1", "dir1"}, {"f2", "dir2"}};
+    manifest = manifest.next(3, "dir3", metadata, 2);
+    ASSERT_EQ(std::vector<int64_t>({2, 3}), manifest.backup_ids);
+    ASSERT_FALSE(manifest.find_reusable_file(f1, 4, file));
+    ASSERT_TRUE(manifest.find_reusable_file(changed, 4, file));
+    ASSERT_EQ("dir2", file.remote_dir);
+
+    blob value = ::json::json_forwarder<incremental_backup_manifest>::encode(manifest);
+    incremental_backup_manifest decoded;
+    ASSERT_TRUE(::json::json_forwarder<incremental_backup_manifest>::decode(value, decoded));
+    ASSERT_EQ(manifest.backup_ids, decoded.backup_ids);
+    ASSERT_EQ(manifest.files.size(), decoded.files.size());
+    // the backup_metadata written before incremental backup can still be decoded
+    std::string old_metadata = "{\"checkpoint_decree\":1,\"checkpoint_timestamp\":2,\"files\":[],"
+                               "\"checkpoint_total_size\":0}";
+    cold_backup_metadata decoded_metadata;
+    ASSERT_TRUE(::json::json_forwarder<cold_backup_metadata>::decode(
+        blob::create_from_bytes(std::move(old_metadata)), decoded_metadata));
+    ASSERT_TRUE(decoded_metadata.reused_files.empty());
+}
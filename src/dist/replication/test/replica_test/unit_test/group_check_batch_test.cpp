@@ -0,0 +1,66 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include <dsn/dist/replication/replication.codes.h>
+
+#include "common/replication_common.h"
+
+namespace dsn {
+namespace replication {
+
+TEST(group_check_batch_test, requests_round_trip)
+{
+    std::vector<group_check_request> requests(3);
+    for (int i = 0; i < (int)requests.size(); ++i) {
+        requests[i].app.app_id = 2;
+        requests[i].node = rpc_address("127.0.0.1", 34801);
+        requests[i].config.pid = gpid(2, i);
+        requests[i].config.ballot = i + 1;
+        requests[i].config.status = partition_status::PS_SECONDARY;
+        requests[i].last_committed_decree = 100 + i;
+    }
+
+    message_ptr msg = dsn::message_ex::create_request(RPC_GROUP_CHECK_BATCH);
+    write_group_check_batch(msg.get(), requests);
+    message_ptr recv_msg = msg->copy(true, true);
+
+    std::vector<group_check_request> received;
+    read_group_check_batch(recv_msg.get(), received);
+    ASSERT_EQ(received.size(), requests.size());
+    for (int i = 0; i < (int)requests.size(); ++i) {
+        ASSERT_EQ(received[i].node, requests[i].node);
+        ASSERT_EQ(received[i].config.pid, requests[i].config.pid);
+        ASSERT_EQ(received[i].config.ballot, requests[i].config.ballot);
+        ASSERT_EQ(received[i].config.status, requests[i].config.status);
+        ASSERT_EQ(received[i].last_committed_decree, requests[i].last_committed_decree);
+    }
+}
+
+TEST(group_check_batch_test, responses_round_trip)
+{
+    std::vector<group_check_response> responses(2);
+    responses[0].pid = gpid(2, 0);
+    responses[0].err = ERR_OK;
+    responses[0].last_committed_decree_in_app = 10;
+    responses[1].pid = gpid(2, 1);
+    responses[1].err = ERR_OBJECT_NOT_FOUND;
+
+    message_ptr msg = dsn::message_ex::create_request(RPC_GROUP_CHECK_BATCH);
+    write_group_check_batch(msg.get(), responses);
+    message_ptr recv_msg = msg->copy(true, true);
+
+    std::vector<group_check_response> received;
+    read_group_check_batch(recv_msg.get(), received);
+    ASSERT_EQ(received.size(), 2);
+    ASSERT_EQ(received[0].pid, gpid(2, 0));
+    ASSERT_EQ(received[0].err, ERR_OK);
+    ASSERT_EQ(received[0].last_committed_decree_in_app, 10);
+    ASSERT_EQ(received[1].pid, gpid(2, 1));
+    ASSERT_EQ(received[1].err, ERR_OBJECT_NOT_FOUND);
+}
+
+} // namespace replication
+} // namespace dsn
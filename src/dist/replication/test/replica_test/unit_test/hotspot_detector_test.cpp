@@ -0,0 +1,69 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include "dist/replication/lib/hotspot_detector.h"
+
+namespace dsn {
+namespace replication {
+
+TEST(hotspot_detector_test, find_hot_keys)
+{
+    hotspot_detector detector(1);
+    for (uint64_t i = 0; i < 10000; ++i) {
+        detector.record(i, 10, i % 2 == 0);
+        if (i % 10 == 0) {
+            detector.record(12345678, 10, false);
+        }
+        if (i % 20 == 0) {
+            detector.record(87654321, 10, true);
+        }
+    }
+
+    partition_hotspot hotspot = detector.collect(gpid(1, 2), 2);
+    ASSERT_EQ(gpid(1, 2), hotspot.pid);
+    ASSERT_EQ(std::vector<int64_t>({12345678, 87654321}), hotspot.hot_key_hashes);
+    ASSERT_EQ(2, hotspot.hot_key_qps.size());
+    ASSERT_GE(hotspot.hot_key_qps[0], hotspot.hot_key_qps[1]);
+
+    // the counts are reset after collected
+    hotspot = detector.collect(gpid(1, 2), 2);
+    ASSERT_EQ(0, hotspot.read_qps);
+    ASSERT_EQ(0, hotspot.write_qps);
+    ASSERT_EQ(0, hotspot.bytes_per_sec);
+    ASSERT_TRUE(hotspot.hot_key_hashes.empty());
+}
+
+TEST(hotspot_detector_test, no_key_sampled)
+{
+    hotspot_detector detector(0);
+    for (uint64_t i = 0; i < 1000; ++i) {
+        detector.record(1, 10, false);
+    }
+    ASSERT_TRUE(detector.collect(gpid(1, 0), 3).hot_key_hashes.empty());
+}
+
+TEST(hotspot_detector_test, pick_hot_partitions)
+{
+    std::vector<partition_hotspot> loads(4);
+    for (int i = 0; i < 4; ++i) {
+        loads[i].pid = gpid(1, i);
+        loads[i].read_qps = i * 100;
+        loads[i].write_qps = 10;
+    }
+
+    auto hot = pick_hot_partitions(std::vector<partition_hotspot>(loads), 2, 0);
+    ASSERT_EQ(2, hot.size());
+    ASSERT_EQ(gpid(1, 3), hot[0].pid);
+    ASSERT_EQ(gpid(1, 2), hot[1].pid);
+
+    hot = pick_hot_partitions(std::vector<partition_hotspot>(loads), 10, 200);
+    ASSERT_EQ(2, hot.size());
+
+    ASSERT_TRUE(pick_hot_partitions(std::move(loads), 10, 1000).empty());
+}
+
+} // namespace replication
+} // namespace dsn
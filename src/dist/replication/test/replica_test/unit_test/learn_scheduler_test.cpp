@@ -0,0 +1,76 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include "dist/replication/lib/learn_scheduler.h"
+
+namespace dsn {
+namespace replication {
+
+TEST(learn_scheduler_test, limit_total_and_per_disk)
+{
+    learn_scheduler scheduler(3, 1);
+
+    ASSERT_TRUE(scheduler.acquire(gpid(1, 0), "disk1", 2));
+    // taking the slot again changes nothing
+    ASSERT_TRUE(scheduler.acquire(gpid(1, 0), "disk1", 2));
+    // disk1 is busy
+    ASSERT_FALSE(scheduler.acquire(gpid(1, 1), "disk1", 2));
+    ASSERT_TRUE(scheduler.acquire(gpid(1, 2), "disk2", 2));
+    // the disk of a replica is unknown, which is only limited by the total count
+    ASSERT_TRUE(scheduler.acquire(gpid(1, 3), "", 2));
+    ASSERT_FALSE(scheduler.acquire(gpid(1, 4), "", 2));
+    ASSERT_EQ(3, scheduler.running_count());
+    ASSERT_EQ(2, scheduler.queued_count());
+    ASSERT_TRUE(scheduler.is_running(gpid(1, 0)));
+    ASSERT_TRUE(scheduler.is_queued(gpid(1, 1)));
+
+    // the queued learner on disk1 is started first
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 1)}), scheduler.release(gpid(1, 0)));
+    // disk1 is still busy, so the learner without disk is started
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 4)}), scheduler.release(gpid(1, 2)));
+    ASSERT_EQ(0, scheduler.queued_count());
+
+    // releasing an unknown learner changes nothing
+    ASSERT_TRUE(scheduler.release(gpid(2, 0)).empty());
+    ASSERT_EQ(3, scheduler.running_count());
+}
+
+TEST(learn_scheduler_test, less_replicas_first)
+{
+    learn_scheduler scheduler(1, 0);
+
+    ASSERT_TRUE(scheduler.acquire(gpid(1, 0), "disk1", 3));
+    ASSERT_FALSE(scheduler.acquire(gpid(1, 1), "disk1", 3));
+    ASSERT_FALSE(scheduler.acquire(gpid(1, 2), "disk2", 2));
+    ASSERT_FALSE(scheduler.acquire(gpid(1, 3), "disk1", 1));
+    ASSERT_FALSE(scheduler.acquire(gpid(1, 4), "disk1", 2));
+    // requesting again keeps the place in the queue
+    ASSERT_FALSE(scheduler.acquire(gpid(1, 2), "disk2", 2));
+
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 3)}), scheduler.release(gpid(1, 0)));
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 2)}), scheduler.release(gpid(1, 3)));
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 4)}), scheduler.release(gpid(1, 2)));
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 1)}), scheduler.release(gpid(1, 4)));
+    ASSERT_TRUE(scheduler.release(gpid(1, 1)).empty());
+    ASSERT_EQ(0, scheduler.running_count());
+}
+
+TEST(learn_scheduler_test, cancel_queued)
+{
+    learn_scheduler scheduler(1, 0);
+
+    ASSERT_TRUE(scheduler.acquire(gpid(1, 0), "disk1", 2));
+    ASSERT_FALSE(scheduler.acquire(gpid(1, 1), "disk1", 2));
+    ASSERT_FALSE(scheduler.acquire(gpid(1, 2), "disk1", 2));
+
+    // the queued request is removed by releasing it
+    ASSERT_TRUE(scheduler.release(gpid(1, 1)).empty());
+    ASSERT_FALSE(scheduler.is_queued(gpid(1, 1)));
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 2)}), scheduler.release(gpid(1, 0)));
+}
+
+} // namespace replication
+} // namespace dsn
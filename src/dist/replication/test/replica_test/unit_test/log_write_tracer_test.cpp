@@ -0,0 +1,65 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include <dsn/dist/replication/replication.codes.h>
+#include <dsn/utility/flags.h>
+
+#include "dist/replication/lib/log_write_tracer.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_uint32(log_slow_write_threshold_ms);
+
+TEST(log_write_tracer_test, log_type)
+{
+    ASSERT_STREQ("shared", log_write_tracer::log_type_of(LPC_WRITE_REPLICATION_LOG_SHARED));
+    ASSERT_STREQ("private", log_write_tracer::log_type_of(LPC_WRITE_REPLICATION_LOG_PRIVATE));
+    ASSERT_EQ(nullptr, log_write_tracer::log_type_of(LPC_WRITE_REPLICATION_LOG_COMMON));
+}
+
+TEST(log_write_tracer_test, slow_writes)
+{
+    uint32_t old_threshold_ms = FLAGS_log_slow_write_threshold_ms;
+    FLAGS_log_slow_write_threshold_ms = 10;
+    log_write_tracer &tracer = log_write_tracer::instance();
+    size_t old_count = tracer.recent_slow_writes().size();
+
+    log_write_trace fast;
+    fast.log_type = "private";
+    fast.io_us = 1000;
+    tracer.trace(std::move(fast));
+    ASSERT_EQ(old_count, tracer.recent_slow_writes().size());
+
+    log_write_trace slow;
+    slow.log_type = "shared";
+    slow.file = "log.1.0";
+    slow.offset = 4096;
+    slow.size = 1024;
+    slow.mutation_count = 3;
+    slow.pending_us = 2000;
+    slow.queue_us = 3000;
+    slow.io_us = 4000;
+    slow.dispatch_us = 5000;
+    tracer.trace(std::move(slow));
+
+    std::vector<log_write_trace> slow_writes = tracer.recent_slow_writes();
+    ASSERT_EQ(std::min<size_t>(old_count + 1, 64), slow_writes.size());
+    const log_write_trace &t = slow_writes.back();
+    ASSERT_EQ("shared", t.log_type);
+    ASSERT_EQ(4096, t.offset);
+    ASSERT_EQ(3u, t.mutation_count);
+    ASSERT_EQ(14000u, t.total_us());
+
+    std::string json = tracer.to_json();
+    ASSERT_NE(std::string::npos, json.find("slow_writes"));
+    ASSERT_NE(std::string::npos, json.find("\"dispatch_us\":5000"));
+
+    FLAGS_log_slow_write_threshold_ms = old_threshold_ms;
+}
+
+} // namespace replication
+} // namespace dsn
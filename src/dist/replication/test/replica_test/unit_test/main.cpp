@@ -28,6 +28,8 @@ TEST(cold_backup_context, write_metadata_file) { app->write_backup_metadata_test
 
 TEST(cold_backup_context, write_current_chkpt_file) { app->write_current_chkpt_file_test(); }
 
+TEST(cold_backup_context, fetch_upload_files) { app->fetch_upload_files_test(); }
+
 error_code replication_service_test_app::start(const std::vector<std::string> &args)
 {
     gtest_ret = RUN_ALL_TESTS();
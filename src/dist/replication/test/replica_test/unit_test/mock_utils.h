@@ -63,6 +63,15 @@ public:
     }
     int on_request(message_ex *request) override { return 0; }
     std::string query_compact_state() const { return ""; };
+    int on_batched_write_requests(int64_t decree,
+                                  uint64_t timestamp,
+                                  message_ex **requests,
+                                  int count) override
+    {
+        ++_batched_write_count;
+        return replication_app_base::on_batched_write_requests(decree, timestamp, requests, count);
+    }
+    bool support_batched_mutations() const override { return _support_batched_mutations; }
 
     // we mock the followings
     void update_app_envs(const std::map<std::string, std::string> &envs) override { _envs = envs; }
@@ -75,10 +84,15 @@ public:
     void set_ingestion_status(ingestion_status::type status) { _ingestion_status = status; }
     ingestion_status::type get_ingestion_status() override { return _ingestion_status; }
 
+    void set_support_batched_mutations(bool support) { _support_batched_mutations = support; }
+    int batched_write_count() const { return _batched_write_count; }
+
 private:
     std::map<std::string, std::string> _envs;
     decree _decree = 5;
     ingestion_status::type _ingestion_status;
+    bool _support_batched_mutations = false;
+    int _batched_write_count = 0;
 };
 
 class mock_replica : public replica
@@ -143,6 +157,10 @@ public:
     void prepare_list_commit_hard(decree d) { _prepare_list->commit(d, COMMIT_TO_DECREE_HARD); }
     decree get_app_last_committed_decree() { return _app->last_committed_decree(); }
     void set_app_last_committed_decree(decree d) { _app->_last_committed_decree = d; }
+    mock_replication_app_base *get_mock_app()
+    {
+        return static_cast<mock_replication_app_base *>(_app.get());
+    }
     void set_primary_partition_configuration(partition_configuration &pconfig)
     {
         _primary_states.membership = pconfig;
@@ -195,7 +213,11 @@ public:
 
     ~mock_replica_stub() override = default;
 
-    void add_replica(replica *r) { _replicas[r->get_gpid()] = replica_ptr(r); }
+    void add_replica(replica *r)
+    {
+        _replicas[r->get_gpid()] = replica_ptr(r);
+        update_replica_routes();
+    }
 
     mock_replica *add_primary_replica(int appid, int part_index = 1)
     {
@@ -237,6 +259,7 @@ public:
         mock_replica_ptr rep = new mock_replica(this, pid, std::move(info), "./");
         rep->set_replica_config(config);
         _replicas[pid] = rep;
+        update_replica_routes();
 
         return rep;
     }
@@ -0,0 +1,123 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "dist/replication/lib/mutation_cache.h"
+
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace dsn {
+namespace replication {
+
+static mutation_ptr create_mutation(decree d)
+{
+    mutation_ptr mu(new mutation());
+    mu->data.header.ballot = 1;
+    mu->data.header.decree = d;
+    return mu;
+}
+
+TEST(mutation_cache_test, get_mutations_lock_free)
+{
+    mutation_cache cache(0, 10);
+    for (decree d = 1; d <= 5; d++) {
+        mutation_ptr mu = create_mutation(d);
+        ASSERT_EQ(ERR_OK, cache.put(mu));
+    }
+
+    std::vector<mutation_ptr> mutations;
+    ASSERT_EQ(5, cache.get_mutations_lock_free(1, 10, mutations));
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ(i + 1, mutations[i]->get_decree());
+    }
+
+    // stop at the first popped decree
+    cache.pop_min();
+    mutations.clear();
+    ASSERT_EQ(0, cache.get_mutations_lock_free(1, 5, mutations));
+    ASSERT_EQ(3, cache.get_mutations_lock_free(2, 4, mutations));
+
+    // no reader is active, so nothing is retired
+    ASSERT_EQ(0u, cache.retired_count());
+
+    cache.reset(100, true);
+    mutations.clear();
+    ASSERT_EQ(0, cache.get_mutations_lock_free(2, 5, mutations));
+    mutation_ptr mu = create_mutation(101);
+    ASSERT_EQ(ERR_OK, cache.put(mu));
+    ASSERT_EQ(1, cache.get_mutations_lock_free(101, 200, mutations));
+}
+
+TEST(mutation_cache_test, appro_data_bytes)
+{
+    int64_t old_alive_bytes = mutation::alive_bytes();
+    mutation_cache cache(0, 10);
+    int64_t bytes = 0;
+    for (decree d = 1; d <= 3; d++) {
+        mutation_ptr mu = create_mutation(d);
+        bytes += mu->appro_data_bytes();
+        ASSERT_EQ(ERR_OK, cache.put(mu));
+    }
+    ASSERT_EQ(bytes, cache.appro_data_bytes());
+    ASSERT_EQ(old_alive_bytes + bytes, mutation::alive_bytes());
+
+    mutation_ptr mu = cache.pop_min();
+    ASSERT_EQ(bytes - mu->appro_data_bytes(), cache.appro_data_bytes());
+    mu = nullptr;
+
+    cache.reset(100, true);
+    ASSERT_EQ(0, cache.appro_data_bytes());
+    ASSERT_EQ(old_alive_bytes, mutation::alive_bytes());
+}
+
+TEST(mutation_cache_test, concurrent_readers)
+{
+    const int capacity = 64;
+    const decree max_decree = 200000;
+    mutation_cache cache(0, capacity);
+    std::atomic<decree> last_decree(0);
+    std::atomic<bool> stop(false);
+
+    std::vector<std::thread> readers;
+    std::atomic<int64_t> read_count(0);
+    for (int i = 0; i < 4; i++) {
+        readers.emplace_back([&]() {
+            std::vector<mutation_ptr> mutations;
+            while (!stop.load()) {
+                decree end = last_decree.load();
+                decree start = std::max(end - capacity / 2, (decree)1);
+                mutations.clear();
+                int count = cache.get_mutations_lock_free(start, end, mutations);
+                for (int j = 0; j < count; j++) {
+                    ASSERT_EQ(start + j, mutations[j]->get_decree());
+                    ASSERT_EQ(1, mutations[j]->data.header.ballot);
+                }
+                read_count.fetch_add(count);
+            }
+        });
+    }
+
+    // the single writer keeps a sliding window of decrees like prepare_list does
+    for (decree d = 1; d <= max_decree; d++) {
+        if (cache.count() == capacity) {
+            cache.pop_min();
+        }
+        mutation_ptr mu = create_mutation(d);
+        ASSERT_EQ(ERR_OK, cache.put(mu));
+        last_decree.store(d);
+    }
+
+    stop.store(true);
+    for (auto &t : readers) {
+        t.join();
+    }
+    ASSERT_GT(read_count.load(), 0);
+
+    // all the retired mutations are released once no reader is active
+    cache.reset(max_decree, true);
+    ASSERT_EQ(0u, cache.retired_count());
+}
+
+} // namespace replication
+} // namespace dsn
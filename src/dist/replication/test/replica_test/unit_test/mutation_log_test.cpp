@@ -25,10 +25,14 @@
  */
 
 #include "dist/replication/lib/mutation_log.h"
+#include <dsn/dist/replication/mutation_log_tool.h>
 #include "dist/replication/test/replica_test/unit_test/replica_test_base.h"
 
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <gtest/gtest.h>
+#include <mutex>
+#include <sstream>
 
 using namespace ::dsn;
 using namespace ::dsn::replication;
@@ -265,6 +269,11 @@ TEST(replication, log_file)
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(log_shared_max_inflight_writes);
+DSN_DECLARE_uint32(log_shared_replay_thread_count);
+DSN_DECLARE_bool(mmap_log_file_read);
+DSN_DECLARE_bool(log_file_preallocate);
+
 class mutation_log_test : public replica_test_base
 {
 public:
@@ -327,6 +336,11 @@ public:
 
     mutation_log_ptr create_private_log() { return create_private_log(1); }
 
+    bool remove_log_file(mutation_log_ptr &mlog, const std::string &fpath)
+    {
+        return mlog->remove_log_file(fpath);
+    }
+
     mutation_log_ptr create_private_log(int private_log_size_mb, decree replay_start_decree = 0)
     {
         gpid id = get_gpid();
@@ -441,6 +455,106 @@ TEST_F(mutation_log_test, replay_single_file_1) { test_replay_single_file(1); }
 
 TEST_F(mutation_log_test, replay_single_file_10) { test_replay_single_file(10); }
 
+TEST_F(mutation_log_test, adaptive_flush_interval)
+{
+    // the budget left by the write latency, as the mutations arrive frequently
+    ASSERT_EQ(600u, mutation_log_private::get_adaptive_flush_interval_us(1000, 10, 200, 50));
+    // no budget left for the slow writes
+    ASSERT_EQ(0u, mutation_log_private::get_adaptive_flush_interval_us(1000, 10, 800, 100));
+    // the next mutation is not expected to arrive in the budget
+    ASSERT_EQ(0u, mutation_log_private::get_adaptive_flush_interval_us(1000, 700, 200, 50));
+}
+
+TEST_F(mutation_log_test, replay_with_mmap)
+{
+    FLAGS_mmap_log_file_read = true;
+    test_replay_single_file(1000);
+
+    // the blocks are readable after the file is closed
+    std::string log_file_path = _log_dir + "/log.1.0";
+    error_code ec;
+    log_file_ptr file = log_file::open_read(log_file_path.c_str(), ec);
+    ASSERT_EQ(ERR_OK, ec);
+    file->reset_stream();
+    blob first, second;
+    ASSERT_EQ(ERR_OK, file->read_next_log_block(first));
+    ASSERT_EQ(ERR_OK, file->read_next_log_block(second));
+    std::string content(second.data(), second.length());
+    file = nullptr;
+    ASSERT_EQ(content, std::string(second.data(), second.length()));
+
+    FLAGS_mmap_log_file_read = false;
+}
+
+TEST_F(mutation_log_test, replay_multiple_files_with_mmap)
+{
+    FLAGS_mmap_log_file_read = true;
+    test_replay_multiple_files(10000, 1);
+    FLAGS_mmap_log_file_read = false;
+}
+
+TEST_F(mutation_log_test, replay_preallocated_files)
+{
+    FLAGS_log_file_preallocate = true;
+    test_replay_multiple_files(10000, 1);
+
+    int64_t file_size = 0;
+    ASSERT_TRUE(utils::filesystem::file_size(_log_dir + "/log.1.0", file_size));
+    ASSERT_GE(file_size, 1024 * 1024);
+    FLAGS_log_file_preallocate = false;
+}
+
+TEST_F(mutation_log_test, recycle_log_file)
+{
+    FLAGS_log_file_preallocate = true;
+    std::string recycle_dir = _log_dir + "/recycle";
+    {
+        mutation_log_ptr mlog = create_private_log();
+        for (int i = 0; i < 1000; i++) {
+            mlog->append(create_test_mutation("hello!", 2 + i),
+                         LPC_AIO_IMMEDIATE_CALLBACK,
+                         nullptr,
+                         nullptr,
+                         0);
+        }
+        mlog->tracker()->wait_outstanding_tasks();
+        mlog->close();
+        ASSERT_TRUE(remove_log_file(mlog, _log_dir + "/log.1.0"));
+    }
+    ASSERT_TRUE(utils::filesystem::file_exists(recycle_dir + "/log.1.0"));
+    ASSERT_FALSE(utils::filesystem::file_exists(_log_dir + "/log.1.0"));
+
+    // the new log file is made of the recycled one, whose stale data is not replayed
+    {
+        mutation_log_ptr mlog = create_private_log();
+        for (int i = 0; i < 10; i++) {
+            mlog->append(create_test_mutation("world!", 2 + i),
+                         LPC_AIO_IMMEDIATE_CALLBACK,
+                         nullptr,
+                         nullptr,
+                         0);
+        }
+        mlog->tracker()->wait_outstanding_tasks();
+        mlog->close();
+        ASSERT_FALSE(utils::filesystem::file_exists(recycle_dir + "/log.1.0"));
+    }
+    {
+        mutation_log_ptr mlog =
+            new mutation_log_private(_log_dir, 1, get_gpid(), _replica.get(), 1024, 512, 10000);
+        int replayed = 0;
+        ASSERT_EQ(ERR_OK,
+                  mlog->open(
+                      [&replayed](int, mutation_ptr &mu) -> bool {
+                          ++replayed;
+                          return true;
+                      },
+                      nullptr));
+        ASSERT_EQ(10, replayed);
+        mlog->close();
+    }
+    FLAGS_log_file_preallocate = false;
+}
+
 // mutation_log::open
 TEST_F(mutation_log_test, open)
 {
@@ -495,5 +609,308 @@ TEST_F(mutation_log_test, replay_start_decree)
     ASSERT_EQ(mlog->get_log_file_map().size(), 3);
 }
 
+TEST_F(mutation_log_test, open_without_replay)
+{
+    mutation_log_tail tail;
+    {
+        mutation_log_ptr mlog = create_private_log();
+        for (int i = 1; i <= 100; i++) {
+            mlog->append(
+                create_test_mutation("hello!", i), LPC_AIO_IMMEDIATE_CALLBACK, nullptr, nullptr, 0);
+        }
+        mlog->tracker()->wait_outstanding_tasks();
+        mlog->close(tail);
+    }
+    ASSERT_EQ(100, tail.max_decree);
+    ASSERT_EQ(99, tail.max_commit_on_disk);
+
+    {
+        mutation_log_ptr mlog =
+            new mutation_log_private(_log_dir, 1, get_gpid(), _replica.get(), 1024, 512, 10000);
+        ASSERT_EQ(ERR_OK, mlog->open_without_replay(tail, nullptr));
+        ASSERT_EQ(100, mlog->max_decree(get_gpid()));
+        ASSERT_EQ(99, mlog->max_commit_on_disk());
+        ASSERT_EQ(tail.end_offset, mlog->end_offset());
+
+        // the new mutations are appended after the tail
+        mlog->append(
+            create_test_mutation("hello!", 101), LPC_AIO_IMMEDIATE_CALLBACK, nullptr, nullptr, 0);
+        mlog->tracker()->wait_outstanding_tasks();
+        mlog->close();
+    }
+
+    // the log is changed since the tail is recorded
+    {
+        mutation_log_ptr mlog =
+            new mutation_log_private(_log_dir, 1, get_gpid(), _replica.get(), 1024, 512, 10000);
+        ASSERT_EQ(ERR_INCOMPLETE_DATA, mlog->open_without_replay(tail, nullptr));
+
+        decree max_replayed = 0;
+        ASSERT_EQ(ERR_OK,
+                  mlog->open(
+                      [&max_replayed](int, mutation_ptr &mu) -> bool {
+                          max_replayed = mu->data.header.decree;
+                          return true;
+                      },
+                      nullptr));
+        ASSERT_EQ(101, max_replayed);
+        mlog->close();
+    }
+}
+
+TEST_F(mutation_log_test, shared_log_group_commit)
+{
+    uint32_t old_max_inflight_writes = FLAGS_log_shared_max_inflight_writes;
+    FLAGS_log_shared_max_inflight_writes = 4;
+
+    std::string dir = _log_dir + "/shared";
+    std::vector<mutation_ptr> mutations;
+    std::atomic<int> succeed_count(0);
+    { // writing logs
+        mutation_log_ptr mlog = new mutation_log_shared(dir, 1, false);
+        ASSERT_EQ(ERR_OK, mlog->open(nullptr, nullptr));
+        mlog->set_valid_start_offset_on_open(get_gpid(), 0);
+
+        for (int i = 0; i < 10000; i++) {
+            mutation_ptr mu = create_test_mutation("hello!", 2 + i);
+            mutations.push_back(mu);
+            mlog->append(mu,
+                         LPC_AIO_IMMEDIATE_CALLBACK,
+                         mlog->tracker(),
+                         [&succeed_count](error_code err, size_t) {
+                             if (err == ERR_OK) {
+                                 succeed_count++;
+                             }
+                         },
+                         0);
+        }
+        mlog->flush();
+        mlog->tracker()->wait_outstanding_tasks();
+        mlog->close();
+    }
+    FLAGS_log_shared_max_inflight_writes = old_max_inflight_writes;
+    ASSERT_EQ((int)mutations.size(), succeed_count.load());
+
+    { // reading logs, the mutations must be written in order without holes
+        std::vector<std::string> log_files;
+        ASSERT_TRUE(utils::filesystem::get_subfiles(dir, log_files, false));
+
+        int64_t end_offset;
+        int mutation_index = -1;
+        mutation_log::replay(
+            log_files,
+            [&mutations, &mutation_index](int log_length, mutation_ptr &mu) -> bool {
+                mutation_ptr wmu = mutations[++mutation_index];
+                EXPECT_EQ(wmu->data.header.decree, mu->data.header.decree);
+                ASSERT_BLOB_EQ(wmu->data.updates[0].data, mu->data.updates[0].data);
+                return true;
+            },
+            end_offset);
+        ASSERT_EQ(mutation_index + 1, (int)mutations.size());
+    }
+}
+
+TEST_F(mutation_log_test, shared_log_gc)
+{
+    std::string dir = _log_dir + "/shared";
+    gpid p0(1, 0), p1(1, 1);
+    mutation_log_ptr mlog = new mutation_log_shared(dir, 1, false);
+    ASSERT_EQ(ERR_OK, mlog->open(nullptr, nullptr));
+    mlog->set_valid_start_offset_on_open(p0, 0);
+    mlog->set_valid_start_offset_on_open(p1, 0);
+    decree max_decree = 0;
+    for (int i = 0; i < 20000; i++) {
+        mutation_ptr mu = create_test_mutation("hello!", 2 + i / 2);
+        mu->data.header.pid = (i % 2 == 0) ? p0 : p1;
+        max_decree = mu->get_decree();
+        mlog->append(mu, LPC_AIO_IMMEDIATE_CALLBACK, nullptr, nullptr, 0);
+    }
+    mlog->flush();
+    mlog->tracker()->wait_outstanding_tasks();
+    int file_count = static_cast<int>(mlog->get_log_file_map().size());
+    ASSERT_GT(file_count, 3);
+
+    // no replica has made its mutations durable
+    replica_log_info_map condition;
+    condition[p0] = replica_log_info(0, 0);
+    condition[p1] = replica_log_info(0, 0);
+    std::set<gpid> prevent_gc_replicas;
+    ASSERT_EQ(file_count, mlog->garbage_collection(condition, 2, prevent_gc_replicas));
+    ASSERT_EQ(std::set<gpid>({p0, p1}), prevent_gc_replicas);
+
+    // p1 still prevents, checked twice by the index
+    condition[p0] = replica_log_info(max_decree, 0);
+    for (int i = 0; i < 2; i++) {
+        prevent_gc_replicas.clear();
+        ASSERT_EQ(file_count, mlog->garbage_collection(condition, 2, prevent_gc_replicas));
+        ASSERT_EQ(std::set<gpid>({p1}), prevent_gc_replicas);
+    }
+
+    // all but the newest file are deleted
+    condition[p1] = replica_log_info(max_decree, 0);
+    prevent_gc_replicas.clear();
+    ASSERT_EQ(1, mlog->garbage_collection(condition, 2, prevent_gc_replicas));
+    ASSERT_TRUE(prevent_gc_replicas.empty());
+    ASSERT_EQ(1, mlog->get_log_file_map().size());
+    mlog->close();
+}
+
+TEST_F(mutation_log_test, replay_parallel)
+{
+    const int partition_count = 8;
+    const int mutation_count = 20000;
+    std::string dir = _log_dir + "/shared";
+    std::map<gpid, std::vector<decree>> expected;
+    { // writing logs of multiple partitions
+        mutation_log_ptr mlog = new mutation_log_shared(dir, 1, false);
+        ASSERT_EQ(ERR_OK, mlog->open(nullptr, nullptr));
+        for (int i = 0; i < partition_count; i++) {
+            mlog->set_valid_start_offset_on_open(gpid(1, i), 0);
+        }
+        for (int i = 0; i < mutation_count; i++) {
+            gpid pid(1, i % partition_count);
+            mutation_ptr mu = create_test_mutation("hello!", 2 + i / partition_count);
+            mu->data.header.pid = pid;
+            expected[pid].push_back(mu->get_decree());
+            mlog->append(mu, LPC_AIO_IMMEDIATE_CALLBACK, nullptr, nullptr, 0);
+        }
+        mlog->flush();
+        mlog->tracker()->wait_outstanding_tasks();
+        mlog->close();
+    }
+
+    std::vector<std::string> log_files;
+    ASSERT_TRUE(utils::filesystem::get_subfiles(dir, log_files, false));
+    ASSERT_GT(log_files.size(), 1);
+
+    int64_t serial_end_offset = 0;
+    ASSERT_EQ(ERR_OK,
+              mutation_log::replay(log_files,
+                                   [](int log_length, mutation_ptr &mu) -> bool { return true; },
+                                   serial_end_offset));
+
+    for (uint32_t thread_count : {2, 4, 7}) {
+        std::mutex lock;
+        std::map<gpid, std::vector<decree>> replayed;
+        int64_t end_offset = 0;
+        ASSERT_EQ(ERR_OK,
+                  mutation_log::replay(log_files,
+                                       [&lock, &replayed](int log_length, mutation_ptr &mu) {
+                                           std::lock_guard<std::mutex> l(lock);
+                                           replayed[mu->data.header.pid].push_back(
+                                               mu->get_decree());
+                                           return true;
+                                       },
+                                       end_offset,
+                                       thread_count));
+        // the mutations of each partition are replayed in log order
+        ASSERT_EQ(expected, replayed) << "thread_count = " << thread_count;
+        ASSERT_EQ(serial_end_offset, end_offset);
+    }
+
+    // replay the shared log on open
+    uint32_t old_replay_thread_count = FLAGS_log_shared_replay_thread_count;
+    FLAGS_log_shared_replay_thread_count = 4;
+    std::atomic<int> replayed_count(0);
+    mutation_log_ptr mlog = new mutation_log_shared(dir, 1, false);
+    for (auto &kv : expected) {
+        mlog->set_valid_start_offset_on_open(kv.first, 0);
+    }
+    ASSERT_EQ(ERR_OK,
+              mlog->open(
+                  [&replayed_count](int log_length, mutation_ptr &mu) -> bool {
+                      replayed_count++;
+                      return true;
+                  },
+                  nullptr));
+    FLAGS_log_shared_replay_thread_count = old_replay_thread_count;
+    ASSERT_EQ(mutation_count, replayed_count.load());
+    for (auto &kv : expected) {
+        ASSERT_EQ(kv.second.back(), mlog->max_decree(kv.first));
+    }
+    ASSERT_EQ(serial_end_offset, mlog->get_global_offset());
+    mlog->close();
+}
+
+TEST_F(mutation_log_test, scan_with_index)
+{
+    const int partition_count = 8;
+    const int mutation_count = 20000;
+    std::string dir = _log_dir + "/shared";
+    std::string index_dir = _log_dir + "/index";
+    {
+        mutation_log_ptr mlog = new mutation_log_shared(dir, 1, false);
+        ASSERT_EQ(ERR_OK, mlog->open(nullptr, nullptr));
+        for (int i = 0; i < partition_count; i++) {
+            mlog->set_valid_start_offset_on_open(gpid(1, i), 0);
+        }
+        for (int i = 0; i < mutation_count; i++) {
+            mutation_ptr mu = create_test_mutation("hello!", 2 + i / partition_count);
+            mu->data.header.pid = gpid(1, i % partition_count);
+            mu->set_timestamp(i * 1000);
+            mlog->append(mu, LPC_AIO_IMMEDIATE_CALLBACK, nullptr, nullptr, 0);
+        }
+        mlog->flush();
+        mlog->tracker()->wait_outstanding_tasks();
+        mlog->close();
+    }
+
+    // the mutations are output in log order however many threads are scanning
+    mutation_log_tool tool;
+    std::vector<decree> all_decrees;
+    for (uint32_t thread_count : {1, 4}) {
+        std::vector<decree> scanned;
+        std::ostringstream output;
+        ASSERT_TRUE(tool.scan(dir,
+                              "",
+                              mutation_log_filter(),
+                              thread_count,
+                              output,
+                              [&scanned](int64_t decree,
+                                         int64_t timestamp,
+                                         dsn::message_ex **requests,
+                                         int count) { scanned.push_back(decree); }));
+        ASSERT_EQ(mutation_count, scanned.size());
+        if (all_decrees.empty()) {
+            all_decrees = scanned;
+        }
+        ASSERT_EQ(all_decrees, scanned) << "thread_count = " << thread_count;
+    }
+
+    mutation_log_filter filter;
+    filter.app_id = 1;
+    filter.partition_index = 3;
+    filter.start_timestamp_us = 5000 * 1000;
+    filter.end_timestamp_us = 10000 * 1000;
+    std::vector<decree> expected;
+    for (int i = 5000; i < 10000; i++) {
+        if (i % partition_count == 3) {
+            expected.push_back(2 + i / partition_count);
+        }
+    }
+
+    // the index is built by the first scan, and used by the second one
+    for (int round = 0; round < 2; round++) {
+        std::vector<decree> scanned;
+        std::ostringstream output;
+        ASSERT_TRUE(tool.scan(dir,
+                              index_dir,
+                              filter,
+                              4,
+                              output,
+                              [&scanned](int64_t decree,
+                                         int64_t timestamp,
+                                         dsn::message_ex **requests,
+                                         int count) { scanned.push_back(decree); }));
+        ASSERT_EQ(expected, scanned) << "round = " << round;
+
+        std::vector<std::string> index_files;
+        ASSERT_TRUE(utils::filesystem::get_subfiles(index_dir, index_files, false));
+        std::vector<std::string> log_files;
+        ASSERT_TRUE(utils::filesystem::get_subfiles(dir, log_files, false));
+        ASSERT_EQ(log_files.size(), index_files.size());
+    }
+}
+
 } // namespace replication
 } // namespace dsn
@@ -0,0 +1,77 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "dist/replication/lib/mutation.h"
+
+#include <dsn/dist/replication/replication.codes.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+static prepare_batch_ack_ptr create_batch(decree start, int count)
+{
+    std::vector<decree> decrees;
+    for (int i = 0; i < count; ++i) {
+        decrees.push_back(start + i);
+    }
+    dsn::message_ex *request = dsn::message_ex::create_request(RPC_PREPARE_BATCH);
+    return prepare_batch_ack_ptr(new prepare_batch_ack(request, std::move(decrees)));
+}
+
+TEST(prepare_batch_ack_test, cumulative_ack)
+{
+    decree acked_decree;
+    error_code err;
+
+    // all acked with ERR_OK, in any order
+    prepare_batch_ack_ptr batch = create_batch(10, 3);
+    ASSERT_FALSE(batch->ack(2, ERR_OK));
+    ASSERT_FALSE(batch->ack(0, ERR_OK));
+    // duplicate acks are ignored
+    ASSERT_FALSE(batch->ack(0, ERR_INVALID_STATE));
+    ASSERT_TRUE(batch->ack(1, ERR_OK));
+    batch->get_result(acked_decree, err);
+    ASSERT_EQ(12, acked_decree);
+    ASSERT_EQ(ERR_OK, err);
+
+    // acked up to the first failed one
+    batch = create_batch(10, 4);
+    ASSERT_FALSE(batch->ack(0, ERR_OK));
+    ASSERT_FALSE(batch->ack(2, ERR_INVALID_STATE));
+    ASSERT_FALSE(batch->ack(3, ERR_OK));
+    ASSERT_TRUE(batch->ack(1, ERR_OK));
+    batch->get_result(acked_decree, err);
+    ASSERT_EQ(11, acked_decree);
+    ASSERT_EQ(ERR_INVALID_STATE, err);
+
+    // the first one is failed
+    batch = create_batch(10, 2);
+    ASSERT_FALSE(batch->ack(1, ERR_OK));
+    ASSERT_TRUE(batch->ack(0, ERR_INACTIVE_STATE));
+    batch->get_result(acked_decree, err);
+    ASSERT_EQ(invalid_decree, acked_decree);
+    ASSERT_EQ(ERR_INACTIVE_STATE, err);
+}
+
+TEST(prepare_batch_ack_test, mutation_in_batches)
+{
+    prepare_batch_ack_ptr batch1 = create_batch(1, 2);
+    prepare_batch_ack_ptr batch2 = create_batch(2, 1);
+
+    mutation_ptr mu(new mutation());
+    mu->data.header.decree = 2;
+    mu->add_prepare_batch(batch1, 1);
+    mu->add_prepare_batch(batch2, 0);
+    ASSERT_EQ(2u, mu->prepare_batches().size());
+    ASSERT_TRUE(mu->prepare_requests().empty());
+
+    // a mutation may be carried by multiple batches when duplicate prepares are combined
+    ASSERT_FALSE(mu->prepare_batches()[0].first->ack(mu->prepare_batches()[0].second, ERR_OK));
+    ASSERT_TRUE(mu->prepare_batches()[1].first->ack(mu->prepare_batches()[1].second, ERR_OK));
+    ASSERT_TRUE(batch1->ack(0, ERR_OK));
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,64 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "dist/replication/lib/prepare_list.h"
+#include "dist/replication/lib/mutation.h"
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+static mutation_ptr create_logged_mutation(decree d)
+{
+    mutation_ptr mu(new mutation());
+    mu->data.header.ballot = 1;
+    mu->data.header.decree = d;
+    mu->data.header.last_committed_decree = d - 1;
+    mu->set_logged();
+    return mu;
+}
+
+TEST(prepare_list_test, batch_commit)
+{
+    replica_base r(gpid(1, 1), "1.1", "test");
+    std::vector<decree> committed;
+    std::vector<std::vector<decree>> batches;
+    prepare_list plist(
+        &r, 0, 10, [&committed](mutation_ptr &mu) { committed.push_back(mu->get_decree()); });
+
+    // mutations are committed one by one without the batch committer
+    for (decree d = 1; d <= 3; d++) {
+        mutation_ptr mu = create_logged_mutation(d);
+        ASSERT_EQ(plist.prepare(mu, partition_status::PS_PRIMARY), ERR_OK);
+    }
+    plist.commit(2, COMMIT_TO_DECREE_HARD);
+    ASSERT_EQ(committed, std::vector<decree>({1, 2}));
+
+    // the mutations committable together are committed in one batch
+    plist.set_batch_committer([&batches](std::vector<mutation_ptr> &mutations) {
+        std::vector<decree> batch;
+        for (const mutation_ptr &mu : mutations) {
+            batch.push_back(mu->get_decree());
+        }
+        batches.push_back(batch);
+    });
+    for (decree d = 4; d <= 5; d++) {
+        mutation_ptr mu = create_logged_mutation(d);
+        ASSERT_EQ(plist.prepare(mu, partition_status::PS_PRIMARY), ERR_OK);
+    }
+    plist.commit(5, COMMIT_TO_DECREE_HARD);
+    ASSERT_EQ(batches, std::vector<std::vector<decree>>({{3, 4, 5}}));
+    ASSERT_EQ(plist.last_committed_decree(), 5);
+
+    // a single committable mutation still goes to the mutation committer
+    mutation_ptr mu = create_logged_mutation(6);
+    ASSERT_EQ(plist.prepare(mu, partition_status::PS_PRIMARY), ERR_OK);
+    plist.commit(6, COMMIT_TO_DECREE_HARD);
+    ASSERT_EQ(committed, std::vector<decree>({1, 2, 6}));
+    ASSERT_EQ(batches.size(), 1u);
+}
+
+} // namespace replication
+} // namespace dsn
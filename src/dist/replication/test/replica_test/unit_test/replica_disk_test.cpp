@@ -5,11 +5,15 @@
 #include <gtest/gtest.h>
 
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 #include "replica_test_base.h"
 
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_bool(disk_slow_detection_enabled);
+DSN_DECLARE_uint32(disk_slow_recover_rounds);
+
 class replica_disk_test : public replica_test_base
 {
 public:
@@ -39,6 +43,8 @@ public:
         return stub->_fs_manager._dir_nodes;
     }
 
+    int detect_slow_disks() { return stub->_fs_manager.detect_slow_disks(); }
+
 private:
     void generate_mock_app_info()
     {
@@ -172,5 +178,133 @@ TEST_F(replica_disk_test, on_query_disk_info_one_app)
     }
 }
 
+TEST_F(replica_disk_test, acquire_checkpoint_slot)
+{
+    stub->_options.max_concurrent_checkpoint_count_per_disk = 2;
+
+    std::shared_ptr<void> slot1 = stub->acquire_checkpoint_slot("full_dir_1/1.0.pegasus");
+    std::shared_ptr<void> slot2 = stub->acquire_checkpoint_slot("full_dir_1/1.1.pegasus");
+    ASSERT_NE(nullptr, slot1);
+    ASSERT_NE(nullptr, slot2);
+    ASSERT_EQ(nullptr, stub->acquire_checkpoint_slot("full_dir_1/1.2.pegasus"));
+
+    // the slots of the other disks are not affected
+    ASSERT_NE(nullptr, stub->acquire_checkpoint_slot("full_dir_2/1.2.pegasus"));
+
+    // the slot is returned when it's not referenced any more
+    std::shared_ptr<void> slot1_copy = slot1;
+    slot1 = nullptr;
+    ASSERT_EQ(nullptr, stub->acquire_checkpoint_slot("full_dir_1/1.2.pegasus"));
+    slot1_copy = nullptr;
+    ASSERT_NE(nullptr, stub->acquire_checkpoint_slot("full_dir_1/1.2.pegasus"));
+
+    // 0 means no limit
+    stub->_options.max_concurrent_checkpoint_count_per_disk = 0;
+    ASSERT_NE(nullptr, stub->acquire_checkpoint_slot("full_dir_1/1.2.pegasus"));
+}
+
+TEST_F(replica_disk_test, plan_disk_migration)
+{
+    // the available ratios of tag_5 ... tag_1 are 50%, 40%, 30%, 20%, 10%
+    std::vector<std::shared_ptr<dir_node>> nodes = get_fs_manager_nodes();
+    std::shared_ptr<dir_node> heaviest = nodes[0];
+    ASSERT_EQ("tag_5", heaviest->tag);
+    ASSERT_FALSE(heaviest->holding_secondary_replicas[app_id_1].empty());
+    gpid secondary = *heaviest->holding_secondary_replicas[app_id_1].begin();
+
+    gpid pid;
+    std::string from_tag;
+    std::string to_tag;
+    // no load
+    ASSERT_FALSE(stub->_fs_manager.plan_disk_migration(pid, from_tag, to_tag));
+
+    heaviest->write_bytes_per_sec = 100 << 20;
+    heaviest->replica_write_bytes_per_sec[secondary] = 10 << 20;
+    ASSERT_TRUE(stub->_fs_manager.plan_disk_migration(pid, from_tag, to_tag));
+    ASSERT_EQ(secondary, pid);
+    ASSERT_EQ("tag_5", from_tag);
+    ASSERT_EQ("tag_4", to_tag);
+
+    // the secondary heavier than the gap isn't moved, or the target disk would be heavier
+    heaviest->replica_write_bytes_per_sec[secondary] = 200 << 20;
+    ASSERT_FALSE(stub->_fs_manager.plan_disk_migration(pid, from_tag, to_tag));
+
+    // the disks with little available space are not the targets
+    heaviest->replica_write_bytes_per_sec[secondary] = 10 << 20;
+    for (const auto &n : nodes) {
+        if (n != heaviest && n->disk_available_ratio >= 20) {
+            n->write_bytes_per_sec = 90 << 20;
+        }
+    }
+    ASSERT_FALSE(stub->_fs_manager.plan_disk_migration(pid, from_tag, to_tag));
+}
+
+TEST_F(replica_disk_test, aio_latency_quantile)
+{
+    ASSERT_EQ(0, dir_node::aio_latency_quantile({}, 0.99));
+    ASSERT_EQ(0, dir_node::aio_latency_quantile({0, 0, 0}, 0.99));
+    // the upper bound of the bucket [2^i, 2^(i+1)) is returned
+    ASSERT_EQ(2, dir_node::aio_latency_quantile({100, 0, 0}, 0.99));
+    ASSERT_EQ(8, dir_node::aio_latency_quantile({98, 0, 2}, 0.99));
+    ASSERT_EQ(2, dir_node::aio_latency_quantile({99, 0, 1}, 0.99));
+    ASSERT_EQ(4, dir_node::aio_latency_quantile({0, 50, 50}, 0.5));
+}
+
+TEST_F(replica_disk_test, detect_slow_disks)
+{
+    std::vector<std::shared_ptr<dir_node>> nodes = get_fs_manager_nodes();
+    for (const auto &n : nodes) {
+        n->aio_count = 100;
+        n->aio_p99_latency_us = 1000;
+    }
+    std::shared_ptr<dir_node> slow = nodes[0];
+    slow->aio_count = 100;
+    slow->aio_p99_latency_us = 1000000;
+
+    // disabled by default
+    ASSERT_EQ(0, detect_slow_disks());
+    ASSERT_FALSE(slow->slow);
+
+    FLAGS_disk_slow_detection_enabled = true;
+    // marked after disk_slow_detect_rounds rounds in a row
+    ASSERT_EQ(0, detect_slow_disks());
+    ASSERT_EQ(0, detect_slow_disks());
+    ASSERT_EQ(1, detect_slow_disks());
+    ASSERT_TRUE(slow->slow);
+    ASSERT_EQ(std::vector<std::string>({slow->tag}), stub->_fs_manager.get_slow_disks());
+
+    // the new replicas are not placed on the slow disk
+    for (int i = 0; i < 8; ++i) {
+        gpid pid(3, i);
+        std::string dir;
+        stub->_fs_manager.allocate_dir(pid, "replica", dir);
+        ASSERT_FALSE(slow->has(pid));
+    }
+
+    // the disk with too few aios isn't judged, and keeps its state
+    slow->aio_count = 1;
+    slow->aio_p99_latency_us = 1000;
+    ASSERT_EQ(1, detect_slow_disks());
+
+    // recovered after disk_slow_recover_rounds normal rounds in a row
+    slow->aio_count = 100;
+    for (uint32_t i = 1; i < FLAGS_disk_slow_recover_rounds; ++i) {
+        ASSERT_EQ(1, detect_slow_disks());
+    }
+    ASSERT_EQ(0, detect_slow_disks());
+    ASSERT_FALSE(slow->slow);
+
+    // all the disks are slow, which isn't blamed on the disks
+    for (const auto &n : nodes) {
+        n->aio_p99_latency_us = 1000000;
+    }
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(0, detect_slow_disks());
+    }
+    ASSERT_TRUE(stub->_fs_manager.get_slow_disks().empty());
+
+    FLAGS_disk_slow_detection_enabled = false;
+}
+
 } // namespace replication
 } // namespace dsn
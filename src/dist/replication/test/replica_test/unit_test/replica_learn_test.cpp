@@ -3,6 +3,8 @@
 // can be found in the LICENSE file in the root directory of this source tree.
 
 #include <gtest/gtest.h>
+#include <dsn/utility/flags.h>
+#include <fstream>
 
 #include "dist/replication/lib/replica.h"
 #include "dist/replication/test/replica_test/unit_test/mock_utils.h"
@@ -11,6 +13,8 @@
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_bool(learn_app_from_secondary);
+
 /*static*/ mock_mutation_duplicator::duplicate_function mock_mutation_duplicator::_func;
 
 class replica_learn_test : public duplication_test_base
@@ -149,11 +153,115 @@ public:
             ASSERT_EQ(_replica->get_max_gced_decree_for_learn(), tt.want);
         }
     }
+
+    void test_get_reused_learn_files()
+    {
+        _replica = create_duplicating_replica();
+
+        const std::string dir = "./test_reused_learn_files";
+        utils::filesystem::remove_path(dir);
+        utils::filesystem::create_directory(dir + "/checkpoint.10");
+        for (const std::string &name : {"000001.sst", "000002.sst", "MANIFEST"}) {
+            std::ofstream out(dir + "/checkpoint.10/" + name);
+            out << "data of " << name;
+        }
+
+        learn_response resp;
+        resp.base_local_dir = dir;
+        resp.state.files = {
+            "checkpoint.10/000001.sst", "checkpoint.10/000002.sst", "checkpoint.10/MANIFEST"};
+
+        // only the file with the same name and size could be reused
+        std::vector<file_meta> local_files(2);
+        local_files[0].name = "rdb/000001.sst";
+        local_files[0].size = strlen("data of 000001.sst");
+        local_files[1].name = "rdb/000002.sst";
+        local_files[1].size = local_files[0].size + 1;
+
+        // md5 is computed in background at first
+        ASSERT_EQ(_replica->get_reused_learn_files(local_files, resp), ERR_BUSY);
+        ASSERT_TRUE(resp.reused_files.empty());
+        _replica->tracker()->wait_outstanding_tasks();
+        ASSERT_FALSE(_replica->_primary_states.learn_file_md5_is_computing);
+
+        ASSERT_EQ(_replica->get_reused_learn_files(local_files, resp), ERR_OK);
+        ASSERT_EQ(resp.reused_files.size(), 1u);
+        ASSERT_EQ(resp.reused_files[0].name, "checkpoint.10/000001.sst");
+        ASSERT_EQ(resp.reused_files[0].size, local_files[0].size);
+        std::string md5;
+        ASSERT_EQ(utils::filesystem::md5sum(dir + "/checkpoint.10/000001.sst", md5), ERR_OK);
+        ASSERT_EQ(resp.reused_files[0].md5, md5);
+
+        utils::filesystem::remove_path(dir);
+    }
+
+    void test_get_checkpoint_from_secondary()
+    {
+        typedef remote_learner_state::secondary_checkpoint_status checkpoint_status;
+        _replica = create_duplicating_replica();
+
+        learn_request req;
+        req.learner = rpc_address("127.0.0.1", 34801);
+        req.signature = 1;
+        remote_learner_state &state = _replica->_primary_states.learners[req.learner];
+        state.signature = req.signature;
+        learn_response resp;
+
+        ASSERT_FALSE(_replica->get_checkpoint_from_secondary(req, state, resp));
+        ASSERT_EQ(state.secondary_checkpoint_state, checkpoint_status::NONE);
+
+        FLAGS_learn_app_from_secondary = true;
+        // no secondary to learn from
+        ASSERT_FALSE(_replica->get_checkpoint_from_secondary(req, state, resp));
+        ASSERT_EQ(state.secondary_checkpoint_state, checkpoint_status::DONE);
+
+        // falls back to primary if the query failed
+        state.secondary_checkpoint_state = checkpoint_status::QUERYING;
+        _replica->on_query_secondary_checkpoint_reply(
+            ERR_TIMEOUT, req.learner, req.signature, learn_response());
+        ASSERT_EQ(state.secondary_checkpoint_state, checkpoint_status::DONE);
+        ASSERT_FALSE(_replica->get_checkpoint_from_secondary(req, state, resp));
+
+        learn_response ckpt;
+        ckpt.err = ERR_OK;
+        ckpt.address = rpc_address("127.0.0.1", 34802);
+        ckpt.base_local_dir = "./data";
+        ckpt.state.to_decree_included = 10;
+        ckpt.state.files = {"checkpoint.10/000001.sst", "checkpoint.10/MANIFEST"};
+
+        // the reply to a stale query is ignored
+        state.secondary_checkpoint_state = checkpoint_status::QUERYING;
+        _replica->on_query_secondary_checkpoint_reply(
+            ERR_OK, req.learner, req.signature + 1, learn_response(ckpt));
+        ASSERT_EQ(state.secondary_checkpoint_state, checkpoint_status::QUERYING);
+        ASSERT_TRUE(_replica->get_checkpoint_from_secondary(req, state, resp));
+        ASSERT_EQ(resp.err, ERR_BUSY);
+
+        // the checkpoint of the secondary is learned only once
+        _replica->on_query_secondary_checkpoint_reply(
+            ERR_OK, req.learner, req.signature, learn_response(ckpt));
+        ASSERT_EQ(state.secondary_checkpoint_state, checkpoint_status::READY);
+        resp = learn_response();
+        ASSERT_TRUE(_replica->get_checkpoint_from_secondary(req, state, resp));
+        ASSERT_EQ(resp.err, ERR_OK);
+        ASSERT_EQ(resp.address, ckpt.address);
+        ASSERT_EQ(resp.base_local_dir, ckpt.base_local_dir);
+        ASSERT_EQ(resp.state.files, ckpt.state.files);
+        ASSERT_EQ(resp.state.to_decree_included, ckpt.state.to_decree_included);
+        ASSERT_EQ(state.secondary_checkpoint_state, checkpoint_status::DONE);
+        ASSERT_FALSE(_replica->get_checkpoint_from_secondary(req, state, resp));
+
+        FLAGS_learn_app_from_secondary = false;
+    }
 };
 
 TEST_F(replica_learn_test, get_learn_start_decree) { test_get_learn_start_decree(); }
 
 TEST_F(replica_learn_test, get_max_gced_decree_for_learn) { test_get_max_gced_decree_for_learn(); }
 
+TEST_F(replica_learn_test, get_reused_learn_files) { test_get_reused_learn_files(); }
+
+TEST_F(replica_learn_test, get_checkpoint_from_secondary) { test_get_checkpoint_from_secondary(); }
+
 } // namespace replication
 } // namespace dsn
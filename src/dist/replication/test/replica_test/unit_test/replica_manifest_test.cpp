@@ -0,0 +1,105 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include <dsn/utility/filesystem.h>
+#include <fstream>
+#include <unistd.h>
+
+#include "dist/replication/lib/replica_manifest.h"
+
+namespace dsn {
+namespace replication {
+
+class replica_manifest_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        utils::filesystem::remove_path(_data_dir);
+        utils::filesystem::create_directory(_data_dir);
+    }
+
+    void TearDown() override { utils::filesystem::remove_path(_data_dir); }
+
+    static app_info create_app_info(int32_t app_id)
+    {
+        app_info info;
+        info.app_id = app_id;
+        info.app_name = "manifest_test_" + std::to_string(app_id);
+        info.app_type = "replica";
+        info.partition_count = 8;
+        info.is_stateful = true;
+        info.max_replica_count = 3;
+        return info;
+    }
+
+protected:
+    const std::string _data_dir{"./replica_manifest_test"};
+};
+
+TEST_F(replica_manifest_test, add_and_remove)
+{
+    replica_manifest manifest(_data_dir);
+    ASSERT_FALSE(manifest.load());
+
+    manifest.add("1.0.replica", create_app_info(1));
+    manifest.add("1.1.replica", create_app_info(1));
+    manifest.add("2.0.replica", create_app_info(2));
+    manifest.remove("1.1.replica");
+    manifest.remove("3.0.replica");
+    ASSERT_EQ(2u, manifest.size());
+
+    // the journal is replayed by the next startup
+    replica_manifest loaded(_data_dir);
+    ASSERT_TRUE(loaded.load());
+    ASSERT_EQ(2u, loaded.size());
+    app_info info;
+    ASSERT_TRUE(loaded.get("1.0.replica", info));
+    ASSERT_EQ(create_app_info(1), info);
+    ASSERT_TRUE(loaded.get("2.0.replica", info));
+    ASSERT_EQ(create_app_info(2), info);
+    ASSERT_FALSE(loaded.get("1.1.replica", info));
+
+    // compacted into the given entries only
+    loaded.reset({{"2.0.replica", create_app_info(2)}, {"4.0.replica", create_app_info(4)}});
+    replica_manifest compacted(_data_dir);
+    ASSERT_TRUE(compacted.load());
+    ASSERT_EQ(2u, compacted.size());
+    ASSERT_FALSE(compacted.get("1.0.replica", info));
+    ASSERT_TRUE(compacted.get("4.0.replica", info));
+    ASSERT_EQ(create_app_info(4), info);
+}
+
+TEST_F(replica_manifest_test, torn_tail)
+{
+    replica_manifest manifest(_data_dir);
+    manifest.add("1.0.replica", create_app_info(1));
+    manifest.add("2.0.replica", create_app_info(2));
+
+    // as if the process crashed while appending the last record
+    std::string path = utils::filesystem::path_combine(_data_dir, replica_manifest::FILE_NAME);
+    int64_t size = 0;
+    ASSERT_TRUE(utils::filesystem::file_size(path, size));
+    ASSERT_EQ(0, truncate(path.c_str(), size - 3));
+
+    replica_manifest loaded(_data_dir);
+    ASSERT_TRUE(loaded.load());
+    ASSERT_EQ(1u, loaded.size());
+    app_info info;
+    ASSERT_TRUE(loaded.get("1.0.replica", info));
+    ASSERT_FALSE(loaded.get("2.0.replica", info));
+
+    // a corrupted file is no manifest
+    {
+        std::ofstream os(path, std::ios::binary | std::ios::trunc);
+        os << "not a manifest";
+    }
+    ASSERT_FALSE(loaded.load());
+    ASSERT_EQ(0u, loaded.size());
+}
+
+} // namespace replication
+} // namespace dsn
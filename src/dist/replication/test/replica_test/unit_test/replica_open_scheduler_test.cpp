@@ -0,0 +1,63 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include "dist/replication/lib/replica_open_scheduler.h"
+
+namespace dsn {
+namespace replication {
+
+TEST(replica_open_scheduler_test, limit_total_and_per_disk)
+{
+    replica_open_scheduler scheduler(3, 1);
+
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 0)}), scheduler.add(gpid(1, 0), "disk1", false));
+    // disk1 is busy
+    ASSERT_TRUE(scheduler.add(gpid(1, 1), "disk1", false).empty());
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 2)}), scheduler.add(gpid(1, 2), "disk2", false));
+    // the disk of a new replica is unknown, which is only limited by the total count
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 3)}), scheduler.add(gpid(1, 3), "", false));
+    ASSERT_TRUE(scheduler.add(gpid(1, 4), "", false).empty());
+    ASSERT_EQ(3, scheduler.running_count());
+    ASSERT_EQ(2, scheduler.queued_count());
+
+    // the queued open on disk1 is started first
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 1)}), scheduler.finish(gpid(1, 0)));
+    // disk1 is still busy, so the open without disk is started
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 4)}), scheduler.finish(gpid(1, 2)));
+    ASSERT_EQ(0, scheduler.queued_count());
+
+    // finishing an unknown open changes nothing
+    ASSERT_TRUE(scheduler.finish(gpid(2, 0)).empty());
+    ASSERT_EQ(3, scheduler.running_count());
+}
+
+TEST(replica_open_scheduler_test, primaries_first)
+{
+    replica_open_scheduler scheduler(1, 0);
+
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 0)}), scheduler.add(gpid(1, 0), "disk1", false));
+    ASSERT_TRUE(scheduler.add(gpid(1, 1), "disk1", false).empty());
+    ASSERT_TRUE(scheduler.add(gpid(1, 2), "disk2", true).empty());
+    ASSERT_TRUE(scheduler.add(gpid(1, 3), "disk1", true).empty());
+
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 2)}), scheduler.finish(gpid(1, 0)));
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 3)}), scheduler.finish(gpid(1, 2)));
+    ASSERT_EQ(std::vector<gpid>({gpid(1, 1)}), scheduler.finish(gpid(1, 3)));
+    ASSERT_TRUE(scheduler.finish(gpid(1, 1)).empty());
+    ASSERT_EQ(0, scheduler.running_count());
+}
+
+TEST(replica_open_scheduler_test, no_limit)
+{
+    replica_open_scheduler scheduler(0, 0);
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(std::vector<gpid>({gpid(1, i)}), scheduler.add(gpid(1, i), "disk1", i % 2));
+    }
+    ASSERT_EQ(100, scheduler.running_count());
+}
+
+} // namespace replication
+} // namespace dsn
@@ -7,10 +7,16 @@
 #include <dsn/utility/fail_point.h>
 #include "replica_test_base.h"
 #include <dsn/utility/defer.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(primary_read_lease_ms);
+DSN_DECLARE_bool(follower_read_enabled);
+DSN_DECLARE_uint32(follower_read_max_lag_decrees);
+DSN_DECLARE_uint32(follower_read_max_lag_ms);
+
 class replica_test : public replica_test_base
 {
 public:
@@ -31,6 +37,13 @@ public:
         return stub->_counter_recent_write_size_exceed_threshold_count->get_value();
     }
 
+    void remove_replica(gpid id)
+    {
+        zauto_write_lock l(stub->_replicas_lock);
+        stub->_replicas.erase(id);
+        stub->update_replica_routes();
+    }
+
     int get_table_level_backup_request_qps()
     {
         return _mock_replica->_counter_backup_request_qps->get_integer_value();
@@ -81,5 +94,167 @@ TEST_F(replica_test, backup_request_qps)
     ASSERT_GT(get_table_level_backup_request_qps(), 0);
 }
 
+TEST_F(replica_test, read_lease)
+{
+    auto cleanup = dsn::defer([]() { FLAGS_primary_read_lease_ms = 0; });
+    FLAGS_primary_read_lease_ms = 1000;
+
+    // the meta lease is always valid if failure detection is disabled
+    stub->options().fd_disabled = true;
+    auto secondary1 = rpc_address("127.0.0.2", 34801);
+    auto secondary2 = rpc_address("127.0.0.3", 34801);
+    partition_configuration pconfig;
+    pconfig.secondaries = {secondary1, secondary2};
+    _mock_replica->set_primary_partition_configuration(pconfig);
+
+    // not acked by any secondary yet
+    ASSERT_FALSE(_mock_replica->is_read_lease_valid());
+
+    uint64_t now_ms = dsn_now_ms();
+    _mock_replica->_primary_states.update_secondary_ack_time(secondary1, now_ms);
+    ASSERT_FALSE(_mock_replica->is_read_lease_valid());
+    _mock_replica->_primary_states.update_secondary_ack_time(secondary2, now_ms - 500);
+    ASSERT_TRUE(_mock_replica->is_read_lease_valid());
+
+    // the lease is bound by the earliest ack, and never moves backward
+    _mock_replica->_primary_states.update_secondary_ack_time(secondary2, now_ms - 2000);
+    ASSERT_EQ(now_ms - 500, _mock_replica->_primary_states.get_min_secondary_ack_time());
+    _mock_replica->_primary_states.secondary_ack_time_ms[secondary2] = now_ms - 2000;
+    ASSERT_FALSE(_mock_replica->is_read_lease_valid());
+
+    // the ack times are reset once the replica is not primary
+    _mock_replica->_primary_states.update_secondary_ack_time(secondary2, now_ms);
+    ASSERT_TRUE(_mock_replica->is_read_lease_valid());
+    _mock_replica->_primary_states.cleanup();
+    ASSERT_TRUE(_mock_replica->_primary_states.secondary_ack_time_ms.empty());
+
+    // no secondary
+    pconfig.secondaries.clear();
+    _mock_replica->set_primary_partition_configuration(pconfig);
+    ASSERT_TRUE(_mock_replica->is_read_lease_valid());
+
+    // the failure detector is not started
+    stub->options().fd_disabled = false;
+    ASSERT_FALSE(_mock_replica->is_read_lease_valid());
+}
+
+TEST_F(replica_test, follower_read)
+{
+    auto cleanup = dsn::defer([]() { FLAGS_follower_read_enabled = false; });
+    FLAGS_follower_read_enabled = true;
+    FLAGS_follower_read_max_lag_decrees = 10;
+    FLAGS_follower_read_max_lag_ms = 5000;
+
+    _mock_replica->as_secondary();
+    _mock_replica->set_last_committed_decree(100);
+
+    // the commit point of the primary is unknown yet
+    ASSERT_FALSE(_mock_replica->is_follower_read_allowed());
+
+    _mock_replica->_secondary_states.update_primary_committed_decree(105);
+    ASSERT_TRUE(_mock_replica->is_follower_read_allowed());
+    _mock_replica->_secondary_states.update_primary_committed_decree(111);
+    ASSERT_FALSE(_mock_replica->is_follower_read_allowed());
+
+    // the commit point never moves backward
+    _mock_replica->_secondary_states.update_primary_committed_decree(101);
+    ASSERT_EQ(111, _mock_replica->_secondary_states.primary_committed_decree);
+    _mock_replica->set_last_committed_decree(101);
+    ASSERT_TRUE(_mock_replica->is_follower_read_allowed());
+
+    // the commit point is too old to bound the staleness
+    _mock_replica->_secondary_states.primary_committed_decree_update_ms = dsn_now_ms() - 6000;
+    ASSERT_FALSE(_mock_replica->is_follower_read_allowed());
+
+    _mock_replica->_secondary_states.update_primary_committed_decree(111);
+    ASSERT_TRUE(_mock_replica->is_follower_read_allowed());
+    FLAGS_follower_read_enabled = false;
+    ASSERT_FALSE(_mock_replica->is_follower_read_allowed());
+}
+
+TEST_F(replica_test, commit_notify)
+{
+    _mock_replica->as_secondary();
+    _mock_replica->set_last_committed_decree(100);
+
+    group_check_request request;
+    request.config.pid = pid;
+    request.config.ballot = 0;
+    request.config.status = partition_status::PS_SECONDARY;
+    request.last_committed_decree = 100;
+
+    // the commit point from an outdated primary is ignored
+    _mock_replica->on_commit_notify(request);
+    ASSERT_EQ(invalid_decree, _mock_replica->_secondary_states.primary_committed_decree);
+
+    request.config.ballot = _mock_replica->get_ballot();
+    _mock_replica->on_commit_notify(request);
+    ASSERT_EQ(100, _mock_replica->_secondary_states.primary_committed_decree);
+    ASSERT_EQ(100, _mock_replica->last_committed_decree());
+
+    // only the secondaries take the commit point
+    _mock_replica->as_primary();
+    request.last_committed_decree = 101;
+    _mock_replica->on_commit_notify(request);
+    ASSERT_EQ(100, _mock_replica->_secondary_states.primary_committed_decree);
+}
+
+TEST_F(replica_test, apply_mutations_in_batch)
+{
+    std::vector<mutation_ptr> mutations;
+    std::vector<const mutation *> batch;
+    for (decree d = 1; d <= 3; d++) {
+        mutations.push_back(create_test_mutation(d, "test"));
+        batch.push_back(mutations.back().get());
+    }
+
+    // the mutations are applied one by one if the app doesn't support batching them
+    mock_replication_app_base *app = _mock_replica->get_mock_app();
+    _mock_replica->set_app_last_committed_decree(0);
+    ASSERT_EQ(app->apply_mutations(batch), ERR_OK);
+    ASSERT_EQ(_mock_replica->get_app_last_committed_decree(), 3);
+    ASSERT_EQ(app->batched_write_count(), 3);
+
+    app->set_support_batched_mutations(true);
+    _mock_replica->set_app_last_committed_decree(0);
+    ASSERT_EQ(app->apply_mutations(batch), ERR_OK);
+    ASSERT_EQ(_mock_replica->get_app_last_committed_decree(), 3);
+    ASSERT_EQ(app->batched_write_count(), 4);
+}
+
+TEST_F(replica_test, get_replica_by_routes)
+{
+    ASSERT_EQ(stub->get_replica(pid), _mock_replica);
+    ASSERT_EQ(stub->get_replica(gpid(2, 0)), nullptr);
+    ASSERT_EQ(stub->get_replica(gpid(2, 7)), nullptr);
+    ASSERT_EQ(stub->get_replica(gpid(3, 1)), nullptr);
+
+    // the routes are rebuilt once the replicas are changed
+    mock_replica_ptr rep = stub->generate_replica(_app_info, gpid(2, 5));
+    ASSERT_EQ(stub->get_replica(gpid(2, 5)), rep);
+    ASSERT_EQ(stub->get_replica(pid), _mock_replica);
+
+    remove_replica(gpid(2, 5));
+    ASSERT_EQ(stub->get_replica(gpid(2, 5)), nullptr);
+    ASSERT_EQ(stub->get_replica(pid), _mock_replica);
+}
+
+TEST_F(replica_test, tcmalloc_bytes_to_release)
+{
+    const int64_t MB = 1 << 20;
+
+    // the free memory beyond the percentage of the allocated one is released without pressure
+    ASSERT_EQ(100 * MB, replica_stub::tcmalloc_bytes_to_release(1000 * MB, 200 * MB, 10, 0));
+    ASSERT_EQ(0, replica_stub::tcmalloc_bytes_to_release(1000 * MB, 50 * MB, 10, 0.5));
+
+    // the kept free memory shrinks as the pressure rises between the watermarks
+    ASSERT_NEAR(
+        150 * MB, replica_stub::tcmalloc_bytes_to_release(1000 * MB, 200 * MB, 10, 0.8), MB);
+    ASSERT_EQ(200 * MB, replica_stub::tcmalloc_bytes_to_release(1000 * MB, 200 * MB, 10, 0.95));
+
+    // the release in a check is limited
+    ASSERT_EQ(512 * MB, replica_stub::tcmalloc_bytes_to_release(1000 * MB, 2000 * MB, 10, 0.95));
+}
+
 } // namespace replication
 } // namespace dsn
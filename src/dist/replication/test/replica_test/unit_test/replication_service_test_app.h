@@ -23,4 +23,5 @@ public:
     void on_upload_chkpt_dir_test();
     void write_backup_metadata_test();
     void write_current_chkpt_file_test();
+    void fetch_upload_files_test();
 };
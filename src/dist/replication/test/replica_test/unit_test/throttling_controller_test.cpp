@@ -19,7 +19,6 @@ public:
         bool env_changed = false;
         std::string old_value;
         ASSERT_TRUE(cntl.parse_from_env("20000*delay*100", 4, parse_err, env_changed, old_value));
-        ASSERT_EQ(cntl._cur_units, 0);
         ASSERT_EQ(cntl._enabled, true);
         ASSERT_EQ(cntl._delay_ms, 100);
         ASSERT_EQ(cntl._delay_units, 5000 + 1);
@@ -33,7 +32,6 @@ public:
 
         ASSERT_TRUE(cntl.parse_from_env(
             "20000*delay*100,20000*reject*100", 4, parse_err, env_changed, old_value));
-        ASSERT_EQ(cntl._cur_units, 0);
         ASSERT_EQ(cntl._enabled, true);
         ASSERT_EQ(cntl._delay_ms, 100);
         ASSERT_EQ(cntl._delay_units, 5000 + 1);
@@ -60,6 +58,62 @@ public:
         ASSERT_EQ(env_changed, false);
         ASSERT_NE(parse_err, "");
         ASSERT_EQ(cntl._enabled, true);
+
+        ASSERT_TRUE(cntl.parse_from_env(
+            "20000*delay*100,40000*burst", 4, parse_err, env_changed, old_value));
+        ASSERT_EQ(cntl._delay_units, 5000 + 1);
+        ASSERT_EQ(cntl._burst_units, 10000 + 1);
+        ASSERT_FALSE(cntl.parse_from_env(
+            "20000*delay*100,1*burst,2*burst", 4, parse_err, env_changed, old_value));
+        ASSERT_FALSE(cntl.parse_from_env("20000*delay", 4, parse_err, env_changed, old_value));
+    }
+
+    void test_control()
+    {
+        throttling_controller cntl;
+        std::string parse_err;
+        bool env_changed = false;
+        std::string old_value;
+        // 100 units/s with the burst of 20 units on each of the 2 partitions
+        ASSERT_TRUE(
+            cntl.parse_from_env("198*delay*50,38*burst", 2, parse_err, env_changed, old_value));
+        ASSERT_EQ(cntl._delay_units, 100);
+        ASSERT_EQ(cntl._burst_units, 20);
+
+        int64_t delay_ms = 0;
+        double now_s = 1000;
+        for (int i = 0; i < 20; ++i) {
+            ASSERT_EQ(throttling_controller::PASS, cntl.control(0, 1, now_s, delay_ms));
+        }
+        // the delays grow with the debt by 10ms per unit, rather than jumping to the max
+        ASSERT_EQ(throttling_controller::DELAY, cntl.control(0, 1, now_s, delay_ms));
+        ASSERT_EQ(10, delay_ms);
+        ASSERT_EQ(throttling_controller::DELAY, cntl.control(0, 1, now_s, delay_ms));
+        ASSERT_EQ(20, delay_ms);
+        ASSERT_EQ(throttling_controller::DELAY, cntl.control(0, 3, now_s, delay_ms));
+        ASSERT_EQ(50, delay_ms);
+        // beyond the max delay, the debt doesn't grow any more
+        ASSERT_EQ(throttling_controller::DELAY, cntl.control(0, 2, now_s, delay_ms));
+        ASSERT_EQ(50, delay_ms);
+        ASSERT_EQ(throttling_controller::DELAY, cntl.control(40, 1, now_s, delay_ms));
+        ASSERT_EQ(20, delay_ms);
+
+        // the units are refilled continuously
+        now_s += 0.1;
+        ASSERT_EQ(throttling_controller::PASS, cntl.control(0, 5, now_s, delay_ms));
+
+
+        // 100 units/s with the burst of one second
+        throttling_controller reject_cntl;
+        ASSERT_TRUE(
+            reject_cntl.parse_from_env("99*reject*100", 1, parse_err, env_changed, old_value));
+        now_s = 2000;
+        ASSERT_EQ(throttling_controller::PASS, reject_cntl.control(0, 100, now_s, delay_ms));
+        ASSERT_EQ(throttling_controller::REJECT, reject_cntl.control(0, 1, now_s, delay_ms));
+        ASSERT_EQ(100, delay_ms);
+        now_s += 0.5;
+        ASSERT_EQ(throttling_controller::PASS, reject_cntl.control(0, 50, now_s, delay_ms));
+        ASSERT_EQ(throttling_controller::REJECT, reject_cntl.control(0, 1, now_s, delay_ms));
     }
 
     void test_parse_env_multiplier()
@@ -114,5 +168,16 @@ TEST_F(throttling_controller_test, parse_env_basic) { test_parse_env_basic(); }
 
 TEST_F(throttling_controller_test, parse_env_multiplier) { test_parse_env_multiplier(); }
 
+TEST_F(throttling_controller_test, control) { test_control(); }
+
+TEST_F(throttling_controller_test, backpressure_delay)
+{
+    ASSERT_EQ(0, throttling_controller::backpressure_delay_ms(0, 0.6, 100));
+    ASSERT_EQ(0, throttling_controller::backpressure_delay_ms(0.6, 0.6, 100));
+    ASSERT_EQ(50, throttling_controller::backpressure_delay_ms(0.8, 0.6, 100));
+    ASSERT_EQ(100, throttling_controller::backpressure_delay_ms(1, 0.6, 100));
+    ASSERT_EQ(100, throttling_controller::backpressure_delay_ms(1, 1, 100));
+}
+
 } // namespace replication
 } // namespace dsn
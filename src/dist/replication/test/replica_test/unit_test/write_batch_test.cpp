@@ -0,0 +1,164 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/cpp/serialization.h>
+#include <dsn/dist/replication/replication.codes.h>
+#include <dsn/utility/defer.h>
+#include <dsn/utility/flags.h>
+#include <gtest/gtest.h>
+
+#include "replica_test_base.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_uint32(write_batch_window_ms);
+DSN_DECLARE_uint32(write_batch_max_bytes);
+DSN_DECLARE_uint32(prepare_window_max_kb);
+
+DEFINE_STORAGE_WRITE_RPC_CODE(RPC_WRITE_BATCH_TEST, true, true)
+
+class write_batch_test : public replica_test_base
+{
+public:
+    void SetUp() override
+    {
+        _old_window_ms = FLAGS_write_batch_window_ms;
+        _old_max_bytes = FLAGS_write_batch_max_bytes;
+    }
+
+    void TearDown() override
+    {
+        FLAGS_write_batch_window_ms = _old_window_ms;
+        FLAGS_write_batch_max_bytes = _old_max_bytes;
+    }
+
+    mutation_ptr add_write(mutation_queue &queue, const std::string &value)
+    {
+        dsn::message_ex *request = dsn::message_ex::create_request(RPC_WRITE_BATCH_TEST);
+        dsn::marshall(request, value);
+        dsn::message_ex *received = request->copy(true, true);
+        mutation_ptr mu = queue.add_work(RPC_WRITE_BATCH_TEST, received, _replica.get());
+
+        destroy_message(request);
+        destroy_message(received);
+        return mu;
+    }
+
+    static void destroy_message(dsn::message_ex *msg)
+    {
+        msg->add_ref();
+        msg->release_ref();
+    }
+
+private:
+    uint32_t _old_window_ms;
+    uint32_t _old_max_bytes;
+};
+
+TEST_F(write_batch_test, no_window)
+{
+    FLAGS_write_batch_window_ms = 0;
+    mutation_queue queue(_replica->get_gpid(), 2);
+
+    // the writes are prepared at once while the in-flight mutations are below the limit
+    ASSERT_NE(nullptr, add_write(queue, "a"));
+    ASSERT_NE(nullptr, add_write(queue, "b"));
+    ASSERT_EQ(nullptr, add_write(queue, "c"));
+    ASSERT_TRUE(queue.has_pending());
+}
+
+TEST_F(write_batch_test, coalesce_in_window)
+{
+    FLAGS_write_batch_window_ms = 1;
+    FLAGS_write_batch_max_bytes = 64 * 1024;
+    mutation_queue queue(_replica->get_gpid(), 2);
+
+    // the writes are held until the window ends
+    ASSERT_EQ(nullptr, add_write(queue, "a"));
+    ASSERT_EQ(nullptr, add_write(queue, "b"));
+    ASSERT_EQ(nullptr, add_write(queue, "c"));
+    ASSERT_TRUE(queue.has_pending());
+
+    mutation_ptr mu = queue.flush_pending();
+    ASSERT_NE(nullptr, mu);
+    ASSERT_EQ(3u, mu->data.updates.size());
+    ASSERT_EQ(3u, mu->client_requests.size());
+    ASSERT_FALSE(queue.has_pending());
+    ASSERT_EQ(nullptr, queue.flush_pending());
+
+    // a held mutation reaching the size limit is prepared at once
+    FLAGS_write_batch_max_bytes = 1024;
+    ASSERT_EQ(nullptr, add_write(queue, "d"));
+    mu = add_write(queue, std::string(1024, 'e'));
+    ASSERT_NE(nullptr, mu);
+    ASSERT_EQ(2u, mu->data.updates.size());
+
+    // no more mutations are prepared after the in-flight ones reach the limit
+    FLAGS_write_batch_max_bytes = 64 * 1024;
+    ASSERT_EQ(nullptr, add_write(queue, "f"));
+    ASSERT_EQ(nullptr, queue.flush_pending());
+    ASSERT_TRUE(queue.has_pending());
+}
+
+TEST_F(write_batch_test, window_limited_by_bytes)
+{
+    FLAGS_write_batch_window_ms = 0;
+    FLAGS_prepare_window_max_kb = 2;
+    auto cleanup = dsn::defer([]() { FLAGS_prepare_window_max_kb = 0; });
+    mutation_queue queue(_replica->get_gpid(), 10);
+
+    // a large write is prepared at once if none is running
+    mutation_ptr mu = add_write(queue, std::string(4096, 'a'));
+    ASSERT_NE(nullptr, mu);
+    ASSERT_EQ(1.0, queue.window_usage());
+    ASSERT_EQ(nullptr, add_write(queue, "b"));
+    ASSERT_EQ(nullptr, queue.check_possible_work(1, mu->appro_data_bytes()));
+
+    // the small writes fill the window until the bytes limit
+    mu = queue.check_possible_work(0, 0);
+    ASSERT_NE(nullptr, mu);
+    ASSERT_EQ(1u, mu->data.updates.size());
+    ASSERT_NE(nullptr, add_write(queue, std::string(512, 'c')));
+    ASSERT_LT(queue.window_usage(), 1.0);
+    ASSERT_EQ(nullptr, add_write(queue, std::string(1536, 'd')));
+    ASSERT_TRUE(queue.has_pending());
+}
+
+TEST_F(write_batch_test, share_large_write)
+{
+    std::string value(64 * 1024, 'v');
+    dsn::message_ex *request = dsn::message_ex::create_request(RPC_WRITE_BATCH_TEST);
+    dsn::marshall(request, value);
+    dsn::message_ex *received = request->copy(true, true);
+    mutation_ptr mu = new mutation();
+    mu->add_client_request(RPC_WRITE_BATCH_TEST, received);
+    destroy_message(request);
+    destroy_message(received);
+
+    // the data shares the buffer of the request
+    const blob &data = mu->data.updates[0].data;
+    ASSERT_NE(nullptr, data.buffer_ptr());
+
+    // and it's attached to the prepare message without copying
+    message_ptr prepare = dsn::message_ex::create_request(RPC_PREPARE);
+    {
+        rpc_write_stream writer(prepare.get());
+        mu->write_to(writer, prepare.get());
+    }
+    bool shared = false;
+    for (const blob &bb : prepare->buffers) {
+        shared = shared || bb.data() == data.data();
+    }
+    ASSERT_TRUE(shared);
+
+    message_ptr recv_prepare = prepare->copy(true, true);
+    rpc_read_stream reader(recv_prepare.get());
+    mutation_ptr recv_mu = mutation::read_from(reader, nullptr);
+    ASSERT_EQ(1, recv_mu->data.updates.size());
+    ASSERT_EQ(data.to_string(), recv_mu->data.updates[0].data.to_string());
+}
+
+} // namespace replication
+} // namespace dsn
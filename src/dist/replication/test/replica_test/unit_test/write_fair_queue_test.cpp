@@ -0,0 +1,106 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+
+#include <dsn/dist/replication/replication.codes.h>
+
+#include "dist/replication/lib/write_fair_queue.h"
+
+namespace dsn {
+namespace replication {
+
+class write_fair_queue_test : public ::testing::Test
+{
+public:
+    static message_ex *create_write(const char *client_ip, uint32_t bytes)
+    {
+        message_ex *request = message_ex::create_request(RPC_REPLICATION_WRITE_EMPTY);
+        request->header->from_address = rpc_address(client_ip, 34801);
+        request->header->body_length = bytes;
+        return request;
+    }
+
+    static std::string pop_client(write_fair_queue &queue)
+    {
+        uint64_t queued_ms = 0;
+        message_ptr request = queue.pop(queued_ms);
+        return request->header->from_address.ipv4_str();
+    }
+
+    uint32_t weight_of(write_fair_queue &queue, const char *client_ip)
+    {
+        return queue.weight_of(rpc_address(client_ip, 0).ip());
+    }
+};
+
+TEST_F(write_fair_queue_test, parse_env)
+{
+    write_fair_queue queue;
+    std::string parse_err;
+    bool changed = false;
+    std::string old_value;
+    ASSERT_FALSE(queue.enabled());
+
+    ASSERT_TRUE(queue.parse_from_env("10.0.0.1*4,default*2", parse_err, changed, old_value));
+    ASSERT_TRUE(changed);
+    ASSERT_TRUE(queue.enabled());
+    ASSERT_EQ(4u, weight_of(queue, "10.0.0.1"));
+    ASSERT_EQ(2u, weight_of(queue, "10.0.0.2"));
+
+    ASSERT_TRUE(queue.parse_from_env("10.0.0.1*4,default*2", parse_err, changed, old_value));
+    ASSERT_FALSE(changed);
+
+    ASSERT_FALSE(queue.parse_from_env("10.0.0.1", parse_err, changed, old_value));
+    ASSERT_FALSE(queue.parse_from_env("10.0.0.1*0", parse_err, changed, old_value));
+    ASSERT_FALSE(queue.parse_from_env("10.0.0.1*x", parse_err, changed, old_value));
+    ASSERT_EQ("10.0.0.1*4,default*2", queue.env_value());
+
+    queue.reset(changed, old_value);
+    ASSERT_TRUE(changed);
+    ASSERT_EQ("10.0.0.1*4,default*2", old_value);
+    ASSERT_FALSE(queue.enabled());
+    ASSERT_EQ(1u, weight_of(queue, "10.0.0.1"));
+}
+
+TEST_F(write_fair_queue_test, fair_order)
+{
+    write_fair_queue queue;
+    std::string parse_err;
+    bool changed = false;
+    std::string old_value;
+    ASSERT_TRUE(queue.parse_from_env("10.0.0.3*2", parse_err, changed, old_value));
+
+    // a noisy client sends a burst before the others
+    for (int i = 0; i < 10; ++i) {
+        queue.push(create_write("10.0.0.1", 100));
+    }
+    queue.push(create_write("10.0.0.2", 100));
+    for (int i = 0; i < 4; ++i) {
+        queue.push(create_write("10.0.0.3", 100));
+    }
+    ASSERT_EQ(15u, queue.size());
+
+    // the others are not starved by the burst, and 10.0.0.3 gets twice the share
+    ASSERT_EQ("10.0.0.1", pop_client(queue));
+    ASSERT_EQ("10.0.0.2", pop_client(queue));
+    ASSERT_EQ("10.0.0.3", pop_client(queue));
+    ASSERT_EQ("10.0.0.3", pop_client(queue));
+    ASSERT_EQ("10.0.0.1", pop_client(queue));
+    ASSERT_EQ("10.0.0.3", pop_client(queue));
+    ASSERT_EQ("10.0.0.3", pop_client(queue));
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_EQ("10.0.0.1", pop_client(queue));
+    }
+    ASSERT_TRUE(queue.empty());
+
+    queue.push(create_write("10.0.0.1", 100));
+    queue.clear();
+    ASSERT_TRUE(queue.empty());
+    uint64_t queued_ms = 0;
+    ASSERT_EQ(nullptr, queue.pop(queued_ms).get());
+}
+
+} // namespace replication
+} // namespace dsn
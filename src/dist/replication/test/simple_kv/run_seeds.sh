@@ -0,0 +1,81 @@
+#!/bin/bash
+#
+# Run a case with many random seeds in parallel, each in its own process and working directory,
+# to explore more schedules of the simulator than a single fixed seed does.
+#
+# USAGE: ./run_seeds.sh <case-id> <first-seed> <seed-count> [parallelism]
+#   e.g. ./run_seeds.sh 100 1 1000 16
+#
+# The seed of a run overrides the [tools.simulator] random_seed of the case config by
+# DSN_SIMULATOR_RANDOM_SEED, so a failed run can be replayed by:
+#   DSN_SIMULATOR_RANDOM_SEED=<seed> ./run.sh <case-id>
+
+if [ $# -lt 3 ]; then
+    echo "USAGE: $0 <case-id> <first-seed> <seed-count> [parallelism]"
+    exit 1
+fi
+
+id=$1
+first_seed=$2
+seed_count=$3
+parallelism=${4:-`nproc`}
+
+root=`pwd`
+bin=${root}/dsn.rep_tests.simple_kv
+
+if [ -f case-${id}.act ]; then
+    prefixes="case-${id}"
+else
+    prefixes=`ls case-${id}-[0-9].act 2>/dev/null | sed -n 's/^\(case-[0-9][0-9][0-9]-[0-9]\).act$/\1/p' | sort`
+fi
+if [ -z "${prefixes}" ]; then
+    echo "case-${id} not found, or it's a case directory which is not supported"
+    exit 1
+fi
+
+out_dir=${root}/seeds/case-${id}
+rm -rf ${out_dir}
+mkdir -p ${out_dir}
+
+# run all the sub cases of the case with a seed, and record the result in result.txt
+function run_seed()
+{
+    seed=$1
+    dir=${out_dir}/seed-${seed}
+    mkdir -p ${dir}
+    cd ${dir}
+    for prefix in ${prefixes}; do
+        cp ${root}/${prefix}.ini ${root}/${prefix}.act .
+    done
+
+    for prefix in ${prefixes}; do
+        DSN_SIMULATOR_RANDOM_SEED=${seed} ${bin} ${prefix}.ini ${prefix}.act &>${prefix}.out
+        ret=$?
+        if [ ${ret} -ne 0 ]; then
+            echo "${seed} FAILED ${prefix} ${ret}" >result.txt
+            return
+        fi
+    done
+
+    echo "${seed} PASSED" >result.txt
+    # only the data of the failed runs are kept
+    cd ${out_dir}
+    rm -rf ${dir}/data ${dir}/*.out
+}
+
+export -f run_seed
+export out_dir root bin prefixes
+
+start=`date +%s`
+seq ${first_seed} $((first_seed + seed_count - 1)) | xargs -P ${parallelism} -I {} bash -c 'run_seed {}'
+end=`date +%s`
+
+cat ${out_dir}/seed-*/result.txt >${out_dir}/summary.txt
+passed=`grep -c PASSED ${out_dir}/summary.txt`
+failed=`grep -c FAILED ${out_dir}/summary.txt`
+echo "case-${id}: ${passed} passed, ${failed} failed, in $((end - start)) seconds"
+if [ ${failed} -ne 0 ]; then
+    echo "failed seeds, see ${out_dir}/seed-<seed> for the logs:"
+    grep FAILED ${out_dir}/summary.txt | sort -n
+    exit 1
+fi
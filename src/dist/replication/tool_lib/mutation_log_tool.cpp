@@ -25,17 +25,324 @@
  */
 
 #include <dsn/dist/replication/mutation_log_tool.h>
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/crc.h>
+#include <dsn/utility/filesystem.h>
 #include <dsn/utility/time_utils.h>
 #include "dist/replication/lib/mutation_log.h"
+#include "dist/replication/lib/mutation_log_utils.h"
+
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 namespace dsn {
 namespace replication {
 
-bool mutation_log_tool::dump(
-    const std::string &log_dir,
-    std::ostream &output,
-    std::function<void(int64_t decree, int64_t timestamp, dsn::message_ex **requests, int count)>
-        callback)
+namespace {
+
+void output_mutation(std::ostream &output,
+                     int log_length,
+                     mutation_ptr &mu,
+                     const mutation_log_tool::dump_callback &callback)
+{
+    char timestamp_buf[32];
+    utils::time_ms_to_string(mu->data.header.timestamp / 1000, timestamp_buf);
+    output << "mutation [" << mu->name() << "]: "
+           << "gpid=" << mu->data.header.pid.get_app_id() << "."
+           << mu->data.header.pid.get_partition_index() << ", "
+           << "ballot=" << mu->data.header.ballot << ", decree=" << mu->data.header.decree << ", "
+           << "timestamp=" << timestamp_buf
+           << ", last_committed_decree=" << mu->data.header.last_committed_decree << ", "
+           << "log_offset=" << mu->data.header.log_offset << ", log_length=" << log_length << ", "
+           << "update_count=" << mu->data.updates.size();
+    if (callback && mu->data.updates.size() > 0) {
+
+        dsn::message_ex **batched_requests =
+            (dsn::message_ex **)alloca(sizeof(dsn::message_ex *) * mu->data.updates.size());
+        int batched_count = 0;
+        for (mutation_update &update : mu->data.updates) {
+            dsn::message_ex *req = dsn::message_ex::create_received_request(
+                update.code,
+                (dsn_msg_serialize_format)update.serialization_type,
+                (void *)update.data.data(),
+                update.data.length());
+            batched_requests[batched_count++] = req;
+        }
+        callback(mu->data.header.decree,
+                 mu->data.header.timestamp,
+                 batched_requests,
+                 batched_count);
+        for (int i = 0; i < batched_count; i++) {
+            batched_requests[i]->release_ref();
+        }
+    }
+}
+
+bool match_mutation(const mutation_log_filter &filter, const mutation_header &header)
+{
+    return filter.match_partition(header.pid.get_app_id(), header.pid.get_partition_index()) &&
+           header.timestamp >= filter.start_timestamp_us &&
+           header.timestamp < filter.end_timestamp_us && header.decree >= filter.start_decree &&
+           header.decree < filter.end_decree;
+}
+
+// the index of a log block, with which the block can be read directly
+struct log_block_index
+{
+    int64_t offset = 0;    // local offset of the block in the file
+    uint32_t crc32 = 0;    // the chained crc of the blocks before it
+    int64_t min_timestamp = std::numeric_limits<int64_t>::max();
+    int64_t max_timestamp = std::numeric_limits<int64_t>::min();
+    // gpid => [min decree, max decree] of the mutations in the block
+    std::map<gpid, std::pair<decree, decree>> decrees;
+
+    void add(const mutation_header &header)
+    {
+        min_timestamp = std::min(min_timestamp, header.timestamp);
+        max_timestamp = std::max(max_timestamp, header.timestamp);
+        auto it = decrees.find(header.pid);
+        if (it == decrees.end()) {
+            decrees.emplace(header.pid, std::make_pair(header.decree, header.decree));
+        } else {
+            it->second.first = std::min(it->second.first, header.decree);
+            it->second.second = std::max(it->second.second, header.decree);
+        }
+    }
+
+    bool match(const mutation_log_filter &filter) const
+    {
+        if (max_timestamp < filter.start_timestamp_us || min_timestamp >= filter.end_timestamp_us) {
+            return false;
+        }
+        for (const auto &kv : decrees) {
+            if (filter.match_partition(kv.first.get_app_id(), kv.first.get_partition_index()) &&
+                kv.second.second >= filter.start_decree && kv.second.first < filter.end_decree) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// the index of a log file, saved as "<index_dir>/<log file name>.index"
+struct log_file_index
+{
+    static const uint32_t MAGIC = 0x4c4f4758; // "LOGX"
+
+    int64_t file_size = 0; // the index is valid only if the log file is of this size
+    std::vector<log_block_index> blocks;
+
+    // the content is followed by its crc, so that the corrupted index is never used
+    bool load(const std::string &path)
+    {
+        std::ifstream is(path, std::ios::binary);
+        if (!is) {
+            return false;
+        }
+        std::string content((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+        if (content.size() < sizeof(uint32_t) * 2) {
+            return false;
+        }
+        uint32_t magic, crc;
+        memcpy(&magic, content.data(), sizeof(magic));
+        memcpy(&crc, content.data() + sizeof(magic), sizeof(crc));
+        size_t header_size = sizeof(magic) + sizeof(crc);
+        if (magic != MAGIC || crc != utils::crc32_calc(content.data() + header_size,
+                                                       content.size() - header_size,
+                                                       0)) {
+            return false;
+        }
+
+        binary_reader reader(blob::create_from_bytes(content.data() + header_size,
+                                                     content.size() - header_size));
+        uint32_t block_count;
+        reader.read(file_size);
+        reader.read(block_count);
+        blocks.resize(block_count);
+        for (log_block_index &b : blocks) {
+            uint32_t gpid_count;
+            reader.read(b.offset);
+            reader.read(b.crc32);
+            reader.read(b.min_timestamp);
+            reader.read(b.max_timestamp);
+            reader.read(gpid_count);
+            for (uint32_t i = 0; i < gpid_count; ++i) {
+                int32_t app_id, partition_index;
+                std::pair<decree, decree> range;
+                reader.read(app_id);
+                reader.read(partition_index);
+                reader.read(range.first);
+                reader.read(range.second);
+                b.decrees.emplace(gpid(app_id, partition_index), range);
+            }
+        }
+        return true;
+    }
+
+    bool save(const std::string &path) const
+    {
+        binary_writer writer;
+        writer.write(file_size);
+        writer.write(static_cast<uint32_t>(blocks.size()));
+        for (const log_block_index &b : blocks) {
+            writer.write(b.offset);
+            writer.write(b.crc32);
+            writer.write(b.min_timestamp);
+            writer.write(b.max_timestamp);
+            writer.write(static_cast<uint32_t>(b.decrees.size()));
+            for (const auto &kv : b.decrees) {
+                writer.write(kv.first.get_app_id());
+                writer.write(kv.first.get_partition_index());
+                writer.write(kv.second.first);
+                writer.write(kv.second.second);
+            }
+        }
+        blob content = writer.get_buffer();
+        uint32_t crc = utils::crc32_calc(content.data(), content.length(), 0);
+
+        // written to a temporary file first, so that a partial index is never loaded
+        std::string tmp_path = path + ".tmp";
+        {
+            uint32_t magic = MAGIC;
+            std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+            os.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+            os.write(reinterpret_cast<const char *>(&crc), sizeof(crc));
+            os.write(content.data(), content.length());
+            if (!os) {
+                return false;
+            }
+        }
+        return utils::filesystem::rename_path(tmp_path, path);
+    }
+};
+
+// the matched mutations of a log file, in log order
+struct log_file_scan_result
+{
+    error_code err = ERR_OK;
+    std::vector<std::pair<int, mutation_ptr>> mutations; // log length, mutation
+    bool done = false;
+};
+
+// decodes the block `data` read by mutation_log::read_block(), collecting the matched mutations
+// into `result` and the ranges of all the mutations into `index`
+error_s decode_block(blob data,
+                     int64_t data_offset,
+                     const mutation_log_filter &filter,
+                     log_block_index *index,
+                     log_file_scan_result &result)
+{
+    // the data may refer to the buffer of file_streamer, which is reused by later reads, while
+    // the decoded mutations reference it
+    if (!data.buffer_ptr()) {
+        data = blob::create_from_bytes(data.data(), data.length());
+    }
+    mutation_log::replay_callback collect = [&filter, index, &result](int log_length,
+                                                                      mutation_ptr &mu) {
+        if (index != nullptr) {
+            index->add(mu->data.header);
+        }
+        if (match_mutation(filter, mu->data.header)) {
+            result.mutations.emplace_back(log_length, std::move(mu));
+        }
+        return true;
+    };
+    int64_t end_offset = 0;
+    return mutation_log::decode_block(data, data_offset, collect, end_offset);
+}
+
+// scans the log file at `path`, through its index at `index_path` if valid, or builds the index
+// and saves it there if `index_path` isn't empty
+void scan_log_file(const std::string &path,
+                   const std::string &index_path,
+                   const mutation_log_filter &filter,
+                   log_file_scan_result &result)
+{
+    error_code err;
+    log_file_ptr log = log_file::open_read(path.c_str(), err);
+    if (log == nullptr) {
+        if (err == ERR_HANDLE_EOF || err == ERR_INCOMPLETE_DATA || err == ERR_INVALID_PARAMETERS) {
+            dinfo("skip file %s during log scan", path.c_str());
+        } else {
+            result.err = err;
+        }
+        return;
+    }
+
+    int64_t file_size = 0;
+    utils::filesystem::file_size(path, file_size);
+    log_file_index index;
+    if (!index_path.empty() && index.load(index_path) && index.file_size == file_size) {
+        for (const log_block_index &b : index.blocks) {
+            if (!b.match(filter)) {
+                continue;
+            }
+            blob data;
+            int64_t data_offset = 0;
+            int64_t end_offset = 0;
+            log->reset_stream(static_cast<size_t>(b.offset), b.crc32);
+            error_s es = mutation_log::read_block(
+                log, static_cast<size_t>(b.offset), data, data_offset, end_offset);
+            if (es.is_ok()) {
+                es = decode_block(std::move(data), data_offset, filter, nullptr, result);
+            }
+            if (!es.is_ok()) {
+                derror_f(
+                    "failed to read log block at {} of {} through index: {}", b.offset, path, es);
+                result.err = es.code();
+                break;
+            }
+        }
+        log->close();
+        return;
+    }
+
+    size_t offset = 0;
+    while (true) {
+        log_block_index b;
+        b.offset = static_cast<int64_t>(offset);
+        b.crc32 = offset == 0 ? 0 : log->crc32();
+
+        blob data;
+        int64_t data_offset = 0;
+        int64_t end_offset = 0;
+        error_s es = mutation_log::read_block(log, offset, data, data_offset, end_offset);
+        if (es.is_ok()) {
+            es = decode_block(std::move(data), data_offset, filter, &b, result);
+        }
+        if (!es.is_ok()) {
+            // the incomplete tail is expected for the log file being written
+            if (es.code() != ERR_HANDLE_EOF && es.code() != ERR_INCOMPLETE_DATA) {
+                derror_f("failed to read log block at {} of {}: {}", offset, path, es);
+                result.err = es.code();
+            }
+            break;
+        }
+        index.blocks.push_back(std::move(b));
+        offset = static_cast<size_t>(end_offset - log->start_offset());
+    }
+    log->close();
+
+    if (!index_path.empty() && result.err == ERR_OK) {
+        index.file_size = file_size;
+        if (!index.save(index_path)) {
+            dwarn("failed to save the index of log file %s to %s",
+                  path.c_str(),
+                  index_path.c_str());
+        }
+    }
+}
+
+} // anonymous namespace
+
+bool mutation_log_tool::dump(const std::string &log_dir,
+                             std::ostream &output,
+                             dump_callback callback)
 {
     mutation_log_ptr mlog = new mutation_log_shared(log_dir, 32, false);
     error_code err = mlog->open(
@@ -43,39 +350,7 @@ bool mutation_log_tool::dump(
             if (mlog->max_decree(mu->data.header.pid) == 0) {
                 mlog->set_valid_start_offset_on_open(mu->data.header.pid, 0);
             }
-            char timestamp_buf[32];
-            utils::time_ms_to_string(mu->data.header.timestamp / 1000, timestamp_buf);
-            output << "mutation [" << mu->name() << "]: "
-                   << "gpid=" << mu->data.header.pid.get_app_id() << "."
-                   << mu->data.header.pid.get_partition_index() << ", "
-                   << "ballot=" << mu->data.header.ballot << ", decree=" << mu->data.header.decree
-                   << ", "
-                   << "timestamp=" << timestamp_buf
-                   << ", last_committed_decree=" << mu->data.header.last_committed_decree << ", "
-                   << "log_offset=" << mu->data.header.log_offset << ", log_length=" << log_length
-                   << ", "
-                   << "update_count=" << mu->data.updates.size();
-            if (callback && mu->data.updates.size() > 0) {
-
-                dsn::message_ex **batched_requests =
-                    (dsn::message_ex **)alloca(sizeof(dsn::message_ex *) * mu->data.updates.size());
-                int batched_count = 0;
-                for (mutation_update &update : mu->data.updates) {
-                    dsn::message_ex *req = dsn::message_ex::create_received_request(
-                        update.code,
-                        (dsn_msg_serialize_format)update.serialization_type,
-                        (void *)update.data.data(),
-                        update.data.length());
-                    batched_requests[batched_count++] = req;
-                }
-                callback(mu->data.header.decree,
-                         mu->data.header.timestamp,
-                         batched_requests,
-                         batched_count);
-                for (int i = 0; i < batched_count; i++) {
-                    batched_requests[i]->release_ref();
-                }
-            }
+            output_mutation(output, log_length, mu, callback);
             return true;
         },
         nullptr);
@@ -87,5 +362,113 @@ bool mutation_log_tool::dump(
         return true;
     }
 }
+
+bool mutation_log_tool::scan(const std::string &log_dir,
+                             const std::string &index_dir,
+                             const mutation_log_filter &filter,
+                             uint32_t thread_count,
+                             std::ostream &output,
+                             dump_callback callback)
+{
+    std::vector<std::string> files;
+    error_s es = log_utils::list_all_files(log_dir, files);
+    if (!es.is_ok()) {
+        output << "ERROR: scan mutation log failed, err = " << es.description() << std::endl;
+        return false;
+    }
+    if (!index_dir.empty() && !utils::filesystem::create_directory(index_dir)) {
+        output << "ERROR: create index directory " << index_dir << " failed" << std::endl;
+        return false;
+    }
+
+    // log.{index}.{start_offset}, in the order of the index
+    std::map<int, std::string> logs;
+    for (const std::string &path : files) {
+        std::string name = utils::filesystem::get_file_name(path);
+        int index = 0;
+        int64_t start_offset = 0;
+        if (sscanf(name.c_str(), "log.%d.%" PRId64, &index, &start_offset) == 2) {
+            logs.emplace(index, path);
+        }
+    }
+    std::vector<std::string> paths;
+    for (auto &kv : logs) {
+        paths.push_back(std::move(kv.second));
+    }
+
+    // the files are scanned by the workers concurrently, while the results are output in order
+    // by this thread, at most 2 * thread_count of which are kept in memory
+    thread_count = std::max(thread_count, 1U);
+    const size_t window = thread_count * 2;
+    std::vector<log_file_scan_result> results(paths.size());
+    std::mutex lock;
+    std::condition_variable cv;
+    size_t next = 0;
+    size_t output_count = 0;
+    bool stopped = false;
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        workers.emplace_back([&]() {
+            std::unique_lock<std::mutex> l(lock);
+            while (true) {
+                cv.wait(l, [&]() {
+                    return stopped || next >= paths.size() || next < output_count + window;
+                });
+                if (stopped || next >= paths.size()) {
+                    return;
+                }
+                size_t file = next++;
+                l.unlock();
+
+                std::string index_path;
+                if (!index_dir.empty()) {
+                    index_path = utils::filesystem::path_combine(
+                        index_dir, utils::filesystem::get_file_name(paths[file]) + ".index");
+                }
+                log_file_scan_result result;
+                scan_log_file(paths[file], index_path, filter, result);
+
+                l.lock();
+                results[file] = std::move(result);
+                results[file].done = true;
+                cv.notify_all();
+            }
+        });
+    }
+
+    error_code err = ERR_OK;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        log_file_scan_result result;
+        {
+            std::unique_lock<std::mutex> l(lock);
+            cv.wait(l, [&]() { return results[i].done; });
+            result = std::move(results[i]);
+            output_count = i + 1;
+            cv.notify_all();
+        }
+
+        for (auto &m : result.mutations) {
+            output_mutation(output, m.first, m.second, callback);
+        }
+        if (result.err != ERR_OK) {
+            err = result.err;
+            output << "ERROR: scan mutation log " << paths[i]
+                   << " failed, err = " << err.to_string() << std::endl;
+            break;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> l(lock);
+        stopped = true;
+        cv.notify_all();
+    }
+    for (auto &t : workers) {
+        t.join();
+    }
+    return err == ERR_OK;
+}
+
 } // namespace replication
 } // namespace dsn
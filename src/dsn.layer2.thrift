@@ -20,6 +20,13 @@ struct configuration_query_by_index_request
 {
     1:string           app_name;
     2:list<i32>        partition_indices;
+    // the version of the routes the client has, which is from the version of a response before.
+    // if it's known by the meta server, only the partitions changed since then are responded,
+    // regardless of partition_indices
+    3:optional i64     known_version;
+    // subscribe the changes of the routes: if set with a known_version known by the meta server,
+    // the query is held until some partitions change since known_version or wait_ms passes
+    4:optional i32     wait_ms;
 }
 
 // for server version > 1.11.2, if err == ERR_FORWARD_TO_OTHERS,
@@ -31,6 +38,9 @@ struct configuration_query_by_index_response
     3:i32                           partition_count;
     4:bool                          is_stateful;
     5:list<partition_configuration> partitions;
+    // set if the response contains all the partitions, or all the partitions changed since
+    // known_version, then it can be used as known_version of the next query
+    6:optional i64                  version;
 }
 
 enum app_status
@@ -37,6 +37,7 @@
 #include <dsn/tool-api/command_manager.h>
 #include <chrono>
 #include <ctime>
+#include <tuple>
 
 namespace dsn {
 namespace fd {
@@ -117,6 +118,7 @@ error_code failure_detector::stop()
         }
 
         _masters.clear();
+        utils::auto_write_lock wl(_workers_lock);
         _workers.clear();
     }
 
@@ -291,14 +293,15 @@ void failure_detector::check_all_records()
 
             // we should ensure now is greater than record.last_beacon_recv_time to aviod integer
             // overflow
-            if (record.is_alive && is_time_greater_than(now, record.last_beacon_recv_time) &&
-                now - record.last_beacon_recv_time > _grace_milliseconds) {
+            uint64_t last_beacon_recv_time = record.last_beacon_recv_time.load();
+            if (record.is_alive && is_time_greater_than(now, last_beacon_recv_time) &&
+                now - last_beacon_recv_time > _grace_milliseconds) {
                 derror("worker %s disconnected, now=%" PRId64 ", last_beacon_recv_time=%" PRId64
                        ", now-last_recv=%" PRId64,
                        record.node.to_string(),
                        now,
-                       record.last_beacon_recv_time,
-                       now - record.last_beacon_recv_time);
+                       last_beacon_recv_time,
+                       now - last_beacon_recv_time);
 
                 expire.push_back(record.node);
                 record.is_alive = false;
@@ -362,6 +365,22 @@ std::string failure_detector::get_allow_list(const std::vector<std::string> &arg
     return oss.str();
 }
 
+bool failure_detector::refresh_alive_worker(::dsn::rpc_address node, uint64_t now)
+{
+    utils::auto_read_lock l(_workers_lock);
+    auto itr = _workers.find(node);
+    if (itr == _workers.end() || !itr->second.is_alive.load()) {
+        return false;
+    }
+
+    uint64_t last = itr->second.last_beacon_recv_time.load();
+    while (is_time_greater_than(now, last) &&
+           !itr->second.last_beacon_recv_time.compare_exchange_weak(last, now)) {
+    }
+    dinfo("master %s update last_beacon_recv_time=%" PRId64, node.to_string(), now);
+    return true;
+}
+
 void failure_detector::on_ping_internal(const beacon_msg &beacon, /*out*/ beacon_ack &ack)
 {
     ack.time = beacon.time;
@@ -370,11 +389,16 @@ void failure_detector::on_ping_internal(const beacon_msg &beacon, /*out*/ beacon
     ack.is_master = true;
     ack.allowed = true;
 
-    zauto_lock l(_lock);
-
     uint64_t now = dsn_now_ms();
     auto node = beacon.from_addr;
 
+    // most beacons are from the connected workers, which needn't _lock
+    if (refresh_alive_worker(node, now)) {
+        return;
+    }
+
+    zauto_lock l(_lock);
+
     worker_map::iterator itr = _workers.find(node);
     if (itr == _workers.end()) {
         // if is a new worker, check allow list first if need
@@ -385,9 +409,12 @@ void failure_detector::on_ping_internal(const beacon_msg &beacon, /*out*/ beacon
         }
 
         // create new entry for node
-        worker_record record(node, now);
-        record.is_alive = true;
-        _workers.insert(std::make_pair(node, record));
+        {
+            utils::auto_write_lock wl(_workers_lock);
+            _workers.emplace(std::piecewise_construct,
+                             std::forward_as_tuple(node),
+                             std::forward_as_tuple(node, now));
+        }
 
         report(node, false, true);
         on_worker_connected(node);
@@ -395,9 +422,7 @@ void failure_detector::on_ping_internal(const beacon_msg &beacon, /*out*/ beacon
         // update last_beacon_recv_time
         itr->second.last_beacon_recv_time = now;
 
-        ddebug("master %s update last_beacon_recv_time=%" PRId64,
-               itr->second.node.to_string(),
-               itr->second.last_beacon_recv_time);
+        ddebug("master %s update last_beacon_recv_time=%" PRId64, node.to_string(), now);
 
         if (itr->second.is_alive == false) {
             itr->second.is_alive = true;
@@ -408,7 +433,7 @@ void failure_detector::on_ping_internal(const beacon_msg &beacon, /*out*/ beacon
     } else {
         ddebug("now[%" PRId64 "] <= last_recv_time[%" PRId64 "]",
                now,
-               itr->second.last_beacon_recv_time);
+               itr->second.last_beacon_recv_time.load());
     }
 }
 
@@ -529,16 +554,28 @@ bool failure_detector::is_master_connected(::dsn::rpc_address node) const
         return false;
 }
 
+uint64_t failure_detector::get_master_lease_expire_ms(::dsn::rpc_address node) const
+{
+    zauto_lock l(_lock);
+    auto it = _masters.find(node);
+    if (it == _masters.end() || !it->second.is_alive) {
+        return 0;
+    }
+    uint64_t expire_ms = it->second.last_send_time_for_beacon_with_ack + _lease_milliseconds;
+    return expire_ms > _check_interval_milliseconds ? expire_ms - _check_interval_milliseconds : 0;
+}
+
 void failure_detector::register_worker(::dsn::rpc_address target, bool is_connected)
 {
     /*
      * callers should use the fd::_lock necessarily
      */
-    worker_record record(target, dsn_now_ms());
-    record.is_alive = is_connected ? true : false;
-
-    auto ret = _workers.insert(std::make_pair(target, record));
+    utils::auto_write_lock l(_workers_lock);
+    auto ret = _workers.emplace(std::piecewise_construct,
+                                std::forward_as_tuple(target),
+                                std::forward_as_tuple(target, dsn_now_ms()));
     if (ret.second) {
+        ret.first->second.is_alive = is_connected;
         dinfo("register worker[%s] successfully", target.to_string());
     } else {
         dinfo("worker[%s] already registered", target.to_string());
@@ -552,7 +589,11 @@ bool failure_detector::unregister_worker(::dsn::rpc_address node)
      */
     bool ret;
 
-    size_t count = _workers.erase(node);
+    size_t count;
+    {
+        utils::auto_write_lock l(_workers_lock);
+        count = _workers.erase(node);
+    }
 
     if (count == 0) {
         ret = false;
@@ -570,6 +611,7 @@ bool failure_detector::unregister_worker(::dsn::rpc_address node)
 void failure_detector::clear_workers()
 {
     zauto_lock l(_lock);
+    utils::auto_write_lock wl(_workers_lock);
     _workers.clear();
 }
 
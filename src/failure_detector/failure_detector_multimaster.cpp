@@ -45,7 +45,8 @@ namespace dist {
 slave_failure_detector_with_multimaster::slave_failure_detector_with_multimaster(
     std::vector<::dsn::rpc_address> &meta_servers,
     std::function<void()> &&master_disconnected_callback,
-    std::function<void()> &&master_connected_callback)
+    std::function<void()> &&master_connected_callback,
+    std::function<void()> &&master_switched_callback)
 {
     _meta_servers.assign_group("meta-servers");
     for (auto &s : meta_servers) {
@@ -61,6 +62,7 @@ slave_failure_detector_with_multimaster::slave_failure_detector_with_multimaster
 
     _master_disconnected_callback = std::move(master_disconnected_callback);
     _master_connected_callback = std::move(master_connected_callback);
+    _master_switched_callback = std::move(master_switched_callback);
 }
 
 slave_failure_detector_with_multimaster::~slave_failure_detector_with_multimaster(void)
@@ -96,27 +98,92 @@ void slave_failure_detector_with_multimaster::end_ping(::dsn::error_code err,
             _meta_servers.group_address()->leader().to_string());
 
     if (ERR_OK != err) {
-        rpc_address next = _meta_servers.group_address()->next(ack.this_node);
-        if (next != ack.this_node) {
-            _meta_servers.group_address()->set_leader(next);
-            // do not start next send_beacon() immediately to avoid send rpc too frequently
-            switch_master(ack.this_node, next, 1000);
-        }
+        probe_meta_servers(ack.this_node);
     } else {
         if (ack.is_master) {
             // do nothing
         } else if (ack.primary_node.is_invalid()) {
-            rpc_address next = _meta_servers.group_address()->next(ack.this_node);
-            if (next != ack.this_node) {
-                _meta_servers.group_address()->set_leader(next);
-                // do not start next send_beacon() immediately to avoid send rpc too frequently
-                switch_master(ack.this_node, next, 1000);
-            }
+            probe_meta_servers(ack.this_node);
         } else {
-            _meta_servers.group_address()->set_leader(ack.primary_node);
             // start next send_beacon() immediately because the leader is possibly right.
-            switch_master(ack.this_node, ack.primary_node, 0);
+            switch_leader(ack.this_node, ack.primary_node);
+        }
+    }
+}
+
+void slave_failure_detector_with_multimaster::probe_meta_servers(rpc_address leader)
+{
+    if (_probing) {
+        return;
+    }
+
+    std::vector<rpc_address> servers = _meta_servers.group_address()->members();
+    _probe_round++;
+    _pending_probes = 0;
+    for (const rpc_address &server : servers) {
+        if (server == leader) {
+            continue;
         }
+
+        fd::beacon_msg beacon;
+        beacon.time = dsn_now_ms();
+        beacon.from_addr = dsn_primary_address();
+        beacon.to_addr = server;
+        uint64_t round = _probe_round;
+        rpc::call(server,
+                  RPC_FD_FAILURE_DETECTOR_PING,
+                  beacon,
+                  &_tracker,
+                  [this, server, round](error_code err, fd::beacon_ack &&resp) {
+                      end_probe(err, server, resp, round);
+                  },
+                  std::chrono::milliseconds(get_beacon_timeout_ms()));
+        _pending_probes++;
+    }
+    _probing = _pending_probes > 0;
+    ddebug("probe %d meta servers for the leader, round = %" PRIu64, _pending_probes, _probe_round);
+}
+
+void slave_failure_detector_with_multimaster::end_probe(error_code err,
+                                                        rpc_address target,
+                                                        const fd::beacon_ack &ack,
+                                                        uint64_t round)
+{
+    zauto_lock l(failure_detector::_lock);
+    if (!_probing || round != _probe_round) {
+        // the leader is already found, or a later round is started
+        return;
+    }
+
+    rpc_address leader;
+    if (err == ERR_OK) {
+        leader = ack.is_master ? target : ack.primary_node;
+    }
+    ddebug("end probe result, error[%s], target[%s], leader[%s]",
+           err.to_string(),
+           target.to_string(),
+           leader.to_string());
+
+    if (leader.is_invalid()) {
+        // try again on the next failed beacon once all the probes fail
+        _probing = --_pending_probes > 0;
+        return;
+    }
+
+    _probing = false;
+    rpc_address current = _meta_servers.group_address()->leader();
+    if (leader != current) {
+        switch_leader(current, leader);
+    }
+}
+
+void slave_failure_detector_with_multimaster::switch_leader(rpc_address from, rpc_address to)
+{
+    // the ongoing probes are useless once the leader is known
+    _probing = false;
+    _meta_servers.group_address()->set_leader(to);
+    if (switch_master(from, to, 0) && _master_switched_callback) {
+        _master_switched_callback();
     }
 }
 
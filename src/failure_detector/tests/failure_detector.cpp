@@ -166,6 +166,8 @@ public:
     {
         _opts.stable_rs_min_running_seconds = 10;
         _opts.max_succssive_unstable_restart = 10;
+        // the beacons are handled in batch except in update_stability
+        _opts.batch_beacons = true;
 
         _master_fd = new master_fd_test();
         _master_fd->set_options(&_opts);
@@ -382,6 +384,35 @@ TEST(fd, master_redirect)
     finish(worker, leader, index);
 }
 
+TEST(fd, probe_masters_concurrently)
+{
+    test_worker *worker;
+    std::vector<test_master *> masters;
+    ASSERT_TRUE(get_worker_and_master(worker, masters));
+
+    int index = masters.size() - 1;
+
+    clear(worker, masters);
+    /* leader is the last master, and the one before it doesn't respond */
+    master_group_set_leader(masters, index);
+    masters[index - 1]->fd()->toggle_response_ping(false);
+    // we contact to 0, which knows nothing about the leader
+    worker_set_leader(worker, 0);
+
+    test_master *leader = masters[index];
+    std::atomic_int wait_count;
+    wait_count.store(1);
+    worker->fd()->when_connected([&wait_count](rpc_address leader) mutable { --wait_count; });
+
+    // the masters are probed at the same time, rather than waiting for the beacon to the one not
+    // responding to time out
+    worker->fd()->toggle_send_ping(true);
+    ASSERT_TRUE(spin_wait_condition([&wait_count] { return wait_count == 0; }, 2));
+    ASSERT_EQ(worker->fd()->current_server_contact().port(), MPORT_START + index);
+
+    finish(worker, leader, index);
+}
+
 TEST(fd, switch_new_master_suddenly)
 {
     test_worker *worker;
@@ -0,0 +1,271 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "continuous_cpu_profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+#include <dsn/c/api_layer1.h>
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/tool-api/task.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+
+#ifdef DSN_ENABLE_GPERF
+#include <gperftools/profiler.h>
+#endif // DSN_ENABLE_GPERF
+
+namespace dsn {
+
+//
+// The legacy cpu profile of gperftools is a sequence of machine words:
+//   header:  0, 3, 0, <sampling period in us>, 0
+//   samples: <count>, <depth>, <pc_1>, ..., <pc_depth>
+//   trailer: 0, 1, 0
+// followed by the text of /proc/self/maps.
+//
+bool merge_cpu_profiles(const std::vector<std::string> &profiles, /*out*/ std::string &merged)
+{
+    typedef uintptr_t word;
+    const size_t header_words = 5;
+    const word trailer[] = {0, 1, 0};
+
+    merged.clear();
+    std::string maps;
+    for (const std::string &profile : profiles) {
+        const word *words = reinterpret_cast<const word *>(profile.data());
+        size_t count = profile.size() / sizeof(word);
+        if (count < header_words || words[0] != 0 || words[1] != 3 || words[2] != 0) {
+            return false;
+        }
+        if (merged.empty()) {
+            merged.append(profile.data(), header_words * sizeof(word));
+        }
+
+        size_t i = header_words;
+        while (true) {
+            if (i + 2 > count) {
+                return false;
+            }
+            if (words[i] == 0 && words[i + 1] == 1 && i + 3 <= count && words[i + 2] == 0) {
+                // reach the trailer
+                i += 3;
+                break;
+            }
+            size_t sample_words = 2 + words[i + 1];
+            if (words[i + 1] > count || i + sample_words > count) {
+                return false;
+            }
+            merged.append(reinterpret_cast<const char *>(words + i), sample_words * sizeof(word));
+            i += sample_words;
+        }
+        maps = profile.substr(i * sizeof(word));
+    }
+
+    if (!merged.empty()) {
+        merged.append(reinterpret_cast<const char *>(trailer), sizeof(trailer));
+        merged.append(maps);
+    }
+    return true;
+}
+
+#ifdef DSN_ENABLE_GPERF
+
+DSN_DEFINE_bool("pprof",
+                enable_continuous_cpu_profile,
+                false,
+                "whether to keep a low frequency cpu profiler running, as /pprof/continuous");
+DSN_DEFINE_uint32("pprof",
+                  continuous_profile_frequency,
+                  10,
+                  "the sampling frequency of the continuous cpu profiler, which takes effect "
+                  "only if no cpu profile has been taken in the process, and CPUPROFILE_FREQUENCY "
+                  "is not set");
+DSN_DEFINE_uint32("pprof",
+                  continuous_profile_window_seconds,
+                  60,
+                  "the continuous cpu profile is rotated into a new file every this seconds");
+DSN_DEFINE_uint32("pprof",
+                  continuous_profile_max_windows,
+                  30,
+                  "the max count of the continuous cpu profile files kept");
+DSN_DEFINE_string("pprof",
+                  continuous_profile_dir,
+                  "./cpu_profile",
+                  "the directory of the continuous cpu profile files");
+DSN_DEFINE_string("pprof",
+                  continuous_profile_task_code,
+                  "",
+                  "only record the samples of this task code in the continuous cpu profile if set");
+
+/*static*/ std::unique_ptr<continuous_cpu_profiler> continuous_cpu_profiler::create_if_enabled()
+{
+    if (!FLAGS_enable_continuous_cpu_profile) {
+        return nullptr;
+    }
+    return std::unique_ptr<continuous_cpu_profiler>(new continuous_cpu_profiler());
+}
+
+continuous_cpu_profiler::continuous_cpu_profiler()
+    : _filter_task_code(
+          task_code::try_get(FLAGS_continuous_profile_task_code, TASK_CODE_INVALID).code()),
+      _task_code_count(task_code::max() + 1)
+{
+    _task_samples.reset(new std::atomic<uint64_t>[_task_code_count]);
+    for (int i = 0; i < _task_code_count; ++i) {
+        _task_samples[i].store(0);
+    }
+
+    if (!utils::filesystem::create_directory(FLAGS_continuous_profile_dir)) {
+        derror_f("create directory {} for continuous cpu profile failed",
+                 FLAGS_continuous_profile_dir);
+    }
+    setenv("CPUPROFILE_FREQUENCY",
+           std::to_string(FLAGS_continuous_profile_frequency).c_str(),
+           0 /* don't overwrite */);
+
+    _thread = std::thread(&continuous_cpu_profiler::run, this);
+}
+
+continuous_cpu_profiler::~continuous_cpu_profiler()
+{
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        _stopped = true;
+    }
+    _cond.notify_all();
+    _thread.join();
+}
+
+/*static*/ int continuous_cpu_profiler::on_sample(void *arg)
+{
+    auto profiler = static_cast<continuous_cpu_profiler *>(arg);
+    int code = tls_dsn.current_task_code;
+    if (code < 0 || code >= profiler->_task_code_count) {
+        code = TASK_CODE_INVALID;
+    }
+    profiler->_task_samples[code].fetch_add(1, std::memory_order_relaxed);
+    return profiler->_filter_task_code == TASK_CODE_INVALID ||
+           code == profiler->_filter_task_code;
+}
+
+void continuous_cpu_profiler::run()
+{
+    for (uint64_t seq = 0;; ++seq) {
+        std::string file =
+            fmt::format("{}/cpu.{}.{}.prof", FLAGS_continuous_profile_dir, getpid(), seq);
+        for (int i = 0; i < _task_code_count; ++i) {
+            _task_samples[i].store(0, std::memory_order_relaxed);
+        }
+
+        ProfilerOptions options;
+        memset(&options, 0, sizeof(options));
+        options.filter_in_thread = &continuous_cpu_profiler::on_sample;
+        options.filter_in_thread_arg = this;
+        bool started = ProfilerStartWithOptions(file.c_str(), &options);
+        if (!started) {
+            derror_f("start continuous cpu profile {} failed, maybe another cpu profile is "
+                     "running",
+                     file);
+        }
+
+        bool stopped;
+        {
+            std::unique_lock<std::mutex> l(_lock);
+            _cond.wait_for(l,
+                           std::chrono::seconds(FLAGS_continuous_profile_window_seconds),
+                           [this]() { return _stopped; });
+            stopped = _stopped;
+        }
+
+        if (started) {
+            ProfilerStop();
+
+            auto w = std::make_shared<window>();
+            w->file = std::move(file);
+            w->end_ms = dsn_now_ms();
+            w->task_samples.resize(_task_code_count);
+            for (int i = 0; i < _task_code_count; ++i) {
+                w->task_samples[i] = _task_samples[i].load(std::memory_order_relaxed);
+            }
+
+            std::lock_guard<std::mutex> l(_lock);
+            _windows.emplace_back(std::move(w));
+            while (_windows.size() > std::max(FLAGS_continuous_profile_max_windows, 1u)) {
+                if (!utils::filesystem::remove_path(_windows.front()->file)) {
+                    dwarn_f("remove continuous cpu profile {} failed", _windows.front()->file);
+                }
+                _windows.pop_front();
+            }
+        }
+
+        if (stopped) {
+            break;
+        }
+    }
+}
+
+std::vector<std::shared_ptr<continuous_cpu_profiler::window>>
+continuous_cpu_profiler::recent_windows(int minutes) const
+{
+    uint64_t since_ms = dsn_now_ms() - static_cast<uint64_t>(minutes) * 60 * 1000;
+    std::vector<std::shared_ptr<window>> windows;
+    std::lock_guard<std::mutex> l(_lock);
+    for (const auto &w : _windows) {
+        if (w->end_ms >= since_ms) {
+            windows.push_back(w);
+        }
+    }
+    return windows;
+}
+
+bool continuous_cpu_profiler::get_profile(int minutes, /*out*/ std::string &profile) const
+{
+    std::vector<std::string> profiles;
+    for (const auto &w : recent_windows(minutes)) {
+        std::ifstream in(w->file, std::ios::binary);
+        if (!in.is_open()) {
+            // removed by rotation
+            continue;
+        }
+        std::ostringstream content;
+        content << in.rdbuf();
+        profiles.emplace_back(content.str());
+    }
+    return merge_cpu_profiles(profiles, profile);
+}
+
+std::string continuous_cpu_profiler::get_task_samples(int minutes) const
+{
+    std::vector<uint64_t> samples(_task_code_count, 0);
+    for (const auto &w : recent_windows(minutes)) {
+        for (int i = 0; i < _task_code_count; ++i) {
+            samples[i] += w->task_samples[i];
+        }
+    }
+
+    std::vector<int> codes;
+    for (int i = 0; i < _task_code_count; ++i) {
+        if (samples[i] > 0) {
+            codes.push_back(i);
+        }
+    }
+    std::sort(codes.begin(), codes.end(), [&samples](int a, int b) {
+        return samples[a] > samples[b];
+    });
+
+    std::string result;
+    for (int code : codes) {
+        result += fmt::format("{} {}\n", task_code(code).to_string(), samples[code]);
+    }
+    return result;
+}
+
+#endif // DSN_ENABLE_GPERF
+
+} // namespace dsn
@@ -0,0 +1,80 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dsn {
+
+// merge the cpu profiles in the legacy format of gperftools into one, by concatenating the
+// samples of all the profiles, with the header of the first profile and the memory mappings
+// of the last one. Return false if any of the profiles is corrupted.
+bool merge_cpu_profiles(const std::vector<std::string> &profiles, /*out*/ std::string &merged);
+
+#ifdef DSN_ENABLE_GPERF
+
+///
+/// continuous_cpu_profiler keeps the cpu profiler of gperftools running at a low frequency
+/// ([pprof] continuous_profile_frequency), and rotates the profile into a new file every
+/// [pprof] continuous_profile_window_seconds, keeping the last
+/// [pprof] continuous_profile_max_windows files in [pprof] continuous_profile_dir.
+///
+/// The task code of each sample is read from tls_dsn in the signal handler of the profiler,
+/// which is counted for each window, and if [pprof] continuous_profile_task_code is set, only
+/// the samples of this task code are recorded in the profiles.
+///
+class continuous_cpu_profiler
+{
+public:
+    // return nullptr if [pprof] enable_continuous_cpu_profile is false
+    static std::unique_ptr<continuous_cpu_profiler> create_if_enabled();
+
+    continuous_cpu_profiler();
+    ~continuous_cpu_profiler();
+
+    // the merged profile of the windows finished in the last `minutes`
+    bool get_profile(int minutes, /*out*/ std::string &profile) const;
+
+    // "<task_code> <sample_count>" of the windows finished in the last `minutes`, one task code
+    // in a line in the descending order of the counts
+    std::string get_task_samples(int minutes) const;
+
+private:
+    struct window
+    {
+        std::string file;
+        uint64_t end_ms;
+        std::vector<uint64_t> task_samples; // indexed by task code
+    };
+
+    void run();
+    // called in the signal handler for each sample
+    static int on_sample(void *arg);
+
+    std::vector<std::shared_ptr<window>> recent_windows(int minutes) const;
+
+    int _filter_task_code;
+    // the sample counts of the running window, indexed by task code
+    std::unique_ptr<std::atomic<uint64_t>[]> _task_samples;
+    int _task_code_count;
+
+    mutable std::mutex _lock; // protect _windows and _stopped
+    std::condition_variable _cond;
+    bool _stopped{false};
+    std::deque<std::shared_ptr<window>> _windows;
+
+    std::thread _thread;
+};
+
+#endif // DSN_ENABLE_GPERF
+
+} // namespace dsn
@@ -33,6 +33,7 @@
 #include <dsn/c/api_layer1.h>
 #include <dsn/tool-api/http_server.h>
 #include <iomanip>
+#include <strings.h>
 
 namespace dsn {
 
@@ -42,6 +43,21 @@ struct parser_context
     message_reader *reader;
 };
 
+// refer `length` bytes at `at` of the read buffer by `buf`, or append them to `buf` when
+// `buf` is parsed in pieces, which happens when it's received in several reads
+static void append_parsed(blob &buf, const blob &read_buf, const char *at, size_t length)
+{
+    if (buf.length() == 0) {
+        buf.assign(read_buf.buffer(), at - read_buf.buffer_ptr(), length);
+    } else {
+        std::string merged;
+        merged.reserve(buf.length() + length);
+        merged.append(buf.data(), buf.length());
+        merged.append(at, length);
+        buf = blob::create_from_bytes(std::move(merged));
+    }
+}
+
 /*extern*/ const char *http_parser_stage_to_string(http_parser_stage s)
 {
     switch (s) {
@@ -76,7 +92,9 @@ http_message_parser::http_message_parser()
         // initialize http message
         // msg->buffers[0] = header
         // msg->buffers[1] = body (blob())
+        // msg->buffers[2] = url (blob())
         msg.reset(message_ex::create_receive_message_with_standalone_header(blob()));
+        msg->buffers.emplace_back();
 
         message_header *header = msg->header;
         header->hdr_length = sizeof(message_header);
@@ -86,23 +104,41 @@ http_message_parser::http_message_parser()
     };
 
     _parser_setting.on_url = [](http_parser *parser, const char *at, size_t length) -> int {
-        http_message_parser *msg_parser = reinterpret_cast<parser_context *>(parser->data)->parser;
-        msg_parser->_stage = HTTP_ON_URL;
-        msg_parser->_url.append(at, length);
+        auto data = reinterpret_cast<parser_context *>(parser->data);
+        auto &msg = data->parser->_current_message;
+        data->parser->_stage = HTTP_ON_URL;
+
+        // set url, which refers to the read buffer rather than being copied
+        append_parsed(msg->buffers[2], data->reader->_buffer, at, length);
         return 0;
     };
 
     _parser_setting.on_header_field =
         [](http_parser *parser, const char *at, size_t length) -> int {
         http_message_parser *msg_parser = reinterpret_cast<parser_context *>(parser->data)->parser;
+        // a field may be parsed in pieces as well
+        if (msg_parser->_stage != HTTP_ON_HEADER_FIELD) {
+            msg_parser->_header_field.clear();
+        }
+        msg_parser->_header_field.append(at, length);
         msg_parser->_stage = HTTP_ON_HEADER_FIELD;
         return 0;
     };
 
     _parser_setting.on_header_value =
         [](http_parser *parser, const char *at, size_t length) -> int {
-        http_message_parser *msg_parser = reinterpret_cast<parser_context *>(parser->data)->parser;
+        auto data = reinterpret_cast<parser_context *>(parser->data);
+        http_message_parser *msg_parser = data->parser;
         msg_parser->_stage = HTTP_ON_HEADER_VALUE;
+
+        // only If-None-Match is kept, for the responses cached by http_response_cache
+        if (strcasecmp(msg_parser->_header_field.c_str(), "If-None-Match") == 0) {
+            auto &msg = msg_parser->_current_message;
+            if (msg->buffers.size() == 3) {
+                msg->buffers.emplace_back();
+            }
+            append_parsed(msg->buffers[3], data->reader->_buffer, at, length);
+        }
         return 0;
     };
 
@@ -110,12 +146,7 @@ http_message_parser::http_message_parser()
         http_message_parser *msg_parser = reinterpret_cast<parser_context *>(parser->data)->parser;
         msg_parser->_stage = HTTP_ON_HEADERS_COMPLETE;
 
-        auto &msg = msg_parser->_current_message;
-
-        // msg->buffers[2] = url
-        msg->buffers.emplace_back(blob::create_from_bytes(std::move(msg_parser->_url)));
-
-        message_header *header = msg->header;
+        message_header *header = msg_parser->_current_message->header;
         if (parser->type == HTTP_REQUEST && parser->method == HTTP_GET) {
             header->hdr_type = http_method::HTTP_METHOD_GET;
             header->context.u.is_request = 1;
@@ -136,6 +167,16 @@ http_message_parser::http_message_parser()
         return 0;
     };
 
+    _parser_setting.on_body = [](http_parser *parser, const char *at, size_t length) -> int {
+        auto data = reinterpret_cast<parser_context *>(parser->data);
+        auto &msg = data->parser->_current_message;
+
+        // set http body, which refers to the read buffer rather than being copied
+        append_parsed(msg->buffers[1], data->reader->_buffer, at, length);
+        msg->header->body_length = msg->buffers[1].length();
+        return 0;
+    };
+
     // rDSN application can only serve as http server, support for http client is not in our plan.
     http_parser_init(&_parser, HTTP_REQUEST);
 }
@@ -149,17 +190,6 @@ message_ex *http_message_parser::get_message_on_receive(message_reader *reader,
         parser_context ctx{this, reader};
         _parser.data = &ctx;
 
-        _parser_setting.on_body = [](http_parser *parser, const char *at, size_t length) -> int {
-            auto data = reinterpret_cast<parser_context *>(parser->data);
-            auto &msg = data->parser->_current_message;
-            blob read_buf = data->reader->_buffer;
-
-            // set http body
-            msg->buffers[1].assign(read_buf.buffer(), at - read_buf.buffer_ptr(), length);
-            msg->header->body_length = length;
-            return 0;
-        };
-
         auto nparsed = http_parser_execute(
             &_parser, &_parser_setting, reader->_buffer.data(), reader->_buffer_occupied);
 
@@ -174,11 +204,14 @@ message_ex *http_message_parser::get_message_on_receive(message_reader *reader,
             return nullptr;
         }
 
+        // http_parser keeps its state between the calls, so the parsed data is consumed at once
+        // rather than parsed again with the data of the next read. this allows a request to be
+        // received in several reads, which is common for the keep-alive connections.
+        reader->_buffer = reader->_buffer.range(nparsed);
+        reader->_buffer_occupied -= nparsed;
         _parsed_length += nparsed;
         if (is_complete()) {
             // parsing complete
-            reader->_buffer = reader->_buffer.range(_parsed_length);
-            reader->_buffer_occupied -= _parsed_length;
             reset();
         }
     }
@@ -234,7 +267,6 @@ int http_message_parser::get_buffers_on_send(message_ex *msg, send_buf *buffers)
 void http_message_parser::reset()
 {
     _current_message.reset();
-    _url.clear();
     _stage = HTTP_INVALID;
     _parsed_length = 0;
 }
@@ -29,8 +29,9 @@
 #include <dsn/utility/ports.h>
 #include <dsn/tool-api/rpc_message.h>
 #include <dsn/tool-api/message_parser.h>
-#include <vector>
 #include <queue>
+#include <string>
+#include <vector>
 
 #include "http_parser.h"
 
@@ -47,6 +48,7 @@ DEFINE_CUSTOMIZED_ID(network_header_format, NET_HDR_HTTP)
 //    msg->buffers[0] = header
 //    msg->buffers[1] = body
 //    msg->buffers[2] = url
+//    msg->buffers[3] = the value of If-None-Match, only if the request has it
 //
 
 enum http_parser_stage
@@ -92,7 +94,8 @@ private:
 
     std::unique_ptr<message_ex> _current_message;
     http_parser_stage _stage{HTTP_INVALID};
-    std::string _url;
+    // the field of the header being parsed
+    std::string _header_field;
     size_t _parsed_length{0};
     std::queue<std::unique_ptr<message_ex>> _received_messages;
 };
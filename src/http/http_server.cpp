@@ -4,13 +4,15 @@
 
 #include <dsn/tool-api/http_server.h>
 #include <dsn/tool_api.h>
-#include <boost/algorithm/string.hpp>
+#include <algorithm>
 #include <fmt/ostream.h>
 
 #include "http_message_parser.h"
 #include "root_http_service.h"
 #include "pprof_http_service.h"
 #include "perf_counter_http_service.h"
+#include "metrics_http_service.h"
+#include "task_cpu_http_service.h"
 #include "uri_decoder.h"
 
 namespace dsn {
@@ -20,6 +22,8 @@ namespace dsn {
     switch (code) {
     case http_status_code::ok:
         return "200 OK";
+    case http_status_code::not_modified:
+        return "304 Not Modified";
     case http_status_code::temporary_redirect:
         return "307 Temporary Redirect";
     case http_status_code::bad_request:
@@ -52,6 +56,10 @@ http_server::http_server(bool start /*default=true*/) : serverlet<http_server>("
 #endif // DSN_ENABLE_GPERF
 
     add_service(new perf_counter_http_service());
+
+    add_service(new metrics_http_service());
+
+    add_service(new task_cpu_http_service());
 }
 
 void http_server::serve(message_ex *msg)
@@ -82,9 +90,47 @@ void http_server::add_service(http_service *service)
     _service_map.emplace(service->path(), std::unique_ptr<http_service>(service));
 }
 
+// `field` of `url`, which refers to `url` unless it's percent-encoded, in which case it's
+// decoded into `decoded`
+static error_s get_url_field(const blob &url,
+                             const http_parser_url &u,
+                             http_parser_url_fields field,
+                             /*out*/ std::string &decoded,
+                             /*out*/ string_view &value)
+{
+    if (!(u.field_set & (1u << field))) {
+        value = string_view();
+        return error_s::ok();
+    }
+
+    value = string_view(url.data() + u.field_data[field].off, u.field_data[field].len);
+    if (std::find(value.begin(), value.end(), '%') != value.end()) {
+        decoded.assign(value.data(), value.size());
+        RETURN_NOT_OK(uri::decode_in_place(decoded));
+        value = decoded;
+    }
+    return error_s::ok();
+}
+
+// call `cb` with each of the pieces of `str` separated by `sep`
+template <typename Callback>
+static error_s for_each_piece(string_view str, char sep, Callback &&cb)
+{
+    const char *begin = str.data();
+    const char *end = str.data() + str.size();
+    while (true) {
+        const char *next = std::find(begin, end, sep);
+        RETURN_NOT_OK(cb(string_view(begin, next - begin)));
+        if (next == end) {
+            return error_s::ok();
+        }
+        begin = next + 1;
+    }
+}
+
 /*static*/ error_with<http_request> http_request::parse(message_ex *m)
 {
-    if (m->buffers.size() != 3) {
+    if (m->buffers.size() != 3 && m->buffers.size() != 4) {
         return error_s::make(ERR_INVALID_DATA,
                              std::string("buffer size is: ") + std::to_string(m->buffers.size()));
     }
@@ -93,111 +139,252 @@ void http_server::add_service(http_service *service)
     ret.body = m->buffers[1];
     ret.full_url = m->buffers[2];
     ret.method = static_cast<http_method>(m->header->hdr_type);
+    if (m->buffers.size() == 4) {
+        ret.if_none_match = m->buffers[3].to_string();
+    }
 
     http_parser_url u{0};
     http_parser_parse_url(ret.full_url.data(), ret.full_url.length(), false, &u);
 
-    std::string unresolved_path;
-    if (u.field_set & (1u << UF_PATH)) {
-        uint16_t data_length = u.field_data[UF_PATH].len;
-        unresolved_path.resize(data_length + 1);
-        strncpy(&unresolved_path[0], ret.full_url.data() + u.field_data[UF_PATH].off, data_length);
-        unresolved_path[data_length] = '\0';
-
-        // decode resolved path
-        auto decoded_unresolved_path = uri::decode(unresolved_path);
-        if (!decoded_unresolved_path.is_ok()) {
-            return decoded_unresolved_path.get_error();
-        }
-        unresolved_path = decoded_unresolved_path.get_value();
-    }
-
-    std::string unresolved_query;
-    if (u.field_set & (1u << UF_QUERY)) {
-        uint16_t data_length = u.field_data[UF_QUERY].len;
-        unresolved_query.resize(data_length);
-        strncpy(
-            &unresolved_query[0], ret.full_url.data() + u.field_data[UF_QUERY].off, data_length);
+    // the path and the query are parsed in a single pass over the url, without being copied
+    // unless they're percent-encoded
+    std::string decoded_path;
+    string_view path;
+    RETURN_NOT_OK(get_url_field(ret.full_url, u, UF_PATH, decoded_path, path));
+    std::string decoded_query;
+    string_view query;
+    RETURN_NOT_OK(get_url_field(ret.full_url, u, UF_QUERY, decoded_query, query));
 
-        // decode resolved query
-        auto decoded_unresolved_query = uri::decode(unresolved_query);
-        if (!decoded_unresolved_query.is_ok()) {
-            return decoded_unresolved_query.get_error();
+    // <service>/<method>, in which the empty segments are skipped
+    std::string &service = ret.service_method.first;
+    std::string &method = ret.service_method.second;
+    RETURN_NOT_OK(for_each_piece(path, '/', [&service, &method](string_view segment) {
+        if (segment.empty()) {
+            return error_s::ok();
         }
-        unresolved_query = decoded_unresolved_query.get_value();
-    }
-
-    // remove tailing '\0'
-    if (!unresolved_path.empty() && *unresolved_path.crbegin() == '\0') {
-        unresolved_path.pop_back();
-    }
-    std::vector<std::string> args;
-    boost::split(args, unresolved_path, boost::is_any_of("/"));
-    std::vector<std::string> real_args;
-    for (std::string &arg : args) {
-        if (!arg.empty()) {
-            real_args.emplace_back(std::move(arg));
-        }
-    }
-    if (real_args.size() == 0) {
-        ret.service_method = {"", ""};
-    } else if (real_args.size() == 1) {
-        ret.service_method = {std::move(real_args[0]), ""};
-    } else {
-        std::string method = std::move(real_args[1]);
-        for (int i = 2; i < real_args.size(); i++) {
-            method += '/';
-            method += real_args[i];
+        if (service.empty()) {
+            service.assign(segment.data(), segment.size());
+        } else {
+            if (!method.empty()) {
+                method += '/';
+            }
+            method.append(segment.data(), segment.size());
         }
-        ret.service_method = {std::move(real_args[0]), std::move(method)};
-    }
+        return error_s::ok();
+    }));
 
     // find if there are method args (<ip>:<port>/<service>/<method>?<arg>=<val>&<arg>=<val>)
-    if (!unresolved_query.empty()) {
-        std::vector<std::string> method_arg_val;
-        boost::split(method_arg_val, unresolved_query, boost::is_any_of("&"));
-        for (const std::string &arg_val : method_arg_val) {
-            size_t sep = arg_val.find_first_of('=');
-            if (sep == std::string::npos) {
+    if (!query.empty()) {
+        RETURN_NOT_OK(for_each_piece(query, '&', [&ret](string_view arg_val) {
+            const char *sep = std::find(arg_val.begin(), arg_val.end(), '=');
+            if (sep == arg_val.end()) {
                 // assume this as a bool flag
-                ret.query_args.emplace(arg_val, "");
-                continue;
-            }
-            std::string name = arg_val.substr(0, sep);
-            std::string value;
-            if (sep + 1 < arg_val.size()) {
-                value = arg_val.substr(sep + 1, arg_val.size() - sep);
+                ret.query_args.emplace(std::string(arg_val.data(), arg_val.size()), "");
+                return error_s::ok();
             }
-            auto iter = ret.query_args.find(name);
-            if (iter != ret.query_args.end()) {
+            std::string name(arg_val.data(), sep - arg_val.data());
+            if (ret.query_args.find(name) != ret.query_args.end()) {
                 return FMT_ERR(ERR_INVALID_PARAMETERS, "duplicate parameter: {}", name);
             }
-            ret.query_args.emplace(std::move(name), std::move(value));
-        }
+            ret.query_args.emplace(std::move(name), std::string(sep + 1, arg_val.end()));
+            return error_s::ok();
+        }));
     }
 
     return ret;
 }
 
+std::string http_response::full_body() const
+{
+    std::string ret = body;
+    for (const blob &chunk : body_chunks) {
+        ret.append(chunk.data(), chunk.length());
+    }
+    return ret;
+}
+
 message_ptr http_response::to_message(message_ex *req) const
 {
     message_ptr resp = req->create_response();
 
-    std::ostringstream os;
-    os << "HTTP/1.1 " << http_status_code_to_string(status_code) << "\r\n";
-    os << "Content-Type: " << content_type << "\r\n";
-    os << "Content-Length: " << body.length() << "\r\n";
+    // the connection is always kept alive, so that the clients polling the same server can
+    // reuse it, rather than paying for a connection per request
+    std::string header = fmt::format("HTTP/1.1 {}\r\nContent-Type: {}\r\n",
+                                     http_status_code_to_string(status_code),
+                                     content_type);
+    header += "Connection: keep-alive\r\n";
+    if (body_chunks.empty()) {
+        header += fmt::format("Content-Length: {}\r\n", body.length());
+    } else {
+        header += "Transfer-Encoding: chunked\r\n";
+    }
     if (!location.empty()) {
-        os << "Location: " << location << "\r\n";
+        header += fmt::format("Location: {}\r\n", location);
+    }
+    if (!etag.empty()) {
+        header += fmt::format("ETag: {}\r\n", etag);
     }
-    os << "\r\n";
-    os << body;
+    header += "\r\n";
 
     rpc_write_stream writer(resp.get());
-    writer.write(os.str().data(), os.str().length());
+    writer.write(header.data(), header.length());
+    if (body_chunks.empty()) {
+        writer.write(body.data(), body.length());
+    } else {
+        // an empty chunk marks the end of the body, so the empty ones are skipped
+        auto write_chunk_size = [&writer](size_t length) {
+            std::string size_line = fmt::format("{:x}\r\n", length);
+            writer.write(size_line.data(), size_line.length());
+        };
+        if (!body.empty()) {
+            write_chunk_size(body.length());
+            writer.write(body.data(), body.length());
+            writer.write("\r\n", 2);
+        }
+        for (const blob &chunk : body_chunks) {
+            if (chunk.length() > 0) {
+                write_chunk_size(chunk.length());
+                writer.write_shared(chunk);
+                writer.write("\r\n", 2);
+            }
+        }
+        writer.write("0\r\n\r\n", 5);
+    }
     writer.flush();
 
     return resp;
 }
 
+// whether `if_none_match`, i.e. "*" or a list of the ETags, matches `etag`
+static bool etag_matches(const std::string &if_none_match, const std::string &etag)
+{
+    bool matched = false;
+    for_each_piece(if_none_match, ',', [&matched, &etag](string_view tag) {
+        while (!tag.empty() && tag.front() == ' ') {
+            tag.remove_prefix(1);
+        }
+        while (!tag.empty() && tag.back() == ' ') {
+            tag.remove_suffix(1);
+        }
+        // the weak comparison, as the responses aren't sent in ranges
+        if (tag.size() >= 2 && tag[0] == 'W' && tag[1] == '/') {
+            tag.remove_prefix(2);
+        }
+        if (tag == "*" || tag == etag) {
+            matched = true;
+        }
+        return error_s::ok();
+    });
+    return matched;
+}
+
+void http_response_cache::call(const http_request &req, http_response &resp)
+{
+    int64_t version = _version();
+    if (version < 0) {
+        _cb(req, resp);
+        return;
+    }
+
+    // the query args are in no order, and a value may contain any character
+    std::map<std::string, std::string> args(req.query_args.begin(), req.query_args.end());
+    std::string key;
+    for (const auto &arg : args) {
+        key.append(arg.first).append(1, '\0').append(arg.second).append(1, '\0');
+    }
+
+    bool cached = true;
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        auto iter = _entries.find(key);
+        if (iter != _entries.end()) {
+            entry &e = iter->second;
+            if (e.version == version || (e.building && !e.etag.empty())) {
+                reply(req, e, resp);
+                return;
+            }
+            if (e.building) {
+                cached = false;
+            } else {
+                e.building = true;
+            }
+        } else if (_entries.size() < MAX_CACHED_QUERIES) {
+            _entries[key].building = true;
+        } else {
+            cached = false;
+        }
+    }
+
+    // built without the lock, the version is taken before, so the response is never newer
+    // than its version
+    _cb(req, resp);
+    if (!cached) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> l(_lock);
+    entry &e = _entries[key];
+    e.building = false;
+    if (resp.status_code != http_status_code::ok) {
+        return;
+    }
+    std::string body = resp.full_body();
+    e.version = version;
+    e.content_type = resp.content_type;
+    e.etag = fmt::format("\"{:x}-{:x}\"", body.length(), std::hash<std::string>()(body));
+    e.body = blob::create_from_bytes(std::move(body));
+    reply(req, e, resp);
+}
+
+/*static*/ void
+http_response_cache::reply(const http_request &req, const entry &e, http_response &resp)
+{
+    resp.status_code = http_status_code::ok;
+    resp.content_type = e.content_type;
+    resp.etag = e.etag;
+    resp.body.clear();
+    resp.body_chunks.clear();
+    if (!req.if_none_match.empty() && etag_matches(req.if_none_match, e.etag)) {
+        resp.status_code = http_status_code::not_modified;
+        return;
+    }
+    // shared by the responses rather than copied
+    resp.body_chunks.push_back(e.body);
+}
+
+http_body_stream::http_body_stream(http_response &resp, size_t chunk_bytes)
+    : std::ostream(nullptr), _buf(resp.body_chunks, chunk_bytes)
+{
+    rdbuf(&_buf);
+}
+
+http_body_stream::~http_body_stream() { _buf.write_chunk(); }
+
+http_body_stream::chunk_buf::chunk_buf(std::vector<blob> &chunks, size_t chunk_bytes)
+    : _chunks(chunks), _chunk_bytes(std::max(chunk_bytes, (size_t)1))
+{
+}
+
+http_body_stream::chunk_buf::int_type http_body_stream::chunk_buf::overflow(int_type c)
+{
+    write_chunk();
+    _buffer = utils::make_shared_array<char>(_chunk_bytes);
+    setp(_buffer.get(), _buffer.get() + _chunk_bytes);
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+void http_body_stream::chunk_buf::write_chunk()
+{
+    if (pptr() != pbase()) {
+        _chunks.emplace_back(_buffer, 0, static_cast<unsigned int>(pptr() - pbase()));
+        // the rest of the buffer is not reused, as it's shared with the chunk
+        _buffer.reset();
+        setp(nullptr, nullptr);
+    }
+}
+
 } // namespace dsn
@@ -0,0 +1,260 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <cmath>
+
+#include <dsn/c/api_layer1.h>
+#include <dsn/utility/flags.h>
+#include "metrics_http_service.h"
+
+namespace dsn {
+
+DSN_DEFINE_uint32("http",
+                  metrics_snapshot_interval_seconds,
+                  10,
+                  "the min interval to refresh the snapshot of perf counters for /metrics");
+
+namespace {
+
+// a metric name matches [a-zA-Z_:][a-zA-Z0-9_:]*, the other characters are replaced with '_'
+// and the repeated or trailing '_' are removed
+void append_metric_name(const std::string &name, std::string &out)
+{
+    size_t begin = out.size();
+    for (char c : name) {
+        if (!isalnum(static_cast<unsigned char>(c)) && c != ':') {
+            c = '_';
+        }
+        if (c == '_' && (out.size() == begin || out.back() == '_')) {
+            continue;
+        }
+        if (out.size() == begin && isdigit(static_cast<unsigned char>(c))) {
+            out.push_back('_');
+        }
+        out.push_back(c);
+    }
+    while (out.size() > begin && out.back() == '_') {
+        out.pop_back();
+    }
+}
+
+void append_label(const char *name, const std::string &value, bool &first, std::string &out)
+{
+    if (value.empty()) {
+        return;
+    }
+    out.append(first ? "{" : ",");
+    first = false;
+    out.append(name);
+    out.append("=\"");
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (c == '\n') {
+            out.append("\\n");
+        } else {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+}
+
+void append_value(double value, std::string &out)
+{
+    char buf[32];
+    if (std::isnan(value)) {
+        out.append("NaN");
+    } else if (std::isinf(value)) {
+        out.append(value > 0 ? "+Inf" : "-Inf");
+    } else if (std::fabs(value) < 1e15 && value == std::floor(value)) {
+        snprintf(buf, sizeof(buf), "%" PRId64, static_cast<int64_t>(value));
+        out.append(buf);
+    } else {
+        snprintf(buf, sizeof(buf), "%.9g", value);
+        out.append(buf);
+    }
+}
+
+bool is_number(const std::string &s)
+{
+    return !s.empty() && std::all_of(s.begin(), s.end(), [](char c) {
+        return isdigit(static_cast<unsigned char>(c));
+    });
+}
+
+bool match(const std::string &filter, const std::string &value)
+{
+    return filter.empty() || filter == value;
+}
+
+} // anonymous namespace
+
+/*static*/ void metrics_http_service::parse_counter_name(const std::string &full_name,
+                                                         /*out*/ std::string &family,
+                                                         /*out*/ metric_labels &labels)
+{
+    family.clear();
+    labels = metric_labels();
+
+    // full_name = <app>*<section>*<name>
+    size_t app_end = full_name.find('*');
+    size_t section_end = app_end == std::string::npos ? app_end : full_name.find('*', app_end + 1);
+    if (section_end == std::string::npos) {
+        append_metric_name(full_name, family);
+        return;
+    }
+    labels.service = full_name.substr(0, app_end);
+
+    std::string name = full_name.substr(app_end + 1, section_end - app_end - 1);
+    name.push_back('_');
+    name.append(full_name, section_end + 1, std::string::npos);
+
+    // name = <name>@<gpid> or <name>@<table>
+    size_t at = name.rfind('@');
+    if (at != std::string::npos) {
+        std::string suffix = name.substr(at + 1);
+        name.resize(at);
+        size_t dot = suffix.find('.');
+        if (dot != std::string::npos && is_number(suffix.substr(0, dot)) &&
+            is_number(suffix.substr(dot + 1))) {
+            labels.app_id = suffix.substr(0, dot);
+            labels.partition = suffix.substr(dot + 1);
+        } else {
+            labels.table = std::move(suffix);
+        }
+    }
+    append_metric_name(name, family);
+}
+
+/*static*/ void metrics_http_service::write_exposition(
+    const std::vector<const perf_counters::counter_snapshot *> &counters,
+    const metric_labels &filter,
+    /*out*/ std::string &out)
+{
+    struct sample
+    {
+        std::string family;
+        metric_labels labels;
+        const char *quantile;
+        const perf_counters::counter_snapshot *counter;
+    };
+
+    static const std::string p999_suffix = ".p999";
+    std::vector<sample> samples;
+    samples.reserve(counters.size());
+    for (const perf_counters::counter_snapshot *cs : counters) {
+        sample s;
+        s.counter = cs;
+        s.quantile = nullptr;
+        const std::string *name = &cs->name;
+        std::string stripped;
+        if (cs->type == COUNTER_TYPE_NUMBER_PERCENTILES || cs->type == COUNTER_TYPE_HISTOGRAM) {
+            // the snapshot keeps P99 as "<name>" and P999 as "<name>.p999"
+            s.quantile = "0.99";
+            size_t suffix_pos = name->size() - p999_suffix.size();
+            if (name->size() > p999_suffix.size() &&
+                name->compare(suffix_pos, p999_suffix.size(), p999_suffix) == 0) {
+                stripped = name->substr(0, suffix_pos);
+                name = &stripped;
+                s.quantile = "0.999";
+            }
+        }
+        parse_counter_name(*name, s.family, s.labels);
+        if (!match(filter.app_id, s.labels.app_id) ||
+            !match(filter.partition, s.labels.partition) || !match(filter.table, s.labels.table)) {
+            continue;
+        }
+        samples.emplace_back(std::move(s));
+    }
+
+    // the samples of a metric family must be contiguous
+    std::stable_sort(samples.begin(), samples.end(), [](const sample &a, const sample &b) {
+        return a.family < b.family;
+    });
+
+    const std::string *last_family = nullptr;
+    for (const sample &s : samples) {
+        if (last_family == nullptr || *last_family != s.family) {
+            out.append("# TYPE ");
+            out.append(s.family);
+            out.append(s.quantile != nullptr ? " summary\n" : " gauge\n");
+            last_family = &s.family;
+        }
+        out.append(s.family);
+        bool first = true;
+        append_label("service", s.labels.service, first, out);
+        append_label("app_id", s.labels.app_id, first, out);
+        append_label("partition", s.labels.partition, first, out);
+        append_label("table", s.labels.table, first, out);
+        if (s.quantile != nullptr) {
+            append_label("quantile", s.quantile, first, out);
+        }
+        if (!first) {
+            out.push_back('}');
+        }
+        out.push_back(' ');
+        append_value(s.counter->value, out);
+        out.push_back('\n');
+    }
+    out.append("# EOF\n");
+}
+
+void metrics_http_service::refresh_snapshot()
+{
+    uint64_t now_ms = dsn_now_ms();
+    if (_last_snapshot_ms == 0 ||
+        now_ms >= _last_snapshot_ms + FLAGS_metrics_snapshot_interval_seconds * 1000) {
+        perf_counters::instance().take_snapshot();
+        _last_snapshot_ms = now_ms;
+    }
+}
+
+void metrics_http_service::get_metrics_handler(const http_request &req, http_response &resp)
+{
+    metric_labels filter;
+    for (const auto &p : req.query_args) {
+        if ("app_id" == p.first) {
+            filter.app_id = p.second;
+        } else if ("partition" == p.first) {
+            filter.partition = p.second;
+        } else if ("table" == p.first) {
+            filter.table = p.second;
+        } else {
+            resp.status_code = http_status_code::bad_request;
+            resp.body = "invalid argument: " + p.first;
+            resp.body_chunks.clear();
+            return;
+        }
+    }
+    std::string filter_key = filter.app_id + "\n" + filter.partition + "\n" + filter.table;
+
+    resp.content_type = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+    resp.status_code = http_status_code::ok;
+
+    // the exposition is sent as a chunk of the response, so that the cached one is shared by the
+    // responses rather than copied into each of them
+    resp.body.clear();
+    utils::auto_lock<utils::ex_lock_nr> l(_lock);
+    refresh_snapshot();
+    uint64_t version = perf_counters::instance().snapshot_version();
+    if (version != _cached_version || filter_key != _cached_filter) {
+        std::string exposition;
+        exposition.reserve(_cached_exposition.length());
+        perf_counters::instance().visit_snapshot(
+            [&filter, &exposition](
+                const std::vector<const perf_counters::counter_snapshot *> &counters) {
+                write_exposition(counters, filter, exposition);
+            });
+        _cached_version = version;
+        _cached_filter = std::move(filter_key);
+        _cached_exposition = blob::create_from_bytes(std::move(exposition));
+    }
+    resp.body_chunks.assign(1, _cached_exposition);
+}
+
+} // namespace dsn
@@ -0,0 +1,75 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <dsn/perf_counter/perf_counters.h>
+#include <dsn/tool-api/http_server.h>
+#include <dsn/utility/synchronize.h>
+
+namespace dsn {
+
+///
+/// metrics_http_service exposes the perf counters in the OpenMetrics text format:
+///
+///   ip:port/metrics[?app_id={app_id}][&partition={partition_index}][&table={table_name}]
+///
+/// A counter "<app>*<section>*<name>@<suffix>" is exposed as the metric family
+/// "<section>_<name>" with the label service="<app>", and the suffix is parsed into labels
+/// app_id/partition if it is a gpid, or table otherwise. The query args filter the counters by
+/// these labels.
+///
+/// The exposition is written directly from the snapshot of perf_counters, which is refreshed at
+/// most once every [http] metrics_snapshot_interval_seconds, and the exposition is cached until
+/// the snapshot changes, so that the scrapes in between cost nothing but a copy.
+///
+class metrics_http_service : public http_service
+{
+public:
+    metrics_http_service()
+    {
+        register_handler("",
+                         std::bind(&metrics_http_service::get_metrics_handler,
+                                   this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2),
+                         "ip:port/metrics[?app_id={app_id}][&partition={partition_index}]"
+                         "[&table={table_name}]");
+    }
+
+    std::string path() const override { return "metrics"; }
+
+    void get_metrics_handler(const http_request &req, http_response &resp);
+
+    struct metric_labels
+    {
+        std::string service;
+        std::string app_id;
+        std::string partition;
+        std::string table;
+    };
+
+    // parse the full name of a counter into its metric family and labels
+    static void parse_counter_name(const std::string &full_name,
+                                   /*out*/ std::string &family,
+                                   /*out*/ metric_labels &labels);
+
+    // write the exposition of all the counters in `counters` which match `filter` into `out`,
+    // an empty field of `filter` matches any value
+    static void
+    write_exposition(const std::vector<const perf_counters::counter_snapshot *> &counters,
+                     const metric_labels &filter,
+                     /*out*/ std::string &out);
+
+private:
+    void refresh_snapshot();
+
+    utils::ex_lock_nr _lock; // protect the fields below
+    uint64_t _last_snapshot_ms{0};
+    uint64_t _cached_version{0};
+    std::string _cached_filter;
+    blob _cached_exposition;
+};
+
+} // namespace dsn
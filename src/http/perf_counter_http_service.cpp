@@ -3,17 +3,25 @@
 // can be found in the LICENSE file in the root directory of this source tree.
 
 #include <dsn/utility/output_utils.h>
+#include <dsn/utility/string_conv.h>
+#include <dsn/utility/strings.h>
 #include "perf_counter_http_service.h"
 
+#include <algorithm>
+
 namespace dsn {
 
 void perf_counter_http_service::get_perf_counter_handler(const http_request &req,
                                                          http_response &resp)
 {
     std::string perf_counter_name;
+    // extra quantiles to query, only valid for COUNTER_TYPE_HISTOGRAM
+    std::vector<std::string> quantiles;
     for (const auto &p : req.query_args) {
         if ("name" == p.first) {
             perf_counter_name = p.second;
+        } else if ("quantiles" == p.first) {
+            utils::split_args(p.second.c_str(), quantiles, ',');
         } else {
             resp.status_code = http_status_code::bad_request;
             return;
@@ -30,6 +38,25 @@ void perf_counter_http_service::get_perf_counter_handler(const http_request &req
         if (COUNTER_TYPE_NUMBER_PERCENTILES == perf_counter->type()) {
             tp.add_row_name_and_data("p99", perf_counter->get_percentile(COUNTER_PERCENTILE_99));
             tp.add_row_name_and_data("p999", perf_counter->get_percentile(COUNTER_PERCENTILE_999));
+        } else if (COUNTER_TYPE_HISTOGRAM == perf_counter->type()) {
+            histogram_snapshot snapshot;
+            perf_counter->get_histogram_snapshot(snapshot);
+            tp.add_row_name_and_data("count", snapshot.count());
+            tp.add_row_name_and_data("mean", snapshot.mean());
+            for (int i = 0; i < COUNTER_PERCENTILE_COUNT; ++i) {
+                auto type = static_cast<dsn_perf_counter_percentile_type_t>(i);
+                std::string row_name = dsn_percentile_type_to_string(type);
+                std::transform(row_name.begin(), row_name.end(), row_name.begin(), ::tolower);
+                tp.add_row_name_and_data(row_name, perf_counter->get_percentile(type));
+            }
+            for (const std::string &q : quantiles) {
+                double quantile;
+                if (!buf2double(q, quantile) || quantile < 0.0 || quantile > 1.0) {
+                    resp.status_code = http_status_code::bad_request;
+                    return;
+                }
+                tp.add_row_name_and_data("q" + q, (double)snapshot.quantile(quantile));
+            }
         } else {
             tp.add_row_name_and_data("value", perf_counter->get_value());
         }
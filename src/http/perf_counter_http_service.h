@@ -18,7 +18,7 @@ public:
                                    this,
                                    std::placeholders::_1,
                                    std::placeholders::_2),
-                         "ip:port/perfCounter?name={perf_counter_name}");
+                         "ip:port/perfCounter?name={perf_counter_name}[&quantiles={q1,q2,...}]");
     }
 
     std::string path() const override { return "perfCounter"; }
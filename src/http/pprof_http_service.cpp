@@ -356,6 +356,13 @@ void pprof_http_service::heap_handler(const http_request &req, http_response &re
     _in_pprof_action.store(false);
 }
 
+/*static*/ bool pprof_http_service::get_heap_sample(std::string &profile)
+{
+    profile.clear();
+    MallocExtension::instance()->GetHeapSample(&profile);
+    return !profile.empty();
+}
+
 //                             //
 // == ip:port/pprof/cmdline == //
 //                             //
@@ -463,6 +470,12 @@ static bool get_cpu_profile(std::string &result, useconds_t seconds)
 
 void pprof_http_service::profile_handler(const http_request &req, http_response &resp)
 {
+    if (_continuous_profiler != nullptr) {
+        resp.status_code = http_status_code::internal_server_error;
+        resp.body = "the continuous cpu profiler is running, please use /pprof/continuous instead";
+        return;
+    }
+
     bool in_pprof = false;
     if (!_in_pprof_action.compare_exchange_strong(in_pprof, true)) {
         dwarn_f("node is already exectuting pprof action, please wait and retry");
@@ -496,6 +509,56 @@ void pprof_http_service::profile_handler(const http_request &req, http_response
     _in_pprof_action.store(false);
 }
 
+//                                //
+// == ip:port/pprof/continuous == //
+//                                //
+
+bool pprof_http_service::get_continuous_profile_minutes(const http_request &req,
+                                                        http_response &resp,
+                                                        /*out*/ int &minutes)
+{
+    if (_continuous_profiler == nullptr) {
+        resp.status_code = http_status_code::bad_request;
+        resp.body = "the continuous cpu profiler is disabled, please set "
+                    "[pprof] enable_continuous_cpu_profile = true";
+        return false;
+    }
+
+    minutes = 5;
+    for (const auto &p : req.query_args) {
+        if (p.first != "minutes" || !dsn::buf2int32(p.second, minutes) || minutes <= 0) {
+            resp.status_code = http_status_code::bad_request;
+            resp.body = "invalid argument: " + p.first + "=" + p.second;
+            return false;
+        }
+    }
+    return true;
+}
+
+void pprof_http_service::continuous_profile_handler(const http_request &req, http_response &resp)
+{
+    int minutes;
+    if (!get_continuous_profile_minutes(req, resp, minutes)) {
+        return;
+    }
+    if (!_continuous_profiler->get_profile(minutes, resp.body)) {
+        resp.status_code = http_status_code::internal_server_error;
+        resp.body = "the continuous cpu profiles are corrupted";
+        return;
+    }
+    resp.status_code = http_status_code::ok;
+}
+
+void pprof_http_service::continuous_tasks_handler(const http_request &req, http_response &resp)
+{
+    int minutes;
+    if (!get_continuous_profile_minutes(req, resp, minutes)) {
+        return;
+    }
+    resp.body = _continuous_profiler->get_task_samples(minutes);
+    resp.status_code = http_status_code::ok;
+}
+
 } // namespace dsn
 
 #endif // DSN_ENABLE_GPERF
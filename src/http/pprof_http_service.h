@@ -8,6 +8,8 @@
 
 #include <dsn/tool-api/http_server.h>
 
+#include "continuous_cpu_profiler.h"
+
 namespace dsn {
 
 class pprof_http_service : public http_service
@@ -45,10 +47,29 @@ public:
                                    std::placeholders::_1,
                                    std::placeholders::_2),
                          "ip:port/pprof/profile");
+        register_handler("continuous",
+                         std::bind(&pprof_http_service::continuous_profile_handler,
+                                   this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2),
+                         "ip:port/pprof/continuous[?minutes={minutes}]");
+        register_handler("continuous_tasks",
+                         std::bind(&pprof_http_service::continuous_tasks_handler,
+                                   this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2),
+                         "ip:port/pprof/continuous_tasks[?minutes={minutes}]");
+
+        _continuous_profiler = continuous_cpu_profiler::create_if_enabled();
     }
 
     std::string path() const override { return "pprof"; }
 
+    // the sampled heap profile of this process at once, in the same format as /pprof/heap, it
+    // requires the sampling of tcmalloc enabled by TCMALLOC_SAMPLE_PARAMETER
+    // return false if nothing is sampled
+    static bool get_heap_sample(/*out*/ std::string &profile);
+
     void heap_handler(const http_request &req, http_response &resp);
 
     void symbol_handler(const http_request &req, http_response &resp);
@@ -59,8 +80,20 @@ public:
 
     void profile_handler(const http_request &req, http_response &resp);
 
+    // the merged profile of the continuous cpu profiler in the last minutes
+    void continuous_profile_handler(const http_request &req, http_response &resp);
+
+    // the sample counts of each task code of the continuous cpu profiler in the last minutes
+    void continuous_tasks_handler(const http_request &req, http_response &resp);
+
 private:
+    // return false if the continuous cpu profiler is disabled or the args are invalid
+    bool get_continuous_profile_minutes(const http_request &req,
+                                        http_response &resp,
+                                        /*out*/ int &minutes);
+
     std::atomic_bool _in_pprof_action{false};
+    std::unique_ptr<continuous_cpu_profiler> _continuous_profiler;
 };
 
 } // namespace dsn
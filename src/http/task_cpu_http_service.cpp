@@ -0,0 +1,26 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/tool-api/task_cpu_accounting.h>
+#include <dsn/utility/string_conv.h>
+#include "task_cpu_http_service.h"
+
+namespace dsn {
+
+void task_cpu_http_service::get_task_cpu_handler(const http_request &req, http_response &resp)
+{
+    int32_t top = 20;
+    for (const auto &p : req.query_args) {
+        if ("top" == p.first && buf2int32(p.second, top) && top >= 0) {
+            continue;
+        }
+        resp.status_code = http_status_code::bad_request;
+        return;
+    }
+
+    resp.body = task_cpu_accounting::instance().get_usage_report(top, true);
+    resp.status_code = http_status_code::ok;
+}
+
+} // namespace dsn
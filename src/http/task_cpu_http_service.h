@@ -0,0 +1,31 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <dsn/tool-api/http_server.h>
+
+namespace dsn {
+
+// the cpu time consumed by each app, and by the top partitions and task codes, recorded by
+// task_cpu_accounting
+class task_cpu_http_service : public http_service
+{
+public:
+    task_cpu_http_service()
+    {
+        register_handler("",
+                         std::bind(&task_cpu_http_service::get_task_cpu_handler,
+                                   this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2),
+                         "ip:port/taskCpu[?top={count}]");
+    }
+
+    std::string path() const override { return "taskCpu"; }
+
+    void get_task_cpu_handler(const http_request &req, http_response &resp);
+};
+
+} // namespace dsn
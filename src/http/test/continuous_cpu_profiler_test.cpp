@@ -0,0 +1,48 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+#include <http/continuous_cpu_profiler.h>
+
+namespace dsn {
+
+static std::string make_profile(const std::vector<std::vector<uintptr_t>> &samples,
+                                const std::string &maps)
+{
+    std::vector<uintptr_t> words = {0, 3, 0, 100000, 0};
+    for (const auto &s : samples) {
+        words.insert(words.end(), s.begin(), s.end());
+    }
+    words.insert(words.end(), {0, 1, 0});
+    return std::string(reinterpret_cast<const char *>(words.data()),
+                       words.size() * sizeof(uintptr_t)) +
+           maps;
+}
+
+TEST(continuous_cpu_profiler_test, merge_cpu_profiles)
+{
+    std::string p1 = make_profile({{3, 2, 0x10, 0x20}, {1, 1, 0x30}}, "maps1\n");
+    std::string p2 = make_profile({{5, 3, 0x40, 0x50, 0x60}}, "maps2\n");
+
+    std::string merged;
+    ASSERT_TRUE(merge_cpu_profiles({p1, p2}, merged));
+    ASSERT_EQ(make_profile({{3, 2, 0x10, 0x20}, {1, 1, 0x30}, {5, 3, 0x40, 0x50, 0x60}},
+                           "maps2\n"),
+              merged);
+
+    ASSERT_TRUE(merge_cpu_profiles({p1}, merged));
+    ASSERT_EQ(p1, merged);
+
+    ASSERT_TRUE(merge_cpu_profiles({}, merged));
+    ASSERT_TRUE(merged.empty());
+
+    // corrupted profiles
+    ASSERT_FALSE(merge_cpu_profiles({p1.substr(0, 3 * sizeof(uintptr_t))}, merged));
+    ASSERT_FALSE(merge_cpu_profiles({p1.substr(0, 8 * sizeof(uintptr_t))}, merged));
+    std::string bad_header = p1;
+    bad_header[sizeof(uintptr_t)] = 4;
+    ASSERT_FALSE(merge_cpu_profiles({p2, bad_header}, merged));
+}
+
+} // namespace dsn
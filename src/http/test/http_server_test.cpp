@@ -3,6 +3,7 @@
 // can be found in the LICENSE file in the root directory of this source tree.
 
 #include <dsn/tool-api/http_server.h>
+#include <fmt/format.h>
 #include <gtest/gtest.h>
 
 #include "http/http_message_parser.h"
@@ -29,6 +30,8 @@ TEST(http_server, parse_url)
         {"http://127.0.0.1:34601//pprof///heap", ERR_OK, {"pprof", "heap"}},
         {"http://127.0.0.1:34601/pprof/heap/arg/", ERR_OK, {"pprof", "heap/arg"}},
         {"http://127.0.0.1:34601/pprof///heap///arg/", ERR_OK, {"pprof", "heap/arg"}},
+        {"http://127.0.0.1:34601/pprof%2Fheap%2F%2Farg", ERR_OK, {"pprof", "heap/arg"}},
+        {"http://127.0.0.1:34601/pprof%2", ERR_INVALID_PARAMETERS, {}},
     };
 
     for (auto tt : tests) {
@@ -85,8 +88,8 @@ public:
         ASSERT_EQ(msg, nullptr);
         ASSERT_EQ(parser._stage, HTTP_ON_URL); // url parsed
         ASSERT_EQ(parser._parsed_length, http_request.size());
-        ASSERT_EQ(parser._url, "/");
         ASSERT_NE(parser._current_message, nullptr);
+        ASSERT_EQ(parser._current_message->buffers[2].to_string(), "/");
         ASSERT_NE(read_next, -1);
 
         // normal request
@@ -174,6 +177,31 @@ TEST_F(http_message_parser_test, parse_request)
         std::string("/path/file.html?sdfsdf=sdfs&sldf1=sdf"));
 }
 
+TEST_F(http_message_parser_test, parse_if_none_match)
+{
+    std::string http_request = "GET /meta/apps HTTP/1.1\r\n"
+                               "Host: myhost\r\n"
+                               "if-none-match: \"5-abc\"\r\n"
+                               "\r\n";
+
+    message_reader reader(64);
+    char *buf = reader.read_buffer_ptr(http_request.size());
+    memcpy(buf, http_request.data(), http_request.size());
+    reader.mark_read(http_request.size());
+
+    http_message_parser parser;
+    int read_next = 0;
+    message_ptr msg = parser.get_message_on_receive(&reader, read_next);
+    ASSERT_NE(msg, nullptr);
+    ASSERT_EQ(msg->buffers.size(), 4);
+
+    auto res = http_request::parse(msg.get());
+    ASSERT_TRUE(res.is_ok());
+    std::pair<std::string, std::string> service_method("meta", "apps");
+    ASSERT_EQ(res.get_value().service_method, service_method);
+    ASSERT_EQ(res.get_value().if_none_match, "\"5-abc\"");
+}
+
 TEST_F(http_message_parser_test, eof)
 {
     std::string http_request =
@@ -231,6 +259,40 @@ TEST_F(http_message_parser_test, parse_bad_request) { parse_bad_request(); }
 
 TEST_F(http_message_parser_test, parse_multiple_requests) { parse_multiple_requests(); }
 
+TEST_F(http_message_parser_test, parse_request_in_several_reads)
+{
+    // a request may be received in several reads on a keep-alive connection
+    std::vector<std::string> pieces = {"POST /pa",
+                                       "th HTTP/1.1\r\nHost: myhost\r\nContent-Len",
+                                       "gth: 11\r\n\r\nhello ",
+                                       "worldGET / HTTP/1.1\r\n\r\n"};
+
+    message_reader reader(64);
+    http_message_parser parser;
+    int read_next = 0;
+    std::vector<message_ptr> msgs;
+    for (const std::string &piece : pieces) {
+        char *buf = reader.read_buffer_ptr(piece.size());
+        memcpy(buf, piece.data(), piece.size());
+        reader.mark_read(piece.size());
+
+        message_ex *msg = nullptr;
+        while ((msg = parser.get_message_on_receive(&reader, read_next)) != nullptr) {
+            msgs.emplace_back(msg);
+        }
+        ASSERT_NE(read_next, -1);
+        ASSERT_EQ(reader._buffer_occupied, 0);
+    }
+
+    ASSERT_EQ(msgs.size(), 2);
+    ASSERT_EQ(msgs[0]->header->hdr_type, http_method::HTTP_METHOD_POST);
+    ASSERT_EQ(msgs[0]->buffers[1].to_string(), "hello world"); // body
+    ASSERT_EQ(msgs[0]->header->body_length, 11);
+    ASSERT_EQ(msgs[0]->buffers[2].to_string(), "/path"); // url
+    ASSERT_EQ(msgs[1]->header->hdr_type, http_method::HTTP_METHOD_GET);
+    ASSERT_EQ(msgs[1]->buffers[2].to_string(), "/");
+}
+
 TEST_F(http_message_parser_test, parse_long_url)
 {
     std::string http_request = "GET /" + std::string(4096, 'a') + " HTTP/1.1\r\n\r\n";
@@ -273,6 +335,12 @@ TEST_F(http_message_parser_test, parse_query_params)
         {"http://127.0.0.1:34601?query1=value1&query2",
          ERR_OK,
          {{"query1", "value1"}, {"query2", ""}}},
+
+        {"http://127.0.0.1:34601?query1=value%3D1%26query2%3Dvalue2",
+         ERR_OK,
+         {{"query1", "value=1"}, {"query2", "value2"}}},
+
+        {"http://127.0.0.1:34601?query1=value1&query1=value2", ERR_INVALID_PARAMETERS, {}},
     };
 
     for (auto tt : tests) {
@@ -289,4 +357,125 @@ TEST_F(http_message_parser_test, parse_query_params)
     }
 }
 
-} // namespace dsn
+TEST(http_server, chunked_response)
+{
+    std::string http_request = "GET / HTTP/1.1\r\n\r\n";
+    message_reader reader(64);
+    char *buf = reader.read_buffer_ptr(http_request.size());
+    memcpy(buf, http_request.data(), http_request.size());
+    reader.mark_read(http_request.size());
+    http_message_parser parser;
+    int read_next = 0;
+    message_ptr req = parser.get_message_on_receive(&reader, read_next);
+    ASSERT_NE(req, nullptr);
+
+    auto to_string = [](const message_ptr &msg) {
+        std::string ret;
+        for (const blob &b : msg->buffers) {
+            ret.append(b.data(), b.length());
+        }
+        // skip the message header, as http_message_parser does on sending
+        return ret.substr(sizeof(message_header));
+    };
+
+    http_response resp;
+    resp.body = "hello";
+    ASSERT_EQ("HTTP/1.1 200 OK\r\n"
+              "Content-Type: text/plain\r\n"
+              "Connection: keep-alive\r\n"
+              "Content-Length: 5\r\n"
+              "\r\n"
+              "hello",
+              to_string(resp.to_message(req.get())));
+
+    {
+        // the stream cuts the body into chunks of 4 bytes
+        http_body_stream out(resp, 4);
+        out << " world" << std::endl << "!";
+    }
+    ASSERT_EQ(2, resp.body_chunks.size());
+    ASSERT_EQ("hello world\n!", resp.full_body());
+    ASSERT_EQ("HTTP/1.1 200 OK\r\n"
+              "Content-Type: text/plain\r\n"
+              "Connection: keep-alive\r\n"
+              "Transfer-Encoding: chunked\r\n"
+              "\r\n"
+              "5\r\nhello\r\n"
+              "4\r\n wor\r\n"
+              "4\r\nld\n!\r\n"
+              "0\r\n\r\n",
+              to_string(resp.to_message(req.get())));
+}
+
+TEST(http_server, response_cache)
+{
+    int64_t version = 1;
+    int calls = 0;
+    http_response_cache cache([&version]() { return version; },
+                              [&calls](const http_request &req, http_response &resp) {
+                                  calls++;
+                                  if (req.query_args.count("bad") > 0) {
+                                      resp.status_code = http_status_code::bad_request;
+                                      return;
+                                  }
+                                  resp.body = fmt::format("call {}", calls);
+                              });
+    auto call = [&cache](const http_request &req) {
+        http_response resp;
+        cache.call(req, resp);
+        return resp;
+    };
+
+    http_request req;
+    http_response resp = call(req);
+    ASSERT_EQ(resp.status_code, http_status_code::ok);
+    ASSERT_EQ(resp.full_body(), "call 1");
+    ASSERT_FALSE(resp.etag.empty());
+    std::string etag = resp.etag;
+
+    // reused until the version changes
+    resp = call(req);
+    ASSERT_EQ(calls, 1);
+    ASSERT_EQ(resp.full_body(), "call 1");
+    ASSERT_EQ(resp.etag, etag);
+
+    // cached by the query args
+    http_request detail_req;
+    detail_req.query_args.emplace("detail", "");
+    resp = call(detail_req);
+    ASSERT_EQ(calls, 2);
+    ASSERT_EQ(resp.full_body(), "call 2");
+
+    // not modified
+    req.if_none_match = "\"other\", W/" + etag;
+    resp = call(req);
+    ASSERT_EQ(resp.status_code, http_status_code::not_modified);
+    ASSERT_EQ(resp.full_body(), "");
+    ASSERT_EQ(resp.etag, etag);
+
+    // rebuilt once the version changes
+    version = 2;
+    resp = call(req);
+    ASSERT_EQ(calls, 3);
+    ASSERT_EQ(resp.status_code, http_status_code::ok);
+    ASSERT_EQ(resp.full_body(), "call 3");
+    ASSERT_NE(resp.etag, etag);
+
+    // the failed responses aren't cached
+    http_request bad_req;
+    bad_req.query_args.emplace("bad", "");
+    resp = call(bad_req);
+    ASSERT_EQ(resp.status_code, http_status_code::bad_request);
+    resp = call(bad_req);
+    ASSERT_EQ(calls, 5);
+
+    // nothing is cached with a negative version
+    version = -1;
+    resp = call(http_request());
+    resp = call(http_request());
+    ASSERT_EQ(calls, 7);
+    ASSERT_EQ(resp.full_body(), "call 7");
+    ASSERT_TRUE(resp.etag.empty());
+}
+
+} // namespace dsn} // namespace dsn
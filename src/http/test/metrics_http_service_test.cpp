@@ -0,0 +1,137 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <http/metrics_http_service.h>
+
+namespace dsn {
+
+TEST(metrics_http_service_test, parse_counter_name)
+{
+    struct test_case
+    {
+        const char *full_name;
+        const char *family;
+        const char *service;
+        const char *app_id;
+        const char *partition;
+        const char *table;
+    } tests[] = {
+        {"replica*eon.replica*private.log.size(MB)@1.2",
+         "eon_replica_private_log_size_MB",
+         "replica",
+         "1",
+         "2",
+         ""},
+        {"replica*eon.replica*backup_request_qps@temp", "eon_replica_backup_request_qps", "replica",
+         "", "", "temp"},
+        {"replica*server*memused.res(MB)", "server_memused_res_MB", "replica", "", "", ""},
+        {"replica*eon.replica*get_qps@1.x", "eon_replica_get_qps", "replica", "", "", "1.x"},
+        {"1counter", "_1counter", "", "", "", ""},
+    };
+
+    for (const auto &test : tests) {
+        std::string family;
+        metrics_http_service::metric_labels labels;
+        metrics_http_service::parse_counter_name(test.full_name, family, labels);
+        ASSERT_EQ(test.family, family) << test.full_name;
+        ASSERT_EQ(test.service, labels.service) << test.full_name;
+        ASSERT_EQ(test.app_id, labels.app_id) << test.full_name;
+        ASSERT_EQ(test.partition, labels.partition) << test.full_name;
+        ASSERT_EQ(test.table, labels.table) << test.full_name;
+    }
+}
+
+TEST(metrics_http_service_test, write_exposition)
+{
+    std::vector<perf_counters::counter_snapshot> snapshots(5);
+    snapshots[0].name = "replica*eon.replica*write_qps@1.0";
+    snapshots[0].type = COUNTER_TYPE_RATE;
+    snapshots[0].value = 1.5;
+    snapshots[1].name = "replica*eon.replica*latency@temp";
+    snapshots[1].type = COUNTER_TYPE_HISTOGRAM;
+    snapshots[1].value = 100;
+    snapshots[2].name = "replica*eon.replica*write_qps@1.1";
+    snapshots[2].type = COUNTER_TYPE_RATE;
+    snapshots[2].value = 3;
+    snapshots[3].name = "replica*eon.replica*latency@temp.p999";
+    snapshots[3].type = COUNTER_TYPE_HISTOGRAM;
+    snapshots[3].value = 200;
+    snapshots[4].name = "replica*eon.replica*read_qps@2.0";
+    snapshots[4].type = COUNTER_TYPE_RATE;
+    snapshots[4].value = 0;
+
+    std::vector<const perf_counters::counter_snapshot *> counters;
+    for (const auto &cs : snapshots) {
+        counters.push_back(&cs);
+    }
+
+    // the samples of a family are grouped together
+    std::string out;
+    metrics_http_service::write_exposition(counters, {}, out);
+    ASSERT_EQ("# TYPE eon_replica_latency summary\n"
+              "eon_replica_latency{service=\"replica\",table=\"temp\",quantile=\"0.99\"} 100\n"
+              "eon_replica_latency{service=\"replica\",table=\"temp\",quantile=\"0.999\"} 200\n"
+              "# TYPE eon_replica_read_qps gauge\n"
+              "eon_replica_read_qps{service=\"replica\",app_id=\"2\",partition=\"0\"} 0\n"
+              "# TYPE eon_replica_write_qps gauge\n"
+              "eon_replica_write_qps{service=\"replica\",app_id=\"1\",partition=\"0\"} 1.5\n"
+              "eon_replica_write_qps{service=\"replica\",app_id=\"1\",partition=\"1\"} 3\n"
+              "# EOF\n",
+              out);
+
+    // filtered by labels
+    out.clear();
+    metrics_http_service::metric_labels filter;
+    filter.app_id = "1";
+    filter.partition = "1";
+    metrics_http_service::write_exposition(counters, filter, out);
+    ASSERT_EQ("# TYPE eon_replica_write_qps gauge\n"
+              "eon_replica_write_qps{service=\"replica\",app_id=\"1\",partition=\"1\"} 3\n"
+              "# EOF\n",
+              out);
+
+    out.clear();
+    filter = metrics_http_service::metric_labels();
+    filter.table = "not_exist";
+    metrics_http_service::write_exposition(counters, filter, out);
+    ASSERT_EQ("# EOF\n", out);
+}
+
+TEST(metrics_http_service_test, get_metrics)
+{
+    perf_counter_wrapper counter;
+    counter.init_global_counter(
+        "replica", "http_metrics", "number@3.4", COUNTER_TYPE_NUMBER, "number type");
+    counter->set(42);
+
+    metrics_http_service service;
+    http_request req;
+    http_response resp;
+    req.query_args.emplace("app_id", "3");
+    service.get_metrics_handler(req, resp);
+    ASSERT_EQ(http_status_code::ok, resp.status_code);
+    ASSERT_EQ("# TYPE http_metrics_number gauge\n"
+              "http_metrics_number{service=\"replica\",app_id=\"3\",partition=\"4\"} 42\n"
+              "# EOF\n",
+              resp.full_body());
+
+    // the cached exposition is returned until the snapshot is refreshed
+    counter->set(43);
+    http_response cached_resp;
+    service.get_metrics_handler(req, cached_resp);
+    ASSERT_EQ(resp.full_body(), cached_resp.full_body());
+    ASSERT_EQ(resp.body_chunks[0].data(), cached_resp.body_chunks[0].data());
+
+    perf_counters::instance().take_snapshot();
+    service.get_metrics_handler(req, resp);
+    ASSERT_NE(resp.full_body().find("} 43\n"), std::string::npos) << resp.full_body();
+
+    req.query_args.emplace("name", "number");
+    service.get_metrics_handler(req, resp);
+    ASSERT_EQ(http_status_code::bad_request, resp.status_code);
+}
+
+} // namespace dsn
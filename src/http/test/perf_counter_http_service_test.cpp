@@ -28,7 +28,8 @@ TEST_F(perf_counter_http_service_test, get_perf_counter)
         {"replica", "http", "number", COUNTER_TYPE_NUMBER, "number type"},
         {"replica", "http", "volatile", COUNTER_TYPE_VOLATILE_NUMBER, "volatile type"},
         {"replica", "http", "rate", COUNTER_TYPE_RATE, "rate type"},
-        {"replica", "http", "percentline", COUNTER_TYPE_NUMBER_PERCENTILES, "percentline type"}};
+        {"replica", "http", "percentline", COUNTER_TYPE_NUMBER_PERCENTILES, "percentline type"},
+        {"replica", "http", "histogram", COUNTER_TYPE_HISTOGRAM, "histogram type"}};
 
     for (auto test : tests) {
         // create perf counter
@@ -51,6 +52,12 @@ TEST_F(perf_counter_http_service_test, get_perf_counter)
                         R"("p99":"0.00","p999":"0.00",)" +
                         R"("type":")" + dsn_counter_type_to_string(test.type) + R"(",)" +
                         R"("description":")" + test.description + R"("})" + "\n";
+        } else if (COUNTER_TYPE_HISTOGRAM == test.type) {
+            fake_json = R"({"name":")" + perf_counter_name + R"(",)" +
+                        R"("count":"0","mean":"0.00",)" +
+                        R"("p50":"0.00","p90":"0.00","p95":"0.00","p99":"0.00","p999":"0.00",)" +
+                        R"("type":")" + dsn_counter_type_to_string(test.type) + R"(",)" +
+                        R"("description":")" + test.description + R"("})" + "\n";
         } else {
             fake_json = R"({"name":")" + perf_counter_name + R"(",)" +
                         R"("value":"0.00",)" +
@@ -61,5 +68,23 @@ TEST_F(perf_counter_http_service_test, get_perf_counter)
         ASSERT_EQ(fake_resp.status_code, http_status_code::ok);
         ASSERT_EQ(fake_resp.body, fake_json);
     }
+
+    // extra quantiles of histogram counter
+    perf_counter_wrapper counter;
+    counter.init_global_counter("replica", "http", "histogram", COUNTER_TYPE_HISTOGRAM, "");
+    std::string perf_counter_name;
+    perf_counter::build_full_name("replica", "http", "histogram", perf_counter_name);
+
+    http_request fake_req;
+    http_response fake_resp;
+    fake_req.query_args.emplace("name", perf_counter_name);
+    fake_req.query_args.emplace("quantiles", "0.9999");
+    _perf_counter_http_service.get_perf_counter_handler(fake_req, fake_resp);
+    ASSERT_EQ(fake_resp.status_code, http_status_code::ok);
+    ASSERT_NE(fake_resp.body.find(R"("q0.9999":"0.00")"), std::string::npos) << fake_resp.body;
+
+    fake_req.query_args["quantiles"] = "1.5";
+    _perf_counter_http_service.get_perf_counter_handler(fake_req, fake_resp);
+    ASSERT_EQ(fake_resp.status_code, http_status_code::bad_request);
 }
 } // namespace dsn
@@ -74,5 +74,21 @@ TEST_F(uri_decoder_test, decode)
     }
 }
 
+TEST_F(uri_decoder_test, decode_in_place)
+{
+    std::string uri = "perfCounter?name=collector*app%23_all_";
+    const char *data = uri.data();
+    ASSERT_TRUE(decode_in_place(uri).is_ok());
+    ASSERT_EQ("perfCounter?name=collector*app#_all_", uri);
+    ASSERT_EQ(data, uri.data());
+
+    uri = "perfCounter";
+    ASSERT_TRUE(decode_in_place(uri).is_ok());
+    ASSERT_EQ("perfCounter", uri);
+
+    uri = "perfCounter%2";
+    ASSERT_EQ(ERR_INVALID_PARAMETERS, decode_in_place(uri).code());
+}
+
 } // namespace dsn
 } // namespace uri
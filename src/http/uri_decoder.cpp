@@ -37,32 +37,46 @@ error_with<char> decode_char(const string_view &hex)
 
 error_with<std::string> decode(const string_view &encoded_uri)
 {
-    std::string decoded_uri;
-    for (size_t i = 0; i < encoded_uri.size(); ++i) {
+    std::string decoded_uri(encoded_uri.data(), encoded_uri.size());
+    RETURN_NOT_OK(decode_in_place(decoded_uri));
+    return decoded_uri;
+}
+
+error_s decode_in_place(std::string &uri)
+{
+    size_t i = uri.find('%');
+    if (i == std::string::npos) {
+        return error_s::ok();
+    }
+
+    // the decoded chars are written behind the ones being read
+    size_t decoded_size = i;
+    for (; i < uri.size(); ++i) {
         // '%' is followed by 2 hex chars
-        if ('%' == encoded_uri[i]) {
-            if (i + 2 >= encoded_uri.size()) {
+        if ('%' == uri[i]) {
+            if (i + 2 >= uri.size()) {
                 return error_s::make(ERR_INVALID_PARAMETERS,
                                      "Encountered partial escape sequence at end of string");
             }
 
-            const string_view encoded_char(encoded_uri.data() + i + 1, 2);
+            const string_view encoded_char(uri.data() + i + 1, 2);
             auto decoded_char = decode_char(encoded_char);
             if (!decoded_char.is_ok()) {
                 return error_s::make(
                     ERR_INVALID_PARAMETERS,
                     fmt::format("The characters {} do not "
                                 "form a hex value. Please escape it or pass a valid hex value",
-                                encoded_char.data()));
+                                std::string(encoded_char.data(), encoded_char.size())));
             }
-            decoded_uri += decoded_char.get_value();
+            uri[decoded_size++] = decoded_char.get_value();
             i += 2;
         } else {
-            decoded_uri += encoded_uri[i];
+            uri[decoded_size++] = uri[i];
         }
     }
+    uri.resize(decoded_size);
 
-    return decoded_uri;
+    return error_s::ok();
 }
 
 } // namespace uri
@@ -14,5 +14,10 @@ namespace uri {
 /// \returns the decoded uri path
 error_with<std::string> decode(const string_view &encoded_uri);
 
+/// \brief Decodes `uri` in place according to the percent decoding rules. Decoding never
+/// grows a sequence, so no memory is allocated, and `uri` is untouched if it has no '%'.
+/// `uri` is left partially decoded on failure.
+error_s decode_in_place(std::string &uri);
+
 } // namespace uri
 } // namespace dsn
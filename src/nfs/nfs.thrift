@@ -12,6 +12,8 @@ struct copy_request
     6: i32 size;
     7: bool is_last;
     8: bool overwrite;
+    // see nfs_copy_priority in nfs_node.h, the copies of higher priority are served first
+    9: i32 priority = 1;
 }
 
 struct copy_response
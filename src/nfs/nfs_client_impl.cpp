@@ -33,8 +33,17 @@
  *     xxxx-xx-xx, author, fix bug about xxx
  */
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/io_scheduler.h>
+#include <fcntl.h>
 #include <queue>
+#include <unistd.h>
 #include <dsn/tool-api/command_manager.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <set>
+#include <unordered_map>
 #include "nfs_client_impl.h"
 
 namespace dsn {
@@ -77,6 +86,242 @@ DSN_DEFINE_int32("nfs",
                  10000,
                  "rpc timeout in milliseconds for nfs copy, "
                  "0 means use default timeout of rpc engine");
+DSN_DEFINE_bool("nfs",
+                nfs_streaming_copy_enabled,
+                false,
+                "whether to write each copied block as soon as it is received instead of in the "
+                "order of offsets, into the file which is preallocated to its final size");
+DSN_DEFINE_bool("nfs",
+                nfs_adaptive_copy_enabled,
+                false,
+                "whether to adapt the block size and the max concurrent copy requests of each "
+                "remote node to the observed throughput and rtt, within nfs_min_copy_block_bytes, "
+                "nfs_copy_block_bytes and max_concurrent_remote_copy_requests");
+DSN_TAG_VARIABLE(nfs_adaptive_copy_enabled, FT_MUTABLE);
+DSN_DEFINE_uint32("nfs",
+                  nfs_min_copy_block_bytes,
+                  256 * 1024,
+                  "min block size (bytes) for each network copy if nfs_adaptive_copy_enabled");
+DSN_DEFINE_uint32("nfs",
+                  nfs_copy_block_target_latency_ms,
+                  200,
+                  "the latency of copying a block that the block size adapts to if "
+                  "nfs_adaptive_copy_enabled");
+DSN_TAG_VARIABLE(nfs_copy_block_target_latency_ms, FT_MUTABLE);
+DSN_DEFINE_bool("nfs",
+                nfs_resumable_copy_enabled,
+                false,
+                "whether to save the blocks written of each file when a copy fails, so that the "
+                "next copy of the same file into the same directory resumes from them");
+DSN_TAG_VARIABLE(nfs_resumable_copy_enabled, FT_MUTABLE);
+
+// the min rtt of a remote node is renewed after this period, to follow the changes of the path
+static const uint64_t MIN_RTT_EXPIRE_US = 10 * 1000 * 1000;
+
+// Creates `file_path` if not exist, and sets its size to `size`, so that the blocks can be
+// written at any offset without extending the file, and the stale tail of an overwritten file
+// is dropped. The disk space is allocated if supported by the file system.
+static bool preallocate_file(const char *file_path, uint64_t size)
+{
+    int fd = ::open(file_path, O_WRONLY | O_CREAT | O_BINARY, 0666);
+    if (fd < 0) {
+        derror("open file %s failed, err = %s", file_path, strerror(errno));
+        return false;
+    }
+    auto cleanup = dsn::defer([fd]() { ::close(fd); });
+
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        derror("truncate file %s failed, err = %s", file_path, strerror(errno));
+        return false;
+    }
+    if (size > 0) {
+        // just a hint for the file system, the file is already of the final size
+        int err = ::posix_fallocate(fd, 0, static_cast<off_t>(size));
+        if (err != 0) {
+            dwarn("fallocate file %s failed, err = %s", file_path, strerror(err));
+        }
+    }
+    return true;
+}
+
+// The copy progress of a file is saved in "<file>.nfs_progress" next to it:
+//
+//   <source address>:<source path>
+//   <file size> <block size>
+//   <index of a written block> ...
+//
+// which is saved only after the blocks are synced to disk, and removed once the file is
+// completely written.
+static std::string get_copy_progress_path(const std::string &file_path)
+{
+    return file_path + nfs_node::COPY_PROGRESS_SUFFIX;
+}
+
+static std::string get_copy_source(const get_file_size_request &req, const std::string &file_name)
+{
+    return std::string(req.source.to_string()) + ":" +
+           utils::filesystem::path_combine(req.source_dir, file_name);
+}
+
+// return false if no valid progress is saved for the file
+static bool load_copy_progress(const std::string &file_path,
+                               const std::string &source,
+                               uint64_t file_size,
+                               /*out*/ uint32_t &block_bytes,
+                               /*out*/ std::set<int> &written)
+{
+    std::string progress_path = get_copy_progress_path(file_path);
+    if (!utils::filesystem::file_exists(progress_path)) {
+        return false;
+    }
+
+    std::ifstream in(progress_path);
+    std::string saved_source;
+    uint64_t saved_file_size = 0;
+    uint32_t saved_block_bytes = 0;
+    if (!std::getline(in, saved_source) || !(in >> saved_file_size >> saved_block_bytes) ||
+        saved_source != source || saved_file_size != file_size || saved_block_bytes == 0 ||
+        !utils::filesystem::file_exists(file_path)) {
+        dwarn("ignore stale copy progress %s of %s", progress_path.c_str(), source.c_str());
+        utils::filesystem::remove_path(progress_path);
+        return false;
+    }
+
+    int index = 0;
+    while (in >> index) {
+        written.insert(index);
+    }
+    block_bytes = saved_block_bytes;
+    ddebug("resume copy of %s into %s with %d blocks written",
+           source.c_str(),
+           file_path.c_str(),
+           static_cast<int>(written.size()));
+    return true;
+}
+
+nfs_client_impl::peer_state::peer_state(rpc_address addr)
+    : address(addr),
+      inflight(0),
+      window(std::min(2, std::max(FLAGS_max_concurrent_remote_copy_requests, 1))),
+      block_bytes(FLAGS_nfs_copy_block_bytes),
+      slow_start(true),
+      window_credit(0),
+      min_rtt_us(0),
+      min_rtt_stamp_us(0),
+      srtt_us(0),
+      last_window_adjust_us(0),
+      last_block_adjust_us(0),
+      delivery_rate(0),
+      rate_start_us(0),
+      rate_bytes(0),
+      copy_bytes(0),
+      copy_count(0),
+      fail_count(0)
+{
+}
+
+bool nfs_client_impl::peer_state::can_copy() const
+{
+    return !FLAGS_nfs_adaptive_copy_enabled || inflight.load() < window.load();
+}
+
+void nfs_client_impl::peer_state::on_copied(uint32_t size, uint64_t rtt_us)
+{
+    zauto_lock l(lock);
+    uint64_t now = dsn_now_us();
+    copy_bytes += size;
+    ++copy_count;
+
+    srtt_us = srtt_us == 0 ? rtt_us : (srtt_us * 7 + rtt_us) / 8;
+    if (min_rtt_us == 0 || rtt_us <= min_rtt_us || now - min_rtt_stamp_us > MIN_RTT_EXPIRE_US) {
+        min_rtt_us = std::max<uint64_t>(rtt_us, 1);
+        min_rtt_stamp_us = now;
+    }
+
+    // the delivery rate is sampled over periods of at least one rtt, and filtered by a decaying
+    // max, for a sample is limited by the window when it's measured
+    if (rate_start_us == 0) {
+        rate_start_us = now - std::min(now, rtt_us);
+    }
+    rate_bytes += size;
+    uint64_t elapsed_us = now - rate_start_us;
+    if (elapsed_us >= std::max<uint64_t>(srtt_us, 10000)) {
+        double rate = rate_bytes * 1000000.0 / elapsed_us;
+        delivery_rate = std::max(rate, delivery_rate * 0.9);
+        rate_start_us = now;
+        rate_bytes = 0;
+    }
+
+    if (!FLAGS_nfs_adaptive_copy_enabled) {
+        return;
+    }
+
+    int w = window.load();
+    int max_window = std::max(FLAGS_max_concurrent_remote_copy_requests, 1);
+    if (srtt_us <= min_rtt_us * 2) {
+        // no queue on the path, probe for more throughput
+        window_credit += slow_start ? 1.0 : 1.0 / w;
+        if (window_credit >= 1.0) {
+            window_credit = 0;
+            w = std::min(w + 1, max_window);
+        }
+    } else if (now - last_window_adjust_us > srtt_us) {
+        slow_start = false;
+        window_credit = 0;
+        last_window_adjust_us = now;
+        int bdp = static_cast<int>(std::ceil(delivery_rate * min_rtt_us / 1000000.0 /
+                                             std::max<uint32_t>(block_bytes.load(), 1)));
+        w = std::max(std::max(w * 3 / 4, std::min(bdp, max_window)), 1);
+    }
+    window.store(std::min(w, max_window));
+
+    if (now - last_block_adjust_us > srtt_us) {
+        last_block_adjust_us = now;
+        uint64_t target_us = FLAGS_nfs_copy_block_target_latency_ms * 1000ULL;
+        uint32_t max_block = FLAGS_nfs_copy_block_bytes;
+        uint32_t min_block = std::min(FLAGS_nfs_min_copy_block_bytes, max_block);
+        uint32_t b = std::min(block_bytes.load(), max_block);
+        if (srtt_us * 2 < target_us) {
+            b = static_cast<uint32_t>(std::min<uint64_t>(b * 2ULL, max_block));
+        } else if (srtt_us > target_us * 2) {
+            b = std::max(b / 2, min_block);
+        }
+        block_bytes.store(b);
+    }
+}
+
+void nfs_client_impl::peer_state::on_failed()
+{
+    zauto_lock l(lock);
+    ++fail_count;
+    if (!FLAGS_nfs_adaptive_copy_enabled) {
+        return;
+    }
+
+    slow_start = false;
+    window_credit = 0;
+    window.store(std::max(window.load() / 2, 1));
+    uint32_t min_block = std::min(FLAGS_nfs_min_copy_block_bytes, FLAGS_nfs_copy_block_bytes);
+    block_bytes.store(std::max(block_bytes.load() / 2, min_block));
+}
+
+std::string nfs_client_impl::peer_state::to_string()
+{
+    zauto_lock l(lock);
+    return fmt::format("{}: block_bytes = {}, window = {}, inflight = {}, min_rtt_ms = {:.1f}, "
+                       "srtt_ms = {:.1f}, rate_mb = {:.1f}, copy_mb = {}, copy_count = {}, "
+                       "fail_count = {}",
+                       address.to_string(),
+                       block_bytes.load(),
+                       window.load(),
+                       inflight.load(),
+                       min_rtt_us / 1000.0,
+                       srtt_us / 1000.0,
+                       delivery_rate / (1 << 20),
+                       copy_bytes >> 20,
+                       copy_count,
+                       fail_count);
+}
 
 nfs_client_impl::nfs_client_impl()
     : _concurrent_copy_request_count(0),
@@ -121,6 +366,7 @@ void nfs_client_impl::begin_remote_copy(std::shared_ptr<remote_copy_request> &rc
 {
     user_request_ptr req(new user_request());
     req->high_priority = rci->high_priority;
+    req->priority = rci->priority;
     req->file_size_req.source = rci->source;
     req->file_size_req.dst_dir = rci->dest_dir;
     req->file_size_req.file_list = rci->files;
@@ -128,6 +374,8 @@ void nfs_client_impl::begin_remote_copy(std::shared_ptr<remote_copy_request> &rc
     req->file_size_req.overwrite = rci->overwrite;
     req->nfs_task = nfs_task;
     req->is_finished = false;
+    req->streaming = FLAGS_nfs_streaming_copy_enabled;
+    req->peer = get_peer(rci->source);
 
     get_file_size(req->file_size_req,
                   [=](error_code err, get_file_size_response &&resp) {
@@ -163,20 +411,43 @@ void nfs_client_impl::end_get_file_size(::dsn::error_code err,
         return;
     }
 
+    // the block size adapts to the remote node between the user requests, rather than between
+    // the blocks of a file, which are all split here
+    uint32_t block_bytes = FLAGS_nfs_copy_block_bytes;
+    if (FLAGS_nfs_adaptive_copy_enabled) {
+        block_bytes = std::max(std::min(ureq->peer->block_bytes.load(), block_bytes), 1u);
+    }
+
     std::deque<copy_request_ex_ptr> copy_requests;
+    bool resumed = false;
     ureq->file_contexts.resize(resp.size_list.size());
     for (size_t i = 0; i < resp.size_list.size(); i++) // file list
     {
         file_context_ptr filec(new file_context(ureq, resp.file_list[i], resp.size_list[i]));
         ureq->file_contexts[i] = filec;
 
+        // the blocks written by the last copy of the file, which failed
+        uint32_t file_block_bytes = block_bytes;
+        std::set<int> written;
+        std::string file_path =
+            utils::filesystem::path_combine(ureq->file_size_req.dst_dir, filec->file_name);
+        if (FLAGS_nfs_resumable_copy_enabled &&
+            load_copy_progress(file_path,
+                               get_copy_source(ureq->file_size_req, filec->file_name),
+                               filec->file_size,
+                               file_block_bytes,
+                               written)) {
+            filec->has_progress = true;
+            resumed = true;
+        }
+
         // init copy requests
         uint64_t size = resp.size_list[i];
         uint64_t req_offset = 0;
-        uint32_t req_size = size > FLAGS_nfs_copy_block_bytes ? FLAGS_nfs_copy_block_bytes
-                                                              : static_cast<uint32_t>(size);
+        uint32_t req_size =
+            size > file_block_bytes ? file_block_bytes : static_cast<uint32_t>(size);
 
-        filec->copy_requests.reserve(size / FLAGS_nfs_copy_block_bytes + 1);
+        filec->copy_requests.reserve(size / file_block_bytes + 1);
         int idx = 0;
         for (;;) // send one file with multi-round rpc
         {
@@ -187,7 +458,12 @@ void nfs_client_impl::end_get_file_size(::dsn::error_code err,
             req->is_last = (size <= req_size);
 
             filec->copy_requests.push_back(req);
-            copy_requests.push_back(req);
+            if (written.count(req->index) != 0) {
+                req->is_written = true;
+                ++filec->finished_segments;
+            } else {
+                copy_requests.push_back(req);
+            }
 
             req_offset += req_size;
             size -= req_size;
@@ -196,9 +472,23 @@ void nfs_client_impl::end_get_file_size(::dsn::error_code err,
                 break;
             }
 
-            req_size = size > FLAGS_nfs_copy_block_bytes ? FLAGS_nfs_copy_block_bytes
-                                                         : static_cast<uint32_t>(size);
+            req_size = size > file_block_bytes ? file_block_bytes : static_cast<uint32_t>(size);
         }
+
+        if (filec->finished_segments == static_cast<int>(filec->copy_requests.size())) {
+            utils::filesystem::remove_path(get_copy_progress_path(file_path));
+            filec->file_holder = nullptr;
+            ++ureq->finished_files;
+        }
+    }
+
+    if (resumed) {
+        // the blocks not written yet are written at their own offsets
+        ureq->streaming = true;
+    }
+    if (ureq->finished_files == static_cast<int>(ureq->file_contexts.size())) {
+        handle_completion(ureq, ERR_OK);
+        return;
     }
 
     if (!copy_requests.empty()) {
@@ -233,7 +523,11 @@ void nfs_client_impl::continue_copy()
         {
             zauto_lock l(_copy_requests_lock);
 
-            if (_high_priority_remaining_time > 0 && !_copy_requests_high.empty()) {
+            // the high priority requests are copied in order, so the ones to a remote node whose
+            // window is full hold back the others
+            bool high_ready = !_copy_requests_high.empty() &&
+                              _copy_requests_high.front()->file_ctx->user_req->peer->can_copy();
+            if (_high_priority_remaining_time > 0 && high_ready) {
                 // pop from high queue
                 req = _copy_requests_high.front();
                 _copy_requests_high.pop_front();
@@ -246,7 +540,7 @@ void nfs_client_impl::continue_copy()
                 }
             }
 
-            if (!req && !_copy_requests_high.empty()) {
+            if (!req && high_ready) {
                 // pop from low queue failed, then pop from high priority,
                 // but not change the _high_priority_remaining_time
                 req = _copy_requests_high.front();
@@ -255,6 +549,7 @@ void nfs_client_impl::continue_copy()
 
             if (req) {
                 ++req->file_ctx->user_req->concurrent_copy_count;
+                ++req->file_ctx->user_req->peer->inflight;
             } else {
                 // no copy request
                 --_concurrent_copy_request_count;
@@ -267,6 +562,8 @@ void nfs_client_impl::continue_copy()
             const user_request_ptr &ureq = req->file_ctx->user_req;
             if (req->is_valid) {
                 _copy_token_bucket->consumeWithBorrowAndWait(req->size);
+                io_scheduler::instance().consume(
+                    io_class::LEARN, ureq->file_size_req.dst_dir, req->size);
 
                 copy_request copy_req;
                 copy_req.source = ureq->file_size_req.source;
@@ -277,6 +574,8 @@ void nfs_client_impl::continue_copy()
                 copy_req.source_dir = ureq->file_size_req.source_dir;
                 copy_req.overwrite = ureq->file_size_req.overwrite;
                 copy_req.is_last = req->is_last;
+                copy_req.priority = ureq->priority;
+                req->copy_start_us = dsn_now_us();
                 req->remote_copy_task = copy(copy_req,
                                              [=](error_code err, copy_response &&resp) {
                                                  end_copy(err, std::move(resp), req);
@@ -295,6 +594,7 @@ void nfs_client_impl::continue_copy()
                                              req->file_ctx->user_req->file_size_req.source);
             } else {
                 --ureq->concurrent_copy_count;
+                --ureq->peer->inflight;
                 --_concurrent_copy_request_count;
             }
         }
@@ -314,6 +614,7 @@ void nfs_client_impl::end_copy(::dsn::error_code err,
 {
     --_concurrent_copy_request_count;
     --reqc->file_ctx->user_req->concurrent_copy_count;
+    --reqc->file_ctx->user_req->peer->inflight;
 
     const file_context_ptr &fc = reqc->file_ctx;
 
@@ -323,6 +624,7 @@ void nfs_client_impl::end_copy(::dsn::error_code err,
 
     if (err != ::dsn::ERR_OK) {
         _recent_copy_fail_count->increment();
+        fc->user_req->peer->on_failed();
 
         if (!fc->user_req->is_finished) {
             if (reqc->retry_count > 0) {
@@ -359,13 +661,21 @@ void nfs_client_impl::end_copy(::dsn::error_code err,
 
     else {
         _recent_copy_data_size->add(resp.size);
+        fc->user_req->peer->on_copied(resp.size, dsn_now_us() - reqc->copy_start_us);
 
         reqc->response = resp;
         reqc->is_ready_for_write = true;
 
         // prepare write requests
         std::deque<copy_request_ex_ptr> new_writes;
-        {
+        if (fc->user_req->streaming) {
+            // blocks are written with their own offsets, so no need to wait for the previous
+            // ones, which may be delayed by retries
+            zauto_lock l(fc->user_req->user_req_lock);
+            if (!fc->user_req->is_finished) {
+                new_writes.push_back(reqc);
+            }
+        } else {
             zauto_lock l(fc->user_req->user_req_lock);
             if (!fc->user_req->is_finished && fc->current_write_index == reqc->index - 1) {
                 for (int i = reqc->index; i < (int)(fc->copy_requests.size()); i++) {
@@ -445,8 +755,15 @@ void nfs_client_impl::continue_write()
         // double check
         zauto_lock l(fc->user_req->user_req_lock);
         if (!fc->file_holder->file_handle) {
-            fc->file_holder->file_handle =
-                file::open(file_path.c_str(), O_RDWR | O_CREAT | O_BINARY, 0666);
+            if (fc->user_req->streaming &&
+                !preallocate_file(file_path.c_str(), fc->file_size)) {
+                derror("preallocate file %s to %" PRIu64 " bytes failed",
+                       file_path.c_str(),
+                       fc->file_size);
+            } else {
+                fc->file_holder->file_handle =
+                    file::open(file_path.c_str(), O_RDWR | O_CREAT | O_BINARY, 0666);
+            }
         }
     }
 
@@ -503,11 +820,19 @@ void nfs_client_impl::end_write(error_code err, size_t sz, const copy_request_ex
 
         file_wrapper_ptr temp_holder;
         zauto_lock l(fc->user_req->user_req_lock);
+        if (!fc->user_req->is_finished) {
+            reqc->is_written = true;
+        }
         if (!fc->user_req->is_finished &&
             ++fc->finished_segments == (int)fc->copy_requests.size()) {
             // release file to make it closed immediately after write done.
             // we use temp_holder to make file closing out of lock.
             temp_holder = std::move(fc->file_holder);
+            if (fc->has_progress) {
+                utils::filesystem::remove_path(get_copy_progress_path(
+                    utils::filesystem::path_combine(fc->user_req->file_size_req.dst_dir,
+                                                    fc->file_name)));
+            }
 
             if (++fc->user_req->finished_files == (int)fc->user_req->file_contexts.size()) {
                 completed = true;
@@ -533,6 +858,10 @@ void nfs_client_impl::handle_completion(const user_request_ptr &req, error_code
         return;
     req->is_finished = true;
 
+    if (err != ERR_OK && FLAGS_nfs_resumable_copy_enabled) {
+        save_copy_progress(req);
+    }
+
     size_t total_size = 0;
     for (file_context_ptr &fc : req->file_contexts) {
         total_size += fc->file_size;
@@ -554,6 +883,52 @@ void nfs_client_impl::handle_completion(const user_request_ptr &req, error_code
     req->nfs_task->enqueue(err, err == ERR_OK ? total_size : 0);
 }
 
+void nfs_client_impl::save_copy_progress(const user_request_ptr &req)
+{
+    for (const file_context_ptr &fc : req->file_contexts) {
+        std::string written;
+        for (const copy_request_ex_ptr &rc : fc->copy_requests) {
+            if (rc->is_written) {
+                written.append(std::to_string(rc->index)).append(" ");
+            }
+        }
+        if (written.empty()) {
+            continue;
+        }
+
+        // the blocks must be on disk before the progress which refers to them
+        std::string file_path =
+            utils::filesystem::path_combine(req->file_size_req.dst_dir, fc->file_name);
+        int fd = ::open(file_path.c_str(), O_WRONLY | O_BINARY);
+        if (fd < 0) {
+            dwarn("open file %s failed, err = %s", file_path.c_str(), strerror(errno));
+            continue;
+        }
+        bool synced = (::fdatasync(fd) == 0);
+        ::close(fd);
+        if (!synced) {
+            dwarn("sync file %s failed, err = %s", file_path.c_str(), strerror(errno));
+            continue;
+        }
+
+        std::string progress_path = get_copy_progress_path(file_path);
+        std::string tmp_path = progress_path + ".tmp";
+        {
+            std::ofstream out(tmp_path, std::ios::trunc);
+            out << get_copy_source(req->file_size_req, fc->file_name) << "\n"
+                << fc->file_size << " " << std::max(fc->copy_requests[0]->size, 1u) << "\n"
+                << written << "\n";
+            if (!out.good()) {
+                dwarn("write copy progress %s failed", tmp_path.c_str());
+                continue;
+            }
+        }
+        if (!utils::filesystem::rename_path(tmp_path, progress_path)) {
+            dwarn("rename copy progress %s failed", tmp_path.c_str());
+        }
+    }
+}
+
 void nfs_client_impl::register_cli_commands()
 {
 
@@ -593,7 +968,54 @@ void nfs_client_impl::register_cli_commands()
                 FLAGS_max_copy_rate_megabytes = max_copy_rate_megabytes;
                 return result;
             });
+
+        dsn::command_manager::instance().register_command(
+            {"nfs.peers"},
+            "nfs.peers",
+            "show the copy state of each remote node copied from",
+            [](const std::vector<std::string> &args) {
+                std::string result;
+                for (const peer_state_ptr &peer : get_peers()) {
+                    result.append(peer->to_string()).append("\n");
+                }
+                return result;
+            });
     });
 }
+
+struct nfs_peers
+{
+    zlock lock;
+    std::unordered_map<rpc_address, nfs_client_impl::peer_state_ptr> peers;
+};
+
+static nfs_peers &all_peers()
+{
+    static nfs_peers s_peers;
+    return s_peers;
+}
+
+/*static*/ nfs_client_impl::peer_state_ptr nfs_client_impl::get_peer(rpc_address addr)
+{
+    nfs_peers &all = all_peers();
+    zauto_lock l(all.lock);
+    peer_state_ptr &peer = all.peers[addr];
+    if (peer == nullptr) {
+        peer = new peer_state(addr);
+    }
+    return peer;
+}
+
+/*static*/ std::vector<nfs_client_impl::peer_state_ptr> nfs_client_impl::get_peers()
+{
+    nfs_peers &all = all_peers();
+    zauto_lock l(all.lock);
+    std::vector<peer_state_ptr> peers;
+    peers.reserve(all.peers.size());
+    for (const auto &kv : all.peers) {
+        peers.push_back(kv.second);
+    }
+    return peers;
+}
 } // namespace service
 } // namespace dsn
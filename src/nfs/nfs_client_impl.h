@@ -56,11 +56,50 @@ public:
     struct file_context;
     struct copy_request_ex;
     struct file_wrapper;
+    struct peer_state;
 
     typedef ::dsn::ref_ptr<user_request> user_request_ptr;
     typedef ::dsn::ref_ptr<file_context> file_context_ptr;
     typedef ::dsn::ref_ptr<copy_request_ex> copy_request_ex_ptr;
     typedef ::dsn::ref_ptr<file_wrapper> file_wrapper_ptr;
+    typedef ::dsn::ref_ptr<peer_state> peer_state_ptr;
+
+    // the copy state of a remote node, see nfs_adaptive_copy_enabled:
+    // - the window (max concurrent copy requests to the node) grows by one for each window of
+    //   copies done while the rtt stays close to the min rtt, and shrinks to 3/4 when the rtt
+    //   shows a queue, but never below the bandwidth-delay product of the observed throughput
+    // - the block size doubles while a block is copied in much less than
+    //   nfs_copy_block_target_latency_ms, and halves while it takes much longer
+    // - both are halved on a failed copy
+    struct peer_state : public ::dsn::ref_counter
+    {
+        rpc_address address;
+        std::atomic<int> inflight;
+        std::atomic<int> window;
+        std::atomic<uint32_t> block_bytes;
+
+        zlock lock; // to protect the fields below
+        bool slow_start; // the window grows by one for each copy done until a queue shows
+        double window_credit;
+        uint64_t min_rtt_us;
+        uint64_t min_rtt_stamp_us;
+        uint64_t srtt_us;
+        uint64_t last_window_adjust_us;
+        uint64_t last_block_adjust_us;
+        double delivery_rate; // bytes per second
+        uint64_t rate_start_us;
+        uint64_t rate_bytes;
+        uint64_t copy_bytes;
+        uint64_t copy_count;
+        uint64_t fail_count;
+
+        explicit peer_state(rpc_address addr);
+
+        bool can_copy() const;
+        void on_copied(uint32_t size, uint64_t rtt_us);
+        void on_failed();
+        std::string to_string();
+    };
 
     struct file_wrapper : public ::dsn::ref_counter
     {
@@ -84,9 +123,11 @@ public:
         uint32_t size;
         bool is_last;
         copy_response response;
+        uint64_t copy_start_us;
         ::dsn::task_ptr remote_copy_task;
         ::dsn::task_ptr local_write_task;
         bool is_ready_for_write;
+        bool is_written; // protected by user_req_lock
         bool is_valid;
         int retry_count;
         zlock lock; // to protect is_valid
@@ -97,8 +138,10 @@ public:
             index = idx;
             offset = 0;
             size = 0;
+            copy_start_us = 0;
             is_last = false;
             is_ready_for_write = false;
+            is_written = false;
             is_valid = true;
             retry_count = try_count;
         }
@@ -114,6 +157,8 @@ public:
         file_wrapper_ptr file_holder;
         int current_write_index;
         int finished_segments;
+        // whether the copy progress of the file is saved, see nfs_resumable_copy_enabled
+        bool has_progress;
         std::vector<copy_request_ex_ptr> copy_requests;
 
         file_context(const user_request_ptr &req, const std::string &file_nm, uint64_t sz)
@@ -124,6 +169,7 @@ public:
             file_holder = new file_wrapper();
             current_write_index = -1;
             finished_segments = 0;
+            has_progress = false;
         }
     };
 
@@ -132,22 +178,27 @@ public:
         zlock user_req_lock;
 
         bool high_priority;
+        nfs_copy_priority priority; // on the server
         int low_queue_index;
         get_file_size_request file_size_req;
         ::dsn::ref_ptr<aio_task> nfs_task;
         std::atomic<int> finished_files;
         std::atomic<int> concurrent_copy_count;
         bool is_finished;
+        bool streaming; // see nfs_streaming_copy_enabled
+        peer_state_ptr peer;
 
         std::vector<file_context_ptr> file_contexts;
 
         user_request()
         {
             high_priority = false;
+            priority = NFS_COPY_PRIORITY_BALANCE;
             low_queue_index = -1;
             finished_files = 0;
             concurrent_copy_count = 0;
             is_finished = false;
+            streaming = false;
         }
     };
 
@@ -201,8 +252,9 @@ public:
                 pop_it = queue_list.begin();
             auto start_it = pop_it;
             while (true) {
-                if (pop_it->front()->file_ctx->user_req->concurrent_copy_count <
-                    max_concurrent_copy_count_per_queue) {
+                const user_request_ptr &ureq = pop_it->front()->file_ctx->user_req;
+                if (ureq->concurrent_copy_count < max_concurrent_copy_count_per_queue &&
+                    ureq->peer->can_copy()) {
                     // ok, find one, pop from queue, and forward pop_it
                     p = pop_it->front();
                     pop_it->pop_front();
@@ -251,8 +303,15 @@ private:
 
     void handle_completion(const user_request_ptr &req, error_code err);
 
+    // save the blocks written of each file of a failed request, caller should hold user_req_lock
+    void save_copy_progress(const user_request_ptr &req);
+
     void register_cli_commands();
 
+    // the remote nodes are shared by all the nfs clients in the process
+    static peer_state_ptr get_peer(rpc_address addr);
+    static std::vector<peer_state_ptr> get_peers();
+
 private:
     std::unique_ptr<folly::TokenBucket> _copy_token_bucket; // rate limiter of copy from remote
 
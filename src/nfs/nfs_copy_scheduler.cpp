@@ -0,0 +1,107 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "nfs_copy_scheduler.h"
+
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/string_conv.h>
+#include <dsn/utility/strings.h>
+
+#include <algorithm>
+
+namespace dsn {
+namespace service {
+
+nfs_copy_scheduler::nfs_copy_scheduler(const std::vector<uint32_t> &weights)
+    : _priorities(NFS_COPY_PRIORITY_COUNT), _virtual_time(0), _size(0)
+{
+    dassert(weights.size() == NFS_COPY_PRIORITY_COUNT,
+            "%d weights are required, but %d are given",
+            NFS_COPY_PRIORITY_COUNT,
+            static_cast<int>(weights.size()));
+    for (int i = 0; i < NFS_COPY_PRIORITY_COUNT; ++i) {
+        dassert(weights[i] > 0, "the weight of priority %d should be positive", i);
+        _priorities[i].weight = weights[i];
+        _priorities[i].pass = 0;
+        _priorities[i].size = 0;
+    }
+}
+
+/*static*/ bool nfs_copy_scheduler::parse_weights(const std::string &str,
+                                                  /*out*/ std::vector<uint32_t> &weights)
+{
+    weights.clear();
+    std::vector<std::string> items;
+    utils::split_args(str.c_str(), items, ',');
+    if (items.size() != NFS_COPY_PRIORITY_COUNT) {
+        return false;
+    }
+    for (const std::string &item : items) {
+        uint32_t weight = 0;
+        if (!buf2uint32(item, weight) || weight == 0) {
+            return false;
+        }
+        weights.push_back(weight);
+    }
+    return true;
+}
+
+void nfs_copy_scheduler::enqueue(int32_t priority,
+                                 rpc_address client,
+                                 uint32_t bytes,
+                                 copy_fn &&copy)
+{
+    if (priority < 0 || priority >= NFS_COPY_PRIORITY_COUNT) {
+        priority = NFS_COPY_PRIORITY_BALANCE;
+    }
+    priority_queue &pq = _priorities[priority];
+    if (pq.size == 0) {
+        pq.pass = std::max(pq.pass, _virtual_time);
+    }
+
+    auto it = std::find_if(pq.clients.begin(), pq.clients.end(), [client](const client_queue &q) {
+        return q.client == client;
+    });
+    if (it == pq.clients.end()) {
+        it = pq.clients.emplace(pq.clients.end());
+        it->client = client;
+    }
+    it->copies.push_back(pending_copy{bytes, std::move(copy)});
+    ++pq.size;
+    ++_size;
+}
+
+bool nfs_copy_scheduler::dequeue(/*out*/ copy_fn &copy)
+{
+    // the one with the least pass is served, the higher priority wins a tie
+    priority_queue *next = nullptr;
+    for (int i = NFS_COPY_PRIORITY_COUNT - 1; i >= 0; --i) {
+        priority_queue &pq = _priorities[i];
+        if (pq.size > 0 && (next == nullptr || pq.pass < next->pass)) {
+            next = &pq;
+        }
+    }
+    if (next == nullptr) {
+        return false;
+    }
+
+    client_queue &cq = next->clients.front();
+    pending_copy &pc = cq.copies.front();
+    copy = std::move(pc.copy);
+    _virtual_time = next->pass;
+    // a copy of 0 bytes still costs a little, or it could be served endlessly
+    next->pass += static_cast<double>(std::max(pc.bytes, 1u)) / next->weight;
+    cq.copies.pop_front();
+    if (cq.copies.empty()) {
+        next->clients.pop_front();
+    } else {
+        next->clients.splice(next->clients.end(), next->clients, next->clients.begin());
+    }
+    --next->size;
+    --_size;
+    return true;
+}
+
+} // namespace service
+} // namespace dsn
@@ -0,0 +1,76 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <dsn/dist/nfs_node.h>
+#include <dsn/tool-api/rpc_address.h>
+
+#include <deque>
+#include <functional>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace dsn {
+namespace service {
+
+// Schedules the copies queued on the nfs server:
+// - the priorities share the bandwidth by their weights, i.e. each priority with copies queued
+//   gets bytes in proportion to its weight, by the stride scheduling over the copied bytes, so
+//   that the copies of lower priorities are slowed down rather than starved
+// - the clients of the same priority are served one copy each in turn
+// Not thread safe.
+class nfs_copy_scheduler
+{
+public:
+    typedef std::function<void()> copy_fn;
+
+    // `weights` are indexed by nfs_copy_priority
+    explicit nfs_copy_scheduler(const std::vector<uint32_t> &weights);
+
+    // parse the weights in the format of "<backup>,<balance>,<split>,<recovery>"
+    static bool parse_weights(const std::string &str, /*out*/ std::vector<uint32_t> &weights);
+
+    // the priorities out of range are served as NFS_COPY_PRIORITY_BALANCE
+    void enqueue(int32_t priority, rpc_address client, uint32_t bytes, copy_fn &&copy);
+
+    // returns false if no copy is queued
+    bool dequeue(/*out*/ copy_fn &copy);
+
+    size_t size() const { return _size; }
+    size_t size(nfs_copy_priority priority) const { return _priorities[priority].size; }
+
+private:
+    struct pending_copy
+    {
+        uint32_t bytes;
+        copy_fn copy;
+    };
+
+    struct client_queue
+    {
+        rpc_address client;
+        std::deque<pending_copy> copies;
+    };
+
+    struct priority_queue
+    {
+        uint32_t weight;
+        // the virtual time of this priority, which grows by bytes / weight as it is served
+        double pass;
+        size_t size;
+        // the front client is served next
+        std::list<client_queue> clients;
+    };
+
+    std::vector<priority_queue> _priorities;
+    // the pass of the priority served last, from which the idle priorities restart, so that
+    // they can't save up the bandwidth when idle
+    double _virtual_time;
+    size_t _size;
+};
+
+} // namespace service
+} // namespace dsn
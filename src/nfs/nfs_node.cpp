@@ -1,16 +1,52 @@
 #include <dsn/utility/smart_pointers.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <dsn/tool-api/async_calls.h>
 #include <dsn/dist/nfs_node.h>
 
+#include <algorithm>
+#include <set>
+
 #include "nfs_node_simple.h"
 
 namespace dsn {
 
+namespace service {
+DSN_DECLARE_bool(nfs_resumable_copy_enabled);
+} // namespace service
+
+const char *nfs_node::COPY_PROGRESS_SUFFIX = ".nfs_progress";
+
 std::unique_ptr<nfs_node> nfs_node::create()
 {
     return dsn::make_unique<dsn::service::nfs_node_simple>();
 }
 
+/*static*/ void nfs_node::prepare_copy_dir(const std::string &dest_dir,
+                                           const std::vector<std::string> &files)
+{
+    std::vector<std::string> sub_files;
+    if (!service::FLAGS_nfs_resumable_copy_enabled ||
+        !utils::filesystem::get_subfiles(dest_dir, sub_files, true)) {
+        utils::filesystem::remove_path(dest_dir);
+        return;
+    }
+
+    std::set<std::string> kept;
+    for (const std::string &file : files) {
+        kept.insert(file);
+        kept.insert(file + COPY_PROGRESS_SUFFIX);
+    }
+    for (const std::string &path : sub_files) {
+        // the paths are under `dest_dir`
+        std::string name = path.substr(std::min(dest_dir.size(), path.size()));
+        name.erase(0, name.find_first_not_of('/'));
+        if (kept.count(name) == 0) {
+            utils::filesystem::remove_path(path);
+        }
+    }
+}
+
 aio_task_ptr nfs_node::copy_remote_directory(rpc_address remote,
                                              const std::string &source_dir,
                                              const std::string &dest_dir,
@@ -19,7 +55,8 @@ aio_task_ptr nfs_node::copy_remote_directory(rpc_address remote,
                                              task_code callback_code,
                                              task_tracker *tracker,
                                              aio_handler &&callback,
-                                             int hash)
+                                             int hash,
+                                             nfs_copy_priority priority)
 {
     return copy_remote_files(remote,
                              source_dir,
@@ -30,7 +67,8 @@ aio_task_ptr nfs_node::copy_remote_directory(rpc_address remote,
                              callback_code,
                              tracker,
                              std::move(callback),
-                             hash);
+                             hash,
+                             priority);
 }
 
 aio_task_ptr nfs_node::copy_remote_files(rpc_address remote,
@@ -42,7 +80,8 @@ aio_task_ptr nfs_node::copy_remote_files(rpc_address remote,
                                          task_code callback_code,
                                          task_tracker *tracker,
                                          aio_handler &&callback,
-                                         int hash)
+                                         int hash,
+                                         nfs_copy_priority priority)
 {
     auto cb = dsn::file::create_aio_task(callback_code, tracker, std::move(callback), hash);
 
@@ -53,6 +92,7 @@ aio_task_ptr nfs_node::copy_remote_files(rpc_address remote,
     rci->dest_dir = dest_dir;
     rci->overwrite = overwrite;
     rci->high_priority = high_priority;
+    rci->priority = priority;
     call(rci, cb);
 
     return cb;
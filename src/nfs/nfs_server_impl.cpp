@@ -45,7 +45,31 @@ namespace service {
 DSN_DECLARE_int32(file_close_timer_interval_ms_on_server);
 DSN_DECLARE_int32(file_close_expire_time_ms);
 
-nfs_service_impl::nfs_service_impl() : ::dsn::serverlet<nfs_service_impl>("nfs")
+DSN_DEFINE_uint32("nfs",
+                  nfs_readahead_kb,
+                  4096,
+                  "the size of the file read ahead of the copy served by nfs server (KB), "
+                  "0 means no readahead except by the kernel");
+DSN_DEFINE_bool("nfs",
+                nfs_drop_behind,
+                true,
+                "whether to drop the pages of the file copied by nfs server from the page cache "
+                "once they are served, except those which were cached before");
+DSN_DEFINE_uint32("nfs",
+                  nfs_server_max_concurrent_reads,
+                  0,
+                  "the max count of the copies read concurrently by nfs server, the others are "
+                  "queued and served by their priorities, see nfs_server_priority_weights; 0 "
+                  "means the copies are read as soon as they arrive regardless of the priorities");
+DSN_DEFINE_string("nfs",
+                  nfs_server_priority_weights,
+                  "1,2,4,8",
+                  "the shares of the bandwidth of nfs server taken by the copies queued of each "
+                  "priority, in the format of \"<backup>,<balance>,<split>,<recovery>\"; the "
+                  "copies of the same priority are served from each client in turn");
+
+nfs_service_impl::nfs_service_impl()
+    : ::dsn::serverlet<nfs_service_impl>("nfs"), _reading_count(0)
 {
     _file_close_timer = ::dsn::tasking::enqueue_timer(
         LPC_NFS_FILE_CLOSE_TIMER,
@@ -62,6 +86,20 @@ nfs_service_impl::nfs_service_impl() : ::dsn::serverlet<nfs_service_impl>("nfs")
         "recent_copy_fail_count",
         COUNTER_TYPE_VOLATILE_NUMBER,
         "nfs server copy fail count count in the recent period");
+    _pending_copy_count.init_app_counter("eon.nfs_server",
+                                         "pending_copy_count",
+                                         COUNTER_TYPE_NUMBER,
+                                         "nfs server copy count queued to be read");
+
+    if (FLAGS_nfs_server_max_concurrent_reads > 0) {
+        std::vector<uint32_t> weights;
+        if (!nfs_copy_scheduler::parse_weights(FLAGS_nfs_server_priority_weights, weights)) {
+            derror("invalid nfs_server_priority_weights \"%s\", use \"1,1,1,1\" instead",
+                   FLAGS_nfs_server_priority_weights);
+            weights.assign(NFS_COPY_PRIORITY_COUNT, 1);
+        }
+        _copy_scheduler.reset(new nfs_copy_scheduler(weights));
+    }
 }
 
 void nfs_service_impl::on_copy(const ::dsn::service::copy_request &request,
@@ -69,9 +107,64 @@ void nfs_service_impl::on_copy(const ::dsn::service::copy_request &request,
 {
     // dinfo(">>> on call RPC_COPY end, exec RPC_NFS_COPY");
 
+    if (_copy_scheduler == nullptr) {
+        start_copy(request, std::move(reply));
+        return;
+    }
+
+    // std::function requires the copy to be copyable
+    auto req = std::make_shared<copy_request>(request);
+    auto replier = std::make_shared<rpc_replier<copy_response>>(std::move(reply));
+    rpc_address client = replier->to_address();
+    {
+        zauto_lock l(_copy_lock);
+        _copy_scheduler->enqueue(req->priority, client, req->size, [this, req, replier]() {
+            start_copy(*req, std::move(*replier));
+        });
+    }
+    dispatch_copies();
+}
+
+void nfs_service_impl::dispatch_copies()
+{
+    // the copies failed without reading are finished synchronously, which free the slots for
+    // the others
+    while (true) {
+        std::vector<nfs_copy_scheduler::copy_fn> copies;
+        {
+            zauto_lock l(_copy_lock);
+            nfs_copy_scheduler::copy_fn copy;
+            while (_reading_count < FLAGS_nfs_server_max_concurrent_reads &&
+                   _copy_scheduler->dequeue(copy)) {
+                ++_reading_count;
+                copies.push_back(std::move(copy));
+            }
+            _pending_copy_count->set(_copy_scheduler->size());
+        }
+        if (copies.empty()) {
+            return;
+        }
+        for (auto &copy : copies) {
+            copy();
+        }
+    }
+}
+
+void nfs_service_impl::on_copy_finished()
+{
+    if (_copy_scheduler != nullptr) {
+        zauto_lock l(_copy_lock);
+        --_reading_count;
+    }
+}
+
+void nfs_service_impl::start_copy(const copy_request &request,
+                                  ::dsn::rpc_replier<copy_response> &&reply)
+{
     std::string file_path =
         dsn::utils::filesystem::path_combine(request.source_dir, request.file_name);
     disk_file *hfile;
+    std::shared_ptr<file_handle_info_on_server> fh;
 
     {
         zauto_lock l(_handles_map_lock);
@@ -82,14 +175,17 @@ void nfs_service_impl::on_copy(const ::dsn::service::copy_request &request,
             hfile = file::open(file_path.c_str(), O_RDONLY | O_BINARY, 0);
             if (hfile) {
 
-                auto fh = std::make_shared<file_handle_info_on_server>();
+                fh = std::make_shared<file_handle_info_on_server>();
                 fh->file_handle = hfile;
                 fh->file_access_count = 1;
                 fh->last_access_time = dsn_now_ms();
-                _handles_map.insert(std::make_pair(file_path, std::move(fh)));
+                fh->advisor.reset(new utils::page_cache_advisor(
+                    file::native_fd(hfile), FLAGS_nfs_readahead_kb * 1024, FLAGS_nfs_drop_behind));
+                _handles_map.insert(std::make_pair(file_path, fh));
             }
         } else // found
         {
+            fh = it->second;
             hfile = it->second->file_handle;
             it->second->file_access_count++;
             it->second->last_access_time = dsn_now_ms();
@@ -106,12 +202,13 @@ void nfs_service_impl::on_copy(const ::dsn::service::copy_request &request,
         ::dsn::service::copy_response resp;
         resp.error = ERR_OBJECT_NOT_FOUND;
         reply(resp);
+        on_copy_finished();
         return;
     }
 
     std::shared_ptr<callback_para> cp = std::make_shared<callback_para>(std::move(reply));
     cp->bb = blob(dsn::utils::make_shared_array<char>(request.size), request.size);
-    cp->dst_dir = std::move(request.dst_dir);
+    cp->dst_dir = request.dst_dir;
     cp->file_path = std::move(file_path);
     cp->hfile = hfile;
     cp->offset = request.offset;
@@ -119,6 +216,7 @@ void nfs_service_impl::on_copy(const ::dsn::service::copy_request &request,
 
     auto buffer_save = cp->bb.buffer().get();
 
+    fh->advisor->on_read(request.offset, request.size);
     file::read(
         hfile,
         buffer_save,
@@ -150,11 +248,19 @@ void nfs_service_impl::internal_read_callback(error_code err, size_t sz, callbac
 
     ::dsn::service::copy_response resp;
     resp.error = err;
-    resp.file_content = std::move(cp.bb);
+    // large blocks are attached to the response without copying, see blob::write()
+    if (err == ERR_OK) {
+        resp.file_content = std::move(cp.bb);
+    }
     resp.offset = cp.offset;
     resp.size = cp.size;
 
     cp.replier(resp);
+
+    if (_copy_scheduler != nullptr) {
+        on_copy_finished();
+        dispatch_copies();
+    }
 }
 
 // RPC_NFS_NEW_NFS_GET_FILE_SIZE
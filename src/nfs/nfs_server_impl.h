@@ -35,9 +35,11 @@
 #pragma once
 #include <dsn/tool-api/task_tracker.h>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/utility/page_cache_advisor.h>
 
 #include "nfs_server.h"
 #include "nfs_client_impl.h"
+#include "nfs_copy_scheduler.h"
 
 namespace dsn {
 namespace service {
@@ -90,6 +92,8 @@ private:
         disk_file *file_handle;
         int32_t file_access_count; // concurrent r/w count
         uint64_t last_access_time; // last touch time
+        // the files are mostly read sequentially by the learners
+        std::unique_ptr<utils::page_cache_advisor> advisor;
 
         file_handle_info_on_server()
             : file_handle(nullptr), file_access_count(0), last_access_time(0)
@@ -98,13 +102,24 @@ private:
 
         ~file_handle_info_on_server()
         {
+            // the pages are dropped before the file is closed
+            advisor.reset();
             error_code err = file::close(file_handle);
             dassert(err == ERR_OK, "file::close failed, err = %s", err.to_string());
         }
     };
 
+    void start_copy(const copy_request &request, ::dsn::rpc_replier<copy_response> &&reply);
+
     void internal_read_callback(error_code err, size_t sz, callback_para &cp);
 
+    // start the copies queued in _copy_scheduler as long as the reads in flight are fewer than
+    // nfs_server_max_concurrent_reads
+    void dispatch_copies();
+
+    // a copy started by dispatch_copies() is finished
+    void on_copy_finished();
+
     void close_file();
 
 private:
@@ -114,8 +129,14 @@ private:
 
     ::dsn::task_ptr _file_close_timer;
 
+    // the copies are read as soon as they arrive if null, see nfs_server_max_concurrent_reads
+    std::unique_ptr<nfs_copy_scheduler> _copy_scheduler;
+    zlock _copy_lock;
+    uint32_t _reading_count; // protected by _copy_lock
+
     perf_counter_wrapper _recent_copy_data_size;
     perf_counter_wrapper _recent_copy_fail_count;
+    perf_counter_wrapper _pending_copy_count;
 
     dsn::task_tracker _tracker;
 };
@@ -32,6 +32,8 @@ void copy_request::__set_is_last(const bool val) { this->is_last = val; }
 
 void copy_request::__set_overwrite(const bool val) { this->overwrite = val; }
 
+void copy_request::__set_priority(const int32_t val) { this->priority = val; }
+
 uint32_t copy_request::read(::apache::thrift::protocol::TProtocol *iprot)
 {
 
@@ -115,6 +117,14 @@ uint32_t copy_request::read(::apache::thrift::protocol::TProtocol *iprot)
                 xfer += iprot->skip(ftype);
             }
             break;
+        case 9:
+            if (ftype == ::apache::thrift::protocol::T_I32) {
+                xfer += iprot->readI32(this->priority);
+                this->__isset.priority = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
         default:
             xfer += iprot->skip(ftype);
             break;
@@ -165,6 +175,10 @@ uint32_t copy_request::write(::apache::thrift::protocol::TProtocol *oprot) const
     xfer += oprot->writeBool(this->overwrite);
     xfer += oprot->writeFieldEnd();
 
+    xfer += oprot->writeFieldBegin("priority", ::apache::thrift::protocol::T_I32, 9);
+    xfer += oprot->writeI32(this->priority);
+    xfer += oprot->writeFieldEnd();
+
     xfer += oprot->writeFieldStop();
     xfer += oprot->writeStructEnd();
     return xfer;
@@ -181,6 +195,7 @@ void swap(copy_request &a, copy_request &b)
     swap(a.size, b.size);
     swap(a.is_last, b.is_last);
     swap(a.overwrite, b.overwrite);
+    swap(a.priority, b.priority);
     swap(a.__isset, b.__isset);
 }
 
@@ -194,6 +209,7 @@ copy_request::copy_request(const copy_request &other0)
     size = other0.size;
     is_last = other0.is_last;
     overwrite = other0.overwrite;
+    priority = other0.priority;
     __isset = other0.__isset;
 }
 copy_request::copy_request(copy_request &&other1)
@@ -206,6 +222,7 @@ copy_request::copy_request(copy_request &&other1)
     size = std::move(other1.size);
     is_last = std::move(other1.is_last);
     overwrite = std::move(other1.overwrite);
+    priority = std::move(other1.priority);
     __isset = std::move(other1.__isset);
 }
 copy_request &copy_request::operator=(const copy_request &other2)
@@ -218,6 +235,7 @@ copy_request &copy_request::operator=(const copy_request &other2)
     size = other2.size;
     is_last = other2.is_last;
     overwrite = other2.overwrite;
+    priority = other2.priority;
     __isset = other2.__isset;
     return *this;
 }
@@ -231,6 +249,7 @@ copy_request &copy_request::operator=(copy_request &&other3)
     size = std::move(other3.size);
     is_last = std::move(other3.is_last);
     overwrite = std::move(other3.overwrite);
+    priority = std::move(other3.priority);
     __isset = std::move(other3.__isset);
     return *this;
 }
@@ -253,6 +272,8 @@ void copy_request::printTo(std::ostream &out) const
         << "is_last=" << to_string(is_last);
     out << ", "
         << "overwrite=" << to_string(overwrite);
+    out << ", "
+        << "priority=" << to_string(priority);
     out << ")";
 }
 
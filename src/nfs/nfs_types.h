@@ -38,7 +38,8 @@ typedef struct _copy_request__isset
           offset(false),
           size(false),
           is_last(false),
-          overwrite(false)
+          overwrite(false),
+          priority(true)
     {
     }
     bool source : 1;
@@ -49,6 +50,7 @@ typedef struct _copy_request__isset
     bool size : 1;
     bool is_last : 1;
     bool overwrite : 1;
+    bool priority : 1;
 } _copy_request__isset;
 
 class copy_request
@@ -59,7 +61,14 @@ public:
     copy_request &operator=(const copy_request &);
     copy_request &operator=(copy_request &&);
     copy_request()
-        : source_dir(), dst_dir(), file_name(), offset(0), size(0), is_last(0), overwrite(0)
+        : source_dir(),
+          dst_dir(),
+          file_name(),
+          offset(0),
+          size(0),
+          is_last(0),
+          overwrite(0),
+          priority(1)
     {
     }
 
@@ -72,6 +81,7 @@ public:
     int32_t size;
     bool is_last;
     bool overwrite;
+    int32_t priority;
 
     _copy_request__isset __isset;
 
@@ -91,6 +101,8 @@ public:
 
     void __set_overwrite(const bool val);
 
+    void __set_priority(const int32_t val);
+
     bool operator==(const copy_request &rhs) const
     {
         if (!(source == rhs.source))
@@ -109,6 +121,8 @@ public:
             return false;
         if (!(overwrite == rhs.overwrite))
             return false;
+        if (!(priority == rhs.priority))
+            return false;
         return true;
     }
     bool operator!=(const copy_request &rhs) const { return !(*this == rhs); }
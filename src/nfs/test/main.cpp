@@ -4,10 +4,27 @@
 #include <dsn/utility/filesystem.h>
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/command_manager.h>
 #include <dsn/dist/nfs_node.h>
+#include <dsn/utility/defer.h>
+#include <dsn/utility/flags.h>
+#include <fstream>
+#include <sstream>
+
+#include "../nfs_copy_scheduler.h"
 
 using namespace dsn;
 
+namespace dsn {
+namespace service {
+DSN_DECLARE_bool(nfs_streaming_copy_enabled);
+DSN_DECLARE_uint32(nfs_copy_block_bytes);
+DSN_DECLARE_bool(nfs_adaptive_copy_enabled);
+DSN_DECLARE_uint32(nfs_min_copy_block_bytes);
+DSN_DECLARE_bool(nfs_resumable_copy_enabled);
+} // namespace service
+} // namespace dsn
+
 DEFINE_TASK_CODE_AIO(LPC_AIO_TEST_NFS, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
 struct aio_result
 {
@@ -142,6 +159,277 @@ TEST(nfs, basic)
     }
 }
 
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+TEST(nfs, streaming_copy)
+{
+    uint32_t old_block_bytes = service::FLAGS_nfs_copy_block_bytes;
+    auto cleanup = dsn::defer([old_block_bytes]() {
+        service::FLAGS_nfs_streaming_copy_enabled = false;
+        service::FLAGS_nfs_copy_block_bytes = old_block_bytes;
+    });
+    service::FLAGS_nfs_streaming_copy_enabled = true;
+    // split the files into many blocks, which may complete out of order
+    service::FLAGS_nfs_copy_block_bytes = 100;
+
+    std::unique_ptr<dsn::nfs_node> nfs(dsn::nfs_node::create());
+    nfs->start();
+
+    utils::filesystem::remove_path("nfs_test_dir_streaming");
+    ASSERT_TRUE(utils::filesystem::create_directory("nfs_test_dir_streaming"));
+
+    // the stale tail of an overwritten file should be dropped
+    {
+        std::ofstream out("nfs_test_dir_streaming/nfs_test_file1", std::ios::binary);
+        out << std::string(10000, 'x');
+    }
+
+    std::vector<std::string> files{"nfs_test_file1", "nfs_test_file2"};
+    aio_result r;
+    dsn::aio_task_ptr t = nfs->copy_remote_files(dsn::rpc_address("localhost", 20101),
+                                                 ".",
+                                                 files,
+                                                 "nfs_test_dir_streaming",
+                                                 true,
+                                                 false,
+                                                 LPC_AIO_TEST_NFS,
+                                                 nullptr,
+                                                 [&r](dsn::error_code err, size_t sz) {
+                                                     r.err = err;
+                                                     r.sz = sz;
+                                                 },
+                                                 0);
+    ASSERT_NE(nullptr, t);
+    ASSERT_TRUE(t->wait(20000));
+    ASSERT_EQ(ERR_OK, r.err);
+    ASSERT_EQ(r.sz, t->get_transferred_size());
+
+    for (const auto &file : files) {
+        std::string src = read_file(file);
+        ASSERT_FALSE(src.empty());
+        ASSERT_EQ(src, read_file("nfs_test_dir_streaming/" + file)) << file;
+    }
+
+    utils::filesystem::remove_path("nfs_test_dir_streaming");
+}
+
+TEST(nfs, adaptive_copy)
+{
+    uint32_t old_block_bytes = service::FLAGS_nfs_copy_block_bytes;
+    uint32_t old_min_block_bytes = service::FLAGS_nfs_min_copy_block_bytes;
+    auto cleanup = dsn::defer([old_block_bytes, old_min_block_bytes]() {
+        service::FLAGS_nfs_adaptive_copy_enabled = false;
+        service::FLAGS_nfs_copy_block_bytes = old_block_bytes;
+        service::FLAGS_nfs_min_copy_block_bytes = old_min_block_bytes;
+    });
+    service::FLAGS_nfs_adaptive_copy_enabled = true;
+    service::FLAGS_nfs_copy_block_bytes = 1000;
+    service::FLAGS_nfs_min_copy_block_bytes = 100;
+
+    std::unique_ptr<dsn::nfs_node> nfs(dsn::nfs_node::create());
+    nfs->start();
+
+    utils::filesystem::remove_path("nfs_test_dir_adaptive");
+    ASSERT_TRUE(utils::filesystem::create_directory("nfs_test_dir_adaptive"));
+
+    // the block size and the window of the remote node change between the copies
+    std::vector<std::string> files{"nfs_test_file1", "nfs_test_file2"};
+    for (int i = 0; i < 3; ++i) {
+        aio_result r;
+        dsn::aio_task_ptr t = nfs->copy_remote_files(dsn::rpc_address("localhost", 20101),
+                                                     ".",
+                                                     files,
+                                                     "nfs_test_dir_adaptive",
+                                                     true,
+                                                     false,
+                                                     LPC_AIO_TEST_NFS,
+                                                     nullptr,
+                                                     [&r](dsn::error_code err, size_t sz) {
+                                                         r.err = err;
+                                                         r.sz = sz;
+                                                     },
+                                                     0);
+        ASSERT_NE(nullptr, t);
+        ASSERT_TRUE(t->wait(20000));
+        ASSERT_EQ(ERR_OK, r.err);
+
+        for (const auto &file : files) {
+            ASSERT_EQ(read_file(file), read_file("nfs_test_dir_adaptive/" + file)) << file;
+        }
+    }
+
+    std::string output;
+    ASSERT_TRUE(dsn::command_manager::instance().run_command("nfs.peers", {}, output));
+    ASSERT_NE(std::string::npos, output.find("20101")) << output;
+
+    utils::filesystem::remove_path("nfs_test_dir_adaptive");
+}
+
+TEST(nfs, resumable_copy)
+{
+    uint32_t old_block_bytes = service::FLAGS_nfs_copy_block_bytes;
+    auto cleanup = dsn::defer([old_block_bytes]() {
+        service::FLAGS_nfs_resumable_copy_enabled = false;
+        service::FLAGS_nfs_copy_block_bytes = old_block_bytes;
+    });
+    service::FLAGS_nfs_resumable_copy_enabled = true;
+    service::FLAGS_nfs_copy_block_bytes = 100;
+
+    const std::string dir = "nfs_test_dir_resumable";
+    const std::string file = "nfs_test_file1";
+    const std::string dest = dir + "/" + file;
+    const std::string progress = dest + nfs_node::COPY_PROGRESS_SUFFIX;
+    std::string src = read_file(file);
+    ASSERT_GT(src.size(), 450u);
+
+    // the files not to be copied are removed
+    utils::filesystem::remove_path(dir);
+    ASSERT_TRUE(utils::filesystem::create_directory(dir));
+    { std::ofstream(dir + "/stale_file") << "stale"; }
+    { std::ofstream(dest, std::ios::binary) << std::string(src.size(), 'x'); }
+    // block 1 and 2 were written by the last copy, with the block size of 150
+    {
+        std::ofstream out(progress);
+        out << dsn::rpc_address("localhost", 20101).to_string() << ":"
+            << utils::filesystem::path_combine(".", file) << "\n"
+            << src.size() << " 150\n"
+            << "1 2\n";
+    }
+    nfs_node::prepare_copy_dir(dir, {file});
+    ASSERT_FALSE(utils::filesystem::file_exists(dir + "/stale_file"));
+    ASSERT_TRUE(utils::filesystem::file_exists(dest));
+    ASSERT_TRUE(utils::filesystem::file_exists(progress));
+
+    std::unique_ptr<dsn::nfs_node> nfs(dsn::nfs_node::create());
+    nfs->start();
+
+    aio_result r;
+    dsn::aio_task_ptr t = nfs->copy_remote_files(dsn::rpc_address("localhost", 20101),
+                                                 ".",
+                                                 {file},
+                                                 dir,
+                                                 true,
+                                                 false,
+                                                 LPC_AIO_TEST_NFS,
+                                                 nullptr,
+                                                 [&r](dsn::error_code err, size_t sz) {
+                                                     r.err = err;
+                                                     r.sz = sz;
+                                                 },
+                                                 0);
+    ASSERT_NE(nullptr, t);
+    ASSERT_TRUE(t->wait(20000));
+    ASSERT_EQ(ERR_OK, r.err);
+
+    // the blocks written are not copied again
+    std::string copied = read_file(dest);
+    ASSERT_EQ(src.size(), copied.size());
+    ASSERT_EQ(src.substr(0, 150), copied.substr(0, 150));
+    ASSERT_EQ(std::string(300, 'x'), copied.substr(150, 300));
+    ASSERT_EQ(src.substr(450), copied.substr(450));
+    ASSERT_FALSE(utils::filesystem::file_exists(progress));
+
+    utils::filesystem::remove_path(dir);
+}
+
+TEST(nfs, copy_scheduler_parse_weights)
+{
+    std::vector<uint32_t> weights;
+    ASSERT_TRUE(service::nfs_copy_scheduler::parse_weights("1,2,4,8", weights));
+    ASSERT_EQ(std::vector<uint32_t>({1, 2, 4, 8}), weights);
+
+    ASSERT_FALSE(service::nfs_copy_scheduler::parse_weights("", weights));
+    ASSERT_FALSE(service::nfs_copy_scheduler::parse_weights("1,2,4", weights));
+    ASSERT_FALSE(service::nfs_copy_scheduler::parse_weights("1,2,4,0", weights));
+    ASSERT_FALSE(service::nfs_copy_scheduler::parse_weights("1,2,4,a", weights));
+}
+
+TEST(nfs, copy_scheduler_priority_shares)
+{
+    service::nfs_copy_scheduler scheduler({1, 2, 4, 8});
+    rpc_address client("127.0.0.1", 1);
+    std::vector<int> served(NFS_COPY_PRIORITY_COUNT, 0);
+    for (int i = 0; i < 100; ++i) {
+        for (int p = 0; p < NFS_COPY_PRIORITY_COUNT; ++p) {
+            scheduler.enqueue(p, client, 1000, [&served, p]() { ++served[p]; });
+        }
+    }
+    ASSERT_EQ(400, scheduler.size());
+
+    service::nfs_copy_scheduler::copy_fn copy;
+    for (int i = 0; i < 150; ++i) {
+        ASSERT_TRUE(scheduler.dequeue(copy));
+        copy();
+    }
+    ASSERT_EQ(std::vector<int>({10, 20, 40, 80}), served);
+    ASSERT_EQ(20, scheduler.size(NFS_COPY_PRIORITY_RECOVERY));
+
+    // the lower priorities take the bandwidth left by the higher ones
+    while (scheduler.dequeue(copy)) {
+        copy();
+    }
+    ASSERT_EQ(std::vector<int>({100, 100, 100, 100}), served);
+    ASSERT_EQ(0, scheduler.size());
+
+    // the priorities out of range are served as balance
+    scheduler.enqueue(100, client, 1000, []() {});
+    ASSERT_EQ(1, scheduler.size(NFS_COPY_PRIORITY_BALANCE));
+}
+
+TEST(nfs, copy_scheduler_idle_priority)
+{
+    service::nfs_copy_scheduler scheduler({1, 2, 4, 8});
+    rpc_address client("127.0.0.1", 1);
+    int backup = 0;
+    int recovery = 0;
+    service::nfs_copy_scheduler::copy_fn copy;
+    for (int i = 0; i < 100; ++i) {
+        scheduler.enqueue(NFS_COPY_PRIORITY_BACKUP, client, 1000, [&backup]() { ++backup; });
+        ASSERT_TRUE(scheduler.dequeue(copy));
+        copy();
+    }
+
+    // the recovery idle for long doesn't starve the backup
+    for (int i = 0; i < 100; ++i) {
+        scheduler.enqueue(NFS_COPY_PRIORITY_BACKUP, client, 1000, [&backup]() { ++backup; });
+        scheduler.enqueue(NFS_COPY_PRIORITY_RECOVERY, client, 1000, [&recovery]() { ++recovery; });
+    }
+    for (int i = 0; i < 90; ++i) {
+        ASSERT_TRUE(scheduler.dequeue(copy));
+        copy();
+    }
+    ASSERT_EQ(81, recovery);
+    ASSERT_EQ(109, backup);
+}
+
+TEST(nfs, copy_scheduler_client_fairness)
+{
+    service::nfs_copy_scheduler scheduler({1, 1, 1, 1});
+    rpc_address client1("127.0.0.1", 1);
+    rpc_address client2("127.0.0.1", 2);
+    std::vector<int> served;
+    for (int i = 0; i < 3; ++i) {
+        scheduler.enqueue(
+            NFS_COPY_PRIORITY_BALANCE, client1, 1000, [&served, i]() { served.push_back(i); });
+    }
+    for (int i = 10; i < 12; ++i) {
+        scheduler.enqueue(
+            NFS_COPY_PRIORITY_BALANCE, client2, 1000, [&served, i]() { served.push_back(i); });
+    }
+
+    service::nfs_copy_scheduler::copy_fn copy;
+    while (scheduler.dequeue(copy)) {
+        copy();
+    }
+    ASSERT_EQ(std::vector<int>({0, 10, 1, 11, 2}), served);
+}
+
 GTEST_API_ int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
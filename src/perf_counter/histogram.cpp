@@ -0,0 +1,165 @@
+// Copyright (c) 2017-present, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/perf_counter/histogram.h>
+#include <dsn/utility/process_utils.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace dsn {
+
+void histogram_snapshot::clear()
+{
+    _buckets.clear();
+    _count = 0;
+    _sum = 0;
+}
+
+void histogram_snapshot::merge(const histogram_snapshot &other)
+{
+    if (other._buckets.empty()) {
+        return;
+    }
+    if (_buckets.empty()) {
+        _buckets.resize(other._buckets.size(), 0);
+    }
+    for (size_t i = 0; i < _buckets.size(); ++i) {
+        _buckets[i] += other._buckets[i];
+    }
+    _count += other._count;
+    _sum += other._sum;
+}
+
+void histogram_snapshot::subtract(const histogram_snapshot &base)
+{
+    if (base._buckets.empty()) {
+        return;
+    }
+    if (_buckets.empty()) {
+        // nothing recorded since base, which must also be empty
+        return;
+    }
+    for (size_t i = 0; i < _buckets.size(); ++i) {
+        // buckets are sampled one by one, so a concurrent record() may be missing in
+        // `this` but present in `base`, take it as zero
+        _buckets[i] = _buckets[i] >= base._buckets[i] ? _buckets[i] - base._buckets[i] : 0;
+    }
+    _count = _count >= base._count ? _count - base._count : 0;
+    _sum -= base._sum;
+}
+
+int64_t histogram_snapshot::quantile(double quantile) const
+{
+    if (_count == 0) {
+        return 0;
+    }
+
+    quantile = std::min(std::max(quantile, 0.0), 1.0);
+    uint64_t rank = std::max(static_cast<uint64_t>(std::ceil(quantile * _count)), (uint64_t)1);
+    uint64_t seen = 0;
+    int last = 0;
+    for (size_t i = 0; i < _buckets.size(); ++i) {
+        if (_buckets[i] == 0) {
+            continue;
+        }
+        last = static_cast<int>(i);
+        seen += _buckets[i];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    return log_linear_histogram::bucket_value(last);
+}
+
+log_linear_histogram::log_linear_histogram()
+{
+    for (auto &s : _shards) {
+        s.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+log_linear_histogram::~log_linear_histogram()
+{
+    for (auto &s : _shards) {
+        delete s.load();
+    }
+}
+
+/*static*/ int log_linear_histogram::bucket_index(int64_t value)
+{
+    if (value < 2 * SUB_BUCKET_COUNT) {
+        return value < 0 ? 0 : static_cast<int>(value);
+    }
+    if (value >= (int64_t(1) << MAX_VALUE_BITS)) {
+        value = (int64_t(1) << MAX_VALUE_BITS) - 1;
+    }
+
+    // [2^msb, 2^(msb+1)) is divided into SUB_BUCKET_COUNT buckets of width 2^shift
+    int msb = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+    int shift = msb - SUB_BUCKET_BITS;
+    return shift * SUB_BUCKET_COUNT + static_cast<int>(value >> shift);
+}
+
+/*static*/ int64_t log_linear_histogram::bucket_value(int index)
+{
+    if (index < 2 * SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    int shift = index / SUB_BUCKET_COUNT - 1;
+    int64_t mantissa = index - shift * SUB_BUCKET_COUNT;
+    // the middle of [mantissa << shift, (mantissa + 1) << shift)
+    return (mantissa << shift) + ((int64_t(1) << shift) >> 1);
+}
+
+log_linear_histogram::shard *log_linear_histogram::get_shard()
+{
+    std::atomic<shard *> &slot = _shards[utils::get_current_tid() % SHARD_COUNT];
+    shard *s = slot.load(std::memory_order_acquire);
+    if (s != nullptr) {
+        return s;
+    }
+
+    shard *created = new shard();
+    for (auto &b : created->buckets) {
+        b.store(0, std::memory_order_relaxed);
+    }
+    created->sum.store(0, std::memory_order_relaxed);
+    if (slot.compare_exchange_strong(s, created, std::memory_order_acq_rel)) {
+        return created;
+    }
+    // another thread of the same shard has allocated it
+    delete created;
+    return s;
+}
+
+void log_linear_histogram::record(int64_t value)
+{
+    shard *s = get_shard();
+    s->buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    s->sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+void log_linear_histogram::take_snapshot(/*out*/ histogram_snapshot &snapshot) const
+{
+    snapshot.clear();
+    for (const auto &slot : _shards) {
+        const shard *s = slot.load(std::memory_order_acquire);
+        if (s == nullptr) {
+            continue;
+        }
+        if (snapshot._buckets.empty()) {
+            snapshot._buckets.resize(BUCKET_COUNT, 0);
+        }
+        for (int i = 0; i < BUCKET_COUNT; ++i) {
+            uint64_t c = s->buckets[i].load(std::memory_order_relaxed);
+            snapshot._buckets[i] += c;
+            snapshot._count += c;
+        }
+        snapshot._sum += s->sum.load(std::memory_order_relaxed);
+    }
+}
+
+} // namespace dsn
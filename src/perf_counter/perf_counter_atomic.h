@@ -6,19 +6,101 @@
 #include <boost/make_shared.hpp>
 #include <dsn/utility/utils.h>
 #include <dsn/utility/config_api.h>
+#include <dsn/utility/flags.h>
 #include <dsn/c/api_utilities.h>
 #include <dsn/perf_counter/perf_counter.h>
 #include <dsn/utility/time_utils.h>
+#include <dsn/utility/synchronize.h>
 #include "core/tools/common/shared_io_service.h"
 
 namespace dsn {
 
+DSN_DECLARE_uint32(counter_computation_interval_seconds);
+DSN_DECLARE_uint64(window_seconds);
+
+// -----------   sharded number for NUMBER/VOLATILE_NUMBER/RATE ---------------------------------
+
+//
+// sharded_number keeps a number in COUNTER_SHARD_COUNT shards, each of which is padded to a
+// cache line, so that the threads updating the same hot counter won't bounce the line among
+// cores. A thread is assigned with a shard in a round-robin way on its first update, thus no two
+// threads share a shard unless there are more than COUNTER_SHARD_COUNT updating threads.
+// The shards are aggregated on read.
+//
+#define COUNTER_SHARD_COUNT 32
+#define COUNTER_CACHELINE_SIZE 64
+
+class sharded_number
+{
+public:
+    sharded_number()
+    {
+        for (int i = 0; i < COUNTER_SHARD_COUNT; i++) {
+            _shards[i].val.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void add(int64_t val)
+    {
+        _shards[current_shard()].val.fetch_add(val, std::memory_order_relaxed);
+    }
+
+    // store `val` into the first shard and zero the others, concurrent updates may be lost
+    void set(int64_t val)
+    {
+        for (int i = 1; i < COUNTER_SHARD_COUNT; i++) {
+            _shards[i].val.store(0, std::memory_order_relaxed);
+        }
+        _shards[0].val.store(val, std::memory_order_relaxed);
+    }
+
+    int64_t sum() const
+    {
+        int64_t val = 0;
+        for (int i = 0; i < COUNTER_SHARD_COUNT; i++) {
+            val += _shards[i].val.load(std::memory_order_relaxed);
+        }
+        return val;
+    }
+
+    // reset all the shards to zero and return the sum of them
+    int64_t fetch_and_reset()
+    {
+        int64_t val = 0;
+        for (int i = 0; i < COUNTER_SHARD_COUNT; i++) {
+            val += _shards[i].val.exchange(0, std::memory_order_relaxed);
+        }
+        return val;
+    }
+
+    static int current_shard()
+    {
+        static std::atomic<int> next_shard(0);
+        static thread_local int shard = -1;
+        if (dsn_unlikely(shard == -1)) {
+            shard = next_shard.fetch_add(1, std::memory_order_relaxed) % COUNTER_SHARD_COUNT;
+        }
+        return shard;
+    }
+
+private:
+    // the padding keeps any two shards in different cache lines, even if the counter
+    // itself is not aligned to a cache line
+    struct shard
+    {
+        std::atomic<int64_t> val;
+        char padding[COUNTER_CACHELINE_SIZE - sizeof(std::atomic<int64_t>)];
+    };
+    static_assert(sizeof(shard) == COUNTER_CACHELINE_SIZE, "shard should fill a cache line");
+
+    shard _shards[COUNTER_SHARD_COUNT];
+};
+
 #pragma pack(push)
 #pragma pack(8)
 
 // -----------   NUMBER perf counter ---------------------------------
 
-#define DIVIDE_CONTAINER 107
 class perf_counter_number_atomic : public perf_counter
 {
 public:
@@ -29,52 +111,21 @@ public:
                                const char *dsptr)
         : perf_counter(app, section, name, type, dsptr)
     {
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            _val[i].store(0);
-        }
     }
     ~perf_counter_number_atomic(void) {}
 
-    virtual void increment()
-    {
-        uint64_t task_id = static_cast<int>(utils::get_current_tid());
-        _val[task_id % DIVIDE_CONTAINER].fetch_add(1, std::memory_order_relaxed);
-    }
-    virtual void decrement()
-    {
-        uint64_t task_id = static_cast<int>(utils::get_current_tid());
-        _val[task_id % DIVIDE_CONTAINER].fetch_sub(1, std::memory_order_relaxed);
-    }
-    virtual void add(int64_t val)
-    {
-        uint64_t task_id = static_cast<int>(utils::get_current_tid());
-        _val[task_id % DIVIDE_CONTAINER].fetch_add(val, std::memory_order_relaxed);
-    }
+    virtual void increment() { _val.add(1); }
+    virtual void decrement() { _val.add(-1); }
+    virtual void add(int64_t val) { _val.add(val); }
     virtual void set(int64_t val)
     {
         // the set-op of number is reset the number to zero.
         // for simplicity, only set other zero, not add the lock to protect, if needed, should add
         // lock.
-        for (int i = 0; i < DIVIDE_CONTAINER; i++)
-            _val[i].store(0, std::memory_order_relaxed);
-        _val[0].store(val, std::memory_order_relaxed);
-    }
-    virtual double get_value()
-    {
-        double val = 0;
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            val += static_cast<double>(_val[i].load(std::memory_order_relaxed));
-        }
-        return val;
-    }
-    virtual int64_t get_integer_value()
-    {
-        int64_t val = 0;
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            val += _val[i].load(std::memory_order_relaxed);
-        }
-        return val;
+        _val.set(val);
     }
+    virtual double get_value() { return static_cast<double>(_val.sum()); }
+    virtual int64_t get_integer_value() { return _val.sum(); }
     virtual double get_percentile(dsn_perf_counter_percentile_type_t type)
     {
         dassert(false, "invalid execution flow");
@@ -82,7 +133,7 @@ public:
     }
 
 protected:
-    std::atomic<int64_t> _val[DIVIDE_CONTAINER];
+    sharded_number _val;
 };
 
 // -----------   VOLATILE_NUMBER perf counter ---------------------------------
@@ -100,22 +151,8 @@ public:
     }
     ~perf_counter_volatile_number_atomic(void) {}
 
-    virtual double get_value()
-    {
-        double val = 0;
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            val += static_cast<double>(_val[i].exchange(0, std::memory_order_relaxed));
-        }
-        return val;
-    }
-    virtual int64_t get_integer_value()
-    {
-        int64_t val = 0;
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            val += _val[i].exchange(0, std::memory_order_relaxed);
-        }
-        return val;
-    }
+    virtual double get_value() { return static_cast<double>(_val.fetch_and_reset()); }
+    virtual int64_t get_integer_value() { return _val.fetch_and_reset(); }
 };
 
 // -----------   RATE perf counter ---------------------------------
@@ -131,27 +168,12 @@ public:
         : perf_counter(app, section, name, type, dsptr), _rate(0)
     {
         _last_time = utils::get_current_physical_time_ns();
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            _val[i].store(0, std::memory_order_relaxed);
-        }
     }
     ~perf_counter_rate_atomic(void) {}
 
-    virtual void increment()
-    {
-        uint64_t task_id = static_cast<int>(utils::get_current_tid());
-        _val[task_id % DIVIDE_CONTAINER].fetch_add(1, std::memory_order_relaxed);
-    }
-    virtual void decrement()
-    {
-        uint64_t task_id = static_cast<int>(utils::get_current_tid());
-        _val[task_id % DIVIDE_CONTAINER].fetch_sub(1, std::memory_order_relaxed);
-    }
-    virtual void add(int64_t val)
-    {
-        uint64_t task_id = static_cast<int>(utils::get_current_tid());
-        _val[task_id % DIVIDE_CONTAINER].fetch_add(val, std::memory_order_relaxed);
-    }
+    virtual void increment() { _val.add(1); }
+    virtual void decrement() { _val.add(-1); }
+    virtual void add(int64_t val) { _val.add(val); }
     virtual void set(int64_t val) { dassert(false, "invalid execution flow"); }
     virtual double get_value()
     {
@@ -160,11 +182,7 @@ public:
         if (interval <= 0.1)
             return _rate;
 
-        double val = 0;
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            val += _val[i].fetch_and(0, std::memory_order_relaxed);
-        }
-
+        double val = static_cast<double>(_val.fetch_and_reset());
         _rate = val / interval;
         _last_time = now;
         return _rate;
@@ -179,7 +197,7 @@ public:
 private:
     std::atomic<double> _rate;
     std::atomic<uint64_t> _last_time;
-    std::atomic<int64_t> _val[DIVIDE_CONTAINER];
+    sharded_number _val;
 };
 
 // -----------   NUMBER_PERCENTILE perf counter ---------------------------------
@@ -206,15 +224,9 @@ public:
         _results[COUNTER_PERCENTILE_99] = 0;
         _results[COUNTER_PERCENTILE_999] = 0;
 
-        _counter_computation_interval_seconds = (int)dsn_config_get_value_uint64(
-            "components.pegasus_perf_counter_number_percentile_atomic",
-            "counter_computation_interval_seconds",
-            10,
-            "period (seconds) the system computes the percentiles of the "
-            "pegasus_perf_counter_number_percentile_atomic counters");
         _timer.reset(new boost::asio::deadline_timer(tools::shared_io_service::instance().ios));
         _timer->expires_from_now(
-            boost::posix_time::seconds(rand() % _counter_computation_interval_seconds + 1));
+            boost::posix_time::seconds(rand() % FLAGS_counter_computation_interval_seconds + 1));
         _timer->async_wait(std::bind(
             &perf_counter_number_percentile_atomic::on_timer, this, _timer, std::placeholders::_1));
     }
@@ -418,8 +430,9 @@ private:
         if (!ec) {
             calc(boost::make_shared<compute_context>());
 
+            // read on each round, as it may be updated at runtime
             timer->expires_from_now(
-                boost::posix_time::seconds(_counter_computation_interval_seconds));
+                boost::posix_time::seconds(FLAGS_counter_computation_interval_seconds));
             timer->async_wait(std::bind(&perf_counter_number_percentile_atomic::on_timer,
                                         this,
                                         timer,
@@ -433,7 +446,100 @@ private:
     std::atomic<uint64_t> _tail; // should use unsigned int to avoid out of bound
     int64_t _samples[MAX_QUEUE_LENGTH];
     int64_t _results[COUNTER_PERCENTILE_COUNT];
-    int _counter_computation_interval_seconds;
+};
+
+// -----------   HISTOGRAM perf counter ---------------------------------
+
+// Unlike perf_counter_number_percentile_atomic which keeps the latest MAX_QUEUE_LENGTH samples
+// and computes the percentiles on a timer, every sample is recorded into a lock-free
+// log_linear_histogram, and the quantiles are computed on demand from the increment of the
+// histogram during the latest completed window of `window_seconds`.
+class perf_counter_histogram_atomic : public perf_counter
+{
+public:
+    perf_counter_histogram_atomic(const char *app,
+                                  const char *section,
+                                  const char *name,
+                                  dsn_perf_counter_type_t type,
+                                  const char *dsptr)
+        : perf_counter(app, section, name, type, dsptr), _latest_sample(0)
+    {
+        _window_ns = FLAGS_window_seconds * 1000000000;
+        _window_start_ns = utils::get_current_physical_time_ns();
+    }
+    ~perf_counter_histogram_atomic(void) {}
+
+    virtual void increment() { dassert(false, "invalid execution flow"); }
+    virtual void decrement() { dassert(false, "invalid execution flow"); }
+    virtual void add(int64_t val) { dassert(false, "invalid execution flow"); }
+    virtual void set(int64_t val)
+    {
+        _histogram.record(val);
+        _latest_sample.store(val, std::memory_order_relaxed);
+    }
+
+    virtual double get_value()
+    {
+        dassert(false, "invalid execution flow");
+        return 0.0;
+    }
+    virtual int64_t get_integer_value() { return (int64_t)get_value(); }
+
+    virtual double get_percentile(dsn_perf_counter_percentile_type_t type)
+    {
+        static const double quantiles[COUNTER_PERCENTILE_COUNT] = {0.5, 0.9, 0.95, 0.99, 0.999};
+        if ((type < 0) || (type >= COUNTER_PERCENTILE_COUNT)) {
+            dassert(false, "send a wrong counter percentile type");
+            return 0.0;
+        }
+        return get_quantile(quantiles[type]);
+    }
+
+    virtual double get_quantile(double quantile) override
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        update_window();
+        return (double)_last_window.quantile(quantile);
+    }
+
+    virtual bool get_histogram_snapshot(/*out*/ histogram_snapshot &snapshot) override
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        update_window();
+        snapshot = _last_window;
+        return true;
+    }
+
+    virtual int64_t get_latest_sample() const override
+    {
+        return _latest_sample.load(std::memory_order_relaxed);
+    }
+
+private:
+    // roll the window if it's completed, called with _lock held
+    void update_window()
+    {
+        uint64_t now = utils::get_current_physical_time_ns();
+        if (now - _window_start_ns < _window_ns) {
+            return;
+        }
+
+        histogram_snapshot current;
+        _histogram.take_snapshot(current);
+        _last_window = current;
+        _last_window.subtract(_window_base);
+        _window_base = std::move(current);
+        _window_start_ns = now;
+    }
+
+    log_linear_histogram _histogram;
+    std::atomic<int64_t> _latest_sample;
+
+    utils::ex_lock_nr _lock; // protect the fields below, never taken by set()
+    uint64_t _window_ns;
+    uint64_t _window_start_ns;
+    histogram_snapshot _window_base; // snapshot of _histogram when the window starts
+    histogram_snapshot _last_window; // increment of _histogram in the latest completed window
 };
 
 #pragma pack(pop)
@@ -36,6 +36,7 @@
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/tool-api/task.h>
 #include <dsn/utility/string_view.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/time_utils.h>
 
 #include "perf_counter_atomic.h"
@@ -44,6 +45,24 @@
 
 namespace dsn {
 
+// the counters are created on hot paths, e.g. per replica, so the options are read as flags
+// rather than from the config on each creation
+DSN_DEFINE_uint32("components.pegasus_perf_counter_number_percentile_atomic",
+                  counter_computation_interval_seconds,
+                  10,
+                  "period (seconds) the system computes the percentiles of the "
+                  "pegasus_perf_counter_number_percentile_atomic counters");
+DSN_DEFINE_validator(counter_computation_interval_seconds,
+                     [](uint32_t value) -> bool { return value > 0; });
+DSN_TAG_VARIABLE(counter_computation_interval_seconds, FT_MUTABLE);
+
+DSN_DEFINE_uint64("components.perf_counter_histogram_atomic",
+                  window_seconds,
+                  10,
+                  "period (seconds) the percentiles of the perf_counter_histogram_atomic "
+                  "counters cover");
+DSN_DEFINE_validator(window_seconds, [](uint64_t value) -> bool { return value > 0; });
+
 perf_counters::perf_counters()
 {
     command_manager::instance().register_command(
@@ -112,12 +131,14 @@ perf_counter_ptr perf_counters::get_global_counter(const char *app,
     std::string full_name;
     perf_counter::build_full_name(app, section, name, full_name);
 
-    utils::auto_write_lock l(_lock);
+    counter_shard &shard = _shards[shard_of(full_name)];
+    utils::auto_write_lock l(shard.lock);
     if (create_if_not_exist) {
-        auto it = _counters.find(full_name);
-        if (it == _counters.end()) {
+        auto it = shard.counters.find(full_name);
+        if (it == shard.counters.end()) {
             perf_counter_ptr counter = new_counter(app, section, name, flags, dsptr);
-            _counters.emplace(full_name, counter_object{counter, 1});
+            shard.counters.emplace(full_name, counter_object{counter, 1});
+            ++shard.generation;
             return counter;
         } else {
             dassert(it->second.counter->type() == flags,
@@ -129,8 +150,8 @@ perf_counter_ptr perf_counters::get_global_counter(const char *app,
             return it->second.counter;
         }
     } else {
-        auto it = _counters.find(full_name);
-        if (it == _counters.end())
+        auto it = shard.counters.find(full_name);
+        if (it == shard.counters.end())
             return nullptr;
         else {
             ++it->second.user_reference;
@@ -143,15 +164,17 @@ bool perf_counters::remove_counter(const char *full_name)
 {
     int remain_ref;
     {
-        utils::auto_write_lock l(_lock);
-        auto it = _counters.find(full_name);
-        if (it == _counters.end())
+        counter_shard &shard = _shards[shard_of(full_name)];
+        utils::auto_write_lock l(shard.lock);
+        auto it = shard.counters.find(full_name);
+        if (it == shard.counters.end())
             return false;
         else {
             counter_object &c = it->second;
             remain_ref = (--c.user_reference);
             if (remain_ref == 0) {
-                _counters.erase(it);
+                shard.counters.erase(it);
+                ++shard.generation;
             }
         }
     }
@@ -162,14 +185,35 @@ bool perf_counters::remove_counter(const char *full_name)
 
 perf_counter_ptr perf_counters::get_counter(const std::string &full_name)
 {
-    utils::auto_read_lock l(_lock);
-    auto it = _counters.find(full_name);
-    if (it != _counters.end())
+    const counter_shard &shard = _shards[shard_of(full_name)];
+    utils::auto_read_lock l(shard.lock);
+    auto it = shard.counters.find(full_name);
+    if (it != shard.counters.end())
         return it->second.counter;
 
     return nullptr;
 }
 
+perf_counter_ptr perf_counters::add_counter(const perf_counter_ptr &counter)
+{
+    std::string full_name(counter->full_name());
+    counter_shard &shard = _shards[shard_of(full_name)];
+    utils::auto_write_lock l(shard.lock);
+    auto it = shard.counters.find(full_name);
+    if (it == shard.counters.end()) {
+        shard.counters.emplace(full_name, counter_object{counter, 1});
+        ++shard.generation;
+        return counter;
+    }
+    dassert(it->second.counter->type() == counter->type(),
+            "counters with the same name %s with differnt types, (%d) vs (%d)",
+            full_name.c_str(),
+            it->second.counter->type(),
+            counter->type());
+    ++it->second.user_reference;
+    return it->second.counter;
+}
+
 perf_counter *perf_counters::new_counter(const char *app,
                                          const char *section,
                                          const char *name,
@@ -184,22 +228,54 @@ perf_counter *perf_counters::new_counter(const char *app,
         return new perf_counter_rate_atomic(app, section, name, type, dsptr);
     else if (type == dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES)
         return new perf_counter_number_percentile_atomic(app, section, name, type, dsptr);
+    else if (type == dsn_perf_counter_type_t::COUNTER_TYPE_HISTOGRAM)
+        return new perf_counter_histogram_atomic(app, section, name, type, dsptr);
     else {
         dassert(false, "invalid type(%d)", type);
         return nullptr;
     }
 }
 
-void perf_counters::get_all_counters(std::vector<perf_counter_ptr> *all) const
+/*static*/ int perf_counters::shard_of(const std::string &full_name)
+{
+    return static_cast<int>(std::hash<std::string>()(full_name) % SHARD_COUNT);
+}
+
+/*static*/ void perf_counters::read_values(const snapshot_shard &ss,
+                                           /*out*/ std::vector<double> &values)
 {
-    all->clear();
-    utils::auto_read_lock l(_lock);
-    all->reserve(_counters.size());
-    for (auto &p : _counters) {
-        all->push_back(p.second.counter);
+    values.resize(ss.sources.size());
+    for (size_t i = 0; i < ss.sources.size(); ++i) {
+        const perf_counter_ptr &c = ss.sources[i].first;
+        dsn_perf_counter_percentile_type_t percentile = ss.sources[i].second;
+        values[i] = percentile == COUNTER_PERCENTILE_INVALID ? c->get_value()
+                                                             : c->get_percentile(percentile);
     }
 }
 
+const perf_counters::counter_snapshot *perf_counters::find_snapshot(const std::string &name) const
+{
+    static const std::string p999_suffix(".p999");
+
+    const snapshot_shard &ss = _snapshots[shard_of(name)];
+    auto it = ss.index.find(name);
+    if (it != ss.index.end()) {
+        return &ss.entries[it->second];
+    }
+
+    // the p999 entries are kept in the shard of their counters
+    size_t base_size = name.size() - p999_suffix.size();
+    if (name.size() > p999_suffix.size() &&
+        name.compare(base_size, std::string::npos, p999_suffix) == 0) {
+        const snapshot_shard &base = _snapshots[shard_of(name.substr(0, base_size))];
+        it = base.index.find(name);
+        if (it != base.index.end()) {
+            return &base.entries[it->second];
+        }
+    }
+    return nullptr;
+}
+
 std::string perf_counters::list_snapshot_by_regexp(const std::vector<std::string> &args) const
 {
     perf_counter_info info;
@@ -286,54 +362,116 @@ void perf_counters::take_snapshot()
 {
     builtin_counters::instance().update_counters();
 
-    std::vector<perf_counter_ptr> all_counters;
-    get_all_counters(&all_counters);
+    utils::auto_lock<utils::ex_lock_nr> sl(_take_snapshot_lock);
+    uint64_t version = _snapshot_version.load() + 1;
+    std::vector<double> values;
+    for (int i = 0; i < SHARD_COUNT; ++i) {
+        snapshot_shard &ss = _snapshots[i];
+
+        // rebuild the entries out of the snapshot lock if the counters of the shard changed
+        snapshot_shard rebuilt;
+        {
+            const counter_shard &shard = _shards[i];
+            utils::auto_read_lock l(shard.lock);
+            if (!ss.built || ss.generation != shard.generation) {
+                rebuilt.built = true;
+                rebuilt.generation = shard.generation;
+                rebuilt.sources.reserve(shard.counters.size());
+                for (const auto &kv : shard.counters) {
+                    const perf_counter_ptr &c = kv.second.counter;
+                    if (c->type() != COUNTER_TYPE_NUMBER_PERCENTILES &&
+                        c->type() != COUNTER_TYPE_HISTOGRAM) {
+                        rebuilt.sources.emplace_back(c, COUNTER_PERCENTILE_INVALID);
+                    } else {
+                        // take P999 metrics into account as well.
+                        rebuilt.sources.emplace_back(c, COUNTER_PERCENTILE_99);
+                        rebuilt.sources.emplace_back(c, COUNTER_PERCENTILE_999);
+                    }
+                }
+            }
+        }
+        if (rebuilt.built) {
+            rebuilt.entries.resize(rebuilt.sources.size());
+            rebuilt.index.reserve(rebuilt.sources.size());
+            for (size_t j = 0; j < rebuilt.sources.size(); ++j) {
+                counter_snapshot &cs = rebuilt.entries[j];
+                const perf_counter_ptr &c = rebuilt.sources[j].first;
+                cs.name = c->full_name();
+                if (rebuilt.sources[j].second == COUNTER_PERCENTILE_999) {
+                    cs.name += ".p999";
+                }
+                cs.type = c->type();
+                auto it = ss.index.find(cs.name);
+                if (it != ss.index.end()) {
+                    // keep the value of the existing counter to tell whether it changes
+                    cs.value = ss.entries[it->second].value;
+                    cs.changed_version = ss.entries[it->second].changed_version;
+                } else {
+                    cs.changed_version = version;
+                }
+                rebuilt.index.emplace(cs.name, j);
+            }
+        }
 
-    utils::auto_write_lock l(_snapshot_lock);
-    for (auto &p : _snapshots) {
-        p.second.updated_recently = false;
-    }
+        // the values are read out of the snapshot lock as well
+        const snapshot_shard &src = rebuilt.built ? rebuilt : ss;
+        read_values(src, values);
 
-    // updated counters from current value
-    for (const perf_counter_ptr &c : all_counters) {
-        counter_snapshot &cs = _snapshots[c->full_name()];
-        if (cs.name.empty()) {
-            // recently created counter, which wasn't in snapshot before
-            cs.name = c->full_name();
-            cs.type = c->type();
+        utils::auto_write_lock l(_snapshot_lock);
+        if (rebuilt.built) {
+            ss = std::move(rebuilt);
         }
-        cs.updated_recently = true;
-        if (c->type() != COUNTER_TYPE_NUMBER_PERCENTILES) {
-            cs.value = c->get_value();
-        } else {
-            cs.value = c->get_percentile(COUNTER_PERCENTILE_99);
-
-            // take P999 metrics into account as well.
-            std::string name_p999 = std::string(c->full_name()) + ".p999";
-            counter_snapshot &cs999 = _snapshots[name_p999];
-            cs999.name = std::move(name_p999);
-            cs999.type = c->type();
-            cs999.updated_recently = true;
-            cs999.value = c->get_percentile(COUNTER_PERCENTILE_999);
+        for (size_t j = 0; j < values.size(); ++j) {
+            counter_snapshot &cs = ss.entries[j];
+            if (cs.value != values[j]) {
+                cs.value = values[j];
+                cs.changed_version = version;
+            }
         }
     }
 
+    utils::auto_write_lock l(_snapshot_lock);
     _timestamp = dsn_now_ms() / 1000;
-
-    // delete old counters
-    std::vector<std::string> old_counters;
-    for (auto &p : _snapshots)
-        if (!p.second.updated_recently)
-            old_counters.push_back(p.first);
-    for (const std::string &n : old_counters)
-        _snapshots.erase(n);
+    _snapshot_version.store(version);
 }
 
 void perf_counters::iterate_snapshot(const snapshot_iterator &v) const
 {
     utils::auto_read_lock l(_snapshot_lock);
-    for (auto &kv : _snapshots) {
-        v(kv.second);
+    for (const snapshot_shard &ss : _snapshots) {
+        for (const counter_snapshot &cs : ss.entries) {
+            v(cs);
+        }
+    }
+}
+
+void perf_counters::visit_snapshot(const snapshot_visitor &v) const
+{
+    std::vector<const counter_snapshot *> counters;
+    utils::auto_read_lock l(_snapshot_lock);
+    size_t count = 0;
+    for (const snapshot_shard &ss : _snapshots) {
+        count += ss.entries.size();
+    }
+    counters.reserve(count);
+    for (const snapshot_shard &ss : _snapshots) {
+        for (const counter_snapshot &cs : ss.entries) {
+            counters.push_back(&cs);
+        }
+    }
+    v(counters);
+}
+
+void perf_counters::iterate_changed_snapshot(uint64_t since_version,
+                                             const snapshot_iterator &v) const
+{
+    utils::auto_read_lock l(_snapshot_lock);
+    for (const snapshot_shard &ss : _snapshots) {
+        for (const counter_snapshot &cs : ss.entries) {
+            if (cs.changed_version > since_version) {
+                v(cs);
+            }
+        }
     }
 }
 
@@ -348,12 +486,12 @@ void perf_counters::query_snapshot(const std::vector<std::string> &counters,
     found->reserve(counters.size());
     utils::auto_read_lock l(_snapshot_lock);
     for (const std::string &name : counters) {
-        auto iter = _snapshots.find(name);
-        if (iter == _snapshots.end()) {
+        const counter_snapshot *cs = find_snapshot(name);
+        if (cs == nullptr) {
             found->push_back(false);
         } else {
             found->push_back(true);
-            v(iter->second);
+            v(*cs);
         }
     }
 }
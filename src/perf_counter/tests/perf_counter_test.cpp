@@ -35,8 +35,11 @@
 
 #include <dsn/tool_api.h>
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <iostream>
 #include <thread>
 #include <cmath>
+#include <limits>
 #include <vector>
 
 #include "perf_counter/perf_counter_atomic.h"
@@ -125,12 +128,163 @@ TEST(perf_counter, perf_counter_atomic)
     }
 }
 
+TEST(perf_counter, sharded_number)
+{
+    // each thread is assigned with a shard of its own
+    std::vector<int> shards(COUNTER_SHARD_COUNT, -1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < COUNTER_SHARD_COUNT; ++t) {
+        threads.emplace_back([&shards, t]() { shards[t] = sharded_number::current_shard(); });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    std::sort(shards.begin(), shards.end());
+    for (int i = 0; i < COUNTER_SHARD_COUNT; ++i) {
+        ASSERT_EQ(i, shards[i]);
+    }
+    ASSERT_EQ(sharded_number::current_shard(), sharded_number::current_shard());
+
+    sharded_number number;
+    number.add(10);
+    number.add(-3);
+    ASSERT_EQ(7, number.sum());
+    number.set(100);
+    ASSERT_EQ(100, number.sum());
+    ASSERT_EQ(100, number.fetch_and_reset());
+    ASSERT_EQ(0, number.sum());
+}
+
+const int64_t increments_per_thread = 1000000;
+static void perf_counter_scaling_benchmark(dsn_perf_counter_type_t type, const char *type_name)
+{
+    for (int thread_count = 1; thread_count <= 64; thread_count *= 2) {
+        perf_counter_ptr counter;
+        if (type == COUNTER_TYPE_RATE) {
+            counter = new perf_counter_rate_atomic("", "", "", type, "");
+        } else {
+            counter = new perf_counter_number_atomic("", "", "", type, "");
+        }
+
+        std::vector<std::thread> threads;
+        uint64_t start = dsn_now_ns();
+        for (int t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&counter]() {
+                for (int64_t i = 0; i < increments_per_thread; ++i) {
+                    counter->increment();
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        uint64_t elapsed_ns = dsn_now_ns() - start;
+
+        std::cout << type_name << ": threads = " << thread_count << ", elapsed = "
+                  << elapsed_ns / 1000000 << " ms, throughput = "
+                  << increments_per_thread * thread_count * 1000 / (elapsed_ns / 1000 + 1)
+                  << " ops/ms" << std::endl;
+        if (type != COUNTER_TYPE_RATE) {
+            ASSERT_EQ(increments_per_thread * thread_count, counter->get_integer_value());
+        }
+    }
+}
+
+TEST(perf_counter, sharded_counter_benchmark)
+{
+    perf_counter_scaling_benchmark(COUNTER_TYPE_NUMBER, "NUMBER");
+    perf_counter_scaling_benchmark(COUNTER_TYPE_RATE, "RATE");
+}
+
+TEST(perf_counter, log_linear_histogram)
+{
+    // bucket boundaries
+    for (int64_t v = 0; v < 2 * log_linear_histogram::SUB_BUCKET_COUNT; ++v) {
+        ASSERT_EQ(v, log_linear_histogram::bucket_index(v));
+        ASSERT_EQ(v, log_linear_histogram::bucket_value(v));
+    }
+    ASSERT_EQ(0, log_linear_histogram::bucket_index(-1));
+    ASSERT_EQ(log_linear_histogram::BUCKET_COUNT - 1,
+              log_linear_histogram::bucket_index(std::numeric_limits<int64_t>::max()));
+    for (int64_t v = 1; v < (int64_t(1) << 40); v = v * 3 + 1) {
+        int64_t approx = log_linear_histogram::bucket_value(log_linear_histogram::bucket_index(v));
+        ASSERT_LE(std::abs(approx - v), v / log_linear_histogram::SUB_BUCKET_COUNT) << v;
+    }
+
+    // concurrent recording of 1..100000 from 10 threads
+    log_linear_histogram h;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 10; ++t) {
+        threads.emplace_back([&h, t]() {
+            for (int64_t v = t + 1; v <= 100000; v += 10) {
+                h.record(v);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    histogram_snapshot snapshot;
+    h.take_snapshot(snapshot);
+    ASSERT_EQ(100000u, snapshot.count());
+    ASSERT_EQ(int64_t(100000) * 100001 / 2, snapshot.sum());
+    for (double q : {0.5, 0.9, 0.99, 0.999, 0.9999}) {
+        double expected = q * 100000;
+        ASSERT_NEAR(expected, snapshot.quantile(q), expected / 32) << q;
+    }
+    ASSERT_EQ(1, snapshot.quantile(0.0));
+
+    // merge and subtract
+    histogram_snapshot merged = snapshot;
+    merged.merge(snapshot);
+    ASSERT_EQ(200000u, merged.count());
+    ASSERT_EQ(snapshot.quantile(0.99), merged.quantile(0.99));
+
+    for (int i = 0; i < 1000; ++i) {
+        h.record(1000000);
+    }
+    histogram_snapshot window;
+    h.take_snapshot(window);
+    window.subtract(snapshot);
+    ASSERT_EQ(1000u, window.count());
+    ASSERT_NEAR(1000000, window.quantile(0.5), 1000000 / 32);
+
+    histogram_snapshot empty;
+    ASSERT_EQ(0, empty.quantile(0.99));
+    empty.merge(window);
+    ASSERT_EQ(1000u, empty.count());
+}
+
+TEST(perf_counter, perf_counter_histogram_atomic)
+{
+    perf_counter_ptr counter = new perf_counter_histogram_atomic(
+        "", "", "", dsn_perf_counter_type_t::COUNTER_TYPE_HISTOGRAM, "");
+    for (int i = 0; i < 1000; ++i) {
+        counter->set(i);
+    }
+    ASSERT_EQ(999, counter->get_latest_sample());
+
+    // quantiles cover the latest completed window only
+    histogram_snapshot snapshot;
+    ASSERT_TRUE(counter->get_histogram_snapshot(snapshot));
+    ASSERT_EQ(0u, snapshot.count());
+    for (int i = 0; i != COUNTER_PERCENTILE_COUNT; ++i) {
+        ASSERT_EQ(0.0, counter->get_percentile((dsn_perf_counter_percentile_type_t)i));
+    }
+
+    counter = new perf_counter_number_percentile_atomic(
+        "", "", "", dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES, "");
+    ASSERT_FALSE(counter->get_histogram_snapshot(snapshot));
+}
+
 TEST(perf_counter, print_type)
 {
     ASSERT_STREQ("NUMBER", dsn_counter_type_to_string(COUNTER_TYPE_NUMBER));
     ASSERT_STREQ("VOLATILE_NUMBER", dsn_counter_type_to_string(COUNTER_TYPE_VOLATILE_NUMBER));
     ASSERT_STREQ("RATE", dsn_counter_type_to_string(COUNTER_TYPE_RATE));
     ASSERT_STREQ("PERCENTILE", dsn_counter_type_to_string(COUNTER_TYPE_NUMBER_PERCENTILES));
+    ASSERT_STREQ("HISTOGRAM", dsn_counter_type_to_string(COUNTER_TYPE_HISTOGRAM));
     ASSERT_STREQ("INVALID_COUNTER", dsn_counter_type_to_string(COUNTER_TYPE_INVALID));
 
     ASSERT_EQ(COUNTER_TYPE_NUMBER,
@@ -143,6 +297,8 @@ TEST(perf_counter, print_type)
     ASSERT_EQ(
         COUNTER_TYPE_NUMBER_PERCENTILES,
         dsn_counter_type_from_string(dsn_counter_type_to_string(COUNTER_TYPE_NUMBER_PERCENTILES)));
+    ASSERT_EQ(COUNTER_TYPE_HISTOGRAM,
+              dsn_counter_type_from_string(dsn_counter_type_to_string(COUNTER_TYPE_HISTOGRAM)));
     ASSERT_EQ(COUNTER_TYPE_INVALID, dsn_counter_type_from_string("xxxx"));
 
     ASSERT_STREQ("P50", dsn_percentile_type_to_string(COUNTER_PERCENTILE_50));
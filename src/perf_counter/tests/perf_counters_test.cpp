@@ -37,6 +37,7 @@
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/perf_counter/perf_counter_utils.h>
 #include <gtest/gtest.h>
+#include <set>
 
 using namespace ::dsn;
 
@@ -274,6 +275,9 @@ TEST(perf_counters_test, query_snapshot_by_regexp)
     dsn::perf_counter_wrapper c8;
     c8.init_global_counter("d", "s", "test_counter", COUNTER_TYPE_NUMBER_PERCENTILES, "");
 
+    dsn::perf_counter_wrapper c9;
+    c9.init_global_counter("e", "s", "test_counter", COUNTER_TYPE_HISTOGRAM, "");
+
     perf_counters::instance().take_snapshot();
     std::string result = perf_counters::instance().list_snapshot_by_regexp({".*\\*s\\*.*"});
 
@@ -284,7 +288,7 @@ TEST(perf_counters_test, query_snapshot_by_regexp)
     ASSERT_GT(info.timestamp, 0);
     ASSERT_TRUE(!info.timestamp_str.empty());
     printf("got timestamp: %s\n", info.timestamp_str.c_str());
-    ASSERT_EQ(4 + 1, info.counters.size()); // add 1 for p999 counter
+    ASSERT_EQ(5 + 2, info.counters.size()); // add 2 for p999 counters
 
     std::map<std::string, std::string> expected = {
         {"a*s*test_counter", dsn_counter_type_to_string(COUNTER_TYPE_NUMBER)},
@@ -292,6 +296,8 @@ TEST(perf_counters_test, query_snapshot_by_regexp)
         {"c*s*test_counter", dsn_counter_type_to_string(COUNTER_TYPE_RATE)},
         {"d*s*test_counter", dsn_counter_type_to_string(COUNTER_TYPE_NUMBER_PERCENTILES)},
         {"d*s*test_counter.p999", dsn_counter_type_to_string(COUNTER_TYPE_NUMBER_PERCENTILES)},
+        {"e*s*test_counter", dsn_counter_type_to_string(COUNTER_TYPE_HISTOGRAM)},
+        {"e*s*test_counter.p999", dsn_counter_type_to_string(COUNTER_TYPE_HISTOGRAM)},
     };
     std::map<std::string, std::string> actual;
     for (const dsn::perf_counter_metric &m : info.counters) {
@@ -347,3 +353,48 @@ TEST(perf_counters_test, get_by_fullname)
         }
     }
 }
+
+TEST(perf_counters_test, iterate_changed_snapshot)
+{
+    dsn::perf_counter_wrapper c1;
+    c1.init_global_counter("f", "s", "changed_counter", COUNTER_TYPE_NUMBER, "");
+    dsn::perf_counter_wrapper c2;
+    c2.init_global_counter("f", "s", "unchanged_counter", COUNTER_TYPE_NUMBER, "");
+
+    std::set<std::string> changed;
+    perf_counters::snapshot_iterator iter = [&changed](const perf_counters::counter_snapshot &cs) {
+        changed.insert(cs.name);
+    };
+
+    // the created counters are changed
+    uint64_t version = perf_counters::instance().snapshot_version();
+    perf_counters::instance().take_snapshot();
+    perf_counters::instance().iterate_changed_snapshot(version, iter);
+    ASSERT_EQ(1, changed.count("f*s*changed_counter"));
+    ASSERT_EQ(1, changed.count("f*s*unchanged_counter"));
+
+    c1->set(10);
+    version = perf_counters::instance().snapshot_version();
+    perf_counters::instance().take_snapshot();
+    changed.clear();
+    perf_counters::instance().iterate_changed_snapshot(version, iter);
+    ASSERT_EQ(1, changed.count("f*s*changed_counter"));
+    ASSERT_EQ(0, changed.count("f*s*unchanged_counter"));
+
+    // the values are kept across the rebuilding of the shards
+    dsn::perf_counter_wrapper c3;
+    c3.init_global_counter("f", "s", "new_counter", COUNTER_TYPE_NUMBER, "");
+    version = perf_counters::instance().snapshot_version();
+    perf_counters::instance().take_snapshot();
+    changed.clear();
+    perf_counters::instance().iterate_changed_snapshot(version, iter);
+    ASSERT_EQ(0, changed.count("f*s*changed_counter"));
+    ASSERT_EQ(0, changed.count("f*s*unchanged_counter"));
+    ASSERT_EQ(1, changed.count("f*s*new_counter"));
+
+    // all the counters are visited since version 0
+    changed.clear();
+    perf_counters::instance().iterate_changed_snapshot(0, iter);
+    ASSERT_EQ(1, changed.count("f*s*changed_counter"));
+    ASSERT_EQ(1, changed.count("f*s*unchanged_counter"));
+}
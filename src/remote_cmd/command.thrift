@@ -5,3 +5,8 @@ struct command
     1:string       cmd;
     2:list<string> arguments;
 }
+
+struct batch_command
+{
+    1:list<command> commands;
+}
@@ -149,6 +149,120 @@ void command::printTo(std::ostream &out) const
         << "arguments=" << to_string(arguments);
     out << ")";
 }
+
+batch_command::~batch_command() throw() {}
+
+void batch_command::__set_commands(const std::vector<command> &val) { this->commands = val; }
+
+uint32_t batch_command::read(::apache::thrift::protocol::TProtocol *iprot)
+{
+
+    apache::thrift::protocol::TInputRecursionTracker tracker(*iprot);
+    uint32_t xfer = 0;
+    std::string fname;
+    ::apache::thrift::protocol::TType ftype;
+    int16_t fid;
+
+    xfer += iprot->readStructBegin(fname);
+
+    using ::apache::thrift::protocol::TProtocolException;
+
+    while (true) {
+        xfer += iprot->readFieldBegin(fname, ftype, fid);
+        if (ftype == ::apache::thrift::protocol::T_STOP) {
+            break;
+        }
+        switch (fid) {
+        case 1:
+            if (ftype == ::apache::thrift::protocol::T_LIST) {
+                {
+                    this->commands.clear();
+                    uint32_t _size10;
+                    ::apache::thrift::protocol::TType _etype13;
+                    xfer += iprot->readListBegin(_etype13, _size10);
+                    this->commands.resize(_size10);
+                    uint32_t _i14;
+                    for (_i14 = 0; _i14 < _size10; ++_i14) {
+                        xfer += this->commands[_i14].read(iprot);
+                    }
+                    xfer += iprot->readListEnd();
+                }
+                this->__isset.commands = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
+        default:
+            xfer += iprot->skip(ftype);
+            break;
+        }
+        xfer += iprot->readFieldEnd();
+    }
+
+    xfer += iprot->readStructEnd();
+
+    return xfer;
+}
+
+uint32_t batch_command::write(::apache::thrift::protocol::TProtocol *oprot) const
+{
+    uint32_t xfer = 0;
+    apache::thrift::protocol::TOutputRecursionTracker tracker(*oprot);
+    xfer += oprot->writeStructBegin("batch_command");
+
+    xfer += oprot->writeFieldBegin("commands", ::apache::thrift::protocol::T_LIST, 1);
+    {
+        xfer += oprot->writeListBegin(::apache::thrift::protocol::T_STRUCT,
+                                      static_cast<uint32_t>(this->commands.size()));
+        std::vector<command>::const_iterator _iter15;
+        for (_iter15 = this->commands.begin(); _iter15 != this->commands.end(); ++_iter15) {
+            xfer += (*_iter15).write(oprot);
+        }
+        xfer += oprot->writeListEnd();
+    }
+    xfer += oprot->writeFieldEnd();
+
+    xfer += oprot->writeFieldStop();
+    xfer += oprot->writeStructEnd();
+    return xfer;
+}
+
+void swap(batch_command &a, batch_command &b)
+{
+    using ::std::swap;
+    swap(a.commands, b.commands);
+    swap(a.__isset, b.__isset);
+}
+
+batch_command::batch_command(const batch_command &other16)
+{
+    commands = other16.commands;
+    __isset = other16.__isset;
+}
+batch_command::batch_command(batch_command &&other17)
+{
+    commands = std::move(other17.commands);
+    __isset = std::move(other17.__isset);
+}
+batch_command &batch_command::operator=(const batch_command &other18)
+{
+    commands = other18.commands;
+    __isset = other18.__isset;
+    return *this;
+}
+batch_command &batch_command::operator=(batch_command &&other19)
+{
+    commands = std::move(other19.commands);
+    __isset = std::move(other19.__isset);
+    return *this;
+}
+void batch_command::printTo(std::ostream &out) const
+{
+    using ::apache::thrift::to_string;
+    out << "batch_command(";
+    out << "commands=" << to_string(commands);
+    out << ")";
+}
 }
 }
 } // namespace
@@ -22,6 +22,8 @@ namespace cmd {
 
 class command;
 
+class batch_command;
+
 typedef struct _command__isset
 {
     _command__isset() : cmd(false), arguments(false) {}
@@ -73,6 +75,52 @@ inline std::ostream &operator<<(std::ostream &out, const command &obj)
     obj.printTo(out);
     return out;
 }
+
+typedef struct _batch_command__isset
+{
+    _batch_command__isset() : commands(false) {}
+    bool commands : 1;
+} _batch_command__isset;
+
+class batch_command
+{
+public:
+    batch_command(const batch_command &);
+    batch_command(batch_command &&);
+    batch_command &operator=(const batch_command &);
+    batch_command &operator=(batch_command &&);
+    batch_command() {}
+
+    virtual ~batch_command() throw();
+    std::vector<command> commands;
+
+    _batch_command__isset __isset;
+
+    void __set_commands(const std::vector<command> &val);
+
+    bool operator==(const batch_command &rhs) const
+    {
+        if (!(commands == rhs.commands))
+            return false;
+        return true;
+    }
+    bool operator!=(const batch_command &rhs) const { return !(*this == rhs); }
+
+    bool operator<(const batch_command &) const;
+
+    uint32_t read(::apache::thrift::protocol::TProtocol *iprot);
+    uint32_t write(::apache::thrift::protocol::TProtocol *oprot) const;
+
+    virtual void printTo(std::ostream &out) const;
+};
+
+void swap(batch_command &a, batch_command &b);
+
+inline std::ostream &operator<<(std::ostream &out, const batch_command &obj)
+{
+    obj.printTo(out);
+    return out;
+}
 }
 }
 } // namespace
@@ -4,8 +4,11 @@
 
 #include <dsn/dist/remote_command.h>
 #include <dsn/tool-api/command_manager.h>
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/cpp/json_helper.h>
 #include <dsn/cpp/rpc_holder.h>
 #include <dsn/c/api_layer1.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/smart_pointers.h>
 
 #include "command_types.h"
@@ -14,9 +17,105 @@ namespace dsn {
 namespace dist {
 namespace cmd {
 
+DSN_DEFINE_uint32("core",
+                  remote_command_batch_max_count,
+                  1024,
+                  "max count of commands in a batch remote command request");
+
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_REMOTE_COMMAND)
 DEFINE_TASK_CODE_RPC(RPC_CLI_CLI_CALL, TASK_PRIORITY_COMMON, ::dsn::THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE_RPC(RPC_CLI_CLI_BATCH_CALL, TASK_PRIORITY_COMMON, ::dsn::THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE(LPC_REMOTE_COMMAND_BATCH, TASK_PRIORITY_COMMON, THREAD_POOL_REMOTE_COMMAND)
 
 typedef rpc_holder<command, std::string> remote_command_rpc;
+typedef rpc_holder<batch_command, std::string> batch_remote_command_rpc;
+
+// Executes the commands of a batch concurrently, and writes their results into the response in
+// the order of the request. A result is encoded and released as soon as it and all the results
+// before it are done, rather than holding all the outputs until the last command finishes.
+class batch_command_executor : public std::enable_shared_from_this<batch_command_executor>
+{
+public:
+    explicit batch_command_executor(batch_remote_command_rpc rpc)
+        : _rpc(std::move(rpc)),
+          _results(_rpc.request().commands.size()),
+          _writer(_stream),
+          _remaining(_results.size())
+    {
+    }
+
+    void start()
+    {
+        _writer.StartArray();
+        if (_results.empty()) {
+            finish();
+            return;
+        }
+        for (size_t i = 0; i < _results.size(); ++i) {
+            auto self = shared_from_this();
+            tasking::enqueue(LPC_REMOTE_COMMAND_BATCH, nullptr, [self, i]() { self->run(i); });
+        }
+    }
+
+private:
+    struct result
+    {
+        bool done{false};
+        bool ok{false};
+        std::string output;
+    };
+
+    void run(size_t i)
+    {
+        const command &c = _rpc.request().commands[i];
+        std::string output;
+        bool ok = command_manager::instance().run_command(c.cmd, c.arguments, output);
+
+        utils::auto_lock<utils::ex_lock_nr> l(_lock);
+        result &r = _results[i];
+        r.done = true;
+        r.ok = ok;
+        r.output = std::move(output);
+        while (_next < _results.size() && _results[_next].done) {
+            encode(_next);
+            _next++;
+        }
+        if (--_remaining == 0) {
+            finish();
+        }
+    }
+
+    void encode(size_t i)
+    {
+        result &r = _results[i];
+        _writer.StartObject();
+        _writer.Key("cmd");
+        _writer.String(_rpc.request().commands[i].cmd.c_str());
+        _writer.Key("ok");
+        _writer.Bool(r.ok);
+        _writer.Key("output");
+        _writer.String(r.output.data(), static_cast<rapidjson::SizeType>(r.output.size()));
+        _writer.EndObject();
+        std::string().swap(r.output);
+    }
+
+    // the response is replied when the last holder of `_rpc` is released
+    void finish()
+    {
+        _writer.EndArray();
+        blob buffer = _stream.get_buffer();
+        _rpc.response().assign(buffer.data(), buffer.length());
+    }
+
+    batch_remote_command_rpc _rpc;
+
+    utils::ex_lock_nr _lock; // protects the members below
+    std::vector<result> _results;
+    size_t _next{0};
+    json::json_output_stream _stream;
+    json::JsonWriter _writer;
+    size_t _remaining;
+};
 
 task_ptr async_call_remote(rpc_address remote,
                            const std::string &cmd,
@@ -33,6 +132,26 @@ task_ptr async_call_remote(rpc_address remote,
     });
 }
 
+task_ptr async_call_remote_batch(
+    rpc_address remote,
+    const std::vector<std::pair<std::string, std::vector<std::string>>> &commands,
+    std::function<void(error_code, const std::string &)> callback,
+    std::chrono::milliseconds timeout)
+{
+    std::unique_ptr<batch_command> request = make_unique<batch_command>();
+    request->commands.reserve(commands.size());
+    for (const auto &c : commands) {
+        command cmd;
+        cmd.cmd = c.first;
+        cmd.arguments = c.second;
+        request->commands.emplace_back(std::move(cmd));
+    }
+    batch_remote_command_rpc rpc(std::move(request), RPC_CLI_CLI_BATCH_CALL, timeout);
+    return rpc.call(remote, nullptr, [ cb = std::move(callback), rpc ](error_code ec) {
+        cb(ec, rpc.response());
+    });
+}
+
 bool register_remote_command_rpc()
 {
     rpc_request_handler cb = [](dsn::message_ex *msg) {
@@ -41,7 +160,18 @@ bool register_remote_command_rpc()
             rpc.request().cmd, rpc.request().arguments, rpc.response());
     };
 
-    return dsn_rpc_register_handler(RPC_CLI_CLI_CALL, "call", cb);
+    rpc_request_handler batch_cb = [](dsn::message_ex *msg) {
+        auto rpc = batch_remote_command_rpc::auto_reply(msg);
+        if (rpc.request().commands.size() > FLAGS_remote_command_batch_max_count) {
+            rpc.response() = "ERR: too many commands in a batch, the limit is " +
+                             std::to_string(FLAGS_remote_command_batch_max_count);
+            return;
+        }
+        std::make_shared<batch_command_executor>(std::move(rpc))->start();
+    };
+
+    return dsn_rpc_register_handler(RPC_CLI_CLI_CALL, "call", cb) &&
+           dsn_rpc_register_handler(RPC_CLI_CLI_BATCH_CALL, "batch_call", batch_cb);
 }
 
 } // namespace cmd
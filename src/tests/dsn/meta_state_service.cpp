@@ -1,4 +1,6 @@
 #include <dsn/dist/meta_state_service.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <boost/lexical_cast.hpp>
 
 #include <gtest/gtest.h>
@@ -8,6 +10,12 @@
 #include "dist/replication/meta_server/meta_state_service_simple.h"
 #include "dist/replication/meta_server/meta_state_service_zookeeper.h"
 
+namespace dsn {
+namespace dist {
+DSN_DECLARE_uint64(checkpoint_log_size_kb);
+} // namespace dist
+} // namespace dsn
+
 using namespace dsn;
 using namespace dsn::dist;
 
@@ -245,6 +253,146 @@ void provider_recursively_create_delete_test(const service_creator_func &creator
     deleter(service);
 }
 
+void provider_concurrent_write_test(const service_creator_func &creator,
+                                    const service_deleter_func &deleter)
+{
+    meta_state_service *service = creator();
+    dsn::task_tracker tracker;
+
+    service->delete_node("/w", true, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, [](error_code) {})
+        ->wait();
+    service->create_node("/w", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+    service->get_children_data("/w",
+                               META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                               [](error_code ec, const children_data &children) {
+                                   ASSERT_EQ(ERR_OK, ec);
+                                   ASSERT_TRUE(children.empty());
+                               })
+        ->wait();
+
+    // concurrent writes, in which one fails, get their own results
+    service->create_node("/w/5", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+    for (int i = 0; i < 100; ++i) {
+        std::string node = "/w/" + boost::lexical_cast<std::string>(i);
+        blob value = blob::create_from_bytes(std::to_string(i));
+        service->create_node(node,
+                             META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                             [i](error_code ec) {
+                                 if (i == 5) {
+                                     ASSERT_EQ(ERR_NODE_ALREADY_EXIST, ec);
+                                 } else {
+                                     ASSERT_EQ(ERR_OK, ec);
+                                 }
+                             },
+                             value,
+                             &tracker);
+        // the writes of the same node are done in order
+        service->set_data(node,
+                          blob::create_from_bytes("v" + std::to_string(i)),
+                          META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                          expect_ok,
+                          &tracker);
+    }
+    tracker.wait_outstanding_tasks();
+
+    service
+        ->get_children_data(
+            "/w",
+            META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+            [](error_code ec, const children_data &children) {
+                ASSERT_EQ(ERR_OK, ec);
+                ASSERT_EQ(100, children.size());
+                for (const auto &child : children) {
+                    ASSERT_EQ("v" + child.first, child.second.to_string());
+                }
+            })
+        ->wait();
+    service->delete_node("/w", true, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+    service->get_children_data("/w",
+                               META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                               [](error_code ec, const children_data &) {
+                                   ASSERT_EQ(ERR_OBJECT_NOT_FOUND, ec);
+                               })
+        ->wait();
+    deleter(service);
+}
+
+void simple_checkpoint_test()
+{
+    const std::string work_dir = "./simple_checkpoint_test";
+    utils::filesystem::remove_path(work_dir);
+    ASSERT_TRUE(utils::filesystem::create_directory(work_dir));
+    auto creator = [&work_dir]() {
+        meta_state_service_simple *svc = new meta_state_service_simple();
+        EXPECT_EQ(ERR_OK, svc->initialize({work_dir}));
+        return svc;
+    };
+
+    uint64_t old_checkpoint_log_size_kb = FLAGS_checkpoint_log_size_kb;
+    FLAGS_checkpoint_log_size_kb = 1;
+    meta_state_service *service = creator();
+    service->create_node("/c", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+    const std::string value(100, 'v');
+    for (int i = 0; i < 100; ++i) {
+        service
+            ->create_node("/c/" + std::to_string(i),
+                          META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                          expect_ok,
+                          blob::create_from_bytes(std::string(value)))
+            ->wait();
+    }
+    service
+        ->set_data("/c/0",
+                   blob::create_from_bytes("new"),
+                   META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                   expect_ok)
+        ->wait();
+    service->delete_node("/c/1", false, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)
+        ->wait();
+
+    // the old logs are removed after checkpointed
+    const std::string first_log =
+        utils::filesystem::path_combine(work_dir, "meta_state_service.log");
+    for (int i = 0; i < 100 && utils::filesystem::file_exists(first_log); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_FALSE(utils::filesystem::file_exists(first_log));
+    ASSERT_TRUE(utils::filesystem::file_exists(
+        utils::filesystem::path_combine(work_dir, "meta_state_service.checkpoint")));
+    delete service;
+
+    // the tree is loaded from the checkpoint and the logs after it
+    FLAGS_checkpoint_log_size_kb = old_checkpoint_log_size_kb;
+    service = creator();
+    service
+        ->get_children("/c",
+                       META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                       [](error_code ec, const std::vector<std::string> &children) {
+                           ASSERT_EQ(ERR_OK, ec);
+                           ASSERT_EQ(99, children.size());
+                       })
+        ->wait();
+    service
+        ->get_data("/c/0",
+                   META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                   [](error_code ec, const blob &data) {
+                       ASSERT_EQ(ERR_OK, ec);
+                       ASSERT_EQ("new", data.to_string());
+                   })
+        ->wait();
+    service
+        ->get_data("/c/99",
+                   META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                   [&value](error_code ec, const blob &data) {
+                       ASSERT_EQ(ERR_OK, ec);
+                       ASSERT_EQ(value, data.to_string());
+                   })
+        ->wait();
+    service->node_exist("/c/1", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_err)->wait();
+    delete service;
+    utils::filesystem::remove_path(work_dir);
+}
+
 #undef expect_ok
 #undef expect_err
 
@@ -259,8 +407,11 @@ TEST(meta_state_service, simple)
 
     provider_basic_test(simple_service_creator, simple_service_deleter);
     provider_recursively_create_delete_test(simple_service_creator, simple_service_deleter);
+    provider_concurrent_write_test(simple_service_creator, simple_service_deleter);
 }
 
+TEST(meta_state_service, simple_checkpoint) { simple_checkpoint_test(); }
+
 TEST(meta_state_service, zookeeper)
 {
     auto zookeeper_service_creator = [] {
@@ -274,4 +425,5 @@ TEST(meta_state_service, zookeeper)
 
     provider_basic_test(zookeeper_service_creator, zookeeper_service_deleter);
     provider_recursively_create_delete_test(zookeeper_service_creator, zookeeper_service_deleter);
+    provider_concurrent_write_test(zookeeper_service_creator, zookeeper_service_deleter);
 }
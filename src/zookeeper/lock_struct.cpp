@@ -419,6 +419,7 @@ void lock_struct::get_lock_owner(bool watch_myself)
     op->_input._path = _lock_dir + "/" + _owner._node_seq_name;
 
     op->_input._is_set_watch = 1;
+    op->_input._use_cache = true;
     op->_input._owner = this;
     op->_input._watcher_callback = watcher_callback_wrapper;
 
@@ -32,6 +32,7 @@
  *     2015-12-04, @shengofsun (sunweijie@xiaomi.com)
  */
 
+#include <dsn/utility/flags.h>
 #include <zookeeper/zookeeper.h>
 
 #include "zookeeper_session.h"
@@ -40,6 +41,13 @@
 namespace dsn {
 namespace dist {
 
+DSN_DEFINE_uint32("zookeeper",
+                  read_cache_capacity,
+                  100000,
+                  "the max number of nodes whose values are cached by a zookeeper session, "
+                  "0 means the read cache is disabled");
+DSN_TAG_VARIABLE(read_cache_capacity, FT_MUTABLE);
+
 zookeeper_session::zoo_atomic_packet::zoo_atomic_packet(unsigned int size)
 {
     _capacity = size;
@@ -132,9 +140,22 @@ const char *zookeeper_session::string_zoo_state(int zoo_state)
 
 zookeeper_session::~zookeeper_session() {}
 
-zookeeper_session::zookeeper_session(const service_app_info &node) : _handle(nullptr)
+zookeeper_session::zookeeper_session(const service_app_info &node)
+    : _handle(nullptr), _cache_epoch(1)
 {
     _srv_node = node;
+
+    _read_cache_hit_count.init_global_counter(_srv_node.full_name.c_str(),
+                                              "eon.zookeeper",
+                                              "read_cache_hit_count",
+                                              COUNTER_TYPE_RATE,
+                                              "the number of reads served from the read cache");
+    _read_cache_miss_count.init_global_counter(
+        _srv_node.full_name.c_str(),
+        "eon.zookeeper",
+        "read_cache_miss_count",
+        COUNTER_TYPE_RATE,
+        "the number of cacheable reads sent to zookeeper as they aren't cached");
 }
 
 int zookeeper_session::attach(void *callback_owner, const state_callback &cb)
@@ -168,6 +189,14 @@ void zookeeper_session::detach(void *callback_owner)
 
 void zookeeper_session::dispatch_event(int type, int zstate, const char *path)
 {
+    // the cached values are dropped before the watchers are notified, so that they can read the
+    // new values
+    if (ZOO_SESSION_EVENT != type) {
+        drop_from_cache(path, false);
+    } else if (ZOO_CONNECTED_STATE != zstate) {
+        clear_cache();
+    }
+
     {
         utils::auto_read_lock l(_watcher_lock);
         int ret_code = type;
@@ -224,6 +253,7 @@ void zookeeper_session::visit(zoo_opcontext *ctx)
                          (const void *)ctx);
         break;
     case ZOO_DELETE:
+        drop_from_cache(input._path, true);
         ec = zoo_adelete(_handle, path, -1, global_void_completion, (const void *)ctx);
         break;
     case ZOO_EXISTS:
@@ -232,13 +262,18 @@ void zookeeper_session::visit(zoo_opcontext *ctx)
         ec = zoo_aexists(
             _handle, path, input._is_set_watch, global_state_completion, (const void *)ctx);
         break;
-    case ZOO_GET:
+    case ZOO_GET: {
         if (1 == input._is_set_watch)
             add_watch_object();
-        ec =
-            zoo_aget(_handle, path, input._is_set_watch, global_data_completion, (const void *)ctx);
-        break;
+        if (input._use_cache && read_from_cache(ctx)) {
+            return;
+        }
+        // a watch is required to cache the value
+        int watch = (input._is_set_watch || ctx->_priv_cache_epoch != 0) ? 1 : 0;
+        ec = zoo_aget(_handle, path, watch, global_data_completion, (const void *)ctx);
+    } break;
     case ZOO_SET:
+        drop_from_cache(input._path, true);
         ec = zoo_aset(_handle,
                       path,
                       input._value.data(),
@@ -254,6 +289,9 @@ void zookeeper_session::visit(zoo_opcontext *ctx)
             _handle, path, input._is_set_watch, global_strings_completion, (const void *)ctx);
         break;
     case ZOO_TRANSACTION:
+        for (unsigned int i = 0; i < input._pkt->_count; ++i) {
+            drop_from_cache(input._pkt->_paths[i], true);
+        }
         ec = zoo_amulti(_handle,
                         input._pkt->_count,
                         input._pkt->_ops,
@@ -272,6 +310,63 @@ void zookeeper_session::visit(zoo_opcontext *ctx)
     }
 }
 
+bool zookeeper_session::read_from_cache(zoo_opcontext *ctx)
+{
+    std::shared_ptr<const std::string> value;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_cache_lock);
+        if (FLAGS_read_cache_capacity == 0) {
+            return false;
+        }
+        auto it = _read_cache.find(ctx->_input._path);
+        if (it == _read_cache.end()) {
+            ctx->_priv_cache_epoch = _cache_epoch;
+            _read_cache_miss_count->increment();
+            return false;
+        }
+        value = it->second;
+    }
+
+    _read_cache_hit_count->increment();
+    ctx->_output.error = ZOK;
+    ctx->_output.get_op.value = value->data();
+    ctx->_output.get_op.value_length = static_cast<int>(value->length());
+    ctx->_callback_function(ctx);
+    release_ref(ctx);
+    return true;
+}
+
+void zookeeper_session::add_to_cache(zoo_opcontext *ctx, const char *value, int value_length)
+{
+    if (value == nullptr) {
+        // the node has no data
+        return;
+    }
+    auto cached = std::make_shared<const std::string>(value, value_length);
+    utils::auto_lock<utils::ex_lock_nr> l(_cache_lock);
+    // the value may be out of date if a write is issued after the read
+    if (ctx->_priv_cache_epoch == _cache_epoch &&
+        _read_cache.size() < FLAGS_read_cache_capacity) {
+        _read_cache[ctx->_input._path] = std::move(cached);
+    }
+}
+
+void zookeeper_session::drop_from_cache(const std::string &path, bool by_write)
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_cache_lock);
+    _read_cache.erase(path);
+    if (by_write) {
+        _cache_epoch++;
+    }
+}
+
+void zookeeper_session::clear_cache()
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_cache_lock);
+    _read_cache.clear();
+    _cache_epoch++;
+}
+
 void zookeeper_session::init_non_dsn_thread()
 {
     static __thread int dsn_context_init = 0;
@@ -322,6 +417,9 @@ void zookeeper_session::global_data_completion(
     dinfo("rc(%s), input path(%s)", zerror(rc), op_ctx->_input._path.c_str());
     output.get_op.value_length = value_length;
     output.get_op.value = value;
+    if (ZOK == rc && op_ctx->_priv_cache_epoch != 0) {
+        op_ctx->_priv_session_ref->add_to_cache(op_ctx, value, value_length);
+    }
     op_ctx->_callback_function(op_ctx);
     release_ref(op_ctx);
 }
@@ -32,11 +32,13 @@
  *     2015-12-04, @shengofsun (sunweijie@xiaomi.com)
  */
 
+#include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/utility/utils.h>
 #include <dsn/utility/singleton.h>
 #include <dsn/utility/synchronize.h>
 
 #include <thread>
+#include <unordered_map>
 #include <zookeeper/zookeeper.h>
 #include "zookeeper_session_mgr.h"
 
@@ -88,6 +90,8 @@ public:
         int _flags;
         /* for get/exists/get_children */
         int _is_set_watch;
+        /* for get, which may be served from the read cache of the session */
+        bool _use_cache;
 
         /* for watcher callback */
         void *_owner;
@@ -136,6 +140,8 @@ public:
         // this are for implement usage, user shouldn't modify this directly
         zookeeper_session *_priv_session_ref;
         int32_t _ref_count;
+        // the epoch of the read cache when a cacheable read is sent, 0 for the others
+        uint64_t _priv_cache_epoch;
     };
 
     static zoo_opcontext *create_context()
@@ -143,6 +149,7 @@ public:
         zoo_opcontext *result = new zoo_opcontext();
         result->_input._flags = 0;
         result->_input._is_set_watch = false;
+        result->_input._use_cache = false;
         result->_input._owner = nullptr;
         result->_input._watcher_callback = nullptr;
 
@@ -151,6 +158,7 @@ public:
         result->_optype = ZOO_OPINVALID;
         result->_callback_function = nullptr;
         result->_priv_session_ref = nullptr;
+        result->_priv_cache_epoch = 0;
 
         result->add_ref();
         return result;
@@ -185,6 +193,24 @@ private:
     service_app_info _srv_node;
     zhandle_t *_handle;
 
+    // The values of the nodes read with `_use_cache`. A node is cached only if the read sets a
+    // watch on it, and the value is dropped once the watch is triggered, so it's never stale
+    // except for the writes issued by this session, which drop the values of their nodes.
+    // The reads issued before any write or disconnection are not cached, as their results may
+    // be out of date.
+    utils::ex_lock_nr _cache_lock;
+    std::unordered_map<std::string, std::shared_ptr<const std::string>> _read_cache;
+    // increased on every write or disconnection, starting from 1, as 0 means not cacheable
+    uint64_t _cache_epoch;
+    perf_counter_wrapper _read_cache_hit_count;
+    perf_counter_wrapper _read_cache_miss_count;
+
+    // returns false if the value of `ctx` isn't cached, otherwise `ctx` is completed
+    bool read_from_cache(zoo_opcontext *ctx);
+    void add_to_cache(zoo_opcontext *ctx, const char *value, int value_length);
+    void drop_from_cache(const std::string &path, bool by_write);
+    void clear_cache();
+
     void dispatch_event(int type, int zstate, const char *path);
     static void global_watcher(zhandle_t *handle, int type, int state, const char *path, void *ctx);
     static void global_string_completion(int rc, const char *name, const void *data);